@@ -0,0 +1,124 @@
+/*!
+ * allocation_tracker.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ *
+ * @brief
+ * Counting of heap allocations per pipeline stage, available in builds with
+ * ALLOCATION_TRACKING defined, e.g. by adding -DALLOCATION_TRACKING to
+ * compiler options.
+ */
+
+#ifndef NATIVE_PLAYER_INC_ALLOCATION_TRACKER_H_
+#define NATIVE_PLAYER_INC_ALLOCATION_TRACKER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Counts heap allocations made by global operator new, which is replaced in
+ * builds with ALLOCATION_TRACKING. Allocations are attributed to the stage
+ * of the innermost AllocationScope on the allocating thread, or to the
+ * "other" stage outside of scopes. Stages also count units of work, i.e.
+ * segments and packets, so allocations per segment and per packet can be
+ * compared between builds.
+ *
+ * Every 64th allocation of each thread is sampled together with its return
+ * address, which can be symbolized with addr2line, to find call sites which
+ * allocate the most.
+ *
+ * Stage names must be string literals, only pointers to them are stored.
+ * Without ALLOCATION_TRACKING all calls do nothing.
+ */
+class AllocationTracker {
+ public:
+  struct StageStats {
+    const char* stage;
+    uint64_t allocations;
+    uint64_t bytes;
+    uint64_t segments;
+    uint64_t packets;
+  };
+
+  struct CallSite {
+    uintptr_t address;
+    uint64_t samples;
+  };
+
+  static bool IsEnabled();
+
+  /**
+   * Counts a segment, or packets, processed by the stage.
+   */
+  static void CountSegment(const char* stage);
+  static void CountPackets(const char* stage, uint64_t count);
+
+  /**
+   * Returns counters of stages which allocated or counted anything.
+   */
+  static std::vector<StageStats> GetStageStats();
+
+  /**
+   * Returns sampled call sites, the most frequent first.
+   */
+  static std::vector<CallSite> GetTopCallSites(size_t count);
+
+  /**
+   * Returns a number of allocations made by the calling thread.
+   */
+  static uint64_t ThreadAllocations();
+
+  /**
+   * Resets all counters and samples.
+   */
+  static void Reset();
+
+ private:
+  friend class AllocationScope;
+
+  // Makes the stage current on the calling thread, returns the previous one.
+  static int32_t EnterStage(const char* stage);
+  static void LeaveStage(int32_t previous);
+};
+
+/**
+ * Attributes allocations made on the calling thread until the end of the
+ * scope to the given stage.
+ */
+class AllocationScope {
+ public:
+#ifdef ALLOCATION_TRACKING
+  explicit AllocationScope(const char* stage)
+      : previous_(AllocationTracker::EnterStage(stage)) {}
+
+  ~AllocationScope() {
+    AllocationTracker::LeaveStage(previous_);
+  }
+
+ private:
+  int32_t previous_;
+#else
+  explicit AllocationScope(const char*) {}
+#endif  // ALLOCATION_TRACKING
+};
+
+#define ALLOCATION_CONCAT_INTERNAL(a, b) a##b
+#define ALLOCATION_CONCAT(a, b) ALLOCATION_CONCAT_INTERNAL(a, b)
+#define ALLOCATION_SCOPE(stage) \
+  AllocationScope ALLOCATION_CONCAT(allocation_scope_, __LINE__)(stage)
+
+#endif  // NATIVE_PLAYER_INC_ALLOCATION_TRACKER_H_
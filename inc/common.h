@@ -21,6 +21,10 @@
 #ifndef NATIVE_PLAYER_SRC_COMMON_H_
 #define NATIVE_PLAYER_SRC_COMMON_H_
 
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <functional>
 #include <limits>
 #include <memory>
@@ -29,7 +33,11 @@
 #include <utility>
 #include <vector>
 
+#include "ppapi/c/pp_instance.h"
+#include "ppapi/cpp/url_loader.h"
 #include "ppapi/cpp/url_request_info.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/lock.h"
 
 #include "nacl_player/common.h"
 
@@ -37,10 +45,44 @@
 
 #include "logger.h"
 
+#ifndef LOG_CATEGORY
+#define LOG_CATEGORY LogCategory::kGeneral
+#endif
+
 #define LOG_STATS __LINE__, __func__, __FILE__
-#define LOG_INFO(msg, ...) Logger::Info(LOG_STATS, msg, ##__VA_ARGS__)
-#define LOG_ERROR(msg, ...) Logger::Error(LOG_STATS, msg, ##__VA_ARGS__)
-#define LOG_DEBUG(msg, ...) Logger::Debug(LOG_STATS, msg, ##__VA_ARGS__)
+// Arguments are evaluated only when the level is enabled for the category of
+// the calling file. Levels above kCompiledLogLevel are a constant false
+// condition and get compiled out.
+#define LOG_AT_LEVEL(level, func, msg, ...)         \
+  do {                                              \
+    if (Logger::IsEnabled(level, LOG_CATEGORY))     \
+      Logger::func(LOG_STATS, msg, ##__VA_ARGS__);  \
+  } while (0)
+#define LOG_INFO(msg, ...) \
+  LOG_AT_LEVEL(LogLevel::kInfo, Info, msg, ##__VA_ARGS__)
+#define LOG_ERROR(msg, ...) \
+  LOG_AT_LEVEL(LogLevel::kError, Error, msg, ##__VA_ARGS__)
+#define LOG_DEBUG(msg, ...) \
+  LOG_AT_LEVEL(LogLevel::kDebug, Debug, msg, ##__VA_ARGS__)
+
+// Rate limited logs for sites called per packet or per read, e.g.
+// LOG_EVERY_N(Debug, 100, "...") logs the 1st, 101st, 201st... call and
+// LOG_EVERY_MS(Info, 1000, "...") logs at most once a second. Calls made
+// while the level is disabled are not counted.
+#define LOG_EVERY_N(severity, n, msg, ...)                             \
+  do {                                                                 \
+    static std::atomic<uint32_t> log_occurrences(0);                   \
+    if (Logger::IsEnabled(LogLevel::k##severity, LOG_CATEGORY) &&      \
+        log_occurrences++ % (n) == 0)                                  \
+      Logger::severity(LOG_STATS, msg, ##__VA_ARGS__);                 \
+  } while (0)
+#define LOG_EVERY_MS(severity, interval_ms, msg, ...)                  \
+  do {                                                                 \
+    static std::atomic<int64_t> log_last_ms(-1);                       \
+    if (Logger::IsEnabled(LogLevel::k##severity, LOG_CATEGORY) &&      \
+        Logger::ShouldLogEveryMs(&log_last_ms, interval_ms))           \
+      Logger::severity(LOG_STATS, msg, ##__VA_ARGS__);                 \
+  } while (0)
 
 constexpr double kEps = 0.0001;
 constexpr Samsung::NaClPlayer::TimeTicks kSegmentMargin = 0.1;
@@ -61,6 +103,23 @@ enum class StreamType : int32_t {
   MaxStreamTypes = static_cast<int32_t>(MediaStreamType::MaxTypes)
 };
 
+// Media times a stream is buffered for, in seconds, like MSE buffered ranges
+// split by stages of the pipeline. Buffering starts anew at each seek, so
+// each stage holds a single range, which is empty when end is not past
+// start.
+struct StreamBufferedRanges {
+  struct Range {
+    Samsung::NaClPlayer::TimeTicks start = 0.;
+    Samsung::NaClPlayer::TimeTicks end = 0.;
+  };
+  // Packets appended to the player since the last seek.
+  Range appended;
+  // Packets demuxed and waiting to be appended.
+  Range queued;
+  // Segments downloaded and passed to the demuxer.
+  Range downloaded;
+};
+
 const Samsung::NaClPlayer::TimeTicks kEndOfStream =
     std::numeric_limits<Samsung::NaClPlayer::TimeTicks>::infinity();
 
@@ -68,6 +127,32 @@ std::string ToHexString(uint32_t size, const uint8_t* data);
 
 std::vector<uint8_t> Base64Decode(const std::string& text);
 
+// Whitespace of XML and of text subtitle formats: space, tab, CR and LF.
+// Parsers call it for every character, so it's inline.
+inline bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Checks if the text in [p, end), or text, starts with prefix.
+inline bool StartsWith(const char* p, const char* end, const char* prefix) {
+  size_t size = std::strlen(prefix);
+  return static_cast<size_t>(end - p) >= size &&
+         std::memcmp(p, prefix, size) == 0;
+}
+
+inline bool StartsWith(const std::string& text, const char* prefix) {
+  return StartsWith(text.data(), text.data() + text.size(), prefix);
+}
+
+// Nearest rank percentile of sorted samples, 0 if there are none.
+double Percentile(const std::vector<double>& sorted, double percent);
+
+// Milliseconds of the steady clock which passed since start.
+double MillisecondsSince(std::chrono::steady_clock::time_point start);
+
+// Microseconds of the steady clock which passed since start.
+double MicrosecondsSince(std::chrono::steady_clock::time_point start);
+
 // From:
 // https://isocpp.org/wiki/faq/pointers-to-members#macro-for-ptr-to-memfn
 #define CALL_MEMBER_FN(object, ptr_to_member)  ((object).*(ptr_to_member))
@@ -108,12 +193,257 @@ inline auto WeakBind(
       std::forward<Args>(args)...);
 }
 
+// Instances of the module, each of them showing a player of its own (e.g.
+// a mosaic or picture in picture). Requests which don't belong to one of
+// them, e.g. downloads on workers shared by all players, are made on behalf
+// of the oldest one which is still alive. Both are thread safe.
+void RegisterModuleInstance(PP_Instance instance);
+void UnregisterModuleInstance(PP_Instance instance);
+
 pp::URLRequestInfo GetRequestForURL(const std::string& url);
 
+// Sends a HEAD request to url, so the DNS lookup and the TCP and TLS
+// handshakes with its host are done before requests which need them, which
+// reuse the connection. The response is dropped. Must not be called on the
+// main thread.
+int32_t WarmUpConnection(const std::string& url);
+
+// Returns value of the given HTTP header or an empty string if it's missing.
+// Header names are compared case insensitively.
+std::string GetHttpHeader(const std::string& headers, const std::string& name);
+
+struct TuningProfile;
+
+// Timing of a request, in seconds since it was started.
+struct URLRequestTiming {
+  // Response headers were received, i.e. URLLoader::Open() completed.
+  double time_to_first_byte = 0.;
+  // The first part of the response body was received, 0 if it was empty.
+  double time_to_first_body_byte = 0.;
+  // The whole response body was received.
+  double total_time = 0.;
+};
+
+// Status code and headers of a response.
+struct URLResponseHeaders {
+  int32_t status_code = 0;
+  // Headers separated by new lines.
+  std::string headers;
+};
+
+// Headers of a response which tell how it was served, e.g. to correlate slow
+// downloads with CDN cache misses.
+struct ResponseDiagnostics {
+  int32_t status_code = 0;
+  // Content-Length, 0 if it's not given.
+  uint64_t content_length = 0;
+  // Age, i.e. seconds the response spent in caches, -1 if it's not given.
+  int64_t age = -1;
+  // X-Cache, e.g. "Hit from cloudfront" or "MISS, HIT".
+  std::string cache_status;
+  // Server-Timing, e.g. "cdn-cache;desc=MISS, origin;dur=120".
+  std::string server_timing;
+  // An id of the CDN point of presence which served the response, taken from
+  // X-Amz-Cf-Pop, X-Served-By, CF-Ray or X-Edge-Location.
+  std::string cdn_pop;
+};
+
+// Extracts ResponseDiagnostics from status and headers of a response.
+ResponseDiagnostics ParseResponseDiagnostics(
+    const URLResponseHeaders& response);
+
+// HTTP status of a response to a conditional request, which body wasn't
+// modified. Such response has an empty body.
+constexpr int32_t kHttpNotModified = 304;
+
+// Lets another thread abort URL requests started with it, e.g. downloads
+// which are not needed after a seek. Cancel() closes URLLoaders of requests
+// in progress, so their blocking calls return right away, and makes requests
+// started later fail without opening a connection. Such requests return
+// PP_ERROR_ABORTED. It's thread safe.
+class CancellationToken {
+ public:
+  CancellationToken();
+  ~CancellationToken();
+
+  void Cancel();
+  bool IsCancelled() const;
+
+  // Registers a loader of a request in progress, returns false if the token
+  // is cancelled already.
+  bool Attach(const pp::URLLoader& loader);
+  void Detach(const pp::URLLoader& loader);
+
+ private:
+  mutable pp::Lock lock_;
+  bool cancelled_;
+  std::vector<pp::URLLoader> loaders_;
+};
+
+// Resources which should be released when a player is closed. Their counts
+// are sampled by a soak test to find leaks.
+enum class TrackedResource : int32_t {
+  // Threads of NetworkExecutors and demuxers.
+  kThread,
+  // URLLoaders of requests in progress.
+  kUrlLoader,
+  kMaxTrackedResources
+};
+
+// Counts resources for the lifetime of this object. It's thread safe.
+class ScopedResourceCount {
+ public:
+  explicit ScopedResourceCount(TrackedResource resource, int64_t count = 1);
+  ~ScopedResourceCount();
+
+  // Returns the number of resources counted by existing objects.
+  static int64_t Get(TrackedResource resource);
+
+ private:
+  ScopedResourceCount(const ScopedResourceCount&) = delete;
+  ScopedResourceCount& operator=(const ScopedResourceCount&) = delete;
+
+  TrackedResource resource_;
+  int64_t count_;
+};
+
+// Timing of the request is stored in timing, if it's not null.
+int32_t ProcessURLRequestOnSideThread(const pp::URLRequestInfo& request,
+                                      std::string* out,
+                                      URLRequestTiming* timing = nullptr);
+
+// Status and headers of the response are stored in response, if it's not
+// null.
 int32_t ProcessURLRequestOnSideThread(const pp::URLRequestInfo& request,
-                                      std::string* out);
+                                      std::string* out,
+                                      URLRequestTiming* timing,
+                                      URLResponseHeaders* response);
 
+// The request is aborted when token, if it's not null, is cancelled. Status
+// and headers of the response are stored in response, if it's not null.
+// A body shorter than announced by the response headers, e.g. when the
+// connection dropped, ends with PP_ERROR_CONNECTION_CLOSED. Bytes received
+// so far are kept in out then, so the rest can be requested with a Range
+// header. The same applies to all overloads. The response buffer is sized
+// by tuning, or by the current TuningProfile if it's null.
 int32_t ProcessURLRequestOnSideThread(const pp::URLRequestInfo& request,
-                                      std::vector<uint8_t>* out);
+                                      std::vector<uint8_t>* out,
+                                      URLRequestTiming* timing = nullptr,
+                                      CancellationToken* token = nullptr,
+                                      URLResponseHeaders* response = nullptr,
+                                      const TuningProfile* tuning = nullptr);
+
+// Passes the response body to chunk_callback in chunks, as it is received.
+// Download is aborted if chunk_callback returns false or token, if it's not
+// null, is cancelled. A truncated body ends with PP_ERROR_CONNECTION_CLOSED
+// after chunks received in full are passed on. Chunks are sized by tuning,
+// or by the current TuningProfile if it's null.
+int32_t ProcessURLRequestOnSideThread(
+    const pp::URLRequestInfo& request,
+    const std::function<bool(std::vector<uint8_t>&&)>& chunk_callback,
+    URLRequestTiming* timing = nullptr, CancellationToken* token = nullptr,
+    URLResponseHeaders* response = nullptr,
+    const TuningProfile* tuning = nullptr);
+
+// Downloads a response body without blocking: opening the request and each
+// read complete on the message loop of the thread which called Start(), so a
+// single thread (the main one included) can run many requests at a time.
+// The loader must be started and destroyed on that thread. Destroying it
+// aborts the request without running done_callback.
+class AsyncURLLoader {
+ public:
+  enum class State { kIdle, kOpening, kReading, kFinished };
+
+  // Receives PP_OK and the response body, or an error code. The body is
+  // empty when chunks were passed to a ChunkCallback instead.
+  typedef std::function<void(int32_t, std::vector<uint8_t>&&)> DoneCallback;
+  // Receives parts of the body as they arrive, returning false aborts the
+  // download.
+  typedef std::function<bool(std::vector<uint8_t>&&)> ChunkCallback;
+
+  AsyncURLLoader();
+  ~AsyncURLLoader();
+
+  // Must be called before Start().
+  void SetChunkCallback(ChunkCallback chunk_callback);
+
+  // Starts the request, done_callback is run once it ends, unless Start()
+  // itself fails. The request is aborted when token, if it's not null, is
+  // cancelled.
+  //
+  // @return PP_OK_COMPLETIONPENDING if the request was started or an error
+  // code.
+  int32_t Start(const pp::URLRequestInfo& request, DoneCallback done_callback,
+                std::shared_ptr<CancellationToken> token = nullptr);
+
+  State state() const { return state_; }
+  // Valid once the request is finished.
+  const URLRequestTiming& timing() const { return timing_; }
+  // Valid once the request is opened.
+  const URLResponseHeaders& response() const { return response_; }
+
+ private:
+  void OnOpened(int32_t result);
+  void ReadNext();
+  void OnRead(int32_t result);
+  void Finish(int32_t result);
+
+  AsyncURLLoader(const AsyncURLLoader&) = delete;
+  AsyncURLLoader& operator=(const AsyncURLLoader&) = delete;
+
+  pp::CompletionCallbackFactory<AsyncURLLoader> cc_factory_;
+  State state_;
+  pp::URLLoader loader_;
+  std::unique_ptr<ScopedResourceCount> loader_count_;
+  std::shared_ptr<CancellationToken> token_;
+  DoneCallback done_callback_;
+  ChunkCallback chunk_callback_;
+  // Taken from the TuningProfile when the response is opened.
+  size_t min_chunk_size_;
+  std::unique_ptr<uint8_t[]> scratch_;
+  // The whole body, or the current chunk when chunk_callback_ is set.
+  std::vector<uint8_t> body_;
+  std::chrono::steady_clock::time_point start_;
+  URLRequestTiming timing_;
+  URLResponseHeaders response_;
+};
+
+// Returns a directory of a temporary HTML5 file system, which keeps data
+// between sessions unless the browser needs the space. It's mounted on the
+// first call, an empty string is returned if that fails. Must not be called
+// on the main thread.
+std::string GetTemporaryStorageDir();
+
+// Returns a directory of a persistent HTML5 file system, which the browser
+// doesn't clear, like GetTemporaryStorageDir(). It needs a storage quota
+// granted to the application.
+std::string GetPersistentStorageDir();
+
+// Returns a name of a file which holds data of key in one of the storage
+// dirs above: a stable hash of key as 16 hex digits. Other keys can get the
+// same name, so the key is stored in the file and checked when it's read.
+std::string StorageFileName(const std::string& key);
+
+// Writes a field of a storage file: its size followed by its bytes.
+bool WriteStorageField(FILE* file, const void* data, uint32_t size);
+bool WriteStorageField(FILE* file, const std::string& field);
+
+// Reads a field written by WriteStorageField(). Fails if the field is
+// bigger than max_size, as the file can be broken.
+bool ReadStorageField(FILE* file, uint32_t max_size, std::string* field);
+bool ReadStorageField(FILE* file, uint32_t max_size,
+                      std::vector<uint8_t>* field);
+
+// Returns a path of a file:// URL in the nacl_io file system (e.g. a mounted
+// USB storage or one of the storage dirs above), or an empty string if url
+// is not a file:// URL.
+std::string LocalFilePath(const std::string& url);
+
+// Reads a file of the nacl_io file system, or a byte range of it in the
+// "first-last" form of a HTTP Range header, straight into data, which is
+// allocated once in the size of the range. Returns false if the file can't
+// be read or the range starts past its end.
+bool ReadLocalFile(const std::string& path, const std::string& range,
+                   std::vector<uint8_t>* data);
 
 #endif  // NATIVE_PLAYER_SRC_COMMON_H_
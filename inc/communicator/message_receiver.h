@@ -21,12 +21,30 @@
 #ifndef NATIVE_PLAYER_INC_COMMUNICATOR_MESSAGE_RECEIVER_H_
 #define NATIVE_PLAYER_INC_COMMUNICATOR_MESSAGE_RECEIVER_H_
 
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <utility>
+
 #include "ppapi/cpp/var.h"
 #include "ppapi/cpp/instance_handle.h"
 #include "ppapi/cpp/message_handler.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/simple_thread.h"
 
+#include "communicator/message_sender.h"
+#include "dash/manifest_benchmark.h"
+#include "demuxer/demuxer_benchmark.h"
+#include "encoding_benchmark.h"
+#include "player/es_dash_player/drm_benchmark.h"
+#include "player/es_dash_player/network_simulation.h"
+#include "player/es_dash_player/packet_capture.h"
+#include "player/es_dash_player/packets_manager_benchmark.h"
+#include "player/es_dash_player/seek_benchmark.h"
+#include "player/es_dash_player/switch_benchmark.h"
 #include "player/player_controller.h"
 #include "player/player_provider.h"
+#include "player/soak_test.h"
 
 /// @file
 /// @brief This file defines <code>MessageReceiver</code> class.
@@ -46,6 +64,14 @@ namespace Communication {
 ///
 /// @see Communication Description of the <code>Communication</code> namespace
 ///   provides a brief of the communication mechanism.
+/// Messages are handled in order on a single thread, because player
+/// controllers are not thread safe. Closing a player joins its threads, so
+/// a closed (or replaced) controller is destroyed on a separate thread
+/// instead. This way control messages queued after <code>kClosePlayer</code>
+/// or <code>kLoadMedia</code> are not delayed by the teardown, and
+/// <code>kPlayerClosed</code> is sent once it completes. A DASH player which
+/// loads DASH media again is reused rather than replaced.
+///
 /// @see kKeyMessageToPlayer
 /// @see MessageToPlayer
 
@@ -53,15 +79,20 @@ class MessageReceiver : public pp::MessageHandler {
  public:
   /// Creates a <code>MessageReceiver</code> object instance.
   ///
+  /// @param[in] instance An instance used to create a thread on which closed
+  ///   players are destroyed.
   /// @param[in] player_provider A factory object which is used to get player
   ///   controller which fits the needs.
+  /// @param[in] message_sender An object used to reply to messages which
+  ///   aren't handled by the player, e.g. <code>kExportTrace</code>.
   /// @see PlayerProvider
-  explicit MessageReceiver(std::shared_ptr<PlayerProvider> player_provider)
-      : player_provider_(std::move(player_provider)) {}
+  MessageReceiver(const pp::InstanceHandle& instance,
+                  std::shared_ptr<PlayerProvider> player_provider,
+                  std::shared_ptr<MessageSender> message_sender);
 
   /// Destroys the <code>MessageReceiver</code> object and frees all allocated
-  /// resources.
-  ~MessageReceiver() {}
+  /// resources. Waits until players closed so far are destroyed.
+  ~MessageReceiver();
 
   /// Handles asynchronous messages from the communication
   /// channel. This method performs an action selected basing on a value mapped
@@ -115,15 +146,18 @@ class MessageReceiver : public pp::MessageHandler {
 
   /// @public
   /// Handles a <code>kClosePlayer</code> message, closes the player
-  /// and frees resources.
+  /// and frees resources. Resources are freed asynchronously, a
+  /// <code>kPlayerClosed</code> message is sent when it's done.
   ///
   /// @see kClosePlayer
+  /// @see kPlayerClosed
   void ClosePlayer();
 
   /// @public
   /// Validates a <code>kLoadMedia</code> message, decodes provided
   /// parameters and creates a player that can handle a given type of the
-  /// multimedia content.
+  /// multimedia content. A player of the same type is reused if it can
+  /// be, so zapping between titles keeps NaCl Player and caches warm.
   ///
   /// @param[in] type A type of a content which needs to be loaded. This
   ///   <code>Var</code> is casted to <code>ClipTypeEnum</code> and it has to
@@ -143,13 +177,72 @@ class MessageReceiver : public pp::MessageHandler {
   ///   used when requesting license from license server
   ///   (see <code>license_url</code>). It is an optional parameter, which
   ///   has to be a <code>dictionary</code> type value.
+  /// @param[in] initial_buffer Seconds of media buffered before a URL
+  ///   content starts playing. It is an optional parameter, which has to be
+  ///   a <code>double</code> type value.
+  /// @param[in] start_time A position in seconds a DASH content starts
+  ///   playing at. It is an optional parameter, which has to be a
+  ///   <code>double</code> type value.
+  /// @param[in] tuning A <code>TuningProfile</code> used by the player. It
+  ///   is an optional parameter, which has to be a <code>dictionary</code>
+  ///   type value.
   ///
   /// @see kLoadMedia
   /// @see ClipTypeEnum
   void LoadMedia(const pp::Var& type, const pp::Var& url,
                  const pp::Var& subtitle, const pp::Var& encoding,
                  const pp::Var& license_url,
-                 const pp::Var& key_request_properties);
+                 const pp::Var& key_request_properties,
+                 const pp::Var& initial_buffer,
+                 const pp::Var& start_time, const pp::Var& tuning);
+
+  /// Makes the profile in a <code>kLoadMedia</code> message current, or
+  /// the default one if the message has none.
+  void SetTuningProfile(const pp::Var& tuning);
+
+  /// @public
+  /// Validates a <code>kPreloadMedia</code> message and starts preparing
+  /// the given content in the background.
+  ///
+  /// @param[in] type A type of the content. This <code>Var</code> is cast
+  ///   to <code>ClipTypeEnum</code> and it has to be an integer value.
+  /// @param[in] url An URL to the content container. This <code>Var</code>
+  ///   has to be a <code>string</code> type value.
+  ///
+  /// @see kPreloadMedia
+  void PreloadMedia(const pp::Var& type, const pp::Var& url);
+
+  /// @public
+  /// Validates a <code>kSetWarmMedia</code> message and keeps the given
+  /// DASH content warm in the background.
+  ///
+  /// @param[in] urls URLs to DASH manifests. This <code>Var</code> has to
+  ///   be an <code>array</code> of <code>string</code> values.
+  ///
+  /// @see kSetWarmMedia
+  void SetWarmMedia(const pp::Var& urls);
+
+  /// @public
+  /// Validates a <code>kDownloadMedia</code> message and starts storing
+  /// the given DASH content for offline playback.
+  ///
+  /// @param[in] url An URL to the DASH manifest. This <code>Var</code> has
+  ///   to be a <code>string</code> type value.
+  /// @param[in] bitrate The highest video bitrate stored, it's optional.
+  ///
+  /// @see kDownloadMedia
+  void DownloadMedia(const pp::Var& url, const pp::Var& bitrate);
+
+  /// @public
+  /// Handles a <code>kEnqueueMedia</code> message, and requests the player
+  /// to play the given content after the current one. The request will be
+  /// ignored if the content is not loaded.
+  ///
+  /// @param[in] url An URL to the DASH manifest. This <code>Var</code> has
+  ///   to be a <code>string</code> type value.
+  ///
+  /// @see kEnqueueMedia
+  void EnqueueMedia(const pp::Var& url);
 
   /// @public
   /// Handles a <code>kPause</code> message, and requests the player
@@ -177,6 +270,25 @@ class MessageReceiver : public pp::MessageHandler {
   /// @see TimeTick
   void Seek(const pp::Var& time);
 
+  /// @public
+  /// Handles a <code>kSeekPreview</code> message, validates a provided
+  /// parameter and lets the player prepare for a seek to the given time.
+  /// The request will be ignored if the content is not loaded.
+  ///
+  /// @param[in] time A candidate seek position, it has to be a floating point
+  ///   value.
+  /// @see kSeekPreview
+  void PreviewSeek(const pp::Var& time);
+
+  /// @public
+  /// Handles a <code>kSetPlaybackRate</code> message, validates a provided
+  /// parameter and starts or stops a fast forward or rewind. The request
+  /// will be ignored if the content is not loaded.
+  ///
+  /// @param[in] rate A playback rate, it has to be a number.
+  /// @see kSetPlaybackRate
+  void SetPlaybackRate(const pp::Var& rate);
+
   /// @public
   /// Handles a <code>kChangeViewRect</code> message, validates
   /// provided parameters and informs the player about new position and
@@ -215,11 +327,307 @@ class MessageReceiver : public pp::MessageHandler {
   void ChangeSubtitlesVisibility();
 
   /// @public
-  void SetLogLevel(const pp::Var& level);
+  /// Handles a <code>kSetLogLevel</code> message, sets a level of logs sent
+  /// to JS or, when a category is given, limits logs of that category.
+  ///
+  /// @param[in] level A <code>LogLevel</code> value.
+  /// @param[in] category An optional name of a log category.
+  /// @see kSetLogLevel
+  void SetLogLevel(const pp::Var& level, const pp::Var& category);
+
+  /// @public
+  /// Handles a <code>kSetThreadPriority</code> message, sets a priority and a
+  /// CPU of threads of the given role.
+  ///
+  /// @param[in] role A name of a <code>ThreadRole</code>.
+  /// @param[in] priority A nice value.
+  /// @param[in] cpu An optional index of a CPU.
+  /// @see kSetThreadPriority
+  void SetThreadPriority(const pp::Var& role, const pp::Var& priority,
+                         const pp::Var& cpu);
+
+  /// @public
+  /// Handles a <code>kSetMainThreadBudget</code> message.
+  ///
+  /// @param[in] budget A time of main thread work allowed per frame in
+  ///   seconds. This <code>Var</code> has to be a number.
+  /// @see kSetMainThreadBudget
+  void SetMainThreadBudget(const pp::Var& budget);
+
+  /// @public
+  /// Handles a <code>kSetMemoryBudget</code> message.
+  ///
+  /// @param[in] budget A budget of memory in bytes. This <code>Var</code>
+  ///   has to be a number.
+  /// @see kSetMemoryBudget
+  void SetMemoryBudget(const pp::Var& budget);
+
+  /// @public
+  /// Handles a <code>kSetMemoryPressure</code> message.
+  ///
+  /// @param[in] pressure A name of a <code>MemoryPressure</code> level.
+  /// @see kSetMemoryPressure
+  void SetMemoryPressure(const pp::Var& pressure);
+
+  /// @public
+  /// Handles a <code>kSetVisibility</code> message.
+  ///
+  /// @param[in] visible Whether the application is visible. This
+  ///   <code>Var</code> has to be a bool.
+  /// @see kSetVisibility
+  void SetVisibility(const pp::Var& visible);
+
+  /// @public
+  /// Handles a <code>kSetAudioOnly</code> message.
+  ///
+  /// @param[in] enabled Whether only audio should be played. This
+  ///   <code>Var</code> has to be a bool.
+  /// @see kSetAudioOnly
+  void SetAudioOnly(const pp::Var& enabled);
+
+  /// @public
+  /// Handles a <code>kSetDeviceCapabilities</code> message. Limits which
+  /// are not given don't prune representations.
+  ///
+  /// @param[in] width The largest video width.
+  /// @param[in] height The largest video height.
+  /// @param[in] channels The most audio channels.
+  /// @param[in] hdr Whether HDR video can be presented.
+  /// @param[in] codecs An array of supported sample entries.
+  /// @see kSetDeviceCapabilities
+  void SetDeviceCapabilities(const pp::Var& width, const pp::Var& height,
+                             const pp::Var& channels, const pp::Var& hdr,
+                             const pp::Var& codecs);
+
+  /// @public
+  /// Handles a <code>kSetTimeUpdateInterval</code> message.
+  ///
+  /// @param[in] interval A minimum interval between time updates in seconds.
+  ///   This <code>Var</code> has to be a number.
+  /// @see kSetTimeUpdateInterval
+  void SetTimeUpdateInterval(const pp::Var& interval);
+
+  /// @public
+  /// Handles a <code>kSetBinaryMessages</code> message.
+  ///
+  /// @param[in] enabled Whether binary messages should be used. This
+  ///   <code>Var</code> has to be a bool.
+  /// @see kSetBinaryMessages
+  void SetBinaryMessages(const pp::Var& enabled);
+
+  /// @public
+  /// Handles a <code>kGetMetrics</code> message, requests the player to send
+  /// its metrics and optionally changes how often they are sent. The request
+  /// will be ignored if the content is not loaded.
+  ///
+  /// @param[in] interval An optional interval of sending metrics in seconds.
+  ///   This <code>Var</code> has to be a number.
+  /// @see kGetMetrics
+  void GetMetrics(const pp::Var& interval);
+
+  /// @public
+  /// Handles a <code>kExportTrace</code> message, stops collecting trace
+  /// events and sends them in a <code>kTraceData</code> message.
+  ///
+  /// @see kExportTrace
+  void ExportTrace();
+
+  /// @public
+  /// Handles a <code>kBenchmarkDemuxer</code> message, validates provided
+  /// parameters and starts a demuxer benchmark, unless one is running.
+  ///
+  /// @param[in] type A <code>StreamType</code> of the content, it has to be
+  ///   an integer value.
+  /// @param[in] init_url An URL of the initialization segment, it has to be
+  ///   a <code>string</code> type value.
+  /// @param[in] media_urls URLs of media segments, it has to be an array of
+  ///   <code>string</code> values.
+  /// @param[in] demuxer An optional name of the demuxer to test.
+  /// @see kBenchmarkDemuxer
+  void BenchmarkDemuxer(const pp::Var& type, const pp::Var& init_url,
+                        const pp::Var& media_urls, const pp::Var& demuxer);
+
+  /// @public
+  /// Handles a <code>kBenchmarkPacketsManager</code> message and starts a
+  /// <code>PacketsManager</code> benchmark, unless one is running.
+  ///
+  /// @see kBenchmarkPacketsManager
+  void BenchmarkPacketsManager();
+
+  /// @public
+  /// Handles a <code>kBenchmarkManifest</code> message and starts a manifest
+  /// benchmark, unless one is running.
+  ///
+  /// @see kBenchmarkManifest
+  void BenchmarkManifest();
+
+  /// @public
+  /// Handles a <code>kSimulateNetwork</code> message, validates provided
+  /// parameters and starts a network simulation, unless one is running.
+  ///
+  /// @param[in] url An URL to the DASH manifest, it has to be a
+  ///   <code>string</code> type value.
+  /// @param[in] traces Optional traces, a dictionary of arrays of points.
+  /// @see kSimulateNetwork
+  void SimulateNetwork(const pp::Var& url, const pp::Var& traces);
+
+  /// @public
+  /// Handles a <code>kSoakTest</code> message, validates provided
+  /// parameters and starts or stops a soak test.
+  ///
+  /// @param[in] type A kind of the content, it has to be an integer value.
+  /// @param[in] url An URL to the content, it has to be a
+  ///   <code>string</code> type value.
+  /// @param[in] duration A duration of the test in seconds, 0 stops it.
+  /// @param[in] seek_range An optional limit of seek positions in seconds.
+  /// @see kSoakTest
+  void RunSoakTest(const pp::Var& type, const pp::Var& url,
+                   const pp::Var& duration, const pp::Var& seek_range);
+
+  /// @public
+  /// Handles a <code>kGetAllocationStats</code> message and sends
+  /// allocation counters of pipeline stages.
+  ///
+  /// @param[in] operation An optional <code>"reset"</code> string, which
+  ///   clears counters after they are sent.
+  /// @see kGetAllocationStats
+  void GetAllocationStats(const pp::Var& operation);
+
+  /// @public
+  /// Handles a <code>kGetCpuStats</code> message and sends CPU time used
+  /// by pipeline stages.
+  ///
+  /// @param[in] sampling_interval An optional interval of stage sampling
+  ///   in seconds, 0 stops sampling.
+  /// @see kGetCpuStats
+  void GetCpuStats(const pp::Var& sampling_interval);
+
+  /// @public
+  /// Handles a <code>kBenchmarkEncoding</code> message and starts an
+  /// encoding benchmark, unless one is running.
+  ///
+  /// @see kBenchmarkEncoding
+  void BenchmarkEncoding();
+
+  /// @public
+  /// Handles a <code>kBenchmarkAll</code> message and queues benchmarks,
+  /// unless a queue is running. Optional parameters which are missing or
+  /// have a wrong type skip benchmarks which need them.
+  ///
+  /// @param[in] device A device model put in benchmark records.
+  /// @param[in] type A <code>StreamType</code> of demuxer benchmark content.
+  /// @param[in] init_url An URL of its initialization segment.
+  /// @param[in] media_urls URLs of its media segments.
+  /// @param[in] manifest_url An URL of a manifest for a network simulation
+  ///   and a seek benchmark.
+  /// @see kBenchmarkAll
+  void BenchmarkAll(const pp::Var& device, const pp::Var& type,
+                    const pp::Var& init_url, const pp::Var& media_urls,
+                    const pp::Var& manifest_url);
+
+  /// @public
+  /// Handles a <code>kStartPacketCapture</code> message.
+  ///
+  /// @param[in] path An optional path of the capture file.
+  /// @param[in] with_payloads Whether packet payloads are recorded.
+  /// @see kStartPacketCapture
+  void StartPacketCapture(const pp::Var& path, const pp::Var& with_payloads);
+
+  /// @public
+  /// Handles a <code>kStopPacketCapture</code> message and sends what was
+  /// recorded.
+  ///
+  /// @see kStopPacketCapture
+  void StopPacketCapture();
+
+  /// @public
+  /// Handles a <code>kReplayPacketCapture</code> message and starts a
+  /// replay, unless one is running.
+  ///
+  /// @param[in] path An optional path of the capture file.
+  /// @param[in] rate 0 to replay as fast as possible.
+  /// @see kReplayPacketCapture
+  void ReplayPacketCapture(const pp::Var& path, const pp::Var& rate);
+
+  /// @public
+  /// Handles a <code>kBenchmarkSeek</code> message and starts a seek
+  /// benchmark, unless one is running.
+  ///
+  /// @param[in] manifest_urls URLs of manifests, it has to be an array of
+  ///   <code>string</code> values.
+  /// @see kBenchmarkSeek
+  void BenchmarkSeek(const pp::Var& manifest_urls);
+
+  /// @public
+  /// Handles a <code>kBenchmarkSwitch</code> message and starts a
+  /// representation switch benchmark, unless one is running.
+  ///
+  /// @param[in] manifest_urls URLs of manifests, it has to be an array of
+  ///   <code>string</code> values.
+  /// @see kBenchmarkSwitch
+  void BenchmarkSwitch(const pp::Var& manifest_urls);
+
+  /// @public
+  /// Handles a <code>kBenchmarkDrm</code> message and starts a DRM
+  /// benchmark, unless one is running.
+  ///
+  /// @param[in] manifest_url An optional URL of PlayReady content.
+  /// @see kBenchmarkDrm
+  void BenchmarkDrm(const pp::Var& manifest_url);
+
+  /// @private
+  /// Starts the next queued benchmark once the previous one is finished,
+  /// polling on the message handling thread.
+  void RunNextBenchmark(int32_t);
+
+  /// @private
+  /// Passes the given controller to <code>disposal_thread_</code>, so it
+  /// is destroyed there.
+  void DisposePlayer(std::shared_ptr<PlayerController> controller);
+
+  /// @private
+  /// Releases the controller on <code>disposal_thread_</code> and sends
+  /// <code>kPlayerClosed</code>.
+  void DisposePlayerOnDisposalThread(int32_t,
+      std::shared_ptr<PlayerController>* controller);
 
   std::shared_ptr<PlayerController> player_controller_;
+  // Type player_controller_ was created with.
+  PlayerProvider::PlayerType player_type_;
   std::shared_ptr<PlayerProvider> player_provider_;
+  std::shared_ptr<MessageSender> message_sender_;
   Samsung::NaClPlayer::Rect view_rect_;
+  pp::InstanceHandle instance_;
+  // Created on the first kBenchmarkDemuxer message.
+  std::unique_ptr<DemuxerBenchmark> demuxer_benchmark_;
+  // Created on the first kBenchmarkPacketsManager message.
+  std::unique_ptr<PacketsManagerBenchmark> packets_manager_benchmark_;
+  // Created on the first kBenchmarkManifest message.
+  std::unique_ptr<ManifestBenchmark> manifest_benchmark_;
+  // Created on the first kSimulateNetwork message.
+  std::unique_ptr<NetworkSimulation> network_simulation_;
+  // Created on the first kSoakTest message.
+  std::unique_ptr<SoakTest> soak_test_;
+  // Created on the first kBenchmarkEncoding message.
+  std::unique_ptr<EncodingBenchmark> encoding_benchmark_;
+  // Created on the first kReplayPacketCapture message.
+  std::unique_ptr<PacketCaptureReplay> packet_capture_replay_;
+  // Created on the first kBenchmarkSeek message.
+  std::unique_ptr<SeekBenchmark> seek_benchmark_;
+  // Created on the first kBenchmarkSwitch message.
+  std::unique_ptr<SwitchBenchmark> switch_benchmark_;
+  // Created on the first kBenchmarkDrm message.
+  std::unique_ptr<DrmBenchmark> drm_benchmark_;
+  // Benchmarks queued by kBenchmarkAll, each one started by the first
+  // function, the second one tells if it's still running.
+  std::deque<std::pair<std::function<void()>, std::function<bool()>>>
+      benchmark_queue_;
+  std::function<bool()> benchmark_running_;
+  uint32_t benchmarks_run_;
+  std::chrono::steady_clock::time_point benchmarks_started_;
+  pp::CompletionCallbackFactory<MessageReceiver> cc_factory_;
+  // Declared last, so it's joined before other members are destroyed.
+  pp::SimpleThread disposal_thread_;
 };
 
 }  // namespace Communication
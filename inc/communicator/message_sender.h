@@ -21,8 +21,15 @@
 #ifndef NATIVE_PLAYER_INC_COMMUNICATOR_MESSAGE_SENDER_H_
 #define NATIVE_PLAYER_INC_COMMUNICATOR_MESSAGE_SENDER_H_
 
+#include <chrono>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "ppapi/cpp/var_array.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/lock.h"
+
 #include "common.h"
 #include "nacl_player/common.h"
 #include "nacl_player/media_common.h"
@@ -32,11 +39,156 @@
 
 namespace Communication {
 
+/// Playback metrics sent in a <code>kMetrics</code> message.
+struct MetricsSnapshot {
+  uint32_t license_count;
+  /// License round trip percentiles, in milliseconds.
+  double license_p50;
+  double license_p95;
+  double license_p99;
+  double encrypted_packets_per_second;
+  uint64_t encrypted_packets;
+  uint64_t packet_allocations;
+  uint64_t storage_allocations;
+  uint64_t bytes_downloaded;
+  uint32_t segments_downloaded;
+  /// Segment downloads counted by download time, see <code>kMetrics</code>
+  /// for bounds of the buckets.
+  std::vector<uint32_t> download_time_histogram;
+  /// Estimated bandwidth, in bits per second.
+  double bandwidth;
+  /// Time buffered ahead of the playback position, in seconds.
+  double video_buffer;
+  double audio_buffer;
+  uint64_t video_buffered_bytes;
+  uint64_t audio_buffered_bytes;
+  uint64_t packets_appended;
+  uint64_t packets_dropped;
+  uint32_t seek_count;
+  /// Seek latencies, in milliseconds.
+  double seek_latency_average;
+  double seek_latency_max;
+  uint32_t rebuffer_count;
+  /// Time spent rebuffering, in seconds.
+  double rebuffer_duration;
+  /// Ids of the current representations, -1 if there is no such stream.
+  int32_t video_representation_id;
+  int32_t audio_representation_id;
+  /// CPU time used by demuxers, in seconds.
+  double demuxer_cpu_time;
+  /// CPU time of pipeline stages (see <code>CpuStage</code>), in
+  /// milliseconds per second of played media.
+  double download_cpu;
+  double demux_cpu;
+  double packets_cpu;
+  double drm_cpu;
+  /// Stalled pipeline stages which were recovered.
+  uint32_t stall_recoveries;
+  /// An id of the <code>TuningProfile</code> used by the playback.
+  int32_t tuning_profile;
+  /// Time of handling and sending messages on the main thread, in seconds.
+  double main_thread_time;
+  /// Time of posting logs to JS, in seconds.
+  double log_forwarding_time;
+  /// Frames in which the main thread budget was exceeded.
+  uint32_t frames_over_budget;
+  /// Messages and logs dropped or deferred because of the budget.
+  uint64_t shed_messages;
+  /// Memory held by pipelines of all players, in bytes.
+  uint64_t memory_usage;
+  /// A <code>MemoryPressure</code> level.
+  int32_t memory_pressure;
+  /// Errors reported by NaCl Player and the code of the last one, 0 if
+  /// there was none.
+  uint32_t player_errors;
+  int32_t last_player_error;
+  /// Buffering started by NaCl Player during playback, and the part of it
+  /// which started with video appended ahead of the playback position.
+  uint32_t platform_buffering;
+  uint32_t platform_underruns;
+  /// Intervals between time updates during playback and their standard
+  /// deviation, in milliseconds.
+  double time_update_interval;
+  double time_update_jitter;
+  uint32_t late_time_updates;
+  /// Video is limited below this bitrate, as the device didn't keep up with
+  /// it, 0 if it isn't.
+  uint32_t device_max_bitrate;
+  /// Latency percentiles of a pipeline stage, in milliseconds.
+  struct LatencyPercentiles {
+    double p50;
+    double p90;
+    double p99;
+  };
+  /// Segments measured through the whole pipeline, and latencies of its
+  /// stages, see <code>kMetrics</code>.
+  uint32_t pipeline_segments;
+  LatencyPercentiles request_latency;
+  LatencyPercentiles download_latency;
+  LatencyPercentiles first_packet_latency;
+  LatencyPercentiles parse_latency;
+  LatencyPercentiles append_latency;
+  LatencyPercentiles segment_latency;
+};
+
+/// A segment request sent in a <code>kSegmentDownloads</code> message.
+struct SegmentDownloadRecord {
+  std::string host;
+  std::string representation_id;
+  uint64_t bytes;
+  /// Milliseconds until response headers were received.
+  double open_time;
+  /// Milliseconds until the first part of the body was received.
+  double first_byte_time;
+  /// Milliseconds from response headers to the end of the body.
+  double body_time;
+  ResponseDiagnostics response;
+};
+
+/// A quality of experience event sent in a <code>kQoeEvent</code> message,
+/// with the state of the pipeline at its time.
+struct QoeEventData {
+  enum class Type {
+    kRebufferStart,
+    kRebufferEnd,
+    kError
+  };
+
+  Type type;
+  /// Milliseconds since the epoch.
+  double timestamp;
+  Samsung::NaClPlayer::TimeTicks playback_time;
+  /// Time buffered ahead of the playback position, in seconds.
+  double video_buffer;
+  double audio_buffer;
+  /// A duration of a rebuffer, in seconds.
+  double rebuffer_duration;
+  /// A <code>MediaPlayerError</code> code of an error.
+  int32_t error;
+  /// Ids of the current representations, -1 if there is no such stream.
+  int32_t video_representation_id;
+  int32_t audio_representation_id;
+  /// Segments requested and not demuxed yet.
+  uint32_t video_pending_segments;
+  uint32_t audio_pending_segments;
+  /// Bytes of demuxed packets which are not appended yet.
+  uint64_t video_queued_bytes;
+  uint64_t audio_queued_bytes;
+  uint32_t pending_licenses;
+};
+
 /// @class MessageSender
 /// @brief This class is designed to create and post messages from the player
 /// using the communication channel. Possible messages, which the player can
 /// send, are defined in <code>enum MessageFromPlayer</code>.
 ///
+/// Messages can be posted from any thread. They are collected and sent from
+/// the main thread about once a frame; when more than one message is pending,
+/// they are sent together in a <code>kMessages</code> message, so each tick
+/// costs a single post to the renderer. Time updates and buffer levels are
+/// throttled, only the latest ones are sent. High-frequency messages can be
+/// sent in a compact binary form, see <code>kSetBinaryMessages</code>.
+///
 /// @see Communication The description of <code>Communication</code> namespace
 ///   provides a brief of the communication mechanism.
 /// @see MessageFromPlayer
@@ -47,7 +199,7 @@ class MessageSender {
   ///
   /// @param[in] instance A pointer to a module which will be used for sending
   ///   messages.
-  explicit MessageSender(pp::Instance* instance) : instance_(instance) {}
+  explicit MessageSender(pp::Instance* instance);
 
   /// Destroys the <code>MessageSender</code> object.
   ~MessageSender() {}
@@ -65,15 +217,74 @@ class MessageSender {
   /// @see kTimeUpdate Main key value in the prepared message.
   void CurrentTimeUpdate(Samsung::NaClPlayer::TimeTicks time);
 
+  /// Sets how often time updates are sent at most.
+  ///
+  /// @param[in] interval A minimum interval in seconds between
+  ///   <code>kTimeUpdate</code> messages, 0 sends each update.
+  void SetTimeUpdateInterval(Samsung::NaClPlayer::TimeTicks interval);
+
+  /// Prepares and posts a message with how far the streams are buffered. It's
+  /// throttled along with time updates.
+  ///
+  /// @param[in] video_buffer Seconds of video buffered ahead.
+  /// @param[in] audio_buffer Seconds of audio buffered ahead.
+  /// @see kBufferLevel Main key value in the prepared message.
+  void BufferLevel(Samsung::NaClPlayer::TimeTicks video_buffer,
+                   Samsung::NaClPlayer::TimeTicks audio_buffer);
+
+  /// Prepares and posts a message with ranges buffered by each stage of
+  /// the pipeline. It's throttled along with time updates.
+  ///
+  /// @param[in] video Ranges of the video stream, empty without one.
+  /// @param[in] audio Ranges of the audio stream, empty without one.
+  /// @see kBufferedRanges Main key value in the prepared message.
+  void BufferedRanges(const StreamBufferedRanges& video,
+                      const StreamBufferedRanges& audio);
+
+  /// Prepares and posts a message with playback metrics.
+  ///
+  /// @param[in] metrics Current metrics values.
+  /// @see kMetrics Main key value in the prepared message.
+  void Metrics(const MetricsSnapshot& metrics);
+
+  /// Prepares and posts a message with recent segment requests.
+  ///
+  /// @param[in] downloads Requests completed since the previous message.
+  /// @see kSegmentDownloads Main key value in the prepared message.
+  void SegmentDownloads(const std::vector<SegmentDownloadRecord>& downloads);
+
+  /// Selects between dictionary and binary high-frequency messages.
+  ///
+  /// @param[in] enabled Whether binary messages should be sent.
+  /// @see kSetBinaryMessages
+  void SetBinaryMessages(bool enabled);
+
   /// Prepares and posts a message with the information that buffering has been
   /// finished, and playback is possible from this moment.
   ///
   /// @see kBufferingCompleted Main key value in the prepared message.
   void BufferingCompleted();
 
+  /// Prepares and posts a message with a progress of buffering.
+  ///
+  /// @param[in] percent A percentage of the data needed to play buffered.
+  /// @see kBufferingProgress Main key value in the prepared message.
+  void BufferingProgress(uint32_t percent);
+
+  /// Prepares and posts a message with a progress of storing content for
+  /// offline playback.
+  ///
+  /// @param[in] url An URL to the DASH manifest of the content.
+  /// @param[in] percent A percentage of segments stored.
+  /// @param[in] error 0, or an error code if the download failed.
+  /// @see kDownloadProgress Main key value in the prepared message.
+  void DownloadProgress(const std::string& url, uint32_t percent,
+                        int32_t error);
+
   /// Prepares and posts messages about all available audio stream
   /// representations from the provided array container. A separate message
-  /// will be sent for each representation.
+  /// is prepared for each representation, all of them reach JS in a single
+  /// <code>kMessages</code> message.
   ///
   /// @param[in] stream A vector with AudioStreams. Id, bitrate and
   ///   language are taken from those streams.
@@ -84,7 +295,8 @@ class MessageSender {
 
   /// Prepares and posts messages about all available video stream
   /// representations from a provided array container. A separate message
-  /// will be sent for each representation.
+  /// is prepared for each representation, all of them reach JS in a single
+  /// <code>kMessages</code> message.
   ///
   /// @param[in] stream A vector with VideoStreams. Id, bitrate and
   ///   resolution are taken from those streams.
@@ -103,14 +315,16 @@ class MessageSender {
   void ChangeRepresentation(StreamType stream_type, int32_t id);
 
   /// Prepares and posts a message with the subtitle which should be presented
-  /// for the given duration.
+  /// for the given duration. Subtitles shown within the same frame are
+  /// merged into one message, with texts in separate lines and the longest
+  /// duration, so dense subtitle tracks don't flood the UI.
   ///
   /// @param[in] duration A value indicating for how long the subtitle should
   ///   be presented from the current moment.
   /// @param[in] text A subtitle content.
   /// @see kSubtitles Main key value in the prepared message.
   void ShowSubtitles(Samsung::NaClPlayer::TimeTicks duration,
-                     const pp::Var& text);
+                     const std::string& text);
 
   /// Prepares and posts messages about all subtitles' track information from
   /// a provided container. A separate message will be sent for each track
@@ -128,14 +342,114 @@ class MessageSender {
   /// @see kStreamEnded Main key value in the prepared message.
   void StreamEnded();
 
+  /// Prepares and posts a message with the information that a closed player
+  /// has been destroyed.
+  ///
+  /// @see kPlayerClosed Main key value in the prepared message.
+  void PlayerClosed();
+
+  /// Prepares and posts a message with the information that a content
+  /// played from a URL is opened.
+  ///
+  /// @param[in] error An <code>ErrorCodes</code> value of opening it.
+  /// @see kMediaLoaded Main key value in the prepared message.
+  void MediaLoaded(int32_t error);
+
+  /// Prepares and posts a message with a thumbnail of a previewed position.
+  ///
+  /// @param[in] time The previewed position.
+  /// @param[in] url An URL of the image the thumbnail is a tile of.
+  /// @param[in] mime_type A MIME type of the image.
+  /// @param[in] image The image data.
+  /// @param[in] tile The thumbnail in pixels of the image.
+  /// @see kThumbnail Main key value in the prepared message.
+  void Thumbnail(Samsung::NaClPlayer::TimeTicks time, const std::string& url,
+                 const std::string& mime_type,
+                 const std::vector<uint8_t>& image,
+                 const Samsung::NaClPlayer::Rect& tile);
+
+  /// Prepares and posts a message about a quality of experience event.
+  ///
+  /// @param[in] event The event and the state of the pipeline.
+  /// @see kQoeEvent Main key value in the prepared message.
+  void QoeEvent(const QoeEventData& event);
+
+  /// Prepares and posts a message with durations of phases of a startup or
+  /// a seek.
+  ///
+  /// @param[in] operation A name of the measured operation.
+  /// @param[in] phases Names of phases with milliseconds elapsed since the
+  ///   operation was requested.
+  /// @see kLatencyReport Main key value in the prepared message.
+  void LatencyReport(const std::string& operation,
+      const std::vector<std::pair<std::string, double>>& phases);
+
+  /// Prepares and posts a message with exported trace events.
+  ///
+  /// @param[in] trace Trace events in Chrome trace event JSON format.
+  /// @see kTraceData Main key value in the prepared message.
+  void TraceData(const std::string& trace);
+
+  /// Prepares and posts a message with a result of a benchmark. Values are
+  /// also formatted as JSON lines records, one per value, with the git
+  /// revision the module was built from and the device model.
+  ///
+  /// @param[in] benchmark A name of the benchmark.
+  /// @param[in] values Measured values, keyed by names.
+  /// @see kBenchmarkResult Main key value in the prepared message.
+  void BenchmarkResult(const std::string& benchmark,
+      const std::vector<std::pair<std::string, double>>& values);
+
+  /// Sets a device model put in benchmark records, it's
+  /// <code>"unknown"</code> until it is set.
+  void SetDeviceModel(const std::string& model);
+
  private:
-  /// Send a provided message by the communication channel.
+  /// Queues a provided message to be sent by the communication channel.
   ///
   /// @param[in] message An object which holds message content.
   /// @see pp::Instance
-  inline void PostMessage(const pp::Var& message);
+  void PostMessage(const pp::Var& message);
+
+  /// Schedules sending queued messages, must be called under
+  /// <code>lock_</code>.
+  void ScheduleFlush(int32_t delay_ms);
+
+  /// Sends queued messages and a time update with a buffer level, if they're
+  /// due.
+  void FlushOnMainThread(int32_t);
+
+  /// Appends throttled messages to <code>pending_messages_</code>, must be
+  /// called under <code>lock_</code>.
+  void AppendPeriodicMessages();
+
+  /// Appends a message with subtitles merged by <code>ShowSubtitles()</code>
+  /// to <code>pending_messages_</code>, must be called under
+  /// <code>lock_</code>.
+  void AppendPendingSubtitles();
 
   pp::Instance* instance_;
+  pp::Lock lock_;
+  pp::VarArray pending_messages_;
+  bool has_pending_time_update_;
+  Samsung::NaClPlayer::TimeTicks pending_time_update_;
+  bool has_pending_buffer_level_;
+  Samsung::NaClPlayer::TimeTicks pending_video_buffer_;
+  Samsung::NaClPlayer::TimeTicks pending_audio_buffer_;
+  bool has_pending_buffered_ranges_;
+  StreamBufferedRanges pending_video_ranges_;
+  StreamBufferedRanges pending_audio_ranges_;
+  bool has_pending_subtitles_;
+  Samsung::NaClPlayer::TimeTicks pending_subtitles_duration_;
+  std::string pending_subtitles_text_;
+  std::chrono::steady_clock::time_point last_periodic_update_;
+  Samsung::NaClPlayer::TimeTicks time_update_interval_;
+  bool binary_messages_;
+  bool flush_scheduled_;
+  // Set when a flush was put off because of the main thread budget.
+  bool flush_deferred_;
+  std::string device_model_;
+  pp::CompletionCallbackFactory<MessageSender> cc_factory_;
 };
 
 }  // namespace Communication
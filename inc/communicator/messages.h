@@ -62,6 +62,28 @@ enum MessageToPlayer {
   ///   content with external subtitles this field must be filled.
   /// @param (string)kKeyEncoding [optional] A subtitles encoding code.
   ///   If this parameter is not specified then UTF-8 will be used .
+  /// @param (double)kKeyInitialBuffer [optional] Seconds of media the
+  ///   platform buffers before a <code>ClipTypeEnum::kUrl</code> content
+  ///   starts playing. Less starts sooner, more makes rebuffering less
+  ///   likely. The platform default is used if it's not specified.
+  /// @param (double)kKeyStartTime [optional] A position in seconds a
+  ///   <code>ClipTypeEnum::kDash</code> content starts playing at, e.g. to
+  ///   continue watching. Segments are downloaded from there right away, so
+  ///   it's faster than a <code>kSeek</code> after loading. Dynamic
+  ///   presentations ignore it.
+  /// @param (VarDictionary)kKeyTuning [optional] A tuning profile used by
+  ///   the player, numbers mapped by field names of
+  ///   <code>TuningProfile</code>: <code>id</code> (reported in
+  ///   <code>kMetrics</code>), <code>appendAhead</code>,
+  ///   <code>minAppendAhead</code>, <code>segmentAhead</code>,
+  ///   <code>languageSwitchAhead</code>, <code>analyzeDuration</code> (in
+  ///   seconds),
+  ///   <code>bufferUpdateInterval</code> (in milliseconds),
+  ///   <code>downloadBudget</code>, <code>audioProbeSize</code>,
+  ///   <code>videoProbeSize</code>, <code>downloadBufferSize</code> and
+  ///   <code>downloadChunkSize</code> (in bytes). Fields which are missing
+  ///   or out of range keep their defaults; the defaults are used if the
+  ///   profile is not specified or inconsistent.
   /// @see Communication::ClipTypeEnum
   kLoadMedia = 1,
 
@@ -80,7 +102,8 @@ enum MessageToPlayer {
   ///   <code>Video = 0</code> or an <code>Audio = 1</code> stream needs
   ///   to be changed.
   /// @param (int)kKeyId An index of a stream representation which should
-  ///   be used.
+  ///   be used. It disables automatic representation selection of the
+  ///   stream, -1 enables it again.
   kChangeRepresentation = 5,
 
   /// A request to change subtitles representation to a defined one.
@@ -102,11 +125,312 @@ enum MessageToPlayer {
   /// @param (int)kKeyHeight A height of the players window.
   kChangeViewRect = 9,
 
+  /// An information about a position the user is about to seek to, e.g.
+  /// while seeking with FF/RW keys or hovering over the seek bar. Data at
+  /// this position is downloaded in advance, so a following
+  /// <code>kSeek</code> to it completes faster.
+  /// @param (double)kKeyTime A candidate playback position.
+  kSeekPreview = 10,
+
+  /// A request to fast forward or rewind in a trick mode, which shows only
+  /// keyframes and doesn't play audio.
+  /// @param (double)kKeyRate A playback rate, e.g. 8 moves 8 times faster
+  ///   than a normal playback and -8 moves backwards at the same speed.
+  ///   1 returns to a normal playback at the current trick mode position.
+  ///   Rates from 0.5 to 2 play continuously with audio on platforms which
+  ///   support it, buffering that much more media ahead.
+  kSetPlaybackRate = 11,
+
+  /// A request to prepare content which is likely to be loaded next, e.g.
+  /// the next episode, while the current one plays. Its manifest,
+  /// initialization segments and first media segments are downloaded in
+  /// the background, so a following <code>kLoadMedia</code> of the same
+  /// URL starts faster.
+  /// @param (int)kKeyType A kind of the content, only
+  ///   <code>ClipTypeEnum::kDash</code> can be preloaded.
+  /// @param (string)kKeyUrl An URL to the content container, the same as
+  ///   it will be passed to <code>kLoadMedia</code>.
+  kPreloadMedia = 12,
+
+  /// A request to play the given DASH content right after the currently
+  /// loaded one, without stopping the playback between them. Both contents
+  /// have to be static presentations.
+  /// @param (string)kKeyUrl An URL to the DASH manifest of the content.
+  kEnqueueMedia = 13,
+
+  /// A request to change how often <code>kTimeUpdate</code> messages are
+  /// sent. By default they are sent at most every 0.25 s.
+  /// @param (double)kKeyDuration A minimum interval between time updates in
+  ///   seconds, 0 sends each update.
+  kSetTimeUpdateInterval = 14,
+
+  /// A request to send high-frequency messages (<code>kTimeUpdate</code>,
+  /// <code>kBufferLevel</code> and <code>kMetrics</code>) as
+  /// <code>ArrayBuffer</code>s instead of dictionaries. Initially disabled.
+  /// A binary message starts with a 32-bit message type followed by its
+  /// fields, all little-endian, in the order listed below (u32 is a 32-bit
+  /// unsigned integer, f64 is a double):
+  ///   - <code>kTimeUpdate</code>: f64 time.
+  ///   - <code>kBufferLevel</code>: f64 video buffer, f64 audio buffer.
+  ///   - <code>kBufferedRanges</code>: f64 start and end of appended, queued
+  ///     and downloaded ranges of video, then the same of audio.
+  ///   - <code>kMetrics</code>: u32 license count, f64 values in the order
+  ///     listed at <code>kMetrics</code> (from <code>licenseP50</code> to
+  ///     <code>segmentLatencyP99</code>), u32 number of download time buckets
+  ///     and u32 count of each bucket.
+  /// @param (bool)kKeyEnabled Whether binary messages should be used.
+  kSetBinaryMessages = 15,
+
+  /// A request to send a <code>kMetrics</code> message now. By default
+  /// metrics are also sent every second during playback.
+  /// @param (double)kKeyDuration [optional] An interval of sending metrics
+  ///   during playback in seconds, 0 stops sending them periodically.
+  kGetMetrics = 16,
+
+  /// A request to set a scheduling priority, and optionally a CPU, of
+  /// pipeline threads of the given role, e.g. so the audio demuxer isn't
+  /// starved when UI loads the CPU. Settings apply to threads started
+  /// afterwards, so they should be sent before <code>kLoadMedia</code>;
+  /// download workers are shared by players and started with the first one.
+  /// They are applied only where the platform supports it.
+  /// @param (string)kKeyRole A role of threads: <code>"audioDemuxer"</code>,
+  ///   <code>"videoDemuxer"</code>, <code>"appendScheduler"</code> (the
+  ///   player thread) or <code>"download"</code> (network workers).
+  /// @param (int)kKeyPriority A nice value, from -20 (scheduled first) to
+  ///   19. Values below 0 usually need privileges, so less important roles
+  ///   should get higher values instead.
+  /// @param (int)kKeyCpu [optional] An index of a CPU the threads should
+  ///   run on, -1 or no value lets them run on any.
+  /// @see ThreadConfig
+  kSetThreadPriority = 17,
+
+  /// A request to set a budget of main thread work per UI frame: handling
+  /// and sending messages and forwarding logs. While work in a frame exceeds
+  /// it, logs other than errors are not sent to JS, metrics are skipped and
+  /// other messages are sent with ones of the next frame. Initially 0.004 s.
+  /// @param (double)kKeyDuration A time of work allowed per frame in
+  ///   seconds, 0 disables the budget.
+  /// @see MainThreadBudget
+  kSetMainThreadBudget = 18,
+
+  /// A request to set a budget of memory held by the playback pipeline:
+  /// downloaded segments, demuxer buffers, buffered packets, segment caches
+  /// and manifests. From 3/4 of it prefetch, caches and buffer targets are
+  /// reduced. Initially 192 MiB, which fits TVs with 1.5 GB of RAM.
+  /// @param (double)kKeyBytes A budget in bytes.
+  /// @see MemoryGovernor
+  kSetMemoryBudget = 19,
+
+  /// A low memory signal of the platform, which the application forwards,
+  /// e.g. from a <code>tizen.systeminfo</code> "MEMORY" property listener.
+  /// Memory is reduced as if the budget was exceeded, until the level is
+  /// set back to <code>"none"</code>.
+  /// @param (string)kKeyPressure <code>"none"</code>,
+  ///   <code>"moderate"</code> or <code>"critical"</code>.
+  /// @see MemoryGovernor
+  kSetMemoryPressure = 20,
+
+  /// Informs the player whether the application is visible, e.g. from
+  /// a <code>visibilitychange</code> event. A hidden player is paused and
+  /// its buffers are trimmed, a visible one resumes playback if it was
+  /// playing when it got hidden. The state of a hidden DASH playback is
+  /// kept, so if the application is suspended and loads the same content
+  /// when it returns, the playback continues from the same position
+  /// without loading the manifest again.
+  /// @param (bool)kKeyVisible Whether the application is visible.
+  kSetVisibility = 21,
+
+  /// A request to keep DASH content the user can switch to quickly warm,
+  /// e.g. live channels next to the current one in an EPG. Their manifests
+  /// and initialization segments are downloaded in the background and
+  /// manifests of live content are refreshed, so a following
+  /// <code>kLoadMedia</code> of one of them starts at the live edge faster.
+  /// It's independent of <code>kPreloadMedia</code>.
+  /// @param (array)kKeyUrls URLs to DASH manifests, the most likely ones
+  ///   first. Only the first four are kept warm, an empty array drops all
+  ///   of them.
+  kSetWarmMedia = 22,
+
+  /// A request to download DASH content for playback without a network.
+  /// Its segments are stored in a persistent storage in the background, a
+  /// stopped download continues when it's requested again. A following
+  /// <code>kLoadMedia</code> of the same URL plays the stored content, its
+  /// DRM licenses are kept for offline playbacks. Progress is reported with
+  /// <code>kDownloadProgress</code> messages.
+  /// @param (string)kKeyUrl An URL to the DASH manifest.
+  /// @param (int)kKeyBitrate [optional] The highest video bitrate stored,
+  ///   in bits per second. When it's omitted, the highest one is stored.
+  kDownloadMedia = 23,
+
+  /// A request to play only the audio of the current content, e.g. for
+  /// music channels or a player in the background. Video segments are not
+  /// downloaded nor demuxed then. When video is enabled again, playback
+  /// seeks to the current position, so video catches up with audio.
+  /// @param (bool)kKeyEnabled Whether only audio should be played.
+  kSetAudioOnly = 24,
+
+  /// Describes what the device can play, e.g. from
+  /// <code>webapis.productinfo</code> and an <code>avinfo</code> query.
+  /// Representations exceeding it are left out of manifests loaded
+  /// afterwards, so they are neither downloaded nor chosen by adaptation.
+  /// If no representation of an adaptation set fits, all of them are kept.
+  /// Omitted limits don't prune anything.
+  /// @param (int)kKeyWidth [optional] The largest video width.
+  /// @param (int)kKeyHeight [optional] The largest video height.
+  /// @param (int)kKeyChannels [optional] The most audio channels.
+  /// @param (bool)kKeyHdr [optional] Whether HDR video can be presented.
+  /// @param (array)kKeyCodecs [optional] Supported sample entries, e.g.
+  ///   <code>["avc1", "hev1", "mp4a"]</code>.
+  /// @see DeviceCapabilities
+  kSetDeviceCapabilities = 25,
+
   /// Set a log level.
-  /// @param (int)New log level. A value from the LogLevel enum.
+  /// @param (int)kKeyLogLevel New log level. A value from the LogLevel enum.
+  /// @param (string)kKeyLogCategory [optional] A name of a log category,
+  ///   e.g. <code>"demuxer"</code>, which logs are limited to the level.
+  ///   When it's omitted, the level of logs sent to JS is set.
   /// @see logger.h
   /// @see enum class LogLevel
   kSetLogLevel = 90,
+
+  /// A request to start collecting trace events; no additional parameters.
+  /// Events collected before are dropped.
+  kStartTracing = 91,
+
+  /// A request to stop collecting trace events and send them in a
+  /// <code>kTraceData</code> message; no additional parameters.
+  kExportTrace = 92,
+
+  /// A request to measure demuxer throughput on recorded content. Segments
+  /// are downloaded first, then only demuxing is measured. The result is
+  /// sent in a <code>kBenchmarkResult</code> message.
+  /// @param (int)kKeyType A <code>StreamType</code> of the content.
+  /// @param (string)kKeyUrl An URL of the initialization segment.
+  /// @param (array)kKeyUrls URLs of media segments, in order.
+  /// @param (string)kKeyDemuxer [optional] <code>ffmpeg</code> to test
+  ///   <code>FFMpegDemuxer</code>, otherwise the default demuxer is used.
+  kBenchmarkDemuxer = 93,
+
+  /// A request to measure <code>PacketsManager</code> with synthetic audio
+  /// and video packets, without NaCl Player. A few scenarios (frame rates,
+  /// buffer depths, seeks and configuration changes) are run, each result
+  /// is sent in a <code>kBenchmarkResult</code> message.
+  kBenchmarkPacketsManager = 94,
+
+  /// A request to measure the manifest layer on a corpus of generated
+  /// manifests (small VOD, multi-language, live DVR with a long
+  /// SegmentTimeline and SegmentBase with a large sidx), served from
+  /// memory. Each result is sent in a <code>kBenchmarkResult</code> message.
+  kBenchmarkManifest = 95,
+
+  /// A request to replay network traces against the download and adaptive
+  /// bitrate logic in a simulated time, with segments of the given
+  /// manifest. Each result is sent in a <code>kBenchmarkResult</code>
+  /// message.
+  /// @param (string)kKeyUrl An URL to the DASH manifest of the content.
+  /// @param (dictionary)kKeyTraces [optional] Traces keyed by names, each
+  ///   an array of <code>[seconds, bitsPerSecond, latencySeconds]</code>
+  ///   points. Built-in traces are used if it's missing.
+  kSimulateNetwork = 96,
+
+  /// A request to run a soak test, which loops loading, playing, seeking,
+  /// changing representations and closing the player, and samples heap
+  /// usage, threads, URL loaders and live packets after each cycle. Each
+  /// sample and the final result are sent in <code>kBenchmarkResult</code>
+  /// messages. It replaces the current player.
+  /// @param (int)kKeyType A kind of the content, as in
+  ///   <code>kLoadMedia</code>.
+  /// @param (string)kKeyUrl An URL to the content container.
+  /// @param (double)kKeyDuration How long the test lasts in seconds, 0 stops
+  ///   a running test.
+  /// @param (double)kKeyTime [optional] Seeks are made to random positions
+  ///   below this time, 60 seconds by default.
+  kSoakTest = 97,
+
+  /// A request for heap allocation counters of pipeline stages, collected
+  /// in builds with <code>ALLOCATION_TRACKING</code> defined. Counters of
+  /// each stage and the most frequent sampled call sites are sent in
+  /// <code>kBenchmarkResult</code> messages.
+  /// @param (string)kKeyOperation [optional] <code>"reset"</code> clears
+  ///   counters after they are sent, so the next request covers only what
+  ///   happened in between.
+  kGetAllocationStats = 98,
+
+  /// A request to benchmark <code>Base64Decode()</code> and
+  /// <code>ToHexString()</code> with data of a few sizes. Each result is
+  /// sent in a <code>kBenchmarkResult</code> message.
+  kBenchmarkEncoding = 99,
+
+  /// A request to run benchmarks one after another, so lab devices can
+  /// track results over time: encoding, <code>PacketsManager</code>,
+  /// manifest and DRM benchmarks always, demuxer benchmarks (the default
+  /// demuxer and FFmpeg), a network simulation, seek and switch benchmarks
+  /// when their content is given.
+  /// Each result is sent in a <code>kBenchmarkResult</code> message,
+  /// <code>all/done</code> is sent at the end.
+  /// @param (string)kKeyDevice [optional] A device model put in benchmark
+  ///   records.
+  /// @param (int)kKeyType [optional] A <code>StreamType</code> of the
+  ///   demuxer benchmark content.
+  /// @param (string)kKeyUrl [optional] An URL of the initialization segment
+  ///   of the demuxer benchmark content.
+  /// @param (array)kKeyUrls [optional] URLs of its media segments.
+  /// @param (string)kKeyManifest [optional] An URL of the DASH manifest for
+  ///   a network simulation with built-in traces, seek, switch and DRM
+  ///   benchmarks.
+  kBenchmarkAll = 100,
+
+  /// A request to send CPU time used by each pipeline stage (see
+  /// <code>CpuProfiler</code>). Each stage is sent in a
+  /// <code>kBenchmarkResult</code> message named <code>cpu/stage</code>
+  /// with <code>cpuTime</code> (in seconds) and <code>samples</code>.
+  /// @param (double)kKeyDuration [optional] Starts sampling stages of
+  ///   threads with this interval in seconds, 0 stops it.
+  kGetCpuStats = 101,
+
+  /// A request to start recording what <code>PacketsManager</code> gets
+  /// (configs, packets and calls of the player) to a file, see
+  /// <code>PacketCapture</code>. A capture in progress is stopped first.
+  /// @param (string)kKeyUrl [optional] A path of the file in the nacl_io
+  ///   file system, a file in the temporary storage by default.
+  /// @param (bool)kKeyData [optional] Whether packet payloads are recorded,
+  ///   only their sizes are by default.
+  kStartPacketCapture = 102,
+
+  /// A request to stop recording packets; no additional parameters. What
+  /// was recorded is sent in a <code>kBenchmarkResult</code> message.
+  kStopPacketCapture = 103,
+
+  /// A request to feed a packet capture into a separate
+  /// <code>PacketsManager</code>, without NaCl Player. The result is sent in
+  /// a <code>kBenchmarkResult</code> message.
+  /// @param (string)kKeyUrl [optional] A path of the capture, the default
+  ///   one of <code>kStartPacketCapture</code> if it's not given.
+  /// @param (double)kKeyRate [optional] 0 to replay as fast as possible,
+  ///   calls are replayed at their original pace otherwise.
+  kReplayPacketCapture = 104,
+
+  /// A request to measure seek latency of the pipeline without NaCl Player,
+  /// with segments of the given manifests replayed over a simulated link.
+  /// Results are sent per content type and scenario in
+  /// <code>kBenchmarkResult</code> messages once all manifests are done.
+  /// @param (array)kKeyUrls URLs of DASH manifests of static content.
+  kBenchmarkSeek = 105,
+
+  /// A request to measure representation switches of the pipeline without
+  /// NaCl Player, with segments of the given manifests replayed over a
+  /// simulated link. Results are sent per scenario and direction in
+  /// <code>kBenchmarkResult</code> messages once all manifests are done.
+  /// @param (array)kKeyUrls URLs of DASH manifests of static content.
+  kBenchmarkSwitch = 106,
+
+  /// A request to measure the DRM pipeline without NaCl Player or a license
+  /// server: license round trips of a <code>DrmPlayReadyListener</code>
+  /// served from memory and, with a manifest, appends of encrypted packets.
+  /// The result is sent in a <code>kBenchmarkResult</code> message.
+  /// @param (string)kKeyUrl [optional] An URL to the DASH manifest of static
+  ///   PlayReady content.
+  kBenchmarkDrm = 107,
 };
 
 /// @enum MessageFromPlayer
@@ -182,6 +506,310 @@ enum MessageFromPlayer {
   /// An information from the player that stream has finished;
   /// no additional parameters.
   kStreamEnded = 108,
+
+  /// An information from the player how long phases of a startup or a seek
+  /// took, sent when the operation is finished.
+  /// @param (string)kKeyOperation <code>"startup"</code>,
+  ///   <code>"seek"</code> or <code>"urlStartup"</code> (opening a URL
+  ///   played by <code>UrlPlayerController</code>).
+  /// @param (dictionary)kKeyPhases Milliseconds elapsed from the request
+  ///   until each phase which happened, e.g. <code>manifestParsed</code> or
+  ///   <code>firstPacketAppended</code>, keyed by phase names.
+  kLatencyReport = 109,
+
+  /// Trace events requested by <code>kExportTrace</code>.
+  /// @param (string)kKeyTrace Events in Chrome trace event JSON format,
+  ///   which can be loaded in <code>about:tracing</code>.
+  kTraceData = 110,
+
+  /// Messages posted by the player within one tick, sent together to limit
+  /// the number of posts to the renderer. A single message is sent as is.
+  /// @param (array)kKeyMessages Dictionaries of the messages, in order.
+  kMessages = 111,
+
+  /// Seconds of content buffered ahead of the playback position, sent along
+  /// with time updates.
+  /// @param (double)kKeyVideoBuffer Video buffered ahead, in seconds.
+  /// @param (double)kKeyAudioBuffer Audio buffered ahead, in seconds.
+  kBufferLevel = 112,
+
+  /// A snapshot of playback metrics, sent every second while playing.
+  /// @param (dictionary)kKeyMetrics Metric values keyed by names:
+  ///   <code>licenseCount</code> (license requests), <code>licenseP50</code>,
+  ///   <code>licenseP95</code>, <code>licenseP99</code> (license round
+  ///   trips in milliseconds), <code>encryptedPacketsPerSecond</code>,
+  ///   <code>encryptedPackets</code>, <code>packetAllocations</code>,
+  ///   <code>storageAllocations</code>, <code>bytesDownloaded</code>,
+  ///   <code>segmentsDownloaded</code>, <code>bandwidth</code> (estimate in
+  ///   bits per second), <code>videoBuffer</code>, <code>audioBuffer</code>
+  ///   (seconds buffered ahead), <code>videoBufferedBytes</code>,
+  ///   <code>audioBufferedBytes</code>, <code>packetsAppended</code>,
+  ///   <code>packetsDropped</code>, <code>seekCount</code>,
+  ///   <code>seekLatencyAverage</code>, <code>seekLatencyMax</code> (in
+  ///   milliseconds), <code>rebufferCount</code>,
+  ///   <code>rebufferDuration</code> (in seconds),
+  ///   <code>videoRepresentation</code>, <code>audioRepresentation</code>
+  ///   (ids, -1 without such stream), <code>demuxerCpuTime</code>,
+  ///   <code>mainThreadTime</code> (handling and sending messages),
+  ///   <code>logForwardingTime</code> (all in seconds),
+  ///   <code>framesOverBudget</code>, <code>shedMessages</code> (see
+  ///   <code>kSetMainThreadBudget</code>), <code>memoryUsage</code> (bytes
+  ///   held by the pipelines of all players), <code>memoryPressure</code>
+  ///   (0 none, 1 moderate, 2 critical, see <code>kSetMemoryBudget</code>),
+  ///   <code>downloadCpu</code>, <code>demuxCpu</code>,
+  ///   <code>packetsCpu</code>, <code>drmCpu</code> (CPU time of pipeline
+  ///   stages in milliseconds per second of played media, see
+  ///   <code>CpuProfiler</code>), <code>stallRecoveries</code> (stalled
+  ///   pipeline stages which were recovered), <code>tuningProfile</code>
+  ///   (an id of the profile passed to <code>kLoadMedia</code>),
+  ///   <code>playerErrors</code>, <code>lastPlayerError</code> (errors
+  ///   reported by NaCl Player and the last code),
+  ///   <code>platformBuffering</code>, <code>platformUnderruns</code>
+  ///   (buffering during playback, and the part of it with video appended
+  ///   ahead, i.e. caused by the device), <code>timeUpdateInterval</code>,
+  ///   <code>timeUpdateJitter</code> (mean and deviation of time update
+  ///   intervals in milliseconds), <code>lateTimeUpdates</code>,
+  ///   <code>deviceMaxBitrate</code> (video is limited below it, as the
+  ///   device didn't keep up with it, 0 if it isn't),
+  ///   <code>pipelineSegments</code> (segments measured from the request
+  ///   to the last appended packet), <code>requestLatencyP50</code>,
+  ///   <code>P90</code>, <code>P99</code> (from the request of a segment to
+  ///   its first byte), <code>downloadLatencyP50</code>... (from its first
+  ///   to its last byte), <code>firstPacketLatencyP50</code>... (from its
+  ///   first byte to its first packet demuxed),
+  ///   <code>parseLatencyP50</code>... (from passing it to the demuxer to
+  ///   its last packet demuxed), <code>appendLatencyP50</code>... (from its
+  ///   last packet demuxed to appended) and
+  ///   <code>segmentLatencyP50</code>... (from the request to the last
+  ///   packet appended), all in milliseconds, with three values for each
+  ///   stage in that order, and
+  ///   <code>downloadTimeHistogram</code>, an array of segment download
+  ///   counts taking up to 250, 500, 1000, 2000, 4000 ms and longer.
+  ///   Counters are reset when a content is loaded.
+  kMetrics = 113,
+
+  /// An information from the player that a player closed by
+  /// <code>kClosePlayer</code> (or replaced by <code>kLoadMedia</code>) is
+  /// destroyed and its resources are freed; no additional parameters.
+  kPlayerClosed = 114,
+
+  /// A quality of experience event: a rebuffer started or ended, or the
+  /// player reported an error. It carries the state of the pipeline at the
+  /// moment of the event, so stalls can be attributed to the network,
+  /// demuxing or DRM.
+  /// @param (string)kKeyEvent <code>rebufferStart</code>,
+  ///   <code>rebufferEnd</code> or <code>error</code>.
+  /// @param (double)kKeyTimestamp Time of the event, in milliseconds since
+  ///   the epoch.
+  /// @param (double)kKeyTime A playback position.
+  /// @param (double)kKeyVideoBuffer Video buffered ahead, in seconds.
+  /// @param (double)kKeyAudioBuffer Audio buffered ahead, in seconds.
+  /// @param (double)kKeyDuration [optional] A duration of the rebuffer in
+  ///   seconds, sent with <code>rebufferEnd</code>.
+  /// @param (int)kKeyError [optional] A <code>MediaPlayerError</code> code,
+  ///   sent with <code>error</code>.
+  /// @param (dictionary)kKeyState Values keyed by names:
+  ///   <code>videoRepresentation</code>, <code>audioRepresentation</code>
+  ///   (ids, -1 without such stream), <code>videoPendingSegments</code>,
+  ///   <code>audioPendingSegments</code> (segments requested and not
+  ///   demuxed yet), <code>videoQueuedBytes</code>,
+  ///   <code>audioQueuedBytes</code> (demuxed packets not appended yet) and
+  ///   <code>pendingLicenses</code> (license requests in progress).
+  kQoeEvent = 115,
+
+  /// A result of a benchmark.
+  /// @param (string)kKeyBenchmark A name of the benchmark:
+  ///   <code>demuxer/</code> followed by a name of the tested demuxer, or
+  ///   <code>packetsManager/</code> followed by a name of the scenario, or
+  ///   <code>manifest/</code> followed by a name of the manifest, or
+  ///   <code>network/</code> followed by a name of the trace, or
+  ///   <code>soak/sample</code> and <code>soak/result</code>, or
+  ///   <code>allocations/</code> followed by a name of the stage, or
+  ///   <code>encoding/</code> followed by a function and a size, or
+  ///   <code>seek/</code> followed by a content type and a scenario, or
+  ///   <code>switch/</code> followed by a scenario and a direction, or
+  ///   <code>drm/playready</code>, or <code>all/done</code>.
+  /// @param (dictionary)kKeyMetrics Values keyed by names.
+  /// @param (string)kKeyRecords The values as JSON lines, one record per
+  ///   value with <code>sha</code> (a git revision of the module),
+  ///   <code>device</code>, <code>benchmark</code>, <code>metric</code>,
+  ///   <code>value</code> and <code>timestamp</code> (in seconds since the
+  ///   epoch) fields.
+  ///
+  /// Values of a <code>kBenchmarkDemuxer</code> request: <code>ok</code>
+  ///   (1 if the benchmark completed), <code>packets</code>,
+  ///   <code>bytes</code>, <code>seconds</code>,
+  ///   <code>packetsPerSecond</code>, <code>megabytesPerSecond</code>,
+  ///   <code>latencyP50</code>, <code>latencyP95</code>,
+  ///   <code>latencyMax</code> (from a <code>Parse()</code> call to a packet
+  ///   callback in milliseconds), <code>allocationsPerPacket</code> and
+  ///   <code>peakHeapBytes</code>.
+  ///
+  /// Values of a <code>kBenchmarkPacketsManager</code> request:
+  ///   <code>packets</code>, <code>appended</code>, <code>seconds</code>,
+  ///   <code>deliverNsPerPacket</code> and <code>updateNsPerPacket</code>
+  ///   (time spent in <code>OnEsPacket(s)()</code> and
+  ///   <code>UpdateBuffer()</code>), <code>deliverP50Us</code>,
+  ///   <code>deliverP99Us</code>, <code>deliverMaxUs</code>,
+  ///   <code>updateP50Us</code>, <code>updateP99Us</code>,
+  ///   <code>updateMaxUs</code> (durations of single calls, including
+  ///   waiting for the packets lock), <code>seeks</code> and
+  ///   <code>seekMaxUs</code>.
+  ///
+  /// Values of a <code>kBenchmarkManifest</code> request: <code>ok</code>,
+  ///   <code>mpdBytes</code>, <code>representations</code>,
+  ///   <code>parseMs</code> (<code>DashManifest::ParseMPD()</code>),
+  ///   <code>getStreamsUs</code>, <code>createSequenceUs</code> (per
+  ///   representation), <code>firstLookupMs</code> (including a segment
+  ///   index load), <code>lookupNs</code> (random
+  ///   <code>MediaSegmentForTime()</code> calls), <code>segments</code> and
+  ///   <code>walkNsPerSegment</code> (an iterator walk of a video sequence).
+  ///
+  /// Values of a <code>kSimulateNetwork</code> request: <code>ok</code>
+  ///   (1 if playback finished), <code>startupTime</code>,
+  ///   <code>rebufferRatio</code> (part of the time after startup spent
+  ///   waiting for data), <code>rebuffers</code>,
+  ///   <code>averageBitrate</code> (of video), <code>switches</code>,
+  ///   <code>switchesPerMinute</code> (of played content),
+  ///   <code>oscillations</code> (switches reverting the previous one
+  ///   within 10 seconds), <code>playedTime</code> and
+  ///   <code>simulatedTime</code>.
+  ///
+  /// Values of a <code>kSoakTest</code> sample: <code>cycle</code>,
+  ///   <code>elapsed</code> (seconds), <code>heapBytes</code>,
+  ///   <code>threads</code>, <code>urlLoaders</code> and
+  ///   <code>livePackets</code>. The result has <code>ok</code>,
+  ///   <code>cycles</code>, <code>baselineHeapBytes</code>,
+  ///   <code>lastHeapBytes</code>, <code>peakHeapBytes</code> and
+  ///   <code>heapDrift</code>, <code>threadDrift</code>,
+  ///   <code>urlLoaderDrift</code>, <code>packetDrift</code> (1 for values
+  ///   which stayed above the first cycle).
+  ///
+  /// Values of a <code>kGetAllocationStats</code> request, named
+  ///   <code>"allocations/&lt;stage&gt;"</code>: <code>allocations</code>,
+  ///   <code>bytes</code>, <code>segments</code>, <code>packets</code>,
+  ///   <code>perSegment</code> and <code>perPacket</code> (allocations per
+  ///   unit of work, 0 if the stage didn't count any). Values of
+  ///   <code>"allocations/callSites"</code> are numbers of samples keyed by
+  ///   hexadecimal return addresses, which can be symbolized with addr2line.
+  ///   Only <code>"allocations/disabled"</code> is sent by builds without
+  ///   tracking.
+  ///
+  /// Values of a <code>kBenchmarkEncoding</code> request, named
+  ///   <code>"encoding/&lt;function&gt;/&lt;bytes&gt;"</code>:
+  ///   <code>bytes</code>, <code>iterations</code>, <code>nsPerByte</code>
+  ///   and <code>mbPerSecond</code>.
+  ///
+  /// Values of <code>all/done</code>: <code>benchmarks</code> (a number of
+  ///   benchmarks run by a <code>kBenchmarkAll</code> request) and
+  ///   <code>seconds</code>.
+  ///
+  /// Values of a <code>kStopPacketCapture</code> request, named
+  ///   <code>capture/stopped</code>: <code>records</code> and
+  ///   <code>bytes</code>.
+  ///
+  /// Values of a <code>kReplayPacketCapture</code> request, named
+  ///   <code>capture/replay</code>: <code>ok</code>, <code>records</code>,
+  ///   <code>packets</code>, <code>appended</code>,
+  ///   <code>appendedBytes</code>, <code>seconds</code>,
+  ///   <code>capturedSeconds</code>, <code>deliverNsPerPacket</code>,
+  ///   <code>updateNsPerPacket</code>, <code>updateMaxUs</code> and
+  ///   <code>appendedMbPerSecond</code>.
+  ///
+  /// Values of a <code>kBenchmarkSeek</code> request, named
+  ///   <code>"seek/&lt;addressing&gt;/&lt;clear|encrypted&gt;/&lt;scenario
+  ///   &gt;"</code>: <code>contents</code>, <code>seeks</code>,
+  ///   <code>timeouts</code>, <code>cacheMisses</code> (real downloads
+  ///   during measured seeks), <code>keyframeP50</code>,
+  ///   <code>keyframeP90</code>, <code>keyframeMax</code> (to the first
+  ///   keyframe appended after a seek, in milliseconds),
+  ///   <code>audioP50</code>, <code>audioP90</code>, <code>audioMax</code>
+  ///   (to the first audio packet) and <code>keyframeProcessingP50</code>
+  ///   (without the simulated network).
+  ///
+  /// Values of a <code>kBenchmarkSwitch</code> request, named
+  ///   <code>"switch/&lt;keepBuffered|replaceBuffered&gt;/&lt;up|down&gt;
+  ///   "</code>: <code>contents</code>, <code>switches</code>,
+  ///   <code>timeouts</code>, <code>latencyP50</code>,
+  ///   <code>latencyP90</code>, <code>latencyMax</code> (to the first
+  ///   packet of the new representation appended, in milliseconds),
+  ///   <code>wastedBytesPerSwitch</code> (segments dropped or downloaded
+  ///   again) and <code>decoderReinitsPerSwitch</code>.
+  ///
+  /// Values of a <code>kBenchmarkDrm</code> request, named
+  ///   <code>drm/playready</code>: <code>ok</code>, <code>licenses</code>,
+  ///   <code>licenseP50</code>, <code>licenseP95</code>,
+  ///   <code>licenseP99</code> (round trips in milliseconds),
+  ///   <code>encryptedPackets</code>,
+  ///   <code>encryptedPacketsPerSecond</code> (per second of appending
+  ///   them), <code>packetAllocations</code> and
+  ///   <code>storageAllocations</code> (heap allocations of packets during
+  ///   the benchmark).
+  kBenchmarkResult = 116,
+
+  /// An information from the player that a content played from a URL is
+  /// opened, so its duration and text tracks are sent already. Commands
+  /// received while it was opened are performed afterwards.
+  /// @param (int)kKeyError An <code>ErrorCodes</code> value of attaching
+  ///   the data source, 0 when the content can be played.
+  kMediaLoaded = 117,
+
+  /// A thumbnail of a position previewed with a
+  /// <code>MessageToPlayer::kSeekPreview</code> message, sent if the DASH
+  /// content has an image adaptation set. It's a tile of an image, the
+  /// whole image is passed, so thumbnails of the same image have the same
+  /// <code>kKeyUrl</code> value.
+  /// @param (double)kKeyTime The previewed position in seconds.
+  /// @param (string)kKeyUrl An URL of the image.
+  /// @param (string)kKeyMimeType A MIME type of the image.
+  /// @param (ArrayBuffer)kKeyData The image data.
+  /// @param (int)kKeyXCoordination A horizontal position of the tile in
+  ///   pixels of the image.
+  /// @param (int)kKeyYCoordination A vertical position of the tile.
+  /// @param (int)kKeyWidth A width of the tile.
+  /// @param (int)kKeyHeight A height of the tile.
+  kThumbnail = 118,
+
+  /// An information how much of the data needed to start or resume the
+  /// playback is buffered, sent while a <code>ClipTypeEnum::kUrl</code>
+  /// content buffers. It's followed by <code>kBufferingCompleted</code>.
+  /// @param (int)kKeyPercent A percentage of the data buffered.
+  kBufferingProgress = 119,
+
+  /// A progress of a download requested with
+  /// <code>MessageToPlayer::kDownloadMedia</code>, sent as segments are
+  /// stored and when the download finishes.
+  /// @param (string)kKeyUrl An URL to the DASH manifest.
+  /// @param (int)kKeyPercent A percentage of segments stored.
+  /// @param (int)kKeyError 0, or an error code if the download failed.
+  kDownloadProgress = 120,
+
+  /// Segment requests completed since the previous such message, sent with
+  /// <code>kMetrics</code> when there are any, so slow downloads can be
+  /// correlated with CDN cache misses. It's never sent in the binary form.
+  /// @param (array)kKeyDownloads Dictionaries of the requests, in order,
+  ///   with: <code>host</code>, <code>representation</code> (an id),
+  ///   <code>bytes</code>, <code>status</code> (HTTP status code),
+  ///   <code>openTime</code> (until response headers were received),
+  ///   <code>firstByteTime</code> (until the first part of the body was
+  ///   received), <code>bodyTime</code> (from the headers to the end of the
+  ///   body, all in milliseconds), <code>contentLength</code>,
+  ///   <code>age</code> (-1 without the header) and <code>cache</code>,
+  ///   <code>serverTiming</code>, <code>pop</code> (values of X-Cache,
+  ///   Server-Timing and of a header naming the CDN point of presence,
+  ///   empty if missing). Up to 64 most recent requests are kept.
+  kSegmentDownloads = 121,
+
+  /// Media times buffered by each stage of the pipeline, like MSE buffered
+  /// ranges, sent along with time updates. Each stream has a dictionary
+  /// with <code>appended</code> (packets given to the platform player since
+  /// the last seek), <code>queued</code> (packets demuxed and waiting to be
+  /// appended) and <code>downloaded</code> (segments passed to the demuxer)
+  /// ranges, each a [start, end] array in seconds. A range is empty when
+  /// its end is not past its start.
+  /// @param (dictionary)kKeyVideoBuffer Ranges of the video stream.
+  /// @param (dictionary)kKeyAudioBuffer Ranges of the audio stream.
+  kBufferedRanges = 122,
 };
 
 /// @enum ClipTypeEnum
@@ -219,22 +847,122 @@ const std::string kKeyMessageFromPlayer = "messageFromPlayer";
 /// This key maps to an <code>int</code> type value.
 const std::string kKeyBitrate = "bitrate";
 
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>string</code> type value.
+const std::string kKeyBenchmark = "benchmark";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>double</code> type value.
+const std::string kKeyBytes = "bytes";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to an <code>int</code> type value.
+const std::string kKeyCpu = "cpu";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to an <code>ArrayBuffer</code> type value.
+const std::string kKeyData = "data";
+
 /// A string value used in messages as a <code>VarDictionary</code> key.
 /// This key maps to a <code>double</code> type value.
 const std::string kKeyDuration = "duration";
 
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>string</code> type value.
+const std::string kKeyDemuxer = "demuxer";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>string</code> type value.
+const std::string kKeyDevice = "device";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>VarArray</code> type value.
+const std::string kKeyDownloads = "downloads";
+
 /// A string value used in messages as a <code>VarDictionary</code> key.
 /// This key maps to a <code>string</code> type value.
 const std::string kKeyEncoding = "encoding";
 
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>bool</code> type value.
+const std::string kKeyEnabled = "enabled";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to an <code>int</code> type value.
+const std::string kKeyError = "error";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>string</code> type value.
+const std::string kKeyEvent = "event";
+
 /// A string value used in messages as a <code>VarDictionary</code> key.
 /// This key maps to an <code>int</code> type value.
 const std::string kKeyId = "id";
 
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>double</code> type value.
+const std::string kKeyInitialBuffer = "initialBuffer";
+
 /// A string value used in messages as a <code>VarDictionary</code> key.
 /// This key maps to a <code>string</code> type value.
 const std::string kKeyLanguage = "language";
 
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>string</code> type value.
+const std::string kKeyManifest = "manifest";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>VarArray</code> type value.
+const std::string kKeyMessages = "messages";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>VarDictionary</code> type value.
+const std::string kKeyMetrics = "metrics";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>string</code> type value.
+const std::string kKeyMimeType = "mimeType";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>string</code> type value.
+const std::string kKeyOperation = "operation";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to an <code>int</code> type value.
+const std::string kKeyPercent = "percent";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>VarDictionary</code> type value.
+const std::string kKeyPhases = "phases";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>string</code> type value.
+const std::string kKeyPressure = "pressure";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to an <code>int</code> type value.
+const std::string kKeyPriority = "priority";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>double</code> type value.
+const std::string kKeyRate = "rate";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>string</code> type value.
+const std::string kKeyRecords = "records";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>string</code> type value.
+const std::string kKeyRole = "role";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>VarDictionary</code> type value.
+const std::string kKeyState = "state";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>double</code> type value.
+const std::string kKeyStartTime = "startTime";
+
 /// A string value used in messages as a <code>VarDictionary</code> key.
 /// This key maps to a <code>string</code> type value.
 const std::string kKeySubtitle = "subtitle";
@@ -243,6 +971,22 @@ const std::string kKeySubtitle = "subtitle";
 /// This key maps to a <code>double</code> type value.
 const std::string kKeyTime = "time";
 
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>double</code> type value.
+const std::string kKeyTimestamp = "timestamp";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>string</code> type value.
+const std::string kKeyTrace = "trace";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>VarDictionary</code> type value.
+const std::string kKeyTraces = "traces";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>VarDictionary</code> type value.
+const std::string kKeyTuning = "tuning";
+
 /// A string value used in messages as a <code>VarDictionary</code> key.
 /// This key maps to an <code>int</code> type value.
 const std::string kKeyType = "type";
@@ -251,6 +995,22 @@ const std::string kKeyType = "type";
 /// This key maps to a <code>string</code> type value.
 const std::string kKeyUrl = "url";
 
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>VarArray</code> type value.
+const std::string kKeyUrls = "urls";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>double</code> type value.
+const std::string kKeyVideoBuffer = "videoBuffer";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>bool</code> type value.
+const std::string kKeyVisible = "visible";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>double</code> type value.
+const std::string kKeyAudioBuffer = "audioBuffer";
+
 /// A string value used in messages as a <code>VarDictionary</code> key.
 /// This key maps to an <code>int</code> type value.
 const std::string kKeyWidth = "width";
@@ -259,6 +1019,18 @@ const std::string kKeyWidth = "width";
 /// This key maps to an <code>int</code> type value.
 const std::string kKeyHeight = "height";
 
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to an <code>int</code> type value.
+const std::string kKeyChannels = "channels";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>bool</code> type value.
+const std::string kKeyHdr = "hdr";
+
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to an <code>array</code> of <code>string</code> values.
+const std::string kKeyCodecs = "codecs";
+
 const std::string kDrmLicenseUrl = "drm_license_url";
 const std::string kDrmKeyRequestProperties = "drm_key_request_properties";
 
@@ -275,6 +1047,13 @@ const std::string kKeyYCoordination = "y_coordinate";
 /// enum value.
 const std::string kKeyLogLevel = "level";
 
+/// A string value used in messages as a <code>VarDictionary</code> key.
+/// This key maps to a <code>string</code> type value with a name of a
+/// LogCategory, one of: <code>"general"</code>, <code>"dash"</code>,
+/// <code>"demuxer"</code>, <code>"packets"</code>, <code>"drm"</code>,
+/// <code>"net"</code> or <code>"communicator"</code>.
+const std::string kKeyLogCategory = "category";
+
 }  // namespace Communication
 
 #endif  // NATIVE_PLAYER_INC_COMMUNICATOR_MESSAGES_H_
@@ -0,0 +1,119 @@
+/*!
+ * cpu_profiler.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ *
+ * @brief
+ * CPU time accounting per pipeline stage, measured with the CPU clock of
+ * each thread, and an optional sampling of stages threads are in.
+ */
+
+#ifndef NATIVE_PLAYER_INC_CPU_PROFILER_H_
+#define NATIVE_PLAYER_INC_CPU_PROFILER_H_
+
+#include <stdint.h>
+#include <array>
+#include <cstddef>
+
+/**
+ * Stages of the pipeline CPU time is attributed to.
+ */
+enum class CpuStage : int32_t {
+  // Outside of any CpuScope.
+  kOther,
+  // Downloading segments and manifests.
+  kDownload,
+  // Parsing segments into packets.
+  kDemux,
+  // Queueing packets and scheduling their appends.
+  kPackets,
+  // License requests and appending encrypted packets.
+  kDrm,
+  kCount
+};
+
+/**
+ * Sums CPU time (CLOCK_THREAD_CPUTIME_ID) used by threads in each stage.
+ * The time of a thread is attributed to the innermost CpuScope, so nested
+ * stages don't count twice. Time spent waiting, e.g. for network data,
+ * doesn't use CPU and is not counted. Entering and leaving a scope reads
+ * the clock once each.
+ *
+ * Sampling, when enabled, checks the stage each thread is in at a low
+ * frequency, which shows where threads are when a device is overloaded,
+ * e.g. a stage which waits inside a scope a lot.
+ */
+class CpuProfiler {
+ public:
+  struct StageStats {
+    // CPU time, in seconds.
+    double cpu_time;
+    // Samples which found a thread in the stage.
+    uint64_t samples;
+  };
+
+  typedef std::array<StageStats,
+                     static_cast<std::size_t>(CpuStage::kCount)> Report;
+
+  /**
+   * Returns CPU time used by the calling thread so far, in seconds.
+   */
+  static double ThreadCpuTime();
+
+  static const char* StageName(CpuStage stage);
+
+  /**
+   * Returns totals of all stages since the start of the module.
+   */
+  static Report GetReport();
+
+  /**
+   * Starts sampling stages of threads every interval_ms milliseconds, or
+   * stops it with 0. Samples are kept until the module ends.
+   */
+  static void SetSamplingInterval(int32_t interval_ms);
+
+ private:
+  friend class CpuScope;
+
+  // Makes the stage current on the calling thread, returns the previous one.
+  static CpuStage EnterStage(CpuStage stage);
+  static void LeaveStage(CpuStage previous);
+};
+
+/**
+ * Attributes CPU time of the calling thread until the end of the scope to
+ * the given stage.
+ */
+class CpuScope {
+ public:
+  explicit CpuScope(CpuStage stage)
+      : previous_(CpuProfiler::EnterStage(stage)) {}
+
+  ~CpuScope() {
+    CpuProfiler::LeaveStage(previous_);
+  }
+
+ private:
+  CpuStage previous_;
+};
+
+#define CPU_CONCAT_INTERNAL(a, b) a##b
+#define CPU_CONCAT(a, b) CPU_CONCAT_INTERNAL(a, b)
+#define CPU_SCOPE(stage) \
+  CpuScope CPU_CONCAT(cpu_scope_, __LINE__)(stage)
+
+#endif  // NATIVE_PLAYER_INC_CPU_PROFILER_H_
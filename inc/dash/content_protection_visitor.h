@@ -96,6 +96,8 @@ class ContentProtectionVisitor {
   /// @return ContentProtectionDescriptor builded by acquired information from
   ///   <code><ContentProtection></code> node for specified DRM.\n An
   ///   <code>empty shared_ptr</code> if no information has been found.
+  /// @note Nodes are freed once the manifest is parsed, so the descriptor
+  ///   must copy data it needs instead of keeping pointers to them.
   virtual std::shared_ptr<ContentProtectionDescriptor> Visit(
       const std::vector<dash::mpd::IDescriptor*>& cp) = 0;
 
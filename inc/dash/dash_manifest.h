@@ -28,20 +28,43 @@
 #include "dash/media_segment_sequence.h"
 #include "dash/media_stream.h"
 
-namespace dash {
-
-class IDASHManager;
-
-namespace mpd {
-
-class IMPD;
-
-}
-}
-
 /// @file
 /// @brief This file defines <code>DashManifest</code> class.
 
+/// @struct DeviceCapabilities
+/// @brief Describes what the device can decode and present. Representations
+/// exceeding it are left out when a manifest is parsed, so no sequences,
+/// segment indexes nor representation choices are made for them. Limits
+/// which are 0 or empty don't prune anything.
+struct DeviceCapabilities {
+  /// The largest video resolution.
+  uint32_t max_width = 0;
+  uint32_t max_height = 0;
+  /// The most audio channels, e.g. 2 on stereo output.
+  uint32_t max_channels = 0;
+  /// Whether HDR video (PQ, HLG or Dolby Vision) can be presented.
+  bool hdr = true;
+  /// Sample entries of supported codecs, i.e. the part of
+  /// <code>@codecs</code> before the first dot, e.g. "avc1" or "mp4a".
+  std::vector<std::string> codecs;
+};
+
+/// @struct ContentSteeringInfo
+/// @brief Describes a DASH content steering server of a manifest
+/// (<code>ContentSteering</code> element), which tells in what order
+/// alternative base URLs (pathways) should be used.
+struct ContentSteeringInfo {
+  /// An absolute URL of the steering manifest, empty if the manifest
+  /// doesn't use content steering.
+  std::string server_url;
+  /// A <code>BaseURL@serviceLocation</code> used until the steering
+  /// manifest is downloaded, empty if it's not given.
+  std::string default_service_location;
+  /// If <code>true</code>, the steering manifest is downloaded before the
+  /// first segment is requested.
+  bool query_before_start = false;
+};
+
 /// @class DashManifest
 /// @brief This class is responsible for parsing DASH manifest file from the
 /// given URL.
@@ -50,7 +73,7 @@ class IMPD;
 /// in the DASH manifest.
 /// This class allows to:
 ///   - Parse the DASH manifest from the given URL
-///   - List available information about tracks (audio/video)
+///   - List available information about tracks (audio/video/text/image)
 ///   - Set/switch representation of the media stream
 ///   - Download an init segment of representation - needed to initialize
 ///     demuxer
@@ -82,6 +105,58 @@ class DashManifest {
   static std::unique_ptr<DashManifest> ParseMPD(
       const std::string& url, ContentProtectionVisitor* visitor = nullptr);
 
+  /// Downloads a DASH manifest file, revalidating a cached copy of it if
+  /// there is one. Together with <code>ParseMPD(url, mpd_data, visitor)
+  /// </code> it does the same as <code>ParseMPD(url, visitor)</code>, e.g.
+  /// when both steps are timed separately.
+  ///
+  /// @param[in] url A localization of the DASH manifest file
+  /// @param[out] mpd_data Contents of the DASH manifest file.
+  /// @return <code>true</code> if the manifest was downloaded, or
+  ///   <code>false</code> otherwise.
+  static bool DownloadManifest(const std::string& url, std::string* mpd_data);
+
+  /// Parses DASH manifest data downloaded from given URL and creates
+  /// DashManifest object from it.
+  ///
+  /// @param[in] url A localization of the DASH manifest file, relative URLs
+  ///   of the manifest are resolved against it.
+  /// @param[in] mpd_data Contents of the DASH manifest file.
+  /// @param[in] visitor A <code>ContentProtectionVisitor</code> which is used
+  ///   to extract content protection information from the DASH manifest
+  /// @return A DashManifest object created from the DASH manifest.\n An
+  ///   <code>empty unique_ptr</code> in case of an error.
+  static std::unique_ptr<DashManifest> ParseMPD(
+      const std::string& url, const std::string& mpd_data,
+      ContentProtectionVisitor* visitor = nullptr);
+
+  /// Sets capabilities of the device, which manifests parsed afterwards
+  /// are pruned to. It can be called on any thread.
+  ///
+  /// @param[in] capabilities Capabilities of the device.
+  static void SetDeviceCapabilities(const DeviceCapabilities& capabilities);
+
+  /// Provides capabilities set with <code>SetDeviceCapabilities()</code>.
+  static DeviceCapabilities GetDeviceCapabilities();
+
+  /// Joins two presentations into a single one, which plays periods of
+  /// <code>next</code> after periods of <code>first</code>, e.g. to play
+  /// consecutive episodes without a gap. Periods of <code>next</code> are
+  /// shifted to start when <code>first</code> ends, so their segments get
+  /// timestamp offsets like periods of a single multi-period manifest.
+  /// Both manifests are kept alive by the joined one and sequences created
+  /// by them before remain valid.
+  ///
+  /// @param[in] first A presentation which is played first.
+  /// @param[in] next A presentation which is played after
+  ///   <code>first</code>.
+  /// @return A DashManifest object of the joined presentation.\n An
+  ///   <code>empty unique_ptr</code> when any of the presentations is dynamic
+  ///   or its duration is not known.
+  static std::unique_ptr<DashManifest> Concatenate(
+      const std::shared_ptr<DashManifest>& first,
+      const std::shared_ptr<DashManifest>& next);
+
   /// Provides information about available <code>AudioStream</code>
   /// representations.
   /// @return A vector of <code>AudioStream</code> representations parsed
@@ -94,9 +169,25 @@ class DashManifest {
   /// from DASH manifest.
   std::vector<VideoStream> GetVideoStreams() const;
 
+  /// Provides information about available <code>TextStream</code>
+  /// representations, i.e. subtitles carried in DASH segments.
+  /// @return A vector of <code>TextStream</code> representations parsed
+  /// from DASH manifest.
+  std::vector<TextStream> GetTextStreams() const;
+
+  /// Provides information about available <code>ImageStream</code>
+  /// representations, i.e. thumbnail tiles of image adaptation sets.
+  /// @return A vector of <code>ImageStream</code> representations parsed
+  /// from DASH manifest.
+  std::vector<ImageStream> GetImageStreams() const;
+
   /// Provides a segment sequence for the given parameters.
-  /// This method calls DashManifest::GetAudioSequence or
-  /// DashManifest::GetVideoSequence depending of passed <code>type</code>.
+  /// This method calls DashManifest::GetAudioSequence,
+  /// DashManifest::GetVideoSequence, DashManifest::GetTextSequence or
+  /// DashManifest::GetImageSequence depending of passed <code>type</code>.
+  /// @note Sequences are immutable, so the one created by the first call
+  ///   for a representation is shared by all callers and next calls return
+  ///   it without blocking.
   ///
   /// @param[in] type An information about <code>MediaStreamType</code> for
   /// which <code>MediaSegmentSequence</code> will be returned.
@@ -104,8 +195,8 @@ class DashManifest {
   /// <code>MediaSegmentSequence</code> is demanded.
   /// @return A <code>MediaSegmentSequence</code> object for the given
   /// <code>type</code> and <code>id</code>.
-  std::unique_ptr<MediaSegmentSequence> GetSequence(MediaStreamType type,
-                                                    uint32_t id);
+  std::shared_ptr<const MediaSegmentSequence> GetSequence(
+      MediaStreamType type, uint32_t id);
 
   /// Provides a segment sequence for the given parameter among audio stream
   /// representations.
@@ -114,7 +205,7 @@ class DashManifest {
   /// <code>MediaSegmentSequence</code> is demanded.
   /// @return A <code>MediaSegmentSequence</code> object for the given
   /// <code>id</code>.
-  std::unique_ptr<MediaSegmentSequence> GetAudioSequence(uint32_t id);
+  std::shared_ptr<const MediaSegmentSequence> GetAudioSequence(uint32_t id);
 
   /// Provides a segment sequence for the given parameter among video stream
   /// representations.
@@ -123,7 +214,55 @@ class DashManifest {
   /// <code>MediaSegmentSequence</code> is demanded.
   /// @return A <code>MediaSegmentSequence</code> object for the given
   /// <code>id</code>.
-  std::unique_ptr<MediaSegmentSequence> GetVideoSequence(uint32_t id);
+  std::shared_ptr<const MediaSegmentSequence> GetVideoSequence(uint32_t id);
+
+  /// Provides a segment sequence for the given parameter among text stream
+  /// representations.
+  ///
+  /// @param[in] id An information about which text stream representation
+  /// <code>MediaSegmentSequence</code> is demanded.
+  /// @return A <code>MediaSegmentSequence</code> object for the given
+  /// <code>id</code>.
+  std::shared_ptr<const MediaSegmentSequence> GetTextSequence(uint32_t id);
+
+  /// Provides a segment sequence for the given parameter among image stream
+  /// representations. Each segment is a single image of thumbnail tiles.
+  ///
+  /// @param[in] id An information about which image stream representation
+  /// <code>MediaSegmentSequence</code> is demanded.
+  /// @return A <code>MediaSegmentSequence</code> object for the given
+  /// <code>id</code>.
+  std::shared_ptr<const MediaSegmentSequence> GetImageSequence(uint32_t id);
+
+  /// Provides a segment sequence of a trick mode video representation, i.e.
+  /// one from an adaptation set marked with the DASH-IF trick mode
+  /// <code>EssentialProperty</code>. Such representations hold keyframes
+  /// only, so they are used for fast forward and rewind instead of regular
+  /// video streams, which don't include them.
+  ///
+  /// @return A <code>MediaSegmentSequence</code> object of the trick mode
+  ///   representation with the lowest bitrate.\n nullptr if there is none.
+  std::shared_ptr<const MediaSegmentSequence> GetTrickModeSequence();
+
+  /// Creates a segment sequence for the given parameters in advance, so
+  /// <code>TakePreparedSequence()</code> can provide it. Does nothing if
+  /// such sequence is already created.
+  /// @note This method is meant to be called on worker threads, sequences of
+  ///   different representations can be prepared concurrently.
+  ///
+  /// @param[in] type A type of the media stream.
+  /// @param[in] id An id of the media stream representation.
+  void PrepareSequence(MediaStreamType type, uint32_t id);
+
+  /// Provides a segment sequence created by <code>PrepareSequence()</code>
+  /// or <code>GetSequence()</code> without creating it, so it never blocks.
+  ///
+  /// @param[in] type A type of the media stream.
+  /// @param[in] id An id of the media stream representation.
+  /// @return A prepared <code>MediaSegmentSequence</code> or nullptr if
+  ///   it's not created yet and <code>GetSequence()</code> needs to be used.
+  std::shared_ptr<const MediaSegmentSequence> TakePreparedSequence(
+      MediaStreamType type, uint32_t id);
 
   /// Provides duration of media content in text format parsed from DASH
   /// manifest.
@@ -143,10 +282,58 @@ class DashManifest {
   ///   DASH manifest.
   const std::string& GetDuration() const;
 
+  /// Checks if the manifest describes a dynamic (live) presentation, which
+  /// segments become available over time.
+  /// @return True if MPD@type is "dynamic".
+  bool IsDynamic() const;
+
+  /// Provides MPD@minimumUpdatePeriod of a dynamic presentation.
+  /// @return A period in seconds after which the manifest should be
+  ///   refreshed with <code>Refresh()</code>.\n A negative value if the
+  ///   manifest doesn't need to be refreshed.
+  double GetMinimumUpdatePeriod() const;
+
+  /// Provides a latency a low-latency live presentation should be played
+  /// with, i.e. its <code>ServiceDescription</code> latency target, or a
+  /// default one when its segments are available before they are complete
+  /// (<code>@availabilityTimeOffset</code>, e.g. chunked CMAF).
+  /// @return A latency in seconds.\n 0 if it's not a low-latency
+  ///   presentation.
+  double GetTargetLatency() const;
+
+  /// Downloads the manifest again and adds new segments of its
+  /// <code>SegmentTimeline</code>s to sequences created before, including
+  /// ones which are in use. Other changes of the manifest are ignored.
+  /// @note This method needs to be called on non-main thread.
+  ///
+  /// @return True if the manifest was refreshed.
+  bool Refresh();
+
+  /// Downloads segment indexes (<code>sidx</code> boxes) of all
+  /// representations using <code>SegmentBase</code>, which weren't
+  /// downloaded yet. Sequences of these representations download their
+  /// index when it's needed for the first time, so calling this method
+  /// in the background shortens startup and representation switches.
+  /// @note This method needs to be called on non-main thread.
+  void LoadSegmentIndexes();
+
+  /// Provides origins (e.g. <code>"https://cdn.example.com/"</code>) of
+  /// base URLs of all representations, including alternative ones, so
+  /// connections to them can be opened before segments are requested.
+  ///
+  /// @return Distinct origins in order of representations of the manifest.
+  std::vector<std::string> GetOrigins() const;
+
+  /// Provides a content steering server of the manifest.
+  ///
+  /// @return A description of the server, which <code>server_url</code> is
+  ///   empty if the manifest doesn't use content steering.
+  /// @see ContentSteeringInfo
+  const ContentSteeringInfo& GetContentSteering() const;
+
  private:
-  DashManifest(std::unique_ptr<dash::IDASHManager> manager,
-               std::unique_ptr<dash::mpd::IMPD> mpd,
-               ContentProtectionVisitor* visitor);
+  class Impl;
+  explicit DashManifest(std::unique_ptr<Impl> pimpl);
 
   DashManifest(const DashManifest&) = delete;
   DashManifest(DashManifest&&) = delete;
@@ -154,7 +341,6 @@ class DashManifest {
   DashManifest operator=(const DashManifest&) = delete;
   DashManifest operator=(DashManifest&&) = delete;
 
-  class Impl;
   std::unique_ptr<Impl> pimpl_;
 };
 
@@ -20,9 +20,14 @@
 #ifndef SRC_PLAYER_ES_DASH_PLAYER_DASH_MEDIA_SEGMENT_SEQUENCE_H_
 #define SRC_PLAYER_ES_DASH_PLAYER_DASH_MEDIA_SEGMENT_SEQUENCE_H_
 
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
+#include "common.h"
+
 /// @file
 /// @brief This file defines <code>MediaSegmentSequence</code> class.
 
@@ -32,7 +37,17 @@ class ISegment;
 }
 }
 
-class SequenceIterator;
+class CancellationToken;
+
+/// @struct SegmentDescriptor
+/// @brief Location of a segment: an absolute URL and an optional byte range.
+struct SegmentDescriptor {
+  /// Absolute URL of the segment.
+  std::string url;
+  /// Byte range in the <code>first-last</code> form of a HTTP Range header,
+  /// empty when the whole resource is the segment.
+  std::string range;
+};
 
 /// @class MediaSegmentSequence
 /// @brief Container of possibly infinite (in case of live streams) sequence
@@ -48,9 +63,22 @@ class MediaSegmentSequence {
 
   virtual ~MediaSegmentSequence();
 
+  /// @struct Position
+  /// @brief Position of a segment in a sequence. Meaning of its fields
+  /// depends on the type of the sequence.
+  struct Position {
+    uint32_t index;
+    uint32_t sub_index;
+    uint32_t period;
+  };
+
   /// @class Iterator
   /// @brief Constant bidirectional iterator through the sequence.
   ///
+  /// It's a value type holding the sequence and a position in it, so it's
+  /// cheap to copy and can be passed between threads as long as the
+  /// sequence exists.
+  ///
   /// For live streams incrementation and decrementation operations might
   /// return past-the-end iterator when a segment is either not yet available
   /// or no more segments are available.
@@ -59,26 +87,10 @@ class MediaSegmentSequence {
     /// Constructs an empty <code>Iterator</code> object.
     Iterator();
 
-    /// Constructs an <code>Iterator</code> object
-    /// from <code>SequenceIterator</code>.
-    explicit Iterator(std::unique_ptr<SequenceIterator>&&);
-
-    /// Constructs a copy of <code>other</code>.
-    Iterator(const Iterator& other);
-
-    /// Move-constructs a <code>Iterator</code> object, making it point at the
-    /// same object that <code>other</code> was pointing to.
-    Iterator(Iterator&& other);
-
-    /// Destroys <code>Iterator</code> object.
-    ~Iterator();
-
-    /// Assigns <code>other</code> to this <code>Iterator</code>
-    Iterator& operator=(const Iterator& other);
-
-    /// Move-assigns <code>other</code> to this
-    /// <code>Iterator</code> object.
-    Iterator& operator=(Iterator&& other);
+    /// Constructs an <code>Iterator</code> object pointing at the given
+    /// position of the sequence.
+    Iterator(const MediaSegmentSequence* sequence, uint32_t index,
+             uint32_t sub_index = 0, uint32_t period = 0);
 
     /// Advances the iterator by one position.
     /// @return *this.
@@ -105,7 +117,9 @@ class MediaSegmentSequence {
     bool operator!=(const Iterator&) const;
 
     /// @note Iteration happens over ISegment*, however a call to
-    /// this method creates a new ISegment* object!
+    /// this method creates a new ISegment* object! Use
+    /// <code>MediaSegmentSequence::GetSegmentDescriptor()</code> when only
+    /// the location of the segment is needed.
 
     /// Returns a smart pointer to the segment which is a copy of the
     /// ISegment pointed by the iterator.
@@ -122,8 +136,16 @@ class MediaSegmentSequence {
     /// (like invalid MediaSegmentSequence).
     double SegmentTimestamp(const MediaSegmentSequence*) const;
 
+    /// @return A sequence this iterator points to, null for an empty
+    /// iterator.
+    const MediaSegmentSequence* sequence() const { return sequence_; }
+
+    /// @return A position of the segment in the sequence.
+    const Position& position() const { return position_; }
+
    private:
-    std::unique_ptr<SequenceIterator> pimpl_;
+    const MediaSegmentSequence* sequence_;
+    Position position_;
   };
 
   /// @return Iterator to first element.
@@ -132,6 +154,18 @@ class MediaSegmentSequence {
   /// @return Past-the-end iterator.
   virtual Iterator End() const = 0;
 
+  /// Provides a segment playback should start from. It's the first segment
+  /// of a static presentation and a segment close to the live edge of a
+  /// dynamic one.
+  /// @return Iterator to the first segment to play.
+  virtual Iterator StartSegment() const;
+
+  /// Checks if this sequence belongs to a dynamic (live) presentation. New
+  /// segments of such sequence become available over time, so reaching
+  /// <code>End()</code> doesn't mean the end of the stream.
+  /// @return True for a sequence of a dynamic presentation.
+  virtual bool IsDynamic() const;
+
   // TODO(samsung) use units from nacl-player
   /// Searches for a segment which has frames for given timestamp.
   /// @return Iterator for given timestamp.
@@ -142,6 +176,21 @@ class MediaSegmentSequence {
   /// @return New Initialization Segment object.
   virtual std::unique_ptr<dash::mpd::ISegment> GetInitSegment() const = 0;
 
+  /// Provides an initialization segment needed to demux the segment pointed
+  /// by the given Iterator. Sequences spanning many periods have a different
+  /// one in each period.
+  /// @return New Initialization Segment object.
+  virtual std::unique_ptr<dash::mpd::ISegment> GetInitSegmentFor(
+      const Iterator& it) const;
+
+  /// Provides data of the segment returned by <code>GetInitSegment()</code>
+  /// when the sequence downloads it together with its segment index, which
+  /// saves a request. It blocks while they are downloaded.
+  /// @param[out] data Receives the initialization segment.
+  /// @return True if data is set.\n False if the segment has to be
+  /// downloaded by the caller.
+  virtual bool GetInitSegmentData(std::vector<uint8_t>* data) const;
+
   /// Provides a bitstream switching segment of media stream needed in live
   /// profile.
   /// @return New Bitstream Switching Segment object.
@@ -174,16 +223,203 @@ class MediaSegmentSequence {
   /// (like invalid iterator, passed iterator doesn't points to current
   /// sequence).
   virtual double SegmentTimestamp(const Iterator& it) const;
+
+  /// Provides an offset which needs to be added to media timestamps of the
+  /// segment pointed by the given Iterator to get its presentation time.
+  /// It's non-zero in sequences spanning many periods, which media
+  /// timestamps start anew in each period.
+  /// @return Offset in seconds.
+  virtual double SegmentTimestampOffset(const Iterator& it) const;
+
+  /// Provides a location of the segment pointed by the given Iterator,
+  /// which can be downloaded without creating an ISegment object.
+  /// @param[in] it An iterator of this sequence.
+  /// @param[out] descriptor Receives the location of the segment.
+  /// @return True on success.\n False for an invalid iterator.
+  bool GetSegmentDescriptor(const Iterator& it,
+                            SegmentDescriptor* descriptor) const;
+
+  /// Provides a size of the segment pointed by the given Iterator, when
+  /// it's known before the download, e.g. from a segment index or a byte
+  /// range in the manifest. Sizes of VBR segments differ a lot, so they
+  /// allow to predict download times better than bitrates.
+  /// @param[in] it An iterator of this sequence.
+  /// @return Segment size in bytes.\n 0 if it's not known or for an invalid
+  /// iterator.
+  uint64_t SegmentSize(const Iterator& it) const;
+
+  /// Provides times of keyframes inside the segment pointed by the given
+  /// Iterator, when they are known before the download, e.g. from stream
+  /// access points in a segment index. A seek to such keyframe doesn't need
+  /// to start at the segment beginning.
+  /// @param[in] it An iterator of this sequence.
+  /// @return Keyframe times in seconds, sorted ascending.\n Empty if they
+  /// are not known or for an invalid iterator.
+  std::vector<double> SegmentKeyframes(const Iterator& it) const;
+
+  /// @return Id of the representation described by this sequence.
+  const std::string& RepresentationId() const { return representation_id_; }
+
+  /// @return @codecs of the representation described by this sequence, e.g.
+  /// "avc1.640028".\n Empty if the manifest doesn't give it.
+  const std::string& Codecs() const { return codecs_; }
+
+  /// @return @bandwidth of the representation described by this sequence,
+  /// in bits per second.\n 0 if the manifest doesn't give it.
+  uint32_t Bandwidth() const { return bandwidth_; }
+
+ protected:
+  MediaSegmentSequence(const std::string& representation_id,
+                       const std::string& codecs, uint32_t bandwidth);
+
+  /// Moves position to the next segment. Increments the index by default.
+  virtual void NextSegment(Position* position) const;
+
+  /// Moves position to the previous segment. Decrements the index by
+  /// default.
+  virtual void PrevSegment(Position* position) const;
+
+  /// @return A new segment object for the position, an empty pointer if
+  /// the position is not valid.
+  virtual std::unique_ptr<dash::mpd::ISegment> SegmentAt(
+      const Position& position) const = 0;
+
+  /// Provides a location of the segment at the position. By default it's
+  /// read from the segment returned by <code>SegmentAt()</code>.
+  /// @return False if the position is not valid.
+  virtual bool DescriptorAt(const Position& position,
+                            SegmentDescriptor* descriptor) const;
+
+  /// Provides a size of the segment at the position. By default it's the
+  /// length of the byte range returned by <code>DescriptorAt()</code>.
+  /// @return Segment size in bytes.\n 0 if it's not known or the position
+  /// is not valid.
+  virtual uint64_t SizeAt(const Position& position) const;
+
+  /// Provides keyframe times of the segment at the position. None are known
+  /// by default.
+  /// @return Keyframe times in seconds.\n Empty if they are not known or the
+  /// position is not valid.
+  virtual std::vector<double> KeyframesAt(const Position& position) const;
+
+  /// @return Segment duration in seconds.\n Value < 0 if the position is not
+  /// valid.
+  virtual double DurationAt(const Position& position) const = 0;
+
+  /// @return Segment timestamp in seconds.\n Value < 0 if the position is
+  /// not valid.
+  virtual double TimestampAt(const Position& position) const = 0;
+
+ private:
+  std::string representation_id_;
+  std::string codecs_;
+  uint32_t bandwidth_;
+};
+
+/// @struct SegmentDownloadInfo
+/// @brief Describes the last request made by <code>DownloadSegment()</code>.
+struct SegmentDownloadInfo {
+  /// Requested URL, it can point to another base URL than the segment.
+  std::string url;
+  /// Number of received bytes.
+  size_t bytes = 0;
+  /// Time in seconds until response headers were received.
+  double time_to_first_byte = 0.;
+  /// Time in seconds until the first part of the body was received.
+  double time_to_first_body_byte = 0.;
+  /// Time in seconds until the whole response was received.
+  double total_time = 0.;
+  /// Headers telling how the response was served, e.g. CDN cache status.
+  /// Its status code is 0 if the segment was served from memory.
+  ResponseDiagnostics response;
 };
 
+/// A function serving downloads from memory. It gets a location of the
+/// requested resource (a manifest or a segment) and returns
+/// <code>false</code> if it doesn't serve it.
+typedef std::function<bool(const SegmentDescriptor& location,
+                           std::vector<uint8_t>* data)> LocalDataSource;
+
+/// Sets a source checked by <code>DownloadSegment()</code> and manifest
+/// downloads before a request is made, e.g. to benchmark the manifest layer
+/// without a server. Resources it doesn't serve are downloaded as usual.
+///
+/// @param[in] source A source to use, or an empty function to remove the
+///   current one.
+void SetLocalDataSource(const LocalDataSource& source);
+
+/// Reads a resource from the source set with
+/// <code>SetLocalDataSource()</code>, or from the nacl_io file system if its
+/// URL is a <code>file://</code> one (e.g. a file of a mounted USB storage).
+/// Local files are read straight into data, without URL loader chunks.
+///
+/// @return True if the resource was served by the source or read from a
+/// local file.\n False if it must be downloaded.
+bool ReadFromLocalDataSource(const SegmentDescriptor& location,
+                             std::vector<uint8_t>* data);
+
 /// Downloads the whole segment to the vector pointed by data for the given
 /// segment.
 ///
 /// @param[in] seg An ISegment for which data will be downloaded.
 /// @param[out] data An array container to which data will be downloaded.
+/// @param[out] info If not null, receives a description of the successful
+/// request.
 /// @return True if download succeed.\n False if download fails (e.g. wrong
 /// ISegment).
-bool DownloadSegment(dash::mpd::ISegment* seg, std::vector<uint8_t>* data);
+bool DownloadSegment(dash::mpd::ISegment* seg, std::vector<uint8_t>* data,
+                     SegmentDownloadInfo* info = nullptr);
+
+/// Downloads the segment, passing its data to chunk_callback in chunks as
+/// they are received.
+///
+/// @param[in] seg An ISegment for which data will be downloaded.
+/// @param[in] chunk_callback A function receiving consecutive chunks of the
+/// segment data. Returning false from it aborts the download.
+/// @param[out] info If not null, receives a description of the successful
+/// request.
+/// @return True if download succeed.\n False if download fails or is aborted.
+bool DownloadSegment(
+    dash::mpd::ISegment* seg,
+    const std::function<bool(std::vector<uint8_t>&&)>& chunk_callback,
+    SegmentDownloadInfo* info = nullptr);
+
+/// Downloads the whole segment to the vector pointed by data for the given
+/// segment location.
+///
+/// @param[in] segment A location of the segment to download.
+/// @param[out] data An array container to which data will be downloaded.
+/// @param[out] info If not null, receives a description of the successful
+/// request.
+/// @param[in] token If not null, cancelling it aborts the download.
+/// @param[in] tuning If not null, a profile of the player which sizes
+/// download buffers, the current <code>TuningProfile</code> is used
+/// otherwise.
+/// @return True if download succeed.\n False if download fails or is
+/// cancelled.
+bool DownloadSegment(const SegmentDescriptor& segment,
+                     std::vector<uint8_t>* data,
+                     SegmentDownloadInfo* info = nullptr,
+                     CancellationToken* token = nullptr,
+                     const TuningProfile* tuning = nullptr);
+
+/// Downloads the segment at the given location, passing its data to
+/// chunk_callback in chunks as they are received.
+///
+/// @param[in] segment A location of the segment to download.
+/// @param[in] chunk_callback A function receiving consecutive chunks of the
+/// segment data. Returning false from it aborts the download.
+/// @param[out] info If not null, receives a description of the successful
+/// request.
+/// @param[in] token If not null, cancelling it aborts the download.
+/// @param[in] tuning If not null, a profile of the player which sizes
+/// chunks, the current <code>TuningProfile</code> is used otherwise.
+/// @return True if download succeed.\n False if download fails or is aborted.
+bool DownloadSegment(
+    const SegmentDescriptor& segment,
+    const std::function<bool(std::vector<uint8_t>&&)>& chunk_callback,
+    SegmentDownloadInfo* info = nullptr, CancellationToken* token = nullptr,
+    const TuningProfile* tuning = nullptr);
 
 /// Downloads whole segment to vector pointed by data for given segment.
 /// @note This method calls  <code>DownloadSegment(dash::mpd::ISegment* seg,
@@ -191,12 +427,14 @@ bool DownloadSegment(dash::mpd::ISegment* seg, std::vector<uint8_t>* data);
 ///
 /// @param[in] seg An ISegment for which data will be downloaded.
 /// @param[out] data An array container to which data will be downloaded.
+/// @param[out] info If not null, receives a description of the successful
+/// request.
 /// @return True if download succeed.\n False if download fails (e.g. wrong
 /// ISegment).
 inline
 bool DownloadSegment(std::unique_ptr<dash::mpd::ISegment> seg,
-    std::vector<uint8_t>* data) {
-  return DownloadSegment(seg.get(), data);
+    std::vector<uint8_t>* data, SegmentDownloadInfo* info = nullptr) {
+  return DownloadSegment(seg.get(), data, info);
 }
 
 #endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_MEDIA_SEGMENT_SEQUENCE_H_
@@ -28,7 +28,8 @@
 /// @file
 /// @brief This file defines the <code>MediaStreamType</code> enum and
 /// <code>CommonStreamDescription</code>, <code>AudioStream</code>,
-/// <code>VideoStream</code> structs.
+/// <code>VideoStream</code>, <code>TextStream</code>,
+/// <code>ImageStream</code> structs.
 
 /// @enum MediaStreamType
 /// @brief Describes available stream types supported by the DASH parser.
@@ -36,7 +37,12 @@ enum class MediaStreamType : int32_t {
   Unknown = -1,
   Video = 0,
   Audio = 1,
-  MaxTypes
+  MaxTypes,
+  /// Text tracks are not elementary streams of NaCl Player, they are parsed
+  /// by the application, so <code>MaxTypes</code> doesn't count them.
+  Text = MaxTypes,
+  /// Thumbnail tiles of an image adaptation set, shown while seeking.
+  Image
 };
 
 /// @struct CommonStreamDescription
@@ -61,6 +67,11 @@ struct CommonStreamDescription {
   /// address.
   std::shared_ptr<ContentProtectionDescriptor> content_protection;
 
+  /// Describes the first entry of the <code>@codecs</code> attribute, e.g.
+  /// "avc1.64001f" or "mp4a.40.2". Used to configure the elementary stream
+  /// before its initialization segment is downloaded.
+  std::string codecs;
+
   /// Constructs a <code>CommonStreamDescription</code> with 0 values.
   CommonStreamDescription() : id(0), bitrate(0) {}
 
@@ -94,6 +105,27 @@ struct CommonStreamDescription {
 struct AudioStream {
   CommonStreamDescription description;
   std::string language;
+  uint32_t sampling_rate;
+  uint32_t channels;
+
+  /// Constructs an <code>AudioStream</code> with 0 values.
+  AudioStream() : sampling_rate(0), channels(0) {}
+
+  /// Constructs a copy of <code>other</code>.
+  AudioStream(const AudioStream& other) = default;
+
+  /// Move-constructs an <code>AudioStream</code> object, making it
+  /// point at the same object that <code>other</code> was pointing to.
+  AudioStream(AudioStream&& other) = default;
+
+  /// Assigns <code>other</code> to this <code>AudioStream</code>
+  AudioStream& operator=(const AudioStream& other) = default;
+
+  /// Move-assigns <code>other</code> to this <code>AudioStream</code> object.
+  AudioStream& operator=(AudioStream&& other) = default;
+
+  /// Destroys <code>AudioStream</code> object.
+  ~AudioStream() = default;
 };
 
 /// @struct VideoStream
@@ -108,9 +140,16 @@ struct VideoStream {
   CommonStreamDescription description;
   uint32_t width;
   uint32_t height;
+  /// Frame rate as a fraction, 0 when the manifest doesn't specify it.
+  uint32_t frame_rate_num;
+  uint32_t frame_rate_den;
+  /// Whether the stream uses an HDR transfer function (PQ or HLG).
+  bool hdr;
 
   /// Constructs a <code>VideoStream</code> with 0 values.
-  VideoStream() : width(0), height(0) {}
+  VideoStream()
+      : width(0), height(0), frame_rate_num(0), frame_rate_den(0),
+        hdr(false) {}
 
   /// Constructs a copy of <code>other</code>.
   VideoStream(const VideoStream& other) = default;
@@ -129,4 +168,100 @@ struct VideoStream {
   ~VideoStream() = default;
 };
 
+/// @struct TextStream
+/// @brief Describes the text (subtitles) stream.
+///
+/// Consists of CommonStreamDescription and text detailed description.\n
+/// Segments of this stream are downloaded and parsed by the application
+/// along with the audio and video streams.
+/// @note Fields which aren't specified in the DASH manifest should be 0 or
+///   empty.
+struct TextStream {
+  CommonStreamDescription description;
+  std::string language;
+  /// Describes <code>@mimeType</code>, e.g. "text/vtt",
+  /// "application/ttml+xml" or "application/mp4", in which case
+  /// <code>description.codecs</code> tells if it's "wvtt" or "stpp".
+  std::string mime_type;
+
+  /// Constructs a <code>TextStream</code> with 0 values.
+  TextStream() = default;
+
+  /// Constructs a copy of <code>other</code>.
+  TextStream(const TextStream& other) = default;
+
+  /// Move-constructs a <code>TextStream</code> object, making it
+  /// point at the same object that <code>other</code> was pointing to.
+  TextStream(TextStream&& other) = default;
+
+  /// Assigns <code>other</code> to this <code>TextStream</code>
+  TextStream& operator=(const TextStream& other) = default;
+
+  /// Move-assigns <code>other</code> to this <code>TextStream</code> object.
+  TextStream& operator=(TextStream&& other) = default;
+
+  /// Destroys <code>TextStream</code> object.
+  ~TextStream() = default;
+};
+
+/// @struct ImageStream
+/// @brief Describes the image (thumbnail) stream.
+///
+/// Consists of CommonStreamDescription and image detailed description.\n
+/// Each segment of this stream is a single image, e.g. a JPEG, divided into
+/// a grid of tiles. Tiles are thumbnails of equal parts of the segment
+/// duration, in rows from the top left one.
+/// @note Fields which aren't specified in the DASH manifest should be 0 or
+///   empty.
+struct ImageStream {
+  CommonStreamDescription description;
+  /// Describes <code>@mimeType</code>, e.g. "image/jpeg".
+  std::string mime_type;
+  /// A size of the whole image in pixels.
+  uint32_t width;
+  uint32_t height;
+  /// A grid of tiles described by the DASH-IF thumbnail tile
+  /// <code>EssentialProperty</code>, 1x1 if there is none.
+  uint32_t tile_columns;
+  uint32_t tile_rows;
+
+  /// Constructs an <code>ImageStream</code> with 0 values and a single tile.
+  ImageStream() : width(0), height(0), tile_columns(1), tile_rows(1) {}
+
+  /// Constructs a copy of <code>other</code>.
+  ImageStream(const ImageStream& other) = default;
+
+  /// Move-constructs an <code>ImageStream</code> object, making it
+  /// point at the same object that <code>other</code> was pointing to.
+  ImageStream(ImageStream&& other) = default;
+
+  /// Assigns <code>other</code> to this <code>ImageStream</code>
+  ImageStream& operator=(const ImageStream& other) = default;
+
+  /// Move-assigns <code>other</code> to this <code>ImageStream</code> object.
+  ImageStream& operator=(ImageStream&& other) = default;
+
+  /// Destroys <code>ImageStream</code> object.
+  ~ImageStream() = default;
+};
+
+/// Tells if representations are of the same kind, i.e. alternatives which
+/// representation selection can switch between, e.g. audio or subtitles of
+/// the same language. All video and image representations are of one kind.
+inline bool IsSameKind(const VideoStream&, const VideoStream&) {
+  return true;
+}
+
+inline bool IsSameKind(const AudioStream& lhs, const AudioStream& rhs) {
+  return lhs.language == rhs.language;
+}
+
+inline bool IsSameKind(const TextStream& lhs, const TextStream& rhs) {
+  return lhs.language == rhs.language;
+}
+
+inline bool IsSameKind(const ImageStream&, const ImageStream&) {
+  return true;
+}
+
 #endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_MEDIA_STREAM_H_
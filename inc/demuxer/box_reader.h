@@ -0,0 +1,169 @@
+/*!
+ * box_reader.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_BOX_READER_H_
+#define SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_BOX_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/// @file
+/// @brief This file defines the <code>BoxReader</code>.
+
+/// Returns a box type given as a four character code, e.g.
+/// <code>FourCC("moov")</code>.
+constexpr uint32_t FourCC(const char (&code)[5]) {
+  return (static_cast<uint32_t>(static_cast<uint8_t>(code[0])) << 24) |
+         (static_cast<uint32_t>(static_cast<uint8_t>(code[1])) << 16) |
+         (static_cast<uint32_t>(static_cast<uint8_t>(code[2])) << 8) |
+         static_cast<uint32_t>(static_cast<uint8_t>(code[3]));
+}
+
+/// @class BoxReader
+/// @brief Bounds checked big-endian reader of ISO BMFF boxes.
+///
+/// It refers to data owned by someone else, so a payload of a box is read by
+/// another <code>BoxReader</code> without copying it. Once a read goes past
+/// the end of data, all further reads return 0 and <code>ok()</code> returns
+/// false, so a sequence of reads is checked once at its end.
+///
+/// Multibyte fields are loaded whole and byte swapped, which compiles to a
+/// single instruction instead of a loop over bytes.
+class BoxReader {
+ public:
+  /// Size of a box header without the 64-bit size and the user type.
+  static constexpr size_t kBoxHeaderSize = 8;
+
+  BoxReader() : data_(nullptr), size_(0), pos_(0), ok_(true) {}
+  BoxReader(const uint8_t* data, size_t size)
+      : data_(data), size_(size), pos_(0), ok_(true) {}
+
+  bool ok() const { return ok_; }
+  const uint8_t* data() const { return data_; }
+  const uint8_t* current() const { return data_ + pos_; }
+  size_t size() const { return size_; }
+  size_t position() const { return pos_; }
+  size_t remaining() const { return size_ - pos_; }
+
+  bool Skip(size_t bytes) {
+    if (!ok_ || bytes > remaining()) {
+      ok_ = false;
+      pos_ = size_;
+      return false;
+    }
+    pos_ += bytes;
+    return true;
+  }
+
+  bool Read(uint8_t* out, size_t bytes) {
+    const uint8_t* src = current();
+    if (!Skip(bytes)) return false;
+    memcpy(out, src, bytes);
+    return true;
+  }
+
+  uint8_t U8() {
+    const uint8_t* src = current();
+    return Skip(1) ? *src : 0;
+  }
+  uint16_t U16() { return SwapBytes(Load<uint16_t>()); }
+  uint32_t U24() {
+    uint32_t high = U16();
+    return (high << 8) | U8();
+  }
+  uint32_t U32() { return SwapBytes(Load<uint32_t>()); }
+  uint64_t U64() { return SwapBytes(Load<uint64_t>()); }
+
+  /// Reads version and flags of a full box.
+  void FullBoxHeader(uint8_t* version, uint32_t* flags) {
+    *version = U8();
+    *flags = U24();
+  }
+
+  /// Reads a header of the next box without requiring its payload to be in
+  /// data. <code>box_size</code> is 0 for a box extending to the end of the
+  /// file. Returns false if the header doesn't fit in data, which isn't
+  /// consumed then.
+  bool NextBoxHeader(uint64_t* box_size, uint32_t* type,
+                     size_t* header_size) {
+    if (!ok_) return false;
+    size_t start = pos_;
+    *box_size = U32();
+    *type = U32();
+    if (*box_size == 1) *box_size = U64();
+    if (!ok_) {
+      pos_ = start;
+      ok_ = true;
+      return false;
+    }
+    *header_size = pos_ - start;
+    return true;
+  }
+
+  /// Reads the next child box. Returns false at the end of data or when the
+  /// box is malformed. <code>header_size</code>, if given, receives size of
+  /// the box header.
+  bool NextBox(uint32_t* type, BoxReader* payload,
+               size_t* header_size = nullptr) {
+    if (!ok_ || remaining() < kBoxHeaderSize) return false;
+    size_t start = pos_;
+    uint64_t box_size;
+    size_t header;
+    if (!NextBoxHeader(&box_size, type, &header)) {
+      ok_ = false;
+      return false;
+    }
+    if (box_size == 0) box_size = size_ - start;  // to the end of data
+    if (box_size < header || box_size > size_ - start) {
+      ok_ = false;
+      return false;
+    }
+    *payload = BoxReader(data_ + pos_, box_size - header);
+    pos_ = start + box_size;
+    if (header_size) *header_size = header;
+    return true;
+  }
+
+ private:
+  template <typename T>
+  T Load() {
+    T value = 0;
+    const uint8_t* src = current();
+    if (Skip(sizeof(T))) memcpy(&value, src, sizeof(T));
+    return value;
+  }
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  static uint16_t SwapBytes(uint16_t value) { return value; }
+  static uint32_t SwapBytes(uint32_t value) { return value; }
+  static uint64_t SwapBytes(uint64_t value) { return value; }
+#else
+  static uint16_t SwapBytes(uint16_t value) { return __builtin_bswap16(value); }
+  static uint32_t SwapBytes(uint32_t value) { return __builtin_bswap32(value); }
+  static uint64_t SwapBytes(uint64_t value) { return __builtin_bswap64(value); }
+#endif
+
+  const uint8_t* data_;
+  size_t size_;
+  size_t pos_;
+  bool ok_;
+};
+
+#endif  // SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_BOX_READER_H_
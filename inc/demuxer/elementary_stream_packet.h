@@ -20,6 +20,10 @@
 #ifndef SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_ELEMENTARY_STREAM_PACKET_H_
 #define SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_ELEMENTARY_STREAM_PACKET_H_
 
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 #include "nacl_player/media_common.h"
@@ -27,6 +31,34 @@
 /// @file
 /// @brief This file defines the <code>ElementaryStreamPacket</code>.
 
+/// A timestamp or a duration in units of <code>kMediaTimescale</code>.
+/// Demuxers convert container timestamps to it once per packet and packets
+/// are ordered by it exactly, so no floating point comparison is involved
+/// until a packet is passed to the platform as
+/// <code>Samsung::NaClPlayer::TimeTicks</code>.
+typedef int64_t MediaTime;
+
+/// Units of <code>MediaTime</code> per second (microseconds).
+constexpr MediaTime kMediaTimescale = 1000000;
+
+/// Converts <code>value</code> expressed in units of <code>timescale</code>
+/// to <code>MediaTime</code>. Seconds and the remainder are rescaled apart,
+/// so big decode times of live streams don't overflow.
+inline MediaTime ToMediaTime(int64_t value, int64_t timescale) {
+  return value / timescale * kMediaTimescale +
+      value % timescale * kMediaTimescale / timescale;
+}
+
+/// Converts seconds to <code>MediaTime</code>.
+inline MediaTime ToMediaTime(Samsung::NaClPlayer::TimeTicks time) {
+  return std::llround(time * kMediaTimescale);
+}
+
+/// Converts <code>MediaTime</code> to seconds.
+inline Samsung::NaClPlayer::TimeTicks ToTimeTicks(MediaTime time) {
+  return static_cast<Samsung::NaClPlayer::TimeTicks>(time) / kMediaTimescale;
+}
+
 /// @class ElementaryStreamPacket
 /// @brief This class is a wrapper for both Samsung::NaClPlayer::ESPacket and
 /// encryption information.
@@ -36,6 +68,10 @@
 /// @see Samsung::NaClPlayer::ESPacket
 /// @see Samsung::NaClPlayer::EncryptedSubsampleDescription
 /// @see Samsung::NaClPlayer::ESPacketEncryptionInfo
+///
+/// @note Packets are created for every demuxed frame, so both the packet
+///   objects and their internal byte arrays are recycled through a pool
+///   instead of being allocated and released on each frame.
 class ElementaryStreamPacket {
  public:
   /// Constructs <code>ElementaryStreamPacket</code> and
@@ -47,6 +83,16 @@ class ElementaryStreamPacket {
   /// @see Samsung::NaClPlayer::ESPacket
   ElementaryStreamPacket(uint8_t* data, uint32_t size);
 
+  /// Constructs <code>ElementaryStreamPacket</code> which refers to data
+  /// held by <code>buffer</code> instead of copying it.
+  ///
+  /// @param[in] buffer A byte array which helds data of elementary stream
+  ///   packet. It is kept alive as long as this packet exists.
+  /// @param[in] offset An offset of packet data in <code>buffer</code>.
+  /// @param[in] size A size of packet data in bytes.
+  ElementaryStreamPacket(std::shared_ptr<const std::vector<uint8_t>> buffer,
+                         uint32_t offset, uint32_t size);
+
   ElementaryStreamPacket(const ElementaryStreamPacket&) = delete;
 
   /// Move-constructs a <code>ElementaryStreamPacket</code> object,
@@ -54,7 +100,8 @@ class ElementaryStreamPacket {
   /// to.
   ElementaryStreamPacket(ElementaryStreamPacket&& other) = default;
 
-  /// Destroys <code>ElementaryStreamPacket</code> object.
+  /// Destroys <code>ElementaryStreamPacket</code> object. Internal byte
+  /// arrays are returned to the pool.
   ~ElementaryStreamPacket() = default;
 
   ElementaryStreamPacket& operator=(const ElementaryStreamPacket&) = delete;
@@ -63,6 +110,27 @@ class ElementaryStreamPacket {
   /// <code>ElementaryStreamPacket</code> object.
   ElementaryStreamPacket& operator=(ElementaryStreamPacket&& other) = default;
 
+  /// Allocates memory for <code>ElementaryStreamPacket</code> object from
+  /// the pool of released packets.
+  static void* operator new(size_t size);
+
+  /// Returns memory of <code>ElementaryStreamPacket</code> object to the pool.
+  static void operator delete(void* ptr);
+
+  /// Counts of heap allocations made since the start, when the pool had no
+  /// released object to reuse.
+  struct AllocationStats {
+    /// Allocations of <code>ElementaryStreamPacket</code> objects.
+    uint64_t packets;
+    /// Allocations of storages of packets' byte arrays.
+    uint64_t storages;
+    /// Packets which are not destroyed yet.
+    int64_t live_packets;
+  };
+
+  /// Returns counts of heap allocations of packets.
+  static AllocationStats GetAllocationStats();
+
   /// Returns Elementary Stream Packet.
   const Samsung::NaClPlayer::ESPacket& GetESPacket() const;
 
@@ -77,7 +145,7 @@ class ElementaryStreamPacket {
   bool IsKeyFrame() const { return es_packet_.is_key_frame; }
 
   /// Returns size of packet's data.
-  uint32_t GetDataSize() const { return data_.size(); }
+  uint32_t GetDataSize() const { return es_packet_.size; }
 
   /// Returns the presentation timestamp.
   /// @see Samsung::NaClPlayer::ESPacket::pts
@@ -93,24 +161,53 @@ class ElementaryStreamPacket {
     return es_packet_.duration;
   }
 
+  /// Returns the presentation timestamp in units of
+  /// <code>kMediaTimescale</code>.
+  MediaTime GetMediaPts() const { return pts_; }
+
+  /// Returns the decode timestamp in units of <code>kMediaTimescale</code>.
+  MediaTime GetMediaDts() const { return dts_; }
+
+  /// Returns the packet's duration in units of <code>kMediaTimescale</code>.
+  MediaTime GetMediaDuration() const { return duration_; }
+
   /// Allows to set if packet is a key frame or not.
   /// @see Samsung::NaClPlayer::ESPacket::is_key_frame
   void SetKeyFrame(bool key_frame) { es_packet_.is_key_frame = key_frame; }
 
   /// Allows to set a presentation timestamp.
   /// @see Samsung::NaClPlayer::ESPacket::pts
-  void SetPts(Samsung::NaClPlayer::TimeTicks pts) { es_packet_.pts = pts; }
+  void SetPts(Samsung::NaClPlayer::TimeTicks pts) {
+    pts_ = ToMediaTime(pts);
+    es_packet_.pts = pts;
+  }
 
   /// Allows to set a decode timestamp.
   /// @see Samsung::NaClPlayer::ESPacket::dts
-  void SetDts(Samsung::NaClPlayer::TimeTicks dts) { es_packet_.dts = dts; }
+  void SetDts(Samsung::NaClPlayer::TimeTicks dts) {
+    dts_ = ToMediaTime(dts);
+    es_packet_.dts = dts;
+  }
 
   /// Allows to set a packet's duration.
   /// @see Samsung::NaClPlayer::ESPacket::duration
   void SetDuration(Samsung::NaClPlayer::TimeTicks duration) {
+    duration_ = ToMediaTime(duration);
     es_packet_.duration = duration;
   }
 
+  /// Sets all timestamps of the packet in units of
+  /// <code>kMediaTimescale</code>. This is what demuxers use; seconds are
+  /// derived from them only for Samsung::NaClPlayer::ESPacket.
+  void SetMediaTimestamps(MediaTime pts, MediaTime dts, MediaTime duration) {
+    pts_ = pts;
+    dts_ = dts;
+    duration_ = duration;
+    es_packet_.pts = ToTimeTicks(pts);
+    es_packet_.dts = ToTimeTicks(dts);
+    es_packet_.duration = ToTimeTicks(duration);
+  }
+
   /// Sets a key id for encrypted data needed to decrypt it.
   ///
   /// @param[in] key_id An byte array which helds data of key id. It is copied
@@ -139,8 +236,19 @@ class ElementaryStreamPacket {
   int demux_id;
 
  private:
-  // assumption: Address returned by vector::data() method is invariant under
-  //             move operations
+  // Holds byte arrays of the packet. Storages are recycled along with the
+  // capacity of their vectors, so a packet of a typical size doesn't need
+  // any allocation once the pool is warmed up. Key id, IV and subsamples are
+  // kept inline in the storage unless they are unusually big.
+  struct Storage;
+
+  // Returns a storage to the pool instead of deleting it.
+  struct StorageDeleter {
+    void operator()(Storage* storage) const;
+  };
+
+  // assumption: Storage is not moved when the packet is moved, so data()
+  //             pointers of its vectors are invariant under move operations
 
   // invariants:
 
@@ -159,12 +267,11 @@ class ElementaryStreamPacket {
   // encryption_info.num_subsamples == subsamples_.size()
   void FixSubsamplesInvariant();
 
-  std::vector<uint8_t> data_;
+  std::unique_ptr<Storage, StorageDeleter> storage_;
+  MediaTime pts_ = 0;
+  MediaTime dts_ = 0;
+  MediaTime duration_ = 0;
   Samsung::NaClPlayer::ESPacket es_packet_;
-
-  std::vector<uint8_t> key_id_;
-  std::vector<uint8_t> iv_;
-  std::vector<Samsung::NaClPlayer::EncryptedSubsampleDescription> subsamples_;
   Samsung::NaClPlayer::ESPacketEncryptionInfo encryption_info_;
 };
 
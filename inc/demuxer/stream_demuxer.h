@@ -20,7 +20,10 @@
 #ifndef SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_STREAM_DEMUXER_H_
 #define SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_STREAM_DEMUXER_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -31,9 +34,67 @@
 #include "nacl_player/media_codecs.h"
 
 #include "demuxer/elementary_stream_packet.h"
+#include "hash_bytes.h"
 /// @file
 /// @brief This file defines the <code>StreamDemuxer</code>,
-/// <code>AudioConfig</code> and <code>VideoConfig</code>.
+/// <code>AudioConfig</code>, <code>VideoConfig</code> and
+/// <code>CodecExtraData</code>.
+
+/// @class CodecExtraData
+/// @brief Immutable codec extra data of a stream configuration.
+///
+/// Configurations are copied on their way from a demuxer to NaCl Player and
+/// compared to find changes, while extra data can take kilobytes, e.g. HEVC
+/// parameter sets. Copies share the data and its hash is computed once, so
+/// copying is cheap and data which differs is told apart without comparing
+/// it byte by byte.
+class CodecExtraData {
+ public:
+  /// Constructs empty extra data.
+  CodecExtraData() : hash_(0) {}
+
+  /// Constructs extra data holding a copy of the given bytes.
+  CodecExtraData(const uint8_t* begin, const uint8_t* end)
+      : CodecExtraData(std::vector<uint8_t>(begin, end)) {}
+
+  /// Constructs extra data taking over the given bytes.
+  explicit CodecExtraData(std::vector<uint8_t> data)
+      : data_(data.empty() ? nullptr
+                           : std::make_shared<const std::vector<uint8_t>>(
+                                 std::move(data))),
+        hash_(Hash(data_.get())) {}
+
+  /// @return A pointer to the bytes, null if there are none.
+  const uint8_t* data() const { return data_ ? data_->data() : nullptr; }
+
+  /// @return A number of bytes.
+  size_t size() const { return data_ ? data_->size() : 0; }
+
+  bool empty() const { return !data_; }
+
+  uint8_t operator[](size_t index) const { return (*data_)[index]; }
+
+  /// Checks if extra data holds the same bytes. Bytes are compared only
+  /// when they are not shared and their hashes are equal.
+  bool operator==(const CodecExtraData& other) const {
+    if (data_ == other.data_) return true;
+    if (hash_ != other.hash_ || size() != other.size()) return false;
+    return *data_ == *other.data_;
+  }
+
+  bool operator!=(const CodecExtraData& other) const {
+    return !(*this == other);
+  }
+
+ private:
+  static size_t Hash(const std::vector<uint8_t>* data) {
+    if (!data) return 0;
+    return static_cast<size_t>(HashBytes(data->data(), data->size()));
+  }
+
+  std::shared_ptr<const std::vector<uint8_t>> data_;
+  size_t hash_;
+};
 
 /// @struct AudioConfig
 /// @brief Structure describing Elementary Audio Stream configuration.
@@ -67,7 +128,7 @@ struct AudioConfig {
 
   /// Describes audio extra data. Some codecs need more data to encode
   /// stream. Usually it's in header of the file.
-  std::vector<uint8_t> extra_data;
+  CodecExtraData extra_data;
 
   int demux_id;
 
@@ -85,6 +146,49 @@ struct AudioConfig {
   }
 };
 
+/// @struct VideoColorInfo
+/// @brief Structure describing colour properties of a video stream, as
+///   codes of ISO/IEC 23091-2, the same as in H.264/H.265 VUI and in
+///   <code>colr</code> boxes. E.g. HDR10 uses primaries 9 (BT.2020),
+///   transfer 16 (PQ) and matrix 9, HLG uses transfer 18.
+/// @note Codes are 0 if they are not known.
+struct VideoColorInfo {
+  int32_t primaries;
+  int32_t transfer;
+  int32_t matrix;
+  bool full_range;
+
+  bool operator==(const VideoColorInfo& info) const {
+    return primaries == info.primaries && transfer == info.transfer &&
+           matrix == info.matrix && full_range == info.full_range;
+  }
+};
+
+/// @struct DolbyVisionConfig
+/// @brief Structure describing a Dolby Vision configuration of a video
+///   stream, read from its <code>dvcC</code> or <code>dvvC</code> box.
+struct DolbyVisionConfig {
+  /// Set if the stream has a Dolby Vision configuration, other fields are
+  /// valid only then.
+  bool present;
+  int32_t profile;
+  int32_t level;
+  bool rpu_present;
+  bool el_present;
+  bool bl_present;
+  /// Describes which format the base layer is compatible with, e.g. 1 for
+  /// HDR10, 2 for SDR or 4 for HLG. 0 if it's not compatible.
+  int32_t bl_compatibility_id;
+
+  bool operator==(const DolbyVisionConfig& config) const {
+    return present == config.present && profile == config.profile &&
+           level == config.level && rpu_present == config.rpu_present &&
+           el_present == config.el_present &&
+           bl_present == config.bl_present &&
+           bl_compatibility_id == config.bl_compatibility_id;
+  }
+};
+
 /// @struct VideoConfig
 /// @brief Structure describing Elementary Video Stream configuration.
 /// @note Not all fields are required to properly configure audio elementary
@@ -115,7 +219,26 @@ struct VideoConfig {
 
   /// Describes video extra data. Some codecs need more data to encode
   /// stream. Usually it's in header of the file.
-  std::vector<uint8_t> extra_data;
+  CodecExtraData extra_data;
+
+  /// Describes a profile and a level as signalled in the stream, e.g.
+  /// general_profile_idc and general_level_idc of HEVC, which
+  /// <code>codec_profile</code> has no values for.
+  /// @note Values are 0 if they are not known.
+  int32_t profile_idc;
+  int32_t level_idc;
+
+  /// Describes bit depth of luma samples, e.g. 10 for HDR content. 0 if it's
+  /// not known.
+  int32_t bit_depth;
+
+  /// Describes colour properties, which tell SDR, HDR10 and HLG apart.
+  /// @see struct <code>VideoColorInfo</code>
+  VideoColorInfo color;
+
+  /// Describes a Dolby Vision configuration.
+  /// @see struct <code>DolbyVisionConfig</code>
+  DolbyVisionConfig dolby_vision;
 
   int demux_id;
 
@@ -126,10 +249,69 @@ struct VideoConfig {
     return ((codec_profile == config.codec_profile) &&
             (codec_type == config.codec_type) &&
             (extra_data == config.extra_data) &&
-            (frame_format == config.frame_format));
+            (frame_format == config.frame_format) &&
+            (profile_idc == config.profile_idc) &&
+            (level_idc == config.level_idc) &&
+            (bit_depth == config.bit_depth) &&
+            (color == config.color) &&
+            (dolby_vision == config.dolby_vision));
   }
 };
 
+/// @enum ConfigChange
+/// Describes what a new stream configuration changes compared to the
+/// previous one, i.e. how much work applying it takes.
+/// @see ClassifyConfigChange()
+enum class ConfigChange {
+  /// Configurations are the same, nothing has to be done.
+  kNone,
+  /// Only the frame size or the frame rate changed, which the decoder
+  /// follows from the stream itself, so it doesn't need to be initialized
+  /// again (e.g. a representation change within an adaptation set).
+  kResolution,
+  /// The codec or its parameters changed, the decoder has to be initialized
+  /// with the new configuration.
+  kCodec
+};
+
+/// Classifies a change from the <code>previous</code> audio configuration
+/// to the <code>next</code> one. Audio configurations don't have resolution
+/// only changes.
+inline ConfigChange ClassifyConfigChange(const AudioConfig& previous,
+                                         const AudioConfig& next) {
+  return previous == next ? ConfigChange::kNone : ConfigChange::kCodec;
+}
+
+/// Classifies a change from the <code>previous</code> video configuration
+/// to the <code>next</code> one.
+inline ConfigChange ClassifyConfigChange(const VideoConfig& previous,
+                                         const VideoConfig& next) {
+  if (!(previous == next)) return ConfigChange::kCodec;
+  if (previous.size.width != next.size.width ||
+      previous.size.height != next.size.height ||
+      previous.frame_rate.numerator != next.frame_rate.numerator ||
+      previous.frame_rate.denominator != next.frame_rate.denominator)
+    return ConfigChange::kResolution;
+  return ConfigChange::kNone;
+}
+
+/// @struct DemuxerOptions
+/// @brief Describes a stream to a demuxer before it's parsed, so the demuxer
+///   can size its buffers for it.
+struct DemuxerOptions {
+  /// Bitrate of the stream in bits per second, 0 if it's not known.
+  uint32_t bitrate = 0;
+  /// Average duration of segments of the stream in seconds, 0 if it's not
+  /// known.
+  double segment_duration = 0.;
+  /// Number of bytes probed to find stream parameters, 0 for a default of
+  /// the stream type.
+  uint32_t probe_size = 0;
+  /// How far into the stream its parameters are probed in microseconds, 0
+  /// for a default.
+  int64_t analyze_duration = 0;
+};
+
 /// @class StreamDemuxer
 /// @brief An interface for demuxing modules.
 /// This interface provides methods used to parse data of media container and
@@ -162,11 +344,21 @@ class StreamDemuxer {
 
   /// @enum InitMode
   /// Describes how <code>StreamDemuxer</code> should be initialized.
+  /// <code>kFullInitialization</code> probes the stream to discover its
+  /// configuration, <code>kSkipInitCodecData</code> doesn't report any
+  /// configuration and <code>kFastInitialization</code> reports configuration
+  /// based only on the codec parameters found in the initialization segment
+  /// (probing is done only if these are not sufficient).
   enum InitMode {
     kFullInitialization = 0,
     kSkipInitCodecData = 1,
+    kFastInitialization = 2,
   };
 
+  /// A batch of demuxed packets.
+  /// @see StreamDemuxer::SetEsPacketsListener
+  typedef std::vector<std::unique_ptr<ElementaryStreamPacket>> PacketBatch;
+
   /// Creates <code>StreamDemuxer</code> for given StreamDemuxer::Type.
   /// @param[in] instance An <code>InstanceHandle</code> identifying
   /// Native Player object.
@@ -174,10 +366,17 @@ class StreamDemuxer {
   /// requested to create <code>StreamDemuxer</code> to create.
   /// @param[in] init_mode A <code>StreamDemuxer::InitMode</code> identifying
   /// a demuxer initialization mode.
+  /// @param[in] options A <code>DemuxerOptions</code> describing the stream.
   ///
   /// @return StreamDemuxer constructed with given params.
   static std::unique_ptr<StreamDemuxer> Create(
-      const pp::InstanceHandle& instance, Type type, InitMode init_mode);
+      const pp::InstanceHandle& instance, Type type, InitMode init_mode,
+      const DemuxerOptions& options = DemuxerOptions());
+
+  /// Returns CPU time used by all demuxers to parse data so far.
+  ///
+  /// @return CPU time in seconds.
+  static double GetCpuTime();
 
   /// Constructs an empty <code>StreamDemuxer</code>.
   StreamDemuxer() {}
@@ -204,6 +403,11 @@ class StreamDemuxer {
   /// Performs flush operation on StreamDemuxer. All demuxed elementary stream
   /// packets have to be erased, in order to prepare <code>StreamDemuxer</code>
   /// to receive data from container.
+  ///
+  /// @note Data passed to StreamDemuxer::Parse after a flush must start with
+  ///   an initialization segment, like the data passed after
+  ///   StreamDemuxer::Init. Configurations which were already reported via
+  ///   registered listeners are not reported again.
   virtual void Flush() = 0;
 
   /// Performs parse operation. Passed data should be parsed or added to
@@ -216,6 +420,16 @@ class StreamDemuxer {
   /// @param[in] data An byte array which helds data of media container.
   virtual void Parse(const std::vector<uint8_t>& data) = 0;
 
+  /// Performs parse operation taking over ownership of passed data. Demuxers
+  /// which queue data for parsing should override this method to avoid
+  /// copying the container data.
+  ///
+  /// @param[in] data An byte array which helds data of media container.
+  /// @see StreamDemuxer::Parse(const std::vector<uint8_t>&)
+  virtual void Parse(std::vector<uint8_t>&& data) {
+    Parse(static_cast<const std::vector<uint8_t>&>(data));
+  }
+
   /// Registers a callback function which is called every time audio
   /// configuration has changed and pass new configuration.
   ///
@@ -250,13 +464,79 @@ class StreamDemuxer {
       void(const std::string& type, const std::vector<uint8_t>& init_data)>&
                                           callback) = 0;
 
+  /// Registers a callback function which receives demuxed packets in batches,
+  /// instead of one by one via the callback registered in StreamDemuxer::Init.
+  /// Packets of a batch have the same type (StreamDemuxer::Message::kAudioPkt
+  /// or StreamDemuxer::Message::kVideoPkt) and are in demuxing order. Other
+  /// messages are still passed to the callback registered in Init.
+  ///
+  /// @param[in] callback A function which is registered in StreamDemuxer.
+  /// Callback should be called on callback_dispatcher MessageLoop registered
+  /// in StreamDemuxer::Init.
+  /// @return True if demuxer delivers packets in batches, false otherwise.
+  virtual bool SetEsPacketsListener(
+      const std::function<void(Message, PacketBatch)>& callback) {
+    return false;
+  }
+
   /// Sets time stamp to demuxed packets. Can be use after performing
   /// seek operation on elementary stream to set proper timestamps of packets.
   virtual void SetTimestamp(Samsung::NaClPlayer::TimeTicks) = 0;
 
+  /// Sets an offset which is added to timestamps of packets demuxed from data
+  /// passed to StreamDemuxer::Parse afterwards. It's used when media
+  /// timestamps start anew, e.g. in each period of a DASH presentation.
+  /// @return True if demuxer supports timestamp offsets, false otherwise.
+  virtual bool SetTimestampOffset(Samsung::NaClPlayer::TimeTicks) {
+    return false;
+  }
+
+  /// Checks if an initialization segment of another representation can be
+  /// passed to StreamDemuxer::Parse in the middle of the stream, followed by
+  /// media segments of that representation, without creating a new demuxer.
+  /// Stream configuration is reported again only if it changes.
+  /// @return True if demuxer supports bitstream switching, false otherwise.
+  virtual bool CanSwitchBitstream() const {
+    return false;
+  }
+
+  /// Gets a number of bytes passed to StreamDemuxer::Parse which are queued
+  /// and not demuxed yet. Demuxers which parse synchronously queue nothing.
+  /// It can be called on any thread.
+  virtual size_t QueuedBytes() const {
+    return 0;
+  }
+
+  /// Passes @codecs of the stream given by the DASH manifest, e.g.
+  /// "avc1.640028" or "mp4a.40.2". Demuxers use it to complete a
+  /// configuration which the initialization segment doesn't fully describe,
+  /// instead of probing the stream. It must be called before
+  /// StreamDemuxer::Parse. Ignored by default.
+  virtual void SetCodecs(const std::string&) {}
+
+  /// Makes StreamDemuxer stop parsing as soon as possible, dropping data which
+  /// isn't parsed yet and packets which aren't delivered yet. Demuxers which
+  /// parse on a thread of their own otherwise finish parsing queued data
+  /// before they are destroyed, which is not needed e.g. when a seek makes
+  /// the data obsolete. Only destruction is expected afterwards.
+  virtual void Abort() {}
+
   /// Closes StreamDemuxer. Clear all data, stream configurations.
   /// StreamDemuxer::Init should be called, before using it again.
   virtual void Close() = 0;
+
+ protected:
+  /// Returns CPU time used by the calling thread so far, in seconds.
+  static double GetThreadCpuTime();
+
+  /// Adds CPU time used to parse data to the total returned by
+  /// StreamDemuxer::GetCpuTime.
+  static void AddCpuTime(double seconds);
+
+  /// Returns a new id for <code>demux_id</code> of configurations and
+  /// packets of a demuxer. Ids are unique among all demuxers of the module,
+  /// whatever their implementation, and can be taken on any thread.
+  static int NextDemuxId();
 };
 
 #endif  // NATIVE_PLAYER_SRC_DEMUXER_STREAM_DEMUXER_H_
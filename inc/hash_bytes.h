@@ -0,0 +1,44 @@
+/*!
+ * hash_bytes.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ *
+ * @brief
+ * A 64-bit FNV-1a hash of bytes. Unlike std::hash, it's the same on every
+ * platform and toolchain, so it can also name files kept across sessions.
+ */
+
+#ifndef NATIVE_PLAYER_INC_HASH_BYTES_H_
+#define NATIVE_PLAYER_INC_HASH_BYTES_H_
+
+#include <cstddef>
+#include <cstdint>
+
+constexpr uint64_t kHashBytesSeed = 14695981039346656037ULL;
+
+// Hashes size bytes, continuing from hash, so data in several parts can be
+// hashed as a whole.
+inline uint64_t HashBytes(const void* data, std::size_t size,
+                          uint64_t hash = kHashBytesSeed) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (std::size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+#endif  // NATIVE_PLAYER_INC_HASH_BYTES_H_
@@ -25,9 +25,13 @@
 #define COMMON_SRC_LOGGER_H_
 
 #include <stdarg.h>
+#include <stdint.h>
+#include <atomic>
 #include <string>
+#include <vector>
 
 #include "ppapi/cpp/instance.h"
+#include "ppapi/utility/threading/lock.h"
 
 enum class LogLevel {
   kNone = 0,
@@ -39,17 +43,58 @@ enum class LogLevel {
   kMaxLevel = kDebug,
 };
 
+/**
+ * Modules which logs can be filtered separately. A source file selects its
+ * category by defining LOG_CATEGORY before including any headers, e.g.
+ * <code>#define LOG_CATEGORY LogCategory::kDemuxer</code>. Files which
+ * don't are logged in the kGeneral category.
+ */
+enum class LogCategory {
+  kGeneral = 0,
+  kDash,
+  kDemuxer,
+  kPackets,
+  kDrm,
+  kNet,
+  kCommunicator,
+
+  kCount,
+};
+
+/**
+ * Logs of levels above LOG_MAX_LEVEL are compiled out by LOG_* macros (see
+ * common.h), together with evaluation of their arguments. Release builds
+ * drop debug logs unless DEBUG_LOGS is defined; the threshold can also be
+ * set explicitly with -DLOG_MAX_LEVEL=<0-3>.
+ */
+#ifndef LOG_MAX_LEVEL
+#if defined(NDEBUG) && !defined(DEBUG_LOGS)
+#define LOG_MAX_LEVEL 2
+#else
+#define LOG_MAX_LEVEL 3
+#endif
+#endif
+
+constexpr LogLevel kCompiledLogLevel = static_cast<LogLevel>(LOG_MAX_LEVEL);
+
 /**
  * Utility class that simplifies sending log messages by PostMessage to JS.
  */
 class Logger {
  public:
   /**
-   * Initializes the pp::Instance pointer, so that the Logger could post
-   * messages to JS.
+   * Registers an instance, so that the Logger could post messages to JS.
+   * Logs are posted to the oldest registered instance, there are no logs of
+   * particular instances.
    */
   static void InitializeInstance(pp::Instance* instance);
 
+  /**
+   * Unregisters an instance which is about to be destroyed. Logs posted at
+   * the same time are completed before it returns.
+   */
+  static void ReleaseInstance(pp::Instance* instance);
+
   /**
    * Adds an info prefix and a newline character at the end to the passed string
    * and sends it to JS.
@@ -95,29 +140,72 @@ class Logger {
    */
   static void SetStdLogLevel(LogLevel level);
 
+  /**
+   * Limits logs of a category to the given level, in addition to JS and stdout
+   * levels. Initially all categories are limited to LogLevel::kMaxLevel only.
+   */
+  static void SetCategoryLogLevel(LogCategory category, LogLevel level);
+
+  /**
+   * Finds a category by its name, e.g. "demuxer". Returns false when there is
+   * no such category.
+   */
+  static bool GetCategoryByName(const std::string& name,
+                                LogCategory* category);
+
+  /**
+   * Used by LOG_EVERY_MS. Returns true when at least interval_ms passed since
+   * last_log_ms (or it's negative) and updates it, so only one of concurrent
+   * callers logs.
+   */
+  static bool ShouldLogEveryMs(std::atomic<int64_t>* last_log_ms,
+                               int64_t interval_ms);
+
+  /**
+   * Checks if logs of the given level and category would be sent anywhere, so
+   * callers can skip formatting them.
+   */
+  static bool IsEnabled(LogLevel level,
+                        LogCategory category = LogCategory::kGeneral) {
+    return level <= kCompiledLogLevel &&
+           level <= category_log_levels_[static_cast<int>(category)] &&
+           IsOutputEnabled(level);
+  }
+
  private:
   /**
-   * Internal wrappers for printing to PostMessage with specified prefix.
+   * A lock-free queue of log records, drained by a logging thread which
+   * prefixes messages and sends them to JS and stdout.
+   */
+  class LogQueue;
+
+  static LogQueue* GetQueue();
+
+  /**
+   * Internal wrappers which format a message on the calling thread and queue
+   * it for printing. line, func and file may be omitted (0 and nullptr).
    */
-  static void InternalPrint(LogLevel, const char* std_prefix,
-                            const char* message);
-  static void InternalPrint(LogLevel, const char* std_prefix,
-                            const char* message_format, va_list arguments_list);
   static void InternalPrint(int line, const char* func, const char* file,
                             LogLevel, const char* message_format,
                             va_list arguments_list);
-  static void InternalPrint(LogLevel level, const std::string& message) {
-    InternalPrint(level, nullptr, message.c_str());
-  }
+  static void InternalPrint(LogLevel level, const std::string& message);
 
-  static bool IsLoggingEnabled() {
-    return std_log_level_ != LogLevel::kNone ||
-           js_log_level_ != LogLevel::kNone;
+  /**
+   * Sends a message to PostMessage and stdout, called on the logging thread.
+   */
+  static void Print(LogLevel, const char* std_prefix, const char* message);
+
+  static bool IsOutputEnabled(LogLevel level) {
+    return level <= js_log_level_ || level <= std_log_level_;
   }
 
-  static pp::Instance* instance_;
+  // Instances in order of registration, guarded by GetInstancesLock().
+  static std::vector<pp::Instance*>* GetInstances();
+  static pp::Lock* GetInstancesLock();
+
   static LogLevel js_log_level_;
   static LogLevel std_log_level_;
+  static LogLevel category_log_levels_[static_cast<int>(LogCategory::kCount)];
 };
 
 #endif  // COMMON_SRC_LOGGER_H_
@@ -0,0 +1,128 @@
+/*!
+ * main_thread_budget.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ *
+ * @brief
+ * Accounting of work done on the main thread and of messages posted to JS,
+ * which compete with rendering of the UI, against a budget per frame.
+ */
+
+#ifndef NATIVE_PLAYER_INC_MAIN_THREAD_BUDGET_H_
+#define NATIVE_PLAYER_INC_MAIN_THREAD_BUDGET_H_
+
+#include <stdint.h>
+#include <array>
+#include <chrono>
+
+/**
+ * Kinds of accounted work.
+ */
+enum class MainThreadWork : int32_t {
+  // Handling messages from JS.
+  kHandleMessage,
+  // Posting player messages to JS.
+  kSendMessages,
+  // Posting logs to JS.
+  kForwardLogs,
+  kCount
+};
+
+/**
+ * Sums time of work on the main thread and of PostMessage() traffic in
+ * frames of the UI. When work in the current frame exceeds the budget,
+ * deferrable work (log forwarding, metrics) should be shed or coalesced
+ * until the next frame. It's thread safe.
+ */
+class MainThreadBudget {
+ public:
+  struct Report {
+    // Time of work of each kind, in seconds.
+    std::array<double, static_cast<size_t>(MainThreadWork::kCount)> time;
+    // Messages posted to JS by work of each kind.
+    std::array<uint64_t, static_cast<size_t>(MainThreadWork::kCount)>
+        messages;
+    // Frames in which the budget was exceeded.
+    uint32_t frames_over_budget;
+    // Messages dropped or deferred because of the budget.
+    uint64_t shed_messages;
+  };
+
+  // Length of a frame, the UI is rendered at 60 fps.
+  static constexpr double kFrameDuration = 1. / 60.;  // in seconds
+  // A quarter of a frame.
+  static constexpr double kDefaultBudget = 0.004;  // in seconds
+
+  /**
+   * Sets a time of work allowed in a frame, 0 disables shedding.
+   */
+  static void SetBudget(double seconds);
+
+  /**
+   * Accounts work which took the given time and posted messages.
+   */
+  static void AddWork(MainThreadWork work, double seconds,
+                      uint32_t messages = 0);
+
+  /**
+   * Checks if work in the current frame exceeded the budget, so deferrable
+   * work should wait.
+   */
+  static bool IsOverBudget();
+
+  /**
+   * Counts messages which were dropped or deferred because of the budget.
+   */
+  static void AddShedMessages(uint32_t messages);
+
+  /**
+   * Returns counters since the module was loaded. The main thread is shared
+   * by all players, so a player reports the difference from a report taken
+   * when it loaded its content, see GetReportSince().
+   */
+  static Report GetReport();
+
+  /**
+   * Returns counters accumulated since base was taken with GetReport().
+   */
+  static Report GetReportSince(const Report& base);
+};
+
+/**
+ * Accounts work done in its scope.
+ */
+class ScopedMainThreadWork {
+ public:
+  explicit ScopedMainThreadWork(MainThreadWork work, uint32_t messages = 0)
+      : work_(work),
+        messages_(messages),
+        start_(std::chrono::steady_clock::now()) {}
+
+  ~ScopedMainThreadWork() {
+    MainThreadBudget::AddWork(work_, std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start_).count(), messages_);
+  }
+
+ private:
+  ScopedMainThreadWork(const ScopedMainThreadWork&) = delete;
+  ScopedMainThreadWork& operator=(const ScopedMainThreadWork&) = delete;
+
+  MainThreadWork work_;
+  uint32_t messages_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+#endif  // NATIVE_PLAYER_INC_MAIN_THREAD_BUDGET_H_
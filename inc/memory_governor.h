@@ -0,0 +1,141 @@
+/*!
+ * memory_governor.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ *
+ * @brief
+ * A budget of memory held by the playback pipeline, which components
+ * register their usage with and adapt to.
+ */
+
+#ifndef NATIVE_PLAYER_INC_MEMORY_GOVERNOR_H_
+#define NATIVE_PLAYER_INC_MEMORY_GOVERNOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <string>
+
+/**
+ * Parts of the pipeline which hold memory.
+ */
+enum class MemoryConsumer : int32_t {
+  // Downloaded segments waiting to be passed on in order.
+  kSegments,
+  // Data waiting for demuxers and their AVIO buffers.
+  kDemuxers,
+  // Demuxed packets waiting to be appended.
+  kPackets,
+  // Segment caches.
+  kSegmentCache,
+  // Parsed manifests, estimated from sizes of their documents.
+  kManifest,
+  kCount
+};
+
+enum class MemoryPressure : int32_t {
+  kNone,
+  // Deferrable memory should be reduced: prefetch and caches are limited.
+  kModerate,
+  // Only memory needed to keep playing should be held.
+  kCritical
+};
+
+/**
+ * Sums memory registered by components of all players and compares it with
+ * a budget for the device. Pressure is the higher of the one derived from
+ * usage (moderate from kModerateUsage of the budget, critical above it) and
+ * the one signalled by the platform. Components check it when they decide
+ * to buffer, prefetch or cache more data; listeners are notified when the
+ * platform signal or the budget changes, so caches can shrink right away.
+ * It's thread safe.
+ */
+class MemoryGovernor {
+ public:
+  // Fits a player on TVs with 1.5 GB of RAM, next to the application.
+  static constexpr size_t kDefaultBudget = 192 * 1024 * 1024;
+  // Usage from which pressure is moderate, as a fraction of the budget.
+  static constexpr double kModerateUsage = 0.75;
+
+  static void SetBudget(size_t bytes);
+  static size_t GetBudget();
+
+  /**
+   * Sets pressure signalled by the platform, e.g. a low memory warning
+   * forwarded by the application.
+   */
+  static void SetPlatformPressure(MemoryPressure pressure);
+
+  static MemoryPressure GetPressure();
+
+  /**
+   * Gets a pressure level by its name: "none", "moderate" or "critical".
+   * Returns false if there is no such level.
+   */
+  static bool GetPressureByName(const std::string& name,
+                                MemoryPressure* pressure);
+
+  static size_t GetUsage(MemoryConsumer consumer);
+  static size_t GetTotalUsage();
+
+  /**
+   * Scales a limit of deferrable memory, e.g. a buffer or a cache size, to
+   * the current pressure: a half of it under moderate pressure, a quarter
+   * under critical.
+   */
+  static size_t ScaleLimit(size_t limit);
+
+  /**
+   * Adds a function called with the new pressure when the platform signal
+   * or the budget changes. It's called on the thread which changed it and
+   * mustn't add or remove listeners. Returns an id for
+   * RemovePressureListener(), which waits for a call in progress.
+   */
+  static int32_t AddPressureListener(
+      std::function<void(MemoryPressure)> listener);
+  static void RemovePressureListener(int32_t id);
+
+ private:
+  friend class MemoryUsage;
+
+  static void AddUsage(MemoryConsumer consumer, int64_t bytes);
+  static void NotifyListeners();
+};
+
+/**
+ * Registers memory held by its owner with the MemoryGovernor, for its
+ * lifetime. It's thread safe, so owners can update it from any thread.
+ */
+class MemoryUsage {
+ public:
+  explicit MemoryUsage(MemoryConsumer consumer);
+  ~MemoryUsage();
+
+  void Set(size_t bytes);
+  void Add(size_t bytes);
+  void Remove(size_t bytes);
+  size_t bytes() const { return bytes_; }
+
+ private:
+  MemoryUsage(const MemoryUsage&) = delete;
+  MemoryUsage& operator=(const MemoryUsage&) = delete;
+
+  MemoryConsumer consumer_;
+  std::atomic<size_t> bytes_;
+};
+
+#endif  // NATIVE_PLAYER_INC_MEMORY_GOVERNOR_H_
@@ -38,6 +38,12 @@
 /// @class NativePlayer
 /// This is a main class for this application. It holds a classes responsible
 /// for communication and for controlling the player.
+///
+/// Each <code>embed</code> element of the module is a separate instance with
+/// a player of its own, so several players can be shown at once (e.g. a
+/// mosaic or picture in picture). Messages of a player are exchanged with
+/// its element. Network workers, caches and the memory budget are shared by
+/// players of all instances.
 
 class NativePlayer : public pp::Instance {
  public:
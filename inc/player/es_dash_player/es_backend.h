@@ -0,0 +1,97 @@
+/*!
+ * es_backend.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_ES_BACKEND_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_ES_BACKEND_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "nacl_player/elementary_stream_listener.h"
+
+#include "common.h"
+#include "demuxer/elementary_stream_packet.h"
+#include "demuxer/stream_demuxer.h"
+
+/// @file
+/// @brief This file defines the <code>EsBackend</code> interface.
+
+/// @class EsBackend
+/// This interface is the consumer side of the elementary stream pipeline,
+/// i.e. what <code>StreamManager</code> feeds with configurations and
+/// packets. <code>NaClEsBackend</code> passes them to NaCl Player through
+/// <code>Samsung::NaClPlayer::ESDataSource</code>, while
+/// <code>RecordingEsBackend</code> only counts them, so downloading,
+/// demuxing and packet scheduling can be run and profiled without the
+/// player.
+///
+/// Methods return <code>Samsung::NaClPlayer::ErrorCodes</code> values.
+///
+/// @see class <code>StreamManager</code>
+/// @see class <code>NaClEsBackend</code>
+/// @see class <code>RecordingEsBackend</code>
+
+class EsBackend {
+ public:
+  /// @class Stream
+  /// A single elementary stream added to the backend.
+  class Stream {
+   public:
+    virtual ~Stream();
+
+    /// Configures the stream and marks its initialization as done.
+    virtual int32_t SetConfig(const AudioConfig& audio_config) = 0;
+    virtual int32_t SetConfig(const VideoConfig& video_config) = 0;
+
+    /// Appends a packet, encrypted or not. The packet stays owned by the
+    /// caller.
+    virtual int32_t AppendPacket(const ElementaryStreamPacket& packet) = 0;
+
+    virtual int32_t SetDrmInitData(const std::string& type,
+                                   const std::vector<uint8_t>& init_data) = 0;
+  };
+
+  virtual ~EsBackend();
+
+  /// Adds a stream of the given type.
+  ///
+  /// @param[in] type A type of the stream.
+  /// @param[in] listener A listener notified when the backend needs data,
+  ///   has enough of it or seeks.
+  /// @param[out] stream The added stream, set only on success.
+  virtual int32_t AddStream(
+      StreamType type,
+      std::shared_ptr<Samsung::NaClPlayer::ElementaryStreamListener> listener,
+      std::shared_ptr<Stream>* stream) = 0;
+
+  virtual int32_t SetDuration(Samsung::NaClPlayer::TimeTicks duration) = 0;
+
+  /// Signals that all streams reached their ends.
+  virtual int32_t SetEndOfStream() = 0;
+
+  /// Sets a speed of a continuous playback, 1 being the normal one. NaCl
+  /// Player has no playback rate control, so by default only 1 is accepted.
+  ///
+  /// @param[in] rate A playback rate.
+  /// @return Whether the backend plays at the given rate.
+  virtual bool SetPlaybackRate(double rate);
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_ES_BACKEND_H_
@@ -22,6 +22,10 @@
 #define NATIVE_PLAYER_INC_PLAYER_ES_DASH_PLAYER_ES_DASH_PLAYER_CONTROLLER_H_
 
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -38,11 +42,26 @@
 #include "dash/dash_manifest.h"
 #include "player/es_dash_player/packets_manager.h"
 #include "player/es_dash_player/stream_manager.h"
+#include "player/es_dash_player/task_executor.h"
 #include "player/player_controller.h"
 #include "player/player_listeners.h"
+#include "tuning_profile.h"
 #include "communicator/message_sender.h"
 
+class AbrEngine;
 class DrmPlayReadyListener;
+class BandwidthEstimator;
+class ContentSteering;
+class DownloadArbiter;
+class DrmMetrics;
+class LatencyTimeline;
+class PlatformHealth;
+class NetworkExecutor;
+class PipelineLatency;
+class PlaybackMetrics;
+class PreloadedMedia;
+class TextStreamManager;
+class ThumbnailProvider;
 
 /// @file
 /// @brief This file defines the <code>EsDashPlayerController</code> class.
@@ -93,27 +112,22 @@ class EsDashPlayerController : public PlayerController,
   ///   which will be used to send messages through the communication channel.
   ///
   /// @see EsDashPlayerController::InitPlayer()
-  EsDashPlayerController(const pp::InstanceHandle& instance,
-                   std::shared_ptr<Communication::MessageSender> message_sender)
-      : PlayerController(),
-        instance_(instance),
-        cc_factory_(this),
-        subtitles_visible_(true),
-        seeking_(false),
-        media_duration_(0.),
-        message_sender_(message_sender),
-        state_(PlayerState::kUnitialized) {}
+  EsDashPlayerController(
+      const pp::InstanceHandle& instance,
+      std::shared_ptr<Communication::MessageSender> message_sender);
 
   /// Destroys an <code>EsDashPlayerController</code> object. This also
   /// destroys a <code>MediaPlayer</code> object and thus a player pipeline.
-  ~EsDashPlayerController() override {};
+  ~EsDashPlayerController() override;
 
   /// Initializes NaCl Player and prepares it to play a given content.
   /// Subtitles information may also be passed to this function to get ready
   /// for a playback with the subtitles.
   ///
   /// This method can be called several times to change a multimedia content
-  /// that should be played with NaCl Player.
+  /// that should be played with NaCl Player. NaCl Player created by the
+  /// first call is reused then, unless it failed or didn't load its media
+  /// yet, and only the data source is replaced.
   ///
   /// @param[in] url An address of a DASH manifest file to be prepared for a
   ///   playback in NaCl Player.
@@ -139,13 +153,84 @@ class EsDashPlayerController : public PlayerController,
                   const std::unordered_map<std::string, std::string>&
                           drm_key_request_properties);
 
+  /// Makes the player start from a title prepared in the background, e.g.
+  /// while the previous one played, if <code>InitPlayer()</code> is called
+  /// for its URL. Its manifest and segments are used instead of downloading
+  /// them again. Must be called before <code>InitPlayer()</code>.
+  ///
+  /// @param[in] media A title prepared by <code>DashPreloader</code>.
+  void SetPreloadedMedia(std::shared_ptr<PreloadedMedia> media);
+
+  /// Captures what a player needs to continue this playback when the
+  /// application is suspended: the parsed manifest with its segment
+  /// indexes, segments cached by streams (init segments included), the
+  /// playback position, representations and the bandwidth estimate. A player
+  /// given it with <code>SetPreloadedMedia()</code> starts from there without
+  /// downloading nor parsing the manifest again.
+  ///
+  /// @return A title to be kept by <code>DashPreloader</code>, or null if
+  ///   nothing is played.
+  std::shared_ptr<PreloadedMedia> CreateResumeState();
+
+  /// Makes the next <code>InitPlayer()</code> start the playback at the
+  /// given position, e.g. to continue watching. Streams start downloading
+  /// from the segments of the position, so nothing before it is downloaded
+  /// nor demuxed. It's ignored for dynamic presentations, which start at
+  /// the live edge. Must be called before <code>InitPlayer()</code>.
+  ///
+  /// @param[in] start_time A position in seconds, 0 starts at the beginning.
+  void SetStartTime(Samsung::NaClPlayer::TimeTicks start_time);
+
+  /// Makes the player run network requests, i.e. downloads, license
+  /// requests and manifest loading, with the given executor, e.g. one on
+  /// workers shared with other players, instead of starting workers of its
+  /// own. Must be called before <code>InitPlayer()</code>.
+  ///
+  /// @param[in] executor An executor to be used by this player.
+  void SetNetworkExecutor(std::shared_ptr<NetworkExecutor> executor);
+
+  /// Makes tasks of the player thread, i.e. buffer updates, watchdogs and
+  /// download deadline checks, and the clock of ABR and metrics intervals
+  /// use the given executor instead of the message loop of the player
+  /// thread and the steady clock. With a <code>SimulatedExecutor</code>
+  /// these timing decisions run deterministically in virtual time. Must be
+  /// called before <code>InitPlayer()</code>.
+  ///
+  /// @param[in] executor An executor to be used, or null for the default.
+  void SetTaskExecutor(std::shared_ptr<TaskExecutor> executor);
+
+  /// Makes the player read the playback position from source instead of
+  /// NaCl Player, e.g. to drive buffering with a simulated playback. Must
+  /// be called before <code>InitPlayer()</code>.
+  ///
+  /// @param[in] source A function returning the playback position, or an
+  ///   empty function for the default.
+  void SetPlaybackTimeSource(
+      std::function<Samsung::NaClPlayer::TimeTicks()> source);
+
+  /// Frees memory of a paused playback: segments and packets buffered by
+  /// streams are dropped and demuxers are destroyed, which lets their
+  /// threads exit. Only the segments at the playback position stay
+  /// downloaded, so playback resumes quickly, with demuxers created from
+  /// cached initialization segments. It's called when playback stays paused
+  /// for long or the application is hidden and does nothing unless the
+  /// playback is paused. Must be called on the main thread.
+  void Trim();
+
   // Overloaded methods defined by PlayerController, don't have to be commented
   void Play() override;
   void Pause() override;
   void Seek(Samsung::NaClPlayer::TimeTicks to_time) override;
+  void PreviewSeek(Samsung::NaClPlayer::TimeTicks to_time) override;
+  void SetPlaybackRate(double rate) override;
+  void EnqueueMedia(const std::string& url) override;
   void ChangeRepresentation(StreamType stream_type, int32_t id) override;
   void SetViewRect(const Samsung::NaClPlayer::Rect& view_rect) override;
   void PostTextTrackInfo() override;
+  void PostMetrics() override;
+  void SetMetricsInterval(double interval) override;
+  void SetVisible(bool visible) override;
+  void SetAudioOnly(bool audio_only) override;
   void ChangeSubtitles(int32_t id) override;
   void ChangeSubtitleVisibility() override;
   PlayerState GetState() override;
@@ -153,14 +238,32 @@ class EsDashPlayerController : public PlayerController,
  private:
   /// @public
   /// Checks every stream if there is enough data buffered. If not, initiates
-  /// data download. This method reschedules a call to itself on the side
-  /// player thread.
+  /// data download. It's run on the side player thread when something that
+  /// affects buffers happens (see <code>ScheduleBufferUpdate()</code>) and
+  /// schedules <code>OnBufferWatchdog()</code> in case nothing does.
   ///
   /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
   ///   PP_OK is an expected value .
   /// @see StreamManager::UpdateBuffer()
   void UpdateStreamsBuffer(int32_t /*result*/);
 
+  /// @public
+  /// Posts <code>UpdateStreamsBuffer()</code> to the player thread, unless
+  /// it's posted already. Called on any thread on events which affect
+  /// buffers: a segment was received, packets were demuxed, the player needs
+  /// or has enough data or playback time changed.
+  void ScheduleBufferUpdate();
+
+  /// @public
+  /// Runs <code>UpdateStreamsBuffer()</code> if it didn't run since this call
+  /// was scheduled, so buffers are updated periodically even without events.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] update_count A value of <code>buffer_update_count_</code> at
+  ///   the time this call was scheduled.
+  void OnBufferWatchdog(int32_t /*result*/, uint32_t update_count);
+
   /// @public
   /// An event handler method that should be called both when configuration for
   /// the stream is set for the first time and when configuration is changed
@@ -174,7 +277,174 @@ class EsDashPlayerController : public PlayerController,
   /// Marks end of configuration of all media streams.
   void FinishStreamConfiguration();
 
-  void OnChangeRepresentation(int32_t /*result*/, StreamType type, int32_t id);
+  /// @public
+  /// Switches a stream to the given representation. Segments it has buffered
+  /// are downloaded again in the new representation if
+  /// <code>replace_buffered</code> is set.
+  void OnChangeRepresentation(int32_t /*result*/, StreamType type, int32_t id,
+                              bool replace_buffered = false);
+
+  /// @public
+  /// Handles a representation change requested through the communication
+  /// channel. A chosen representation disables automatic selection for the
+  /// stream, a negative <code>id</code> enables it again.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] type A type of the stream.
+  /// @param[in] id An id of the representation or -1.
+  void OnSelectRepresentation(int32_t /*result*/, StreamType type,
+                              int32_t id);
+
+  /// @public
+  /// Switches representations of streams which are selected automatically,
+  /// if <code>AbrEngine</code> decides so. Called periodically on the player
+  /// thread.
+  ///
+  /// @param[in] playback_time A current playback position.
+  void AdaptRepresentations(Samsung::NaClPlayer::TimeTicks playback_time);
+
+  /// @public
+  /// Limits automatically selected video representations below the current
+  /// one if <code>PlatformHealth</code> finds the device doesn't keep up
+  /// with it, so ABR steps down even if the bandwidth is enough. Called on
+  /// the player thread.
+  void LimitOverloadedVideo();
+
+  /// @public
+  /// Moves a low-latency live playback closer to the live edge when it
+  /// drifts away from the target latency. Called periodically on the player
+  /// thread.
+  ///
+  /// @param[in] playback_time A current playback position.
+  void CatchUpLiveEdge(Samsung::NaClPlayer::TimeTicks playback_time);
+
+  /// @public
+  /// Seeks towards the live edge on the main thread.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] time A position to seek to.
+  void OnLiveCatchUpSeek(int32_t /*result*/,
+                         Samsung::NaClPlayer::TimeTicks time);
+
+  /// @public
+  /// Recovers pipeline stages which make no progress for longer than a
+  /// stall timeout of the streams: ends a seek which keeps dropping packets
+  /// without finding where to start and replaces a stalled demuxer, seeking
+  /// to the playback position. Stalled downloads are retried by
+  /// <code>AsyncDataProvider</code> itself. Called periodically on the
+  /// player thread.
+  ///
+  /// @param[in] playback_time A current playback position.
+  void RecoverStalls(Samsung::NaClPlayer::TimeTicks playback_time);
+
+  /// @public
+  /// Downloads in advance the audio segment a switch to the language the
+  /// user is likely to choose next would start with, and limits appended
+  /// audio so the switch is heard soon (see <code>languageSwitchAhead</code>
+  /// of <code>TuningProfile</code>). The language is the most recent one
+  /// in <code>LanguageHistory</code> other than the current one, or the
+  /// only other language of the content. Called periodically on the player
+  /// thread.
+  ///
+  /// @param[in] playback_time A current playback position.
+  void PrebufferAlternateLanguage(Samsung::NaClPlayer::TimeTicks playback_time);
+
+  /// @public
+  /// Seeks to the playback position on the main thread, so streams with a
+  /// stalled demuxer start over with a new one.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] time A position to seek to.
+  void OnStallRecoverySeek(int32_t /*result*/,
+                           Samsung::NaClPlayer::TimeTicks time);
+
+  /// @public
+  /// Limits resolution of video representations chosen automatically to the
+  /// size of the view, so small views don't download and decode more than
+  /// they can show.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] width A width of the view.
+  /// @param[in] height A height of the view.
+  void OnViewSizeChanged(int32_t /*result*/, int32_t width, int32_t height);
+
+  /// @public
+  /// Adjusts a requested seek position to be within the content and at
+  /// a keyframe, so segments are downloaded from there.
+  ///
+  /// @param[in] time A requested seek position.
+  /// @return A position playback continues from after the seek.
+  Samsung::NaClPlayer::TimeTicks GetSeekTarget(
+      Samsung::NaClPlayer::TimeTicks time);
+
+  /// @public
+  /// Downloads segments needed to start playback at a likely seek position
+  /// to the segment cache of each stream. Called when a seek is queued
+  /// behind another one or when the UI reports a position the user is about
+  /// to seek to.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] time A candidate seek position.
+  void PrefetchSeekTarget(int32_t /*result*/,
+                          Samsung::NaClPlayer::TimeTicks time);
+
+  /// @public
+  /// Starts, changes the speed of or stops a trick mode, in which the player
+  /// is paused and seeks to keyframes ahead or behind in regular intervals.
+  /// Rates between <code>kMinPlaybackSpeed</code> and
+  /// <code>kMaxPlaybackSpeed</code> are played continuously instead, if
+  /// the backend supports them. It must be called on the player thread.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] rate A playback rate, negative values rewind. Values between
+  ///   -1 and 1 return to a normal playback.
+  void OnSetPlaybackRate(int32_t /*result*/, double rate);
+
+  /// @public
+  /// Moves the trick mode position by the playback rate and seeks there.
+  /// Called on the player thread every <code>kTrickPlayStepDelay</code>
+  /// while the trick mode lasts.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] generation A value of <code>trick_play_generation_</code> at
+  ///   the time this call was scheduled, steps of a stopped trick mode are
+  ///   ignored.
+  void OnTrickPlayStep(int32_t /*result*/, uint32_t generation);
+
+  /// @public
+  /// Ends the trick mode at its current position, switching streams back to
+  /// a normal playback. It must be called on the player thread.
+  void StopTrickPlay();
+
+  /// @public
+  /// Seeks to a trick mode position on the main thread.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] time A keyframe position to show.
+  /// @param[in] resume Whether the playback should be resumed after the
+  ///   seek, i.e. the trick mode ended.
+  void OnTrickPlaySeek(int32_t /*result*/, Samsung::NaClPlayer::TimeTicks time,
+                       bool resume);
+
+  /// @public
+  /// Starts a background download of initialization segments of all
+  /// representations of a stream but the current one, so later
+  /// representation changes don't wait for them.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] type A stream type for which segments are downloaded.
+  /// @param[in] current_id An id of the currently used representation.
+  void PrefetchInitSegments(int32_t /*result*/, StreamType type,
+                            uint32_t current_id);
 
   /// @public
   /// Loads a subtitles file. This will enable subtitle text updates to be sent
@@ -200,36 +470,261 @@ class EsDashPlayerController : public PlayerController,
   /// @public
   /// Initializes audio and video streams. This method choses initial
   /// representations for each available stream and initializes DRM if it is
-  /// present.
+  /// present. Segment indexes and initialization segments of all streams are
+  /// downloaded at the same time, streams are initialized when all of them
+  /// are, without blocking the player thread meanwhile.
   ///
   /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
   ///   PP_OK is an expected value.
   void InitializeStreams(int32_t /*result*/);
 
-  void InitializeVideoStream(Samsung::NaClPlayer::DRMType /*drm_type*/);
+  /// @public
+  /// Creates <code>thumbnail_provider_</code> from the image representation
+  /// of the lowest bitrate, if the manifest has any.
+  void InitializeThumbnails();
+
+  /// Schedules a refresh of a dynamic manifest after its minimum update
+  /// period. It can be called on any thread.
+  ///
+  /// @param[in] manifest A manifest to refresh. Refreshing stops when the
+  ///   player doesn't use it anymore.
+  /// @param[in] player_loop A message loop of the player thread.
+  void ScheduleManifestRefresh(const std::shared_ptr<DashManifest>& manifest,
+                               pp::MessageLoop player_loop);
+
+  /// @public
+  /// Downloads segment indexes of the manifest in the background, so
+  /// streams don't wait for them when they start or switch
+  /// representations. Must be called on a network thread.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] manifest A manifest which indexes are loaded.
+  void LoadSegmentIndexesOnWorker(int32_t /*result*/,
+      const std::shared_ptr<DashManifest>& manifest);
+
+  /// @public
+  /// Creates a segment sequence of the given representation in advance, so
+  /// a representation change doesn't wait for it. Must be called on a
+  /// network thread.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] manifest A manifest which describes the representation.
+  /// @param[in] type A type of the stream.
+  /// @param[in] id An id of the representation.
+  void PrepareSequenceOnWorker(int32_t /*result*/,
+      const std::shared_ptr<DashManifest>& manifest, StreamType type,
+      uint32_t id);
+
+  /// @public
+  /// Starts a refresh of the manifest on a network thread, if it's still
+  /// used by the player. Must be called on the player thread.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] manifest A manifest to refresh.
+  void RefreshManifest(int32_t /*result*/,
+                       const std::shared_ptr<DashManifest>& manifest);
+
+  void RefreshManifestOnWorker(int32_t /*result*/,
+                               const std::shared_ptr<DashManifest>& manifest,
+                               pp::MessageLoop player_loop);
 
-  void InitializeAudioStream(Samsung::NaClPlayer::DRMType /*drm_type*/);
+  /// Schedules an update of the pathway priority from a content steering
+  /// server. It can be called on any thread.
+  ///
+  /// @param[in] steering A steering client to update. Updates stop when the
+  ///   player doesn't use it anymore.
+  /// @param[in] player_loop A message loop of the player thread.
+  /// @param[in] delay A delay of the update in seconds, i.e. the TTL of the
+  ///   last steering manifest.
+  void ScheduleSteeringUpdate(const std::shared_ptr<ContentSteering>& steering,
+                              pp::MessageLoop player_loop, double delay);
+
+  /// @public
+  /// Starts a content steering update on a network thread, if the steering
+  /// client is still used by the player. Must be called on the player
+  /// thread.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] steering A steering client to update.
+  void UpdateSteering(int32_t /*result*/,
+                      const std::shared_ptr<ContentSteering>& steering);
+
+  void UpdateSteeringOnWorker(int32_t /*result*/,
+                              const std::shared_ptr<ContentSteering>& steering,
+                              pp::MessageLoop player_loop);
+
+  /// @public
+  /// Adds a DASH manifest to the playlist and starts loading it, unless
+  /// a manifest enqueued before is still loaded. Must be called on the
+  /// player thread.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] url A URL of the DASH manifest file.
+  void OnEnqueueMedia(int32_t /*result*/, const std::string& url);
+
+  /// @public
+  /// Downloads and parses a manifest of the playlist, then passes it to
+  /// <code>AppendManifest()</code> on the player thread. Must be called on
+  /// a network thread.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] url A URL of the DASH manifest file.
+  /// @param[in] player_loop A message loop of the player thread.
+  void LoadPlaylistManifestOnWorker(int32_t /*result*/,
+                                    const std::string& url,
+                                    pp::MessageLoop player_loop);
+
+  /// @public
+  /// Joins the manifest with the played one, so streams continue with its
+  /// segments once segments of the played presentation run out. Streams
+  /// switch to sequences of the joined manifest at the next segment, like on
+  /// a representation change. Then the next manifest of the playlist is
+  /// loaded. Must be called on the player thread.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] manifest A parsed manifest of the playlist, null if it
+  ///   failed to load.
+  void AppendManifest(int32_t /*result*/,
+                      const std::shared_ptr<DashManifest>& manifest);
 
   void OnSetDisplayRect(int32_t /*result*/);
 
   void OnSeek(int32_t /*result*/);
 
+  /// @public
+  /// Trims buffers if playback is still paused since the pause which
+  /// scheduled this call.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] pause_generation A value of <code>pause_generation_</code>
+  ///   at the time this call was scheduled.
+  void OnIdleTrim(int32_t /*result*/, uint32_t pause_generation);
+
+  // Record phases of the startup or of a seek, called on a network thread
+  // and on the main thread.
+  void OnLicenseInstalled();
+  void OnBufferingCompleted();
+  // Counts buffering during playback as a rebuffer, called on the main
+  // thread.
+  void OnBufferingStarted();
+  // Measures the cadence of time updates and updates buffers, called on the
+  // main thread.
+  void OnTimeUpdate();
+  void OnPlayerError(Samsung::NaClPlayer::MediaPlayerError error);
+
+  /// @public
+  /// Posts a QoE event to the player thread, where the state of the
+  /// pipeline is added to it before it's sent. It can be called on any
+  /// thread.
+  ///
+  /// @param[in] event An event with its type, timestamp and, depending on
+  ///   the type, a duration or an error.
+  void PostQoeEvent(std::shared_ptr<Communication::QoeEventData> event);
+
+  void OnQoeEvent(int32_t /*result*/,
+                  const std::shared_ptr<Communication::QoeEventData>& event);
+
+  void OnPostMetrics(int32_t /*result*/);
+
+  void OnSetMetricsInterval(int32_t /*result*/, double interval);
+
   void OnChangeSubtitles(int32_t /*result*/, int32_t id);
 
   void OnChangeSubVisibility(int32_t /*result*/, bool show);
 
+  /// @public
+  /// Creates NaCl Player and sets up its listeners. Called by
+  /// <code>InitPlayer()</code> unless the player is reused.
+  void InitializeMediaPlayer();
+
   void CleanPlayer();
 
+  /// @public
+  /// Drops the state of the played media: streams, the data source, the
+  /// manifest, DRM and tasks posted for them, so other media can be loaded
+  /// with the same NaCl Player. It keeps the network executor and the
+  /// bandwidth estimate as well, as they don't depend on media.
+  void ResetMedia();
+
   void PerformWaitingOperations();
 
   pp::InstanceHandle instance_;
+  // A snapshot of the current TuningProfile taken when the player is
+  // created, used by all its parts and reported in metrics.
+  const TuningProfile tuning_;
   std::unique_ptr<pp::SimpleThread> player_thread_;
+  // Runs tasks of the player thread and provides its clock, set while
+  // player_thread_ is.
+  std::shared_ptr<TaskExecutor> executor_;
+  // Set by SetTaskExecutor(), used as executor_ instead of the message loop
+  // of player_thread_.
+  std::shared_ptr<TaskExecutor> custom_executor_;
+  // Set by SetPlaybackTimeSource(), replaces MediaPlayer::GetCurrentTime().
+  std::function<Samsung::NaClPlayer::TimeTicks()> playback_time_source_;
+  // Runs network requests of streams, the DRM client and manifest loading.
+  std::shared_ptr<NetworkExecutor> network_executor_;
+  // Measures segment downloads of all streams.
+  std::shared_ptr<BandwidthEstimator> bandwidth_estimator_;
+  // Shares segment downloads between audio and video streams.
+  std::shared_ptr<DownloadArbiter> download_arbiter_;
+  // Times phases of the startup and of seeks.
+  std::unique_ptr<LatencyTimeline> latency_timeline_;
+  // Latencies of segments of all streams going through the pipeline.
+  std::unique_ptr<PipelineLatency> pipeline_latency_;
+  // Tells if the device keeps up with video representations of this player.
+  std::unique_ptr<PlatformHealth> platform_health_;
+  // License round trips and encrypted appends of this player.
+  std::unique_ptr<DrmMetrics> drm_metrics_;
+  // Downloads, appends, seeks and rebuffers of this player.
+  std::unique_ptr<PlaybackMetrics> playback_metrics_;
+  // Chooses representations automatically, used on the player thread.
+  std::unique_ptr<AbrEngine> abr_engine_;
+  // Time of the next AdaptRepresentations() decision.
+  TaskExecutor::Clock::time_point next_abr_update_;
+  // Buffer kept ahead of a low-latency live playback, zero otherwise.
+  Samsung::NaClPlayer::TimeTicks live_target_buffer_;
+  // Time after which CatchUpLiveEdge() may seek again.
+  TaskExecutor::Clock::time_point next_live_catch_up_;
+  // Time since which packets of a seek are dropped, the epoch when they
+  // aren't, see RecoverStalls().
+  TaskExecutor::Clock::time_point seek_dropping_since_;
+  // Time after which RecoverStalls() may replace demuxers again.
+  TaskExecutor::Clock::time_point next_stall_recovery_;
+  // Time when metrics are sent to the UI next.
+  TaskExecutor::Clock::time_point next_metrics_report_;
+  // Interval of sending metrics during playback, zero if they are not sent.
+  std::chrono::milliseconds metrics_report_interval_;
+  // Set while UpdateStreamsBuffer() is posted and didn't start yet.
+  std::atomic<bool> buffer_update_scheduled_;
+  // Number of UpdateStreamsBuffer() runs, used on the player thread.
+  uint32_t buffer_update_count_;
+  // The last bandwidth estimate saved for next sessions.
+  double saved_bandwidth_;
+  // Video representations are limited below this bitrate, as the platform
+  // didn't keep up with it (see PlatformHealth), 0 if they aren't.
+  uint32_t device_max_bitrate_;
   pp::CompletionCallbackFactory<EsDashPlayerController> cc_factory_;
 
   PlayerListeners listeners_;
 
   std::shared_ptr<DrmPlayReadyListener> drm_listener_;
   std::shared_ptr<Samsung::NaClPlayer::ESDataSource> data_source_;
+  // Data source of the previous media of a reused player, kept until
+  // data_source_ is attached.
+  std::shared_ptr<Samsung::NaClPlayer::ESDataSource> previous_data_source_;
+  // Set once data_source_ is attached. Streams configured from the manifest
+  // let it happen before they are initialized.
+  bool data_source_attached_;
+  // Feeds data_source_, streams are added through it.
+  std::unique_ptr<EsBackend> es_backend_;
   std::shared_ptr<Samsung::NaClPlayer::MediaPlayer> player_;
   std::unique_ptr<Samsung::NaClPlayer::TextTrackInfo> text_track_;
   std::vector<Samsung::NaClPlayer::TextTrackInfo> text_track_list_;
@@ -243,17 +738,90 @@ class EsDashPlayerController : public PlayerController,
   Samsung::NaClPlayer::Rect view_rect_;
 
   PacketsManager packets_manager_;
-  std::unique_ptr<DashManifest> dash_parser_;
+  std::shared_ptr<DashManifest> dash_parser_;
+  // Set when the manifest uses content steering.
+  std::shared_ptr<ContentSteering> content_steering_;
+  // Used until streams are initialized, on the player thread.
+  std::shared_ptr<PreloadedMedia> preloaded_media_;
   std::array<std::unique_ptr<StreamManager>,
              static_cast<int32_t>(StreamType::MaxStreamTypes)> streams_;
+  // Streams created on startup, moved to streams_ once their sequences and
+  // init segments are loaded.
+  std::array<std::unique_ptr<StreamManager>,
+             static_cast<int32_t>(StreamType::MaxStreamTypes)>
+                 loading_streams_;
   std::vector<VideoStream> video_representations_;
   std::vector<AudioStream> audio_representations_;
+  // Subtitles carried by the manifest, used unless external subtitles are
+  // given. Cues of the chosen one are scheduled by packets_manager_.
+  std::vector<TextStream> text_representations_;
+  std::unique_ptr<TextStreamManager> text_stream_;
+  // Id of the text representation shown or being loaded, -1 if none.
+  int32_t text_representation_id_;
+  // Thumbnails of previewed seek positions, null if the manifest has no
+  // image representations.
+  std::shared_ptr<ThumbnailProvider> thumbnail_provider_;
 
   std::unique_ptr<Samsung::NaClPlayer::TimeTicks> waiting_seek_;
   std::array<std::unique_ptr<int32_t>,
              static_cast<size_t>(StreamType::MaxStreamTypes)>
                  waiting_representation_changes_;
-
+  // Ids of representations used by streams, apart from a trick mode one.
+  std::array<int32_t, static_cast<size_t>(StreamType::MaxStreamTypes)>
+      representation_ids_;
+  // Audio languages the user chose before, loaded with the first audio
+  // representations, and the representation of another language which is
+  // prebuffered, -1 if none. See PrebufferAlternateLanguage().
+  std::vector<std::string> language_history_;
+  bool language_history_loaded_;
+  int32_t alternate_audio_id_;
+  std::shared_ptr<const MediaSegmentSequence> alternate_audio_sequence_;
+
+  // Set while fast forward or rewind is in progress. Trick mode state is
+  // used on the player thread, seeks are made on the main thread.
+  std::atomic<bool> trick_play_;
+  double playback_rate_;
+  // Rate of a continuous playback, 1 unless the backend supports others.
+  double playback_speed_;
+  Samsung::NaClPlayer::TimeTicks trick_play_time_;
+  // Incremented when a trick mode starts or stops.
+  uint32_t trick_play_generation_;
+  // Whether the playback was running when the trick mode started.
+  bool resume_after_trick_play_;
+  // Set when the video stream uses a trick mode representation of the
+  // manifest.
+  bool trick_mode_sequence_used_;
+
+  // Set by Trim() on the main thread until a seek restores buffers, read on
+  // the player thread.
+  std::atomic<bool> trimmed_;
+  // Playback position at which buffers were trimmed.
+  Samsung::NaClPlayer::TimeTicks trim_time_;
+  // Position the loaded media starts at, see SetStartTime().
+  Samsung::NaClPlayer::TimeTicks start_time_;
+  // Set until NaCl Player is moved to start_time_, which needs both the
+  // data source attached and streams initialized.
+  bool start_seek_pending_;
+  // Incremented on each play and pause, used on the main thread.
+  uint32_t pause_generation_;
+  // Whether the application is visible.
+  bool visible_;
+  // Whether the playback was running when the application got hidden.
+  bool resume_when_visible_;
+  // Set on the main thread while only audio is played, the video stream
+  // doesn't download nor demux anything then. Read on the player thread.
+  std::atomic<bool> video_suspended_;
+
+  // URLs of manifests played after the current one, the first of them is
+  // loaded while playlist_loading_ is set. Used on the player thread.
+  std::deque<std::string> playlist_;
+  bool playlist_loading_;
+  // Set when the content is played from offline storage (see OfflineStore),
+  // its licenses are persistent then.
+  bool offline_;
+
+  // A URL of the manifest given to InitPlayer().
+  std::string url_;
   std::string drm_license_url_;
   std::unordered_map<std::string, std::string> drm_key_request_properties_;
 
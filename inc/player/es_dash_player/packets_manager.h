@@ -23,16 +23,25 @@
 #include <common.h>
 
 #include <array>
-#include <queue>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "demuxer/elementary_stream_packet.h"
 #include "demuxer/stream_demuxer.h"
+#include "memory_governor.h"
 #include "nacl_player/media_common.h"
+#include "player/es_dash_player/spsc_queue.h"
 #include "player/es_dash_player/stream_listener.h"
-#include "player/es_dash_player/stream_manager.h"
+#include "player/es_dash_player/stream_sink.h"
+#include "player/es_dash_player/text_track_parser.h"
 #include "ppapi/utility/threading/lock.h"
+#include "tuning_profile.h"
 
-class StreamManager;
+class PlaybackMetrics;
 
 /// @file
 /// @brief This file defines the <code>PacketsManager</code> class.
@@ -40,21 +49,138 @@ class StreamManager;
 /// @class StreamManager
 /// This class synchronizes and feeds NaCl Player with
 /// <code>ElementaryStreamPacket</code>s from multiple elementary streams
-/// (represented by <code>StreamManager</code>s).
+/// (represented by <code>StreamManager</code>s, seen here through the
+/// <code>StreamSink</code> interface).
+///
+/// Demuxed packets and configurations are handed over through a lock-free
+/// queue per stream, so the demuxer thread of a stream never waits for
+/// <code>packets_lock_</code>. The lock serializes the append side, but
+/// it's released for calls to NaCl Player, so <code>OnNeedData()</code>
+/// and <code>OnEnoughData()</code> don't wait for them either.
 ///
 /// @see class <code>ElementaryStreamPacket</code>
 /// @see class <code>StreamManager</code>
+/// @see class <code>StreamSink</code>
 
 class PacketsManager : public StreamListener {
  public:
-  PacketsManager();
+  /// @param[in] tuning A tuning profile of the player, which sets how far
+  ///   ahead of the playback position packets are appended.
+  explicit PacketsManager(const TuningProfile& tuning);
   ~PacketsManager() override;
 
-  void PrepareForSeek(Samsung::NaClPlayer::TimeTicks to_time);
+  /// Checks whether a seek to <code>to_time</code> can be served from
+  /// packets already queued: a video keyframe near the target is buffered
+  /// (if there is a video stream) and audio packets cover it.
+  bool CanSeekInBuffer(Samsung::NaClPlayer::TimeTicks to_time);
+
+  /// Starts a seek to <code>to_time</code>. Queued packets are dropped,
+  /// unless <code>in_buffer</code> is set (see <code>CanSeekInBuffer()</code>)
+  /// and only the ones before the keyframe at the target are dropped, while
+  /// streams keep demuxing from where they are.
+  void PrepareForSeek(Samsung::NaClPlayer::TimeTicks to_time,
+                      bool in_buffer = false);
+
+  /// Drops all packets and the state of the played media, so other media
+  /// can be played. Streams must be unset before.
+  void Reset();
   void OnEsPacket(StreamDemuxer::Message,
                   std::unique_ptr<ElementaryStreamPacket>);
+  void OnEsPackets(StreamDemuxer::Message, StreamDemuxer::PacketBatch);
   bool UpdateBuffer(Samsung::NaClPlayer::TimeTicks playback_time);
-  void SetStream(StreamType type, StreamManager* manager);
+  void SetStream(StreamType type, StreamSink* stream);
+
+  /// Sets a function called whenever buffers may need an update: when
+  /// segments are received, packets are demuxed or the player needs or has
+  /// enough data. It can be called on any thread.
+  ///
+  /// @param[in] callback A function scheduling <code>UpdateBuffer()</code>
+  ///   and an update of streams.
+  void SetBufferUpdateCallback(const std::function<void()>& callback);
+
+  /// Sets a function which checks if an encrypted packet can be appended,
+  /// i.e. if a license of its key is available. Clear packets are always
+  /// appended. A stream which next packet can't be appended waits, while
+  /// other streams still get packets. It's called with
+  /// <code>packets_lock_</code> locked. Must be called before packets are
+  /// demuxed.
+  ///
+  /// @param[in] callback A function returning <code>false</code> if a
+  ///   packet has to wait, or an empty function if all packets can be
+  ///   appended.
+  void SetDecryptableCallback(
+      const std::function<bool(const ElementaryStreamPacket&)>& callback);
+
+  /// Sets a limit of memory used by packets of the given stream, which are
+  /// buffered in this <code>PacketsManager</code>. It's reduced under memory
+  /// pressure, see <code>MemoryGovernor::ScaleLimit()</code>.
+  ///
+  /// @param[in] type A stream type.
+  /// @param[in] max_bytes A memory budget in bytes.
+  void SetMemoryBudget(StreamType type, size_t max_bytes);
+
+  /// Switches the buffering policy of a low-latency live presentation on or
+  /// off. Packets are appended as soon as they are demuxed then, rather than
+  /// up to a few seconds ahead of the playback, as the buffer is bounded by
+  /// the live edge anyway and every packet held here adds to the latency.
+  ///
+  /// @param[in] enabled Whether the low-latency policy is used.
+  void SetLowLatency(bool enabled);
+
+  /// Informs about a speed of a continuous playback. Packets are appended
+  /// that many times further ahead, so the player holds the same time of
+  /// playback at any rate.
+  ///
+  /// @param[in] rate A playback rate, 1 being the normal speed.
+  void SetPlaybackRate(double rate);
+
+  /// Limits how far ahead of the playback position packets of the given
+  /// stream are appended, even when the player asks for more. Packets which
+  /// are not appended can still be replaced (see
+  /// <code>DropQueuedPackets()</code>), so it bounds how long a switch of
+  /// the stream takes to be heard. The limit is removed by
+  /// <code>Reset()</code>.
+  ///
+  /// @param[in] type A stream type.
+  /// @param[in] limit A limit in seconds, 0 for none. It's never below the
+  ///   least appended time of the <code>TuningProfile</code>.
+  void SetAppendLimit(StreamType type, Samsung::NaClPlayer::TimeTicks limit);
+
+  /// Sets a function called on the thread of <code>UpdateBuffer()</code>
+  /// when the playback reaches a subtitle cue. The cue is passed with
+  /// <code>start</code> set to the playback position, so the remaining time
+  /// it's shown for is <code>end - start</code>.
+  ///
+  /// @param[in] callback A function showing the cue.
+  void SetTextCueCallback(const std::function<void(const TextCue&)>& callback);
+
+  /// Makes dropped packets counted in playback metrics of the player.
+  /// Nothing is counted if it's not called.
+  ///
+  /// @param[in] metrics Playback metrics of the player, which must outlive
+  ///   this object.
+  void SetPlaybackMetrics(PlaybackMetrics* metrics);
+
+  /// Schedules subtitle cues of a text stream, in presentation times. Cues
+  /// are kept until the playback reaches them or a seek is made.
+  ///
+  /// @param[in] cues Cues parsed from a text segment.
+  void OnTextCues(std::vector<TextCue> cues);
+
+  /// Drops scheduled cues, e.g. when the text stream changes.
+  void ClearTextCues();
+
+  /// Returns a number of bytes held in buffered packets of the given stream.
+  size_t GetBufferedBytes(StreamType type);
+
+  /// Returns a timestamp of the last packet of the given stream received
+  /// from its demuxer, which is how far the stream is buffered.
+  Samsung::NaClPlayer::TimeTicks GetBufferedTime(StreamType type);
+
+  /// Returns times of packets of the given stream appended to NaCl Player
+  /// since the last seek and of packets queued here. The downloaded range
+  /// is left empty, it's known to <code>StreamManager</code>.
+  StreamBufferedRanges GetBufferedRanges(StreamType type);
 
   void OnStreamConfig(const AudioConfig&) override;
   void OnStreamConfig(const VideoConfig&) override;
@@ -62,35 +188,93 @@ class PacketsManager : public StreamListener {
   void OnEnoughData(StreamType type) override;
   void OnSeekData(StreamType type,
                   Samsung::NaClPlayer::TimeTicks new_position)  override;
+  void OnSegmentReceived(StreamType type) override;
+  bool CanBuffer(StreamType type, size_t bytes) override;
+  bool GetPendingPacketsTime(StreamType type,
+                             Samsung::NaClPlayer::TimeTicks* first,
+                             Samsung::NaClPlayer::TimeTicks* last) override;
+  bool DropPacketsFrom(StreamType type,
+                       Samsung::NaClPlayer::TimeTicks time) override;
+  bool DropQueuedPackets(StreamType type,
+                         Samsung::NaClPlayer::TimeTicks* appended_end)
+      override;
+
+  /// Signals that the demuxer of a stream passed its last packet.
+  void OnEndOfStream(StreamType type);
+
+  bool IsEosReached();
 
-  bool IsEosReached() const;
+  /// Suspends or resumes a stream, e.g. video while only audio is played.
+  /// Packets queued for a suspended stream are dropped and it doesn't hold
+  /// back appending packets of other streams, seeks nor the end of stream.
+  /// A resumed stream has to be seeked before its packets are appended.
+  void SetStreamSuspended(StreamType type, bool suspended);
 
-   // This class encapsulates a stream object that is appendable to a stream in
-   // a timely manner. Usually this means an ES packet, but a stream
-   // configuration changed outside seek (i.e. during representation change)
-   // also falls into this category.
+  /// Checks if any packet was appended to NaCl Player since the last seek
+  /// (or since the start of playback).
+  bool PacketsAppended() const;
+
+  /// Checks if a seek is in progress and dropped packets which came before
+  /// its starting packets, i.e. streams deliver data, but the seek didn't
+  /// find where to start yet.
+  bool IsSeekDroppingPackets();
+
+  /// Makes a seek in progress end at the next packet of each stream which is
+  /// still seeking, keyframe or not. Used when a seek stalls, e.g. when no
+  /// keyframe is found around its target.
+  void ForceSeekEnd();
+
+  // This class encapsulates a stream object that is appendable to a stream in
+  // a timely manner. Usually this means an ES packet, but a stream
+  // configuration changed outside seek (i.e. during representation change)
+  // also falls into this category. It's a plain record kept by value in the
+  // queues, with attributes of the packet read once on the demuxer thread,
+  // so scheduling neither allocates nor makes virtual calls per packet.
+  // Configs are rare and held out of line.
   class BufferedStreamObject {
    public:
     BufferedStreamObject(StreamType type,
-                         Samsung::NaClPlayer::TimeTicks time)
-        : type_(type),
-          time_(time) {}
-    virtual ~BufferedStreamObject();
-    virtual bool Append(StreamManager*) = 0;
-    virtual bool IsKeyFrame() const = 0;
-    virtual bool IsConfig() const = 0;
+                         std::unique_ptr<ElementaryStreamPacket> packet);
+    BufferedStreamObject(MediaTime time, const AudioConfig& config);
+    BufferedStreamObject(MediaTime time, const VideoConfig& config);
+    BufferedStreamObject(BufferedStreamObject&&) = default;
+    BufferedStreamObject& operator=(BufferedStreamObject&&) = default;
+    ~BufferedStreamObject();
+    // Passes the config to the stream. Returns true if it was applied, so
+    // appending should wait for the stream to finish its initialization.
+    bool AppendConfig(StreamSink* stream) const;
+    bool IsKeyFrame() const {
+      return key_frame_;
+    }
+    bool IsEncrypted() const {
+      return encrypted_;
+    }
+    bool IsConfig() const {
+      return !packet_;
+    }
+    size_t GetDataSize() const {
+      return data_size_;
+    }
+    // Returns null if this object is not an ES packet.
+    const ElementaryStreamPacket* GetPacket() const {
+      return packet_.get();
+    }
     StreamType type() const {
       return type_;
     }
     Samsung::NaClPlayer::TimeTicks time() const {
+      return ToTimeTicks(time_);
+    }
+    // The time in units of kMediaTimescale, which objects are ordered by.
+    MediaTime media_time() const {
       return time_;
     }
     bool operator<(const BufferedStreamObject& another) const {
       return time_ < another.time_;
     }
     bool operator==(const BufferedStreamObject& another) const {
-      // Stream objects are equal if they are literally equal, hence no kEps
-      // and it's intentional.
+      // Times are integers, so stream objects of equal timestamps are
+      // literally equal.
       return time_ == another.time_;
     }
     bool operator!=(const BufferedStreamObject& another) const {
@@ -105,35 +289,72 @@ class PacketsManager : public StreamListener {
     bool operator>=(const BufferedStreamObject& another) const {
       return !(*this < another);
     }
-    struct IsGreater {
-      // for packets_ priority queue: lower timestamps go first
-      bool operator()(
-          const std::unique_ptr<BufferedStreamObject>& p1,
-          const std::unique_ptr<BufferedStreamObject>& p2) const {
-        return *p1 > *p2;
-      }
-    };
    private:
     StreamType type_;
-    Samsung::NaClPlayer::TimeTicks time_;
+    bool key_frame_;
+    bool encrypted_;
+    uint32_t data_size_;
+    MediaTime time_;
+    std::unique_ptr<ElementaryStreamPacket> packet_;
+    std::unique_ptr<AudioConfig> audio_config_;
+    std::unique_ptr<VideoConfig> video_config_;
   };  // class BufferedStreamObject
  private:
-  /// This method assures that <code>packets_</code> buffer top packet can be
-  /// safely used to start a playback after a seek operation. A good starting
-  /// packet is a video keyframe, so this method essentially drops any audio or
-  /// non-keyframe video packet until a video keyframe is encountered. If this
-  /// happens, a seek operation is finished (i.e. <code>seeking_</code> flag is
-  /// set to <code>false</code>).
+  /// This method assures that the front packet of each stream queue in
+  /// <code>packets_</code> can be safely used to start a playback after a
+  /// seek operation. Each stream finishes its seek on its own: video at a
+  /// keyframe at the seek target (see <code>PrepareForSeek()</code>), audio
+  /// at the packet which plays at the seek target. Packets before them are
+  /// dropped. When all streams are done, a seek operation is finished (i.e.
+  /// <code>seeking_</code> flag is set to <code>false</code>).
   ///
   /// \pre Seeking operation must be in progress (i.e. <code>seeking_</code> is
   ///      set to <code>true</code>).
   /// \pre <code>packets_lock_</code> must be locked.
+  void CheckSeekEndConditions();
+
+  /// Calls a function set with <code>SetBufferUpdateCallback()</code>, if
+  /// any.
+  void RequestBufferUpdate();
+
+  typedef std::vector<BufferedStreamObject> IncomingObjects;
+
+  /// Hands objects demuxed for a given stream over to the append side. It's
+  /// called only on the demuxer thread of the stream and doesn't lock.
   ///
-  /// @param[in] buffered_time A time for which both audio and video packets
-  ///   are buffered. Any Packets in <code>packets_</code> buffer with a
-  ///   <code>dts</code> value higher than <code>buffered_time</code> will not
-  ///   be considered.
-  void CheckSeekEndConditions(Samsung::NaClPlayer::TimeTicks buffered_time);
+  /// @param[in] stream_id A stream index, objects belong to.
+  /// @param[in] objects Objects in the dts order.
+  /// @param[in] last_dts A timestamp of the last packet in objects, which
+  ///   the stream is buffered to.
+  void PushIncoming(int32_t stream_id, IncomingObjects objects,
+                    MediaTime last_dts);
+
+  /// Drops packets which repeat times already received for a stream, i.e.
+  /// packets of a new representation which starts before the end of the
+  /// previous one, so no bytes or decoder time go to duplicate frames. Video
+  /// packets queued from the first keyframe of the new representation on
+  /// are replaced instead, if none of them was appended yet. Otherwise video
+  /// resumes at a keyframe past the repeated range. It's called only on the
+  /// demuxer thread of the stream.
+  ///
+  /// @param[in] stream_id A stream index, packets belong to.
+  /// @param[in,out] packets Packets in the dts order, dropped ones are
+  ///   removed.
+  void DropOverlappingPackets(int32_t stream_id,
+                              StreamDemuxer::PacketBatch* packets);
+
+  /// Removes packets queued for a stream from <code>time</code> on, if all
+  /// of them are still in <code>packets_</code> and there are no
+  /// configurations among them.
+  ///
+  /// @return <code>true</code> if packets were removed.
+  bool ReplaceQueuedPackets(int32_t stream_id, MediaTime time);
+
+  /// Moves objects handed over with <code>PushIncoming()</code> to
+  /// <code>packets_</code>.
+  ///
+  /// \pre <code>packets_lock_</code> must be locked.
+  void DrainIncoming();
 
   /// Appends <code>ElementaryStreamPacket</code>s buffered in
   /// <code>packets_</code> buffer to Player for a playback. Only a number of
@@ -141,16 +362,57 @@ class PacketsManager : public StreamListener {
   /// <code>playback_time</code> will be sent. Packets in <code>packets_</code>
   /// buffer that have <code>dts</code> value higher than
   /// <code>buffered_time</code> are not considered for appending.
+  /// A stream which requested data with <code>OnNeedData()</code> gets
+  /// packets up to the requested size regardless of their time, a stream
+  /// which reported <code>OnEnoughData()</code> gets only packets needed
+  /// very soon.
+  ///
+  /// Streams which are still seeking (see <code>stream_seeking_</code>) are
+  /// skipped.
   ///
-  /// \pre Seeking operation is NOT in progress (i.e. <code>seeking_</code> is
-  ///      set to <code>false</code>).
   /// \pre <code>packets_lock_</code> must be locked.
   ///
   /// @param[in] playback_time A current playback position.
   /// @param[in] buffered_time A time for which both audio and video packets
   ///   are buffered.
   void AppendPackets(Samsung::NaClPlayer::TimeTicks playback_time,
-                     Samsung::NaClPlayer::TimeTicks buffered_time);
+                     MediaTime buffered_time);
+
+  /// Appends ES packets of the given stream, which were removed from its
+  /// queue in <code>packets_</code>, with a single
+  /// <code>StreamManager::AppendPackets()</code> call. Packets which are not
+  /// accepted are put back at the front of the queue, unless a seek was
+  /// prepared in the meantime.
+  ///
+  /// \pre <code>packets_lock_</code> must be locked. It's released while
+  ///      packets are appended.
+  ///
+  /// @param[in] stream_id A stream index, packets belong to.
+  /// @param[in,out] batch Packets to append, it's cleared.
+  /// @return <code>true</code> if all packets were appended.
+  bool AppendBatch(int32_t stream_id,
+                   std::vector<BufferedStreamObject>* batch);
+
+  /// Removes the front object of a given stream queue in
+  /// <code>packets_</code> and returns it.
+  ///
+  /// \pre <code>packets_lock_</code> must be locked.
+  BufferedStreamObject PopFront(int32_t stream_id);
+
+  /// Returns an index of the stream which object should be appended next (the
+  /// one with the lowest timestamp at the front of its queue), or -1 if all
+  /// queues in <code>packets_</code> are empty.
+  ///
+  /// \pre <code>packets_lock_</code> must be locked.
+  ///
+  /// @param[in] skipped_streams A bit mask of stream indexes which are not
+  ///   considered.
+  int32_t NextStreamIndex(uint32_t skipped_streams = 0) const;
+
+  /// Checks if any stream has buffered objects in <code>packets_</code>.
+  ///
+  /// \pre <code>packets_lock_</code> must be locked.
+  bool HasBufferedObjects() const;
 
   /// Checks if EOS is signalled on all streams by stream demuxers. Please note
   /// it might not be reached on packets manager side yet, i.e. there can still
@@ -158,11 +420,46 @@ class PacketsManager : public StreamListener {
   /// Player.
   bool IsEosSignalled() const;
 
-  std::unique_ptr<BufferedStreamObject> CreateBufferedConfig(
-      const AudioConfig&);
+  // Whether a stream is set and not suspended.
+  bool IsActive(int32_t stream_id) const;
+
+  // Moves cues which start by playback_time from text_cues_ to due_cues.
+  // Must be called with packets_lock_ held.
+  void TakeDueTextCues(Samsung::NaClPlayer::TimeTicks playback_time,
+                       std::vector<TextCue>* due_cues);
+
+  // Counts packets demuxed but not appended in playback_metrics_, if set.
+  void AddDroppedPackets(size_t count);
 
-  std::unique_ptr<BufferedStreamObject> CreateBufferedConfig(
-      const VideoConfig&);
+  /// Queues a configuration with a codec change after packets received
+  /// before it. An audio configuration is queued at once. A video one is
+  /// held until the first keyframe of the new representation, see
+  /// <code>HoldUntilKeyframe()</code>.
+  ///
+  /// \pre Called by the demuxing side of the stream only.
+  void QueueConfig(const AudioConfig& config);
+  void QueueConfig(const VideoConfig& config);
+
+  /// Queues a video configuration held by <code>QueueConfig()</code> at the
+  /// first keyframe of <code>packets</code>, and drops packets before that
+  /// keyframe, as the decoder can't start with them. Packets are kept if no
+  /// configuration is held. It's called only on the demuxer thread of the
+  /// stream.
+  ///
+  /// @param[in] stream_id A stream index, packets belong to.
+  /// @param[in,out] packets Packets in the dts order, dropped ones are
+  ///   removed.
+  /// @param[out] objects Gets the configuration when it's queued.
+  void HoldUntilKeyframe(int32_t stream_id,
+                         StreamDemuxer::PacketBatch* packets,
+                         IncomingObjects* objects);
+
+  /// Classifies a configuration received for a stream against the previous
+  /// one received for it and remembers it.
+  ///
+  /// \pre Called by the demuxing side of the stream only.
+  ConfigChange UpdateLastConfig(const AudioConfig& config);
+  ConfigChange UpdateLastConfig(const VideoConfig& config);
 
   template <typename ConfigT>
   void HandleStreamConfig(StreamType stream, const ConfigT& config) {
@@ -174,24 +471,40 @@ class PacketsManager : public StreamListener {
                     "VIDEO" : "AUDIO");
       return;
     }
+    auto change = UpdateLastConfig(config);
     if (streams_[stream_index]->IsSeeking() ||
         !streams_[stream_index]->IsInitialized()) {
       // If stream is seeking or uninitialized, apply configuration
       // immediately:
       streams_[stream_index]->SetConfig(config);
+      if (stream == StreamType::Video) has_held_video_config_ = false;
+    } else if (change != ConfigChange::kCodec) {
+      // A repeated configuration or a resolution change (e.g. a
+      // representation change) doesn't reinitialize the decoder, so it
+      // doesn't have to interrupt appending packets either.
+      LOG_DEBUG("Skipping a configuration without codec changes (%s).",
+                change == ConfigChange::kNone ? "the same" : "resolution");
     } else {
       // Otherwise enqueue configuration appliance after all packets from a
       // previous config are sent:
-      packets_.push(CreateBufferedConfig(config));
+      QueueConfig(config);
     }
 
   }
 
   pp::Lock packets_lock_;
-  typedef std::unique_ptr<BufferedStreamObject> BufferedStreamObjectPtr;
-  std::priority_queue<BufferedStreamObjectPtr,
-                      std::vector<BufferedStreamObjectPtr>,
-                      typename BufferedStreamObject::IsGreater> packets_;
+  // Objects pushed by demuxer threads and not moved to packets_ yet.
+  std::array<SpscQueue<IncomingObjects>,
+             static_cast<int32_t>(StreamType::MaxStreamTypes)> incoming_;
+  // Packets of a single stream arrive in the dts order, so each stream has
+  // its own FIFO queue (with configuration changes queued in between its
+  // packets). Queues are merged by timestamp when objects are appended.
+  std::array<std::deque<BufferedStreamObject>,
+             static_cast<int32_t>(StreamType::MaxStreamTypes)> packets_;
+
+  /// A snapshot of the profile of the player, restored by
+  /// <code>Reset()</code>.
+  const TuningProfile tuning_;
 
   /// If <code>true</code>, we are during a seek operation and cannot append
   /// any packets until we fill a buffer with a number of approperiate packets.
@@ -199,21 +512,117 @@ class PacketsManager : public StreamListener {
   /// @see method <code>PacketsManager::CheckSeekEndConditions()</code>
   bool seeking_;
 
-  /// EOS is in effect when EOS count reaches number of streams.
-  int eos_count_;
+  // Set when a packet is appended, cleared in PrepareForSeek().
+  std::atomic<bool> packets_appended_;
+
+  // Incremented by PrepareForSeek(), so appends made with packets_lock_
+  // released know their remaining packets are stale.
+  uint32_t seek_generation_;
+
+  // Set by PrepareForSeek() for a seek served from queued packets, so
+  // OnSeekData() leaves the streams at their download positions.
+  std::atomic<bool> in_buffer_seek_;
+
+  /// EOS is in effect when it's signalled on all active streams.
+  std::array<std::atomic<bool>,
+             static_cast<int32_t>(StreamType::MaxStreamTypes)> eos_signalled_;
+
+  // Set for streams which are not played, see SetStreamSuspended().
+  std::array<std::atomic<bool>,
+             static_cast<int32_t>(StreamType::MaxStreamTypes)> suspended_;
+
+  // Streams which haven't reached their starting packet of the current
+  // seek, see CheckSeekEndConditions().
+  std::array<bool, static_cast<int32_t>(StreamType::MaxStreamTypes)>
+      stream_seeking_;
+  // Set when CheckSeekEndConditions() drops a packet of the current seek.
+  bool seek_dropped_packets_;
+  // Set by ForceSeekEnd(), cleared when the next seek starts.
+  bool force_seek_end_;
 
   std::array<bool,
             static_cast<int32_t>(StreamType::MaxStreamTypes)> seek_segment_set_;
   Samsung::NaClPlayer::TimeTicks seek_segment_video_time_;
+  // A keyframe time the current seek goes to. It can be inside a segment,
+  // so video keyframes before it are dropped as well.
+  Samsung::NaClPlayer::TimeTicks seek_keyframe_time_;
 
-  std::array<Samsung::NaClPlayer::TimeTicks,
+  // In units of kMediaTimescale, like times of buffered objects.
+  std::array<std::atomic<MediaTime>,
              static_cast<int32_t>(StreamType::MaxStreamTypes)>
                  buffered_packets_timestamp_;
 
+  // A dts of the last packet received from the demuxer of each stream and,
+  // while packets of a new representation repeat the buffered range, the
+  // end of that range. Used by the demuxing side, see
+  // DropOverlappingPackets().
+  std::array<MediaTime, static_cast<int32_t>(StreamType::MaxStreamTypes)>
+      last_demuxed_dts_;
+  std::array<MediaTime, static_cast<int32_t>(StreamType::MaxStreamTypes)>
+      overlap_end_dts_;
+
+  // Dts of the first and the last packet appended since the last seek, per
+  // stream, kNoDts before any.
+  std::array<std::atomic<MediaTime>,
+             static_cast<int32_t>(StreamType::MaxStreamTypes)> appended_start_;
+  std::array<std::atomic<MediaTime>,
+             static_cast<int32_t>(StreamType::MaxStreamTypes)> appended_end_;
+
+  // Bytes held in incoming_ and packets_ and memory budgets, per stream.
+  std::array<std::atomic<size_t>,
+             static_cast<int32_t>(StreamType::MaxStreamTypes)> buffered_bytes_;
+  std::array<std::atomic<size_t>,
+             static_cast<int32_t>(StreamType::MaxStreamTypes)> memory_budget_;
+  // Bytes of all streams, registered with MemoryGovernor.
+  MemoryUsage memory_usage_;
+
+  // Bytes requested by the player with OnNeedData() and not appended yet,
+  // per stream. Set by OnEnoughData() until the next OnNeedData().
+  std::array<int64_t, static_cast<int32_t>(StreamType::MaxStreamTypes)>
+      needed_bytes_;
+  std::array<bool, static_cast<int32_t>(StreamType::MaxStreamTypes)>
+      enough_data_;
+  // Set for low-latency live presentations, see SetLowLatency().
+  std::atomic<bool> low_latency_;
+  // Set by SetPlaybackRate(), scales thresholds of appended packets.
+  std::atomic<double> playback_rate_;
+  // Seconds of packets appended ahead of the playback position, and the
+  // least kept appended even when the player has enough data. Taken from
+  // the TuningProfile on construction and Reset().
+  Samsung::NaClPlayer::TimeTicks append_ahead_;
+  Samsung::NaClPlayer::TimeTicks min_append_ahead_;
+  // Set by SetAppendLimit(), 0 for streams without a limit.
+  std::array<Samsung::NaClPlayer::TimeTicks,
+             static_cast<int32_t>(StreamType::MaxStreamTypes)> append_limit_;
+
+  // The last configurations received from demuxers, used to tell which of
+  // them have to be applied. Set by the demuxing side of each stream.
+  AudioConfig last_audio_config_;
+  VideoConfig last_video_config_;
+  std::array<bool, static_cast<int32_t>(StreamType::MaxStreamTypes)>
+      has_last_config_;
+  // A video configuration with a codec change which waits for the first
+  // keyframe of the new representation, see HoldUntilKeyframe(). Used by
+  // the demuxing side.
+  VideoConfig held_video_config_;
+  bool has_held_video_config_;
+
   // Non-owning pointers managed by parent. They are bound to be valid as long
   // as they are set.
-  std::array<StreamManager*,
+  std::array<StreamSink*,
              static_cast<int32_t>(StreamType::MaxStreamTypes)> streams_;
+
+  std::function<void()> buffer_update_callback_;
+  std::function<bool(const ElementaryStreamPacket&)> decryptable_callback_;
+  std::function<void(const TextCue&)> text_cue_callback_;
+
+  // Subtitle cues ordered by their start, and the last one that was shown.
+  std::deque<TextCue> text_cues_;
+  Samsung::NaClPlayer::TimeTicks shown_text_cue_end_;
+  std::string shown_text_cue_text_;
+
+  // Set before the playback, counts dropped packets.
+  PlaybackMetrics* playback_metrics_;
 };
 
 #endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_PACKETS_MANAGER_H_
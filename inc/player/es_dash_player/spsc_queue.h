@@ -0,0 +1,90 @@
+/*!
+ * spsc_queue.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_SPSC_QUEUE_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <utility>
+
+/// @file
+/// @brief This file defines the <code>SpscQueue</code> class.
+
+/// @class SpscQueue
+/// An unbounded lock-free FIFO queue for a single producer and a single
+/// consumer, which can run on different threads. <code>Push()</code> is
+/// called only by the producer, <code>Pop()</code> and <code>Empty()</code>
+/// only by the consumer. Several threads can take the consumer role as long
+/// as they are serialized, e.g. by a lock.
+///
+/// Items are kept in a linked list ending with a node which the consumer
+/// already took the item from, so the producer and the consumer never
+/// touch the same node, except for its <code>next</code> link.
+template <typename T>
+class SpscQueue {
+ public:
+  SpscQueue() : head_(new Node), tail_(head_) {}
+
+  ~SpscQueue() {
+    while (tail_) {
+      Node* next = tail_->next.load(std::memory_order_relaxed);
+      delete tail_;
+      tail_ = next;
+    }
+  }
+
+  void Push(T item) {
+    Node* node = new Node;
+    node->item = std::move(item);
+    // The item is published together with the link.
+    head_->next.store(node, std::memory_order_release);
+    head_ = node;
+  }
+
+  /// Takes the oldest item, returns <code>false</code> if there is none.
+  bool Pop(T* item) {
+    Node* next = tail_->next.load(std::memory_order_acquire);
+    if (!next) return false;
+    *item = std::move(next->item);
+    delete tail_;
+    tail_ = next;
+    return true;
+  }
+
+  bool Empty() const {
+    return !tail_->next.load(std::memory_order_acquire);
+  }
+
+ private:
+  struct Node {
+    Node() : next(nullptr) {}
+    std::atomic<Node*> next;
+    T item;
+  };
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  // The last node, used by the producer.
+  Node* head_;
+  // The node before the oldest item, used by the consumer.
+  Node* tail_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_SPSC_QUEUE_H_
@@ -43,6 +43,36 @@ class StreamListener {
   virtual void OnEnoughData(StreamType type) = 0;
   virtual void OnSeekData(StreamType type,
                           Samsung::NaClPlayer::TimeTicks new_position) = 0;
+  /// Called when a downloaded segment (or its chunk) of the given stream is
+  /// received, before it's parsed.
+  virtual void OnSegmentReceived(StreamType type) = 0;
+  /// Checks if <code>bytes</code> more of the given stream data fit in the
+  /// memory budget of a listener. Used to throttle segment downloads.
+  virtual bool CanBuffer(StreamType type, size_t bytes) = 0;
+  /// Gets timestamps of the first and the last packet of the given stream
+  /// which are buffered by a listener, but not appended yet. Returns
+  /// <code>false</code> if there are none or if a configuration change is
+  /// waiting among them.
+  virtual bool GetPendingPacketsTime(StreamType type,
+                                     Samsung::NaClPlayer::TimeTicks* first,
+                                     Samsung::NaClPlayer::TimeTicks* last) = 0;
+  /// Drops packets of the given stream buffered by a listener, starting with
+  /// a keyframe at <code>time</code> (give or take <code>kSegmentMargin
+  /// </code>), so they can be replaced with packets of another
+  /// representation. Returns <code>false</code>, dropping nothing, if there
+  /// is no such keyframe or if a configuration change would be dropped.
+  virtual bool DropPacketsFrom(StreamType type,
+                               Samsung::NaClPlayer::TimeTicks time) = 0;
+  /// Drops all packets of the given stream buffered by a listener, so the
+  /// stream continues with packets of another representation right after
+  /// the ones appended already. Packets demuxed later which repeat appended
+  /// times are dropped. Returns <code>false</code>, dropping nothing, if
+  /// nothing was appended yet, a seek is in progress or a configuration
+  /// change would be dropped.
+  ///
+  /// @param[out] appended_end A timestamp of the last appended packet.
+  virtual bool DropQueuedPackets(
+      StreamType type, Samsung::NaClPlayer::TimeTicks* appended_end) = 0;
 };
 
 #endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_STREAM_LISTENER_H_
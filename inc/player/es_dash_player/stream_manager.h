@@ -28,16 +28,27 @@
 #include <vector>
 
 #include "nacl_player/elementary_stream_listener.h"
-#include "nacl_player/es_data_source.h"
 #include "nacl_player/media_common.h"
 #include "nacl_player/media_player.h"
 #include "ppapi/cpp/instance.h"
 
 #include "dash/media_segment_sequence.h"
+#include "dash/media_stream.h"
 #include "demuxer/stream_demuxer.h"
+#include "player/es_dash_player/es_backend.h"
 #include "player/es_dash_player/stream_listener.h"
+#include "player/es_dash_player/stream_sink.h"
+#include "player/es_dash_player/task_executor.h"
+#include "tuning_profile.h"
 
+class BandwidthEstimator;
+class DownloadArbiter;
+class DrmMetrics;
 class ElementaryStreamPacket;
+class NetworkExecutor;
+class PipelineLatency;
+class PlaybackMetrics;
+class SegmentCache;
 
 /// @file
 /// @brief This file defines the <code>StreamManager</code> class.
@@ -78,8 +89,10 @@ class ElementaryStreamPacket;
 /// @see class <code>MediaSegmentSequence</code>
 /// @see class <code>StreamDemuxer</code>
 /// @see class <code>Samsung::NaClPlayer::ElementaryStreamListener</code>
+/// @see class <code>StreamSink</code>
 
-class StreamManager : public Samsung::NaClPlayer::ElementaryStreamListener {
+class StreamManager : public Samsung::NaClPlayer::ElementaryStreamListener,
+                      public StreamSink {
  public:
   /// Creates a <code>StreamManager</code> object and opens a stream of a given
   /// type in a give player. Newly created object must be initialized using the
@@ -92,17 +105,28 @@ class StreamManager : public Samsung::NaClPlayer::ElementaryStreamListener {
   ///   Player object.
   /// @param[in] type A stream type for which the <code>StreamManager</code>
   ///   object is constructed.
-  explicit StreamManager(pp::InstanceHandle instance, StreamType type);
+  /// @param[in] tuning A tuning profile of the player, which sets how far
+  ///   ahead segments are downloaded, download buffers and demuxer probing.
+  /// @param[in] network_executor An executor running segment downloads,
+  ///   shared with other network clients of the player. The stream uses its
+  ///   own one if it's null.
+  /// @param[in] bandwidth_estimator An estimator fed with measurements of
+  ///   segment downloads, shared with other streams of the player. The
+  ///   stream uses its own one if it's null.
+  StreamManager(pp::InstanceHandle instance, StreamType type,
+      const TuningProfile& tuning,
+      std::shared_ptr<NetworkExecutor> network_executor = nullptr,
+      std::shared_ptr<BandwidthEstimator> bandwidth_estimator = nullptr);
 
   /// Destroys a <code>StreamManager</code> object and closes a stream it
   /// manages.
-  ~StreamManager();
+  ~StreamManager() override;
 
   /// Initializes a <code>StreamManager</code> object, associating it with a
   /// <code>segment_sequence</code> and enabling it to deliver elementary
   /// stream packets from that sequence to NaCl Player.
   ///
-  /// This method must be called before a given <code>es_data_source</code> is
+  /// This method must be called before a given <code>es_backend</code> is
   /// attached to NaCl Player (i.e. before media stream configuration is
   /// completed and thus before
   /// <code>EsDashPlayerController::OnStreamConfigured()</code> for the managed
@@ -110,11 +134,19 @@ class StreamManager : public Samsung::NaClPlayer::ElementaryStreamListener {
   ///
   /// @param[in] segment_sequence A source of elementary stream packets to be
   ///   used in this stream.
-  /// @param[in] es_data_source NaCl Player data source which will consume
-  ///    elementary stream packets.
+  /// @param[in] init_segment Data of the initialization segment of
+  ///   <code>segment_sequence</code> if it's downloaded already, or an empty
+  ///   vector if it should be downloaded by this method.
+  /// @param[in] es_backend A backend, e.g. NaCl Player data source, which
+  ///    will consume elementary stream packets.
   /// @param[in] stream_configured_callback A callback which will be called
   ///   whenever a new stream configuration is discovered and successfully
   ///   applied to NaCl Player.
+  /// @param[in] es_packet_callback A callback which receives demuxed
+  ///   <code>ElementaryStreamPacket</code>s and other demuxer messages.
+  /// @param[in] es_packets_callback A callback which receives batches of
+  ///   demuxed <code>ElementaryStreamPacket</code>s, if the demuxer supports
+  ///   it. Can be empty.
   /// @param[in] packets_manager A class that will perform synchronization of
   ///   <code>ElementaryStreamPacket</code>s outputted from this stream.
   /// @param[in] drm_type A DRM scheme used by the managed stream. If no DRM
@@ -123,15 +155,45 @@ class StreamManager : public Samsung::NaClPlayer::ElementaryStreamListener {
   /// @return <code>true</code> if an initialization was successfull, or
   ///   <code>false</code> otherwise.
   bool Initialize(
-      std::unique_ptr<MediaSegmentSequence> segment_sequence,
-      Samsung::NaClPlayer::ESDataSource* es_data_source,
+      std::shared_ptr<const MediaSegmentSequence> segment_sequence,
+      const std::vector<uint8_t>& init_segment,
+      EsBackend* es_backend,
       std::function<void(StreamType)> stream_configured_callback,
       std::function<void(StreamDemuxer::Message, std::unique_ptr<
           ElementaryStreamPacket>)> es_packet_callback,
+      std::function<void(StreamDemuxer::Message,
+          StreamDemuxer::PacketBatch)> es_packets_callback,
       StreamListener* stream_listener,
       Samsung::NaClPlayer::DRMType drm_type =
           Samsung::NaClPlayer::DRMType_Unknown);
 
+  /// Adds the managed stream to <code>es_backend</code> before
+  /// <code>Initialize()</code> is called, which does it otherwise. This
+  /// allows to pass DRM init data known from a manifest with
+  /// <code>SetDrmInitData()</code>, so a license is requested while media
+  /// data is still downloaded.
+  ///
+  /// @param[in] es_backend A backend, e.g. NaCl Player data source, which
+  ///    will consume elementary stream packets.
+  ///
+  /// @return <code>true</code> if the stream was added, or
+  ///   <code>false</code> otherwise.
+  bool AddStream(EsBackend* es_backend);
+
+  /// Configures the stream added with <code>AddStream()</code> from its
+  /// description in a manifest (<code>@codecs</code>, sampling rate,
+  /// channels, size and frame rate), so the player can be set up while the
+  /// init segment is still downloaded. A configuration demuxed later
+  /// replaces the provisional one only if it differs.
+  ///
+  /// @param[in] stream A manifest description of the representation.
+  ///
+  /// @return <code>true</code> if the stream was configured, or
+  ///   <code>false</code> if the manifest doesn't describe it well enough
+  ///   or the configuration was rejected.
+  bool PreConfigure(const AudioStream& stream);
+  bool PreConfigure(const VideoStream& stream);
+
   void SetDrmInitData(const std::string& type,
                       const std::vector<uint8_t>& init_data);
 
@@ -144,8 +206,137 @@ class StreamManager : public Samsung::NaClPlayer::ElementaryStreamListener {
   ///
   /// @param[in] segment_sequence A new source of elementary stream packets to
   ///   be used in this stream.
+  /// @param[in] replace_buffered If <code>true</code>, packets buffered in
+  ///   the <code>StreamListener</code> which won't be appended within a
+  ///   second are dropped and their segments are downloaded again from the
+  ///   new sequence, so the new representation is played sooner. It's
+  ///   ignored when the demuxer can't switch bitstreams.
   void SetMediaSegmentSequence(
-      std::unique_ptr<MediaSegmentSequence> segment_sequence);
+      std::shared_ptr<const MediaSegmentSequence> segment_sequence,
+      bool replace_buffered = false);
+
+  /// Changes the representation like <code>SetMediaSegmentSequence()</code>,
+  /// but all packets which are not appended to NaCl Player yet are dropped
+  /// and the new representation continues right after the appended ones,
+  /// e.g. when the user switches the audio language. Falls back to
+  /// <code>SetMediaSegmentSequence()</code> when they can't be dropped.
+  ///
+  /// @param[in] segment_sequence A new source of elementary stream packets.
+  void ReplaceMediaSegmentSequence(
+      std::shared_ptr<const MediaSegmentSequence> segment_sequence);
+
+  /// Downloads initialization segments of other representations of this
+  /// stream in the background. When one of them is later set with
+  /// <code>SetMediaSegmentSequence()</code>, its initialization segment is
+  /// already available and the change doesn't wait for a download.
+  ///
+  /// @param[in] sequences Sequences of representations which can be chosen
+  ///   later.
+  void PrefetchInitSegments(
+      std::vector<std::shared_ptr<const MediaSegmentSequence>> sequences);
+
+  /// Downloads the media segment of the current representation at the given
+  /// time in the background, so a seek there finds it in the segment cache.
+  /// A prefetch started before is dropped if it's still in progress.
+  ///
+  /// @param[in] time A likely seek position.
+  /// @param[in] sequence A representation the segment is taken from instead
+  ///   of the current one, e.g. one the stream is likely to switch to.
+  void PrefetchSegment(
+      Samsung::NaClPlayer::TimeTicks time,
+      std::shared_ptr<const MediaSegmentSequence> sequence = nullptr);
+
+  /// Makes segments downloaded before this stream was initialized, e.g.
+  /// when the content was preloaded, available to it, so they are not
+  /// downloaded again. Must be called after <code>Initialize()</code>.
+  ///
+  /// @param[in] segments Segments of this stream.
+  void AddCachedSegments(const SegmentCache& segments);
+
+  /// Copies segments cached by this stream, including its init segments, to
+  /// <code>destination</code>, e.g. to keep them while the application is
+  /// suspended. Least recently used ones are dropped first if they don't fit
+  /// in the budget of <code>destination</code>.
+  ///
+  /// @param[out] destination A cache the segments are copied to.
+  void CopyCachedSegments(SegmentCache* destination) const;
+
+  /// Enables or disables a trick mode used for fast forward and rewind, in
+  /// which each seek downloads a single segment. A video stream passes on
+  /// only the keyframe at the seek position and aborts the download once
+  /// it's demuxed, so the rest of the segment is not downloaded.
+  ///
+  /// @param[in] enabled Whether the trick mode should be used.
+  void SetTrickPlay(bool enabled);
+
+  /// Informs about a speed of a continuous playback, so segments are
+  /// requested further ahead at higher rates and the buffer lasts the same
+  /// time. It can be called on any thread.
+  ///
+  /// @param[in] rate A playback rate, 1 being the normal speed.
+  void SetPlaybackRate(double rate);
+
+  /// Makes downloaded segments and download deadline checks run on the
+  /// given executor instead of the message loop of the thread which calls
+  /// <code>UpdateBuffer()</code>. Must be called before
+  /// <code>Initialize()</code>.
+  ///
+  /// @param[in] executor An executor of the thread updating this stream.
+  void SetTaskExecutor(std::shared_ptr<TaskExecutor> executor);
+
+  /// Makes segment downloads of this stream share a budget with other
+  /// streams which use the same arbiter, the stream with the least buffered
+  /// getting the next download. Must be called before
+  /// <code>Initialize()</code>.
+  ///
+  /// @param[in] arbiter An arbiter shared by streams of the player.
+  void SetDownloadArbiter(std::shared_ptr<DownloadArbiter> arbiter);
+
+  /// Makes latencies of segments of this stream measured into the given
+  /// histograms, shared with other streams of the player. Nothing is
+  /// measured if it's not called.
+  ///
+  /// @param[in] latency Latency histograms of the player, which must outlive
+  ///   this stream.
+  void SetPipelineLatency(PipelineLatency* latency);
+
+  /// Makes appends of encrypted packets of this stream measured into DRM
+  /// metrics of the player. Nothing is measured if it's not called.
+  ///
+  /// @param[in] metrics DRM metrics of the player, which must outlive this
+  ///   stream.
+  void SetDrmMetrics(DrmMetrics* metrics);
+
+  /// Makes downloaded segments and appended packets of this stream counted
+  /// in playback metrics of the player. Nothing is counted if it's not
+  /// called. Must be called before <code>Initialize()</code>.
+  ///
+  /// @param[in] metrics Playback metrics of the player, which must outlive
+  ///   this stream.
+  void SetPlaybackMetrics(PlaybackMetrics* metrics);
+
+  /// Makes a stream of a low-latency live presentation keep only a short
+  /// buffer behind the live edge, instead of the default time threshold of
+  /// segment downloads. Must be called before <code>Initialize()</code>.
+  ///
+  /// @param[in] buffer A buffer in seconds, 0 restores the default.
+  void SetLiveTargetBuffer(Samsung::NaClPlayer::TimeTicks buffer);
+
+  /// Makes the stream start with the segment at the given position instead
+  /// of the first one. Must be called before <code>Initialize()</code>.
+  ///
+  /// @param[in] time A position in seconds, 0 starts at the first segment.
+  void SetStartTime(Samsung::NaClPlayer::TimeTicks time);
+
+  /// By default the end of stream is passed to the demuxer as soon as the
+  /// last segment is requested, so the player gets it right after the last
+  /// packets. While media enqueued to be played after this one is loaded,
+  /// it's passed only when the playback gets near it, so the segments of
+  /// the next media can be joined. Must be called on the thread of
+  /// <code>UpdateBuffer()</code>.
+  ///
+  /// @param[in] expected Whether more media may follow.
+  void SetMoreMediaExpected(bool expected);
 
   /// Checks if there is enough data buffered for this stream and initiates
   /// data download and parsing if there is not enough buffered elementary
@@ -158,15 +349,76 @@ class StreamManager : public Samsung::NaClPlayer::ElementaryStreamListener {
   /// @return Indicates whether there are more segments to download or not.
   bool UpdateBuffer(Samsung::NaClPlayer::TimeTicks playback_time);
 
+  /// Provides a bitrate of segments which will be downloaded next, computed
+  /// from their sizes when they are known before download (e.g. from a
+  /// segment index). Bitrates of VBR segments can differ a lot from
+  /// a bitrate of their representation.
+  ///
+  /// @param[in] time A duration of upcoming segments to take into account.
+  ///
+  /// @return A bitrate in bits per second, or 0 if sizes of segments are not
+  ///   known.
+  double GetUpcomingBitrate(Samsung::NaClPlayer::TimeTicks time);
+
+  /// Provides a number of segments which are requested and not delivered to
+  /// the demuxer yet, e.g. downloads in progress.
+  ///
+  /// @return A number of pending segments.
+  size_t GetPendingSegments() const;
+
+  /// Provides a time after which a stage of this stream which makes no
+  /// progress is considered stalled: a few segment durations, but not less
+  /// than a few seconds.
+  ///
+  /// @return A timeout in seconds.
+  Samsung::NaClPlayer::TimeTicks GetStallTimeout() const;
+
+  /// Checks if the demuxer of this stream has data queued, but delivered no
+  /// packets for longer than <code>GetStallTimeout()</code>.
+  bool IsDemuxerStalled() const;
+
+  /// Makes the next seek of this stream replace its demuxer with a new one,
+  /// instead of flushing it. Used to recover from a stalled demuxer.
+  void RecreateDemuxerOnSeek();
+
+  /// Provides times of segments passed to the demuxer since the last seek.
+  /// It can be called on any thread.
+  ///
+  /// @return A range of media times, empty if nothing was downloaded yet.
+  StreamBufferedRanges::Range GetDownloadedRange() const;
+
+  /// Counters of representation changes of this stream, used by benchmarks.
+  struct SwitchStats {
+    /// Changes made with <code>SetMediaSegmentSequence()</code> or
+    /// <code>ReplaceMediaSegmentSequence()</code>.
+    uint32_t switches = 0;
+    /// Changes after which a packet of the new representation was appended
+    /// to NaCl Player.
+    uint32_t completed = 0;
+    /// Bytes of segments downloaded in vain: dropped while seeking, or
+    /// covering media passed to the demuxer before, e.g. when buffered
+    /// packets are replaced.
+    uint64_t wasted_bytes = 0;
+    /// Configs passed to the elementary stream, each one re-initializing
+    /// the decoder.
+    uint32_t decoder_configs = 0;
+  };
+
+  /// Provides counters of representation changes of this stream. It can be
+  /// called on any thread.
+  ///
+  /// @return Counters since this object was constructed.
+  SwitchStats GetSwitchStats() const;
+
   /// Checks if this <code>StreamManager</code> was initialized, i.e.
   /// <code>Initialize()</code> was successfully called on this object before
   /// and thus internal demuxer is properly initialized.
   ///
   /// @return A <code>true</code> value if this <code>StreamManager</code> is
   ///   in a proper and useable state, or a <code>false</code> otherwise.
-  bool IsInitialized();
+  bool IsInitialized() override;
 
-  bool IsSeeking() const;
+  bool IsSeeking() const override;
 
   /// Prepares this <code>StreamManager</code> for a seek operation. This
   /// stops the manager from downloading media segments from an old playback
@@ -175,17 +427,46 @@ class StreamManager : public Samsung::NaClPlayer::ElementaryStreamListener {
   /// packets to an underlying NaCl Player will be stopped until
   /// <code>OnSeekData()</code> event occurs.
   ///
+  /// It can be called from a thread other than the one which initialized
+  /// the stream and calls <code>UpdateBuffer()</code>. Appending stops at
+  /// once, while the demuxer is flushed on the stream thread, before the
+  /// following <code>OnSeekData()</code> is handled there.
+  ///
+  /// If <code>in_buffer</code> is set, packets at <code>new_position</code>
+  /// are queued already (see <code>PacketsManager::CanSeekInBuffer()</code>),
+  /// so neither downloads nor the demuxer are reset and the stream goes on
+  /// from where it is.
+  ///
   /// @param[in] new_position A new playback position.
-  void PrepareForSeek(Samsung::NaClPlayer::TimeTicks new_position);
+  /// @param[in] in_buffer Whether the seek is served from queued packets.
+  void PrepareForSeek(Samsung::NaClPlayer::TimeTicks new_position,
+                      bool in_buffer = false);
+
+  /// Aborts downloads made for a seek in progress, which is superseded by
+  /// another one. No segments are requested until the next
+  /// <code>PrepareForSeek()</code> call.
+  void CancelSeek();
+
+  /// Frees memory of an idle stream, e.g. one paused for long: downloads
+  /// are cancelled and the demuxer is destroyed together with its buffers,
+  /// which lets its thread exit. The initialization segment is kept, so the
+  /// demuxer is created again without a download on the next seek. No
+  /// segments are requested and no packets are passed on until the next
+  /// <code>PrepareForSeek()</code> call.
+  void Trim();
+
+  AppendResult AppendPacket(const ElementaryStreamPacket& packet) override;
 
-  bool AppendPacket(std::unique_ptr<ElementaryStreamPacket>);
+  size_t AppendPackets(
+      const std::vector<const ElementaryStreamPacket*>& packets,
+      AppendResult* result) override;
 
-  bool SetConfig(const AudioConfig& audio_config);
-  bool SetConfig(const VideoConfig& video_config);
+  bool SetConfig(const AudioConfig& audio_config) override;
+  bool SetConfig(const VideoConfig& video_config) override;
 
   void SetSegmentToTime(Samsung::NaClPlayer::TimeTicks time,
       Samsung::NaClPlayer::TimeTicks* timestamp,
-      Samsung::NaClPlayer::TimeTicks* duration);
+      Samsung::NaClPlayer::TimeTicks* duration) override;
 
   Samsung::NaClPlayer::TimeTicks GetClosestKeyframeTime(
       Samsung::NaClPlayer::TimeTicks);
@@ -0,0 +1,94 @@
+/*!
+ * stream_sink.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_STREAM_SINK_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_STREAM_SINK_H_
+
+#include <vector>
+
+#include "common.h"
+#include "demuxer/elementary_stream_packet.h"
+#include "demuxer/stream_demuxer.h"
+
+/// @file
+/// @brief This file defines the <code>StreamSink</code> interface.
+
+/// @class StreamSink
+/// This interface is a part of <code>StreamManager</code> used by
+/// <code>PacketsManager</code> to feed a single elementary stream with
+/// synchronized packets. It allows to drive <code>PacketsManager</code>
+/// without NaCl Player, e.g. in benchmarks.
+///
+/// @see class <code>PacketsManager</code>
+/// @see class <code>StreamManager</code>
+
+class StreamSink {
+ public:
+  /// A result of appending a packet to NaCl Player.
+  enum class AppendResult {
+    kAppended,
+    /// The player can't take more data now (e.g. its buffer is full). The
+    /// packet can be appended again once the player needs data.
+    kTryAgain,
+    /// The packet was rejected, appending it again won't help.
+    kFailed
+  };
+
+  virtual ~StreamSink();
+
+  /// Checks if the stream is initialized, i.e. its configuration can be
+  /// changed only after packets of the previous one are appended.
+  virtual bool IsInitialized() = 0;
+
+  /// Checks if the stream is seeking, i.e. packets of the old position
+  /// should be dropped.
+  virtual bool IsSeeking() const = 0;
+
+  /// Appends a packet to the underlying NaCl Player stream. The packet stays
+  /// owned by the caller, so it can be appended again on
+  /// <code>AppendResult::kTryAgain</code>.
+  virtual AppendResult AppendPacket(const ElementaryStreamPacket& packet) = 0;
+
+  /// Appends packets to the underlying NaCl Player stream in the given order,
+  /// until one of them is not appended. Packets stay owned by the caller.
+  ///
+  /// @param[in] packets Packets to append.
+  /// @param[out] result A result of the last append, i.e. why the packet at
+  ///   the returned index wasn't appended, or
+  ///   <code>AppendResult::kAppended</code> if all packets were appended.
+  /// @return A number of packets appended.
+  virtual size_t AppendPackets(
+      const std::vector<const ElementaryStreamPacket*>& packets,
+      AppendResult* result) = 0;
+
+  virtual bool SetConfig(const AudioConfig& audio_config) = 0;
+  virtual bool SetConfig(const VideoConfig& video_config) = 0;
+
+  /// Makes the stream continue from a segment containing <code>time</code>
+  /// after a seek.
+  ///
+  /// @param[in] time A seek position.
+  /// @param[out] timestamp A start of the segment, can be null.
+  /// @param[out] duration A duration of the segment, can be null.
+  virtual void SetSegmentToTime(Samsung::NaClPlayer::TimeTicks time,
+      Samsung::NaClPlayer::TimeTicks* timestamp,
+      Samsung::NaClPlayer::TimeTicks* duration) = 0;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_STREAM_SINK_H_
@@ -0,0 +1,145 @@
+/*!
+ * task_executor.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_TASK_EXECUTOR_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_TASK_EXECUTOR_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+#include "ppapi/cpp/completion_callback.h"
+#include "ppapi/cpp/message_loop.h"
+#include "ppapi/utility/threading/lock.h"
+
+/// @file
+/// @brief This file defines the <code>TaskExecutor</code> interface and its
+/// implementations.
+
+/// @class TaskExecutor
+/// A clock and a queue of delayed tasks of a single thread, i.e. what
+/// timing decisions of the player (buffer updates, watchdogs, download
+/// deadlines, ABR and metrics intervals) are based on.
+/// <code>MessageLoopExecutor</code> uses the real clock and a
+/// <code>pp::MessageLoop</code>, while <code>SimulatedExecutor</code> runs
+/// tasks in virtual time, so such decisions can be replayed
+/// deterministically.
+///
+/// Tasks are <code>pp::CompletionCallback</code>s, so ones made by
+/// <code>pp::CompletionCallbackFactory</code> are dropped when their
+/// object is gone, like with <code>pp::MessageLoop::PostWork()</code>.
+///
+/// @see class <code>MessageLoopExecutor</code>
+/// @see class <code>SimulatedExecutor</code>
+
+class TaskExecutor {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  virtual ~TaskExecutor();
+
+  /// Returns the current time of this executor.
+  virtual Clock::time_point Now() const = 0;
+
+  /// Runs callback with <code>PP_OK</code> after delay_ms milliseconds.
+  /// Tasks with the same due time run in the order they were posted. It's
+  /// thread safe.
+  virtual void PostWork(const pp::CompletionCallback& callback,
+                        int64_t delay_ms = 0) = 0;
+};
+
+/// @class MessageLoopExecutor
+/// Posts tasks to a <code>pp::MessageLoop</code>, uses the steady clock.
+class MessageLoopExecutor : public TaskExecutor {
+ public:
+  explicit MessageLoopExecutor(const pp::MessageLoop& message_loop);
+  ~MessageLoopExecutor() override;
+
+  Clock::time_point Now() const override;
+  void PostWork(const pp::CompletionCallback& callback,
+                int64_t delay_ms = 0) override;
+
+ private:
+  pp::MessageLoop message_loop_;
+};
+
+/// @class SimulatedExecutor
+/// Runs tasks in virtual time, only when asked to. Time stands still unless
+/// it's advanced with <code>AdvanceBy()</code>, so the same sequence of
+/// posted tasks always runs in the same order, regardless of the speed of
+/// the device. Tasks posted from other threads are queued as well, but run
+/// on the thread calling <code>AdvanceBy()</code> or
+/// <code>RunUntilIdle()</code>.
+class SimulatedExecutor : public TaskExecutor {
+ public:
+  explicit SimulatedExecutor(
+      Clock::time_point start_time = Clock::time_point());
+  ~SimulatedExecutor() override;
+
+  Clock::time_point Now() const override;
+  void PostWork(const pp::CompletionCallback& callback,
+                int64_t delay_ms = 0) override;
+
+  /// Runs tasks which are due, including ones they post without a delay,
+  /// but at most max_tasks of them, so a task reposting itself doesn't hang
+  /// the caller.
+  ///
+  /// @return A number of tasks run.
+  size_t RunUntilIdle(size_t max_tasks = kDefaultMaxTasks);
+
+  /// Moves the time forward by time, running tasks which become due on the
+  /// way at their due times, in order.
+  ///
+  /// @return A number of tasks run.
+  size_t AdvanceBy(std::chrono::milliseconds time,
+                   size_t max_tasks = kDefaultMaxTasks);
+
+  /// Returns a number of tasks waiting, due or not.
+  size_t PendingTasks() const;
+
+  static constexpr size_t kDefaultMaxTasks = 100000;
+
+ private:
+  struct Task {
+    Clock::time_point due_time;
+    // Keeps tasks with the same due time in the posting order.
+    uint64_t sequence;
+    pp::CompletionCallback callback;
+  };
+
+  struct RunsLater {
+    bool operator()(const Task& a, const Task& b) const {
+      if (a.due_time != b.due_time) return a.due_time > b.due_time;
+      return a.sequence > b.sequence;
+    }
+  };
+
+  // Takes the first task due at or before time, returns false if there is
+  // none.
+  bool PopTaskDueAt(Clock::time_point time, Task* task);
+
+  mutable pp::Lock lock_;
+  Clock::time_point now_;
+  uint64_t next_sequence_;
+  std::priority_queue<Task, std::vector<Task>, RunsLater> tasks_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_TASK_EXECUTOR_H_
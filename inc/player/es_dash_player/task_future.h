@@ -0,0 +1,189 @@
+/*!
+ * task_future.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_INC_PLAYER_ES_DASH_PLAYER_TASK_FUTURE_H_
+#define NATIVE_PLAYER_INC_PLAYER_ES_DASH_PLAYER_TASK_FUTURE_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "ppapi/c/pp_errors.h"
+#include "ppapi/cpp/completion_callback.h"
+
+#include "player/es_dash_player/task_executor.h"
+
+/// @file
+/// @brief This file defines the <code>Promise</code> and <code>Future</code>
+/// classes, which chain asynchronous steps on <code>TaskExecutor</code>s
+/// instead of blocking a thread until a step is done.
+
+template <typename T>
+class Promise;
+
+namespace internal {
+
+// A value shared by a promise and its future, with a continuation waiting
+// for it.
+template <typename T>
+struct FutureState {
+  std::mutex mutex;
+  std::unique_ptr<T> value;
+  std::function<void(T)> continuation;
+};
+
+// Runs and deletes a task posted to a TaskExecutor. A task dropped by a
+// destroyed message loop is deleted without running.
+inline void RunPostedTask(void* user_data, int32_t result) {
+  std::unique_ptr<std::function<void()>> task(
+      static_cast<std::function<void()>*>(user_data));
+  if (result == PP_OK) (*task)();
+}
+
+}  // namespace internal
+
+/// @class Future
+/// A value which a <code>Promise</code> provides later, e.g. a result of a
+/// task running on a network thread. A future has at most one continuation,
+/// which gets the value once it's set. Values are moved, so they can be
+/// move-only.
+///
+/// A continuation is dropped if its promise is destroyed without setting a
+/// value, e.g. because a task producing it was dropped with its executor.
+///
+/// @see class <code>Promise</code>
+/// @see <code>WhenAll()</code>
+template <typename T>
+class Future {
+ public:
+  Future() = default;
+
+  bool IsValid() const { return static_cast<bool>(state_); }
+
+  /// Runs continuation with the value on executor, once the value is set.
+  /// Continuations which can outlive their objects should be made with
+  /// <code>WeakBind()</code>.
+  void Then(std::shared_ptr<TaskExecutor> executor,
+            std::function<void(T)> continuation) {
+    OnResolved([executor, continuation](T value) {
+      // std::function needs a copyable task, so the value is shared.
+      auto shared_value = std::make_shared<T>(std::move(value));
+      executor->PostWork(pp::CompletionCallback(&internal::RunPostedTask,
+          new std::function<void()>([continuation, shared_value]() {
+            continuation(std::move(*shared_value));
+          })));
+    });
+  }
+
+  /// Runs continuation with the value on the thread which sets it, or right
+  /// away if it's set already. Continuations must be short.
+  void OnResolved(std::function<void(T)> continuation) {
+    std::unique_ptr<T> value;
+    {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      if (!state_->value) {
+        state_->continuation = std::move(continuation);
+        return;
+      }
+      value = std::move(state_->value);
+    }
+    continuation(std::move(*value));
+  }
+
+ private:
+  friend class Promise<T>;
+
+  explicit Future(std::shared_ptr<internal::FutureState<T>> state)
+      : state_(std::move(state)) {}
+
+  std::shared_ptr<internal::FutureState<T>> state_;
+};
+
+/// @class Promise
+/// Sets a value of its <code>Future</code>. Copies of a promise set the same
+/// future, so it can be captured by tasks, and the value is set only once.
+/// It's thread safe.
+template <typename T>
+class Promise {
+ public:
+  Promise() : state_(std::make_shared<internal::FutureState<T>>()) {}
+
+  Future<T> GetFuture() const { return Future<T>(state_); }
+
+  void SetValue(T value) {
+    std::function<void(T)> continuation;
+    {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      if (!state_->continuation) {
+        state_->value.reset(new T(std::move(value)));
+        return;
+      }
+      continuation = std::move(state_->continuation);
+      state_->continuation = nullptr;
+    }
+    continuation(std::move(value));
+  }
+
+ private:
+  std::shared_ptr<internal::FutureState<T>> state_;
+};
+
+/// Returns a future of values of all futures, in their order, set when the
+/// last of them is. Steps which don't depend on each other are started
+/// together and joined with it, so the next step waits only for the slowest
+/// of them.
+template <typename T>
+Future<std::vector<T>> WhenAll(const std::vector<Future<T>>& futures) {
+  struct Join {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<T>> values;
+    size_t pending;
+    Promise<std::vector<T>> promise;
+  };
+
+  auto join = std::make_shared<Join>();
+  join->values.resize(futures.size());
+  join->pending = futures.size();
+  auto all = join->promise.GetFuture();
+  if (futures.empty()) {
+    join->promise.SetValue(std::vector<T>());
+    return all;
+  }
+
+  for (size_t i = 0; i < futures.size(); ++i) {
+    Future<T> future = futures[i];
+    future.OnResolved([join, i](T value) {
+      {
+        std::lock_guard<std::mutex> lock(join->mutex);
+        join->values[i].reset(new T(std::move(value)));
+        if (--join->pending > 0) return;
+      }
+      std::vector<T> values;
+      values.reserve(join->values.size());
+      for (auto& joined : join->values) values.push_back(std::move(*joined));
+      join->promise.SetValue(std::move(values));
+    });
+  }
+  return all;
+}
+
+#endif  // NATIVE_PLAYER_INC_PLAYER_ES_DASH_PLAYER_TASK_FUTURE_H_
@@ -0,0 +1,62 @@
+/*!
+ * text_track_parser.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_INC_PLAYER_ES_DASH_PLAYER_TEXT_TRACK_PARSER_H_
+#define NATIVE_PLAYER_INC_PLAYER_ES_DASH_PLAYER_TEXT_TRACK_PARSER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "nacl_player/media_common.h"
+
+// A subtitle shown between start and end, in seconds.
+struct TextCue {
+  Samsung::NaClPlayer::TimeTicks start;
+  Samsung::NaClPlayer::TimeTicks end;
+  std::string text;
+};
+
+// Parses cues of a DASH text representation one segment at a time, so
+// subtitles of a long content are never held (or parsed) at once. Supported
+// are WebVTT and TTML segments, as well as both of them carried in ISO BMFF
+// segments ("wvtt" and "stpp" codecs).
+class TextTrackParser {
+ public:
+  // Returns null if the format is not supported.
+  static std::unique_ptr<TextTrackParser> Create(const std::string& mime_type,
+                                                 const std::string& codecs);
+
+  virtual ~TextTrackParser() = default;
+
+  // Checks if segments need an initialization segment to be parsed.
+  virtual bool NeedsInitSegment() const { return false; }
+
+  // Parses a segment, or an initialization segment, appending its cues to
+  // *cues. Times are media times of the representation, in seconds.
+  // Returns false if the data is malformed, cues parsed before an error are
+  // still appended.
+  virtual bool Parse(const uint8_t* data, size_t size,
+                     std::vector<TextCue>* cues) = 0;
+
+ protected:
+  TextTrackParser() = default;
+};
+
+#endif  // NATIVE_PLAYER_INC_PLAYER_ES_DASH_PLAYER_TEXT_TRACK_PARSER_H_
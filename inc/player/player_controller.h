@@ -78,6 +78,30 @@ class PlayerController {
   ///   operation completes.
   virtual void Seek(Samsung::NaClPlayer::TimeTicks to_time) = 0;
 
+  /// Informs the player that a seek to the defined time is likely, so it can
+  /// download data needed there in advance. Players which can show a
+  /// thumbnail of the position send a <code>kThumbnail</code> message.
+  ///
+  /// param[in] to_time A candidate seek position.
+  virtual void PreviewSeek(Samsung::NaClPlayer::TimeTicks to_time) = 0;
+
+  /// Orders the player to fast forward or rewind showing keyframes only, to
+  /// play continuously at a different speed if the platform supports it, or
+  /// to return to a normal playback. Players which don't support it ignore
+  /// this call.
+  ///
+  /// @param[in] rate A playback rate, negative values rewind. 1 returns to
+  ///   a normal playback.
+  virtual void SetPlaybackRate(double rate) = 0;
+
+  /// Orders the player to play the given content after the loaded one (and
+  /// after content enqueued before) without stopping in between. Players
+  /// which don't support it ignore this call.
+  ///
+  /// @param[in] url A URL address of the content, of the same type as the
+  ///   loaded one.
+  virtual void EnqueueMedia(const std::string& url) = 0;
+
   /// Orders the player to change a stream representation to a defined one.
   ///
   /// @param[in] stream_type A definition which stream representation should be
@@ -95,6 +119,31 @@ class PlayerController {
   /// track's information.
   virtual void PostTextTrackInfo() = 0;
 
+  /// Orders the player to send a message with a snapshot of its metrics.
+  /// Players which don't support it ignore this call.
+  virtual void PostMetrics() = 0;
+
+  /// Sets how often the player sends metrics during playback. Players which
+  /// don't support it ignore this call.
+  ///
+  /// @param[in] interval An interval in seconds, 0 stops sending metrics
+  ///   periodically.
+  virtual void SetMetricsInterval(double interval) = 0;
+
+  /// Informs the player whether the application is visible. A hidden
+  /// player can pause and free memory it doesn't need while it's in the
+  /// background. Players which don't support it ignore this call.
+  ///
+  /// @param[in] visible Whether the application is visible.
+  virtual void SetVisible(bool visible) = 0;
+
+  /// Orders the player to play only audio of the content, so video isn't
+  /// downloaded nor decoded, or to play video again. Players which don't
+  /// support it ignore this call.
+  ///
+  /// @param[in] audio_only Whether only audio should be played.
+  virtual void SetAudioOnly(bool audio_only) = 0;
+
   /// Orders the player to change a subtitles set from current to the
   /// specified one.
   ///
@@ -21,6 +21,7 @@
 #ifndef NATIVE_PLAYER_INC_PLAYER_PLAYER_LISTENERS_H_
 #define NATIVE_PLAYER_INC_PLAYER_PLAYER_LISTENERS_H_
 
+#include <functional>
 #include <memory>
 
 #include "nacl_player/buffering_listener.h"
@@ -78,9 +79,18 @@ class MediaPlayerListener : public Samsung::NaClPlayer::MediaEventsListener {
   ///
   /// @param[in] message_sender An object which will be used to send messages
   ///   based on received subtitle events through the communication channel
+  /// @param[in] time_update_callback An optional function called on each
+  ///   playback progress event, e.g. to update buffers of the player.
+  /// @param[in] error_callback An optional function called when an error
+  ///   occurs.
   explicit MediaPlayerListener(
-      std::weak_ptr<Communication::MessageSender> message_sender)
-      : message_sender_(std::move(message_sender)) {}
+      std::weak_ptr<Communication::MessageSender> message_sender,
+      std::function<void()> time_update_callback = {},
+      std::function<void(Samsung::NaClPlayer::MediaPlayerError)>
+          error_callback = {})
+      : message_sender_(std::move(message_sender)),
+        time_update_callback_(std::move(time_update_callback)),
+        error_callback_(std::move(error_callback)) {}
 
   /// An event handler method, called periodically during clip playback and
   /// indicates a playback progress. <code>MediaPlayerListener</code> passes
@@ -104,6 +114,8 @@ class MediaPlayerListener : public Samsung::NaClPlayer::MediaEventsListener {
 
  private:
   std::weak_ptr<Communication::MessageSender> message_sender_;
+  std::function<void()> time_update_callback_;
+  std::function<void(Samsung::NaClPlayer::MediaPlayerError)> error_callback_;
 };
 
 /// @class MediaBufferingListener
@@ -120,11 +132,19 @@ class MediaBufferingListener : public Samsung::NaClPlayer::BufferingListener {
   /// @param[in] player_controller A handler to a controller, which will be
   ///   requested to send all text track information through the communication
   ///   channel when buffering finished.
+  /// @param[in] buffering_complete_callback An optional function called when
+  ///   buffering has been completed.
+  /// @param[in] buffering_start_callback An optional function called when
+  ///   buffering has been started.
   explicit MediaBufferingListener(
       std::weak_ptr<Communication::MessageSender> message_sender,
-      std::weak_ptr<PlayerController> player_controller = {})
+      std::weak_ptr<PlayerController> player_controller = {},
+      std::function<void()> buffering_complete_callback = {},
+      std::function<void()> buffering_start_callback = {})
       : message_sender_(std::move(message_sender)),
-        player_controller_(std::move(player_controller)) {}
+        player_controller_(std::move(player_controller)),
+        buffering_complete_callback_(std::move(buffering_complete_callback)),
+        buffering_start_callback_(std::move(buffering_start_callback)) {}
 
   /// An event handler method, called when buffering has been started by the
   /// player. <code>MediaBufferingListener</code> passes this information
@@ -154,6 +174,8 @@ class MediaBufferingListener : public Samsung::NaClPlayer::BufferingListener {
  private:
   std::weak_ptr<Communication::MessageSender> message_sender_;
   std::weak_ptr<PlayerController> player_controller_;
+  std::function<void()> buffering_complete_callback_;
+  std::function<void()> buffering_start_callback_;
 };
 
 /// @struct PlayerListeners
@@ -20,8 +20,10 @@
 #ifndef NATIVE_PLAYER_INC_PLAYER_PLAYER_PROVIDER_H_
 #define NATIVE_PLAYER_INC_PLAYER_PLAYER_PROVIDER_H_
 
+#include <memory>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 #include "nacl_player/common.h"
 #include "ppapi/cpp/instance.h"
@@ -30,6 +32,10 @@
 #include "player/player_controller.h"
 #include "communicator/message_sender.h"
 
+class DashPreloader;
+class OfflineStore;
+class WorkerPool;
+
 /// @file
 /// @brief This file defines <code>PlayerProvider</code> class.
 
@@ -73,12 +79,11 @@ class PlayerProvider {
   /// @see pp::Instance
   /// @see Communication::MessageSender
   explicit PlayerProvider(const pp::InstanceHandle& instance,
-      std::shared_ptr<Communication::MessageSender> message_sender)
-      : instance_(instance), message_sender_((std::move(message_sender))) {}
+      std::shared_ptr<Communication::MessageSender> message_sender);
 
   /// Destroys a <code>PlayerProvider</code> object. Created
   /// <code>PlayerController</code> objects will not be destroyed.
-  ~PlayerProvider() {}
+  ~PlayerProvider();
 
   /// Provides an initialized <code>PlayerController</code> of a given type.
   /// The <code>PlayerController</code> object is ready to use. This is the
@@ -112,9 +117,110 @@ class PlayerProvider {
       const std::unordered_map<std::string, std::string>&
             drm_key_request_properties);
 
+  /// Makes a controller created by <code>CreatePlayer()</code> play other
+  /// content instead of creating a new one. Only the data source and the
+  /// state of the content are replaced, NaCl Player, its listeners, network
+  /// executor and bandwidth estimate are kept, so zapping between titles
+  /// is faster. Parameters are the ones of <code>CreatePlayer()</code>.
+  ///
+  /// @param[in] controller A controller created for the given
+  ///   <code>type</code>.
+  /// @return True if the controller loads the content, false if it can't be
+  ///   reused, e.g. it's still loading previous content, and a new one has
+  ///   to be created.
+  bool ReusePlayer(const std::shared_ptr<PlayerController>& controller,
+      PlayerType type,
+      const std::string& url,
+      const Samsung::NaClPlayer::Rect view_rect,
+      const std::string& subtitle,
+      const std::string& encoding,
+      const std::string& drm_license_url,
+      const std::unordered_map<std::string, std::string>&
+            drm_key_request_properties);
+
+  /// Prepares content which is likely to be played next, e.g. the next
+  /// episode, in the background. Its manifest, initialization segments and
+  /// first media segments are downloaded, within a memory budget. A following
+  /// <code>CreatePlayer()</code> of the same type and URL uses them, so the
+  /// playback starts faster. Content preloaded before is dropped.
+  ///
+  /// @param[in] type A type of the player controller which will play the
+  ///   content. Only <code>kEsDash</code> content can be preloaded.
+  /// @param[in] url A URL address of the content, as it will be passed to
+  ///   <code>CreatePlayer()</code>.
+  void PreloadMedia(PlayerType type, const std::string& url);
+
+  /// Keeps content which the user can switch to quickly warm, e.g. live
+  /// channels next to the current one in an EPG. Manifests and
+  /// initialization segments of up to four of them are downloaded in the
+  /// background and manifests of dynamic presentations are refreshed, so a
+  /// following <code>CreatePlayer()</code> or <code>ReusePlayer()</code> of
+  /// one of them starts at the live edge right away. Content which was warm
+  /// before and is not given is dropped.
+  ///
+  /// @param[in] type A type of the player controller which will play the
+  ///   content. Only <code>kEsDash</code> content can be kept warm.
+  /// @param[in] urls URL addresses of the content, the most likely ones
+  ///   first. An empty list drops all warm content.
+  void SetWarmMedia(PlayerType type, const std::vector<std::string>& urls);
+
+  /// Keeps what a player needs to continue its playback while the
+  /// application is suspended: the parsed manifest, cached segments, the
+  /// playback position, representations and the bandwidth estimate. A
+  /// following <code>CreatePlayer()</code> or <code>ReusePlayer()</code> of
+  /// the same URL continues from there without downloading nor parsing the
+  /// manifest again. Content preloaded before is dropped.
+  ///
+  /// @param[in] controller A controller created by
+  ///   <code>CreatePlayer()</code>.
+  /// @param[in] type A type of the controller. Only <code>kEsDash</code>
+  ///   playbacks are kept.
+  void SuspendPlayer(const std::shared_ptr<PlayerController>& controller,
+                     PlayerType type);
+
+  /// Stores content for playback without a network in the background. A
+  /// following <code>CreatePlayer()</code> or <code>ReusePlayer()</code> of
+  /// the same URL plays the stored content. Progress is reported with
+  /// <code>MessageSender::DownloadProgress()</code>.
+  ///
+  /// @param[in] type A type of the player controller which will play the
+  ///   content. Only <code>kEsDash</code> content can be downloaded.
+  /// @param[in] url A URL address of the content.
+  /// @param[in] max_bitrate The highest video bitrate stored, 0 stores the
+  ///   highest one.
+  void DownloadMedia(PlayerType type, const std::string& url,
+                     uint32_t max_bitrate);
+
+  /// Sets how much media the platform buffers before a content starts
+  /// playing, used by following <code>CreatePlayer()</code> calls. Only
+  /// <code>kUrl</code> players use it, <code>kEsDash</code> players buffer
+  /// according to their own buffering policy.
+  ///
+  /// @param[in] initial_buffer Seconds of media, 0 uses the platform
+  ///   default.
+  void SetInitialBuffer(Samsung::NaClPlayer::TimeTicks initial_buffer);
+
+  /// Sets a position following <code>CreatePlayer()</code> and
+  /// <code>ReusePlayer()</code> calls start the playback at. Only
+  /// <code>kEsDash</code> players use it, they download segments from the
+  /// position right away instead of seeking after the start.
+  ///
+  /// @param[in] start_time A position in seconds, 0 starts at the
+  ///   beginning.
+  void SetStartTime(Samsung::NaClPlayer::TimeTicks start_time);
+
  private:
+  // Returns workers shared by players and the preloader of all instances,
+  // they are started with the first one and kept for following ones.
+  std::shared_ptr<WorkerPool> GetWorkerPool();
+
   pp::InstanceHandle instance_;
   std::shared_ptr<Communication::MessageSender> message_sender_;
+  std::shared_ptr<WorkerPool> worker_pool_;
+  std::unique_ptr<DashPreloader> dash_preloader_;
+  std::unique_ptr<OfflineStore> offline_store_;
+  Samsung::NaClPlayer::TimeTicks initial_buffer_;
+  Samsung::NaClPlayer::TimeTicks start_time_;
 };
 
 #endif  // NATIVE_PLAYER_INC_PLAYER_PLAYER_PROVIDER_H_
@@ -22,8 +22,10 @@
 #define NATIVE_PLAYER_INC_PLAYER_URL_PLAYER_URL_PLAYER_CONTROLLER_H_
 
 #include <array>
+#include <chrono>
 #include <string>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "nacl_player/media_player.h"
@@ -90,7 +92,10 @@ class UrlPlayerController : public PlayerController {
         subtitles_visible_(true),
         message_sender_(std::move(message_sender)),
         state_(PlayerState::kUnitialized),
-        video_duration_(0.) {}
+        video_duration_(0.),
+        load_generation_(0),
+        play_requested_(false),
+        initial_buffer_(0.) {}
 
   /// Destroys <code>UrlPlayerController</code> object. This also
   /// destroys a <code>MediaPlayer</code> object and thus a player pipeline.
@@ -112,25 +117,65 @@ class UrlPlayerController : public PlayerController {
   void InitPlayer(const std::string& url, const std::string& subtitle = {},
                   const std::string& encoding = {});
 
+  /// Sets how much media the platform buffers before the playback starts.
+  /// It's used by following <code>InitPlayer()</code> calls, as the
+  /// platform takes it with the URL.
+  ///
+  /// @param[in] initial_buffer Seconds of media, 0 uses the platform
+  ///   default.
+  void SetInitialBuffer(Samsung::NaClPlayer::TimeTicks initial_buffer);
+
   void Play() override;
   void Pause() override;
   void Seek(Samsung::NaClPlayer::TimeTicks to_time) override;
+  void PreviewSeek(Samsung::NaClPlayer::TimeTicks to_time) override;
+  void SetPlaybackRate(double rate) override;
+  void EnqueueMedia(const std::string& url) override;
   void ChangeRepresentation(StreamType stream_type, int32_t id) override;
   void SetViewRect(const Samsung::NaClPlayer::Rect& view_rect) override;
   void PostTextTrackInfo() override;
+  void PostMetrics() override;
+  void SetMetricsInterval(double interval) override;
+  void SetVisible(bool visible) override;
+  void SetAudioOnly(bool audio_only) override;
   void ChangeSubtitles(int32_t id) override;
   void ChangeSubtitleVisibility() override;
   PlayerState GetState() override;
 
  private:
   /// @public
-  /// This method initializes a media data source with the given URL. After a
-  /// successful initialization the media data source is attached to the player.
+  /// This method initializes a media data source with the given URL and
+  /// posts attaching it to the player thread, as the platform opens the URL
+  /// meanwhile. <code>Play()</code> and <code>Seek()</code> called until it
+  /// completes are performed afterwards.
   /// This method is called after <code>UrlPlayerController::InitPlayer</code>.
   /// @param[in] content_container_url A URL address of a file with a media
   /// content.
   void InitializeUrlPlayer(const std::string& content_container_url);
 
+  /// @public
+  /// Attaches the media data source and queries the duration and text
+  /// tracks of the content on the player thread.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] generation A number of the load it belongs to.
+  void OnInitializeUrlPlayer(int32_t /*result*/, uint32_t generation);
+
+  /// @public
+  /// Sends the duration, text tracks and timing of the load to the UI and
+  /// performs commands deferred until it completed. Called on the main
+  /// thread.
+  ///
+  /// @param[in] result A PPAPI error code, required in PP_MessageLoop tasks.
+  ///   PP_OK is an expected value.
+  /// @param[in] attach_result An <code>ErrorCodes</code> value of attaching
+  ///   the data source.
+  /// @param[in] generation A number of the load it belongs to, results of
+  ///   replaced loads are dropped.
+  void OnUrlPlayerInitialized(int32_t /*result*/, int32_t attach_result,
+                              uint32_t generation);
+
   void OnSetDisplayRect(int32_t /*result*/);
 
   void OnSeek(int32_t /*result*/);
@@ -158,6 +203,18 @@ class UrlPlayerController : public PlayerController {
   PlayerState state_;
   Samsung::NaClPlayer::Rect view_rect_;
   Samsung::NaClPlayer::TimeTicks video_duration_;
+
+  // Incremented by each InitializeUrlPlayer() call.
+  uint32_t load_generation_;
+  // Time InitPlayer() was called, used on the player thread while loading.
+  std::chrono::steady_clock::time_point load_start_;
+  // Names of load steps with milliseconds elapsed since load_start_,
+  // filled on the player thread and sent once the load completes.
+  std::vector<std::pair<std::string, double>> load_phases_;
+  // Commands received while the URL is opened.
+  bool play_requested_;
+  std::unique_ptr<Samsung::NaClPlayer::TimeTicks> pending_seek_;
+  Samsung::NaClPlayer::TimeTicks initial_buffer_;
 };
 
 #endif  // NATIVE_PLAYER_INC_PLAYER_URL_PLAYER_URL_PLAYER_CONTROLLER_H_
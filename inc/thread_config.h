@@ -0,0 +1,100 @@
+/*!
+ * thread_config.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ *
+ * @brief
+ * Scheduling priorities and CPU affinity of pipeline threads, configured per
+ * thread role, e.g. so the audio demuxer keeps up when UI loads the CPU.
+ */
+
+#ifndef NATIVE_PLAYER_INC_THREAD_CONFIG_H_
+#define NATIVE_PLAYER_INC_THREAD_CONFIG_H_
+
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/utility/threading/simple_thread.h"
+
+/**
+ * Roles of pipeline threads, in the order they usually should be scheduled.
+ */
+enum class ThreadRole : int32_t {
+  kAudioDemuxer,
+  kVideoDemuxer,
+  // The player thread, which schedules appending packets.
+  kAppendScheduler,
+  // Network workers, downloading and prefetching segments.
+  kDownload,
+  kCount
+};
+
+/**
+ * Settings of thread roles and a factory of pipeline threads, which applies
+ * them when a thread starts. Settings apply to threads started afterwards,
+ * threads which are already running keep theirs.
+ *
+ * A priority is a nice value, from -20 (scheduled first) to 19. Lowering it
+ * below 0 usually needs privileges which the sandbox doesn't have, so the
+ * order is better expressed by raising the values of less important roles.
+ * Priorities and affinity are applied only where the platform supports it
+ * (Linux), elsewhere threads run with defaults.
+ */
+class ThreadConfig {
+ public:
+  static constexpr int32_t kMinPriority = -20;
+  static constexpr int32_t kMaxPriority = 19;
+  // Lets a thread run on any CPU.
+  static constexpr int32_t kAnyCpu = -1;
+
+  /**
+   * Sets a priority and a CPU of threads of the given role. A role which
+   * has never been set keeps threads as they are created.
+   */
+  static void Set(ThreadRole role, int32_t priority, int32_t cpu = kAnyCpu);
+
+  /**
+   * Finds a role by its name, one of <code>"audioDemuxer"</code>,
+   * <code>"videoDemuxer"</code>, <code>"appendScheduler"</code> or
+   * <code>"download"</code>.
+   */
+  static bool GetRoleByName(const std::string& name, ThreadRole* role);
+
+  /**
+   * Applies settings of the role to the calling thread.
+   *
+   * @return False if the settings couldn't be applied.
+   */
+  static bool ApplyToCurrentThread(ThreadRole role);
+
+  /**
+   * Starts a thread running function with settings of the role.
+   */
+  static std::unique_ptr<std::thread> StartThread(
+      ThreadRole role, std::function<void()> function);
+
+  /**
+   * Starts a thread with a message loop and settings of the role.
+   */
+  static std::unique_ptr<pp::SimpleThread> StartSimpleThread(
+      const pp::InstanceHandle& instance, ThreadRole role);
+};
+
+#endif  // NATIVE_PLAYER_INC_THREAD_CONFIG_H_
@@ -0,0 +1,105 @@
+/*!
+ * tracer.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ *
+ * @brief
+ * Lightweight trace events, exported in Chrome trace event format, so
+ * downloads, demuxing and appending can be seen on a timeline in
+ * about:tracing.
+ */
+
+#ifndef NATIVE_PLAYER_INC_TRACER_H_
+#define NATIVE_PLAYER_INC_TRACER_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+/**
+ * Collects trace events (slices, counters and flows between threads) into
+ * per-thread buffers. Each buffer keeps the most recent events of its thread.
+ *
+ * Event names must be string literals (or live as long as the module), only
+ * pointers to them are stored. Tracing is disabled by default, calls are then
+ * a single check of a flag.
+ */
+class Tracer {
+ public:
+  /**
+   * Enables or disables collecting events. Enabling drops events collected
+   * before.
+   */
+  static void SetEnabled(bool enabled);
+
+  static bool IsEnabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Begins and ends a slice on the calling thread. Prefer TRACE_SCOPE.
+   */
+  static void Begin(const char* name);
+  static void End(const char* name);
+
+  /**
+   * Records a value of a counter, e.g. a number of buffered bytes.
+   */
+  static void Counter(const char* name, int64_t value);
+
+  /**
+   * Begins a flow from the current slice, e.g. when passing data to another
+   * thread. The flow is connected to the slice in which FlowEnd() is called
+   * with the same name and id.
+   */
+  static void FlowStart(const char* name, uint64_t id);
+  static void FlowEnd(const char* name, uint64_t id);
+
+  /**
+   * Returns events of all threads as a Chrome trace event JSON.
+   */
+  static std::string ExportJson();
+
+ private:
+  static void AddEvent(const char* name, char phase, uint64_t value);
+
+  static std::atomic<bool> enabled_;
+};
+
+/**
+ * Records a slice lasting until the end of the scope.
+ */
+class ScopedTrace {
+ public:
+  explicit ScopedTrace(const char* name)
+      : name_(Tracer::IsEnabled() ? name : nullptr) {
+    if (name_) Tracer::Begin(name_);
+  }
+
+  ~ScopedTrace() {
+    if (name_) Tracer::End(name_);
+  }
+
+ private:
+  const char* name_;
+};
+
+#define TRACE_CONCAT_INTERNAL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INTERNAL(a, b)
+#define TRACE_SCOPE(name) \
+  ScopedTrace TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+#endif  // NATIVE_PLAYER_INC_TRACER_H_
@@ -0,0 +1,108 @@
+/*!
+ * tuning_profile.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ *
+ * @brief
+ * Values of the playback pipeline which trade startup time, latency, memory
+ * and robustness, gathered in one profile which can be changed at runtime.
+ */
+
+#ifndef NATIVE_PLAYER_INC_TUNING_PROFILE_H_
+#define NATIVE_PLAYER_INC_TUNING_PROFILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/**
+ * A profile of pipeline values, so buffering strategies can be tuned per
+ * device model and content and compared in A/B tests without rebuilding.
+ * The application picks a profile and sends it with kLoadMedia; it's used
+ * by players created since. Fields are set by their names in messages,
+ * which are checked against ranges of sane values. Defaults are the values
+ * the pipeline was tuned with.
+ */
+struct TuningProfile {
+  // Reported in metrics, so results of profiles can be told apart. 0 for
+  // the defaults.
+  int32_t id = 0;
+
+  // How far ahead of the playback position packets are appended to NaCl
+  // Player, and the least that is kept appended, in seconds.
+  double append_ahead = 4.0;
+  double min_append_ahead = 0.5;
+
+  // How far ahead of the playback position segments are downloaded, in
+  // seconds.
+  double segment_ahead = 7.0;
+
+  // When it's not 0, a segment of the audio language the user is likely to
+  // switch to is downloaded in advance and audio is appended at most that
+  // many seconds ahead of the playback position, so a switch is heard after
+  // about that long. Audio is appended as far as other streams otherwise.
+  double language_switch_ahead = 0.;
+
+  // An interval of buffer updates driven by the player thread while
+  // playing, in milliseconds. Updates are also made when data arrives.
+  int64_t buffer_update_interval = 250;
+
+  // Segment downloads which audio and video streams share.
+  size_t download_budget = 4;
+
+  // Bytes FFmpeg probes for stream parameters, and how far into the stream
+  // in microseconds.
+  uint32_t audio_probe_size = 512;
+  uint32_t video_probe_size = 128 * 1024;
+  int64_t analyze_duration = 10 * 1000 * 1000;
+
+  // A capacity of a response buffer when its size is not known, and a size
+  // from which received data is passed on in chunks, in bytes.
+  uint32_t download_buffer_size = 256 * 1024;
+  uint32_t download_chunk_size = 64 * 1024;
+
+  /**
+   * Sets a field by its name in messages, e.g. "appendAhead" (seconds are
+   * used for analyzeDuration). Returns false if there is no such field or
+   * the value is out of its range, the field is left as it is then.
+   */
+  bool Set(const std::string& name, double value);
+
+  /**
+   * Checks constraints between fields, e.g. the least appended time can't
+   * be more than the appended time.
+   */
+  bool IsValid() const;
+
+  /**
+   * Returns fields with their names in messages, e.g. for logs.
+   */
+  std::string ToString() const;
+
+  /**
+   * Makes the profile used by players created from now on. It's thread
+   * safe.
+   */
+  static void SetCurrent(const TuningProfile& profile);
+
+  /**
+   * Returns a copy of the current profile. It's thread safe, components
+   * which read values often keep the copy.
+   */
+  static TuningProfile Current();
+};
+
+#endif  // NATIVE_PLAYER_INC_TUNING_PROFILE_H_
@@ -52,6 +52,8 @@ var clips = [
     ],
     encoding: 'windows-1251',
     type: ClipTypeEnum.kUrl,
+    // A long progressive download, buffering more avoids stalls.
+    initial_buffer: 5,
     poster: 'resources/bunny.jpg',
     describe: 'This is clip played directly from URL',
   },
@@ -109,7 +111,40 @@ var MessageToPlayerEnum = {
   kChangeRepresentation : 5,
   kChangeSubtitlesRepresentation : 7,
   kChangeSubtitlesVisibility : 8,
+  kSeekPreview : 10,
+  kSetPlaybackRate : 11,
+  kPreloadMedia : 12,
+  kEnqueueMedia : 13,
+  kSetTimeUpdateInterval : 14,
+  kSetBinaryMessages : 15,
+  kGetMetrics : 16,
+  kSetThreadPriority : 17,
+  kSetMainThreadBudget : 18,
+  kSetMemoryBudget : 19,
+  kSetMemoryPressure : 20,
+  kSetVisibility : 21,
+  kSetWarmMedia : 22,
+  kDownloadMedia : 23,
+  kSetAudioOnly : 24,
+  kSetDeviceCapabilities : 25,
   kSetLogLevel : 90,
+  kStartTracing : 91,
+  kExportTrace : 92,
+  kBenchmarkDemuxer : 93,
+  kBenchmarkPacketsManager : 94,
+  kBenchmarkManifest : 95,
+  kSimulateNetwork : 96,
+  kSoakTest : 97,
+  kGetAllocationStats : 98,
+  kBenchmarkEncoding : 99,
+  kBenchmarkAll : 100,
+  kGetCpuStats : 101,
+  kStartPacketCapture : 102,
+  kStopPacketCapture : 103,
+  kReplayPacketCapture : 104,
+  kBenchmarkSeek : 105,
+  kBenchmarkSwitch : 106,
+  kBenchmarkDrm : 107,
 };
 
 var MessageFromPlayerEnum = {
@@ -122,8 +157,29 @@ var MessageFromPlayerEnum = {
   kRepresentationChanged : 106,
   kSubtitles : 107,
   kStreamEnded : 108,
+  kLatencyReport : 109,
+  kTraceData : 110,
+  kMessages : 111,
+  kBufferLevel : 112,
+  kMetrics : 113,
+  kPlayerClosed : 114,
+  kQoeEvent : 115,
+  kBenchmarkResult : 116,
+  kMediaLoaded : 117,
+  kThumbnail : 118,
+  kBufferingProgress : 119,
+  kDownloadProgress : 120,
+  kSegmentDownloads : 121,
+  kBufferedRanges : 122,
 };
 
+// The latest buffer level and metrics reported by the player.
+var player_stats = {};
+// Benchmark results as JSON lines, collected until they are saved.
+var benchmark_records = [];
+// If set, records are posted there when kBenchmarkAll finishes.
+var benchmark_upload_url;
+
 var StreamTypeEnum = {
   kInvalid : -1,
   kVideo : 0,
@@ -196,14 +252,34 @@ var kSubsOn = 'Subs ON';
 var kSubsOff = 'Subs OFF';
 var kUrlButtonControls = 7;
 var kSendSeekTimeout = 2000;
+// Seeks requested within this time are sent as one, to the last position.
+var kSeekDebounceTimeout = 300;
 var kMilisecondsInSecond = 1000;
+var kMinTrickPlayRate = 2;
+var kMaxTrickPlayRate = 32;
+// Time updates are requested at this interval in seconds, the current time
+// is interpolated between them when it's rendered.
+var kTimeUpdateInterval = 1;
 
 var clip_duration;
 var current_time;
 var to_seek = 0;
+var previewed_seek;
+var playback_rate = 1;
+// The last time update and performance.now() of its arrival.
+var time_update_time = 0;
+var time_update_arrival = 0;
+var time_render_request;
+var rendered_time_text;
+var rendered_played_percent;
+// An object URL of the image of the last thumbnail, images are sent whole
+// and thumbnails are their tiles.
+var thumbnail_image_url;
+var thumbnail_object_url;
 
 var button_timeout;
 var seek_timeout;
+var seek_debounce_timeout;
 var subtitle_timeout;
 
 var playing = false;
@@ -247,14 +323,80 @@ function Timer(callback, delay) {
 
 function updateCurrentTime(time) {
   current_time = parseFloat(time);
-  var current_time_box = document.getElementById('current_time');
-  current_time_box.innerHTML = current_time;
   if (clip_duration < current_time)
     clip_duration = current_time;
-  var played_bar = document.getElementById('played_bar');
-  played_bar.style.width = parseInt(100.0 * current_time / clip_duration) + '%';
-  document.getElementById('current_time').innerHTML = current_time;
-  return;
+  time_update_time = current_time;
+  time_update_arrival = performance.now();
+  requestTimeRender();
+}
+
+function requestTimeRender() {
+  if (!time_render_request)
+    time_render_request = window.requestAnimationFrame(renderCurrentTime);
+}
+
+// Renders the current time once per frame at most. While playing, the time
+// moves on from the last update at the playback rate, but not further than
+// two update intervals in case the playback stalls. The DOM is touched only
+// when the rendered text or bar width changes.
+function renderCurrentTime(now) {
+  time_render_request = null;
+  var time = time_update_time;
+  if (playing) {
+    var elapsed = Math.min((now - time_update_arrival) / kMilisecondsInSecond,
+                           2 * kTimeUpdateInterval);
+    time = Math.max(time + Math.max(elapsed, 0) * playback_rate, 0);
+    if (clip_duration)
+      time = Math.min(time, clip_duration);
+    requestTimeRender();
+  }
+
+  var time_text = time.toFixed(1);
+  if (time_text != rendered_time_text) {
+    rendered_time_text = time_text;
+    document.getElementById('current_time').innerHTML = time_text;
+  }
+  var played_percent =
+      clip_duration ? parseInt(100.0 * time / clip_duration) : 0;
+  if (played_percent != rendered_played_percent) {
+    rendered_played_percent = played_percent;
+    document.getElementById('played_bar').style.width = played_percent + '%';
+  }
+}
+
+// Shows on the seek bar what is buffered by both streams, from the start of
+// the appended range to the end of the downloaded one.
+function renderBufferedRange() {
+  var ranges = player_stats.bufferedRanges;
+  var bar = document.getElementById('buffered_bar');
+  if (!ranges || !clip_duration || !bar)
+    return;
+  var start = 0;
+  var end = Infinity;
+  [ranges.video, ranges.audio].forEach(function(stream) {
+    var stages = [stream.appended, stream.queued, stream.downloaded].filter(
+        function(range) { return range[1] > range[0]; });
+    if (stages.length == 0)
+      return;
+    start = Math.max(start, Math.min.apply(null, stages.map(
+        function(range) { return range[0]; })));
+    end = Math.min(end, Math.max.apply(null, stages.map(
+        function(range) { return range[1]; })));
+  });
+  if (!(end > start)) {
+    bar.style.width = '0%';
+    return;
+  }
+  bar.style.left = (100.0 * start / clip_duration) + '%';
+  bar.style.width =
+      (100.0 * (Math.min(end, clip_duration) - start) / clip_duration) + '%';
+}
+
+// Asks the player to send time updates at the given interval in seconds.
+function setTimeUpdateInterval(interval) {
+  nacl_module.postMessage(
+      {'messageToPlayer': MessageToPlayerEnum.kSetTimeUpdateInterval,
+       'duration': interval});
 }
 
 function showSubtitles(data) {
@@ -273,10 +415,333 @@ function showSubtitles(data) {
   }
 }
 
+function showThumbnail(data) {
+  if (data.url != thumbnail_image_url) {
+    if (thumbnail_object_url)
+      URL.revokeObjectURL(thumbnail_object_url);
+    thumbnail_image_url = data.url;
+    thumbnail_object_url = URL.createObjectURL(
+        new Blob([data.data], {type: data.mimeType}));
+  }
+  var element = document.getElementById('thumbnail');
+  element.style.width = data.width + 'px';
+  element.style.height = data.height + 'px';
+  element.style.backgroundImage = 'url(' + thumbnail_object_url + ')';
+  element.style.backgroundPosition =
+      -data.x_coordinate + 'px ' + -data.y_coordinate + 'px';
+  element.style.display = 'block';
+}
+
 /**
  * This function is called when a message from NaCl arrives.
  */
+// Names of f64 values of a binary kMetrics message, in order.
+var METRICS_VALUE_NAMES = [
+  'licenseP50', 'licenseP95', 'licenseP99', 'encryptedPacketsPerSecond',
+  'encryptedPackets', 'packetAllocations', 'storageAllocations',
+  'bytesDownloaded', 'segmentsDownloaded', 'bandwidth', 'videoBuffer',
+  'audioBuffer', 'videoBufferedBytes', 'audioBufferedBytes',
+  'packetsAppended', 'packetsDropped', 'seekCount', 'seekLatencyAverage',
+  'seekLatencyMax', 'rebufferCount', 'rebufferDuration',
+  'videoRepresentation', 'audioRepresentation', 'demuxerCpuTime',
+  'mainThreadTime', 'logForwardingTime', 'framesOverBudget', 'shedMessages',
+  'memoryUsage', 'memoryPressure', 'downloadCpu', 'demuxCpu', 'packetsCpu',
+  'drmCpu', 'stallRecoveries', 'tuningProfile', 'playerErrors',
+  'lastPlayerError', 'platformBuffering', 'platformUnderruns',
+  'timeUpdateInterval', 'timeUpdateJitter', 'lateTimeUpdates',
+  'deviceMaxBitrate', 'pipelineSegments', 'requestLatencyP50',
+  'requestLatencyP90', 'requestLatencyP99', 'downloadLatencyP50',
+  'downloadLatencyP90', 'downloadLatencyP99', 'firstPacketLatencyP50',
+  'firstPacketLatencyP90', 'firstPacketLatencyP99', 'parseLatencyP50',
+  'parseLatencyP90', 'parseLatencyP99', 'appendLatencyP50',
+  'appendLatencyP90', 'appendLatencyP99', 'segmentLatencyP50',
+  'segmentLatencyP90', 'segmentLatencyP99',
+];
+
+// Decodes a binary message, see kSetBinaryMessages in messages.h for the
+// layout. Returns an object with the same fields as the dictionary message.
+function decodeBinaryMessage(buffer) {
+  var view = new DataView(buffer);
+  var message = {messageFromPlayer: view.getUint32(0, true)};
+  switch (message.messageFromPlayer) {
+  case MessageFromPlayerEnum.kTimeUpdate:
+    message.time = view.getFloat64(4, true);
+    break;
+  case MessageFromPlayerEnum.kBufferLevel:
+    message.videoBuffer = view.getFloat64(4, true);
+    message.audioBuffer = view.getFloat64(12, true);
+    break;
+  case MessageFromPlayerEnum.kBufferedRanges:
+    var offset = 4;
+    ['videoBuffer', 'audioBuffer'].forEach(function(stream) {
+      message[stream] = {};
+      ['appended', 'queued', 'downloaded'].forEach(function(stage) {
+        message[stream][stage] = [view.getFloat64(offset, true),
+                                  view.getFloat64(offset + 8, true)];
+        offset += 16;
+      });
+    });
+    break;
+  case MessageFromPlayerEnum.kMetrics:
+    message.metrics = {licenseCount: view.getUint32(4, true)};
+    var offset = 8;
+    for (var i = 0; i < METRICS_VALUE_NAMES.length; ++i, offset += 8)
+      message.metrics[METRICS_VALUE_NAMES[i]] = view.getFloat64(offset, true);
+    var histogram = [];
+    var bucket_count = view.getUint32(offset, true);
+    for (var i = 0; i < bucket_count; ++i)
+      histogram.push(view.getUint32(offset + 4 * (i + 1), true));
+    message.metrics.downloadTimeHistogram = histogram;
+    break;
+  }
+  return message;
+}
+
+// Measures demuxer throughput on recorded segments, e.g.
+// benchmarkDemuxer(1, 'video/init.mp4', ['video/1.m4s', 'video/2.m4s']).
+// Pass 'ffmpeg' as demuxer to test FFMpegDemuxer instead of the default one.
+function benchmarkDemuxer(type, init_url, media_urls, demuxer) {
+  var message = {'messageToPlayer': MessageToPlayerEnum.kBenchmarkDemuxer,
+                 'type': type, 'url': init_url, 'urls': media_urls};
+  if (demuxer !== undefined)
+    message['demuxer'] = demuxer;
+  nacl_module.postMessage(message);
+}
+
+// Measures PacketsManager with synthetic packets, results of its scenarios
+// are logged as they come.
+function benchmarkPacketsManager() {
+  nacl_module.postMessage({'messageToPlayer':
+                               MessageToPlayerEnum.kBenchmarkPacketsManager});
+}
+
+// Measures manifest parsing and segment sequences on generated manifests,
+// results are logged as they come.
+function benchmarkManifest() {
+  nacl_module.postMessage({'messageToPlayer':
+                               MessageToPlayerEnum.kBenchmarkManifest});
+}
+
+// Replays network traces against ABR and buffering with segments of the
+// given manifest. traces is optional, it maps names to arrays of
+// [seconds, bitsPerSecond, latencySeconds] points.
+function simulateNetwork(manifest_url, traces) {
+  var message = {'messageToPlayer': MessageToPlayerEnum.kSimulateNetwork,
+                 'url': manifest_url};
+  if (traces !== undefined) message['traces'] = traces;
+  nacl_module.postMessage(message);
+}
+
+// Loops player lifecycles with the given content for duration seconds,
+// 0 stops a running test. seek_range (in seconds) is optional.
+function runSoakTest(type, url, duration, seek_range) {
+  var message = {'messageToPlayer': MessageToPlayerEnum.kSoakTest,
+                 'type': type, 'url': url, 'duration': duration};
+  if (seek_range !== undefined) message['time'] = seek_range;
+  nacl_module.postMessage(message);
+}
+
+// Measures Base64Decode() and ToHexString() with data of a few sizes,
+// results are logged as they come.
+function benchmarkEncoding() {
+  nacl_module.postMessage({'messageToPlayer':
+                               MessageToPlayerEnum.kBenchmarkEncoding});
+}
+
+// Requests CPU time used by pipeline stages, results are logged as they
+// come. sampling_interval (in seconds) is optional, it starts sampling
+// stages of threads, 0 stops it.
+function getCpuStats(sampling_interval) {
+  var message = {'messageToPlayer': MessageToPlayerEnum.kGetCpuStats};
+  if (sampling_interval !== undefined)
+    message['duration'] = sampling_interval;
+  nacl_module.postMessage(message);
+}
+
+// Records configs, packets and player calls seen by PacketsManager to a
+// file. path (in the nacl_io file system) and with_payloads are optional.
+function startPacketCapture(path, with_payloads) {
+  var message = {'messageToPlayer': MessageToPlayerEnum.kStartPacketCapture};
+  if (path !== undefined) message['url'] = path;
+  if (with_payloads !== undefined) message['data'] = with_payloads;
+  nacl_module.postMessage(message);
+}
+
+// Stops recording packets, the size of the capture is logged.
+function stopPacketCapture() {
+  nacl_module.postMessage({'messageToPlayer':
+                               MessageToPlayerEnum.kStopPacketCapture});
+}
+
+// Feeds a packet capture into PacketsManager without NaCl Player, at the
+// original pace, or as fast as possible if max_speed is set. path is
+// optional, the result is logged when the replay ends.
+function replayPacketCapture(path, max_speed) {
+  var message = {'messageToPlayer': MessageToPlayerEnum.kReplayPacketCapture,
+                 'rate': max_speed ? 0 : 1};
+  if (path !== undefined) message['url'] = path;
+  nacl_module.postMessage(message);
+}
+
+// Measures time from seeks to the first keyframe and audio appended, with
+// segments of the given DASH manifests replayed over a simulated link.
+// Results per content type and scenario are logged when all manifests are
+// done.
+function benchmarkSeek(manifest_urls) {
+  nacl_module.postMessage({'messageToPlayer':
+                               MessageToPlayerEnum.kBenchmarkSeek,
+                           'urls': manifest_urls});
+}
+
+// Measures representation switches between the lowest and the highest video
+// bitrate: time to the first packet of the new representation, wasted
+// segment bytes and decoder re-initializations, with segments of the given
+// DASH manifests replayed over a simulated link. Results per scenario and
+// direction are logged when all manifests are done.
+function benchmarkSwitch(manifest_urls) {
+  nacl_module.postMessage({'messageToPlayer':
+                               MessageToPlayerEnum.kBenchmarkSwitch,
+                           'urls': manifest_urls});
+}
+
+// Measures license round trips served from memory and, if manifest_url (of
+// static PlayReady content) is given, appends of its encrypted packets,
+// without NaCl Player. The result is logged when the benchmark is done.
+function benchmarkDrm(manifest_url) {
+  var message = {'messageToPlayer': MessageToPlayerEnum.kBenchmarkDrm};
+  if (manifest_url !== undefined) message['url'] = manifest_url;
+  nacl_module.postMessage(message);
+}
+
+// Runs all benchmarks one after another. options is optional and may have:
+// manifest (a DASH manifest URL for network, seek, switch and DRM benchmarks),
+// type, initUrl and mediaUrls (content for demuxer benchmarks) and uploadUrl
+// (records are posted there when benchmarks finish). The device model is
+// taken from Tizen webapis when they are available.
+function benchmarkAll(options) {
+  options = options || {};
+  var message = {'messageToPlayer': MessageToPlayerEnum.kBenchmarkAll};
+  if (typeof webapis !== 'undefined' && webapis.productinfo)
+    message['device'] = webapis.productinfo.getRealModel();
+  if (options.manifest !== undefined) message['manifest'] = options.manifest;
+  if (options.initUrl !== undefined) {
+    message['type'] = options.type;
+    message['url'] = options.initUrl;
+    message['urls'] = options.mediaUrls;
+  }
+  benchmark_records = [];
+  benchmark_upload_url = options.uploadUrl;
+  nacl_module.postMessage(message);
+}
+
+// Posts collected benchmark records to upload_url, or saves them to a file
+// when it's not given.
+function saveBenchmarkRecords(upload_url) {
+  var records = benchmark_records.join('');
+  benchmark_records = [];
+  if (upload_url) {
+    var request = new XMLHttpRequest();
+    request.open('POST', upload_url);
+    request.setRequestHeader('Content-Type', 'application/x-ndjson');
+    request.send(records);
+    return;
+  }
+  var link = document.createElement('a');
+  link.href = URL.createObjectURL(new Blob([records],
+                                           {type: 'application/x-ndjson'}));
+  link.download = 'benchmarks.jsonl';
+  link.click();
+  setTimeout(function() { URL.revokeObjectURL(link.href); }, 0);
+}
+
+// Requests allocation counters of pipeline stages from a build with
+// ALLOCATION_TRACKING. reset is optional, if true counters are cleared after
+// they are sent.
+function getAllocationStats(reset) {
+  var message = {'messageToPlayer': MessageToPlayerEnum.kGetAllocationStats};
+  if (reset) message['operation'] = 'reset';
+  nacl_module.postMessage(message);
+}
+
+// Requests metrics from the player, interval (in seconds) is optional and
+// changes how often they are sent during playback.
+function getMetrics(interval) {
+  var message = {'messageToPlayer': MessageToPlayerEnum.kGetMetrics};
+  if (interval !== undefined)
+    message['duration'] = interval;
+  nacl_module.postMessage(message);
+}
+
+// Sets a priority (a nice value) of threads of a role, e.g. 'audioDemuxer',
+// started afterwards. cpu is optional and pins the threads to that CPU.
+function setThreadPriority(role, priority, cpu) {
+  var message = {'messageToPlayer': MessageToPlayerEnum.kSetThreadPriority,
+                 'role': role, 'priority': priority};
+  if (cpu !== undefined)
+    message['cpu'] = cpu;
+  nacl_module.postMessage(message);
+}
+
+// Sets seconds of main thread work allowed per UI frame, 0 disables the
+// budget.
+function setMainThreadBudget(seconds) {
+  nacl_module.postMessage(
+      {'messageToPlayer': MessageToPlayerEnum.kSetMainThreadBudget,
+       'duration': seconds});
+}
+
+// Sets a budget of memory held by the playback pipeline, in bytes.
+function setMemoryBudget(bytes) {
+  nacl_module.postMessage(
+      {'messageToPlayer': MessageToPlayerEnum.kSetMemoryBudget,
+       'bytes': bytes});
+}
+
+// Forwards a low memory signal of the platform: 'none', 'moderate' or
+// 'critical'.
+function setMemoryPressure(pressure) {
+  nacl_module.postMessage(
+      {'messageToPlayer': MessageToPlayerEnum.kSetMemoryPressure,
+       'pressure': pressure});
+}
+
+// Tells the player whether the application is visible. A hidden player
+// pauses and frees most of its buffers.
+function setVisibility(visible) {
+  nacl_module.postMessage(
+      {'messageToPlayer': MessageToPlayerEnum.kSetVisibility,
+       'visible': visible});
+}
+
+// Plays only the audio of the content (e.g. for music channels), which saves
+// bandwidth and CPU spent on video. Disabling it seeks to bring video back.
+function setAudioOnly(enabled) {
+  nacl_module.postMessage(
+      {'messageToPlayer': MessageToPlayerEnum.kSetAudioOnly,
+       'enabled': enabled});
+}
+
+// Describes what the device can play, e.g. {width: 1920, height: 1080,
+// channels: 2, hdr: false, codecs: ['avc1', 'mp4a']}. Representations
+// exceeding it are skipped in manifests loaded afterwards.
+function setDeviceCapabilities(capabilities) {
+  var message = {'messageToPlayer':
+                     MessageToPlayerEnum.kSetDeviceCapabilities};
+  for (var key in capabilities) message[key] = capabilities[key];
+  nacl_module.postMessage(message);
+}
+
+function setBinaryMessages(enabled) {
+  nacl_module.postMessage(
+      {'messageToPlayer': MessageToPlayerEnum.kSetBinaryMessages,
+       'enabled': enabled});
+}
+
 function handleNaclMessage(message_event) {
+  if (message_event.data instanceof ArrayBuffer) {
+    handleNaclMessage({data: decodeBinaryMessage(message_event.data)});
+    return;
+  }
   var message = message_event.data;
   if (printIfLog(message)) {  // function defined in common.js
     return;   // this was a log or error message, so we can finish this handling
@@ -287,7 +752,7 @@ function handleNaclMessage(message_event) {
 
   switch (message_event.data.messageFromPlayer) {
   case MessageFromPlayerEnum.kTimeUpdate:
-    updateCurrentTime( message_event.data.time)
+    updateCurrentTime(message_event.data.time);
     break;
   case MessageFromPlayerEnum.kSetDuration:
     clip_duration = message_event.data.time;
@@ -297,6 +762,9 @@ function handleNaclMessage(message_event) {
   case MessageFromPlayerEnum.kBufferingCompleted:
     ui_enabled = true;
     document.getElementById('loading').style.display = 'none';
+    document.getElementById('seek_to_box').innerHTML = '';
+    preloadNextClip();
+    warmNeighbourClips();
     break;
   case MessageFromPlayerEnum.kAudioRepresentation:
     document.getElementById('audio_reps').style.display = 'inline-block';
@@ -340,6 +808,72 @@ function handleNaclMessage(message_event) {
     ui_enabled = false;
     document.getElementById('ended').style.display = 'block';
     break;
+  case MessageFromPlayerEnum.kLatencyReport:
+    var phases = message_event.data.phases;
+    var breakdown = [];
+    for (var phase in phases)
+      breakdown.push(phase + ': ' + phases[phase].toFixed(0) + ' ms');
+    console.log(message_event.data.operation + ' latency - ' +
+                breakdown.join(', '));
+    break;
+  case MessageFromPlayerEnum.kTraceData:
+    saveTrace(message_event.data.trace);
+    break;
+  case MessageFromPlayerEnum.kBufferLevel:
+    player_stats.videoBuffer = message_event.data.videoBuffer;
+    player_stats.audioBuffer = message_event.data.audioBuffer;
+    break;
+  case MessageFromPlayerEnum.kBufferedRanges:
+    player_stats.bufferedRanges = {video: message_event.data.videoBuffer,
+                                   audio: message_event.data.audioBuffer};
+    renderBufferedRange();
+    break;
+  case MessageFromPlayerEnum.kMetrics:
+    player_stats.metrics = message_event.data.metrics;
+    break;
+  case MessageFromPlayerEnum.kSegmentDownloads:
+    player_stats.downloads = message_event.data.downloads;
+    break;
+  case MessageFromPlayerEnum.kPlayerClosed:
+    console.log('Player closed.');
+    break;
+  case MessageFromPlayerEnum.kMediaLoaded:
+    if (message_event.data.error != 0)
+      console.log('Failed to open media, error: ' + message_event.data.error);
+    break;
+  case MessageFromPlayerEnum.kBufferingProgress:
+    document.getElementById('seek_to_box').innerHTML =
+        '<i>Buffering ' + message_event.data.percent + ' %</i>';
+    break;
+  case MessageFromPlayerEnum.kDownloadProgress:
+    if (message_event.data.error != 0)
+      console.log('Failed to download ' + message_event.data.url +
+                  ', error: ' + message_event.data.error);
+    else
+      console.log('Downloaded ' + message_event.data.percent + ' % of ' +
+                  message_event.data.url);
+    break;
+  case MessageFromPlayerEnum.kThumbnail:
+    showThumbnail(message_event.data);
+    break;
+  case MessageFromPlayerEnum.kBenchmarkResult:
+    console.log(message_event.data.benchmark + ' benchmark: ' +
+                JSON.stringify(message_event.data.metrics));
+    if (message_event.data.records)
+      benchmark_records.push(message_event.data.records);
+    if (message_event.data.benchmark == 'all/done' && benchmark_upload_url)
+      saveBenchmarkRecords(benchmark_upload_url);
+    break;
+  case MessageFromPlayerEnum.kQoeEvent:
+    console.log('QoE event: ' + message_event.data.event + ' at ' +
+                message_event.data.time.toFixed(3) + ' s, state: ' +
+                JSON.stringify(message_event.data.state));
+    break;
+  case MessageFromPlayerEnum.kMessages:
+    var messages = message_event.data.messages;
+    for (var i = 0; i < messages.length; ++i)
+      handleNaclMessage({data: messages[i]});
+    break;
   }
 }
 
@@ -362,6 +896,7 @@ function onSeekHover(e) {
   var seek_to_s = parseInt(getSeekS(e));
   var seek_to_box = document.getElementById('seek_to_box');
   seek_to_box.innerHTML = '<i>Seek to ' + seek_to_s + ' s</i>';
+  sendSeekPreview(getSeekS(e));
   e.stopPropagation();
   e.preventDefault();
 }
@@ -369,6 +904,7 @@ function onSeekHover(e) {
 function onSeekOut(e) {
   var seek_to_box = document.getElementById('seek_to_box');
   seek_to_box.innerHTML = '';
+  document.getElementById('thumbnail').style.display = 'none';
   e.stopPropagation();
   e.preventDefault();
 }
@@ -395,6 +931,31 @@ function onSubsClick() {
   }
 }
 
+// Tuning profiles sent with kLoadMedia, see TuningProfile in
+// tuning_profile.h. Values which are not set keep their defaults. A profile
+// of the device model (as webapis.productinfo reports it) is overridden by
+// the content profile named by the 'tuning' field of a clip.
+var device_tuning_profiles = {};
+var content_tuning_profiles = {
+  'live': {'id': 1, 'appendAhead': 2, 'segmentAhead': 4},
+  'fastStart': {'id': 2, 'videoProbeSize': 32768, 'analyzeDuration': 2},
+};
+
+// Returns the tuning profile for a clip, undefined for the defaults.
+function tuningProfile(clip) {
+  var profile;
+  var merge = function(values) {
+    if (!values) return;
+    profile = profile || {};
+    for (var key in values) profile[key] = values[key];
+  };
+  if (typeof webapis !== 'undefined' && webapis.productinfo)
+    merge(device_tuning_profiles[webapis.productinfo.getRealModel()]);
+  if (clip.hasOwnProperty('tuning'))
+    merge(content_tuning_profiles[clip.tuning]);
+  return profile;
+}
+
 function onLoadClick() {
   ui_enabled = false;
 
@@ -415,6 +976,15 @@ function onLoadClick() {
     'url': clips[selected_clip].url
   };
 
+  if (clips[selected_clip].hasOwnProperty('initial_buffer'))
+    message.initialBuffer = clips[selected_clip].initial_buffer;
+
+  if (clips[selected_clip].hasOwnProperty('start_time'))
+    message.startTime = clips[selected_clip].start_time;
+
+  var tuning = tuningProfile(clips[selected_clip]);
+  if (tuning !== undefined) message.tuning = tuning;
+
   if (clips[selected_clip].hasOwnProperty('drm_license_url'))
     message.drm_license_url = clips[selected_clip].drm_license_url;
 
@@ -426,10 +996,62 @@ function onLoadClick() {
   nacl_module.postMessage(message);
 }
 
+// The next clip on the list is the one likely to be played next, like the
+// next episode.
+function preloadNextClip() {
+  var next_clip = parseInt(selected_clip) + 1;
+  if (next_clip >= clips.length || clips[next_clip].type != ClipTypeEnum.kDash)
+    return;
+  nacl_module.postMessage({'messageToPlayer': MessageToPlayerEnum.kPreloadMedia,
+                           'type': clips[next_clip].type,
+                           'url': clips[next_clip].url});
+}
+
+// Clips next to the current one on the list are the ones zapped to, like
+// neighbouring channels of an EPG.
+function warmNeighbourClips() {
+  var current_clip = parseInt(selected_clip);
+  var urls = [];
+  [current_clip + 1, current_clip - 1].forEach(function(clip_index) {
+    if (clip_index >= 0 && clip_index < clips.length &&
+        clips[clip_index].type == ClipTypeEnum.kDash)
+      urls.push(clips[clip_index].url);
+  });
+  nacl_module.postMessage({'messageToPlayer': MessageToPlayerEnum.kSetWarmMedia,
+                           'urls': urls});
+}
+
+// Makes the given DASH clip play right after the current one.
+function enqueueClip(clip_index) {
+  if (clip_index >= clips.length ||
+      clips[clip_index].type != ClipTypeEnum.kDash)
+    return;
+  nacl_module.postMessage({'messageToPlayer': MessageToPlayerEnum.kEnqueueMedia,
+                           'url': clips[clip_index].url});
+}
+
+// Stores the given DASH clip, so it plays without a network afterwards.
+// max_bitrate limits the stored video quality, it's optional.
+function downloadClip(clip_index, max_bitrate) {
+  if (clip_index >= clips.length ||
+      clips[clip_index].type != ClipTypeEnum.kDash)
+    return;
+  var message = {'messageToPlayer': MessageToPlayerEnum.kDownloadMedia,
+                 'url': clips[clip_index].url};
+  if (max_bitrate) message.bitrate = max_bitrate;
+  nacl_module.postMessage(message);
+}
+
 function onPlayPauseClick() {
   if (!ui_enabled)
     return;
 
+  // Playback returns to the state it had before the trick play.
+  if (playback_rate != 1) {
+    sendPlaybackRate(1);
+    return;
+  }
+
   if (playing) {
     playing = false;
     if (subtitle_timeout)
@@ -465,6 +1087,8 @@ function onPlayClick() {
   if (!ui_enabled)
     return;
 
+  if (playback_rate != 1)
+    sendPlaybackRate(1);
   playing = true;
   if (subtitle_timeout)
     subtitle_timeout.resume();
@@ -476,6 +1100,8 @@ function onPauseClick() {
   if (!ui_enabled)
     return;
 
+  if (playback_rate != 1)
+    sendPlaybackRate(1);
   playing = false;
   if (subtitle_timeout)
     subtitle_timeout.hold();
@@ -498,14 +1124,46 @@ function sendSeek(to_time, from_current_time) {
   ui_enabled = false;
   if (subtitle_timeout)
     subtitle_timeout.execute();
-  if (from_current_time) {
+  if (from_current_time)
     to_time += current_time;
-    nacl_module.postMessage({'messageToPlayer': MessageToPlayerEnum.kSeek,
-                           'time': to_time});   // float
-  } else {
-    nacl_module.postMessage({'messageToPlayer': MessageToPlayerEnum.kSeek,
+  clearTimeout(seek_debounce_timeout);
+  seek_debounce_timeout = setTimeout(
+      function() {
+        nacl_module.postMessage({'messageToPlayer': MessageToPlayerEnum.kSeek,
+                                 'time': to_time});   // float
+      }, kSeekDebounceTimeout);
+}
+
+function sendSeekPreview(to_time) {
+  // Hovering sends many positions, one per second is enough.
+  if (Math.floor(to_time) == previewed_seek)
+    return;
+  previewed_seek = Math.floor(to_time);
+  nacl_module.postMessage({'messageToPlayer': MessageToPlayerEnum.kSeekPreview,
                            'time': to_time});   // float
+}
+
+function sendPlaybackRate(rate) {
+  playback_rate = rate;
+  nacl_module.postMessage({'messageToPlayer':
+                               MessageToPlayerEnum.kSetPlaybackRate,
+                           'rate': rate});   // float
+  var seek_to_box = document.getElementById('seek_to_box');
+  seek_to_box.innerHTML = rate == 1 ? '' : '<i>Speed x' + rate + '</i>';
+}
+
+// Each press in the same direction doubles the speed, a press in the other
+// direction starts over with the lowest speed. URL clips are played by the
+// platform player, which seeks in steps instead.
+function trickPlayHelper(direction) {
+  if (clips[selected_clip].type != ClipTypeEnum.kDash) {
+    seekHelper(direction * 5);
+    return;
   }
+  var speed = kMinTrickPlayRate;
+  if (playback_rate * direction > 1)
+    speed = Math.min(Math.abs(playback_rate) * 2, kMaxTrickPlayRate);
+  sendPlaybackRate(direction * speed);
 }
 
 function sendChangeRepresentation(type, id) {
@@ -526,6 +1184,7 @@ function seekHelper(seek_step) {
   to_seek += seek_step;
   var seek_to_box = document.getElementById('seek_to_box');
   seek_to_box.innerHTML = '<i>Seek ' + to_seek + ' seconds</i>';
+  sendSeekPreview(current_time + to_seek);
   seek_timeout = setTimeout(
       function() {
         sendSeek(to_seek, true);
@@ -592,6 +1251,27 @@ function onFullscreenClick() {
   }
 }
 
+// Trace events can be collected with startTracing() and exportTrace() calls,
+// e.g. from the console, and loaded in about:tracing.
+function startTracing() {
+  nacl_module.postMessage(
+      {'messageToPlayer': MessageToPlayerEnum.kStartTracing});
+}
+
+function exportTrace() {
+  nacl_module.postMessage(
+      {'messageToPlayer': MessageToPlayerEnum.kExportTrace});
+}
+
+function saveTrace(trace) {
+  var link = document.createElement('a');
+  link.href = URL.createObjectURL(new Blob([trace],
+                                           {type: 'application/json'}));
+  link.download = 'trace.json';
+  link.click();
+  setTimeout(function() { URL.revokeObjectURL(link.href); }, 0);
+}
+
 function updateLogLevel(level) {
   logs_level = level;
   nacl_module.postMessage(
@@ -599,3 +1279,11 @@ function updateLogLevel(level) {
        'level': logs_level});
 
 }
+
+// Limits logs of a category (e.g. 'demuxer') to the given level, so other
+// modules can be logged in detail.
+function updateCategoryLogLevel(category, level) {
+  nacl_module.postMessage(
+      {'messageToPlayer': MessageToPlayerEnum.kSetLogLevel,
+       'level': level, 'category': category});
+}
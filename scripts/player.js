@@ -81,7 +81,27 @@ function initPlayer() {
   element.classList.add('selected');
 }
 
+// Forwards low memory warnings of the TV, so the player holds less data.
+function watchMemoryStatus() {
+  if (typeof window['tizen'] == 'undefined' || !tizen.systeminfo)
+    return;
+  tizen.systeminfo.addPropertyValueChangeListener('MEMORY', function(memory) {
+    setMemoryPressure(memory.status == 'WARNING' ? 'critical' : 'none');
+  });
+}
+
+// Lets the player pause and trim its buffers while the application is in
+// the background.
+function watchVisibility() {
+  document.addEventListener('visibilitychange', function() {
+    setVisibility(!document.hidden);
+  });
+}
+
 function exampleSpecificActionAfterNaclLoad() {
+  setTimeUpdateInterval(kTimeUpdateInterval);
+  watchMemoryStatus();
+  watchVisibility();
   onLoadClick();
 }
 
@@ -166,10 +186,10 @@ function keyHandler(e) {
     onCloseClick();
     break;
   case TvKeyEnum.kKeyFF:
-    seekHelper(5);
+    trickPlayHelper(1);
     break;
   case TvKeyEnum.kKeyRW:
-    seekHelper(-5);
+    trickPlayHelper(-1);
     break;
   case TvKeyEnum.kKeyUp:
     updateSelectedIndex(kPrevious);
@@ -0,0 +1,274 @@
+/*!
+ * allocation_tracker.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ *
+ * @brief
+ * Replacement of global operator new and delete counting allocations per
+ * stage, built only with ALLOCATION_TRACKING.
+ */
+
+#include "allocation_tracker.h"
+
+#ifdef ALLOCATION_TRACKING
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+namespace {
+
+// Stages registered after this many are counted as "other".
+constexpr int32_t kMaxStages = 16;
+constexpr int32_t kOtherStage = 0;
+constexpr uint32_t kSampleInterval = 64;
+// Sampled call sites are kept in an open addressing table, sites which
+// don't fit are dropped.
+constexpr size_t kMaxCallSites = 1024;
+
+struct Stage {
+  std::atomic<const char*> name;
+  std::atomic<uint64_t> allocations;
+  std::atomic<uint64_t> bytes;
+  std::atomic<uint64_t> segments;
+  std::atomic<uint64_t> packets;
+};
+
+struct CallSiteSlot {
+  std::atomic<uintptr_t> address;
+  std::atomic<uint64_t> samples;
+};
+
+// Counters are zero-initialized statics, so they are usable by allocations
+// made before other static initializers run. None of the code below
+// allocates.
+Stage stages[kMaxStages];
+std::atomic<int32_t> stage_count(1);
+std::atomic<bool> stages_lock(false);
+CallSiteSlot call_sites[kMaxCallSites];
+
+__thread int32_t current_stage = kOtherStage;
+__thread uint64_t thread_allocations = 0;
+__thread uint32_t sample_countdown = 0;
+
+void Increment(std::atomic<uint64_t>* counter, uint64_t value) {
+  counter->fetch_add(value, std::memory_order_relaxed);
+}
+
+int32_t FindStage(const char* name) {
+  int32_t count = stage_count.load(std::memory_order_acquire);
+  for (int32_t i = 1; i < count; ++i) {
+    const char* stage = stages[i].name.load(std::memory_order_relaxed);
+    if (stage == name || strcmp(stage, name) == 0) return i;
+  }
+  return -1;
+}
+
+// Returns an index of the stage, registering it if it's new.
+int32_t StageIndex(const char* name) {
+  int32_t index = FindStage(name);
+  if (index >= 0) return index;
+
+  while (stages_lock.exchange(true, std::memory_order_acquire)) {}
+  index = FindStage(name);
+  if (index < 0) {
+    int32_t count = stage_count.load(std::memory_order_relaxed);
+    if (count < kMaxStages) {
+      stages[count].name.store(name, std::memory_order_relaxed);
+      stage_count.store(count + 1, std::memory_order_release);
+      index = count;
+    } else {
+      index = kOtherStage;
+    }
+  }
+  stages_lock.store(false, std::memory_order_release);
+  return index;
+}
+
+void SampleCallSite(uintptr_t address) {
+  size_t slot = (address >> 2) % kMaxCallSites;
+  for (size_t probe = 0; probe < kMaxCallSites; ++probe) {
+    CallSiteSlot& site = call_sites[(slot + probe) % kMaxCallSites];
+    uintptr_t expected = 0;
+    if (site.address.load(std::memory_order_relaxed) == address ||
+        site.address.compare_exchange_strong(expected, address) ||
+        expected == address) {
+      Increment(&site.samples, 1);
+      return;
+    }
+  }
+}
+
+void RecordAllocation(size_t size, void* caller) {
+  ++thread_allocations;
+  Stage& stage = stages[current_stage];
+  Increment(&stage.allocations, 1);
+  Increment(&stage.bytes, size);
+  if (sample_countdown-- == 0) {
+    sample_countdown = kSampleInterval - 1;
+    SampleCallSite(reinterpret_cast<uintptr_t>(caller));
+  }
+}
+
+void* Allocate(size_t size, void* caller) {
+  void* ptr = malloc(size ? size : 1);
+  if (ptr) RecordAllocation(size, caller);
+  return ptr;
+}
+
+}  // anonymous namespace
+
+void* operator new(size_t size) {
+  void* ptr = Allocate(size, __builtin_return_address(0));
+  if (!ptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  void* ptr = Allocate(size, __builtin_return_address(0));
+  if (!ptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return Allocate(size, __builtin_return_address(0));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return Allocate(size, __builtin_return_address(0));
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  free(ptr);
+}
+
+bool AllocationTracker::IsEnabled() {
+  return true;
+}
+
+void AllocationTracker::CountSegment(const char* stage) {
+  Increment(&stages[StageIndex(stage)].segments, 1);
+}
+
+void AllocationTracker::CountPackets(const char* stage, uint64_t count) {
+  Increment(&stages[StageIndex(stage)].packets, count);
+}
+
+std::vector<AllocationTracker::StageStats>
+AllocationTracker::GetStageStats() {
+  std::vector<StageStats> result;
+  int32_t count = stage_count.load(std::memory_order_acquire);
+  for (int32_t i = 0; i < count; ++i) {
+    const Stage& stage = stages[i];
+    StageStats stats{i == kOtherStage ? "other" : stage.name.load(),
+                     stage.allocations.load(), stage.bytes.load(),
+                     stage.segments.load(), stage.packets.load()};
+    if (stats.allocations || stats.segments || stats.packets)
+      result.push_back(stats);
+  }
+  return result;
+}
+
+std::vector<AllocationTracker::CallSite> AllocationTracker::GetTopCallSites(
+    size_t count) {
+  std::vector<CallSite> result;
+  for (const auto& site : call_sites) {
+    uintptr_t address = site.address.load();
+    if (address) result.push_back({address, site.samples.load()});
+  }
+  std::sort(result.begin(), result.end(),
+            [](const CallSite& lhs, const CallSite& rhs) {
+              return lhs.samples > rhs.samples;
+            });
+  if (result.size() > count) result.resize(count);
+  return result;
+}
+
+uint64_t AllocationTracker::ThreadAllocations() {
+  return thread_allocations;
+}
+
+void AllocationTracker::Reset() {
+  for (auto& stage : stages) {
+    stage.allocations = 0;
+    stage.bytes = 0;
+    stage.segments = 0;
+    stage.packets = 0;
+  }
+  for (auto& site : call_sites) {
+    site.address = 0;
+    site.samples = 0;
+  }
+}
+
+int32_t AllocationTracker::EnterStage(const char* stage) {
+  int32_t previous = current_stage;
+  current_stage = StageIndex(stage);
+  return previous;
+}
+
+void AllocationTracker::LeaveStage(int32_t previous) {
+  current_stage = previous;
+}
+
+#else  // ALLOCATION_TRACKING
+
+bool AllocationTracker::IsEnabled() {
+  return false;
+}
+
+void AllocationTracker::CountSegment(const char*) {}
+
+void AllocationTracker::CountPackets(const char*, uint64_t) {}
+
+std::vector<AllocationTracker::StageStats>
+AllocationTracker::GetStageStats() {
+  return {};
+}
+
+std::vector<AllocationTracker::CallSite> AllocationTracker::GetTopCallSites(
+    size_t) {
+  return {};
+}
+
+uint64_t AllocationTracker::ThreadAllocations() {
+  return 0;
+}
+
+void AllocationTracker::Reset() {}
+
+int32_t AllocationTracker::EnterStage(const char*) {
+  return 0;
+}
+
+void AllocationTracker::LeaveStage(int32_t) {}
+
+#endif  // ALLOCATION_TRACKING
@@ -17,58 +17,182 @@
  * @author Adam Bujalski
  */
 
+#define LOG_CATEGORY LogCategory::kNet
+
+#include <fcntl.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
 
 #include "ppapi/c/pp_errors.h"
 #include "ppapi/cpp/completion_callback.h"
 #include "ppapi/cpp/instance_handle.h"
 #include "ppapi/cpp/message_loop.h"
-#include "ppapi/cpp/module.h"
 #include "ppapi/cpp/url_loader.h"
 #include "ppapi/cpp/url_response_info.h"
+#include "ppapi/cpp/var.h"
 
 #include "common.h"
+#include "hash_bytes.h"
 #include "logger.h"
+#include "tuning_profile.h"
 
 namespace {
 
-constexpr uint32_t kMinBufferSize = 64 * 1024;
-constexpr uint32_t kExtendBufferSize = 256 * 1024;
+// Size of a single read from the URLLoader. An initial capacity of a
+// response buffer when its size is not known (downloadBufferSize) and a size
+// at which data is passed on in chunk mode (downloadChunkSize) come from the
+// TuningProfile.
+constexpr uint32_t kReadSize = 64 * 1024;
+
+std::array<std::atomic<int64_t>,
+           static_cast<size_t>(TrackedResource::kMaxTrackedResources)>
+    tracked_resources{};
+
+// Values of Base64DecodeTable() other than 6 bit digits.
+constexpr uint8_t kBase64Padding = 0x40;
+constexpr uint8_t kBase64Invalid = 0x80;
+
+// Maps characters to their 6 bit values, '=' to kBase64Padding and the rest
+// to kBase64Invalid.
+const std::array<uint8_t, 256>& Base64DecodeTable() {
+  static const std::array<uint8_t, 256> table = [] {
+    static const char kCodes[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::array<uint8_t, 256> codes;
+    codes.fill(kBase64Invalid);
+    for (uint8_t i = 0; i < 64; ++i)
+      codes[static_cast<uint8_t>(kCodes[i])] = i;
+    codes['='] = kBase64Padding;
+    return codes;
+  }();
+  return table;
+}
+
+// Registered instances, in order of creation. pp::Module::current_instances()
+// can't be used instead, as it's changed on the main thread without a lock.
+pp::Lock& ModuleInstancesLock() {
+  static pp::Lock* lock = new pp::Lock;
+  return *lock;
+}
 
-inline pp::InstanceHandle CurrentInstanceHandle() {
-  pp::Module* module = pp::Module::Get();
-  if (!module) return pp::InstanceHandle(static_cast<PP_Instance>(0));
+std::vector<PP_Instance>& ModuleInstances() {
+  static std::vector<PP_Instance>* instances = new std::vector<PP_Instance>;
+  return *instances;
+}
 
-  if (module->current_instances().empty())
+pp::InstanceHandle CurrentInstanceHandle() {
+  pp::AutoLock lock(ModuleInstancesLock());
+  if (ModuleInstances().empty())
     return pp::InstanceHandle(static_cast<PP_Instance>(0));
 
-  return pp::InstanceHandle(module->current_instances().begin()->first);
+  return pp::InstanceHandle(ModuleInstances().front());
 }
 
-template<typename T>
-int32_t ProcessURLRequest(const pp::URLRequestInfo& request, T* out) {
-  if (out == nullptr)
-    return PP_ERROR_BADARGUMENT;
+// Measures URLRequestTiming of a request, if timing is not null.
+class RequestTimer {
+ public:
+  explicit RequestTimer(URLRequestTiming* timing)
+      : timing_(timing), start_(std::chrono::steady_clock::now()),
+        body_started_(false) {}
 
-  out->clear();
-  if (pp::MessageLoop::GetCurrent().is_null())
-    return PP_ERROR_NO_MESSAGE_LOOP;
+  void FirstByteReceived() {
+    if (timing_) timing_->time_to_first_byte = Elapsed();
+  }
 
-  if (pp::MessageLoop::GetCurrent() == pp::MessageLoop::GetForMainThread())
-    return PP_ERROR_BLOCKS_MAIN_THREAD;
+  // Only the first call after the body started arriving is measured.
+  void BodyReceived() {
+    if (body_started_) return;
+    body_started_ = true;
+    if (timing_) timing_->time_to_first_body_byte = Elapsed();
+  }
 
-  if (request.is_null()) {
-    LOG_ERROR("request is null!");
-    return PP_ERROR_BADARGUMENT;
+  void Finished() {
+    if (timing_) timing_->total_time = Elapsed();
   }
 
-  pp::URLLoader loader(CurrentInstanceHandle());
-  int32_t ret = loader.Open(request, pp::CompletionCallback());
-  if (ret != PP_OK) {
-    LOG_ERROR("Failed to open URLLoader with given request, code: %d", ret);
-    return ret;
+ private:
+  double Elapsed() const {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start_).count();
+  }
+
+  URLRequestTiming* timing_;
+  std::chrono::steady_clock::time_point start_;
+  bool body_started_;
+};
+
+// Returns the response body size announced in Content-Length or
+// Content-Range headers, or 0 if it's not known. The browser decodes a
+// Content-Encoding, so sizes of encoded bodies are not known either.
+size_t GetExpectedBodySize(const pp::URLResponseInfo& response_info) {
+  std::string headers = response_info.GetHeaders().AsString();
+  std::string encoding = GetHttpHeader(headers, "Content-Encoding");
+  if (!encoding.empty() && encoding != "identity") return 0;
+
+  std::string value = GetHttpHeader(headers, "Content-Length");
+  if (!value.empty())
+    return static_cast<size_t>(std::strtoull(value.c_str(), nullptr, 10));
+
+  // Content-Range: bytes <first>-<last>/<total>
+  value = GetHttpHeader(headers, "Content-Range");
+  size_t dash = value.find('-');
+  size_t begin = value.find_first_of("0123456789");
+  if (dash == std::string::npos || begin == std::string::npos || begin > dash)
+    return 0;
+  uint64_t first = std::strtoull(value.c_str() + begin, nullptr, 10);
+  uint64_t last = std::strtoull(value.c_str() + dash + 1, nullptr, 10);
+  if (last < first) return 0;
+  return static_cast<size_t>(last - first + 1);
+}
+
+// Reads next part of the response body and appends it to out. Data is read
+// to scratch first, so the output never holds value-initialized bytes which
+// are about to be overwritten. Returns the number of bytes read, PP_OK at the
+// end of the body or an error code.
+template<typename T>
+int32_t ReadResponseBody(pp::URLLoader* loader, uint8_t* scratch, T* out) {
+  int32_t ret =
+      loader->ReadResponseBody(scratch, kReadSize, pp::CompletionCallback());
+  if (ret <= 0) return ret;
+
+  size_t needed = out->size() + ret;
+  if (out->capacity() < needed)
+    out->reserve(std::max<size_t>(needed, out->capacity() * 2));
+  out->insert(out->end(), scratch, scratch + ret);
+  return ret;
+}
+
+// Unregisters a loader from a token when a request ends.
+class ScopedLoaderAttachment {
+ public:
+  ScopedLoaderAttachment(CancellationToken* token, pp::URLLoader* loader)
+      : token_(token), loader_(loader) {}
+  ~ScopedLoaderAttachment() {
+    if (token_) token_->Detach(*loader_);
   }
 
+ private:
+  CancellationToken* token_;
+  pp::URLLoader* loader_;
+};
+
+// Errors of requests which were cancelled are caused by closing the loader.
+int32_t ErrorCode(int32_t error_code, CancellationToken* token) {
+  return token && token->IsCancelled() ? PP_ERROR_ABORTED : error_code;
+}
+
+// Validates the response of an opened loader and reads its expected body size
+// and headers, if the outputs are not null.
+int32_t CheckResponse(const pp::URLLoader& loader, size_t* expected_size,
+                      URLResponseHeaders* response) {
   pp::URLResponseInfo response_info(loader.GetResponseInfo());
   if (response_info.is_null()) {
     LOG_ERROR("URLLoader::GetResponseInfo returned null");
@@ -81,49 +205,247 @@ int32_t ProcessURLRequest(const pp::URLRequestInfo& request, T* out) {
     return PP_ERROR_FAILED;
   }
 
-  size_t bytes_received = 0;
-  while (true) {
-    if (out->size() < bytes_received + kMinBufferSize)
-      out->resize(bytes_received + kExtendBufferSize);
+  if (expected_size) *expected_size = GetExpectedBodySize(response_info);
+  if (response) {
+    response->status_code = status_code;
+    response->headers = response_info.GetHeaders().AsString();
+  }
+  return PP_OK;
+}
+
+int32_t OpenURLLoader(const pp::URLRequestInfo& request,
+                      pp::URLLoader* loader, size_t* expected_size,
+                      URLResponseHeaders* response = nullptr,
+                      CancellationToken* token = nullptr) {
+  if (pp::MessageLoop::GetCurrent().is_null())
+    return PP_ERROR_NO_MESSAGE_LOOP;
+
+  if (pp::MessageLoop::GetCurrent() == pp::MessageLoop::GetForMainThread())
+    return PP_ERROR_BLOCKS_MAIN_THREAD;
+
+  if (request.is_null()) {
+    LOG_ERROR("request is null!");
+    return PP_ERROR_BADARGUMENT;
+  }
+
+  *loader = pp::URLLoader(CurrentInstanceHandle());
+  if (token && !token->Attach(*loader)) return PP_ERROR_ABORTED;
+  int32_t ret = loader->Open(request, pp::CompletionCallback());
+  if (ret != PP_OK) {
+    ret = ErrorCode(ret, token);
+    if (ret != PP_ERROR_ABORTED)
+      LOG_ERROR("Failed to open URLLoader with given request, code: %d", ret);
+    return ret;
+  }
+
+  return CheckResponse(*loader, expected_size, response);
+}
+
+template<typename T>
+int32_t ProcessURLRequest(const pp::URLRequestInfo& request, T* out,
+                          URLRequestTiming* timing,
+                          URLResponseHeaders* response = nullptr,
+                          CancellationToken* token = nullptr,
+                          const TuningProfile* tuning = nullptr) {
+  if (out == nullptr)
+    return PP_ERROR_BADARGUMENT;
 
-    if (out->size() <= bytes_received) {
+  out->clear();
+  RequestTimer timer(timing);
+  pp::URLLoader loader;
+  ScopedResourceCount loader_count(TrackedResource::kUrlLoader);
+  ScopedLoaderAttachment attachment(token, &loader);
+  size_t expected_size = 0;
+  int32_t ret =
+      OpenURLLoader(request, &loader, &expected_size, response, token);
+  if (ret != PP_OK) return ret;
+  timer.FirstByteReceived();
+
+  // Capacity reserved by the caller is kept when the size is not known.
+  size_t buffer_size = tuning ? tuning->download_buffer_size
+                              : TuningProfile::Current().download_buffer_size;
+  if (expected_size > 0)
+    out->reserve(expected_size);
+  else if (out->capacity() < buffer_size)
+    out->reserve(buffer_size);
+
+  std::unique_ptr<uint8_t[]> scratch(new uint8_t[kReadSize]);
+  do {
+    ret = ReadResponseBody(&loader, scratch.get(), out);
+    if (ret > 0) timer.BodyReceived();
+  } while (ret > 0);
+
+  if (ret < 0) {
+    if (ErrorCode(ret, token) == PP_ERROR_ABORTED) {
       out->clear();
-      LOG_ERROR("Failed to resize buffer");
-      return PP_ERROR_NOMEMORY;
+      return PP_ERROR_ABORTED;
     }
-
-    size_t bytes_to_read = out->size() - bytes_received;
-    ret = loader.ReadResponseBody(&(*out)[bytes_received],
-                                  bytes_to_read,
-                                  pp::CompletionCallback());
-    if (ret < 0) {
+    LOG_ERROR("Failed to ReadResponseBody, result: %d", ret);
+    // Without a known size received bytes can't be resumed.
+    if (expected_size == 0 || out->empty()) {
       out->clear();
-      LOG_ERROR("Failed to ReadResponseBody, result: %d", ret);
       return PP_ERROR_FAILED;
     }
+  }
 
-    if (ret == PP_OK) break;
+  timer.Finished();
+  // Connection dropped mid-body, bytes received so far are kept.
+  if (out->size() < expected_size) {
+    LOG_ERROR("Response body is truncated, received %zu of %zu bytes",
+              out->size(), expected_size);
+    return PP_ERROR_CONNECTION_CLOSED;
+  }
+  return PP_OK;
+}
+
+int32_t ProcessURLRequestInChunks(
+    const pp::URLRequestInfo& request,
+    const std::function<bool(std::vector<uint8_t>&&)>& chunk_callback,
+    URLRequestTiming* timing, CancellationToken* token,
+    URLResponseHeaders* response, const TuningProfile* tuning) {
+  if (!chunk_callback)
+    return PP_ERROR_BADARGUMENT;
+
+  RequestTimer timer(timing);
+  pp::URLLoader loader;
+  ScopedResourceCount loader_count(TrackedResource::kUrlLoader);
+  ScopedLoaderAttachment attachment(token, &loader);
+  size_t expected_size = 0;
+  int32_t ret =
+      OpenURLLoader(request, &loader, &expected_size, response, token);
+  if (ret != PP_OK) return ret;
+  timer.FirstByteReceived();
+  // Bytes passed to chunk_callback.
+  size_t delivered = 0;
+
+  std::unique_ptr<uint8_t[]> scratch(new uint8_t[kReadSize]);
+  std::vector<uint8_t> chunk;
+  // A chunk never exceeds min_chunk_size by more than a single read.
+  size_t min_chunk_size = tuning ? tuning->download_chunk_size
+                                 : TuningProfile::Current().download_chunk_size;
+  chunk.reserve(min_chunk_size + kReadSize);
+  while (true) {
+    ret = ReadResponseBody(&loader, scratch.get(), &chunk);
+    if (ret < 0) {
+      if (ErrorCode(ret, token) == PP_ERROR_ABORTED) {
+        LOG_DEBUG("Download cancelled");
+        return PP_ERROR_ABORTED;
+      }
+      LOG_ERROR("Failed to ReadResponseBody, result: %d", ret);
+      // Chunks passed on can be followed by the rest of the body requested
+      // with a Range header, if its size is known.
+      if (expected_size == 0 || delivered == 0) return PP_ERROR_FAILED;
+      break;
+    }
+    if (ret > 0) timer.BodyReceived();
+
+    bool finished = (ret == PP_OK);
+    if (!chunk.empty() && (finished || chunk.size() >= min_chunk_size)) {
+      delivered += chunk.size();
+      if (!chunk_callback(std::move(chunk))) {
+        LOG_DEBUG("Download aborted by chunk callback");
+        return PP_ERROR_ABORTED;
+      }
+      chunk = std::vector<uint8_t>();
+      if (!finished) chunk.reserve(min_chunk_size + kReadSize);
+    }
 
-    bytes_received += ret;
+    if (finished) break;
   }
 
-  out->resize(bytes_received);
+  timer.Finished();
+  if (delivered < expected_size) {
+    LOG_ERROR("Response body is truncated, received %zu of %zu bytes",
+              delivered, expected_size);
+    return PP_ERROR_CONNECTION_CLOSED;
+  }
   return PP_OK;
 }
 
+std::string MountTemporaryStorage() {
+  static constexpr const char* kMountPoint = "/temporary";
+  mkdir(kMountPoint, 0777);
+  // Most of it is taken by the segment disk cache.
+  if (mount("", kMountPoint, "html5fs", 0,
+            "type=TEMPORARY,expected_size=67108864") != 0) {
+    LOG_ERROR("Can't mount temporary storage.");
+    return std::string();
+  }
+  return kMountPoint;
+}
+
+std::string MountPersistentStorage() {
+  static constexpr const char* kMountPoint = "/persistent";
+  mkdir(kMountPoint, 0777);
+  // Titles downloaded for offline playback are stored there.
+  if (mount("", kMountPoint, "html5fs", 0,
+            "type=PERSISTENT,expected_size=4294967296") != 0) {
+    LOG_ERROR("Can't mount persistent storage.");
+    return std::string();
+  }
+  return kMountPoint;
+}
+
 }  // namespace
 
-std::string ToHexString(uint32_t size, const uint8_t* data) {
-  std::ostringstream oss;
-  oss.setf(std::ios::hex, std::ios::basefield);
-  for (size_t i = 0; i < size; ++i) {
-    oss.width(2);
-    oss.fill('0');
-    oss << static_cast<unsigned>(data[i]);
-    oss << " ";
+std::string GetHttpHeader(const std::string& headers, const std::string& name) {
+  std::istringstream stream(headers);
+  std::string line;
+  while (std::getline(stream, line)) {
+    size_t colon = line.find(':');
+    if (colon != name.size()) continue;
+    if (!std::equal(name.begin(), name.end(), line.begin(),
+                    [](char a, char b) {
+                      return std::tolower(static_cast<unsigned char>(a)) ==
+                             std::tolower(static_cast<unsigned char>(b));
+                    }))
+      continue;
+    size_t begin = line.find_first_not_of(" \t", colon + 1);
+    size_t end = line.find_last_not_of(" \t\r");
+    if (begin == std::string::npos || end < begin) return std::string();
+    return line.substr(begin, end - begin + 1);
   }
+  return std::string();
+}
 
-  return oss.str();
+ResponseDiagnostics ParseResponseDiagnostics(
+    const URLResponseHeaders& response) {
+  const std::string& headers = response.headers;
+  ResponseDiagnostics diagnostics;
+  diagnostics.status_code = response.status_code;
+  std::string value = GetHttpHeader(headers, "Content-Length");
+  if (!value.empty())
+    diagnostics.content_length = std::strtoull(value.c_str(), nullptr, 10);
+  value = GetHttpHeader(headers, "Age");
+  if (!value.empty())
+    diagnostics.age = std::strtoll(value.c_str(), nullptr, 10);
+  diagnostics.cache_status = GetHttpHeader(headers, "X-Cache");
+  diagnostics.server_timing = GetHttpHeader(headers, "Server-Timing");
+
+  // Each CDN names its points of presence in its own header.
+  diagnostics.cdn_pop = GetHttpHeader(headers, "X-Amz-Cf-Pop");
+  if (diagnostics.cdn_pop.empty())
+    diagnostics.cdn_pop = GetHttpHeader(headers, "X-Served-By");
+  if (diagnostics.cdn_pop.empty()) {
+    // CF-Ray: <ray id>-<data center>
+    value = GetHttpHeader(headers, "CF-Ray");
+    size_t dash = value.rfind('-');
+    if (dash != std::string::npos) diagnostics.cdn_pop = value.substr(dash + 1);
+  }
+  if (diagnostics.cdn_pop.empty())
+    diagnostics.cdn_pop = GetHttpHeader(headers, "X-Edge-Location");
+  return diagnostics;
+}
+
+std::string ToHexString(uint32_t size, const uint8_t* data) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  // Each byte is printed as two digits followed by a space.
+  std::string hex(size * 3, ' ');
+  for (uint32_t i = 0; i < size; ++i) {
+    hex[i * 3] = kHexDigits[data[i] >> 4];
+    hex[i * 3 + 1] = kHexDigits[data[i] & 0xf];
+  }
+  return hex;
 }
 
 // Simple implementation based on https://en.wikipedia.org/wiki/Base64
@@ -133,37 +455,120 @@ std::vector<uint8_t> Base64Decode(const std::string& text) {
     return {};
   }
 
-  static const std::string codes =
-    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=";
-
-  size_t pos = text.find('=');
-  uint32_t decoded_size = (text.length() * 3) / 4;
-  if (pos != std::string::npos) decoded_size -= text.length() - pos;
+  // Only the padding of the last group shortens the output, any other '='
+  // is rejected below.
+  size_t padding = 0;
+  while (padding < 2 && padding < text.length() &&
+         text[text.length() - 1 - padding] == '=')
+    ++padding;
+  size_t decoded_size = (text.length() * 3) / 4 - padding;
 
+  const auto& table = Base64DecodeTable();
+  const auto* in = reinterpret_cast<const uint8_t*>(text.data());
   std::vector<uint8_t> ret(decoded_size);
   uint32_t j = 0;
-  uint32_t b[4];
   for (uint32_t i = 0; i < text.length(); i += 4) {
-    for (uint32_t k = 0; k < 4; ++k) {
-      pos = codes.find(text[i + k]);
-      if (pos == std::string::npos) {
-        LOG_ERROR("Bad character found in input");
-        return {};
-      }
+    uint32_t b0 = table[in[i]];
+    uint32_t b1 = table[in[i + 1]];
+    uint32_t b2 = table[in[i + 2]];
+    uint32_t b3 = table[in[i + 3]];
+    uint32_t all = b0 | b1 | b2 | b3;
+    if (all < kBase64Padding) {
+      ret[j++] = (b0 << 2) | (b1 >> 4);
+      ret[j++] = (b1 << 4) | (b2 >> 2);
+      ret[j++] = (b2 << 6) | b3;
+      continue;
+    }
 
-      b[k] = pos;
+    // Only the last group can be padded, either with "==" or with "=".
+    bool last = i + 4 == text.length();
+    bool padded = (b0 | b1) < kBase64Padding && b3 == kBase64Padding &&
+                  b2 <= kBase64Padding;
+    if (all & kBase64Invalid || !last || !padded) {
+      LOG_ERROR("Bad character found in input");
+      return {};
     }
+    ret[j++] = (b0 << 2) | (b1 >> 4);
+    if (b2 == kBase64Padding) break;
+    ret[j++] = (b1 << 4) | (b2 >> 2);
+  }
 
-    ret[j++] = ((b[0] << 2) | (b[1] >> 4));
-    if (b[2] >= 64) continue;
+  return ret;
+}
 
-    ret[j++] = ((b[1] << 4) | (b[2] >> 2));
-    if (b[3] >= 64) continue;
+double Percentile(const std::vector<double>& sorted, double percent) {
+  if (sorted.empty()) return 0.;
+  size_t rank = static_cast<size_t>(percent / 100. * sorted.size() + 0.5);
+  return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
 
-    ret[j++] = ((b[2] << 6)) | b[3];
-  }
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+}
 
-  return ret;
+double MicrosecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+ScopedResourceCount::ScopedResourceCount(TrackedResource resource,
+                                         int64_t count)
+    : resource_(resource),
+      count_(count) {
+  tracked_resources[static_cast<size_t>(resource_)] += count_;
+}
+
+ScopedResourceCount::~ScopedResourceCount() {
+  tracked_resources[static_cast<size_t>(resource_)] -= count_;
+}
+
+int64_t ScopedResourceCount::Get(TrackedResource resource) {
+  return tracked_resources[static_cast<size_t>(resource)];
+}
+
+CancellationToken::CancellationToken() : cancelled_(false) {}
+
+CancellationToken::~CancellationToken() {}
+
+void CancellationToken::Cancel() {
+  pp::AutoLock lock(lock_);
+  if (cancelled_) return;
+  cancelled_ = true;
+  for (auto& loader : loaders_) loader.Close();
+  loaders_.clear();
+}
+
+bool CancellationToken::IsCancelled() const {
+  pp::AutoLock lock(lock_);
+  return cancelled_;
+}
+
+bool CancellationToken::Attach(const pp::URLLoader& loader) {
+  pp::AutoLock lock(lock_);
+  if (cancelled_) return false;
+  loaders_.push_back(loader);
+  return true;
+}
+
+void CancellationToken::Detach(const pp::URLLoader& loader) {
+  pp::AutoLock lock(lock_);
+  loaders_.erase(std::remove_if(loaders_.begin(), loaders_.end(),
+      [&loader](const pp::URLLoader& attached) {
+        return attached.pp_resource() == loader.pp_resource();
+      }), loaders_.end());
+}
+
+void RegisterModuleInstance(PP_Instance instance) {
+  pp::AutoLock lock(ModuleInstancesLock());
+  ModuleInstances().push_back(instance);
+}
+
+void UnregisterModuleInstance(PP_Instance instance) {
+  pp::AutoLock lock(ModuleInstancesLock());
+  auto& instances = ModuleInstances();
+  instances.erase(std::remove(instances.begin(), instances.end(), instance),
+                  instances.end());
 }
 
 pp::URLRequestInfo GetRequestForURL(const std::string& url) {
@@ -172,13 +577,267 @@ pp::URLRequestInfo GetRequestForURL(const std::string& url) {
   return request;
 }
 
+int32_t WarmUpConnection(const std::string& url) {
+  pp::URLRequestInfo request = GetRequestForURL(url);
+  request.SetMethod("HEAD");
+  std::string response;
+  URLRequestTiming timing;
+  int32_t result = ProcessURLRequest(request, &response, &timing);
+  LOG_DEBUG("Warmed up a connection to %s in %.1f [ms], result: %d",
+            url.c_str(), timing.total_time * 1000., result);
+  return result;
+}
+
 int32_t ProcessURLRequestOnSideThread(const pp::URLRequestInfo& request,
-                                      std::string* out) {
-  return ProcessURLRequest(request, out);
+                                      std::string* out,
+                                      URLRequestTiming* timing) {
+  return ProcessURLRequest(request, out, timing);
 }
 
 int32_t ProcessURLRequestOnSideThread(const pp::URLRequestInfo& request,
-                                      std::vector<uint8_t>* out) {
-  return ProcessURLRequest(request, out);
+                                      std::string* out,
+                                      URLRequestTiming* timing,
+                                      URLResponseHeaders* response) {
+  return ProcessURLRequest(request, out, timing, response);
+}
+
+int32_t ProcessURLRequestOnSideThread(const pp::URLRequestInfo& request,
+                                      std::vector<uint8_t>* out,
+                                      URLRequestTiming* timing,
+                                      CancellationToken* token,
+                                      URLResponseHeaders* response,
+                                      const TuningProfile* tuning) {
+  return ProcessURLRequest(request, out, timing, response, token, tuning);
+}
+
+int32_t ProcessURLRequestOnSideThread(
+    const pp::URLRequestInfo& request,
+    const std::function<bool(std::vector<uint8_t>&&)>& chunk_callback,
+    URLRequestTiming* timing, CancellationToken* token,
+    URLResponseHeaders* response, const TuningProfile* tuning) {
+  return ProcessURLRequestInChunks(request, chunk_callback, timing, token,
+                                   response, tuning);
+}
+
+AsyncURLLoader::AsyncURLLoader()
+    : cc_factory_(this), state_(State::kIdle), min_chunk_size_(0) {}
+
+AsyncURLLoader::~AsyncURLLoader() {
+  if (state_ == State::kOpening || state_ == State::kReading) {
+    LOG_DEBUG("Aborting a request in progress");
+    if (token_) token_->Detach(loader_);
+    loader_.Close();
+  }
+}
+
+void AsyncURLLoader::SetChunkCallback(ChunkCallback chunk_callback) {
+  assert(state_ == State::kIdle);
+  chunk_callback_ = std::move(chunk_callback);
+}
+
+int32_t AsyncURLLoader::Start(const pp::URLRequestInfo& request,
+                              DoneCallback done_callback,
+                              std::shared_ptr<CancellationToken> token) {
+  if (state_ != State::kIdle || !done_callback)
+    return PP_ERROR_BADARGUMENT;
+
+  if (pp::MessageLoop::GetCurrent().is_null())
+    return PP_ERROR_NO_MESSAGE_LOOP;
+
+  if (request.is_null()) {
+    LOG_ERROR("request is null!");
+    return PP_ERROR_BADARGUMENT;
+  }
+
+  loader_ = pp::URLLoader(CurrentInstanceHandle());
+  if (token && !token->Attach(loader_)) return PP_ERROR_ABORTED;
+
+  token_ = std::move(token);
+  done_callback_ = std::move(done_callback);
+  loader_count_ = MakeUnique<ScopedResourceCount>(TrackedResource::kUrlLoader);
+  start_ = std::chrono::steady_clock::now();
+  state_ = State::kOpening;
+  // A required callback is always run asynchronously, errors included.
+  loader_.Open(request, cc_factory_.NewCallback(&AsyncURLLoader::OnOpened));
+  return PP_OK_COMPLETIONPENDING;
+}
+
+void AsyncURLLoader::OnOpened(int32_t result) {
+  if (result != PP_OK) {
+    result = ErrorCode(result, token_.get());
+    if (result != PP_ERROR_ABORTED)
+      LOG_ERROR("Failed to open URLLoader with given request, code: %d",
+                result);
+    Finish(result);
+    return;
+  }
+
+  size_t expected_size = 0;
+  result = CheckResponse(loader_, &expected_size, &response_);
+  if (result != PP_OK) {
+    Finish(result);
+    return;
+  }
+  timing_.time_to_first_byte = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start_).count();
+
+  auto tuning = TuningProfile::Current();
+  min_chunk_size_ = tuning.download_chunk_size;
+  if (chunk_callback_)
+    body_.reserve(min_chunk_size_ + kReadSize);
+  else
+    body_.reserve(expected_size > 0 ? expected_size
+                                    : tuning.download_buffer_size);
+  scratch_.reset(new uint8_t[kReadSize]);
+  state_ = State::kReading;
+  ReadNext();
+}
+
+void AsyncURLLoader::ReadNext() {
+  loader_.ReadResponseBody(scratch_.get(), kReadSize,
+                           cc_factory_.NewCallback(&AsyncURLLoader::OnRead));
+}
+
+void AsyncURLLoader::OnRead(int32_t result) {
+  if (result < 0) {
+    if (ErrorCode(result, token_.get()) == PP_ERROR_ABORTED) {
+      LOG_DEBUG("Download cancelled");
+      Finish(PP_ERROR_ABORTED);
+      return;
+    }
+    LOG_ERROR("Failed to ReadResponseBody, result: %d", result);
+    Finish(PP_ERROR_FAILED);
+    return;
+  }
+
+  if (body_.capacity() < body_.size() + result)
+    body_.reserve(std::max(body_.size() + result, body_.capacity() * 2));
+  body_.insert(body_.end(), scratch_.get(), scratch_.get() + result);
+
+  bool finished = (result == PP_OK);
+  if (chunk_callback_ && !body_.empty() &&
+      (finished || body_.size() >= min_chunk_size_)) {
+    if (!chunk_callback_(std::move(body_))) {
+      LOG_DEBUG("Download aborted by chunk callback");
+      Finish(PP_ERROR_ABORTED);
+      return;
+    }
+    body_ = std::vector<uint8_t>();
+    if (!finished) body_.reserve(min_chunk_size_ + kReadSize);
+  }
+
+  if (finished) {
+    timing_.total_time = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start_).count();
+    Finish(PP_OK);
+    return;
+  }
+  ReadNext();
+}
+
+void AsyncURLLoader::Finish(int32_t result) {
+  state_ = State::kFinished;
+  if (token_) token_->Detach(loader_);
+  loader_.Close();
+  loader_count_.reset();
+  scratch_.reset();
+  std::vector<uint8_t> body;
+  if (result == PP_OK) body.swap(body_);
+  body_.clear();
+  // The callback may destroy this object, so nothing is touched after it.
+  DoneCallback done_callback = std::move(done_callback_);
+  done_callback(result, std::move(body));
+}
+
+std::string GetTemporaryStorageDir() {
+  static const std::string dir = MountTemporaryStorage();
+  return dir;
+}
+
+std::string GetPersistentStorageDir() {
+  static const std::string dir = MountPersistentStorage();
+  return dir;
+}
+
+std::string StorageFileName(const std::string& key) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(
+      HashBytes(key.data(), key.size())));
+  return name;
+}
+
+bool WriteStorageField(FILE* file, const void* data, uint32_t size) {
+  return fwrite(&size, sizeof(size), 1, file) == 1 &&
+         (size == 0 || fwrite(data, 1, size, file) == size);
+}
+
+bool WriteStorageField(FILE* file, const std::string& field) {
+  return WriteStorageField(file, field.data(), field.size());
+}
+
+bool ReadStorageField(FILE* file, uint32_t max_size, std::string* field) {
+  uint32_t size;
+  if (fread(&size, sizeof(size), 1, file) != 1 || size > max_size)
+    return false;
+  field->resize(size);
+  return size == 0 || fread(&(*field)[0], 1, size, file) == size;
+}
+
+bool ReadStorageField(FILE* file, uint32_t max_size,
+                      std::vector<uint8_t>* field) {
+  uint32_t size;
+  if (fread(&size, sizeof(size), 1, file) != 1 || size > max_size)
+    return false;
+  field->resize(size);
+  return size == 0 || fread(field->data(), 1, size, file) == size;
+}
+
+std::string LocalFilePath(const std::string& url) {
+  static constexpr const char kFileScheme[] = "file://";
+  static constexpr size_t kFileSchemeSize = sizeof(kFileScheme) - 1;
+  if (url.compare(0, kFileSchemeSize, kFileScheme) != 0) return std::string();
+  // A host, if any, is not a part of the path, e.g. "file://localhost/usb".
+  size_t path_start = url.find('/', kFileSchemeSize);
+  if (path_start == std::string::npos) return std::string();
+  size_t path_end = url.find_first_of("?#", path_start);
+  return url.substr(path_start, path_end == std::string::npos
+                                    ? std::string::npos
+                                    : path_end - path_start);
+}
+
+bool ReadLocalFile(const std::string& path, const std::string& range,
+                   std::vector<uint8_t>* data) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat info;
+  bool ok = fstat(fd, &info) == 0;
+  uint64_t size = ok ? static_cast<uint64_t>(info.st_size) : 0;
+  uint64_t first = 0;
+  uint64_t last = size - 1;
+  if (ok && !range.empty()) {
+    char* end = nullptr;
+    first = std::strtoull(range.c_str(), &end, 10);
+    if (*end == '-' && *(end + 1) != '\0')
+      last = std::min<uint64_t>(last, std::strtoull(end + 1, nullptr, 10));
+  }
+  ok = ok && first <= last + 1 &&
+       lseek(fd, static_cast<off_t>(first), SEEK_SET) ==
+           static_cast<off_t>(first);
+  if (ok) {
+    // File systems of nacl_io may return less than requested, so the range
+    // is read in a loop straight into its final buffer.
+    data->resize(last + 1 - first);
+    size_t offset = 0;
+    while (ok && offset < data->size()) {
+      ssize_t read_bytes = read(fd, data->data() + offset,
+                                data->size() - offset);
+      ok = read_bytes > 0;
+      if (ok) offset += read_bytes;
+    }
+  }
+  close(fd);
+  if (!ok) data->clear();
+  return ok;
 }
 
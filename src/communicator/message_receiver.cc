@@ -18,16 +18,30 @@
  * @author Michal Murgrabia
  */
 
+#define LOG_CATEGORY LogCategory::kCommunicator
+
 #include "communicator/message_receiver.h"
 
 #include <algorithm>
+#include <chrono>
+#include <sstream>
 #include <unordered_map>
 #include <string>
 
+#include "ppapi/c/pp_errors.h"
+#include "ppapi/cpp/message_loop.h"
 #include "ppapi/cpp/var_array.h"
 #include "ppapi/cpp/var_dictionary.h"
 
 #include "communicator/messages.h"
+#include "dash/dash_manifest.h"
+#include "allocation_tracker.h"
+#include "cpu_profiler.h"
+#include "main_thread_budget.h"
+#include "memory_governor.h"
+#include "thread_config.h"
+#include "tracer.h"
+#include "tuning_profile.h"
 
 using pp::Var;
 using pp::VarArray;
@@ -43,6 +57,25 @@ inline int32_t ClipToRange(int32_t value, int32_t min, int32_t max) {
 
 namespace Communication {
 
+MessageReceiver::MessageReceiver(
+    const pp::InstanceHandle& instance,
+    std::shared_ptr<PlayerProvider> player_provider,
+    std::shared_ptr<MessageSender> message_sender)
+    : player_type_(PlayerProvider::kUnknown),
+      player_provider_(std::move(player_provider)),
+      message_sender_(std::move(message_sender)),
+      instance_(instance),
+      benchmarks_run_(0),
+      cc_factory_(this),
+      disposal_thread_(instance) {
+  disposal_thread_.Start();
+}
+
+MessageReceiver::~MessageReceiver() {
+  DisposePlayer(std::move(player_controller_));
+  disposal_thread_.Join();
+}
+
 void MessageReceiver::HandleMessage(pp::InstanceHandle /*instance*/,
                                     const Var& message_data) {
   LOG_INFO("MessageHandler - HandleMessage");
@@ -53,6 +86,7 @@ void MessageReceiver::HandleMessage(pp::InstanceHandle /*instance*/,
     return;
   }
 
+  ScopedMainThreadWork work(MainThreadWork::kHandleMessage);
   VarDictionary msg(message_data);
   Var action_var = msg.Get(kKeyMessageToPlayer);
   if (!action_var.is_int()) {
@@ -72,7 +106,55 @@ void MessageReceiver::HandleMessage(pp::InstanceHandle /*instance*/,
                 msg.Get(kKeySubtitle),
                 msg.Get(kKeyEncoding),
                 msg.Get(kDrmLicenseUrl),
-                msg.Get(kDrmKeyRequestProperties));
+                msg.Get(kDrmKeyRequestProperties),
+                msg.Get(kKeyInitialBuffer),
+                msg.Get(kKeyStartTime),
+                msg.Get(kKeyTuning));
+      break;
+    case MessageToPlayer::kPreloadMedia:
+      PreloadMedia(msg.Get(kKeyType), msg.Get(kKeyUrl));
+      break;
+    case MessageToPlayer::kSetWarmMedia:
+      SetWarmMedia(msg.Get(kKeyUrls));
+      break;
+    case MessageToPlayer::kDownloadMedia:
+      DownloadMedia(msg.Get(kKeyUrl), msg.Get(kKeyBitrate));
+      break;
+    case MessageToPlayer::kEnqueueMedia:
+      EnqueueMedia(msg.Get(kKeyUrl));
+      break;
+    case MessageToPlayer::kSetTimeUpdateInterval:
+      SetTimeUpdateInterval(msg.Get(kKeyDuration));
+      break;
+    case MessageToPlayer::kSetBinaryMessages:
+      SetBinaryMessages(msg.Get(kKeyEnabled));
+      break;
+    case MessageToPlayer::kGetMetrics:
+      GetMetrics(msg.Get(kKeyDuration));
+      break;
+    case MessageToPlayer::kSetThreadPriority:
+      SetThreadPriority(msg.Get(kKeyRole), msg.Get(kKeyPriority),
+                        msg.Get(kKeyCpu));
+      break;
+    case MessageToPlayer::kSetMainThreadBudget:
+      SetMainThreadBudget(msg.Get(kKeyDuration));
+      break;
+    case MessageToPlayer::kSetMemoryBudget:
+      SetMemoryBudget(msg.Get(kKeyBytes));
+      break;
+    case MessageToPlayer::kSetMemoryPressure:
+      SetMemoryPressure(msg.Get(kKeyPressure));
+      break;
+    case MessageToPlayer::kSetVisibility:
+      SetVisibility(msg.Get(kKeyVisible));
+      break;
+    case MessageToPlayer::kSetAudioOnly:
+      SetAudioOnly(msg.Get(kKeyEnabled));
+      break;
+    case MessageToPlayer::kSetDeviceCapabilities:
+      SetDeviceCapabilities(msg.Get(kKeyWidth), msg.Get(kKeyHeight),
+                            msg.Get(kKeyChannels), msg.Get(kKeyHdr),
+                            msg.Get(kKeyCodecs));
       break;
     case MessageToPlayer::kPlay:
       Play();
@@ -83,6 +165,12 @@ void MessageReceiver::HandleMessage(pp::InstanceHandle /*instance*/,
     case MessageToPlayer::kSeek:
       Seek(msg.Get(kKeyTime));
       break;
+    case MessageToPlayer::kSeekPreview:
+      PreviewSeek(msg.Get(kKeyTime));
+      break;
+    case MessageToPlayer::kSetPlaybackRate:
+      SetPlaybackRate(msg.Get(kKeyRate));
+      break;
     case MessageToPlayer::kChangeRepresentation:
       ChangeRepresentation(msg.Get(kKeyType),
                            msg.Get(kKeyId));
@@ -100,7 +188,61 @@ void MessageReceiver::HandleMessage(pp::InstanceHandle /*instance*/,
                      msg.Get(kKeyHeight));
       break;
     case MessageToPlayer::kSetLogLevel:
-      SetLogLevel(msg.Get(kKeyLogLevel));
+      SetLogLevel(msg.Get(kKeyLogLevel), msg.Get(kKeyLogCategory));
+      break;
+    case MessageToPlayer::kStartTracing:
+      Tracer::SetEnabled(true);
+      break;
+    case MessageToPlayer::kExportTrace:
+      ExportTrace();
+      break;
+    case MessageToPlayer::kBenchmarkDemuxer:
+      BenchmarkDemuxer(msg.Get(kKeyType), msg.Get(kKeyUrl), msg.Get(kKeyUrls),
+                       msg.Get(kKeyDemuxer));
+      break;
+    case MessageToPlayer::kBenchmarkPacketsManager:
+      BenchmarkPacketsManager();
+      break;
+    case MessageToPlayer::kBenchmarkManifest:
+      BenchmarkManifest();
+      break;
+    case MessageToPlayer::kSimulateNetwork:
+      SimulateNetwork(msg.Get(kKeyUrl), msg.Get(kKeyTraces));
+      break;
+    case MessageToPlayer::kSoakTest:
+      RunSoakTest(msg.Get(kKeyType), msg.Get(kKeyUrl), msg.Get(kKeyDuration),
+                  msg.Get(kKeyTime));
+      break;
+    case MessageToPlayer::kGetAllocationStats:
+      GetAllocationStats(msg.Get(kKeyOperation));
+      break;
+    case MessageToPlayer::kBenchmarkEncoding:
+      BenchmarkEncoding();
+      break;
+    case MessageToPlayer::kBenchmarkAll:
+      BenchmarkAll(msg.Get(kKeyDevice), msg.Get(kKeyType), msg.Get(kKeyUrl),
+                   msg.Get(kKeyUrls), msg.Get(kKeyManifest));
+      break;
+    case MessageToPlayer::kGetCpuStats:
+      GetCpuStats(msg.Get(kKeyDuration));
+      break;
+    case MessageToPlayer::kStartPacketCapture:
+      StartPacketCapture(msg.Get(kKeyUrl), msg.Get(kKeyData));
+      break;
+    case MessageToPlayer::kStopPacketCapture:
+      StopPacketCapture();
+      break;
+    case MessageToPlayer::kReplayPacketCapture:
+      ReplayPacketCapture(msg.Get(kKeyUrl), msg.Get(kKeyRate));
+      break;
+    case MessageToPlayer::kBenchmarkSeek:
+      BenchmarkSeek(msg.Get(kKeyUrls));
+      break;
+    case MessageToPlayer::kBenchmarkSwitch:
+      BenchmarkSwitch(msg.Get(kKeyUrls));
+      break;
+    case MessageToPlayer::kBenchmarkDrm:
+      BenchmarkDrm(msg.Get(kKeyUrl));
       break;
     default:
       LOG_ERROR("Not supported action code!");
@@ -112,12 +254,18 @@ Var MessageReceiver::HandleBlockingMessage(
   return Var();
 }
 
-void MessageReceiver::ClosePlayer() { player_controller_.reset(); }
+void MessageReceiver::ClosePlayer() {
+  DisposePlayer(std::move(player_controller_));
+  player_controller_.reset();
+  player_type_ = PlayerProvider::kUnknown;
+}
 
 void MessageReceiver::LoadMedia(const Var& type, const Var& url,
                                 const Var& subtitle, const Var& encoding,
                                 const Var& license_url,
-                                const Var& key_request_properties) {
+                                const Var& key_request_properties,
+                                const Var& initial_buffer,
+                                const Var& start_time, const Var& tuning) {
   if (!type.is_int() || !url.is_string()) {
     LOG_ERROR("Invalid message - 'url' should be a string");
     return;
@@ -149,12 +297,96 @@ void MessageReceiver::LoadMedia(const Var& type, const Var& url,
     }
   }
 
+  std::string subtitle_url = subtitle.is_string() ? subtitle.AsString() : "";
+  std::string encoding_name = encoding.is_string() ? encoding.AsString() : "";
+  std::string drm_license_url =
+      license_url.is_string() ? license_url.AsString() : "";
+  player_provider_->SetInitialBuffer(
+      initial_buffer.is_number() ? initial_buffer.AsDouble() : 0.);
+  player_provider_->SetStartTime(
+      start_time.is_number() ? start_time.AsDouble() : 0.);
+  SetTuningProfile(tuning);
+  if (player_controller_ && player_type == player_type_ &&
+      player_provider_->ReusePlayer(player_controller_, player_type,
+          url.AsString(), view_rect_, subtitle_url, encoding_name,
+          drm_license_url, key_request_map)) {
+    LOG_INFO("Player reused for [%s]", url.AsString().c_str());
+    return;
+  }
+
+  // The previous player is destroyed after the new one is created, like it
+  // used to be when it was replaced in place.
+  auto previous_controller = std::move(player_controller_);
   player_controller_ = player_provider_->CreatePlayer(
-      player_type, url.AsString(), view_rect_,
-      subtitle.is_string() ? subtitle.AsString() : "",
-      encoding.is_string() ? encoding.AsString() : "",
-      license_url.is_string() ? license_url.AsString() : "",
-      key_request_map);
+      player_type, url.AsString(), view_rect_, subtitle_url, encoding_name,
+      drm_license_url, key_request_map);
+  player_type_ = player_controller_ ? player_type : PlayerProvider::kUnknown;
+  DisposePlayer(std::move(previous_controller));
+}
+
+void MessageReceiver::SetTuningProfile(const Var& tuning) {
+  TuningProfile profile;
+  if (tuning.is_dictionary()) {
+    VarDictionary dict{tuning};
+    VarArray keys = dict.GetKeys();
+    for (uint32_t i = 0; i < keys.GetLength(); ++i) {
+      Var key = keys.Get(i);
+      Var value = dict.Get(key);
+      if (!value.is_number() || !profile.Set(key.AsString(), value.AsDouble()))
+        LOG_ERROR("Ignored tuning value '%s'", key.AsString().c_str());
+    }
+    if (!profile.IsValid()) {
+      LOG_ERROR("Inconsistent tuning profile %d, defaults are used",
+                profile.id);
+      profile = TuningProfile();
+    }
+  }
+  TuningProfile::SetCurrent(profile);
+  LOG_INFO("Tuning profile: %s", profile.ToString().c_str());
+}
+
+void MessageReceiver::PreloadMedia(const Var& type, const Var& url) {
+  if (!type.is_int() || !url.is_string()) {
+    LOG_ERROR("Invalid message - 'url' should be a string");
+    return;
+  }
+  if (static_cast<ClipTypeEnum>(type.AsInt()) != ClipTypeEnum::kDash) {
+    LOG_INFO("Only DASH content can be preloaded, type: %d", type.AsInt());
+    return;
+  }
+  player_provider_->PreloadMedia(PlayerProvider::kEsDash, url.AsString());
+}
+
+void MessageReceiver::SetWarmMedia(const Var& urls) {
+  if (!urls.is_array()) {
+    LOG_ERROR("Invalid message - 'urls' should be an array");
+    return;
+  }
+  std::vector<std::string> warm_urls;
+  VarArray urls_array(urls);
+  for (uint32_t i = 0; i < urls_array.GetLength(); ++i) {
+    Var url = urls_array.Get(i);
+    if (url.is_string()) warm_urls.push_back(url.AsString());
+  }
+  player_provider_->SetWarmMedia(PlayerProvider::kEsDash, warm_urls);
+}
+
+void MessageReceiver::DownloadMedia(const Var& url, const Var& bitrate) {
+  if (!url.is_string()) {
+    LOG_ERROR("Invalid message - 'url' should be a string");
+    return;
+  }
+  uint32_t max_bitrate = bitrate.is_number() ? bitrate.AsInt() : 0;
+  player_provider_->DownloadMedia(PlayerProvider::kEsDash, url.AsString(),
+                                  max_bitrate);
+}
+
+void MessageReceiver::EnqueueMedia(const Var& url) {
+  if (!url.is_string()) {
+    LOG_ERROR("Invalid message - 'url' should be a string");
+    return;
+  }
+  if (player_controller_) player_controller_->EnqueueMedia(url.AsString());
 }
 
 void MessageReceiver::Play() {
@@ -170,7 +402,24 @@ void MessageReceiver::Seek(const Var& time) {
     LOG_ERROR("Invalid message - 'time' should be a float");
     return;
   }
-  player_controller_->Seek(time.AsDouble());
+  if (player_controller_) player_controller_->Seek(time.AsDouble());
+}
+
+void MessageReceiver::PreviewSeek(const Var& time) {
+  if (!time.is_double()) {
+    LOG_ERROR("Invalid message - 'time' should be a float");
+    return;
+  }
+  if (player_controller_) player_controller_->PreviewSeek(time.AsDouble());
+}
+
+void MessageReceiver::SetPlaybackRate(const Var& rate) {
+  if (!rate.is_number()) {
+    LOG_ERROR("Invalid message - 'rate' should be a number");
+    return;
+  }
+  if (player_controller_)
+    player_controller_->SetPlaybackRate(rate.AsDouble());
 }
 
 void MessageReceiver::ChangeViewRect(const Var& x_position,
@@ -210,13 +459,682 @@ void MessageReceiver::ChangeSubtitlesVisibility() {
     player_controller_->ChangeSubtitleVisibility();
 }
 
-void MessageReceiver::SetLogLevel(const pp::Var& pp_level) {
+void MessageReceiver::SetLogLevel(const pp::Var& pp_level,
+                                  const pp::Var& pp_category) {
   if (!pp_level.is_int())
     return;
-  auto level = ClipToRange(pp_level.AsInt(),
-                           static_cast<int32_t>(LogLevel::kMinLevel),
-                           static_cast<int32_t>(LogLevel::kMaxLevel));
-  Logger::SetJsLogLevel(static_cast<LogLevel>(level));
+  auto level = static_cast<LogLevel>(
+      ClipToRange(pp_level.AsInt(),
+                  static_cast<int32_t>(LogLevel::kMinLevel),
+                  static_cast<int32_t>(LogLevel::kMaxLevel)));
+  if (pp_category.is_string()) {
+    LogCategory category;
+    if (!Logger::GetCategoryByName(pp_category.AsString(), &category)) {
+      LOG_ERROR("Unknown log category: %s", pp_category.AsString().c_str());
+      return;
+    }
+    Logger::SetCategoryLogLevel(category, level);
+    return;
+  }
+  Logger::SetJsLogLevel(level);
+}
+
+void MessageReceiver::SetThreadPriority(const pp::Var& role_name,
+                                        const pp::Var& priority,
+                                        const pp::Var& cpu) {
+  if (!role_name.is_string() || !priority.is_int()) {
+    LOG_ERROR("Invalid message - 'role' should be a string and 'priority' "
+              "an integer");
+    return;
+  }
+  ThreadRole role;
+  if (!ThreadConfig::GetRoleByName(role_name.AsString(), &role)) {
+    LOG_ERROR("Unknown thread role: %s", role_name.AsString().c_str());
+    return;
+  }
+  ThreadConfig::Set(role, priority.AsInt(),
+                    cpu.is_int() ? cpu.AsInt() : ThreadConfig::kAnyCpu);
+}
+
+void MessageReceiver::SetMainThreadBudget(const pp::Var& budget) {
+  if (!budget.is_number()) {
+    LOG_ERROR("Invalid message - 'duration' should be a number");
+    return;
+  }
+  LOG_INFO("Main thread budget: %f [s] per frame", budget.AsDouble());
+  MainThreadBudget::SetBudget(budget.AsDouble());
+}
+
+void MessageReceiver::SetMemoryBudget(const pp::Var& budget) {
+  if (!budget.is_number() || budget.AsDouble() < 0) {
+    LOG_ERROR("Invalid message - 'bytes' should be a non-negative number");
+    return;
+  }
+  LOG_INFO("Memory budget: %.0f bytes", budget.AsDouble());
+  MemoryGovernor::SetBudget(static_cast<size_t>(budget.AsDouble()));
+}
+
+void MessageReceiver::SetMemoryPressure(const pp::Var& pressure_name) {
+  if (!pressure_name.is_string()) {
+    LOG_ERROR("Invalid message - 'pressure' should be a string");
+    return;
+  }
+  MemoryPressure pressure;
+  if (!MemoryGovernor::GetPressureByName(pressure_name.AsString(),
+                                         &pressure)) {
+    LOG_ERROR("Unknown memory pressure: %s",
+              pressure_name.AsString().c_str());
+    return;
+  }
+  LOG_INFO("Memory pressure signalled: %s", pressure_name.AsString().c_str());
+  MemoryGovernor::SetPlatformPressure(pressure);
+}
+
+void MessageReceiver::SetVisibility(const pp::Var& visible) {
+  if (!visible.is_bool()) {
+    LOG_ERROR("Invalid message - 'visible' should be a bool");
+    return;
+  }
+  LOG_INFO("Application %s", visible.AsBool() ? "visible" : "hidden");
+  // The application may be suspended once it's hidden, a player created
+  // when it returns continues this playback.
+  if (!visible.AsBool())
+    player_provider_->SuspendPlayer(player_controller_, player_type_);
+  if (player_controller_) player_controller_->SetVisible(visible.AsBool());
+}
+
+void MessageReceiver::SetAudioOnly(const pp::Var& enabled) {
+  if (!enabled.is_bool()) {
+    LOG_ERROR("Invalid message - 'enabled' should be a bool");
+    return;
+  }
+  LOG_INFO("Audio only playback %s",
+           enabled.AsBool() ? "enabled" : "disabled");
+  if (player_controller_) player_controller_->SetAudioOnly(enabled.AsBool());
+}
+
+void MessageReceiver::SetDeviceCapabilities(const Var& width,
+    const Var& height, const Var& channels, const Var& hdr,
+    const Var& codecs) {
+  DeviceCapabilities capabilities;
+  if (width.is_number()) capabilities.max_width = width.AsInt();
+  if (height.is_number()) capabilities.max_height = height.AsInt();
+  if (channels.is_number()) capabilities.max_channels = channels.AsInt();
+  if (hdr.is_bool()) capabilities.hdr = hdr.AsBool();
+  if (codecs.is_array()) {
+    VarArray codecs_array(codecs);
+    for (uint32_t i = 0; i < codecs_array.GetLength(); ++i) {
+      Var codec = codecs_array.Get(i);
+      if (codec.is_string()) capabilities.codecs.push_back(codec.AsString());
+    }
+  }
+  LOG_INFO("Device capabilities: %ux%u, %u channels, HDR %s, %zu codecs",
+           capabilities.max_width, capabilities.max_height,
+           capabilities.max_channels, capabilities.hdr ? "yes" : "no",
+           capabilities.codecs.size());
+  DashManifest::SetDeviceCapabilities(capabilities);
+}
+
+void MessageReceiver::SetTimeUpdateInterval(const pp::Var& interval) {
+  if (!interval.is_number()) {
+    LOG_ERROR("Invalid message - 'duration' should be a number");
+    return;
+  }
+  if (message_sender_)
+    message_sender_->SetTimeUpdateInterval(interval.AsDouble());
+}
+
+void MessageReceiver::SetBinaryMessages(const pp::Var& enabled) {
+  if (!enabled.is_bool()) {
+    LOG_ERROR("Invalid message - 'enabled' should be a bool");
+    return;
+  }
+  if (message_sender_)
+    message_sender_->SetBinaryMessages(enabled.AsBool());
+}
+
+void MessageReceiver::GetMetrics(const pp::Var& interval) {
+  if (!interval.is_undefined() && !interval.is_number()) {
+    LOG_ERROR("Invalid message - 'duration' should be a number");
+    return;
+  }
+  if (!player_controller_) return;
+  if (interval.is_number())
+    player_controller_->SetMetricsInterval(interval.AsDouble());
+  player_controller_->PostMetrics();
+}
+
+void MessageReceiver::ExportTrace() {
+  Tracer::SetEnabled(false);
+  if (message_sender_)
+    message_sender_->TraceData(Tracer::ExportJson());
+}
+
+void MessageReceiver::BenchmarkDemuxer(const Var& type, const Var& init_url,
+                                       const Var& media_urls,
+                                       const Var& demuxer) {
+  if (!type.is_int() || !init_url.is_string() || !media_urls.is_array()) {
+    LOG_ERROR("Invalid message - 'type', 'url' or 'urls' has a wrong type");
+    return;
+  }
+  std::vector<std::string> urls;
+  VarArray urls_array(media_urls);
+  for (uint32_t i = 0; i < urls_array.GetLength(); ++i) {
+    Var url = urls_array.Get(i);
+    if (url.is_string()) urls.push_back(url.AsString());
+  }
+  auto stream_type = static_cast<StreamType>(type.AsInt());
+  auto demuxer_type = stream_type == StreamType::Video
+      ? StreamDemuxer::kVideo : StreamDemuxer::kAudio;
+  auto kind = demuxer.is_string() && demuxer.AsString() == "ffmpeg"
+      ? DemuxerBenchmark::DemuxerKind::kFFmpeg
+      : DemuxerBenchmark::DemuxerKind::kDefault;
+
+  if (!demuxer_benchmark_)
+    demuxer_benchmark_ = MakeUnique<DemuxerBenchmark>(instance_);
+  std::weak_ptr<MessageSender> weak_sender = message_sender_;
+  demuxer_benchmark_->Start(demuxer_type, kind, init_url.AsString(), urls,
+      [weak_sender, kind](const DemuxerBenchmark::Result& result) {
+        auto message_sender = weak_sender.lock();
+        if (!message_sender) return;
+        message_sender->BenchmarkResult(
+            std::string("demuxer/") + DemuxerBenchmark::KindName(kind), {
+          {"ok", result.ok ? 1. : 0.},
+          {"packets", static_cast<double>(result.packets)},
+          {"bytes", static_cast<double>(result.bytes)},
+          {"seconds", result.seconds},
+          {"packetsPerSecond", result.packets_per_second},
+          {"megabytesPerSecond", result.megabytes_per_second},
+          {"latencyP50", result.latency_p50},
+          {"latencyP95", result.latency_p95},
+          {"latencyMax", result.latency_max},
+          {"allocationsPerPacket", result.allocations_per_packet},
+          {"peakHeapBytes", static_cast<double>(result.peak_heap_bytes)},
+        });
+      });
+}
+
+void MessageReceiver::BenchmarkPacketsManager() {
+  if (!packets_manager_benchmark_) {
+    packets_manager_benchmark_ =
+        MakeUnique<PacketsManagerBenchmark>(instance_);
+  }
+  std::weak_ptr<MessageSender> weak_sender = message_sender_;
+  packets_manager_benchmark_->Start(
+      [weak_sender](const PacketsManagerBenchmark::Result& result) {
+        auto message_sender = weak_sender.lock();
+        if (!message_sender) return;
+        message_sender->BenchmarkResult("packetsManager/" + result.scenario, {
+          {"packets", static_cast<double>(result.packets)},
+          {"appended", static_cast<double>(result.appended)},
+          {"seconds", result.seconds},
+          {"deliverNsPerPacket", result.deliver_ns_per_packet},
+          {"updateNsPerPacket", result.update_ns_per_packet},
+          {"deliverP50Us", result.deliver_p50_us},
+          {"deliverP99Us", result.deliver_p99_us},
+          {"deliverMaxUs", result.deliver_max_us},
+          {"updateP50Us", result.update_p50_us},
+          {"updateP99Us", result.update_p99_us},
+          {"updateMaxUs", result.update_max_us},
+          {"seeks", static_cast<double>(result.seeks)},
+          {"seekMaxUs", result.seek_max_us},
+        });
+      });
+}
+
+void MessageReceiver::BenchmarkManifest() {
+  if (!manifest_benchmark_)
+    manifest_benchmark_ = MakeUnique<ManifestBenchmark>(instance_);
+  std::weak_ptr<MessageSender> weak_sender = message_sender_;
+  manifest_benchmark_->Start(
+      [weak_sender](const ManifestBenchmark::Result& result) {
+        auto message_sender = weak_sender.lock();
+        if (!message_sender) return;
+        message_sender->BenchmarkResult("manifest/" + result.manifest, {
+          {"ok", result.ok ? 1. : 0.},
+          {"mpdBytes", static_cast<double>(result.mpd_bytes)},
+          {"representations", static_cast<double>(result.representations)},
+          {"parseMs", result.parse_ms},
+          {"getStreamsUs", result.get_streams_us},
+          {"createSequenceUs", result.create_sequence_us},
+          {"firstLookupMs", result.first_lookup_ms},
+          {"lookupNs", result.lookup_ns},
+          {"segments", static_cast<double>(result.segments)},
+          {"walkNsPerSegment", result.walk_ns_per_segment},
+        });
+      });
+}
+
+void MessageReceiver::SimulateNetwork(const Var& url, const Var& traces) {
+  if (!url.is_string()) {
+    LOG_ERROR("Invalid message - 'url' should be a string");
+    return;
+  }
+  std::vector<NetworkSimulation::Trace> parsed_traces;
+  if (traces.is_dictionary()) {
+    VarDictionary traces_dictionary(traces);
+    VarArray names = traces_dictionary.GetKeys();
+    for (uint32_t i = 0; i < names.GetLength(); ++i) {
+      NetworkSimulation::Trace trace;
+      trace.name = names.Get(i).AsString();
+      Var points = traces_dictionary.Get(names.Get(i));
+      if (!points.is_array()) continue;
+      VarArray points_array(points);
+      for (uint32_t j = 0; j < points_array.GetLength(); ++j) {
+        Var point = points_array.Get(j);
+        if (!point.is_array()) continue;
+        VarArray values(point);
+        if (values.GetLength() < 3 || !values.Get(0).is_number() ||
+            !values.Get(1).is_number() || !values.Get(2).is_number())
+          continue;
+        trace.points.push_back({values.Get(0).AsDouble(),
+                                values.Get(1).AsDouble(),
+                                values.Get(2).AsDouble()});
+      }
+      if (trace.points.empty()) {
+        LOG_ERROR("Trace %s has no valid points", trace.name.c_str());
+        continue;
+      }
+      parsed_traces.push_back(std::move(trace));
+    }
+  }
+
+  if (!network_simulation_)
+    network_simulation_ = MakeUnique<NetworkSimulation>(instance_);
+  std::weak_ptr<MessageSender> weak_sender = message_sender_;
+  network_simulation_->Start(url.AsString(), parsed_traces,
+      [weak_sender](const NetworkSimulation::Result& result) {
+        auto message_sender = weak_sender.lock();
+        if (!message_sender) return;
+        message_sender->BenchmarkResult("network/" + result.trace, {
+          {"ok", result.ok ? 1. : 0.},
+          {"startupTime", result.startup_time},
+          {"rebufferRatio", result.rebuffer_ratio},
+          {"rebuffers", static_cast<double>(result.rebuffers)},
+          {"averageBitrate", result.average_bitrate},
+          {"switches", static_cast<double>(result.switches)},
+          {"switchesPerMinute", result.switches_per_minute},
+          {"oscillations", static_cast<double>(result.oscillations)},
+          {"playedTime", result.played_time},
+          {"simulatedTime", result.simulated_time},
+        });
+      });
+}
+
+void MessageReceiver::RunSoakTest(const Var& type, const Var& url,
+                                  const Var& duration,
+                                  const Var& seek_range) {
+  constexpr double kDefaultSeekRange = 60.;  // seconds
+  if (!duration.is_number()) {
+    LOG_ERROR("Invalid message - 'duration' should be a number");
+    return;
+  }
+  if (soak_test_ && soak_test_->IsRunning()) soak_test_->Stop();
+  if (duration.AsDouble() <= 0.) return;
+  if (!type.is_int() || !url.is_string()) {
+    LOG_ERROR("Invalid message - 'type' or 'url' has a wrong type");
+    return;
+  }
+
+  SoakTest::Actions actions;
+  actions.load = [this, type, url]() {
+    LoadMedia(type, url, Var(), Var(), Var(), Var(), Var(), Var(), Var());
+  };
+  actions.play = [this]() { Play(); };
+  actions.close = [this]() { ClosePlayer(); };
+  actions.seek = [this](double time) { Seek(Var(time)); };
+  actions.change_representation = [this](StreamType type, int32_t id) {
+    ChangeRepresentation(Var(static_cast<int32_t>(type)), Var(id));
+  };
+  soak_test_ = MakeUnique<SoakTest>(actions);
+
+  std::weak_ptr<MessageSender> weak_sender = message_sender_;
+  soak_test_->Start(duration.AsDouble(),
+      seek_range.is_number() ? seek_range.AsDouble() : kDefaultSeekRange,
+      [weak_sender](const SoakTest::Sample& sample) {
+        auto message_sender = weak_sender.lock();
+        if (!message_sender) return;
+        message_sender->BenchmarkResult("soak/sample", {
+          {"cycle", static_cast<double>(sample.cycle)},
+          {"elapsed", sample.elapsed},
+          {"heapBytes", static_cast<double>(sample.heap_bytes)},
+          {"threads", static_cast<double>(sample.threads)},
+          {"urlLoaders", static_cast<double>(sample.url_loaders)},
+          {"livePackets", static_cast<double>(sample.live_packets)},
+        });
+      },
+      [weak_sender](const SoakTest::Result& result) {
+        auto message_sender = weak_sender.lock();
+        if (!message_sender) return;
+        message_sender->BenchmarkResult("soak/result", {
+          {"ok", result.ok ? 1. : 0.},
+          {"cycles", static_cast<double>(result.cycles)},
+          {"baselineHeapBytes",
+           static_cast<double>(result.baseline.heap_bytes)},
+          {"lastHeapBytes", static_cast<double>(result.last.heap_bytes)},
+          {"peakHeapBytes", static_cast<double>(result.peak_heap_bytes)},
+          {"heapDrift", result.heap_drift ? 1. : 0.},
+          {"threadDrift", result.thread_drift ? 1. : 0.},
+          {"urlLoaderDrift", result.url_loader_drift ? 1. : 0.},
+          {"packetDrift", result.packet_drift ? 1. : 0.},
+        });
+      });
+}
+
+void MessageReceiver::GetAllocationStats(const Var& operation) {
+  constexpr size_t kMaxCallSites = 20;
+  if (!AllocationTracker::IsEnabled()) {
+    message_sender_->BenchmarkResult("allocations/disabled", {});
+    return;
+  }
+
+  for (const auto& stats : AllocationTracker::GetStageStats()) {
+    auto allocations = static_cast<double>(stats.allocations);
+    message_sender_->BenchmarkResult(
+        std::string("allocations/") + stats.stage, {
+          {"allocations", allocations},
+          {"bytes", static_cast<double>(stats.bytes)},
+          {"segments", static_cast<double>(stats.segments)},
+          {"packets", static_cast<double>(stats.packets)},
+          {"perSegment", stats.segments ? allocations / stats.segments : 0.},
+          {"perPacket", stats.packets ? allocations / stats.packets : 0.},
+        });
+  }
+
+  std::vector<std::pair<std::string, double>> call_sites;
+  for (const auto& call_site :
+       AllocationTracker::GetTopCallSites(kMaxCallSites)) {
+    std::ostringstream address;
+    address << "0x" << std::hex << call_site.address;
+    call_sites.emplace_back(address.str(),
+                            static_cast<double>(call_site.samples));
+  }
+  message_sender_->BenchmarkResult("allocations/callSites", call_sites);
+
+  if (operation.is_string() && operation.AsString() == "reset")
+    AllocationTracker::Reset();
+}
+
+void MessageReceiver::GetCpuStats(const Var& sampling_interval) {
+  auto report = CpuProfiler::GetReport();
+  for (size_t i = 0; i < report.size(); ++i) {
+    message_sender_->BenchmarkResult(
+        std::string("cpu/") + CpuProfiler::StageName(static_cast<CpuStage>(i)),
+        {
+          {"cpuTime", report[i].cpu_time},
+          {"samples", static_cast<double>(report[i].samples)},
+        });
+  }
+
+  if (sampling_interval.is_number()) {
+    CpuProfiler::SetSamplingInterval(
+        static_cast<int32_t>(sampling_interval.AsDouble() * 1000));
+  }
+}
+
+void MessageReceiver::StartPacketCapture(const Var& path,
+                                         const Var& with_payloads) {
+  PacketCapture::Start(path.is_string() ? path.AsString() : std::string(),
+                       with_payloads.is_bool() && with_payloads.AsBool());
+}
+
+void MessageReceiver::StopPacketCapture() {
+  auto stats = PacketCapture::Stop();
+  message_sender_->BenchmarkResult("capture/stopped", {
+    {"records", static_cast<double>(stats.records)},
+    {"bytes", static_cast<double>(stats.bytes)},
+  });
+}
+
+void MessageReceiver::ReplayPacketCapture(const Var& path, const Var& rate) {
+  if (!packet_capture_replay_)
+    packet_capture_replay_ = MakeUnique<PacketCaptureReplay>(instance_);
+  std::weak_ptr<MessageSender> weak_sender = message_sender_;
+  packet_capture_replay_->Start(
+      path.is_string() ? path.AsString() : std::string(),
+      rate.is_number() && rate.AsDouble() == 0.,
+      [weak_sender](const PacketCaptureReplay::Result& result) {
+        auto message_sender = weak_sender.lock();
+        if (!message_sender) return;
+        message_sender->BenchmarkResult("capture/replay", {
+          {"ok", result.ok ? 1. : 0.},
+          {"records", static_cast<double>(result.records)},
+          {"packets", static_cast<double>(result.packets)},
+          {"appended", static_cast<double>(result.appended)},
+          {"appendedBytes", static_cast<double>(result.appended_bytes)},
+          {"seconds", result.seconds},
+          {"capturedSeconds", result.captured_seconds},
+          {"deliverNsPerPacket", result.deliver_ns_per_packet},
+          {"updateNsPerPacket", result.update_ns_per_packet},
+          {"updateMaxUs", result.update_max_us},
+          {"appendedMbPerSecond", result.appended_megabytes_per_second},
+        });
+      });
+}
+
+void MessageReceiver::BenchmarkSeek(const Var& manifest_urls) {
+  if (!manifest_urls.is_array()) {
+    LOG_ERROR("Invalid message - 'urls' should be an array");
+    return;
+  }
+  std::vector<std::string> urls;
+  VarArray urls_array(manifest_urls);
+  for (uint32_t i = 0; i < urls_array.GetLength(); ++i) {
+    Var url = urls_array.Get(i);
+    if (url.is_string()) urls.push_back(url.AsString());
+  }
+
+  if (!seek_benchmark_)
+    seek_benchmark_ = MakeUnique<SeekBenchmark>(instance_);
+  std::weak_ptr<MessageSender> weak_sender = message_sender_;
+  seek_benchmark_->Start(urls,
+      [weak_sender](const SeekBenchmark::Result& result) {
+        auto message_sender = weak_sender.lock();
+        if (!message_sender) return;
+        message_sender->BenchmarkResult(
+            "seek/" + result.content_type + "/" + result.scenario, {
+          {"contents", static_cast<double>(result.contents)},
+          {"seeks", static_cast<double>(result.seeks)},
+          {"timeouts", static_cast<double>(result.timeouts)},
+          {"cacheMisses", static_cast<double>(result.cache_misses)},
+          {"keyframeP50", result.keyframe_p50},
+          {"keyframeP90", result.keyframe_p90},
+          {"keyframeMax", result.keyframe_max},
+          {"audioP50", result.audio_p50},
+          {"audioP90", result.audio_p90},
+          {"audioMax", result.audio_max},
+          {"keyframeProcessingP50", result.keyframe_processing_p50},
+        });
+      });
+}
+
+void MessageReceiver::BenchmarkSwitch(const Var& manifest_urls) {
+  if (!manifest_urls.is_array()) {
+    LOG_ERROR("Invalid message - 'urls' should be an array");
+    return;
+  }
+  std::vector<std::string> urls;
+  VarArray urls_array(manifest_urls);
+  for (uint32_t i = 0; i < urls_array.GetLength(); ++i) {
+    Var url = urls_array.Get(i);
+    if (url.is_string()) urls.push_back(url.AsString());
+  }
+
+  if (!switch_benchmark_)
+    switch_benchmark_ = MakeUnique<SwitchBenchmark>(instance_);
+  std::weak_ptr<MessageSender> weak_sender = message_sender_;
+  switch_benchmark_->Start(urls,
+      [weak_sender](const SwitchBenchmark::Result& result) {
+        auto message_sender = weak_sender.lock();
+        if (!message_sender) return;
+        message_sender->BenchmarkResult(
+            "switch/" + result.scenario + "/" + result.direction, {
+          {"contents", static_cast<double>(result.contents)},
+          {"switches", static_cast<double>(result.switches)},
+          {"timeouts", static_cast<double>(result.timeouts)},
+          {"latencyP50", result.latency_p50},
+          {"latencyP90", result.latency_p90},
+          {"latencyMax", result.latency_max},
+          {"wastedBytesPerSwitch", result.wasted_bytes_per_switch},
+          {"decoderReinitsPerSwitch", result.decoder_reinits_per_switch},
+        });
+      });
+}
+
+void MessageReceiver::BenchmarkDrm(const Var& manifest_url) {
+  if (!drm_benchmark_)
+    drm_benchmark_ = MakeUnique<DrmBenchmark>(instance_);
+  std::weak_ptr<MessageSender> weak_sender = message_sender_;
+  std::string url = manifest_url.is_string() ? manifest_url.AsString() : "";
+  drm_benchmark_->Start(url,
+      [weak_sender](const DrmBenchmark::Result& result) {
+        auto message_sender = weak_sender.lock();
+        if (!message_sender) return;
+        message_sender->BenchmarkResult("drm/playready", {
+          {"ok", result.ok ? 1. : 0.},
+          {"licenses", static_cast<double>(result.licenses)},
+          {"licenseP50", result.license_p50},
+          {"licenseP95", result.license_p95},
+          {"licenseP99", result.license_p99},
+          {"encryptedPackets", static_cast<double>(result.encrypted_packets)},
+          {"encryptedPacketsPerSecond", result.encrypted_packets_per_second},
+          {"packetAllocations",
+           static_cast<double>(result.packet_allocations)},
+          {"storageAllocations",
+           static_cast<double>(result.storage_allocations)},
+        });
+      });
+}
+
+void MessageReceiver::BenchmarkEncoding() {
+  if (!encoding_benchmark_)
+    encoding_benchmark_ = MakeUnique<EncodingBenchmark>(instance_);
+  std::weak_ptr<MessageSender> weak_sender = message_sender_;
+  encoding_benchmark_->Start(
+      [weak_sender](const EncodingBenchmark::Result& result) {
+        auto message_sender = weak_sender.lock();
+        if (!message_sender) return;
+        message_sender->BenchmarkResult("encoding/" + result.function + "/" +
+            std::to_string(result.bytes), {
+          {"bytes", static_cast<double>(result.bytes)},
+          {"iterations", static_cast<double>(result.iterations)},
+          {"nsPerByte", result.ns_per_byte},
+          {"mbPerSecond", result.mb_per_second},
+        });
+      });
+}
+
+void MessageReceiver::BenchmarkAll(const Var& device, const Var& type,
+                                   const Var& init_url, const Var& media_urls,
+                                   const Var& manifest_url) {
+  if (benchmark_running_ || !benchmark_queue_.empty()) {
+    LOG_ERROR("Benchmarks are running already");
+    return;
+  }
+  if (device.is_string()) message_sender_->SetDeviceModel(device.AsString());
+
+  benchmark_queue_.emplace_back([this]() { BenchmarkEncoding(); },
+      [this]() {
+        return encoding_benchmark_ && encoding_benchmark_->IsRunning();
+      });
+  benchmark_queue_.emplace_back([this]() { BenchmarkPacketsManager(); },
+      [this]() {
+        return packets_manager_benchmark_ &&
+               packets_manager_benchmark_->IsRunning();
+      });
+  benchmark_queue_.emplace_back([this]() { BenchmarkManifest(); },
+      [this]() {
+        return manifest_benchmark_ && manifest_benchmark_->IsRunning();
+      });
+  if (type.is_int() && init_url.is_string() && media_urls.is_array()) {
+    for (const char* demuxer : { "default", "ffmpeg" }) {
+      benchmark_queue_.emplace_back(
+          [this, type, init_url, media_urls, demuxer]() {
+            BenchmarkDemuxer(type, init_url, media_urls, Var(demuxer));
+          },
+          [this]() {
+            return demuxer_benchmark_ && demuxer_benchmark_->IsRunning();
+          });
+    }
+  }
+  if (manifest_url.is_string()) {
+    benchmark_queue_.emplace_back(
+        [this, manifest_url]() { SimulateNetwork(manifest_url, Var()); },
+        [this]() {
+          return network_simulation_ && network_simulation_->IsRunning();
+        });
+    VarArray manifest_urls;
+    manifest_urls.Set(0, manifest_url);
+    benchmark_queue_.emplace_back(
+        [this, manifest_urls]() { BenchmarkSeek(manifest_urls); },
+        [this]() {
+          return seek_benchmark_ && seek_benchmark_->IsRunning();
+        });
+    benchmark_queue_.emplace_back(
+        [this, manifest_urls]() { BenchmarkSwitch(manifest_urls); },
+        [this]() {
+          return switch_benchmark_ && switch_benchmark_->IsRunning();
+        });
+  }
+  // Without a manifest, only license round trips are measured.
+  benchmark_queue_.emplace_back(
+      [this, manifest_url]() { BenchmarkDrm(manifest_url); },
+      [this]() { return drm_benchmark_ && drm_benchmark_->IsRunning(); });
+
+  LOG_INFO("Running %zu benchmarks", benchmark_queue_.size());
+  benchmarks_run_ = 0;
+  benchmarks_started_ = std::chrono::steady_clock::now();
+  RunNextBenchmark(PP_OK);
+}
+
+void MessageReceiver::RunNextBenchmark(int32_t) {
+  // Benchmarks report results from their own threads, this only checks if
+  // they're done.
+  constexpr int32_t kPollIntervalMs = 250;
+  if (benchmark_running_ && benchmark_running_()) {
+    pp::MessageLoop::GetCurrent().PostWork(cc_factory_.NewCallback(
+        &MessageReceiver::RunNextBenchmark), kPollIntervalMs);
+    return;
+  }
+  benchmark_running_ = nullptr;
+
+  if (benchmark_queue_.empty()) {
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - benchmarks_started_).count();
+    LOG_INFO("%u benchmarks finished in %.1f [s]", benchmarks_run_, seconds);
+    message_sender_->BenchmarkResult("all/done", {
+      {"benchmarks", static_cast<double>(benchmarks_run_)},
+      {"seconds", seconds},
+    });
+    return;
+  }
+
+  auto next = std::move(benchmark_queue_.front());
+  benchmark_queue_.pop_front();
+  next.first();
+  ++benchmarks_run_;
+  benchmark_running_ = next.second;
+  pp::MessageLoop::GetCurrent().PostWork(cc_factory_.NewCallback(
+      &MessageReceiver::RunNextBenchmark), kPollIntervalMs);
+}
+
+void MessageReceiver::DisposePlayer(
+    std::shared_ptr<PlayerController> controller) {
+  if (!controller) return;
+  disposal_thread_.message_loop().PostWork(cc_factory_.NewCallback(
+      &MessageReceiver::DisposePlayerOnDisposalThread,
+      new std::shared_ptr<PlayerController>(std::move(controller))));
+}
+
+void MessageReceiver::DisposePlayerOnDisposalThread(int32_t,
+    std::shared_ptr<PlayerController>* controller) {
+  TRACE_SCOPE("destroy player");
+  auto started = std::chrono::steady_clock::now();
+  AdoptUnique(controller).reset();
+  LOG_INFO("Player destroyed in %lld ms", static_cast<long long>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - started).count()));
+  if (message_sender_) message_sender_->PlayerClosed();
 }
 
 }  // namespace Communication
@@ -18,21 +18,189 @@
  * @author Michal Murgrabia
  */
 
+#define LOG_CATEGORY LogCategory::kCommunicator
+
 #include "communicator/message_sender.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
 #include <string>
 
+#include "ppapi/cpp/message_loop.h"
+#include "ppapi/cpp/var_array_buffer.h"
 #include "ppapi/cpp/var_dictionary.h"
 
 #include "communicator/messages.h"
+#include "main_thread_budget.h"
 
+using pp::AutoLock;
 using pp::Var;
+using pp::VarArray;
+using pp::VarArrayBuffer;
 using pp::VarDictionary;
 using Samsung::NaClPlayer::TimeTicks;
 using Samsung::NaClPlayer::TextTrackInfo;
+using std::chrono::duration;
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+// Messages posted within this time are sent together, about a frame.
+constexpr int32_t kFlushDelayMs = 16;
+
+constexpr TimeTicks kDefaultTimeUpdateInterval = 0.25;
+
+// A git revision put in benchmark records, set with e.g.
+// -DNATIVE_PLAYER_GIT_SHA=\"$(git rev-parse HEAD)\" in compiler options.
+#ifndef NATIVE_PLAYER_GIT_SHA
+#define NATIVE_PLAYER_GIT_SHA "unknown"
+#endif
+
+constexpr uint32_t kUint32Size = 4;
+constexpr uint32_t kDoubleSize = 8;
+
+// Appends text as a JSON string, names and models need only basic escaping.
+void AppendJsonString(const std::string& text, std::string* json) {
+  json->push_back('"');
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      json->push_back('\\');
+      json->push_back(c);
+    } else if (static_cast<unsigned char>(c) >= 0x20) {
+      json->push_back(c);
+    }
+  }
+  json->push_back('"');
+}
+
+// Formats benchmark values as JSON lines, one record per value, e.g.
+// {"sha":"...","device":"...","benchmark":"manifest/smallVod",
+//  "metric":"parseMs","value":1.5,"timestamp":1467331200}
+std::string FormatBenchmarkRecords(const std::string& device_model,
+    const std::string& benchmark,
+    const std::vector<std::pair<std::string, double>>& values) {
+  std::string prefix = "{\"sha\":";
+  AppendJsonString(NATIVE_PLAYER_GIT_SHA, &prefix);
+  prefix.append(",\"device\":");
+  AppendJsonString(device_model, &prefix);
+  prefix.append(",\"benchmark\":");
+  AppendJsonString(benchmark, &prefix);
+  prefix.append(",\"metric\":");
+
+  char buff[64];
+  snprintf(buff, sizeof(buff), ",\"timestamp\":%lld}\n",
+           static_cast<long long>(time(nullptr)));
+  std::string suffix = buff;
+
+  std::string records;
+  for (const auto& value : values) {
+    records.append(prefix);
+    AppendJsonString(value.first, &records);
+    records.append(",\"value\":");
+    // JSON has no infinities nor NaNs.
+    if (std::isfinite(value.second)) {
+      snprintf(buff, sizeof(buff), "%.17g", value.second);
+      records.append(buff);
+    } else {
+      records.append("null");
+    }
+    records.append(suffix);
+  }
+  return records;
+}
+
+// Writes a binary message, see kSetBinaryMessages for the layout.
+class BinaryMessageWriter {
+ public:
+  BinaryMessageWriter(Communication::MessageFromPlayer type,
+                      uint32_t payload_size)
+      : buffer_(kUint32Size + payload_size),
+        data_(static_cast<uint8_t*>(buffer_.Map())),
+        offset_(0) {
+    WriteUint32(static_cast<uint32_t>(type));
+  }
+
+  ~BinaryMessageWriter() {
+    if (data_) buffer_.Unmap();
+  }
+
+  void WriteUint32(uint32_t value) {
+    for (uint32_t i = 0; i < kUint32Size; ++i)
+      data_[offset_++] = static_cast<uint8_t>(value >> (8 * i));
+  }
+
+  void WriteDouble(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (uint32_t i = 0; i < kDoubleSize; ++i)
+      data_[offset_++] = static_cast<uint8_t>(bits >> (8 * i));
+  }
+
+  VarArrayBuffer Finish() {
+    buffer_.Unmap();
+    data_ = nullptr;
+    return buffer_;
+  }
+
+ private:
+  VarArrayBuffer buffer_;
+  uint8_t* data_;
+  uint32_t offset_;
+};
+
+// Ranges of a stream in a kBufferedRanges message, as [start, end] arrays.
+VarDictionary ToVarDictionary(const StreamBufferedRanges& ranges) {
+  const std::pair<const char*, const StreamBufferedRanges::Range*> stages[] = {
+    {"appended", &ranges.appended},
+    {"queued", &ranges.queued},
+    {"downloaded", &ranges.downloaded},
+  };
+  VarDictionary dictionary;
+  for (const auto& stage : stages) {
+    VarArray range;
+    range.Set(0, stage.second->start);
+    range.Set(1, stage.second->end);
+    dictionary.Set(stage.first, range);
+  }
+  return dictionary;
+}
+
+void WriteRanges(const StreamBufferedRanges& ranges,
+                 BinaryMessageWriter* writer) {
+  for (const auto* range :
+       {&ranges.appended, &ranges.queued, &ranges.downloaded}) {
+    writer->WriteDouble(range->start);
+    writer->WriteDouble(range->end);
+  }
+}
+
+}  // anonymous namespace
 
 namespace Communication {
 
+MessageSender::MessageSender(pp::Instance* instance)
+    : instance_(instance),
+      has_pending_time_update_(false),
+      pending_time_update_(0),
+      has_pending_buffer_level_(false),
+      pending_video_buffer_(0),
+      pending_audio_buffer_(0),
+      has_pending_buffered_ranges_(false),
+      has_pending_subtitles_(false),
+      pending_subtitles_duration_(0),
+      last_periodic_update_(),
+      time_update_interval_(kDefaultTimeUpdateInterval),
+      binary_messages_(false),
+      flush_scheduled_(false),
+      flush_deferred_(false),
+      device_model_("unknown"),
+      cc_factory_(this) {}
+
 void MessageSender::SetMediaDuration(TimeTicks duration) {
   VarDictionary message;
   message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kSetDuration);
@@ -41,19 +209,203 @@ void MessageSender::SetMediaDuration(TimeTicks duration) {
 }
 
 void MessageSender::CurrentTimeUpdate(TimeTicks time) {
-  LOG_DEBUG("Current clip time: %f", time);
+  LOG_EVERY_MS(Debug, 1000, "Current clip time: %f", time);
+  AutoLock lock(lock_);
+  pending_time_update_ = time;
+  has_pending_time_update_ = true;
+  ScheduleFlush(kFlushDelayMs);
+}
+
+void MessageSender::SetTimeUpdateInterval(TimeTicks interval) {
+  AutoLock lock(lock_);
+  time_update_interval_ = std::max(interval, 0.0);
+}
+
+void MessageSender::BufferLevel(TimeTicks video_buffer,
+                                TimeTicks audio_buffer) {
+  AutoLock lock(lock_);
+  pending_video_buffer_ = video_buffer;
+  pending_audio_buffer_ = audio_buffer;
+  has_pending_buffer_level_ = true;
+  ScheduleFlush(kFlushDelayMs);
+}
+
+void MessageSender::BufferedRanges(const StreamBufferedRanges& video,
+                                   const StreamBufferedRanges& audio) {
+  AutoLock lock(lock_);
+  pending_video_ranges_ = video;
+  pending_audio_ranges_ = audio;
+  has_pending_buffered_ranges_ = true;
+  ScheduleFlush(kFlushDelayMs);
+}
+
+void MessageSender::Metrics(const MetricsSnapshot& metrics) {
+  // Values following the license count, in the order of the binary layout.
+  const std::pair<const char*, double> values[] = {
+    {"licenseP50", metrics.license_p50},
+    {"licenseP95", metrics.license_p95},
+    {"licenseP99", metrics.license_p99},
+    {"encryptedPacketsPerSecond", metrics.encrypted_packets_per_second},
+    {"encryptedPackets", static_cast<double>(metrics.encrypted_packets)},
+    {"packetAllocations", static_cast<double>(metrics.packet_allocations)},
+    {"storageAllocations", static_cast<double>(metrics.storage_allocations)},
+    {"bytesDownloaded", static_cast<double>(metrics.bytes_downloaded)},
+    {"segmentsDownloaded", metrics.segments_downloaded},
+    {"bandwidth", metrics.bandwidth},
+    {"videoBuffer", metrics.video_buffer},
+    {"audioBuffer", metrics.audio_buffer},
+    {"videoBufferedBytes",
+     static_cast<double>(metrics.video_buffered_bytes)},
+    {"audioBufferedBytes",
+     static_cast<double>(metrics.audio_buffered_bytes)},
+    {"packetsAppended", static_cast<double>(metrics.packets_appended)},
+    {"packetsDropped", static_cast<double>(metrics.packets_dropped)},
+    {"seekCount", metrics.seek_count},
+    {"seekLatencyAverage", metrics.seek_latency_average},
+    {"seekLatencyMax", metrics.seek_latency_max},
+    {"rebufferCount", metrics.rebuffer_count},
+    {"rebufferDuration", metrics.rebuffer_duration},
+    {"videoRepresentation",
+     static_cast<double>(metrics.video_representation_id)},
+    {"audioRepresentation",
+     static_cast<double>(metrics.audio_representation_id)},
+    {"demuxerCpuTime", metrics.demuxer_cpu_time},
+    {"mainThreadTime", metrics.main_thread_time},
+    {"logForwardingTime", metrics.log_forwarding_time},
+    {"framesOverBudget", static_cast<double>(metrics.frames_over_budget)},
+    {"shedMessages", static_cast<double>(metrics.shed_messages)},
+    {"memoryUsage", static_cast<double>(metrics.memory_usage)},
+    {"memoryPressure", static_cast<double>(metrics.memory_pressure)},
+    {"downloadCpu", metrics.download_cpu},
+    {"demuxCpu", metrics.demux_cpu},
+    {"packetsCpu", metrics.packets_cpu},
+    {"drmCpu", metrics.drm_cpu},
+    {"stallRecoveries", metrics.stall_recoveries},
+    {"tuningProfile", static_cast<double>(metrics.tuning_profile)},
+    {"playerErrors", metrics.player_errors},
+    {"lastPlayerError", static_cast<double>(metrics.last_player_error)},
+    {"platformBuffering", metrics.platform_buffering},
+    {"platformUnderruns", metrics.platform_underruns},
+    {"timeUpdateInterval", metrics.time_update_interval},
+    {"timeUpdateJitter", metrics.time_update_jitter},
+    {"lateTimeUpdates", metrics.late_time_updates},
+    {"deviceMaxBitrate", metrics.device_max_bitrate},
+    {"pipelineSegments", metrics.pipeline_segments},
+    {"requestLatencyP50", metrics.request_latency.p50},
+    {"requestLatencyP90", metrics.request_latency.p90},
+    {"requestLatencyP99", metrics.request_latency.p99},
+    {"downloadLatencyP50", metrics.download_latency.p50},
+    {"downloadLatencyP90", metrics.download_latency.p90},
+    {"downloadLatencyP99", metrics.download_latency.p99},
+    {"firstPacketLatencyP50", metrics.first_packet_latency.p50},
+    {"firstPacketLatencyP90", metrics.first_packet_latency.p90},
+    {"firstPacketLatencyP99", metrics.first_packet_latency.p99},
+    {"parseLatencyP50", metrics.parse_latency.p50},
+    {"parseLatencyP90", metrics.parse_latency.p90},
+    {"parseLatencyP99", metrics.parse_latency.p99},
+    {"appendLatencyP50", metrics.append_latency.p50},
+    {"appendLatencyP90", metrics.append_latency.p90},
+    {"appendLatencyP99", metrics.append_latency.p99},
+    {"segmentLatencyP50", metrics.segment_latency.p50},
+    {"segmentLatencyP90", metrics.segment_latency.p90},
+    {"segmentLatencyP99", metrics.segment_latency.p99},
+  };
+  const auto& histogram = metrics.download_time_histogram;
+  // The next snapshot supersedes this one.
+  if (MainThreadBudget::IsOverBudget()) {
+    MainThreadBudget::AddShedMessages(1);
+    return;
+  }
+
+  bool binary;
+  {
+    AutoLock lock(lock_);
+    binary = binary_messages_;
+  }
+  if (binary) {
+    uint32_t value_count = sizeof(values) / sizeof(values[0]);
+    BinaryMessageWriter writer(MessageFromPlayer::kMetrics,
+        kUint32Size * (2 + histogram.size()) + kDoubleSize * value_count);
+    writer.WriteUint32(metrics.license_count);
+    for (const auto& value : values)
+      writer.WriteDouble(value.second);
+    writer.WriteUint32(histogram.size());
+    for (uint32_t count : histogram)
+      writer.WriteUint32(count);
+    PostMessage(writer.Finish());
+    return;
+  }
+  VarDictionary dictionary;
+  dictionary.Set("licenseCount", static_cast<int32_t>(metrics.license_count));
+  for (const auto& value : values)
+    dictionary.Set(value.first, value.second);
+  VarArray histogram_array;
+  histogram_array.SetLength(histogram.size());
+  for (uint32_t i = 0; i < histogram.size(); ++i)
+    histogram_array.Set(i, static_cast<int32_t>(histogram[i]));
+  dictionary.Set("downloadTimeHistogram", histogram_array);
   VarDictionary message;
-  message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kTimeUpdate);
-  message.Set(kKeyTime, time);
+  message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kMetrics);
+  message.Set(kKeyMetrics, dictionary);
+  PostMessage(message);
+}
+
+void MessageSender::SegmentDownloads(
+    const std::vector<SegmentDownloadRecord>& downloads) {
+  VarArray array;
+  array.SetLength(downloads.size());
+  for (uint32_t i = 0; i < downloads.size(); ++i) {
+    const auto& download = downloads[i];
+    VarDictionary record;
+    record.Set("host", download.host);
+    record.Set("representation", download.representation_id);
+    record.Set("bytes", static_cast<double>(download.bytes));
+    record.Set("status", download.response.status_code);
+    record.Set("openTime", download.open_time);
+    record.Set("firstByteTime", download.first_byte_time);
+    record.Set("bodyTime", download.body_time);
+    record.Set("contentLength",
+               static_cast<double>(download.response.content_length));
+    record.Set("age", static_cast<double>(download.response.age));
+    record.Set("cache", download.response.cache_status);
+    record.Set("serverTiming", download.response.server_timing);
+    record.Set("pop", download.response.cdn_pop);
+    array.Set(i, record);
+  }
+  VarDictionary message;
+  message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kSegmentDownloads);
+  message.Set(kKeyDownloads, array);
   PostMessage(message);
 }
 
+void MessageSender::SetBinaryMessages(bool enabled) {
+  AutoLock lock(lock_);
+  binary_messages_ = enabled;
+}
+
 void MessageSender::BufferingCompleted() {
   VarDictionary message;
   message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kBufferingCompleted);
   PostMessage(message);
 }
 
+void MessageSender::BufferingProgress(uint32_t percent) {
+  VarDictionary message;
+  message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kBufferingProgress);
+  message.Set(kKeyPercent, static_cast<int32_t>(percent));
+  PostMessage(message);
+}
+
+void MessageSender::DownloadProgress(const std::string& url,
+                                     uint32_t percent, int32_t error) {
+  VarDictionary message;
+  message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kDownloadProgress);
+  message.Set(kKeyUrl, url);
+  message.Set(kKeyPercent, static_cast<int32_t>(percent));
+  message.Set(kKeyError, error);
+  PostMessage(message);
+}
+
 void MessageSender::SetRepresentations(const std::vector<AudioStream>& reps) {
   for (auto rep : reps) {
     VarDictionary message;
@@ -90,14 +442,26 @@ void MessageSender::ChangeRepresentation(StreamType type, int32_t id) {
   PostMessage(message);
 }
 
-void MessageSender::ShowSubtitles(TimeTicks duration, const Var& text) {
-  VarDictionary message;
-  message.Set(kKeyMessageFromPlayer,
-              static_cast<int>(MessageFromPlayer::kSubtitles));
-  message.Set(kKeyDuration, duration);
-  message.Set(kKeySubtitle, text);
-  LOG_DEBUG("Sending to JS text: %s", text.AsString().c_str());
-  PostMessage(message);
+void MessageSender::ShowSubtitles(TimeTicks duration,
+                                  const std::string& text) {
+  LOG_DEBUG("Sending to JS text: %s", text.c_str());
+  AutoLock lock(lock_);
+  if (!has_pending_subtitles_) {
+    has_pending_subtitles_ = true;
+    pending_subtitles_duration_ = duration;
+    pending_subtitles_text_ = text;
+  } else {
+    // A message would replace the previous one right away, so cues of the
+    // same frame are shown together instead.
+    pending_subtitles_duration_ =
+        std::max(pending_subtitles_duration_, duration);
+    if (!text.empty() && text != pending_subtitles_text_) {
+      if (!pending_subtitles_text_.empty())
+        pending_subtitles_text_.push_back('\n');
+      pending_subtitles_text_.append(text);
+    }
+  }
+  ScheduleFlush(kFlushDelayMs);
 }
 
 void MessageSender::SetTextTracks(const std::vector<TextTrackInfo>& reps) {
@@ -117,8 +481,237 @@ void MessageSender::StreamEnded() {
   PostMessage(message);
 }
 
+void MessageSender::PlayerClosed() {
+  VarDictionary message;
+  message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kPlayerClosed);
+  PostMessage(message);
+}
+
+void MessageSender::MediaLoaded(int32_t error) {
+  VarDictionary message;
+  message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kMediaLoaded);
+  message.Set(kKeyError, error);
+  PostMessage(message);
+}
+
+void MessageSender::Thumbnail(TimeTicks time, const std::string& url,
+                              const std::string& mime_type,
+                              const std::vector<uint8_t>& image,
+                              const Samsung::NaClPlayer::Rect& tile) {
+  VarArrayBuffer data(image.size());
+  if (!image.empty()) {
+    memcpy(data.Map(), image.data(), image.size());
+    data.Unmap();
+  }
+  VarDictionary message;
+  message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kThumbnail);
+  message.Set(kKeyTime, time);
+  message.Set(kKeyUrl, url);
+  message.Set(kKeyMimeType, mime_type);
+  message.Set(kKeyData, data);
+  message.Set(kKeyXCoordination, tile.x());
+  message.Set(kKeyYCoordination, tile.y());
+  message.Set(kKeyWidth, tile.width());
+  message.Set(kKeyHeight, tile.height());
+  PostMessage(message);
+}
+
+void MessageSender::QoeEvent(const QoeEventData& event) {
+  VarDictionary state;
+  state.Set("videoRepresentation", event.video_representation_id);
+  state.Set("audioRepresentation", event.audio_representation_id);
+  state.Set("videoPendingSegments",
+            static_cast<int32_t>(event.video_pending_segments));
+  state.Set("audioPendingSegments",
+            static_cast<int32_t>(event.audio_pending_segments));
+  state.Set("videoQueuedBytes", static_cast<double>(event.video_queued_bytes));
+  state.Set("audioQueuedBytes", static_cast<double>(event.audio_queued_bytes));
+  state.Set("pendingLicenses", static_cast<int32_t>(event.pending_licenses));
+
+  VarDictionary message;
+  message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kQoeEvent);
+  switch (event.type) {
+    case QoeEventData::Type::kRebufferStart:
+      message.Set(kKeyEvent, "rebufferStart");
+      break;
+    case QoeEventData::Type::kRebufferEnd:
+      message.Set(kKeyEvent, "rebufferEnd");
+      message.Set(kKeyDuration, event.rebuffer_duration);
+      break;
+    case QoeEventData::Type::kError:
+      message.Set(kKeyEvent, "error");
+      message.Set(kKeyError, event.error);
+      break;
+  }
+  message.Set(kKeyTimestamp, event.timestamp);
+  message.Set(kKeyTime, event.playback_time);
+  message.Set(kKeyVideoBuffer, event.video_buffer);
+  message.Set(kKeyAudioBuffer, event.audio_buffer);
+  message.Set(kKeyState, state);
+  PostMessage(message);
+}
+
+void MessageSender::LatencyReport(const std::string& operation,
+    const std::vector<std::pair<std::string, double>>& phases) {
+  VarDictionary phases_dictionary;
+  for (const auto& phase : phases)
+    phases_dictionary.Set(phase.first, phase.second);
+  VarDictionary message;
+  message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kLatencyReport);
+  message.Set(kKeyOperation, operation);
+  message.Set(kKeyPhases, phases_dictionary);
+  PostMessage(message);
+}
+
+void MessageSender::TraceData(const std::string& trace) {
+  VarDictionary message;
+  message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kTraceData);
+  message.Set(kKeyTrace, trace);
+  PostMessage(message);
+}
+
+void MessageSender::BenchmarkResult(const std::string& benchmark,
+    const std::vector<std::pair<std::string, double>>& values) {
+  VarDictionary values_dictionary;
+  for (const auto& value : values)
+    values_dictionary.Set(value.first, value.second);
+  VarDictionary message;
+  message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kBenchmarkResult);
+  message.Set(kKeyBenchmark, benchmark);
+  message.Set(kKeyMetrics, values_dictionary);
+  std::string device_model;
+  {
+    AutoLock lock(lock_);
+    device_model = device_model_;
+  }
+  message.Set(kKeyRecords,
+              FormatBenchmarkRecords(device_model, benchmark, values));
+  PostMessage(message);
+}
+
+void MessageSender::SetDeviceModel(const std::string& model) {
+  AutoLock lock(lock_);
+  device_model_ = model;
+}
+
 void MessageSender::PostMessage(const Var& message) {
-  instance_->PostMessage(message);
+  AutoLock lock(lock_);
+  pending_messages_.Set(pending_messages_.GetLength(), message);
+  ScheduleFlush(kFlushDelayMs);
+}
+
+void MessageSender::ScheduleFlush(int32_t delay_ms) {
+  if (flush_scheduled_) return;
+  flush_scheduled_ = true;
+  pp::MessageLoop::GetForMainThread().PostWork(
+      cc_factory_.NewCallback(&MessageSender::FlushOnMainThread), delay_ms);
+}
+
+void MessageSender::FlushOnMainThread(int32_t) {
+  VarArray messages;
+  {
+    AutoLock lock(lock_);
+    flush_scheduled_ = false;
+    // Over the budget, messages are sent with ones of the next frame, but
+    // they are deferred only once, so they don't starve.
+    if (!flush_deferred_ && MainThreadBudget::IsOverBudget()) {
+      flush_deferred_ = true;
+      MainThreadBudget::AddShedMessages(pending_messages_.GetLength());
+      ScheduleFlush(kFlushDelayMs);
+      return;
+    }
+    flush_deferred_ = false;
+    AppendPeriodicMessages();
+    AppendPendingSubtitles();
+    messages = pending_messages_;
+    pending_messages_ = VarArray();
+  }
+
+  uint32_t count = messages.GetLength();
+  if (count == 0) return;
+  ScopedMainThreadWork work(MainThreadWork::kSendMessages, 1);
+  if (count == 1) {
+    instance_->PostMessage(messages.Get(0));
+    return;
+  }
+  VarDictionary batch;
+  batch.Set(kKeyMessageFromPlayer, MessageFromPlayer::kMessages);
+  batch.Set(kKeyMessages, messages);
+  instance_->PostMessage(batch);
+}
+
+void MessageSender::AppendPeriodicMessages() {
+  if (!has_pending_time_update_ && !has_pending_buffer_level_ &&
+      !has_pending_buffered_ranges_)
+    return;
+  auto now = steady_clock::now();
+  auto due = last_periodic_update_ + duration_cast<steady_clock::duration>(
+      duration<double>(time_update_interval_));
+  if (now < due) {
+    // The latest values are sent once the interval passes.
+    ScheduleFlush(std::max<int32_t>(
+        duration_cast<milliseconds>(due - now).count(), 1));
+    return;
+  }
+  last_periodic_update_ = now;
+
+  if (has_pending_time_update_) {
+    has_pending_time_update_ = false;
+    if (binary_messages_) {
+      BinaryMessageWriter writer(MessageFromPlayer::kTimeUpdate, kDoubleSize);
+      writer.WriteDouble(pending_time_update_);
+      pending_messages_.Set(pending_messages_.GetLength(), writer.Finish());
+    } else {
+      VarDictionary message;
+      message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kTimeUpdate);
+      message.Set(kKeyTime, pending_time_update_);
+      pending_messages_.Set(pending_messages_.GetLength(), message);
+    }
+  }
+  if (has_pending_buffer_level_) {
+    has_pending_buffer_level_ = false;
+    if (binary_messages_) {
+      BinaryMessageWriter writer(MessageFromPlayer::kBufferLevel,
+                                 2 * kDoubleSize);
+      writer.WriteDouble(pending_video_buffer_);
+      writer.WriteDouble(pending_audio_buffer_);
+      pending_messages_.Set(pending_messages_.GetLength(), writer.Finish());
+    } else {
+      VarDictionary message;
+      message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kBufferLevel);
+      message.Set(kKeyVideoBuffer, pending_video_buffer_);
+      message.Set(kKeyAudioBuffer, pending_audio_buffer_);
+      pending_messages_.Set(pending_messages_.GetLength(), message);
+    }
+  }
+  if (has_pending_buffered_ranges_) {
+    has_pending_buffered_ranges_ = false;
+    if (binary_messages_) {
+      BinaryMessageWriter writer(MessageFromPlayer::kBufferedRanges,
+                                 12 * kDoubleSize);
+      WriteRanges(pending_video_ranges_, &writer);
+      WriteRanges(pending_audio_ranges_, &writer);
+      pending_messages_.Set(pending_messages_.GetLength(), writer.Finish());
+    } else {
+      VarDictionary message;
+      message.Set(kKeyMessageFromPlayer, MessageFromPlayer::kBufferedRanges);
+      message.Set(kKeyVideoBuffer, ToVarDictionary(pending_video_ranges_));
+      message.Set(kKeyAudioBuffer, ToVarDictionary(pending_audio_ranges_));
+      pending_messages_.Set(pending_messages_.GetLength(), message);
+    }
+  }
+}
+
+void MessageSender::AppendPendingSubtitles() {
+  if (!has_pending_subtitles_) return;
+  has_pending_subtitles_ = false;
+  VarDictionary message;
+  message.Set(kKeyMessageFromPlayer,
+              static_cast<int>(MessageFromPlayer::kSubtitles));
+  message.Set(kKeyDuration, pending_subtitles_duration_);
+  message.Set(kKeySubtitle, pending_subtitles_text_);
+  pending_messages_.Set(pending_messages_.GetLength(), message);
+  pending_subtitles_text_.clear();
 }
 
 }  // namespace Communication
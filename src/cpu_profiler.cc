@@ -0,0 +1,189 @@
+/*!
+ * cpu_profiler.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#include "cpu_profiler.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "common.h"
+
+namespace {
+
+constexpr size_t kStageCount = static_cast<size_t>(CpuStage::kCount);
+constexpr int32_t kOtherStage = static_cast<int32_t>(CpuStage::kOther);
+// Threads which enter a scope while this many live threads are sampled are
+// not sampled, their CPU time is still counted. Slots of threads which exit
+// are reused.
+constexpr int32_t kMaxSampledThreads = 64;
+
+const char* const kStageNames[kStageCount] = {
+  "other", "download", "demux", "packets", "drm"
+};
+
+// Totals in microseconds, zero-initialized statics.
+std::atomic<uint64_t> stage_cpu_time[kStageCount];
+std::atomic<uint64_t> stage_samples[kStageCount];
+// Current stages of threads, read by the sampling thread. A free slot is
+// in kOtherStage, so it's never counted.
+std::atomic<int32_t> thread_stages[kMaxSampledThreads];
+std::atomic<bool> thread_slot_taken[kMaxSampledThreads];
+
+// Its value is an index of the slot of a thread plus one, its destructor
+// frees the slot when the thread exits.
+pthread_key_t thread_slot_key;
+pthread_once_t thread_slot_key_once = PTHREAD_ONCE_INIT;
+
+__thread int32_t current_stage = kOtherStage;
+__thread double stage_start = 0.;
+__thread std::atomic<int32_t>* thread_slot = nullptr;
+__thread bool thread_slot_assigned = false;
+
+void ReleaseThreadSlot(void* value) {
+  auto index = reinterpret_cast<intptr_t>(value) - 1;
+  thread_stages[index].store(kOtherStage, std::memory_order_relaxed);
+  thread_slot_taken[index].store(false);
+}
+
+void CreateThreadSlotKey() {
+  pthread_key_create(&thread_slot_key, &ReleaseThreadSlot);
+}
+
+// Takes a free slot for the calling thread, returns nullptr if there is
+// none.
+std::atomic<int32_t>* AcquireThreadSlot() {
+  pthread_once(&thread_slot_key_once, &CreateThreadSlotKey);
+  for (intptr_t i = 0; i < kMaxSampledThreads; ++i) {
+    bool taken = false;
+    if (!thread_slot_taken[i].compare_exchange_strong(taken, true)) continue;
+    if (pthread_setspecific(thread_slot_key,
+                            reinterpret_cast<void*>(i + 1)) != 0) {
+      thread_slot_taken[i].store(false);
+      return nullptr;
+    }
+    return &thread_stages[i];
+  }
+  return nullptr;
+}
+
+void SwitchStage(int32_t stage) {
+  double now = CpuProfiler::ThreadCpuTime();
+  double elapsed = now - stage_start;
+  if (current_stage != kOtherStage && elapsed > 0.) {
+    stage_cpu_time[current_stage].fetch_add(
+        static_cast<uint64_t>(elapsed * 1e6), std::memory_order_relaxed);
+  }
+  current_stage = stage;
+  stage_start = now;
+
+  if (!thread_slot_assigned) {
+    thread_slot_assigned = true;
+    thread_slot = AcquireThreadSlot();
+  }
+  if (thread_slot) thread_slot->store(stage, std::memory_order_relaxed);
+}
+
+// Counts stages of threads in regular intervals on a thread of its own.
+class Sampler {
+ public:
+  static Sampler& Get() {
+    static Sampler sampler;
+    return sampler;
+  }
+
+  ~Sampler() { SetInterval(0); }
+
+  void SetInterval(int32_t interval_ms) {
+    std::unique_ptr<std::thread> stopped;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      interval_ms_ = interval_ms;
+      if (interval_ms_ > 0 && !thread_)
+        thread_ = MakeUnique<std::thread>(&Sampler::SampleLoop, this);
+      else if (interval_ms_ <= 0)
+        stopped = std::move(thread_);
+    }
+    condition_.notify_all();
+    if (stopped) stopped->join();
+  }
+
+ private:
+  Sampler() : interval_ms_(0) {}
+
+  void SampleLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (interval_ms_ > 0) {
+      condition_.wait_for(lock, std::chrono::milliseconds(interval_ms_));
+      if (interval_ms_ <= 0) break;
+      for (int32_t i = 0; i < kMaxSampledThreads; ++i) {
+        int32_t stage = thread_stages[i].load(std::memory_order_relaxed);
+        // Threads outside of scopes are idle or do something else.
+        if (stage != kOtherStage)
+          stage_samples[stage].fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  int32_t interval_ms_;
+  std::unique_ptr<std::thread> thread_;
+};
+
+}  // anonymous namespace
+
+double CpuProfiler::ThreadCpuTime() {
+  timespec time;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) return 0.;
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+const char* CpuProfiler::StageName(CpuStage stage) {
+  return kStageNames[static_cast<size_t>(stage)];
+}
+
+CpuProfiler::Report CpuProfiler::GetReport() {
+  Report report;
+  for (size_t i = 0; i < kStageCount; ++i) {
+    report[i].cpu_time = stage_cpu_time[i].load() / 1e6;
+    report[i].samples = stage_samples[i].load();
+  }
+  return report;
+}
+
+void CpuProfiler::SetSamplingInterval(int32_t interval_ms) {
+  Sampler::Get().SetInterval(interval_ms);
+}
+
+CpuStage CpuProfiler::EnterStage(CpuStage stage) {
+  auto previous = static_cast<CpuStage>(current_stage);
+  SwitchStage(static_cast<int32_t>(stage));
+  return previous;
+}
+
+void CpuProfiler::LeaveStage(CpuStage previous) {
+  SwitchStage(static_cast<int32_t>(previous));
+}
@@ -0,0 +1,312 @@
+/*!
+ * base_url_selector.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include "base_url_selector.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <utility>
+
+#include "common.h"
+
+using pp::AutoLock;
+
+namespace {
+
+// Weight of the last request in the measured throughput.
+constexpr double kThroughputSmoothing = 0.3;
+// A failed base URL is avoided for this long, doubled with each consecutive
+// failure up to kMaxFailurePenalty.
+constexpr std::chrono::seconds kFailurePenalty(5);
+constexpr std::chrono::seconds kMaxFailurePenalty(120);
+constexpr const char* kSavedScoresFile = "/base_urls";
+// Older scores say little about the current network, the oldest ones are
+// also dropped when there's too many of them.
+constexpr double kMaxSavedScoreAge = 7. * 24. * 60. * 60.;  // seconds
+constexpr size_t kMaxSavedScores = 64;
+constexpr size_t kMaxSavedLineLength = 4096;
+
+std::string SavedScoresPath() {
+  std::string dir = GetTemporaryStorageDir();
+  return dir.empty() ? dir : dir + kSavedScoresFile;
+}
+
+}  // namespace
+
+BaseUrlSelector& BaseUrlSelector::Get() {
+  static BaseUrlSelector selector;
+  return selector;
+}
+
+BaseUrlSelector::BaseUrlSelector() {}
+
+void BaseUrlSelector::AddAlternatives(
+    const std::vector<std::string>& base_urls,
+    const std::vector<std::string>& service_locations) {
+  if (base_urls.size() < 2) return;
+
+  AutoLock lock(lock_);
+  for (const auto& group : groups_) {
+    if (group == base_urls) return;
+  }
+
+  groups_.push_back(base_urls);
+  for (size_t i = 0; i < base_urls.size(); ++i) {
+    const auto& base_url = base_urls[i];
+    std::string location =
+        i < service_locations.size() ? service_locations[i] : std::string();
+    auto existing = stats_.find(base_url);
+    if (existing != stats_.end()) {
+      if (!location.empty()) existing->second.service_location = location;
+      continue;
+    }
+    auto saved = saved_scores_.find(base_url);
+    double throughput =
+        saved != saved_scores_.end() ? saved->second.throughput : 0.;
+    stats_[base_url] =
+        BaseUrlStats{throughput, 0, 0, Clock::time_point(), location};
+  }
+  LOG_INFO("Registered %zu alternative base URLs for: %s", base_urls.size(),
+           base_urls.front().c_str());
+}
+
+std::string BaseUrlSelector::BeginRequest(const std::string& url) {
+  AutoLock lock(lock_);
+  size_t base_length = 0;
+  int group_index = FindGroup(url, &base_length);
+  if (group_index < 0) return url;
+
+  const auto& group = groups_[group_index];
+  auto now = Clock::now();
+  double best_throughput = 0.;
+  bool any_healthy = false;
+  for (const auto& base_url : group) {
+    const auto& stats = stats_[base_url];
+    best_throughput = std::max(best_throughput, stats.throughput);
+    any_healthy = any_healthy || stats.unhealthy_until <= now;
+  }
+
+  // Base URLs of the most preferred pathway are used first, they are tried
+  // in manifest order when scores are equal.
+  const auto* priority = GroupPathwayPriority(group);
+  const std::string* best = nullptr;
+  size_t best_rank = 0;
+  double best_score = -1.;
+  for (const auto& base_url : group) {
+    const auto& stats = stats_[base_url];
+    if (any_healthy && stats.unhealthy_until > now) continue;
+
+    size_t rank = PathwayRank(priority, stats);
+    if (best && rank > best_rank) continue;
+    double score = Score(stats, best_throughput);
+    if (!best || rank < best_rank || score > best_score) {
+      best_rank = rank;
+      best_score = score;
+      best = &base_url;
+    }
+  }
+
+  ++stats_[*best].requests_in_flight;
+  return *best + url.substr(base_length);
+}
+
+void BaseUrlSelector::EndRequest(const std::string& url, bool succeeded,
+                                 size_t bytes, double seconds) {
+  AutoLock lock(lock_);
+  size_t base_length = 0;
+  if (FindGroup(url, &base_length) < 0) return;
+
+  auto& stats = stats_[url.substr(0, base_length)];
+  if (stats.requests_in_flight > 0) --stats.requests_in_flight;
+
+  if (!succeeded) {
+    ++stats.consecutive_failures;
+    auto penalty = std::min<Clock::duration>(kMaxFailurePenalty,
+        kFailurePenalty * (1 << std::min<uint32_t>(
+            stats.consecutive_failures - 1, 5)));
+    stats.unhealthy_until = Clock::now() + penalty;
+    LOG_INFO("Request to %s failed, avoiding its base URL for %lld [ms]",
+             url.c_str(), static_cast<long long>(
+                 std::chrono::duration_cast<std::chrono::milliseconds>(
+                     penalty).count()));
+    return;
+  }
+
+  stats.consecutive_failures = 0;
+  stats.unhealthy_until = Clock::time_point();
+  if (seconds <= 0.) return;
+
+  double measured = bytes / seconds;
+  stats.throughput = stats.throughput > 0.
+      ? stats.throughput + kThroughputSmoothing * (measured - stats.throughput)
+      : measured;
+}
+
+void BaseUrlSelector::SetPathwayPriority(
+    const void* session, const std::vector<std::string>& pathways) {
+  AutoLock lock(lock_);
+  auto it = std::find_if(pathway_priorities_.begin(),
+                         pathway_priorities_.end(),
+      [session](const std::pair<const void*, std::vector<std::string>>&
+                    priority) { return priority.first == session; });
+  if (it == pathway_priorities_.end() ? pathways.empty()
+                                       : it->second == pathways)
+    return;
+
+  if (it != pathway_priorities_.end()) pathway_priorities_.erase(it);
+
+  if (!pathways.empty()) pathway_priorities_.emplace_back(session, pathways);
+  LOG_INFO("Pathway priority changed, preferred: %s",
+           pathways.empty() ? "none" : pathways.front().c_str());
+}
+
+void BaseUrlSelector::ClearPathwayPriority(const void* session) {
+  SetPathwayPriority(session, std::vector<std::string>());
+}
+
+double BaseUrlSelector::PathwayThroughput(const std::string& pathway) {
+  AutoLock lock(lock_);
+  double throughput = 0.;
+  for (const auto& stats : stats_) {
+    if (stats.second.service_location == pathway)
+      throughput = std::max(throughput, stats.second.throughput);
+  }
+  return throughput;
+}
+
+void BaseUrlSelector::SaveScores() {
+  std::string path = SavedScoresPath();
+  if (path.empty()) return;
+
+  std::vector<std::pair<std::string, SavedScore>> scores;
+  {
+    AutoLock lock(lock_);
+    int64_t now = static_cast<int64_t>(time(nullptr));
+    for (const auto& stats : stats_) {
+      if (stats.second.throughput > 0.)
+        saved_scores_[stats.first] = SavedScore{stats.second.throughput, now};
+    }
+    scores.assign(saved_scores_.begin(), saved_scores_.end());
+  }
+
+  std::sort(scores.begin(), scores.end(),
+            [](const std::pair<std::string, SavedScore>& lhs,
+               const std::pair<std::string, SavedScore>& rhs) {
+              return lhs.second.saved_at > rhs.second.saved_at;
+            });
+  if (scores.size() > kMaxSavedScores) scores.resize(kMaxSavedScores);
+
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) return;
+  for (const auto& score : scores) {
+    fprintf(file, "%.0f %lld %s\n", score.second.throughput,
+            static_cast<long long>(score.second.saved_at),
+            score.first.c_str());
+  }
+  fclose(file);
+}
+
+void BaseUrlSelector::LoadScores() {
+  std::string path = SavedScoresPath();
+  if (path.empty()) return;
+
+  FILE* file = fopen(path.c_str(), "r");
+  if (!file) return;
+  std::map<std::string, SavedScore> scores;
+  time_t now = time(nullptr);
+  char line[kMaxSavedLineLength];
+  while (fgets(line, sizeof(line), file)) {
+    double throughput = 0.;
+    long long saved_at = 0;
+    int url_start = 0;
+    if (sscanf(line, "%lf %lld %n", &throughput, &saved_at, &url_start) < 2 ||
+        url_start == 0 || throughput <= 0.)
+      continue;
+    double age = difftime(now, static_cast<time_t>(saved_at));
+    if (age < 0. || age > kMaxSavedScoreAge) continue;
+
+    std::string base_url(line + url_start);
+    while (!base_url.empty() &&
+           (base_url.back() == '\n' || base_url.back() == '\r'))
+      base_url.pop_back();
+    if (!base_url.empty())
+      scores[base_url] = SavedScore{throughput, saved_at};
+  }
+  fclose(file);
+
+  AutoLock lock(lock_);
+  for (const auto& score : scores) {
+    saved_scores_.insert(score);
+    auto stats = stats_.find(score.first);
+    if (stats != stats_.end() && stats->second.throughput <= 0.)
+      stats->second.throughput = score.second.throughput;
+  }
+  LOG_INFO("Loaded %zu base URL scores saved by previous sessions",
+           scores.size());
+}
+
+int BaseUrlSelector::FindGroup(const std::string& url,
+                               size_t* base_length) const {
+  int found = -1;
+  size_t found_length = 0;
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    for (const auto& base_url : groups_[i]) {
+      if (base_url.size() <= found_length ||
+          url.compare(0, base_url.size(), base_url) != 0)
+        continue;
+      found = static_cast<int>(i);
+      found_length = base_url.size();
+    }
+  }
+
+  *base_length = found_length;
+  return found;
+}
+
+const std::vector<std::string>* BaseUrlSelector::GroupPathwayPriority(
+    const std::vector<std::string>& group) {
+  for (auto it = pathway_priorities_.rbegin();
+       it != pathway_priorities_.rend(); ++it) {
+    for (const auto& base_url : group) {
+      if (PathwayRank(&it->second, stats_[base_url]) < it->second.size())
+        return &it->second;
+    }
+  }
+  return nullptr;
+}
+
+size_t BaseUrlSelector::PathwayRank(const std::vector<std::string>* priority,
+                                    const BaseUrlStats& stats) const {
+  if (!priority) return 0;
+  return std::find(priority->begin(), priority->end(),
+                   stats.service_location) - priority->begin();
+}
+
+double BaseUrlSelector::Score(const BaseUrlStats& stats,
+                              double best_throughput) const {
+  // Unmeasured base URLs are assumed to be as good as the best one, so they
+  // get tried. Requests in flight share the throughput.
+  double throughput = stats.throughput > 0. ? stats.throughput
+                                             : std::max(best_throughput, 1.);
+  return throughput / (1 + stats.requests_in_flight);
+}
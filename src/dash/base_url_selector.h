@@ -0,0 +1,127 @@
+/*!
+ * base_url_selector.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_PLAYER_ES_DASH_PLAYER_DASH_BASE_URL_SELECTOR_H_
+#define SRC_PLAYER_ES_DASH_PLAYER_DASH_BASE_URL_SELECTOR_H_
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ppapi/utility/threading/lock.h"
+
+// Keeps alternative base URLs (e.g. CDNs) listed in manifests and health and
+// throughput scores of each of them. Segment URLs are resolved against the
+// first base URL given in the manifest, requests made through this class are
+// moved to the base URL with the best score, which spreads parallel requests
+// across them and avoids ones which recently failed. When content steering
+// sets a pathway priority, healthy base URLs of the most preferred pathway
+// (BaseURL@serviceLocation) are used first. Each steering session keeps its
+// own priority, so players of a module don't override each other. It's
+// thread safe.
+class BaseUrlSelector {
+ public:
+  static BaseUrlSelector& Get();
+
+  // Registers base URLs which serve the same content. Segment URLs starting
+  // with any of them can be downloaded from any other. service_locations,
+  // if not empty, holds a pathway of each base URL.
+  void AddAlternatives(const std::vector<std::string>& base_urls,
+                       const std::vector<std::string>& service_locations =
+                           std::vector<std::string>());
+
+  // Sets service locations in order of preference, as given by a content
+  // steering server of a session. Base URLs of pathways which are not listed
+  // are used only when listed ones are unhealthy. Alternatives whose
+  // pathways are listed by several sessions follow the latest priority.
+  void SetPathwayPriority(const void* session,
+                          const std::vector<std::string>& pathways);
+
+  // Drops the pathway priority of a session.
+  void ClearPathwayPriority(const void* session);
+
+  // Returns the best measured throughput of base URLs of a pathway in bytes
+  // per second, 0 if it's not known.
+  double PathwayThroughput(const std::string& pathway);
+
+  // Returns an URL that should be used for downloading url and counts
+  // a request to it as started. Each call must be followed by EndRequest().
+  std::string BeginRequest(const std::string& url);
+
+  // Updates score of a base URL of url returned by BeginRequest().
+  void EndRequest(const std::string& url, bool succeeded, size_t bytes,
+                  double seconds);
+
+  // Keeps measured throughputs in the temporary storage, so base URLs of
+  // later sessions start with them instead of being tried in turn. Both
+  // methods must not be called on the main thread.
+  void SaveScores();
+  void LoadScores();
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct BaseUrlStats {
+    // Measured throughput in bytes per second, 0 if unknown.
+    double throughput;
+    uint32_t requests_in_flight;
+    uint32_t consecutive_failures;
+    // The base URL is avoided until then after failures.
+    Clock::time_point unhealthy_until;
+    // BaseURL@serviceLocation, empty if it's not given.
+    std::string service_location;
+  };
+
+  struct SavedScore {
+    double throughput;
+    // Seconds since the epoch.
+    int64_t saved_at;
+  };
+
+  BaseUrlSelector();
+
+  // Returns index of a group url belongs to and length of its base URL, or
+  // -1 if url is not known. lock_ must be locked.
+  int FindGroup(const std::string& url, size_t* base_length) const;
+  double Score(const BaseUrlStats& stats, double best_throughput) const;
+  // Returns the latest pathway priority which lists a pathway of the group,
+  // or null if there's none. lock_ must be locked.
+  const std::vector<std::string>* GroupPathwayPriority(
+      const std::vector<std::string>& group);
+  // Returns a position of the base URL's pathway in priority, or its size if
+  // the pathway is not listed.
+  size_t PathwayRank(const std::vector<std::string>* priority,
+                     const BaseUrlStats& stats) const;
+
+  pp::Lock lock_;
+  // Groups of alternative base URLs.
+  std::vector<std::vector<std::string>> groups_;
+  std::map<std::string, BaseUrlStats> stats_;
+  // Throughputs saved by this and previous sessions, by base URL.
+  std::map<std::string, SavedScore> saved_scores_;
+  // Set by content steering sessions, the latest one last.
+  std::vector<std::pair<const void*, std::vector<std::string>>>
+      pathway_priorities_;
+};
+
+#endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_BASE_URL_SELECTOR_H_
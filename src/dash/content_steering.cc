@@ -0,0 +1,192 @@
+/*!
+ * content_steering.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include "content_steering.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+
+#include "ppapi/c/pp_errors.h"
+
+#include "common.h"
+
+#include "base_url_selector.h"
+#include "util.h"
+
+namespace {
+
+// Used when a steering manifest doesn't give its TTL.
+constexpr double kDefaultTtl = 300.;  // in seconds
+// Guards the server against a TTL which would make requests too often.
+constexpr double kMinTtl = 1.;  // in seconds
+constexpr long kSupportedVersion = 1;
+const char kVersionKey[] = "VERSION";
+const char kTtlKey[] = "TTL";
+const char kReloadUriKey[] = "RELOAD-URI";
+const char kPathwayPriorityKey[] = "PATHWAY-PRIORITY";
+const char kWhitespace[] = " \t\r\n";
+
+// Returns a position of the value of key in json, or npos. Steering
+// manifests are flat objects, so the first occurrence of the key is taken.
+size_t FindValue(const std::string& json, const char* key) {
+  std::string quoted = std::string("\"") + key + "\"";
+  size_t pos = json.find(quoted);
+  if (pos == std::string::npos) return pos;
+  pos = json.find_first_not_of(kWhitespace, pos + quoted.size());
+  if (pos == std::string::npos || json[pos] != ':') return std::string::npos;
+  return json.find_first_not_of(kWhitespace, pos + 1);
+}
+
+// Reads a JSON string starting at *pos and moves *pos past it. URLs and
+// service locations don't need \u escapes, so they are not supported.
+bool ReadString(const std::string& json, size_t* pos, std::string* out) {
+  if (*pos >= json.size() || json[*pos] != '"') return false;
+
+  out->clear();
+  for (size_t i = *pos + 1; i < json.size(); ++i) {
+    char c = json[i];
+    if (c == '"') {
+      *pos = i + 1;
+      return true;
+    }
+    if (c == '\\') {
+      if (++i == json.size() || json[i] == 'u') return false;
+      c = json[i] == 'n' ? '\n' : json[i] == 't' ? '\t' : json[i];
+    }
+    out->push_back(c);
+  }
+  return false;
+}
+
+// RELOAD-URI can be relative to the URL of the last request.
+std::string ResolveReloadUri(const std::string& url, const std::string& uri) {
+  if (uri.find("://") != std::string::npos) return uri;
+
+  if (!uri.empty() && uri.front() == '/') {
+    std::string origin = GetOrigin(url);
+    return origin.empty() ? uri : origin + uri.substr(1);
+  }
+  size_t directory_end = url.find_last_of('/', url.find('?'));
+  if (directory_end == std::string::npos) return uri;
+  return url.substr(0, directory_end + 1) + uri;
+}
+
+}  // namespace
+
+ContentSteering::ContentSteering(const ContentSteeringInfo& info)
+    : info_(info),
+      reload_url_(info.server_url),
+      ttl_(kDefaultTtl) {}
+
+ContentSteering::~ContentSteering() {
+  BaseUrlSelector::Get().ClearPathwayPriority(this);
+}
+
+void ContentSteering::ApplyDefault() {
+  if (info_.default_service_location.empty()) return;
+
+  current_pathway_ = info_.default_service_location;
+  BaseUrlSelector::Get().SetPathwayPriority(this, {current_pathway_});
+}
+
+double ContentSteering::Update() {
+  std::string url = RequestUrl();
+  std::string data;
+  int32_t error_code =
+      ProcessURLRequestOnSideThread(GetRequestForURL(url), &data);
+  if (error_code != PP_OK) {
+    LOG_ERROR("Failed to download a steering manifest from %s: %d",
+              url.c_str(), error_code);
+    return ttl_;
+  }
+
+  SteeringManifest manifest;
+  if (!ParseManifest(data, &manifest)) {
+    LOG_ERROR("Invalid steering manifest from %s", url.c_str());
+    return ttl_;
+  }
+
+  ttl_ = std::max(manifest.ttl, kMinTtl);
+  if (!manifest.reload_uri.empty())
+    reload_url_ = ResolveReloadUri(reload_url_, manifest.reload_uri);
+  if (!manifest.pathway_priority.empty()) {
+    current_pathway_ = manifest.pathway_priority.front();
+    BaseUrlSelector::Get().SetPathwayPriority(this,
+                                              manifest.pathway_priority);
+  }
+  LOG_DEBUG("Steering manifest: %zu pathways, next update in %f [s]",
+            manifest.pathway_priority.size(), ttl_);
+  return ttl_;
+}
+
+bool ContentSteering::ParseManifest(const std::string& json,
+                                    SteeringManifest* manifest) {
+  size_t pos = FindValue(json, kVersionKey);
+  if (pos == std::string::npos ||
+      std::strtol(json.c_str() + pos, nullptr, 10) != kSupportedVersion)
+    return false;
+
+  manifest->ttl = kDefaultTtl;
+  pos = FindValue(json, kTtlKey);
+  if (pos != std::string::npos) {
+    double ttl = std::strtod(json.c_str() + pos, nullptr);
+    if (ttl > 0.) manifest->ttl = ttl;
+  }
+
+  manifest->reload_uri.clear();
+  pos = FindValue(json, kReloadUriKey);
+  if (pos != std::string::npos &&
+      !ReadString(json, &pos, &manifest->reload_uri))
+    return false;
+
+  manifest->pathway_priority.clear();
+  pos = FindValue(json, kPathwayPriorityKey);
+  if (pos == std::string::npos) return true;
+  if (json[pos] != '[') return false;
+  for (++pos;;) {
+    pos = json.find_first_not_of(kWhitespace, pos);
+    if (pos == std::string::npos) return false;
+    if (json[pos] == ']') return true;
+
+    std::string pathway;
+    if (!ReadString(json, &pos, &pathway)) return false;
+    manifest->pathway_priority.push_back(std::move(pathway));
+    pos = json.find_first_not_of(kWhitespace, pos);
+    if (pos != std::string::npos && json[pos] == ',') ++pos;
+  }
+}
+
+std::string ContentSteering::RequestUrl() const {
+  if (current_pathway_.empty()) return reload_url_;
+
+  std::string url = reload_url_;
+  url += url.find('?') == std::string::npos ? '?' : '&';
+  url += "_DASH_pathway=%22" + current_pathway_ + "%22";
+  double throughput =
+      BaseUrlSelector::Get().PathwayThroughput(current_pathway_);
+  if (throughput > 0.) {
+    url += "&_DASH_throughput=" +
+           std::to_string(static_cast<uint64_t>(throughput * 8.));
+  }
+  return url;
+}
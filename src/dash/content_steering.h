@@ -0,0 +1,75 @@
+/*!
+ * content_steering.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_PLAYER_ES_DASH_PLAYER_DASH_CONTENT_STEERING_H_
+#define SRC_PLAYER_ES_DASH_PLAYER_DASH_CONTENT_STEERING_H_
+
+#include <string>
+#include <vector>
+
+#include "dash/dash_manifest.h"
+
+// Keeps the pathway priority of BaseUrlSelector up to date with a DASH
+// content steering server. The steering manifest is downloaded again after
+// its TTL, so the server can move segment requests away from congested CDNs
+// during playback. The priority applies to this session only and it's
+// dropped with the object. Update() downloads it and must not be called on
+// the main thread, the caller schedules the next one.
+class ContentSteering {
+ public:
+  // Fields of a steering manifest (DASH-IF Content Steering, JSON).
+  struct SteeringManifest {
+    // Seconds after which the steering manifest is downloaded again.
+    double ttl;
+    // URL of the next request, empty if the same one is used.
+    std::string reload_uri;
+    // Service locations in order of preference.
+    std::vector<std::string> pathway_priority;
+  };
+
+  explicit ContentSteering(const ContentSteeringInfo& info);
+  ~ContentSteering();
+
+  // Prefers the default service location of the manifest until the first
+  // steering manifest is received.
+  void ApplyDefault();
+
+  // Downloads the steering manifest and applies its pathway priority.
+  // Returns seconds after which it should be called again, the last
+  // priority is kept when the download fails.
+  double Update();
+
+  // Returns false if json isn't a steering manifest of a supported version.
+  static bool ParseManifest(const std::string& json,
+                            SteeringManifest* manifest);
+
+ private:
+  // Adds the pathway in use and its throughput to the request, so the
+  // server can base its decisions on them.
+  std::string RequestUrl() const;
+
+  ContentSteeringInfo info_;
+  std::string reload_url_;
+  // TTL of the last steering manifest, kept when a download fails.
+  double ttl_;
+  // The most preferred pathway, reported to the server.
+  std::string current_pathway_;
+};
+
+#endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_CONTENT_STEERING_H_
@@ -17,29 +17,217 @@
  * @author Adam Bujalski
  */
 
+#define LOG_CATEGORY LogCategory::kDash
+
 #include "dash/dash_manifest.h"
 
+#include <zlib.h>
+
+#include <algorithm>
 #include <vector>
+#include <map>
 #include <string>
-#include <cassert>
+#include <utility>
+#include <tuple>
+#include <cstring>
 
 #include "ppapi/cpp/completion_callback.h"
 #include "ppapi/cpp/url_loader.h"
 #include "ppapi/cpp/url_response_info.h"
 #include "ppapi/cpp/url_request_info.h"
+#include "ppapi/utility/threading/lock.h"
 
 #include "libdash/libdash.h"
 
 #include "dash/media_stream.h"
 #include "dash/media_segment_sequence.h"
+#include "memory_governor.h"
 
+#include "manifest_cache.h"
+#include "mpd_info.h"
+#include "mpd_stream_parser.h"
+#include "multi_period_sequence.h"
 #include "representation_builder.h"
+#include "segment_base_index.h"
+#include "segment_info.h"
+#include "segment_timeline.h"
+#include "util.h"
 
+using pp::AutoLock;
 using pp::CompletionCallback;
 using pp::URLLoader;
 using pp::URLResponseInfo;
 using pp::URLRequestInfo;
 
+namespace {
+
+// Adaptation sets with this EssentialProperty hold keyframes of another
+// adaptation set for fast forward and rewind (DASH-IF IOP 3.2.9).
+const char kTrickModeSchemeIdUri[] = "http://dashif.org/guidelines/trickmode";
+// libdash keeps every element and attribute of a manifest as objects and
+// strings, which take several times the size of the document. The object
+// tree is freed once the manifest is processed, so it's held only while a
+// manifest is parsed or refreshed. MpdStreamParser keeps only MpdInfo,
+// which is smaller than the document.
+constexpr size_t kParsedMPDSizeRatio = 4;
+
+// The steering server URL is resolved like segment URLs, against the MPD
+// location and its first BaseURL.
+ContentSteeringInfo ResolveContentSteering(const MpdInfo& mpd) {
+  ContentSteeringInfo info = mpd.content_steering;
+  const std::string& url = info.server_url;
+  size_t begin = url.find_first_not_of(" \t\r\n");
+  size_t end = url.find_last_not_of(" \t\r\n");
+  if (begin == std::string::npos) return {};
+
+  std::vector<std::string> chain;
+  if (!mpd.mpd_path_base_url.empty())
+    chain.push_back(mpd.mpd_path_base_url);
+  if (!mpd.base_urls.empty()) chain.push_back(mpd.base_urls.front().url);
+  chain.push_back(url.substr(begin, end - begin + 1));
+  info.server_url = ResolveBaseUrl(chain);
+  return info;
+}
+
+bool IsTrickModeAdaptationSet(const AdaptationSetInfo& adaptation_set) {
+  for (const auto& property : adaptation_set.essential_properties) {
+    if (property.scheme_id_uri == kTrickModeSchemeIdUri) return true;
+  }
+  return false;
+}
+
+// Keeps the object tree of a manifest parsed by libdash, which MpdInfo of
+// the manifest refers to.
+struct LibdashMPD {
+  std::unique_ptr<dash::IDASHManager> manager;
+  std::unique_ptr<dash::mpd::IMPD> mpd;
+};
+
+// Parses a manifest in a single pass with MpdStreamParser. Documents it
+// doesn't handle are parsed by libdash, which object tree is kept in
+// libdash_mpd and accounted in usage. Returns false if the manifest can't be
+// parsed.
+bool ParseMPDInfo(const std::string& url, const std::string& mpd_data,
+                  MpdInfo* mpd, LibdashMPD* libdash_mpd, MemoryUsage* usage) {
+  usage->Set(mpd_data.size());
+  if (MpdStreamParser::Parse(url, mpd_data, mpd)) return true;
+
+  LOG_INFO("Falling back to libdash to parse MPD");
+  libdash_mpd->manager.reset(CreateDashManager());
+  if (!libdash_mpd->manager) return false;
+
+  usage->Set(mpd_data.size() * kParsedMPDSizeRatio);
+  libdash_mpd->mpd.reset(libdash_mpd->manager->Open(
+      url.c_str(), mpd_data.data(), mpd_data.size()));
+  if (!libdash_mpd->mpd) {
+    LOG_ERROR("libdash returned null");
+    return false;
+  }
+  *mpd = ExtractMpdInfo(libdash_mpd->mpd.get());
+  return true;
+}
+
+// Manifests are inflated in chunks of that size.
+constexpr size_t kInflateChunkSize = 64 * 1024;
+// Compressed manifests aren't inflated beyond that size.
+constexpr size_t kMaxInflatedMPDSize = 64 * 1024 * 1024;
+
+// Headers of a request revalidating a response with given validators.
+std::string ConditionalHeaders(const std::string& etag,
+                               const std::string& last_modified) {
+  std::string headers;
+  if (!etag.empty())
+    headers = "If-None-Match: " + etag;
+  if (!last_modified.empty()) {
+    if (!headers.empty()) headers += "\n";
+    headers += "If-Modified-Since: " + last_modified;
+  }
+  return headers;
+}
+
+// The browser decodes a Content-Encoding of responses, but some servers
+// send gzip or zlib compressed manifests (e.g. pre-compressed files) as
+// they are. Such data is inflated in place, returns false if it's
+// malformed.
+bool InflateMPD(std::string* mpd_data) {
+  if (mpd_data->size() < 2) return true;
+  uint8_t first = static_cast<uint8_t>((*mpd_data)[0]);
+  uint8_t second = static_cast<uint8_t>((*mpd_data)[1]);
+  bool gzip = first == 0x1f && second == 0x8b;
+  bool zlib = (first & 0x0f) == 8 && (first * 256 + second) % 31 == 0;
+  if (!gzip && !zlib) return true;
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // 32 lets zlib detect the gzip or zlib header.
+  if (inflateInit2(&stream, 15 + 32) != Z_OK) return false;
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(mpd_data->data()));
+  stream.avail_in = mpd_data->size();
+
+  std::string inflated;
+  int result = Z_OK;
+  while (result == Z_OK && inflated.size() < kMaxInflatedMPDSize) {
+    size_t offset = inflated.size();
+    inflated.resize(offset + kInflateChunkSize);
+    stream.next_out = reinterpret_cast<Bytef*>(&inflated[offset]);
+    stream.avail_out = kInflateChunkSize;
+    result = inflate(&stream, Z_NO_FLUSH);
+    inflated.resize(inflated.size() - stream.avail_out);
+  }
+  inflateEnd(&stream);
+  if (result != Z_STREAM_END) {
+    LOG_ERROR("Failed to inflate a compressed MPD: %d", result);
+    return false;
+  }
+
+  LOG_DEBUG("Inflated a compressed MPD: %zu -> %zu bytes", mpd_data->size(),
+            inflated.size());
+  *mpd_data = std::move(inflated);
+  return true;
+}
+
+// Downloads a manifest, revalidating a cached copy of it if there is one.
+int32_t DownloadMPD(const std::string& url, std::string* mpd_data) {
+  std::vector<uint8_t> local_data;
+  if (ReadFromLocalDataSource({url, ""}, &local_data)) {
+    mpd_data->assign(local_data.begin(), local_data.end());
+    return PP_OK;
+  }
+
+  URLRequestInfo mpd_request = GetRequestForURL(url);
+  ManifestCache::Entry cached;
+  bool has_cached = ManifestCache::Get().Lookup(url, &cached);
+  if (has_cached)
+    mpd_request.SetHeaders(
+        ConditionalHeaders(cached.etag, cached.last_modified));
+
+  URLResponseHeaders response;
+  int32_t error_code = ProcessURLRequestOnSideThread(mpd_request, mpd_data,
+                                                     nullptr, &response);
+  if (error_code != PP_OK) return error_code;
+
+  if (has_cached && response.status_code == kHttpNotModified) {
+    LOG_INFO("MPD not modified, using cached copy.");
+    *mpd_data = std::move(cached.body);
+    return PP_OK;
+  }
+  if (!InflateMPD(mpd_data)) return PP_ERROR_FAILED;
+
+  ManifestCache::Entry entry;
+  entry.etag = GetHttpHeader(response.headers, "ETag");
+  entry.last_modified = GetHttpHeader(response.headers, "Last-Modified");
+  entry.body = *mpd_data;
+  ManifestCache::Get().Put(url, entry);
+  return PP_OK;
+}
+
+// Set by the application, see DashManifest::SetDeviceCapabilities().
+pp::Lock device_capabilities_lock;
+DeviceCapabilities device_capabilities;
+
+}  // namespace
+
 // From DASH spec:
 //
 // A Media Presentation as described in the MPD consists of
@@ -74,9 +262,13 @@ using pp::URLRequestInfo;
 
 class DashManifest::Impl {
  public:
-  Impl(std::unique_ptr<dash::IDASHManager> manager,
-       std::unique_ptr<dash::mpd::IMPD> mpd,
+  // Representations don't refer to mpd, so it can be freed afterwards.
+  Impl(const std::string& url, const MpdInfo& mpd,
        ContentProtectionVisitor* visitor);
+  // Joins periods of both manifests, see DashManifest::Concatenate().
+  Impl(const std::shared_ptr<DashManifest>& first,
+       const std::shared_ptr<DashManifest>& next, double first_duration,
+       double next_duration);
   ~Impl() = default;
 
   Impl(const Impl&) = delete;
@@ -89,31 +281,111 @@ class DashManifest::Impl {
   // equals to index of stream!
   std::vector<AudioStream> GetAudioStreams() const;
   std::vector<VideoStream> GetVideoStreams() const;
+  std::vector<TextStream> GetTextStreams() const;
+  std::vector<ImageStream> GetImageStreams() const;
 
   // Assumptions for {Audio|Video}Stream:
   // Id of the representation (field) represenation.description.id
   // equals to index of stream!
-  std::unique_ptr<MediaSegmentSequence> GetAudioSequence(uint32_t id);
-  std::unique_ptr<MediaSegmentSequence> GetVideoSequence(uint32_t id);
+  std::shared_ptr<const MediaSegmentSequence> GetAudioSequence(uint32_t id);
+  std::shared_ptr<const MediaSegmentSequence> GetVideoSequence(uint32_t id);
+  std::shared_ptr<const MediaSegmentSequence> GetTextSequence(uint32_t id);
+  std::shared_ptr<const MediaSegmentSequence> GetImageSequence(uint32_t id);
+  std::shared_ptr<const MediaSegmentSequence> GetTrickModeSequence();
+
+  void PrepareSequence(MediaStreamType type, uint32_t id);
+  std::shared_ptr<const MediaSegmentSequence> TakePreparedSequence(
+      MediaStreamType type, uint32_t id);
 
   const std::string& GetDuration() const;
 
+  bool IsDynamic() const;
+  double GetMinimumUpdatePeriod() const;
+  double GetTargetLatency() const;
+  bool Refresh();
+  void LoadSegmentIndexes();
+  std::vector<std::string> GetOrigins() const;
+  const ContentSteeringInfo& GetContentSteering() const;
+
  private:
-  void ProcessMPD(ContentProtectionVisitor* visitor);
-  void ProcessPeriod(dash::mpd::IPeriod* period,
-                     const RepresentationBuilder& builder);
-  void ProcessAdaptationSet(dash::mpd::IAdaptationSet* adaptation_set,
-                            const RepresentationBuilder& builder);
-  void ProcessRepresentation(dash::mpd::IRepresentation* representation,
-                             const RepresentationBuilder& builder);
+  // A type of the stream, whether it's a trick mode one and an id of the
+  // representation.
+  typedef std::tuple<MediaStreamType, bool, uint32_t> SequenceKey;
+
+  // Representations of a single Period of the presentation.
+  struct Period {
+    std::vector<VideoRepresentation> video;
+    std::vector<AudioRepresentation> audio;
+    // Keyframe only representations for fast forward and rewind, they are
+    // not regular video streams.
+    std::vector<VideoRepresentation> trick_video;
+    std::vector<TextRepresentation> text;
+    std::vector<ImageRepresentation> image;
+  };
 
-  std::unique_ptr<dash::IDASHManager> manager_;
-  std::unique_ptr<dash::mpd::IMPD> mpd_;
+  void ProcessMPD(const MpdInfo& mpd, ContentProtectionVisitor* visitor);
+  // Creates timelines shared by sequences of representations which use
+  // SegmentTimeline, so Refresh() can update them.
+  template <typename T>
+  void CreateTimelines(std::vector<T>* representations);
+  // Creates indexes shared by sequences of representations which use
+  // SegmentBase, so LoadSegmentIndexes() can download them in advance.
+  template <typename T>
+  void CreateSegmentBaseIndexes(std::vector<T>* representations);
+  // Adds origins of base URLs of representations which aren't in origins.
+  template <typename T>
+  static void AddOrigins(const std::vector<T>& representations,
+                         std::vector<std::string>* origins);
+  void ProcessPeriod(const PeriodInfo& period,
+                     const RepresentationBuilder& builder, Period* output);
+  void ProcessAdaptationSet(const AdaptationSetInfo& adaptation_set,
+                            const RepresentationBuilder& builder,
+                            Period* output);
+  void ProcessRepresentation(const RepresentationInfo& representation,
+                             const RepresentationBuilder& builder,
+                             bool prune_unsupported, Period* output);
+  // Returns the sequence of the representation with given id, created by
+  // the first call for it.
+  template <typename T>
+  std::shared_ptr<const MediaSegmentSequence> GetSequence(
+      const SequenceKey& key, std::vector<T> Period::*representations);
+  // Creates a sequence of the representation with given id in the first
+  // period, followed by the most similar representations of next periods.
+  template <typename T>
+  std::unique_ptr<MediaSegmentSequence> CreatePeriodsSequence(
+      std::vector<T> Period::*representations, uint32_t id);
 
-  std::vector<VideoRepresentation> video_;
-  std::vector<AudioRepresentation> audio_;
+  // Address the manifest is refreshed from.
+  std::string url_;
+  // Representations exceeding them are left out of periods_.
+  DeviceCapabilities capabilities_;
+  // MPD@mediaPresentationDuration, or the duration of all joined manifests.
+  std::string duration_;
+  bool dynamic_;
+  double minimum_update_period_;
+  ContentSteeringInfo content_steering_;
+  // Validators of the last refreshed manifest, so a refresh of a manifest
+  // which didn't change gets an empty 304 response.
+  std::string refresh_etag_;
+  std::string refresh_last_modified_;
+  // Manifests joined by Concatenate().
+  std::vector<std::shared_ptr<DashManifest>> joined_manifests_;
+  // Keyed by representation id.
+  std::map<std::string, std::shared_ptr<SegmentTimeline>> timelines_;
+  // Indexes of all periods, in order of representations of the manifest.
+  std::vector<std::shared_ptr<SegmentBaseIndex>> segment_base_indexes_;
 
-  dash::mpd::IPeriod* curr_period_;
+  // Streams are described by representations of the first period.
+  std::vector<Period> periods_;
+
+  // periods_ don't change after construction, so sequences can be created
+  // without locking, only the created ones are guarded. Sequences are
+  // immutable (timelines and segment indexes they share are updated in
+  // place), so a switch back to a representation reuses its sequence
+  // instead of compiling templates and looking up indexes again.
+  pp::Lock sequences_lock_;
+  std::map<SequenceKey, std::shared_ptr<const MediaSegmentSequence>>
+      sequences_;
 };
 
 template <typename T, typename U>
@@ -125,103 +397,533 @@ inline std::vector<T> ExtractStreamInfo(const std::vector<U>& representations) {
   return streams;
 }
 
-DashManifest::Impl::Impl(std::unique_ptr<dash::IDASHManager> manager,
-                         std::unique_ptr<dash::mpd::IMPD> mpd,
+template <typename T>
+inline void ShiftPeriodTiming(std::vector<T>* representations, double offset) {
+  for (auto& rep : *representations)
+    rep.representation.period_start += offset;
+}
+
+template <typename T>
+inline void SetPeriodTiming(std::vector<T>* representations, double start,
+                            double duration) {
+  for (auto& rep : *representations) {
+    rep.representation.period_start = start;
+    rep.representation.period_duration = duration;
+  }
+}
+
+// Returns a representation of the same kind as stream (e.g. of the same
+// language) with the closest bitrate, or of any kind if there is none.
+template <typename T, typename U>
+const T* FindMatchingRepresentation(const std::vector<T>& representations,
+                                    const U& stream) {
+  const T* match = nullptr;
+  bool same_kind = false;
+  uint32_t difference = 0;
+  for (const auto& rep : representations) {
+    bool rep_same_kind = IsSameKind(rep.stream, stream);
+    if (same_kind && !rep_same_kind) continue;
+
+    uint32_t bitrate = rep.stream.description.bitrate;
+    uint32_t wanted = stream.description.bitrate;
+    uint32_t rep_difference =
+        bitrate > wanted ? bitrate - wanted : wanted - bitrate;
+    if (match && rep_same_kind == same_kind && rep_difference >= difference)
+      continue;
+
+    match = &rep;
+    same_kind = rep_same_kind;
+    difference = rep_difference;
+  }
+  return match;
+}
+
+DashManifest::Impl::Impl(const std::string& url, const MpdInfo& mpd,
                          ContentProtectionVisitor* visitor)
-    : manager_(std::move(manager)),
-      mpd_(std::move(mpd)),
-      curr_period_(nullptr) {
-  ProcessMPD(visitor);
+    : url_(url),
+      duration_(mpd.media_presentation_duration),
+      dynamic_(mpd.type == kDynamicPresentationType),
+      minimum_update_period_(kInvalidDuration),
+      joined_manifests_(),
+      periods_() {
+  if (dynamic_)
+    minimum_update_period_ = ParseDurationToSeconds(mpd.minimum_update_period);
+  content_steering_ = ResolveContentSteering(mpd);
+  if (!content_steering_.server_url.empty()) {
+    LOG_INFO("Content steering server: %s",
+             content_steering_.server_url.c_str());
+  }
+  ProcessMPD(mpd, visitor);
+}
+
+DashManifest::Impl::Impl(const std::shared_ptr<DashManifest>& first,
+                         const std::shared_ptr<DashManifest>& next,
+                         double first_duration, double next_duration)
+    : url_(first->pimpl_->url_),
+      duration_("PT" + std::to_string(first_duration + next_duration) + "S"),
+      // Only static presentations are joined.
+      dynamic_(false),
+      minimum_update_period_(kInvalidDuration),
+      content_steering_(first->pimpl_->content_steering_),
+      joined_manifests_{first, next},
+      segment_base_indexes_(first->pimpl_->segment_base_indexes_),
+      periods_(first->pimpl_->periods_) {
+  const Impl& tail = *next->pimpl_;
+  segment_base_indexes_.insert(segment_base_indexes_.end(),
+                               tail.segment_base_indexes_.begin(),
+                               tail.segment_base_indexes_.end());
+  for (Period period : tail.periods_) {
+    ShiftPeriodTiming(&period.video, first_duration);
+    ShiftPeriodTiming(&period.audio, first_duration);
+    ShiftPeriodTiming(&period.trick_video, first_duration);
+    ShiftPeriodTiming(&period.text, first_duration);
+    ShiftPeriodTiming(&period.image, first_duration);
+    periods_.push_back(std::move(period));
+  }
+  LOG_INFO("Joined presentations, %zu periods", periods_.size());
+}
+
+inline void DashManifest::Impl::ProcessMPD(const MpdInfo& mpd,
+                                           ContentProtectionVisitor* visitor) {
+  capabilities_ = DashManifest::GetDeviceCapabilities();
+  RepresentationBuilder builder(mpd, visitor);
+  const auto& periods = mpd.periods;
+  double presentation_duration = ParseDurationToSeconds(duration_);
+  // Refresh() updates timelines of the first period only, so next periods of
+  // a dynamic presentation are not played.
+  size_t period_count = IsDynamic() ? 1 : periods.size();
+  double period_start = 0.;
+  for (size_t i = 0; i < period_count; ++i) {
+    double start = ParseDurationToSeconds(periods[i].start);
+    if (start != kInvalidDuration) {
+      period_start = start;
+    } else if (i > 0 && period_start == kInvalidDuration) {
+      LOG_ERROR("Can't determine start of period %zu, ignoring it and "
+                "following ones", i);
+      break;
+    }
+
+    double duration = ParseDurationToSeconds(periods[i].duration);
+    if (duration == kInvalidDuration) {
+      double end = presentation_duration;
+      if (i + 1 < periods.size())
+        end = ParseDurationToSeconds(periods[i + 1].start);
+      if (end != kInvalidDuration) duration = end - period_start;
+    }
+
+    periods_.emplace_back();
+    Period& period = periods_.back();
+    ProcessPeriod(periods[i], builder, &period);
+    SetPeriodTiming(&period.video, period_start, duration);
+    SetPeriodTiming(&period.audio, period_start, duration);
+    SetPeriodTiming(&period.trick_video, period_start, duration);
+    SetPeriodTiming(&period.text, period_start, duration);
+    SetPeriodTiming(&period.image, period_start, duration);
+    CreateTimelines(&period.video);
+    CreateTimelines(&period.audio);
+    CreateTimelines(&period.trick_video);
+    CreateTimelines(&period.text);
+    CreateTimelines(&period.image);
+    CreateSegmentBaseIndexes(&period.video);
+    CreateSegmentBaseIndexes(&period.audio);
+    CreateSegmentBaseIndexes(&period.trick_video);
+    CreateSegmentBaseIndexes(&period.text);
+    CreateSegmentBaseIndexes(&period.image);
+
+    period_start = duration != kInvalidDuration
+        ? period_start + duration : kInvalidDuration;
+  }
+  LOG_INFO("Processed %zu of %zu periods", periods_.size(), periods.size());
+}
+
+template <typename T>
+void DashManifest::Impl::CreateTimelines(std::vector<T>* representations) {
+  for (auto& rep : *representations) {
+    RepresentationDescription& desc = rep.representation;
+    if (!desc.segment_template || !desc.segment_template->has_timeline)
+      continue;
+
+    auto timeline = std::make_shared<SegmentTimeline>(
+        desc.segment_template->timescale);
+    timeline->Update(desc.segment_template->timeline);
+    desc.segment_timeline = timeline;
+    // Representation ids are unique within a period only, but just the
+    // first period of a dynamic presentation is refreshed.
+    if (IsDynamic()) timelines_[desc.representation_id] = timeline;
+  }
 }
 
-inline void DashManifest::Impl::ProcessMPD(ContentProtectionVisitor* visitor) {
-  // Right now we support only one period in a mpd file.
-  curr_period_ = mpd_->GetPeriods()[0];
+template <typename T>
+void DashManifest::Impl::CreateSegmentBaseIndexes(
+    std::vector<T>* representations) {
+  for (auto& rep : *representations) {
+    RepresentationDescription& desc = rep.representation;
+    if (!desc.segment_base) continue;
 
-  RepresentationBuilder builder(mpd_.get(), visitor);
-  ProcessPeriod(curr_period_, builder);
+    desc.segment_base_index = std::make_shared<SegmentBaseIndex>(desc);
+    segment_base_indexes_.push_back(desc.segment_base_index);
+  }
 }
 
 inline std::vector<AudioStream> DashManifest::Impl::GetAudioStreams() const {
-  return ExtractStreamInfo<AudioStream, AudioRepresentation>(audio_);
+  if (periods_.empty()) return {};
+
+  return ExtractStreamInfo<AudioStream, AudioRepresentation>(
+      periods_[0].audio);
 }
 
 inline std::vector<VideoStream> DashManifest::Impl::GetVideoStreams() const {
-  return ExtractStreamInfo<VideoStream, VideoRepresentation>(video_);
+  if (periods_.empty()) return {};
+
+  return ExtractStreamInfo<VideoStream, VideoRepresentation>(
+      periods_[0].video);
 }
 
-inline std::unique_ptr<MediaSegmentSequence>
-DashManifest::Impl::GetAudioSequence(uint32_t id) {
-  if (id >= audio_.size()) return {};
+inline std::vector<TextStream> DashManifest::Impl::GetTextStreams() const {
+  if (periods_.empty()) return {};
 
-  return CreateSequence(audio_[id].representation,
-                        audio_[id].stream.description.bitrate);
+  return ExtractStreamInfo<TextStream, TextRepresentation>(periods_[0].text);
 }
 
-inline std::unique_ptr<MediaSegmentSequence>
+inline std::vector<ImageStream> DashManifest::Impl::GetImageStreams() const {
+  if (periods_.empty()) return {};
+
+  return ExtractStreamInfo<ImageStream, ImageRepresentation>(
+      periods_[0].image);
+}
+
+inline std::shared_ptr<const MediaSegmentSequence>
+DashManifest::Impl::GetAudioSequence(uint32_t id) {
+  return GetSequence(SequenceKey(MediaStreamType::Audio, false, id),
+                     &Period::audio);
+}
+
+inline std::shared_ptr<const MediaSegmentSequence>
 DashManifest::Impl::GetVideoSequence(uint32_t id) {
-  if (id >= video_.size()) return {};
+  return GetSequence(SequenceKey(MediaStreamType::Video, false, id),
+                     &Period::video);
+}
+
+inline std::shared_ptr<const MediaSegmentSequence>
+DashManifest::Impl::GetTextSequence(uint32_t id) {
+  return GetSequence(SequenceKey(MediaStreamType::Text, false, id),
+                     &Period::text);
+}
+
+inline std::shared_ptr<const MediaSegmentSequence>
+DashManifest::Impl::GetImageSequence(uint32_t id) {
+  return GetSequence(SequenceKey(MediaStreamType::Image, false, id),
+                     &Period::image);
+}
+
+std::shared_ptr<const MediaSegmentSequence>
+DashManifest::Impl::GetTrickModeSequence() {
+  if (periods_.empty() || periods_[0].trick_video.empty()) return {};
+
+  const auto& representations = periods_[0].trick_video;
+  uint32_t id = 0;
+  for (uint32_t i = 1; i < representations.size(); ++i) {
+    if (representations[i].stream.description.bitrate <
+        representations[id].stream.description.bitrate)
+      id = i;
+  }
+  return GetSequence(SequenceKey(MediaStreamType::Video, true, id),
+                     &Period::trick_video);
+}
+
+void DashManifest::Impl::PrepareSequence(MediaStreamType type, uint32_t id) {
+  if (type == MediaStreamType::Audio)
+    GetAudioSequence(id);
+  else if (type == MediaStreamType::Video)
+    GetVideoSequence(id);
+  else if (type == MediaStreamType::Text)
+    GetTextSequence(id);
+  else if (type == MediaStreamType::Image)
+    GetImageSequence(id);
+}
+
+std::shared_ptr<const MediaSegmentSequence>
+DashManifest::Impl::TakePreparedSequence(MediaStreamType type, uint32_t id) {
+  AutoLock lock(sequences_lock_);
+  auto it = sequences_.find(SequenceKey(type, false, id));
+  if (it == sequences_.end()) return {};
+  return it->second;
+}
+
+template <typename T>
+std::shared_ptr<const MediaSegmentSequence> DashManifest::Impl::GetSequence(
+    const SequenceKey& key, std::vector<T> Period::*representations) {
+  {
+    AutoLock lock(sequences_lock_);
+    auto it = sequences_.find(key);
+    if (it != sequences_.end()) return it->second;
+  }
+
+  std::shared_ptr<const MediaSegmentSequence> sequence =
+      CreatePeriodsSequence(representations, std::get<2>(key));
+  if (!sequence) return {};
+
+  AutoLock lock(sequences_lock_);
+  // Another thread could create it in the meantime, the first one is kept.
+  return sequences_.insert(std::make_pair(key, std::move(sequence)))
+      .first->second;
+}
 
-  return CreateSequence(video_[id].representation,
-                        video_[id].stream.description.bitrate);
+template <typename T>
+std::unique_ptr<MediaSegmentSequence>
+DashManifest::Impl::CreatePeriodsSequence(
+    std::vector<T> Period::*representations, uint32_t id) {
+  if (periods_.empty() || id >= (periods_[0].*representations).size())
+    return {};
+
+  const T& selected = (periods_[0].*representations)[id];
+  if (periods_.size() == 1) {
+    return CreateSequence(selected.representation,
+                          selected.stream.description.bitrate);
+  }
+
+  auto sequence = MakeUnique<MultiPeriodSequence>(
+      selected.representation.representation_id,
+      selected.representation.codecs, selected.stream.description.bitrate);
+  for (size_t i = 0; i < periods_.size(); ++i) {
+    const T* rep = FindMatchingRepresentation(periods_[i].*representations,
+                                              selected.stream);
+    if (!rep) {
+      LOG_ERROR("No matching representation in period %zu", i);
+      continue;
+    }
+    auto period_sequence = CreateSequence(rep->representation,
+                                          rep->stream.description.bitrate);
+    if (!period_sequence) continue;
+
+    sequence->AddPeriod(std::move(period_sequence), rep->representation);
+  }
+  return std::unique_ptr<MediaSegmentSequence>(std::move(sequence));
 }
 
 const std::string& DashManifest::Impl::GetDuration() const {
-  return mpd_->GetMediaPresentationDuration();
+  return duration_;
+}
+
+bool DashManifest::Impl::IsDynamic() const {
+  return dynamic_;
+}
+
+double DashManifest::Impl::GetMinimumUpdatePeriod() const {
+  return minimum_update_period_;
+}
+
+double DashManifest::Impl::GetTargetLatency() const {
+  if (!dynamic_ || periods_.empty()) return 0.;
+
+  double latency = 0.;
+  for (const auto& rep : periods_[0].video)
+    latency = std::max(latency, rep.representation.target_latency);
+  for (const auto& rep : periods_[0].audio)
+    latency = std::max(latency, rep.representation.target_latency);
+  return latency;
+}
+
+bool DashManifest::Impl::Refresh() {
+  URLRequestInfo mpd_request = GetRequestForURL(url_);
+  mpd_request.SetHeaders(
+      ConditionalHeaders(refresh_etag_, refresh_last_modified_));
+  std::string mpd_data;
+  URLResponseHeaders response;
+  int32_t error_code = ProcessURLRequestOnSideThread(mpd_request, &mpd_data,
+                                                     nullptr, &response);
+  if (error_code != PP_OK) {
+    LOG_ERROR("Failed to refresh MPD: %d", error_code);
+    return false;
+  }
+  // Timelines are up to date already.
+  if (response.status_code == kHttpNotModified) {
+    LOG_DEBUG("Refreshed MPD not modified");
+    return true;
+  }
+  if (!InflateMPD(&mpd_data)) return false;
+  refresh_etag_ = GetHttpHeader(response.headers, "ETag");
+  refresh_last_modified_ = GetHttpHeader(response.headers, "Last-Modified");
+
+  // The new manifest is used only to update timelines, it's freed when
+  // they are updated.
+  MemoryUsage mpd_usage(MemoryConsumer::kManifest);
+  MpdInfo mpd;
+  LibdashMPD libdash_mpd;
+  if (!ParseMPDInfo(url_, mpd_data, &mpd, &libdash_mpd, &mpd_usage) ||
+      mpd.periods.empty()) {
+    LOG_ERROR("Failed to parse refreshed MPD");
+    return false;
+  }
+  if (!mpd.locations.empty()) url_ = mpd.locations[0];
+
+  size_t added_segments = 0;
+  const PeriodInfo& period = mpd.periods[0];
+  for (const auto& adaptation_set : period.adaptation_sets) {
+    for (const auto& representation : adaptation_set.representations) {
+      auto it = timelines_.find(representation.id);
+      if (it == timelines_.end()) continue;
+
+      // The closest SegmentTemplate applies to the representation.
+      const SegmentTemplateInfo* segment_template =
+          representation.segment_template.get();
+      if (!segment_template)
+        segment_template = adaptation_set.segment_template.get();
+      if (!segment_template) segment_template = period.segment_template.get();
+      if (!segment_template) continue;
+
+      added_segments += it->second->Update(segment_template->timeline);
+    }
+  }
+
+  LOG_DEBUG("Refreshed MPD, %zu new segments", added_segments);
+  return true;
+}
+
+void DashManifest::Impl::LoadSegmentIndexes() {
+  uint32_t loaded = 0;
+  for (const auto& index : segment_base_indexes_)
+    if (index->Load()) ++loaded;
+
+  LOG_DEBUG("Loaded %u of %zu segment indexes", loaded,
+            segment_base_indexes_.size());
+}
+
+template <typename T>
+void DashManifest::Impl::AddOrigins(const std::vector<T>& representations,
+                                    std::vector<std::string>* origins) {
+  for (const auto& rep : representations) {
+    for (const auto& base_url : ResolveBaseUrls(rep.representation)) {
+      std::string origin = GetOrigin(base_url);
+      if (!origin.empty() &&
+          std::find(origins->begin(), origins->end(), origin) ==
+              origins->end())
+        origins->push_back(std::move(origin));
+    }
+  }
+}
+
+const ContentSteeringInfo& DashManifest::Impl::GetContentSteering() const {
+  return content_steering_;
+}
+
+std::vector<std::string> DashManifest::Impl::GetOrigins() const {
+  std::vector<std::string> origins;
+  for (const auto& period : periods_) {
+    AddOrigins(period.video, &origins);
+    AddOrigins(period.audio, &origins);
+    AddOrigins(period.trick_video, &origins);
+    AddOrigins(period.text, &origins);
+    AddOrigins(period.image, &origins);
+  }
+  return origins;
 }
 
 inline void DashManifest::Impl::ProcessPeriod(
-    dash::mpd::IPeriod* period, const RepresentationBuilder& parent_builder) {
+    const PeriodInfo& period, const RepresentationBuilder& parent_builder,
+    Period* output) {
   RepresentationBuilder builder = parent_builder.Visit(period);
 
-  for (auto as : period->GetAdaptationSets()) ProcessAdaptationSet(as, builder);
+  for (const auto& as : period.adaptation_sets)
+    ProcessAdaptationSet(as, builder, output);
 }
 
 inline void DashManifest::Impl::ProcessAdaptationSet(
-    dash::mpd::IAdaptationSet* adaptation_set,
-    const RepresentationBuilder& parent_builder) {
+    const AdaptationSetInfo& adaptation_set,
+    const RepresentationBuilder& parent_builder, Period* output) {
   RepresentationBuilder builder = parent_builder.Visit(adaptation_set);
 
-  for (auto rep : adaptation_set->GetRepresentation())
-    ProcessRepresentation(rep, builder);
+  if (IsTrickModeAdaptationSet(adaptation_set)) {
+    // Players which don't support trick modes must ignore these sets, so
+    // their representations are kept apart from regular video streams.
+    std::vector<AudioRepresentation> no_audio;
+    std::vector<TextRepresentation> no_text;
+    std::vector<ImageRepresentation> no_image;
+    for (const auto& rep : adaptation_set.representations) {
+      builder.Visit(rep).EmitRepresentation(output->trick_video, no_audio,
+                                            no_text, no_image);
+    }
+    LOG_INFO("Found a trick mode adaptation set with %zu representations",
+             adaptation_set.representations.size());
+    return;
+  }
+
+  // A set which the device can't play at all is kept, so playback is still
+  // attempted instead of losing the stream.
+  const auto& representations = adaptation_set.representations;
+  bool prune_unsupported = std::any_of(representations.begin(),
+      representations.end(), [&](const RepresentationInfo& rep) {
+        return builder.Visit(rep).IsSupported(capabilities_);
+      });
+  if (!prune_unsupported && !representations.empty()) {
+    LOG_ERROR("No representation of an adaptation set is supported by the "
+              "device, keeping all of them");
+  }
+
+  for (const auto& rep : representations)
+    ProcessRepresentation(rep, builder, prune_unsupported, output);
 }
 
 inline void DashManifest::Impl::ProcessRepresentation(
-    dash::mpd::IRepresentation* representation,
-    const RepresentationBuilder& parent_builder) {
+    const RepresentationInfo& representation,
+    const RepresentationBuilder& parent_builder, bool prune_unsupported,
+    Period* output) {
   RepresentationBuilder builder = parent_builder.Visit(representation);
-  builder.EmitRepresentation(video_, audio_);
+  if (prune_unsupported && !builder.IsSupported(capabilities_)) {
+    LOG_INFO("Representation %s is not supported by the device, skipping it",
+             builder.Describe().c_str());
+    return;
+  }
+  builder.EmitRepresentation(output->video, output->audio, output->text,
+                             output->image);
+}
+
+void DashManifest::SetDeviceCapabilities(
+    const DeviceCapabilities& capabilities) {
+  AutoLock lock(device_capabilities_lock);
+  device_capabilities = capabilities;
+}
+
+DeviceCapabilities DashManifest::GetDeviceCapabilities() {
+  AutoLock lock(device_capabilities_lock);
+  return device_capabilities;
 }
 
 std::unique_ptr<DashManifest> DashManifest::ParseMPD(
     const std::string& url, ContentProtectionVisitor* visitor) {
-  std::unique_ptr<dash::IDASHManager> manager{CreateDashManager()};
-  if (!manager) return {};
-
-  URLRequestInfo mpd_request = GetRequestForURL(url);
   std::string mpd_data;
-  int32_t error_code =  ProcessURLRequestOnSideThread(mpd_request, &mpd_data);
+  if (!DownloadManifest(url, &mpd_data)) return {};
+
+  return ParseMPD(url, mpd_data, visitor);
+}
+
+bool DashManifest::DownloadManifest(const std::string& url,
+                                    std::string* mpd_data) {
+  int32_t error_code = DownloadMPD(url, mpd_data);
   if (error_code != PP_OK) {
     LOG_ERROR("Failed to download MPD: %d", error_code);
-    return {};
+    return false;
   }
-  std::unique_ptr<dash::mpd::IMPD> mpd{manager->Open(url.c_str(),
-                                                     mpd_data.data(),
-                                                     mpd_data.size())};
-  if (!mpd) {
-    LOG_ERROR("libdash returned null");
+  return true;
+}
+
+std::unique_ptr<DashManifest> DashManifest::ParseMPD(const std::string& url,
+    const std::string& mpd_data, ContentProtectionVisitor* visitor) {
+  // The parsed manifest is freed once it's processed.
+  MemoryUsage mpd_usage(MemoryConsumer::kManifest);
+  MpdInfo mpd;
+  LibdashMPD libdash_mpd;
+  if (!ParseMPDInfo(url, mpd_data, &mpd, &libdash_mpd, &mpd_usage))
     return {};
-  }
 
   // According to DASH spec must be at least one more Period
-  assert(mpd->GetPeriods().size() > 0);
-  if (mpd->GetPeriods().empty()) {
+  if (mpd.periods.empty()) {
     LOG_ERROR("No periods");
     return {};
   }
 
   auto manifest = MakeUnique<DashManifest>(
-      std::move(manager), std::move(mpd), visitor);
+      MakeUnique<DashManifest::Impl>(url, mpd, visitor));
 
   if (!manifest || !manifest->pimpl_) {
     LOG_ERROR("Failed to create dash manifest");
@@ -231,6 +933,28 @@ std::unique_ptr<DashManifest> DashManifest::ParseMPD(
   return manifest;
 }
 
+std::unique_ptr<DashManifest> DashManifest::Concatenate(
+    const std::shared_ptr<DashManifest>& first,
+    const std::shared_ptr<DashManifest>& next) {
+  if (!first || !next) return {};
+
+  if (first->IsDynamic() || next->IsDynamic()) {
+    LOG_ERROR("Dynamic presentations can't be joined");
+    return {};
+  }
+
+  double first_duration = ParseDurationToSeconds(first->GetDuration());
+  double next_duration = ParseDurationToSeconds(next->GetDuration());
+  if (first_duration == kInvalidDuration ||
+      next_duration == kInvalidDuration) {
+    LOG_ERROR("Durations of joined presentations must be known");
+    return {};
+  }
+
+  return MakeUnique<DashManifest>(MakeUnique<DashManifest::Impl>(
+      first, next, first_duration, next_duration));
+}
+
 std::vector<AudioStream> DashManifest::GetAudioStreams() const {
   return pimpl_->GetAudioStreams();
 }
@@ -238,33 +962,94 @@ std::vector<VideoStream> DashManifest::GetVideoStreams() const {
   return pimpl_->GetVideoStreams();
 }
 
-std::unique_ptr<MediaSegmentSequence> DashManifest::GetSequence(
+std::vector<TextStream> DashManifest::GetTextStreams() const {
+  return pimpl_->GetTextStreams();
+}
+
+std::vector<ImageStream> DashManifest::GetImageStreams() const {
+  return pimpl_->GetImageStreams();
+}
+
+std::shared_ptr<const MediaSegmentSequence> DashManifest::GetSequence(
     MediaStreamType type, uint32_t id) {
   if (type == MediaStreamType::Audio) return GetAudioSequence(id);
 
   if (type == MediaStreamType::Video) return GetVideoSequence(id);
 
+  if (type == MediaStreamType::Text) return GetTextSequence(id);
+
+  if (type == MediaStreamType::Image) return GetImageSequence(id);
+
   return {};
 }
 
-std::unique_ptr<MediaSegmentSequence> DashManifest::GetAudioSequence(
+std::shared_ptr<const MediaSegmentSequence> DashManifest::GetAudioSequence(
     uint32_t id) {
   return pimpl_->GetAudioSequence(id);
 }
 
-std::unique_ptr<MediaSegmentSequence> DashManifest::GetVideoSequence(
+std::shared_ptr<const MediaSegmentSequence> DashManifest::GetVideoSequence(
     uint32_t id) {
   return pimpl_->GetVideoSequence(id);
 }
 
+std::shared_ptr<const MediaSegmentSequence> DashManifest::GetTextSequence(
+    uint32_t id) {
+  return pimpl_->GetTextSequence(id);
+}
+
+std::shared_ptr<const MediaSegmentSequence> DashManifest::GetImageSequence(
+    uint32_t id) {
+  return pimpl_->GetImageSequence(id);
+}
+
+std::shared_ptr<const MediaSegmentSequence>
+DashManifest::GetTrickModeSequence() {
+  return pimpl_->GetTrickModeSequence();
+}
+
+void DashManifest::PrepareSequence(MediaStreamType type, uint32_t id) {
+  pimpl_->PrepareSequence(type, id);
+}
+
+std::shared_ptr<const MediaSegmentSequence>
+DashManifest::TakePreparedSequence(MediaStreamType type, uint32_t id) {
+  return pimpl_->TakePreparedSequence(type, id);
+}
+
 const std::string& DashManifest::GetDuration() const {
   return pimpl_->GetDuration();
 }
 
-DashManifest::DashManifest(std::unique_ptr<dash::IDASHManager> manager,
-                           std::unique_ptr<dash::mpd::IMPD> mpd,
-                           ContentProtectionVisitor* visitor)
-    : pimpl_(MakeUnique<DashManifest::Impl>(
-        std::move(manager), std::move(mpd), visitor)) {}
+bool DashManifest::IsDynamic() const {
+  return pimpl_->IsDynamic();
+}
+
+double DashManifest::GetMinimumUpdatePeriod() const {
+  return pimpl_->GetMinimumUpdatePeriod();
+}
+
+double DashManifest::GetTargetLatency() const {
+  return pimpl_->GetTargetLatency();
+}
+
+bool DashManifest::Refresh() {
+  return pimpl_->Refresh();
+}
+
+void DashManifest::LoadSegmentIndexes() {
+  pimpl_->LoadSegmentIndexes();
+}
+
+std::vector<std::string> DashManifest::GetOrigins() const {
+  return pimpl_->GetOrigins();
+}
+
+const ContentSteeringInfo& DashManifest::GetContentSteering() const {
+  return pimpl_->GetContentSteering();
+}
+
+DashManifest::DashManifest(std::unique_ptr<Impl> pimpl)
+    : pimpl_(std::move(pimpl)) {}
 
 DashManifest::~DashManifest() {}
@@ -0,0 +1,407 @@
+/*!
+ * manifest_benchmark.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include "manifest_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "common.h"
+#include "dash/dash_manifest.h"
+#include "dash/media_segment_sequence.h"
+
+using std::chrono::steady_clock;
+using std::string;
+using std::vector;
+
+namespace {
+
+const char kBaseUrl[] = "http://manifest-benchmark.local/";
+
+constexpr double kSegmentDuration = 2.;  // seconds
+constexpr uint32_t kLookups = 10000;
+// Random times are reproducible between runs.
+constexpr uint32_t kRandomSeed = 1234;
+
+// Multi-language manifest: video representations, audio languages and
+// audio representations of each language, 100 representations in total.
+constexpr uint32_t kLanguageVideoCount = 10;
+constexpr uint32_t kLanguageCount = 30;
+constexpr uint32_t kLanguageAudioCount = 3;
+constexpr double kLanguageDuration = 2. * 3600.;  // seconds
+
+constexpr double kVodDuration = 10. * 60.;  // seconds
+// Live DVR window covered by the SegmentTimeline.
+constexpr double kDvrDuration = 4. * 3600.;  // seconds
+// SegmentBase: a reference per segment, sidx reference_count is 16 bit.
+constexpr uint32_t kSidxReferences = 9000;
+constexpr uint32_t kSidxTimescale = 1000;
+constexpr uint32_t kSidxSegmentSize = 500000;  // bytes
+// ftyp box preceding sidx in SegmentBase files.
+constexpr uint32_t kFtypSize = 24;
+
+void AppendUnsigned(uint32_t value, vector<uint8_t>* out) {
+  for (int shift = 24; shift >= 0; shift -= 8)
+    out->push_back(static_cast<uint8_t>(value >> shift));
+}
+
+void AppendFourCC(const char* four_cc, vector<uint8_t>* out) {
+  out->insert(out->end(), four_cc, four_cc + 4);
+}
+
+// An ftyp box followed by a version 0 sidx box with a reference per segment,
+// each starting with a SAP of type 1. Media data isn't included, as it's
+// never requested.
+vector<uint8_t> MakeSegmentBaseFile() {
+  vector<uint8_t> file;
+  AppendUnsigned(kFtypSize, &file);
+  AppendFourCC("ftyp", &file);
+  AppendFourCC("iso6", &file);
+  AppendUnsigned(0, &file);
+  AppendFourCC("iso6", &file);
+  AppendFourCC("dash", &file);
+
+  uint32_t sidx_size = 32 + kSidxReferences * 12;
+  AppendUnsigned(sidx_size, &file);
+  AppendFourCC("sidx", &file);
+  AppendUnsigned(0, &file);  // version and flags
+  AppendUnsigned(1, &file);  // reference_id
+  AppendUnsigned(kSidxTimescale, &file);
+  AppendUnsigned(0, &file);  // earliest_presentation_time
+  AppendUnsigned(0, &file);  // first_offset
+  AppendUnsigned(kSidxReferences, &file);  // reserved and reference_count
+  auto segment_duration =
+      static_cast<uint32_t>(kSegmentDuration * kSidxTimescale);
+  for (uint32_t i = 0; i < kSidxReferences; ++i) {
+    AppendUnsigned(kSidxSegmentSize, &file);
+    AppendUnsigned(segment_duration, &file);
+    AppendUnsigned(0x90000000u, &file);  // starts_with_SAP, SAP type 1
+  }
+  return file;
+}
+
+string MpdHeader(const char* type, double duration) {
+  std::ostringstream mpd;
+  mpd << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      << "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" type=\"" << type
+      << "\" minBufferTime=\"PT2S\"";
+  if (string(type) == "dynamic") {
+    mpd << " availabilityStartTime=\"2016-01-01T00:00:00Z\""
+        << " minimumUpdatePeriod=\"PT2S\" timeShiftBufferDepth=\"PT"
+        << duration << "S\"";
+  } else {
+    mpd << " mediaPresentationDuration=\"PT" << duration << "S\"";
+  }
+  mpd << " profiles=\"urn:mpeg:dash:profile:isoff-live:2011\">\n"
+      << "<Period id=\"1\" start=\"PT0S\">\n";
+  return mpd.str();
+}
+
+const char kMpdFooter[] = "</Period>\n</MPD>\n";
+
+string NumberTemplate(const string& name) {
+  std::ostringstream segment_template;
+  segment_template << "<SegmentTemplate timescale=\"1000\" duration=\""
+      << static_cast<uint32_t>(kSegmentDuration * 1000)
+      << "\" startNumber=\"1\" initialization=\"" << name
+      << "/$RepresentationID$/init.mp4\" media=\"" << name
+      << "/$RepresentationID$/$Number$.m4s\"/>\n";
+  return segment_template.str();
+}
+
+void AppendVideoRepresentations(uint32_t count, const string& prefix,
+                                std::ostringstream* mpd) {
+  for (uint32_t i = 0; i < count; ++i) {
+    *mpd << "<Representation id=\"" << prefix << i << "\" bandwidth=\""
+         << 500000 * (i + 1) << "\" width=\"" << 320 * (i % 6 + 1)
+         << "\" height=\"" << 180 * (i % 6 + 1) << "\"/>\n";
+  }
+}
+
+string MakeSmallVod() {
+  std::ostringstream mpd;
+  mpd << MpdHeader("static", kVodDuration)
+      << "<AdaptationSet mimeType=\"video/mp4\" codecs=\"avc1.64001f\">\n"
+      << NumberTemplate("vod");
+  AppendVideoRepresentations(3, "v", &mpd);
+  mpd << "</AdaptationSet>\n"
+      << "<AdaptationSet mimeType=\"audio/mp4\" codecs=\"mp4a.40.2\""
+      << " lang=\"en\">\n" << NumberTemplate("vod")
+      << "<Representation id=\"a0\" bandwidth=\"128000\"/>\n"
+      << "</AdaptationSet>\n" << kMpdFooter;
+  return mpd.str();
+}
+
+string MakeMultiLanguage() {
+  std::ostringstream mpd;
+  mpd << MpdHeader("static", kLanguageDuration)
+      << "<AdaptationSet mimeType=\"video/mp4\" codecs=\"avc1.640028\">\n"
+      << NumberTemplate("languages");
+  AppendVideoRepresentations(kLanguageVideoCount, "v", &mpd);
+  mpd << "</AdaptationSet>\n";
+  for (uint32_t language = 0; language < kLanguageCount; ++language) {
+    char lang[] = {static_cast<char>('a' + language / 26),
+                   static_cast<char>('a' + language % 26), '\0'};
+    mpd << "<AdaptationSet mimeType=\"audio/mp4\" codecs=\"mp4a.40.2\""
+        << " lang=\"" << lang << "\">\n" << NumberTemplate("languages");
+    for (uint32_t i = 0; i < kLanguageAudioCount; ++i) {
+      mpd << "<Representation id=\"a_" << lang << i << "\" bandwidth=\""
+          << 64000 * (i + 1) << "\"/>\n";
+    }
+    mpd << "</AdaptationSet>\n";
+  }
+  mpd << kMpdFooter;
+  return mpd.str();
+}
+
+string MakeLiveDvr() {
+  // Durations alternate, like with 29.97 fps content, so S elements can't be
+  // folded with @r and the timeline has an entry per segment.
+  std::ostringstream timeline;
+  timeline << "<SegmentTemplate timescale=\"90000\""
+           << " initialization=\"live/$RepresentationID$/init.mp4\""
+           << " media=\"live/$RepresentationID$/$Time$.m4s\">\n"
+           << "<SegmentTimeline>\n";
+  uint64_t time = 0;
+  auto segments = static_cast<uint32_t>(kDvrDuration / kSegmentDuration);
+  for (uint32_t i = 0; i < segments; ++i) {
+    uint32_t segment_duration = (i % 2) ? 180180 : 179820;
+    timeline << "<S t=\"" << time << "\" d=\"" << segment_duration
+             << "\"/>\n";
+    time += segment_duration;
+  }
+  timeline << "</SegmentTimeline>\n</SegmentTemplate>\n";
+
+  std::ostringstream mpd;
+  mpd << MpdHeader("dynamic", kDvrDuration)
+      << "<AdaptationSet mimeType=\"video/mp4\" codecs=\"avc1.64001f\">\n"
+      << timeline.str();
+  AppendVideoRepresentations(4, "v", &mpd);
+  mpd << "</AdaptationSet>\n"
+      << "<AdaptationSet mimeType=\"audio/mp4\" codecs=\"mp4a.40.2\""
+      << " lang=\"en\">\n" << timeline.str()
+      << "<Representation id=\"a0\" bandwidth=\"128000\"/>\n"
+      << "</AdaptationSet>\n" << kMpdFooter;
+  return mpd.str();
+}
+
+string MakeSegmentBase() {
+  std::ostringstream segment_base;
+  segment_base << "<SegmentBase indexRange=\"" << kFtypSize << "-"
+               << kFtypSize + 32 + kSidxReferences * 12 - 1 << "\">\n"
+               << "<Initialization range=\"0-" << kFtypSize - 1 << "\"/>\n"
+               << "</SegmentBase>\n";
+
+  std::ostringstream mpd;
+  mpd << MpdHeader("static", kSidxReferences * kSegmentDuration)
+      << "<AdaptationSet mimeType=\"video/mp4\" codecs=\"avc1.64001f\">\n";
+  for (uint32_t i = 0; i < 3; ++i) {
+    mpd << "<Representation id=\"v" << i << "\" bandwidth=\""
+        << 1000000 * (i + 1) << "\" width=\"" << 640 * (i + 1)
+        << "\" height=\"" << 360 * (i + 1) << "\">\n"
+        << "<BaseURL>sidx/v" << i << ".mp4</BaseURL>\n" << segment_base.str()
+        << "</Representation>\n";
+  }
+  mpd << "</AdaptationSet>\n"
+      << "<AdaptationSet mimeType=\"audio/mp4\" codecs=\"mp4a.40.2\""
+      << " lang=\"en\">\n"
+      << "<Representation id=\"a0\" bandwidth=\"128000\">\n"
+      << "<BaseURL>sidx/a0.mp4</BaseURL>\n" << segment_base.str()
+      << "</Representation>\n</AdaptationSet>\n" << kMpdFooter;
+  return mpd.str();
+}
+
+// Serves manifests by their URLs and SegmentBase files by the "sidx/" path,
+// honoring byte ranges.
+class LocalResources {
+ public:
+  LocalResources() : segment_base_file_(MakeSegmentBaseFile()) {}
+
+  void Add(const string& url, const string& data) {
+    resources_[url] = data;
+  }
+
+  bool Read(const SegmentDescriptor& location, vector<uint8_t>* data) const {
+    auto it = resources_.find(location.url);
+    if (it != resources_.end()) {
+      data->assign(it->second.begin(), it->second.end());
+      return true;
+    }
+    if (location.url.find(string(kBaseUrl) + "sidx/") != 0) return false;
+
+    uint64_t first = 0;
+    uint64_t last = segment_base_file_.size() - 1;
+    size_t dash = location.range.find('-');
+    if (dash != string::npos) {
+      first = std::stoull(location.range.substr(0, dash));
+      last = std::min<uint64_t>(std::stoull(location.range.substr(dash + 1)),
+                                last);
+    }
+    if (first > last) return false;
+    data->assign(segment_base_file_.begin() + first,
+                 segment_base_file_.begin() + last + 1);
+    return true;
+  }
+
+ private:
+  std::map<string, string> resources_;
+  vector<uint8_t> segment_base_file_;
+};
+
+}  // anonymous namespace
+
+ManifestBenchmark::ManifestBenchmark(const pp::InstanceHandle& instance)
+    : cc_factory_(this),
+      running_(false),
+      cancelled_(false),
+      thread_(instance) {
+  thread_.Start();
+}
+
+ManifestBenchmark::~ManifestBenchmark() {
+  cancelled_ = true;
+  thread_.Join();
+}
+
+bool ManifestBenchmark::Start(const ResultCallback& callback) {
+  if (running_.exchange(true)) {
+    LOG_ERROR("A manifest benchmark is running already");
+    return false;
+  }
+  callback_ = callback;
+  thread_.message_loop().PostWork(cc_factory_.NewCallback(
+      &ManifestBenchmark::RunOnBenchmarkThread));
+  return true;
+}
+
+void ManifestBenchmark::RunOnBenchmarkThread(int32_t) {
+  const std::pair<const char*, string> corpus[] = {
+    {"smallVod", MakeSmallVod()},
+    {"multiLanguage", MakeMultiLanguage()},
+    {"liveDvr", MakeLiveDvr()},
+    {"segmentBaseSidx", MakeSegmentBase()},
+  };
+  auto resources = std::make_shared<LocalResources>();
+  for (const auto& manifest : corpus)
+    resources->Add(kBaseUrl + string(manifest.first) + ".mpd",
+                   manifest.second);
+  SetLocalDataSource([resources](const SegmentDescriptor& location,
+                                 vector<uint8_t>* data) {
+    return resources->Read(location, data);
+  });
+
+  for (const auto& manifest : corpus) {
+    if (cancelled_) break;
+    Result result = Run(manifest.first,
+                        kBaseUrl + string(manifest.first) + ".mpd");
+    result.mpd_bytes = manifest.second.size();
+    LOG_INFO("%s: %s, %llu bytes, %u representations, parse: %.3f [ms], "
+             "streams: %.1f [us], sequence: %.1f [us], first lookup: %.3f "
+             "[ms], lookup: %.0f [ns], walk: %llu segments %.0f [ns] each",
+             result.manifest.c_str(), result.ok ? "ok" : "failed",
+             static_cast<unsigned long long>(result.mpd_bytes),
+             result.representations, result.parse_ms, result.get_streams_us,
+             result.create_sequence_us, result.first_lookup_ms,
+             result.lookup_ns,
+             static_cast<unsigned long long>(result.segments),
+             result.walk_ns_per_segment);
+    if (callback_) callback_(result);
+  }
+  SetLocalDataSource(nullptr);
+  callback_ = nullptr;
+  running_ = false;
+}
+
+ManifestBenchmark::Result ManifestBenchmark::Run(const string& name,
+                                                 const string& url) {
+  Result result = Result();
+  result.manifest = name;
+
+  auto start = steady_clock::now();
+  auto manifest = DashManifest::ParseMPD(url);
+  result.parse_ms = MicrosecondsSince(start) / 1e3;
+  if (!manifest) {
+    LOG_ERROR("Failed to parse %s", url.c_str());
+    return result;
+  }
+
+  start = steady_clock::now();
+  vector<VideoStream> video_streams = manifest->GetVideoStreams();
+  vector<AudioStream> audio_streams = manifest->GetAudioStreams();
+  result.get_streams_us = MicrosecondsSince(start);
+  result.representations = video_streams.size() + audio_streams.size();
+  if (video_streams.empty()) {
+    LOG_ERROR("No video streams in %s", url.c_str());
+    return result;
+  }
+
+  // A sequence is created for every representation, like when switching
+  // between them.
+  std::shared_ptr<const MediaSegmentSequence> sequence;
+  start = steady_clock::now();
+  for (uint32_t id = 0; id < audio_streams.size(); ++id)
+    manifest->GetAudioSequence(id);
+  for (uint32_t id = 0; id < video_streams.size(); ++id)
+    sequence = manifest->GetVideoSequence(id);
+  result.create_sequence_us =
+      MicrosecondsSince(start) / result.representations;
+  if (!sequence) {
+    LOG_ERROR("Failed to create a sequence for %s", url.c_str());
+    return result;
+  }
+
+  start = steady_clock::now();
+  auto end = sequence->End();
+  auto begin = sequence->MediaSegmentForTime(0.);
+  result.first_lookup_ms = MicrosecondsSince(start) / 1e3;
+
+  // Walks the sequence before random lookups, as its length bounds times.
+  double sequence_end = 0.;
+  start = steady_clock::now();
+  for (auto it = sequence->Begin(); it != end && !cancelled_; ++it) {
+    sequence_end = sequence->SegmentTimestamp(it) +
+        sequence->SegmentDuration(it);
+    ++result.segments;
+  }
+  if (result.segments > 0) {
+    result.walk_ns_per_segment =
+        MicrosecondsSince(start) * 1e3 / result.segments;
+  }
+
+  std::mt19937 generator(kRandomSeed);
+  std::uniform_real_distribution<double> times(0., sequence_end);
+  uint32_t found = 0;
+  start = steady_clock::now();
+  for (uint32_t i = 0; i < kLookups && !cancelled_; ++i)
+    if (sequence->MediaSegmentForTime(times(generator)) != end) ++found;
+  result.lookup_ns = MicrosecondsSince(start) * 1e3 / kLookups;
+  if (found < kLookups)
+    LOG_DEBUG("%s: %u of %u lookups found a segment", name.c_str(), found,
+              kLookups);
+
+  result.ok = begin != end && result.segments > 0 && !cancelled_;
+  return result;
+}
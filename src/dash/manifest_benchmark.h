@@ -0,0 +1,85 @@
+/*!
+ * manifest_benchmark.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_PLAYER_ES_DASH_PLAYER_DASH_MANIFEST_BENCHMARK_H_
+#define SRC_PLAYER_ES_DASH_PLAYER_DASH_MANIFEST_BENCHMARK_H_
+
+#include <atomic>
+#include <functional>
+#include <string>
+
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/simple_thread.h"
+
+// Measures the manifest layer on a corpus of generated manifests: a small
+// VOD, a multi-language one with 100 representations, a live DVR one with
+// long SegmentTimelines and a SegmentBase one with a large sidx box. They
+// are served from memory with SetLocalDataSource(), so no server is needed
+// and only parsing and sequence operations are timed.
+class ManifestBenchmark {
+ public:
+  struct Result {
+    std::string manifest;
+    bool ok;
+    uint64_t mpd_bytes;
+    uint32_t representations;
+    // DashManifest::ParseMPD() from an URL, in milliseconds.
+    double parse_ms;
+    // GetVideoStreams() and GetAudioStreams() together, in microseconds.
+    double get_streams_us;
+    // Sequence of a representation, created by GetVideoSequence() or
+    // GetAudioSequence(), in microseconds.
+    double create_sequence_us;
+    // The first MediaSegmentForTime() of a sequence, which loads its
+    // segment index when there is one, in milliseconds.
+    double first_lookup_ms;
+    // MediaSegmentForTime() with random times, in nanoseconds.
+    double lookup_ns;
+    // A walk from Begin() to End() of a video sequence, reading timestamps
+    // and durations.
+    uint64_t segments;
+    double walk_ns_per_segment;
+  };
+
+  // Called once per manifest, on the benchmark thread.
+  typedef std::function<void(const Result&)> ResultCallback;
+
+  explicit ManifestBenchmark(const pp::InstanceHandle& instance);
+  ~ManifestBenchmark();
+
+  // Starts a benchmark, unless one is running already.
+  bool Start(const ResultCallback& callback);
+
+  bool IsRunning() const { return running_; }
+
+ private:
+  void RunOnBenchmarkThread(int32_t);
+  Result Run(const std::string& name, const std::string& url);
+
+  pp::CompletionCallbackFactory<ManifestBenchmark> cc_factory_;
+  std::atomic<bool> running_;
+  std::atomic<bool> cancelled_;
+  ResultCallback callback_;
+
+  // Declared last, so it's joined before other members are destroyed.
+  pp::SimpleThread thread_;
+};
+
+#endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_MANIFEST_BENCHMARK_H_
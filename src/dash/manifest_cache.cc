@@ -0,0 +1,105 @@
+/*!
+ * manifest_cache.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include "manifest_cache.h"
+
+#include <cstdio>
+
+#include "common.h"
+
+using pp::AutoLock;
+
+namespace {
+
+constexpr const char* kFilePrefix = "/manifest_";
+constexpr const char* kMagic = "NPMC1";
+// Bigger manifests aren't cached, so a long live presentation doesn't fill
+// the temporary storage.
+constexpr size_t kMaxBodySize = 4 * 1024 * 1024;
+constexpr uint32_t kMaxFieldSize = kMaxBodySize;
+
+bool ReadField(FILE* file, std::string* field) {
+  return ReadStorageField(file, kMaxFieldSize, field);
+}
+
+}  // namespace
+
+ManifestCache& ManifestCache::Get() {
+  static ManifestCache cache;
+  return cache;
+}
+
+ManifestCache::ManifestCache() {}
+
+std::string ManifestCache::PathFor(const std::string& url) const {
+  std::string dir = GetTemporaryStorageDir();
+  if (dir.empty()) return std::string();
+
+  return dir + kFilePrefix + StorageFileName(url);
+}
+
+bool ManifestCache::Lookup(const std::string& url, Entry* entry) {
+  std::string path = PathFor(url);
+  if (path.empty()) return false;
+
+  AutoLock lock(lock_);
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) return false;
+
+  std::string magic;
+  std::string cached_url;
+  Entry cached;
+  bool ok = ReadField(file, &magic) && magic == kMagic &&
+            ReadField(file, &cached_url) && cached_url == url &&
+            ReadField(file, &cached.etag) &&
+            ReadField(file, &cached.last_modified) &&
+            ReadField(file, &cached.body);
+  fclose(file);
+  if (!ok) return false;
+
+  LOG_DEBUG("Found cached manifest of %s", url.c_str());
+  *entry = std::move(cached);
+  return true;
+}
+
+void ManifestCache::Put(const std::string& url, const Entry& entry) {
+  if (entry.etag.empty() && entry.last_modified.empty()) return;
+  if (entry.body.size() > kMaxBodySize) return;
+
+  std::string path = PathFor(url);
+  if (path.empty()) return;
+
+  AutoLock lock(lock_);
+  FILE* file = fopen(path.c_str(), "wb");
+  if (!file) {
+    LOG_ERROR("Can't create manifest cache file %s", path.c_str());
+    return;
+  }
+
+  bool ok = WriteStorageField(file, kMagic) && WriteStorageField(file, url) &&
+            WriteStorageField(file, entry.etag) &&
+            WriteStorageField(file, entry.last_modified) &&
+            WriteStorageField(file, entry.body);
+  if (fclose(file) != 0 || !ok) {
+    LOG_ERROR("Can't write manifest cache file %s", path.c_str());
+    remove(path.c_str());
+  }
+}
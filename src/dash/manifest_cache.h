@@ -0,0 +1,59 @@
+/*!
+ * manifest_cache.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_PLAYER_ES_DASH_PLAYER_DASH_MANIFEST_CACHE_H_
+#define SRC_PLAYER_ES_DASH_PLAYER_DASH_MANIFEST_CACHE_H_
+
+#include <string>
+
+#include "ppapi/utility/threading/lock.h"
+
+// Keeps bodies of recently downloaded manifests together with their HTTP
+// validators (ETag, Last-Modified) in a temporary HTML5 file system, so
+// restarting a recently played title needs only a conditional request, which
+// the server answers with an empty 304 response if the manifest hasn't
+// changed. It's thread safe, but must not be used on the main thread.
+class ManifestCache {
+ public:
+  struct Entry {
+    std::string etag;
+    std::string last_modified;
+    std::string body;
+  };
+
+  static ManifestCache& Get();
+
+  // Returns true and fills entry if a manifest downloaded from url is
+  // cached.
+  bool Lookup(const std::string& url, Entry* entry);
+
+  // Stores a manifest downloaded from url. Entries without validators are
+  // not stored, as they can't be revalidated.
+  void Put(const std::string& url, const Entry& entry);
+
+ private:
+  ManifestCache();
+
+  // Returns an empty string if the storage is not available.
+  std::string PathFor(const std::string& url) const;
+
+  pp::Lock lock_;
+};
+
+#endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_MANIFEST_CACHE_H_
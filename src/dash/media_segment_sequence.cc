@@ -17,20 +17,54 @@
  * @author Adam Bujalski
  */
 
+#define LOG_CATEGORY LogCategory::kDash
+
+#include <cstdio>
+#include <cstdlib>
 #include <sstream>
 
 #include "ppapi/c/pp_errors.h"
+#include "ppapi/utility/threading/lock.h"
 
 #include "dash/media_segment_sequence.h"
 
+#include "allocation_tracker.h"
+#include "base_url_selector.h"
+#include "cpu_profiler.h"
 #include "segment_base_sequence.h"
 #include "segment_list_sequence.h"
 #include "segment_template_sequence.h"
-#include "sequence_iterator.h"
 #include "util.h"
 
+MediaSegmentSequence::MediaSegmentSequence(
+    const std::string& representation_id, const std::string& codecs,
+    uint32_t bandwidth)
+    : representation_id_(representation_id), codecs_(codecs),
+      bandwidth_(bandwidth) {}
+
 MediaSegmentSequence::~MediaSegmentSequence() {}
 
+MediaSegmentSequence::Iterator MediaSegmentSequence::StartSegment() const {
+  return Begin();
+}
+
+bool MediaSegmentSequence::IsDynamic() const {
+  return false;
+}
+
+std::unique_ptr<dash::mpd::ISegment> MediaSegmentSequence::GetInitSegmentFor(
+    const Iterator&) const {
+  return GetInitSegment();
+}
+
+bool MediaSegmentSequence::GetInitSegmentData(std::vector<uint8_t>*) const {
+  return false;
+}
+
+double MediaSegmentSequence::SegmentTimestampOffset(const Iterator&) const {
+  return 0.;
+}
+
 double MediaSegmentSequence::SegmentDuration(const Iterator& it) const {
   return it.SegmentDuration(this);
 }
@@ -39,39 +73,71 @@ double MediaSegmentSequence::SegmentTimestamp(const Iterator& it) const {
   return it.SegmentTimestamp(this);
 }
 
-MediaSegmentSequence::Iterator::Iterator() : pimpl_() {}
+bool MediaSegmentSequence::GetSegmentDescriptor(const Iterator& it,
+    SegmentDescriptor* descriptor) const {
+  if (it.sequence() != this || !descriptor) return false;
 
-MediaSegmentSequence::Iterator::Iterator(
-    std::unique_ptr<SequenceIterator>&& sequence_iterator)
-    : pimpl_(std::move(sequence_iterator)) {}
+  return DescriptorAt(it.position(), descriptor);
+}
 
-MediaSegmentSequence::Iterator::Iterator(
-    const MediaSegmentSequence::Iterator& rhs)
-    : pimpl_(rhs.pimpl_ ? rhs.pimpl_->Clone() : nullptr) {}
+uint64_t MediaSegmentSequence::SegmentSize(const Iterator& it) const {
+  if (it.sequence() != this) return 0;
 
-MediaSegmentSequence::Iterator::~Iterator() {}
+  return SizeAt(it.position());
+}
 
-MediaSegmentSequence::Iterator& MediaSegmentSequence::Iterator::operator=(
-    const MediaSegmentSequence::Iterator& rhs) {
-  if (this == &rhs) return *this;
+std::vector<double> MediaSegmentSequence::SegmentKeyframes(
+    const Iterator& it) const {
+  if (it.sequence() != this) return {};
 
-  if (rhs.pimpl_)
-    pimpl_ = std::move(rhs.pimpl_->Clone());
-  else
-    pimpl_.reset();
+  return KeyframesAt(it.position());
+}
 
-  return *this;
+void MediaSegmentSequence::NextSegment(Position* position) const {
+  ++position->index;
 }
 
-MediaSegmentSequence::Iterator& MediaSegmentSequence::Iterator::operator=(
-    MediaSegmentSequence::Iterator&& other) {
-  pimpl_ = std::move(other.pimpl_);
+void MediaSegmentSequence::PrevSegment(Position* position) const {
+  --position->index;
+}
 
-  return *this;
+bool MediaSegmentSequence::DescriptorAt(const Position& position,
+    SegmentDescriptor* descriptor) const {
+  auto segment = SegmentAt(position);
+  if (!segment) return false;
+
+  *descriptor = DescribeSegment(segment.get());
+  return true;
+}
+
+uint64_t MediaSegmentSequence::SizeAt(const Position& position) const {
+  SegmentDescriptor descriptor;
+  if (!DescriptorAt(position, &descriptor) || descriptor.range.empty())
+    return 0;
+
+  unsigned long long first = 0;
+  unsigned long long last = 0;
+  if (sscanf(descriptor.range.c_str(), "%llu-%llu", &first, &last) != 2 ||
+      last < first)
+    return 0;
+  return last - first + 1;
 }
 
+std::vector<double> MediaSegmentSequence::KeyframesAt(
+    const Position&) const {
+  return {};
+}
+
+MediaSegmentSequence::Iterator::Iterator()
+    : sequence_(nullptr), position_{0, 0, 0} {}
+
+MediaSegmentSequence::Iterator::Iterator(
+    const MediaSegmentSequence* sequence, uint32_t index, uint32_t sub_index,
+    uint32_t period)
+    : sequence_(sequence), position_{index, sub_index, period} {}
+
 MediaSegmentSequence::Iterator& MediaSegmentSequence::Iterator::operator++() {
-  if (pimpl_) pimpl_->NextSegment();
+  if (sequence_) sequence_->NextSegment(&position_);
 
   return *this;
 }
@@ -84,7 +150,7 @@ MediaSegmentSequence::Iterator MediaSegmentSequence::Iterator::operator++(
 }
 
 MediaSegmentSequence::Iterator& MediaSegmentSequence::Iterator::operator--() {
-  if (pimpl_) pimpl_->PrevSegment();
+  if (sequence_) sequence_->PrevSegment(&position_);
 
   return *this;
 }
@@ -98,69 +164,297 @@ MediaSegmentSequence::Iterator MediaSegmentSequence::Iterator::operator--(
 
 bool MediaSegmentSequence::Iterator::operator==(
     const MediaSegmentSequence::Iterator& rhs) const {
-  if (!pimpl_ || !rhs.pimpl_) return false;
+  if (!sequence_ || !rhs.sequence_) return false;
 
-  return pimpl_->Equals(*(rhs.pimpl_));
+  return sequence_ == rhs.sequence_ &&
+      position_.index == rhs.position_.index &&
+      position_.sub_index == rhs.position_.sub_index &&
+      position_.period == rhs.position_.period;
 }
 
 bool MediaSegmentSequence::Iterator::operator!=(
     const MediaSegmentSequence::Iterator& rhs) const {
-  if (!pimpl_ || !rhs.pimpl_) return true;
-
-  return !pimpl_->Equals(*(rhs.pimpl_));
+  return !(*this == rhs);
 }
 
 std::unique_ptr<dash::mpd::ISegment> MediaSegmentSequence::Iterator::operator*()
     const {
-  return pimpl_->Get();
+  if (!sequence_) return {};
+
+  return sequence_->SegmentAt(position_);
 }
 
 double MediaSegmentSequence::Iterator::SegmentDuration(
     const MediaSegmentSequence* ptr) const {
-  if (!pimpl_)
+  if (!sequence_ || sequence_ != ptr)
     return kInvalidSegmentDuration;
-  return pimpl_->SegmentDuration(ptr);
+  return sequence_->DurationAt(position_);
 }
 
 double MediaSegmentSequence::Iterator::SegmentTimestamp(
     const MediaSegmentSequence* ptr) const {
-  if (!pimpl_)
+  if (!sequence_ || sequence_ != ptr)
     return kInvalidSegmentTimestamp;
-  return pimpl_->SegmentTimestamp(ptr);
+  return sequence_->TimestampAt(position_);
 }
 
 
-bool DownloadSegment(dash::mpd::ISegment* seg, std::vector<uint8_t>* data) {
-  if (!seg || !data) return false;
+namespace {
 
-  dash::network::IChunk* chunk = static_cast<dash::network::IChunk*>(seg);
-  // Quick fix for wrongly parsed MPDs
-  // Got url in following form:
-  //    "http://dash.akamaized.net/dash264/TestCasesMCA/dolby/1/1/"
-  //    "http://dash.akamaized.net/dash264/TestCasesMCA/dolby/1/1/"
-  //    "ChID_voices_51_256_ddp_A.mp4"
-  // and thus got 404 error.
-  std::string url = chunk->AbsoluteURI();
-  auto first_match = url.find("://");
-  auto last_match = url.rfind("://");
-  if (first_match != last_match)
-    url.erase(url.begin() + first_match, url.begin() + last_match);
+// Maximum number of base URLs a segment download is tried from.
+constexpr uint32_t kMaxBaseUrlAttempts = 3;
+// Maximum number of times a truncated segment is resumed with a request for
+// its missing tail, before the download is moved to another base URL.
+constexpr uint32_t kMaxResumeAttempts = 2;
+constexpr int32_t kHttpPartialContent = 206;
+
+pp::Lock local_data_source_lock;
+LocalDataSource local_data_source;
+
+pp::URLRequestInfo GetRequestForSegment(const SegmentDescriptor& segment,
+                                        const std::string& url) {
+  bool has_range = !segment.range.empty();
   LOG_INFO("Downloading segment: %s%s%s", url.c_str(),
-           chunk->HasByteRange() ? " Range: " : "",
-           chunk->HasByteRange() ? chunk->Range().c_str() : "");
+           has_range ? " Range: " : "", segment.range.c_str());
 
   auto request = GetRequestForURL(url);
-  if (chunk->HasByteRange()) {
+  if (has_range) {
     std::ostringstream oss;
-    oss << "Range: bytes=" << chunk->Range();
+    oss << "Range: bytes=" << segment.range;
     request.SetProperty(PP_URLREQUESTPROPERTY_HEADERS, oss.str());
   }
+  return request;
+}
+
+// Returns the size of the byte range of a segment, or 0 if it's not known.
+size_t RangeSize(const SegmentDescriptor& segment) {
+  size_t dash = segment.range.find('-');
+  if (dash == std::string::npos || dash + 1 == segment.range.size()) return 0;
+  uint64_t first = std::strtoull(segment.range.c_str(), nullptr, 10);
+  uint64_t last = std::strtoull(segment.range.c_str() + dash + 1, nullptr, 10);
+  return last >= first ? static_cast<size_t>(last - first + 1) : 0;
+}
+
+// Returns a segment without its first received bytes.
+SegmentDescriptor SegmentTail(const SegmentDescriptor& segment,
+                              size_t received) {
+  uint64_t first = 0;
+  std::string last;
+  size_t dash = segment.range.find('-');
+  if (dash != std::string::npos) {
+    first = std::strtoull(segment.range.c_str(), nullptr, 10);
+    last = segment.range.substr(dash + 1);
+  }
+  return SegmentDescriptor{segment.url,
+                           std::to_string(first + received) + "-" + last};
+}
+
+// Downloads a segment from a base URL chosen by BaseUrlSelector. A segment
+// which is shorter than its Content-Length or byte range (e.g. connection
+// dropped mid-body) is resumed with a request for the missing tail. On
+// failure it's retried from other base URLs as long as retry_allowed returns
+// true. download gets a request, which asks for a tail of the segment if
+// resume is true, and returns an error code, received bytes, timing and
+// headers of the response. info can be null.
+bool DownloadFromBestBaseUrl(
+    const SegmentDescriptor& segment,
+    const std::function<int32_t(const pp::URLRequestInfo&, bool resume,
+                                size_t*, URLRequestTiming*,
+                                URLResponseHeaders*)>& download,
+    const std::function<bool()>& retry_allowed, SegmentDownloadInfo* info) {
+  const size_t range_size = RangeSize(segment);
+  BaseUrlSelector& selector = BaseUrlSelector::Get();
+  const std::string& segment_url = segment.url;
+  std::string previous_url;
+  for (uint32_t attempt = 0; attempt < kMaxBaseUrlAttempts; ++attempt) {
+    std::string url = selector.BeginRequest(segment_url);
+    if (url == previous_url) {
+      // No other base URL to try.
+      selector.EndRequest(url, true, 0, 0);
+      break;
+    }
+
+    size_t bytes = 0;
+    URLRequestTiming timing;
+    URLResponseHeaders response;
+    int32_t error_code = download(GetRequestForSegment(segment, url), false,
+                                  &bytes, &timing, &response);
+    for (uint32_t resume = 0; resume <= kMaxResumeAttempts; ++resume) {
+      // Servers which don't announce a size are checked against the range.
+      if (error_code == PP_OK && bytes < range_size) {
+        LOG_ERROR("Segment is truncated, received %zu of %zu bytes", bytes,
+                  range_size);
+        error_code = PP_ERROR_CONNECTION_CLOSED;
+      }
+      if (error_code != PP_ERROR_CONNECTION_CLOSED || bytes == 0 ||
+          resume == kMaxResumeAttempts)
+        break;
+
+      LOG_INFO("Resuming a truncated segment after %zu bytes", bytes);
+      size_t tail_bytes = 0;
+      URLRequestTiming tail_timing;
+      error_code = download(GetRequestForSegment(SegmentTail(segment, bytes),
+                                                 url),
+                            true, &tail_bytes, &tail_timing, &response);
+      bytes += tail_bytes;
+      timing.total_time += tail_timing.total_time;
+    }
+    if (error_code == PP_ERROR_ABORTED) {
+      // Download was stopped by the caller, it says nothing about the server.
+      selector.EndRequest(url, true, 0, 0);
+      return false;
+    }
+    selector.EndRequest(url, error_code == PP_OK, bytes, timing.total_time);
+    if (error_code == PP_OK) {
+      if (info) {
+        info->url = url;
+        info->bytes = bytes;
+        info->time_to_first_byte = timing.time_to_first_byte;
+        info->time_to_first_body_byte = timing.time_to_first_body_byte;
+        info->total_time = timing.total_time;
+        info->response = ParseResponseDiagnostics(response);
+      }
+      return true;
+    }
 
-  int32_t error_code = ProcessURLRequestOnSideThread(request, data);
-  if (error_code != PP_OK) {
     LOG_ERROR("Segment download failed: %d", error_code);
-    return false;
+    if (!retry_allowed()) break;
+    previous_url = url;
   }
 
-  return true;
+  return false;
+}
+
+}  // anonymous namespace
+
+void SetLocalDataSource(const LocalDataSource& source) {
+  pp::AutoLock lock(local_data_source_lock);
+  local_data_source = source;
+}
+
+bool ReadFromLocalDataSource(const SegmentDescriptor& location,
+                             std::vector<uint8_t>* data) {
+  LocalDataSource source;
+  {
+    pp::AutoLock lock(local_data_source_lock);
+    source = local_data_source;
+  }
+  if (source && source(location, data)) return true;
+
+  // Local files, e.g. of a USB storage, are read directly, without URL
+  // loaders and the chunks they deliver.
+  std::string path = LocalFilePath(location.url);
+  if (path.empty()) return false;
+  if (ReadLocalFile(path, location.range, data)) return true;
+  // The URL loader rejects file:// URLs, so the download fails as usual.
+  LOG_ERROR("Can't read a local file: %s%s%s", path.c_str(),
+            location.range.empty() ? "" : " Range: ", location.range.c_str());
+  return false;
+}
+
+bool DownloadSegment(dash::mpd::ISegment* seg, std::vector<uint8_t>* data,
+                     SegmentDownloadInfo* info) {
+  if (!seg) return false;
+
+  return DownloadSegment(DescribeSegment(seg), data, info);
+}
+
+bool DownloadSegment(
+    dash::mpd::ISegment* seg,
+    const std::function<bool(std::vector<uint8_t>&&)>& chunk_callback,
+    SegmentDownloadInfo* info) {
+  if (!seg) return false;
+
+  return DownloadSegment(DescribeSegment(seg), chunk_callback, info);
+}
+
+bool DownloadSegment(const SegmentDescriptor& segment,
+                     std::vector<uint8_t>* data, SegmentDownloadInfo* info,
+                     CancellationToken* token, const TuningProfile* tuning) {
+  if (segment.url.empty() || !data) return false;
+  ALLOCATION_SCOPE("download");
+  CPU_SCOPE(CpuStage::kDownload);
+  AllocationTracker::CountSegment("download");
+  if (ReadFromLocalDataSource(segment, data)) {
+    if (info) {
+      info->url = segment.url;
+      info->bytes = data->size();
+    }
+    return true;
+  }
+
+  return DownloadFromBestBaseUrl(segment,
+      [data, token, tuning](const pp::URLRequestInfo& request, bool resume,
+                            size_t* bytes, URLRequestTiming* timing,
+                            URLResponseHeaders* response) {
+        if (!resume) {
+          data->clear();
+          int32_t error_code = ProcessURLRequestOnSideThread(request, data,
+                                                             timing, token,
+                                                             response,
+                                                             tuning);
+          *bytes = data->size();
+          return error_code;
+        }
+
+        std::vector<uint8_t> tail;
+        int32_t error_code = ProcessURLRequestOnSideThread(request, &tail,
+                                                           timing, token,
+                                                           response, tuning);
+        if (tail.empty()) return error_code;
+        // A full response would repeat the beginning of the segment.
+        if (response->status_code != kHttpPartialContent) {
+          LOG_ERROR("Server doesn't support resuming, status: %d",
+                    response->status_code);
+          return static_cast<int32_t>(PP_ERROR_FAILED);
+        }
+        data->insert(data->end(), tail.begin(), tail.end());
+        *bytes = tail.size();
+        return error_code;
+      },
+      [] { return true; }, info);
+}
+
+bool DownloadSegment(
+    const SegmentDescriptor& segment,
+    const std::function<bool(std::vector<uint8_t>&&)>& chunk_callback,
+    SegmentDownloadInfo* info, CancellationToken* token,
+    const TuningProfile* tuning) {
+  if (segment.url.empty() || !chunk_callback) return false;
+  ALLOCATION_SCOPE("download");
+  CPU_SCOPE(CpuStage::kDownload);
+  AllocationTracker::CountSegment("download");
+  std::vector<uint8_t> local_data;
+  if (ReadFromLocalDataSource(segment, &local_data)) {
+    if (info) {
+      info->url = segment.url;
+      info->bytes = local_data.size();
+    }
+    return chunk_callback(std::move(local_data));
+  }
+
+  // Chunks which were already passed on can't be taken back, so a download
+  // is moved to another base URL only if it failed before the first chunk.
+  size_t total_bytes = 0;
+  return DownloadFromBestBaseUrl(segment,
+      [&chunk_callback, &total_bytes, token, tuning](
+          const pp::URLRequestInfo& request, bool resume, size_t* bytes,
+          URLRequestTiming* timing, URLResponseHeaders* response) {
+        int32_t error_code = ProcessURLRequestOnSideThread(request,
+            [&chunk_callback, bytes, resume, response](
+                std::vector<uint8_t>&& chunk) {
+              // Response headers are known before the first chunk. A full
+              // response would repeat the beginning of the segment.
+              if (resume && response->status_code != kHttpPartialContent) {
+                LOG_ERROR("Server doesn't support resuming, status: %d",
+                          response->status_code);
+                return false;
+              }
+              *bytes += chunk.size();
+              return chunk_callback(std::move(chunk));
+            }, timing, token, response, tuning);
+        total_bytes += *bytes;
+        return error_code;
+      },
+      [&total_bytes] { return total_bytes == 0; }, info);
 }
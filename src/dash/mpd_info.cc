@@ -0,0 +1,179 @@
+/*!
+ * mpd_info.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#include "mpd_info.h"
+
+#include <cstdlib>
+
+namespace {
+
+const char kEssentialPropertyElement[] = "EssentialProperty";
+const char kSupplementalPropertyElement[] = "SupplementalProperty";
+const char kSchemeIdUriAttribute[] = "schemeIdUri";
+const char kValueAttribute[] = "value";
+const char kContentSteeringElement[] = "ContentSteering";
+const char kDefaultServiceLocationAttribute[] = "defaultServiceLocation";
+const char kQueryBeforeStartAttribute[] = "queryBeforeStart";
+const char kServiceDescriptionElement[] = "ServiceDescription";
+const char kLatencyElement[] = "Latency";
+const char kLatencyTargetAttribute[] = "target";
+
+std::vector<MpdBaseUrl> ExtractBaseUrls(
+    const std::vector<dash::mpd::IBaseUrl*>& base_urls) {
+  std::vector<MpdBaseUrl> result;
+  result.reserve(base_urls.size());
+  for (const auto base_url : base_urls)
+    result.push_back({base_url->GetUrl(), base_url->GetServiceLocation()});
+  return result;
+}
+
+// libdash doesn't parse property descriptors, they are kept with unknown
+// elements.
+MpdDescriptor ExtractProperty(const dash::xml::INode* node) {
+  MpdDescriptor descriptor;
+  if (node->HasAttribute(kSchemeIdUriAttribute))
+    descriptor.scheme_id_uri = node->GetAttributeValue(kSchemeIdUriAttribute);
+  if (node->HasAttribute(kValueAttribute))
+    descriptor.value = node->GetAttributeValue(kValueAttribute);
+  return descriptor;
+}
+
+template <typename T>
+void ExtractSegmentInfo(T* element, MpdElementInfo* info) {
+  info->base_urls = ExtractBaseUrls(element->GetBaseURLs());
+  info->segment_base = ExtractSegmentBase(element->GetSegmentBase());
+  info->segment_list = ExtractSegmentList(element->GetSegmentList());
+  info->segment_template =
+      ExtractSegmentTemplate(element->GetSegmentTemplate());
+}
+
+void ExtractRepresentationBase(dash::mpd::IRepresentationBase* element,
+                               MpdElementInfo* info) {
+  info->mime_type = element->GetMimeType();
+  if (!element->GetCodecs().empty()) info->codecs = element->GetCodecs()[0];
+  info->audio_sampling_rate = element->GetAudioSamplingRate();
+  info->frame_rate = element->GetFrameRate();
+  info->width = element->GetWidth();
+  info->height = element->GetHeight();
+  for (const auto descriptor : element->GetAudioChannelConfiguration()) {
+    info->audio_channel_configurations.push_back(
+        {descriptor->GetSchemeIdUri(), descriptor->GetValue()});
+  }
+  for (const auto node : element->GetAdditionalSubNodes()) {
+    if (node->GetName() == kEssentialPropertyElement)
+      info->essential_properties.push_back(ExtractProperty(node));
+    else if (node->GetName() == kSupplementalPropertyElement)
+      info->supplemental_properties.push_back(ExtractProperty(node));
+  }
+  info->content_protection = element->GetContentProtection();
+}
+
+RepresentationInfo ExtractRepresentation(
+    dash::mpd::IRepresentation* representation) {
+  RepresentationInfo info;
+  ExtractSegmentInfo(representation, &info);
+  ExtractRepresentationBase(representation, &info);
+  info.id = representation->GetId();
+  info.bandwidth = representation->GetBandwidth();
+  return info;
+}
+
+AdaptationSetInfo ExtractAdaptationSet(
+    dash::mpd::IAdaptationSet* adaptation_set) {
+  AdaptationSetInfo info;
+  ExtractSegmentInfo(adaptation_set, &info);
+  ExtractRepresentationBase(adaptation_set, &info);
+  // TODO(samsung) handle situation when GetContentComponent provides more
+  // than one IContentComponent
+  if (!adaptation_set->GetContentComponent().empty()) {
+    const auto content_component = adaptation_set->GetContentComponent()[0];
+    info.content_type = content_component->GetContentType();
+    info.lang = content_component->GetLang();
+  } else {
+    info.content_type = adaptation_set->GetContentType();
+    info.lang = adaptation_set->GetLang();
+  }
+  info.representations.reserve(adaptation_set->GetRepresentation().size());
+  for (const auto representation : adaptation_set->GetRepresentation())
+    info.representations.push_back(ExtractRepresentation(representation));
+  return info;
+}
+
+PeriodInfo ExtractPeriod(dash::mpd::IPeriod* period) {
+  PeriodInfo info;
+  ExtractSegmentInfo(period, &info);
+  info.start = period->GetStart();
+  info.duration = period->GetDuration();
+  info.adaptation_sets.reserve(period->GetAdaptationSets().size());
+  for (const auto adaptation_set : period->GetAdaptationSets())
+    info.adaptation_sets.push_back(ExtractAdaptationSet(adaptation_set));
+  return info;
+}
+
+void ExtractAdditionalNodes(dash::mpd::IMPD* mpd, MpdInfo* info) {
+  bool has_content_steering = false;
+  for (const auto node : mpd->GetAdditionalSubNodes()) {
+    if (node->GetName() == kServiceDescriptionElement &&
+        info->target_latency == 0.) {
+      for (const auto latency : node->GetNodes()) {
+        if (latency->GetName() != kLatencyElement ||
+            !latency->HasAttribute(kLatencyTargetAttribute))
+          continue;
+        // In milliseconds.
+        info->target_latency = std::strtod(
+            latency->GetAttributeValue(kLatencyTargetAttribute).c_str(),
+            nullptr) / 1000.;
+        break;
+      }
+    } else if (node->GetName() == kContentSteeringElement &&
+               node->HasText() && !has_content_steering) {
+      has_content_steering = true;
+      ContentSteeringInfo& steering = info->content_steering;
+      steering.server_url = node->GetText();
+      if (node->HasAttribute(kDefaultServiceLocationAttribute)) {
+        steering.default_service_location =
+            node->GetAttributeValue(kDefaultServiceLocationAttribute);
+      }
+      steering.query_before_start =
+          node->HasAttribute(kQueryBeforeStartAttribute) &&
+          node->GetAttributeValue(kQueryBeforeStartAttribute) == "true";
+    }
+  }
+}
+
+}  // namespace
+
+MpdInfo ExtractMpdInfo(dash::mpd::IMPD* mpd) {
+  MpdInfo info;
+  if (mpd->GetMPDPathBaseUrl())
+    info.mpd_path_base_url = mpd->GetMPDPathBaseUrl()->GetUrl();
+  info.base_urls = ExtractBaseUrls(mpd->GetBaseUrls());
+  info.locations = mpd->GetLocations();
+  info.type = mpd->GetType();
+  info.media_presentation_duration = mpd->GetMediaPresentationDuration();
+  info.minimum_update_period = mpd->GetMinimumUpdatePeriod();
+  info.availability_start_time = mpd->GetAvailabilityStarttime();
+  info.time_shift_buffer_depth = mpd->GetTimeShiftBufferDepth();
+  info.suggested_presentation_delay = mpd->GetSuggestedPresentationDelay();
+  ExtractAdditionalNodes(mpd, &info);
+  info.periods.reserve(mpd->GetPeriods().size());
+  for (const auto period : mpd->GetPeriods())
+    info.periods.push_back(ExtractPeriod(period));
+  return info;
+}
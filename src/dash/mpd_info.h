@@ -0,0 +1,119 @@
+/*!
+ * mpd_info.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_PLAYER_ES_DASH_PLAYER_DASH_MPD_INFO_H_
+#define SRC_PLAYER_ES_DASH_PLAYER_DASH_MPD_INFO_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "libdash/libdash.h"
+
+#include "dash/dash_manifest.h"
+
+#include "segment_info.h"
+
+// Elements and attributes of a manifest which the player uses. They are
+// built in a single pass over the document by MpdStreamParser, or copied
+// out of the libdash object tree when a manifest is parsed by libdash.
+// Apart from ContentProtection elements, which are passed as they are to
+// ContentProtectionVisitor, they don't refer to the document.
+
+struct MpdBaseUrl {
+  std::string url;
+  std::string service_location;
+};
+
+// A descriptor element (e.g. EssentialProperty), its children are dropped.
+struct MpdDescriptor {
+  std::string scheme_id_uri;
+  std::string value;
+};
+
+// Elements and attributes shared by Period, AdaptationSet and
+// Representation, ones which an element doesn't have are left empty.
+struct MpdElementInfo {
+  std::vector<MpdBaseUrl> base_urls;
+  std::shared_ptr<const SegmentBaseInfo> segment_base;
+  std::shared_ptr<const SegmentListInfo> segment_list;
+  std::shared_ptr<const SegmentTemplateInfo> segment_template;
+
+  // Common attributes and elements of AdaptationSet and Representation.
+  std::string mime_type;
+  // The first codec of @codecs.
+  std::string codecs;
+  std::string audio_sampling_rate;
+  std::string frame_rate;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<MpdDescriptor> audio_channel_configurations;
+  std::vector<MpdDescriptor> essential_properties;
+  std::vector<MpdDescriptor> supplemental_properties;
+  // Owned by MpdInfo::descriptors, or by the libdash object tree.
+  std::vector<dash::mpd::IDescriptor*> content_protection;
+};
+
+struct RepresentationInfo : MpdElementInfo {
+  std::string id;
+  uint32_t bandwidth = 0;
+};
+
+struct AdaptationSetInfo : MpdElementInfo {
+  // Attributes of the first ContentComponent if there is one, otherwise of
+  // the adaptation set.
+  std::string content_type;
+  std::string lang;
+  std::vector<RepresentationInfo> representations;
+};
+
+struct PeriodInfo : MpdElementInfo {
+  std::string start;
+  std::string duration;
+  std::vector<AdaptationSetInfo> adaptation_sets;
+};
+
+struct MpdInfo {
+  // The location of the manifest, up to its last slash.
+  std::string mpd_path_base_url;
+  std::vector<MpdBaseUrl> base_urls;
+  std::vector<std::string> locations;
+  std::string type;
+  std::string media_presentation_duration;
+  std::string minimum_update_period;
+  std::string availability_start_time;
+  std::string time_shift_buffer_depth;
+  std::string suggested_presentation_delay;
+  // ServiceDescription Latency@target in seconds, 0 if there is none.
+  double target_latency = 0.;
+  // server_url is the ContentSteering text as it's written in the manifest,
+  // it's resolved against base URLs by DashManifest.
+  ContentSteeringInfo content_steering;
+  std::vector<PeriodInfo> periods;
+  // ContentProtection elements built by MpdStreamParser, the libdash object
+  // tree owns them otherwise.
+  std::vector<std::unique_ptr<dash::mpd::IDescriptor>> descriptors;
+};
+
+// Copies elements of a manifest parsed by libdash. mpd must outlive the
+// result, which content_protection descriptors refer to.
+MpdInfo ExtractMpdInfo(dash::mpd::IMPD* mpd);
+
+#endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_MPD_INFO_H_
@@ -0,0 +1,644 @@
+/*!
+ * mpd_stream_parser.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include "mpd_stream_parser.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+#include "common.h"
+
+namespace {
+
+const char kMpdElement[] = "MPD";
+const char kPeriodElement[] = "Period";
+const char kAdaptationSetElement[] = "AdaptationSet";
+const char kRepresentationElement[] = "Representation";
+const char kContentComponentElement[] = "ContentComponent";
+const char kBaseUrlElement[] = "BaseURL";
+const char kLocationElement[] = "Location";
+const char kContentSteeringElement[] = "ContentSteering";
+const char kServiceDescriptionElement[] = "ServiceDescription";
+const char kLatencyElement[] = "Latency";
+const char kSegmentBaseElement[] = "SegmentBase";
+const char kSegmentListElement[] = "SegmentList";
+const char kSegmentTemplateElement[] = "SegmentTemplate";
+const char kInitializationElement[] = "Initialization";
+const char kRepresentationIndexElement[] = "RepresentationIndex";
+const char kSegmentTimelineElement[] = "SegmentTimeline";
+const char kTimelineElement[] = "S";
+const char kSegmentUrlElement[] = "SegmentURL";
+const char kAudioChannelConfigurationElement[] = "AudioChannelConfiguration";
+const char kEssentialPropertyElement[] = "EssentialProperty";
+const char kSupplementalPropertyElement[] = "SupplementalProperty";
+const char kContentProtectionElement[] = "ContentProtection";
+const char kSchemeIdUriAttribute[] = "schemeIdUri";
+const char kValueAttribute[] = "value";
+
+// libdash types of XML nodes, only elements are exposed.
+constexpr int kElementNodeType = 1;
+
+const std::string kEmptyString;
+
+const char* SkipSpaces(const char* p, const char* end) {
+  while (p < end && IsSpace(*p)) ++p;
+  return p;
+}
+
+// Returns the first occurrence of pattern in [p, end), or null.
+const char* Find(const char* p, const char* end, const char* pattern) {
+  const char* found = std::search(p, end, pattern, pattern + strlen(pattern));
+  return found != end ? found : nullptr;
+}
+
+void AppendUtf8(uint32_t code_point, std::string* out) {
+  if (code_point < 0x80) {
+    out->push_back(code_point);
+  } else if (code_point < 0x800) {
+    out->push_back(0xc0 | (code_point >> 6));
+    out->push_back(0x80 | (code_point & 0x3f));
+  } else if (code_point < 0x10000) {
+    out->push_back(0xe0 | (code_point >> 12));
+    out->push_back(0x80 | ((code_point >> 6) & 0x3f));
+    out->push_back(0x80 | (code_point & 0x3f));
+  } else {
+    out->push_back(0xf0 | (code_point >> 18));
+    out->push_back(0x80 | ((code_point >> 12) & 0x3f));
+    out->push_back(0x80 | ((code_point >> 6) & 0x3f));
+    out->push_back(0x80 | (code_point & 0x3f));
+  }
+}
+
+// Replaces entity and character references of [p, end). Unknown entities
+// are kept as they are.
+std::string Decode(const char* p, const char* end) {
+  const char* amp = std::find(p, end, '&');
+  if (amp == end) return std::string(p, end);
+
+  static const struct {
+    const char* name;
+    char value;
+  } kEntities[] = {{"&lt;", '<'}, {"&gt;", '>'}, {"&amp;", '&'},
+                   {"&quot;", '"'}, {"&apos;", '\''}};
+  std::string decoded(p, amp);
+  p = amp;
+  while (p < end) {
+    if (*p != '&') {
+      decoded.push_back(*p++);
+      continue;
+    }
+    const char* semicolon = std::find(p, end, ';');
+    if (semicolon != end && p + 2 < semicolon && p[1] == '#') {
+      bool hex = p[2] == 'x';
+      char* number_end = nullptr;
+      uint32_t code_point = std::strtoul(p + (hex ? 3 : 2), &number_end,
+                                         hex ? 16 : 10);
+      if (number_end == semicolon && code_point > 0 &&
+          code_point <= 0x10ffff) {
+        AppendUtf8(code_point, &decoded);
+        p = semicolon + 1;
+        continue;
+      }
+    }
+    bool replaced = false;
+    for (const auto& entity : kEntities) {
+      if (StartsWith(p, end, entity.name)) {
+        decoded.push_back(entity.value);
+        p += strlen(entity.name);
+        replaced = true;
+        break;
+      }
+    }
+    if (!replaced) decoded.push_back(*p++);
+  }
+  return decoded;
+}
+
+std::string Trim(const std::string& text) {
+  size_t begin = text.find_first_not_of(" \t\r\n");
+  if (begin == std::string::npos) return {};
+  size_t end = text.find_last_not_of(" \t\r\n");
+  return text.substr(begin, end - begin + 1);
+}
+
+// The first codec of a comma separated list.
+std::string FirstCodec(const std::string& codecs) {
+  return Trim(codecs.substr(0, codecs.find(',')));
+}
+
+}  // namespace
+
+class MpdStreamParser::Node : public dash::mpd::IDescriptor,
+                              public dash::xml::INode {
+ public:
+  Node(const std::string& name, const Attributes& attributes)
+      : name_(name), attributes_(attributes.begin(), attributes.end()) {}
+  ~Node() override = default;
+
+  Node* AddChild(std::unique_ptr<Node> child) {
+    nodes_.push_back(child.get());
+    children_.push_back(std::move(child));
+    return children_.back().get();
+  }
+
+  void AppendText(const std::string& text) { text_ += text; }
+
+  const std::string& GetSchemeIdUri() const override {
+    return GetAttributeValue(kSchemeIdUriAttribute);
+  }
+
+  const std::string& GetValue() const override {
+    return GetAttributeValue(kValueAttribute);
+  }
+
+  const std::vector<dash::xml::INode*> GetAdditionalSubNodes()
+      const override {
+    return nodes_;
+  }
+
+  const std::map<std::string, std::string> GetRawAttributes() const override {
+    return attributes_;
+  }
+
+  const std::vector<dash::xml::INode*>& GetNodes() const override {
+    return nodes_;
+  }
+
+  std::vector<std::string> GetAttributeKeys() const override {
+    std::vector<std::string> keys;
+    keys.reserve(attributes_.size());
+    for (const auto& attribute : attributes_) keys.push_back(attribute.first);
+    return keys;
+  }
+
+  const std::string& GetName() const override { return name_; }
+
+  std::string GetText() const override { return text_; }
+
+  const std::map<std::string, std::string>& GetAttributes() const override {
+    return attributes_;
+  }
+
+  int GetType() const override { return kElementNodeType; }
+
+  const std::string& GetAttributeValue(std::string key) const override {
+    auto it = attributes_.find(key);
+    return it != attributes_.end() ? it->second : kEmptyString;
+  }
+
+  bool HasAttribute(const std::string& name) const override {
+    return attributes_.count(name) > 0;
+  }
+
+  bool HasText() const override { return !text_.empty(); }
+
+ private:
+  std::string name_;
+  std::map<std::string, std::string> attributes_;
+  std::string text_;
+  std::vector<std::unique_ptr<Node>> children_;
+  // Children in the form libdash exposes them.
+  std::vector<dash::xml::INode*> nodes_;
+};
+
+namespace {
+
+const std::string& Attribute(
+    const std::vector<std::pair<std::string, std::string>>& attributes,
+    const char* name) {
+  for (const auto& attribute : attributes) {
+    if (attribute.first == name) return attribute.second;
+  }
+  return kEmptyString;
+}
+
+// Attributes of unsigned types, default_value is used when it's missing.
+uint64_t UnsignedAttribute(
+    const std::vector<std::pair<std::string, std::string>>& attributes,
+    const char* name, uint64_t default_value) {
+  const std::string& value = Attribute(attributes, name);
+  if (value.empty()) return default_value;
+  return std::strtoull(value.c_str(), nullptr, 10);
+}
+
+MpdDescriptor ReadDescriptor(
+    const std::vector<std::pair<std::string, std::string>>& attributes) {
+  return {Attribute(attributes, kSchemeIdUriAttribute),
+          Attribute(attributes, kValueAttribute)};
+}
+
+// Reads attributes which AdaptationSet and Representation share.
+void ReadRepresentationBase(
+    const std::vector<std::pair<std::string, std::string>>& attributes,
+    MpdElementInfo* info) {
+  info->mime_type = Attribute(attributes, "mimeType");
+  info->codecs = FirstCodec(Attribute(attributes, "codecs"));
+  info->audio_sampling_rate = Attribute(attributes, "audioSamplingRate");
+  info->frame_rate = Attribute(attributes, "frameRate");
+  info->width = UnsignedAttribute(attributes, "width", 0);
+  info->height = UnsignedAttribute(attributes, "height", 0);
+}
+
+}  // namespace
+
+bool MpdStreamParser::Parse(const std::string& url, const std::string& data,
+                            MpdInfo* mpd) {
+  *mpd = MpdInfo();
+  mpd->mpd_path_base_url = url.substr(0, url.find_last_of('/') + 1);
+
+  MpdStreamParser parser(mpd);
+  if (!parser.Read(data.data(), data.data() + data.size())) {
+    *mpd = MpdInfo();
+    return false;
+  }
+  return true;
+}
+
+MpdStreamParser::MpdStreamParser(MpdInfo* mpd)
+    : mpd_(mpd),
+      has_root_(false),
+      period_(nullptr),
+      adaptation_set_(nullptr),
+      representation_(nullptr),
+      has_content_component_(false),
+      segment_info_(nullptr),
+      multiple_segment_info_(nullptr),
+      capture_text_(false) {}
+
+MpdStreamParser::~MpdStreamParser() {}
+
+bool MpdStreamParser::Read(const char* p, const char* end) {
+  // UTF-8 byte order mark. Other encodings are left to libdash.
+  if (StartsWith(p, end, "\xef\xbb\xbf")) p += 3;
+
+  std::string name;
+  Attributes attributes;
+  while (p < end) {
+    if (*p != '<') {
+      const char* text_end = std::find(p, end, '<');
+      if (capture_text_ || !nodes_.empty()) OnText(Decode(p, text_end));
+      p = text_end;
+      continue;
+    }
+
+    if (StartsWith(p, end, "<!--")) {
+      p = Find(p + 4, end, "-->");
+      if (!p) return false;
+      p += 3;
+    } else if (StartsWith(p, end, "<![CDATA[")) {
+      const char* cdata_end = Find(p + 9, end, "]]>");
+      if (!cdata_end) return false;
+      OnText(std::string(p + 9, cdata_end));
+      p = cdata_end + 3;
+    } else if (StartsWith(p, end, "<?")) {
+      p = Find(p + 2, end, "?>");
+      if (!p) return false;
+      p += 2;
+    } else if (StartsWith(p, end, "<!")) {
+      // Entities of an internal subset would change the document.
+      const char* tag_end = std::find(p, end, '>');
+      if (tag_end == end || std::find(p, tag_end, '[') != tag_end) {
+        LOG_DEBUG("DOCTYPE with an internal subset");
+        return false;
+      }
+      p = tag_end + 1;
+    } else if (StartsWith(p, end, "</")) {
+      const char* tag_end = std::find(p, end, '>');
+      if (tag_end == end) return false;
+      const char* name_end = p + 2;
+      while (name_end < tag_end && !IsSpace(*name_end)) ++name_end;
+      name.assign(p + 2, name_end);
+      if (SkipSpaces(name_end, tag_end) != tag_end || !OnEndElement(name))
+        return false;
+      p = tag_end + 1;
+    } else {
+      const char* name_begin = ++p;
+      while (p < end && !IsSpace(*p) && *p != '>' && *p != '/') ++p;
+      name.assign(name_begin, p);
+      if (name.empty()) return false;
+
+      attributes.clear();
+      bool empty_element = false;
+      for (;;) {
+        p = SkipSpaces(p, end);
+        if (p == end) return false;
+        if (*p == '>') {
+          ++p;
+          break;
+        }
+        if (*p == '/') {
+          if (p + 1 == end || p[1] != '>') return false;
+          p += 2;
+          empty_element = true;
+          break;
+        }
+        const char* attribute_begin = p;
+        while (p < end && *p != '=' && !IsSpace(*p) && *p != '>' &&
+               *p != '/')
+          ++p;
+        std::string attribute_name(attribute_begin, p);
+        p = SkipSpaces(p, end);
+        if (attribute_name.empty() || p == end || *p != '=') return false;
+        p = SkipSpaces(p + 1, end);
+        if (p == end || (*p != '"' && *p != '\'')) return false;
+        const char* value_end = std::find(p + 1, end, *p);
+        if (value_end == end) return false;
+        attributes.emplace_back(std::move(attribute_name),
+                                Decode(p + 1, value_end));
+        p = value_end + 1;
+      }
+
+      if (!OnStartElement(name, attributes)) return false;
+      if (empty_element && !OnEndElement(name)) return false;
+    }
+  }
+
+  if (!has_root_ || !open_elements_.empty()) {
+    LOG_DEBUG("No complete MPD element in the document");
+    return false;
+  }
+  return true;
+}
+
+bool MpdStreamParser::OnStartElement(const std::string& name,
+                                     const Attributes& attributes) {
+  if (open_elements_.empty()) {
+    // The document has a single root element.
+    if (has_root_ || name != kMpdElement) return false;
+    has_root_ = true;
+    open_elements_.push_back(name);
+    mpd_->type = Attribute(attributes, "type");
+    mpd_->media_presentation_duration =
+        Attribute(attributes, "mediaPresentationDuration");
+    mpd_->minimum_update_period =
+        Attribute(attributes, "minimumUpdatePeriod");
+    mpd_->availability_start_time =
+        Attribute(attributes, "availabilityStartTime");
+    mpd_->time_shift_buffer_depth =
+        Attribute(attributes, "timeShiftBufferDepth");
+    mpd_->suggested_presentation_delay =
+        Attribute(attributes, "suggestedPresentationDelay");
+    return true;
+  }
+
+  if (!nodes_.empty()) {
+    nodes_.push_back(
+        nodes_.back()->AddChild(MakeUnique<Node>(name, attributes)));
+    open_elements_.push_back(name);
+    return true;
+  }
+
+  const std::string& parent = open_elements_.back();
+
+  bool in_element = parent == kPeriodElement ||
+                    parent == kAdaptationSetElement ||
+                    parent == kRepresentationElement;
+  bool in_representation_base = parent == kAdaptationSetElement ||
+                                parent == kRepresentationElement;
+  bool in_segment_info = parent == kSegmentBaseElement ||
+                         parent == kSegmentListElement ||
+                         parent == kSegmentTemplateElement;
+
+  if (name == kBaseUrlElement && (parent == kMpdElement || in_element)) {
+    capture_text_ = true;
+    text_.clear();
+    service_location_ = Attribute(attributes, "serviceLocation");
+  } else if (parent == kMpdElement && (name == kLocationElement ||
+                                       name == kContentSteeringElement)) {
+    capture_text_ = true;
+    text_.clear();
+    if (name == kContentSteeringElement &&
+        mpd_->content_steering.server_url.empty()) {
+      mpd_->content_steering.default_service_location =
+          Attribute(attributes, "defaultServiceLocation");
+      mpd_->content_steering.query_before_start =
+          Attribute(attributes, "queryBeforeStart") == "true";
+    }
+  } else if (parent == kServiceDescriptionElement &&
+             name == kLatencyElement) {
+    const std::string& target = Attribute(attributes, "target");
+    // In milliseconds.
+    if (!target.empty() && mpd_->target_latency == 0.)
+      mpd_->target_latency = std::strtod(target.c_str(), nullptr) / 1000.;
+  } else if (parent == kMpdElement && name == kPeriodElement) {
+    StartPeriod(attributes);
+  } else if (parent == kPeriodElement && name == kAdaptationSetElement) {
+    StartAdaptationSet(attributes);
+  } else if (parent == kAdaptationSetElement &&
+             name == kRepresentationElement) {
+    StartRepresentation(attributes);
+  } else if (parent == kAdaptationSetElement &&
+             name == kContentComponentElement) {
+    if (!has_content_component_) {
+      has_content_component_ = true;
+      adaptation_set_->content_type = Attribute(attributes, "contentType");
+      adaptation_set_->lang = Attribute(attributes, "lang");
+    }
+  } else if (in_element && (name == kSegmentBaseElement ||
+                            name == kSegmentListElement ||
+                            name == kSegmentTemplateElement)) {
+    StartSegmentInfo(name, attributes);
+  } else if (in_segment_info && segment_info_ &&
+             (name == kInitializationElement ||
+              name == kRepresentationIndexElement)) {
+    SegmentUrlInfo& url = name == kInitializationElement
+        ? segment_info_->initialization
+        : segment_info_->representation_index;
+    url = {Attribute(attributes, "sourceURL"), Attribute(attributes, "range")};
+  } else if (in_segment_info && multiple_segment_info_ &&
+             name == kSegmentTimelineElement) {
+    multiple_segment_info_->has_timeline = true;
+  } else if (parent == kSegmentTimelineElement && multiple_segment_info_ &&
+             name == kTimelineElement) {
+    // @r is read like libdash does, -1 becomes the largest repeat count.
+    multiple_segment_info_->timeline.push_back(
+        {UnsignedAttribute(attributes, "t", 0),
+         UnsignedAttribute(attributes, "d", 0),
+         static_cast<uint32_t>(
+             std::strtoul(Attribute(attributes, "r").c_str(), nullptr, 10))});
+  } else if (parent == kSegmentListElement && segment_list_ &&
+             name == kSegmentUrlElement) {
+    segment_list_->segment_urls.push_back(
+        {Attribute(attributes, "media"), Attribute(attributes, "mediaRange")});
+  } else if (in_representation_base &&
+             name == kAudioChannelConfigurationElement) {
+    CurrentElement()->audio_channel_configurations.push_back(
+        ReadDescriptor(attributes));
+  } else if (in_representation_base && name == kEssentialPropertyElement) {
+    CurrentElement()->essential_properties.push_back(
+        ReadDescriptor(attributes));
+  } else if (in_representation_base &&
+             name == kSupplementalPropertyElement) {
+    CurrentElement()->supplemental_properties.push_back(
+        ReadDescriptor(attributes));
+  } else if (in_representation_base && name == kContentProtectionElement) {
+    StartContentProtection(name, attributes);
+  }
+  // Invalidates parent.
+  open_elements_.push_back(name);
+  return true;
+}
+
+bool MpdStreamParser::OnEndElement(const std::string& name) {
+  if (open_elements_.empty() || open_elements_.back() != name) {
+    LOG_DEBUG("Unexpected end tag of %s", name.c_str());
+    return false;
+  }
+  open_elements_.pop_back();
+
+  if (!nodes_.empty()) {
+    nodes_.pop_back();
+    return true;
+  }
+
+  if (capture_text_) {
+    capture_text_ = false;
+    if (name == kBaseUrlElement) {
+      MpdBaseUrl base_url{Trim(text_), service_location_};
+      MpdElementInfo* element = CurrentElement();
+      if (element)
+        element->base_urls.push_back(std::move(base_url));
+      else
+        mpd_->base_urls.push_back(std::move(base_url));
+    } else if (name == kLocationElement) {
+      mpd_->locations.push_back(Trim(text_));
+    } else if (name == kContentSteeringElement &&
+               mpd_->content_steering.server_url.empty()) {
+      mpd_->content_steering.server_url = text_;
+    }
+    return true;
+  }
+
+  if (name == kPeriodElement && period_) {
+    period_ = nullptr;
+  } else if (name == kAdaptationSetElement && adaptation_set_) {
+    adaptation_set_ = nullptr;
+  } else if (name == kRepresentationElement && representation_) {
+    representation_ = nullptr;
+  } else if (name == kSegmentBaseElement || name == kSegmentListElement ||
+             name == kSegmentTemplateElement) {
+    EndSegmentInfo(name);
+  }
+  return true;
+}
+
+void MpdStreamParser::OnText(const std::string& text) {
+  if (!nodes_.empty())
+    nodes_.back()->AppendText(text);
+  else if (capture_text_)
+    text_ += text;
+}
+
+void MpdStreamParser::StartPeriod(const Attributes& attributes) {
+  mpd_->periods.emplace_back();
+  period_ = &mpd_->periods.back();
+  period_->start = Attribute(attributes, "start");
+  period_->duration = Attribute(attributes, "duration");
+}
+
+void MpdStreamParser::StartAdaptationSet(const Attributes& attributes) {
+  period_->adaptation_sets.emplace_back();
+  adaptation_set_ = &period_->adaptation_sets.back();
+  has_content_component_ = false;
+  ReadRepresentationBase(attributes, adaptation_set_);
+  adaptation_set_->content_type = Attribute(attributes, "contentType");
+  adaptation_set_->lang = Attribute(attributes, "lang");
+}
+
+void MpdStreamParser::StartRepresentation(const Attributes& attributes) {
+  adaptation_set_->representations.emplace_back();
+  representation_ = &adaptation_set_->representations.back();
+  ReadRepresentationBase(attributes, representation_);
+  representation_->id = Attribute(attributes, "id");
+  representation_->bandwidth = UnsignedAttribute(attributes, "bandwidth", 0);
+}
+
+void MpdStreamParser::StartSegmentInfo(const std::string& name,
+                                       const Attributes& attributes) {
+  if (name == kSegmentBaseElement) {
+    segment_base_ = std::make_shared<SegmentBaseInfo>();
+    segment_info_ = segment_base_.get();
+    multiple_segment_info_ = nullptr;
+  } else if (name == kSegmentListElement) {
+    segment_list_ = std::make_shared<SegmentListInfo>();
+    segment_info_ = multiple_segment_info_ = segment_list_.get();
+  } else {
+    segment_template_ = std::make_shared<SegmentTemplateInfo>();
+    segment_template_->media = Attribute(attributes, "media");
+    segment_template_->initialization_template =
+        Attribute(attributes, "initialization");
+    segment_template_->bitstream_switching_template =
+        Attribute(attributes, "bitstreamSwitching");
+    segment_info_ = multiple_segment_info_ = segment_template_.get();
+  }
+
+  // Defaults are the same as libdash ones.
+  segment_info_->timescale = UnsignedAttribute(attributes, "timescale", 1);
+  segment_info_->presentation_time_offset =
+      UnsignedAttribute(attributes, "presentationTimeOffset", 0);
+  segment_info_->index_range = Attribute(attributes, "indexRange");
+  const std::string& offset = Attribute(attributes, "availabilityTimeOffset");
+  // "INF" (all segments are available) is parsed as infinity.
+  segment_info_->availability_time_offset = !offset.empty()
+      ? std::max(std::strtod(offset.c_str(), nullptr), 0.) : 0.;
+  if (multiple_segment_info_) {
+    multiple_segment_info_->duration =
+        UnsignedAttribute(attributes, "duration", 0);
+    multiple_segment_info_->start_number =
+        UnsignedAttribute(attributes, "startNumber", 1);
+    multiple_segment_info_->has_timeline = false;
+  }
+}
+
+void MpdStreamParser::EndSegmentInfo(const std::string& name) {
+  MpdElementInfo* element = CurrentElement();
+  if (!element) return;
+
+  if (name == kSegmentBaseElement && segment_base_)
+    element->segment_base = std::move(segment_base_);
+  else if (name == kSegmentListElement && segment_list_)
+    element->segment_list = std::move(segment_list_);
+  else if (name == kSegmentTemplateElement && segment_template_)
+    element->segment_template = std::move(segment_template_);
+  else
+    return;
+  segment_base_.reset();
+  segment_list_.reset();
+  segment_template_.reset();
+  segment_info_ = nullptr;
+  multiple_segment_info_ = nullptr;
+}
+
+void MpdStreamParser::StartContentProtection(const std::string& name,
+                                             const Attributes& attributes) {
+  auto node = MakeUnique<Node>(name, attributes);
+  nodes_.push_back(node.get());
+  CurrentElement()->content_protection.push_back(node.get());
+  mpd_->descriptors.push_back(std::move(node));
+}
+
+MpdElementInfo* MpdStreamParser::CurrentElement() {
+  if (representation_) return representation_;
+  if (adaptation_set_) return adaptation_set_;
+  return period_;
+}
@@ -0,0 +1,109 @@
+/*!
+ * mpd_stream_parser.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_PLAYER_ES_DASH_PLAYER_DASH_MPD_STREAM_PARSER_H_
+#define SRC_PLAYER_ES_DASH_PLAYER_DASH_MPD_STREAM_PARSER_H_
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mpd_info.h"
+
+// Builds MpdInfo of a manifest in a single pass over the document. Unlike
+// libdash, which builds a DOM of the document and then an object tree of
+// all its elements, it handles tags as they are read (like a SAX parser):
+// elements the player uses are copied into MpdInfo and everything else is
+// skipped. Only ContentProtection elements are kept with their children,
+// as they are passed to ContentProtectionVisitor.
+//
+// The parser is not validating. It handles the subset of XML which
+// manifests use: elements, attributes, character and entity references,
+// CDATA sections, comments, processing instructions and DOCTYPE without an
+// internal subset. Namespace prefixes are kept in names, like libdash
+// does.
+class MpdStreamParser {
+ public:
+  // url is the location of the manifest. Returns false if the document is
+  // not a well-formed MPD, or it uses XML the parser doesn't handle, so it
+  // should be parsed by libdash.
+  static bool Parse(const std::string& url, const std::string& data,
+                    MpdInfo* mpd);
+
+ private:
+  // Attributes of a start tag in document order, values are decoded.
+  typedef std::vector<std::pair<std::string, std::string>> Attributes;
+  // An element of a ContentProtection subtree.
+  class Node;
+
+  explicit MpdStreamParser(MpdInfo* mpd);
+  ~MpdStreamParser();
+
+  // Reads the document, calling handlers below for its tags and text.
+  bool Read(const char* data, const char* end);
+
+  // Return false if the document is malformed.
+  bool OnStartElement(const std::string& name, const Attributes& attributes);
+  bool OnEndElement(const std::string& name);
+  void OnText(const std::string& text);
+
+  void StartPeriod(const Attributes& attributes);
+  void StartAdaptationSet(const Attributes& attributes);
+  void StartRepresentation(const Attributes& attributes);
+  void StartSegmentInfo(const std::string& name, const Attributes& attributes);
+  void StartContentProtection(const std::string& name,
+                              const Attributes& attributes);
+  // Moves the segment information element which ends to its parent.
+  void EndSegmentInfo(const std::string& name);
+
+  // The innermost open Representation, AdaptationSet or Period, null
+  // outside of periods.
+  MpdElementInfo* CurrentElement();
+
+  MpdInfo* mpd_;
+  // Names of open elements, the innermost one last.
+  std::vector<std::string> open_elements_;
+  bool has_root_;
+  PeriodInfo* period_;
+  AdaptationSetInfo* adaptation_set_;
+  RepresentationInfo* representation_;
+  // Set once the first ContentComponent of the adaptation set is read.
+  bool has_content_component_;
+
+  // An open SegmentBase, SegmentList or SegmentTemplate element, only one
+  // of them is set. segment_info_ and multiple_segment_info_ point to the
+  // common part of it.
+  std::shared_ptr<SegmentBaseInfo> segment_base_;
+  std::shared_ptr<SegmentListInfo> segment_list_;
+  std::shared_ptr<SegmentTemplateInfo> segment_template_;
+  SegmentBaseInfo* segment_info_;
+  MultipleSegmentBaseInfo* multiple_segment_info_;
+
+  // Text of an open BaseURL, Location or ContentSteering element.
+  bool capture_text_;
+  std::string text_;
+  std::string service_location_;
+
+  // An open ContentProtection element and its open descendants, they are
+  // owned by mpd_.
+  std::vector<Node*> nodes_;
+};
+
+#endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_MPD_STREAM_PARSER_H_
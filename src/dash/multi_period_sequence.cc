@@ -0,0 +1,241 @@
+/*!
+ * multi_period_sequence.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#include "multi_period_sequence.h"
+
+#include <algorithm>
+
+#include "util.h"
+
+MultiPeriodSequence::MultiPeriodSequence(const std::string& representation_id,
+                                         const std::string& codecs,
+                                         uint32_t bandwidth)
+    : MediaSegmentSequence(representation_id, codecs, bandwidth),
+      periods_() {}
+
+MultiPeriodSequence::~MultiPeriodSequence() {}
+
+void MultiPeriodSequence::AddPeriod(
+    std::unique_ptr<MediaSegmentSequence> sequence,
+    const RepresentationDescription& desc) {
+  if (!sequence) return;
+
+  Period period;
+  period.sequence = std::move(sequence);
+  period.start = desc.period_start;
+  period.media_offset = desc.period_start - PresentationTimeOffset(desc);
+  // Segments of SegmentTemplate@duration are timestamped from the beginning
+  // of the period, other sequences report media times.
+  bool period_relative = desc.segment_template &&
+      !desc.segment_template->has_timeline;
+  period.timestamp_offset =
+      period_relative ? desc.period_start : period.media_offset;
+  periods_.push_back(std::move(period));
+}
+
+MediaSegmentSequence::Iterator MultiPeriodSequence::Begin() const {
+  if (periods_.empty()) return Iterator(this, 0);
+
+  return MakeIterator(0, periods_[0].sequence->Begin());
+}
+
+MediaSegmentSequence::Iterator MultiPeriodSequence::End() const {
+  if (periods_.empty()) return Iterator(this, 0);
+
+  size_t last = periods_.size() - 1;
+  return MakeIterator(last, periods_[last].sequence->End());
+}
+
+MediaSegmentSequence::Iterator MultiPeriodSequence::MediaSegmentForTime(
+    double time) const {
+  if (periods_.empty()) return End();
+
+  size_t index = PeriodForTime(time);
+  const Period& period = periods_[index];
+  auto it = period.sequence->MediaSegmentForTime(
+      time - period.timestamp_offset);
+  if (it != period.sequence->End()) return MakeIterator(index, it);
+
+  // Time is past the last segment of a period, which is shorter than
+  // announced.
+  if (index + 1 < periods_.size())
+    return MakeIterator(index + 1, periods_[index + 1].sequence->Begin());
+  return End();
+}
+
+std::unique_ptr<dash::mpd::ISegment> MultiPeriodSequence::GetInitSegment()
+    const {
+  if (periods_.empty()) return {};
+
+  return periods_[0].sequence->GetInitSegment();
+}
+
+std::unique_ptr<dash::mpd::ISegment> MultiPeriodSequence::GetInitSegmentFor(
+    const Iterator& it) const {
+  if (periods_.empty()) return {};
+
+  return periods_[PeriodOf(it)].sequence->GetInitSegment();
+}
+
+bool MultiPeriodSequence::GetInitSegmentData(
+    std::vector<uint8_t>* data) const {
+  if (periods_.empty()) return false;
+
+  return periods_[0].sequence->GetInitSegmentData(data);
+}
+
+std::unique_ptr<dash::mpd::ISegment>
+MultiPeriodSequence::GetBitstreamSwitchingSegment() const {
+  if (periods_.empty()) return {};
+
+  return periods_[0].sequence->GetBitstreamSwitchingSegment();
+}
+
+std::unique_ptr<dash::mpd::ISegment>
+MultiPeriodSequence::GetRepresentationIndexSegment() const {
+  if (periods_.empty()) return {};
+
+  return periods_[0].sequence->GetRepresentationIndexSegment();
+}
+
+std::unique_ptr<dash::mpd::ISegment> MultiPeriodSequence::GetIndexSegment()
+    const {
+  if (periods_.empty()) return {};
+
+  return periods_[0].sequence->GetIndexSegment();
+}
+
+double MultiPeriodSequence::AverageSegmentDuration() const {
+  if (periods_.empty()) return kInvalidSegmentDuration;
+
+  return periods_[0].sequence->AverageSegmentDuration();
+}
+
+double MultiPeriodSequence::SegmentTimestampOffset(const Iterator& it) const {
+  if (periods_.empty()) return 0.;
+
+  return periods_[PeriodOf(it)].media_offset;
+}
+
+size_t MultiPeriodSequence::PeriodForTime(double time) const {
+  size_t index = 0;
+  for (size_t i = 1; i < periods_.size(); ++i) {
+    if (periods_[i].start <= time + kEps) index = i;
+  }
+  return index;
+}
+
+size_t MultiPeriodSequence::PeriodOf(const Iterator& it) const {
+  if (it.sequence() != this) return periods_.size() - 1;
+
+  return std::min<size_t>(it.position().period, periods_.size() - 1);
+}
+
+MediaSegmentSequence::Iterator MultiPeriodSequence::PeriodIterator(
+    const Position& position) const {
+  return Iterator(periods_[position.period].sequence.get(), position.index,
+                  position.sub_index);
+}
+
+MediaSegmentSequence::Iterator MultiPeriodSequence::MakeIterator(
+    size_t period, Iterator period_iterator) const {
+  while (period + 1 < periods_.size() &&
+         period_iterator == periods_[period].sequence->End()) {
+    ++period;
+    period_iterator = periods_[period].sequence->Begin();
+  }
+  const Position& position = period_iterator.position();
+  return Iterator(this, position.index, position.sub_index, period);
+}
+
+void MultiPeriodSequence::NextSegment(Position* position) const {
+  if (position->period >= periods_.size()) return;
+
+  auto period_iterator = PeriodIterator(*position);
+  *position = MakeIterator(position->period, ++period_iterator).position();
+}
+
+void MultiPeriodSequence::PrevSegment(Position* position) const {
+  if (position->period >= periods_.size()) return;
+
+  size_t period = position->period;
+  auto period_iterator = PeriodIterator(*position);
+  while (period > 0 && period_iterator == periods_[period].sequence->Begin()) {
+    --period;
+    period_iterator = periods_[period].sequence->End();
+  }
+  --period_iterator;
+  const Position& period_position = period_iterator.position();
+  *position = {period_position.index, period_position.sub_index,
+               static_cast<uint32_t>(period)};
+}
+
+std::unique_ptr<dash::mpd::ISegment> MultiPeriodSequence::SegmentAt(
+    const Position& position) const {
+  if (position.period >= periods_.size()) return {};
+
+  return *PeriodIterator(position);
+}
+
+bool MultiPeriodSequence::DescriptorAt(const Position& position,
+    SegmentDescriptor* descriptor) const {
+  if (position.period >= periods_.size()) return false;
+
+  const auto& sequence = periods_[position.period].sequence;
+  return sequence->GetSegmentDescriptor(PeriodIterator(position), descriptor);
+}
+
+uint64_t MultiPeriodSequence::SizeAt(const Position& position) const {
+  if (position.period >= periods_.size()) return 0;
+
+  const auto& sequence = periods_[position.period].sequence;
+  return sequence->SegmentSize(PeriodIterator(position));
+}
+
+std::vector<double> MultiPeriodSequence::KeyframesAt(
+    const Position& position) const {
+  if (position.period >= periods_.size()) return {};
+
+  const Period& period = periods_[position.period];
+  std::vector<double> keyframes =
+      period.sequence->SegmentKeyframes(PeriodIterator(position));
+  for (auto& keyframe : keyframes)
+    keyframe += period.timestamp_offset;
+  return keyframes;
+}
+
+double MultiPeriodSequence::DurationAt(const Position& position) const {
+  if (position.period >= periods_.size())
+    return MediaSegmentSequence::kInvalidSegmentDuration;
+
+  const auto& sequence = periods_[position.period].sequence;
+  return sequence->SegmentDuration(PeriodIterator(position));
+}
+
+double MultiPeriodSequence::TimestampAt(const Position& position) const {
+  if (position.period >= periods_.size())
+    return MediaSegmentSequence::kInvalidSegmentTimestamp;
+
+  const Period& period = periods_[position.period];
+  double timestamp = period.sequence->SegmentTimestamp(
+      PeriodIterator(position));
+  if (timestamp < 0.) return MediaSegmentSequence::kInvalidSegmentTimestamp;
+
+  return timestamp + period.timestamp_offset;
+}
@@ -0,0 +1,106 @@
+/*!
+ * multi_period_sequence.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_PLAYER_ES_DASH_PLAYER_DASH_MULTI_PERIOD_SEQUENCE_H_
+#define SRC_PLAYER_ES_DASH_PLAYER_DASH_MULTI_PERIOD_SEQUENCE_H_
+
+#include "dash/media_segment_sequence.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+struct RepresentationDescription;
+
+// Joins sequences of representations of consecutive periods into a single
+// one. Segment timestamps are presentation times, while media timestamps in
+// each period can start anew, see SegmentTimestampOffset().
+//
+// Position::period is an index of the period, other fields hold a position
+// in its sequence.
+class MultiPeriodSequence : public MediaSegmentSequence {
+ public:
+  MultiPeriodSequence(const std::string& representation_id,
+                      const std::string& codecs, uint32_t bandwidth);
+  virtual ~MultiPeriodSequence();
+
+  // Periods must be added in presentation order.
+  void AddPeriod(std::unique_ptr<MediaSegmentSequence> sequence,
+                 const RepresentationDescription& desc);
+
+  Iterator Begin() const override;
+  Iterator End() const override;
+
+  Iterator MediaSegmentForTime(double time) const override;
+
+  // Init segment of the first period.
+  std::unique_ptr<dash::mpd::ISegment> GetInitSegment() const override;
+  std::unique_ptr<dash::mpd::ISegment> GetInitSegmentFor(
+      const Iterator& it) const override;
+  bool GetInitSegmentData(std::vector<uint8_t>* data) const override;
+
+  std::unique_ptr<dash::mpd::ISegment> GetBitstreamSwitchingSegment()
+      const override;
+
+  std::unique_ptr<dash::mpd::ISegment> GetRepresentationIndexSegment()
+      const override;
+
+  std::unique_ptr<dash::mpd::ISegment> GetIndexSegment() const override;
+
+  double AverageSegmentDuration() const override;
+
+  double SegmentTimestampOffset(const Iterator& it) const override;
+
+ protected:
+  void NextSegment(Position* position) const override;
+  void PrevSegment(Position* position) const override;
+  std::unique_ptr<dash::mpd::ISegment> SegmentAt(
+      const Position& position) const override;
+  bool DescriptorAt(const Position& position,
+                    SegmentDescriptor* descriptor) const override;
+  uint64_t SizeAt(const Position& position) const override;
+  std::vector<double> KeyframesAt(const Position& position) const override;
+  double DurationAt(const Position& position) const override;
+  double TimestampAt(const Position& position) const override;
+
+ private:
+  struct Period {
+    std::unique_ptr<MediaSegmentSequence> sequence;
+    double start;
+    // Added to media timestamps of the period to get presentation times.
+    double media_offset;
+    // Added to timestamps reported by the sequence, which are media times or
+    // times since the beginning of the period.
+    double timestamp_offset;
+  };
+
+  // Returns index of the last period which starts before time.
+  size_t PeriodForTime(double time) const;
+  // Returns index of the period the segment belongs to.
+  size_t PeriodOf(const Iterator& it) const;
+  // Returns an iterator of the sequence of the period at position.
+  Iterator PeriodIterator(const Position& position) const;
+  // Returns an iterator pointing at period_iterator of the period. Past the
+  // end iterator of a period is moved to the beginning of the next one.
+  Iterator MakeIterator(size_t period, Iterator period_iterator) const;
+
+  std::vector<Period> periods_;
+};
+
+#endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_MULTI_PERIOD_SEQUENCE_H_
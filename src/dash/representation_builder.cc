@@ -19,38 +19,100 @@
 
 #include "representation_builder.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
 #include <vector>
 #include <string>
+#include <utility>
 
 #include "dash/content_protection_visitor.h"
 #include "dash/dash_manifest.h"
 
 const char kAudioTypeString[] = "audio/";
 const char kVideoTypeString[] = "video/";
+const char kTextTypeString[] = "text/";
+const char kTextContentType[] = "text";
+const char kImageTypeString[] = "image/";
+const char kImageContentType[] = "image";
+// EssentialProperty of image adaptation sets, its value is the tile grid,
+// e.g. "10x5". The first URI is used by DASH-IF IOP 4.3, the second one by
+// earlier drafts.
+const char kThumbnailTileSchemeIdUri[] = "http://dashif.org/thumbnail_tile";
+const char kLegacyThumbnailTileSchemeIdUri[] =
+    "http://dashif.org/guidelines/thumbnail_tile";
+const char kTtmlMimeType[] = "application/ttml+xml";
+// Codecs of WebVTT and TTML carried in ISO BMFF segments.
+const char kWebVttCodec[] = "wvtt";
+const char kTtmlCodec[] = "stpp";
+// AudioChannelConfiguration scheme whose value is the channel count.
+const char kMpegChannelConfigurationScheme[] =
+    "urn:mpeg:dash:23003:3:audio_channel_configuration:2011";
+// Transfer characteristics (ISO/IEC 23001-8) of HDR video: 16 is PQ and 18 is
+// HLG. Dolby Vision sample entries are HDR regardless of them.
+const char kTransferCharacteristicsSchemeIdUri[] =
+    "urn:mpeg:mpegB:cicp:TransferCharacteristics";
+constexpr uint32_t kPqTransferCharacteristics = 16;
+constexpr uint32_t kHlgTransferCharacteristics = 18;
+const char* const kDolbyVisionCodecs[] = {"dvh1", "dvhe"};
+// Used when MPD@suggestedPresentationDelay is missing.
+constexpr double kDefaultPresentationDelay = 10.0;
+// Latency of low-latency presentations without a ServiceDescription.
+constexpr double kDefaultTargetLatency = 3.0;
 
 template <typename T>
-void UpdateIfNotNull(T*& val, T* new_val) {
-  if (new_val) val = new_val;
+void UpdateIfNotNull(std::shared_ptr<const T>& val,
+                     std::shared_ptr<const T> new_val) {
+  if (new_val) val = std::move(new_val);
 }
 
-template <typename T>
-void AppendIfNotNull(std::vector<T*>& dest, T* val) {
-  if (val) dest.push_back(val);
+void AppendIfNotEmpty(RepresentationDescription& rep,
+                      const std::string& base_url) {
+  if (base_url.empty()) return;
+
+  rep.base_urls.push_back(base_url);
+  rep.base_url_levels.push_back({base_url});
+  rep.service_location_levels.push_back({std::string()});
 }
 
-template <typename T>
-void AppendIfNotEmpty(std::vector<T>& dest, const std::vector<T>& src) {
-  if (!src.empty())
-    dest.push_back(src[0]);  // TODO(samsung) what if ther will be more URLs?
+// The first base URL is used to resolve segment URLs, others are kept as
+// alternatives.
+void AppendIfNotEmpty(RepresentationDescription& rep,
+                      const std::vector<MpdBaseUrl>& src) {
+  if (src.empty()) return;
+
+  std::vector<std::string> level;
+  std::vector<std::string> locations;
+  level.reserve(src.size());
+  locations.reserve(src.size());
+  for (const auto& base_url : src) {
+    level.push_back(base_url.url);
+    locations.push_back(base_url.service_location);
+  }
+  rep.base_urls.push_back(level[0]);
+  rep.base_url_levels.push_back(std::move(level));
+  rep.service_location_levels.push_back(std::move(locations));
 }
 
-template <typename T>
-void UpdateRepresentation(RepresentationDescription& rep, T* mpd_element) {
-  // TODO(samsung) add support for multiple URLs...
-  AppendIfNotEmpty(rep.base_urls, mpd_element->GetBaseURLs());
-  UpdateIfNotNull(rep.segment_base, mpd_element->GetSegmentBase());
-  UpdateIfNotNull(rep.segment_list, mpd_element->GetSegmentList());
-  UpdateIfNotNull(rep.segment_template, mpd_element->GetSegmentTemplate());
+// Segment information elements are shared with MpdInfo, the closest one
+// applies to the representation.
+void UpdateRepresentation(RepresentationDescription& rep,
+                          const MpdElementInfo& mpd_element) {
+  AppendIfNotEmpty(rep, mpd_element.base_urls);
+  UpdateIfNotNull(rep.segment_base, mpd_element.segment_base);
+  UpdateIfNotNull(rep.segment_list, mpd_element.segment_list);
+  UpdateIfNotNull(rep.segment_template, mpd_element.segment_template);
+}
+
+// Live presentations which segments are available before they are complete
+// are played close to the live edge, see RepresentationDescription.
+void ApplyTargetLatency(RepresentationDescription* rep) {
+  if (!rep->dynamic) return;
+
+  if (rep->target_latency <= 0. && rep->segment_template &&
+      rep->segment_template->availability_time_offset > 0.)
+    rep->target_latency = kDefaultTargetLatency;
+  if (rep->target_latency > 0.) rep->presentation_delay = rep->target_latency;
 }
 
 MediaStreamType ParseContentType(const std::string& type) {
@@ -58,6 +120,10 @@ MediaStreamType ParseContentType(const std::string& type) {
 
   if (type == kVideoTypeString) return MediaStreamType::Video;
 
+  if (type == kTextContentType) return MediaStreamType::Text;
+
+  if (type == kImageContentType) return MediaStreamType::Image;
+
   return MediaStreamType::Unknown;
 }
 
@@ -70,34 +136,64 @@ MediaStreamType ParseTypeFromMimeType(const std::string& mime_type) {
   if (mime_type.compare(0, sizeof(kVideoTypeString) - 1, kVideoTypeString) == 0)
     return MediaStreamType::Video;
 
+  if (mime_type.compare(0, sizeof(kTextTypeString) - 1, kTextTypeString) == 0 ||
+      mime_type == kTtmlMimeType)
+    return MediaStreamType::Text;
+
+  if (mime_type.compare(0, sizeof(kImageTypeString) - 1, kImageTypeString) == 0)
+    return MediaStreamType::Image;
+
+  return MediaStreamType::Unknown;
+}
+
+// Text in ISO BMFF segments has a generic "application/mp4" @mimeType.
+MediaStreamType ParseTypeFromCodecs(const std::string& codecs) {
+  if (codecs.empty()) return MediaStreamType::Unknown;
+
+  if (codecs.compare(0, sizeof(kWebVttCodec) - 1, kWebVttCodec) == 0 ||
+      codecs.compare(0, sizeof(kTtmlCodec) - 1, kTtmlCodec) == 0)
+    return MediaStreamType::Text;
+
   return MediaStreamType::Unknown;
 }
 
-RepresentationBuilder::RepresentationBuilder(dash::mpd::IMPD* mpd,
+RepresentationBuilder::RepresentationBuilder(const MpdInfo& mpd,
                                              ContentProtectionVisitor* visitor)
     : representation_(MakeEmptyRepresentation()),
       type_(MediaStreamType::Unknown),
       visitor_(visitor) {
-  AppendIfNotNull(representation_.base_urls, mpd->GetMPDPathBaseUrl());
-  AppendIfNotEmpty(representation_.base_urls, mpd->GetBaseUrls());
+  AppendIfNotEmpty(representation_, mpd.mpd_path_base_url);
+  AppendIfNotEmpty(representation_, mpd.base_urls);
+
+  if (mpd.type != kDynamicPresentationType) return;
+
+  representation_.dynamic = true;
+  representation_.availability_start_time =
+      std::max(ParseDateTimeToSeconds(mpd.availability_start_time), 0.);
+  representation_.time_shift_buffer_depth =
+      ParseDurationToSeconds(mpd.time_shift_buffer_depth);
+  double delay = ParseDurationToSeconds(mpd.suggested_presentation_delay);
+  representation_.presentation_delay =
+      delay != kInvalidDuration ? delay : kDefaultPresentationDelay;
+  representation_.target_latency = std::max(mpd.target_latency, 0.);
 }
 
 RepresentationBuilder RepresentationBuilder::Visit(
-    dash::mpd::IPeriod* period) const {
+    const PeriodInfo& period) const {
   RepresentationBuilder builder = *this;
   builder.ProcessNode(period);
   return builder;
 }
 
 RepresentationBuilder RepresentationBuilder::Visit(
-    dash::mpd::IAdaptationSet* adaptation_set) const {
+    const AdaptationSetInfo& adaptation_set) const {
   RepresentationBuilder builder = *this;
   builder.ProcessNode(adaptation_set);
   return builder;
 }
 
 RepresentationBuilder RepresentationBuilder::Visit(
-    dash::mpd::IRepresentation* representation) const {
+    const RepresentationInfo& representation) const {
   RepresentationBuilder builder = *this;
   builder.ProcessNode(representation);
   return builder;
@@ -105,32 +201,136 @@ RepresentationBuilder RepresentationBuilder::Visit(
 
 void RepresentationBuilder::EmitRepresentation(
     std::vector<VideoRepresentation>& video,
-    std::vector<AudioRepresentation>& audio) const {
+    std::vector<AudioRepresentation>& audio,
+    std::vector<TextRepresentation>& text,
+    std::vector<ImageRepresentation>& image) const {
   if (type_ == MediaStreamType::Audio)
     EmitAudioRepresentation(audio);
   else if (type_ == MediaStreamType::Video)
     EmitVideoRepresentation(video);
+  else if (type_ == MediaStreamType::Text)
+    EmitTextRepresentation(text);
+  else if (type_ == MediaStreamType::Image)
+    EmitImageRepresentation(image);
+}
+
+bool RepresentationBuilder::IsSupported(
+    const DeviceCapabilities& capabilities) const {
+  if (type_ != MediaStreamType::Audio && type_ != MediaStreamType::Video)
+    return true;
+
+  // Codecs are compared by their sample entry, e.g. "avc1" of "avc1.640028".
+  const std::string& codecs = type_ == MediaStreamType::Audio
+      ? audio_.description.codecs : video_.description.codecs;
+  std::string sample_entry = codecs.substr(0, codecs.find('.'));
+  if (!capabilities.codecs.empty() && !sample_entry.empty() &&
+      std::find(capabilities.codecs.begin(), capabilities.codecs.end(),
+                sample_entry) == capabilities.codecs.end())
+    return false;
+
+  if (type_ == MediaStreamType::Audio)
+    return capabilities.max_channels == 0 ||
+           audio_.channels <= capabilities.max_channels;
+
+  if (capabilities.max_width > 0 && video_.width > capabilities.max_width)
+    return false;
+  if (capabilities.max_height > 0 && video_.height > capabilities.max_height)
+    return false;
+  if (!capabilities.hdr) {
+    if (video_.hdr) return false;
+    for (auto dolby_vision : kDolbyVisionCodecs) {
+      if (sample_entry == dolby_vision) return false;
+    }
+  }
+  return true;
+}
+
+std::string RepresentationBuilder::Describe() const {
+  std::string description = representation_.representation_id + " (" +
+                            representation_.codecs;
+  if (type_ == MediaStreamType::Audio) {
+    description += ", " + std::to_string(audio_.channels) + " channels";
+  } else if (type_ == MediaStreamType::Video) {
+    description += ", " + std::to_string(video_.width) + "x" +
+                   std::to_string(video_.height);
+    if (video_.hdr) description += ", HDR";
+  }
+  return description + ")";
 }
 
-void RepresentationBuilder::ExtractAudioInfo(dash::mpd::IRepresentationBase*) {
-  // Currently nothing to extract for audio...
+void RepresentationBuilder::ExtractAudioInfo(const MpdElementInfo& rb) {
+  uint32_t sampling_rate = std::strtoul(rb.audio_sampling_rate.c_str(),
+                                        nullptr, 10);
+  if (sampling_rate > 0) audio_.sampling_rate = sampling_rate;
+
+  for (const auto& descriptor : rb.audio_channel_configurations) {
+    if (descriptor.scheme_id_uri != kMpegChannelConfigurationScheme)
+      continue;
+    uint32_t channels = std::strtoul(descriptor.value.c_str(), nullptr, 10);
+    if (channels > 0) audio_.channels = channels;
+  }
 }
 
-void RepresentationBuilder::ExtractVideoInfo(
-    dash::mpd::IRepresentationBase* rb) {
-  uint32_t width = rb->GetWidth();
-  uint32_t height = rb->GetHeight();
+void RepresentationBuilder::ExtractVideoInfo(const MpdElementInfo& rb) {
+  uint32_t width = rb.width;
+  uint32_t height = rb.height;
 
   if (width > 0) video_.width = width;
 
   if (height > 0) video_.height = height;
+
+  // @frameRate is either an integer or a "num/den" fraction.
+  const std::string& frame_rate = rb.frame_rate;
+  char* end = nullptr;
+  uint32_t num = std::strtoul(frame_rate.c_str(), &end, 10);
+  uint32_t den = *end == '/' ? std::strtoul(end + 1, nullptr, 10) : 1;
+  if (num > 0 && den > 0) {
+    video_.frame_rate_num = num;
+    video_.frame_rate_den = den;
+  }
+
+  for (const auto* properties :
+       {&rb.essential_properties, &rb.supplemental_properties}) {
+    for (const auto& property : *properties) {
+      if (property.scheme_id_uri != kTransferCharacteristicsSchemeIdUri ||
+          property.value.empty())
+        continue;
+      uint32_t transfer = std::strtoul(property.value.c_str(), nullptr, 10);
+      video_.hdr = transfer == kPqTransferCharacteristics ||
+                   transfer == kHlgTransferCharacteristics;
+    }
+  }
+}
+
+void RepresentationBuilder::ExtractImageInfo(const MpdElementInfo& rb) {
+  if (rb.width > 0) image_.width = rb.width;
+  if (rb.height > 0) image_.height = rb.height;
+
+  for (const auto& property : rb.essential_properties) {
+    if (property.value.empty()) continue;
+    const std::string& scheme = property.scheme_id_uri;
+    if (scheme != kThumbnailTileSchemeIdUri &&
+        scheme != kLegacyThumbnailTileSchemeIdUri)
+      continue;
+
+    // "<columns>x<rows>"
+    const std::string& grid = property.value;
+    char* end = nullptr;
+    uint32_t columns = std::strtoul(grid.c_str(), &end, 10);
+    uint32_t rows = (*end == 'x' || *end == 'X')
+        ? std::strtoul(end + 1, nullptr, 10) : 0;
+    if (columns > 0 && rows > 0) {
+      image_.tile_columns = columns;
+      image_.tile_rows = rows;
+    }
+  }
 }
 
 void RepresentationBuilder::ExtractContentProtection(
-    dash::mpd::IRepresentationBase* rb) {
+    const MpdElementInfo& rb) {
   if (!visitor_) return;
 
-  auto descriptor = visitor_->Visit(rb->GetContentProtection());
+  auto descriptor = visitor_->Visit(rb.content_protection);
   if (!descriptor && !drm_descriptor_) return;
 
   if (!descriptor)
@@ -144,42 +344,52 @@ void RepresentationBuilder::ExtractContentProtection(
     drm_descriptor_ = descriptor;
 }
 
-void RepresentationBuilder::ExtractInfo(dash::mpd::IRepresentationBase* rb) {
+void RepresentationBuilder::ExtractInfo(const MpdElementInfo& rb) {
+  if (!rb.codecs.empty()) {
+    representation_.codecs = rb.codecs;
+    audio_.description.codecs = representation_.codecs;
+    video_.description.codecs = representation_.codecs;
+    text_.description.codecs = representation_.codecs;
+  }
+  if (!rb.mime_type.empty()) {
+    text_.mime_type = rb.mime_type;
+    image_.mime_type = rb.mime_type;
+  }
+
   if (type_ == MediaStreamType::Audio)
     ExtractAudioInfo(rb);
   else if (type_ == MediaStreamType::Video)
     ExtractVideoInfo(rb);
+  else if (type_ == MediaStreamType::Image)
+    ExtractImageInfo(rb);
 
   ExtractContentProtection(rb);
 }
 
 void RepresentationBuilder::ExtractRepresentationType(
-    dash::mpd::IAdaptationSet* adaptation_set) {
-  const dash::mpd::IContentComponent* content_component = nullptr;
-
-  // TODO(samsung) handle situation when GetContentComponent provides more than
-  // one IContentComponent
-  if (!adaptation_set->GetContentComponent().empty())
-    content_component = adaptation_set->GetContentComponent()[0];
-
-  type_ =
-      ParseContentType(content_component ? content_component->GetContentType()
-                                         : adaptation_set->GetContentType());
+    const AdaptationSetInfo& adaptation_set) {
+  type_ = ParseContentType(adaptation_set.content_type);
+  if (type_ == MediaStreamType::Unknown)
+    type_ = ParseTypeFromMimeType(adaptation_set.mime_type);
   if (type_ == MediaStreamType::Unknown)
-    type_ = ParseTypeFromMimeType(adaptation_set->GetMimeType());
+    type_ = ParseTypeFromCodecs(adaptation_set.codecs);
 
-  if (type_ == MediaStreamType::Audio) {
-    audio_.language = (content_component ? content_component->GetLang()
-                                         : adaptation_set->GetLang());
-  }
+  if (type_ == MediaStreamType::Audio)
+    audio_.language = adaptation_set.lang;
+  else if (type_ == MediaStreamType::Text)
+    text_.language = adaptation_set.lang;
 }
 
-void RepresentationBuilder::ProcessNode(dash::mpd::IPeriod* period) {
+void RepresentationBuilder::ProcessNode(const PeriodInfo& period) {
   UpdateRepresentation(representation_, period);
+
+  double start = ParseDurationToSeconds(period.start);
+  if (representation_.dynamic && start != kInvalidDuration)
+    representation_.availability_start_time += start;
 }
 
 void RepresentationBuilder::ProcessNode(
-    dash::mpd::IAdaptationSet* adaptation_set) {
+    const AdaptationSetInfo& adaptation_set) {
   drm_descriptor_ = nullptr;
   UpdateRepresentation(representation_, adaptation_set);
   ExtractRepresentationType(adaptation_set);
@@ -188,32 +398,39 @@ void RepresentationBuilder::ProcessNode(
 }
 
 void RepresentationBuilder::ProcessNode(
-    dash::mpd::IRepresentation* representation) {
+    const RepresentationInfo& representation) {
   UpdateRepresentation(representation_, representation);
-  representation_.representation_id = representation->GetId();
+  representation_.representation_id = representation.id;
 
   // In some cases representation type is determined on IRepresentation level
   ExtractRepresentationType(representation);
   // ExtractInfo rely on determined representation type
   ExtractInfo(representation);
 
-  uint32_t bandwidth = representation->GetBandwidth();
+  uint32_t bandwidth = representation.bandwidth;
   if (bandwidth > 0 && type_ == MediaStreamType::Audio)
     audio_.description.bitrate = bandwidth;
   else if (bandwidth > 0 && type_ == MediaStreamType::Video)
     video_.description.bitrate = bandwidth;
+  else if (bandwidth > 0 && type_ == MediaStreamType::Text)
+    text_.description.bitrate = bandwidth;
+  else if (bandwidth > 0 && type_ == MediaStreamType::Image)
+    image_.description.bitrate = bandwidth;
 }
 
 void RepresentationBuilder::ExtractRepresentationType(
-    dash::mpd::IRepresentation* representation) {
+    const RepresentationInfo& representation) {
+  if (type_ == MediaStreamType::Unknown)
+    type_ = ParseTypeFromMimeType(representation.mime_type);
   if (type_ == MediaStreamType::Unknown)
-    type_ = ParseTypeFromMimeType(representation->GetMimeType());
+    type_ = ParseTypeFromCodecs(representation.codecs);
 }
 
 void RepresentationBuilder::EmitAudioRepresentation(
     std::vector<AudioRepresentation>& audio) const {
   AudioRepresentation rep = {audio_, representation_};
   rep.stream.description.id = audio.size();
+  ApplyTargetLatency(&rep.representation);
   audio.push_back(rep);
 }
 
@@ -221,5 +438,22 @@ void RepresentationBuilder::EmitVideoRepresentation(
     std::vector<VideoRepresentation>& video) const {
   VideoRepresentation rep = {video_, representation_};
   rep.stream.description.id = video.size();
+  ApplyTargetLatency(&rep.representation);
   video.push_back(rep);
 }
+
+void RepresentationBuilder::EmitTextRepresentation(
+    std::vector<TextRepresentation>& text) const {
+  TextRepresentation rep = {text_, representation_};
+  rep.stream.description.id = text.size();
+  ApplyTargetLatency(&rep.representation);
+  text.push_back(rep);
+}
+
+void RepresentationBuilder::EmitImageRepresentation(
+    std::vector<ImageRepresentation>& image) const {
+  ImageRepresentation rep = {image_, representation_};
+  rep.stream.description.id = image.size();
+  ApplyTargetLatency(&rep.representation);
+  image.push_back(rep);
+}
@@ -23,10 +23,10 @@
 #include <vector>
 #include <string>
 
-#include "libdash/libdash.h"
-
 #include "dash/content_protection_visitor.h"
+#include "dash/dash_manifest.h"
 
+#include "mpd_info.h"
 #include "util.h"
 
 
@@ -64,40 +64,54 @@
 
 class RepresentationBuilder {
  public:
-  RepresentationBuilder(dash::mpd::IMPD*, ContentProtectionVisitor*);
+  RepresentationBuilder(const MpdInfo&, ContentProtectionVisitor*);
   RepresentationBuilder(const RepresentationBuilder&) = default;
   RepresentationBuilder(RepresentationBuilder&&) = default;
   RepresentationBuilder& operator=(const RepresentationBuilder&) = default;
   RepresentationBuilder& operator=(RepresentationBuilder&&) = default;
   ~RepresentationBuilder() = default;
 
-  RepresentationBuilder Visit(dash::mpd::IPeriod*) const;
-  RepresentationBuilder Visit(dash::mpd::IAdaptationSet*) const;
-  RepresentationBuilder Visit(dash::mpd::IRepresentation*) const;
+  RepresentationBuilder Visit(const PeriodInfo&) const;
+  RepresentationBuilder Visit(const AdaptationSetInfo&) const;
+  RepresentationBuilder Visit(const RepresentationInfo&) const;
 
   void EmitRepresentation(std::vector<VideoRepresentation>& video,
-                          std::vector<AudioRepresentation>& audio) const;
+                          std::vector<AudioRepresentation>& audio,
+                          std::vector<TextRepresentation>& text,
+                          std::vector<ImageRepresentation>& image) const;
 
- private:
-  void ExtractAudioInfo(dash::mpd::IRepresentationBase*);
-  void ExtractVideoInfo(dash::mpd::IRepresentationBase*);
-  void ExtractContentProtection(dash::mpd::IRepresentationBase*);
-  void ExtractInfo(dash::mpd::IRepresentationBase*);
-  void ExtractRepresentationType(dash::mpd::IAdaptationSet*);
-  void ExtractRepresentationType(dash::mpd::IRepresentation*);
+  // Checks the representation against limits of the device. Text and image
+  // representations are always supported.
+  bool IsSupported(const DeviceCapabilities& capabilities) const;
 
-  void ProcessNode(dash::mpd::IPeriod*);
-  void ProcessNode(dash::mpd::IAdaptationSet*);
-  void ProcessNode(dash::mpd::IRepresentation*);
+  // Describes the representation in logs.
+  std::string Describe() const;
+
+ private:
+  void ExtractAudioInfo(const MpdElementInfo&);
+  void ExtractVideoInfo(const MpdElementInfo&);
+  void ExtractImageInfo(const MpdElementInfo&);
+  void ExtractContentProtection(const MpdElementInfo&);
+  void ExtractInfo(const MpdElementInfo&);
+  void ExtractRepresentationType(const AdaptationSetInfo&);
+  void ExtractRepresentationType(const RepresentationInfo&);
+
+  void ProcessNode(const PeriodInfo&);
+  void ProcessNode(const AdaptationSetInfo&);
+  void ProcessNode(const RepresentationInfo&);
 
   void EmitAudioRepresentation(std::vector<AudioRepresentation>& audio) const;
   void EmitVideoRepresentation(std::vector<VideoRepresentation>& video) const;
+  void EmitTextRepresentation(std::vector<TextRepresentation>& text) const;
+  void EmitImageRepresentation(std::vector<ImageRepresentation>& image) const;
 
   RepresentationDescription representation_;
 
   MediaStreamType type_;
   AudioStream audio_;
   VideoStream video_;
+  TextStream text_;
+  ImageStream image_;
 
   std::shared_ptr<ContentProtectionDescriptor> drm_descriptor_;
 
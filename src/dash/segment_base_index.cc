@@ -0,0 +1,791 @@
+/*!
+ * segment_base_index.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "demuxer/box_reader.h"
+
+#include "segment_base_index.h"
+#include "segment_disk_cache.h"
+#include "url_segment.h"
+#include "util.h"
+
+namespace {
+
+// Box walk looking for sidx downloads this much data per request.
+constexpr uint32_t kProbeSize = 64 * 1024;
+
+// Adjacent sidx references are joined into one segment (and a single ranged
+// request) as long as it doesn't exceed these limits.
+constexpr double kMaxCoalescedSegmentDuration = 10.0;
+constexpr uint64_t kMaxCoalescedSegmentSize = 8 * 1024 * 1024;
+
+// Nesting level of sidx boxes referenced by the top level one, which are
+// followed.
+constexpr uint32_t kMaxSidxDepth = 4;
+
+// Size of each sidx reference.
+constexpr size_t kSidxReferenceSize = 12;
+
+// Size of a box header with a 64-bit size.
+constexpr uint32_t kMaxBoxHeaderSize = 16;
+
+// Number of attempts to download the top level sidx box.
+constexpr uint32_t kMaxLoadAttempts = 2;
+
+// EBML element ids of WebM (Matroska) used to find and parse Cues.
+constexpr uint32_t kEbmlHeaderId = 0x1A45DFA3;
+constexpr uint32_t kSegmentId = 0x18538067;
+constexpr uint32_t kSeekHeadId = 0x114D9B74;
+constexpr uint32_t kSeekId = 0x4DBB;
+constexpr uint32_t kSeekIdId = 0x53AB;
+constexpr uint32_t kSeekPositionId = 0x53AC;
+constexpr uint32_t kInfoId = 0x1549A966;
+constexpr uint32_t kTimecodeScaleId = 0x2AD7B1;
+constexpr uint32_t kDurationId = 0x4489;
+constexpr uint32_t kCuesId = 0x1C53BB6B;
+constexpr uint32_t kCuePointId = 0xBB;
+constexpr uint32_t kCueTimeId = 0xB3;
+constexpr uint32_t kCueTrackPositionsId = 0xB7;
+constexpr uint32_t kCueClusterPositionId = 0xF1;
+
+// Matroska default, timecodes are in milliseconds.
+constexpr uint64_t kDefaultTimecodeScale = 1000000;
+constexpr double kNanosecondsPerSecond = 1e9;
+// Size of an element which extends to the end of its parent.
+constexpr uint64_t kEbmlUnknownSize = ~0ULL;
+
+SegmentIndexEntry MakeEntry(double timestamp, double duration, uint64_t offset,
+                            uint64_t size) {
+  return {timestamp, duration, offset, size, false, true, 0, 0.0, {}};
+}
+
+double ToSeconds(uint64_t pts, uint32_t timescale) {
+  return static_cast<double>(pts) / static_cast<double>(timescale);
+}
+
+// Index data is small and needed before the playback can start, so it's
+// kept in the disk cache for replays.
+bool DownloadIndexData(dash::mpd::ISegment* segment,
+                       std::vector<uint8_t>* data) {
+  if (!segment) return false;
+
+  SegmentDescriptor location = DescribeSegment(segment);
+  if (SegmentDiskCache::Get().Lookup(location, data)) return true;
+  if (!DownloadSegment(location, data)) return false;
+
+  SegmentDiskCache::Get().Put(location, *data);
+  return true;
+}
+
+std::string ToHttpRange(uint64_t data_begin, uint64_t data_size) {
+  return std::to_string(data_begin) + "-"
+      + std::to_string(data_begin + data_size - 1);
+}
+
+// Reads an EBML variable size integer. The length marker is kept in ids and
+// stripped from sizes, a size with all bits set is kEbmlUnknownSize.
+bool NextEbmlVint(const uint8_t*& stream, const uint8_t* end, bool is_id,
+                  uint64_t* value) {
+  if (stream >= end || *stream == 0) return false;
+  size_t length = 1;
+  while (!(*stream & (0x80 >> (length - 1)))) ++length;
+  if (static_cast<size_t>(end - stream) < length) return false;
+
+  const uint64_t mask = 0xFF >> length;
+  uint64_t out = is_id ? *stream : *stream & mask;
+  bool all_ones = (*stream & mask) == mask;
+  for (size_t i = 1; i < length; ++i) {
+    out = (out << 8) | stream[i];
+    all_ones = all_ones && stream[i] == 0xFF;
+  }
+  stream += length;
+  *value = !is_id && all_ones ? kEbmlUnknownSize : out;
+  return true;
+}
+
+bool NextEbmlElement(const uint8_t*& stream, const uint8_t* end,
+                     uint32_t* id, uint64_t* size) {
+  uint64_t element_id;
+  if (!NextEbmlVint(stream, end, true, &element_id) ||
+      element_id > 0xFFFFFFFFu)
+    return false;
+  *id = static_cast<uint32_t>(element_id);
+  return NextEbmlVint(stream, end, false, size);
+}
+
+uint64_t EbmlUnsigned(const uint8_t* data, uint64_t size) {
+  uint64_t out = 0;
+  for (uint64_t i = 0; i < size && i < sizeof(out); ++i)
+    out = (out << 8) | data[i];
+  return out;
+}
+
+double EbmlFloat(const uint8_t* data, uint64_t size) {
+  uint64_t bits = EbmlUnsigned(data, size);
+  if (size == 4) {
+    uint32_t bits32 = static_cast<uint32_t>(bits);
+    float out;
+    memcpy(&out, &bits32, sizeof(out));
+    return out;
+  }
+  if (size != 8) return 0.0;
+  double out;
+  memcpy(&out, &bits, sizeof(out));
+  return out;
+}
+
+// Calls visit(id, payload, size) for each child element in [stream, end),
+// until an element is malformed or doesn't fit in the data.
+template <typename Visitor>
+void ForEachEbmlElement(const uint8_t* stream, const uint8_t* end,
+                        Visitor visit) {
+  uint32_t id;
+  uint64_t size;
+  while (NextEbmlElement(stream, end, &id, &size) &&
+         size <= static_cast<uint64_t>(end - stream)) {
+    visit(id, stream, size);
+    stream += size;
+  }
+}
+
+bool IsWebmCues(const std::vector<uint8_t>& data) {
+  const uint8_t* stream = data.data();
+  uint32_t id;
+  uint64_t size;
+  return NextEbmlElement(stream, stream + data.size(), &id, &size) &&
+         id == kCuesId;
+}
+
+}  // namespace
+
+SegmentBaseIndex::SegmentBaseIndex(const RepresentationDescription& desc)
+    : base_url_(ResolveBaseUrl(desc.base_urls)),
+      segment_base_(desc.segment_base),
+      load_lock_(),
+      loaded_(false),
+      load_attempts_(0),
+      segment_index_(),
+      average_segment_duration_(0.0),
+      init_data_(),
+      sub_indexes_lock_(),
+      sub_indexes_() {}
+
+SegmentBaseIndex::~SegmentBaseIndex() {}
+
+bool SegmentBaseIndex::Load() {
+  pp::AutoLock lock(load_lock_);
+  if (loaded_) return !segment_index_.entries.empty();
+  if (load_attempts_ >= kMaxLoadAttempts) return false;
+
+  ++load_attempts_;
+  loaded_ = LoadIndexSegment();
+  if (!loaded_)
+    LOG_ERROR("Failed to load segment index, attempt %u", load_attempts_);
+  return loaded_ && !segment_index_.entries.empty();
+}
+
+uint32_t SegmentBaseIndex::size() {
+  if (!Load()) return 0;
+
+  return segment_index_.entries.size();
+}
+
+bool SegmentBaseIndex::FindSegment(double time, uint32_t* index,
+                                   uint32_t* sub_index) {
+  if (!Load()) return false;
+
+  // The last segment which starts before time.
+  const auto& timestamps = segment_index_.timestamps;
+  auto it = std::upper_bound(timestamps.begin(), timestamps.end(),
+                             time + kEps);
+  if (it == timestamps.begin()) return false;
+
+  uint32_t i = std::distance(timestamps.begin(), it) - 1;
+  const SegmentIndexEntry& e = segment_index_.entries[i];
+  if (time >= e.timestamp + e.duration) return false;
+  if (!e.is_index) {
+    *index = i;
+    *sub_index = 0;
+    return true;
+  }
+
+  const SegmentIndex* sub = SubIndex(i);
+  const auto& sub_timestamps = sub->timestamps;
+  auto sub_it = std::upper_bound(sub_timestamps.begin(), sub_timestamps.end(),
+                                 time + kEps);
+  if (sub_it == sub_timestamps.begin()) return false;
+
+  uint32_t j = std::distance(sub_timestamps.begin(), sub_it) - 1;
+  const SegmentIndexEntry& sub_entry = sub->entries[j];
+  if (time >= sub_entry.timestamp + sub_entry.duration) return false;
+
+  *index = i;
+  *sub_index = j;
+  return true;
+}
+
+double SegmentBaseIndex::AverageSegmentDuration() {
+  if (!Load()) return 0.0;
+
+  return average_segment_duration_;
+}
+
+bool SegmentBaseIndex::GetInitData(std::vector<uint8_t>* data) {
+  if (CombinedInitSize() == 0) return false;
+
+  Load();
+  pp::AutoLock lock(load_lock_);
+  if (init_data_.empty()) return false;
+
+  *data = init_data_;
+  return true;
+}
+
+uint64_t SegmentBaseIndex::CombinedInitSize() const {
+  // Explicit initialization and representation index segments are
+  // downloaded on their own.
+  if (!segment_base_->initialization.url.empty() ||
+      !segment_base_->representation_index.url.empty())
+    return 0;
+
+  const std::string& range = segment_base_->index_range;
+  size_t pos = range.find("-");
+  if (pos == std::string::npos) return 0;
+
+  uint64_t index_begin = std::strtoull(range.c_str(), nullptr, 10);
+  // Initialization@range has to end right at the index, e.g. WebM Cues
+  // usually come after all clusters.
+  const std::string& init_range = segment_base_->initialization.range;
+  if (!init_range.empty()) {
+    size_t init_pos = init_range.find("-");
+    if (init_pos == std::string::npos ||
+        std::strtoull(init_range.c_str() + init_pos + 1, nullptr, 10) + 1 !=
+            index_begin)
+      return 0;
+  }
+  return index_begin;
+}
+
+std::unique_ptr<dash::mpd::ISegment>
+SegmentBaseIndex::GetRepresentationIndexSegment() const {
+  return CreateSegment(base_url_, segment_base_->representation_index,
+                       dash::metrics::IndexSegment);
+}
+
+std::unique_ptr<dash::mpd::ISegment> SegmentBaseIndex::GetIndexSegment()
+    const {
+  if (segment_base_->index_range.empty()) return {};
+
+  auto segment = GetBaseSegment();
+  if (!segment) return {};
+
+  segment->Range(segment_base_->index_range);
+  segment->HasByteRange(true);
+  return segment;
+}
+
+bool SegmentBaseIndex::ParseSidx(const std::vector<uint8_t>& data,
+    uint64_t data_begin, std::vector<SegmentIndexEntry>* references) {
+  BoxReader reader(data.data(), data.size());
+  uint32_t type;
+  BoxReader sidx;
+  bool found = false;
+  while (!found && reader.NextBox(&type, &sidx))
+    found = type == FourCC("sidx");
+  if (!found) return false;
+
+  uint8_t version;
+  uint32_t flags;
+  sidx.FullBoxHeader(&version, &flags);
+  sidx.U32();  // reference_ID
+  uint32_t timescale = sidx.U32();
+  uint64_t pts = version == 0 ? sidx.U32() : sidx.U64();
+  // Offsets are relative to the first byte after the sidx box.
+  uint64_t offset = data_begin + reader.position();
+  offset += version == 0 ? sidx.U32() : sidx.U64();
+  sidx.U16();  // reserved
+  uint16_t reference_count = sidx.U16();
+  if (!sidx.ok() || timescale == 0 ||
+      sidx.remaining() < reference_count * kSidxReferenceSize)
+    return false;
+
+  references->reserve(references->size() + reference_count);
+  for (uint16_t i = 0; i < reference_count; ++i) {
+    uint32_t ref_size = sidx.U32();
+    bool is_index = (ref_size & 0x80000000u) != 0;
+    ref_size &= 0x7FFFFFFFu;
+
+    uint32_t duration = sidx.U32();
+
+    uint32_t sap = sidx.U32();
+
+    SegmentIndexEntry entry = MakeEntry(ToSeconds(pts, timescale),
+                                        ToSeconds(duration, timescale),
+                                        offset, ref_size);
+    entry.is_index = is_index;
+    entry.starts_with_sap = (sap & 0x80000000u) != 0;
+    entry.sap_type = static_cast<uint8_t>((sap >> 28) & 0x7u);
+    entry.sap_delta_time = ToSeconds(sap & 0x0FFFFFFFu, timescale);
+    references->push_back(entry);
+
+    pts += duration;
+    offset += ref_size;
+  }
+
+  return true;
+}
+
+bool SegmentBaseIndex::ParseWebmHeader(const std::vector<uint8_t>& data,
+                                       WebmSegmentInfo* info) {
+  const uint8_t* stream = data.data();
+  const uint8_t* end = stream + data.size();
+  uint32_t id;
+  uint64_t size;
+  if (!NextEbmlElement(stream, end, &id, &size) || id != kEbmlHeaderId ||
+      size > static_cast<uint64_t>(end - stream))
+    return false;
+  stream += size;
+  if (!NextEbmlElement(stream, end, &id, &size) || id != kSegmentId)
+    return false;
+
+  info->data_offset = stream - data.data();
+  info->data_size = size == kEbmlUnknownSize ? 0 : size;
+  info->timecode_scale = kDefaultTimecodeScale;
+  info->duration = 0.0;
+  info->cues_position = 0;
+  double duration = 0.0;
+  // Elements are read until the first one which isn't complete in data,
+  // usually a cluster.
+  ForEachEbmlElement(stream, end,
+      [info, &duration](uint32_t id, const uint8_t* payload, uint64_t size) {
+    if (id == kInfoId) {
+      ForEachEbmlElement(payload, payload + size,
+          [info, &duration](uint32_t id, const uint8_t* data, uint64_t size) {
+        if (id == kTimecodeScaleId)
+          info->timecode_scale = EbmlUnsigned(data, size);
+        else if (id == kDurationId)
+          duration = EbmlFloat(data, size);
+      });
+    } else if (id == kSeekHeadId) {
+      ForEachEbmlElement(payload, payload + size,
+          [info](uint32_t id, const uint8_t* seek, uint64_t size) {
+        if (id != kSeekId) return;
+        uint64_t seek_id = 0;
+        uint64_t position = 0;
+        ForEachEbmlElement(seek, seek + size,
+            [&seek_id, &position](uint32_t id, const uint8_t* data,
+                                  uint64_t size) {
+          if (id == kSeekIdId) seek_id = EbmlUnsigned(data, size);
+          else if (id == kSeekPositionId) position = EbmlUnsigned(data, size);
+        });
+        if (seek_id == kCuesId) info->cues_position = position;
+      });
+    }
+  });
+
+  if (info->timecode_scale == 0) info->timecode_scale = kDefaultTimecodeScale;
+  info->duration = duration * info->timecode_scale / kNanosecondsPerSecond;
+  return true;
+}
+
+bool SegmentBaseIndex::ParseCues(const std::vector<uint8_t>& cues,
+    uint64_t cues_begin, const WebmSegmentInfo& info,
+    std::vector<SegmentIndexEntry>* references) {
+  const uint8_t* stream = cues.data();
+  const uint8_t* end = stream + cues.size();
+  uint32_t id;
+  uint64_t size;
+  if (!NextEbmlElement(stream, end, &id, &size) || id != kCuesId ||
+      size > static_cast<uint64_t>(end - stream))
+    return false;
+
+  // Time and position of each cluster. Clusters with a few cue points
+  // (e.g. one per track) start at the first one.
+  std::vector<std::pair<uint64_t, uint64_t>> clusters;
+  ForEachEbmlElement(stream, stream + size,
+      [&clusters](uint32_t id, const uint8_t* payload, uint64_t size) {
+    if (id != kCuePointId) return;
+    uint64_t time = 0;
+    uint64_t position = 0;
+    bool has_position = false;
+    ForEachEbmlElement(payload, payload + size,
+        [&](uint32_t id, const uint8_t* data, uint64_t size) {
+      if (id == kCueTimeId) {
+        time = EbmlUnsigned(data, size);
+      } else if (id == kCueTrackPositionsId && !has_position) {
+        // Positions of the first track, WebM DASH has only one.
+        ForEachEbmlElement(data, data + size,
+            [&](uint32_t field_id, const uint8_t* field, uint64_t field_size) {
+          if (field_id != kCueClusterPositionId) return;
+          position = EbmlUnsigned(field, field_size);
+          has_position = true;
+        });
+      }
+    });
+    if (!has_position) return;
+    if (!clusters.empty() && clusters.back().second >= position) return;
+    clusters.emplace_back(time, position);
+  });
+  if (clusters.empty()) return false;
+
+  const double scale = info.timecode_scale / kNanosecondsPerSecond;
+  uint64_t data_end = 0;
+  if (cues_begin > info.data_offset + clusters.back().second)
+    data_end = cues_begin;
+  else if (info.data_size > 0)
+    data_end = info.data_offset + info.data_size;
+
+  references->reserve(references->size() + clusters.size());
+  for (size_t i = 0; i < clusters.size(); ++i) {
+    uint64_t offset = info.data_offset + clusters[i].second;
+    double timestamp = clusters[i].first * scale;
+    double duration;
+    uint64_t byte_end;
+    if (i + 1 < clusters.size()) {
+      duration = clusters[i + 1].first * scale - timestamp;
+      byte_end = info.data_offset + clusters[i + 1].second;
+    } else {
+      // The last cluster lasts till the end of the Segment.
+      if (data_end <= offset) {
+        LOG_ERROR("Size of the last cluster is unknown, skipping it");
+        break;
+      }
+      if (info.duration > timestamp)
+        duration = info.duration - timestamp;
+      else
+        duration = i > 0 ? references->back().duration : 0.0;
+      byte_end = data_end;
+    }
+    // Cue points are keyframes, so each cluster starts with one.
+    SegmentIndexEntry entry = MakeEntry(timestamp, duration, offset,
+                                        byte_end - offset);
+    entry.sap_type = 1;
+    references->push_back(entry);
+  }
+
+  LOG_DEBUG("Parsed %zu clusters of Cues", references->size());
+  return !references->empty();
+}
+
+SegmentIndex SegmentBaseIndex::CoalesceReferences(
+    const std::vector<SegmentIndexEntry>& references) {
+  SegmentIndex index;
+  for (const auto& ref : references) {
+    // SAP types 1-3 are keyframes decodable without preceding data, other
+    // types (or none) can't be used as seek targets.
+    bool has_access_point =
+        !ref.is_index && ref.sap_type >= 1 && ref.sap_type <= 3;
+    double access_point = ref.timestamp +
+        (ref.starts_with_sap ? 0.0 : ref.sap_delta_time);
+    if (!index.entries.empty() && !ref.is_index &&
+        !index.entries.back().is_index) {
+      SegmentIndexEntry& last = index.entries.back();
+      // A reference which doesn't start with an access point can't start
+      // a segment, as a seek to it couldn't be decoded.
+      bool fits =
+          last.duration + ref.duration <= kMaxCoalescedSegmentDuration &&
+          last.byte_size + ref.byte_size <= kMaxCoalescedSegmentSize;
+      if (last.byte_offset + last.byte_size == ref.byte_offset &&
+          (fits || !ref.starts_with_sap)) {
+        last.duration += ref.duration;
+        last.byte_size += ref.byte_size;
+        if (has_access_point) last.access_points.push_back(access_point);
+        continue;
+      }
+    }
+    index.entries.push_back(ref);
+    if (has_access_point)
+      index.entries.back().access_points.push_back(access_point);
+  }
+
+  index.timestamps.reserve(index.entries.size());
+  for (const auto& entry : index.entries)
+    index.timestamps.push_back(entry.timestamp);
+
+  LOG_DEBUG("Coalesced %zu sidx references into %zu segments",
+            references.size(), index.entries.size());
+  return index;
+}
+
+bool SegmentBaseIndex::LoadSubIndexReferences(
+    const SegmentIndexEntry& entry, uint32_t depth,
+    std::vector<SegmentIndexEntry>* references) const {
+  auto segment = GetBaseSegment();
+  if (!segment) return false;
+
+  segment->Range(ToHttpRange(entry.byte_offset, entry.byte_size));
+  segment->HasByteRange(true);
+  std::vector<uint8_t> data;
+  if (!DownloadIndexData(segment.get(), &data)) return false;
+
+  std::vector<SegmentIndexEntry> sub_references;
+  if (!ParseSidx(data, entry.byte_offset, &sub_references)) {
+    LOG_ERROR("Failed to parse sidx at %llu",
+              static_cast<unsigned long long>(entry.byte_offset));
+    return false;
+  }
+
+  for (const auto& ref : sub_references) {
+    if (!ref.is_index) {
+      references->push_back(ref);
+    } else if (depth >= kMaxSidxDepth ||
+               !LoadSubIndexReferences(ref, depth + 1, references)) {
+      LOG_ERROR("Skipping sidx reference at %llu",
+                static_cast<unsigned long long>(ref.byte_offset));
+    }
+  }
+  return true;
+}
+
+const SegmentIndex* SegmentBaseIndex::SubIndex(uint32_t index) {
+  static const SegmentIndex kEmptyIndex;
+  if (index >= segment_index_.entries.size() ||
+      !segment_index_.entries[index].is_index)
+    return nullptr;
+
+  pp::AutoLock lock(sub_indexes_lock_);
+  if (sub_indexes_[index]) return sub_indexes_[index].get();
+
+  std::vector<SegmentIndexEntry> references;
+  // Not stored, so the download is retried when it's needed again.
+  if (!LoadSubIndexReferences(segment_index_.entries[index], 1, &references))
+    return &kEmptyIndex;
+
+  sub_indexes_[index] = MakeUnique<SegmentIndex>(
+      CoalesceReferences(references));
+  return sub_indexes_[index].get();
+}
+
+uint32_t SegmentBaseIndex::SegmentCount(uint32_t index) {
+  if (!Load() || index >= segment_index_.entries.size()) return 0;
+
+  const SegmentIndex* sub_index = SubIndex(index);
+  return sub_index ? sub_index->entries.size() : 1;
+}
+
+const SegmentIndexEntry* SegmentBaseIndex::Entry(uint32_t index,
+    uint32_t sub_index) {
+  if (!Load() || index >= segment_index_.entries.size()) return nullptr;
+
+  const SegmentIndex* sub = SubIndex(index);
+  if (!sub) {
+    return sub_index == 0 ? &segment_index_.entries[index] : nullptr;
+  }
+  if (sub_index >= sub->entries.size()) return nullptr;
+
+  return &sub->entries[sub_index];
+}
+
+std::unique_ptr<dash::mpd::ISegment>
+SegmentBaseIndex::FindIndexSegmentInMp4(
+    std::vector<uint8_t>* sidx_data) const {
+  auto segment = GetBaseSegment();
+  if (!segment) return nullptr;
+
+  // Boxes are read from a larger probe range, which is downloaded again only
+  // when the walk gets past it.
+  std::vector<uint8_t> data;
+  uint64_t data_begin = 0;
+  uint64_t box_begin = 0;
+  bool is_mp4 = false;
+  while (true) {
+    if (data.empty() ||
+        box_begin + kMaxBoxHeaderSize > data_begin + data.size()) {
+      segment->Range(ToHttpRange(box_begin, kProbeSize));
+      segment->HasByteRange(true);
+
+      DownloadIndexData(segment.get(), &data);
+      if (data.size() < BoxReader::kBoxHeaderSize) return nullptr;
+      data_begin = box_begin;
+    }
+
+    size_t box_offset = box_begin - data_begin;
+    BoxReader reader(data.data() + box_offset, data.size() - box_offset);
+    uint64_t size;
+    uint32_t type;
+    size_t header_size;
+    if (!reader.NextBoxHeader(&size, &type, &header_size)) return nullptr;
+
+    if (!is_mp4 && type != FourCC("ftyp")) return nullptr;
+
+    // Boxes extending to the end of file are not expected before sidx.
+    if (size < header_size) return nullptr;
+
+    if (type == FourCC("ftyp")) {
+      is_mp4 = true;
+    } else if (type == FourCC("sidx")) {
+      segment->Range(ToHttpRange(box_begin, size));
+      segment->HasByteRange(true);
+      if (sidx_data && size <= reader.size())
+        sidx_data->assign(reader.data(), reader.data() + size);
+      return segment;
+    }
+
+    box_begin += size;
+  }
+}
+
+std::unique_ptr<dash::mpd::ISegment>
+SegmentBaseIndex::FindIndexSegmentInWebm(
+    std::vector<uint8_t>* cues_data) const {
+  auto segment = GetBaseSegment();
+  if (!segment) return nullptr;
+
+  std::vector<uint8_t> data;
+  segment->Range(ToHttpRange(0, kProbeSize));
+  segment->HasByteRange(true);
+  DownloadIndexData(segment.get(), &data);
+  WebmSegmentInfo info;
+  if (!ParseWebmHeader(data, &info) || info.cues_position == 0)
+    return nullptr;
+
+  // Size of Cues is read from their header, the probe usually holds all of
+  // them.
+  uint64_t cues_begin = info.data_offset + info.cues_position;
+  segment->Range(ToHttpRange(cues_begin, kProbeSize));
+  DownloadIndexData(segment.get(), &data);
+  const uint8_t* stream = data.data();
+  uint32_t id;
+  uint64_t size;
+  if (!NextEbmlElement(stream, stream + data.size(), &id, &size) ||
+      id != kCuesId || size == kEbmlUnknownSize)
+    return nullptr;
+
+  uint64_t cues_size = (stream - data.data()) + size;
+  segment->Range(ToHttpRange(cues_begin, cues_size));
+  if (cues_data && cues_size <= data.size())
+    cues_data->assign(data.begin(), data.begin() + cues_size);
+  return segment;
+}
+
+bool SegmentBaseIndex::LoadWebmSegmentInfo(WebmSegmentInfo* info) const {
+  if (!init_data_.empty()) return ParseWebmHeader(init_data_, info);
+
+  auto segment = GetInitializationSegment();
+  if (!segment) {
+    segment = GetBaseSegment();
+    if (!segment) return false;
+    segment->Range(ToHttpRange(0, kProbeSize));
+    segment->HasByteRange(true);
+  }
+  std::vector<uint8_t> data;
+  return DownloadIndexData(segment.get(), &data) &&
+         ParseWebmHeader(data, info);
+}
+
+bool SegmentBaseIndex::LoadIndexSegment() {
+  using dash::mpd::ISegment;
+  using dash::network::IChunk;
+  std::vector<uint8_t> data;
+  auto segment = GetRepresentationIndexSegment();
+  if (!segment) segment = std::move(GetIndexSegment());
+  // sidx is returned in data if it fits in the probed range.
+  if (!segment) segment = std::move(FindIndexSegmentInMp4(&data));
+  if (!segment) segment = std::move(FindIndexSegmentInWebm(&data));
+
+  // No index segment, there is nothing to retry.
+  if (!segment) return true;
+
+  auto chunk = static_cast<IChunk*>(segment.get());
+  std::string range = chunk->Range();
+  size_t pos = range.find("-");
+  if (pos == std::string::npos) return true;
+
+  uint32_t sidx_beg = std::stoul(range.substr(0, pos));
+  uint32_t sidx_end = std::stoul(range.substr(pos + 1));
+  uint64_t init_size = CombinedInitSize();
+  if (data.empty() && init_size > 0 && init_size == sidx_beg) {
+    // The initialization segment is all data before sidx, so both come
+    // with one request and GetInitData() doesn't download it again.
+    auto combined = GetBaseSegment();
+    if (!combined) return false;
+
+    combined->Range(ToHttpRange(0, sidx_end + 1));
+    combined->HasByteRange(true);
+    DownloadIndexData(combined.get(), &data);
+    if (data.size() <= init_size) return false;
+
+    init_data_.assign(data.begin(), data.begin() + init_size);
+    data.erase(data.begin(), data.begin() + init_size);
+  }
+  if (data.empty()) DownloadIndexData(segment.get(), &data);
+  if (data.empty()) return false;
+
+  std::vector<SegmentIndexEntry> references;
+  if (IsWebmCues(data)) {
+    WebmSegmentInfo info;
+    if (!LoadWebmSegmentInfo(&info)) return false;
+    if (!ParseCues(data, sidx_beg, info, &references)) {
+      LOG_ERROR("Failed to parse Cues");
+      return true;
+    }
+  } else if (!ParseSidx(data, sidx_beg, &references)) {
+    LOG_ERROR("Failed to parse sidx");
+    return true;
+  }
+
+  // References to other sidx boxes are loaded when they are played.
+  segment_index_ = CoalesceReferences(references);
+  sub_indexes_.resize(segment_index_.entries.size());
+
+  average_segment_duration_ = 0.0;
+  uint32_t segment_count = 0;
+  for (const auto& entry : segment_index_.entries) {
+    if (entry.is_index) continue;
+    ++segment_count;
+    average_segment_duration_ +=
+        (entry.duration - average_segment_duration_) / segment_count;
+  }
+  // Only sidx references, segments of the first one are played anyway.
+  if (segment_count == 0 && !segment_index_.entries.empty()) {
+    const SegmentIndex* first = SubIndex(0);
+    if (!first->entries.empty()) {
+      average_segment_duration_ = segment_index_.entries[0].duration /
+          first->entries.size();
+    }
+  }
+  return true;
+}
+
+std::unique_ptr<dash::mpd::ISegment> SegmentBaseIndex::GetBaseSegment()
+    const {
+  auto segment = CreateSegment(base_url_, segment_base_->initialization,
+                               dash::metrics::InitializationSegment);
+  if (segment) return segment;
+
+  return UrlSegment::Create(base_url_, std::string(),
+                            dash::metrics::MediaSegment);
+}
+
+std::unique_ptr<dash::mpd::ISegment>
+SegmentBaseIndex::GetInitializationSegment() const {
+  auto segment = CreateSegment(base_url_, segment_base_->initialization,
+                               dash::metrics::InitializationSegment);
+  if (segment || segment_base_->initialization.range.empty()) return segment;
+
+  return UrlSegment::Create(base_url_, segment_base_->initialization.range,
+                            dash::metrics::InitializationSegment);
+}
@@ -0,0 +1,186 @@
+/*!
+ * segment_base_index.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_PLAYER_ES_DASH_PLAYER_DASH_SEGMENT_BASE_INDEX_H_
+#define SRC_PLAYER_ES_DASH_PLAYER_DASH_SEGMENT_BASE_INDEX_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "libdash/libdash.h"
+#include "ppapi/utility/threading/lock.h"
+
+#include "segment_info.h"
+
+struct RepresentationDescription;
+
+struct SegmentIndexEntry {
+  double timestamp;
+  double duration;
+  uint64_t byte_offset;
+  uint64_t byte_size;
+  // Set for a reference to another sidx box, which indexes this range.
+  bool is_index;
+  // Stream access point of the reference, as described in the sidx box.
+  bool starts_with_sap;
+  uint8_t sap_type;
+  double sap_delta_time;
+  // Times of decodable stream access points of coalesced references, i.e.
+  // keyframes which a seek inside the segment can start at.
+  std::vector<double> access_points;
+};
+
+// Parameters of a WebM Segment element, which Cues references depend on.
+struct WebmSegmentInfo {
+  // Position of the Segment payload, Cues positions are relative to it.
+  uint64_t data_offset;
+  // Size of the payload, 0 if it's unknown.
+  uint64_t data_size;
+  // Nanoseconds per timecode unit.
+  uint64_t timecode_scale;
+  // Duration of the Segment in seconds, 0 if it's unknown.
+  double duration;
+  // Position of Cues given by SeekHead, relative like Cues positions. 0 if
+  // SeekHead doesn't point at Cues.
+  uint64_t cues_position;
+};
+
+// Segments indexed by a single sidx box, including ones indexed by sidx
+// boxes it references.
+struct SegmentIndex {
+  std::vector<SegmentIndexEntry> entries;
+  // Timestamps of entries, for a binary search by time.
+  std::vector<double> timestamps;
+};
+
+// Segment index (sidx box, or Cues of WebM) of a representation using
+// SegmentBase. It's
+// created by the manifest and shared with sequences of the representation,
+// so indexes can be downloaded in the background before they are needed.
+// Index is downloaded by Load(), which is called by other methods when
+// it's not loaded yet. It's thread safe, threads calling it while another
+// one downloads the index wait for it.
+class SegmentBaseIndex {
+ public:
+  explicit SegmentBaseIndex(const RepresentationDescription& desc);
+  ~SegmentBaseIndex();
+
+  // Downloads and parses the top level sidx box, unless it's already done.
+  // Returns false if the representation has no usable index. A failed
+  // download is retried by next calls up to kMaxLoadAttempts times.
+  bool Load();
+
+  // Number of top level sidx references.
+  uint32_t size();
+  // Number of segments of a top level reference.
+  uint32_t SegmentCount(uint32_t index);
+  // Returns null for an invalid position.
+  const SegmentIndexEntry* Entry(uint32_t index, uint32_t sub_index);
+  // Finds a segment containing time. Only the sidx box indexing the given
+  // time is downloaded. Returns false if there is no such segment.
+  bool FindSegment(double time, uint32_t* index, uint32_t* sub_index);
+  double AverageSegmentDuration();
+
+  // Provides the initialization segment when it's right before the sidx box
+  // and has no URL of its own. Both are downloaded with a single request
+  // then, which loads the index if it's not loaded yet. Returns false when
+  // the initialization segment has to be downloaded separately.
+  bool GetInitData(std::vector<uint8_t>* data);
+
+  // Returns a segment without a range, pointing to the media.
+  std::unique_ptr<dash::mpd::ISegment> GetBaseSegment() const;
+  // Returns the initialization segment when it has a URL of its own or a
+  // range of the media given by Initialization@range, null otherwise.
+  std::unique_ptr<dash::mpd::ISegment> GetInitializationSegment() const;
+  std::unique_ptr<dash::mpd::ISegment> GetRepresentationIndexSegment() const;
+  std::unique_ptr<dash::mpd::ISegment> GetIndexSegment() const;
+
+ private:
+  // Parses the first sidx box of data, which starts at data_begin of the
+  // media. Returns false if there is no sidx or it's malformed.
+  static bool ParseSidx(const std::vector<uint8_t>& data, uint64_t data_begin,
+                        std::vector<SegmentIndexEntry>* references);
+  // Reads the position of the Segment payload, its timing and the position
+  // of Cues from the start of a WebM file. Returns false if data is not
+  // WebM.
+  static bool ParseWebmHeader(const std::vector<uint8_t>& data,
+                              WebmSegmentInfo* info);
+  // Makes a reference of each cluster pointed at by Cues. Cues found at
+  // cues_begin delimit the last cluster, unless they precede clusters.
+  // Returns false if Cues are malformed.
+  static bool ParseCues(const std::vector<uint8_t>& cues, uint64_t cues_begin,
+                        const WebmSegmentInfo& info,
+                        std::vector<SegmentIndexEntry>* references);
+  // Joins adjacent sidx references into segments, so a few of them can be
+  // fetched with a single ranged request. Each segment starts with a stream
+  // access point, so a seek to its beginning can be decoded.
+  static SegmentIndex CoalesceReferences(
+      const std::vector<SegmentIndexEntry>& references);
+  // Walks top level boxes looking for sidx. Its data is stored in sidx_data
+  // when already downloaded.
+  std::unique_ptr<dash::mpd::ISegment> FindIndexSegmentInMp4(
+      std::vector<uint8_t>* sidx_data) const;
+  // Walks SeekHead of a WebM file looking for Cues. Their data is stored in
+  // cues_data when already downloaded.
+  std::unique_ptr<dash::mpd::ISegment> FindIndexSegmentInWebm(
+      std::vector<uint8_t>* cues_data) const;
+  // Downloads the initialization segment (or the start of the media when
+  // there is none) and parses it with ParseWebmHeader(). The one
+  // downloaded together with the index is used when it's there, so
+  // load_lock_ must be locked.
+  bool LoadWebmSegmentInfo(WebmSegmentInfo* info) const;
+  // Returns the offset of sidx when the initialization segment is all data
+  // before it, 0 otherwise.
+  uint64_t CombinedInitSize() const;
+  // load_lock_ must be locked. Returns false if the index couldn't be
+  // downloaded.
+  bool LoadIndexSegment();
+  // Downloads the referenced sidx box and appends its references to given
+  // ones, following nested references up to kMaxSidxDepth.
+  bool LoadSubIndexReferences(const SegmentIndexEntry& entry, uint32_t depth,
+      std::vector<SegmentIndexEntry>* references) const;
+  // Returns segments of a top level sidx reference to another sidx box. They
+  // are downloaded when needed for the first time, an empty index is
+  // returned when download fails. It's null for other references. Index
+  // must be loaded.
+  const SegmentIndex* SubIndex(uint32_t index);
+
+  // Absolute base URL of the representation.
+  std::string base_url_;
+  std::shared_ptr<const SegmentBaseInfo> segment_base_;
+
+  // Guards fields below, it's held while the index is downloaded.
+  pp::Lock load_lock_;
+  bool loaded_;
+  uint32_t load_attempts_;
+  // Top level sidx box, it doesn't change once it's loaded.
+  SegmentIndex segment_index_;
+  double average_segment_duration_;
+  // Initialization segment downloaded together with sidx, see
+  // CombinedInitSize().
+  std::vector<uint8_t> init_data_;
+
+  // Guards sub_indexes_, which has an entry for each segment_index_ entry.
+  // Sub indexes don't change once they are loaded.
+  pp::Lock sub_indexes_lock_;
+  std::vector<std::unique_ptr<SegmentIndex>> sub_indexes_;
+};
+
+#endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_SEGMENT_BASE_INDEX_H_
@@ -23,22 +23,16 @@
 #include "dash/media_segment_sequence.h"
 
 #include <memory>
+#include <string>
 #include <vector>
-#include <cstdlib>
-#include <sstream>
 
-#include "sequence_iterator.h"
+#include "segment_base_index.h"
 #include "util.h"
 
-class SegmentBaseIterator;
 struct RepresentationDescription;
 
-struct SegmentIndexEntry {
-  double timestamp;
-  double duration;
-  uint64_t byte_offset;
-  uint64_t byte_size;
-};
+// Position::index points to a top level sidx reference and
+// Position::sub_index to a segment of a reference to another sidx box.
 
 class SegmentBaseSequence : public MediaSegmentSequence {
  public:
@@ -53,6 +47,8 @@ class SegmentBaseSequence : public MediaSegmentSequence {
 
   std::unique_ptr<dash::mpd::ISegment> GetInitSegment() const override;
 
+  bool GetInitSegmentData(std::vector<uint8_t>* data) const override;
+
   std::unique_ptr<dash::mpd::ISegment> GetBitstreamSwitchingSegment()
       const override;
 
@@ -63,57 +59,30 @@ class SegmentBaseSequence : public MediaSegmentSequence {
 
   double AverageSegmentDuration() const override;
 
- private:
-  void ParseSidx(const std::vector<uint8_t>& sidx, uint64_t sidx_begin,
-                 uint64_t sidx_end);
-  std::unique_ptr<dash::mpd::ISegment> FindIndexSegmentInMp4();
-  void LoadIndexSegment();
-  double Duration(uint32_t segment) const;
-  double Timestamp(uint32_t segment) const;
-  std::unique_ptr<dash::mpd::ISegment> GetBaseSegment() const;
-
-  std::vector<dash::mpd::IBaseUrl*> base_urls_;
-  dash::mpd::ISegmentBase* segment_base_;
-  std::vector<SegmentIndexEntry> segment_index_;
-  double average_segment_duration_;
-
-  friend class SegmentBaseIterator;
-};
-
-class SegmentBaseIterator : public SequenceIterator {
- public:
-  SegmentBaseIterator();
-  SegmentBaseIterator(const SegmentBaseSequence*, uint32_t current_index);
-  virtual ~SegmentBaseIterator() = default;
-
-  std::unique_ptr<SequenceIterator> Clone() const override;
-  void NextSegment() override;
-  void PrevSegment() override;
-  std::unique_ptr<dash::mpd::ISegment> Get() const override;
-  bool Equals(const SequenceIterator&) const override;
-
-  double SegmentDuration(const MediaSegmentSequence*) const override;
-  double SegmentTimestamp(const MediaSegmentSequence*) const override;
-
-  bool operator==(const SegmentBaseIterator&) const;
-
-  SegmentBaseIterator(SegmentBaseIterator&&) = delete;
-  SegmentBaseIterator& operator=(const SegmentBaseIterator&) = delete;
-  SegmentBaseIterator& operator=(SegmentBaseIterator&&) = delete;
-  SegmentBaseIterator(const SegmentBaseIterator&) = default;
-
  protected:
-  bool EqualsTo(const SegmentBaseIterator&) const override;
+  void NextSegment(Position* position) const override;
+  void PrevSegment(Position* position) const override;
+  std::unique_ptr<dash::mpd::ISegment> SegmentAt(
+      const Position& position) const override;
+  bool DescriptorAt(const Position& position,
+                    SegmentDescriptor* descriptor) const override;
+  uint64_t SizeAt(const Position& position) const override;
+  std::vector<double> KeyframesAt(const Position& position) const override;
+  double DurationAt(const Position& position) const override;
+  double TimestampAt(const Position& position) const override;
 
  private:
-
-  const SegmentBaseSequence* sequence_;
-  uint32_t current_index_;
+  // Returns a byte range of the segment, empty for an invalid position.
+  std::string RangeAt(const Position& position) const;
+
+  // Absolute base URL of the representation.
+  std::string base_url_;
+  std::shared_ptr<const SegmentBaseInfo> segment_base_;
+  // Shared with the manifest, which may load it in the background. Sequence
+  // creates its own one when the description has none.
+  std::shared_ptr<SegmentBaseIndex> index_;
+  // Absolute URL of the media, which all segments share.
+  std::string media_url_;
 };
 
-inline bool operator!=(const SegmentBaseIterator& lhs,
-                       const SegmentBaseIterator& rhs) {
-  return !(lhs == rhs);
-}
-
 #endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_SEGMENT_BASE_SEQUENCE_H_
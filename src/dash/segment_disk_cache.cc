@@ -0,0 +1,215 @@
+/*!
+ * segment_disk_cache.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include "segment_disk_cache.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include "common.h"
+
+using pp::AutoLock;
+
+namespace {
+
+constexpr const char* kSubdirectory = "/segments";
+constexpr const char* kFilePrefix = "segment_";
+constexpr const char* kMagic = "NPSC1";
+// Bigger segments would evict many small ones.
+constexpr uint32_t kMaxDataSize = 8 * 1024 * 1024;
+constexpr time_t kMaxAge = 7 * 24 * 60 * 60;  // in seconds
+
+std::string KeyFor(const SegmentDescriptor& segment) {
+  if (segment.range.empty()) return segment.url;
+
+  return segment.url + "#" + segment.range;
+}
+
+std::string FileNameFor(const std::string& key) {
+  return kFilePrefix + StorageFileName(key);
+}
+
+template <typename T>
+bool ReadField(FILE* file, T* field) {
+  return ReadStorageField(file, kMaxDataSize, field);
+}
+
+}  // namespace
+
+constexpr uint64_t SegmentDiskCache::kByteBudget;
+constexpr double SegmentDiskCache::kCachedHeadDuration;
+
+SegmentDiskCache& SegmentDiskCache::Get() {
+  static SegmentDiskCache cache;
+  return cache;
+}
+
+SegmentDiskCache::SegmentDiskCache()
+    : index_loaded_(false),
+      cached_bytes_(0) {}
+
+bool SegmentDiskCache::LoadIndex() {
+  if (index_loaded_) return !dir_.empty();
+
+  index_loaded_ = true;
+  std::string storage = GetTemporaryStorageDir();
+  if (storage.empty()) return false;
+
+  std::string dir = storage + kSubdirectory;
+  mkdir(dir.c_str(), 0777);
+  DIR* listing = opendir(dir.c_str());
+  if (!listing) {
+    LOG_ERROR("Can't open segment cache directory %s", dir.c_str());
+    return false;
+  }
+  dir_ = dir;
+
+  time_t now = time(nullptr);
+  std::vector<std::string> expired;
+  while (struct dirent* entry = readdir(listing)) {
+    std::string name = entry->d_name;
+    if (name.compare(0, strlen(kFilePrefix), kFilePrefix) != 0) continue;
+
+    struct stat info;
+    if (stat((dir_ + "/" + name).c_str(), &info) != 0) continue;
+    if (now - info.st_mtime > kMaxAge) {
+      expired.push_back(name);
+      continue;
+    }
+    files_[name] = FileInfo{static_cast<uint64_t>(info.st_size),
+                            info.st_mtime};
+    cached_bytes_ += info.st_size;
+  }
+  closedir(listing);
+
+  for (const auto& name : expired)
+    remove((dir_ + "/" + name).c_str());
+  LOG_INFO("Segment disk cache: %zu files, %llu bytes, %zu expired",
+           files_.size(), static_cast<unsigned long long>(cached_bytes_),
+           expired.size());
+  EvictOverBudget();
+  return true;
+}
+
+bool SegmentDiskCache::Lookup(const SegmentDescriptor& segment,
+                              std::vector<uint8_t>* data) {
+  std::string key = KeyFor(segment);
+  if (key.empty()) return false;
+
+  AutoLock lock(lock_);
+  if (!LoadIndex()) return false;
+
+  std::string name = FileNameFor(key);
+  auto it = files_.find(name);
+  if (it == files_.end()) return false;
+
+  time_t now = time(nullptr);
+  if (now - it->second.last_use > kMaxAge) {
+    RemoveFile(name);
+    return false;
+  }
+
+  FILE* file = fopen((dir_ + "/" + name).c_str(), "rb");
+  if (!file) {
+    RemoveFile(name);
+    return false;
+  }
+  std::string magic;
+  std::string cached_key;
+  std::vector<uint8_t> cached;
+  bool ok = ReadField(file, &magic) && magic == kMagic &&
+            ReadField(file, &cached_key) && cached_key == key &&
+            ReadField(file, &cached);
+  fclose(file);
+  if (!ok) {
+    // Another key with the same hash is not removed.
+    if (cached_key != key && !cached_key.empty()) return false;
+    RemoveFile(name);
+    return false;
+  }
+
+  it->second.last_use = now;
+  LOG_DEBUG("Read a cached segment of %s", key.c_str());
+  *data = std::move(cached);
+  return true;
+}
+
+void SegmentDiskCache::Put(const SegmentDescriptor& segment,
+                           const std::vector<uint8_t>& data) {
+  std::string key = KeyFor(segment);
+  if (key.empty() || data.empty() || data.size() > kMaxDataSize) return;
+
+  AutoLock lock(lock_);
+  if (!LoadIndex()) return;
+
+  std::string name = FileNameFor(key);
+  std::string path = dir_ + "/" + name;
+  if (files_.count(name)) RemoveFile(name);
+  FILE* file = fopen(path.c_str(), "wb");
+  if (!file) {
+    LOG_ERROR("Can't create segment cache file %s", path.c_str());
+    return;
+  }
+
+  bool ok = WriteStorageField(file, kMagic, strlen(kMagic)) &&
+            WriteStorageField(file, key) &&
+            WriteStorageField(file, data.data(), data.size());
+  if (fclose(file) != 0 || !ok) {
+    // The storage is likely full, the next put evicts more.
+    LOG_ERROR("Can't write segment cache file %s", path.c_str());
+    remove(path.c_str());
+    return;
+  }
+
+  uint64_t size = 3 * sizeof(uint32_t) + strlen(kMagic) + key.size() +
+                  data.size();
+  files_[name] = FileInfo{size, time(nullptr)};
+  cached_bytes_ += size;
+  EvictOverBudget();
+}
+
+void SegmentDiskCache::RemoveFile(const std::string& name) {
+  auto it = files_.find(name);
+  if (it == files_.end()) return;
+
+  remove((dir_ + "/" + name).c_str());
+  cached_bytes_ -= it->second.size;
+  files_.erase(it);
+}
+
+void SegmentDiskCache::EvictOverBudget() {
+  if (cached_bytes_ <= kByteBudget) return;
+
+  std::vector<std::pair<time_t, std::string>> by_use;
+  by_use.reserve(files_.size());
+  for (const auto& file : files_)
+    by_use.emplace_back(file.second.last_use, file.first);
+  std::sort(by_use.begin(), by_use.end());
+  for (const auto& file : by_use) {
+    if (cached_bytes_ <= kByteBudget) break;
+    RemoveFile(file.second);
+  }
+}
@@ -0,0 +1,80 @@
+/*!
+ * segment_disk_cache.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_PLAYER_ES_DASH_PLAYER_DASH_SEGMENT_DISK_CACHE_H_
+#define SRC_PLAYER_ES_DASH_PLAYER_DASH_SEGMENT_DISK_CACHE_H_
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ppapi/utility/threading/lock.h"
+
+#include "dash/media_segment_sequence.h"
+
+// A second tier behind the in-memory segment caches, in a temporary HTML5
+// file system. It keeps data which is small, but needed before the playback
+// can start: initialization segments, segment indexes and the first seconds
+// of media segments, so replaying a recently played title doesn't wait for
+// the CDN. Files which weren't used for the longest are evicted to keep
+// within a byte budget and ones older than a week are dropped. It's thread
+// safe, but must not be used on the main thread.
+class SegmentDiskCache {
+ public:
+  static constexpr uint64_t kByteBudget = 48 * 1024 * 1024;
+  // Media segments starting earlier than that are worth caching.
+  static constexpr double kCachedHeadDuration = 30.;  // in seconds
+
+  static SegmentDiskCache& Get();
+
+  // Reads the cached data of segment. Returns false if it isn't cached.
+  bool Lookup(const SegmentDescriptor& segment, std::vector<uint8_t>* data);
+
+  // Stores data of segment, evicting other files if needed.
+  void Put(const SegmentDescriptor& segment, const std::vector<uint8_t>& data);
+
+ private:
+  struct FileInfo {
+    uint64_t size;
+    // Time the file was written or read last, in seconds since the epoch.
+    time_t last_use;
+  };
+
+  SegmentDiskCache();
+
+  // Returns false if the storage is not available. Files are listed on the
+  // first call. lock_ must be locked.
+  bool LoadIndex();
+  // Removes the file with the given name. lock_ must be locked.
+  void RemoveFile(const std::string& name);
+  // lock_ must be locked.
+  void EvictOverBudget();
+
+  pp::Lock lock_;
+  bool index_loaded_;
+  // An empty string if the storage is not available.
+  std::string dir_;
+  // Cached files by names.
+  std::unordered_map<std::string, FileInfo> files_;
+  uint64_t cached_bytes_;
+};
+
+#endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_SEGMENT_DISK_CACHE_H_
@@ -0,0 +1,109 @@
+/*!
+ * segment_info.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#include "segment_info.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+// libdash doesn't parse the attribute, it's kept with raw ones.
+const char kAvailabilityTimeOffsetAttribute[] = "availabilityTimeOffset";
+
+SegmentUrlInfo ExtractUrl(const dash::mpd::IURLType* url) {
+  if (!url) return {};
+
+  return {url->GetSourceURL(), url->GetRange()};
+}
+
+void FillSegmentBase(const dash::mpd::ISegmentBase* segment_base,
+                     SegmentBaseInfo* info) {
+  info->timescale = segment_base->GetTimescale();
+  info->presentation_time_offset = segment_base->GetPresentationTimeOffset();
+  info->index_range = segment_base->GetIndexRange();
+  info->initialization = ExtractUrl(segment_base->GetInitialization());
+  info->representation_index =
+      ExtractUrl(segment_base->GetRepresentationIndex());
+
+  const auto attributes = segment_base->GetRawAttributes();
+  auto offset = attributes.find(kAvailabilityTimeOffsetAttribute);
+  // "INF" (all segments are available) is parsed as infinity.
+  info->availability_time_offset = offset != attributes.end()
+      ? std::max(std::strtod(offset->second.c_str(), nullptr), 0.) : 0.;
+}
+
+void FillMultipleSegmentBase(
+    const dash::mpd::IMultipleSegmentBase* segment_base,
+    MultipleSegmentBaseInfo* info) {
+  FillSegmentBase(segment_base, info);
+  info->duration = segment_base->GetDuration();
+  info->start_number = segment_base->GetStartNumber();
+  info->has_timeline = segment_base->GetSegmentTimeline() != nullptr;
+  info->timeline = ExtractSegmentTimeline(segment_base->GetSegmentTimeline());
+}
+
+}  // namespace
+
+std::shared_ptr<const SegmentBaseInfo> ExtractSegmentBase(
+    const dash::mpd::ISegmentBase* segment_base) {
+  if (!segment_base) return {};
+
+  auto info = std::make_shared<SegmentBaseInfo>();
+  FillSegmentBase(segment_base, info.get());
+  return info;
+}
+
+std::shared_ptr<const SegmentListInfo> ExtractSegmentList(
+    const dash::mpd::ISegmentList* segment_list) {
+  if (!segment_list) return {};
+
+  auto info = std::make_shared<SegmentListInfo>();
+  FillMultipleSegmentBase(segment_list, info.get());
+  info->segment_urls.reserve(segment_list->GetSegmentURLs().size());
+  for (const auto url : segment_list->GetSegmentURLs())
+    info->segment_urls.push_back({url->GetMediaURI(), url->GetMediaRange()});
+  return info;
+}
+
+std::shared_ptr<const SegmentTemplateInfo> ExtractSegmentTemplate(
+    const dash::mpd::ISegmentTemplate* segment_template) {
+  if (!segment_template) return {};
+
+  auto info = std::make_shared<SegmentTemplateInfo>();
+  FillMultipleSegmentBase(segment_template, info.get());
+  info->media = segment_template->Getmedia();
+  info->initialization_template = segment_template->Getinitialization();
+  info->bitstream_switching_template =
+      segment_template->GetbitstreamSwitching();
+  return info;
+}
+
+std::vector<SegmentTimelineElement> ExtractSegmentTimeline(
+    const dash::mpd::ISegmentTimeline* timeline) {
+  std::vector<SegmentTimelineElement> elements;
+  if (!timeline) return elements;
+
+  elements.reserve(timeline->GetTimelines().size());
+  for (const auto element : timeline->GetTimelines()) {
+    elements.push_back({element->GetStartTime(), element->GetDuration(),
+                        element->GetRepeatCount()});
+  }
+  return elements;
+}
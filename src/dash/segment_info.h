@@ -0,0 +1,90 @@
+/*!
+ * segment_info.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_PLAYER_ES_DASH_PLAYER_DASH_SEGMENT_INFO_H_
+#define SRC_PLAYER_ES_DASH_PLAYER_DASH_SEGMENT_INFO_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "libdash/libdash.h"
+
+#include "segment_timeline.h"
+
+// Segment information elements of a manifest, copied out of the libdash
+// object tree, so the tree can be freed once the manifest is processed.
+// Only fields the sequences use are kept. They don't change once they are
+// created and are shared by representations inheriting the same element.
+
+// An URLType element (e.g. Initialization) or a SegmentURL. URL is relative
+// to the base URL of the representation, it's empty when the element is
+// missing.
+struct SegmentUrlInfo {
+  std::string url;
+  std::string range;
+};
+
+// Attributes of SegmentBase, shared by SegmentList and SegmentTemplate.
+struct SegmentBaseInfo {
+  uint32_t timescale;
+  uint64_t presentation_time_offset;
+  std::string index_range;
+  SegmentUrlInfo initialization;
+  SegmentUrlInfo representation_index;
+  // @availabilityTimeOffset in seconds, 0 when it's missing. Low-latency
+  // live streams set it, so segments are requested while they are produced
+  // and downloaded in chunks.
+  double availability_time_offset;
+};
+
+// Attributes shared by SegmentList and SegmentTemplate.
+struct MultipleSegmentBaseInfo : SegmentBaseInfo {
+  uint32_t duration;
+  uint32_t start_number;
+  // Set when the element has a SegmentTimeline, which may be empty.
+  bool has_timeline;
+  std::vector<SegmentTimelineElement> timeline;
+};
+
+struct SegmentListInfo : MultipleSegmentBaseInfo {
+  std::vector<SegmentUrlInfo> segment_urls;
+};
+
+struct SegmentTemplateInfo : MultipleSegmentBaseInfo {
+  // URL templates, empty when the attribute is missing.
+  std::string media;
+  std::string initialization_template;
+  std::string bitstream_switching_template;
+};
+
+// Functions below return null for a null element.
+std::shared_ptr<const SegmentBaseInfo> ExtractSegmentBase(
+    const dash::mpd::ISegmentBase* segment_base);
+std::shared_ptr<const SegmentListInfo> ExtractSegmentList(
+    const dash::mpd::ISegmentList* segment_list);
+std::shared_ptr<const SegmentTemplateInfo> ExtractSegmentTemplate(
+    const dash::mpd::ISegmentTemplate* segment_template);
+
+// Returns S elements of the timeline, none for a null one.
+std::vector<SegmentTimelineElement> ExtractSegmentTimeline(
+    const dash::mpd::ISegmentTimeline* timeline);
+
+#endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_SEGMENT_INFO_H_
@@ -23,25 +23,26 @@
 #include <limits>
 #include <vector>
 
+#include "url_segment.h"
 #include "util.h"
 
 SegmentListSequence::SegmentListSequence(const RepresentationDescription& desc,
-                                         uint32_t)
-    : base_urls_(desc.base_urls),
+                                         uint32_t bandwidth)
+    : MediaSegmentSequence(desc.representation_id, desc.codecs, bandwidth),
       segment_list_(desc.segment_list),
-      segment_duration_(0.0) {
+      segment_duration_(0.0),
+      base_url_(ResolveBaseUrl(desc.base_urls)) {
   ExtractSegmentDuration();
 }
 
 SegmentListSequence::~SegmentListSequence() {}
 
 MediaSegmentSequence::Iterator SegmentListSequence::Begin() const {
-  return MakeIterator<SegmentListIterator>(this, 0);
+  return Iterator(this, 0);
 }
 
 MediaSegmentSequence::Iterator SegmentListSequence::End() const {
-  auto& urls = segment_list_->GetSegmentURLs();
-  return MakeIterator<SegmentListIterator>(this, urls.size());
+  return Iterator(this, segment_list_->segment_urls.size());
 }
 
 MediaSegmentSequence::Iterator SegmentListSequence::MediaSegmentForTime(
@@ -50,17 +51,15 @@ MediaSegmentSequence::Iterator SegmentListSequence::MediaSegmentForTime(
     return End();
 
   uint32_t index = static_cast<uint32_t>(floor(time / segment_duration_));
-  if (index >= segment_list_->GetSegmentURLs().size()) return End();
+  if (index >= segment_list_->segment_urls.size()) return End();
 
-  return MakeIterator<SegmentListIterator>(this, index);
+  return Iterator(this, index);
 }
 
 std::unique_ptr<dash::mpd::ISegment> SegmentListSequence::GetInitSegment()
     const {
-  const dash::mpd::IURLType* url = segment_list_->GetInitialization();
-  if (!url) return {};
-
-  return AdoptUnique(url->ToSegment(base_urls_));
+  return CreateSegment(base_url_, segment_list_->initialization,
+                       dash::metrics::InitializationSegment);
 }
 
 std::unique_ptr<dash::mpd::ISegment>
@@ -81,76 +80,47 @@ std::unique_ptr<dash::mpd::ISegment> SegmentListSequence::GetIndexSegment()
 void SegmentListSequence::ExtractSegmentDuration() {
   if (!segment_list_) return;
 
-  segment_duration_ = segment_list_->GetDuration();
-  if (segment_list_->GetTimescale() > 0)
-    segment_duration_ /= segment_list_->GetTimescale();
+  segment_duration_ = segment_list_->duration;
+  if (segment_list_->timescale > 0)
+    segment_duration_ /= segment_list_->timescale;
 }
 
 double SegmentListSequence::AverageSegmentDuration() const {
   return segment_duration_;
 }
 
-double SegmentListSequence::Timestamp(uint32_t index) const {
-  if (segment_list_->GetSegmentTimeline()) {
-    auto& timelines = segment_list_->GetSegmentTimeline()->GetTimelines();
-
-    if (index < timelines.size()) {
-      double timestamp = static_cast<double>(timelines[index]->GetStartTime());
-      return segment_list_->GetTimescale() == 0
-                 ? timestamp
-                 : timestamp / segment_list_->GetTimescale();
-    }
-  }
-  return segment_duration_ * index;
-}
-
-SegmentListIterator::SegmentListIterator()
-    : sequence_(NULL), current_index_(0) {}
-
-SegmentListIterator::SegmentListIterator(const SegmentListSequence* seq,
-                                         uint32_t current_index)
-    : sequence_(seq), current_index_(current_index) {}
-
-std::unique_ptr<SequenceIterator> SegmentListIterator::Clone() const {
-  return MakeUnique<SegmentListIterator>(*this);
-}
-
-void SegmentListIterator::NextSegment() { ++current_index_; }
+std::unique_ptr<dash::mpd::ISegment> SegmentListSequence::SegmentAt(
+    const Position& position) const {
+  auto& urls = segment_list_->segment_urls;
+  if (position.index >= urls.size()) return {};
 
-void SegmentListIterator::PrevSegment() { --current_index_; }
-
-std::unique_ptr<dash::mpd::ISegment> SegmentListIterator::Get() const {
-  auto& urls = sequence_->segment_list_->GetSegmentURLs();
-  if (current_index_ >= urls.size()) return {};
-
-  return AdoptUnique(
-      urls[current_index_]->ToMediaSegment(sequence_->base_urls_));
-}
-
-bool SegmentListIterator::Equals(const SequenceIterator& it) const {
-  return it.EqualsTo(*this);
-}
-
-double SegmentListIterator::SegmentDuration(
-    const MediaSegmentSequence* sequence) const {
-  if (!sequence_ || sequence_ != sequence)
-    return MediaSegmentSequence::kInvalidSegmentDuration;
-
-  return sequence_->Duration(current_index_);
+  const SegmentUrlInfo& url = urls[position.index];
+  return UrlSegment::Create(CombineUrl(base_url_, url.url), url.range,
+                            dash::metrics::MediaSegment);
 }
 
-double SegmentListIterator::SegmentTimestamp(
-    const MediaSegmentSequence* sequence) const {
-  if (!sequence_ || sequence_ != sequence)
-    return MediaSegmentSequence::kInvalidSegmentDuration;
+bool SegmentListSequence::DescriptorAt(const Position& position,
+    SegmentDescriptor* descriptor) const {
+  auto& urls = segment_list_->segment_urls;
+  if (position.index >= urls.size()) return false;
 
-  return sequence_->Timestamp(current_index_);
+  const SegmentUrlInfo& url = urls[position.index];
+  descriptor->url = CombineUrl(base_url_, url.url);
+  descriptor->range = url.range;
+  return true;
 }
 
-bool SegmentListIterator::operator==(const SegmentListIterator& rhs) const {
-  return sequence_ == rhs.sequence_ && current_index_ == rhs.current_index_;
-}
+double SegmentListSequence::TimestampAt(const Position& position) const {
+  uint32_t index = position.index;
+  if (segment_list_->has_timeline) {
+    auto& timeline = segment_list_->timeline;
 
-bool SegmentListIterator::EqualsTo(const SegmentListIterator& it) const {
-  return *this == it;
+    if (index < timeline.size()) {
+      double timestamp = static_cast<double>(timeline[index].start_time);
+      return segment_list_->timescale == 0
+                 ? timestamp
+                 : timestamp / segment_list_->timescale;
+    }
+  }
+  return segment_duration_ * index;
 }
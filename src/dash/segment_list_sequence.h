@@ -22,9 +22,12 @@
 
 #include "dash/media_segment_sequence.h"
 
-#include <vector>
+#include <memory>
+#include <string>
 
-#include "sequence_iterator.h"
+#include "libdash/libdash.h"
+
+#include "segment_info.h"
 
 struct RepresentationDescription;
 
@@ -51,51 +54,23 @@ class SegmentListSequence : public MediaSegmentSequence {
 
   double AverageSegmentDuration() const override;
 
+ protected:
+  std::unique_ptr<dash::mpd::ISegment> SegmentAt(
+      const Position& position) const override;
+  bool DescriptorAt(const Position& position,
+                    SegmentDescriptor* descriptor) const override;
+  double DurationAt(const Position&) const override {
+    return segment_duration_;
+  }
+  double TimestampAt(const Position& position) const override;
+
  private:
   void ExtractSegmentDuration();
-  double Duration(uint32_t) const { return segment_duration_; }
-  double Timestamp(uint32_t index) const;
 
-  std::vector<dash::mpd::IBaseUrl*> base_urls_;
-  dash::mpd::ISegmentList* segment_list_;
+  std::shared_ptr<const SegmentListInfo> segment_list_;
   double segment_duration_;
-
-  friend class SegmentListIterator;
-};
-
-class SegmentListIterator : public SequenceIterator {
- public:
-  SegmentListIterator();
-  SegmentListIterator(const SegmentListSequence*, uint32_t current_index);
-  virtual ~SegmentListIterator() = default;
-
-  std::unique_ptr<SequenceIterator> Clone() const override;
-  void NextSegment() override;
-  void PrevSegment() override;
-  std::unique_ptr<dash::mpd::ISegment> Get() const override;
-  bool Equals(const SequenceIterator&) const override;
-
-  double SegmentDuration(const MediaSegmentSequence*) const override;
-  double SegmentTimestamp(const MediaSegmentSequence*) const override;
-
-  bool operator==(const SegmentListIterator&) const;
-
-  SegmentListIterator(SegmentListIterator&&) = delete;
-  SegmentListIterator& operator=(const SegmentListIterator&) = delete;
-  SegmentListIterator& operator=(SegmentListIterator&&) = delete;
-  SegmentListIterator(const SegmentListIterator&) = default;
-
- protected:
-  bool EqualsTo(const SegmentListIterator&) const override;
-
- private:
-  const SegmentListSequence* sequence_;
-  uint32_t current_index_;
+  // Absolute base URL segment URLs are resolved against.
+  std::string base_url_;
 };
 
-inline bool operator!=(const SegmentListIterator& lhs,
-                       const SegmentListIterator& rhs) {
-  return !(lhs == rhs);
-}
-
 #endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_SEGMENT_LIST_SEQUENCE_H_
@@ -19,78 +19,142 @@
 
 #include "segment_template_sequence.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <limits>
+#include <string>
 
+#include "segment_timeline.h"
+#include "url_segment.h"
 #include "util.h"
 
+namespace {
+
+// Only the %0[width]d format tag is allowed by the spec, 0 is returned for
+// an empty or invalid one.
+size_t ParseWidth(const std::string& format) {
+  if (format.size() < 4 || format.compare(0, 2, "%0") != 0 ||
+      format.back() != 'd')
+    return 0;
+  return std::strtoul(format.c_str() + 2, nullptr, 10);
+}
+
+std::string FormatNumber(uint64_t value, size_t width) {
+  std::string digits = std::to_string(value);
+  if (digits.size() < width) digits.insert(0, width - digits.size(), '0');
+  return digits;
+}
+
+void AppendNumber(uint64_t value, size_t width, std::string* out) {
+  char digits[24];
+  int size = snprintf(digits, sizeof(digits), "%llu",
+                      static_cast<unsigned long long>(value));
+  if (size < 0) return;
+  if (static_cast<size_t>(size) < width) out->append(width - size, '0');
+  out->append(digits, size);
+}
+
+}  // namespace
+
 SegmentTemplateSequence::SegmentTemplateSequence(
     const RepresentationDescription& desc, uint32_t bandwidth)
-    : base_urls_(desc.base_urls),
+    : MediaSegmentSequence(desc.representation_id, desc.codecs, bandwidth),
+      base_url_(ResolveBaseUrl(desc.base_urls)),
       rep_id_(desc.representation_id),
       segment_template_(desc.segment_template),
+      media_tokens_(),
+      media_literals_size_(0),
       bandwidth_(bandwidth),
       start_index_(0),
       end_index_(std::numeric_limits<uint32_t>::max()),
-      segment_duration_(MediaSegmentSequence::kInvalidSegmentDuration) {
+      segment_duration_(MediaSegmentSequence::kInvalidSegmentDuration),
+      timeline_(desc.segment_timeline),
+      dynamic_(desc.dynamic),
+      availability_start_time_(desc.availability_start_time),
+      availability_time_offset_(0.),
+      time_shift_buffer_depth_(desc.time_shift_buffer_depth),
+      presentation_delay_(desc.presentation_delay),
+      period_end_(kInvalidDuration) {
   ExtractSegmentDuration();
   ExtractStartIndex();
-  CalculateSegmentStartTimes();
-  // FIXME compute end_index_, but it might require access to period!!!
+  if (segment_template_ && segment_duration_ > 0.) {
+    availability_time_offset_ = std::min(
+        segment_template_->availability_time_offset, segment_duration_);
+  }
+  CompileMediaTemplate();
+  if (!timeline_ && segment_template_->has_timeline) {
+    timeline_ =
+        std::make_shared<SegmentTimeline>(segment_template_->timescale);
+    timeline_->Update(segment_template_->timeline);
+  }
+  // Segments end with the period, also in dynamic presentations which
+  // duration is known, so no segment past the last one is requested.
+  if (desc.period_duration > 0.) {
+    period_end_ = PresentationTimeOffset(desc) + desc.period_duration;
+    if (!timeline_ &&
+        segment_duration_ > std::numeric_limits<double>::epsilon()) {
+      end_index_ = start_index_ + static_cast<uint32_t>(
+          ceil(desc.period_duration / segment_duration_ - kEps));
+    }
+  }
 }
 
 SegmentTemplateSequence::~SegmentTemplateSequence() {}
 
 MediaSegmentSequence::Iterator SegmentTemplateSequence::Begin() const {
-  return MakeIterator<SegmentTemplateIterator>(this, start_index_);
+  return Iterator(this, BeginIndex());
 }
 
 MediaSegmentSequence::Iterator SegmentTemplateSequence::End() const {
-  return MakeIterator<SegmentTemplateIterator>(this, end_index_);
+  return Iterator(this, EndIndex());
+}
+
+MediaSegmentSequence::Iterator SegmentTemplateSequence::StartSegment() const {
+  if (!dynamic_) return Begin();
+
+  double live_edge = timeline_ ? timeline_->EndSeconds() : LiveTime();
+  auto segment =
+      MediaSegmentForTime(std::max(live_edge - presentation_delay_, 0.));
+  if (segment == End()) return Begin();
+
+  return segment;
+}
+
+bool SegmentTemplateSequence::IsDynamic() const {
+  return dynamic_;
 }
 
 MediaSegmentSequence::Iterator SegmentTemplateSequence::MediaSegmentForTime(
     double time) const {
-  if (!segment_template_->GetSegmentTimeline()) {
+  if (!timeline_) {
     if (time < 0 || segment_duration_ <= std::numeric_limits<double>::epsilon())
       return End();
 
     auto index = static_cast<uint32_t>(floor(time / segment_duration_));
     index += start_index_;
-    if (index >= end_index_) return End();
+    if (index < BeginIndex() || index >= EndIndex()) return End();
 
-    return MakeIterator<SegmentTemplateIterator>(this, index);
-  }
-  for (uint32_t index = 0; index < segment_start_times_.size(); ++index) {
-    auto start_time = double(segment_start_times_.at(index).start_time_
-        / (segment_template_->GetTimescale() > 0
-            ? segment_template_->GetTimescale()
-            : 1));
-
-    auto duration = double(segment_start_times_.at(index).duration_
-        / (segment_template_->GetTimescale() > 0
-            ? segment_template_->GetTimescale()
-            : 1));
-    if (start_time <= time && start_time + duration >= time) {
-      index += start_index_;
-      return MakeIterator<SegmentTemplateIterator>(this, index);
-    }
+    return Iterator(this, index);
   }
-  return End();
+
+  uint32_t index = start_index_ + timeline_->FindIndex(time);
+  if (index >= EndIndex()) return End();
+
+  return Iterator(this, index);
 }
 
 std::unique_ptr<dash::mpd::ISegment> SegmentTemplateSequence::GetInitSegment()
     const {
-  auto segment = segment_template_->ToInitializationSegment(base_urls_, rep_id_,
-                                                            bandwidth_);
-  return AdoptUnique(segment);
+  return TemplateSegment(segment_template_->initialization_template,
+                         dash::metrics::InitializationSegment);
 }
 
 std::unique_ptr<dash::mpd::ISegment>
 SegmentTemplateSequence::GetBitstreamSwitchingSegment() const {
-  auto segment = segment_template_->ToBitstreamSwitchingSegment(
-      base_urls_, rep_id_, bandwidth_);
-  return AdoptUnique(segment);
+  return TemplateSegment(segment_template_->bitstream_switching_template,
+                         dash::metrics::BitstreamSwitchingSegment);
 }
 
 std::unique_ptr<dash::mpd::ISegment>
@@ -107,144 +171,221 @@ double SegmentTemplateSequence::AverageSegmentDuration() const {
   return segment_duration_;
 }
 
-std::unique_ptr<dash::mpd::ISegment>
-SegmentTemplateSequence::GetMediaSegmentFromNumber(uint32_t number) const {
-  if (number < start_index_ || number > end_index_)
-    return nullptr;
-
-  dash::mpd::ISegment *segment = nullptr;
-  if (segment_template_->GetSegmentTimeline()) {
-    number -= start_index_;  // passed index is not always zero-based
-
-    if (number < segment_start_times_.size()) {
-      auto start_time = segment_start_times_.at(number).start_time_;
-      segment = segment_template_->GetMediaSegmentFromTime(
-          base_urls_, rep_id_, bandwidth_, start_time);
-    }
-  } else {
-    segment = segment_template_->GetMediaSegmentFromNumber(
-        base_urls_, rep_id_, bandwidth_, number);
-  }
-  return AdoptUnique(segment);
+bool SegmentTemplateSequence::GetSegmentTiming(uint32_t number,
+                                               uint64_t* start_time) const {
+  if (number < start_index_ || number > EndIndex())
+    return false;
+
+  *start_time = 0;
+  // passed index is not always zero-based
+  return !timeline_ ||
+      timeline_->GetStartTime(number - start_index_, start_time);
 }
 
-void SegmentTemplateSequence::ExtractSegmentDuration() {
-  if (!segment_template_) return;
+std::unique_ptr<dash::mpd::ISegment> SegmentTemplateSequence::SegmentAt(
+    const Position& position) const {
+  SegmentDescriptor descriptor;
+  if (!DescriptorAt(position, &descriptor)) return {};
 
-  segment_duration_ = segment_template_->GetDuration();
-  if (segment_template_->GetTimescale() > 0)
-    segment_duration_ /= segment_template_->GetTimescale();
+  return UrlSegment::Create(descriptor.url, descriptor.range,
+                            dash::metrics::MediaSegment);
 }
 
-void SegmentTemplateSequence::ExtractStartIndex() {
+bool SegmentTemplateSequence::DescriptorAt(const Position& position,
+    SegmentDescriptor* descriptor) const {
+  uint64_t start_time;
+  if (!GetSegmentTiming(position.index, &start_time)) return false;
+
+  // Clearing keeps capacity of a descriptor which is reused by the caller.
+  descriptor->url.clear();
+  AppendMediaUrl(position.index, start_time, &descriptor->url);
+  descriptor->range.clear();
+  return true;
+}
+
+void SegmentTemplateSequence::ExtractSegmentDuration() {
   if (!segment_template_) return;
 
-  start_index_ = segment_template_->GetStartNumber();
+  segment_duration_ = segment_template_->duration;
+  if (segment_template_->timescale > 0)
+    segment_duration_ /= segment_template_->timescale;
 }
 
-double SegmentTemplateSequence::Timestamp(uint32_t index) const {
-  if (index < start_index_ || index > end_index_)
-    return kInvalidSegmentTimestamp;
+void SegmentTemplateSequence::CompileMediaTemplate() {
+  if (!segment_template_) return;
 
-  index -= start_index_;  // passed index is not always zero-based
+  media_tokens_ = CompileTemplate(segment_template_->media);
+  for (const auto& token : media_tokens_)
+    media_literals_size_ += token.literal.size();
+}
 
-  if (segment_template_->GetSegmentTimeline()) {
-    if (index < segment_start_times_.size()) {
-      auto start_time = segment_start_times_.at(index).start_time_;
-      return segment_template_->GetTimescale() == 0
-          ? start_time
-          : start_time / segment_template_->GetTimescale();
+// Identifiers of URL templates are described in 5.3.9.4.4 of the DASH spec.
+std::vector<SegmentTemplateSequence::MediaToken>
+SegmentTemplateSequence::CompileTemplate(
+    const std::string& url_template) const {
+  std::vector<MediaToken> tokens;
+  std::string literal;
+  auto end_literal = [&tokens, &literal]() {
+    if (literal.empty()) return;
+    tokens.push_back({MediaToken::Type::kLiteral, literal, 0});
+    literal.clear();
+  };
+
+  size_t pos = 0;
+  while (pos < url_template.size()) {
+    size_t begin = url_template.find('$', pos);
+    size_t end = begin != std::string::npos
+        ? url_template.find('$', begin + 1) : std::string::npos;
+    if (end == std::string::npos) {
+      literal.append(url_template, pos, std::string::npos);
+      break;
+    }
+    literal.append(url_template, pos, begin - pos);
+    pos = end + 1;
+
+    std::string identifier = url_template.substr(begin + 1, end - begin - 1);
+    size_t format_pos = identifier.find('%');
+    size_t width = format_pos != std::string::npos
+        ? ParseWidth(identifier.substr(format_pos)) : 0;
+    identifier = identifier.substr(0, format_pos);
+    if (identifier.empty() && format_pos == std::string::npos) {
+      literal.push_back('$');
+    } else if (identifier == "RepresentationID") {
+      literal.append(rep_id_);
+    } else if (identifier == "Bandwidth") {
+      literal.append(FormatNumber(bandwidth_, width));
+    } else if (identifier == "Number" || identifier == "Time") {
+      end_literal();
+      tokens.push_back({identifier == "Number"
+          ? MediaToken::Type::kNumber : MediaToken::Type::kTime,
+          std::string(), width});
+    } else {
+      // Unknown identifiers are left as they are.
+      literal.append(url_template, begin, end - begin + 1);
     }
-    return kInvalidSegmentTimestamp;
   }
-  return segment_duration_ * index;
+  end_literal();
+
+  // Numbers can't change whether the URL is absolute or starts with a slash,
+  // so the base URL is resolved once, like CombineUrl() would do it.
+  if (!tokens.empty() && tokens.front().type == MediaToken::Type::kLiteral) {
+    tokens.front().literal = CombineUrl(base_url_, tokens.front().literal);
+  } else if (!base_url_.empty()) {
+    std::string prefix = base_url_;
+    if (!tokens.empty() && prefix.back() != '/') prefix.push_back('/');
+    tokens.insert(tokens.begin(), {MediaToken::Type::kLiteral, prefix, 0});
+  }
+  return tokens;
 }
 
-double SegmentTemplateSequence::Duration(uint32_t index) const {
-  if (!segment_template_->GetSegmentTimeline())
-    return segment_duration_;
-
-  if (index < start_index_ || index > end_index_)
-    return kInvalidSegmentDuration;
-
-  index -= start_index_;  // passed index is not always zero-based
+void SegmentTemplateSequence::AppendMediaUrl(uint64_t number, uint64_t time,
+                                             std::string* out) const {
+  // Room for two 20 digit numbers is enough for usual templates.
+  out->reserve(out->size() + media_literals_size_ + 40);
+  AppendUrl(media_tokens_, number, time, out);
+}
 
-  // invalid duration for last segment
-  if (index < segment_start_times_.size()) {
-    auto duration = segment_start_times_.at(index).duration_;
-    return segment_template_->GetTimescale() == 0
-        ? duration
-        : duration / segment_template_->GetTimescale();
+void SegmentTemplateSequence::AppendUrl(
+    const std::vector<MediaToken>& tokens, uint64_t number, uint64_t time,
+    std::string* out) {
+  for (const auto& token : tokens) {
+    switch (token.type) {
+      case MediaToken::Type::kLiteral:
+        out->append(token.literal);
+        break;
+      case MediaToken::Type::kNumber:
+        AppendNumber(number, token.width, out);
+        break;
+      case MediaToken::Type::kTime:
+        AppendNumber(time, token.width, out);
+        break;
+    }
   }
-  return kInvalidSegmentDuration;
 }
 
-void SegmentTemplateSequence::CalculateSegmentStartTimes() {
-  if (!segment_template_->GetSegmentTimeline())
-    return;
+std::unique_ptr<dash::mpd::ISegment> SegmentTemplateSequence::TemplateSegment(
+    const std::string& url_template,
+    dash::metrics::HTTPTransactionType type) const {
+  if (url_template.empty()) return {};
+
+  // Initialization and bitstream switching templates don't depend on the
+  // segment, libdash substitutes 0 for $Number$ and $Time$ too.
+  std::string url;
+  AppendUrl(CompileTemplate(url_template), 0, 0, &url);
+  return UrlSegment::Create(url, std::string(), type);
+}
 
-  uint64_t end_time = 0;
-  auto& timelines = segment_template_->GetSegmentTimeline()->GetTimelines();
-  for (const auto &timeline : timelines) {
-    uint64_t start_time = timeline->GetStartTime();
-    uint64_t duration = timeline->GetDuration();
-    uint64_t repeat = timeline->GetRepeatCount();
+void SegmentTemplateSequence::ExtractStartIndex() {
+  if (!segment_template_) return;
 
-    if (start_time == 0)
-      start_time = end_time;
+  start_index_ = segment_template_->start_number;
+}
 
-    for (uint64_t j = 0; j <= repeat; ++j)
-      segment_start_times_.emplace_back(SegmentTimes(start_time + duration * j,
-                                        duration));
-    end_time = segment_start_times_.back().start_time_ + duration;
-  }
+double SegmentTemplateSequence::LiveTime() const {
+  return CurrentTimeInSeconds() - availability_start_time_;
 }
 
-SegmentTemplateIterator::SegmentTemplateIterator()
-    : sequence_(nullptr), current_index_(0) {}
+uint32_t SegmentTemplateSequence::BeginIndex() const {
+  if (timeline_) return start_index_ + timeline_->FirstIndex();
 
-SegmentTemplateIterator::SegmentTemplateIterator(
-    const SegmentTemplateSequence* seq, uint32_t current_index)
-    : sequence_(seq), current_index_(current_index) {}
+  if (!dynamic_ || time_shift_buffer_depth_ <= 0. ||
+      segment_duration_ <= std::numeric_limits<double>::epsilon())
+    return start_index_;
 
-std::unique_ptr<SequenceIterator> SegmentTemplateIterator::Clone() const {
-  return MakeUnique<SegmentTemplateIterator>(*this);
+  // Segments older than the time shift buffer are not available anymore.
+  double first_available = LiveTime() - time_shift_buffer_depth_;
+  if (first_available <= 0.) return start_index_;
+
+  return start_index_ +
+      static_cast<uint32_t>(ceil(first_available / segment_duration_));
 }
 
-void SegmentTemplateIterator::NextSegment() { ++current_index_; }
+uint32_t SegmentTemplateSequence::EndIndex() const {
+  if (timeline_) {
+    size_t end = timeline_->EndIndex();
+    // The last S element repeated until the end of the period (@r="-1")
+    // describes segments past it.
+    if (period_end_ > 0.) {
+      size_t last = timeline_->FindIndex(period_end_ - kEps);
+      if (last < end) end = last + 1;
+    }
+    return start_index_ + end;
+  }
 
-void SegmentTemplateIterator::PrevSegment() { --current_index_; }
+  if (!dynamic_ || segment_duration_ <= std::numeric_limits<double>::epsilon())
+    return end_index_;
 
-std::unique_ptr<dash::mpd::ISegment> SegmentTemplateIterator::Get() const {
-  return sequence_->GetMediaSegmentFromNumber(current_index_);
-}
+  // A segment is available once it's completely produced, or while it's
+  // produced in low-latency presentations.
+  double live_time = LiveTime() + availability_time_offset_;
+  if (live_time <= 0.) return start_index_;
 
-bool SegmentTemplateIterator::Equals(const SequenceIterator& it) const {
-  return it.EqualsTo(*this);
+  return std::min(end_index_, start_index_ +
+      static_cast<uint32_t>(floor(live_time / segment_duration_)));
 }
 
-double SegmentTemplateIterator::SegmentDuration(
-    const MediaSegmentSequence* sequence) const {
-  if (!sequence_ || sequence_ != sequence)
-    return MediaSegmentSequence::kInvalidSegmentDuration;
+double SegmentTemplateSequence::TimestampAt(const Position& position) const {
+  uint32_t index = position.index;
+  if (index < start_index_)
+    return kInvalidSegmentTimestamp;
 
-  return sequence_->Duration(current_index_);
-}
+  index -= start_index_;  // passed index is not always zero-based
 
-double SegmentTemplateIterator::SegmentTimestamp(
-    const MediaSegmentSequence* sequence) const {
-  if (!sequence_ || sequence_ != sequence)
-    return MediaSegmentSequence::kInvalidSegmentTimestamp;
+  if (timeline_) return timeline_->StartSeconds(index);
 
-  return sequence_->Timestamp(current_index_);
+  return segment_duration_ * index;
 }
 
-bool SegmentTemplateIterator::operator==(
-    const SegmentTemplateIterator& rhs) const {
-  return sequence_ == rhs.sequence_ && current_index_ == rhs.current_index_;
-}
+double SegmentTemplateSequence::DurationAt(const Position& position) const {
+  uint32_t index = position.index;
+  if (!timeline_)
+    return segment_duration_;
+
+  if (index < start_index_)
+    return kInvalidSegmentDuration;
+
+  index -= start_index_;  // passed index is not always zero-based
 
-bool SegmentTemplateIterator::EqualsTo(
-    const SegmentTemplateIterator& it) const {
-  return *this == it;
+  // invalid duration for segments which are not known
+  return timeline_->DurationSeconds(index);
 }
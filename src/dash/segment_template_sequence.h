@@ -22,12 +22,15 @@
 
 #include "dash/media_segment_sequence.h"
 
+#include <memory>
 #include <string>
 #include <vector>
 
-#include "sequence_iterator.h"
+#include "libdash/libdash.h"
 
-class SegmentTemplateIterator;
+#include "segment_info.h"
+
+class SegmentTimeline;
 struct RepresentationDescription;
 
 // FIXME missing support for <SegmentTimeline> attributes
@@ -39,6 +42,8 @@ class SegmentTemplateSequence : public MediaSegmentSequence {
 
   Iterator Begin() const override;
   Iterator End() const override;
+  Iterator StartSegment() const override;
+  bool IsDynamic() const override;
 
   Iterator MediaSegmentForTime(double time) const override;
 
@@ -54,71 +59,76 @@ class SegmentTemplateSequence : public MediaSegmentSequence {
 
   double AverageSegmentDuration() const override;
 
+ protected:
+  std::unique_ptr<dash::mpd::ISegment> SegmentAt(
+      const Position& position) const override;
+  bool DescriptorAt(const Position& position,
+                    SegmentDescriptor* descriptor) const override;
+  double DurationAt(const Position& position) const override;
+  double TimestampAt(const Position& position) const override;
+
  private:
-  struct SegmentTimes {
-      SegmentTimes(uint64_t start_time, uint32_t duration)
-          : start_time_(start_time), duration_(duration){}
-      uint64_t start_time_;
-      uint32_t duration_;
+  // A part of an URL template (e.g. SegmentTemplate@media). Identifiers
+  // which don't change within a representation ($RepresentationID$,
+  // $Bandwidth$) are substituted when the template is compiled, so only
+  // literals, $Number$ and $Time$ remain.
+  struct MediaToken {
+    enum class Type { kLiteral, kNumber, kTime };
+    Type type;
+    std::string literal;
+    // Numbers are padded with zeros to this width.
+    size_t width;
   };
 
   void ExtractSegmentDuration();
   void ExtractStartIndex();
-  void CalculateSegmentStartTimes();
-
-  double Duration(uint32_t) const;
-  double Timestamp(uint32_t index) const;
-
-  // For use by iterators
-  std::unique_ptr<dash::mpd::ISegment> GetMediaSegmentFromNumber(
-      uint32_t number) const;
-
-  std::vector<dash::mpd::IBaseUrl*> base_urls_;
+  void CompileMediaTemplate();
+  // Splits an URL template into tokens, with the base URL prepended to the
+  // first literal.
+  std::vector<MediaToken> CompileTemplate(
+      const std::string& url_template) const;
+  void AppendMediaUrl(uint64_t number, uint64_t time, std::string* out) const;
+  static void AppendUrl(const std::vector<MediaToken>& tokens,
+                        uint64_t number, uint64_t time, std::string* out);
+  // Returns null for an empty template.
+  std::unique_ptr<dash::mpd::ISegment> TemplateSegment(
+      const std::string& url_template,
+      dash::metrics::HTTPTransactionType type) const;
+
+  // Seconds elapsed since availability start of a dynamic presentation.
+  double LiveTime() const;
+  // Range of available segments, it's changing in dynamic presentations.
+  uint32_t BeginIndex() const;
+  uint32_t EndIndex() const;
+
+  // Returns false if the segment of the number is not available.
+  // start_time is set for sequences with SegmentTimeline only.
+  bool GetSegmentTiming(uint32_t number, uint64_t* start_time) const;
+
+  // Absolute base URL media segment URLs are resolved against.
+  std::string base_url_;
   std::string rep_id_;
-  dash::mpd::ISegmentTemplate* segment_template_;
+  std::shared_ptr<const SegmentTemplateInfo> segment_template_;
+  std::vector<MediaToken> media_tokens_;
+  // Length of literals of media_tokens_.
+  size_t media_literals_size_;
   uint32_t bandwidth_;
   uint32_t start_index_;
   uint32_t end_index_;
   double segment_duration_;
-  std::vector<SegmentTimes> segment_start_times_;
-
-  friend class SegmentTemplateIterator;
+  // Set when segment_template_ has a SegmentTimeline.
+  std::shared_ptr<SegmentTimeline> timeline_;
+  bool dynamic_;
+  double availability_start_time_;
+  // Segments of a dynamic presentation become available that much before
+  // they end, at most when they start.
+  double availability_time_offset_;
+  double time_shift_buffer_depth_;
+  double presentation_delay_;
+  // Media time (including the presentation time offset) in seconds at
+  // which the period ends, kInvalidDuration if its duration is unknown.
+  // Segments starting at or after it are not part of the sequence.
+  double period_end_;
 };
 
-class SegmentTemplateIterator : public SequenceIterator {
- public:
-  SegmentTemplateIterator();
-  SegmentTemplateIterator(const SegmentTemplateSequence*,
-                          uint32_t current_index);
-  virtual ~SegmentTemplateIterator() = default;
-
-  std::unique_ptr<SequenceIterator> Clone() const override;
-  void NextSegment() override;
-  void PrevSegment() override;
-  std::unique_ptr<dash::mpd::ISegment> Get() const override;
-  bool Equals(const SequenceIterator&) const override;
-
-  double SegmentDuration(const MediaSegmentSequence*) const override;
-  double SegmentTimestamp(const MediaSegmentSequence*) const override;
-
-  bool operator==(const SegmentTemplateIterator&) const;
-
-  SegmentTemplateIterator(SegmentTemplateIterator&&) = delete;
-  SegmentTemplateIterator& operator=(const SegmentTemplateIterator&) = delete;
-  SegmentTemplateIterator& operator=(SegmentTemplateIterator&&) = delete;
-  SegmentTemplateIterator(const SegmentTemplateIterator&) = default;
-
- protected:
-  bool EqualsTo(const SegmentTemplateIterator&) const override;
-
- private:
-  const SegmentTemplateSequence* sequence_;
-  uint32_t current_index_;
-};
-
-inline bool operator!=(const SegmentTemplateIterator& lhs,
-                       const SegmentTemplateIterator& rhs) {
-  return !(lhs == rhs);
-}
-
 #endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_SEGMENT_TEMPLATE_SEQUENCE_H_
@@ -0,0 +1,191 @@
+/*!
+ * segment_timeline.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#include "segment_timeline.h"
+
+#include <algorithm>
+#include <vector>
+
+using pp::AutoLock;
+
+SegmentTimeline::SegmentTimeline(uint32_t timescale)
+    : timescale_(timescale > 0 ? timescale : 1.0),
+      first_index_(0) {}
+
+SegmentTimeline::~SegmentTimeline() {}
+
+size_t SegmentTimeline::Update(
+    const std::vector<SegmentTimelineElement>& timeline) {
+  // S elements with resolved start times.
+  std::vector<Run> runs;
+  uint64_t end_time = 0;
+  for (const auto& element : timeline) {
+    uint64_t start_time = element.start_time;
+    uint64_t duration = element.duration;
+    uint64_t repeat = element.repeat_count;
+
+    if (start_time == 0)
+      start_time = end_time;
+
+    // Segments of zero duration would all start at the same time.
+    uint64_t count = duration > 0 ? repeat + 1 : 1;
+    runs.push_back({start_time, duration, count, 0});
+    end_time = start_time + duration * count;
+  }
+  if (runs.empty()) return 0;
+
+  AutoLock lock(lock_);
+  RemoveBefore(runs.front().start_time);
+
+  size_t added = 0;
+  for (auto& run : runs) {
+    // Segments which are already known are skipped.
+    if (!runs_.empty()) {
+      const Run& last = runs_.back();
+      uint64_t last_start = last.start_time + last.duration * (last.count - 1);
+      if (run.start_time <= last_start) {
+        uint64_t known = run.duration > 0
+            ? (last_start - run.start_time) / run.duration + 1 : run.count;
+        if (known >= run.count) continue;
+        run.start_time += run.duration * known;
+        run.count -= known;
+      }
+    }
+    added += Append(run.start_time, run.duration, run.count);
+  }
+  return added;
+}
+
+void SegmentTimeline::RemoveBefore(uint64_t start_time) {
+  while (!runs_.empty() && runs_.front().start_time < start_time) {
+    Run& run = runs_.front();
+    uint64_t removed = run.duration > 0
+        ? (start_time - run.start_time + run.duration - 1) / run.duration
+        : run.count;
+    if (removed >= run.count) {
+      first_index_ += run.count;
+      runs_.pop_front();
+      continue;
+    }
+    run.start_time += run.duration * removed;
+    run.count -= removed;
+    run.first_index += removed;
+    first_index_ += removed;
+  }
+}
+
+size_t SegmentTimeline::Append(uint64_t start_time, uint64_t duration,
+                               uint64_t count) {
+  if (!runs_.empty()) {
+    Run& last = runs_.back();
+    if (last.duration == duration &&
+        last.start_time + last.duration * last.count == start_time) {
+      last.count += count;
+      return count;
+    }
+  }
+  runs_.push_back({start_time, duration, count, EndIndexLocked()});
+  return count;
+}
+
+size_t SegmentTimeline::EndIndexLocked() const {
+  if (runs_.empty()) return first_index_;
+  return runs_.back().first_index + runs_.back().count;
+}
+
+double SegmentTimeline::ToSeconds(uint64_t time) const {
+  return time / timescale_;
+}
+
+size_t SegmentTimeline::FirstIndex() const {
+  AutoLock lock(lock_);
+  return first_index_;
+}
+
+size_t SegmentTimeline::EndIndex() const {
+  AutoLock lock(lock_);
+  return EndIndexLocked();
+}
+
+const SegmentTimeline::Run* SegmentTimeline::RunAt(size_t index) const {
+  if (index < first_index_ || index >= EndIndexLocked()) return nullptr;
+
+  // The last run which starts before index.
+  auto it = std::upper_bound(runs_.begin(), runs_.end(), index,
+      [](size_t i, const Run& run) { return i < run.first_index; });
+  return &*(--it);
+}
+
+bool SegmentTimeline::GetStartTime(size_t index, uint64_t* start_time) const {
+  AutoLock lock(lock_);
+  const Run* run = RunAt(index);
+  if (!run) return false;
+
+  *start_time = run->start_time + run->duration * (index - run->first_index);
+  return true;
+}
+
+double SegmentTimeline::StartSeconds(size_t index) const {
+  AutoLock lock(lock_);
+  const Run* run = RunAt(index);
+  if (!run) return -1.0;
+
+  return ToSeconds(run->start_time +
+                   run->duration * (index - run->first_index));
+}
+
+double SegmentTimeline::DurationSeconds(size_t index) const {
+  AutoLock lock(lock_);
+  const Run* run = RunAt(index);
+  return run ? ToSeconds(run->duration) : -1.0;
+}
+
+double SegmentTimeline::EndSeconds() const {
+  AutoLock lock(lock_);
+  if (runs_.empty()) return 0.;
+  const Run& last = runs_.back();
+  return ToSeconds(last.start_time + last.duration * last.count);
+}
+
+size_t SegmentTimeline::FindIndex(double time) const {
+  AutoLock lock(lock_);
+  size_t end_index = EndIndexLocked();
+  // The last run which starts before time.
+  auto it = std::upper_bound(runs_.begin(), runs_.end(), time,
+      [this](double t, const Run& run) {
+        return t < ToSeconds(run.start_time);
+      });
+  if (it == runs_.begin()) return end_index;
+
+  --it;
+  auto start_of = [this, it](uint64_t i) {
+    return ToSeconds(it->start_time + it->duration * i);
+  };
+  uint64_t i = 0;
+  if (it->duration > 0) {
+    double offset = (time - start_of(0)) / ToSeconds(it->duration);
+    i = std::min(static_cast<uint64_t>(std::max(offset, 0.)), it->count - 1);
+  }
+  // Fixes rounding of the division above.
+  while (i + 1 < it->count && start_of(i + 1) <= time) ++i;
+  while (i > 0 && start_of(i) > time) --i;
+
+  if (time > start_of(i) + ToSeconds(it->duration)) return end_index;
+  return it->first_index + i;
+}
@@ -0,0 +1,105 @@
+/*!
+ * segment_timeline.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_PLAYER_ES_DASH_PLAYER_DASH_SEGMENT_TIMELINE_H_
+#define SRC_PLAYER_ES_DASH_PLAYER_DASH_SEGMENT_TIMELINE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "ppapi/utility/threading/lock.h"
+
+// S element of a SegmentTimeline, in timescale units. Start time 0 means
+// the element follows the previous one.
+struct SegmentTimelineElement {
+  uint64_t start_time;
+  uint64_t duration;
+  uint64_t repeat_count;
+};
+
+// Segments described by a SegmentTimeline element. It's shared by the
+// manifest and sequences of a representation, so segments which appear in
+// a refreshed manifest of a dynamic presentation become available in
+// sequences already in use. Segments are indexed from the first one ever
+// added, indices don't change when old segments are removed. It's thread
+// safe.
+//
+// Segments are kept in the run-length form of S elements, so memory used by
+// a long timeline depends on the number of runs of equal segments, not on
+// the number of segments. Runs are searched by index or time in logarithmic
+// time.
+class SegmentTimeline {
+ public:
+  explicit SegmentTimeline(uint32_t timescale);
+  ~SegmentTimeline();
+
+  // Adds segments following the last known one and removes ones which
+  // start before the first segment of timeline, i.e. ones which are not
+  // available anymore. Returns the number of added segments.
+  size_t Update(const std::vector<SegmentTimelineElement>& timeline);
+
+  // Index of the first available segment.
+  size_t FirstIndex() const;
+  // Index following the last known segment.
+  size_t EndIndex() const;
+
+  // Returns false if segment of the index is not available.
+  bool GetStartTime(size_t index, uint64_t* start_time) const;
+  // Returns a negative value if segment of the index is not available.
+  double StartSeconds(size_t index) const;
+  double DurationSeconds(size_t index) const;
+  // End time of the last known segment, 0 if there are no segments.
+  double EndSeconds() const;
+
+  // Returns index of the segment containing time, or EndIndex() if there
+  // is no such segment.
+  size_t FindIndex(double time) const;
+
+ private:
+  // Contiguous segments of equal duration.
+  struct Run {
+    uint64_t start_time;
+    uint64_t duration;
+    uint64_t count;
+    // Index of the first segment of the run, i.e. a sum of counts of all
+    // runs before it, including removed ones.
+    size_t first_index;
+  };
+
+  // Methods below require lock_ to be locked.
+  // Returns null if segment of the index is not available.
+  const Run* RunAt(size_t index) const;
+  // Removes segments which start before start_time.
+  void RemoveBefore(uint64_t start_time);
+  // Appends count segments of a run, merging it with the last run if it
+  // continues it. Returns the number of added segments.
+  size_t Append(uint64_t start_time, uint64_t duration, uint64_t count);
+  size_t EndIndexLocked() const;
+  double ToSeconds(uint64_t time) const;
+
+  mutable pp::Lock lock_;
+  double timescale_;
+  std::deque<Run> runs_;
+  // Number of removed segments, i.e. index of the first available one.
+  size_t first_index_;
+};
+
+#endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_SEGMENT_TIMELINE_H_
@@ -0,0 +1,91 @@
+/*!
+ * url_segment.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#include "url_segment.h"
+
+#include <cstdlib>
+#include <utility>
+
+namespace {
+
+constexpr size_t kDefaultHttpPort = 80;
+constexpr size_t kDefaultHttpsPort = 443;
+
+}  // namespace
+
+std::unique_ptr<dash::mpd::ISegment> UrlSegment::Create(
+    const std::string& url, const std::string& range,
+    dash::metrics::HTTPTransactionType type) {
+  if (url.empty()) return {};
+
+  return std::unique_ptr<dash::mpd::ISegment>{
+      new UrlSegment(url, range, type)};
+}
+
+UrlSegment::UrlSegment(const std::string& url, const std::string& range,
+                       dash::metrics::HTTPTransactionType type)
+    : port_(kDefaultHttpPort),
+      start_byte_(0),
+      end_byte_(0),
+      has_byte_range_(false),
+      type_(type) {
+  AbsoluteURI(url);
+  if (range.empty()) return;
+
+  Range(range);
+  has_byte_range_ = true;
+}
+
+UrlSegment::~UrlSegment() {}
+
+void UrlSegment::AbsoluteURI(std::string uri) {
+  absolute_uri_ = std::move(uri);
+  host_.clear();
+  path_.clear();
+
+  // scheme://host[:port]/path
+  size_t scheme_end = absolute_uri_.find("://");
+  if (scheme_end == std::string::npos) return;
+
+  port_ = absolute_uri_.compare(0, scheme_end, "https") == 0
+      ? kDefaultHttpsPort : kDefaultHttpPort;
+  size_t host_begin = scheme_end + 3;
+  size_t path_begin = absolute_uri_.find('/', host_begin);
+  if (path_begin == std::string::npos) path_begin = absolute_uri_.size();
+  host_ = absolute_uri_.substr(host_begin, path_begin - host_begin);
+  path_ = absolute_uri_.substr(path_begin);
+
+  size_t port_begin = host_.find(':');
+  if (port_begin == std::string::npos) return;
+
+  port_ = std::strtoul(host_.c_str() + port_begin + 1, nullptr, 10);
+  host_.resize(port_begin);
+}
+
+void UrlSegment::Range(std::string range) {
+  range_ = std::move(range);
+  start_byte_ = 0;
+  end_byte_ = 0;
+
+  size_t pos = range_.find('-');
+  if (pos == std::string::npos) return;
+
+  start_byte_ = std::strtoul(range_.c_str(), nullptr, 10);
+  end_byte_ = std::strtoul(range_.c_str() + pos + 1, nullptr, 10);
+}
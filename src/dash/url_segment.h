@@ -0,0 +1,102 @@
+/*!
+ * url_segment.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_PLAYER_ES_DASH_PLAYER_DASH_URL_SEGMENT_H_
+#define SRC_PLAYER_ES_DASH_PLAYER_DASH_URL_SEGMENT_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "libdash/libdash.h"
+
+// A segment described by an absolute URL and an optional byte range. It
+// doesn't depend on the libdash object tree of the manifest, which segments
+// created by libdash elements do. Segments are downloaded by the player
+// (see DownloadSegment()), so libdash download methods do nothing.
+class UrlSegment : public dash::mpd::ISegment {
+ public:
+  // Returns null for an empty URL, like libdash does.
+  static std::unique_ptr<dash::mpd::ISegment> Create(
+      const std::string& url, const std::string& range,
+      dash::metrics::HTTPTransactionType type);
+
+  UrlSegment(const std::string& url, const std::string& range,
+             dash::metrics::HTTPTransactionType type);
+  ~UrlSegment() override;
+
+  // IChunk
+  std::string& AbsoluteURI() override { return absolute_uri_; }
+  std::string& Host() override { return host_; }
+  size_t Port() override { return port_; }
+  std::string& Path() override { return path_; }
+  std::string& Range() override { return range_; }
+  size_t StartByte() override { return start_byte_; }
+  size_t EndByte() override { return end_byte_; }
+  bool HasByteRange() override { return has_byte_range_; }
+  dash::metrics::HTTPTransactionType GetType() override { return type_; }
+
+  // ISegment
+  void AbsoluteURI(std::string uri) override;
+  void Host(std::string host) override { host_ = std::move(host); }
+  void Port(size_t port) override { port_ = port; }
+  void Path(std::string path) override { path_ = std::move(path); }
+  void Range(std::string range) override;
+  void StartByte(size_t start_byte) override { start_byte_ = start_byte; }
+  void EndByte(size_t end_byte) override { end_byte_ = end_byte; }
+  void HasByteRange(bool has_byte_range) override {
+    has_byte_range_ = has_byte_range;
+  }
+
+  // IDownloadableChunk
+  bool StartDownload() override { return false; }
+  bool StartDownload(dash::network::IConnection*) override { return false; }
+  void AbortDownload() override {}
+  int Read(uint8_t*, size_t) override { return -1; }
+  int Peek(uint8_t*, size_t) override { return -1; }
+  int Peek(uint8_t*, size_t, size_t) override { return -1; }
+  void AttachDownloadObserver(dash::network::IDownloadObserver*) override {}
+  void DetachDownloadObserver(dash::network::IDownloadObserver*) override {}
+
+  // IDASHMetrics
+  const std::vector<dash::metrics::ITCPConnection*>& GetTCPConnectionList()
+      const override {
+    return tcp_connections_;
+  }
+  const std::vector<dash::metrics::IHTTPTransaction*>&
+  GetHTTPTransactionList() const override {
+    return http_transactions_;
+  }
+
+ private:
+  std::string absolute_uri_;
+  std::string host_;
+  size_t port_;
+  std::string path_;
+  std::string range_;
+  size_t start_byte_;
+  size_t end_byte_;
+  bool has_byte_range_;
+  dash::metrics::HTTPTransactionType type_;
+  // Always empty, metrics are collected by the player.
+  std::vector<dash::metrics::ITCPConnection*> tcp_connections_;
+  std::vector<dash::metrics::IHTTPTransaction*> http_transactions_;
+};
+
+#endif  // SRC_PLAYER_ES_DASH_PLAYER_DASH_URL_SEGMENT_H_
@@ -18,13 +18,18 @@
  * @author Tomasz Borkowski
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <string>
 #include <vector>
 
 #include "util.h"
+#include "base_url_selector.h"
 #include "segment_base_sequence.h"
 #include "segment_list_sequence.h"
 #include "segment_template_sequence.h"
+#include "url_segment.h"
 
 namespace {
 
@@ -34,20 +39,142 @@ std::unique_ptr<MediaSegmentSequence> MakeSequence(
   return std::unique_ptr<MediaSegmentSequence>{
       new T(representation, bandwidth)};
 }
+
+// Limits number of base URL combinations registered for a representation.
+constexpr size_t kMaxBaseUrlAlternatives = 8;
 }
 
 RepresentationDescription MakeEmptyRepresentation() {
   RepresentationDescription representation;
 
-  representation.segment_base = nullptr;
-  representation.segment_list = nullptr;
-  representation.segment_template = nullptr;
+  representation.period_start = 0.;
+  representation.period_duration = kInvalidDuration;
+  representation.dynamic = false;
+  representation.availability_start_time = 0.;
+  representation.time_shift_buffer_depth = 0.;
+  representation.presentation_delay = 0.;
+  representation.target_latency = 0.;
 
   return representation;
 }
 
+double PresentationTimeOffset(const RepresentationDescription& representation) {
+  const SegmentBaseInfo* segment_base = representation.segment_base.get();
+  if (representation.segment_list)
+    segment_base = representation.segment_list.get();
+  if (representation.segment_template)
+    segment_base = representation.segment_template.get();
+  if (!segment_base || segment_base->timescale == 0) return 0.;
+
+  return static_cast<double>(segment_base->presentation_time_offset) /
+      segment_base->timescale;
+}
+
+std::string GetSegmentUrl(dash::mpd::ISegment* seg) {
+  dash::network::IChunk* chunk = static_cast<dash::network::IChunk*>(seg);
+  // Quick fix for wrongly parsed MPDs
+  // Got url in following form:
+  //    "http://dash.akamaized.net/dash264/TestCasesMCA/dolby/1/1/"
+  //    "http://dash.akamaized.net/dash264/TestCasesMCA/dolby/1/1/"
+  //    "ChID_voices_51_256_ddp_A.mp4"
+  // and thus got 404 error.
+  std::string url = chunk->AbsoluteURI();
+  auto first_match = url.find("://");
+  auto last_match = url.rfind("://");
+  if (first_match != last_match)
+    url.erase(url.begin() + first_match, url.begin() + last_match);
+  return url;
+}
+
+SegmentDescriptor DescribeSegment(dash::mpd::ISegment* seg) {
+  SegmentDescriptor descriptor;
+  if (!seg) return descriptor;
+
+  descriptor.url = GetSegmentUrl(seg);
+  auto chunk = static_cast<dash::network::IChunk*>(seg);
+  if (chunk->HasByteRange()) descriptor.range = chunk->Range();
+  return descriptor;
+}
+
+std::unique_ptr<dash::mpd::ISegment> CreateSegment(
+    const std::string& base_url, const SegmentUrlInfo& url,
+    dash::metrics::HTTPTransactionType type) {
+  if (url.url.empty()) return {};
+
+  return UrlSegment::Create(CombineUrl(base_url, url.url), url.range, type);
+}
+
+std::string ResolveBaseUrl(const std::vector<std::string>& chain) {
+  std::string url;
+  for (const auto& base_url : chain) url = CombineUrl(url, base_url);
+  return url;
+}
+
+std::string CombineUrl(const std::string& base_url, const std::string& url) {
+  if (base_url.empty() || url.find("://") != std::string::npos) return url;
+  if (url.empty()) return base_url;
+
+  bool base_slash = base_url.back() == '/';
+  bool url_slash = url.front() == '/';
+  if (base_slash && url_slash) return base_url + url.substr(1);
+  if (!base_slash && !url_slash) return base_url + "/" + url;
+  return base_url + url;
+}
+
+std::string GetOrigin(const std::string& url) {
+  size_t scheme_end = url.find("://");
+  if (scheme_end == std::string::npos) return std::string();
+  size_t host_end = url.find_first_of("/?#", scheme_end + 3);
+  if (host_end == scheme_end + 3) return std::string();
+  return url.substr(0, host_end) + '/';
+}
+
+std::vector<std::string> ResolveBaseUrls(
+    const RepresentationDescription& representation,
+    std::vector<std::string>* service_locations) {
+  std::vector<std::string> result;
+  const auto& levels = representation.base_url_levels;
+  const auto& location_levels = representation.service_location_levels;
+  // Index of an alternative chosen on each level, like digits of a number.
+  std::vector<size_t> choice(levels.size(), 0);
+  std::vector<std::string> chain(levels.size());
+  while (result.size() < kMaxBaseUrlAlternatives) {
+    for (size_t i = 0; i < levels.size(); ++i)
+      chain[i] = levels[i][choice[i]];
+    std::string url = ResolveBaseUrl(chain);
+    if (!url.empty() &&
+        std::find(result.begin(), result.end(), url) == result.end()) {
+      result.push_back(url);
+      if (service_locations) {
+        std::string location;
+        for (size_t i = 0; i < location_levels.size(); ++i) {
+          if (!location_levels[i][choice[i]].empty())
+            location = location_levels[i][choice[i]];
+        }
+        service_locations->push_back(location);
+      }
+    }
+
+    // Alternatives of the innermost levels are iterated first.
+    size_t level = levels.size();
+    while (level > 0) {
+      --level;
+      if (++choice[level] < levels[level].size()) break;
+      choice[level] = 0;
+    }
+    if (std::all_of(choice.begin(), choice.end(),
+                    [](size_t index) { return index == 0; }))
+      break;
+  }
+  return result;
+}
+
 std::unique_ptr<MediaSegmentSequence> CreateSequence(
     const RepresentationDescription& representation, uint32_t bandwidth) {
+  std::vector<std::string> service_locations;
+  auto base_urls = ResolveBaseUrls(representation, &service_locations);
+  BaseUrlSelector::Get().AddAlternatives(base_urls, service_locations);
+
   if (representation.segment_base)
     return MakeSequence<SegmentBaseSequence>(representation, bandwidth);
 
@@ -116,3 +243,47 @@ double ParseDurationToSeconds(const std::string& duration_str) {
 
   return duration_in_seconds;
 }
+
+double ParseDateTimeToSeconds(const std::string& date_time_str) {
+  // Format: YYYY-MM-DDThh:mm:ss[.s+][Z|(+|-)hh:mm]
+  int year, month, day, hour, minute;
+  double second;
+  int consumed = 0;
+  if (std::sscanf(date_time_str.c_str(), "%d-%d-%dT%d:%d:%lf%n", &year,
+                  &month, &day, &hour, &minute, &second, &consumed) != 6)
+    return kInvalidDuration;
+  if (month < 1 || month > 12 || day < 1 || day > 31)
+    return kInvalidDuration;
+
+  // Days since the epoch of a date in the proleptic Gregorian calendar.
+  int64_t y = year - (month <= 2 ? 1 : 0);
+  int64_t era = (y >= 0 ? y : y - 399) / 400;
+  int64_t year_of_era = y - era * 400;
+  int64_t day_of_year =
+      (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int64_t day_of_era = year_of_era * 365 + year_of_era / 4 -
+      year_of_era / 100 + day_of_year;
+  int64_t days = era * 146097 + day_of_era - 719468;
+
+  const double kSecondsInMinute = 60;
+  const double kSecondsInHour = 60 * kSecondsInMinute;
+  const double kSecondsInDay = 24 * kSecondsInHour;
+  double seconds = days * kSecondsInDay + hour * kSecondsInHour +
+      minute * kSecondsInMinute + second;
+
+  std::string zone = date_time_str.substr(consumed);
+  int zone_hours, zone_minutes;
+  if (!zone.empty() && (zone[0] == '+' || zone[0] == '-') &&
+      std::sscanf(zone.c_str() + 1, "%d:%d", &zone_hours, &zone_minutes) == 2) {
+    double offset =
+        zone_hours * kSecondsInHour + zone_minutes * kSecondsInMinute;
+    seconds += (zone[0] == '+') ? -offset : offset;
+  }
+
+  return seconds;
+}
+
+double CurrentTimeInSeconds() {
+  return std::chrono::duration<double>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
@@ -30,21 +30,64 @@
 #include "common.h"
 #include "dash/media_segment_sequence.h"
 #include "dash/media_stream.h"
+#include "segment_info.h"
 
 class MediaSegmentSequence;
 class ContentProtectionDescriptor;
+class SegmentBaseIndex;
+class SegmentTimeline;
 
 constexpr double kInvalidDuration = -1.0;
+// Value of MPD@type of live presentations.
+constexpr char kDynamicPresentationType[] = "dynamic";
 
+// Description doesn't refer to the libdash object tree of the manifest, it's
+// freed once the manifest is processed.
 struct RepresentationDescription {
-  // Vector of non owning pointers.
-  std::vector<dash::mpd::IBaseUrl*> base_urls;
+  // Base URLs from the outermost level (the MPD location) to the innermost
+  // one, each resolved against the ones before it.
+  std::vector<std::string> base_urls;
+  // All base URLs listed on each level of base_urls, which holds the first
+  // one of each level.
+  std::vector<std::vector<std::string>> base_url_levels;
+  // BaseURL@serviceLocation of each entry of base_url_levels, empty if it's
+  // not given. Content steering picks base URLs by them.
+  std::vector<std::vector<std::string>> service_location_levels;
   std::string representation_id;
-
-  // Non owning pointers.
-  dash::mpd::ISegmentBase* segment_base;
-  dash::mpd::ISegmentList* segment_list;
-  dash::mpd::ISegmentTemplate* segment_template;
+  // The innermost @codecs value, e.g. "avc1.640028". Empty if it's not
+  // given.
+  std::string codecs;
+
+  // The innermost segment information elements, shared with other
+  // representations inheriting them.
+  std::shared_ptr<const SegmentBaseInfo> segment_base;
+  std::shared_ptr<const SegmentListInfo> segment_list;
+  std::shared_ptr<const SegmentTemplateInfo> segment_template;
+
+  // Timeline of segment_template shared with the manifest, which updates it
+  // when it's refreshed. Sequence creates its own one when it's null.
+  std::shared_ptr<SegmentTimeline> segment_timeline;
+  // Index of segment_base shared with the manifest, which loads it in the
+  // background. Sequence creates its own one when it's null.
+  std::shared_ptr<SegmentBaseIndex> segment_base_index;
+
+  // Presentation time of the beginning of the Period and its duration in
+  // seconds. Duration is kInvalidDuration when it's not known.
+  double period_start;
+  double period_duration;
+
+  // Fields below are used by dynamic (live) presentations only.
+  bool dynamic;
+  // MPD@availabilityStartTime plus Period@start in seconds since the epoch.
+  double availability_start_time;
+  double time_shift_buffer_depth;
+  // Distance from the live edge at which playback starts.
+  double presentation_delay;
+  // Latency a low-latency presentation is played with, i.e. its
+  // ServiceDescription Latency@target or a default one when segments are
+  // available before they are complete (@availabilityTimeOffset). It's 0
+  // for other presentations.
+  double target_latency;
 };
 
 struct VideoRepresentation {
@@ -57,21 +100,70 @@ struct AudioRepresentation {
   RepresentationDescription representation;
 };
 
-RepresentationDescription MakeEmptyRepresentation();
+struct TextRepresentation {
+  TextStream stream;
+  RepresentationDescription representation;
+};
 
-template <typename T, class... Args>
-MediaSegmentSequence::Iterator MakeIterator(Args&&... args) {
-  return MediaSegmentSequence::Iterator(
-      std::move(MakeUnique<T>(std::forward<Args>(args)...)));
-}
+struct ImageRepresentation {
+  ImageStream stream;
+  RepresentationDescription representation;
+};
+
+RepresentationDescription MakeEmptyRepresentation();
 
 std::unique_ptr<MediaSegmentSequence> CreateSequence(
     const RepresentationDescription& representation, uint32_t bandwidth);
 
+/// Returns @presentationTimeOffset of the representation in seconds, i.e.
+/// a media time which is presented at the beginning of the Period.
+double PresentationTimeOffset(const RepresentationDescription& representation);
+
+/// Returns an absolute URL of the segment.
+std::string GetSegmentUrl(dash::mpd::ISegment* seg);
+
+/// Returns an absolute URL and a byte range of the segment.
+SegmentDescriptor DescribeSegment(dash::mpd::ISegment* seg);
+
+/// Returns a segment of an URLType element (e.g. Initialization) resolved
+/// against an absolute base_url, or null when the element is missing.
+std::unique_ptr<dash::mpd::ISegment> CreateSegment(
+    const std::string& base_url, const SegmentUrlInfo& url,
+    dash::metrics::HTTPTransactionType type);
+
+/// Returns an absolute URL of the last base URL of the chain, resolved
+/// against the ones before it.
+std::string ResolveBaseUrl(const std::vector<std::string>& chain);
+
+/// Resolves url against an absolute base_url, joining paths like libdash
+/// does for segments. Absolute url is returned as is.
+std::string CombineUrl(const std::string& base_url, const std::string& url);
+
+/// Returns the origin of an absolute url with a trailing slash, e.g.
+/// "https://cdn.example.com:8443/", or an empty string if url isn't
+/// absolute.
+std::string GetOrigin(const std::string& url);
+
+/// Returns absolute base URLs of all combinations of alternative base URLs
+/// of the representation, starting with the one resolved from base_urls.
+/// If service_locations isn't null, it gets a service location of each
+/// returned base URL, i.e. the innermost one given on its levels.
+std::vector<std::string> ResolveBaseUrls(
+    const RepresentationDescription& representation,
+    std::vector<std::string>* service_locations = nullptr);
+
 /// Parses an xs:duration format to a floating-point value in seconds.
 /// Returns -1.0 (kInvalidDuration) if parsing failes.
 double ParseDurationToSeconds(const std::string& duration_str);
 
+/// Parses an xs:dateTime format to a floating-point value in seconds since
+/// the epoch. Time without a time zone is treated as UTC.
+/// Returns -1.0 (kInvalidDuration) if parsing failes.
+double ParseDateTimeToSeconds(const std::string& date_time_str);
+
+/// Returns the current wall clock time in seconds since the epoch.
+double CurrentTimeInSeconds();
+
 template <typename T>
 T GetHighestBitrateStream(const std::vector<T>& representations) {
   if (representations.empty()) return T();
@@ -20,6 +20,14 @@
 #ifndef SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_CONVERT_CODECS_H_
 #define SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_CONVERT_CODECS_H_
 
+#include <strings.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <string>
+#include <vector>
+
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavutil/dict.h>
@@ -27,282 +35,536 @@ extern "C" {
 }
 
 #include "common.h"
+#include "demuxer/stream_demuxer.h"
 
-Samsung::NaClPlayer::AudioCodec_Type ConvertAudioCodec(AVCodecID codec) {
-  switch (codec) {
-    case AV_CODEC_ID_AAC:
-    case AV_CODEC_ID_AAC_LATM:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_AAC;
-    case AV_CODEC_ID_AC3:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_AC3;
-    case AV_CODEC_ID_EAC3:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_EAC3;
-    case AV_CODEC_ID_DTS:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_DTS;
-    case AV_CODEC_ID_MP2:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_MP2;
-    case AV_CODEC_ID_MP3:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_MP3;
-    case AV_CODEC_ID_WMAV1:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_WMAV1;
-    case AV_CODEC_ID_WMAV2:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_WMAV2;
-    case AV_CODEC_ID_PCM_U8:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_PCM;
-    case AV_CODEC_ID_PCM_MULAW:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_PCM_MULAW;
-    case AV_CODEC_ID_PCM_S16BE:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_PCM_S16BE;
-    case AV_CODEC_ID_PCM_S24BE:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_PCM_S24BE;
-    case AV_CODEC_ID_VORBIS:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_VORBIS;
-    case AV_CODEC_ID_FLAC:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_FLAC;
-    case AV_CODEC_ID_AMR_NB:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_AMR_NB;
-    case AV_CODEC_ID_AMR_WB:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_AMR_WB;
-    case AV_CODEC_ID_GSM_MS:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_GSM_MS;
-    case AV_CODEC_ID_OPUS:
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_OPUS;
-    default:
-      LOG_ERROR("unknown codec %d", codec);
-      return Samsung::NaClPlayer::AUDIOCODEC_TYPE_UNKNOWN;
+// Conversions between ffmpeg, container and DASH codec descriptions and
+// NaCl Player ones are lookups in the constant tables below, so adding a
+// codec means adding a table row.
+
+// Describes a codec: its ffmpeg id, its NaCl Player type and a sample entry
+// type naming it in DASH @codecs strings (RFC 6381), e.g. "avc1" of
+// "avc1.640028". A codec can have a few rows, the first one is used to
+// convert its ffmpeg id.
+template <typename CodecType>
+struct CodecDescriptor {
+  AVCodecID av_codec;
+  CodecType type;
+  const char* sample_entry;  // nullptr if the codec has no sample entry
+};
+
+template <typename From, typename To>
+struct CodecMapping {
+  From from;
+  To to;
+};
+
+constexpr CodecDescriptor<Samsung::NaClPlayer::AudioCodec_Type>
+    kAudioCodecs[] = {
+  {AV_CODEC_ID_AAC, Samsung::NaClPlayer::AUDIOCODEC_TYPE_AAC, "mp4a"},
+  {AV_CODEC_ID_AAC_LATM, Samsung::NaClPlayer::AUDIOCODEC_TYPE_AAC, nullptr},
+  {AV_CODEC_ID_AC3, Samsung::NaClPlayer::AUDIOCODEC_TYPE_AC3, "ac-3"},
+  {AV_CODEC_ID_EAC3, Samsung::NaClPlayer::AUDIOCODEC_TYPE_EAC3, "ec-3"},
+  {AV_CODEC_ID_DTS, Samsung::NaClPlayer::AUDIOCODEC_TYPE_DTS, "dtsc"},
+  {AV_CODEC_ID_DTS, Samsung::NaClPlayer::AUDIOCODEC_TYPE_DTS, "dtsh"},
+  {AV_CODEC_ID_DTS, Samsung::NaClPlayer::AUDIOCODEC_TYPE_DTS, "dtsl"},
+  {AV_CODEC_ID_MP2, Samsung::NaClPlayer::AUDIOCODEC_TYPE_MP2, nullptr},
+  {AV_CODEC_ID_MP3, Samsung::NaClPlayer::AUDIOCODEC_TYPE_MP3, "mp3"},
+  {AV_CODEC_ID_WMAV1, Samsung::NaClPlayer::AUDIOCODEC_TYPE_WMAV1, nullptr},
+  {AV_CODEC_ID_WMAV2, Samsung::NaClPlayer::AUDIOCODEC_TYPE_WMAV2, nullptr},
+  {AV_CODEC_ID_PCM_U8, Samsung::NaClPlayer::AUDIOCODEC_TYPE_PCM, nullptr},
+  {AV_CODEC_ID_PCM_MULAW, Samsung::NaClPlayer::AUDIOCODEC_TYPE_PCM_MULAW,
+   nullptr},
+  {AV_CODEC_ID_PCM_S16BE, Samsung::NaClPlayer::AUDIOCODEC_TYPE_PCM_S16BE,
+   nullptr},
+  {AV_CODEC_ID_PCM_S24BE, Samsung::NaClPlayer::AUDIOCODEC_TYPE_PCM_S24BE,
+   nullptr},
+  {AV_CODEC_ID_VORBIS, Samsung::NaClPlayer::AUDIOCODEC_TYPE_VORBIS, "vorbis"},
+  {AV_CODEC_ID_FLAC, Samsung::NaClPlayer::AUDIOCODEC_TYPE_FLAC, "flac"},
+  {AV_CODEC_ID_AMR_NB, Samsung::NaClPlayer::AUDIOCODEC_TYPE_AMR_NB, "samr"},
+  {AV_CODEC_ID_AMR_WB, Samsung::NaClPlayer::AUDIOCODEC_TYPE_AMR_WB, "sawb"},
+  {AV_CODEC_ID_GSM_MS, Samsung::NaClPlayer::AUDIOCODEC_TYPE_GSM_MS, nullptr},
+  {AV_CODEC_ID_OPUS, Samsung::NaClPlayer::AUDIOCODEC_TYPE_OPUS, "opus"},
+};
+
+constexpr CodecDescriptor<Samsung::NaClPlayer::VideoCodec_Type>
+    kVideoCodecs[] = {
+  {AV_CODEC_ID_H264, Samsung::NaClPlayer::VIDEOCODEC_TYPE_H264, "avc1"},
+  {AV_CODEC_ID_H264, Samsung::NaClPlayer::VIDEOCODEC_TYPE_H264, "avc3"},
+  {AV_CODEC_ID_THEORA, Samsung::NaClPlayer::VIDEOCODEC_TYPE_THEORA,
+   "theora"},
+  {AV_CODEC_ID_MPEG4, Samsung::NaClPlayer::VIDEOCODEC_TYPE_MPEG4, "mp4v"},
+  {AV_CODEC_ID_VP8, Samsung::NaClPlayer::VIDEOCODEC_TYPE_VP8, "vp08"},
+  {AV_CODEC_ID_VP8, Samsung::NaClPlayer::VIDEOCODEC_TYPE_VP8, "vp8"},
+  {AV_CODEC_ID_VP9, Samsung::NaClPlayer::VIDEOCODEC_TYPE_VP9, "vp09"},
+  {AV_CODEC_ID_VP9, Samsung::NaClPlayer::VIDEOCODEC_TYPE_VP9, "vp9"},
+  {AV_CODEC_ID_MPEG2VIDEO, Samsung::NaClPlayer::VIDEOCODEC_TYPE_MPEG2,
+   nullptr},
+  {AV_CODEC_ID_VC1, Samsung::NaClPlayer::VIDEOCODEC_TYPE_VC1, "vc-1"},
+  {AV_CODEC_ID_WMV1, Samsung::NaClPlayer::VIDEOCODEC_TYPE_WMV1, nullptr},
+  {AV_CODEC_ID_WMV2, Samsung::NaClPlayer::VIDEOCODEC_TYPE_WMV2, nullptr},
+  {AV_CODEC_ID_WMV3, Samsung::NaClPlayer::VIDEOCODEC_TYPE_WMV3, nullptr},
+  {AV_CODEC_ID_H263, Samsung::NaClPlayer::VIDEOCODEC_TYPE_H263, "s263"},
+  {AV_CODEC_ID_INDEO3, Samsung::NaClPlayer::VIDEOCODEC_TYPE_INDEO3, nullptr},
+#if (PPAPI_RELEASE >= 47)
+  {AV_CODEC_ID_H265, Samsung::NaClPlayer::VIDEOCODEC_TYPE_H265, "hvc1"},
+  {AV_CODEC_ID_H265, Samsung::NaClPlayer::VIDEOCODEC_TYPE_H265, "hev1"},
+  {AV_CODEC_ID_H265, Samsung::NaClPlayer::VIDEOCODEC_TYPE_H265, "dvh1"},
+  {AV_CODEC_ID_H265, Samsung::NaClPlayer::VIDEOCODEC_TYPE_H265, "dvhe"},
+#endif
+};
+
+constexpr CodecMapping<AVSampleFormat, Samsung::NaClPlayer::SampleFormat>
+    kSampleFormats[] = {
+  {AV_SAMPLE_FMT_U8, Samsung::NaClPlayer::SAMPLEFORMAT_U8},
+  {AV_SAMPLE_FMT_S16, Samsung::NaClPlayer::SAMPLEFORMAT_S16},
+  {AV_SAMPLE_FMT_S32, Samsung::NaClPlayer::SAMPLEFORMAT_S32},
+  {AV_SAMPLE_FMT_FLT, Samsung::NaClPlayer::SAMPLEFORMAT_F32},
+  {AV_SAMPLE_FMT_S16P, Samsung::NaClPlayer::SAMPLEFORMAT_PLANARS16},
+  {AV_SAMPLE_FMT_FLTP, Samsung::NaClPlayer::SAMPLEFORMAT_PLANARF32},
+};
+
+// Default layouts of channel counts, indexed by a channel count.
+constexpr Samsung::NaClPlayer::ChannelLayout kDefaultChannelLayouts[] = {
+  Samsung::NaClPlayer::CHANNEL_LAYOUT_UNSUPPORTED,
+  Samsung::NaClPlayer::CHANNEL_LAYOUT_MONO,
+  Samsung::NaClPlayer::CHANNEL_LAYOUT_STEREO,
+  Samsung::NaClPlayer::CHANNEL_LAYOUT_SURROUND,
+  Samsung::NaClPlayer::CHANNEL_LAYOUT_QUAD,
+  Samsung::NaClPlayer::CHANNEL_LAYOUT_5_0,
+  Samsung::NaClPlayer::CHANNEL_LAYOUT_5_1,
+  Samsung::NaClPlayer::CHANNEL_LAYOUT_6_1,
+  Samsung::NaClPlayer::CHANNEL_LAYOUT_7_1,
+};
+
+constexpr CodecMapping<uint64_t, Samsung::NaClPlayer::ChannelLayout>
+    kChannelLayouts[] = {
+  {AV_CH_LAYOUT_MONO, Samsung::NaClPlayer::CHANNEL_LAYOUT_MONO},
+  {AV_CH_LAYOUT_STEREO, Samsung::NaClPlayer::CHANNEL_LAYOUT_STEREO},
+  {AV_CH_LAYOUT_2_1, Samsung::NaClPlayer::CHANNEL_LAYOUT_2_1},
+  {AV_CH_LAYOUT_SURROUND, Samsung::NaClPlayer::CHANNEL_LAYOUT_SURROUND},
+  {AV_CH_LAYOUT_4POINT0, Samsung::NaClPlayer::CHANNEL_LAYOUT_4_0},
+  {AV_CH_LAYOUT_2_2, Samsung::NaClPlayer::CHANNEL_LAYOUT_2_2},
+  {AV_CH_LAYOUT_QUAD, Samsung::NaClPlayer::CHANNEL_LAYOUT_QUAD},
+  {AV_CH_LAYOUT_5POINT0, Samsung::NaClPlayer::CHANNEL_LAYOUT_5_0},
+  {AV_CH_LAYOUT_5POINT1, Samsung::NaClPlayer::CHANNEL_LAYOUT_5_1},
+  {AV_CH_LAYOUT_5POINT0_BACK, Samsung::NaClPlayer::CHANNEL_LAYOUT_5_0_BACK},
+  {AV_CH_LAYOUT_5POINT1_BACK, Samsung::NaClPlayer::CHANNEL_LAYOUT_5_1_BACK},
+  {AV_CH_LAYOUT_7POINT0, Samsung::NaClPlayer::CHANNEL_LAYOUT_7_0},
+  {AV_CH_LAYOUT_7POINT1, Samsung::NaClPlayer::CHANNEL_LAYOUT_7_1},
+  {AV_CH_LAYOUT_7POINT1_WIDE, Samsung::NaClPlayer::CHANNEL_LAYOUT_7_1_WIDE},
+  {AV_CH_LAYOUT_STEREO_DOWNMIX,
+   Samsung::NaClPlayer::CHANNEL_LAYOUT_STEREO_DOWNMIX},
+  {AV_CH_LAYOUT_2POINT1, Samsung::NaClPlayer::CHANNEL_LAYOUT_2POINT1},
+  {AV_CH_LAYOUT_3POINT1, Samsung::NaClPlayer::CHANNEL_LAYOUT_3_1},
+  {AV_CH_LAYOUT_4POINT1, Samsung::NaClPlayer::CHANNEL_LAYOUT_4_1},
+  {AV_CH_LAYOUT_6POINT0, Samsung::NaClPlayer::CHANNEL_LAYOUT_6_0},
+  {AV_CH_LAYOUT_6POINT0_FRONT, Samsung::NaClPlayer::CHANNEL_LAYOUT_6_0_FRONT},
+  {AV_CH_LAYOUT_HEXAGONAL, Samsung::NaClPlayer::CHANNEL_LAYOUT_HEXAGONAL},
+  {AV_CH_LAYOUT_6POINT1, Samsung::NaClPlayer::CHANNEL_LAYOUT_6_1},
+  {AV_CH_LAYOUT_6POINT1_BACK, Samsung::NaClPlayer::CHANNEL_LAYOUT_6_1_BACK},
+  {AV_CH_LAYOUT_6POINT1_FRONT, Samsung::NaClPlayer::CHANNEL_LAYOUT_6_1_FRONT},
+  {AV_CH_LAYOUT_7POINT0_FRONT, Samsung::NaClPlayer::CHANNEL_LAYOUT_7_0_FRONT},
+  {AV_CH_LAYOUT_7POINT1_WIDE_BACK,
+   Samsung::NaClPlayer::CHANNEL_LAYOUT_7_1_WIDE_BACK},
+  {AV_CH_LAYOUT_OCTAGONAL, Samsung::NaClPlayer::CHANNEL_LAYOUT_OCTAGONAL},
+};
+
+// AAC profiles by MPEG-4 audio object types (ISO/IEC 14496-3). ffmpeg
+// profiles (FF_PROFILE_AAC_*) are object types minus one.
+constexpr CodecMapping<int, Samsung::NaClPlayer::AudioCodec_Profile>
+    kAacProfiles[] = {
+  {1, Samsung::NaClPlayer::AUDIOCODEC_PROFILE_AAC_MAIN},
+  {2, Samsung::NaClPlayer::AUDIOCODEC_PROFILE_AAC_LOW},
+  {3, Samsung::NaClPlayer::AUDIOCODEC_PROFILE_AAC_SSR},
+  {4, Samsung::NaClPlayer::AUDIOCODEC_PROFILE_AAC_LTP},
+  {5, Samsung::NaClPlayer::AUDIOCODEC_PROFILE_AAC_HE},
+  {23, Samsung::NaClPlayer::AUDIOCODEC_PROFILE_AAC_LD},
+  {29, Samsung::NaClPlayer::AUDIOCODEC_PROFILE_AAC_HE_V2},
+  {39, Samsung::NaClPlayer::AUDIOCODEC_PROFILE_AAC_ELD},
+};
+
+// Sampling frequencies by samplingFrequencyIndex of AAC AudioSpecificConfig.
+constexpr uint32_t kAacSampleRates[] = {
+  96000, 88200, 64000, 48000, 44100, 32000, 24000,
+  22050, 16000, 12000, 11025, 8000, 7350,
+};
+
+// H.264 profiles by profile_idc. ffmpeg profiles (FF_PROFILE_H264_*) are
+// profile_idc values with constraint flags above them.
+constexpr CodecMapping<int, Samsung::NaClPlayer::VideoCodec_Profile>
+    kH264Profiles[] = {
+  {66, Samsung::NaClPlayer::VIDEOCODEC_PROFILE_H264_BASELINE},
+  {77, Samsung::NaClPlayer::VIDEOCODEC_PROFILE_H264_MAIN},
+  {88, Samsung::NaClPlayer::VIDEOCODEC_PROFILE_H264_EXTENDED},
+  {100, Samsung::NaClPlayer::VIDEOCODEC_PROFILE_H264_HIGH},
+  {110, Samsung::NaClPlayer::VIDEOCODEC_PROFILE_H264_HIGH10},
+  {122, Samsung::NaClPlayer::VIDEOCODEC_PROFILE_H264_HIGH422},
+  {244, Samsung::NaClPlayer::VIDEOCODEC_PROFILE_H264_HIGH444PREDICTIVE},
+};
+
+constexpr CodecMapping<int, Samsung::NaClPlayer::VideoCodec_Profile>
+    kMpeg2Profiles[] = {
+  {FF_PROFILE_MPEG2_422, Samsung::NaClPlayer::VIDEOCODEC_PROFILE_MPEG2_422},
+  {FF_PROFILE_MPEG2_HIGH, Samsung::NaClPlayer::VIDEOCODEC_PROFILE_MPEG2_HIGH},
+  {FF_PROFILE_MPEG2_SS, Samsung::NaClPlayer::VIDEOCODEC_PROFILE_MPEG2_SS},
+  {FF_PROFILE_MPEG2_SNR_SCALABLE,
+   Samsung::NaClPlayer::VIDEOCODEC_PROFILE_MPEG2_SNR_SCALABLE},
+  {FF_PROFILE_MPEG2_MAIN, Samsung::NaClPlayer::VIDEOCODEC_PROFILE_MPEG2_MAIN},
+  {FF_PROFILE_MPEG2_SIMPLE,
+   Samsung::NaClPlayer::VIDEOCODEC_PROFILE_MPEG2_SIMPLE},
+};
+
+constexpr CodecMapping<int, Samsung::NaClPlayer::VideoFrame_Format>
+    kVideoFrameFormats[] = {
+  {AV_PIX_FMT_YUV422P, Samsung::NaClPlayer::VIDEOFRAME_FORMAT_YV16},
+  {AV_PIX_FMT_YUV420P, Samsung::NaClPlayer::VIDEOFRAME_FORMAT_YV12},
+  {AV_PIX_FMT_YUVJ420P, Samsung::NaClPlayer::VIDEOFRAME_FORMAT_YV12},
+  {AV_PIX_FMT_YUVA420P, Samsung::NaClPlayer::VIDEOFRAME_FORMAT_YV12A},
+};
+
+template <typename From, typename To, size_t N>
+inline bool FindMapping(const CodecMapping<From, To>(&table)[N], From from,
+                        To* to) {
+  for (const auto& mapping : table) {
+    if (mapping.from == from) {
+      *to = mapping.to;
+      return true;
+    }
   }
+  return false;
 }
 
-Samsung::NaClPlayer::SampleFormat ConvertSampleFormat(AVSampleFormat format) {
-  switch (format) {
-    case AV_SAMPLE_FMT_U8:
-      return Samsung::NaClPlayer::SAMPLEFORMAT_U8;
-    case AV_SAMPLE_FMT_S16:
-      return Samsung::NaClPlayer::SAMPLEFORMAT_S16;
-    case AV_SAMPLE_FMT_S32:
-      return Samsung::NaClPlayer::SAMPLEFORMAT_S32;
-    case AV_SAMPLE_FMT_FLT:
-      return Samsung::NaClPlayer::SAMPLEFORMAT_F32;
-    case AV_SAMPLE_FMT_S16P:
-      return Samsung::NaClPlayer::SAMPLEFORMAT_PLANARS16;
-    case AV_SAMPLE_FMT_FLTP:
-      return Samsung::NaClPlayer::SAMPLEFORMAT_PLANARF32;
-    default:
-      LOG_ERROR("unknown sample format %d", format);
-      return Samsung::NaClPlayer::SAMPLEFORMAT_UNKNOWN;
+template <typename CodecType, size_t N>
+inline bool FindCodec(const CodecDescriptor<CodecType>(&table)[N],
+                      AVCodecID codec, CodecType* type) {
+  for (const auto& descriptor : table) {
+    if (descriptor.av_codec == codec) {
+      *type = descriptor.type;
+      return true;
+    }
   }
+  return false;
 }
 
-Samsung::NaClPlayer::ChannelLayout ChannelLayoutFromChannelCount(int channels) {
-  switch (channels) {
-    case 1:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_MONO;
-    case 2:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_STEREO;
-    case 3:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_SURROUND;
-    case 4:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_QUAD;
-    case 5:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_5_0;
-    case 6:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_5_1;
-    case 7:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_6_1;
-    case 8:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_7_1;
-    default:
-      LOG_ERROR("layout %d", channels);
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_UNSUPPORTED;
+template <typename CodecType, size_t N>
+inline bool FindCodec(const CodecDescriptor<CodecType>(&table)[N],
+                      const std::string& sample_entry, CodecType* type) {
+  for (const auto& descriptor : table) {
+    if (descriptor.sample_entry &&
+        strcasecmp(descriptor.sample_entry, sample_entry.c_str()) == 0) {
+      *type = descriptor.type;
+      return true;
+    }
   }
+  return false;
 }
 
-Samsung::NaClPlayer::ChannelLayout ConvertChannelLayout(uint64_t layout,
-                                                        int channels) {
-  switch (layout) {
-    case AV_CH_LAYOUT_MONO:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_MONO;
-    case AV_CH_LAYOUT_STEREO:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_STEREO;
-    case AV_CH_LAYOUT_2_1:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_2_1;
-    case AV_CH_LAYOUT_SURROUND:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_SURROUND;
-    case AV_CH_LAYOUT_4POINT0:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_4_0;
-    case AV_CH_LAYOUT_2_2:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_2_2;
-    case AV_CH_LAYOUT_QUAD:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_QUAD;
-    case AV_CH_LAYOUT_5POINT0:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_5_0;
-    case AV_CH_LAYOUT_5POINT1:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_5_1;
-    case AV_CH_LAYOUT_5POINT0_BACK:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_5_0_BACK;
-    case AV_CH_LAYOUT_5POINT1_BACK:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_5_1_BACK;
-    case AV_CH_LAYOUT_7POINT0:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_7_0;
-    case AV_CH_LAYOUT_7POINT1:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_7_1;
-    case AV_CH_LAYOUT_7POINT1_WIDE:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_7_1_WIDE;
-    case AV_CH_LAYOUT_STEREO_DOWNMIX:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_STEREO_DOWNMIX;
-    case AV_CH_LAYOUT_2POINT1:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_2POINT1;
-    case AV_CH_LAYOUT_3POINT1:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_3_1;
-    case AV_CH_LAYOUT_4POINT1:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_4_1;
-    case AV_CH_LAYOUT_6POINT0:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_6_0;
-    case AV_CH_LAYOUT_6POINT0_FRONT:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_6_0_FRONT;
-    case AV_CH_LAYOUT_HEXAGONAL:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_HEXAGONAL;
-    case AV_CH_LAYOUT_6POINT1:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_6_1;
-    case AV_CH_LAYOUT_6POINT1_BACK:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_6_1_BACK;
-    case AV_CH_LAYOUT_6POINT1_FRONT:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_6_1_FRONT;
-    case AV_CH_LAYOUT_7POINT0_FRONT:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_7_0_FRONT;
-    case AV_CH_LAYOUT_7POINT1_WIDE_BACK:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_7_1_WIDE_BACK;
-    case AV_CH_LAYOUT_OCTAGONAL:
-      return Samsung::NaClPlayer::CHANNEL_LAYOUT_OCTAGONAL;
-    default:
-      LOG_ERROR(
-          "channel layout %llu unknown, getting layout from channel "
-          "count %d",
-          layout, channels);
-      return ChannelLayoutFromChannelCount(channels);
+inline Samsung::NaClPlayer::AudioCodec_Type ConvertAudioCodec(
+    AVCodecID codec) {
+  auto type = Samsung::NaClPlayer::AUDIOCODEC_TYPE_UNKNOWN;
+  if (!FindCodec(kAudioCodecs, codec, &type))
+    LOG_ERROR("unknown codec %d", codec);
+  return type;
+}
+
+inline Samsung::NaClPlayer::SampleFormat ConvertSampleFormat(
+    AVSampleFormat format) {
+  auto sample_format = Samsung::NaClPlayer::SAMPLEFORMAT_UNKNOWN;
+  if (!FindMapping(kSampleFormats, format, &sample_format))
+    LOG_ERROR("unknown sample format %d", format);
+  return sample_format;
+}
+
+inline Samsung::NaClPlayer::ChannelLayout ChannelLayoutFromChannelCount(
+    int channels) {
+  constexpr int kMaxChannels =
+      sizeof(kDefaultChannelLayouts) / sizeof(kDefaultChannelLayouts[0]) - 1;
+  if (channels < 1 || channels > kMaxChannels) {
+    LOG_ERROR("layout %d", channels);
+    return Samsung::NaClPlayer::CHANNEL_LAYOUT_UNSUPPORTED;
   }
+  return kDefaultChannelLayouts[channels];
 }
 
-Samsung::NaClPlayer::AudioCodec_Profile ConvertAACAudioCodecProfile(
+inline Samsung::NaClPlayer::ChannelLayout ConvertChannelLayout(
+    uint64_t layout, int channels) {
+  auto channel_layout = Samsung::NaClPlayer::CHANNEL_LAYOUT_UNSUPPORTED;
+  if (FindMapping(kChannelLayouts, layout, &channel_layout))
+    return channel_layout;
+  LOG_ERROR(
+      "channel layout %llu unknown, getting layout from channel "
+      "count %d",
+      layout, channels);
+  return ChannelLayoutFromChannelCount(channels);
+}
+
+inline Samsung::NaClPlayer::AudioCodec_Profile AacProfileFromObjectType(
+    int object_type) {
+  auto profile = Samsung::NaClPlayer::AUDIOCODEC_PROFILE_UNKNOWN;
+  if (!FindMapping(kAacProfiles, object_type, &profile))
+    LOG_ERROR("unknown AAC object type %d", object_type);
+  return profile;
+}
+
+inline Samsung::NaClPlayer::AudioCodec_Profile ConvertAACAudioCodecProfile(
     int profile) {
-  switch (profile) {
-    case FF_PROFILE_AAC_MAIN:
-      return Samsung::NaClPlayer::AUDIOCODEC_PROFILE_AAC_MAIN;
-    case FF_PROFILE_AAC_LOW:
-      return Samsung::NaClPlayer::AUDIOCODEC_PROFILE_AAC_LOW;
-    case FF_PROFILE_AAC_SSR:
-      return Samsung::NaClPlayer::AUDIOCODEC_PROFILE_AAC_SSR;
-    case FF_PROFILE_AAC_LTP:
-      return Samsung::NaClPlayer::AUDIOCODEC_PROFILE_AAC_LTP;
-    case FF_PROFILE_AAC_HE:
-      return Samsung::NaClPlayer::AUDIOCODEC_PROFILE_AAC_HE;
-    case FF_PROFILE_AAC_HE_V2:
-      return Samsung::NaClPlayer::AUDIOCODEC_PROFILE_AAC_HE_V2;
-    case FF_PROFILE_AAC_LD:
-      return Samsung::NaClPlayer::AUDIOCODEC_PROFILE_AAC_LD;
-    case FF_PROFILE_AAC_ELD:
-      return Samsung::NaClPlayer::AUDIOCODEC_PROFILE_AAC_ELD;
-    default:
-      LOG_ERROR("unknown profile %d", profile);
-      return Samsung::NaClPlayer::AUDIOCODEC_PROFILE_UNKNOWN;
-  }
+  return AacProfileFromObjectType(profile + 1);
 }
 
-Samsung::NaClPlayer::VideoCodec_Type ConvertVideoCodec(AVCodecID codec) {
-  switch (codec) {
-    case AV_CODEC_ID_H264:
-      return Samsung::NaClPlayer::VIDEOCODEC_TYPE_H264;
-    case AV_CODEC_ID_THEORA:
-      return Samsung::NaClPlayer::VIDEOCODEC_TYPE_THEORA;
-    case AV_CODEC_ID_MPEG4:
-      return Samsung::NaClPlayer::VIDEOCODEC_TYPE_MPEG4;
-    case AV_CODEC_ID_VP8:
-      return Samsung::NaClPlayer::VIDEOCODEC_TYPE_VP8;
-    case AV_CODEC_ID_VP9:
-      return Samsung::NaClPlayer::VIDEOCODEC_TYPE_VP9;
-    case AV_CODEC_ID_MPEG2VIDEO:
-      return Samsung::NaClPlayer::VIDEOCODEC_TYPE_MPEG2;
-    case AV_CODEC_ID_VC1:
-      return Samsung::NaClPlayer::VIDEOCODEC_TYPE_VC1;
-    case AV_CODEC_ID_WMV1:
-      return Samsung::NaClPlayer::VIDEOCODEC_TYPE_WMV1;
-    case AV_CODEC_ID_WMV2:
-      return Samsung::NaClPlayer::VIDEOCODEC_TYPE_WMV2;
-    case AV_CODEC_ID_WMV3:
-      return Samsung::NaClPlayer::VIDEOCODEC_TYPE_WMV3;
-    case AV_CODEC_ID_H263:
-      return Samsung::NaClPlayer::VIDEOCODEC_TYPE_H263;
-    case AV_CODEC_ID_INDEO3:
-      return Samsung::NaClPlayer::VIDEOCODEC_TYPE_INDEO3;
-#if (PPAPI_RELEASE >= 47)
-    case AV_CODEC_ID_H265:
-      return Samsung::NaClPlayer::VIDEOCODEC_TYPE_H265;
-#endif
-    default:
-      LOG_ERROR("unknown codec %d", codec);
-      return Samsung::NaClPlayer::VIDEOCODEC_TYPE_UNKNOWN;
-  }
+inline Samsung::NaClPlayer::VideoCodec_Type ConvertVideoCodec(
+    AVCodecID codec) {
+  auto type = Samsung::NaClPlayer::VIDEOCODEC_TYPE_UNKNOWN;
+  if (!FindCodec(kVideoCodecs, codec, &type))
+    LOG_ERROR("unknown codec %d", codec);
+  return type;
 }
 
-Samsung::NaClPlayer::VideoCodec_Profile ConvertH264VideoCodecProfile(
+inline Samsung::NaClPlayer::VideoCodec_Profile H264ProfileFromProfileIdc(
+    int profile_idc) {
+  auto profile = Samsung::NaClPlayer::VIDEOCODEC_PROFILE_UNKNOWN;
+  if (!FindMapping(kH264Profiles, profile_idc, &profile))
+    LOG_ERROR("unknown H264 profile %d", profile_idc);
+  return profile;
+}
+
+inline Samsung::NaClPlayer::VideoCodec_Profile ConvertH264VideoCodecProfile(
     int profile) {
   profile &= ~FF_PROFILE_H264_CONSTRAINED;
   profile &= ~FF_PROFILE_H264_INTRA;
-  switch (profile) {
-    case FF_PROFILE_H264_BASELINE:
-      return Samsung::NaClPlayer::VIDEOCODEC_PROFILE_H264_BASELINE;
-    case FF_PROFILE_H264_MAIN:
-      return Samsung::NaClPlayer::VIDEOCODEC_PROFILE_H264_MAIN;
-    case FF_PROFILE_H264_EXTENDED:
-      return Samsung::NaClPlayer::VIDEOCODEC_PROFILE_H264_EXTENDED;
-    case FF_PROFILE_H264_HIGH:
-      return Samsung::NaClPlayer::VIDEOCODEC_PROFILE_H264_HIGH;
-    case FF_PROFILE_H264_HIGH_10:
-      return Samsung::NaClPlayer::VIDEOCODEC_PROFILE_H264_HIGH10;
-    case FF_PROFILE_H264_HIGH_422:
-      return Samsung::NaClPlayer::VIDEOCODEC_PROFILE_H264_HIGH422;
-    case FF_PROFILE_H264_HIGH_444_PREDICTIVE:
-      return Samsung::NaClPlayer::VIDEOCODEC_PROFILE_H264_HIGH444PREDICTIVE;
-    default:
-      LOG_ERROR("unknown profile %d", profile);
-      return Samsung::NaClPlayer::VIDEOCODEC_PROFILE_UNKNOWN;
-  }
+  return H264ProfileFromProfileIdc(profile);
 }
 
-Samsung::NaClPlayer::VideoCodec_Profile ConvertMPEG2VideoCodecProfile(
+inline Samsung::NaClPlayer::VideoCodec_Profile ConvertMPEG2VideoCodecProfile(
     int profile) {
-  switch (profile) {
-    case FF_PROFILE_MPEG2_422:
-      return Samsung::NaClPlayer::VIDEOCODEC_PROFILE_MPEG2_422;
-    case FF_PROFILE_MPEG2_HIGH:
-      return Samsung::NaClPlayer::VIDEOCODEC_PROFILE_MPEG2_HIGH;
-    case FF_PROFILE_MPEG2_SS:
-      return Samsung::NaClPlayer::VIDEOCODEC_PROFILE_MPEG2_SS;
-    case FF_PROFILE_MPEG2_SNR_SCALABLE:
-      return Samsung::NaClPlayer::VIDEOCODEC_PROFILE_MPEG2_SNR_SCALABLE;
-    case FF_PROFILE_MPEG2_MAIN:
-      return Samsung::NaClPlayer::VIDEOCODEC_PROFILE_MPEG2_MAIN;
-    case FF_PROFILE_MPEG2_SIMPLE:
-      return Samsung::NaClPlayer::VIDEOCODEC_PROFILE_MPEG2_SIMPLE;
-    default:
-      LOG_ERROR("unknown profile %d", profile);
-      return Samsung::NaClPlayer::VIDEOCODEC_PROFILE_UNKNOWN;
+  auto codec_profile = Samsung::NaClPlayer::VIDEOCODEC_PROFILE_UNKNOWN;
+  if (!FindMapping(kMpeg2Profiles, profile, &codec_profile))
+    LOG_ERROR("unknown profile %d", profile);
+  return codec_profile;
+}
+
+inline Samsung::NaClPlayer::VideoFrame_Format ConvertVideoFrameFormat(
+    int format) {
+  auto frame_format = Samsung::NaClPlayer::VIDEOFRAME_FORMAT_INVALID;
+  if (!FindMapping(kVideoFrameFormats, format, &frame_format))
+    LOG_ERROR("unknown format %d", format);
+  return frame_format;
+}
+
+// Splits the first codec of a DASH @codecs value into its dot separated
+// elements, e.g. "avc1.640028" into "avc1" and "640028".
+inline std::vector<std::string> SplitCodecString(const std::string& codecs) {
+  std::vector<std::string> elements;
+  std::string codec = codecs.substr(0, codecs.find(','));
+  size_t begin = codec.find_first_not_of(' ');
+  if (begin == std::string::npos) return elements;
+  size_t end = codec.find_last_not_of(' ') + 1;
+  while (begin < end) {
+    size_t dot = std::min(codec.find('.', begin), end);
+    elements.push_back(codec.substr(begin, dot - begin));
+    begin = dot + 1;
   }
+  return elements;
+}
+
+// Parses a number of a codec string element, skipping a letter prefix of
+// HEVC elements (e.g. "L153"). Returns 0 if it's not a number.
+inline int ParseCodecStringNumber(const std::string& element, int base) {
+  size_t begin = base == 16 ? 0 : element.find_first_of("0123456789");
+  if (begin == std::string::npos) return 0;
+  return static_cast<int>(std::strtol(element.c_str() + begin, nullptr,
+                                      base));
 }
 
-Samsung::NaClPlayer::VideoFrame_Format ConvertVideoFrameFormat(int format) {
-  switch (format) {
-    case AV_PIX_FMT_YUV422P:
-      return Samsung::NaClPlayer::VIDEOFRAME_FORMAT_YV16;
-    case AV_PIX_FMT_YUV420P:
-    case AV_PIX_FMT_YUVJ420P:
-      return Samsung::NaClPlayer::VIDEOFRAME_FORMAT_YV12;
-    case AV_PIX_FMT_YUVA420P:
-      return Samsung::NaClPlayer::VIDEOFRAME_FORMAT_YV12A;
+// Fills the codec type and the profile of an audio configuration from a
+// DASH @codecs value, e.g. "mp4a.40.2" (RFC 6381), so they are known before
+// the stream is demuxed. Other fields are left unchanged.
+// Returns false if the codec isn't known.
+inline bool ParseCodecString(const std::string& codecs, AudioConfig* config) {
+  auto elements = SplitCodecString(codecs);
+  if (elements.empty() ||
+      !FindCodec(kAudioCodecs, elements[0], &config->codec_type))
+    return false;
+
+  config->codec_profile = Samsung::NaClPlayer::AUDIOCODEC_PROFILE_UNKNOWN;
+  if (config->codec_type != Samsung::NaClPlayer::AUDIOCODEC_TYPE_AAC ||
+      elements.size() < 2)
+    return true;
+
+  // mp4a.<object type indication>[.<audio object type>]
+  constexpr int kObjectTypeAac = 0x40;
+  constexpr int kObjectTypeAacMain = 0x66;
+  constexpr int kObjectTypeMpeg2Mp3 = 0x69;
+  constexpr int kObjectTypeMp3 = 0x6b;
+  constexpr int kAudioObjectTypeMp3 = 34;
+  int object_type = ParseCodecStringNumber(elements[1], 16);
+  if (object_type == kObjectTypeMpeg2Mp3 || object_type == kObjectTypeMp3) {
+    config->codec_type = Samsung::NaClPlayer::AUDIOCODEC_TYPE_MP3;
+  } else if (object_type >= kObjectTypeAacMain &&
+             object_type < kObjectTypeMpeg2Mp3) {
+    // MPEG-2 AAC Main, LC and SSR are audio object types 1 to 3.
+    config->codec_profile =
+        AacProfileFromObjectType(object_type - kObjectTypeAacMain + 1);
+  } else if (object_type == kObjectTypeAac && elements.size() > 2) {
+    int audio_object_type = ParseCodecStringNumber(elements[2], 10);
+    if (audio_object_type == kAudioObjectTypeMp3)
+      config->codec_type = Samsung::NaClPlayer::AUDIOCODEC_TYPE_MP3;
+    else
+      config->codec_profile = AacProfileFromObjectType(audio_object_type);
+  }
+  return true;
+}
+
+// Fills the codec type, the profile, the level and the bit depth of a video
+// configuration from a DASH @codecs value, e.g. "avc1.640028",
+// "hvc1.2.4.L153.B0" or "vp09.02.10.10" (RFC 6381, ISO/IEC 14496-15 Annex
+// E and the VP9 codec ISO media file format binding), so they are known
+// before the stream is demuxed. Other fields are left unchanged.
+// Returns false if the codec isn't known.
+inline bool ParseCodecString(const std::string& codecs, VideoConfig* config) {
+  auto elements = SplitCodecString(codecs);
+  if (elements.empty() ||
+      !FindCodec(kVideoCodecs, elements[0], &config->codec_type))
+    return false;
+
+  config->codec_profile = Samsung::NaClPlayer::VIDEOCODEC_PROFILE_UNKNOWN;
+  switch (config->codec_type) {
+    case Samsung::NaClPlayer::VIDEOCODEC_TYPE_H264: {
+      // avc1.<profile_idc><constraint flags><level_idc> in hex digits
+      constexpr size_t kAvcElementSize = 6;
+      if (elements.size() < 2 || elements[1].size() != kAvcElementSize)
+        break;
+      int value = ParseCodecStringNumber(elements[1], 16);
+      config->profile_idc = value >> 16;
+      config->level_idc = value & 0xff;
+      config->codec_profile = H264ProfileFromProfileIdc(config->profile_idc);
+      break;
+    }
+    case Samsung::NaClPlayer::VIDEOCODEC_TYPE_VP8:
+      config->codec_profile = Samsung::NaClPlayer::VIDEOCODEC_PROFILE_VP8_MAIN;
+      break;
+    case Samsung::NaClPlayer::VIDEOCODEC_TYPE_VP9:
+      // vp09.<profile>.<level>.<bit depth>[...]
+      config->codec_profile = Samsung::NaClPlayer::VIDEOCODEC_PROFILE_VP9_MAIN;
+      if (elements.size() < 4) break;
+      config->profile_idc = ParseCodecStringNumber(elements[1], 10);
+      config->level_idc = ParseCodecStringNumber(elements[2], 10);
+      config->bit_depth = ParseCodecStringNumber(elements[3], 10);
+      break;
+#if (PPAPI_RELEASE >= 47)
+    case Samsung::NaClPlayer::VIDEOCODEC_TYPE_H265: {
+      // hvc1.[A-C]<profile>.<compatibility>.<L|H><level>[.<constraints>]
+      constexpr int kHevcMainProfile = 1;
+      constexpr int kHevcMain10Profile = 2;
+      if (elements.size() < 4) break;
+      config->profile_idc = ParseCodecStringNumber(elements[1], 10);
+      config->level_idc = ParseCodecStringNumber(elements[3], 10);
+      if (config->profile_idc == kHevcMainProfile)
+        config->bit_depth = 8;
+      else if (config->profile_idc == kHevcMain10Profile)
+        config->bit_depth = 10;
+      break;
+    }
+#endif
     default:
-      LOG_ERROR("unknown format %d", format);
-      return Samsung::NaClPlayer::VIDEOFRAME_FORMAT_INVALID;
+      break;
   }
+  return true;
+}
+
+// Completes an audio configuration with the profile given by a DASH @codecs
+// value, when the stream itself doesn't tell it (e.g. it has no decoder
+// specific info) and the value describes the same codec.
+inline void ApplyCodecString(const std::string& codecs, AudioConfig* config) {
+  if (codecs.empty() ||
+      config->codec_profile != Samsung::NaClPlayer::AUDIOCODEC_PROFILE_UNKNOWN)
+    return;
+  AudioConfig hint = AudioConfig();
+  if (!ParseCodecString(codecs, &hint) ||
+      hint.codec_type != config->codec_type)
+    return;
+  config->codec_profile = hint.codec_profile;
+}
+
+// Completes a video configuration with the profile, the level and the bit
+// depth given by a DASH @codecs value, when the stream itself doesn't tell
+// them and the value describes the same codec.
+inline void ApplyCodecString(const std::string& codecs, VideoConfig* config) {
+  if (codecs.empty()) return;
+  VideoConfig hint = VideoConfig();
+  if (!ParseCodecString(codecs, &hint) ||
+      hint.codec_type != config->codec_type)
+    return;
+  if (config->codec_profile == Samsung::NaClPlayer::VIDEOCODEC_PROFILE_UNKNOWN)
+    config->codec_profile = hint.codec_profile;
+  if (config->profile_idc == 0) config->profile_idc = hint.profile_idc;
+  if (config->level_idc == 0) config->level_idc = hint.level_idc;
+  if (config->bit_depth == 0) config->bit_depth = hint.bit_depth;
+}
+
+// Builds a provisional audio configuration of a DASH representation from
+// its @codecs, @audioSamplingRate and AudioChannelConfiguration, so the
+// elementary stream can be configured before its init segment arrives. An
+// AAC AudioSpecificConfig is made up the way packagers write it, so the
+// configuration demuxed later usually equals this one.
+// Returns false if the manifest doesn't describe the stream well enough.
+inline bool MakeProvisionalConfig(const std::string& codecs,
+                                  uint32_t sample_rate, uint32_t channels,
+                                  AudioConfig* config) {
+  constexpr uint32_t kMaxAacChannelConfig = 7;
+  constexpr int32_t kDefaultBitsPerChannel = 16;
+  *config = AudioConfig();
+  if (sample_rate == 0 || channels == 0 ||
+      !ParseCodecString(codecs, config))
+    return false;
+
+  config->sample_format = Samsung::NaClPlayer::SAMPLEFORMAT_PLANARF32;
+  config->bits_per_channel = kDefaultBitsPerChannel;
+  config->samples_per_second = sample_rate;
+  config->channel_layout = ChannelLayoutFromChannelCount(channels);
+  if (config->codec_type != Samsung::NaClPlayer::AUDIOCODEC_TYPE_AAC)
+    return true;
+
+  // The decoder needs an AudioSpecificConfig, which has to name the object
+  // type and the sampling frequency by index.
+  auto object_type = std::find_if(std::begin(kAacProfiles),
+      std::end(kAacProfiles),
+      [config](const CodecMapping<int,
+          Samsung::NaClPlayer::AudioCodec_Profile>& mapping) {
+        return mapping.to == config->codec_profile;
+      });
+  auto frequency = std::find(std::begin(kAacSampleRates),
+                             std::end(kAacSampleRates), sample_rate);
+  if (object_type == std::end(kAacProfiles) ||
+      object_type->from >= 31 || frequency == std::end(kAacSampleRates) ||
+      channels > kMaxAacChannelConfig)
+    return false;
+
+  uint32_t frequency_index = frequency - std::begin(kAacSampleRates);
+  uint16_t specific_config = (object_type->from << 11) |
+                             (frequency_index << 7) | (channels << 3);
+  config->extra_data = CodecExtraData(std::vector<uint8_t>{
+      static_cast<uint8_t>(specific_config >> 8),
+      static_cast<uint8_t>(specific_config & 0xff)});
+  return true;
+}
+
+// Builds a provisional video configuration of a DASH representation from
+// its @codecs, @width, @height and @frameRate. Decoder specific info (e.g.
+// avcC) is known only once the init segment is demuxed, which then usually
+// configures the stream again.
+// Returns false if the manifest doesn't describe the stream well enough.
+inline bool MakeProvisionalConfig(const std::string& codecs, uint32_t width,
+                                  uint32_t height,
+                                  Samsung::NaClPlayer::Rational frame_rate,
+                                  VideoConfig* config) {
+  *config = VideoConfig();
+  if (width == 0 || height == 0 || !ParseCodecString(codecs, config))
+    return false;
+
+  config->frame_format = Samsung::NaClPlayer::VIDEOFRAME_FORMAT_YV12;
+  config->size = Samsung::NaClPlayer::Size(width, height);
+  config->frame_rate = frame_rate;
+  return true;
 }
 
 #endif  // SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_CONVERT_CODECS_H_
@@ -0,0 +1,245 @@
+/*!
+ * demuxer_benchmark.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDemuxer
+
+#include "demuxer/demuxer_benchmark.h"
+
+#include <malloc.h>
+
+#include <algorithm>
+
+#include "ppapi/c/pp_errors.h"
+
+#include "common.h"
+#include "demuxer/elementary_stream_packet.h"
+#include "ffmpeg_demuxer.h"
+
+using std::chrono::duration;
+using std::chrono::steady_clock;
+using std::vector;
+
+namespace {
+
+size_t HeapInUse() {
+  return static_cast<size_t>(mallinfo().uordblks);
+}
+
+uint64_t PacketAllocations() {
+  auto stats = ElementaryStreamPacket::GetAllocationStats();
+  return stats.packets + stats.storages;
+}
+
+}  // anonymous namespace
+
+DemuxerBenchmark::DemuxerBenchmark(const pp::InstanceHandle& instance)
+    : instance_(instance),
+      cc_factory_(this),
+      running_(false),
+      cancelled_(false),
+      type_(StreamDemuxer::kUnknown),
+      kind_(DemuxerKind::kDefault),
+      next_segment_(0),
+      packets_(0),
+      bytes_(0),
+      allocations_start_(0),
+      heap_start_(0),
+      heap_peak_(0),
+      thread_(instance) {
+  thread_.Start();
+}
+
+DemuxerBenchmark::~DemuxerBenchmark() {
+  cancelled_ = true;
+  thread_.Join();
+}
+
+bool DemuxerBenchmark::Start(StreamDemuxer::Type type, DemuxerKind kind,
+                             const std::string& init_url,
+                             const vector<std::string>& media_urls,
+                             const ResultCallback& callback) {
+  if (running_.exchange(true)) {
+    LOG_ERROR("A demuxer benchmark is running already");
+    return false;
+  }
+  type_ = type;
+  kind_ = kind;
+  init_url_ = init_url;
+  media_urls_ = media_urls;
+  callback_ = callback;
+  thread_.message_loop().PostWork(cc_factory_.NewCallback(
+      &DemuxerBenchmark::RunOnBenchmarkThread));
+  return true;
+}
+
+const char* DemuxerBenchmark::KindName(DemuxerKind kind) {
+  switch (kind) {
+    case DemuxerKind::kDefault:
+      return "default";
+    case DemuxerKind::kFFmpeg:
+      return "ffmpeg";
+  }
+  return "unknown";
+}
+
+void DemuxerBenchmark::RunOnBenchmarkThread(int32_t) {
+  segments_.clear();
+  vector<std::string> urls = media_urls_;
+  urls.insert(urls.begin(), init_url_);
+  for (const auto& url : urls) {
+    vector<uint8_t> data;
+    int32_t ret = ProcessURLRequestOnSideThread(GetRequestForURL(url), &data);
+    if (ret != PP_OK || data.empty()) {
+      LOG_ERROR("Failed to download %s, result: %d", url.c_str(), ret);
+      Finish(false);
+      return;
+    }
+    segments_.emplace_back(std::move(data));
+  }
+  LOG_INFO("Benchmarking %s demuxer on %zu segments",
+           KindName(kind_), segments_.size());
+
+  auto init_mode = StreamDemuxer::kFullInitialization;
+  demuxer_ = kind_ == DemuxerKind::kFFmpeg
+      ? FFMpegDemuxer::Create(instance_, type_, init_mode)
+      : StreamDemuxer::Create(instance_, type_, init_mode);
+  if (!demuxer_ || !demuxer_->Init(
+          [this](StreamDemuxer::Message message,
+                 std::unique_ptr<ElementaryStreamPacket> packet) {
+            OnPacket(message, std::move(packet));
+          }, pp::MessageLoop::GetCurrent())) {
+    LOG_ERROR("Failed to initialize a demuxer");
+    Finish(false);
+    return;
+  }
+  demuxer_->SetEsPacketsListener(
+      [this](StreamDemuxer::Message message,
+             StreamDemuxer::PacketBatch packets) {
+        OnPackets(message, std::move(packets));
+      });
+  demuxer_->SetAudioConfigListener([](const AudioConfig&) {});
+  demuxer_->SetVideoConfigListener([](const VideoConfig&) {});
+
+  next_segment_ = 0;
+  latencies_.clear();
+  packets_ = 0;
+  bytes_ = 0;
+  allocations_start_ = PacketAllocations();
+  heap_start_ = HeapInUse();
+  heap_peak_ = heap_start_;
+  start_ = steady_clock::now();
+  thread_.message_loop().PostWork(cc_factory_.NewCallback(
+      &DemuxerBenchmark::ParseNextOnBenchmarkThread));
+}
+
+void DemuxerBenchmark::ParseNextOnBenchmarkThread(int32_t) {
+  if (cancelled_ || !demuxer_) return;
+  last_parse_ = steady_clock::now();
+  if (next_segment_ == segments_.size()) {
+    // Signals the end of stream.
+    demuxer_->Parse(vector<uint8_t>());
+    return;
+  }
+  // Segments are moved, so they are not copied while time is measured.
+  demuxer_->Parse(std::move(segments_[next_segment_++]));
+  heap_peak_ = std::max(heap_peak_, HeapInUse());
+  // Posted, so packet callbacks run between segments.
+  thread_.message_loop().PostWork(cc_factory_.NewCallback(
+      &DemuxerBenchmark::ParseNextOnBenchmarkThread));
+}
+
+void DemuxerBenchmark::OnPacket(StreamDemuxer::Message message,
+    std::unique_ptr<ElementaryStreamPacket> packet) {
+  switch (message) {
+    case StreamDemuxer::kAudioPkt:
+    case StreamDemuxer::kVideoPkt:
+      if (packet) AddPackets(1, packet->GetDataSize());
+      break;
+    case StreamDemuxer::kEndOfStream:
+      // The demuxer can't be destroyed in its own callback.
+      thread_.message_loop().PostWork(cc_factory_.NewCallback(
+          &DemuxerBenchmark::FinishOnBenchmarkThread, true));
+      break;
+    case StreamDemuxer::kError:
+      LOG_ERROR("Demuxer reported an error");
+      break;
+    default:
+      break;
+  }
+}
+
+void DemuxerBenchmark::OnPackets(StreamDemuxer::Message message,
+                                 StreamDemuxer::PacketBatch packets) {
+  size_t bytes = 0;
+  for (const auto& packet : packets)
+    bytes += packet->GetDataSize();
+  AddPackets(packets.size(), bytes);
+}
+
+void DemuxerBenchmark::AddPackets(size_t count, size_t bytes) {
+  double latency = duration<double, std::milli>(
+      steady_clock::now() - last_parse_).count();
+  latencies_.insert(latencies_.end(), count, latency);
+  packets_ += count;
+  bytes_ += bytes;
+  heap_peak_ = std::max(heap_peak_, HeapInUse());
+}
+
+void DemuxerBenchmark::FinishOnBenchmarkThread(int32_t, bool ok) {
+  Finish(ok);
+}
+
+void DemuxerBenchmark::Finish(bool ok) {
+  Result result = Result();
+  result.ok = ok;
+  if (ok) {
+    result.seconds = duration<double>(steady_clock::now() - start_).count();
+    result.packets = packets_;
+    result.bytes = bytes_;
+    if (result.seconds > 0.) {
+      result.packets_per_second = packets_ / result.seconds;
+      result.megabytes_per_second = bytes_ / 1e6 / result.seconds;
+    }
+    std::sort(latencies_.begin(), latencies_.end());
+    result.latency_p50 = Percentile(latencies_, 50.);
+    result.latency_p95 = Percentile(latencies_, 95.);
+    result.latency_max = latencies_.empty() ? 0. : latencies_.back();
+    if (packets_ > 0) {
+      result.allocations_per_packet = static_cast<double>(
+          PacketAllocations() - allocations_start_) / packets_;
+    }
+    result.peak_heap_bytes = heap_peak_ - heap_start_;
+    LOG_INFO("%s demuxer: %llu packets in %.3f [s], %.0f packets/s, "
+             "%.2f MB/s, latency p50: %.2f p95: %.2f max: %.2f [ms], "
+             "%.3f allocations per packet, peak heap growth: %llu bytes",
+             KindName(kind_), static_cast<unsigned long long>(packets_),
+             result.seconds, result.packets_per_second,
+             result.megabytes_per_second, result.latency_p50,
+             result.latency_p95, result.latency_max,
+             result.allocations_per_packet,
+             static_cast<unsigned long long>(result.peak_heap_bytes));
+  }
+  // The demuxer is destroyed on this thread, after its last callback.
+  demuxer_.reset();
+  segments_.clear();
+  latencies_.clear();
+  if (callback_) callback_(result);
+  callback_ = nullptr;
+  running_ = false;
+}
@@ -0,0 +1,123 @@
+/*!
+ * demuxer_benchmark.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_DEMUXER_DEMUXER_BENCHMARK_H_
+#define NATIVE_PLAYER_SRC_DEMUXER_DEMUXER_BENCHMARK_H_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/simple_thread.h"
+
+#include "demuxer/stream_demuxer.h"
+
+// Measures throughput of a demuxer on recorded content: an initialization
+// segment and media segments are downloaded first, then passed to
+// StreamDemuxer::Parse one by one on the benchmark thread, which is also the
+// callback dispatcher of the demuxer, like in StreamManager. Only parsing is
+// measured, up to the end of stream callback.
+class DemuxerBenchmark {
+ public:
+  enum class DemuxerKind {
+    // A demuxer created by StreamDemuxer::Create.
+    kDefault,
+    kFFmpeg
+  };
+
+  struct Result {
+    bool ok;
+    uint64_t packets;
+    uint64_t bytes;
+    double seconds;
+    double packets_per_second;
+    double megabytes_per_second;
+    // Time from the latest Parse() call to a packet callback, in
+    // milliseconds.
+    double latency_p50;
+    double latency_p95;
+    double latency_max;
+    // Heap allocations of packets and their storages per demuxed packet.
+    double allocations_per_packet;
+    // Peak growth of the heap during parsing, in bytes. NaCl has no RSS, so
+    // it's measured with mallinfo().
+    uint64_t peak_heap_bytes;
+  };
+
+  typedef std::function<void(const Result&)> ResultCallback;
+
+  explicit DemuxerBenchmark(const pp::InstanceHandle& instance);
+  ~DemuxerBenchmark();
+
+  // Starts a benchmark, unless one is running already. The callback is
+  // called on the benchmark thread.
+  bool Start(StreamDemuxer::Type type, DemuxerKind kind,
+             const std::string& init_url,
+             const std::vector<std::string>& media_urls,
+             const ResultCallback& callback);
+
+  bool IsRunning() const { return running_; }
+
+  static const char* KindName(DemuxerKind kind);
+
+ private:
+  void RunOnBenchmarkThread(int32_t);
+  void ParseNextOnBenchmarkThread(int32_t);
+  void OnPacket(StreamDemuxer::Message message,
+                std::unique_ptr<ElementaryStreamPacket> packet);
+  void OnPackets(StreamDemuxer::Message message,
+                 StreamDemuxer::PacketBatch packets);
+  void AddPackets(size_t count, size_t bytes);
+  void FinishOnBenchmarkThread(int32_t, bool ok);
+  // Reports the result and destroys the demuxer.
+  void Finish(bool ok);
+
+  pp::InstanceHandle instance_;
+  pp::CompletionCallbackFactory<DemuxerBenchmark> cc_factory_;
+  std::atomic<bool> running_;
+  std::atomic<bool> cancelled_;
+
+  // Used on the benchmark thread while a benchmark runs.
+  StreamDemuxer::Type type_;
+  DemuxerKind kind_;
+  std::string init_url_;
+  std::vector<std::string> media_urls_;
+  ResultCallback callback_;
+  std::unique_ptr<StreamDemuxer> demuxer_;
+  std::vector<std::vector<uint8_t>> segments_;
+  size_t next_segment_;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point last_parse_;
+  std::vector<double> latencies_;
+  uint64_t packets_;
+  uint64_t bytes_;
+  uint64_t allocations_start_;
+  size_t heap_start_;
+  size_t heap_peak_;
+
+  // Declared last, so it's joined before other members are destroyed.
+  pp::SimpleThread thread_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_DEMUXER_DEMUXER_BENCHMARK_H_
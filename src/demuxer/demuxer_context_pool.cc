@@ -0,0 +1,121 @@
+/*!
+ * demuxer_context_pool.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDemuxer
+
+#include "demuxer_context_pool.h"
+
+#include <iterator>
+
+#include "common.h"
+
+constexpr size_t DemuxerContextPool::kMinBufferSize;
+constexpr size_t DemuxerContextPool::kMaxBufferSize;
+constexpr size_t DemuxerContextPool::kMaxIdleBuffers;
+constexpr size_t DemuxerContextPool::kMaxIdleContexts;
+
+DemuxerContextPool& DemuxerContextPool::Get() {
+  // Never destroyed, as demuxers can still be destroyed at exit.
+  static DemuxerContextPool* pool = new DemuxerContextPool;
+  return *pool;
+}
+
+DemuxerContextPool::DemuxerContextPool()
+    : memory_usage_(MemoryConsumer::kDemuxers) {}
+
+uint8_t* DemuxerContextPool::AcquireBuffer(size_t size) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // The most recently released buffers are the most likely to be warm.
+    for (auto it = idle_buffers_.rbegin(); it != idle_buffers_.rend(); ++it) {
+      if (it->second != size) continue;
+      uint8_t* buffer = it->first;
+      idle_buffers_.erase(std::next(it).base());
+      memory_usage_.Remove(size);
+      return buffer;
+    }
+  }
+  LOG_DEBUG("Allocating an AVIO buffer of %zu bytes", size);
+  return static_cast<uint8_t*>(av_malloc(size));
+}
+
+void DemuxerContextPool::ReleaseBuffer(uint8_t* buffer, size_t size) {
+  if (!buffer) return;
+
+  std::vector<uint8_t*> evicted;
+  if (size >= kMinBufferSize && size <= kMaxBufferSize) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t limit = MemoryGovernor::ScaleLimit(kMaxIdleBuffers);
+    while (limit > 0 && idle_buffers_.size() >= limit) {
+      evicted.push_back(idle_buffers_.front().first);
+      memory_usage_.Remove(idle_buffers_.front().second);
+      idle_buffers_.erase(idle_buffers_.begin());
+    }
+    if (limit > 0) {
+      idle_buffers_.emplace_back(buffer, size);
+      memory_usage_.Add(size);
+      buffer = nullptr;
+    }
+  }
+  // Freed without the lock, so demuxers taking buffers don't wait.
+  for (uint8_t* evicted_buffer : evicted)
+    av_free(evicted_buffer);
+  av_free(buffer);
+}
+
+AVFormatContext* DemuxerContextPool::AcquireFormatContext() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!idle_contexts_.empty()) {
+      AVFormatContext* context = idle_contexts_.back();
+      idle_contexts_.pop_back();
+      return context;
+    }
+  }
+  LOG_DEBUG("Allocating a format context");
+  return avformat_alloc_context();
+}
+
+void DemuxerContextPool::ReleaseFormatContext(AVFormatContext* context,
+                                              bool opened) {
+  if (!context) return;
+
+  if (opened) {
+    avformat_close_input(&context);
+    Refill();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (idle_contexts_.size() < kMaxIdleContexts) {
+      idle_contexts_.push_back(context);
+      return;
+    }
+  }
+  avformat_free_context(context);
+}
+
+void DemuxerContextPool::Refill() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (idle_contexts_.size() >= kMaxIdleContexts) return;
+  }
+  // Allocated without the lock, so demuxers taking contexts don't wait.
+  ReleaseFormatContext(avformat_alloc_context(), false);
+}
@@ -0,0 +1,87 @@
+/*!
+ * demuxer_context_pool.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_DEMUXER_DEMUXER_CONTEXT_POOL_H_
+#define SRC_DEMUXER_DEMUXER_CONTEXT_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include "libavformat/avformat.h"
+}
+
+#include "memory_governor.h"
+
+// Keeps AVIO buffers and format contexts of FFMpegDemuxers for reuse, as
+// seeks and representation changes replace demuxers and flush their
+// contexts. Buffers are large, so reusing them avoids allocation latency
+// and heap fragmentation. Format contexts are freed by FFmpeg once they are
+// opened, so an opened one given back is replaced with a new context right
+// away: it's allocated when a demuxer is destroyed or flushed, instead of
+// when the next one starts parsing. Idle buffers count as demuxer memory
+// and fewer of them are kept under memory pressure. Buffers are sized per
+// stream, so a buffer is reused only by a demuxer asking for its size and the
+// least recently released ones make room for others. It's thread safe.
+class DemuxerContextPool {
+ public:
+  // Range of buffer sizes which are kept for reuse.
+  static constexpr size_t kMinBufferSize = 16 * 1024;
+  static constexpr size_t kMaxBufferSize = 1024 * 1024;
+  // Enough for both demuxers of a playback and ones replacing them.
+  static constexpr size_t kMaxIdleBuffers = 4;
+  static constexpr size_t kMaxIdleContexts = 4;
+
+  static DemuxerContextPool& Get();
+
+  // Returns a buffer of the given size allocated with av_malloc(), or null
+  // if allocation fails.
+  uint8_t* AcquireBuffer(size_t size);
+
+  // Takes back a buffer of an AVIO context. FFmpeg may replace the buffer
+  // with one of a different size, so the current size must be given. Buffers
+  // of sizes out of the kept range are freed.
+  void ReleaseBuffer(uint8_t* buffer, size_t size);
+
+  // Returns an unopened format context, or null if allocation fails. It
+  // may have been used by a demuxer which didn't open it, so fields a
+  // demuxer relies on must be set.
+  AVFormatContext* AcquireFormatContext();
+
+  // Takes back a format context. An opened one is closed, which frees it.
+  // Its custom AVIO context is not freed.
+  void ReleaseFormatContext(AVFormatContext* context, bool opened);
+
+ private:
+  DemuxerContextPool();
+
+  // Adds a new context if there are less than kMaxIdleContexts.
+  void Refill();
+
+  std::mutex mutex_;
+  // Buffers and their sizes, the least recently released first.
+  std::vector<std::pair<uint8_t*, size_t>> idle_buffers_;
+  std::vector<AVFormatContext*> idle_contexts_;
+  MemoryUsage memory_usage_;
+};
+
+#endif  // SRC_DEMUXER_DEMUXER_CONTEXT_POOL_H_
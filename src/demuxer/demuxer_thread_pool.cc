@@ -0,0 +1,115 @@
+/*!
+ * demuxer_thread_pool.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDemuxer
+
+#include "demuxer_thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "common.h"
+
+constexpr size_t DemuxerThreadPool::kMaxIdleThreads;
+constexpr int64_t DemuxerThreadPool::kIdleTimeoutMs;
+
+DemuxerThreadPool::Job::Job() : finished_(false) {}
+
+void DemuxerThreadPool::Job::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  finished_condition_.wait(lock, [this]() { return finished_; });
+}
+
+void DemuxerThreadPool::Job::Finish() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+  }
+  finished_condition_.notify_all();
+}
+
+DemuxerThreadPool& DemuxerThreadPool::Get() {
+  // Never destroyed, as detached workers can still use it at exit.
+  static DemuxerThreadPool* pool = new DemuxerThreadPool;
+  return *pool;
+}
+
+std::shared_ptr<DemuxerThreadPool::Job> DemuxerThreadPool::Run(
+    ThreadRole role, std::function<void()> function) {
+  auto job = std::make_shared<Job>();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find_if(idle_workers_.begin(), idle_workers_.end(),
+        [role](const std::shared_ptr<Worker>& worker) {
+          return worker->role == role;
+        });
+    if (it != idle_workers_.end()) {
+      auto worker = *it;
+      idle_workers_.erase(it);
+      worker->function = std::move(function);
+      worker->job = job;
+      worker->wake_condition.notify_one();
+      return job;
+    }
+  }
+
+  LOG_DEBUG("Starting a demuxer thread");
+  auto worker = std::make_shared<Worker>();
+  worker->role = role;
+  worker->function = std::move(function);
+  worker->job = job;
+  // Workers outlive demuxers, the pool keeps track of them instead.
+  ThreadConfig::StartThread(role, [this, worker]() {
+    WorkerLoop(worker);
+  })->detach();
+  return job;
+}
+
+void DemuxerThreadPool::WorkerLoop(const std::shared_ptr<Worker>& worker) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    auto function = std::move(worker->function);
+    auto job = std::move(worker->job);
+    worker->function = nullptr;
+    lock.unlock();
+    {
+      // Only threads running a demuxer are expected while playing.
+      ScopedResourceCount thread_count(TrackedResource::kThread);
+      function();
+    }
+    job->Finish();
+    // Objects captured by the function are released before it's reused.
+    function = nullptr;
+    lock.lock();
+
+    if (idle_workers_.size() >= kMaxIdleThreads) break;
+    idle_workers_.push_back(worker);
+    bool woken = worker->wake_condition.wait_for(lock,
+        std::chrono::milliseconds(kIdleTimeoutMs),
+        [&worker]() { return static_cast<bool>(worker->function); });
+    if (!woken) {
+      idle_workers_.erase(std::remove(idle_workers_.begin(),
+                                      idle_workers_.end(), worker),
+                          idle_workers_.end());
+      break;
+    }
+  }
+  LOG_DEBUG("Demuxer thread exits");
+}
@@ -0,0 +1,83 @@
+/*!
+ * demuxer_thread_pool.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_DEMUXER_DEMUXER_THREAD_POOL_H_
+#define SRC_DEMUXER_DEMUXER_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "thread_config.h"
+
+// Runs parser loops of FFMpegDemuxers on reused threads. FFmpeg pulls data
+// from a blocking read callback, so a loop keeps its thread until its
+// demuxer is destroyed. A thread whose loop ended waits for the next demuxer
+// of the same role, though, so seeks and representation changes, which
+// replace demuxers, don't start threads. Idle threads exit after a while.
+// It's thread safe.
+class DemuxerThreadPool {
+ public:
+  // Lets the owner of a function wait until it returns.
+  class Job {
+   public:
+    Job();
+    void Wait();
+
+   private:
+    friend class DemuxerThreadPool;
+    void Finish();
+
+    std::mutex mutex_;
+    std::condition_variable finished_condition_;
+    bool finished_;
+  };
+
+  // Threads kept idle at most, enough for both demuxers of a playback and
+  // ones replacing them.
+  static constexpr size_t kMaxIdleThreads = 4;
+  static constexpr int64_t kIdleTimeoutMs = 10000;
+
+  static DemuxerThreadPool& Get();
+
+  // Runs function on an idle thread of the role, or on a new one.
+  std::shared_ptr<Job> Run(ThreadRole role, std::function<void()> function);
+
+ private:
+  struct Worker {
+    ThreadRole role;
+    // Set when the worker is given a function, used under mutex_.
+    std::function<void()> function;
+    std::shared_ptr<Job> job;
+    std::condition_variable wake_condition;
+  };
+
+  DemuxerThreadPool() = default;
+
+  void WorkerLoop(const std::shared_ptr<Worker>& worker);
+
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<Worker>> idle_workers_;
+};
+
+#endif  // SRC_DEMUXER_DEMUXER_THREAD_POOL_H_
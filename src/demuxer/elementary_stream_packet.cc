@@ -19,13 +19,234 @@
 
 #include "demuxer/elementary_stream_packet.h"
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+
 using Samsung::NaClPlayer::EncryptedSubsampleDescription;
 using Samsung::NaClPlayer::ESPacket;
 using Samsung::NaClPlayer::ESPacketEncryptionInfo;
 using Samsung::NaClPlayer::TimeTicks;
 
+namespace {
+
+// Upper limit of released packet objects kept for reuse.
+const size_t kMaxPooledPackets = 512;
+
+// Upper limit of bytes held by pooled storages. Storages which would exceed
+// it (e.g. ones that carried a large video key frame) are released.
+const size_t kMaxPooledStorageBytes = 8 * 1024 * 1024;
+
+// CENC key ids are always 16 bytes long, IVs are either 8 or 16 bytes long.
+const size_t kInlineKeyIdSize = 16;
+const size_t kInlineIvSize = 16;
+
+// Most encrypted frames have only a few subsamples (e.g. one for each NAL
+// unit of a video frame).
+const size_t kInlineSubsamplesCount = 8;
+
+// Array which holds up to N elements inline and spills to the heap only when
+// a bigger one is needed. Address of the inline storage doesn't change as
+// long as the SmallBuffer object isn't moved.
+template <typename T, size_t N>
+class SmallBuffer {
+ public:
+  SmallBuffer() : size_(0) {}
+
+  const T* data() const { return size_ <= N ? inline_ : heap_.data(); }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_t HeapCapacity() const { return heap_.capacity() * sizeof(T); }
+
+  void assign(const T* begin, const T* end) {
+    size_ = end - begin;
+    if (size_ <= N) {
+      std::copy(begin, end, inline_);
+      heap_.clear();
+    } else {
+      heap_.assign(begin, end);
+    }
+  }
+
+  void push_back(const T& value) {
+    if (size_ < N) {
+      inline_[size_++] = value;
+      return;
+    }
+    if (size_ == N) heap_.assign(inline_, inline_ + N);
+    heap_.push_back(value);
+    ++size_;
+  }
+
+  void clear() {
+    size_ = 0;
+    heap_.clear();
+  }
+
+ private:
+  T inline_[N];
+  std::vector<T> heap_;
+  size_t size_;
+};
+
+}  // anonymous namespace
+
+struct ElementaryStreamPacket::Storage {
+  size_t Capacity() const {
+    return data_.capacity() + key_id_.HeapCapacity() + iv_.HeapCapacity() +
+        subsamples_.HeapCapacity();
+  }
+
+  void Clear() {
+    data_.clear();
+    shared_data_.reset();
+    key_id_.clear();
+    iv_.clear();
+    subsamples_.clear();
+  }
+
+  std::vector<uint8_t> data_;
+  // Used instead of data_ when packet refers to a demuxer's buffer.
+  std::shared_ptr<const std::vector<uint8_t>> shared_data_;
+  const uint8_t* shared_data_ptr_;
+  uint32_t shared_data_size_;
+  SmallBuffer<uint8_t, kInlineKeyIdSize> key_id_;
+  SmallBuffer<uint8_t, kInlineIvSize> iv_;
+  SmallBuffer<EncryptedSubsampleDescription, kInlineSubsamplesCount>
+      subsamples_;
+};
+
+namespace {
+
+// Packets are created on a demuxer thread and destroyed on the player thread,
+// hence all pools are guarded by a mutex.
+class PacketPool {
+ public:
+  static PacketPool& Get() {
+    // Intentionally leaked, so there is no destruction order issue with
+    // packets released during exit.
+    static PacketPool* pool = new PacketPool();
+    return *pool;
+  }
+
+  void* AllocatePacket(size_t size) {
+    ++live_packets_;
+    if (size == sizeof(ElementaryStreamPacket)) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!packets_.empty()) {
+        void* ptr = packets_.back();
+        packets_.pop_back();
+        return ptr;
+      }
+    }
+    ++packet_allocations_;
+    return ::operator new(size);
+  }
+
+  void ReleasePacket(void* ptr) {
+    --live_packets_;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (packets_.size() < kMaxPooledPackets) {
+        packets_.push_back(ptr);
+        return;
+      }
+    }
+    ::operator delete(ptr);
+  }
+
+  template <typename StorageT>
+  StorageT* AcquireStorage() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!storages_.empty()) {
+        StorageT* storage = static_cast<StorageT*>(storages_.back());
+        storages_.pop_back();
+        storage_bytes_ -= storage->Capacity();
+        return storage;
+      }
+    }
+    ++storage_allocations_;
+    return new StorageT();
+  }
+
+  template <typename StorageT>
+  void ReleaseStorage(StorageT* storage) {
+    storage->Clear();
+    size_t capacity = storage->Capacity();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (storages_.size() < kMaxPooledPackets &&
+          storage_bytes_ + capacity <= kMaxPooledStorageBytes) {
+        storages_.push_back(storage);
+        storage_bytes_ += capacity;
+        return;
+      }
+    }
+    delete storage;
+  }
+
+  ElementaryStreamPacket::AllocationStats GetAllocationStats() const {
+    return {packet_allocations_.load(), storage_allocations_.load(),
+            live_packets_.load()};
+  }
+
+ private:
+  PacketPool()
+      : storage_bytes_(0),
+        packet_allocations_(0),
+        storage_allocations_(0),
+        live_packets_(0) {
+    packets_.reserve(kMaxPooledPackets);
+    storages_.reserve(kMaxPooledPackets);
+  }
+
+  std::mutex mutex_;
+  std::vector<void*> packets_;
+  std::vector<void*> storages_;
+  size_t storage_bytes_;
+  std::atomic<uint64_t> packet_allocations_;
+  std::atomic<uint64_t> storage_allocations_;
+  std::atomic<int64_t> live_packets_;
+};
+
+}  // anonymous namespace
+
+void ElementaryStreamPacket::StorageDeleter::operator()(
+    Storage* storage) const {
+  PacketPool::Get().ReleaseStorage(storage);
+}
+
+void* ElementaryStreamPacket::operator new(size_t size) {
+  return PacketPool::Get().AllocatePacket(size);
+}
+
+void ElementaryStreamPacket::operator delete(void* ptr) {
+  if (ptr) PacketPool::Get().ReleasePacket(ptr);
+}
+
+ElementaryStreamPacket::AllocationStats
+ElementaryStreamPacket::GetAllocationStats() {
+  return PacketPool::Get().GetAllocationStats();
+}
+
 ElementaryStreamPacket::ElementaryStreamPacket(uint8_t* data, uint32_t size)
-    : data_(data, data + size) {
+    : storage_(PacketPool::Get().AcquireStorage<Storage>()) {
+  storage_->data_.assign(data, data + size);
+  FixDataInvariant();
+  FixKeyIdInvariant();
+  FixIvInvariant();
+  FixSubsamplesInvariant();
+}
+
+ElementaryStreamPacket::ElementaryStreamPacket(
+    std::shared_ptr<const std::vector<uint8_t>> buffer, uint32_t offset,
+    uint32_t size)
+    : storage_(PacketPool::Get().AcquireStorage<Storage>()) {
+  storage_->shared_data_ptr_ = buffer->data() + offset;
+  storage_->shared_data_size_ = size;
+  storage_->shared_data_ = std::move(buffer);
   FixDataInvariant();
   FixKeyIdInvariant();
   FixIvInvariant();
@@ -43,56 +264,61 @@ const ESPacketEncryptionInfo& ElementaryStreamPacket::GetEncryptionInfo()
 
 bool ElementaryStreamPacket::IsEncrypted() const {
   // There might be 0 subsamples in encrypted packet.
-  return !key_id_.empty() || !iv_.empty();
+  return !storage_->key_id_.empty() || !storage_->iv_.empty();
 }
 
 void ElementaryStreamPacket::SetKeyId(uint8_t* key_id, uint32_t key_id_size) {
   if (key_id && key_id_size)
-    key_id_.assign(key_id, key_id + key_id_size);
+    storage_->key_id_.assign(key_id, key_id + key_id_size);
   else
-    key_id_.clear();
+    storage_->key_id_.clear();
 
   FixKeyIdInvariant();
 }
 
 void ElementaryStreamPacket::SetIv(uint8_t* iv, uint32_t iv_size) {
   if (iv && iv_size)
-    iv_.assign(iv, iv + iv_size);
+    storage_->iv_.assign(iv, iv + iv_size);
   else
-    iv_.clear();
+    storage_->iv_.clear();
 
   FixIvInvariant();
 }
 
 void ElementaryStreamPacket::ClearSubsamples() {
-  subsamples_.clear();
+  storage_->subsamples_.clear();
   FixSubsamplesInvariant();
 }
 
 void ElementaryStreamPacket::AddSubsample(uint32_t clear_bytes,
                                           uint32_t cipher_bytes) {
   EncryptedSubsampleDescription subsample = {clear_bytes, cipher_bytes};
-  subsamples_.push_back(subsample);
+  storage_->subsamples_.push_back(subsample);
   FixSubsamplesInvariant();
 }
 
 // es_packet.data == data_.data() && es_packet.size == data.size()
 void ElementaryStreamPacket::FixDataInvariant() {
-  es_packet_.buffer = data_.data();
-  es_packet_.size = data_.size();
+  if (storage_->shared_data_) {
+    es_packet_.buffer = storage_->shared_data_ptr_;
+    es_packet_.size = storage_->shared_data_size_;
+    return;
+  }
+  es_packet_.buffer = storage_->data_.data();
+  es_packet_.size = storage_->data_.size();
 }
 
 void ElementaryStreamPacket::FixKeyIdInvariant() {
-  encryption_info_.key_id = key_id_.data();
-  encryption_info_.key_id_size = key_id_.size();
+  encryption_info_.key_id = storage_->key_id_.data();
+  encryption_info_.key_id_size = storage_->key_id_.size();
 }
 
 void ElementaryStreamPacket::FixIvInvariant() {
-  encryption_info_.iv = iv_.data();
-  encryption_info_.iv_size = iv_.size();
+  encryption_info_.iv = storage_->iv_.data();
+  encryption_info_.iv_size = storage_->iv_.size();
 }
 
 void ElementaryStreamPacket::FixSubsamplesInvariant() {
-  encryption_info_.subsamples = subsamples_.data();
-  encryption_info_.num_subsamples = subsamples_.size();
+  encryption_info_.subsamples = storage_->subsamples_.data();
+  encryption_info_.num_subsamples = storage_->subsamples_.size();
 }
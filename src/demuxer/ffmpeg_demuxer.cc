@@ -18,6 +18,8 @@
  * @author Tomasz Borkowski
  */
 
+#define LOG_CATEGORY LogCategory::kDemuxer
+
 #include <algorithm>
 #include <cmath>
 #include <iomanip>
@@ -30,9 +32,16 @@ extern "C" {
 }
 
 #include "ffmpeg_demuxer.h"
+#include "allocation_tracker.h"
 #include "common.h"
+#include "cpu_profiler.h"
+#include "hash_bytes.h"
+#include "thread_config.h"
+#include "tracer.h"
+#include "tuning_profile.h"
 
 #include "convert_codecs.h"
+#include "demuxer_context_pool.h"
 
 using pp::AutoLock;
 using pp::MessageLoop;
@@ -51,22 +60,44 @@ const std::string kDRMInitDataType("cenc:pssh");
 
 static const int kKidLength = 16;
 static const size_t kErrorBufferSize = 1024;
-static const uint32_t kBufferSize = 128 * 1024;
-static const uint32_t kMicrosecondsPerSecond = 1000000;
-static const TimeTicks kOneMicrosecond = 1.0 / kMicrosecondsPerSecond;
-static const AVRational kMicrosBase = {1, kMicrosecondsPerSecond};
-
-static const uint32_t kAnalyzeDuration = 10 * kMicrosecondsPerSecond;
-static const uint32_t kAudioStreamProbeSize = 512;
-static const uint32_t kVideoStreamProbeSize = 128 * 1024;
-
-static const double kSegmentEps = 0.5;
-
-static int s_demux_id = 0;
+static const AVRational kMediaTimeBase = {
+    1, static_cast<int>(kMediaTimescale)};
+
+// AVIO buffer sizes used when bitrate or segment duration is not known.
+static const size_t kAudioIoBufferSize = 32 * 1024;
+static const size_t kVideoIoBufferSize = 128 * 1024;
+// Otherwise a segment is read in about that many Read() calls, each taking
+// buffer_mutex_.
+static const size_t kReadsPerSegment = 4;
+
+static const MediaTime kSegmentEps = kMediaTimescale / 2;
+
+// Most bytes of the first chunk hashed to key probed stream info, an init
+// segment usually fits in them.
+static const size_t kMaxInitKeyBytes = 64 * 1024;
+static const size_t kMaxCachedProbes = 16;
+
+static const size_t kMaxPacketBatchSize = 32;
+static const std::chrono::milliseconds kMaxPacketBatchDelay(20);
+
+// Picks an AVIO buffer size, so high bitrate segments are read in few large
+// Read() calls, while audio doesn't hold a buffer much bigger than its
+// segments.
+static size_t IoBufferSize(StreamDemuxer::Type type,
+                           const DemuxerOptions& options) {
+  if (options.bitrate == 0 || options.segment_duration <= 0.)
+    return type == StreamDemuxer::kAudio ? kAudioIoBufferSize
+                                         : kVideoIoBufferSize;
+  double segment_bytes = options.bitrate / 8. * options.segment_duration;
+  size_t size = DemuxerContextPool::kMinBufferSize;
+  while (size < DemuxerContextPool::kMaxBufferSize &&
+         size * kReadsPerSegment < segment_bytes)
+    size *= 2;
+  return size;
+}
 
-static TimeTicks ToTimeTicks(int64_t time_ticks, AVRational time_base) {
-  int64_t us = av_rescale_q(time_ticks, time_base, kMicrosBase);
-  return us * kOneMicrosecond;
+static MediaTime ToMediaTime(int64_t time_ticks, AVRational time_base) {
+  return av_rescale_q(time_ticks, time_base, kMediaTimeBase);
 }
 
 static int AVIOReadOperation(void* opaque, uint8_t* buf, int buf_size) {
@@ -78,6 +109,106 @@ static int AVIOReadOperation(void* opaque, uint8_t* buf, int buf_size) {
   return result;
 }
 
+// Makes FFmpeg give up blocking operations, e.g. probing streams or parsing
+// data left in the AVIO buffer, once the demuxer is aborted or flushed.
+static int AVIOInterruptOperation(void* opaque) {
+  FFMpegDemuxer* parser = reinterpret_cast<FFMpegDemuxer*>(opaque);
+  return parser->IsInterrupted() ? 1 : 0;
+}
+
+// Reads AAC profile from AudioSpecificConfig (ISO/IEC 14496-3), used when
+// stream wasn't probed by a decoder. FF_PROFILE_AAC_* values are equal to
+// audio object type - 1.
+static int AACProfileFromExtraData(const uint8_t* data, int size) {
+  if (!data || size < 1) return FF_PROFILE_UNKNOWN;
+  int object_type = data[0] >> 3;
+  if (object_type == 31) {  // escape value
+    if (size < 2) return FF_PROFILE_UNKNOWN;
+    object_type = 32 + (((data[0] & 0x07) << 3) | (data[1] >> 5));
+  }
+  return object_type - 1;
+}
+
+// Reads H.264 profile from AVCDecoderConfigurationRecord (ISO/IEC 14496-15),
+// used when stream wasn't probed by a decoder.
+static int H264ProfileFromExtraData(const uint8_t* data, int size) {
+  const uint8_t kAvcConfigurationVersion = 1;
+  if (!data || size < 4 || data[0] != kAvcConfigurationVersion)
+    return FF_PROFILE_UNKNOWN;
+  return data[1];
+}
+
+// Reads a profile, a level and a bit depth from an
+// HEVCDecoderConfigurationRecord (ISO/IEC 14496-15), used when stream wasn't
+// probed by a decoder.
+static void HevcConfigFromExtraData(const uint8_t* data, int size,
+                                    VideoConfig* config) {
+  const int kMinHevcConfigSize = 23;
+  if (!data || size < kMinHevcConfigSize) return;
+  config->profile_idc = data[1] & 0x1f;
+  config->level_idc = data[12];
+  config->bit_depth = (data[17] & 0x07) + 8;
+}
+
+// Configurations found by avformat_find_stream_info() for an init segment.
+// Representations are switched back and forth and seeks re-create demuxers,
+// so the same init segment is probed over and over, while probing decodes
+// frames and waits for media data. Configurations are shared by all
+// demuxers, the least recently used ones are dropped.
+class ProbedStreamsCache {
+ public:
+  struct Entry {
+    uint64_t key;
+    uint32_t stream_count;
+    int audio_stream_idx;
+    int video_stream_idx;
+    AudioConfig audio_config;
+    VideoConfig video_config;
+  };
+
+  static ProbedStreamsCache& Get() {
+    static ProbedStreamsCache cache;
+    return cache;
+  }
+
+  bool Find(uint64_t key, Entry* entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      if (it->key != key) continue;
+      entries_.splice(entries_.begin(), entries_, it);
+      *entry = entries_.front();
+      return true;
+    }
+    return false;
+  }
+
+  void Add(Entry entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.remove_if([&entry](const Entry& e) {
+      return e.key == entry.key;
+    });
+    entries_.emplace_front(std::move(entry));
+    if (entries_.size() > kMaxCachedProbes) entries_.pop_back();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::list<Entry> entries_;
+};
+
+// Finds stream info of a probed init segment. Streams are told apart by the
+// container header, so the cached ones must be found again in the unprobed
+// context.
+static bool FindProbedStreams(AVFormatContext* context, uint64_t key,
+                              ProbedStreamsCache::Entry* entry) {
+  if (key == 0 || !ProbedStreamsCache::Get().Find(key, entry)) return false;
+  return entry->stream_count == context->nb_streams &&
+      entry->audio_stream_idx == av_find_best_stream(
+          context, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0) &&
+      entry->video_stream_idx == av_find_best_stream(
+          context, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+}
+
 template <size_t N, size_t M>
 static bool SystemIdEqual(const uint8_t(&s0)[N], const uint8_t(&s1)[M]) {
   if (N != M) return false;
@@ -87,14 +218,26 @@ static bool SystemIdEqual(const uint8_t(&s0)[N], const uint8_t(&s1)[M]) {
   return true;
 }
 
-unique_ptr<StreamDemuxer> StreamDemuxer::Create(
-    const pp::InstanceHandle& instance, Type type, InitMode init_mode) {
+unique_ptr<StreamDemuxer> FFMpegDemuxer::Create(
+    const pp::InstanceHandle& instance, Type type, InitMode init_mode,
+    const DemuxerOptions& options) {
+  // Values of the current TuningProfile are used unless options set them.
+  uint32_t probe_size = options.probe_size;
+  int64_t analyze_duration = options.analyze_duration;
+  if (probe_size == 0 || analyze_duration == 0) {
+    auto tuning = TuningProfile::Current();
+    if (probe_size == 0) {
+      probe_size = type == kVideo ? tuning.video_probe_size
+                                  : tuning.audio_probe_size;
+    }
+    if (analyze_duration == 0) analyze_duration = tuning.analyze_duration;
+  }
   switch (type) {
     case kAudio:
-      return MakeUnique<FFMpegDemuxer>(instance, kAudioStreamProbeSize, type,
-                                       init_mode);
     case kVideo:
-      return MakeUnique<FFMpegDemuxer>(instance, kVideoStreamProbeSize, type,
+      return MakeUnique<FFMpegDemuxer>(instance, probe_size,
+                                       analyze_duration,
+                                       IoBufferSize(type, options), type,
                                        init_mode);
     default:
       LOG_ERROR("ERROR - not supported type of stream");
@@ -104,22 +247,37 @@ unique_ptr<StreamDemuxer> StreamDemuxer::Create(
 }
 
 FFMpegDemuxer::FFMpegDemuxer(const pp::InstanceHandle& instance,
-                             uint32_t probe_size, Type type, InitMode init_mode)
+                             uint32_t probe_size, int64_t analyze_duration,
+                             size_t io_buffer_size, Type type,
+                             InitMode init_mode)
     : stream_type_(type),
       audio_stream_idx_(-1),
       video_stream_idx_(-1),
       callback_factory_(this),
       format_context_(nullptr),
       io_context_(nullptr),
+      buffered_bytes_(0),
+      reading_offset_(0),
+      reading_bytes_(0),
+      chunk_read_(false),
+      memory_usage_(MemoryConsumer::kDemuxers),
       context_opened_(false),
       streams_initialized_(false),
       end_of_file_(false),
       exited_(false),
+      aborted_(false),
+      flush_requested_(false),
+      generation_(0),
+      parser_generation_(0),
+      packet_batch_msg_(kError),
       probe_size_(probe_size),
-      timestamp_(0.0),
+      analyze_duration_(analyze_duration),
+      io_buffer_size_(io_buffer_size),
+      timestamp_(0),
       has_packets_(false),
       init_mode_(init_mode),
-      demux_id_(++s_demux_id) {
+      init_key_(0),
+      demux_id_(NextDemuxId()) {
   LOG_DEBUG("parser: %p", this);
   audio_config_.demux_id = demux_id_;
   video_config_.demux_id = demux_id_;
@@ -132,9 +290,13 @@ FFMpegDemuxer::~FFMpegDemuxer() {
     exited_ = true;
   }
   buffer_condition_.notify_one();
-  parser_thread_->join();
-  av_freep(io_context_);
-  avformat_free_context(format_context_);
+  if (parser_job_) parser_job_->Wait();
+  auto& pool = DemuxerContextPool::Get();
+  pool.ReleaseFormatContext(format_context_, context_opened_);
+  if (io_context_) {
+    pool.ReleaseBuffer(io_context_->buffer, io_context_->buffer_size);
+    av_freep(&io_context_);
+  }
   LOG_DEBUG("");
 }
 
@@ -151,33 +313,39 @@ bool FFMpegDemuxer::Init(const InitCallback& callback,
 
   InitFFmpeg();
 
-  format_context_ = avformat_alloc_context();
-  io_context_ = avio_alloc_context(
-      reinterpret_cast<unsigned char*>(av_malloc(kBufferSize)), kBufferSize, 0,
-      this, AVIOReadOperation, NULL, NULL);
+  auto& pool = DemuxerContextPool::Get();
+  uint8_t* buffer = pool.AcquireBuffer(io_buffer_size_);
+  if (buffer) {
+    io_context_ = avio_alloc_context(buffer, io_buffer_size_, 0, this,
+                                     AVIOReadOperation, NULL, NULL);
+    if (!io_context_) pool.ReleaseBuffer(buffer, io_buffer_size_);
+  }
 
-  if (format_context_ == NULL || io_context_ == NULL) {
+  if (io_context_ == NULL || !InitFormatContext()) {
     LOG_ERROR("ERROR: failed to allocate avformat or avio context!");
     return false;
   }
 
   io_context_->seekable = 0;
   io_context_->write_flag = 0;
-
-  // Change this value in case when clip is not well recognized by ffmpeg
-  format_context_->probesize = probe_size_;
-  format_context_->max_analyze_duration = kAnalyzeDuration;
-  format_context_->flags |= AVFMT_FLAG_CUSTOM_IO;
-  format_context_->pb = io_context_;
+  {
+    std::unique_lock<std::mutex> lock(buffer_mutex_);
+    UpdateMemoryUsage();
+  }
 
   LOG_INFO("ffmpeg probe size: %u", probe_size_);
+  LOG_INFO("ffmpeg AVIO buffer size: %zu", io_buffer_size_);
   LOG_INFO("ffmpeg analyze duration: %d",
            format_context_->max_analyze_duration);
   LOG_INFO("done, format_context: %p, io_context: %p",
            format_context_, io_context_);
 
   LOG_INFO("Initialized");
-  parser_thread_ = MakeUnique<std::thread>([this](){
+  auto role = stream_type_ == kAudio ? ThreadRole::kAudioDemuxer
+                                     : ThreadRole::kVideoDemuxer;
+  parser_job_ = DemuxerThreadPool::Get().Run(role, [this](){
+    ALLOCATION_SCOPE("demux");
+    CPU_SCOPE(CpuStage::kDemux);
     ParsingThreadFn();
   });
   DispatchCallback(kInitialized);
@@ -185,13 +353,41 @@ bool FFMpegDemuxer::Init(const InitCallback& callback,
   return true;
 }
 
+bool FFMpegDemuxer::InitFormatContext() {
+  format_context_ = DemuxerContextPool::Get().AcquireFormatContext();
+  if (format_context_ == NULL) return false;
+
+  // Change this value in case when clip is not well recognized by ffmpeg
+  format_context_->probesize = probe_size_;
+  format_context_->max_analyze_duration = analyze_duration_;
+  format_context_->flags |= AVFMT_FLAG_CUSTOM_IO;
+  format_context_->pb = io_context_;
+  format_context_->interrupt_callback.callback = AVIOInterruptOperation;
+  format_context_->interrupt_callback.opaque = this;
+  return true;
+}
+
 void FFMpegDemuxer::Flush() {
-  LOG_DEBUG("");
+  LOG_DEBUG("parser: %p", this);
+  {
+    std::unique_lock<std::mutex> lock(buffer_mutex_);
+    buffer_.clear();
+    buffered_bytes_ = 0;
+    UpdateMemoryUsage();
+    end_of_file_ = false;
+    flush_requested_ = true;
+    ++generation_;
+  }
+  buffer_condition_.notify_one();
   DispatchCallback(kFlushed);
 }
 
 void FFMpegDemuxer::Parse(const std::vector<uint8_t>& data) {
-  LOG_DEBUG("parser: %p, data size: %d", this, data.size());
+  Parse(std::vector<uint8_t>(data));
+}
+
+void FFMpegDemuxer::Parse(std::vector<uint8_t>&& data) {
+  LOG_EVERY_MS(Debug, 1000, "parser: %p, data size: %zu", this, data.size());
   bool signal_buffer = false;
   {
     std::unique_lock<std::mutex> lock(buffer_mutex_);
@@ -200,9 +396,11 @@ void FFMpegDemuxer::Parse(const std::vector<uint8_t>& data) {
       end_of_file_ = true;
       signal_buffer = true;
     } else {
-      buffer_.insert(buffer_.end(), data.begin(), data.end());
+      buffered_bytes_ += data.size();
+      buffer_.emplace_back(std::move(data));
+      UpdateMemoryUsage();
       signal_buffer = true;
-      LOG_DEBUG("parser: %p, Added buffer to parser.", this);
+      LOG_EVERY_MS(Debug, 1000, "parser: %p, Added buffer to parser.", this);
     }
   }
   if (signal_buffer)
@@ -243,9 +441,47 @@ bool FFMpegDemuxer::SetDRMInitDataListener(const DrmInitCallback& callback) {
   }
 }
 
+bool FFMpegDemuxer::SetEsPacketsListener(
+    const std::function<void(Message, PacketBatch)>& callback) {
+  if (callback) {
+    es_pkts_callback_ = callback;
+    return true;
+  } else {
+    LOG_DEBUG("callback is null!");
+    return false;
+  }
+}
+
 void FFMpegDemuxer::SetTimestamp(TimeTicks timestamp) {
-  LOG_INFO("current timestamp: %f, new: %f", timestamp_, timestamp);
-  timestamp_ = timestamp;
+  LOG_INFO("current timestamp: %f, new: %f", ToTimeTicks(timestamp_),
+           timestamp);
+  timestamp_ = ToMediaTime(timestamp);
+}
+
+void FFMpegDemuxer::SetCodecs(const std::string& codecs) {
+  LOG_INFO("codecs: %s", codecs.c_str());
+  codecs_ = codecs;
+}
+
+size_t FFMpegDemuxer::QueuedBytes() const {
+  // A chunk which is being read counts as queued until it's fully read.
+  std::unique_lock<std::mutex> lock(buffer_mutex_);
+  return buffered_bytes_ + (chunk_read_ ? 0 : reading_bytes_);
+}
+
+void FFMpegDemuxer::Abort() {
+  LOG_DEBUG("parser: %p", this);
+  {
+    std::unique_lock<std::mutex> lock(buffer_mutex_);
+    buffer_.clear();
+    buffered_bytes_ = 0;
+    UpdateMemoryUsage();
+    exited_ = true;
+    aborted_ = true;
+    // Packets posted already are dropped, like after a flush.
+    ++generation_;
+  }
+  buffer_condition_.notify_one();
 }
 
 void FFMpegDemuxer::Close() {
@@ -254,26 +490,93 @@ void FFMpegDemuxer::Close() {
 }
 
 void FFMpegDemuxer::ParsingThreadFn() {
-  if (!streams_initialized_ && !InitStreamInfo()) {
-    LOG_ERROR("Can't initialize demuxer");
-    return;
+  // Parser thread and contexts are kept alive across flushes, so a seek
+  // doesn't need to wait for a new demuxer to be created.
+  do {
+    if (InitStreamInfo())
+      ParseStream();
+    else if (!IsInterrupted())
+      LOG_ERROR("Can't initialize demuxer");
+  } while (WaitForFlush());
+
+  LOG_DEBUG("Finished parsing data. buffer left: %zu, parser: %p",
+            buffered_bytes_, this);
+}
+
+bool FFMpegDemuxer::WaitForFlush() {
+  {
+    std::unique_lock<std::mutex> lock(buffer_mutex_);
+    buffer_condition_.wait(lock, [this]() {
+      return flush_requested_ || exited_;
+    });
+    if (exited_) return false;
   }
+  ResetContext();
+  return true;
+}
 
+void FFMpegDemuxer::ResetContext() {
+  LOG_DEBUG("parser: %p", this);
+  // Custom AVIOContext is not freed here, as AVFMT_FLAG_CUSTOM_IO is set.
+  DemuxerContextPool::Get().ReleaseFormatContext(format_context_,
+                                                 context_opened_);
+  format_context_ = nullptr;
+
+  // Drop bytes which are still in the AVIO buffer.
+  io_context_->buf_ptr = io_context_->buffer;
+  io_context_->buf_end = io_context_->buffer;
+  io_context_->pos = 0;
+  io_context_->eof_reached = 0;
+  io_context_->error = 0;
+
+  if (!InitFormatContext())
+    LOG_ERROR("ERROR: failed to allocate avformat context!");
+
+  // Stream configurations have been already reported.
+  if (streams_initialized_) init_mode_ = kSkipInitCodecData;
+  context_opened_ = false;
+  streams_initialized_ = false;
+  audio_stream_idx_ = -1;
+  video_stream_idx_ = -1;
+  has_packets_ = false;
+  init_key_ = 0;
+  packet_batch_.clear();
+  // Data taken before the flush is not parsed.
+  reading_chunk_ = std::vector<uint8_t>();
+  reading_offset_ = 0;
+
+  std::unique_lock<std::mutex> lock(buffer_mutex_);
+  reading_bytes_ = 0;
+  UpdateMemoryUsage();
+  flush_requested_ = false;
+  parser_generation_ = generation_;
+}
+
+void FFMpegDemuxer::ParseStream() {
   AVPacket pkt;
   bool finished_parsing = false;
 
   while (!finished_parsing) {
+    // av_read_frame() doesn't call Read() while the AVIO buffer has data, so
+    // cancellation is checked between packets as well.
+    if (IsInterrupted()) break;
     av_init_packet(&pkt);
     pkt.data = NULL;
     pkt.size = 0;
     Message packet_msg = kError;
     unique_ptr<ElementaryStreamPacket> es_pkt;
+    TRACE_SCOPE(stream_type_ == kVideo ? "demux video packet"
+                                       : "demux audio packet");
+    // Waiting for data in Read() doesn't use CPU, so it's not counted.
+    double cpu_start = GetThreadCpuTime();
     int32_t ret = av_read_frame(format_context_, &pkt);
     if (ret < 0) {
       if (ret == AVERROR_EOF) {
         packet_msg = kEndOfStream;
         finished_parsing = true;
-      } else if (ret != AVERROR_EXIT) {  // Unhandled error.
+        std::unique_lock<std::mutex> lock(buffer_mutex_);
+        if (flush_requested_) packet_msg = kError;
+      } else if (ret != AVERROR_EXIT && !IsInterrupted()) {  // Unhandled error.
         char errbuff[kErrorBufferSize];
         int32_t strerror_ret = av_strerror(ret, errbuff, kErrorBufferSize);
         LOG_ERROR("%s av_read_frame error: %d [%s], av_strerror ret: %d",
@@ -282,13 +585,14 @@ void FFMpegDemuxer::ParsingThreadFn() {
 
         {
           std::unique_lock<std::mutex> lock(buffer_mutex_);
-          if (exited_) finished_parsing = true;
+          if (exited_ || flush_requested_) finished_parsing = true;
         }
       } else {
         finished_parsing = true;
       }
     } else {
-      LOG_DEBUG("parser: %p, got packet with size: %d", this, pkt.size);
+      LOG_EVERY_N(Debug, 100, "parser: %p, got packet with size: %d", this,
+                  pkt.size);
       if (pkt.stream_index == audio_stream_idx_) {
         packet_msg = kAudioPkt;
       } else if (pkt.stream_index == video_stream_idx_) {
@@ -300,23 +604,29 @@ void FFMpegDemuxer::ParsingThreadFn() {
       }
       es_pkt = MakeESPacketFromAVPacket(&pkt);
     }
+    AddCpuTime(GetThreadCpuTime() - cpu_start);
 
-    if (packet_msg != kError) {
+    if (packet_msg == kAudioPkt || packet_msg == kVideoPkt) {
+      AddToPacketBatch(packet_msg, std::move(es_pkt));
+    } else if (packet_msg != kError) {
+      PostPacketBatch();
       auto es_pkt_callback = std::make_shared<EsPktCallbackData>(packet_msg,
           std::move(es_pkt));
       callback_dispatcher_.PostWork(callback_factory_.NewCallback(
-          &FFMpegDemuxer::EsPktCallbackInDispatcherThread, es_pkt_callback));
+          &FFMpegDemuxer::EsPktCallbackInDispatcherThread, es_pkt_callback,
+          parser_generation_));
     }
 
     av_packet_unref(&pkt);
   }
-
-  LOG_DEBUG("Finished parsing data. buffer left: %d, parser: %p",
-            buffer_.size(), this);
 }
 
 void FFMpegDemuxer::EsPktCallbackInDispatcherThread(int32_t,
-    const std::shared_ptr<EsPktCallbackData>& data) {
+    const std::shared_ptr<EsPktCallbackData>& data, uint32_t generation) {
+  if (generation != generation_) {
+    LOG_DEBUG("Dropping packet demuxed before flush, parser: %p", this);
+    return;
+  }
   if (es_pkt_callback_) {
     es_pkt_callback_(
         std::get<kEsPktCallbackDataMessage>(*data),
@@ -326,6 +636,45 @@ void FFMpegDemuxer::EsPktCallbackInDispatcherThread(int32_t,
   }
 }
 
+void FFMpegDemuxer::AddToPacketBatch(
+    Message msg, unique_ptr<ElementaryStreamPacket> packet) {
+  if (!packet_batch_.empty() && msg != packet_batch_msg_) PostPacketBatch();
+  if (packet_batch_.empty())
+    packet_batch_start_ = std::chrono::steady_clock::now();
+  packet_batch_msg_ = msg;
+  packet_batch_.push_back(std::move(packet));
+  if (packet_batch_.size() >= kMaxPacketBatchSize ||
+      std::chrono::steady_clock::now() - packet_batch_start_ >=
+          kMaxPacketBatchDelay)
+    PostPacketBatch();
+}
+
+void FFMpegDemuxer::PostPacketBatch() {
+  if (packet_batch_.empty()) return;
+  auto batch = std::make_shared<PacketBatch>(std::move(packet_batch_));
+  packet_batch_.clear();
+  callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+      &FFMpegDemuxer::EsPktBatchInDispatcherThread, batch, packet_batch_msg_,
+      parser_generation_));
+}
+
+void FFMpegDemuxer::EsPktBatchInDispatcherThread(int32_t,
+    const std::shared_ptr<PacketBatch>& batch, Message msg,
+    uint32_t generation) {
+  if (generation != generation_) {
+    LOG_DEBUG("Dropping %zu packets demuxed before flush, parser: %p",
+              batch->size(), this);
+    return;
+  }
+  if (es_pkts_callback_) {
+    es_pkts_callback_(msg, std::move(*batch));
+  } else if (es_pkt_callback_) {
+    for (auto& packet : *batch) es_pkt_callback_(msg, std::move(packet));
+  } else {
+    LOG_ERROR("ERROR: es_pkt_callback_ is not initialized");
+  }
+}
+
 void FFMpegDemuxer::CallbackInDispatcherThread(int32_t, Message msg) {
   (void)msg;  // suppress warning
   LOG_DEBUG("msg: %d", static_cast<int32_t>(msg));
@@ -337,8 +686,10 @@ void FFMpegDemuxer::DispatchCallback(Message msg) {
       &FFMpegDemuxer::CallbackInDispatcherThread, msg));
 }
 
-void FFMpegDemuxer::CallbackConfigInDispatcherThread(int32_t, Type type) {
+void FFMpegDemuxer::CallbackConfigInDispatcherThread(int32_t, Type type,
+                                                     uint32_t generation) {
   LOG_DEBUG("type: %d", static_cast<int32_t>(type));
+  if (generation != generation_) return;
   switch (type) {
     case kAudio:
       if (audio_config_callback_) audio_config_callback_(audio_config_);
@@ -355,26 +706,51 @@ void FFMpegDemuxer::CallbackConfigInDispatcherThread(int32_t, Type type) {
 }
 
 int FFMpegDemuxer::Read(uint8_t* data, int size) {
+  // While the parser keeps up, AVIO reads a chunk in many calls, only the
+  // first one of them takes the lock.
+  if (reading_offset_ < reading_chunk_.size()) {
+    if (IsInterrupted()) return AVERROR_EXIT;
+    return ReadFromChunk(data, size);
+  }
+
   std::unique_lock<std::mutex> lock(buffer_mutex_);
+  chunk_read_ = true;
   // Order in which conditions are processed below is important.
   // 1. Make sure buffer_ is empty before we can terminate this demuxer.
   //    Otherwise packet supply might be non-contiguous when changing
-  //    representations.
-  //    TODO(p.balut): However it might be a good idea to distinguish
-  //      destroying demuxer upon seek, because seek destruction wouldn't
-  //      need to wait for parsing to complete.
+  //    representations. An aborted demuxer, e.g. one destroyed upon seek,
+  //    doesn't need to wait for parsing to complete, see
+  //    FFMpegDemuxer::Abort.
   // 2. EOF causes signalling End Of Stream. This must be done only after
   //    buffer_ is processed.
   // 3. See (1).
-  buffer_condition_.wait(lock, [this]() {
-    return end_of_file_ || !buffer_.empty() || exited_;
-  });
+  // 4. Flush request drops whatever is being parsed, see FFMpegDemuxer::Flush.
+  // Packets of the data parsed so far are posted before waiting for more.
+  if (buffer_.empty()) PostPacketBatch();
+  {
+    TRACE_SCOPE("wait for data");
+    buffer_condition_.wait(lock, [this]() {
+      return end_of_file_ || !buffer_.empty() || exited_ || flush_requested_;
+    });
+  }
+
+  if (flush_requested_ || aborted_)
+    return AVERROR_EXIT;
 
   if (!buffer_.empty()) {
-    size_t read_bytes = std::min(size, static_cast<int>(buffer_.size()));
-    memcpy(data, buffer_.data(), read_bytes);
-    buffer_.erase(buffer_.begin(), buffer_.begin() + read_bytes);
-    return read_bytes;
+    reading_chunk_ = std::move(buffer_.front());
+    reading_offset_ = 0;
+    buffer_.pop_front();
+    buffered_bytes_ -= reading_chunk_.size();
+    reading_bytes_ = reading_chunk_.size();
+    chunk_read_ = false;
+    UpdateMemoryUsage();
+    Tracer::Counter(stream_type_ == kVideo ? "video demuxer buffer"
+                                           : "audio demuxer buffer",
+                    buffered_bytes_);
+    lock.unlock();
+    if (!context_opened_ && init_key_ == 0) UpdateInitKey();
+    return ReadFromChunk(data, size);
   }
 
   if (end_of_file_)
@@ -386,6 +762,19 @@ int FFMpegDemuxer::Read(uint8_t* data, int size) {
   return AVERROR(EIO);
 }
 
+int FFMpegDemuxer::ReadFromChunk(uint8_t* data, int size) {
+  size_t read_bytes = std::min(static_cast<size_t>(size),
+                               reading_chunk_.size() - reading_offset_);
+  memcpy(data, reading_chunk_.data() + reading_offset_, read_bytes);
+  reading_offset_ += read_bytes;
+  return read_bytes;
+}
+
+void FFMpegDemuxer::UpdateMemoryUsage() {
+  memory_usage_.Set(buffered_bytes_ + reading_bytes_ +
+                    (io_context_ ? io_buffer_size_ : 0));
+}
+
 void FFMpegDemuxer::InitFFmpeg() {
   static bool is_initialized = false;
   if (!is_initialized) {
@@ -417,7 +806,17 @@ bool FFMpegDemuxer::InitStreamInfo() {
     streams_initialized_ = false;
   }
 
-  if (!streams_initialized_ && init_mode_ != kSkipInitCodecData) {
+  bool probe = init_mode_ == kFullInitialization ||
+      (init_mode_ == kFastInitialization && !HasCodecParameters());
+  bool probed = false;
+  ProbedStreamsCache::Entry cached;
+  bool from_cache = !streams_initialized_ && probe &&
+      init_mode_ != kSkipInitCodecData &&
+      FindProbedStreams(format_context_, init_key_, &cached);
+  if (from_cache) {
+    LOG_INFO("Init segment %016llx probed before, skipping probing",
+             static_cast<unsigned long long>(init_key_));
+  } else if (!streams_initialized_ && probe) {
     LOG_DEBUG("parsing stream info ctx = %p", format_context_);
     ret = avformat_find_stream_info(format_context_, NULL);
     LOG_DEBUG("find stream info ret %d", ret);
@@ -425,19 +824,44 @@ bool FFMpegDemuxer::InitStreamInfo() {
       LOG_ERROR("ERROR - find stream info error, ret: %d", ret);
     }
     av_dump_format(format_context_, 0, NULL, 0);
+    probed = ret >= 0;
   }
+  // PSSH boxes are read when the context is opened, they don't need probing.
   UpdateContentProtectionConfig();
 
   audio_stream_idx_ =
       av_find_best_stream(format_context_, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
   if (audio_stream_idx_ >= 0 && init_mode_ != kSkipInitCodecData) {
-    UpdateAudioConfig();
+    if (from_cache) {
+      audio_config_ = cached.audio_config;
+      audio_config_.demux_id = demux_id_;
+      callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+          &FFMpegDemuxer::CallbackConfigInDispatcherThread, kAudio,
+          parser_generation_));
+    } else {
+      UpdateAudioConfig();
+    }
   }
 
   video_stream_idx_ =
       av_find_best_stream(format_context_, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
   if (video_stream_idx_ >= 0 && init_mode_ != kSkipInitCodecData) {
-    UpdateVideoConfig();
+    if (from_cache) {
+      video_config_ = cached.video_config;
+      video_config_.demux_id = demux_id_;
+      callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+          &FFMpegDemuxer::CallbackConfigInDispatcherThread, kVideo,
+          parser_generation_));
+    } else {
+      UpdateVideoConfig();
+    }
+  }
+
+  if (probed && init_key_ != 0 && init_mode_ != kSkipInitCodecData &&
+      (audio_stream_idx_ >= 0 || video_stream_idx_ >= 0)) {
+    ProbedStreamsCache::Get().Add({init_key_, format_context_->nb_streams,
+                                   audio_stream_idx_, video_stream_idx_,
+                                   audio_config_, video_config_});
   }
 
   LOG_DEBUG("Configs updated");
@@ -452,6 +876,31 @@ bool FFMpegDemuxer::InitStreamInfo() {
   return streams_initialized_;
 }
 
+void FFMpegDemuxer::UpdateInitKey() {
+  // Configurations depend also on the stream type and @codecs, which
+  // complete unprobed ones.
+  uint64_t key = HashBytes(reading_chunk_.data(),
+                           std::min(reading_chunk_.size(), kMaxInitKeyBytes));
+  key = HashBytes(codecs_.data(), codecs_.size(), key);
+  uint8_t type = static_cast<uint8_t>(stream_type_);
+  init_key_ = HashBytes(&type, 1, key);
+}
+
+bool FFMpegDemuxer::HasCodecParameters() const {
+  for (uint32_t i = 0; i < format_context_->nb_streams; ++i) {
+    const AVCodecParameters* par = format_context_->streams[i]->codecpar;
+    if (par->codec_id == AV_CODEC_ID_NONE) return false;
+    if (par->codec_type == AVMEDIA_TYPE_AUDIO &&
+        (par->sample_rate <= 0 || par->channels <= 0))
+      return false;
+    if (par->codec_type == AVMEDIA_TYPE_VIDEO &&
+        (par->width <= 0 || par->height <= 0))
+      return false;
+  }
+  LOG_DEBUG("Init segment has all codec parameters, skipping probing");
+  return format_context_->nb_streams > 0;
+}
+
 void FFMpegDemuxer::UpdateAudioConfig() {
   LOG_DEBUG("audio index: %d", audio_stream_idx_);
 
@@ -463,6 +912,15 @@ void FFMpegDemuxer::UpdateAudioConfig() {
   AVSampleFormat sample_format =
       static_cast<AVSampleFormat>(s->codecpar->format);
   audio_config_.codec_type = ConvertAudioCodec(s->codecpar->codec_id);
+  // Sample format and profile are known only after probing with a decoder.
+  int profile = s->codecpar->profile;
+  if (audio_config_.codec_type == Samsung::NaClPlayer::AUDIOCODEC_TYPE_AAC) {
+    if (sample_format == AV_SAMPLE_FMT_NONE)
+      sample_format = AV_SAMPLE_FMT_FLTP;  // output format of AAC decoder
+    if (profile == FF_PROFILE_UNKNOWN)
+      profile = AACProfileFromExtraData(s->codecpar->extradata,
+                                        s->codecpar->extradata_size);
+  }
   audio_config_.sample_format = ConvertSampleFormat(sample_format);
   if (s->codecpar->bits_per_coded_sample > 0) {
     audio_config_.bits_per_channel = s->codecpar->bits_per_coded_sample;
@@ -474,8 +932,7 @@ void FFMpegDemuxer::UpdateAudioConfig() {
       ConvertChannelLayout(s->codecpar->channel_layout, s->codecpar->channels);
   audio_config_.samples_per_second = s->codecpar->sample_rate;
   if (audio_config_.codec_type == Samsung::NaClPlayer::AUDIOCODEC_TYPE_AAC) {
-    audio_config_.codec_profile =
-        ConvertAACAudioCodecProfile(s->codecpar->profile);
+    audio_config_.codec_profile = ConvertAACAudioCodecProfile(profile);
     // this method read channel_no, and modify
     // audio_config_.samples_per_second too
     channel_no =
@@ -487,8 +944,12 @@ void FFMpegDemuxer::UpdateAudioConfig() {
           ConvertChannelLayout(s->codecpar->channel_layout, channel_no);
   }
 
+  // Unprobed streams without decoder specific info get the profile from the
+  // manifest.
+  ApplyCodecString(codecs_, &audio_config_);
+
   if (s->codecpar->extradata_size > 0) {
-    audio_config_.extra_data.assign(
+    audio_config_.extra_data = CodecExtraData(
         s->codecpar->extradata,
         s->codecpar->extradata + s->codecpar->extradata_size);
   }
@@ -503,7 +964,8 @@ void FFMpegDemuxer::UpdateAudioConfig() {
       audio_config_.channel_layout, audio_config_.samples_per_second);
 
   callback_dispatcher_.PostWork(callback_factory_.NewCallback(
-      &FFMpegDemuxer::CallbackConfigInDispatcherThread, kAudio));
+      &FFMpegDemuxer::CallbackConfigInDispatcherThread, kAudio,
+      parser_generation_));
   LOG_DEBUG("audio configuration updated");
 }
 
@@ -515,6 +977,11 @@ void FFMpegDemuxer::UpdateVideoConfig() {
             s->duration == AV_NOPTS_VALUE ? "(AV_NOPTS_VALUE)" : "");
 
   video_config_.codec_type = ConvertVideoCodec(s->codecpar->codec_id);
+  video_config_.profile_idc =
+      s->codecpar->profile != FF_PROFILE_UNKNOWN ? s->codecpar->profile : 0;
+  video_config_.level_idc =
+      s->codecpar->level != FF_LEVEL_UNKNOWN ? s->codecpar->level : 0;
+  video_config_.bit_depth = std::max(s->codecpar->bits_per_raw_sample, 0);
   switch (video_config_.codec_type) {
     case Samsung::NaClPlayer::VIDEOCODEC_TYPE_VP8:
       video_config_.codec_profile =
@@ -525,19 +992,39 @@ void FFMpegDemuxer::UpdateVideoConfig() {
           Samsung::NaClPlayer::VIDEOCODEC_PROFILE_VP9_MAIN;
       break;
     case Samsung::NaClPlayer::VIDEOCODEC_TYPE_H264:
-      video_config_.codec_profile =
-          ConvertH264VideoCodecProfile(s->codecpar->profile);
+      // Profile is known only after probing with a decoder.
+      video_config_.codec_profile = ConvertH264VideoCodecProfile(
+          s->codecpar->profile != FF_PROFILE_UNKNOWN ? s->codecpar->profile
+              : H264ProfileFromExtraData(s->codecpar->extradata,
+                                         s->codecpar->extradata_size));
       break;
     case Samsung::NaClPlayer::VIDEOCODEC_TYPE_MPEG2:
       video_config_.codec_profile =
           ConvertMPEG2VideoCodecProfile(s->codecpar->profile);
       break;
+#if (PPAPI_RELEASE >= 47)
+    case Samsung::NaClPlayer::VIDEOCODEC_TYPE_H265:
+      // NaCl Player has no HEVC profiles, the decoder is configured from
+      // the profile, the level and the bit depth of the configuration.
+      video_config_.codec_profile =
+          Samsung::NaClPlayer::VIDEOCODEC_PROFILE_UNKNOWN;
+      if (s->codecpar->profile == FF_PROFILE_UNKNOWN) {
+        HevcConfigFromExtraData(s->codecpar->extradata,
+                                s->codecpar->extradata_size, &video_config_);
+      }
+      break;
+#endif
     default:
       video_config_.codec_profile =
           Samsung::NaClPlayer::VIDEOCODEC_PROFILE_UNKNOWN;
   }
 
-  video_config_.frame_format = ConvertVideoFrameFormat(s->codecpar->format);
+  int pixel_format = s->codecpar->format;
+  if (pixel_format == AV_PIX_FMT_NONE) {
+    // Not probed by a decoder; all supported codecs are 4:2:0 in practice.
+    pixel_format = AV_PIX_FMT_YUV420P;
+  }
+  video_config_.frame_format = ConvertVideoFrameFormat(pixel_format);
 
   AVDictionaryEntry* webm_alpha =
       av_dict_get(s->metadata, "alpha_mode", NULL, 0);
@@ -547,11 +1034,23 @@ void FFMpegDemuxer::UpdateVideoConfig() {
   video_config_.size = Size(s->codecpar->width,
                             s->codecpar->height);
 
+  video_config_.color.primaries = s->codecpar->color_primaries;
+  video_config_.color.transfer = s->codecpar->color_trc;
+  video_config_.color.matrix = s->codecpar->color_space;
+  video_config_.color.full_range =
+      s->codecpar->color_range == AVCOL_RANGE_JPEG;
+  // Dolby Vision configuration is read by Mp4Demuxer only.
+  video_config_.dolby_vision = DolbyVisionConfig();
+  ApplyCodecString(codecs_, &video_config_);
+
   LOG_DEBUG("r_frame_rate %d. %d#", s->r_frame_rate.num, s->r_frame_rate.den);
-  video_config_.frame_rate = Rational(s->r_frame_rate.num, s->r_frame_rate.den);
+  AVRational frame_rate = s->r_frame_rate;
+  if (frame_rate.num <= 0 || frame_rate.den <= 0)
+    frame_rate = s->avg_frame_rate;  // r_frame_rate is guessed when probing
+  video_config_.frame_rate = Rational(frame_rate.num, frame_rate.den);
 
   if (s->codecpar->extradata_size > 0) {
-    video_config_.extra_data.assign(
+    video_config_.extra_data = CodecExtraData(
         s->codecpar->extradata,
         s->codecpar->extradata + s->codecpar->extradata_size);
   }
@@ -566,7 +1065,8 @@ void FFMpegDemuxer::UpdateVideoConfig() {
       video_config_.size.height);
 
   callback_dispatcher_.PostWork(callback_factory_.NewCallback(
-      &FFMpegDemuxer::CallbackConfigInDispatcherThread, kVideo));
+      &FFMpegDemuxer::CallbackConfigInDispatcherThread, kVideo,
+      parser_generation_));
   LOG_DEBUG("video configuration updated");
 }
 
@@ -613,7 +1113,7 @@ void FFMpegDemuxer::UpdateContentProtectionConfig() {
 
       callback_dispatcher_.PostWork(callback_factory_.NewCallback(
           &FFMpegDemuxer::DrmInitCallbackInDispatcherThread, kDRMInitDataType,
-          init_data));
+          init_data, parser_generation_));
       return;
     }
   }
@@ -623,7 +1123,9 @@ void FFMpegDemuxer::UpdateContentProtectionConfig() {
 }
 
 void FFMpegDemuxer::DrmInitCallbackInDispatcherThread(int32_t,
-    const std::string& type, const std::vector<uint8_t>& init_data) {
+    const std::string& type, const std::vector<uint8_t>& init_data,
+    uint32_t generation) {
+  if (generation != generation_) return;
   if (drm_init_data_callback_)
     drm_init_data_callback_(type, init_data);
   else
@@ -637,19 +1139,18 @@ unique_ptr<ElementaryStreamPacket> FFMpegDemuxer::MakeESPacketFromAVPacket(
 
   AVStream* s = format_context_->streams[pkt->stream_index];
 
-  es_packet->SetDuration(ToTimeTicks(pkt->duration, s->time_base));
   es_packet->SetKeyFrame(pkt->flags == 1);
 
-  auto pts = ToTimeTicks(pkt->pts, s->time_base);
-  auto dts = ToTimeTicks(pkt->dts, s->time_base);
+  MediaTime pts = ToMediaTime(pkt->pts, s->time_base);
+  MediaTime dts = ToMediaTime(pkt->dts, s->time_base);
   if (!has_packets_ && pts + kSegmentEps >= timestamp_) {
       LOG_DEBUG("Got properly timestamped packet. Zero timestamp variable");
       timestamp_ = 0;
   }
   has_packets_ = true;
 
-  es_packet->SetPts(pts + timestamp_);
-  es_packet->SetDts(dts + timestamp_);
+  es_packet->SetMediaTimestamps(pts + timestamp_, dts + timestamp_,
+                                ToMediaTime(pkt->duration, s->time_base));
 
   AVEncInfo* enc_info = reinterpret_cast<AVEncInfo*>(
       av_packet_get_side_data(pkt, AV_PKT_DATA_ENCRYPT_INFO, NULL));
@@ -21,13 +21,14 @@
 #ifndef SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_FFMPEG_DEMUXER_H_
 #define SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_FFMPEG_DEMUXER_H_
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <list>
 #include <memory>
 #include <mutex>
 #include <string>
-#include <thread>
 #include <tuple>
 #include <vector>
 
@@ -40,6 +41,8 @@ extern "C" {
 }
 
 #include "demuxer/stream_demuxer.h"
+#include "memory_governor.h"
+#include "demuxer_thread_pool.h"
 
 class FFMpegDemuxer : public StreamDemuxer {
  public:
@@ -48,22 +51,40 @@ class FFMpegDemuxer : public StreamDemuxer {
   typedef std::function<void(const std::string&,
       const std::vector<uint8_t>& init_data)> DrmInitCallback;
 
-  explicit FFMpegDemuxer(const pp::InstanceHandle& instance,
-                         uint32_t probe_size, Type type, InitMode init_mode);
+  // Creates a demuxer with a probe size and an AVIO buffer size suitable for
+  // given stream type, its bitrate and segment duration.
+  static std::unique_ptr<StreamDemuxer> Create(
+      const pp::InstanceHandle& instance, Type type, InitMode init_mode,
+      const DemuxerOptions& options = DemuxerOptions());
+
+  FFMpegDemuxer(const pp::InstanceHandle& instance, uint32_t probe_size,
+                int64_t analyze_duration, size_t io_buffer_size, Type type,
+                InitMode init_mode);
   ~FFMpegDemuxer();
 
   bool Init(const InitCallback& callback,
             pp::MessageLoop callback_dispatcher) override;
   void Flush() override;
   void Parse(const std::vector<uint8_t>& data) override;
+  void Parse(std::vector<uint8_t>&& data) override;
   bool SetAudioConfigListener(
       const std::function<void(const AudioConfig&)>& callback) override;
   bool SetVideoConfigListener(
       const std::function<void(const VideoConfig&)>& callback) override;
   bool SetDRMInitDataListener(const DrmInitCallback& callback) override;
+  bool SetEsPacketsListener(
+      const std::function<void(Message, PacketBatch)>& callback) override;
   void SetTimestamp(Samsung::NaClPlayer::TimeTicks) override;
+  void SetCodecs(const std::string& codecs) override;
+  size_t QueuedBytes() const override;
+  void Abort() override;
   void Close() override;
   int Read(uint8_t* data, int size);
+  // Checked on the parser thread, also by FFmpeg through the interrupt
+  // callback. Parsing stops once the demuxer is aborted or flushed.
+  bool IsInterrupted() const {
+    return aborted_ || parser_generation_ != generation_;
+  }
 
  private:
   typedef std::tuple<
@@ -74,14 +95,38 @@ class FFMpegDemuxer : public StreamDemuxer {
 
   // main parser thread function
   void ParsingThreadFn();
+  // Demuxes packets until the end of stream, an exit or a flush request.
+  void ParseStream();
+  // Returns true when a flush has been requested, false on exit.
+  bool WaitForFlush();
+  // Drops parsing state, so the next data is parsed from the beginning.
+  void ResetContext();
 
   void CallbackInDispatcherThread(int32_t, StreamDemuxer::Message msg);
   void DispatchCallback(StreamDemuxer::Message);
   void EsPktCallbackInDispatcherThread(int32_t,
-      const std::shared_ptr<EsPktCallbackData>& data);
+      const std::shared_ptr<EsPktCallbackData>& data, uint32_t generation);
+  void EsPktBatchInDispatcherThread(int32_t,
+      const std::shared_ptr<PacketBatch>& batch, StreamDemuxer::Message msg,
+      uint32_t generation);
+  // Packets are posted to the dispatcher in batches, to avoid flooding its
+  // message loop with a task per packet.
+  void AddToPacketBatch(StreamDemuxer::Message msg,
+                        std::unique_ptr<ElementaryStreamPacket> packet);
+  void PostPacketBatch();
+  // Registers buffer_, reading_chunk_ and the AVIO buffer, buffer_mutex_
+  // must be locked.
+  void UpdateMemoryUsage();
+  // Copies unread data of reading_chunk_, up to size bytes.
+  int ReadFromChunk(uint8_t* data, int size);
   void DrmInitCallbackInDispatcherThread(int32_t, const std::string& type,
-      const std::vector<uint8_t>& init_data);
+      const std::vector<uint8_t>& init_data, uint32_t generation);
+  bool InitFormatContext();
   bool InitStreamInfo();
+  bool HasCodecParameters() const;
+  // Keys stream info probed from the first chunk of data, i.e. the init
+  // segment, used on parser thread only.
+  void UpdateInitKey();
   static void InitFFmpeg();
 
   std::unique_ptr<ElementaryStreamPacket> MakeESPacketFromAVPacket(
@@ -91,7 +136,8 @@ class FFMpegDemuxer : public StreamDemuxer {
   void UpdateVideoConfig();
   void UpdateAudioConfig();
   void UpdateContentProtectionConfig();
-  void CallbackConfigInDispatcherThread(int32_t, Type type);
+  void CallbackConfigInDispatcherThread(int32_t, Type type,
+                                        uint32_t generation);
   std::function<void(const VideoConfig&)> video_config_callback_;
   std::function<void(const AudioConfig&)> audio_config_callback_;
   std::function<void(const std::string& type,
@@ -100,11 +146,13 @@ class FFMpegDemuxer : public StreamDemuxer {
   std::function<void(StreamDemuxer::Message,
                      std::unique_ptr<ElementaryStreamPacket>)>
       es_pkt_callback_;
+  std::function<void(StreamDemuxer::Message, PacketBatch)> es_pkts_callback_;
 
   Type stream_type_;
   int audio_stream_idx_;
   int video_stream_idx_;
-  std::unique_ptr<std::thread> parser_thread_;
+  // Runs ParsingThreadFn() on a thread of DemuxerThreadPool.
+  std::shared_ptr<DemuxerThreadPool::Job> parser_job_;
   pp::CompletionCallbackFactory<FFMpegDemuxer> callback_factory_;
 
   VideoConfig video_config_;
@@ -112,20 +160,54 @@ class FFMpegDemuxer : public StreamDemuxer {
   AVFormatContext* format_context_;
   AVIOContext* io_context_;
 
-  std::mutex buffer_mutex_;
+  mutable std::mutex buffer_mutex_;
   std::condition_variable buffer_condition_;
   pp::MessageLoop callback_dispatcher_;
-  std::vector<uint8_t> buffer_;
-  // in case of performance issues, buffer_ may be changed to a list of
-  // buffers to reduce amount of data copying
+  // Buffers passed to Parse() are queued as separate chunks, so Read() can
+  // take a whole one under the lock and hand it to AVIO without moving
+  // remaining data to the front.
+  std::list<std::vector<uint8_t>> buffer_;
+  // Number of bytes in all chunks of buffer_.
+  size_t buffered_bytes_;
+  // A chunk taken from buffer_ and its first unread byte. Read() serves it
+  // without the lock, it's used on parser thread only.
+  std::vector<uint8_t> reading_chunk_;
+  size_t reading_offset_;
+  // Size of reading_chunk_, counted as memory of the demuxer.
+  size_t reading_bytes_;
+  // Set once reading_chunk_ is fully read, guarded by buffer_mutex_.
+  bool chunk_read_;
+  MemoryUsage memory_usage_;
   bool context_opened_;
   bool streams_initialized_;
   bool end_of_file_;
   bool exited_;
+  // Set by Abort(), checked by FFmpeg through the interrupt callback.
+  std::atomic<bool> aborted_;
+  // Set by Flush(), cleared by the parser thread once parsing state is reset.
+  bool flush_requested_;
+  // Incremented on each flush. Results posted by the parser thread carry its
+  // generation, so the ones demuxed before a flush can be dropped.
+  std::atomic<uint32_t> generation_;
+  // Generation of data which is currently parsed, used on parser thread only.
+  uint32_t parser_generation_;
+  // Packets not posted yet, used on parser thread only.
+  PacketBatch packet_batch_;
+  StreamDemuxer::Message packet_batch_msg_;
+  std::chrono::steady_clock::time_point packet_batch_start_;
   uint32_t probe_size_;
-  Samsung::NaClPlayer::TimeTicks timestamp_;
+  // How far into the stream parameters are probed, in microseconds.
+  int64_t analyze_duration_;
+  // Size of the AVIO buffer, i.e. the most data a single Read() can return.
+  size_t io_buffer_size_;
+  // In units of kMediaTimescale, like packet timestamps.
+  MediaTime timestamp_;
   bool has_packets_;
   InitMode init_mode_;
+  // Hash of the init segment and codecs_, 0 until data is read.
+  uint64_t init_key_;
+  // @codecs from the manifest, completing configs of unprobed streams.
+  std::string codecs_;
 
   int demux_id_;
 };
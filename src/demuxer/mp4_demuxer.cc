@@ -0,0 +1,1336 @@
+/*!
+ * mp4_demuxer.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDemuxer
+
+#include "demuxer/mp4_demuxer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "ppapi/c/pp_macros.h"
+
+#include "common.h"
+#include "convert_codecs.h"
+#include "cpu_profiler.h"
+#include "demuxer/box_reader.h"
+#include "demuxer/elementary_stream_packet.h"
+#include "ffmpeg_demuxer.h"
+#include "webm_demuxer.h"
+
+using pp::MessageLoop;
+using std::shared_ptr;
+using std::unique_ptr;
+using std::vector;
+using Samsung::NaClPlayer::EncryptedSubsampleDescription;
+using Samsung::NaClPlayer::Rational;
+using Samsung::NaClPlayer::Size;
+using Samsung::NaClPlayer::TimeTicks;
+
+namespace {
+
+const uint8_t kPlayReadySystemId[] = {
+    // "9a04f079-9840-4286-ab92-e65be0885f95";
+    0x9a, 0x04, 0xf0, 0x79, 0x98, 0x40, 0x42, 0x86,
+    0xab, 0x92, 0xe6, 0x5b, 0xe0, 0x88, 0x5f, 0x95,
+};
+
+// CPU time used by all demuxers, in microseconds.
+std::atomic<uint64_t> demuxers_cpu_time(0);
+// The last id given by StreamDemuxer::NextDemuxId().
+std::atomic<int> last_demux_id(0);
+
+// PIFF Sample Encryption Box, used by Smooth Streaming style PlayReady
+// content instead of senc.
+const uint8_t kPiffSampleEncryptionUuid[] = {
+    // "a2394f52-5a9b-4f14-a244-6c427c648df4"
+    0xa2, 0x39, 0x4f, 0x52, 0x5a, 0x9b, 0x4f, 0x14,
+    0xa2, 0x44, 0x6c, 0x42, 0x7c, 0x64, 0x8d, 0xf4,
+};
+
+const char kDRMInitDataType[] = "cenc:pssh";
+
+const uint32_t kKidLength = 16;
+const uint32_t kMaxIvLength = 16;
+const uint32_t kSystemIdLength = 16;
+
+// tfhd flags
+const uint32_t kBaseDataOffsetPresent = 0x000001;
+const uint32_t kSampleDescriptionIndexPresent = 0x000002;
+const uint32_t kDefaultSampleDurationPresent = 0x000008;
+const uint32_t kDefaultSampleSizePresent = 0x000010;
+const uint32_t kDefaultSampleFlagsPresent = 0x000020;
+
+// trun flags
+const uint32_t kDataOffsetPresent = 0x000001;
+const uint32_t kFirstSampleFlagsPresent = 0x000004;
+const uint32_t kSampleDurationPresent = 0x000100;
+const uint32_t kSampleSizePresent = 0x000200;
+const uint32_t kSampleFlagsPresent = 0x000400;
+const uint32_t kSampleCompositionTimeOffsetPresent = 0x000800;
+
+// sample flags
+const uint32_t kSampleIsNonSyncSample = 0x00010000;
+const uint32_t kSampleDependsOnMask = 0x03000000;
+const uint32_t kSampleDependsOnOthers = 0x01000000;
+
+// senc flags
+const uint32_t kOverrideTrackEncryptionBoxParameters = 0x000001;
+const uint32_t kUseSubsampleEncryption = 0x000002;
+
+// saiz/saio flags
+const uint32_t kAuxInfoTypePresent = 0x000001;
+
+// MPEG-4 object type indications (ISO/IEC 14496-1)
+const uint8_t kObjectTypeAac = 0x40;
+const uint8_t kObjectTypeAacMain = 0x66;
+const uint8_t kObjectTypeAacLowComplexity = 0x67;
+const uint8_t kObjectTypeAacSsr = 0x68;
+const uint8_t kObjectTypeMp3 = 0x6b;
+const uint8_t kObjectTypeMpeg2Mp3 = 0x69;
+
+// MPEG-4 descriptor tags (ISO/IEC 14496-1)
+const uint8_t kEsDescriptorTag = 0x03;
+const uint8_t kDecoderConfigDescriptorTag = 0x04;
+const uint8_t kDecoderSpecificInfoTag = 0x05;
+
+const int32_t kDefaultBitsPerChannel = 16;
+
+const MediaTime kSegmentEps = kMediaTimescale / 2;
+
+Samsung::NaClPlayer::ChannelLayout ChannelLayoutFromAacConfig(
+    uint32_t channel_config, uint32_t channel_count) {
+  switch (channel_config) {
+    case 1:
+      return Samsung::NaClPlayer::CHANNEL_LAYOUT_MONO;
+    case 2:
+      return Samsung::NaClPlayer::CHANNEL_LAYOUT_STEREO;
+    case 3:
+      return Samsung::NaClPlayer::CHANNEL_LAYOUT_SURROUND;
+    case 4:
+      return Samsung::NaClPlayer::CHANNEL_LAYOUT_4_0;
+    case 5:
+      return Samsung::NaClPlayer::CHANNEL_LAYOUT_5_0;
+    case 6:
+      return Samsung::NaClPlayer::CHANNEL_LAYOUT_5_1;
+    case 7:
+      return Samsung::NaClPlayer::CHANNEL_LAYOUT_7_1;
+    default:
+      break;
+  }
+
+  return ChannelLayoutFromChannelCount(channel_count);
+}
+
+// Reads a profile, a level and a bit depth from an
+// HEVCDecoderConfigurationRecord (ISO/IEC 14496-15).
+void ParseHevcConfig(const uint8_t* data, size_t size, VideoConfig* config) {
+  constexpr size_t kMinHevcConfigSize = 23;
+  if (size < kMinHevcConfigSize) return;
+  config->profile_idc = data[1] & 0x1f;
+  config->level_idc = data[12];
+  config->bit_depth = (data[17] & 0x07) + 8;
+}
+
+// Reads a DOVIDecoderConfigurationRecord of a dvcC, dvvC or dvwC box.
+void ParseDolbyVisionConfig(const uint8_t* data, size_t size,
+                            DolbyVisionConfig* config) {
+  constexpr size_t kMinDolbyVisionConfigSize = 5;
+  if (size < kMinDolbyVisionConfigSize) return;
+  // dv_version_major, dv_version_minor, then 7 bits of dv_profile, 6 bits
+  // of dv_level and the rpu, el and bl flags.
+  uint16_t bits = (data[2] << 8) | data[3];
+  config->present = true;
+  config->profile = bits >> 9;
+  config->level = (bits >> 3) & 0x3f;
+  config->rpu_present = (bits & 0x04) != 0;
+  config->el_present = (bits & 0x02) != 0;
+  config->bl_present = (bits & 0x01) != 0;
+  config->bl_compatibility_id = data[4] >> 4;
+}
+
+// Reads fields of an AudioSpecificConfig (ISO/IEC 14496-3) which are not
+// byte aligned.
+class BitReader {
+ public:
+  BitReader(const uint8_t* data, size_t size)
+      : data_(data), size_(size), bit_pos_(0) {}
+
+  uint32_t Read(uint32_t bits) {
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < bits; ++i) {
+      size_t byte = bit_pos_ / 8;
+      uint32_t bit = 0;
+      if (byte < size_) bit = (data_[byte] >> (7 - bit_pos_ % 8)) & 1;
+      value = (value << 1) | bit;
+      ++bit_pos_;
+    }
+    return value;
+  }
+
+  bool ok() const { return bit_pos_ <= size_ * 8; }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t bit_pos_;
+};
+
+}  // anonymous namespace
+
+struct Mp4Demuxer::Track {
+  Track()
+      : track_id(0),
+        timescale(0),
+        media_time(0),
+        default_sample_duration(0),
+        default_sample_size(0),
+        default_sample_flags(0),
+        is_protected(false),
+        iv_size(0),
+        constant_iv_size(0) {
+    memset(kid, 0, sizeof(kid));
+    memset(constant_iv, 0, sizeof(constant_iv));
+  }
+
+  uint32_t track_id;
+  uint32_t timescale;
+  // Start of presentation in media time scale (from the edit list).
+  int64_t media_time;
+  uint32_t default_sample_duration;
+  uint32_t default_sample_size;
+  uint32_t default_sample_flags;
+
+  bool is_protected;
+  uint8_t iv_size;
+  uint8_t kid[kKidLength];
+  uint8_t constant_iv_size;
+  uint8_t constant_iv[kMaxIvLength];
+};
+
+struct Mp4Demuxer::Sample {
+  // Position of sample data in the stream.
+  uint64_t position;
+  uint32_t size;
+  uint32_t duration;
+  int64_t dts;
+  int32_t composition_offset;
+  bool key_frame;
+
+  bool encrypted;
+  uint8_t kid[kKidLength];
+  uint8_t iv_size;
+  uint8_t iv[kMaxIvLength];
+  // Range of sample's entries in Mp4Demuxer::subsamples_.
+  size_t first_subsample;
+  size_t subsample_count;
+};
+
+Mp4Demuxer::Mp4Demuxer(const pp::InstanceHandle& instance, Type type,
+                       InitMode init_mode, const DemuxerOptions& options)
+    : instance_(instance),
+      stream_type_(type),
+      init_mode_(init_mode),
+      options_(options),
+      callback_factory_(this),
+      stream_position_(0),
+      next_decode_time_(0),
+      configs_reported_(false),
+      config_changed_(false),
+      timestamp_(0),
+      timestamp_offset_(0),
+      has_packets_(false),
+      generation_(0),
+      demux_id_(NextDemuxId()) {
+  LOG_DEBUG("parser: %p", this);
+  audio_config_.demux_id = demux_id_;
+  video_config_.demux_id = demux_id_;
+}
+
+Mp4Demuxer::~Mp4Demuxer() {
+  LOG_DEBUG("parser: %p", this);
+}
+
+bool Mp4Demuxer::Init(const InitCallback& callback,
+                      MessageLoop callback_dispatcher) {
+  LOG_DEBUG("Start, parser: %p", this);
+  if (callback_dispatcher.is_null() || !callback) {
+    LOG_ERROR("ERROR: callback is null or callback_dispatcher is invalid!");
+    return false;
+  }
+
+  es_pkt_callback_ = callback;
+  callback_dispatcher_ = callback_dispatcher;
+  callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+      &Mp4Demuxer::MessageInDispatcherThread, kInitialized, generation_));
+  return true;
+}
+
+void Mp4Demuxer::Flush() {
+  LOG_DEBUG("parser: %p", this);
+  if (fallback_) {
+    fallback_->Flush();
+    return;
+  }
+
+  ++generation_;
+  samples_.clear();
+  subsamples_.clear();
+  pending_data_.clear();
+  probe_data_.clear();
+  stream_position_ = 0;
+  next_decode_time_ = 0;
+  has_packets_ = false;
+  callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+      &Mp4Demuxer::MessageInDispatcherThread, kFlushed, generation_));
+}
+
+void Mp4Demuxer::Parse(const vector<uint8_t>& data) {
+  Parse(vector<uint8_t>(data));
+}
+
+void Mp4Demuxer::Parse(vector<uint8_t>&& data) {
+  LOG_DEBUG("parser: %p, data size: %zu", this, data.size());
+  if (fallback_) {
+    fallback_->Parse(std::move(data));
+    return;
+  }
+
+  if (data.empty()) {
+    LOG_DEBUG("Signal EOF");
+    callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+        &Mp4Demuxer::MessageInDispatcherThread, kEndOfStream, generation_));
+    return;
+  }
+
+  // Until stream is recognized, keep its data for a fallback demuxer.
+  if (!track_) probe_data_.insert(probe_data_.end(), data.begin(), data.end());
+
+  shared_ptr<vector<uint8_t>> buffer;
+  if (pending_data_.empty()) {
+    buffer = std::make_shared<vector<uint8_t>>(std::move(data));
+  } else {
+    pending_data_.insert(pending_data_.end(), data.begin(), data.end());
+    buffer = std::make_shared<vector<uint8_t>>(std::move(pending_data_));
+    pending_data_.clear();
+  }
+
+  double cpu_start = GetThreadCpuTime();
+  bool parsed = ParseBuffer(buffer);
+  AddCpuTime(GetThreadCpuTime() - cpu_start);
+  if (!parsed) {
+    LOG_INFO("Not a fragmented MP4 stream, using a fallback demuxer");
+    StartFallback();
+  }
+}
+
+bool Mp4Demuxer::ParseBuffer(const shared_ptr<const vector<uint8_t>>& buffer) {
+  BoxReader reader(buffer->data(), buffer->size());
+  PacketBatch packets;
+  size_t parsed = 0;
+  uint32_t type;
+  BoxReader box;
+  size_t header_size;
+
+  // Only complete top level boxes are parsed, the rest waits for more data.
+  while (reader.NextBox(&type, &box, &header_size)) {
+    uint64_t box_position = stream_position_ + parsed;
+    switch (type) {
+      case FourCC("ftyp"):
+      case FourCC("styp"):
+      case FourCC("sidx"):
+      case FourCC("ssix"):
+      case FourCC("prft"):
+      case FourCC("emsg"):
+      case FourCC("free"):
+      case FourCC("skip"):
+      case FourCC("uuid"):
+        break;
+      case FourCC("moov"): {
+        bool had_track = track_ != nullptr;
+        AudioConfig previous_audio_config = audio_config_;
+        VideoConfig previous_video_config = video_config_;
+        if (!ParseMoov(&box)) return false;
+        if (stream_type_ == kAudio)
+          ApplyCodecString(codecs_, &audio_config_);
+        else
+          ApplyCodecString(codecs_, &video_config_);
+        probe_data_.clear();
+        probe_data_.shrink_to_fit();
+        // A new initialization segment in the middle of the stream, e.g. at
+        // a period boundary, can change the stream config.
+        if (had_track && (stream_type_ == kAudio
+                ? !(audio_config_ == previous_audio_config)
+                : !(video_config_ == previous_video_config))) {
+          LOG_INFO("Stream config changed, parser: %p", this);
+          configs_reported_ = false;
+          config_changed_ = true;
+        }
+        ReportConfig(false);
+        break;
+      }
+      case FourCC("moof"):
+        if (!track_) {
+          LOG_ERROR("Got moof before moov, dropping it");
+          break;
+        }
+        if (!ParseMoof(&box, box_position, header_size)) {
+          LOG_ERROR("Failed to parse moof at %llu, dropping its samples",
+                    static_cast<unsigned long long>(box_position));
+        }
+        ReportConfig(true);
+        break;
+      case FourCC("mdat"):
+        EmitSamples(buffer, box_position + header_size,
+                    box.size(), &packets);
+        break;
+      case FourCC("pssh"):
+        ParsePssh(box.data() - header_size, box.size() + header_size);
+        break;
+      default:
+        // Unknown box before a moov means this is not an MP4 file at all.
+        if (!track_) return false;
+        LOG_DEBUG("Skipping unknown top level box");
+    }
+    parsed = box.data() + box.size() - buffer->data();
+  }
+
+  if (!reader.ok() && !track_ && parsed == 0) {
+    // E.g. WebM EBML header, read as a box, is larger than the data.
+    return false;
+  }
+
+  if (parsed < buffer->size())
+    pending_data_.assign(buffer->begin() + parsed, buffer->end());
+  stream_position_ += parsed;
+
+  if (!packets.empty()) {
+    auto packet_list = std::make_shared<PacketBatch>(std::move(packets));
+    callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+        &Mp4Demuxer::PacketsInDispatcherThread, packet_list, generation_));
+  }
+  return true;
+}
+
+bool Mp4Demuxer::ParseMoov(BoxReader* reader) {
+  uint32_t type;
+  BoxReader box;
+  size_t header_size;
+  bool fragmented = false;
+  vector<Track> trex_defaults;
+  track_.reset();
+
+  while (reader->NextBox(&type, &box, &header_size)) {
+    switch (type) {
+      case FourCC("trak"):
+        if (!track_) ParseTrak(&box);
+        break;
+      case FourCC("mvex"): {
+        fragmented = true;
+        BoxReader trex;
+        while (box.NextBox(&type, &trex)) {
+          if (type != FourCC("trex")) continue;
+          uint8_t version;
+          uint32_t flags;
+          trex.FullBoxHeader(&version, &flags);
+          Track defaults;
+          defaults.track_id = trex.U32();
+          trex.U32();  // default_sample_description_index
+          defaults.default_sample_duration = trex.U32();
+          defaults.default_sample_size = trex.U32();
+          defaults.default_sample_flags = trex.U32();
+          trex_defaults.push_back(defaults);
+        }
+        break;
+      }
+      case FourCC("pssh"):
+        ParsePssh(box.data() - header_size, box.size() + header_size);
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (!fragmented || !track_) {
+    LOG_INFO("fragmented: %d, track found: %d", fragmented, !!track_);
+    track_.reset();
+    return false;
+  }
+
+  for (const auto& defaults : trex_defaults) {
+    if (defaults.track_id != track_->track_id) continue;
+    track_->default_sample_duration = defaults.default_sample_duration;
+    track_->default_sample_size = defaults.default_sample_size;
+    track_->default_sample_flags = defaults.default_sample_flags;
+  }
+
+  LOG_INFO("%s track id: %u, timescale: %u, protected: %d",
+           stream_type_ == kVideo ? "VIDEO" : "AUDIO", track_->track_id,
+           track_->timescale, track_->is_protected);
+  return true;
+}
+
+bool Mp4Demuxer::ParseTrak(BoxReader* reader) {
+  const uint32_t expected_handler =
+      stream_type_ == kVideo ? FourCC("vide") : FourCC("soun");
+  auto track = MakeUnique<Track>();
+  uint32_t type;
+  BoxReader box;
+  bool handler_found = false;
+  bool sample_entry_found = false;
+  uint8_t version;
+  uint32_t flags;
+
+  while (reader->NextBox(&type, &box)) {
+    if (type == FourCC("tkhd")) {
+      box.FullBoxHeader(&version, &flags);
+      box.Skip(version == 1 ? 16 : 8);  // creation and modification time
+      track->track_id = box.U32();
+    } else if (type == FourCC("edts")) {
+      BoxReader elst;
+      while (box.NextBox(&type, &elst)) {
+        if (type != FourCC("elst")) continue;
+        elst.FullBoxHeader(&version, &flags);
+        uint32_t entry_count = elst.U32();
+        for (uint32_t i = 0; i < entry_count && elst.ok(); ++i) {
+          int64_t media_time;
+          if (version == 1) {
+            elst.U64();  // segment_duration
+            media_time = static_cast<int64_t>(elst.U64());
+          } else {
+            elst.U32();  // segment_duration
+            media_time = static_cast<int32_t>(elst.U32());
+          }
+          elst.U32();  // media_rate
+          if (media_time >= 0) {  // -1 denotes an empty edit
+            track->media_time = media_time;
+            break;
+          }
+        }
+      }
+    } else if (type == FourCC("mdia")) {
+      BoxReader mdia_box;
+      while (box.NextBox(&type, &mdia_box)) {
+        if (type == FourCC("mdhd")) {
+          mdia_box.FullBoxHeader(&version, &flags);
+          mdia_box.Skip(version == 1 ? 16 : 8);
+          track->timescale = mdia_box.U32();
+        } else if (type == FourCC("hdlr")) {
+          mdia_box.FullBoxHeader(&version, &flags);
+          mdia_box.U32();  // pre_defined
+          handler_found = mdia_box.U32() == expected_handler;
+          if (!handler_found) return false;
+        } else if (type == FourCC("minf") && handler_found) {
+          BoxReader stbl;
+          while (mdia_box.NextBox(&type, &stbl)) {
+            if (type != FourCC("stbl")) continue;
+            BoxReader stsd;
+            while (stbl.NextBox(&type, &stsd)) {
+              if (type != FourCC("stsd")) continue;
+              stsd.FullBoxHeader(&version, &flags);
+              if (stsd.U32() == 0) break;  // entry_count
+              BoxReader entry;
+              if (stsd.NextBox(&type, &entry)) {
+                // Track is needed by ParseSampleEntry to store encryption
+                // parameters.
+                track_ = std::move(track);
+                sample_entry_found = ParseSampleEntry(type, &entry);
+                track = std::move(track_);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  if (!handler_found || !sample_entry_found || track->timescale == 0)
+    return false;
+
+  track_ = std::move(track);
+  return true;
+}
+
+bool Mp4Demuxer::ParseSampleEntry(uint32_t format, BoxReader* reader) {
+  const bool is_video = stream_type_ == kVideo;
+  reader->Skip(8);  // reserved, data_reference_index
+  uint32_t channel_count = 0;
+  uint32_t sample_size = 0;
+  uint32_t sample_rate = 0;
+  if (is_video) {
+    reader->Skip(16);  // pre_defined, reserved
+    uint16_t width = reader->U16();
+    uint16_t height = reader->U16();
+    // resolutions, reserved, frame_count, compressorname, depth, pre_defined
+    reader->Skip(50);
+    video_config_.size = Size(width, height);
+    video_config_.profile_idc = 0;
+    video_config_.level_idc = 0;
+    video_config_.bit_depth = 0;
+    video_config_.color = VideoColorInfo();
+    video_config_.dolby_vision = DolbyVisionConfig();
+  } else {
+    uint16_t version = reader->U16();  // QuickTime sound sample description
+    reader->Skip(6);
+    channel_count = reader->U16();
+    sample_size = reader->U16();
+    reader->Skip(4);
+    sample_rate = reader->U32() >> 16;
+    if (version == 1) reader->Skip(16);
+    if (version == 2) reader->Skip(36);
+  }
+  if (!reader->ok()) return false;
+
+  uint32_t type;
+  BoxReader box;
+  uint8_t version;
+  uint32_t flags;
+  vector<uint8_t> decoder_specific_info;
+  uint8_t object_type = 0;
+
+  while (reader->NextBox(&type, &box)) {
+    switch (type) {
+      case FourCC("avcC"):
+        video_config_.extra_data =
+            CodecExtraData(box.data(), box.data() + box.size());
+        if (box.size() > 3) {
+          video_config_.profile_idc = box.data()[1];
+          video_config_.level_idc = box.data()[3];
+        }
+        break;
+      case FourCC("hvcC"):
+        video_config_.extra_data =
+            CodecExtraData(box.data(), box.data() + box.size());
+        ParseHevcConfig(box.data(), box.size(), &video_config_);
+        break;
+      case FourCC("dvcC"):
+      case FourCC("dvvC"):
+      case FourCC("dvwC"):
+        ParseDolbyVisionConfig(box.data(), box.size(),
+                               &video_config_.dolby_vision);
+        break;
+      case FourCC("colr"): {
+        uint32_t colour_type = box.U32();
+        if (colour_type != FourCC("nclx") && colour_type != FourCC("nclc"))
+          break;
+        video_config_.color.primaries = box.U16();
+        video_config_.color.transfer = box.U16();
+        video_config_.color.matrix = box.U16();
+        // Only nclx has the flag, reading it past the end of nclc gives 0.
+        video_config_.color.full_range = (box.U8() & 0x80) != 0;
+        break;
+      }
+      case FourCC("esds"): {
+        box.FullBoxHeader(&version, &flags);
+        // Walk ES_Descriptor -> DecoderConfigDescriptor -> DecSpecificInfo.
+        while (box.remaining() > 0 && box.ok()) {
+          uint8_t tag = box.U8();
+          uint32_t size = 0;
+          for (int i = 0; i < 4; ++i) {
+            uint8_t b = box.U8();
+            size = (size << 7) | (b & 0x7f);
+            if (!(b & 0x80)) break;
+          }
+          if (tag == kEsDescriptorTag) {
+            box.U16();  // ES_ID
+            uint8_t es_flags = box.U8();
+            if (es_flags & 0x80) box.U16();  // dependsOn_ES_ID
+            if (es_flags & 0x40) box.Skip(box.U8());  // URL
+            if (es_flags & 0x20) box.U16();  // OCR_ES_Id
+          } else if (tag == kDecoderConfigDescriptorTag) {
+            object_type = box.U8();
+            box.Skip(12);  // streamType, bufferSize, maxBitrate, avgBitrate
+          } else if (tag == kDecoderSpecificInfoTag) {
+            const uint8_t* info = box.current();
+            if (box.Skip(size))
+              decoder_specific_info.assign(info, info + size);
+            break;
+          } else {
+            box.Skip(size);
+          }
+        }
+        break;
+      }
+      case FourCC("sinf"): {
+        BoxReader sinf_box;
+        while (box.NextBox(&type, &sinf_box)) {
+          if (type == FourCC("frma")) {
+            format = sinf_box.U32();
+          } else if (type == FourCC("schi")) {
+            BoxReader tenc;
+            while (sinf_box.NextBox(&type, &tenc)) {
+              if (type != FourCC("tenc")) continue;
+              tenc.FullBoxHeader(&version, &flags);
+              tenc.Skip(2);  // reserved, crypt/skip byte block
+              track_->is_protected = tenc.U8() != 0;
+              track_->iv_size = tenc.U8();
+              tenc.Read(track_->kid, kKidLength);
+              if (track_->is_protected && track_->iv_size == 0) {
+                track_->constant_iv_size =
+                    std::min<uint32_t>(tenc.U8(), kMaxIvLength);
+                tenc.Read(track_->constant_iv, track_->constant_iv_size);
+              }
+            }
+          }
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  if (is_video) {
+    video_config_.frame_format = Samsung::NaClPlayer::VIDEOFRAME_FORMAT_YV12;
+    video_config_.frame_rate = Rational(0, 1);
+    switch (format) {
+      case FourCC("avc1"):
+      case FourCC("avc3"):
+      case FourCC("dva1"):
+      case FourCC("dvav"):
+        video_config_.codec_type = Samsung::NaClPlayer::VIDEOCODEC_TYPE_H264;
+        video_config_.codec_profile =
+            video_config_.extra_data.size() > 1
+                ? H264ProfileFromProfileIdc(video_config_.extra_data[1])
+                : Samsung::NaClPlayer::VIDEOCODEC_PROFILE_UNKNOWN;
+        return true;
+#if (PPAPI_RELEASE >= 47)
+      case FourCC("hvc1"):
+      case FourCC("hev1"):
+      case FourCC("dvh1"):
+      case FourCC("dvhe"):
+        video_config_.codec_type = Samsung::NaClPlayer::VIDEOCODEC_TYPE_H265;
+        video_config_.codec_profile =
+            Samsung::NaClPlayer::VIDEOCODEC_PROFILE_UNKNOWN;
+        return true;
+#endif
+      default:
+        LOG_INFO("Unsupported video sample entry");
+        return false;
+    }
+  }
+
+  audio_config_.sample_format = Samsung::NaClPlayer::SAMPLEFORMAT_PLANARF32;
+  audio_config_.bits_per_channel =
+      sample_size > 0 ? sample_size : kDefaultBitsPerChannel;
+  audio_config_.samples_per_second = sample_rate;
+  audio_config_.channel_layout = ChannelLayoutFromAacConfig(0, channel_count);
+  audio_config_.codec_profile = Samsung::NaClPlayer::AUDIOCODEC_PROFILE_UNKNOWN;
+  audio_config_.extra_data = CodecExtraData();
+  switch (format) {
+    case FourCC("mp4a"):
+      if (object_type == kObjectTypeMp3 || object_type == kObjectTypeMpeg2Mp3) {
+        audio_config_.codec_type = Samsung::NaClPlayer::AUDIOCODEC_TYPE_MP3;
+        return true;
+      }
+      if (object_type != kObjectTypeAac && object_type != kObjectTypeAacMain &&
+          object_type != kObjectTypeAacLowComplexity &&
+          object_type != kObjectTypeAacSsr) {
+        LOG_INFO("Unsupported mp4a object type: 0x%x", object_type);
+        return false;
+      }
+      audio_config_.codec_type = Samsung::NaClPlayer::AUDIOCODEC_TYPE_AAC;
+      audio_config_.extra_data = CodecExtraData(decoder_specific_info);
+      if (!decoder_specific_info.empty()) {
+        BitReader bits(decoder_specific_info.data(),
+                       decoder_specific_info.size());
+        uint32_t audio_object_type = bits.Read(5);
+        if (audio_object_type == 31) audio_object_type = 32 + bits.Read(6);
+        uint32_t frequency_index = bits.Read(4);
+        uint32_t frequency = frequency_index == 0xf ? bits.Read(24)
+            : frequency_index < sizeof(kAacSampleRates) / sizeof(uint32_t)
+                ? kAacSampleRates[frequency_index] : 0;
+        uint32_t channel_config = bits.Read(4);
+        if (bits.ok()) {
+          audio_config_.codec_profile =
+              AacProfileFromObjectType(audio_object_type);
+          if (frequency > 0) audio_config_.samples_per_second = frequency;
+          audio_config_.channel_layout =
+              ChannelLayoutFromAacConfig(channel_config, channel_count);
+        }
+      }
+      return true;
+    case FourCC("ac-3"):
+      audio_config_.codec_type = Samsung::NaClPlayer::AUDIOCODEC_TYPE_AC3;
+      return true;
+    case FourCC("ec-3"):
+      audio_config_.codec_type = Samsung::NaClPlayer::AUDIOCODEC_TYPE_EAC3;
+      return true;
+    default:
+      LOG_INFO("Unsupported audio sample entry");
+      return false;
+  }
+}
+
+bool Mp4Demuxer::ParseMoof(BoxReader* reader, uint64_t moof_position,
+                           size_t header_size) {
+  const BoxReader moof = *reader;
+  const size_t first_sample = samples_.size();
+  const size_t first_subsample = subsamples_.size();
+  uint32_t type;
+  BoxReader box;
+  size_t box_header_size;
+  bool ok = true;
+  while (reader->NextBox(&type, &box, &box_header_size)) {
+    if (type == FourCC("traf")) {
+      ok = ParseTraf(&box, moof_position, moof, moof_position + header_size) &&
+           ok;
+    } else if (type == FourCC("pssh")) {
+      // With key rotation, init data of a new key comes with the first
+      // fragment using it. It's reported once the fragment is parsed, i.e.
+      // when its segment is downloaded, so the license is requested before
+      // its packets need to be appended.
+      ParsePssh(box.data() - box_header_size, box.size() + box_header_size);
+    }
+  }
+  if (ok && reader->ok()) return true;
+  // Samples of a broken fragment could be sent with wrong encryption
+  // parameters, or as clear ones.
+  samples_.resize(first_sample);
+  subsamples_.resize(first_subsample);
+  return false;
+}
+
+bool Mp4Demuxer::ParseTraf(BoxReader* reader, uint64_t moof_position,
+                           const BoxReader& moof, uint64_t moof_data_position) {
+  const size_t first_sample = samples_.size();
+  uint32_t type;
+  BoxReader box;
+  size_t header_size;
+  uint8_t version;
+  uint32_t flags;
+
+  uint64_t base_position = moof_position;
+  uint64_t data_position = moof_position;
+  uint32_t default_duration = track_->default_sample_duration;
+  uint32_t default_size = track_->default_sample_size;
+  uint32_t default_flags = track_->default_sample_flags;
+  bool has_decode_time = false;
+  int64_t decode_time = 0;
+
+  BoxReader senc;
+  uint32_t senc_flags = 0;
+  bool has_senc = false;
+  uint8_t saiz_default_size = 0;
+  vector<uint8_t> saiz_sizes;
+  uint32_t saiz_count = 0;
+  bool has_saio = false;
+  uint64_t saio_offset = 0;
+
+  bool is_protected = track_->is_protected;
+  uint8_t track_iv_size = track_->iv_size;
+  const uint8_t* kid = track_->kid;
+
+  while (reader->NextBox(&type, &box, &header_size)) {
+    switch (type) {
+      case FourCC("tfhd"):
+        box.FullBoxHeader(&version, &flags);
+        if (box.U32() != track_->track_id) return true;  // other track
+        if (flags & kBaseDataOffsetPresent) base_position = box.U64();
+        if (flags & kSampleDescriptionIndexPresent) box.U32();
+        if (flags & kDefaultSampleDurationPresent) default_duration = box.U32();
+        if (flags & kDefaultSampleSizePresent) default_size = box.U32();
+        if (flags & kDefaultSampleFlagsPresent) default_flags = box.U32();
+        data_position = base_position;
+        break;
+      case FourCC("tfdt"):
+        box.FullBoxHeader(&version, &flags);
+        decode_time = static_cast<int64_t>(version == 1 ? box.U64()
+                                                        : box.U32());
+        has_decode_time = true;
+        break;
+      case FourCC("trun"): {
+        box.FullBoxHeader(&version, &flags);
+        uint32_t sample_count = box.U32();
+        if (flags & kDataOffsetPresent)
+          data_position = base_position + static_cast<int32_t>(box.U32());
+        uint32_t first_sample_flags =
+            (flags & kFirstSampleFlagsPresent) ? box.U32() : default_flags;
+        for (uint32_t i = 0; i < sample_count && box.ok(); ++i) {
+          Sample sample;
+          sample.position = data_position;
+          sample.duration =
+              (flags & kSampleDurationPresent) ? box.U32() : default_duration;
+          sample.size = (flags & kSampleSizePresent) ? box.U32() : default_size;
+          uint32_t sample_flags = (flags & kSampleFlagsPresent) ? box.U32()
+              : (i == 0 ? first_sample_flags : default_flags);
+          sample.composition_offset = 0;
+          if (flags & kSampleCompositionTimeOffsetPresent)
+            sample.composition_offset = static_cast<int32_t>(box.U32());
+          sample.key_frame = stream_type_ == kAudio ||
+              (!(sample_flags & kSampleIsNonSyncSample) &&
+               (sample_flags & kSampleDependsOnMask) != kSampleDependsOnOthers);
+          sample.dts = 0;
+          sample.encrypted = false;
+          sample.iv_size = 0;
+          sample.first_subsample = 0;
+          sample.subsample_count = 0;
+          samples_.push_back(sample);
+          data_position += sample.size;
+        }
+        if (!box.ok()) return false;
+        break;
+      }
+      case FourCC("senc"):
+        senc = box;
+        senc.FullBoxHeader(&version, &senc_flags);
+        has_senc = true;
+        break;
+      case FourCC("uuid"): {
+        uint8_t uuid[sizeof(kPiffSampleEncryptionUuid)];
+        if (box.Read(uuid, sizeof(uuid)) &&
+            !memcmp(uuid, kPiffSampleEncryptionUuid, sizeof(uuid))) {
+          senc = box;
+          senc.FullBoxHeader(&version, &senc_flags);
+          has_senc = true;
+        }
+        break;
+      }
+      case FourCC("saiz"):
+        box.FullBoxHeader(&version, &flags);
+        if (flags & kAuxInfoTypePresent) box.Skip(8);
+        saiz_default_size = box.U8();
+        saiz_count = box.U32();
+        if (saiz_default_size == 0 && box.remaining() >= saiz_count)
+          saiz_sizes.assign(box.current(), box.current() + saiz_count);
+        break;
+      case FourCC("sgpd"): {
+        box.FullBoxHeader(&version, &flags);
+        // CENC encryption parameters of a fragment, which can use another
+        // key than the one in tenc box (key rotation).
+        if (box.U32() != FourCC("seig")) break;
+        uint32_t default_length = version == 1 ? box.U32() : 0;
+        if (version >= 2) box.U32();  // default_sample_description_index
+        if (box.U32() == 0) break;  // entry_count
+        if (version == 1 && default_length == 0) box.U32();
+        // All samples of a fragment are expected to use its first entry,
+        // which is how packagers signal key rotation.
+        box.Skip(2);  // reserved, crypt/skip byte block
+        bool seig_protected = box.U8() != 0;
+        uint8_t seig_iv_size = box.U8();
+        const uint8_t* seig_kid = box.current();
+        if (box.Skip(kKidLength)) {
+          is_protected = seig_protected;
+          track_iv_size = seig_iv_size;
+          kid = seig_kid;
+        }
+        break;
+      }
+      case FourCC("saio"):
+        box.FullBoxHeader(&version, &flags);
+        if (flags & kAuxInfoTypePresent) box.Skip(8);
+        if (box.U32() > 0) {  // entry_count
+          saio_offset = version == 1 ? box.U64() : box.U32();
+          has_saio = box.ok();
+        }
+        break;
+      case FourCC("pssh"):
+        ParsePssh(box.data() - header_size, box.size() + header_size);
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (!has_decode_time) decode_time = next_decode_time_;
+  for (size_t i = first_sample; i < samples_.size(); ++i) {
+    samples_[i].dts = decode_time;
+    decode_time += samples_[i].duration;
+  }
+  next_decode_time_ = decode_time;
+
+  if (!is_protected) return true;
+
+  for (size_t i = first_sample; i < samples_.size(); ++i)
+    memcpy(samples_[i].kid, kid, kKidLength);
+
+  const size_t sample_count = samples_.size() - first_sample;
+  if (has_senc) {
+    uint8_t iv_size = track_iv_size;
+    if (senc_flags & kOverrideTrackEncryptionBoxParameters) {
+      senc.Skip(3);  // AlgorithmID
+      iv_size = senc.U8();
+      senc.Skip(kKidLength);
+    }
+    uint32_t count = senc.U32();
+    if (count != sample_count) {
+      LOG_ERROR("senc sample count %u, expected %zu", count, sample_count);
+      return false;
+    }
+    for (size_t i = 0; i < sample_count; ++i) {
+      if (!ParseSampleEncryption(&senc, &samples_[first_sample + i], iv_size,
+                                 senc_flags & kUseSubsampleEncryption))
+        return false;
+    }
+    return true;
+  }
+
+  if (has_saio) {
+    // Auxiliary information is expected to be in this moof, which is the
+    // case for all CENC packagers (usually it's a senc payload anyway).
+    uint64_t aux_position = base_position + saio_offset;
+    if (aux_position < moof_data_position ||
+        aux_position - moof_data_position >= moof.size()) {
+      LOG_ERROR("Sample auxiliary information outside of moof!");
+      return false;
+    }
+    size_t aux_offset = aux_position - moof_data_position;
+    BoxReader aux(moof.data() + aux_offset, moof.size() - aux_offset);
+    size_t count = saiz_default_size ? saiz_count : saiz_sizes.size();
+    if (count != sample_count) {
+      LOG_ERROR("saiz sample count %zu, expected %zu", count, sample_count);
+      return false;
+    }
+    for (size_t i = 0; i < sample_count; ++i) {
+      uint8_t info_size = saiz_default_size ? saiz_default_size
+                                            : saiz_sizes[i];
+      if (!ParseSampleEncryption(&aux, &samples_[first_sample + i],
+                                 track_iv_size, info_size > track_iv_size))
+        return false;
+    }
+    return true;
+  }
+
+  // Content without auxiliary information but with a constant IV
+  // (e.g. cbcs), or a clear lead of protected content.
+  if (track_->constant_iv_size > 0) {
+    for (size_t i = first_sample; i < samples_.size(); ++i) {
+      Sample& sample = samples_[i];
+      sample.encrypted = true;
+      sample.iv_size = track_->constant_iv_size;
+      memcpy(sample.iv, track_->constant_iv, sample.iv_size);
+    }
+  }
+  return true;
+}
+
+bool Mp4Demuxer::ParseSampleEncryption(BoxReader* reader, Sample* sample,
+                                       uint8_t iv_size, bool has_subsamples) {
+  sample->encrypted = true;
+  if (iv_size > 0) {
+    sample->iv_size = std::min<uint8_t>(iv_size, kMaxIvLength);
+    reader->Read(sample->iv, sample->iv_size);
+    reader->Skip(iv_size - sample->iv_size);
+  } else {
+    sample->iv_size = track_->constant_iv_size;
+    memcpy(sample->iv, track_->constant_iv, sample->iv_size);
+  }
+
+  if (!has_subsamples) return reader->ok();
+  uint16_t count = reader->U16();
+  sample->first_subsample = subsamples_.size();
+  sample->subsample_count = 0;
+  for (uint16_t i = 0; i < count; ++i) {
+    EncryptedSubsampleDescription subsample;
+    subsample.clear_bytes = reader->U16();
+    subsample.cipher_bytes = reader->U32();
+    if (!reader->ok()) return false;
+    subsamples_.push_back(subsample);
+    ++sample->subsample_count;
+  }
+  return reader->ok();
+}
+
+void Mp4Demuxer::ParsePssh(const uint8_t* data, size_t size) {
+  // The whole box is passed on as init data, so it's read from its header.
+  BoxReader reader(data, size);
+  uint32_t type;
+  BoxReader pssh;
+  uint8_t version;
+  uint32_t flags;
+  if (!reader.NextBox(&type, &pssh) || type != FourCC("pssh")) return;
+  pssh.FullBoxHeader(&version, &flags);
+  const uint8_t* system_id = pssh.current();
+  if (!pssh.Skip(kSystemIdLength) ||
+      memcmp(system_id, kPlayReadySystemId, kSystemIdLength))
+    return;
+
+  LOG_DEBUG("Found PlayReady init data (pssh box)");
+  if (!drm_init_data_callback_) return;
+  callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+      &Mp4Demuxer::DrmInitInDispatcherThread,
+      vector<uint8_t>(data, data + size), generation_));
+}
+
+void Mp4Demuxer::EmitSamples(const shared_ptr<const vector<uint8_t>>& buffer,
+                             uint64_t mdat_position, uint64_t mdat_size,
+                             PacketBatch* packets) {
+  const uint64_t mdat_end = mdat_position + mdat_size;
+  const int64_t timescale = track_->timescale;
+  size_t kept = 0;
+  for (size_t i = 0; i < samples_.size(); ++i) {
+    Sample& sample = samples_[i];
+    if (sample.position < mdat_position ||
+        sample.position + sample.size > mdat_end) {
+      samples_[kept++] = sample;  // might be in one of the next mdat boxes
+      continue;
+    }
+
+    uint32_t offset =
+        static_cast<uint32_t>(sample.position - stream_position_);
+    auto packet = MakeUnique<ElementaryStreamPacket>(buffer, offset,
+                                                     sample.size);
+    packet->demux_id = demux_id_;
+
+    int64_t dts = sample.dts - track_->media_time;
+    MediaTime pts_time =
+        ToMediaTime(dts + sample.composition_offset, timescale) +
+        timestamp_offset_;
+    MediaTime dts_time = ToMediaTime(dts, timescale) + timestamp_offset_;
+    if (!has_packets_ && pts_time + kSegmentEps >= timestamp_) {
+      LOG_DEBUG("Got properly timestamped packet. Zero timestamp variable");
+      timestamp_ = 0;
+    }
+    has_packets_ = true;
+
+    packet->SetMediaTimestamps(pts_time + timestamp_, dts_time + timestamp_,
+                               ToMediaTime(sample.duration, timescale));
+    packet->SetKeyFrame(sample.key_frame);
+
+    if (sample.encrypted) {
+      packet->SetKeyId(sample.kid, kKidLength);
+      packet->SetIv(sample.iv, sample.iv_size);
+      for (size_t j = 0; j < sample.subsample_count; ++j) {
+        const auto& subsample = subsamples_[sample.first_subsample + j];
+        packet->AddSubsample(subsample.clear_bytes, subsample.cipher_bytes);
+      }
+    }
+    packets->push_back(std::move(packet));
+  }
+
+  samples_.resize(kept);
+  if (samples_.empty()) subsamples_.clear();
+}
+
+void Mp4Demuxer::ReportConfig(bool fragment_parsed) {
+  if (configs_reported_) return;
+  // Configs are skipped unless they differ from the ones known already.
+  if (init_mode_ == kSkipInitCodecData && !config_changed_) return;
+
+  if (stream_type_ == kAudio) {
+    configs_reported_ = true;
+    config_changed_ = false;
+    callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+        &Mp4Demuxer::AudioConfigInDispatcherThread, audio_config_,
+        generation_));
+    return;
+  }
+
+  // Frame rate is not a part of ISO BMFF sample entry. It's taken from the
+  // default sample duration or, if there is none, from the first fragment.
+  uint32_t frame_duration = track_->default_sample_duration;
+  if (frame_duration == 0 && !samples_.empty())
+    frame_duration = samples_.front().duration;
+  if (frame_duration == 0 && !fragment_parsed) return;
+
+  if (frame_duration > 0)
+    video_config_.frame_rate = Rational(track_->timescale, frame_duration);
+  LOG_DEBUG("video frame rate: %d / %d", video_config_.frame_rate.numerator,
+            video_config_.frame_rate.denominator);
+  configs_reported_ = true;
+  config_changed_ = false;
+  callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+      &Mp4Demuxer::VideoConfigInDispatcherThread, video_config_,
+      generation_));
+}
+
+void Mp4Demuxer::StartFallback() {
+  if (WebmDemuxer::IsWebm(probe_data_)) {
+    fallback_ = MakeUnique<WebmDemuxer>(instance_, stream_type_, init_mode_,
+                                        options_);
+  } else {
+    fallback_ =
+        FFMpegDemuxer::Create(instance_, stream_type_, init_mode_, options_);
+  }
+  if (!fallback_ || !fallback_->Init(es_pkt_callback_, callback_dispatcher_)) {
+    LOG_ERROR("Failed to initialize fallback demuxer!");
+    return;
+  }
+  if (audio_config_callback_)
+    fallback_->SetAudioConfigListener(audio_config_callback_);
+  if (video_config_callback_)
+    fallback_->SetVideoConfigListener(video_config_callback_);
+  if (drm_init_data_callback_)
+    fallback_->SetDRMInitDataListener(drm_init_data_callback_);
+  if (es_pkts_callback_) fallback_->SetEsPacketsListener(es_pkts_callback_);
+  fallback_->SetTimestamp(ToTimeTicks(timestamp_));
+  fallback_->SetCodecs(codecs_);
+
+  samples_.clear();
+  pending_data_.clear();
+  fallback_->Parse(std::move(probe_data_));
+  probe_data_.clear();
+}
+
+bool Mp4Demuxer::SetAudioConfigListener(
+    const std::function<void(const AudioConfig&)>& callback) {
+  if (!callback) {
+    LOG_DEBUG("callback is null!");
+    return false;
+  }
+  audio_config_callback_ = callback;
+  if (fallback_) return fallback_->SetAudioConfigListener(callback);
+  return true;
+}
+
+bool Mp4Demuxer::SetVideoConfigListener(
+    const std::function<void(const VideoConfig&)>& callback) {
+  if (!callback) {
+    LOG_DEBUG("callback is null!");
+    return false;
+  }
+  video_config_callback_ = callback;
+  if (fallback_) return fallback_->SetVideoConfigListener(callback);
+  return true;
+}
+
+bool Mp4Demuxer::SetDRMInitDataListener(const DrmInitCallback& callback) {
+  if (!callback) {
+    LOG_DEBUG("callback is null!");
+    return false;
+  }
+  drm_init_data_callback_ = callback;
+  if (fallback_) return fallback_->SetDRMInitDataListener(callback);
+  return true;
+}
+
+bool Mp4Demuxer::SetEsPacketsListener(
+    const std::function<void(Message, PacketBatch)>& callback) {
+  if (!callback) {
+    LOG_DEBUG("callback is null!");
+    return false;
+  }
+  es_pkts_callback_ = callback;
+  if (fallback_) return fallback_->SetEsPacketsListener(callback);
+  return true;
+}
+
+void Mp4Demuxer::SetTimestamp(TimeTicks timestamp) {
+  LOG_INFO("current timestamp: %f, new: %f", ToTimeTicks(timestamp_),
+           timestamp);
+  timestamp_ = ToMediaTime(timestamp);
+  if (fallback_) fallback_->SetTimestamp(timestamp);
+}
+
+bool Mp4Demuxer::SetTimestampOffset(TimeTicks offset) {
+  LOG_INFO("current timestamp offset: %f, new: %f",
+           ToTimeTicks(timestamp_offset_), offset);
+  // Fallback demuxer is used for non-fragmented files, which have a single
+  // timeline.
+  if (fallback_) return false;
+
+  timestamp_offset_ = ToMediaTime(offset);
+  return true;
+}
+
+bool Mp4Demuxer::CanSwitchBitstream() const {
+  // A new moov box replaces the track, like at period boundaries.
+  return !fallback_ && track_;
+}
+
+void Mp4Demuxer::SetCodecs(const std::string& codecs) {
+  codecs_ = codecs;
+  if (fallback_) fallback_->SetCodecs(codecs);
+}
+
+void Mp4Demuxer::Abort() {
+  // Data is parsed synchronously, so only packets posted already are left.
+  ++generation_;
+  if (fallback_) fallback_->Abort();
+}
+
+void Mp4Demuxer::Close() {
+  if (fallback_) fallback_->Close();
+  callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+      &Mp4Demuxer::MessageInDispatcherThread, kClosed, generation_));
+}
+
+void Mp4Demuxer::PacketsInDispatcherThread(int32_t,
+    const shared_ptr<PacketBatch>& packets, uint32_t generation) {
+  if (generation != generation_) {
+    LOG_DEBUG("Dropping packets demuxed before flush, parser: %p", this);
+    return;
+  }
+  if (!es_pkt_callback_ && !es_pkts_callback_) {
+    LOG_ERROR("ERROR: es_pkt_callback_ is not initialized");
+    return;
+  }
+  const Message msg = stream_type_ == kVideo ? kVideoPkt : kAudioPkt;
+  if (es_pkts_callback_) {
+    es_pkts_callback_(msg, std::move(*packets));
+    return;
+  }
+  for (auto& packet : *packets) es_pkt_callback_(msg, std::move(packet));
+}
+
+void Mp4Demuxer::MessageInDispatcherThread(int32_t, Message msg,
+                                           uint32_t generation) {
+  LOG_DEBUG("msg: %d", static_cast<int32_t>(msg));
+  if (msg == kEndOfStream && generation == generation_ && es_pkt_callback_)
+    es_pkt_callback_(msg, nullptr);
+}
+
+void Mp4Demuxer::AudioConfigInDispatcherThread(int32_t,
+    const AudioConfig& config, uint32_t generation) {
+  if (generation == generation_ && audio_config_callback_)
+    audio_config_callback_(config);
+}
+
+void Mp4Demuxer::VideoConfigInDispatcherThread(int32_t,
+    const VideoConfig& config, uint32_t generation) {
+  if (generation == generation_ && video_config_callback_)
+    video_config_callback_(config);
+}
+
+void Mp4Demuxer::DrmInitInDispatcherThread(int32_t,
+    const vector<uint8_t>& init_data, uint32_t generation) {
+  if (generation == generation_ && drm_init_data_callback_)
+    drm_init_data_callback_(kDRMInitDataType, init_data);
+}
+
+unique_ptr<StreamDemuxer> StreamDemuxer::Create(
+    const pp::InstanceHandle& instance, Type type, InitMode init_mode,
+    const DemuxerOptions& options) {
+  switch (type) {
+    case kAudio:
+    case kVideo:
+      return MakeUnique<Mp4Demuxer>(instance, type, init_mode, options);
+    default:
+      LOG_ERROR("ERROR - not supported type of stream");
+  }
+
+  return nullptr;
+}
+
+double StreamDemuxer::GetCpuTime() {
+  return demuxers_cpu_time.load() / 1e6;
+}
+
+double StreamDemuxer::GetThreadCpuTime() {
+  return CpuProfiler::ThreadCpuTime();
+}
+
+void StreamDemuxer::AddCpuTime(double seconds) {
+  if (seconds > 0.) demuxers_cpu_time += static_cast<uint64_t>(seconds * 1e6);
+}
+
+int StreamDemuxer::NextDemuxId() {
+  return ++last_demux_id;
+}
@@ -0,0 +1,173 @@
+/*!
+ * mp4_demuxer.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_MP4_DEMUXER_H_
+#define SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_MP4_DEMUXER_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/cpp/message_loop.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "nacl_player/media_common.h"
+
+#include "demuxer/stream_demuxer.h"
+
+class BoxReader;
+
+/// @class Mp4Demuxer
+/// @brief A demuxer of fragmented MP4 (ISO BMFF, CMAF) streams.
+///
+/// Data is parsed synchronously in <code>Parse()</code> on the calling thread
+/// and demuxed packets refer to the parsed buffer instead of copying it.
+/// Results are posted to the callback dispatcher, like in other demuxers.
+///
+/// Supported are single track streams with AVC/HEVC video or AAC/AC-3/E-AC-3
+/// audio, optionally CENC encrypted (<code>senc</code>, PIFF sample encryption
+/// box or <code>saiz</code>/<code>saio</code> pointing into <code>moof</code>).
+/// WebM streams are passed to <code>WebmDemuxer</code>, other containers (or
+/// non-fragmented MP4 files) to <code>FFMpegDemuxer</code>.
+class Mp4Demuxer : public StreamDemuxer {
+ public:
+  typedef std::function<void(StreamDemuxer::Message,
+      std::unique_ptr<ElementaryStreamPacket>)> InitCallback;
+  typedef std::function<void(const std::string&,
+      const std::vector<uint8_t>& init_data)> DrmInitCallback;
+
+  Mp4Demuxer(const pp::InstanceHandle& instance, Type type,
+             InitMode init_mode,
+             const DemuxerOptions& options = DemuxerOptions());
+  ~Mp4Demuxer() override;
+
+  bool Init(const InitCallback& callback,
+            pp::MessageLoop callback_dispatcher) override;
+  void Flush() override;
+  void Parse(const std::vector<uint8_t>& data) override;
+  void Parse(std::vector<uint8_t>&& data) override;
+  bool SetAudioConfigListener(
+      const std::function<void(const AudioConfig&)>& callback) override;
+  bool SetVideoConfigListener(
+      const std::function<void(const VideoConfig&)>& callback) override;
+  bool SetDRMInitDataListener(const DrmInitCallback& callback) override;
+  bool SetEsPacketsListener(
+      const std::function<void(Message, PacketBatch)>& callback) override;
+  void SetTimestamp(Samsung::NaClPlayer::TimeTicks) override;
+  bool SetTimestampOffset(Samsung::NaClPlayer::TimeTicks) override;
+  bool CanSwitchBitstream() const override;
+  void SetCodecs(const std::string& codecs) override;
+  void Abort() override;
+  void Close() override;
+
+ private:
+  struct Track;
+  struct Sample;
+
+  // Returns false when data is not a fragmented MP4 and fallback demuxer
+  // should be used.
+  bool ParseBuffer(const std::shared_ptr<const std::vector<uint8_t>>& buffer);
+  bool ParseMoov(BoxReader* reader);
+  bool ParseTrak(BoxReader* reader);
+  bool ParseSampleEntry(uint32_t format, BoxReader* reader);
+  bool ParseMoof(BoxReader* reader, uint64_t moof_position,
+                 size_t header_size);
+  bool ParseTraf(BoxReader* reader, uint64_t moof_position,
+                 const BoxReader& moof, uint64_t moof_data_position);
+  // Reads IV and subsamples of a single sample from senc box or sample
+  // auxiliary information. Returns false if they are truncated.
+  bool ParseSampleEncryption(BoxReader* reader, Sample* sample,
+                             uint8_t iv_size, bool has_subsamples);
+  void ParsePssh(const uint8_t* data, size_t size);
+  void EmitSamples(const std::shared_ptr<const std::vector<uint8_t>>& buffer,
+                   uint64_t mdat_position, uint64_t mdat_size,
+                   PacketBatch* packets);
+  // Posts stream config once it's known. Video frame rate is not known until
+  // the first fragment is parsed, unless moov holds default sample duration.
+  void ReportConfig(bool fragment_parsed);
+  // Passes all data received so far to WebmDemuxer or FFMpegDemuxer and makes
+  // it handle all further calls.
+  void StartFallback();
+
+  void PacketsInDispatcherThread(int32_t,
+      const std::shared_ptr<PacketBatch>& packets, uint32_t generation);
+  void MessageInDispatcherThread(int32_t, StreamDemuxer::Message msg,
+                                 uint32_t generation);
+  void AudioConfigInDispatcherThread(int32_t, const AudioConfig& config,
+                                     uint32_t generation);
+  void VideoConfigInDispatcherThread(int32_t, const VideoConfig& config,
+                                     uint32_t generation);
+  void DrmInitInDispatcherThread(int32_t,
+      const std::vector<uint8_t>& init_data, uint32_t generation);
+
+  pp::InstanceHandle instance_;
+  Type stream_type_;
+  InitMode init_mode_;
+  // Passed on to the fallback demuxer.
+  DemuxerOptions options_;
+  pp::CompletionCallbackFactory<Mp4Demuxer> callback_factory_;
+  pp::MessageLoop callback_dispatcher_;
+
+  InitCallback es_pkt_callback_;
+  std::function<void(const AudioConfig&)> audio_config_callback_;
+  std::function<void(const VideoConfig&)> video_config_callback_;
+  DrmInitCallback drm_init_data_callback_;
+  std::function<void(Message, PacketBatch)> es_pkts_callback_;
+
+  // @codecs from the manifest, completing configs of sample entries which
+  // lack decoder configuration.
+  std::string codecs_;
+
+  // Used when stream is not a fragmented MP4 file.
+  std::unique_ptr<StreamDemuxer> fallback_;
+
+  std::unique_ptr<Track> track_;
+  // Samples of parsed moof boxes, which data is not parsed yet.
+  std::vector<Sample> samples_;
+  std::vector<Samsung::NaClPlayer::EncryptedSubsampleDescription> subsamples_;
+  // Incomplete box left from previous Parse() call.
+  std::vector<uint8_t> pending_data_;
+  // Position of pending_data_ (or of the next buffer) in the stream.
+  uint64_t stream_position_;
+  // Data received before moov box, for the fallback demuxer.
+  std::vector<uint8_t> probe_data_;
+  // Decode time of next fragment, used when it has no tfdt box.
+  int64_t next_decode_time_;
+  bool configs_reported_;
+  // Set when a new moov box changed the config, which needs to be reported
+  // even if codec data reporting is skipped.
+  bool config_changed_;
+
+  // Both are in units of kMediaTimescale, so packet timestamps are computed
+  // without floating point arithmetic.
+  MediaTime timestamp_;
+  // Added to timestamps of all demuxed packets.
+  MediaTime timestamp_offset_;
+  bool has_packets_;
+  // Incremented on each flush to drop results posted before it.
+  std::atomic<uint32_t> generation_;
+
+  AudioConfig audio_config_;
+  VideoConfig video_config_;
+  int demux_id_;
+};
+
+#endif  // SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_MP4_DEMUXER_H_
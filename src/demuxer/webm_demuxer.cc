@@ -0,0 +1,886 @@
+/*!
+ * webm_demuxer.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDemuxer
+
+#include "webm_demuxer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "common.h"
+#include "convert_codecs.h"
+#include "demuxer/elementary_stream_packet.h"
+#include "ffmpeg_demuxer.h"
+
+using pp::MessageLoop;
+using std::shared_ptr;
+using std::unique_ptr;
+using std::vector;
+using Samsung::NaClPlayer::Rational;
+using Samsung::NaClPlayer::Size;
+using Samsung::NaClPlayer::TimeTicks;
+
+namespace {
+
+// EBML and Matroska element ids.
+const uint32_t kEbmlHeaderId = 0x1A45DFA3;
+const uint32_t kSegmentId = 0x18538067;
+const uint32_t kInfoId = 0x1549A966;
+const uint32_t kTimecodeScaleId = 0x2AD7B1;
+const uint32_t kTracksId = 0x1654AE6B;
+const uint32_t kTrackEntryId = 0xAE;
+const uint32_t kTrackNumberId = 0xD7;
+const uint32_t kTrackTypeId = 0x83;
+const uint32_t kCodecIdId = 0x86;
+const uint32_t kCodecPrivateId = 0x63A2;
+const uint32_t kDefaultDurationId = 0x23E383;
+const uint32_t kContentEncodingsId = 0x6D80;
+const uint32_t kVideoId = 0xE0;
+const uint32_t kPixelWidthId = 0xB0;
+const uint32_t kPixelHeightId = 0xBA;
+const uint32_t kColourId = 0x55B0;
+const uint32_t kMatrixCoefficientsId = 0x55B1;
+const uint32_t kBitsPerChannelId = 0x55B2;
+const uint32_t kRangeId = 0x55B9;
+const uint32_t kTransferCharacteristicsId = 0x55BA;
+const uint32_t kPrimariesId = 0x55BB;
+const uint32_t kAudioId = 0xE1;
+const uint32_t kSamplingFrequencyId = 0xB5;
+const uint32_t kChannelsId = 0x9F;
+const uint32_t kBitDepthId = 0x6264;
+const uint32_t kClusterId = 0x1F43B675;
+const uint32_t kTimecodeId = 0xE7;
+const uint32_t kSimpleBlockId = 0xA3;
+const uint32_t kBlockGroupId = 0xA0;
+const uint32_t kBlockId = 0xA1;
+const uint32_t kBlockDurationId = 0x9B;
+const uint32_t kReferenceBlockId = 0xFB;
+
+// TrackType values
+const uint64_t kTrackTypeVideo = 1;
+const uint64_t kTrackTypeAudio = 2;
+
+// Block flags
+const uint8_t kSimpleBlockKeyFrame = 0x80;
+const uint8_t kLacingMask = 0x06;
+const uint8_t kNoLacing = 0x00;
+const uint8_t kXiphLacing = 0x02;
+const uint8_t kFixedSizeLacing = 0x04;
+const uint8_t kEbmlLacing = 0x06;
+
+// Colour Range value of full range video.
+const uint64_t kFullRange = 2;
+
+// Matroska default, timecodes are in milliseconds.
+const uint64_t kDefaultTimecodeScale = 1000000;
+const int64_t kNanosecondsPerSecond = 1000000000;
+// Size of an element which extends to the end of its parent.
+const uint64_t kUnknownSize = ~0ULL;
+
+const int32_t kDefaultBitsPerChannel = 16;
+
+const MediaTime kSegmentEps = kMediaTimescale / 2;
+
+}  // anonymous namespace
+
+// Bounds checked reader of EBML elements. Once a read goes past the end of
+// data, all further reads return 0 and ok() returns false.
+class WebmDemuxer::EbmlReader {
+ public:
+  EbmlReader() : data_(nullptr), size_(0), pos_(0), ok_(true) {}
+  EbmlReader(const uint8_t* data, size_t size)
+      : data_(data), size_(size), pos_(0), ok_(true) {}
+
+  bool ok() const { return ok_; }
+  const uint8_t* data() const { return data_; }
+  const uint8_t* current() const { return data_ + pos_; }
+  size_t size() const { return size_; }
+  size_t position() const { return pos_; }
+  size_t remaining() const { return size_ - pos_; }
+
+  bool Skip(size_t bytes) {
+    if (!ok_ || bytes > remaining()) {
+      ok_ = false;
+      pos_ = size_;
+      return false;
+    }
+    pos_ += bytes;
+    return true;
+  }
+
+  uint8_t U8() { return static_cast<uint8_t>(ReadBigEndian(1)); }
+  uint16_t U16() { return static_cast<uint16_t>(ReadBigEndian(2)); }
+
+  // Reads a whole element payload as an unsigned integer.
+  uint64_t Unsigned() { return ReadBigEndian(std::min<size_t>(size_, 8)); }
+
+  // Reads a whole element payload as a float.
+  double Float() {
+    if (size_ == 4) {
+      uint32_t bits = static_cast<uint32_t>(ReadBigEndian(4));
+      float value;
+      memcpy(&value, &bits, sizeof(value));
+      return value;
+    }
+    if (size_ != 8) return 0.0;
+    uint64_t bits = ReadBigEndian(8);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  // Reads a variable size integer. The length marker is kept in ids and
+  // stripped from other values, a value with all bits set is kUnknownSize.
+  // length, if given, receives the number of bytes read.
+  uint64_t Vint(bool is_id, size_t* length = nullptr) {
+    if (!ok_ || remaining() == 0 || *current() == 0) {
+      Skip(remaining() + 1);
+      return 0;
+    }
+    const uint8_t first = *current();
+    size_t bytes = 1;
+    while (!(first & (0x80 >> (bytes - 1)))) ++bytes;
+    const uint8_t* src = current();
+    if (!Skip(bytes)) return 0;
+
+    const uint64_t mask = 0xFF >> bytes;
+    uint64_t value = is_id ? first : first & mask;
+    bool all_ones = (first & mask) == mask;
+    for (size_t i = 1; i < bytes; ++i) {
+      value = (value << 8) | src[i];
+      all_ones = all_ones && src[i] == 0xFF;
+    }
+    if (length) *length = bytes;
+    return !is_id && all_ones ? kUnknownSize : value;
+  }
+
+  // Reads a header of the next element. Returns false at the end of data or
+  // when the header is malformed. Data isn't consumed then.
+  bool NextHeader(uint32_t* id, uint64_t* size) {
+    size_t start = pos_;
+    uint64_t element_id = Vint(true);
+    *size = Vint(false);
+    if (!ok_ || element_id > 0xFFFFFFFFu) {
+      pos_ = start;
+      ok_ = true;
+      return false;
+    }
+    *id = static_cast<uint32_t>(element_id);
+    return true;
+  }
+
+  // Takes the payload of an element which header was just read. Returns
+  // false if it doesn't fit in data, which isn't consumed then.
+  bool Payload(uint64_t size, EbmlReader* payload) {
+    if (!ok_ || size > remaining()) return false;
+    *payload = EbmlReader(current(), size);
+    pos_ += size;
+    return true;
+  }
+
+  // Reads the next complete child element. Returns false at the end of data
+  // or when the element is malformed.
+  bool NextElement(uint32_t* id, EbmlReader* payload) {
+    uint64_t size;
+    if (!NextHeader(id, &size) || !Payload(size, payload)) {
+      ok_ = false;
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  uint64_t ReadBigEndian(size_t bytes) {
+    const uint8_t* src = current();
+    if (!Skip(bytes)) return 0;
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) value = (value << 8) | src[i];
+    return value;
+  }
+
+  const uint8_t* data_;
+  size_t size_;
+  size_t pos_;
+  bool ok_;
+};
+
+struct WebmDemuxer::Track {
+  Track() : number(0), default_duration(0) {}
+
+  uint64_t number;
+  // Duration of each frame in kMediaTimescale units, 0 if it's not known.
+  MediaTime default_duration;
+};
+
+WebmDemuxer::WebmDemuxer(const pp::InstanceHandle& instance, Type type,
+                         InitMode init_mode, const DemuxerOptions& options)
+    : instance_(instance),
+      stream_type_(type),
+      init_mode_(init_mode),
+      options_(options),
+      callback_factory_(this),
+      header_found_(false),
+      timecode_scale_(kDefaultTimecodeScale),
+      cluster_timecode_(0),
+      first_block_time_(-1),
+      first_block_distance_(0),
+      configs_reported_(false),
+      config_changed_(false),
+      timestamp_(0),
+      timestamp_offset_(0),
+      has_packets_(false),
+      generation_(0),
+      demux_id_(NextDemuxId()) {
+  LOG_DEBUG("parser: %p", this);
+  audio_config_.demux_id = demux_id_;
+  video_config_.demux_id = demux_id_;
+}
+
+WebmDemuxer::~WebmDemuxer() {
+  LOG_DEBUG("parser: %p", this);
+}
+
+bool WebmDemuxer::IsWebm(const vector<uint8_t>& data) {
+  EbmlReader reader(data.data(), data.size());
+  uint32_t id;
+  uint64_t size;
+  return reader.NextHeader(&id, &size) && id == kEbmlHeaderId;
+}
+
+bool WebmDemuxer::Init(const InitCallback& callback,
+                       MessageLoop callback_dispatcher) {
+  LOG_DEBUG("Start, parser: %p", this);
+  if (callback_dispatcher.is_null() || !callback) {
+    LOG_ERROR("ERROR: callback is null or callback_dispatcher is invalid!");
+    return false;
+  }
+
+  es_pkt_callback_ = callback;
+  callback_dispatcher_ = callback_dispatcher;
+  callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+      &WebmDemuxer::MessageInDispatcherThread, kInitialized, generation_));
+  return true;
+}
+
+void WebmDemuxer::Flush() {
+  LOG_DEBUG("parser: %p", this);
+  if (fallback_) {
+    fallback_->Flush();
+    return;
+  }
+
+  ++generation_;
+  pending_data_.clear();
+  probe_data_.clear();
+  cluster_timecode_ = 0;
+  has_packets_ = false;
+  callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+      &WebmDemuxer::MessageInDispatcherThread, kFlushed, generation_));
+}
+
+void WebmDemuxer::Parse(const vector<uint8_t>& data) {
+  Parse(vector<uint8_t>(data));
+}
+
+void WebmDemuxer::Parse(vector<uint8_t>&& data) {
+  LOG_DEBUG("parser: %p, data size: %zu", this, data.size());
+  if (fallback_) {
+    fallback_->Parse(std::move(data));
+    return;
+  }
+
+  if (data.empty()) {
+    LOG_DEBUG("Signal EOF");
+    callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+        &WebmDemuxer::MessageInDispatcherThread, kEndOfStream, generation_));
+    return;
+  }
+
+  // Until the track is recognized, keep its data for a fallback demuxer.
+  if (!track_) probe_data_.insert(probe_data_.end(), data.begin(), data.end());
+
+  shared_ptr<vector<uint8_t>> buffer;
+  if (pending_data_.empty()) {
+    buffer = std::make_shared<vector<uint8_t>>(std::move(data));
+  } else {
+    pending_data_.insert(pending_data_.end(), data.begin(), data.end());
+    buffer = std::make_shared<vector<uint8_t>>(std::move(pending_data_));
+    pending_data_.clear();
+  }
+
+  double cpu_start = GetThreadCpuTime();
+  bool parsed = ParseBuffer(buffer);
+  AddCpuTime(GetThreadCpuTime() - cpu_start);
+  if (!parsed) {
+    LOG_INFO("Not a supported WebM stream, using FFmpeg demuxer");
+    StartFallback();
+  }
+}
+
+bool WebmDemuxer::ParseBuffer(
+    const shared_ptr<const vector<uint8_t>>& buffer) {
+  EbmlReader reader(buffer->data(), buffer->size());
+  PacketBatch packets;
+  size_t parsed = 0;
+  uint32_t id;
+  uint64_t size;
+
+  // Segment and clusters are entered without waiting for their end, other
+  // elements are parsed when they are complete.
+  while (reader.NextHeader(&id, &size)) {
+    if (!track_ && !header_found_ && id != kEbmlHeaderId) return false;
+    if (id == kSegmentId || id == kClusterId) {
+      if (id == kClusterId) cluster_timecode_ = 0;
+      parsed = reader.position();
+      continue;
+    }
+    if (size == kUnknownSize) {
+      if (!track_) return false;
+      // Its end can't be found, so the rest of data is dropped.
+      LOG_ERROR("Element 0x%x of unknown size, dropping data", id);
+      parsed = buffer->size();
+      break;
+    }
+
+    EbmlReader element;
+    if (!reader.Payload(size, &element)) break;
+    switch (id) {
+      case kEbmlHeaderId:
+        header_found_ = true;
+        break;
+      case kInfoId: {
+        uint32_t child_id;
+        EbmlReader child;
+        while (element.NextElement(&child_id, &child)) {
+          if (child_id == kTimecodeScaleId) timecode_scale_ = child.Unsigned();
+        }
+        if (timecode_scale_ == 0) timecode_scale_ = kDefaultTimecodeScale;
+        break;
+      }
+      case kTracksId: {
+        bool had_track = track_ != nullptr;
+        AudioConfig previous_audio_config = audio_config_;
+        VideoConfig previous_video_config = video_config_;
+        if (!ParseTracks(&element)) return false;
+        if (stream_type_ == kAudio)
+          ApplyCodecString(codecs_, &audio_config_);
+        else
+          ApplyCodecString(codecs_, &video_config_);
+        probe_data_.clear();
+        probe_data_.shrink_to_fit();
+        // A new initialization segment in the middle of the stream, e.g. at
+        // a representation switch, can change the stream config.
+        if (had_track && (stream_type_ == kAudio
+                ? !(audio_config_ == previous_audio_config)
+                : !(video_config_ == previous_video_config))) {
+          LOG_INFO("Stream config changed, parser: %p", this);
+          configs_reported_ = false;
+          config_changed_ = true;
+        }
+        ReportConfig(false);
+        break;
+      }
+      case kTimecodeId:
+        cluster_timecode_ = element.Unsigned();
+        break;
+      case kSimpleBlockId:
+        if (track_)
+          ParseBlock(buffer, &element, true, 0, false, &packets);
+        break;
+      case kBlockGroupId: {
+        if (!track_) break;
+        EbmlReader block;
+        bool has_block = false;
+        bool key_frame = true;
+        MediaTime duration = 0;
+        uint32_t child_id;
+        EbmlReader child;
+        while (element.NextElement(&child_id, &child)) {
+          if (child_id == kBlockId) {
+            block = child;
+            has_block = true;
+          } else if (child_id == kBlockDurationId) {
+            duration = ToMediaTime(child.Unsigned() * timecode_scale_,
+                                   kNanosecondsPerSecond);
+          } else if (child_id == kReferenceBlockId) {
+            key_frame = false;
+          }
+        }
+        if (has_block)
+          ParseBlock(buffer, &block, false, duration, key_frame, &packets);
+        break;
+      }
+      default:
+        // SeekHead, Cues, Void, Tags and other elements not needed here.
+        break;
+    }
+    parsed = reader.position();
+  }
+
+  if (track_ && !packets.empty()) ReportConfig(true);
+
+  if (parsed < buffer->size())
+    pending_data_.assign(buffer->begin() + parsed, buffer->end());
+
+  if (!packets.empty()) {
+    auto packet_list = std::make_shared<PacketBatch>(std::move(packets));
+    callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+        &WebmDemuxer::PacketsInDispatcherThread, packet_list, generation_));
+  }
+  return true;
+}
+
+bool WebmDemuxer::ParseTracks(EbmlReader* reader) {
+  uint32_t id;
+  EbmlReader entry;
+  track_.reset();
+  first_block_time_ = -1;
+  first_block_distance_ = 0;
+
+  // The first track of the stream type is demuxed.
+  while (reader->NextElement(&id, &entry)) {
+    if (id != kTrackEntryId) continue;
+    auto track = MakeUnique<Track>();
+    if (!ParseTrackEntry(&entry, track.get())) continue;
+    track_ = std::move(track);
+    break;
+  }
+
+  if (!track_) {
+    LOG_INFO("No supported %s track", stream_type_ == kVideo ? "video"
+                                                             : "audio");
+    return false;
+  }
+
+  LOG_INFO("%s track number: %llu, timecode scale: %llu",
+           stream_type_ == kVideo ? "VIDEO" : "AUDIO",
+           static_cast<unsigned long long>(track_->number),
+           static_cast<unsigned long long>(timecode_scale_));
+  return true;
+}
+
+bool WebmDemuxer::ParseTrackEntry(EbmlReader* reader, Track* track) {
+  const uint64_t expected_type =
+      stream_type_ == kVideo ? kTrackTypeVideo : kTrackTypeAudio;
+  uint64_t track_type = 0;
+  std::string codec_id;
+  CodecExtraData codec_private;
+  bool encrypted = false;
+  EbmlReader video;
+  EbmlReader audio;
+  uint32_t id;
+  EbmlReader element;
+
+  while (reader->NextElement(&id, &element)) {
+    switch (id) {
+      case kTrackNumberId:
+        track->number = element.Unsigned();
+        break;
+      case kTrackTypeId:
+        track_type = element.Unsigned();
+        break;
+      case kCodecIdId:
+        codec_id.assign(reinterpret_cast<const char*>(element.data()),
+                        strnlen(reinterpret_cast<const char*>(element.data()),
+                                element.size()));
+        break;
+      case kCodecPrivateId:
+        codec_private = CodecExtraData(element.data(),
+                                       element.data() + element.size());
+        break;
+      case kDefaultDurationId:
+        track->default_duration =
+            ToMediaTime(element.Unsigned(), kNanosecondsPerSecond);
+        break;
+      case kContentEncodingsId:
+        encrypted = true;
+        break;
+      case kVideoId:
+        video = element;
+        break;
+      case kAudioId:
+        audio = element;
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (track_type != expected_type || track->number == 0) return false;
+  if (encrypted) {
+    LOG_INFO("Track %llu is encrypted or compressed",
+             static_cast<unsigned long long>(track->number));
+    return false;
+  }
+
+  if (stream_type_ == kVideo) {
+    video_config_.frame_format = Samsung::NaClPlayer::VIDEOFRAME_FORMAT_YV12;
+    video_config_.frame_rate = Rational(0, 1);
+    video_config_.extra_data = codec_private;
+    video_config_.profile_idc = 0;
+    video_config_.level_idc = 0;
+    video_config_.bit_depth = 0;
+    video_config_.color = VideoColorInfo();
+    video_config_.dolby_vision = DolbyVisionConfig();
+    if (codec_id == "V_VP9") {
+      video_config_.codec_type = Samsung::NaClPlayer::VIDEOCODEC_TYPE_VP9;
+      video_config_.codec_profile =
+          Samsung::NaClPlayer::VIDEOCODEC_PROFILE_VP9_MAIN;
+    } else if (codec_id == "V_VP8") {
+      video_config_.codec_type = Samsung::NaClPlayer::VIDEOCODEC_TYPE_VP8;
+      video_config_.codec_profile =
+          Samsung::NaClPlayer::VIDEOCODEC_PROFILE_VP8_MAIN;
+    } else {
+      LOG_INFO("Unsupported video codec: %s", codec_id.c_str());
+      return false;
+    }
+    ParseVideo(&video);
+    return true;
+  }
+
+  audio_config_.codec_profile = Samsung::NaClPlayer::AUDIOCODEC_PROFILE_UNKNOWN;
+  audio_config_.sample_format = Samsung::NaClPlayer::SAMPLEFORMAT_PLANARF32;
+  audio_config_.extra_data = codec_private;
+  if (codec_id == "A_OPUS") {
+    audio_config_.codec_type = Samsung::NaClPlayer::AUDIOCODEC_TYPE_OPUS;
+  } else if (codec_id == "A_VORBIS") {
+    audio_config_.codec_type = Samsung::NaClPlayer::AUDIOCODEC_TYPE_VORBIS;
+  } else {
+    LOG_INFO("Unsupported audio codec: %s", codec_id.c_str());
+    return false;
+  }
+  ParseAudio(&audio);
+  return true;
+}
+
+void WebmDemuxer::ParseVideo(EbmlReader* reader) {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t id;
+  EbmlReader element;
+  while (reader->NextElement(&id, &element)) {
+    if (id == kPixelWidthId) {
+      width = element.Unsigned();
+    } else if (id == kPixelHeightId) {
+      height = element.Unsigned();
+    } else if (id == kColourId) {
+      EbmlReader colour;
+      while (element.NextElement(&id, &colour)) {
+        if (id == kMatrixCoefficientsId)
+          video_config_.color.matrix = colour.Unsigned();
+        else if (id == kBitsPerChannelId)
+          video_config_.bit_depth = colour.Unsigned();
+        else if (id == kRangeId)
+          video_config_.color.full_range = colour.Unsigned() == kFullRange;
+        else if (id == kTransferCharacteristicsId)
+          video_config_.color.transfer = colour.Unsigned();
+        else if (id == kPrimariesId)
+          video_config_.color.primaries = colour.Unsigned();
+      }
+    }
+  }
+  video_config_.size = Size(width, height);
+}
+
+void WebmDemuxer::ParseAudio(EbmlReader* reader) {
+  uint32_t channels = 1;  // Matroska default
+  double sample_rate = 8000.0;
+  int32_t bits_per_channel = kDefaultBitsPerChannel;
+  uint32_t id;
+  EbmlReader element;
+  while (reader->NextElement(&id, &element)) {
+    if (id == kSamplingFrequencyId)
+      sample_rate = element.Float();
+    else if (id == kChannelsId)
+      channels = element.Unsigned();
+    else if (id == kBitDepthId)
+      bits_per_channel = element.Unsigned();
+  }
+  audio_config_.samples_per_second = static_cast<int32_t>(sample_rate);
+  audio_config_.bits_per_channel = bits_per_channel;
+  audio_config_.channel_layout = ChannelLayoutFromChannelCount(channels);
+}
+
+void WebmDemuxer::ParseBlock(const shared_ptr<const vector<uint8_t>>& buffer,
+                             EbmlReader* block, bool simple_block,
+                             MediaTime duration, bool key_frame,
+                             PacketBatch* packets) {
+  uint64_t track_number = block->Vint(false);
+  int16_t relative_timecode = static_cast<int16_t>(block->U16());
+  uint8_t flags = block->U8();
+  if (!block->ok() || track_number != track_->number) return;
+  if (simple_block) key_frame = (flags & kSimpleBlockKeyFrame) != 0;
+
+  // Sizes of laced frames, the last one takes the rest of the block.
+  vector<uint32_t> frame_sizes;
+  const uint8_t lacing = flags & kLacingMask;
+  if (lacing != kNoLacing) {
+    size_t frame_count = block->U8() + 1;
+    uint64_t laced_size = 0;
+    if (lacing == kXiphLacing) {
+      for (size_t i = 0; i + 1 < frame_count && block->ok(); ++i) {
+        uint32_t frame_size = 0;
+        uint8_t byte;
+        do {
+          byte = block->U8();
+          frame_size += byte;
+        } while (byte == 0xFF && block->ok());
+        frame_sizes.push_back(frame_size);
+        laced_size += frame_size;
+      }
+    } else if (lacing == kEbmlLacing) {
+      int64_t frame_size = block->Vint(false);
+      for (size_t i = 0; i + 1 < frame_count && block->ok(); ++i) {
+        if (i > 0) {
+          // Signed difference to the previous size, biased by half of the
+          // range of its length.
+          size_t length = 0;
+          int64_t value = block->Vint(false, &length);
+          frame_size += value - ((int64_t(1) << (7 * length - 1)) - 1);
+        }
+        if (frame_size < 0) {
+          LOG_ERROR("Malformed EBML lacing");
+          return;
+        }
+        frame_sizes.push_back(static_cast<uint32_t>(frame_size));
+        laced_size += frame_size;
+      }
+    } else if (lacing == kFixedSizeLacing) {
+      frame_sizes.assign(frame_count - 1, block->remaining() / frame_count);
+      laced_size = (frame_count - 1) * (block->remaining() / frame_count);
+    }
+    if (!block->ok() || laced_size > block->remaining()) {
+      LOG_ERROR("Malformed block lacing");
+      return;
+    }
+    frame_sizes.push_back(block->remaining() - laced_size);
+  } else {
+    frame_sizes.push_back(block->remaining());
+  }
+
+  int64_t timecode = static_cast<int64_t>(cluster_timecode_) +
+                     relative_timecode;
+  MediaTime block_time = ToMediaTime(timecode * timecode_scale_,
+                                     kNanosecondsPerSecond);
+  if (first_block_time_ < 0)
+    first_block_time_ = block_time;
+  else if (first_block_distance_ == 0 && block_time > first_block_time_)
+    first_block_distance_ = block_time - first_block_time_;
+
+  // Frames of a block share its timestamp unless their duration is known.
+  MediaTime frame_duration = track_->default_duration;
+  if (duration > 0)
+    frame_duration = duration / static_cast<MediaTime>(frame_sizes.size());
+
+  size_t offset = block->current() - buffer->data();
+  for (size_t i = 0; i < frame_sizes.size(); ++i) {
+    auto packet = MakeUnique<ElementaryStreamPacket>(buffer, offset,
+                                                     frame_sizes[i]);
+    packet->demux_id = demux_id_;
+    offset += frame_sizes[i];
+
+    MediaTime time = block_time + static_cast<MediaTime>(i) * frame_duration +
+                     timestamp_offset_;
+    if (!has_packets_ && time + kSegmentEps >= timestamp_) {
+      LOG_DEBUG("Got properly timestamped packet. Zero timestamp variable");
+      timestamp_ = 0;
+    }
+    has_packets_ = true;
+
+    // VP8, VP9, Opus and Vorbis frames are stored in presentation order.
+    packet->SetMediaTimestamps(time + timestamp_, time + timestamp_,
+                               frame_duration);
+    packet->SetKeyFrame(key_frame || stream_type_ == kAudio);
+    packets->push_back(std::move(packet));
+  }
+}
+
+void WebmDemuxer::ReportConfig(bool blocks_parsed) {
+  if (configs_reported_) return;
+  // Configs are skipped unless they differ from the ones known already.
+  if (init_mode_ == kSkipInitCodecData && !config_changed_) return;
+
+  if (stream_type_ == kAudio) {
+    configs_reported_ = true;
+    config_changed_ = false;
+    callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+        &WebmDemuxer::AudioConfigInDispatcherThread, audio_config_,
+        generation_));
+    return;
+  }
+
+  // Matroska has no frame rate. It's taken from the default duration or,
+  // if there is none, from the distance of the first two blocks.
+  MediaTime frame_duration = track_->default_duration;
+  if (frame_duration == 0) frame_duration = first_block_distance_;
+  if (frame_duration == 0 && !blocks_parsed) return;
+
+  if (frame_duration > 0)
+    video_config_.frame_rate = Rational(kMediaTimescale, frame_duration);
+  LOG_DEBUG("video frame rate: %d / %d", video_config_.frame_rate.numerator,
+            video_config_.frame_rate.denominator);
+  configs_reported_ = true;
+  config_changed_ = false;
+  callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+      &WebmDemuxer::VideoConfigInDispatcherThread, video_config_,
+      generation_));
+}
+
+void WebmDemuxer::StartFallback() {
+  fallback_ =
+      FFMpegDemuxer::Create(instance_, stream_type_, init_mode_, options_);
+  if (!fallback_ || !fallback_->Init(es_pkt_callback_, callback_dispatcher_)) {
+    LOG_ERROR("Failed to initialize fallback demuxer!");
+    return;
+  }
+  if (audio_config_callback_)
+    fallback_->SetAudioConfigListener(audio_config_callback_);
+  if (video_config_callback_)
+    fallback_->SetVideoConfigListener(video_config_callback_);
+  if (drm_init_data_callback_)
+    fallback_->SetDRMInitDataListener(drm_init_data_callback_);
+  if (es_pkts_callback_) fallback_->SetEsPacketsListener(es_pkts_callback_);
+  fallback_->SetTimestamp(ToTimeTicks(timestamp_));
+  fallback_->SetCodecs(codecs_);
+
+  pending_data_.clear();
+  fallback_->Parse(std::move(probe_data_));
+  probe_data_.clear();
+}
+
+bool WebmDemuxer::SetAudioConfigListener(
+    const std::function<void(const AudioConfig&)>& callback) {
+  if (!callback) {
+    LOG_DEBUG("callback is null!");
+    return false;
+  }
+  audio_config_callback_ = callback;
+  if (fallback_) return fallback_->SetAudioConfigListener(callback);
+  return true;
+}
+
+bool WebmDemuxer::SetVideoConfigListener(
+    const std::function<void(const VideoConfig&)>& callback) {
+  if (!callback) {
+    LOG_DEBUG("callback is null!");
+    return false;
+  }
+  video_config_callback_ = callback;
+  if (fallback_) return fallback_->SetVideoConfigListener(callback);
+  return true;
+}
+
+bool WebmDemuxer::SetDRMInitDataListener(const DrmInitCallback& callback) {
+  if (!callback) {
+    LOG_DEBUG("callback is null!");
+    return false;
+  }
+  // Encrypted tracks are demuxed by the fallback demuxer, which reports
+  // their init data.
+  drm_init_data_callback_ = callback;
+  if (fallback_) return fallback_->SetDRMInitDataListener(callback);
+  return true;
+}
+
+bool WebmDemuxer::SetEsPacketsListener(
+    const std::function<void(Message, PacketBatch)>& callback) {
+  if (!callback) {
+    LOG_DEBUG("callback is null!");
+    return false;
+  }
+  es_pkts_callback_ = callback;
+  if (fallback_) return fallback_->SetEsPacketsListener(callback);
+  return true;
+}
+
+void WebmDemuxer::SetTimestamp(TimeTicks timestamp) {
+  LOG_INFO("current timestamp: %f, new: %f", ToTimeTicks(timestamp_),
+           timestamp);
+  timestamp_ = ToMediaTime(timestamp);
+  if (fallback_) fallback_->SetTimestamp(timestamp);
+}
+
+bool WebmDemuxer::SetTimestampOffset(TimeTicks offset) {
+  LOG_INFO("current timestamp offset: %f, new: %f",
+           ToTimeTicks(timestamp_offset_), offset);
+  if (fallback_) return fallback_->SetTimestampOffset(offset);
+
+  timestamp_offset_ = ToMediaTime(offset);
+  return true;
+}
+
+bool WebmDemuxer::CanSwitchBitstream() const {
+  // New Tracks replace the track, like at representation switches.
+  return !fallback_ && track_;
+}
+
+void WebmDemuxer::SetCodecs(const std::string& codecs) {
+  codecs_ = codecs;
+  if (fallback_) fallback_->SetCodecs(codecs);
+}
+
+void WebmDemuxer::Abort() {
+  // Data is parsed synchronously, so only packets posted already are left.
+  ++generation_;
+  if (fallback_) fallback_->Abort();
+}
+
+void WebmDemuxer::Close() {
+  if (fallback_) fallback_->Close();
+  callback_dispatcher_.PostWork(callback_factory_.NewCallback(
+      &WebmDemuxer::MessageInDispatcherThread, kClosed, generation_));
+}
+
+void WebmDemuxer::PacketsInDispatcherThread(int32_t,
+    const shared_ptr<PacketBatch>& packets, uint32_t generation) {
+  if (generation != generation_) {
+    LOG_DEBUG("Dropping packets demuxed before flush, parser: %p", this);
+    return;
+  }
+  if (!es_pkt_callback_ && !es_pkts_callback_) {
+    LOG_ERROR("ERROR: es_pkt_callback_ is not initialized");
+    return;
+  }
+  const Message msg = stream_type_ == kVideo ? kVideoPkt : kAudioPkt;
+  if (es_pkts_callback_) {
+    es_pkts_callback_(msg, std::move(*packets));
+    return;
+  }
+  for (auto& packet : *packets) es_pkt_callback_(msg, std::move(packet));
+}
+
+void WebmDemuxer::MessageInDispatcherThread(int32_t, Message msg,
+                                            uint32_t generation) {
+  LOG_DEBUG("msg: %d", static_cast<int32_t>(msg));
+  if (msg == kEndOfStream && generation == generation_ && es_pkt_callback_)
+    es_pkt_callback_(msg, nullptr);
+}
+
+void WebmDemuxer::AudioConfigInDispatcherThread(int32_t,
+    const AudioConfig& config, uint32_t generation) {
+  if (generation == generation_ && audio_config_callback_)
+    audio_config_callback_(config);
+}
+
+void WebmDemuxer::VideoConfigInDispatcherThread(int32_t,
+    const VideoConfig& config, uint32_t generation) {
+  if (generation == generation_ && video_config_callback_)
+    video_config_callback_(config);
+}
@@ -0,0 +1,170 @@
+/*!
+ * webm_demuxer.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_WEBM_DEMUXER_H_
+#define SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_WEBM_DEMUXER_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/cpp/message_loop.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "nacl_player/media_common.h"
+
+#include "demuxer/stream_demuxer.h"
+
+/// @class WebmDemuxer
+/// @brief A demuxer of WebM (Matroska) streams, e.g. VP9 and Opus DASH
+/// representations.
+///
+/// Like in <code>Mp4Demuxer</code>, data is parsed synchronously in
+/// <code>Parse()</code> on the calling thread and demuxed packets refer to
+/// the parsed buffer instead of copying it. Results are posted to the
+/// callback dispatcher.
+///
+/// Supported are single track streams with VP8/VP9 video or Opus/Vorbis
+/// audio, in SimpleBlock or BlockGroup elements with any lacing. Encrypted
+/// tracks and other codecs are passed to <code>FFMpegDemuxer</code>.
+class WebmDemuxer : public StreamDemuxer {
+ public:
+  typedef std::function<void(StreamDemuxer::Message,
+      std::unique_ptr<ElementaryStreamPacket>)> InitCallback;
+  typedef std::function<void(const std::string&,
+      const std::vector<uint8_t>& init_data)> DrmInitCallback;
+
+  WebmDemuxer(const pp::InstanceHandle& instance, Type type,
+              InitMode init_mode,
+              const DemuxerOptions& options = DemuxerOptions());
+  ~WebmDemuxer() override;
+
+  /// Checks if data starts with an EBML header, i.e. it's WebM.
+  static bool IsWebm(const std::vector<uint8_t>& data);
+
+  bool Init(const InitCallback& callback,
+            pp::MessageLoop callback_dispatcher) override;
+  void Flush() override;
+  void Parse(const std::vector<uint8_t>& data) override;
+  void Parse(std::vector<uint8_t>&& data) override;
+  bool SetAudioConfigListener(
+      const std::function<void(const AudioConfig&)>& callback) override;
+  bool SetVideoConfigListener(
+      const std::function<void(const VideoConfig&)>& callback) override;
+  bool SetDRMInitDataListener(const DrmInitCallback& callback) override;
+  bool SetEsPacketsListener(
+      const std::function<void(Message, PacketBatch)>& callback) override;
+  void SetTimestamp(Samsung::NaClPlayer::TimeTicks) override;
+  bool SetTimestampOffset(Samsung::NaClPlayer::TimeTicks) override;
+  bool CanSwitchBitstream() const override;
+  void SetCodecs(const std::string& codecs) override;
+  void Abort() override;
+  void Close() override;
+
+ private:
+  struct Track;
+  class EbmlReader;
+
+  // Returns false when data is not a supported WebM stream and fallback
+  // demuxer should be used.
+  bool ParseBuffer(const std::shared_ptr<const std::vector<uint8_t>>& buffer);
+  bool ParseTracks(EbmlReader* reader);
+  // Returns false if the track can't be demuxed by this demuxer.
+  bool ParseTrackEntry(EbmlReader* reader, Track* track);
+  void ParseVideo(EbmlReader* reader);
+  void ParseAudio(EbmlReader* reader);
+  // Makes packets of frames of a SimpleBlock or a Block. duration is the
+  // one of BlockDuration, 0 if there is none. Key frames of a Block are
+  // told by BlockGroup, SimpleBlock flags them itself.
+  void ParseBlock(const std::shared_ptr<const std::vector<uint8_t>>& buffer,
+                  EbmlReader* block, bool simple_block, MediaTime duration,
+                  bool key_frame, PacketBatch* packets);
+  // Posts stream config once it's known. Video frame rate is not known until
+  // blocks are parsed, unless the track has a default duration.
+  void ReportConfig(bool blocks_parsed);
+  // Passes all data received so far to FFMpegDemuxer and makes it handle
+  // all further calls.
+  void StartFallback();
+
+  void PacketsInDispatcherThread(int32_t,
+      const std::shared_ptr<PacketBatch>& packets, uint32_t generation);
+  void MessageInDispatcherThread(int32_t, StreamDemuxer::Message msg,
+                                 uint32_t generation);
+  void AudioConfigInDispatcherThread(int32_t, const AudioConfig& config,
+                                     uint32_t generation);
+  void VideoConfigInDispatcherThread(int32_t, const VideoConfig& config,
+                                     uint32_t generation);
+
+  pp::InstanceHandle instance_;
+  Type stream_type_;
+  InitMode init_mode_;
+  // Passed on to the fallback demuxer.
+  DemuxerOptions options_;
+  pp::CompletionCallbackFactory<WebmDemuxer> callback_factory_;
+  pp::MessageLoop callback_dispatcher_;
+
+  InitCallback es_pkt_callback_;
+  std::function<void(const AudioConfig&)> audio_config_callback_;
+  std::function<void(const VideoConfig&)> video_config_callback_;
+  DrmInitCallback drm_init_data_callback_;
+  std::function<void(Message, PacketBatch)> es_pkts_callback_;
+
+  // @codecs from the manifest, completing configs of tracks which lack
+  // profile or level.
+  std::string codecs_;
+
+  // Used when stream is not supported.
+  std::unique_ptr<StreamDemuxer> fallback_;
+
+  std::unique_ptr<Track> track_;
+  // Incomplete element left from previous Parse() call.
+  std::vector<uint8_t> pending_data_;
+  // Data received before Tracks, for the fallback demuxer.
+  std::vector<uint8_t> probe_data_;
+  // Set once an EBML header is found, data is not WebM without it.
+  bool header_found_;
+  // Nanoseconds per timecode unit, given by Info of the Segment.
+  uint64_t timecode_scale_;
+  // Timecode of the cluster which blocks are parsed.
+  uint64_t cluster_timecode_;
+  // Timestamp of the first block of the track, for the video frame rate.
+  MediaTime first_block_time_;
+  // Distance between the first two blocks, 0 until they are parsed.
+  MediaTime first_block_distance_;
+  bool configs_reported_;
+  // Set when new Tracks changed the config, which needs to be reported
+  // even if codec data reporting is skipped.
+  bool config_changed_;
+
+  // Both are in units of kMediaTimescale, like in Mp4Demuxer.
+  MediaTime timestamp_;
+  // Added to timestamps of all demuxed packets.
+  MediaTime timestamp_offset_;
+  bool has_packets_;
+  // Incremented on each flush to drop results posted before it.
+  std::atomic<uint32_t> generation_;
+
+  AudioConfig audio_config_;
+  VideoConfig video_config_;
+  int demux_id_;
+};
+
+#endif  // SRC_PLAYER_ES_DASH_PLAYER_DEMUXER_WEBM_DEMUXER_H_
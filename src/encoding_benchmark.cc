@@ -0,0 +1,129 @@
+/*!
+ * encoding_benchmark.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#include "encoding_benchmark.h"
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "common.h"
+
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+namespace {
+
+// From a 16 byte key ID to a PSSH box of content with many keys.
+constexpr uint32_t kSizes[] = { 16, 1024, 16 * 1024 };
+// Each measurement processes about that much data.
+constexpr uint64_t kBytesPerMeasurement = 64 * 1024 * 1024;
+
+std::string Base64Encode(const std::vector<uint8_t>& data) {
+  static const char kCodes[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string text;
+  text.reserve((data.size() + 2) / 3 * 4);
+  for (size_t i = 0; i < data.size(); i += 3) {
+    uint32_t value = data[i] << 16;
+    if (i + 1 < data.size()) value |= data[i + 1] << 8;
+    if (i + 2 < data.size()) value |= data[i + 2];
+    text += kCodes[value >> 18];
+    text += kCodes[(value >> 12) & 0x3f];
+    text += i + 1 < data.size() ? kCodes[(value >> 6) & 0x3f] : '=';
+    text += i + 2 < data.size() ? kCodes[value & 0x3f] : '=';
+  }
+  return text;
+}
+
+template <typename Function>
+EncodingBenchmark::Result Measure(const char* name, uint32_t bytes,
+                                  const Function& function) {
+  EncodingBenchmark::Result result;
+  result.function = name;
+  result.bytes = bytes;
+  result.iterations = kBytesPerMeasurement / bytes;
+  // A sum of output sizes, so the calls are not optimized out.
+  size_t output_bytes = 0;
+  auto start = steady_clock::now();
+  for (uint32_t i = 0; i < result.iterations; ++i)
+    output_bytes += function();
+  double seconds = duration<double>(steady_clock::now() - start).count();
+  double total_bytes = static_cast<double>(result.iterations) * bytes;
+  result.ns_per_byte = seconds * 1e9 / total_bytes;
+  result.mb_per_second = seconds > 0. ? total_bytes / seconds / 1e6 : 0.;
+  if (output_bytes == 0) LOG_ERROR("%s returned no data", name);
+  return result;
+}
+
+}  // anonymous namespace
+
+EncodingBenchmark::EncodingBenchmark(const pp::InstanceHandle& instance)
+    : cc_factory_(this),
+      running_(false),
+      cancelled_(false),
+      thread_(instance) {
+  thread_.Start();
+}
+
+EncodingBenchmark::~EncodingBenchmark() {
+  cancelled_ = true;
+  thread_.Join();
+}
+
+bool EncodingBenchmark::Start(const ResultCallback& callback) {
+  if (running_.exchange(true)) {
+    LOG_ERROR("An encoding benchmark is running already");
+    return false;
+  }
+  callback_ = callback;
+  thread_.message_loop().PostWork(cc_factory_.NewCallback(
+      &EncodingBenchmark::RunOnBenchmarkThread));
+  return true;
+}
+
+void EncodingBenchmark::RunOnBenchmarkThread(int32_t) {
+  std::mt19937 random(1234);
+  for (uint32_t size : kSizes) {
+    std::vector<uint8_t> data(size);
+    for (auto& byte : data) byte = static_cast<uint8_t>(random());
+    std::string text = Base64Encode(data);
+    if (Base64Decode(text) != data)
+      LOG_ERROR("Base64Decode() of %u bytes returned wrong data", size);
+
+    Result results[] = {
+      Measure("base64Decode", size, [&text] {
+        return Base64Decode(text).size();
+      }),
+      Measure("toHexString", size, [&data] {
+        return ToHexString(data.size(), data.data()).size();
+      }),
+    };
+    for (const auto& result : results) {
+      if (cancelled_) break;
+      LOG_INFO("%s of %u bytes: %.2f ns/byte, %.1f MB/s",
+               result.function.c_str(), result.bytes, result.ns_per_byte,
+               result.mb_per_second);
+      if (callback_) callback_(result);
+    }
+    if (cancelled_) break;
+  }
+  callback_ = nullptr;
+  running_ = false;
+}
@@ -0,0 +1,68 @@
+/*!
+ * encoding_benchmark.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_ENCODING_BENCHMARK_H_
+#define NATIVE_PLAYER_SRC_ENCODING_BENCHMARK_H_
+
+#include <atomic>
+#include <functional>
+#include <string>
+
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/simple_thread.h"
+
+// Measures Base64Decode() and ToHexString() from common.h on random data of
+// a few sizes, from a key ID up to a PSSH box of multi-key content.
+class EncodingBenchmark {
+ public:
+  struct Result {
+    // "base64Decode" or "toHexString".
+    std::string function;
+    // Size of the decoded or encoded data.
+    uint32_t bytes;
+    uint32_t iterations;
+    double ns_per_byte;
+    double mb_per_second;
+  };
+
+  // Called once per function and size, on the benchmark thread.
+  typedef std::function<void(const Result&)> ResultCallback;
+
+  explicit EncodingBenchmark(const pp::InstanceHandle& instance);
+  ~EncodingBenchmark();
+
+  // Starts a benchmark, unless one is running already.
+  bool Start(const ResultCallback& callback);
+
+  bool IsRunning() const { return running_; }
+
+ private:
+  void RunOnBenchmarkThread(int32_t);
+
+  pp::CompletionCallbackFactory<EncodingBenchmark> cc_factory_;
+  std::atomic<bool> running_;
+  std::atomic<bool> cancelled_;
+  ResultCallback callback_;
+
+  // Declared last, so it's joined before other members are destroyed.
+  pp::SimpleThread thread_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_ENCODING_BENCHMARK_H_
@@ -23,29 +23,44 @@
 
 #include "logger.h"
 
+#include <algorithm>
 #include <array>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <string>
 #include <libgen.h>
 
+#include <atomic>
 #include <chrono>
+#include <thread>
 
 #include "ppapi/cpp/instance.h"
 #include "ppapi/cpp/var.h"
 
-pp::Instance* Logger::instance_ = NULL;
+#include "main_thread_budget.h"
+
 LogLevel Logger::js_log_level_ = LogLevel::kNone;
 #ifdef DEBUG_LOGS
 LogLevel Logger::std_log_level_ = LogLevel::kInfo;
 #else
 LogLevel Logger::std_log_level_ = LogLevel::kNone;
 #endif
+LogLevel Logger::category_log_levels_[static_cast<int>(LogCategory::kCount)] =
+    {LogLevel::kMaxLevel, LogLevel::kMaxLevel, LogLevel::kMaxLevel,
+     LogLevel::kMaxLevel, LogLevel::kMaxLevel, LogLevel::kMaxLevel,
+     LogLevel::kMaxLevel};
 
 namespace {
 
 const unsigned kMaxMessageSize = 256;
 
+// Must be a power of 2.
+const size_t kQueueSize = 1024;
+
+// How often the logging thread checks for new records when it's idle.
+const std::chrono::milliseconds kDrainInterval(10);
+
 double GetTimestamp() {
   using std::chrono::steady_clock;
   using std::chrono::duration_cast;
@@ -64,6 +79,18 @@ const std::array<std::string, 4> kLogPrefixes = {{
   "DEBUG: ",  // LogLevel::kDebug
 }};
 
+// Indexed by LogCategory values.
+const std::array<std::string, static_cast<int>(LogCategory::kCount)>
+    kLogCategoryNames = {{
+  "general",
+  "dash",
+  "demuxer",
+  "packets",
+  "drm",
+  "net",
+  "communicator",
+}};
+
 const std::array<std::string, 4> kLogLevelColors = {{
   "",          // LogLevel::kNone
   "\033[31m",  // LogLevel::kError
@@ -73,9 +100,156 @@ const std::array<std::string, 4> kLogLevelColors = {{
 
 }  // anonymous namespace
 
+// A bounded multi-producer queue (based on Dmitry Vyukov's design) with a
+// single consumer - the logging thread. Producers claim a slot with a single
+// CAS and never wait: when the queue is full the message is dropped and
+// counted instead.
+class Logger::LogQueue {
+ public:
+  struct Record;
+
+  LogQueue();
+  ~LogQueue();
+
+  // Returns a free record or nullptr when the queue is full. The record must
+  // be passed to Push() once filled.
+  Record* Claim();
+  void Push(Record* record);
+
+ private:
+  void DrainLoop();
+  // Prints all queued records, returns false if there were none.
+  bool Drain();
+
+  std::array<Record, kQueueSize>* records_;
+  std::atomic<size_t> enqueue_pos_;
+  // Used on the logging thread only.
+  size_t dequeue_pos_;
+  std::atomic<uint32_t> dropped_;
+  std::atomic<bool> exited_;
+  std::thread thread_;
+};
+
+struct Logger::LogQueue::Record {
+  // Position in the queue this record is ready for, see Claim() and Drain().
+  std::atomic<size_t> sequence;
+  size_t position;
+  LogLevel level;
+  int line;
+  const char* func;
+  const char* file;
+  double timestamp;
+  char message[kMaxMessageSize];
+};
+
+Logger::LogQueue::LogQueue()
+    : records_(new std::array<Record, kQueueSize>()),
+      enqueue_pos_(0),
+      dequeue_pos_(0),
+      dropped_(0),
+      exited_(false) {
+  for (size_t i = 0; i < kQueueSize; ++i)
+    (*records_)[i].sequence.store(i, std::memory_order_relaxed);
+  thread_ = std::thread(&LogQueue::DrainLoop, this);
+}
+
+Logger::LogQueue::~LogQueue() {
+  exited_ = true;
+  thread_.join();
+  delete records_;
+}
+
+Logger::LogQueue::Record* Logger::LogQueue::Claim() {
+  size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  for (;;) {
+    Record* record = &(*records_)[pos & (kQueueSize - 1)];
+    size_t sequence = record->sequence.load(std::memory_order_acquire);
+    intptr_t diff =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        record->position = pos;
+        return record;
+      }
+    } else if (diff < 0) {
+      ++dropped_;
+      return nullptr;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void Logger::LogQueue::Push(Record* record) {
+  record->sequence.store(record->position + 1, std::memory_order_release);
+}
+
+void Logger::LogQueue::DrainLoop() {
+  while (!exited_) {
+    if (!Drain())
+      std::this_thread::sleep_for(kDrainInterval);
+  }
+  Drain();
+}
+
+bool Logger::LogQueue::Drain() {
+  bool drained = false;
+  char prefix[kMaxMessageSize];
+  for (;;) {
+    Record* record = &(*records_)[dequeue_pos_ & (kQueueSize - 1)];
+    if (record->sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1)
+      break;
+    drained = true;
+    prefix[0] = '\0';
+    if (record->file) {
+      const char* file_basename = basename(const_cast<char*>(record->file));
+      snprintf(prefix, kMaxMessageSize, "%11.6f [%s/%s:%d] ",
+               record->timestamp, file_basename, record->func, record->line);
+    } else {
+      snprintf(prefix, kMaxMessageSize, "%11.6f ", record->timestamp);
+    }
+    Logger::Print(record->level, prefix, record->message);
+    record->sequence.store(dequeue_pos_ + kQueueSize,
+                           std::memory_order_release);
+    ++dequeue_pos_;
+  }
+  uint32_t dropped = dropped_.exchange(0);
+  if (dropped > 0) {
+    char message[kMaxMessageSize];
+    snprintf(message, kMaxMessageSize,
+             "%u log messages dropped, logging queue was full", dropped);
+    Logger::Print(LogLevel::kError, nullptr, message);
+  }
+  return drained;
+}
+
+Logger::LogQueue* Logger::GetQueue() {
+  static LogQueue queue;
+  return &queue;
+}
+
+std::vector<pp::Instance*>* Logger::GetInstances() {
+  static std::vector<pp::Instance*> instances;
+  return &instances;
+}
+
+pp::Lock* Logger::GetInstancesLock() {
+  static pp::Lock lock;
+  return &lock;
+}
+
 void Logger::InitializeInstance(pp::Instance* instance) {
-  if (!instance_)
-    instance_ = instance;
+  pp::AutoLock lock(*GetInstancesLock());
+  GetInstances()->push_back(instance);
+}
+
+void Logger::ReleaseInstance(pp::Instance* instance) {
+  pp::AutoLock lock(*GetInstancesLock());
+  auto instances = GetInstances();
+  instances->erase(
+      std::remove(instances->begin(), instances->end(), instance),
+      instances->end());
 }
 
 void Logger::Info(const std::string& message) {
@@ -85,7 +259,8 @@ void Logger::Info(const std::string& message) {
 void Logger::Info(const char* message_format, ...) {
   va_list arguments_list;
   va_start(arguments_list, message_format);
-  InternalPrint(LogLevel::kInfo, nullptr, message_format, arguments_list);
+  InternalPrint(0, nullptr, nullptr, LogLevel::kInfo, message_format,
+                arguments_list);
   va_end(arguments_list);
 }
 
@@ -105,7 +280,8 @@ void Logger::Error(const std::string& message) {
 void Logger::Error(const char* message_format, ...) {
   va_list arguments_list;
   va_start(arguments_list, message_format);
-  InternalPrint(LogLevel::kError, nullptr, message_format, arguments_list);
+  InternalPrint(0, nullptr, nullptr, LogLevel::kError, message_format,
+                arguments_list);
   va_end(arguments_list);
 }
 
@@ -125,7 +301,8 @@ void Logger::Debug(const std::string& message) {
 void Logger::Debug(const char* message_format, ...) {
   va_list arguments_list;
   va_start(arguments_list, message_format);
-  InternalPrint(LogLevel::kDebug, nullptr, message_format, arguments_list);
+  InternalPrint(0, nullptr, nullptr, LogLevel::kDebug, message_format,
+                arguments_list);
   va_end(arguments_list);
 }
 
@@ -146,38 +323,89 @@ void Logger::SetStdLogLevel(LogLevel level) {
   std_log_level_ = level;
 }
 
-void Logger::InternalPrint(LogLevel level, const char* std_prefix,
-                           const char* message) {
-  if (instance_ && level <= js_log_level_)
-    instance_->PostMessage(
-        kLogPrefixes[static_cast<int>(level)] + message + "\n");
+bool Logger::ShouldLogEveryMs(std::atomic<int64_t>* last_log_ms,
+                              int64_t interval_ms) {
+  int64_t now_ms = static_cast<int64_t>(GetTimestamp() * 1000);
+  int64_t last = last_log_ms->load(std::memory_order_relaxed);
+  if (last >= 0 && now_ms - last < interval_ms) return false;
+  return last_log_ms->compare_exchange_strong(last, now_ms);
+}
+
+void Logger::SetCategoryLogLevel(LogCategory category, LogLevel level) {
+  category_log_levels_[static_cast<int>(category)] = level;
+}
+
+bool Logger::GetCategoryByName(const std::string& name,
+                               LogCategory* category) {
+  for (size_t i = 0; i < kLogCategoryNames.size(); ++i) {
+    if (kLogCategoryNames[i] == name) {
+      *category = static_cast<LogCategory>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+void Logger::Print(LogLevel level, const char* std_prefix,
+                   const char* message) {
+  if (level <= js_log_level_) {
+    // An instance isn't destroyed while a log is posted to it.
+    pp::AutoLock lock(*GetInstancesLock());
+    pp::Instance* instance =
+        GetInstances()->empty() ? nullptr : GetInstances()->front();
+    // Errors are always forwarded, other logs wait for JS to catch up.
+    if (!instance) {
+      // There is no JS to forward logs to yet, or any more.
+    } else if (level != LogLevel::kError &&
+               MainThreadBudget::IsOverBudget()) {
+      MainThreadBudget::AddShedMessages(1);
+    } else {
+      ScopedMainThreadWork work(MainThreadWork::kForwardLogs, 1);
+      instance->PostMessage(
+          kLogPrefixes[static_cast<int>(level)] + message + "\n");
+    }
+  }
   if (level > std_log_level_)
     return;
-  printf("%s %11.6f %s%s%s\033[0m\n",
+  printf("%s %s%s%s\033[0m\n",
          kLogLevelColors[static_cast<int>(level)].c_str(),
-         GetTimestamp(),
          std_prefix ? std_prefix : "",
          kLogPrefixes[static_cast<int>(level)].c_str(),
          message);
   fflush(stdout);
 }
 
-void Logger::InternalPrint(LogLevel level, const char* std_prefix,
-                           const char* message_format, va_list arguments_list) {
-  if (!IsLoggingEnabled())
+void Logger::InternalPrint(int line, const char* func, const char* file,
+                           LogLevel level, const char* message_format,
+                           va_list arguments_list) {
+  // A category is checked by LOG_* macros, before calling the logger.
+  if (!IsOutputEnabled(level))
+    return;
+  LogQueue* queue = GetQueue();
+  LogQueue::Record* record = queue->Claim();
+  if (!record)
     return;
-  char buff[kMaxMessageSize];
-  vsnprintf(buff, kMaxMessageSize, message_format, arguments_list);
-  InternalPrint(level, std_prefix, buff);
+  record->level = level;
+  record->line = line;
+  record->func = func;
+  record->file = file;
+  record->timestamp = GetTimestamp();
+  vsnprintf(record->message, kMaxMessageSize, message_format, arguments_list);
+  queue->Push(record);
 }
 
-void Logger::InternalPrint(int line, const char* func, const char* file,
-                          LogLevel level, const char* message_format,
-                          va_list arguments_list) {
-  if (!IsLoggingEnabled())
+void Logger::InternalPrint(LogLevel level, const std::string& message) {
+  if (!IsOutputEnabled(level))
+    return;
+  LogQueue* queue = GetQueue();
+  LogQueue::Record* record = queue->Claim();
+  if (!record)
     return;
-  char buff[kMaxMessageSize];
-  const char* file_basename = basename(const_cast<char*>(file));
-  snprintf(buff, kMaxMessageSize, "[%s/%s:%d] ", file_basename, func, line);
-  InternalPrint(level, buff, message_format, arguments_list);
+  record->level = level;
+  record->line = 0;
+  record->func = nullptr;
+  record->file = nullptr;
+  record->timestamp = GetTimestamp();
+  snprintf(record->message, kMaxMessageSize, "%s", message.c_str());
+  queue->Push(record);
 }
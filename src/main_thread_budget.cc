@@ -0,0 +1,105 @@
+/*!
+ * main_thread_budget.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ *
+ * @brief
+ * Accounting of work done on the main thread against a budget per frame.
+ */
+
+#include "main_thread_budget.h"
+
+#include <algorithm>
+
+#include "ppapi/utility/threading/lock.h"
+
+using pp::AutoLock;
+
+constexpr double MainThreadBudget::kFrameDuration;
+constexpr double MainThreadBudget::kDefaultBudget;
+
+namespace {
+
+pp::Lock budget_lock;
+double budget = MainThreadBudget::kDefaultBudget;
+MainThreadBudget::Report report{};
+// The frame which frame_time is summed for.
+int64_t current_frame = -1;
+double frame_time = 0.;
+
+// Returns an index of the current frame. Frames are counted from an
+// arbitrary point, only changes of the index matter.
+int64_t CurrentFrame() {
+  return static_cast<int64_t>(std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count() /
+      MainThreadBudget::kFrameDuration);
+}
+
+// Starts summing a new frame if it has changed, budget_lock must be held.
+void UpdateFrame() {
+  int64_t frame = CurrentFrame();
+  if (frame == current_frame) return;
+  current_frame = frame;
+  frame_time = 0.;
+}
+
+}  // anonymous namespace
+
+void MainThreadBudget::SetBudget(double seconds) {
+  AutoLock lock(budget_lock);
+  budget = std::max(seconds, 0.);
+}
+
+void MainThreadBudget::AddWork(MainThreadWork work, double seconds,
+                               uint32_t messages) {
+  auto index = static_cast<size_t>(work);
+  AutoLock lock(budget_lock);
+  report.time[index] += seconds;
+  report.messages[index] += messages;
+  UpdateFrame();
+  bool was_over_budget = budget > 0. && frame_time >= budget;
+  frame_time += seconds;
+  if (!was_over_budget && budget > 0. && frame_time >= budget)
+    ++report.frames_over_budget;
+}
+
+bool MainThreadBudget::IsOverBudget() {
+  AutoLock lock(budget_lock);
+  UpdateFrame();
+  return budget > 0. && frame_time >= budget;
+}
+
+void MainThreadBudget::AddShedMessages(uint32_t messages) {
+  AutoLock lock(budget_lock);
+  report.shed_messages += messages;
+}
+
+MainThreadBudget::Report MainThreadBudget::GetReport() {
+  AutoLock lock(budget_lock);
+  return report;
+}
+
+MainThreadBudget::Report MainThreadBudget::GetReportSince(
+    const Report& base) {
+  Report since = GetReport();
+  for (size_t i = 0; i < since.time.size(); ++i) {
+    since.time[i] -= base.time[i];
+    since.messages[i] -= base.messages[i];
+  }
+  since.frames_over_budget -= base.frames_over_budget;
+  since.shed_messages -= base.shed_messages;
+  return since;
+}
@@ -0,0 +1,153 @@
+/*!
+ * memory_governor.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#include "memory_governor.h"
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <utility>
+
+#include "ppapi/utility/threading/lock.h"
+
+using pp::AutoLock;
+
+constexpr size_t MemoryGovernor::kDefaultBudget;
+constexpr double MemoryGovernor::kModerateUsage;
+
+namespace {
+
+std::atomic<size_t> budget{MemoryGovernor::kDefaultBudget};
+std::atomic<int32_t> platform_pressure{
+    static_cast<int32_t>(MemoryPressure::kNone)};
+std::array<std::atomic<int64_t>, static_cast<size_t>(MemoryConsumer::kCount)>
+    usage;
+
+// Guards listeners, which are called with it locked.
+pp::Lock listeners_lock;
+std::map<int32_t, std::function<void(MemoryPressure)>> listeners;
+int32_t next_listener_id = 0;
+
+}  // anonymous namespace
+
+void MemoryGovernor::SetBudget(size_t bytes) {
+  budget = bytes;
+  NotifyListeners();
+}
+
+size_t MemoryGovernor::GetBudget() {
+  return budget;
+}
+
+void MemoryGovernor::SetPlatformPressure(MemoryPressure pressure) {
+  platform_pressure = static_cast<int32_t>(pressure);
+  NotifyListeners();
+}
+
+MemoryPressure MemoryGovernor::GetPressure() {
+  size_t total = GetTotalUsage();
+  auto pressure = MemoryPressure::kNone;
+  if (total >= budget)
+    pressure = MemoryPressure::kCritical;
+  else if (total >= budget * kModerateUsage)
+    pressure = MemoryPressure::kModerate;
+  return std::max(pressure,
+                  static_cast<MemoryPressure>(platform_pressure.load()));
+}
+
+bool MemoryGovernor::GetPressureByName(const std::string& name,
+                                       MemoryPressure* pressure) {
+  static const std::map<std::string, MemoryPressure> kPressures = {
+    {"none", MemoryPressure::kNone},
+    {"moderate", MemoryPressure::kModerate},
+    {"critical", MemoryPressure::kCritical},
+  };
+  auto it = kPressures.find(name);
+  if (it == kPressures.end()) return false;
+  *pressure = it->second;
+  return true;
+}
+
+size_t MemoryGovernor::GetUsage(MemoryConsumer consumer) {
+  return std::max<int64_t>(usage[static_cast<size_t>(consumer)], 0);
+}
+
+size_t MemoryGovernor::GetTotalUsage() {
+  int64_t total = 0;
+  for (const auto& bytes : usage) total += bytes;
+  return std::max<int64_t>(total, 0);
+}
+
+size_t MemoryGovernor::ScaleLimit(size_t limit) {
+  switch (GetPressure()) {
+    case MemoryPressure::kModerate:
+      return limit / 2;
+    case MemoryPressure::kCritical:
+      return limit / 4;
+    default:
+      return limit;
+  }
+}
+
+int32_t MemoryGovernor::AddPressureListener(
+    std::function<void(MemoryPressure)> listener) {
+  AutoLock lock(listeners_lock);
+  int32_t id = next_listener_id++;
+  listeners[id] = std::move(listener);
+  return id;
+}
+
+void MemoryGovernor::RemovePressureListener(int32_t id) {
+  AutoLock lock(listeners_lock);
+  listeners.erase(id);
+}
+
+void MemoryGovernor::AddUsage(MemoryConsumer consumer, int64_t bytes) {
+  usage[static_cast<size_t>(consumer)] += bytes;
+}
+
+void MemoryGovernor::NotifyListeners() {
+  auto pressure = GetPressure();
+  AutoLock lock(listeners_lock);
+  for (const auto& listener : listeners) listener.second(pressure);
+}
+
+MemoryUsage::MemoryUsage(MemoryConsumer consumer)
+    : consumer_(consumer),
+      bytes_(0) {}
+
+MemoryUsage::~MemoryUsage() {
+  MemoryGovernor::AddUsage(consumer_, -static_cast<int64_t>(bytes_.load()));
+}
+
+void MemoryUsage::Set(size_t bytes) {
+  size_t previous = bytes_.exchange(bytes);
+  MemoryGovernor::AddUsage(consumer_, static_cast<int64_t>(bytes) -
+                                      static_cast<int64_t>(previous));
+}
+
+void MemoryUsage::Add(size_t bytes) {
+  bytes_ += bytes;
+  MemoryGovernor::AddUsage(consumer_, bytes);
+}
+
+void MemoryUsage::Remove(size_t bytes) {
+  bytes_ -= bytes;
+  MemoryGovernor::AddUsage(consumer_, -static_cast<int64_t>(bytes));
+}
@@ -30,6 +30,7 @@
 #endif
 
 #include "communicator/messages.h"
+#include "common.h"
 #include "logger.h"
 
 using Samsung::NaClPlayer::Rect;
@@ -37,7 +38,11 @@ using Samsung::NaClPlayer::Rect;
 const char* kLogCmd = "logs";
 const char* kLogDebug = "debug";
 
-NativePlayer::~NativePlayer() { UnregisterMessageHandler(); }
+NativePlayer::~NativePlayer() {
+  UnregisterMessageHandler();
+  Logger::ReleaseInstance(this);
+  UnregisterModuleInstance(pp_instance());
+}
 
 void NativePlayer::DidChangeView(const pp::View& view) {
   const pp::Rect pp_r{view.GetRect().size()};
@@ -64,6 +69,7 @@ void NativePlayer::HandleMessage(const pp::Var& message) {
 }
 
 bool NativePlayer::Init(uint32_t argc, const char** argn, const char** argv) {
+  RegisterModuleInstance(pp_instance());
   Logger::InitializeInstance(this);
   LOG_INFO("Start Init");
   for (uint32_t i = 0; i < argc; i++) {
@@ -81,10 +87,10 @@ bool NativePlayer::Init(uint32_t argc, const char** argn, const char** argv) {
       std::make_shared<Communication::MessageSender>(this);
 
   std::shared_ptr<PlayerProvider> player_provider =
-      std::make_shared<PlayerProvider>(this, std::move(ui_message_sender));
+      std::make_shared<PlayerProvider>(this, ui_message_sender);
 
-  message_receiver_ =
-      std::make_shared<Communication::MessageReceiver>(player_provider);
+  message_receiver_ = std::make_shared<Communication::MessageReceiver>(
+      this, player_provider, ui_message_sender);
 
   InitNaClIO();
   player_thread_.Start();
@@ -97,6 +103,11 @@ bool NativePlayer::Init(uint32_t argc, const char** argn, const char** argv) {
 }
 
 void NativePlayer::InitNaClIO() {
+  // nacl_io is a module wide file system, instances created after the first
+  // one use it as it is.
+  static bool initialized = false;
+  if (initialized) return;
+  initialized = true;
   nacl_io_init_ppapi(pp_instance(), pp::Module::Get()->get_browser_interface());
 }
 
@@ -0,0 +1,346 @@
+/*!
+ * abr_engine.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include "abr_engine.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "dash/media_stream.h"
+
+#include "bandwidth_estimator.h"
+
+namespace {
+
+// Part of the measured bandwidth the throughput rule uses, the rest is
+// a margin for its variation.
+constexpr double kBandwidthSafetyFactor = 0.9;
+// The first segment of a stream should download within that time. Segment
+// durations are not known before sequences are created, so a typical one is
+// assumed.
+constexpr double kTargetStartupTime = 2.;  // seconds
+constexpr double kAssumedSegmentDuration = 4.;  // seconds
+
+// Parameters of BOLA, as in the reference implementation of dash.js.
+constexpr double kBolaMinimumBuffer = 10.;  // seconds
+constexpr double kBolaMinimumBufferPerLevel = 2.;  // seconds
+constexpr double kBolaStableBuffer = 12.;  // seconds
+
+// The hybrid rule switches to BOLA above the first buffer level and back to
+// the throughput rule below the second one. StreamManager buffers about 7
+// seconds ahead, so levels are a bit lower than in dash.js.
+constexpr double kHybridBolaBuffer = 6.;  // seconds
+constexpr double kHybridThroughputBuffer = 3.;  // seconds
+
+// Switches to a higher bitrate are made at most that often and only when
+// that much is buffered, switches to a lower one are made right away.
+constexpr std::chrono::seconds kMinUpSwitchInterval(5);
+constexpr double kMinUpSwitchBuffer = 4.;  // seconds
+// Buffered segments are downloaded again in a new representation only if
+// bandwidth exceeds its bitrate that many times, so the first of them is
+// downloaded long before it's played.
+constexpr double kReplaceBufferHeadroom = 2.;
+// Part of the bandwidth audio can use until video reaches its highest
+// representation. Higher audio bitrates add less to the perceived quality
+// than the same bitrate added to video.
+constexpr double kAudioBandwidthShare = 0.1;
+
+size_t ChooseByThroughput(const std::vector<AbrCandidate>& candidates,
+                          double bandwidth) {
+  size_t chosen = 0;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (candidates[i].bitrate <= bandwidth * kBandwidthSafetyFactor)
+      chosen = i;
+  }
+  return chosen;
+}
+
+class ThroughputRule : public AbrRule {
+ public:
+  size_t Choose(const std::vector<AbrCandidate>& candidates,
+                const AbrState& state) override {
+    return ChooseByThroughput(candidates, state.bandwidth);
+  }
+};
+
+class BolaRule : public AbrRule {
+ public:
+  size_t Choose(const std::vector<AbrCandidate>& candidates,
+                const AbrState& state) override {
+    if (candidates.size() < 2) return 0;
+
+    // Utilities are logarithms of bitrates, shifted so the lowest one is 1.
+    double lowest = std::log(std::max(candidates.front().bitrate, 1u));
+    double highest_utility =
+        std::log(std::max(candidates.back().bitrate, 1u)) - lowest + 1.;
+    double buffer_target = std::max(kBolaStableBuffer,
+        kBolaMinimumBuffer + kBolaMinimumBufferPerLevel * candidates.size());
+    double gp = (highest_utility - 1.) /
+                (buffer_target / kBolaMinimumBuffer - 1.);
+    if (gp <= 0.) return 0;
+    double vp = kBolaMinimumBuffer / gp;
+
+    size_t chosen = 0;
+    double best_score = 0.;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      double bitrate = std::max(candidates[i].bitrate, 1u);
+      double utility = std::log(bitrate) - lowest + 1.;
+      double score = (vp * (utility + gp) - state.buffer_level) / bitrate;
+      if (i == 0 || score >= best_score) {
+        chosen = i;
+        best_score = score;
+      }
+    }
+    return chosen;
+  }
+};
+
+class HybridRule : public AbrRule {
+ public:
+  HybridRule() : use_bola_(false) {}
+
+  size_t Choose(const std::vector<AbrCandidate>& candidates,
+                const AbrState& state) override {
+    if (use_bola_ && state.buffer_level < kHybridThroughputBuffer)
+      use_bola_ = false;
+    else if (!use_bola_ && state.buffer_level >= kHybridBolaBuffer)
+      use_bola_ = true;
+
+    if (!use_bola_) return throughput_.Choose(candidates, state);
+
+    // BOLA doesn't know the bandwidth, so it's not allowed to go above what
+    // the network sustains unless the buffer is already well filled.
+    size_t bola = bola_.Choose(candidates, state);
+    size_t throughput = throughput_.Choose(candidates, state);
+    if (bola > throughput && state.buffer_level < kBolaStableBuffer)
+      return std::min(bola, std::max(throughput, state.current));
+    return bola;
+  }
+
+ private:
+  ThroughputRule throughput_;
+  BolaRule bola_;
+  bool use_bola_;
+};
+
+}  // namespace
+
+AbrCandidate MakeAbrCandidate(const VideoStream& representation) {
+  return AbrCandidate{static_cast<int32_t>(representation.description.id),
+                      representation.description.bitrate,
+                      representation.width, representation.height};
+}
+
+AbrCandidate MakeAbrCandidate(const AudioStream& representation) {
+  return AbrCandidate{static_cast<int32_t>(representation.description.id),
+                      representation.description.bitrate, 0, 0};
+}
+
+std::unique_ptr<AbrRule> AbrRule::Create(Type type) {
+  switch (type) {
+    case Type::kThroughput:
+      return MakeUnique<ThroughputRule>();
+    case Type::kBola:
+      return MakeUnique<BolaRule>();
+    case Type::kHybrid:
+      return MakeUnique<HybridRule>();
+  }
+  return {};
+}
+
+AbrEngine::AbrEngine(std::shared_ptr<BandwidthEstimator> bandwidth_estimator,
+                     std::unique_ptr<AbrRule> rule)
+    : bandwidth_estimator_(std::move(bandwidth_estimator)),
+      rule_(std::move(rule)),
+      time_source_(&Clock::now),
+      saved_bandwidth_(0.),
+      playback_rate_(1.),
+      streams_() {
+  for (auto& stream : streams_) {
+    stream.current = 0;
+    stream.manual = false;
+    stream.view_width = 0;
+    stream.view_height = 0;
+    stream.max_bitrate = 0;
+  }
+}
+
+AbrEngine::~AbrEngine() {}
+
+void AbrEngine::SetRule(std::unique_ptr<AbrRule> rule) {
+  rule_ = std::move(rule);
+}
+
+void AbrEngine::SetTimeSource(TimeSource time_source) {
+  time_source_ = time_source ? std::move(time_source) : &Clock::now;
+}
+
+void AbrEngine::SetSavedBandwidth(double bandwidth) {
+  saved_bandwidth_ = bandwidth;
+}
+
+void AbrEngine::SetPlaybackRate(double rate) {
+  playback_rate_ = rate;
+}
+
+void AbrEngine::SetCandidates(StreamType type,
+                              std::vector<AbrCandidate> candidates,
+                              int32_t current_id) {
+  Stream& stream = streams_[static_cast<size_t>(type)];
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const AbrCandidate& lhs, const AbrCandidate& rhs) {
+                     return lhs.bitrate < rhs.bitrate;
+                   });
+  stream.candidates = std::move(candidates);
+  stream.current = 0;
+  OnRepresentationChanged(type, current_id);
+}
+
+int32_t AbrEngine::ChooseInitial(StreamType type) const {
+  const Stream& stream = streams_[static_cast<size_t>(type)];
+  if (stream.candidates.empty()) return -1;
+
+  double bandwidth = AvailableBandwidth(type, true);
+  if (bandwidth <= 0.) return stream.candidates.front().id;
+
+  double startup_bandwidth =
+      bandwidth * kTargetStartupTime / kAssumedSegmentDuration;
+  size_t chosen = ChooseByThroughput(stream.candidates,
+                                     std::min(bandwidth, startup_bandwidth));
+  return stream.candidates[std::min(chosen, MaxCandidate(stream))].id;
+}
+
+void AbrEngine::SetViewSize(StreamType type, uint32_t width,
+                            uint32_t height) {
+  Stream& stream = streams_[static_cast<size_t>(type)];
+  stream.view_width = width;
+  stream.view_height = height;
+}
+
+void AbrEngine::SetMaxBitrate(StreamType type, uint32_t max_bitrate) {
+  streams_[static_cast<size_t>(type)].max_bitrate = max_bitrate;
+}
+
+void AbrEngine::SetManual(StreamType type, bool manual) {
+  streams_[static_cast<size_t>(type)].manual = manual;
+}
+
+bool AbrEngine::IsManual(StreamType type) const {
+  return streams_[static_cast<size_t>(type)].manual;
+}
+
+void AbrEngine::OnRepresentationChanged(StreamType type, int32_t id) {
+  Stream& stream = streams_[static_cast<size_t>(type)];
+  for (size_t i = 0; i < stream.candidates.size(); ++i) {
+    if (stream.candidates[i].id == id) stream.current = i;
+  }
+  stream.last_switch = time_source_();
+}
+
+int32_t AbrEngine::Update(StreamType type, double buffer_level,
+                          double upcoming_bitrate) {
+  Stream& stream = streams_[static_cast<size_t>(type)];
+  if (stream.manual || !rule_ || stream.candidates.size() < 2) return -1;
+
+  double bandwidth = AvailableBandwidth(type);
+  // Until the first measurement there's nothing to adapt to.
+  if (bandwidth <= 0.) return -1;
+  // Smaller upcoming segments are not trusted to stay small.
+  double nominal_bitrate = stream.candidates[stream.current].bitrate;
+  if (nominal_bitrate > 0. && upcoming_bitrate > nominal_bitrate)
+    bandwidth *= nominal_bitrate / upcoming_bitrate;
+
+  // Rules weigh the time the buffer lasts, rather than the media it holds.
+  buffer_level /= playback_rate_;
+  AbrState state{bandwidth, std::max(buffer_level, 0.), stream.current};
+  // Audio keeps to its part of the bandwidth, buffer based rules would
+  // choose the highest bitrate once the buffer is filled.
+  size_t chosen = type == StreamType::Audio
+      ? ChooseByThroughput(stream.candidates, bandwidth)
+      : rule_->Choose(stream.candidates, state);
+  chosen = std::min(chosen, MaxCandidate(stream));
+  if (chosen == stream.current) return -1;
+  if (chosen > stream.current &&
+      (buffer_level < kMinUpSwitchBuffer ||
+       time_source_() - stream.last_switch < kMinUpSwitchInterval))
+    return -1;
+
+  LOG_INFO("ABR switches stream %d from %u to %u bps (bandwidth: %.0f, "
+           "buffer: %.1f s)", static_cast<int32_t>(type),
+           stream.candidates[stream.current].bitrate,
+           stream.candidates[chosen].bitrate, bandwidth, buffer_level);
+  return stream.candidates[chosen].id;
+}
+
+bool AbrEngine::CanReplaceBuffer(StreamType type, int32_t id) const {
+  const Stream& stream = streams_[static_cast<size_t>(type)];
+  if (stream.candidates.empty()) return false;
+  auto candidate = std::find_if(stream.candidates.begin(),
+      stream.candidates.end(),
+      [id](const AbrCandidate& c) { return c.id == id; });
+  if (candidate == stream.candidates.end() ||
+      candidate->bitrate <= stream.candidates[stream.current].bitrate)
+    return false;
+  return AvailableBandwidth(type) >=
+      candidate->bitrate * kReplaceBufferHeadroom;
+}
+
+size_t AbrEngine::MaxCandidate(const Stream& stream) {
+  size_t last = stream.candidates.empty() ? 0 : stream.candidates.size() - 1;
+  while (stream.max_bitrate > 0 && last > 0 &&
+         stream.candidates[last].bitrate >= stream.max_bitrate)
+    --last;
+  if (stream.view_width == 0 || stream.view_height == 0) return last;
+
+  // Video scaled to the view keeps its aspect ratio, so it covers the view
+  // once either dimension does.
+  for (size_t i = 0; i < last; ++i) {
+    const AbrCandidate& candidate = stream.candidates[i];
+    if (candidate.width >= stream.view_width ||
+        candidate.height >= stream.view_height)
+      return i;
+  }
+  return last;
+}
+
+double AbrEngine::AvailableBandwidth(StreamType type,
+                                     bool allow_saved) const {
+  double bandwidth = 0.;
+  if (bandwidth_estimator_)
+    bandwidth = bandwidth_estimator_->EstimatedBandwidth();
+  if (bandwidth <= 0. && allow_saved) bandwidth = saved_bandwidth_;
+  if (bandwidth <= 0.) return 0.;
+  bandwidth /= playback_rate_;
+
+  // Video gets what is left after audio. Audio gets a small part of the
+  // bandwidth, or more if video at its highest bitrate leaves more.
+  const Stream& audio = streams_[static_cast<size_t>(StreamType::Audio)];
+  const Stream& video = streams_[static_cast<size_t>(StreamType::Video)];
+  if (type == StreamType::Video) {
+    if (!audio.candidates.empty())
+      bandwidth -= audio.candidates[audio.current].bitrate;
+  } else if (type == StreamType::Audio && !video.candidates.empty()) {
+    double left = video.current < MaxCandidate(video)
+        ? 0. : bandwidth - video.candidates[video.current].bitrate;
+    bandwidth = std::max(bandwidth * kAudioBandwidthShare, left);
+  }
+  return std::max(bandwidth, 1.);
+}
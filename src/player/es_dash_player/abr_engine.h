@@ -0,0 +1,178 @@
+/*!
+ * abr_engine.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_ABR_ENGINE_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_ABR_ENGINE_H_
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "common.h"
+
+class BandwidthEstimator;
+struct AudioStream;
+struct VideoStream;
+
+// A representation which can be chosen by adaptive bitrate logic.
+struct AbrCandidate {
+  int32_t id;
+  uint32_t bitrate;
+  // Video resolution, 0 if unknown.
+  uint32_t width;
+  uint32_t height;
+};
+
+AbrCandidate MakeAbrCandidate(const VideoStream& representation);
+AbrCandidate MakeAbrCandidate(const AudioStream& representation);
+
+// Inputs of a single representation choice.
+struct AbrState {
+  // Bandwidth in bits per second available to the stream, 0 if unknown.
+  double bandwidth;
+  // Seconds of media buffered ahead of the playback position.
+  double buffer_level;
+  // Index of the candidate which is in use.
+  size_t current;
+};
+
+// An algorithm choosing one of candidates sorted by ascending bitrate.
+class AbrRule {
+ public:
+  enum class Type {
+    // The highest bitrate below the measured throughput.
+    kThroughput,
+    // BOLA, which chooses by buffer level only (Spiteri et al., "BOLA:
+    // Near-Optimal Bitrate Adaptation for Online Videos").
+    kBola,
+    // Throughput rule when the buffer is low, BOLA once it's filled.
+    kHybrid
+  };
+
+  static std::unique_ptr<AbrRule> Create(Type type);
+
+  virtual ~AbrRule() {}
+
+  // Returns index of the candidate that should be used.
+  virtual size_t Choose(const std::vector<AbrCandidate>& candidates,
+                        const AbrState& state) = 0;
+};
+
+// Chooses video and audio representations automatically, based on the
+// bandwidth measured by BandwidthEstimator and buffer levels of streams.
+// Streams share the bandwidth, video gets most of it and audio is chosen
+// by throughput only, within its part of the bandwidth.
+// A stream which representation was chosen manually is not adapted until
+// automatic selection is enabled for it again. It must be used on a single
+// thread.
+class AbrEngine {
+ public:
+  typedef std::chrono::steady_clock Clock;
+  // Returns the current time.
+  typedef std::function<Clock::time_point()> TimeSource;
+
+  AbrEngine(std::shared_ptr<BandwidthEstimator> bandwidth_estimator,
+            std::unique_ptr<AbrRule> rule);
+  ~AbrEngine();
+
+  void SetRule(std::unique_ptr<AbrRule> rule);
+
+  // Replaces the steady clock intervals between switches are measured with,
+  // e.g. to run the engine in a simulated time.
+  void SetTimeSource(TimeSource time_source);
+
+  // Sets bandwidth in bits per second measured in a previous session, used
+  // to choose initial representations before anything is measured.
+  void SetSavedBandwidth(double bandwidth);
+
+  // Sets a speed of the playback. Media is consumed that many times faster,
+  // so each second of it gets a part of the bandwidth and lasts shorter in
+  // the buffer.
+  void SetPlaybackRate(double rate);
+
+  // Sets representations the stream can switch between and the one that is
+  // used.
+  void SetCandidates(StreamType type, std::vector<AbrCandidate> candidates,
+                     int32_t current_id);
+
+  // Returns id of the representation a stream should start with. It's the
+  // highest one which first segment can be downloaded within a target
+  // startup time, or the lowest one if bandwidth is not known at all.
+  int32_t ChooseInitial(StreamType type) const;
+
+  // Limits representations of the stream to the ones needed to fill a view
+  // of the given size, i.e. up to the lowest one which covers it. Zero size
+  // removes the limit.
+  void SetViewSize(StreamType type, uint32_t width, uint32_t height);
+
+  // Limits representations of the stream to ones below max_bitrate, e.g.
+  // because the device doesn't decode higher ones smoothly. The lowest one
+  // is always allowed. Zero removes the limit.
+  void SetMaxBitrate(StreamType type, uint32_t max_bitrate);
+
+  void SetManual(StreamType type, bool manual);
+  bool IsManual(StreamType type) const;
+
+  // Informs that the stream uses the given representation.
+  void OnRepresentationChanged(StreamType type, int32_t id);
+
+  // Returns id of a representation the stream should be switched to, or -1
+  // if it should stay with the current one. upcoming_bitrate is a bitrate
+  // of the next segments of the current representation, if their sizes are
+  // known. Segments bigger than their representation bitrate suggests are
+  // likely to be bigger in others too, so less bandwidth is assumed.
+  int32_t Update(StreamType type, double buffer_level,
+                 double upcoming_bitrate = 0.);
+
+  // Checks if the stream switching to the given representation should
+  // replace what it has buffered. It's an up-switch and the bandwidth is high
+  // enough to download buffered segments again while the playback goes on.
+  bool CanReplaceBuffer(StreamType type, int32_t id) const;
+
+ private:
+  struct Stream {
+    std::vector<AbrCandidate> candidates;
+    size_t current;
+    bool manual;
+    Clock::time_point last_switch;
+    uint32_t view_width;
+    uint32_t view_height;
+    uint32_t max_bitrate;
+  };
+
+  // Index of the highest candidate allowed by the view size and the bitrate
+  // limit of the stream.
+  static size_t MaxCandidate(const Stream& stream);
+
+  // Bandwidth the stream can use, other streams use the rest. The saved
+  // bandwidth is used if allow_saved is set and nothing is measured yet.
+  double AvailableBandwidth(StreamType type, bool allow_saved = false) const;
+
+  std::shared_ptr<BandwidthEstimator> bandwidth_estimator_;
+  std::unique_ptr<AbrRule> rule_;
+  TimeSource time_source_;
+  double saved_bandwidth_;
+  double playback_rate_;
+  std::array<Stream, static_cast<size_t>(StreamType::MaxStreamTypes)>
+      streams_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_ABR_ENGINE_H_
@@ -17,18 +17,24 @@
  * @author Tomasz Borkowski
  */
 
+#define LOG_CATEGORY LogCategory::kNet
+
 #include "async_data_provider.h"
 
+#include <algorithm>
 #include <cmath>
-#include <chrono>
 #include <string>
 
 #include "libdash/libdash.h"
 
 #include "common.h"
 #include "dash/media_segment_sequence.h"
+#include "dash/segment_disk_cache.h"
+#include "dash/util.h"
 
 #include "media_segment.h"
+#include "playback_metrics.h"
+#include "tracer.h"
 
 using pp::AutoLock;
 using pp::MessageLoop;
@@ -37,52 +43,267 @@ using std::vector;
 
 namespace {
 const uint32_t kDefaultSegmentSize = 32 * 1024;
+// Original request, up to one hedged request and a retry.
+constexpr size_t kMaxDownloadAttempts = 3;
+// A download attempt gets this many times its expected duration, based on
+// the measured throughput, before a hedged request is started...
+constexpr double kDownloadDeadlineMargin = 3.0;
+// ...but no less than this...
+constexpr double kMinDownloadDeadline = 2.0;
+// ...and no more than this many segment durations.
+constexpr double kMaxDownloadDeadlineSegments = 2.0;
+constexpr double kBitsPerByte = 8.;
+// Segments of sequences switched between must start at the same time, up to
+// rounding of timestamps.
+constexpr double kMaxSegmentMisalignment = 0.01;  // seconds
 }
 
+constexpr size_t AsyncDataProvider::kDefaultPrefetchDepth;
+constexpr size_t AsyncDataProvider::kDefaultSegmentCacheSize;
+
 AsyncDataProvider::AsyncDataProvider(
     const pp::InstanceHandle& instance,
-    std::function<void(std::unique_ptr<MediaSegment>)> callback)
-    : own_thread_(instance),
+    std::function<void(std::unique_ptr<MediaSegment>)> callback,
+    std::shared_ptr<NetworkExecutor> executor,
+    std::shared_ptr<BandwidthEstimator> bandwidth_estimator,
+    NetworkExecutor::Priority priority,
+    size_t prefetch_depth)
+    : executor_(executor),
+      bandwidth_estimator_(bandwidth_estimator),
+      priority_(priority),
+      prefetch_depth_(std::max<size_t>(prefetch_depth, 1)),
+      running_tasks_(0),
       next_segment_iterator_(),
       iterator_lock_(),
       cc_factory_(this),
       last_segment_size_(kDefaultSegmentSize),
-      data_segment_callback_(callback) {
-  own_thread_.Start();
+      data_segment_callback_(callback),
+      chunked_delivery_(false),
+      tuning_(TuningProfile::Current()),
+      caller_executor_(),
+      playback_metrics_(nullptr),
+      segment_cache_(kDefaultSegmentCacheSize),
+      pending_usage_(MemoryConsumer::kSegments),
+      next_request_number_(0),
+      next_delivery_number_(0),
+      generation_(0),
+      cancellation_token_(std::make_shared<CancellationToken>()),
+      end_of_stream_requested_(false),
+      requested_end_time_(0.),
+      parsed_init_key_(),
+      requested_init_key_(),
+      prefetch_key_(),
+      prefetch_token_(std::make_shared<CancellationToken>()) {
+  if (!executor_)
+    executor_ = std::make_shared<NetworkExecutor>(instance, prefetch_depth_);
+  if (!bandwidth_estimator_)
+    bandwidth_estimator_ = std::make_shared<BandwidthEstimator>();
+}
+
+AsyncDataProvider::~AsyncDataProvider() {
+  {
+    AutoLock lock(iterator_lock_);
+    // Makes downloads stop as soon as possible.
+    ++generation_;
+    cancellation_token_->Cancel();
+    prefetch_token_->Cancel();
+  }
+  cc_factory_.CancelAll();
+  std::unique_lock<std::mutex> guard(tasks_mutex_);
+  tasks_condition_.wait(guard, [this]() { return running_tasks_ == 0; });
+}
+
+void AsyncDataProvider::BeginTask() {
+  std::lock_guard<std::mutex> guard(tasks_mutex_);
+  ++running_tasks_;
+}
+
+void AsyncDataProvider::EndTask() {
+  std::lock_guard<std::mutex> guard(tasks_mutex_);
+  --running_tasks_;
+  tasks_condition_.notify_all();
+}
+
+bool AsyncDataProvider::IsSequenceEnd() const {
+  AutoLock lock(iterator_lock_);
+  return sequence_ && !sequence_->IsDynamic() &&
+         next_segment_iterator_ == sequence_->End();
 }
 
 bool AsyncDataProvider::RequestNextDataSegment() {
   LOG_DEBUG("Requesting next data segment");
-  AutoLock lock(iterator_lock_);
-  if (next_segment_iterator_ == sequence_->End()) {
-    LOG_DEBUG("Pass an empty MediaSegment as an end of stream signal.");
-    data_segment_callback_(MakeUnique<MediaSegment>());
+  {
+    AutoLock lock(iterator_lock_);
+    if (next_segment_iterator_ == sequence_->End()) {
+      // Next segment of a live stream is not available yet.
+      if (sequence_->IsDynamic()) return true;
+      if (end_of_stream_requested_) return false;
+      LOG_DEBUG("Pass an empty MediaSegment as an end of stream signal.");
+      // End of stream is passed after all segments requested before.
+      end_of_stream_requested_ = true;
+      downloaded_segments_[next_request_number_++].push_back(
+          MakeUnique<MediaSegment>());
+    }
+  }
+  if (end_of_stream_requested_) {
+    DeliverSegments();
     return false;
   }
 
-  MessageLoop destination_message_loop = MessageLoop::GetCurrent();
-  if (destination_message_loop.is_null()) {
-    LOG_ERROR("Unable to dispatch next data segment on current MessageLoop!");
-    return false;
+  std::shared_ptr<TaskExecutor> destination = caller_executor_;
+  if (!destination) {
+    MessageLoop destination_message_loop = MessageLoop::GetCurrent();
+    if (destination_message_loop.is_null()) {
+      LOG_ERROR("Unable to dispatch next data segment on current MessageLoop!");
+      return false;
+    }
+    destination =
+        std::make_shared<MessageLoopExecutor>(destination_message_loop);
   }
 
-  int32_t result = own_thread_.message_loop().PostWork(cc_factory_.NewCallback(
-      &AsyncDataProvider::DownloadNextSegmentOnOwnThread,
-      next_segment_iterator_++, destination_message_loop));
+  AutoLock lock(iterator_lock_);
+  auto state = std::make_shared<DownloadState>();
+  // Segment information is read here, so download threads don't access
+  // sequence_ which can be changed in the meantime.
+  state->duration = sequence_->SegmentDuration(next_segment_iterator_);
+  state->timestamp = sequence_->SegmentTimestamp(next_segment_iterator_);
+  state->timestamp_offset =
+      sequence_->SegmentTimestampOffset(next_segment_iterator_);
+  state->size = sequence_->SegmentSize(next_segment_iterator_);
+  state->representation_id = sequence_->RepresentationId();
+  std::string init_key = SegmentCache::KeyFor(
+      sequence_->GetInitSegmentFor(next_segment_iterator_).get());
+  state->needs_init_segment = init_key != requested_init_key_;
+  requested_init_key_ = init_key;
+  state->number = next_request_number_;
+  state->generation = generation_;
+  state->cancellation_token = cancellation_token_;
+  // Only the segment needed first is urgent, following ones are prefetched.
+  state->priority = state->number == next_delivery_number_
+      ? priority_ : NetworkExecutor::Priority::kPrefetch;
+  state->destination = std::move(destination);
+  sequence_->GetSegmentDescriptor(next_segment_iterator_, &state->segment);
+  state->iterator = next_segment_iterator_;
+  state->requested = std::chrono::steady_clock::now();
+  state->delivered_bytes = 0;
+  state->started_attempts = 0;
+  state->running_attempts = 0;
+  state->finished = false;
+  StartDownloadAttempt(state);
 
-  if (result != PP_OK) {
-    return false;
-  }
+  ++next_segment_iterator_;
+  ++next_request_number_;
+  requested_end_time_ = state->timestamp + state->duration;
 
+  // The next segment starts a new period, its init segment is prefetched
+  // while the current one is downloaded.
+  if (next_segment_iterator_ != sequence_->End()) {
+    auto next_init_segment =
+        sequence_->GetInitSegmentFor(next_segment_iterator_);
+    if (SegmentCache::KeyFor(next_init_segment.get()) != init_key) {
+      executor_->Post(NetworkExecutor::Priority::kPrefetch,
+          cc_factory_.NewCallback(
+              &AsyncDataProvider::PrefetchInitSegmentOnOwnThread,
+              next_init_segment.release(), state->representation_id));
+    }
+  }
   LOG_DEBUG("Finishing");
   return true;
 }
 
+void AsyncDataProvider::StartDownloadAttempt(
+    const std::shared_ptr<DownloadState>& state) {
+  std::unique_ptr<dash::mpd::ISegment> init_segment;
+  // The segment can come from a sequence replaced in the meantime.
+  if (state->needs_init_segment) {
+    init_segment =
+        state->iterator.sequence()->GetInitSegmentFor(state->iterator);
+  }
+  size_t attempt;
+  {
+    std::lock_guard<std::mutex> guard(state->mutex);
+    attempt = ++state->started_attempts;
+    ++state->running_attempts;
+  }
+  executor_->Post(state->priority, cc_factory_.NewCallback(
+      &AsyncDataProvider::DownloadNextSegmentOnOwnThread,
+      init_segment.release(), state));
+
+  auto deadline_ms = static_cast<int64_t>(
+      DownloadDeadline(*state) * 1000);
+  state->destination->PostWork(cc_factory_.NewCallback(
+      &AsyncDataProvider::CheckDownloadOnCallerThread, state, attempt),
+      deadline_ms);
+}
+
+double AsyncDataProvider::DownloadDeadline(
+    const DownloadState& state) const {
+  double max_deadline = std::max(kMinDownloadDeadline,
+      kMaxDownloadDeadlineSegments * state.duration);
+  double throughput =
+      bandwidth_estimator_->EstimatedBandwidth() / kBitsPerByte;
+  if (throughput <= 0.) return max_deadline;
+
+  // Otherwise the segment is expected to be similar to the previous one.
+  double size = state.size > 0 ? state.size : last_segment_size_.load();
+  double expected_time = size / throughput;
+  return std::min(max_deadline, std::max(kMinDownloadDeadline,
+      kDownloadDeadlineMargin * expected_time));
+}
+
+void AsyncDataProvider::CheckDownloadOnCallerThread(int32_t,
+    const std::shared_ptr<DownloadState>& state, size_t attempt) {
+  if (!IsCurrentGeneration(state->generation)) return;
+
+  {
+    std::lock_guard<std::mutex> guard(state->mutex);
+    // Only the latest attempt is checked, others were already followed by
+    // a new one.
+    if (state->finished || attempt != state->started_attempts) return;
+
+    // The last attempt failed or missed its deadline too, attempts still
+    // running are aborted with their next chunk or have their result
+    // dropped.
+    if (state->started_attempts >= kMaxDownloadAttempts) {
+      LOG_ERROR("Giving up download of a segment: %f [s] ... %f [s]",
+          state->timestamp, state->timestamp + state->duration);
+      state->finished = true;
+      PostResult(MakeLastChunk(*state), *state);
+      return;
+    }
+
+    LOG_INFO("%s download of a segment: %f [s] ... %f [s], attempt %zu",
+        state->running_attempts > 0 ? "Hedging" : "Retrying",
+        state->timestamp, state->timestamp + state->duration,
+        state->started_attempts + 1);
+  }
+  AutoLock lock(iterator_lock_);
+  if (state->generation != generation_) return;
+  StartDownloadAttempt(state);
+}
+
+void AsyncDataProvider::ResetRequests() {
+  ++generation_;
+  // Downloads in progress would only take bandwidth from the segments
+  // requested next.
+  cancellation_token_->Cancel();
+  cancellation_token_ = std::make_shared<CancellationToken>();
+  downloaded_segments_.clear();
+  pending_usage_.Set(0);
+  previous_sequences_.clear();
+  next_request_number_ = 0;
+  next_delivery_number_ = 0;
+  end_of_stream_requested_ = false;
+  // The demuxer gets the init segment from GetInitSegment() again.
+  requested_init_key_ = parsed_init_key_;
+}
+
 bool AsyncDataProvider::SetNextSegmentToTime(double time) {
   AutoLock lock(iterator_lock_);
   if (!sequence_) {
     return false;
   }
+  ResetRequests();
   next_segment_iterator_ = sequence_->MediaSegmentForTime(time);
   if (next_segment_iterator_ == sequence_->End()) {
     LOG_ERROR("Can't find segment for time: %f", time);
@@ -92,8 +313,13 @@ bool AsyncDataProvider::SetNextSegmentToTime(double time) {
   return true;
 }
 
+void AsyncDataProvider::CancelRequests() {
+  AutoLock lock(iterator_lock_);
+  ResetRequests();
+}
+
 Samsung::NaClPlayer::TimeTicks AsyncDataProvider::GetClosestKeyframeTime(
-    Samsung::NaClPlayer::TimeTicks time) {
+    Samsung::NaClPlayer::TimeTicks time, const KeyframeIndex* index) {
   constexpr Samsung::NaClPlayer::TimeTicks kSeekMargin = 0.1;
   auto segment = sequence_->MediaSegmentForTime(time);
   if (segment == sequence_->End())
@@ -107,22 +333,86 @@ Samsung::NaClPlayer::TimeTicks AsyncDataProvider::GetClosestKeyframeTime(
   if (!has_next_segment)
     return segment_start;
   auto next_segment_start = next_segment.SegmentTimestamp(sequence_.get());
-  if (time - segment_start < next_segment_start - time)
-    return segment_start + kSeekMargin;
-  return next_segment_start + kSeekMargin;
+  Samsung::NaClPlayer::TimeTicks closest =
+      (time - segment_start < next_segment_start - time) ?
+      segment_start : next_segment_start;
+  Samsung::NaClPlayer::TimeTicks closest_keyframe = closest + kSeekMargin;
+
+  // Keyframes inside the segment, known from its index or from demuxing it
+  // before, are exact seek targets and need no margin.
+  auto keyframes = sequence_->SegmentKeyframes(segment);
+  double demuxed_keyframe = 0.;
+  if (index && index->FindClosest(sequence_->RepresentationId(), time,
+                                  segment_start + kEps, next_segment_start,
+                                  &demuxed_keyframe))
+    keyframes.push_back(demuxed_keyframe);
+  for (auto keyframe : keyframes) {
+    if (keyframe <= segment_start + kEps || keyframe >= next_segment_start)
+      continue;
+    if (fabs(keyframe - time) < fabs(closest - time)) {
+      closest = keyframe;
+      closest_keyframe = keyframe;
+    }
+  }
+  return closest_keyframe;
 }
 
 void AsyncDataProvider::SetMediaSegmentSequence(
-    std::unique_ptr<MediaSegmentSequence> sequence, double time) {
+    std::shared_ptr<const MediaSegmentSequence> sequence, double time) {
   AutoLock lock(iterator_lock_);
+  ResetRequests();
   sequence_ = std::move(sequence);
   if (fabs(time) < kEps) {
-    next_segment_iterator_ = sequence_->Begin();
+    next_segment_iterator_ = sequence_->StartSegment();
   } else {
     next_segment_iterator_ = sequence_->MediaSegmentForTime(time);
   }
 }
 
+bool AsyncDataProvider::SwitchMediaSegmentSequence(
+    std::shared_ptr<const MediaSegmentSequence>* sequence) {
+  AutoLock lock(iterator_lock_);
+  if (!sequence_ || !*sequence || next_request_number_ == 0 ||
+      end_of_stream_requested_)
+    return false;
+
+  auto next_segment =
+      (*sequence)->MediaSegmentForTime(requested_end_time_ + kEps);
+  if (next_segment == (*sequence)->End()) return false;
+  double timestamp = (*sequence)->SegmentTimestamp(next_segment);
+  if (fabs(timestamp - requested_end_time_) > kMaxSegmentMisalignment) {
+    LOG_INFO("Segments are not aligned, next one starts at %f instead of %f",
+             timestamp, requested_end_time_);
+    return false;
+  }
+
+  // Segments still pending are delivered in order, so the previous sequences
+  // are not needed once the last of them is.
+  if (PendingSegments() == 0) previous_sequences_.clear();
+  previous_sequences_.push_back(std::move(sequence_));
+  sequence_ = std::move(*sequence);
+  next_segment_iterator_ = next_segment;
+  return true;
+}
+
+bool AsyncDataProvider::GetUpcomingSegmentsSize(double time, uint64_t* bytes,
+                                                double* duration) {
+  AutoLock lock(iterator_lock_);
+  if (!sequence_) return false;
+
+  *bytes = 0;
+  *duration = 0.;
+  for (auto it = next_segment_iterator_;
+       it != sequence_->End() && *duration < time; ++it) {
+    uint64_t size = sequence_->SegmentSize(it);
+    double segment_duration = sequence_->SegmentDuration(it);
+    if (size == 0 || segment_duration <= 0.) return false;
+    *bytes += size;
+    *duration += segment_duration;
+  }
+  return *duration > 0.;
+}
+
 double AsyncDataProvider::AverageSegmentDuration() {
   if (!sequence_) {
     return 0.0;
@@ -131,59 +421,457 @@ double AsyncDataProvider::AverageSegmentDuration() {
 }
 
 bool AsyncDataProvider::GetInitSegment(std::vector<uint8_t>* buffer) {
-  return DownloadSegment(sequence_->GetInitSegment(), buffer);
+  std::unique_ptr<dash::mpd::ISegment> segment;
+  std::string representation_id;
+  {
+    AutoLock lock(iterator_lock_);
+    if (!sequence_) return false;
+
+    segment = next_segment_iterator_ != sequence_->End()
+        ? sequence_->GetInitSegmentFor(next_segment_iterator_)
+        : sequence_->GetInitSegment();
+    parsed_init_key_ = SegmentCache::KeyFor(segment.get());
+    requested_init_key_ = parsed_init_key_;
+    representation_id = sequence_->RepresentationId();
+  }
+  return LoadInitSegment(segment.get(), representation_id, buffer);
+}
+
+void AsyncDataProvider::SetInitSegment(const std::vector<uint8_t>& data) {
+  std::string key;
+  {
+    AutoLock lock(iterator_lock_);
+    if (!sequence_) return;
+
+    auto segment = next_segment_iterator_ != sequence_->End()
+        ? sequence_->GetInitSegmentFor(next_segment_iterator_)
+        : sequence_->GetInitSegment();
+    key = SegmentCache::KeyFor(segment.get());
+  }
+  if (!key.empty()) segment_cache_.Put(key, data, true);
+}
+
+void AsyncDataProvider::PrefetchInitSegments(
+    std::vector<std::shared_ptr<const MediaSegmentSequence>> sequences) {
+  if (sequences.empty()) return;
+
+  auto sequence_list = std::make_shared<SequenceList>(std::move(sequences));
+  executor_->Post(NetworkExecutor::Priority::kPrefetch, cc_factory_.NewCallback(
+      &AsyncDataProvider::PrefetchInitSegmentsOnOwnThread, sequence_list));
+}
+
+size_t AsyncDataProvider::PrefetchDepth() const {
+  switch (MemoryGovernor::GetPressure()) {
+    case MemoryPressure::kModerate:
+      return std::max<size_t>(prefetch_depth_ / 2, 1);
+    case MemoryPressure::kCritical:
+      return 1;
+    default:
+      return prefetch_depth_;
+  }
+}
+
+void AsyncDataProvider::PrefetchSegment(
+    double time, std::shared_ptr<const MediaSegmentSequence> sequence) {
+  // A position the user may not go to isn't worth memory under pressure.
+  if (MemoryGovernor::GetPressure() != MemoryPressure::kNone) return;
+
+  AutoLock lock(iterator_lock_);
+  if (!sequence) sequence = sequence_;
+  if (!sequence) return;
+
+  auto iterator = sequence->MediaSegmentForTime(time);
+  if (iterator == sequence->End()) return;
+
+  auto request = std::make_shared<PrefetchRequest>();
+  sequence->GetSegmentDescriptor(iterator, &request->segment);
+  std::string key = SegmentCache::KeyFor(request->segment);
+  // The user is still around the previously prefetched position.
+  if (key.empty() || key == prefetch_key_ || segment_cache_.Contains(key))
+    return;
+
+  // Only the latest candidate position is worth downloading.
+  prefetch_token_->Cancel();
+  prefetch_token_ = std::make_shared<CancellationToken>();
+  prefetch_key_ = key;
+  request->size = sequence->SegmentSize(iterator);
+  request->representation_id = sequence->RepresentationId();
+  request->cancellation_token = prefetch_token_;
+
+  auto init_segment = sequence->GetInitSegmentFor(iterator);
+  if (!segment_cache_.Contains(SegmentCache::KeyFor(init_segment.get()))) {
+    executor_->Post(NetworkExecutor::Priority::kPrefetch,
+        cc_factory_.NewCallback(
+            &AsyncDataProvider::PrefetchInitSegmentOnOwnThread,
+            init_segment.release(), request->representation_id));
+  }
+  executor_->Post(NetworkExecutor::Priority::kPrefetch, cc_factory_.NewCallback(
+      &AsyncDataProvider::PrefetchSegmentOnOwnThread, request));
+}
+
+void AsyncDataProvider::PrefetchSegmentOnOwnThread(
+    int32_t, const std::shared_ptr<PrefetchRequest>& request) {
+  BeginTask();
+  std::string key = SegmentCache::KeyFor(request->segment);
+  if (!request->cancellation_token->IsCancelled() &&
+      !segment_cache_.Contains(key)) {
+    std::vector<uint8_t> data;
+    if (request->size > 0) data.reserve(request->size);
+    SegmentDownloadInfo info;
+    if (DownloadSegment(request->segment, &data, &info,
+                        request->cancellation_token.get(), &tuning_)) {
+      AddDownloadSample(info, request->representation_id);
+      segment_cache_.Put(key, data);
+      LOG_DEBUG("Prefetched a segment: %s", key.c_str());
+    }
+  }
+  EndTask();
+}
+
+void AsyncDataProvider::PrefetchInitSegmentsOnOwnThread(
+    int32_t, const std::shared_ptr<SequenceList>& sequences) {
+  BeginTask();
+  std::vector<uint8_t> buffer;
+  for (const auto& sequence : *sequences) {
+    if (!sequence) continue;
+    if (!LoadInitSegment(sequence.get(), &buffer))
+      LOG_ERROR("Failed to prefetch an initialization segment");
+  }
+  LOG_DEBUG("Prefetched %zu initialization segments", sequences->size());
+  EndTask();
+}
+
+void AsyncDataProvider::PrefetchInitSegmentOnOwnThread(int32_t,
+    dash::mpd::ISegment* segment, const std::string& representation_id) {
+  BeginTask();
+  auto init_segment = AdoptUnique(segment);
+  std::vector<uint8_t> buffer;
+  if (!LoadInitSegment(init_segment.get(), representation_id, &buffer))
+    LOG_ERROR("Failed to prefetch an initialization segment");
+  EndTask();
+}
+
+bool AsyncDataProvider::LoadInitSegment(const MediaSegmentSequence* sequence,
+                                        std::vector<uint8_t>* buffer) {
+  if (!sequence) return false;
+
+  auto segment = sequence->GetInitSegment();
+  std::string key = SegmentCache::KeyFor(segment.get());
+  if (!key.empty() && segment_cache_.Get(key, buffer)) return true;
+
+  // SegmentBase sequences get it with their index in a single request.
+  bool loaded = false;
+  executor_->RunAndWait(NetworkExecutor::Priority::kInitSegment, [&]() {
+    loaded = sequence->GetInitSegmentData(buffer);
+  });
+  if (loaded) {
+    if (!key.empty()) segment_cache_.Put(key, *buffer, true);
+    return true;
+  }
+  return LoadInitSegment(segment.get(), sequence->RepresentationId(), buffer);
+}
+
+bool AsyncDataProvider::LoadInitSegment(dash::mpd::ISegment* segment,
+    const std::string& representation_id, std::vector<uint8_t>* buffer) {
+  std::string key = SegmentCache::KeyFor(segment);
+  if (!key.empty() && segment_cache_.Get(key, buffer)) return true;
+
+  if (!segment) return false;
+  SegmentDescriptor location = DescribeSegment(segment);
+  if (!SegmentDiskCache::Get().Lookup(location, buffer)) {
+    // Blocking download is still run by the executor, so it's prioritized
+    // against other requests.
+    bool downloaded = false;
+    SegmentDownloadInfo info;
+    executor_->RunAndWait(NetworkExecutor::Priority::kInitSegment, [&]() {
+      downloaded = DownloadSegment(location, buffer, &info, nullptr,
+                                   &tuning_);
+    });
+    if (!downloaded) return false;
+
+    AddDownloadSample(info, representation_id);
+    SegmentDiskCache::Get().Put(location, *buffer);
+  }
+
+  // Init segments are small and needed on each representation change.
+  segment_cache_.Put(key, *buffer, true);
+  return true;
+}
+
+void AsyncDataProvider::DownloadNextSegmentOnOwnThread(int32_t,
+    dash::mpd::ISegment* init_segment,
+    const std::shared_ptr<DownloadState>& state) {
+  TRACE_SCOPE("download segment");
+  BeginTask();
+  DownloadSegmentOnWorker(AdoptUnique(init_segment), state);
+  EndTask();
 }
 
-void AsyncDataProvider::DownloadNextSegmentOnOwnThread(
-    int32_t, MediaSegmentSequence::Iterator segment_iterator,
-    MessageLoop destination_message_loop) {
-  using std::chrono::steady_clock;
-  using std::chrono::duration_cast;
-  using std::chrono::duration;
+bool AsyncDataProvider::ForwardSegmentData(DownloadState* state,
+    size_t offset, std::vector<uint8_t>&& data,
+    const std::vector<uint8_t>& init_data) {
+  std::lock_guard<std::mutex> guard(state->mutex);
+  // Another attempt already passed the whole segment on.
+  if (state->finished) return false;
 
-  auto segment_duration = sequence_->SegmentDuration(segment_iterator);
-  auto segment_timestamp = sequence_->SegmentTimestamp(segment_iterator);
-  auto st = steady_clock::now();
+  size_t end = offset + data.size();
+  if (end <= state->delivered_bytes) return true;
+
+  auto seg_chunk = MakeUnique<MediaSegment>();
+  if (offset < state->delivered_bytes) {
+    seg_chunk->data_.assign(data.begin() + (state->delivered_bytes - offset),
+                            data.end());
+  } else {
+    seg_chunk->data_ = std::move(data);
+  }
+  seg_chunk->duration_ = state->duration;
+  seg_chunk->timestamp_ = state->timestamp;
+  seg_chunk->timestamp_offset_ = state->timestamp_offset;
+  seg_chunk->representation_id_ = state->representation_id;
+  seg_chunk->first_chunk_ = state->delivered_bytes == 0;
+  if (seg_chunk->first_chunk_) {
+    seg_chunk->data_.insert(seg_chunk->data_.begin(), init_data.begin(),
+                            init_data.end());
+    state->first_byte = std::chrono::steady_clock::now();
+  }
+  seg_chunk->requested_ = state->requested;
+  seg_chunk->first_byte_ = state->first_byte;
+  seg_chunk->last_chunk_ = false;
+  state->delivered_bytes = end;
+  // Posted under the lock, so chunks of different attempts keep the order.
+  PostResult(std::move(seg_chunk), *state);
+  return true;
+}
+
+void AsyncDataProvider::FinishDownloadAttempt(
+    const std::shared_ptr<DownloadState>& state, bool downloaded) {
+  std::lock_guard<std::mutex> guard(state->mutex);
+  --state->running_attempts;
+  if (state->finished) return;
+
+  if (downloaded) {
+    state->finished = true;
+    PostResult(MakeLastChunk(*state), *state);
+  } else if (state->running_attempts == 0) {
+    // Retries right away or gives up when all attempts failed.
+    state->destination->PostWork(cc_factory_.NewCallback(
+        &AsyncDataProvider::CheckDownloadOnCallerThread, state,
+        state->started_attempts));
+  }
+}
+
+void AsyncDataProvider::DownloadSegmentOnWorker(
+    std::unique_ptr<dash::mpd::ISegment> init_segment,
+    const std::shared_ptr<DownloadState>& state) {
+  auto segment_duration = state->duration;
+  auto segment_timestamp = state->timestamp;
   LOG_DEBUG("Starting download for a segment: %f [s] ... %f [s]",
       segment_timestamp, segment_timestamp + segment_duration);
-  auto seg = MakeUnique<MediaSegment>();
-
-  // arbitrary additional buffer space if segments size varies a little
-  seg->data_.reserve(last_segment_size_ + last_segment_size_ / 32);
-  seg->duration_ = segment_duration;
-  seg->timestamp_ = segment_timestamp;
-
-  auto segment = *segment_iterator;
-  dash::network::IChunk* chunk =
-      static_cast<dash::network::IChunk*>(segment.get());
-  std::string url = chunk->AbsoluteURI();
-  if (chunk->HasByteRange())
-    url += " Range: " + chunk->Range();
-  if (!DownloadSegment(std::move(segment), &(seg->data_))) {
+
+  // Usually prefetched already, when the previous segment was requested.
+  std::vector<uint8_t> init_data;
+  if (init_segment && !LoadInitSegment(init_segment.get(),
+                                       state->representation_id, &init_data)) {
+    LOG_ERROR("Failed to download an initialization segment for a segment: "
+              "%f [s] ... %f [s]", segment_timestamp,
+              segment_timestamp + segment_duration);
+    FinishDownloadAttempt(state, false);
+    return;
+  }
+
+  std::string cache_key = SegmentCache::KeyFor(state->segment);
+  bool chunked = chunked_delivery_;
+  std::vector<uint8_t> data;
+  bool downloaded = false;
+  bool from_cache = false;
+  size_t seg_data_size = 0;
+  SegmentDownloadInfo info;
+  // The first seconds of media are kept on disk as well, so a replay
+  // starts without waiting for the network.
+  bool head_segment =
+      segment_timestamp < SegmentDiskCache::kCachedHeadDuration;
+  if (segment_cache_.Get(cache_key, &data)) {
+    downloaded = true;
+    from_cache = true;
+  } else if (head_segment &&
+             SegmentDiskCache::Get().Lookup(state->segment, &data)) {
+    segment_cache_.Put(cache_key, data);
+    downloaded = true;
+    from_cache = true;
+  } else if (chunked) {
+    std::vector<uint8_t> cached_data;
+    auto chunk_callback = [&](std::vector<uint8_t>&& chunk_data) {
+      // Downloads requested before a seek are not needed anymore.
+      if (!IsCurrentGeneration(state->generation)) return false;
+      size_t offset = seg_data_size;
+      seg_data_size += chunk_data.size();
+      cached_data.insert(cached_data.end(), chunk_data.begin(),
+                         chunk_data.end());
+      return ForwardSegmentData(state.get(), offset, std::move(chunk_data),
+                                init_data);
+    };
+    downloaded = DownloadSegment(state->segment, chunk_callback, &info,
+                                 state->cancellation_token.get(), &tuning_);
+    if (downloaded) {
+      segment_cache_.Put(cache_key, cached_data);
+      if (head_segment)
+        SegmentDiskCache::Get().Put(state->segment, cached_data);
+    }
+  } else {
+    // arbitrary additional buffer space if segments size varies a little
+    if (state->size > 0)
+      data.reserve(state->size);
+    else
+      data.reserve(last_segment_size_ + last_segment_size_ / 32);
+    downloaded = DownloadSegment(state->segment, &data, &info,
+                                 state->cancellation_token.get(), &tuning_);
+    if (downloaded) {
+      segment_cache_.Put(cache_key, data);
+      if (head_segment) SegmentDiskCache::Get().Put(state->segment, data);
+    }
+  }
+
+  if (!downloaded) {
     LOG_DEBUG("Download of a segment: %f [s] ... %f [s] was interrupted.",
         segment_timestamp, segment_timestamp + segment_duration);
+    FinishDownloadAttempt(state, false);
     return;
   }
-  last_segment_size_ = seg->data_.size();
 
-  size_t seg_data_size = seg->data_.size();
-  destination_message_loop.PostWork(cc_factory_.NewCallback(
-      &AsyncDataProvider::PassResultOnCallerThread, seg.release()));
+  // Data which is not passed on yet.
+  if (from_cache || !chunked) {
+    seg_data_size = data.size();
+    if (chunked) {
+      ForwardSegmentData(state.get(), 0, std::move(data), init_data);
+    } else {
+      auto seg = MakeUnique<MediaSegment>();
+      seg->data_ = std::move(data);
+      seg->data_.insert(seg->data_.begin(), init_data.begin(),
+                        init_data.end());
+      seg->duration_ = segment_duration;
+      seg->timestamp_ = segment_timestamp;
+      seg->timestamp_offset_ = state->timestamp_offset;
+      seg->representation_id_ = state->representation_id;
+      seg->requested_ = state->requested;
+      seg->last_byte_ = std::chrono::steady_clock::now();
+      // The body was being received for that long before the download
+      // ended.
+      double body_time = from_cache ? 0. :
+          std::max(0., info.total_time - info.time_to_first_body_byte);
+      seg->first_byte_ = seg->last_byte_ -
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              std::chrono::duration<double>(body_time));
+      std::lock_guard<std::mutex> guard(state->mutex);
+      if (!state->finished) {
+        // Passed on as a whole, FinishDownloadAttempt() has nothing to add.
+        state->finished = true;
+        PostResult(std::move(seg), *state);
+      }
+    }
+  }
 
-  auto et = steady_clock::now();
-  duration<double> d = et - st;
-  LOG_DEBUG("Finished download of a segment: %f [s] ... %f [s]",
-      segment_timestamp, segment_timestamp + segment_duration);
+  last_segment_size_ = seg_data_size;
+  if (!from_cache) AddDownloadSample(info, state->representation_id);
+  FinishDownloadAttempt(state, true);
+  LOG_DEBUG("Finished download of a segment: %f [s] ... %f [s]%s",
+      segment_timestamp, segment_timestamp + segment_duration,
+      from_cache ? " from cache" : "");
+}
+
+unique_ptr<MediaSegment> AsyncDataProvider::MakeLastChunk(
+    const DownloadState& state) {
+  if (state.delivered_bytes == 0) return nullptr;
 
-  LOG_DEBUG("download time: %.4f segment duration: %.4f data size: %u url: %s",
-        d.count(), segment_duration, seg_data_size,
-        url.c_str());
+  auto last_chunk = MakeUnique<MediaSegment>();
+  last_chunk->duration_ = state.duration;
+  last_chunk->timestamp_ = state.timestamp;
+  last_chunk->timestamp_offset_ = state.timestamp_offset;
+  last_chunk->representation_id_ = state.representation_id;
+  last_chunk->first_chunk_ = false;
+  last_chunk->requested_ = state.requested;
+  last_chunk->first_byte_ = state.first_byte;
+  last_chunk->last_byte_ = std::chrono::steady_clock::now();
+  return last_chunk;
+}
+
+void AsyncDataProvider::PostResult(unique_ptr<MediaSegment> segment,
+                                   const DownloadState& state) {
+  // Connects the download with parsing of the segment on the stream thread.
+  Tracer::FlowStart("segment", reinterpret_cast<uintptr_t>(segment.get()));
+  state.destination->PostWork(cc_factory_.NewCallback(
+      &AsyncDataProvider::PassResultOnCallerThread, segment.release(),
+      state.number, state.generation));
+}
+
+bool AsyncDataProvider::IsCurrentGeneration(uint32_t generation) {
+  AutoLock lock(iterator_lock_);
+  return generation == generation_;
+}
+
+void AsyncDataProvider::AddDownloadSample(
+    const SegmentDownloadInfo& info, const std::string& representation_id) {
+  DownloadSample sample;
+  sample.bytes = info.bytes;
+  sample.time_to_first_byte = info.time_to_first_byte;
+  sample.time_to_first_body_byte = info.time_to_first_body_byte;
+  sample.total_time = info.total_time;
+  sample.host = BandwidthEstimator::HostOf(info.url);
+  sample.representation_id = representation_id;
+  sample.response = info.response;
+  bandwidth_estimator_->AddSample(sample);
+  if (playback_metrics_) {
+    playback_metrics_->AddSegmentDownload(info.bytes, info.total_time);
+    // Segments served from memory have no response to report.
+    if (sample.response.status_code != 0)
+      playback_metrics_->AddDownloadSample(sample);
+  }
+  LOG_DEBUG("Downloaded %zu bytes of representation %s from %s, time to "
+            "first byte: %.4f [s] to first body byte: %.4f [s] total time: "
+            "%.4f [s] status: %d age: %lld cache: %s pop: %s estimated "
+            "bandwidth: %.0f [bps]", sample.bytes,
+            sample.representation_id.c_str(), sample.host.c_str(),
+            sample.time_to_first_byte, sample.time_to_first_body_byte,
+            sample.total_time, sample.response.status_code,
+            static_cast<long long>(sample.response.age),
+            sample.response.cache_status.c_str(),
+            sample.response.cdn_pop.c_str(),
+            bandwidth_estimator_->EstimatedBandwidth());
 }
 
 void AsyncDataProvider::PassResultOnCallerThread(int32_t,
-                                                 MediaSegment* segment) {
-  LOG_DEBUG("");
-  data_segment_callback_(AdoptUnique(segment));
+    MediaSegment* segment, uint64_t number, uint32_t generation) {
+  LOG_DEBUG("segment number: %llu", static_cast<unsigned long long>(number));
+  auto result = AdoptUnique(segment);
+  {
+    AutoLock lock(iterator_lock_);
+    if (generation != generation_) {
+      LOG_DEBUG("Dropping a segment requested before a sequence change.");
+      return;
+    }
+    if (result) pending_usage_.Add(result->data_.size());
+    downloaded_segments_[number].push_back(std::move(result));
+  }
+  DeliverSegments();
   LOG_DEBUG("Finishing");
 }
 
+void AsyncDataProvider::DeliverSegments() {
+  while (true) {
+    unique_ptr<MediaSegment> segment;
+    {
+      AutoLock lock(iterator_lock_);
+      auto it = downloaded_segments_.find(next_delivery_number_);
+      if (it == downloaded_segments_.end() || it->second.empty()) return;
+      segment = std::move(it->second.front());
+      it->second.pop_front();
+      if (segment) pending_usage_.Remove(segment->data_.size());
+      if (!segment || segment->last_chunk_) {
+        downloaded_segments_.erase(it);
+        ++next_delivery_number_;
+      }
+    }
+    // Failed downloads are skipped.
+    if (segment) data_segment_callback_(std::move(segment));
+  }
+}
+
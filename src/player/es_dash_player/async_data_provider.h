@@ -20,45 +20,169 @@
 #ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_ASYNC_DATA_PROVIDER_H_
 #define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_ASYNC_DATA_PROVIDER_H_
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include "nacl_player/common.h"
 #include "ppapi/cpp/message_loop.h"
 #include "ppapi/utility/completion_callback_factory.h"
 #include "ppapi/utility/threading/lock.h"
-#include "ppapi/utility/threading/simple_thread.h"
 
 #include "dash/media_segment_sequence.h"
+#include "memory_governor.h"
+#include "player/es_dash_player/task_executor.h"
 
+#include "bandwidth_estimator.h"
+#include "keyframe_index.h"
 #include "media_segment.h"
+#include "network_executor.h"
+#include "segment_cache.h"
+#include "tuning_profile.h"
+
+class PlaybackMetrics;
 
 class AsyncDataProvider {
  public:
+  static constexpr size_t kDefaultPrefetchDepth = 3;
+  static constexpr size_t kDefaultSegmentCacheSize = 32 * 1024 * 1024;
+
+  // Up to prefetch_depth segments are downloaded in parallel on executor
+  // workers. The segment which is needed first is downloaded with given
+  // priority, the following ones as a prefetch. When executor is null, a
+  // private one is created. Downloads are measured by bandwidth_estimator,
+  // or by a private one if it's null. Downloaded segments are passed to
+  // callback in sequence order.
   AsyncDataProvider(
       const pp::InstanceHandle& instance,
-      std::function<void(std::unique_ptr<MediaSegment>)> callback);
+      std::function<void(std::unique_ptr<MediaSegment>)> callback,
+      std::shared_ptr<NetworkExecutor> executor = nullptr,
+      std::shared_ptr<BandwidthEstimator> bandwidth_estimator = nullptr,
+      NetworkExecutor::Priority priority = NetworkExecutor::Priority::kVideo,
+      size_t prefetch_depth = kDefaultPrefetchDepth);
 
-  ~AsyncDataProvider() {}
+  // Waits for downloads which are in progress.
+  ~AsyncDataProvider();
 
+  // Returns false at the end of stream. Nothing is requested when the next
+  // segment of a dynamic sequence is not available yet.
   bool RequestNextDataSegment();
 
+  // Returns true when all segments of a static sequence are requested, so
+  // the next RequestNextDataSegment() passes the end of stream.
+  bool IsSequenceEnd() const;
+
+  // Number of requested segments which were not passed to callback yet.
+  size_t PendingSegments() const {
+    return next_request_number_ - next_delivery_number_;
+  }
+
+  // The prefetch depth is reduced under memory pressure, down to a single
+  // segment at a time.
+  size_t PrefetchDepth() const;
+
+  // End time of the last requested segment.
+  Samsung::NaClPlayer::TimeTicks RequestedSegmentsEndTime() const {
+    return requested_end_time_;
+  }
+
+  // Size of the last downloaded segment.
+  size_t LastSegmentSize() const { return last_segment_size_; }
+
+  // Gets total size and duration of segments which will be requested next,
+  // up to the one ending at least time seconds after the first of them.
+  // Returns false if a size of any of them is not known before download.
+  bool GetUpcomingSegmentsSize(double time, uint64_t* bytes,
+                               double* duration);
+
+  BandwidthEstimator* GetBandwidthEstimator() {
+    return bandwidth_estimator_.get();
+  }
+
+  // When enabled, segments are passed to callback in chunks as they are
+  // downloaded (see MediaSegment), so demuxing can start before the whole
+  // segment is downloaded.
+  void SetChunkedDelivery(bool enabled) { chunked_delivery_ = enabled; }
+
+  // Sizes download buffers by the profile of the player. The current
+  // TuningProfile is used until it's set, it must be set before segments
+  // are requested.
+  void SetTuningProfile(const TuningProfile& tuning) { tuning_ = tuning; }
+
+  // Segments and download deadline checks are posted to executor instead of
+  // the message loop of the thread requesting segments, e.g. to run them in
+  // virtual time. Must be called before segments are requested.
+  void SetTaskExecutor(std::shared_ptr<TaskExecutor> executor) {
+    caller_executor_ = std::move(executor);
+  }
+
+  // Makes segment downloads counted in playback metrics of the player,
+  // which must outlive this object. Must be called before segments are
+  // requested, nothing is counted if it's not called.
+  void SetPlaybackMetrics(PlaybackMetrics* metrics) {
+    playback_metrics_ = metrics;
+  }
+
   bool SetNextSegmentToTime(double time);
 
+  // Aborts downloads of requested segments, e.g. before a seek. They are
+  // requested again by RequestNextDataSegment() then.
+  void CancelRequests();
+
   // Gets a time of a keyframe closest to a given time. The time must be
-  // between 0 and clip duration.
+  // between 0 and clip duration. Besides segment boundaries, keyframes from
+  // the segment index and the given index of demuxed keyframes are used.
   Samsung::NaClPlayer::TimeTicks GetClosestKeyframeTime(
-      Samsung::NaClPlayer::TimeTicks);
+      Samsung::NaClPlayer::TimeTicks, const KeyframeIndex* index = nullptr);
+
+  void SetMediaSegmentSequence(
+      std::shared_ptr<const MediaSegmentSequence> sequence, double time = 0.);
 
-  void SetMediaSegmentSequence(std::unique_ptr<MediaSegmentSequence> sequence,
-                               double time = 0.);
+  // Makes segments requested from now on come from *sequence, starting with
+  // the one following already requested segments, which are still passed
+  // to the callback. The first of them is preceded by the init segment of
+  // *sequence. It fails, leaving *sequence untouched, if segments of both
+  // sequences are not aligned.
+  bool SwitchMediaSegmentSequence(
+      std::shared_ptr<const MediaSegmentSequence>* sequence);
 
   double AverageSegmentDuration();
 
   /// Needs to be called on non-main thread.
+  /// Gets init segment of the next segment. Following segments which need
+  /// another one, e.g. in the next period, are passed with it prepended.
   bool GetInitSegment(std::vector<uint8_t>* buffer);
 
+  // Makes GetInitSegment() return data, downloaded before this provider was
+  // created, for the init segment of the current sequence.
+  void SetInitSegment(const std::vector<uint8_t>& data);
+
+  // Downloads init segments of given sequences to the segment cache on a
+  // download thread, so a later switch to one of them doesn't wait for it.
+  void PrefetchInitSegments(
+      std::vector<std::shared_ptr<const MediaSegmentSequence>> sequences);
+
+  // Downloads the segment at time to the segment cache on a download thread,
+  // e.g. at a position the user is about to seek to. The segment comes from
+  // sequence if it's given, e.g. a representation the stream may switch to,
+  // or from the current sequence otherwise. It cancels the previous
+  // prefetch, if it's still in progress. Nothing is downloaded under memory
+  // pressure.
+  void PrefetchSegment(
+      double time,
+      std::shared_ptr<const MediaSegmentSequence> sequence = nullptr);
+
+  // Recently downloaded segments are kept here, so a rewind or a switch back
+  // to the previous representation doesn't download them again.
+  SegmentCache* GetSegmentCache() { return &segment_cache_; }
+
   Samsung::NaClPlayer::TimeTicks CurrentSegmentTimestamp() {
     return next_segment_iterator_.SegmentTimestamp(sequence_.get());
   }
@@ -68,20 +192,171 @@ class AsyncDataProvider {
   }
 
  private:
-  void DownloadNextSegmentOnOwnThread(
-      int32_t, MediaSegmentSequence::Iterator segment_iterator,
-      pp::MessageLoop destination_message_loop);
+  // A segment requested for a download. It's shared by all attempts to
+  // download it: when an attempt misses its deadline, a hedged one is
+  // started and whichever gets data first passes it on. Attempts fetch the
+  // same bytes, so data already passed on by one attempt is skipped by
+  // others.
+  struct DownloadState {
+    double duration;
+    double timestamp;
+    double timestamp_offset;
+    // Size known before the download, 0 if it's not.
+    uint64_t size;
+    std::string representation_id;
+    // Set when the segment needs another init segment than the previous one,
+    // it's prepended to the segment data.
+    bool needs_init_segment;
+    uint64_t number;
+    uint32_t generation;
+    // Cancelled when the generation ends, it's shared by all attempts.
+    std::shared_ptr<CancellationToken> cancellation_token;
+    NetworkExecutor::Priority priority;
+    // Runs callbacks on the thread which requested the segment.
+    std::shared_ptr<TaskExecutor> destination;
+    // Location of the segment, it's not changed once the state is shared
+    // with download attempts.
+    SegmentDescriptor segment;
+    // Used on the caller thread only, to create init segments for new
+    // attempts.
+    MediaSegmentSequence::Iterator iterator;
+    std::chrono::steady_clock::time_point requested;
+
+    std::mutex mutex;
+    // When the first chunk was passed on.
+    std::chrono::steady_clock::time_point first_byte;
+    size_t delivered_bytes;
+    size_t started_attempts;
+    size_t running_attempts;
+    bool finished;
+  };
+
+  // Starts a new download attempt and schedules a check of its deadline.
+  // Must be called on the caller thread with iterator_lock_ locked.
+  void StartDownloadAttempt(const std::shared_ptr<DownloadState>& state);
+  // Called when the given attempt misses its deadline or fails. Starts
+  // a hedged or retried attempt if the segment isn't downloaded yet, gives up
+  // after kMaxDownloadAttempts.
+  void CheckDownloadOnCallerThread(int32_t,
+      const std::shared_ptr<DownloadState>& state, size_t attempt);
+  double DownloadDeadline(const DownloadState& state) const;
+
+  // init_segment is owned by the callback. It's null unless it needs to be
+  // prepended to the segment.
+  void DownloadNextSegmentOnOwnThread(int32_t,
+      dash::mpd::ISegment* init_segment,
+      const std::shared_ptr<DownloadState>& state);
+  // Returns false if the download should be stopped. init_data is prepended
+  // to the first chunk.
+  bool ForwardSegmentData(DownloadState* state, size_t offset,
+                          std::vector<uint8_t>&& data,
+                          const std::vector<uint8_t>& init_data);
+  void FinishDownloadAttempt(const std::shared_ptr<DownloadState>& state,
+                             bool downloaded);
+  void DownloadSegmentOnWorker(
+      std::unique_ptr<dash::mpd::ISegment> init_segment,
+      const std::shared_ptr<DownloadState>& state);
 
-  void PassResultOnCallerThread(int32_t, MediaSegment* segment);
+  typedef std::vector<std::shared_ptr<const MediaSegmentSequence>> SequenceList;
 
-  pp::SimpleThread own_thread_;
-  std::unique_ptr<MediaSegmentSequence> sequence_;
+  // A segment downloaded by PrefetchSegment().
+  struct PrefetchRequest {
+    SegmentDescriptor segment;
+    uint64_t size;
+    std::string representation_id;
+    std::shared_ptr<CancellationToken> cancellation_token;
+  };
+
+  // Gets init segment of the sequence from the segment cache or downloads it
+  // and pins it in the cache.
+  bool LoadInitSegment(const MediaSegmentSequence* sequence,
+                       std::vector<uint8_t>* buffer);
+  bool LoadInitSegment(dash::mpd::ISegment* segment,
+                       const std::string& representation_id,
+                       std::vector<uint8_t>* buffer);
+
+  void PrefetchInitSegmentsOnOwnThread(
+      int32_t, const std::shared_ptr<SequenceList>& sequences);
+  // segment is owned by the callback.
+  void PrefetchInitSegmentOnOwnThread(int32_t, dash::mpd::ISegment* segment,
+                                      const std::string& representation_id);
+  void PrefetchSegmentOnOwnThread(
+      int32_t, const std::shared_ptr<PrefetchRequest>& request);
+
+  // segment is null when download failed.
+  void PassResultOnCallerThread(int32_t, MediaSegment* segment,
+                                uint64_t number, uint32_t generation);
+  // Chunks already passed on need to be followed by the last chunk. Returns
+  // null, i.e. a failed segment, if nothing was passed on.
+  static std::unique_ptr<MediaSegment> MakeLastChunk(
+      const DownloadState& state);
+  void PostResult(std::unique_ptr<MediaSegment> segment,
+                  const DownloadState& state);
+  bool IsCurrentGeneration(uint32_t generation);
+  void AddDownloadSample(const SegmentDownloadInfo& info,
+                         const std::string& representation_id);
+
+  // Passes downloaded segments to the callback, as long as they are in order.
+  void DeliverSegments();
+
+  // Drops segments that are being downloaded and aborts their downloads,
+  // called when the next segment changes. iterator_lock_ must be locked.
+  void ResetRequests();
+
+  // Tracks tasks running on executor workers, so the destructor can wait
+  // for them.
+  void BeginTask();
+  void EndTask();
+
+  std::shared_ptr<NetworkExecutor> executor_;
+  std::shared_ptr<BandwidthEstimator> bandwidth_estimator_;
+  NetworkExecutor::Priority priority_;
+  size_t prefetch_depth_;
+  std::mutex tasks_mutex_;
+  std::condition_variable tasks_condition_;
+  size_t running_tasks_;
+  std::shared_ptr<const MediaSegmentSequence> sequence_;
+  // Sequences replaced by SwitchMediaSegmentSequence(), kept while their
+  // segments are downloaded.
+  std::vector<std::shared_ptr<const MediaSegmentSequence>> previous_sequences_;
   MediaSegmentSequence::Iterator next_segment_iterator_;
 
-  pp::Lock iterator_lock_;
+  mutable pp::Lock iterator_lock_;
   pp::CompletionCallbackFactory<AsyncDataProvider> cc_factory_;
-  size_t last_segment_size_;
+  std::atomic<size_t> last_segment_size_;
   std::function<void(std::unique_ptr<MediaSegment>)> data_segment_callback_;
+  std::atomic<bool> chunked_delivery_;
+  TuningProfile tuning_;
+  // Set by SetTaskExecutor(), replaces the message loop of the caller.
+  std::shared_ptr<TaskExecutor> caller_executor_;
+  PlaybackMetrics* playback_metrics_;
+  SegmentCache segment_cache_;
+  // Data of downloaded_segments_.
+  MemoryUsage pending_usage_;
+
+  // Members below are used on the caller thread only.
+  // Segments are numbered in request order and passed to the callback in
+  // the same order. Each number has a queue of downloaded chunks, which ends
+  // with the last chunk of a segment or with null if the download failed.
+  std::map<uint64_t, std::deque<std::unique_ptr<MediaSegment>>>
+      downloaded_segments_;
+  uint64_t next_request_number_;
+  uint64_t next_delivery_number_;
+  // Incremented whenever the next segment is changed, so downloads requested
+  // before can be dropped.
+  uint32_t generation_;
+  // Aborts downloads of the current generation. Guarded by iterator_lock_.
+  std::shared_ptr<CancellationToken> cancellation_token_;
+  bool end_of_stream_requested_;
+  Samsung::NaClPlayer::TimeTicks requested_end_time_;
+  // Cache keys of the init segment returned by GetInitSegment() and of the
+  // one needed by the last requested segment. Guarded by iterator_lock_.
+  std::string parsed_init_key_;
+  std::string requested_init_key_;
+  // Cache key and cancellation token of the last PrefetchSegment() request.
+  // Guarded by iterator_lock_.
+  std::string prefetch_key_;
+  std::shared_ptr<CancellationToken> prefetch_token_;
 };
 
 #endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_ASYNC_DATA_PROVIDER_H_
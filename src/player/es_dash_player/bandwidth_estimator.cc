@@ -0,0 +1,162 @@
+/*!
+ * bandwidth_estimator.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @author Piotr Bałut
+ */
+
+#include "bandwidth_estimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+
+#include "common.h"
+
+using pp::AutoLock;
+
+namespace {
+// Half-lives of the averages, in seconds of downloads.
+constexpr double kFastHalfLife = 2.0;
+constexpr double kSlowHalfLife = 5.0;
+// Smaller downloads are dominated by latency, so they're not used for the
+// bandwidth estimate.
+constexpr size_t kMinSampleBytes = 16 * 1024;
+// The estimate is not reported until this many seconds of downloads.
+constexpr double kMinTotalTime = 0.5;
+constexpr size_t kWindowSize = 20;
+constexpr double kBitsPerByte = 8.;
+constexpr const char* kSavedEstimateFile = "/bandwidth";
+// Older estimates say little about the current network.
+constexpr double kMaxSavedEstimateAge = 24. * 60. * 60.;  // seconds
+
+std::string SavedEstimatePath() {
+  std::string dir = GetTemporaryStorageDir();
+  return dir.empty() ? dir : dir + kSavedEstimateFile;
+}
+}
+
+BandwidthEstimator::Ewma::Ewma(double half_life)
+    : alpha_(std::exp(std::log(0.5) / half_life)),
+      estimate_(0.),
+      total_weight_(0.) {}
+
+void BandwidthEstimator::Ewma::Add(double weight, double value) {
+  double adjusted_alpha = std::pow(alpha_, weight);
+  estimate_ = value * (1. - adjusted_alpha) + adjusted_alpha * estimate_;
+  total_weight_ += weight;
+}
+
+double BandwidthEstimator::Ewma::Estimate() const {
+  double zero_factor = 1. - std::pow(alpha_, total_weight_);
+  if (zero_factor <= 0.) return 0.;
+  return estimate_ / zero_factor;
+}
+
+BandwidthEstimator::BandwidthEstimator()
+    : fast_(kFastHalfLife),
+      slow_(kSlowHalfLife),
+      total_time_(0.),
+      sample_count_(0) {}
+
+BandwidthEstimator::~BandwidthEstimator() {}
+
+std::string BandwidthEstimator::HostOf(const std::string& url) {
+  size_t begin = url.find("://");
+  begin = (begin == std::string::npos) ? 0 : begin + 3;
+  size_t end = url.find_first_of("/?#", begin);
+  return url.substr(begin, end == std::string::npos ? end : end - begin);
+}
+
+void BandwidthEstimator::AddSample(const DownloadSample& sample) {
+  AutoLock lock(lock_);
+  ++sample_count_;
+  window_.push_back(sample);
+  if (window_.size() > kWindowSize) window_.pop_front();
+
+  if (sample.bytes < kMinSampleBytes || sample.total_time <= 0.) return;
+
+  double bandwidth = sample.bytes * kBitsPerByte / sample.total_time;
+  fast_.Add(sample.total_time, bandwidth);
+  slow_.Add(sample.total_time, bandwidth);
+  total_time_ += sample.total_time;
+}
+
+double BandwidthEstimator::EstimatedBandwidth() const {
+  AutoLock lock(lock_);
+  if (total_time_ < kMinTotalTime) return 0.;
+  return std::min(fast_.Estimate(), slow_.Estimate());
+}
+
+double BandwidthEstimator::WindowBandwidth() const {
+  AutoLock lock(lock_);
+  double bytes = 0.;
+  double time = 0.;
+  for (const auto& sample : window_) {
+    bytes += sample.bytes;
+    time += sample.total_time;
+  }
+  if (time <= 0.) return 0.;
+  return bytes * kBitsPerByte / time;
+}
+
+double BandwidthEstimator::AverageTimeToFirstByte() const {
+  AutoLock lock(lock_);
+  if (window_.empty()) return 0.;
+
+  double sum = 0.;
+  for (const auto& sample : window_) sum += sample.time_to_first_byte;
+  return sum / window_.size();
+}
+
+std::vector<DownloadSample> BandwidthEstimator::RecentSamples() const {
+  AutoLock lock(lock_);
+  return std::vector<DownloadSample>(window_.begin(), window_.end());
+}
+
+uint64_t BandwidthEstimator::SampleCount() const {
+  AutoLock lock(lock_);
+  return sample_count_;
+}
+
+void BandwidthEstimator::SaveEstimate(double bandwidth) {
+  std::string path = SavedEstimatePath();
+  if (path.empty()) return;
+
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) return;
+  fprintf(file, "%.0f %lld\n", bandwidth,
+          static_cast<long long>(time(nullptr)));
+  fclose(file);
+}
+
+double BandwidthEstimator::LoadSavedEstimate() {
+  std::string path = SavedEstimatePath();
+  if (path.empty()) return 0.;
+
+  FILE* file = fopen(path.c_str(), "r");
+  if (!file) return 0.;
+  double bandwidth = 0.;
+  long long saved_at = 0;
+  int read = fscanf(file, "%lf %lld", &bandwidth, &saved_at);
+  fclose(file);
+  if (read != 2 || bandwidth <= 0.) return 0.;
+
+  double age = difftime(time(nullptr), static_cast<time_t>(saved_at));
+  if (age < 0. || age > kMaxSavedEstimateAge) return 0.;
+  return bandwidth;
+}
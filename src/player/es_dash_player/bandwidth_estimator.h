@@ -0,0 +1,113 @@
+/*!
+ * bandwidth_estimator.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_BANDWIDTH_ESTIMATOR_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_BANDWIDTH_ESTIMATOR_H_
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "ppapi/utility/threading/lock.h"
+
+#include "common.h"
+
+// A single segment download, as measured by the download path.
+struct DownloadSample {
+  size_t bytes = 0;
+  // Seconds until response headers were received.
+  double time_to_first_byte = 0.;
+  // Seconds until the first part of the body was received.
+  double time_to_first_body_byte = 0.;
+  // Seconds until the whole response was received.
+  double total_time = 0.;
+  std::string host;
+  std::string representation_id;
+  // Headers telling how the response was served, e.g. CDN cache status.
+  ResponseDiagnostics response;
+};
+
+// Estimates network bandwidth from segment download samples. It keeps a fast
+// and a slow exponentially weighted moving average, weighted by download
+// time, and reports the lower one, so the estimate drops quickly when the
+// network slows down but grows only when it's faster for a while. The most
+// recent samples are also kept in a sliding window. It's thread safe.
+class BandwidthEstimator {
+ public:
+  BandwidthEstimator();
+  ~BandwidthEstimator();
+
+  // Returns host part of url, e.g. "example.com:8080" for
+  // "http://example.com:8080/video/1.mp4".
+  static std::string HostOf(const std::string& url);
+
+  void AddSample(const DownloadSample& sample);
+
+  // Returns estimated bandwidth in bits per second, 0 if it's not known yet.
+  double EstimatedBandwidth() const;
+
+  // Returns bandwidth in bits per second measured over the sliding window,
+  // 0 if it's empty.
+  double WindowBandwidth() const;
+
+  // Returns average time to first byte over the sliding window in seconds.
+  double AverageTimeToFirstByte() const;
+
+  // Returns samples from the sliding window, the oldest first.
+  std::vector<DownloadSample> RecentSamples() const;
+
+  uint64_t SampleCount() const;
+
+  // Keeps an estimate in the temporary storage, so the next session can
+  // start with it. Both methods must not be called on the main thread.
+  static void SaveEstimate(double bandwidth);
+
+  // Returns an estimate saved by SaveEstimate() recently, 0 if there is
+  // none.
+  static double LoadSavedEstimate();
+
+ private:
+  // An exponentially weighted moving average with a half-life expressed in
+  // seconds of downloads.
+  class Ewma {
+   public:
+    explicit Ewma(double half_life);
+
+    void Add(double weight, double value);
+
+    // Corrects the bias towards 0 of the first samples.
+    double Estimate() const;
+
+   private:
+    double alpha_;
+    double estimate_;
+    double total_weight_;
+  };
+
+  mutable pp::Lock lock_;
+  Ewma fast_;
+  Ewma slow_;
+  // Seconds of downloads used by the averages.
+  double total_time_;
+  std::deque<DownloadSample> window_;
+  uint64_t sample_count_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_BANDWIDTH_ESTIMATOR_H_
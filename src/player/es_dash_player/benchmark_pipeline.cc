@@ -0,0 +1,229 @@
+/*!
+ * benchmark_pipeline.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include "player/es_dash_player/benchmark_pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "common.h"
+#include "dash/dash_manifest.h"
+#include "player/es_dash_player/packets_manager.h"
+
+#include "recording_es_backend.h"
+
+using pp::AutoLock;
+using Samsung::NaClPlayer::TimeTicks;
+using std::string;
+using std::vector;
+
+namespace {
+
+constexpr int32_t kNeedDataBytes = 1024 * 1024;
+
+// Set while ReplayCache downloads a resource, so the download is not
+// served by the cache itself.
+__thread bool replay_fetch = false;
+
+}  // anonymous namespace
+
+ReplayCache::ReplayCache(const NetworkSimulation::Trace& trace)
+    : link_(trace.points),
+      time_(0.),
+      misses_(0) {}
+
+bool ReplayCache::Read(const SegmentDescriptor& location,
+                       vector<uint8_t>* data) {
+  if (replay_fetch) return false;
+  string key = location.url + " " + location.range;
+  std::shared_ptr<const vector<uint8_t>> resource;
+  {
+    AutoLock critical_section(lock_);
+    auto it = resources_.find(key);
+    if (it != resources_.end()) resource = it->second;
+  }
+  if (!resource) {
+    vector<uint8_t> downloaded;
+    replay_fetch = true;
+    bool ok = DownloadSegment(location, &downloaded);
+    replay_fetch = false;
+    if (!ok) return false;
+    resource = std::make_shared<const vector<uint8_t>>(
+        std::move(downloaded));
+    AutoLock critical_section(lock_);
+    resources_[key] = resource;
+    ++misses_;
+  }
+  data->assign(resource->begin(), resource->end());
+
+  AutoLock critical_section(lock_);
+  double time_to_first_byte;
+  time_ += link_.Download(time_, resource->size(), &time_to_first_byte);
+  return true;
+}
+
+double ReplayCache::Time() const {
+  AutoLock critical_section(lock_);
+  return time_;
+}
+
+void ReplayCache::AdvanceTo(double time) {
+  AutoLock critical_section(lock_);
+  time_ = std::max(time_, time);
+}
+
+uint32_t ReplayCache::Misses() const {
+  AutoLock critical_section(lock_);
+  return misses_;
+}
+
+void ReplayCache::Clear() {
+  AutoLock critical_section(lock_);
+  resources_.clear();
+}
+
+BenchmarkPipeline::BenchmarkPipeline(const pp::InstanceHandle& instance,
+                                     DashManifest* manifest,
+                                     ReplayCache* replay_cache)
+    : instance_(instance),
+      manifest_(manifest),
+      replay_cache_(replay_cache),
+      clock_(0.),
+      drm_type_(Samsung::NaClPlayer::DRMType_Unknown),
+      drm_metrics_(nullptr) {}
+
+BenchmarkPipeline::~BenchmarkPipeline() {
+  if (packets_manager_) {
+    packets_manager_->SetStream(StreamType::Video, nullptr);
+    packets_manager_->SetStream(StreamType::Audio, nullptr);
+  }
+  // Streams wait for their downloads, which use the other members.
+  for (auto& stream : streams_) stream.reset();
+}
+
+void BenchmarkPipeline::SetDrm(Samsung::NaClPlayer::DRMType drm_type,
+                               DrmMetrics* metrics) {
+  drm_type_ = drm_type;
+  drm_metrics_ = metrics;
+}
+
+bool BenchmarkPipeline::Start(int32_t video_id, int32_t audio_id) {
+  executor_ = std::make_shared<SimulatedExecutor>();
+  backend_ = MakeUnique<RecordingEsBackend>(false);
+  tuning_ = TuningProfile::Current();
+  packets_manager_ = MakeUnique<PacketsManager>(tuning_);
+  if (!StartStream(StreamType::Video, video_id) ||
+      (audio_id >= 0 && !StartStream(StreamType::Audio, audio_id)))
+    return false;
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    if (streams_[i])
+      backend_->NeedData(static_cast<StreamType>(i), kNeedDataBytes);
+  }
+  return true;
+}
+
+void BenchmarkPipeline::Step(TimeTicks playback_time) {
+  executor_->RunUntilIdle();
+  // The simulated clock follows the link.
+  auto link_ms = static_cast<int64_t>(replay_cache_->Time() * 1e3);
+  auto clock_ms = static_cast<int64_t>(clock_ * 1e3);
+  if (link_ms > clock_ms) {
+    executor_->AdvanceBy(std::chrono::milliseconds(link_ms - clock_ms));
+    clock_ = link_ms / 1e3;
+  }
+  for (const auto& stream : streams_)
+    if (stream) stream->UpdateBuffer(playback_time);
+  packets_manager_->UpdateBuffer(playback_time);
+}
+
+TimeTicks BenchmarkPipeline::PrepareSeek(TimeTicks time) {
+  TimeTicks to_time = stream(StreamType::Video)->GetClosestKeyframeTime(time);
+  bool in_buffer = packets_manager_->CanSeekInBuffer(to_time);
+  for (const auto& stream : streams_)
+    if (stream) stream->PrepareForSeek(to_time, in_buffer);
+  packets_manager_->PrepareForSeek(to_time, in_buffer);
+  return to_time;
+}
+
+void BenchmarkPipeline::CompletePlatformSeek(TimeTicks to_time) {
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    if (!streams_[i]) continue;
+    backend_->SeekData(static_cast<StreamType>(i), to_time);
+    backend_->NeedData(static_cast<StreamType>(i), kNeedDataBytes);
+  }
+}
+
+void BenchmarkPipeline::CancelSeek() {
+  for (const auto& stream : streams_)
+    if (stream) stream->CancelSeek();
+}
+
+bool BenchmarkPipeline::ChangeRepresentation(StreamType type, int32_t id,
+                                             bool replace_buffered) {
+  StreamManager* stream_manager = stream(type);
+  auto sequence = manifest_->GetSequence(static_cast<MediaStreamType>(type),
+                                         id);
+  if (!stream_manager || !sequence) return false;
+  stream_manager->SetMediaSegmentSequence(std::move(sequence),
+                                          replace_buffered);
+  return true;
+}
+
+bool BenchmarkPipeline::IsSettled() const {
+  for (const auto& stream : streams_)
+    if (stream && stream->GetPendingSegments() > 0) return false;
+  return true;
+}
+
+bool BenchmarkPipeline::StartStream(StreamType type, int32_t id) {
+  auto sequence = manifest_->GetSequence(static_cast<MediaStreamType>(type),
+                                         id);
+  if (!sequence) {
+    LOG_ERROR("No sequence of representation %d", id);
+    return false;
+  }
+  auto& stream = streams_[static_cast<size_t>(type)];
+  stream = MakeUnique<StreamManager>(instance_, type, tuning_);
+  stream->SetTaskExecutor(executor_);
+  stream->SetDrmMetrics(drm_metrics_);
+  if (!stream->AddStream(backend_.get())) return false;
+
+  PacketsManager* packets_manager = packets_manager_.get();
+  auto es_packet_callback = [packets_manager, type](
+      StreamDemuxer::Message message,
+      std::unique_ptr<ElementaryStreamPacket> packet) {
+    if (message == StreamDemuxer::kEndOfStream)
+      packets_manager->OnEndOfStream(type);
+    else
+      packets_manager->OnEsPacket(message, std::move(packet));
+  };
+  auto es_packets_callback = [packets_manager](
+      StreamDemuxer::Message message, StreamDemuxer::PacketBatch packets) {
+    packets_manager->OnEsPackets(message, std::move(packets));
+  };
+  bool success = stream->Initialize(std::move(sequence), {}, backend_.get(),
+      [](StreamType) {}, es_packet_callback, es_packets_callback,
+      packets_manager, drm_type_);
+  packets_manager_->SetStream(type, stream.get());
+  if (!success) LOG_ERROR("Failed to initialize stream %d", id);
+  return success;
+}
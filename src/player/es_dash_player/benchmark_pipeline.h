@@ -0,0 +1,141 @@
+/*!
+ * benchmark_pipeline.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_BENCHMARK_PIPELINE_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_BENCHMARK_PIPELINE_H_
+
+#include <array>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "nacl_player/media_common.h"
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/utility/threading/lock.h"
+
+#include "dash/media_segment_sequence.h"
+#include "player/es_dash_player/network_simulation.h"
+#include "player/es_dash_player/stream_manager.h"
+
+class DashManifest;
+class DrmMetrics;
+class PacketsManager;
+class RecordingEsBackend;
+
+// Serves resources from memory as a LocalDataSource, downloading each one
+// for real the first time it's requested. Served resources take the time
+// of a simulated link, one after another. It's used by download threads.
+class ReplayCache {
+ public:
+  explicit ReplayCache(const NetworkSimulation::Trace& trace);
+
+  bool Read(const SegmentDescriptor& location, std::vector<uint8_t>* data);
+
+  // Seconds of the link spent so far, serving resources or idle.
+  double Time() const;
+
+  // Lets the link idle until time, e.g. while the playback catches up.
+  void AdvanceTo(double time);
+
+  // Requests which were not found in memory.
+  uint32_t Misses() const;
+
+  // Drops resources of the previous content.
+  void Clear();
+
+ private:
+  mutable pp::Lock lock_;
+  NetworkSimulation::Link link_;
+  std::map<std::string, std::shared_ptr<const std::vector<uint8_t>>>
+      resources_;
+  double time_;
+  uint32_t misses_;
+};
+
+// A video stream and an optional audio stream of a manifest, demuxed and
+// passed through a PacketsManager to a RecordingEsBackend. Stream tasks run
+// on a SimulatedExecutor, whose clock follows the link of a ReplayCache.
+// It's driven by Step() calls on a thread with a message loop, which
+// dispatches demuxer callbacks between the steps.
+class BenchmarkPipeline {
+ public:
+  BenchmarkPipeline(const pp::InstanceHandle& instance,
+                    DashManifest* manifest, ReplayCache* replay_cache);
+  ~BenchmarkPipeline();
+
+  // Makes streams take the protected append path of the given DRM, which
+  // measures encrypted appends into metrics. Must be called before Start().
+  void SetDrm(Samsung::NaClPlayer::DRMType drm_type, DrmMetrics* metrics);
+
+  // Creates streams of the given representations, no audio one if audio_id
+  // is negative, and asks for their packets.
+  bool Start(int32_t video_id, int32_t audio_id);
+
+  // Runs due stream tasks, moves the clock to the link time and updates
+  // buffers for the playback position.
+  void Step(Samsung::NaClPlayer::TimeTicks playback_time);
+
+  // Like EsDashPlayerController::Seek(), without the platform seek. Returns
+  // the position the streams seek to.
+  Samsung::NaClPlayer::TimeTicks PrepareSeek(
+      Samsung::NaClPlayer::TimeTicks time);
+
+  // What NaCl Player does once a seek is made.
+  void CompletePlatformSeek(Samsung::NaClPlayer::TimeTicks to_time);
+
+  // Aborts the seek in progress, which is superseded by the next one.
+  void CancelSeek();
+
+  // Like EsDashPlayerController::ChangeRepresentation().
+  bool ChangeRepresentation(StreamType type, int32_t id,
+                            bool replace_buffered);
+
+  // Streams downloaded segments up to their threshold.
+  bool IsSettled() const;
+
+  bool HasAudio() const { return stream(StreamType::Audio) != nullptr; }
+
+  StreamManager* stream(StreamType type) const {
+    return streams_[static_cast<size_t>(type)].get();
+  }
+
+  RecordingEsBackend* backend() const { return backend_.get(); }
+
+ private:
+  bool StartStream(StreamType type, int32_t id);
+
+  pp::InstanceHandle instance_;
+  DashManifest* manifest_;
+  ReplayCache* replay_cache_;
+  std::shared_ptr<SimulatedExecutor> executor_;
+  // The profile taken by Start(), shared by all parts of the pipeline.
+  TuningProfile tuning_;
+  // Streams are destroyed first, see ~BenchmarkPipeline().
+  std::unique_ptr<RecordingEsBackend> backend_;
+  std::unique_ptr<PacketsManager> packets_manager_;
+  std::array<std::unique_ptr<StreamManager>,
+             static_cast<size_t>(StreamType::MaxStreamTypes)> streams_;
+  // Seconds of the simulated clock.
+  double clock_;
+  Samsung::NaClPlayer::DRMType drm_type_;
+  DrmMetrics* drm_metrics_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_BENCHMARK_PIPELINE_H_
@@ -0,0 +1,328 @@
+/*!
+ * dash_preloader.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include "dash_preloader.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "ppapi/cpp/message_loop.h"
+
+#include "dash/base_url_selector.h"
+#include "dash/dash_manifest.h"
+#include "dash/media_stream.h"
+#include "dash/util.h"
+
+#include "abr_engine.h"
+#include "bandwidth_estimator.h"
+#include "drm_play_ready.h"
+#include "network_executor.h"
+#include "segment_cache.h"
+
+using pp::AutoLock;
+
+namespace {
+
+// Duration of media downloaded from the beginning of each stream, enough for
+// a playback to start.
+constexpr double kPreloadedDuration = 4.;  // seconds
+
+// How often update periods of warm dynamic titles are checked.
+constexpr int32_t kWarmRefreshCheckDelay = 1000;  // milliseconds
+
+// Manifests of warm titles aren't refreshed more often, whatever their
+// MPD@minimumUpdatePeriod is.
+constexpr double kMinWarmRefreshPeriod = 2.;  // seconds
+
+// Creates a sequence of the representation a playback would start with.
+template<typename RepType>
+std::shared_ptr<const MediaSegmentSequence> ChooseSequence(
+    StreamType type, const std::vector<RepType>& representations,
+    DashManifest* manifest, AbrEngine* abr_engine) {
+  if (representations.empty()) return nullptr;
+
+  // The same choice as the player makes at startup, apart from a limit of
+  // the view size which isn't known yet.
+  RepType highest = GetHighestBitrateStream(representations);
+  std::vector<AbrCandidate> candidates;
+  for (const auto& representation : representations) {
+    if (IsSameKind(representation, highest))
+      candidates.push_back(MakeAbrCandidate(representation));
+  }
+  abr_engine->SetCandidates(type, std::move(candidates),
+                            highest.description.id);
+  return manifest->GetSequence(static_cast<MediaStreamType>(type),
+                               abr_engine->ChooseInitial(type));
+}
+
+// Downloads the init segment and the first media segments of sequence to
+// cache, as long as they fit in the byte budget of media.
+void PreloadSequence(const MediaSegmentSequence* sequence, bool dynamic,
+                     SegmentCache* cache, PreloadedMedia* media) {
+  if (!sequence) return;
+
+  std::vector<uint8_t> data;
+  auto init_segment = sequence->GetInitSegment();
+  std::string key = SegmentCache::KeyFor(init_segment.get());
+  if (!key.empty() && DownloadSegment(init_segment.get(), &data)) {
+    if (media->CachedBytes() + data.size() > media->ByteBudget()) return;
+    cache->Put(key, data, true);
+  }
+
+  // The live edge moves on until a playback starts, so only init segments
+  // of dynamic presentations are worth downloading in advance.
+  if (dynamic) return;
+
+  double preloaded_duration = 0.;
+  for (auto it = sequence->StartSegment();
+       it != sequence->End() && preloaded_duration < kPreloadedDuration;
+       ++it) {
+    SegmentDescriptor segment;
+    if (!sequence->GetSegmentDescriptor(it, &segment)) return;
+    uint64_t size = sequence->SegmentSize(it);
+    if (media->CachedBytes() + size > media->ByteBudget()) return;
+
+    if (size > 0) data.reserve(size);
+    if (!DownloadSegment(segment, &data, nullptr,
+                         media->GetCancellationToken()))
+      return;
+    if (media->CachedBytes() + data.size() > media->ByteBudget()) return;
+    cache->Put(SegmentCache::KeyFor(segment), data);
+
+    double duration = sequence->SegmentDuration(it);
+    if (duration <= 0.) return;
+    preloaded_duration += duration;
+  }
+}
+
+}  // namespace
+
+PreloadedMedia::PreloadedMedia(const std::string& url, size_t byte_budget)
+    : url_(url),
+      byte_budget_(byte_budget),
+      cancellation_token_(MakeUnique<CancellationToken>()),
+      lock_(),
+      manifest_(),
+      has_resume_point_(false),
+      resume_point_() {
+  // Each cache could hold the whole budget, CachedBytes() of all of them
+  // together is checked before segments are stored.
+  for (auto& cache : segments_)
+    cache = MakeUnique<SegmentCache>(byte_budget);
+}
+
+PreloadedMedia::~PreloadedMedia() {}
+
+void PreloadedMedia::StopDownloads() {
+  cancellation_token_->Cancel();
+}
+
+std::shared_ptr<DashManifest> PreloadedMedia::GetManifest() const {
+  AutoLock lock(lock_);
+  return manifest_;
+}
+
+void PreloadedMedia::SetManifest(std::shared_ptr<DashManifest> manifest) {
+  AutoLock lock(lock_);
+  manifest_ = std::move(manifest);
+}
+
+bool PreloadedMedia::GetResumePoint(ResumePoint* point) const {
+  AutoLock lock(lock_);
+  if (!has_resume_point_) return false;
+  *point = resume_point_;
+  return true;
+}
+
+void PreloadedMedia::SetResumePoint(const ResumePoint& point) {
+  AutoLock lock(lock_);
+  resume_point_ = point;
+  has_resume_point_ = true;
+}
+
+size_t PreloadedMedia::CachedBytes() const {
+  size_t bytes = 0;
+  for (const auto& cache : segments_)
+    bytes += cache->CachedBytes();
+  return bytes;
+}
+
+DashPreloader::DashPreloader(std::shared_ptr<WorkerPool> worker_pool,
+                             size_t byte_budget)
+    : byte_budget_(byte_budget),
+      cc_factory_(this),
+      executor_(MakeUnique<NetworkExecutor>(std::move(worker_pool), 1)),
+      media_(),
+      warm_media_(),
+      warm_refresh_scheduled_(false) {}
+
+DashPreloader::~DashPreloader() {
+  if (media_) media_->StopDownloads();
+  for (auto& warm : warm_media_)
+    warm.media->StopDownloads();
+}
+
+void DashPreloader::Preload(const std::string& url) {
+  if (media_ && media_->Url() == url) return;
+
+  if (media_) media_->StopDownloads();
+  LOG_INFO("Preloading: %s", url.c_str());
+  media_ = std::make_shared<PreloadedMedia>(url, byte_budget_);
+  executor_->Post(NetworkExecutor::Priority::kPrefetch,
+      cc_factory_.NewCallback(&DashPreloader::PreloadOnWorker, media_));
+}
+
+void DashPreloader::SetWarmMedia(const std::vector<std::string>& urls) {
+  std::vector<WarmMedia> warm_media;
+  for (const auto& url : urls) {
+    if (warm_media.size() == kMaxWarmMedia) break;
+    // Entries moved to warm_media are left without media.
+    auto has_url = [&url](const WarmMedia& warm) {
+      return warm.media && warm.media->Url() == url;
+    };
+    if (std::any_of(warm_media.begin(), warm_media.end(), has_url)) continue;
+
+    auto it = std::find_if(warm_media_.begin(), warm_media_.end(), has_url);
+    if (it != warm_media_.end()) {
+      warm_media.push_back(std::move(*it));
+      continue;
+    }
+    LOG_INFO("Keeping warm: %s", url.c_str());
+    auto media = std::make_shared<PreloadedMedia>(
+        url, byte_budget_ / kMaxWarmMedia);
+    executor_->Post(NetworkExecutor::Priority::kPrefetch,
+        cc_factory_.NewCallback(&DashPreloader::PreloadOnWorker, media));
+    warm_media.push_back({std::move(media), Clock::time_point()});
+  }
+
+  for (auto& warm : warm_media_) {
+    if (warm.media) warm.media->StopDownloads();
+  }
+  warm_media_ = std::move(warm_media);
+  ScheduleWarmRefresh();
+}
+
+std::shared_ptr<PreloadedMedia> DashPreloader::Take(const std::string& url) {
+  std::shared_ptr<PreloadedMedia> media;
+  if (media_ && media_->Url() == url) {
+    media = std::move(media_);
+  } else {
+    auto it = std::find_if(warm_media_.begin(), warm_media_.end(),
+        [&url](const WarmMedia& warm) { return warm.media->Url() == url; });
+    if (it == warm_media_.end()) return nullptr;
+    media = std::move(it->media);
+    warm_media_.erase(it);
+  }
+
+  media->StopDownloads();
+  return media;
+}
+
+void DashPreloader::KeepSuspended(std::shared_ptr<PreloadedMedia> media) {
+  if (media_) media_->StopDownloads();
+  LOG_INFO("Keeping a suspended playback of: %s", media->Url().c_str());
+  media_ = std::move(media);
+}
+
+void DashPreloader::PreloadOnWorker(int32_t,
+    const std::shared_ptr<PreloadedMedia>& media) {
+  if (media->GetCancellationToken()->IsCancelled()) return;
+
+  // Base URLs registered while the manifest is parsed start with scores of
+  // previous sessions.
+  BaseUrlSelector::Get().LoadScores();
+  auto visitor = MakeUnique<DrmPlayReadyContentProtectionVisitor>();
+  std::string mpd_data;
+  std::shared_ptr<DashManifest> manifest;
+  if (DashManifest::DownloadManifest(media->Url(), &mpd_data))
+    manifest = DashManifest::ParseMPD(media->Url(), mpd_data, visitor.get());
+  if (!manifest) {
+    LOG_ERROR("Failed to preload manifest: %s", media->Url().c_str());
+    return;
+  }
+  media->SetManifest(manifest);
+
+  // The estimate saved by the running playback is used, so the choice is
+  // close to the one a player of this title would make. Video is chosen
+  // first, as audio gets the bandwidth which video doesn't need.
+  AbrEngine abr_engine(std::make_shared<BandwidthEstimator>(),
+                       AbrRule::Create(AbrRule::Type::kHybrid));
+  abr_engine.SetSavedBandwidth(BandwidthEstimator::LoadSavedEstimate());
+  auto video = ChooseSequence(StreamType::Video, manifest->GetVideoStreams(),
+                              manifest.get(), &abr_engine);
+  auto audio = ChooseSequence(StreamType::Audio, manifest->GetAudioStreams(),
+                              manifest.get(), &abr_engine);
+  // Audio segments are small, so they fit in the budget whatever video
+  // bitrate is chosen.
+  PreloadSequence(audio.get(), manifest->IsDynamic(),
+                  media->GetSegmentCache(StreamType::Audio), media.get());
+  PreloadSequence(video.get(), manifest->IsDynamic(),
+                  media->GetSegmentCache(StreamType::Video), media.get());
+  LOG_INFO("Preloaded %zu bytes of: %s", media->CachedBytes(),
+           media->Url().c_str());
+}
+
+void DashPreloader::ScheduleWarmRefresh() {
+  if (warm_refresh_scheduled_ || warm_media_.empty()) return;
+
+  warm_refresh_scheduled_ = true;
+  pp::MessageLoop::GetForMainThread().PostWork(
+      cc_factory_.NewCallback(&DashPreloader::RefreshWarmMedia),
+      kWarmRefreshCheckDelay);
+}
+
+void DashPreloader::RefreshWarmMedia(int32_t) {
+  warm_refresh_scheduled_ = false;
+  auto now = Clock::now();
+  for (auto& warm : warm_media_) {
+    // Manifests which aren't parsed yet are checked again later.
+    auto manifest = warm.media->GetManifest();
+    if (!manifest || !manifest->IsDynamic() ||
+        manifest->GetMinimumUpdatePeriod() < 0.)
+      continue;
+
+    // The first period starts when the preloaded manifest is noticed.
+    bool preloaded = warm.next_refresh == Clock::time_point();
+    if (!preloaded && now < warm.next_refresh) continue;
+    double period = std::max(manifest->GetMinimumUpdatePeriod(),
+                             kMinWarmRefreshPeriod);
+    warm.next_refresh = now + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(period));
+    if (preloaded) continue;
+
+    executor_->Post(NetworkExecutor::Priority::kPrefetch,
+        cc_factory_.NewCallback(&DashPreloader::RefreshOnWorker, warm.media));
+  }
+  ScheduleWarmRefresh();
+}
+
+void DashPreloader::RefreshOnWorker(int32_t,
+    const std::shared_ptr<PreloadedMedia>& media) {
+  // A title taken by a player is refreshed by it.
+  if (media->GetCancellationToken()->IsCancelled()) return;
+
+  // Only timelines are updated, the live edge of a player which takes the
+  // title is computed when it starts. A failed refresh is retried after
+  // the update period.
+  if (media->GetManifest()->Refresh())
+    LOG_DEBUG("Refreshed a warm manifest: %s", media->Url().c_str());
+}
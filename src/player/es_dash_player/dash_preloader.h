@@ -0,0 +1,160 @@
+/*!
+ * dash_preloader.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_DASH_PRELOADER_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_DASH_PRELOADER_H_
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/lock.h"
+
+#include "common.h"
+
+class DashManifest;
+class NetworkExecutor;
+class WorkerPool;
+class SegmentCache;
+
+// A title prepared by DashPreloader. Its manifest is set on a network worker
+// once it's parsed. Segments of each stream are cached separately, so they
+// can be handed to the data provider of that stream. It's thread safe.
+class PreloadedMedia {
+ public:
+  // Where a playback of the title was when the application was suspended.
+  struct ResumePoint {
+    double time;  // in seconds
+    // Ids of representations of streams, -1 for streams which weren't
+    // played.
+    std::array<int32_t, static_cast<size_t>(StreamType::MaxStreamTypes)>
+        representation_ids;
+    double bandwidth;  // bits per second, 0 if it wasn't estimated
+  };
+
+  PreloadedMedia(const std::string& url, size_t byte_budget);
+  ~PreloadedMedia();
+
+  const std::string& Url() const { return url_; }
+
+  // Aborts downloads of segments. A manifest which is being downloaded is
+  // still parsed.
+  void StopDownloads();
+
+  CancellationToken* GetCancellationToken() {
+    return cancellation_token_.get();
+  }
+
+  // Returns null until the manifest is parsed.
+  std::shared_ptr<DashManifest> GetManifest() const;
+  void SetManifest(std::shared_ptr<DashManifest> manifest);
+
+  SegmentCache* GetSegmentCache(StreamType type) {
+    return segments_[static_cast<size_t>(type)].get();
+  }
+
+  // Returns false if the title wasn't kept by a suspended playback.
+  bool GetResumePoint(ResumePoint* point) const;
+  void SetResumePoint(const ResumePoint& point);
+
+  // Segments of all streams are kept within the budget.
+  size_t ByteBudget() const { return byte_budget_; }
+  size_t CachedBytes() const;
+
+ private:
+  std::string url_;
+  size_t byte_budget_;
+  std::unique_ptr<CancellationToken> cancellation_token_;
+  mutable pp::Lock lock_;
+  std::shared_ptr<DashManifest> manifest_;
+  bool has_resume_point_;
+  ResumePoint resume_point_;
+  std::array<std::unique_ptr<SegmentCache>,
+             static_cast<size_t>(StreamType::MaxStreamTypes)> segments_;
+};
+
+// Prepares a title which is likely to be played next, e.g. the next episode,
+// while another one plays. Its manifest is downloaded and parsed, then init
+// segments and the first media segments of representations a playback would
+// start with are downloaded, as long as they fit in the byte budget. A player
+// of the same URL takes them instead of downloading them again. Downloads run
+// one at a time at the prefetch priority on workers shared with players, so
+// they don't compete with streams of a running playback much.
+//
+// Apart from that title, a few warm ones can be kept, e.g. live channels
+// next to the current one in an EPG. Their manifests are refreshed in the
+// background, so zapping to one of them starts at the live edge without
+// downloading and parsing its manifest or its init segments. It's used on
+// the main thread.
+class DashPreloader {
+ public:
+  static constexpr size_t kDefaultByteBudget = 16 * 1024 * 1024;
+  static constexpr size_t kMaxWarmMedia = 4;
+
+  explicit DashPreloader(std::shared_ptr<WorkerPool> worker_pool,
+                         size_t byte_budget = kDefaultByteBudget);
+  ~DashPreloader();
+
+  // Starts preparing url in the background. A title prepared before is
+  // dropped, unless it's the same one.
+  void Preload(const std::string& url);
+
+  // Keeps the first kMaxWarmMedia of urls warm, most likely ones first.
+  // Titles which are already warm are kept as they are, others are dropped.
+  // Each of them gets an equal part of the byte budget.
+  void SetWarmMedia(const std::vector<std::string>& urls);
+
+  // Returns the title prepared or kept warm for url, or null if there is
+  // none. Downloads of it are stopped, it's passed to a player as it is.
+  std::shared_ptr<PreloadedMedia> Take(const std::string& url);
+
+  // Keeps a title of a playback suspended with the application, with its
+  // manifest, segments and resume point, until a player of its URL takes
+  // it. It replaces a title prepared by Preload().
+  void KeepSuspended(std::shared_ptr<PreloadedMedia> media);
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct WarmMedia {
+    std::shared_ptr<PreloadedMedia> media;
+    Clock::time_point next_refresh;
+  };
+
+  void PreloadOnWorker(int32_t, const std::shared_ptr<PreloadedMedia>& media);
+  void ScheduleWarmRefresh();
+  // Refreshes manifests of warm dynamic titles which update period passed.
+  void RefreshWarmMedia(int32_t);
+  void RefreshOnWorker(int32_t, const std::shared_ptr<PreloadedMedia>& media);
+
+  size_t byte_budget_;
+  pp::CompletionCallbackFactory<DashPreloader> cc_factory_;
+  // Runs a single task at a time on shared workers. Its running task
+  // finishes before cc_factory_ is destroyed.
+  std::unique_ptr<NetworkExecutor> executor_;
+  std::shared_ptr<PreloadedMedia> media_;
+  std::vector<WarmMedia> warm_media_;
+  bool warm_refresh_scheduled_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_DASH_PRELOADER_H_
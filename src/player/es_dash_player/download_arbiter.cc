@@ -0,0 +1,61 @@
+/*!
+ * download_arbiter.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include "download_arbiter.h"
+
+using pp::AutoLock;
+
+DownloadArbiter::DownloadArbiter(size_t budget) : budget_(budget) {}
+
+DownloadArbiter::~DownloadArbiter() {}
+
+void DownloadArbiter::Update(StreamType type, size_t pending) {
+  AutoLock lock(lock_);
+  StreamState& stream = streams_[static_cast<size_t>(type)];
+  stream.pending = pending;
+  stream.waiting = false;
+}
+
+bool DownloadArbiter::Request(StreamType type, double health) {
+  AutoLock lock(lock_);
+  StreamState& stream = streams_[static_cast<size_t>(type)];
+  size_t running = 0;
+  bool yields = false;
+  for (const auto& other : streams_) {
+    running += other.pending;
+    if (&other != &stream && other.waiting && other.health < health)
+      yields = true;
+  }
+
+  if (running >= budget_ || yields) {
+    stream.waiting = true;
+    stream.health = health;
+    return false;
+  }
+  ++stream.pending;
+  stream.waiting = false;
+  return true;
+}
+
+void DownloadArbiter::Remove(StreamType type) {
+  AutoLock lock(lock_);
+  streams_[static_cast<size_t>(type)] = StreamState();
+}
@@ -0,0 +1,70 @@
+/*!
+ * download_arbiter.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_DOWNLOAD_ARBITER_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_DOWNLOAD_ARBITER_H_
+
+#include <array>
+#include <cstddef>
+
+#include "ppapi/utility/threading/lock.h"
+
+#include "common.h"
+
+// Shares segment downloads of audio and video streams. At most a budget of
+// downloads of all streams run at the same time, and a stream asking for
+// another one gets it only if no other stream which waits for a download
+// has less buffered (relative to its target). So a large video download
+// doesn't start while a nearly empty audio buffer waits. Streams report
+// their state on each buffer update, see StreamManager::UpdateBuffer().
+// It's thread safe.
+class DownloadArbiter {
+ public:
+  // budget is the number of downloads of all streams running at the same
+  // time, each stream is limited by its prefetch depth too.
+  explicit DownloadArbiter(size_t budget);
+  ~DownloadArbiter();
+
+  // Starts a buffer update of a stream, pending is the number of its
+  // running downloads. The stream stops waiting for a download.
+  void Update(StreamType type, size_t pending);
+
+  // Asks for another download of a stream. health is time buffered ahead
+  // of the playback position divided by the target buffer of the stream.
+  // Returns true if the download may start, otherwise the stream waits
+  // with that health until its next Update().
+  bool Request(StreamType type, double health);
+
+  // Forgets a stream which doesn't download anymore.
+  void Remove(StreamType type);
+
+ private:
+  struct StreamState {
+    size_t pending = 0;
+    bool waiting = false;
+    double health = 0.;
+  };
+
+  mutable pp::Lock lock_;
+  size_t budget_;
+  std::array<StreamState, static_cast<size_t>(StreamType::MaxStreamTypes)>
+      streams_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_DOWNLOAD_ARBITER_H_
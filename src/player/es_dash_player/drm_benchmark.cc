@@ -0,0 +1,277 @@
+/*!
+ * drm_benchmark.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+
+#define LOG_CATEGORY LogCategory::kDrm
+
+#include "player/es_dash_player/drm_benchmark.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "common.h"
+#include "dash/dash_manifest.h"
+#include "dash/media_stream.h"
+#include "dash/util.h"
+#include "player/es_dash_player/benchmark_pipeline.h"
+
+#include "drm_play_ready.h"
+#include "recording_es_backend.h"
+
+using Samsung::NaClPlayer::DRMType_Playready;
+using Samsung::NaClPlayer::TimeTicks;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The link segments are replayed over, see NetworkSimulation::DefaultTraces.
+const char kTraceName[] = "dsl";
+
+// Served by the LocalDataSource of the benchmark only.
+const char kLicenseUrl[] = "http://drm-benchmark.invalid/rightsmanager.asmx";
+
+// A challenge as the CDM sends it, with data after the SOAP envelope which
+// isn't sent to the server.
+const char kChallenge[] =
+    "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+    "<soap:Envelope xmlns:soap=\"http://schemas.xmlsoap.org/soap/envelope/\">"
+    "<soap:Body><AcquireLicense xmlns=\"http://schemas.microsoft.com/DRM/"
+    "2007/03/protocols\"><challenge><Challenge><LA><Version>1</Version>"
+    "<ContentHeader><WRMHEADER version=\"4.0.0.0\"><DATA><LA_URL>"
+    "http://drm-benchmark.invalid/rightsmanager.asmx</LA_URL></DATA>"
+    "</WRMHEADER></ContentHeader></LA></Challenge></challenge>"
+    "</AcquireLicense></soap:Body></soap:Envelope>\r\n\r\n";
+
+// Some servers put data into the HTTP body before the XML.
+const char kLicenseResponse[] =
+    "\r\n<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+    "<soap:Envelope xmlns:soap=\"http://schemas.xmlsoap.org/soap/envelope/\">"
+    "<soap:Body><AcquireLicenseResponse xmlns=\"http://schemas.microsoft.com/"
+    "DRM/2007/03/protocols\"><AcquireLicenseResult><Response>"
+    "<LicenseResponse><Version>1</Version><Licenses><License>"
+    "WE1SAAAAAANtHSY9EpvluoRHZaggdNEeAAMAAQAAAZ4AAwACAAAAMgABAA0AAAAKAAEAAAAz"
+    "AAAACgABAAEAMgAAAAwAAABMAAEANAAAAAoH0AACAAQAAABeAAEABQAAABIBkAEAAPoA"
+    "</License></Licenses></LicenseResponse></Response></AcquireLicenseResult>"
+    "</AcquireLicenseResponse></soap:Body></soap:Envelope>";
+
+const char kXmlTag[] = "<?xml";
+
+constexpr uint32_t kLicenseRequests = 200;
+// Playback of longer content is simulated up to that position.
+constexpr TimeTicks kMaxContentTime = 120.;  // seconds
+// Content which ends within that much of the end is played to the end.
+constexpr TimeTicks kEndMargin = 1.;  // seconds
+// Packets stop when no video packet is appended for that much link time.
+constexpr double kStallTimeout = 30.;  // seconds
+// The link idles that much per step when streams download nothing.
+constexpr double kIdleStep = 0.1;  // seconds
+
+}  // anonymous namespace
+
+DrmBenchmark::DrmBenchmark(const pp::InstanceHandle& instance)
+    : instance_(instance),
+      cc_factory_(this),
+      running_(false),
+      cancelled_(false),
+      licenses_requested_(0),
+      content_end_(0.),
+      last_pts_(-1.),
+      progress_time_(0.),
+      thread_(instance) {
+  thread_.Start();
+}
+
+DrmBenchmark::~DrmBenchmark() {
+  cancelled_ = true;
+  thread_.Join();
+}
+
+bool DrmBenchmark::Start(const string& manifest_url,
+                         const ResultCallback& callback) {
+  if (running_.exchange(true)) {
+    LOG_ERROR("A DRM benchmark is running already");
+    return false;
+  }
+  manifest_url_ = manifest_url;
+  callback_ = callback;
+  thread_.message_loop().PostWork(cc_factory_.NewCallback(
+      &DrmBenchmark::RunOnBenchmarkThread));
+  return true;
+}
+
+void DrmBenchmark::RunOnBenchmarkThread(int32_t) {
+  for (const auto& trace : NetworkSimulation::DefaultTraces()) {
+    if (trace.name == kTraceName)
+      replay_cache_ = std::make_shared<ReplayCache>(trace);
+  }
+  auto replay_cache = replay_cache_;
+  SetLocalDataSource([replay_cache](const SegmentDescriptor& location,
+                                    vector<uint8_t>* data) {
+    if (location.url == kLicenseUrl) {
+      data->assign(kLicenseResponse,
+                   kLicenseResponse + sizeof(kLicenseResponse) - 1);
+      return true;
+    }
+    return replay_cache->Read(location, data);
+  });
+  metrics_.Reset();
+
+  // Requests are processed on this thread, as the listener gets no network
+  // executor.
+  listener_ = std::make_shared<DrmPlayReadyListener>(instance_, nullptr);
+  auto descriptor = std::make_shared<DrmPlayReadyContentProtectionDescriptor>();
+  descriptor->system_url_ = kLicenseUrl;
+  listener_->SetContentProtectionDescriptor(descriptor);
+  listener_->SetMetrics(&metrics_);
+  licenses_installed_ = std::make_shared<std::atomic<uint32_t>>(0);
+  auto licenses_installed = licenses_installed_;
+  listener_->SetLicenseInstaller(
+      [licenses_installed](const char* license, size_t size) {
+        if (size < strlen(kXmlTag) || memcmp(license, kXmlTag, strlen(kXmlTag)))
+          return false;
+        ++*licenses_installed;
+        return true;
+      });
+  licenses_requested_ = 0;
+  StepLicensesOnBenchmarkThread(PP_OK);
+}
+
+void DrmBenchmark::StepLicensesOnBenchmarkThread(int32_t) {
+  if (cancelled_) {
+    Finish();
+    return;
+  }
+  if (listener_->PendingRequests() == 0) {
+    if (licenses_requested_ >= kLicenseRequests) {
+      listener_.reset();
+      if (manifest_url_.empty() || !StartPackets()) {
+        Finish();
+        return;
+      }
+      thread_.message_loop().PostWork(cc_factory_.NewCallback(
+          &DrmBenchmark::StepPacketsOnBenchmarkThread));
+      return;
+    }
+    ++licenses_requested_;
+    listener_->OnLicenseRequest(sizeof(kChallenge) - 1, kChallenge);
+  }
+  // The request is processed before this step runs again.
+  thread_.message_loop().PostWork(cc_factory_.NewCallback(
+      &DrmBenchmark::StepLicensesOnBenchmarkThread));
+}
+
+bool DrmBenchmark::StartPackets() {
+  string mpd;
+  if (!DashManifest::DownloadManifest(manifest_url_, &mpd)) {
+    LOG_ERROR("Failed to download %s", manifest_url_.c_str());
+    return false;
+  }
+  manifest_ = DashManifest::ParseMPD(manifest_url_, mpd);
+  if (!manifest_) {
+    LOG_ERROR("Failed to parse %s", manifest_url_.c_str());
+    return false;
+  }
+  double duration = ParseDurationToSeconds(manifest_->GetDuration());
+  if (manifest_->IsDynamic() || duration <= 0.) {
+    LOG_ERROR("Only static content with a duration can be used: %s",
+              manifest_url_.c_str());
+    return false;
+  }
+  manifest_->LoadSegmentIndexes();
+  content_end_ = std::min(duration, kMaxContentTime);
+
+  vector<VideoStream> video_streams = manifest_->GetVideoStreams();
+  vector<AudioStream> audio_streams = manifest_->GetAudioStreams();
+  if (video_streams.empty()) {
+    LOG_ERROR("No video streams");
+    return false;
+  }
+  pipeline_ = MakeUnique<BenchmarkPipeline>(instance_, manifest_.get(),
+                                            replay_cache_.get());
+  pipeline_->SetDrm(DRMType_Playready, &metrics_);
+  int32_t audio_id =
+      audio_streams.empty() ? -1 : audio_streams.front().description.id;
+  last_pts_ = -1.;
+  progress_time_ = replay_cache_->Time();
+  LOG_INFO("DRM benchmark of %s", manifest_url_.c_str());
+  return pipeline_->Start(video_streams.front().description.id, audio_id);
+}
+
+void DrmBenchmark::StepPacketsOnBenchmarkThread(int32_t) {
+  if (cancelled_) {
+    Finish();
+    return;
+  }
+  // Demuxer callbacks are dispatched by the message loop of this thread, so
+  // it's not blocked between steps.
+  pipeline_->Step(std::max(last_pts_, 0.));
+  auto stats = pipeline_->backend()->GetStats(StreamType::Video);
+  double now = replay_cache_->Time();
+  if (stats.last_pts > last_pts_) {
+    last_pts_ = stats.last_pts;
+    progress_time_ = now;
+  }
+  if (last_pts_ >= content_end_ - kEndMargin ||
+      pipeline_->backend()->IsEndOfStream()) {
+    Finish();
+    return;
+  }
+  if (now - progress_time_ > kStallTimeout) {
+    LOG_ERROR("Playback stalled at %f [s]", last_pts_);
+    Finish();
+    return;
+  }
+  // Nothing is downloaded until buffers drain, so the link idles.
+  if (pipeline_->IsSettled()) replay_cache_->AdvanceTo(now + kIdleStep);
+  thread_.message_loop().PostWork(cc_factory_.NewCallback(
+      &DrmBenchmark::StepPacketsOnBenchmarkThread));
+}
+
+void DrmBenchmark::Finish() {
+  listener_.reset();
+  pipeline_.reset();
+  manifest_.reset();
+  SetLocalDataSource(nullptr);
+  replay_cache_.reset();
+
+  DrmMetrics::Report report = metrics_.GetReport();
+  Result result = Result();
+  result.licenses = report.license_count;
+  result.license_p50 = report.license_p50;
+  result.license_p95 = report.license_p95;
+  result.license_p99 = report.license_p99;
+  result.encrypted_packets = report.encrypted_packets;
+  result.encrypted_packets_per_second = report.encrypted_packets_per_second;
+  result.packet_allocations = report.packet_allocations;
+  result.storage_allocations = report.storage_allocations;
+  result.ok = licenses_installed_ &&
+      *licenses_installed_ == kLicenseRequests &&
+      report.license_count == kLicenseRequests &&
+      (manifest_url_.empty() || report.encrypted_packets > 0);
+  licenses_installed_.reset();
+  if (!cancelled_) {
+    metrics_.LogReport();
+    if (callback_) callback_(result);
+  }
+  manifest_url_.clear();
+  callback_ = nullptr;
+  running_ = false;
+}
@@ -0,0 +1,119 @@
+/*!
+ * drm_benchmark.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_DRM_BENCHMARK_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_DRM_BENCHMARK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/simple_thread.h"
+
+#include "player/es_dash_player/drm_metrics.h"
+
+class BenchmarkPipeline;
+class DashManifest;
+class DrmPlayReadyListener;
+class ReplayCache;
+
+// Measures the DRM pipeline in isolation, into a DrmMetrics of its own like
+// the one of a player.
+//
+// License round trips: a DrmPlayReadyListener gets PlayReady challenges
+// one after another, as if the CDM sent them. The license server is a
+// LocalDataSource serving a canned response, and the license is installed
+// by a stub instead of NaCl Player. Challenges carry no key ID, so
+// LicenseCache never serves them.
+//
+// Encrypted packets: if a manifest is given, its first video and audio
+// representations are played by a BenchmarkPipeline with PlayReady set, so
+// packets take the protected append path of StreamManager to a
+// RecordingEsBackend. Segments are replayed over the "dsl" link of a
+// ReplayCache and playback follows the last appended video packet, so
+// appends run as fast as packets are demuxed.
+class DrmBenchmark {
+ public:
+  struct Result {
+    // Set if all licenses were installed and, with a manifest, encrypted
+    // packets were appended.
+    bool ok;
+    // See DrmMetrics::Report.
+    uint32_t licenses;
+    double license_p50;
+    double license_p95;
+    double license_p99;
+    uint64_t encrypted_packets;
+    double encrypted_packets_per_second;
+    uint64_t packet_allocations;
+    uint64_t storage_allocations;
+  };
+
+  // Called once the benchmark is done, on the benchmark thread.
+  typedef std::function<void(const Result&)> ResultCallback;
+
+  explicit DrmBenchmark(const pp::InstanceHandle& instance);
+  ~DrmBenchmark();
+
+  // Starts a benchmark, unless one is running already. Encrypted packets
+  // are measured only if manifest_url is not empty.
+  bool Start(const std::string& manifest_url, const ResultCallback& callback);
+
+  bool IsRunning() const { return running_; }
+
+ private:
+  void RunOnBenchmarkThread(int32_t);
+  // Sends the next challenge once the previous one is done.
+  void StepLicensesOnBenchmarkThread(int32_t);
+  // Returns false if the content can't be played.
+  bool StartPackets();
+  void StepPacketsOnBenchmarkThread(int32_t);
+  void Finish();
+
+  pp::InstanceHandle instance_;
+  pp::CompletionCallbackFactory<DrmBenchmark> cc_factory_;
+  std::atomic<bool> running_;
+  std::atomic<bool> cancelled_;
+
+  // Used on the benchmark thread while a benchmark runs.
+  std::string manifest_url_;
+  ResultCallback callback_;
+  DrmMetrics metrics_;
+  std::shared_ptr<DrmPlayReadyListener> listener_;
+  uint32_t licenses_requested_;
+  // Licenses which reached the stub installer intact.
+  std::shared_ptr<std::atomic<uint32_t>> licenses_installed_;
+  std::shared_ptr<ReplayCache> replay_cache_;
+  std::unique_ptr<DashManifest> manifest_;
+  std::unique_ptr<BenchmarkPipeline> pipeline_;
+  double content_end_;
+  // The last video packet appended and the link time it changed at.
+  double last_pts_;
+  double progress_time_;
+
+  // Declared last, so it's joined before other members are destroyed.
+  pp::SimpleThread thread_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_DRM_BENCHMARK_H_
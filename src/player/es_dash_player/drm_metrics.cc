@@ -0,0 +1,104 @@
+/*!
+ * drm_metrics.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDrm
+
+#include "drm_metrics.h"
+
+#include <algorithm>
+
+#include "common.h"
+#include "demuxer/elementary_stream_packet.h"
+
+using pp::AutoLock;
+
+constexpr size_t DrmMetrics::kMaxLicenseSamples;
+
+DrmMetrics::DrmMetrics() {
+  license_round_trips_.reserve(kMaxLicenseSamples);
+  Reset();
+}
+
+void DrmMetrics::Reset() {
+  ElementaryStreamPacket::AllocationStats allocations =
+      ElementaryStreamPacket::GetAllocationStats();
+  AutoLock lock(lock_);
+  license_round_trips_.clear();
+  next_license_sample_ = 0;
+  license_count_ = 0;
+  encrypted_packets_ = 0;
+  encrypted_append_time_ = 0.;
+  packet_allocations_base_ = allocations.packets;
+  storage_allocations_base_ = allocations.storages;
+}
+
+void DrmMetrics::AddLicenseRoundTrip(double milliseconds) {
+  AutoLock lock(lock_);
+  ++license_count_;
+  if (license_round_trips_.size() < kMaxLicenseSamples) {
+    license_round_trips_.push_back(milliseconds);
+    return;
+  }
+  license_round_trips_[next_license_sample_] = milliseconds;
+  next_license_sample_ = (next_license_sample_ + 1) % kMaxLicenseSamples;
+}
+
+void DrmMetrics::AddEncryptedAppends(size_t packet_count, double seconds) {
+  AutoLock lock(lock_);
+  encrypted_packets_ += packet_count;
+  encrypted_append_time_ += seconds;
+}
+
+DrmMetrics::Report DrmMetrics::GetReport() const {
+  Report report;
+  std::vector<double> sorted;
+  ElementaryStreamPacket::AllocationStats allocations =
+      ElementaryStreamPacket::GetAllocationStats();
+  {
+    AutoLock lock(lock_);
+    sorted = license_round_trips_;
+    report.packet_allocations = allocations.packets - packet_allocations_base_;
+    report.storage_allocations =
+        allocations.storages - storage_allocations_base_;
+    report.license_count = license_count_;
+    report.encrypted_packets = encrypted_packets_;
+    report.encrypted_packets_per_second = encrypted_append_time_ > 0.
+        ? encrypted_packets_ / encrypted_append_time_ : 0.;
+  }
+  std::sort(sorted.begin(), sorted.end());
+  report.license_p50 = Percentile(sorted, 50.);
+  report.license_p95 = Percentile(sorted, 95.);
+  report.license_p99 = Percentile(sorted, 99.);
+  return report;
+}
+
+void DrmMetrics::LogReport() const {
+  Report report = GetReport();
+  if (report.license_count == 0) return;
+
+  LOG_INFO("DRM licenses: %u, round trip p50: %.1f p95: %.1f p99: %.1f [ms]",
+           report.license_count, report.license_p50, report.license_p95,
+           report.license_p99);
+  LOG_INFO("Encrypted packets: %llu, %.0f appended per second, packet "
+           "allocations: %llu, storage allocations: %llu",
+           static_cast<unsigned long long>(report.encrypted_packets),
+           report.encrypted_packets_per_second,
+           static_cast<unsigned long long>(report.packet_allocations),
+           static_cast<unsigned long long>(report.storage_allocations));
+}
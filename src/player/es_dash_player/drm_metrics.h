@@ -0,0 +1,77 @@
+/*!
+ * drm_metrics.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_DRM_METRICS_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_DRM_METRICS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ppapi/utility/threading/lock.h"
+
+// Collects timings of the DRM pipeline: license round trips (from the CDM
+// challenge to the installed license) and time spent appending encrypted
+// packets to NaCl Player, so regressions of these paths show up in logs of
+// regular and long running (soak) playbacks. Each player owns one, reset
+// when it starts a new content. It's thread safe.
+class DrmMetrics {
+ public:
+  struct Report {
+    uint32_t license_count;
+    // License round trip percentiles, in milliseconds.
+    double license_p50;
+    double license_p95;
+    double license_p99;
+    uint64_t encrypted_packets;
+    // Encrypted packets appended per second of appending them.
+    double encrypted_packets_per_second;
+    // Heap allocations of ElementaryStreamPacket objects and their storages
+    // since Reset(), i.e. the ones which weren't served by the packet pool.
+    // They're counted for the whole module.
+    uint64_t packet_allocations;
+    uint64_t storage_allocations;
+  };
+
+  DrmMetrics();
+
+  void Reset();
+
+  void AddLicenseRoundTrip(double milliseconds);
+  void AddEncryptedAppends(size_t packet_count, double seconds);
+
+  Report GetReport() const;
+  // Logs the report, if any license has been requested.
+  void LogReport() const;
+
+ private:
+  // Only the latest round trips are kept for percentiles.
+  static constexpr size_t kMaxLicenseSamples = 256;
+
+  mutable pp::Lock lock_;
+  std::vector<double> license_round_trips_;
+  size_t next_license_sample_;
+  uint32_t license_count_;
+  uint64_t encrypted_packets_;
+  double encrypted_append_time_;
+  uint64_t packet_allocations_base_;
+  uint64_t storage_allocations_base_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_DRM_METRICS_H_
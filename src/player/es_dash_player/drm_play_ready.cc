@@ -17,6 +17,8 @@
  * @author Tomasz Borkowski
  */
 
+#define LOG_CATEGORY LogCategory::kDrm
+
 #include <algorithm>
 #include <sstream>
 
@@ -26,15 +28,24 @@
 #include "ppapi/cpp/url_response_info.h"
 #include "ppapi/cpp/url_request_info.h"
 
+#include "cpu_profiler.h"
+#include "drm_metrics.h"
 #include "drm_play_ready.h"
+#include "license_cache.h"
+#include "network_executor.h"
+#include "tracer.h"
 
 #include "common.h"
+#include "dash/media_segment_sequence.h"
 #include "libdash/libdash.h"
 
+using std::chrono::duration;
+using std::chrono::steady_clock;
 using std::shared_ptr;
 using std::string;
 using std::vector;
 
+using pp::AutoLock;
 using pp::CompletionCallback;
 using pp::URLLoader;
 using pp::URLResponseInfo;
@@ -55,14 +66,44 @@ const char* kPlayreadSchemeIdUri =
 const char* kSchemeIdUriAttribute = "schemeIdUri";
 const char* kCencPsshAttribute = "cenc:pssh";
 const char* kMsprProAttribute = "mspr:pro";
+// Failed downloads of a license are retried, so a single network error
+// doesn't leave packets of its key waiting.
+const int kMaxLicenseAttempts = 3;
+const size_t kKeyIdSize = 16;
+
+namespace {
+
+// PlayReady headers list key IDs as base64 encoded GUIDs, which first three
+// fields are little endian, while packets use them as big endian UUIDs.
+vector<string> ToPacketKeyIds(const string& key_ids) {
+  vector<string> result;
+  std::istringstream stream(key_ids);
+  string key_id;
+  while (std::getline(stream, key_id, ',')) {
+    vector<uint8_t> guid = Base64Decode(key_id);
+    if (guid.size() != kKeyIdSize) continue;
+    std::reverse(guid.begin(), guid.begin() + 4);
+    std::reverse(guid.begin() + 4, guid.begin() + 6);
+    std::reverse(guid.begin() + 6, guid.begin() + 8);
+    result.emplace_back(guid.begin(), guid.end());
+  }
+  return result;
+}
+
+}  // namespace
 
 DrmPlayReadyListener::DrmPlayReadyListener(
     const pp::InstanceHandle& instance,
-    std::shared_ptr<Samsung::NaClPlayer::MediaPlayer> player)
+    std::shared_ptr<Samsung::NaClPlayer::MediaPlayer> player,
+    std::shared_ptr<NetworkExecutor> network_executor)
     : instance_(instance),
+      network_executor_(network_executor),
       cc_factory_(this),
       player_(player),
-      pending_licence_requests_(0) {
+      pending_unknown_requests_(0),
+      request_finished_(false),
+      persistent_licenses_(false),
+      metrics_(nullptr) {
   side_thread_loop_ = pp::MessageLoop::GetCurrent();
 }
 
@@ -77,23 +118,101 @@ void DrmPlayReadyListener::OnInitdataLoaded(DRMType drm_type,
 
 void DrmPlayReadyListener::OnLicenseRequest(uint32_t request_size,
                                             const void* request) {
-  LOG_INFO("Making license request to: %s",
-           cp_descriptor_->system_url_.c_str());
-  LOG_DEBUG("request_size: %d, str: [%s]", request_size, request);
-  std::string soap_request(static_cast<const char*>(request),
-                           static_cast<const char*>(request) + request_size);
+  // This runs on the platform's DRM thread, so the challenge is only copied
+  // here and it's prepared and sent by a network worker.
+  TRACE_SCOPE("license request");
+  auto challenge = std::make_shared<const std::string>(
+      static_cast<const char*>(request), request_size);
+  Tracer::FlowStart("license", reinterpret_cast<uintptr_t>(challenge.get()));
+  {
+    AutoLock lock(keys_lock_);
+    // Keys of the challenge are not known until it's parsed, so packets of
+    // keys which licenses are missing wait meanwhile.
+    ++pending_unknown_requests_;
+  }
 
+  auto callback = cc_factory_.NewCallback(
+      &DrmPlayReadyListener::ProcessLicenseRequestOnSideThread, challenge,
+      steady_clock::now());
+  // Workers of the executor download licenses of different keys at the
+  // same time.
+  if (network_executor_)
+    network_executor_->Post(NetworkExecutor::Priority::kLicense, callback);
+  else
+    side_thread_loop_.PostWork(callback);
+}
+
+void DrmPlayReadyListener::ProcessLicenseRequestOnSideThread(
+    int32_t, const std::shared_ptr<const std::string>& challenge,
+    steady_clock::time_point requested) {
+  TRACE_SCOPE("process license request");
+  CPU_SCOPE(CpuStage::kDrm);
+  Tracer::FlowEnd("license", reinterpret_cast<uintptr_t>(challenge.get()));
+  LOG_DEBUG("request_size: %d, str: [%s]", challenge->size(),
+            challenge->c_str());
   // Clear garbage at the end...
-  size_t soap_end = soap_request.find(kSoapTagEnd);
-  if (soap_end != std::string::npos) {
-    soap_request.resize(soap_end + strlen(kSoapTagEnd));
+  size_t soap_size = challenge->find(kSoapTagEnd);
+  soap_size = soap_size == std::string::npos
+      ? challenge->size() : soap_size + strlen(kSoapTagEnd);
+
+  // The CDM sends a challenge whenever init data of a key reaches it, e.g.
+  // from the manifest and from init segments of both streams. A license of
+  // the key is installed already, or will be once the first request
+  // completes.
+  std::string key_id = LicenseCache::ParseKeyId(*challenge);
+  if (!AddRequest(key_id)) {
+    LOG_INFO("License of key %s is requested already", key_id.c_str());
+    return;
+  }
+
+  const std::string& url = cp_descriptor_->system_url_;
+  std::string response;
+  if (!key_id.empty() &&
+      LicenseCache::Get().Lookup(key_id, url, &response,
+                                 persistent_licenses_)) {
+    if (InstallLicense(response)) {
+      AddRoundTrip(requested);
+      FinishRequest(key_id, true);
+      // A license cached by an online playback is kept for offline ones.
+      if (persistent_licenses_)
+        LicenseCache::Get().Put(key_id, url, response, true);
+      return;
+    }
+    // E.g. the license has been revoked, so ask the server for a new one.
+    LicenseCache::Get().Remove(key_id, url);
+  }
+
+  if (DownloadLicense(url, *challenge, soap_size, &response) != PP_OK) {
+    FinishRequest(key_id, false);
+    return;
   }
 
-  ++pending_licence_requests_;
+  LOG_INFO("Successfully retrieved license request!");
+  if (!InstallLicense(response)) {
+    FinishRequest(key_id, false);
+    return;
+  }
+  AddRoundTrip(requested);
+  FinishRequest(key_id, true);
+  if (!key_id.empty())
+    LicenseCache::Get().Put(key_id, url, response, persistent_licenses_);
+}
+
+int32_t DrmPlayReadyListener::DownloadLicense(const std::string& url,
+                                              const std::string& challenge,
+                                              size_t challenge_size,
+                                              std::string* response) {
+  // E.g. a license server replayed by DrmBenchmark.
+  vector<uint8_t> local_data;
+  if (ReadFromLocalDataSource({url, ""}, &local_data)) {
+    response->assign(local_data.begin(), local_data.end());
+    return PP_OK;
+  }
 
-  URLRequestInfo lic_request = GetRequestForURL(cp_descriptor_->system_url_);
+  LOG_INFO("Making license request to: %s", url.c_str());
+  URLRequestInfo lic_request = GetRequestForURL(url);
   lic_request.SetMethod("POST");
-  lic_request.AppendDataToBody(soap_request.data(), soap_request.size());
+  lic_request.AppendDataToBody(challenge.data(), challenge_size);
   if (!cp_descriptor_->key_request_properties_.empty()) {
     std::ostringstream oss;
     for (const auto& e : cp_descriptor_->key_request_properties_)
@@ -102,51 +221,104 @@ void DrmPlayReadyListener::OnLicenseRequest(uint32_t request_size,
     lic_request.SetHeaders(oss.str());
   }
 
-  side_thread_loop_.PostWork(cc_factory_.NewCallback(
-      &DrmPlayReadyListener::ProcessLicenseRequestOnSideThread,
-      cp_descriptor_->system_url_, lic_request));
-
-  LOG_DEBUG("Redirected license request to a side thread");
-}
-
-void DrmPlayReadyListener::ProcessLicenseRequestOnSideThread(
-    int32_t, const std::string& url, URLRequestInfo lic_request) {
-  LOG_DEBUG("Start");
-  std::string response;
-  int32_t ret = ProcessURLRequestOnSideThread(lic_request, &response);
-  if (ret != PP_OK) {
-    LOG_ERROR("Failed to download license from: %s result: %d",
-              url.c_str(), ret);
-    return;
+  int32_t ret = PP_ERROR_FAILED;
+  for (int attempt = 1; attempt <= kMaxLicenseAttempts; ++attempt) {
+    response->clear();
+    ret = ProcessURLRequestOnSideThread(lic_request, response);
+    if (ret == PP_OK) break;
+    LOG_ERROR("Failed to download license from: %s result: %d, attempt: %d",
+              url.c_str(), ret, attempt);
   }
+  return ret;
+}
 
-  LOG_INFO("Successfully retrieved license request!");
+bool DrmPlayReadyListener::InstallLicense(const std::string& response) {
+  TRACE_SCOPE("install license");
   // Some servers (e.g. YouTube)
   // put data into HTTP body before XML;
-  // this tries to skip this data
-  response.erase(0, response.find(kXMLTag));
-  LOG_DEBUG("response after removing headers:\n%s", response.c_str());
-
-  ret = player_->SetDRMSpecificData(DRMType_Playready,
-                                    DRMOperation_InstallLicense,
-                                    response.size(), response.data());
+  // this skips this data
+  size_t xml_start = std::min(response.find(kXMLTag), response.size());
+  LOG_DEBUG("response after removing headers:\n%s",
+            response.c_str() + xml_start);
+  if (license_installer_)
+    return license_installer_(response.data() + xml_start,
+                              response.size() - xml_start);
+  int32_t ret = player_->SetDRMSpecificData(DRMType_Playready,
+                                            DRMOperation_InstallLicense,
+                                            response.size() - xml_start,
+                                            response.data() + xml_start);
   if (ret != ErrorCodes::Success) {
     LOG_ERROR("Failed to install license!, code: %d", ret);
-    return;
+    return false;
   }
 
-  if (pending_licence_requests_)
-    --pending_licence_requests_;
-
   LOG_INFO("Successfully installed license.");
+  return true;
+}
+
+void DrmPlayReadyListener::AddRoundTrip(steady_clock::time_point requested) {
+  if (!metrics_) return;
+  metrics_->AddLicenseRoundTrip(
+      duration<double, std::milli>(steady_clock::now() - requested).count());
+}
+
+bool DrmPlayReadyListener::AddRequest(const std::string& key_id) {
+  AutoLock lock(keys_lock_);
+  // Requests which keys can't be found are always sent and they stay
+  // counted as unknown.
+  if (key_id.empty()) return true;
+  --pending_unknown_requests_;
+  if (!keys_.emplace(key_id, KeyState::kPending).second) return false;
+  for (auto& packet_key_id : ToPacketKeyIds(key_id))
+    pending_key_ids_.insert(std::move(packet_key_id));
+  return true;
+}
+
+void DrmPlayReadyListener::FinishRequest(const std::string& key_id,
+                                         bool installed) {
+  {
+    AutoLock lock(keys_lock_);
+    request_finished_ = true;
+    if (key_id.empty()) {
+      --pending_unknown_requests_;
+    } else {
+      for (const auto& packet_key_id : ToPacketKeyIds(key_id)) {
+        auto it = pending_key_ids_.find(packet_key_id);
+        if (it != pending_key_ids_.end()) pending_key_ids_.erase(it);
+        if (installed) installed_key_ids_.insert(packet_key_id);
+      }
+      if (installed)
+        keys_[key_id] = KeyState::kInstalled;
+      else
+        keys_.erase(key_id);
+    }
+  }
+  if (!installed) {
+    LOG_ERROR("No license of key %s, its packets won't wait for it",
+              key_id.c_str());
+    return;
+  }
+  if (license_installed_callback_) license_installed_callback_();
 }
 
-bool DrmPlayReadyListener::IsInitialized() const {
-  return pending_licence_requests_.load() == 0;
+bool DrmPlayReadyListener::IsKeyPending(const void* key_id,
+                                        uint32_t key_id_size) const {
+  const char* data = static_cast<const char*>(key_id);
+  string packet_key_id = key_id ? string(data, data + key_id_size) : string();
+  AutoLock lock(keys_lock_);
+  if (installed_key_ids_.count(packet_key_id)) return false;
+  if (pending_key_ids_.count(packet_key_id)) return true;
+  // The key can still come with a license which is requested, or which the
+  // CDM hasn't asked for yet.
+  return pending_unknown_requests_ > 0 || !request_finished_;
 }
 
-void DrmPlayReadyListener::Reset() {
-  pending_licence_requests_ = 0;
+size_t DrmPlayReadyListener::PendingRequests() const {
+  AutoLock lock(keys_lock_);
+  size_t pending = std::max(pending_unknown_requests_, 0);
+  for (const auto& key : keys_)
+    if (key.second == KeyState::kPending) ++pending;
+  return pending;
 }
 
 
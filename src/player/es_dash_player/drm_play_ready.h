@@ -20,10 +20,12 @@
 #ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_DRM_PLAY_READY_H_
 #define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_DRM_PLAY_READY_H_
 
-#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "nacl_player/drm_listener.h"
@@ -31,9 +33,13 @@
 #include "ppapi/cpp/instance_handle.h"
 #include "ppapi/cpp/message_loop.h"
 #include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/lock.h"
 
 #include "dash/content_protection_visitor.h"
 
+class DrmMetrics;
+class NetworkExecutor;
+
 namespace pp {
 class MessageLoop;
 class URLRequestInfo;
@@ -71,9 +77,12 @@ class DrmPlayReadyContentProtectionVisitor : public ContentProtectionVisitor {
 
 class DrmPlayReadyListener : public Samsung::NaClPlayer::DRMListener {
  public:
+  // License requests are run by network_executor with the highest priority.
+  // When it's null, they are run on the thread which creates this object.
   DrmPlayReadyListener(
       const pp::InstanceHandle& instance,
-      std::shared_ptr<Samsung::NaClPlayer::MediaPlayer> player);
+      std::shared_ptr<Samsung::NaClPlayer::MediaPlayer> player,
+      std::shared_ptr<NetworkExecutor> network_executor = nullptr);
   ~DrmPlayReadyListener() override{};
 
   void OnInitdataLoaded(Samsung::NaClPlayer::DRMType drm_type,
@@ -87,20 +96,91 @@ class DrmPlayReadyListener : public Samsung::NaClPlayer::DRMListener {
     cp_descriptor_ = cp_descriptor;
   }
 
-  bool IsInitialized() const;
-  void Reset();
+  // Sets a function called on a network thread whenever a license is
+  // installed.
+  inline void SetLicenseInstalledCallback(
+      const std::function<void()>& callback) {
+    license_installed_callback_ = callback;
+  }
+
+  // Makes licenses persistent (see LicenseCache), e.g. for a title played
+  // from offline storage, so it plays without a network later.
+  inline void SetPersistentLicenses(bool persistent) {
+    persistent_licenses_ = persistent;
+  }
+
+  // Makes license round trips measured into metrics of the player, which
+  // must outlive this object. Nothing is measured while it's null.
+  inline void SetMetrics(DrmMetrics* metrics) { metrics_ = metrics; }
+
+  // Sets a function which installs licenses (their XML, without data put
+  // before it) instead of the player, e.g. in a benchmark without NaCl
+  // Player. It returns false if the license can't be installed.
+  inline void SetLicenseInstaller(
+      const std::function<bool(const char*, size_t)>& installer) {
+    license_installer_ = installer;
+  }
+
+  // Checks if packets encrypted with the given key (16 bytes, like in
+  // ESPacketEncryptionInfo) have to wait for its license. They wait while
+  // the license is requested. Until the first request completes, and while
+  // a challenge which keys are not known is in progress, packets of all
+  // keys which licenses are not installed wait. Clear packets never wait,
+  // so a clear lead plays while the first license is downloaded.
+  bool IsKeyPending(const void* key_id, uint32_t key_id_size) const;
+
+  // Returns a number of license requests in progress.
+  size_t PendingRequests() const;
 
  private:
+  enum class KeyState {
+    kPending,
+    kInstalled
+  };
+
+  // Installs a cached license of keys of the challenge if there is one,
+  // otherwise sends the challenge to the license server. The license server
+  // URL is the content ID of cached licenses.
   void ProcessLicenseRequestOnSideThread(int32_t,
-                                         const std::string& url,
-                                         pp::URLRequestInfo lic_request);
+      const std::shared_ptr<const std::string>& challenge,
+      std::chrono::steady_clock::time_point requested);
+  // Serves the license from a LocalDataSource if there is one, otherwise
+  // posts challenge_size bytes of the challenge to the license server,
+  // retrying failed requests.
+  int32_t DownloadLicense(const std::string& url,
+                          const std::string& challenge, size_t challenge_size,
+                          std::string* response);
+  // Data before the XML of response is skipped.
+  bool InstallLicense(const std::string& response);
+  void AddRoundTrip(std::chrono::steady_clock::time_point requested);
+  // Returns false if a license of key_id has been requested already, e.g.
+  // because audio and video streams use the same key.
+  bool AddRequest(const std::string& key_id);
+  // Keys of a request which failed are forgotten, so a later challenge
+  // retries them.
+  void FinishRequest(const std::string& key_id, bool installed);
 
   pp::InstanceHandle instance_;
   pp::MessageLoop side_thread_loop_;
+  std::shared_ptr<NetworkExecutor> network_executor_;
   pp::CompletionCallbackFactory<DrmPlayReadyListener> cc_factory_;
   std::shared_ptr<DrmPlayReadyContentProtectionDescriptor> cp_descriptor_;
   std::shared_ptr<Samsung::NaClPlayer::MediaPlayer> player_;
-  std::atomic<int> pending_licence_requests_;
+  mutable pp::Lock keys_lock_;
+  // Keys which licenses are requested or installed, as they are listed in
+  // challenges (see LicenseCache::ParseKeyId()).
+  std::unordered_map<std::string, KeyState> keys_;
+  // Keys of requests in progress and keys of installed licenses, in the
+  // format of packets' key IDs.
+  std::unordered_multiset<std::string> pending_key_ids_;
+  std::unordered_set<std::string> installed_key_ids_;
+  // Requests in progress which keys are not known.
+  int pending_unknown_requests_;
+  bool request_finished_;
+  bool persistent_licenses_;
+  std::function<void()> license_installed_callback_;
+  std::function<bool(const char*, size_t)> license_installer_;
+  DrmMetrics* metrics_;
 };
 
 #endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_DRM_PLAY_READY_H_
@@ -1,5 +1,5 @@
 /*!
- * sequence_iterator.cc (https://github.com/SamsungDForum/NativePlayer)
+ * es_backend.cc (https://github.com/SamsungDForum/NativePlayer)
  * Copyright 2016, Samsung Electronics Co., Ltd
  * Licensed under the MIT license
  *
@@ -14,19 +14,15 @@
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
- * @author Adam Bujalski
+ * @author Piotr Bałut
  */
 
-#include "sequence_iterator.h"
+#include "player/es_dash_player/es_backend.h"
 
-bool SequenceIterator::EqualsTo(const SegmentBaseIterator&) const {
-  return false;
-}
+EsBackend::Stream::~Stream() = default;
 
-bool SequenceIterator::EqualsTo(const SegmentTemplateIterator&) const {
-  return false;
-}
+EsBackend::~EsBackend() = default;
 
-bool SequenceIterator::EqualsTo(const SegmentListIterator&) const {
-  return false;
+bool EsBackend::SetPlaybackRate(double rate) {
+  return rate == 1.;
 }
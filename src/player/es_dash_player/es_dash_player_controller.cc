@@ -18,6 +18,9 @@
  * @author Michal Murgrabia
  */
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <functional>
 #include <limits>
 #include <utility>
@@ -28,12 +31,37 @@
 #include "nacl_player/url_data_source.h"
 
 #include "player/es_dash_player/es_dash_player_controller.h"
+#include "player/es_dash_player/task_future.h"
 
 #include "demuxer/elementary_stream_packet.h"
+#include "dash/base_url_selector.h"
+#include "dash/content_steering.h"
 #include "dash/dash_manifest.h"
+#include "dash/media_stream.h"
 #include "dash/util.h"
-
+#include "cpu_profiler.h"
+#include "main_thread_budget.h"
+#include "memory_governor.h"
+#include "thread_config.h"
+#include "tuning_profile.h"
+
+#include "abr_engine.h"
+#include "bandwidth_estimator.h"
+#include "dash_preloader.h"
+#include "download_arbiter.h"
+#include "drm_metrics.h"
 #include "drm_play_ready.h"
+#include "language_history.h"
+#include "latency_timeline.h"
+#include "nacl_es_backend.h"
+#include "network_executor.h"
+#include "offline_store.h"
+#include "pipeline_latency.h"
+#include "platform_health.h"
+#include "playback_metrics.h"
+#include "segment_cache.h"
+#include "text_stream_manager.h"
+#include "thumbnail_provider.h"
 
 using Samsung::NaClPlayer::DRMType;
 using Samsung::NaClPlayer::DRMType_Playready;
@@ -43,17 +71,73 @@ using Samsung::NaClPlayer::ESDataSource;
 using Samsung::NaClPlayer::URLDataSource;
 using Samsung::NaClPlayer::MediaDataSource;
 using Samsung::NaClPlayer::MediaPlayer;
+using Samsung::NaClPlayer::MediaPlayerError;
 using Samsung::NaClPlayer::MediaPlayerState;
 using Samsung::NaClPlayer::Rect;
 using Samsung::NaClPlayer::TextTrackInfo;
 using Samsung::NaClPlayer::TimeTicks;
+using std::chrono::duration;
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::system_clock;
 using std::make_shared;
 using std::placeholders::_1;
 using std::shared_ptr;
 using std::unique_ptr;
 using std::vector;
 
-const int64_t kMainLoopDelay = 50;  // in milliseconds
+using LatencyPhase = LatencyTimeline::Phase;
+
+// Buffers are updated on events, these delays are used only if no event
+// happens for that long. During playback the delay is the
+// bufferUpdateInterval of the TuningProfile.
+const int64_t kPausedBufferWatchdogDelay = 1000;  // in milliseconds
+// Minimal delay between refreshes of a dynamic manifest.
+const int64_t kMinManifestRefreshDelay = 1000;  // in milliseconds
+// Delay between decisions of automatic representation selection.
+const int64_t kAbrUpdateInterval = 1000;  // in milliseconds
+// Delay between metrics snapshots sent to the UI.
+const int64_t kMetricsReportInterval = 1000;  // in milliseconds
+// Duration of upcoming segments which sizes are taken into account by
+// automatic representation selection, if they are known.
+const TimeTicks kAbrLookahead = 8.0;  // in seconds
+// Buffered ranges of a stream which are that close are contiguous, e.g. the
+// appended one ends at the last appended packet and the queued one starts at
+// the next packet.
+const TimeTicks kBufferGap = 0.25;  // in seconds
+// A bandwidth estimate is saved for next sessions when it changes by more
+// than that part.
+const double kBandwidthSaveThreshold = 0.2;
+// Views are in plugin coordinates, which are 1920x1080 on TVs whatever
+// the panel resolution is. A view that large doesn't limit representations,
+// as UHD panels show the full resolution.
+const int32_t kUnlimitedViewWidth = 1920;
+const int32_t kUnlimitedViewHeight = 1080;
+// A trick mode shows a keyframe that often, moving by the playback rate
+// multiplied by this delay each time.
+const int64_t kTrickPlayStepDelay = 500;  // in milliseconds
+const double kMaxPlaybackRate = 64.0;
+// Rates in this range are played continuously, with audio, if the backend
+// supports it. Other ones, or all of them if it doesn't, use a trick mode.
+const double kMinPlaybackSpeed = 0.5;
+const double kMaxPlaybackSpeed = 2.0;
+// Playback paused for that long has its buffers trimmed.
+const int64_t kIdleTrimDelay = 60000;  // in milliseconds
+// Bounds of the buffer kept ahead of a low-latency live playback, which
+// follows the target latency of the manifest.
+const TimeTicks kMinLiveTargetBuffer = 1.0;  // in seconds
+const TimeTicks kMaxLiveTargetBuffer = 3.0;  // in seconds
+// NaCl Player has no playback rate control, so a low-latency playback that
+// fell behind its target by more than that catches up with a seek.
+const TimeTicks kLiveCatchUpDrift = 2.0;  // in seconds
+// Minimal delay between catch up seeks.
+const int64_t kLiveCatchUpInterval = 10000;  // in milliseconds
+// Connections to that many segment hosts are opened ahead of segment
+// requests, the first ones serve the representations a playback starts with.
+const size_t kMaxWarmedOrigins = 4;
+// Segments of each stream kept for a playback suspended with the
+// application, the most recently used ones first.
+const size_t kResumeByteBudget = 8 * 1024 * 1024;
 
 namespace {
 
@@ -71,18 +155,316 @@ void PrintChosenRepresentation(const AudioStream& s) {
   LOG_INFO("Chosen audio rep is: %s, bitrate: %u, id: %d",
             s.language.c_str(), s.description.bitrate, s.description.id);
 }
+
 }
 
 class EsDashPlayerController::Impl {
  public:
+  // Reads the playback position from NaCl Player or from the source set by
+  // SetPlaybackTimeSource().
+  static void GetPlaybackTime(EsDashPlayerController* thiz,
+                              TimeTicks* playback_time) {
+    if (thiz->playback_time_source_)
+      *playback_time = thiz->playback_time_source_();
+    else
+      thiz->player_->GetCurrentTime(*playback_time);
+  }
+
+  // Reads where a suspended playback of the title was, if this player
+  // continues it (see CreateResumeState()).
+  static bool GetResumePoint(const EsDashPlayerController* thiz,
+                             PreloadedMedia::ResumePoint* point) {
+    return thiz->preloaded_media_ &&
+           thiz->preloaded_media_->GetResumePoint(point);
+  }
+
+  // Whether a stream doesn't download nor demux anything, because only
+  // audio is played (see SetAudioOnly()).
+  static bool IsSuspended(const EsDashPlayerController* thiz,
+                          StreamType type) {
+    return type == StreamType::Video && thiz->video_suspended_;
+  }
+
+  // Plays continuously at the given rate. Returns false if it's out of
+  // bounds of such playback or the backend can't play at it.
+  static bool SetPlaybackSpeed(EsDashPlayerController* thiz, double speed) {
+    if (speed < kMinPlaybackSpeed || speed > kMaxPlaybackSpeed) return false;
+    if (speed == thiz->playback_speed_) return true;
+    if (!thiz->es_backend_ || !thiz->es_backend_->SetPlaybackRate(speed))
+      return false;
+
+    LOG_INFO("Playback speed changed to %f", speed);
+    thiz->playback_speed_ = speed;
+    ApplyPlaybackSpeed(thiz);
+    return true;
+  }
+
+  // Scales buffering of the pipeline to the playback speed.
+  static void ApplyPlaybackSpeed(EsDashPlayerController* thiz) {
+    for (const auto& stream : thiz->streams_) {
+      if (stream) stream->SetPlaybackRate(thiz->playback_speed_);
+    }
+    thiz->packets_manager_.SetPlaybackRate(thiz->playback_speed_);
+    if (thiz->abr_engine_)
+      thiz->abr_engine_->SetPlaybackRate(thiz->playback_speed_);
+  }
+
+  // Ranges of a stream buffered by each stage of the pipeline, all empty
+  // without such stream.
+  static StreamBufferedRanges GetBufferedRanges(
+      EsDashPlayerController* thiz, StreamType type) {
+    const auto& stream = thiz->streams_[static_cast<int32_t>(type)];
+    if (!stream || IsSuspended(thiz, type)) return StreamBufferedRanges();
+    auto ranges = thiz->packets_manager_.GetBufferedRanges(type);
+    ranges.downloaded = stream->GetDownloadedRange();
+    return ranges;
+  }
+
+  // Seconds buffered continuously from the playback position on, through
+  // appended and queued packets and downloaded segments.
+  static TimeTicks BufferedAhead(const StreamBufferedRanges& ranges,
+                                 TimeTicks playback_time) {
+    TimeTicks end = playback_time;
+    for (const auto* range :
+         {&ranges.appended, &ranges.queued, &ranges.downloaded}) {
+      if (range->end > range->start && range->start <= end + kBufferGap)
+        end = std::max(end, range->end);
+    }
+    return end - playback_time;
+  }
+
+  // Sends buffer levels and, once in a while, a metrics snapshot to the UI.
+  static void ReportBufferLevel(EsDashPlayerController* thiz,
+                                TimeTicks playback_time) {
+    auto& packets_manager = thiz->packets_manager_;
+    thiz->message_sender_->BufferLevel(
+        std::max(packets_manager.GetBufferedTime(StreamType::Video) -
+                     playback_time, 0.0),
+        std::max(packets_manager.GetBufferedTime(StreamType::Audio) -
+                     playback_time, 0.0));
+    thiz->message_sender_->BufferedRanges(
+        GetBufferedRanges(thiz, StreamType::Video),
+        GetBufferedRanges(thiz, StreamType::Audio));
+
+    if (thiz->metrics_report_interval_.count() == 0) return;
+    auto now = thiz->executor_->Now();
+    if (now < thiz->next_metrics_report_) return;
+    thiz->next_metrics_report_ = now + thiz->metrics_report_interval_;
+    SendMetrics(thiz, playback_time);
+  }
+
+  // Sends a snapshot of metrics of the player and of the pipeline.
+  static void SendMetrics(EsDashPlayerController* thiz,
+                          TimeTicks playback_time) {
+    auto drm_report = thiz->drm_metrics_->GetReport();
+    auto playback_report = thiz->playback_metrics_->GetReport();
+    auto& packets_manager = thiz->packets_manager_;
+    Communication::MetricsSnapshot metrics;
+    metrics.license_count = drm_report.license_count;
+    metrics.license_p50 = drm_report.license_p50;
+    metrics.license_p95 = drm_report.license_p95;
+    metrics.license_p99 = drm_report.license_p99;
+    metrics.encrypted_packets_per_second =
+        drm_report.encrypted_packets_per_second;
+    metrics.encrypted_packets = drm_report.encrypted_packets;
+    metrics.packet_allocations = drm_report.packet_allocations;
+    metrics.storage_allocations = drm_report.storage_allocations;
+    metrics.bytes_downloaded = playback_report.bytes_downloaded;
+    metrics.segments_downloaded = playback_report.segments_downloaded;
+    metrics.download_time_histogram.assign(
+        playback_report.download_time_histogram.begin(),
+        playback_report.download_time_histogram.end());
+    metrics.bandwidth = thiz->bandwidth_estimator_
+        ? thiz->bandwidth_estimator_->EstimatedBandwidth() : 0.;
+    metrics.video_buffer = std::max(
+        packets_manager.GetBufferedTime(StreamType::Video) - playback_time,
+        0.0);
+    metrics.audio_buffer = std::max(
+        packets_manager.GetBufferedTime(StreamType::Audio) - playback_time,
+        0.0);
+    metrics.video_buffered_bytes =
+        packets_manager.GetBufferedBytes(StreamType::Video);
+    metrics.audio_buffered_bytes =
+        packets_manager.GetBufferedBytes(StreamType::Audio);
+    metrics.packets_appended = playback_report.packets_appended;
+    metrics.packets_dropped = playback_report.packets_dropped;
+    metrics.seek_count = playback_report.seek_count;
+    metrics.seek_latency_average = playback_report.seek_latency_average;
+    metrics.seek_latency_max = playback_report.seek_latency_max;
+    metrics.rebuffer_count = playback_report.rebuffer_count;
+    metrics.rebuffer_duration = playback_report.rebuffer_duration;
+    auto representation_id = [thiz](StreamType type) {
+      auto index = static_cast<size_t>(type);
+      return thiz->streams_[index] ? thiz->representation_ids_[index] : -1;
+    };
+    metrics.video_representation_id = representation_id(StreamType::Video);
+    metrics.audio_representation_id = representation_id(StreamType::Audio);
+    metrics.demuxer_cpu_time = playback_report.demuxer_cpu_time;
+    // In milliseconds per second of played media.
+    auto stage_cpu = [&playback_report](CpuStage stage) {
+      double played_time = playback_report.played_time;
+      return played_time > 0.
+          ? playback_report.stage_cpu_time[static_cast<size_t>(stage)] *
+                1000. / played_time
+          : 0.;
+    };
+    metrics.download_cpu = stage_cpu(CpuStage::kDownload);
+    metrics.demux_cpu = stage_cpu(CpuStage::kDemux);
+    metrics.packets_cpu = stage_cpu(CpuStage::kPackets);
+    metrics.drm_cpu = stage_cpu(CpuStage::kDrm);
+    metrics.stall_recoveries = playback_report.stall_recoveries;
+    metrics.tuning_profile = thiz->tuning_.id;
+    const auto& budget_report = playback_report.main_thread;
+    auto work_time = [&budget_report](MainThreadWork work) {
+      return budget_report.time[static_cast<size_t>(work)];
+    };
+    metrics.main_thread_time = work_time(MainThreadWork::kHandleMessage) +
+                               work_time(MainThreadWork::kSendMessages);
+    metrics.log_forwarding_time = work_time(MainThreadWork::kForwardLogs);
+    metrics.frames_over_budget = budget_report.frames_over_budget;
+    metrics.shed_messages = budget_report.shed_messages;
+    metrics.memory_usage = MemoryGovernor::GetTotalUsage();
+    metrics.memory_pressure =
+        static_cast<int32_t>(MemoryGovernor::GetPressure());
+    auto health_report = thiz->platform_health_->GetReport();
+    metrics.player_errors = health_report.error_count;
+    metrics.last_player_error = health_report.last_error;
+    metrics.platform_buffering = health_report.buffering_count;
+    metrics.platform_underruns = health_report.underrun_count;
+    metrics.time_update_interval = health_report.time_update_interval;
+    metrics.time_update_jitter = health_report.time_update_jitter;
+    metrics.late_time_updates = health_report.late_time_updates;
+    metrics.device_max_bitrate = thiz->device_max_bitrate_;
+    auto latency_report = thiz->pipeline_latency_->GetReport();
+    auto stage_latency = [&latency_report](PipelineLatency::Stage stage) {
+      const auto& stage_report =
+          latency_report.stages[static_cast<size_t>(stage)];
+      return Communication::MetricsSnapshot::LatencyPercentiles{
+          stage_report.p50, stage_report.p90, stage_report.p99};
+    };
+    metrics.pipeline_segments =
+        latency_report.stages[static_cast<size_t>(
+            PipelineLatency::Stage::kTotal)].count;
+    metrics.request_latency = stage_latency(PipelineLatency::Stage::kRequest);
+    metrics.download_latency =
+        stage_latency(PipelineLatency::Stage::kDownload);
+    metrics.first_packet_latency =
+        stage_latency(PipelineLatency::Stage::kFirstPacket);
+    metrics.parse_latency = stage_latency(PipelineLatency::Stage::kParse);
+    metrics.append_latency = stage_latency(PipelineLatency::Stage::kAppend);
+    metrics.segment_latency = stage_latency(PipelineLatency::Stage::kTotal);
+    thiz->message_sender_->Metrics(metrics);
+
+    auto samples = thiz->playback_metrics_->TakeDownloadSamples();
+    if (samples.empty()) return;
+    std::vector<Communication::SegmentDownloadRecord> downloads;
+    downloads.reserve(samples.size());
+    for (const auto& sample : samples) {
+      Communication::SegmentDownloadRecord record;
+      record.host = sample.host;
+      record.representation_id = sample.representation_id;
+      record.bytes = sample.bytes;
+      record.open_time = sample.time_to_first_byte * 1000.;
+      record.first_byte_time = sample.time_to_first_body_byte * 1000.;
+      record.body_time =
+          (sample.total_time - sample.time_to_first_byte) * 1000.;
+      record.response = sample.response;
+      downloads.push_back(std::move(record));
+    }
+    thiz->message_sender_->SegmentDownloads(downloads);
+  }
+
+  // Records a phase of the startup or of a seek. When it completes the
+  // operation, its timeline is logged and sent to the UI.
+  static void MarkLatency(EsDashPlayerController* thiz, LatencyPhase phase) {
+    if (!thiz->latency_timeline_->Mark(phase)) return;
+
+    LatencyTimeline::Operation operation;
+    LatencyTimeline::Report report;
+    if (!thiz->latency_timeline_->Finish(&operation, &report)) return;
+
+    if (operation == LatencyTimeline::Operation::kSeek && !report.empty())
+      thiz->playback_metrics_->AddSeek(report.back().second);
+    const char* operation_name = LatencyTimeline::OperationName(operation);
+    for (const auto& phase_time : report) {
+      LOG_INFO("%s latency: %s after %.1f [ms]", operation_name,
+               phase_time.first.c_str(), phase_time.second);
+    }
+    thiz->message_sender_->LatencyReport(operation_name, report);
+  }
+
+  // Makes segment requests follow the pathway priority of a content
+  // steering server of the manifest and keeps it up to date.
+  static void StartContentSteering(EsDashPlayerController* thiz) {
+    thiz->content_steering_.reset();
+    const auto& info = thiz->dash_parser_->GetContentSteering();
+    if (thiz->offline_ || info.server_url.empty()) return;
+
+    auto steering = std::make_shared<ContentSteering>(info);
+    steering->ApplyDefault();
+    double delay = 0.;
+    if (info.query_before_start) {
+      thiz->network_executor_->RunAndWait(NetworkExecutor::Priority::kManifest,
+          [&]() { delay = steering->Update(); });
+    }
+    thiz->content_steering_ = steering;
+    thiz->ScheduleSteeringUpdate(steering,
+                                 thiz->player_thread_->message_loop(), delay);
+  }
+
+  // Opens connections to segment hosts and the license server while
+  // streams are set up, so DNS lookups and handshakes don't delay the first
+  // segments and the license request.
+  static void WarmUpConnections(EsDashPlayerController* thiz) {
+    if (thiz->offline_) return;
+
+    std::vector<std::string> origins = thiz->dash_parser_->GetOrigins();
+    if (origins.size() > kMaxWarmedOrigins) origins.resize(kMaxWarmedOrigins);
+    std::string license_url = thiz->drm_license_url_;
+    for (const auto& stream : thiz->video_representations_) {
+      if (!license_url.empty()) break;
+      if (stream.description.content_protection) {
+        license_url = std::static_pointer_cast<
+            DrmPlayReadyContentProtectionDescriptor>(
+                stream.description.content_protection)->system_url_;
+      }
+    }
+    std::string license_origin = GetOrigin(license_url);
+    if (!license_origin.empty() &&
+        std::find(origins.begin(), origins.end(), license_origin) ==
+            origins.end())
+      origins.push_back(license_origin);
+
+    for (const auto& origin : origins) {
+      thiz->network_executor_->PostTask(NetworkExecutor::Priority::kManifest,
+          [origin]() { WarmUpConnection(origin); });
+    }
+  }
+
+  // Chooses a representation a stream starts with and sets up DRM for it.
+  // Returns false if there are no representations of this stream.
   template<typename RepType>
-  static void InitializeStream(EsDashPlayerController* thiz,
-                               StreamType type,
-                               Samsung::NaClPlayer::DRMType drm_type,
-                               const std::vector<RepType>& representations) {
-    if (representations.empty()) return;
+  static bool SelectStream(EsDashPlayerController* thiz, StreamType type,
+                           const std::vector<RepType>& representations,
+                           RepType* selected) {
+    if (representations.empty()) return false;
 
     RepType s = GetHighestBitrateStream(representations);
+    UpdateAbrCandidates(thiz, type, representations, s.description.id);
+    const RepType* initial = FindRepresentation(representations,
+        thiz->abr_engine_->ChooseInitial(type));
+    // A resumed playback continues with the representation it had.
+    PreloadedMedia::ResumePoint resume_point;
+    if (GetResumePoint(thiz, &resume_point)) {
+      const RepType* resumed = FindRepresentation(representations,
+          resume_point.representation_ids[static_cast<size_t>(type)]);
+      if (resumed) initial = resumed;
+    }
+    if (initial) s = *initial;
+    thiz->abr_engine_->OnRepresentationChanged(type, s.description.id);
+    thiz->representation_ids_[static_cast<size_t>(type)] = s.description.id;
+    if (type == StreamType::Video)
+      thiz->platform_health_->SetRepresentation(s.description.id);
     thiz->message_sender_->SetRepresentations(representations);
     thiz->message_sender_->ChangeRepresentation(type, s.description.id);
     PrintChosenRepresentation(s);
@@ -100,50 +482,496 @@ class EsDashPlayerController::Impl {
       }
 
       thiz->drm_listener_ = make_shared<DrmPlayReadyListener>(
-          thiz->instance_, thiz->player_);
+          thiz->instance_, thiz->player_, thiz->network_executor_);
 
       thiz->drm_listener_->SetContentProtectionDescriptor(
           playready_descriptor);
+      thiz->drm_listener_->SetPersistentLicenses(thiz->offline_);
+      thiz->drm_listener_->SetMetrics(thiz->drm_metrics_.get());
+      thiz->drm_listener_->SetLicenseInstalledCallback(WeakBind(
+          &EsDashPlayerController::OnLicenseInstalled,
+          std::static_pointer_cast<EsDashPlayerController>(
+              thiz->shared_from_this())));
 
       thiz->player_->SetDRMListener(thiz->drm_listener_);
     }
+    *selected = s;
+    return true;
+  }
 
-    auto& stream_manager = thiz->streams_[static_cast<int32_t>(type)];
-    stream_manager = MakeUnique<StreamManager>(thiz->instance_, type);
-    auto configured_callback = WeakBind(
-        &EsDashPlayerController::OnStreamConfigured,
+  // A sequence of a representation with its init segment, loaded for
+  // a stream before it's initialized.
+  struct LoadedStream {
+    StreamType type;
+    uint32_t id;
+    std::shared_ptr<const MediaSegmentSequence> sequence;
+    std::vector<uint8_t> init_segment;
+  };
+
+  // Creates a sequence of a representation and downloads its init segment
+  // on a network executor worker, so this is done for all streams at the
+  // same time. sequence_built is set once the sequence is created.
+  static Future<LoadedStream> LoadStreamData(EsDashPlayerController* thiz,
+      StreamType type, uint32_t id, Promise<bool> sequence_built) {
+    Promise<LoadedStream> loaded;
+    // The task doesn't use thiz, as it can outlive it when the executor is
+    // shared.
+    auto manifest = thiz->dash_parser_;
+    auto preloaded_media = thiz->preloaded_media_;
+    auto task = [loaded, sequence_built, manifest, preloaded_media, type,
+                 id]() mutable {
+      LoadedStream stream{type, id, nullptr, std::vector<uint8_t>()};
+      stream.sequence = manifest->TakePreparedSequence(
+          static_cast<MediaStreamType>(type), id);
+      if (!stream.sequence) {
+        stream.sequence = manifest->GetSequence(
+            static_cast<MediaStreamType>(type), id);
+      }
+      sequence_built.SetValue(static_cast<bool>(stream.sequence));
+      if (stream.sequence) {
+        auto segment = stream.sequence->GetInitSegment();
+        // When the download fails, the stream manager tries again.
+        if (!GetPreloadedSegment(preloaded_media.get(), type, segment.get(),
+                                 &stream.init_segment) &&
+            !stream.sequence->GetInitSegmentData(&stream.init_segment) &&
+            !DownloadSegment(segment.get(), &stream.init_segment))
+          stream.init_segment.clear();
+      }
+      loaded.SetValue(std::move(stream));
+    };
+    thiz->network_executor_->PostTask(NetworkExecutor::Priority::kInitSegment,
+                                      task);
+    return loaded.GetFuture();
+  }
+
+  // Gets data of a segment downloaded in advance by DashPreloader.
+  static bool GetPreloadedSegment(PreloadedMedia* preloaded_media,
+                                  StreamType type,
+                                  dash::mpd::ISegment* segment,
+                                  std::vector<uint8_t>* data) {
+    if (!preloaded_media || !segment) return false;
+
+    return preloaded_media->GetSegmentCache(type)->Get(
+        SegmentCache::KeyFor(segment), data);
+  }
+
+  // Initializes streams which data is loaded, then runs representation
+  // changes requested meanwhile.
+  static void InitializeLoadedStreams(EsDashPlayerController* thiz,
+      const std::shared_ptr<DashManifest>& manifest,
+      std::vector<LoadedStream> loaded) {
+    // Dropped if the player was closed or started again meanwhile.
+    if (!thiz->player_thread_ || thiz->dash_parser_ != manifest) return;
+
+    MarkLatency(thiz, LatencyPhase::kInitSegmentsDownloaded);
+    // Currently only Playready is supported
+    DRMType drm_type = DRMType_Playready;
+    for (auto& stream : loaded) {
+      auto index = static_cast<size_t>(stream.type);
+      thiz->streams_[index] = std::move(thiz->loading_streams_[index]);
+      if (stream.type == StreamType::Video) {
+        InitializeStream(thiz, stream.type, drm_type,
+            *FindRepresentation(thiz->video_representations_, stream.id),
+            std::move(stream.sequence), stream.init_segment);
+      } else {
+        InitializeStream(thiz, stream.type, drm_type,
+            *FindRepresentation(thiz->audio_representations_, stream.id),
+            std::move(stream.sequence), stream.init_segment);
+      }
+    }
+    // Preloaded segments are copied to caches of streams by now.
+    thiz->preloaded_media_.reset();
+    SeekToStartTime(thiz);
+    if (!thiz->seeking_) thiz->PerformWaitingOperations();
+  }
+
+  // Moves NaCl Player to start_time_ once the data source is attached and
+  // streams are initialized. Streams download from there already, so it's
+  // served like a seek into queued packets: nothing is downloaded again and
+  // packets before the keyframe of the position are dropped.
+  static void SeekToStartTime(EsDashPlayerController* thiz) {
+    if (!thiz->start_seek_pending_ || !thiz->data_source_attached_) return;
+    bool initialized = false;
+    for (const auto& stream : thiz->streams_)
+      initialized |= static_cast<bool>(stream);
+    if (!initialized) return;
+
+    thiz->start_seek_pending_ = false;
+    thiz->seeking_ = true;
+    auto to_time = thiz->GetSeekTarget(thiz->start_time_);
+    LOG_INFO("Starting at %f [s], keyframe at %f [s]", thiz->start_time_,
+             to_time);
+    for (size_t i = 0; i < thiz->streams_.size(); ++i) {
+      if (thiz->streams_[i] && !IsSuspended(thiz, static_cast<StreamType>(i)))
+        thiz->streams_[i]->PrepareForSeek(to_time, true);
+    }
+    thiz->packets_manager_.PrepareForSeek(to_time, true);
+
+    auto callback = WeakBind(&EsDashPlayerController::OnSeek,
         std::static_pointer_cast<EsDashPlayerController>(
             thiz->shared_from_this()), _1);
-    // We bravely capture this because we are bound to outlive stream_manager.
-    auto es_packet_callback = [thiz](StreamDemuxer::Message message,
-        std::unique_ptr<ElementaryStreamPacket> packet) {
-      thiz->packets_manager_.OnEsPacket(message, std::move(packet));
-    };
+    int32_t ret = thiz->player_->Seek(to_time, callback);
+    if (ret < ErrorCodes::CompletionPending) {
+      LOG_ERROR("Seek to the start time failed, code: %d", ret);
+      thiz->seeking_ = false;
+    }
+  }
 
-    bool success = stream_manager->Initialize(
-        thiz->dash_parser_->GetSequence(
-            static_cast<MediaStreamType>(type), s.description.id),
-        thiz->data_source_.get(), configured_callback, es_packet_callback,
-        &thiz->packets_manager_, drm_type);
-    thiz->packets_manager_.SetStream(type, stream_manager.get());
+  // Creates a stream manager and passes it DRM init data from the manifest,
+  // so the license is requested while media data is downloaded.
+  template<typename RepType>
+  static bool CreateStream(EsDashPlayerController* thiz, StreamType type,
+                           const RepType& s, bool* preconfigured) {
+    // Streams are used once they are initialized.
+    auto& stream_manager = thiz->loading_streams_[static_cast<int32_t>(type)];
+    stream_manager = MakeUnique<StreamManager>(thiz->instance_, type,
+        thiz->tuning_, thiz->network_executor_, thiz->bandwidth_estimator_);
+    stream_manager->SetTaskExecutor(thiz->executor_);
+    stream_manager->SetDownloadArbiter(thiz->download_arbiter_);
+    stream_manager->SetPipelineLatency(thiz->pipeline_latency_.get());
+    stream_manager->SetDrmMetrics(thiz->drm_metrics_.get());
+    stream_manager->SetPlaybackMetrics(thiz->playback_metrics_.get());
+    stream_manager->SetLiveTargetBuffer(thiz->live_target_buffer_);
+    stream_manager->SetPlaybackRate(thiz->playback_speed_);
+    stream_manager->SetStartTime(thiz->start_time_);
+    if (!stream_manager->AddStream(thiz->es_backend_.get())) {
+      LOG_ERROR("Failed to add stream %d", static_cast<int32_t>(type));
+      thiz->state_ = PlayerState::kError;
+      return false;
+    }
 
     if (s.description.content_protection) {
       auto play_ready_desc =
           static_cast<DrmPlayReadyContentProtectionDescriptor*>(
               s.description.content_protection.get());
       if (!play_ready_desc->init_data_type_.empty()) {
+        LOG_INFO("Passing DRM init data from the manifest");
         stream_manager->SetDrmInitData(play_ready_desc->init_data_type_,
                                        play_ready_desc->init_data_);
       }
     }
+    *preconfigured = stream_manager->PreConfigure(s);
+    return true;
+  }
+
+  template<typename RepType>
+  static void InitializeStream(EsDashPlayerController* thiz,
+      StreamType type, Samsung::NaClPlayer::DRMType drm_type,
+      const RepType& s,
+      std::shared_ptr<const MediaSegmentSequence> sequence,
+      const std::vector<uint8_t>& init_segment) {
+    auto& stream_manager = thiz->streams_[static_cast<int32_t>(type)];
+    auto configured_callback = WeakBind(
+        &EsDashPlayerController::OnStreamConfigured,
+        std::static_pointer_cast<EsDashPlayerController>(
+            thiz->shared_from_this()), _1);
+    // We bravely capture this because we are bound to outlive stream_manager.
+    auto es_packet_callback = [thiz, type](StreamDemuxer::Message message,
+        std::unique_ptr<ElementaryStreamPacket> packet) {
+      if (message == StreamDemuxer::kEndOfStream)
+        thiz->packets_manager_.OnEndOfStream(type);
+      else
+        thiz->packets_manager_.OnEsPacket(message, std::move(packet));
+    };
+    auto es_packets_callback = [thiz](StreamDemuxer::Message message,
+        StreamDemuxer::PacketBatch packets) {
+      thiz->packets_manager_.OnEsPackets(message, std::move(packets));
+    };
+
+    bool success = stream_manager->Initialize(std::move(sequence),
+        init_segment, thiz->es_backend_.get(), configured_callback,
+        es_packet_callback, es_packets_callback, &thiz->packets_manager_,
+        drm_type);
+    thiz->packets_manager_.SetStream(type, stream_manager.get());
 
     if (!success) {
       LOG_ERROR("Failed to initialize video stream manager");
       thiz->state_ = PlayerState::kError;
+      return;
+    }
+    if (thiz->preloaded_media_) {
+      stream_manager->AddCachedSegments(
+          *thiz->preloaded_media_->GetSegmentCache(type));
+    }
+
+    // Posted after the first buffer update, so it doesn't delay playback.
+    thiz->executor_->PostWork(
+        thiz->cc_factory_.NewCallback(
+            &EsDashPlayerController::PrefetchInitSegments, type,
+            s.description.id));
+  }
+
+  template<typename RepType>
+  static const RepType* FindRepresentation(
+      const std::vector<RepType>& representations, int32_t id) {
+    for (const auto& representation : representations) {
+      if (static_cast<int32_t>(representation.description.id) == id)
+        return &representation;
+    }
+    return nullptr;
+  }
+
+  static void LoadLanguageHistory(EsDashPlayerController* thiz) {
+    if (thiz->language_history_loaded_) return;
+    thiz->language_history_ = LanguageHistory::Load();
+    thiz->language_history_loaded_ = true;
+  }
+
+  static void AddToLanguageHistory(EsDashPlayerController* thiz,
+                                   const std::string& language) {
+    LoadLanguageHistory(thiz);
+    auto& history = thiz->language_history_;
+    history.erase(std::remove(history.begin(), history.end(), language),
+                  history.end());
+    history.insert(history.begin(), language);
+    LanguageHistory::Add(language);
+  }
+
+  // Returns an id of the audio representation of the language the user is
+  // likely to switch to, with a bitrate closest to the current one, or -1.
+  static int32_t AlternateLanguageRepresentation(
+      EsDashPlayerController* thiz) {
+    const AudioStream* current = FindRepresentation(
+        thiz->audio_representations_,
+        thiz->representation_ids_[static_cast<size_t>(StreamType::Audio)]);
+    if (!current) return -1;
+
+    LoadLanguageHistory(thiz);
+    std::vector<std::string> other_languages;
+    for (const auto& representation : thiz->audio_representations_) {
+      const auto& language = representation.language;
+      if (language != current->language &&
+          std::find(other_languages.begin(), other_languages.end(),
+                    language) == other_languages.end())
+        other_languages.push_back(language);
+    }
+    std::string language;
+    for (const auto& chosen : thiz->language_history_) {
+      if (chosen == current->language) continue;
+      if (std::find(other_languages.begin(), other_languages.end(),
+                    chosen) != other_languages.end()) {
+        language = chosen;
+        break;
+      }
+    }
+    if (language.empty() && other_languages.size() == 1)
+      language = other_languages.front();
+    if (language.empty()) return -1;
+
+    const AudioStream* closest = nullptr;
+    auto distance = [current](const AudioStream& representation) {
+      return std::abs(static_cast<int64_t>(representation.description.bitrate) -
+                      static_cast<int64_t>(current->description.bitrate));
+    };
+    for (const auto& representation : thiz->audio_representations_) {
+      if (representation.language == language &&
+          (!closest || distance(representation) < distance(*closest)))
+        closest = &representation;
+    }
+    return static_cast<int32_t>(closest->description.id);
+  }
+
+  // Automatic selection switches between representations of the same kind
+  // as the current one, e.g. audio of the same language.
+  template<typename RepType>
+  static void UpdateAbrCandidates(EsDashPlayerController* thiz,
+                                  StreamType type,
+                                  const std::vector<RepType>& representations,
+                                  int32_t current_id) {
+    const RepType* current = FindRepresentation(representations, current_id);
+    if (!current || !thiz->abr_engine_) return;
+
+    std::vector<AbrCandidate> candidates;
+    for (const auto& representation : representations) {
+      if (!IsSameKind(representation, *current)) continue;
+      candidates.push_back(MakeAbrCandidate(representation));
     }
+    thiz->abr_engine_->SetCandidates(type, std::move(candidates), current_id);
+  }
+
+  template<typename RepType>
+  static std::vector<std::shared_ptr<const MediaSegmentSequence>>
+  GetSequences(EsDashPlayerController* thiz, StreamType type,
+      const std::vector<RepType>& representations, uint32_t skipped_id) {
+    std::vector<std::shared_ptr<const MediaSegmentSequence>> sequences;
+    for (const auto& representation : representations) {
+      if (representation.description.id == skipped_id) continue;
+      auto sequence = LoadSequence(thiz, type, representation.description.id,
+                                   NetworkExecutor::Priority::kPrefetch);
+      if (sequence) sequences.push_back(std::move(sequence));
+    }
+    return sequences;
+  }
+
+  template<typename RepType>
+  static void PrepareSequences(EsDashPlayerController* thiz, StreamType type,
+                               const std::vector<RepType>& representations) {
+    for (const auto& representation : representations)
+      PostPrepareSequence(thiz, type, representation.description.id);
+  }
+
+  static void PostPrepareSequence(EsDashPlayerController* thiz,
+                                  StreamType type, uint32_t id) {
+    thiz->network_executor_->Post(NetworkExecutor::Priority::kPrefetch,
+        thiz->cc_factory_.NewCallback(
+            &EsDashPlayerController::PrepareSequenceOnWorker,
+            thiz->dash_parser_, type, id));
+  }
+
+  // Starts loading the first manifest of the playlist. Manifests are loaded
+  // one at a time, so they are joined in the order they were enqueued.
+  static void LoadNextPlaylistManifest(EsDashPlayerController* thiz) {
+    if (thiz->playlist_loading_ || thiz->playlist_.empty() ||
+        !thiz->network_executor_ || !thiz->player_thread_)
+      return;
+
+    thiz->playlist_loading_ = true;
+    thiz->network_executor_->Post(NetworkExecutor::Priority::kPrefetch,
+        thiz->cc_factory_.NewCallback(
+            &EsDashPlayerController::LoadPlaylistManifestOnWorker,
+            thiz->playlist_.front(), thiz->player_thread_->message_loop()));
+  }
+
+  // Sequences are usually prepared in advance by the network executor.
+  // Otherwise creating one is done by the executor as well, as it can take
+  // a while for big manifests.
+  static std::shared_ptr<const MediaSegmentSequence> LoadSequence(
+      EsDashPlayerController* thiz, StreamType type, uint32_t id,
+      NetworkExecutor::Priority priority) {
+    auto sequence = thiz->dash_parser_->TakePreparedSequence(
+        static_cast<MediaStreamType>(type), id);
+    if (!sequence) {
+      thiz->network_executor_->RunAndWait(priority, [&]() {
+        sequence = thiz->dash_parser_->GetSequence(
+            static_cast<MediaStreamType>(type), id);
+      });
+    }
+    return sequence;
+  }
+
+  // A sequence of a text representation with its init segment.
+  struct LoadedText {
+    std::shared_ptr<const MediaSegmentSequence> sequence;
+    std::vector<uint8_t> init_segment;
+  };
+
+  // Switches subtitles to a text representation of the manifest. Its
+  // sequence and init segment are loaded on a network executor worker, then
+  // the text stream starts at the given time on the player thread.
+  static void StartTextStream(EsDashPlayerController* thiz, uint32_t id,
+                              TimeTicks time) {
+    if (!FindRepresentation(thiz->text_representations_, id)) {
+      LOG_ERROR("There is no text representation %u", id);
+      return;
+    }
+    thiz->text_stream_.reset();
+    thiz->packets_manager_.ClearTextCues();
+    thiz->text_representation_id_ = id;
+
+    Promise<LoadedText> loaded;
+    auto manifest = thiz->dash_parser_;
+    thiz->network_executor_->PostTask(NetworkExecutor::Priority::kPrefetch,
+        [loaded, manifest, id]() mutable {
+          LoadedText text{manifest->GetSequence(MediaStreamType::Text, id),
+                          std::vector<uint8_t>()};
+          if (text.sequence) {
+            auto segment = text.sequence->GetInitSegment();
+            if (segment && !DownloadSegment(segment.get(), &text.init_segment))
+              LOG_ERROR("Failed to download a text init segment");
+          }
+          loaded.SetValue(std::move(text));
+        });
+    std::weak_ptr<PlayerController> weak_this = thiz->shared_from_this();
+    loaded.GetFuture().Then(thiz->executor_,
+        [weak_this, manifest, id, time](LoadedText text) {
+      auto self = weak_this.lock();
+      if (!self) return;
+      auto controller = static_cast<EsDashPlayerController*>(self.get());
+      // Dropped if subtitles or the media changed meanwhile.
+      if (!controller->player_thread_ || controller->dash_parser_ != manifest ||
+          controller->text_representation_id_ != static_cast<int32_t>(id))
+        return;
+      InitializeTextStream(controller, id, std::move(text), time);
+    });
+  }
+
+  static void InitializeTextStream(EsDashPlayerController* thiz, uint32_t id,
+                                   LoadedText text, TimeTicks time) {
+    // We bravely capture this because we are bound to outlive text_stream_.
+    auto cues_callback = [thiz](std::vector<TextCue> cues) {
+      thiz->packets_manager_.OnTextCues(std::move(cues));
+    };
+    auto text_stream = MakeUnique<TextStreamManager>(thiz->instance_,
+        thiz->network_executor_, thiz->bandwidth_estimator_, thiz->executor_,
+        cues_callback);
+    text_stream->SetPlaybackMetrics(thiz->playback_metrics_.get());
+    if (!text_stream->Initialize(std::move(text.sequence), text.init_segment,
+            *FindRepresentation(thiz->text_representations_, id), time)) {
+      LOG_ERROR("Failed to initialize text representation %u", id);
+      thiz->text_representation_id_ = -1;
+      return;
+    }
+    thiz->text_stream_ = std::move(text_stream);
+    thiz->ScheduleBufferUpdate();
   }
 };
 
+EsDashPlayerController::EsDashPlayerController(
+    const pp::InstanceHandle& instance,
+    std::shared_ptr<Communication::MessageSender> message_sender)
+    : PlayerController(),
+      instance_(instance),
+      tuning_(TuningProfile::Current()),
+      latency_timeline_(MakeUnique<LatencyTimeline>()),
+      pipeline_latency_(MakeUnique<PipelineLatency>()),
+      platform_health_(MakeUnique<PlatformHealth>()),
+      drm_metrics_(MakeUnique<DrmMetrics>()),
+      playback_metrics_(MakeUnique<PlaybackMetrics>()),
+      next_abr_update_(),
+      live_target_buffer_(0.),
+      next_live_catch_up_(),
+      seek_dropping_since_(),
+      next_stall_recovery_(),
+      next_metrics_report_(),
+      metrics_report_interval_(kMetricsReportInterval),
+      buffer_update_scheduled_(false),
+      buffer_update_count_(0),
+      saved_bandwidth_(0.),
+      device_max_bitrate_(0),
+      cc_factory_(this),
+      data_source_attached_(false),
+      subtitles_visible_(true),
+      seeking_(false),
+      media_duration_(0.),
+      message_sender_(message_sender),
+      state_(PlayerState::kUnitialized),
+      packets_manager_(tuning_),
+      text_representation_id_(-1),
+      representation_ids_(),
+      language_history_loaded_(false),
+      alternate_audio_id_(-1),
+      trick_play_(false),
+      playback_rate_(1.),
+      playback_speed_(1.),
+      trick_play_time_(0.),
+      trick_play_generation_(0),
+      resume_after_trick_play_(false),
+      trick_mode_sequence_used_(false),
+      trimmed_(false),
+      trim_time_(0.),
+      start_time_(0.),
+      start_seek_pending_(false),
+      pause_generation_(0),
+      visible_(true),
+      resume_when_visible_(false),
+      video_suspended_(false),
+      playlist_loading_(false),
+      offline_(false) {
+  packets_manager_.SetPlaybackMetrics(playback_metrics_.get());
+}
+
+EsDashPlayerController::~EsDashPlayerController() {}
+
 void EsDashPlayerController::InitPlayer(const std::string& mpd_file_path,
     const std::string& subtitle,
     const std::string& encoding,
@@ -151,19 +979,28 @@ void EsDashPlayerController::InitPlayer(const std::string& mpd_file_path,
     const std::unordered_map<std::string, std::string>&
         drm_key_request_properties) {
   LOG_INFO("Loading media from : [%s]", mpd_file_path.c_str());
-  CleanPlayer();
+  // Loading other media with a working player swaps only its data source,
+  // NaCl Player, network workers and the bandwidth estimate stay. A player
+  // still loading media is not reused, as ResetMedia() would wait for it.
+  bool reuse_player = player_ &&
+      static_cast<int>(state_) > static_cast<int>(PlayerState::kUnitialized);
+  if (reuse_player) {
+    LOG_INFO("Reusing the player.");
+    if (state_ == PlayerState::kPlaying) player_->Pause();
+    ResetMedia();
+  } else {
+    CleanPlayer();
+  }
+  playback_metrics_->Reset();
+  platform_health_->Reset();
+  pipeline_latency_->Reset();
+  drm_metrics_->Reset();
+  latency_timeline_->Start(LatencyTimeline::Operation::kStartup);
 
+  url_ = mpd_file_path;
   drm_license_url_ = drm_license_url;
   drm_key_request_properties_ = drm_key_request_properties;
-  player_ = make_shared<MediaPlayer>();
-  listeners_.player_listener =
-      make_shared<MediaPlayerListener>(message_sender_);
-  listeners_.buffering_listener =
-      make_shared<MediaBufferingListener>(message_sender_,
-                                          shared_from_this());
-
-  player_->SetMediaEventsListener(listeners_.player_listener);
-  player_->SetBufferingListener(listeners_.buffering_listener);
+  if (!reuse_player) InitializeMediaPlayer();
   int32_t ret = player_->SetDisplayRect(view_rect_);
 
   if (ret != ErrorCodes::Success) {
@@ -174,13 +1011,118 @@ void EsDashPlayerController::InitPlayer(const std::string& mpd_file_path,
 
   InitializeSubtitles(subtitle, encoding);
 
-  player_thread_ = MakeUnique<pp::SimpleThread>(instance_);
-  player_thread_->Start();
-  player_thread_->message_loop().PostWork(
+  player_thread_ = ThreadConfig::StartSimpleThread(
+      instance_, ThreadRole::kAppendScheduler);
+  executor_ = custom_executor_ ? custom_executor_
+      : make_shared<MessageLoopExecutor>(player_thread_->message_loop());
+  if (!network_executor_)
+    network_executor_ = make_shared<NetworkExecutor>(instance_);
+  if (!bandwidth_estimator_)
+    bandwidth_estimator_ = make_shared<BandwidthEstimator>();
+  if (!download_arbiter_)
+    // Segment downloads of audio and video streams running at the same
+    // time, fewer than prefetch depths of both streams together.
+    download_arbiter_ = make_shared<DownloadArbiter>(tuning_.download_budget);
+  if (!abr_engine_) {
+    abr_engine_ = MakeUnique<AbrEngine>(bandwidth_estimator_,
+        AbrRule::Create(AbrRule::Type::kHybrid));
+  }
+  // Other content may use other codecs, the device is measured again.
+  device_max_bitrate_ = 0;
+  abr_engine_->SetMaxBitrate(StreamType::Video, 0);
+  OnViewSizeChanged(PP_OK, view_rect_.width(), view_rect_.height());
+  next_abr_update_ = executor_->Now() + milliseconds(kAbrUpdateInterval);
+  executor_->PostWork(
       cc_factory_.NewCallback(&EsDashPlayerController::InitializeDash,
                               mpd_file_path));
 }
 
+void EsDashPlayerController::InitializeMediaPlayer() {
+  player_ = make_shared<MediaPlayer>();
+  listeners_.player_listener = make_shared<MediaPlayerListener>(
+      message_sender_,
+      WeakBind(&EsDashPlayerController::OnTimeUpdate,
+               std::static_pointer_cast<EsDashPlayerController>(
+                   shared_from_this())),
+      WeakBind(&EsDashPlayerController::OnPlayerError,
+               std::static_pointer_cast<EsDashPlayerController>(
+                   shared_from_this()), _1));
+  listeners_.buffering_listener = make_shared<MediaBufferingListener>(
+      message_sender_, shared_from_this(),
+      WeakBind(&EsDashPlayerController::OnBufferingCompleted,
+               std::static_pointer_cast<EsDashPlayerController>(
+                   shared_from_this())),
+      WeakBind(&EsDashPlayerController::OnBufferingStarted,
+               std::static_pointer_cast<EsDashPlayerController>(
+                   shared_from_this())));
+
+  player_->SetMediaEventsListener(listeners_.player_listener);
+  player_->SetBufferingListener(listeners_.buffering_listener);
+  packets_manager_.SetBufferUpdateCallback([this]() {
+    ScheduleBufferUpdate();
+  });
+  packets_manager_.SetTextCueCallback([this](const TextCue& cue) {
+    if (subtitles_visible_)
+      message_sender_->ShowSubtitles(cue.end - cue.start, cue.text);
+  });
+  packets_manager_.SetDecryptableCallback(
+      [this](const ElementaryStreamPacket& packet) {
+        const auto& info = packet.GetEncryptionInfo();
+        return !drm_listener_ ||
+               !drm_listener_->IsKeyPending(info.key_id, info.key_id_size);
+      });
+}
+
+void EsDashPlayerController::SetPreloadedMedia(
+    std::shared_ptr<PreloadedMedia> media) {
+  preloaded_media_ = std::move(media);
+}
+
+std::shared_ptr<PreloadedMedia> EsDashPlayerController::CreateResumeState() {
+  if (!player_ || !dash_parser_ || offline_ ||
+      static_cast<int>(state_) < static_cast<int>(PlayerState::kReady))
+    return nullptr;
+
+  auto media = std::make_shared<PreloadedMedia>(url_, kResumeByteBudget);
+  media->SetManifest(dash_parser_);
+  PreloadedMedia::ResumePoint point;
+  if (trimmed_)
+    point.time = trim_time_;
+  else
+    Impl::GetPlaybackTime(this, &point.time);
+  point.bandwidth = bandwidth_estimator_->EstimatedBandwidth();
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    point.representation_ids[i] = streams_[i] ? representation_ids_[i] : -1;
+    if (streams_[i]) {
+      streams_[i]->CopyCachedSegments(
+          media->GetSegmentCache(static_cast<StreamType>(i)));
+    }
+  }
+  media->SetResumePoint(point);
+  LOG_INFO("Resume state at %f [s], kept %zu bytes of segments", point.time,
+           media->CachedBytes());
+  return media;
+}
+
+void EsDashPlayerController::SetStartTime(TimeTicks start_time) {
+  start_time_ = std::max(start_time, 0.);
+}
+
+void EsDashPlayerController::SetNetworkExecutor(
+    std::shared_ptr<NetworkExecutor> executor) {
+  network_executor_ = std::move(executor);
+}
+
+void EsDashPlayerController::SetTaskExecutor(
+    std::shared_ptr<TaskExecutor> executor) {
+  custom_executor_ = std::move(executor);
+}
+
+void EsDashPlayerController::SetPlaybackTimeSource(
+    std::function<TimeTicks()> source) {
+  playback_time_source_ = std::move(source);
+}
+
 void EsDashPlayerController::InitializeSubtitles(const std::string& subtitle,
                                                  const std::string& encoding) {
   if (subtitle.empty()) return;
@@ -197,14 +1139,44 @@ void EsDashPlayerController::InitializeSubtitles(const std::string& subtitle,
 
 void EsDashPlayerController::InitializeDash(int32_t,
     const std::string& mpd_file_path) {
+  // Base URLs registered while the manifest is parsed start with scores of
+  // previous sessions.
+  BaseUrlSelector::Get().LoadScores();
   // we support only PlayReady right now
   unique_ptr<DrmPlayReadyContentProtectionVisitor> visitor =
       MakeUnique<DrmPlayReadyContentProtectionVisitor>();
-  dash_parser_ = DashManifest::ParseMPD(mpd_file_path, visitor.get());
+  // A stored title is served from storage, its manifest lists only stored
+  // representations, so nothing preloaded from the network is used.
+  offline_ = OfflineStore::Activate(mpd_file_path);
+  if (preloaded_media_ &&
+      (offline_ || preloaded_media_->Url() != mpd_file_path))
+    preloaded_media_.reset();
+  // Segments preloaded for the same URL are used even if preloading didn't
+  // get the manifest in time.
+  if (preloaded_media_) dash_parser_ = preloaded_media_->GetManifest();
+  if (dash_parser_) {
+    LOG_INFO("Using a preloaded manifest.");
+    Impl::MarkLatency(this, LatencyPhase::kManifestDownloaded);
+    Impl::MarkLatency(this, LatencyPhase::kManifestParsed);
+  } else {
+    network_executor_->RunAndWait(NetworkExecutor::Priority::kManifest, [&]() {
+      std::string mpd_data;
+      if (!DashManifest::DownloadManifest(mpd_file_path, &mpd_data)) return;
+      Impl::MarkLatency(this, LatencyPhase::kManifestDownloaded);
+      dash_parser_ = DashManifest::ParseMPD(mpd_file_path, mpd_data,
+                                            visitor.get());
+      if (dash_parser_)
+        Impl::MarkLatency(this, LatencyPhase::kManifestParsed);
+    });
+  }
   if (!dash_parser_) {
     LOG_ERROR("Failed to load/parse MPD manifest file!");
     return;
   }
+  // Streams wait only for indexes of representations they use.
+  network_executor_->Post(NetworkExecutor::Priority::kPrefetch,
+      cc_factory_.NewCallback(
+          &EsDashPlayerController::LoadSegmentIndexesOnWorker, dash_parser_));
 
   auto es_data_source = std::make_shared<ESDataSource>();
   TimeTicks duration = ParseDurationToSeconds(dash_parser_->GetDuration());
@@ -213,40 +1185,266 @@ void EsDashPlayerController::InitializeDash(int32_t,
   if (duration != kInvalidDuration) {
     es_data_source->SetDuration(duration);
     message_sender_->SetMediaDuration(duration);
+  } else if (dash_parser_->IsDynamic()) {
+    LOG_INFO("Dynamic presentation, duration is not known.");
   } else {
     LOG_ERROR("Invalid media duration!");
   }
+  TimeTicks target_latency = dash_parser_->GetTargetLatency();
+  if (target_latency > 0.) {
+    live_target_buffer_ = std::min(
+        std::max(target_latency, kMinLiveTargetBuffer), kMaxLiveTargetBuffer);
+    LOG_INFO("Low-latency live, target latency: %f [s], buffer: %f [s]",
+             target_latency, live_target_buffer_);
+    packets_manager_.SetLowLatency(true);
+  }
   data_source_ = es_data_source;
+  es_backend_ = MakeUnique<NaClEsBackend>(es_data_source);
   media_duration_ = duration;
+  // A start time given by the application takes precedence.
+  PreloadedMedia::ResumePoint resume_point;
+  if (start_time_ == 0. && Impl::GetResumePoint(this, &resume_point)) {
+    LOG_INFO("Resuming a suspended playback at %f [s]", resume_point.time);
+    start_time_ = resume_point.time;
+  }
+  if (start_time_ > 0. && (dash_parser_->IsDynamic() ||
+      (duration != kInvalidDuration && start_time_ >= duration))) {
+    LOG_INFO("Start time %f [s] ignored, playing from the start",
+             start_time_);
+    start_time_ = 0.;
+  }
+  start_seek_pending_ = start_time_ > 0.;
   for (auto& stream : streams_)
     stream.reset();
   video_representations_ = dash_parser_->GetVideoStreams();
   audio_representations_ = dash_parser_->GetAudioStreams();
-
-  player_thread_->message_loop().PostWork(
+  text_representations_ = dash_parser_->GetTextStreams();
+  Impl::StartContentSteering(this);
+  Impl::WarmUpConnections(this);
+  Impl::PrepareSequences(this, StreamType::Video, video_representations_);
+  Impl::PrepareSequences(this, StreamType::Audio, audio_representations_);
+  InitializeThumbnails();
+
+  executor_->PostWork(
       cc_factory_.NewCallback(&EsDashPlayerController::InitializeStreams));
-  player_thread_->message_loop().PostWork(
-      cc_factory_.NewCallback(&EsDashPlayerController::UpdateStreamsBuffer));
+  ScheduleBufferUpdate();
+  if (dash_parser_->IsDynamic())
+    ScheduleManifestRefresh(dash_parser_, player_thread_->message_loop());
 }
 
-void EsDashPlayerController::InitializeStreams(int32_t) {
-  // Currently only Playready is supported
-  DRMType drm_type = DRMType_Playready;
+void EsDashPlayerController::InitializeThumbnails() {
+  auto images = dash_parser_->GetImageStreams();
+  if (images.empty()) return;
+
+  // Thumbnails are small, the smallest images are enough.
+  auto image = std::min_element(images.begin(), images.end(),
+      [](const ImageStream& a, const ImageStream& b) {
+        return a.description.bitrate < b.description.bitrate;
+      });
+  auto sequence = dash_parser_->GetImageSequence(image->description.id);
+  if (!sequence) return;
+
+  auto message_sender = message_sender_;
+  thumbnail_provider_ = std::make_shared<ThumbnailProvider>(
+      network_executor_, *image, std::move(sequence),
+      [message_sender](const Thumbnail& thumbnail) {
+        message_sender->Thumbnail(thumbnail.time, thumbnail.url,
+                                  thumbnail.mime_type, thumbnail.image,
+                                  thumbnail.tile);
+      });
+  LOG_INFO("Thumbnails from image representation %u, %ux%u tiles",
+           image->description.id, image->tile_columns, image->tile_rows);
+}
+
+void EsDashPlayerController::ScheduleManifestRefresh(
+    const std::shared_ptr<DashManifest>& manifest,
+    pp::MessageLoop player_loop) {
+  double period = manifest->GetMinimumUpdatePeriod();
+  if (period < 0.) {
+    LOG_INFO("Dynamic manifest doesn't need to be refreshed.");
+    return;
+  }
+
+  auto delay_ms = std::max(kMinManifestRefreshDelay,
+                           static_cast<int64_t>(period * 1000));
+  player_loop.PostWork(cc_factory_.NewCallback(
+      &EsDashPlayerController::RefreshManifest, manifest), delay_ms);
+}
+
+void EsDashPlayerController::RefreshManifest(int32_t,
+    const std::shared_ptr<DashManifest>& manifest) {
+  if (manifest != dash_parser_ || !network_executor_ || !player_thread_)
+    return;
+
+  network_executor_->Post(NetworkExecutor::Priority::kManifest,
+      cc_factory_.NewCallback(&EsDashPlayerController::RefreshManifestOnWorker,
+                              manifest, player_thread_->message_loop()));
+}
+
+void EsDashPlayerController::RefreshManifestOnWorker(int32_t,
+    const std::shared_ptr<DashManifest>& manifest,
+    pp::MessageLoop player_loop) {
+  // A failed refresh is retried after the update period.
+  manifest->Refresh();
+  ScheduleManifestRefresh(manifest, player_loop);
+}
 
-  InitializeVideoStream(drm_type);
-  InitializeAudioStream(drm_type);
+void EsDashPlayerController::ScheduleSteeringUpdate(
+    const std::shared_ptr<ContentSteering>& steering,
+    pp::MessageLoop player_loop, double delay) {
+  player_loop.PostWork(cc_factory_.NewCallback(
+      &EsDashPlayerController::UpdateSteering, steering),
+      static_cast<int64_t>(delay * 1000));
 }
 
-void EsDashPlayerController::InitializeVideoStream(
-    Samsung::NaClPlayer::DRMType drm_type) {
-  Impl::InitializeStream(this, StreamType::Video, drm_type,
-                         video_representations_);
+void EsDashPlayerController::UpdateSteering(int32_t,
+    const std::shared_ptr<ContentSteering>& steering) {
+  if (steering != content_steering_ || !network_executor_ || !player_thread_)
+    return;
+
+  network_executor_->Post(NetworkExecutor::Priority::kManifest,
+      cc_factory_.NewCallback(&EsDashPlayerController::UpdateSteeringOnWorker,
+                              steering, player_thread_->message_loop()));
+}
+
+void EsDashPlayerController::UpdateSteeringOnWorker(int32_t,
+    const std::shared_ptr<ContentSteering>& steering,
+    pp::MessageLoop player_loop) {
+  double ttl = steering->Update();
+  ScheduleSteeringUpdate(steering, player_loop, ttl);
+}
+
+void EsDashPlayerController::OnEnqueueMedia(int32_t, const std::string& url) {
+  playlist_.push_back(url);
+  Impl::LoadNextPlaylistManifest(this);
+}
+
+void EsDashPlayerController::LoadPlaylistManifestOnWorker(int32_t,
+    const std::string& url, pp::MessageLoop player_loop) {
+  unique_ptr<DrmPlayReadyContentProtectionVisitor> visitor =
+      MakeUnique<DrmPlayReadyContentProtectionVisitor>();
+  std::shared_ptr<DashManifest> manifest =
+      DashManifest::ParseMPD(url, visitor.get());
+  player_loop.PostWork(cc_factory_.NewCallback(
+      &EsDashPlayerController::AppendManifest, manifest));
+}
+
+void EsDashPlayerController::AppendManifest(int32_t,
+    const std::shared_ptr<DashManifest>& manifest) {
+  playlist_loading_ = false;
+  if (playlist_.empty()) return;
+
+  std::string url = playlist_.front();
+  playlist_.pop_front();
+  std::shared_ptr<DashManifest> joined;
+  if (manifest && dash_parser_)
+    joined = DashManifest::Concatenate(dash_parser_, manifest);
+  if (joined) {
+    LOG_INFO("[%s] is played after the current media", url.c_str());
+    dash_parser_ = joined;
+    media_duration_ = ParseDurationToSeconds(dash_parser_->GetDuration());
+    es_backend_->SetDuration(media_duration_);
+    message_sender_->SetMediaDuration(media_duration_);
+    // Sequences of the joined manifest start with the same segments as the
+    // ones in use, so streams switch to them once requested segments are
+    // downloaded. Packets of the next presentation get its timestamp offset
+    // and its config is buffered before them, if it differs.
+    for (size_t i = 0; i < streams_.size(); ++i) {
+      if (!streams_[i]) continue;
+      OnChangeRepresentation(PP_OK, static_cast<StreamType>(i),
+                             representation_ids_[i]);
+    }
+  } else {
+    LOG_ERROR("Failed to add [%s] to the playlist", url.c_str());
+  }
+  Impl::LoadNextPlaylistManifest(this);
+}
+
+void EsDashPlayerController::LoadSegmentIndexesOnWorker(int32_t,
+    const std::shared_ptr<DashManifest>& manifest) {
+  manifest->LoadSegmentIndexes();
+}
+
+void EsDashPlayerController::PrepareSequenceOnWorker(int32_t,
+    const std::shared_ptr<DashManifest>& manifest, StreamType type,
+    uint32_t id) {
+  manifest->PrepareSequence(static_cast<MediaStreamType>(type), id);
 }
 
-void EsDashPlayerController::InitializeAudioStream(
-    Samsung::NaClPlayer::DRMType drm_type) {
-  Impl::InitializeStream(this, StreamType::Audio, drm_type,
-                         audio_representations_);
+void EsDashPlayerController::InitializeStreams(int32_t) {
+  // A resumed playback continues with the estimate it had. Otherwise, it's
+  // read here, as the storage can't be used on the main thread.
+  PreloadedMedia::ResumePoint resume_point;
+  if (Impl::GetResumePoint(this, &resume_point) &&
+      resume_point.bandwidth > 0.) {
+    saved_bandwidth_ = resume_point.bandwidth;
+  } else {
+    saved_bandwidth_ = BandwidthEstimator::LoadSavedEstimate();
+  }
+  if (saved_bandwidth_ > 0.)
+    LOG_INFO("Bandwidth saved by previous session: %.0f", saved_bandwidth_);
+  if (abr_engine_) abr_engine_->SetSavedBandwidth(saved_bandwidth_);
+
+  VideoStream video;
+  AudioStream audio;
+  bool has_video = Impl::SelectStream(this, StreamType::Video,
+                                      video_representations_, &video);
+  bool has_audio = Impl::SelectStream(this, StreamType::Audio,
+                                      audio_representations_, &audio);
+  // External subtitles take precedence over the ones of the manifest.
+  if (!text_track_ && !text_representations_.empty()) {
+    Impl::StartTextStream(this, text_representations_.front().description.id,
+                          start_time_);
+  }
+  bool video_preconfigured = false;
+  bool audio_preconfigured = false;
+  has_video = has_video && Impl::CreateStream(this, StreamType::Video, video,
+                                              &video_preconfigured);
+  has_audio = has_audio && Impl::CreateStream(this, StreamType::Audio, audio,
+                                              &audio_preconfigured);
+  // When the manifest describes all streams well enough, they are configured
+  // from it and the data source is attached while init segments are still
+  // downloaded. Configs demuxed from them replace provisional ones only if
+  // they differ.
+  if ((has_video || has_audio) && has_video == video_preconfigured &&
+      has_audio == audio_preconfigured)
+    FinishStreamConfiguration();
+
+  // Segment indexes and init segments of both streams are downloaded at the
+  // same time, so startup waits for the slower of them only. A license
+  // request, made for DRM init data from the manifest, is run meanwhile. The
+  // player thread isn't blocked until then.
+  std::vector<Future<Impl::LoadedStream>> loaded_streams;
+  std::vector<Future<bool>> built_sequences;
+  if (has_video) {
+    Promise<bool> sequence_built;
+    built_sequences.push_back(sequence_built.GetFuture());
+    loaded_streams.push_back(Impl::LoadStreamData(
+        this, StreamType::Video, video.description.id, sequence_built));
+  }
+  if (has_audio) {
+    Promise<bool> sequence_built;
+    built_sequences.push_back(sequence_built.GetFuture());
+    loaded_streams.push_back(Impl::LoadStreamData(
+        this, StreamType::Audio, audio.description.id, sequence_built));
+  }
+
+  std::weak_ptr<PlayerController> weak_this = shared_from_this();
+  WhenAll(built_sequences).Then(executor_, [weak_this](std::vector<bool>) {
+    if (auto self = weak_this.lock()) {
+      Impl::MarkLatency(static_cast<EsDashPlayerController*>(self.get()),
+                        LatencyPhase::kSequencesBuilt);
+    }
+  });
+  auto manifest = dash_parser_;
+  WhenAll(loaded_streams).Then(executor_,
+      [weak_this, manifest](std::vector<Impl::LoadedStream> loaded) {
+    if (auto self = weak_this.lock()) {
+      Impl::InitializeLoadedStreams(
+          static_cast<EsDashPlayerController*>(self.get()), manifest,
+          std::move(loaded));
+    }
+  });
 }
 
 void EsDashPlayerController::Play() {
@@ -255,10 +1453,14 @@ void EsDashPlayerController::Play() {
     return;
   }
 
+  ++pause_generation_;
+  // Buffers are downloaded again from the position they were trimmed at.
+  if (trimmed_) Seek(trim_time_);
   int32_t ret = player_->Play();
   if (ret == ErrorCodes::Success) {
     LOG_INFO("Play called successfully");
     state_ = PlayerState::kPlaying;
+    ScheduleBufferUpdate();
   } else {
     LOG_ERROR("Play call failed, code: %d", ret);
   }
@@ -274,31 +1476,150 @@ void EsDashPlayerController::Pause() {
   if (ret == ErrorCodes::Success) {
     LOG_INFO("Pause called successfully");
     state_ = PlayerState::kPaused;
+    pp::MessageLoop::GetForMainThread().PostWork(cc_factory_.NewCallback(
+        &EsDashPlayerController::OnIdleTrim, ++pause_generation_),
+        kIdleTrimDelay);
   } else {
     LOG_ERROR("Pause call failed, code: %d", ret);
   }
 }
 
+void EsDashPlayerController::Trim() {
+  if (!player_ || state_ != PlayerState::kPaused || seeking_ || trick_play_ ||
+      trimmed_)
+    return;
+
+  Impl::GetPlaybackTime(this, &trim_time_);
+  LOG_INFO("Trimming buffers at %f [s]", trim_time_);
+  trimmed_ = true;
+  for (const auto& stream : streams_) {
+    if (stream) stream->Trim();
+  }
+  packets_manager_.PrepareForSeek(trim_time_);
+  // Segments at the position are downloaded again and kept in segment
+  // caches, so resuming doesn't wait for them.
+  if (executor_) {
+    executor_->PostWork(cc_factory_.NewCallback(
+        &EsDashPlayerController::PrefetchSeekTarget, trim_time_));
+  }
+}
+
+void EsDashPlayerController::OnIdleTrim(int32_t, uint32_t pause_generation) {
+  if (pause_generation != pause_generation_) return;
+
+  Trim();
+}
+
+void EsDashPlayerController::SetVisible(bool visible) {
+  if (visible == visible_) return;
+
+  visible_ = visible;
+  if (!visible) {
+    resume_when_visible_ = state_ == PlayerState::kPlaying;
+    if (resume_when_visible_) Pause();
+    Trim();
+  } else if (resume_when_visible_) {
+    resume_when_visible_ = false;
+    Play();
+  }
+}
+
+void EsDashPlayerController::SetAudioOnly(bool audio_only) {
+  const auto& video_stream = streams_[static_cast<int32_t>(StreamType::Video)];
+  if (audio_only == video_suspended_) return;
+  if (!player_ || !video_stream ||
+      !streams_[static_cast<int32_t>(StreamType::Audio)] ||
+      static_cast<int>(state_) < static_cast<int>(PlayerState::kReady)) {
+    LOG_INFO("No audio and video streams to play, ignoring audio only mode");
+    return;
+  }
+
+  video_suspended_ = audio_only;
+  if (audio_only) {
+    LOG_INFO("Suspending video, playing audio only");
+    // As with trimmed buffers, the stream waits for the next seek.
+    video_stream->Trim();
+    packets_manager_.SetStreamSuspended(StreamType::Video, true);
+    return;
+  }
+
+  // NaCl Player seeks all streams at once, so video catches up with audio
+  // by a seek to the current position.
+  TimeTicks playback_time = 0.;
+  Impl::GetPlaybackTime(this, &playback_time);
+  LOG_INFO("Resuming video at %f [s]", playback_time);
+  packets_manager_.SetStreamSuspended(StreamType::Video, false);
+  Seek(playback_time);
+}
+
 void EsDashPlayerController::CleanPlayer() {
   LOG_INFO("Cleaning player.");
   if (!player_) return;
+  drm_metrics_->LogReport();
+  pipeline_latency_->LogReport();
   player_->SetMediaEventsListener(nullptr);
-  player_->SetSubtitleListener(nullptr);
   player_->SetBufferingListener(nullptr);
+  ResetMedia();
+  player_.reset();
+  previous_data_source_.reset();
+  network_executor_.reset();
+  bandwidth_estimator_.reset();
+  download_arbiter_.reset();
+  abr_engine_.reset();
+  LOG_INFO("Finished closing.");
+}
+
+void EsDashPlayerController::ResetMedia() {
+  // Tasks of the previous media are dropped, the ones posted to the player
+  // thread with it.
+  cc_factory_.CancelAll();
+  player_->SetSubtitleListener(nullptr);
   player_->SetDRMListener(nullptr);
   player_thread_.reset();
+  executor_.reset();
+  es_backend_.reset();
+  // NaCl Player keeps using the data source until another one is attached.
+  if (data_source_attached_) previous_data_source_ = std::move(data_source_);
   data_source_.reset();
+  data_source_attached_ = false;
   dash_parser_.reset();
+  content_steering_.reset();
+  drm_listener_.reset();
   text_track_.reset();
-  player_.reset();
   packets_manager_.SetStream(StreamType::Audio, nullptr);
   packets_manager_.SetStream(StreamType::Video, nullptr);
   for (auto& stream : streams_)
     stream.reset();
+  for (auto& stream : loading_streams_)
+    stream.reset();
+  text_stream_.reset();
+  text_representation_id_ = -1;
+  thumbnail_provider_.reset();
+  packets_manager_.Reset();
+  live_target_buffer_ = 0.;
+  packets_manager_.SetLowLatency(false);
+  waiting_seek_.reset();
+  for (auto& change : waiting_representation_changes_)
+    change.reset();
+  seeking_ = false;
+  trick_play_ = false;
+  playback_rate_ = 1.;
+  playback_speed_ = 1.;
+  packets_manager_.SetPlaybackRate(1.);
+  ++trick_play_generation_;
+  trick_mode_sequence_used_ = false;
+  trimmed_ = false;
+  ++pause_generation_;
+  resume_when_visible_ = false;
+  video_suspended_ = false;
+  playlist_.clear();
+  playlist_loading_ = false;
   state_ = PlayerState::kUnitialized;
   video_representations_.clear();
   audio_representations_.clear();
-  LOG_INFO("Finished closing.");
+  text_representations_.clear();
+  alternate_audio_id_ = -1;
+  alternate_audio_sequence_.reset();
 }
 
 void EsDashPlayerController::Seek(TimeTicks original_time) {
@@ -307,33 +1628,41 @@ void EsDashPlayerController::Seek(TimeTicks original_time) {
     return;
   }
   if (seeking_) {
+    // The platform seek has to complete before the next one is made, but
+    // nothing is downloaded for it anymore.
+    if (!waiting_seek_) {
+      for (const auto& stream : streams_) {
+        if (stream) stream->CancelSeek();
+      }
+    }
     waiting_seek_ = MakeUnique<TimeTicks>(original_time);
+    // Segments at the queued position are downloaded while the current seek
+    // completes. A trick mode needs only a keyframe of them.
+    if (!trick_play_) PreviewSeek(original_time);
     return;
   }
   seeking_ = true;
-  // Seeking very close to media_duration_ will most likely place us after
-  // last segment. kSegmentMargin is substracted  from media_duration_, which
-  // will pretty reliable place us within the segment.
-  constexpr Samsung::NaClPlayer::TimeTicks kSegmentMargin = 0.25;
-  if (original_time > media_duration_ - kSegmentMargin) {
-    original_time = media_duration_ - kSegmentMargin;
-  } else if (original_time < kEps) {
-    original_time = 0.;
-  }
-  auto to_time = streams_[static_cast<int>(StreamType::Video)]
-      ->GetClosestKeyframeTime(original_time);
+  trimmed_ = false;
+  // A seek made after superseded ones continues their timeline. Trick mode
+  // steps are not measured.
+  if (!trick_play_)
+    latency_timeline_->Start(LatencyTimeline::Operation::kSeek, true);
+  auto to_time = GetSeekTarget(original_time);
   LOG_INFO("Requested seek to %f [s], adjusted time to keyframe at %f [s]",
            original_time, to_time);
-
-  if (drm_listener_)
-    drm_listener_->Reset();
-
-  for (const auto& stream : streams_) {
-    if (stream)
-      stream->PrepareForSeek(to_time);
+  // A seek into packets which are queued already (e.g. a short skip forward)
+  // drops the ones before it and goes on without new downloads. Trick modes
+  // request single keyframes, so they always seek streams.
+  bool in_buffer = !trick_play_ && packets_manager_.CanSeekInBuffer(to_time);
+  if (in_buffer) LOG_INFO("Seek to %f [s] is served from buffer", to_time);
+
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    if (streams_[i] && !Impl::IsSuspended(this, static_cast<StreamType>(i)))
+      streams_[i]->PrepareForSeek(to_time, in_buffer);
   }
 
-  packets_manager_.PrepareForSeek(to_time);
+  packets_manager_.PrepareForSeek(to_time, in_buffer);
+  if (text_stream_) text_stream_->PrepareForSeek(to_time);
 
   auto callback = WeakBind(&EsDashPlayerController::OnSeek,
       std::static_pointer_cast<EsDashPlayerController>(
@@ -345,6 +1674,150 @@ void EsDashPlayerController::Seek(TimeTicks original_time) {
   }
 }
 
+void EsDashPlayerController::PreviewSeek(TimeTicks to_time) {
+  if (state_ == PlayerState::kFinished || !player_thread_) return;
+
+  if (thumbnail_provider_) thumbnail_provider_->Request(to_time);
+  executor_->PostWork(cc_factory_.NewCallback(
+      &EsDashPlayerController::PrefetchSeekTarget, to_time));
+}
+
+TimeTicks EsDashPlayerController::GetSeekTarget(TimeTicks time) {
+  // Seeking very close to media_duration_ will most likely place us after
+  // last segment. kSegmentMargin is substracted  from media_duration_, which
+  // will pretty reliable place us within the segment.
+  constexpr Samsung::NaClPlayer::TimeTicks kSegmentMargin = 0.25;
+  if (time > media_duration_ - kSegmentMargin) {
+    time = media_duration_ - kSegmentMargin;
+  } else if (time < kEps) {
+    time = 0.;
+  }
+  const auto& video_stream = streams_[static_cast<int>(StreamType::Video)];
+  return video_stream ? video_stream->GetClosestKeyframeTime(time) : time;
+}
+
+void EsDashPlayerController::PrefetchSeekTarget(int32_t, TimeTicks time) {
+  auto to_time = GetSeekTarget(time);
+  LOG_DEBUG("Prefetching segments at %f [s] for a seek to %f [s]", to_time,
+            time);
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    if (streams_[i] && !Impl::IsSuspended(this, static_cast<StreamType>(i)))
+      streams_[i]->PrefetchSegment(to_time);
+  }
+}
+
+void EsDashPlayerController::SetPlaybackRate(double rate) {
+  if (state_ == PlayerState::kFinished || !player_thread_) return;
+
+  executor_->PostWork(cc_factory_.NewCallback(
+      &EsDashPlayerController::OnSetPlaybackRate, rate));
+}
+
+void EsDashPlayerController::OnSetPlaybackRate(int32_t, double rate) {
+  if (!player_ || state_ == PlayerState::kUnitialized) return;
+
+  if (!trick_play_ && Impl::SetPlaybackSpeed(this, rate)) return;
+
+  if (std::fabs(rate) <= 1.) {
+    if (trick_play_) StopTrickPlay();
+    return;
+  }
+
+  playback_rate_ = std::max(-kMaxPlaybackRate,
+                            std::min(rate, kMaxPlaybackRate));
+  if (trick_play_) {
+    LOG_INFO("Trick play rate changed to %f", playback_rate_);
+    return;
+  }
+
+  // A trick mode pauses the playback, it resumes at the normal speed.
+  Impl::SetPlaybackSpeed(this, 1.);
+  Impl::GetPlaybackTime(this, &trick_play_time_);
+  resume_after_trick_play_ = state_ == PlayerState::kPlaying;
+  trick_play_ = true;
+  ++trick_play_generation_;
+  LOG_INFO("Starting trick play at %f [s], rate: %f", trick_play_time_,
+           playback_rate_);
+  for (const auto& stream : streams_) {
+    if (stream) stream->SetTrickPlay(true);
+  }
+
+  // Keyframe only representations are much smaller than regular ones.
+  const auto& video_stream = streams_[static_cast<int32_t>(StreamType::Video)];
+  if (video_stream && dash_parser_) {
+    std::shared_ptr<const MediaSegmentSequence> sequence;
+    network_executor_->RunAndWait(NetworkExecutor::Priority::kInitSegment,
+                                  [&]() {
+      sequence = dash_parser_->GetTrickModeSequence();
+    });
+    trick_mode_sequence_used_ = static_cast<bool>(sequence);
+    if (sequence) {
+      LOG_INFO("Using a trick mode representation");
+      video_stream->SetMediaSegmentSequence(std::move(sequence), false);
+    }
+  }
+  OnTrickPlayStep(PP_OK, trick_play_generation_);
+}
+
+void EsDashPlayerController::OnTrickPlayStep(int32_t, uint32_t generation) {
+  if (!trick_play_ || generation != trick_play_generation_ || !player_thread_)
+    return;
+
+  trick_play_time_ += playback_rate_ * kTrickPlayStepDelay / 1000.;
+  bool at_end = media_duration_ > 0. && trick_play_time_ >= media_duration_;
+  if (trick_play_time_ <= 0. || at_end) {
+    trick_play_time_ = at_end ? media_duration_ : 0.;
+    LOG_INFO("Trick play reached the %s of the content",
+             at_end ? "end" : "beginning");
+    StopTrickPlay();
+    return;
+  }
+
+  // A seek which doesn't finish before the next step is replaced by it, so
+  // slow downloads show less frames instead of lagging behind.
+  pp::MessageLoop::GetForMainThread().PostWork(cc_factory_.NewCallback(
+      &EsDashPlayerController::OnTrickPlaySeek, trick_play_time_, false));
+  executor_->PostWork(cc_factory_.NewCallback(
+      &EsDashPlayerController::OnTrickPlayStep, generation),
+      kTrickPlayStepDelay);
+}
+
+void EsDashPlayerController::StopTrickPlay() {
+  trick_play_ = false;
+  ++trick_play_generation_;
+  playback_rate_ = 1.;
+  LOG_INFO("Stopping trick play at %f [s]", trick_play_time_);
+  for (const auto& stream : streams_) {
+    if (stream) stream->SetTrickPlay(false);
+  }
+
+  const auto& video_stream = streams_[static_cast<int32_t>(StreamType::Video)];
+  if (trick_mode_sequence_used_ && video_stream) {
+    trick_mode_sequence_used_ = false;
+    video_stream->SetMediaSegmentSequence(Impl::LoadSequence(
+        this, StreamType::Video,
+        representation_ids_[static_cast<size_t>(StreamType::Video)],
+        NetworkExecutor::Priority::kInitSegment), false);
+  }
+  pp::MessageLoop::GetForMainThread().PostWork(cc_factory_.NewCallback(
+      &EsDashPlayerController::OnTrickPlaySeek, trick_play_time_, true));
+}
+
+void EsDashPlayerController::OnTrickPlaySeek(int32_t, TimeTicks time,
+                                             bool resume) {
+  if (!player_ || (!resume && !trick_play_)) return;
+
+  if (!resume && state_ == PlayerState::kPlaying) Pause();
+  Seek(time);
+  if (resume && resume_after_trick_play_) Play();
+}
+
+void EsDashPlayerController::OnLiveCatchUpSeek(int32_t, TimeTicks time) {
+  if (!player_ || state_ != PlayerState::kPlaying || trick_play_) return;
+
+  Seek(time);
+}
+
 void EsDashPlayerController::OnSeek(int32_t ret) {
   if (ret == PP_OK) {
     seeking_ = false;
@@ -355,8 +1828,9 @@ void EsDashPlayerController::OnSeek(int32_t ret) {
       return;
     }
     TimeTicks current_playback_time = 0.0;
-    player_->GetCurrentTime(current_playback_time);
+    Impl::GetPlaybackTime(this, &current_playback_time);
     LOG_INFO("After seek, time: %f, result: %d", current_playback_time, ret);
+    Impl::MarkLatency(this, LatencyPhase::kSeekCompleted);
   } else {
     LOG_ERROR("Seek failed with code: %d", ret);
   }
@@ -364,32 +1838,395 @@ void EsDashPlayerController::OnSeek(int32_t ret) {
   PerformWaitingOperations();
 }
 
+void EsDashPlayerController::OnLicenseInstalled() {
+  Impl::MarkLatency(this, LatencyPhase::kLicenseInstalled);
+  // Packets of the key may wait for it.
+  ScheduleBufferUpdate();
+}
+
+void EsDashPlayerController::OnBufferingCompleted() {
+  Impl::MarkLatency(this, LatencyPhase::kBufferingCompleted);
+  double rebuffer_duration;
+  if (!playback_metrics_->EndRebuffer(&rebuffer_duration)) return;
+  auto event = make_shared<Communication::QoeEventData>();
+  event->type = Communication::QoeEventData::Type::kRebufferEnd;
+  event->rebuffer_duration = rebuffer_duration;
+  PostQoeEvent(std::move(event));
+}
+
+void EsDashPlayerController::OnBufferingStarted() {
+  // Buffering after a startup or a seek is expected, a trick mode pauses
+  // the player.
+  if (state_ != PlayerState::kPlaying || seeking_ || trick_play_) return;
+  if (!playback_metrics_->StartRebuffer()) return;
+  auto event = make_shared<Communication::QoeEventData>();
+  event->type = Communication::QoeEventData::Type::kRebufferStart;
+  PostQoeEvent(std::move(event));
+}
+
+void EsDashPlayerController::OnTimeUpdate() {
+  platform_health_->AddTimeUpdate(
+      state_ == PlayerState::kPlaying && !seeking_ && !trick_play_);
+  ScheduleBufferUpdate();
+}
+
+void EsDashPlayerController::OnPlayerError(MediaPlayerError error) {
+  platform_health_->AddError(static_cast<int32_t>(error));
+  auto event = make_shared<Communication::QoeEventData>();
+  event->type = Communication::QoeEventData::Type::kError;
+  event->error = static_cast<int32_t>(error);
+  PostQoeEvent(std::move(event));
+}
+
+void EsDashPlayerController::PostQoeEvent(
+    std::shared_ptr<Communication::QoeEventData> event) {
+  if (!player_thread_) return;
+  // The state is gathered a moment later, but the event keeps its time.
+  event->timestamp = duration<double, std::milli>(
+      system_clock::now().time_since_epoch()).count();
+  executor_->PostWork(cc_factory_.NewCallback(
+      &EsDashPlayerController::OnQoeEvent, event));
+}
+
+void EsDashPlayerController::OnQoeEvent(int32_t,
+    const std::shared_ptr<Communication::QoeEventData>& event) {
+  TimeTicks playback_time = 0.;
+  if (player_ &&
+      static_cast<int>(state_) > static_cast<int>(PlayerState::kReady))
+    Impl::GetPlaybackTime(this, &playback_time);
+  event->playback_time = playback_time;
+  event->video_buffer = std::max(
+      packets_manager_.GetBufferedTime(StreamType::Video) - playback_time,
+      0.0);
+  event->audio_buffer = std::max(
+      packets_manager_.GetBufferedTime(StreamType::Audio) - playback_time,
+      0.0);
+  const auto& video = streams_[static_cast<size_t>(StreamType::Video)];
+  const auto& audio = streams_[static_cast<size_t>(StreamType::Audio)];
+  event->video_representation_id = video
+      ? representation_ids_[static_cast<size_t>(StreamType::Video)] : -1;
+  event->audio_representation_id = audio
+      ? representation_ids_[static_cast<size_t>(StreamType::Audio)] : -1;
+  event->video_pending_segments = video ? video->GetPendingSegments() : 0;
+  event->audio_pending_segments = audio ? audio->GetPendingSegments() : 0;
+  event->video_queued_bytes =
+      packets_manager_.GetBufferedBytes(StreamType::Video);
+  event->audio_queued_bytes =
+      packets_manager_.GetBufferedBytes(StreamType::Audio);
+  event->pending_licenses =
+      drm_listener_ ? drm_listener_->PendingRequests() : 0;
+  if (event->type == Communication::QoeEventData::Type::kRebufferStart) {
+    const auto& appended =
+        Impl::GetBufferedRanges(this, StreamType::Video).appended;
+    platform_health_->AddBuffering(
+        appended.start <= playback_time ? appended.end - playback_time : 0.);
+  }
+  LOG_INFO("QoE event %d at %f [s], buffered video: %f audio: %f [s], "
+           "pending segments video: %u audio: %u, pending licenses: %u",
+           static_cast<int>(event->type), playback_time, event->video_buffer,
+           event->audio_buffer, event->video_pending_segments,
+           event->audio_pending_segments, event->pending_licenses);
+  message_sender_->QoeEvent(*event);
+}
+
+void EsDashPlayerController::EnqueueMedia(const std::string& url) {
+  if (!player_thread_) {
+    LOG_INFO("EnqueueMedia. Player is not initialized");
+    return;
+  }
+
+  LOG_INFO("Enqueueing media: [%s]", url.c_str());
+  executor_->PostWork(cc_factory_.NewCallback(
+      &EsDashPlayerController::OnEnqueueMedia, url));
+}
+
 void EsDashPlayerController::ChangeRepresentation(StreamType stream_type,
                                                   int32_t id) {
   LOG_INFO("Changing rep type: %d -> %d", stream_type, id);
-  player_thread_->message_loop().PostWork(cc_factory_.NewCallback(
-      &EsDashPlayerController::OnChangeRepresentation, stream_type, id));
+  executor_->PostWork(cc_factory_.NewCallback(
+      &EsDashPlayerController::OnSelectRepresentation, stream_type, id));
+}
+
+void EsDashPlayerController::OnSelectRepresentation(int32_t, StreamType type,
+                                                    int32_t id) {
+  if (abr_engine_) abr_engine_->SetManual(type, id >= 0);
+  if (id < 0) {
+    LOG_INFO("Representations of stream %d are selected automatically",
+             static_cast<int32_t>(type));
+    return;
+  }
+
+  OnChangeRepresentation(PP_OK, type, id);
 }
 
 void EsDashPlayerController::OnChangeRepresentation(int32_t, StreamType type,
-                                                     int32_t id) {
-  if (seeking_) {
+                                                     int32_t id,
+                                                     bool replace_buffered) {
+  // Trimmed streams have no demuxers until a seek restores them.
+  if (seeking_ || trimmed_) {
     waiting_representation_changes_[static_cast<size_t>(type)]
         = MakeUnique<int32_t>(id);
     return;
   }
 
-  if (drm_listener_)
-    drm_listener_->Reset();
+  // A change of the audio language is heard right after packets appended
+  // already, rather than after everything buffered.
+  bool language_change = false;
+  if (type == StreamType::Audio) {
+    const AudioStream* previous = Impl::FindRepresentation(
+        audio_representations_, representation_ids_[static_cast<size_t>(type)]);
+    const AudioStream* next = Impl::FindRepresentation(
+        audio_representations_, id);
+    language_change = previous && next && previous->language != next->language;
+    if (language_change) {
+      Impl::AddToLanguageHistory(this, next->language);
+      alternate_audio_id_ = -1;
+      alternate_audio_sequence_.reset();
+    }
+  }
+  representation_ids_[static_cast<size_t>(type)] = id;
+  if (type == StreamType::Video) platform_health_->SetRepresentation(id);
+  // The trick mode representation is replaced with this one when the trick
+  // mode ends.
+  if (type == StreamType::Video && trick_mode_sequence_used_) return;
+
+  if (type == StreamType::Video)
+    Impl::UpdateAbrCandidates(this, type, video_representations_, id);
+  else
+    Impl::UpdateAbrCandidates(this, type, audio_representations_, id);
 
   const auto& stream_manager =
       streams_[static_cast<int32_t>(type)];
-  stream_manager->SetMediaSegmentSequence(
-      dash_parser_->GetSequence(static_cast<MediaStreamType>(type), id));
+  if (!stream_manager) {
+    // The stream is still loaded, the change is made once it's initialized.
+    waiting_representation_changes_[static_cast<size_t>(type)]
+        = MakeUnique<int32_t>(id);
+    return;
+  }
+  auto sequence = Impl::LoadSequence(
+      this, type, id, NetworkExecutor::Priority::kInitSegment);
+  if (language_change)
+    stream_manager->ReplaceMediaSegmentSequence(std::move(sequence));
+  else
+    stream_manager->SetMediaSegmentSequence(std::move(sequence),
+                                            replace_buffered);
+}
+
+void EsDashPlayerController::AdaptRepresentations(TimeTicks playback_time) {
+  if (!abr_engine_ || seeking_ || trick_play_ || trimmed_) return;
+
+  auto now = executor_->Now();
+  if (now < next_abr_update_) return;
+  next_abr_update_ = now + milliseconds(kAbrUpdateInterval);
+
+  double bandwidth = bandwidth_estimator_->EstimatedBandwidth();
+  if (bandwidth > 0. && std::fabs(bandwidth - saved_bandwidth_) >
+                            saved_bandwidth_ * kBandwidthSaveThreshold) {
+    BandwidthEstimator::SaveEstimate(bandwidth);
+    BaseUrlSelector::Get().SaveScores();
+    saved_bandwidth_ = bandwidth;
+  }
+  LimitOverloadedVideo();
+
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    auto type = static_cast<StreamType>(i);
+    if (!streams_[i] || !streams_[i]->IsInitialized() ||
+        Impl::IsSuspended(this, type))
+      continue;
+
+    // Downloaded segments count too, they are demuxed in a moment.
+    double buffer_level =
+        Impl::BufferedAhead(Impl::GetBufferedRanges(this, type),
+                            playback_time);
+    int32_t id = abr_engine_->Update(type, buffer_level,
+        streams_[i]->GetUpcomingBitrate(kAbrLookahead));
+    if (id < 0) continue;
+
+    // With enough bandwidth a better quality is shown as soon as possible,
+    // instead of after what is buffered already.
+    bool replace_buffered = abr_engine_->CanReplaceBuffer(type, id);
+    message_sender_->ChangeRepresentation(type, id);
+    OnChangeRepresentation(PP_OK, type, id, replace_buffered);
+  }
+}
+
+void EsDashPlayerController::LimitOverloadedVideo() {
+  auto index = static_cast<size_t>(StreamType::Video);
+  if (!streams_[index] ||
+      !platform_health_->IsOverloaded(representation_ids_[index]))
+    return;
+
+  const VideoStream* representation = Impl::FindRepresentation(
+      video_representations_, representation_ids_[index]);
+  if (!representation) return;
+  uint32_t bitrate = representation->description.bitrate;
+  if (bitrate == 0 ||
+      (device_max_bitrate_ > 0 && bitrate >= device_max_bitrate_))
+    return;
+
+  LOG_INFO("The platform doesn't keep up with video representation %d, "
+           "limiting video below %u bps", representation_ids_[index],
+           bitrate);
+  device_max_bitrate_ = bitrate;
+  abr_engine_->SetMaxBitrate(StreamType::Video, bitrate);
+}
+
+void EsDashPlayerController::PrebufferAlternateLanguage(
+    TimeTicks playback_time) {
+  const auto& audio = streams_[static_cast<size_t>(StreamType::Audio)];
+  if (!audio || !audio->IsInitialized() || seeking_ || trick_play_ ||
+      trimmed_)
+    return;
+  double switch_ahead = tuning_.language_switch_ahead;
+  int32_t id = switch_ahead > 0. ? Impl::AlternateLanguageRepresentation(this)
+                                 : -1;
+  if (id != alternate_audio_id_) {
+    alternate_audio_id_ = id;
+    alternate_audio_sequence_ = id < 0 ? nullptr : Impl::LoadSequence(
+        this, StreamType::Audio, id, NetworkExecutor::Priority::kPrefetch);
+    packets_manager_.SetAppendLimit(StreamType::Audio,
+                                    id < 0 ? 0. : switch_ahead);
+    if (id >= 0) {
+      LOG_INFO("Prebuffering audio representation %d, a switch to it is "
+               "heard within %f [s]", id, switch_ahead);
+    }
+  }
+  // A switch replaces packets after the appended ones, which end about
+  // switch_ahead past the playback position. Only the segment there is
+  // downloaded, once per segment.
+  if (alternate_audio_sequence_)
+    audio->PrefetchSegment(playback_time + switch_ahead,
+                           alternate_audio_sequence_);
+}
+
+void EsDashPlayerController::CatchUpLiveEdge(TimeTicks playback_time) {
+  if (live_target_buffer_ <= 0. || state_ != PlayerState::kPlaying ||
+      seeking_ || trick_play_ || trimmed_)
+    return;
+
+  auto now = executor_->Now();
+  if (now < next_live_catch_up_) return;
+
+  // Segments are delivered in chunks as they are produced, so the buffered
+  // end follows the live edge and the buffer ahead approximates latency.
+  TimeTicks buffer = std::numeric_limits<TimeTicks>::max();
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    if (!streams_[i] || !streams_[i]->IsInitialized()) continue;
+    buffer = std::min(buffer, packets_manager_.GetBufferedTime(
+        static_cast<StreamType>(i)) - playback_time);
+  }
+  if (buffer == std::numeric_limits<TimeTicks>::max() ||
+      buffer <= live_target_buffer_ + kLiveCatchUpDrift)
+    return;
+
+  next_live_catch_up_ = now + milliseconds(kLiveCatchUpInterval);
+  TimeTicks time = playback_time + buffer - live_target_buffer_;
+  LOG_INFO("Live playback is %f [s] behind its target, seeking to %f [s]",
+           buffer - live_target_buffer_, time);
+  pp::MessageLoop::GetForMainThread().PostWork(cc_factory_.NewCallback(
+      &EsDashPlayerController::OnLiveCatchUpSeek, time));
+}
+
+void EsDashPlayerController::RecoverStalls(TimeTicks playback_time) {
+  if (trick_play_) return;
+
+  auto now = executor_->Now();
+  TimeTicks timeout = 0.;
+  for (const auto& stream : streams_) {
+    if (stream) timeout = std::max(timeout, stream->GetStallTimeout());
+  }
+  if (timeout <= 0.) return;
+  auto stall_timeout = duration_cast<TaskExecutor::Clock::duration>(
+      duration<double>(timeout));
+
+  // Packets arrive, but none of them can start the playback, e.g. when
+  // keyframes are not marked.
+  if (!packets_manager_.IsSeekDroppingPackets()) {
+    seek_dropping_since_ = TaskExecutor::Clock::time_point();
+  } else if (seek_dropping_since_ == TaskExecutor::Clock::time_point()) {
+    seek_dropping_since_ = now;
+  } else if (now - seek_dropping_since_ >= stall_timeout) {
+    LOG_ERROR("Seek found no starting packets in %f [s]", timeout);
+    packets_manager_.ForceSeekEnd();
+    playback_metrics_->AddStallRecovery();
+    seek_dropping_since_ = TaskExecutor::Clock::time_point();
+  }
+
+  if (state_ != PlayerState::kPlaying || seeking_ || trimmed_ ||
+      now < next_stall_recovery_)
+    return;
+
+  bool stalled = false;
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    if (!streams_[i] || !streams_[i]->IsDemuxerStalled()) continue;
+    LOG_ERROR("%s demuxer made no progress in %f [s], replacing it",
+              i == static_cast<size_t>(StreamType::Video) ? "VIDEO" : "AUDIO",
+              timeout);
+    streams_[i]->RecreateDemuxerOnSeek();
+    playback_metrics_->AddStallRecovery();
+    stalled = true;
+  }
+  if (!stalled) return;
+
+  // A seek replacing demuxers gets time to deliver packets again.
+  next_stall_recovery_ = now + stall_timeout;
+  pp::MessageLoop::GetForMainThread().PostWork(cc_factory_.NewCallback(
+      &EsDashPlayerController::OnStallRecoverySeek, playback_time));
+}
+
+void EsDashPlayerController::OnStallRecoverySeek(int32_t, TimeTicks time) {
+  if (!player_ || trick_play_) return;
+
+  Seek(time);
+}
+
+void EsDashPlayerController::OnViewSizeChanged(int32_t, int32_t width,
+                                               int32_t height) {
+  if (!abr_engine_) return;
+
+  if (width >= kUnlimitedViewWidth || height >= kUnlimitedViewHeight ||
+      width <= 0 || height <= 0) {
+    abr_engine_->SetViewSize(StreamType::Video, 0, 0);
+  } else {
+    LOG_INFO("Video representations are limited to a %d x %d view", width,
+             height);
+    abr_engine_->SetViewSize(StreamType::Video, width, height);
+  }
+  // Representations are chosen again with the next buffer update.
+  next_abr_update_ = executor_->Now();
+}
+
+void EsDashPlayerController::PrefetchInitSegments(int32_t, StreamType type,
+                                                  uint32_t current_id) {
+  const auto& stream_manager = streams_[static_cast<int32_t>(type)];
+  if (!stream_manager || !dash_parser_) return;
+
+  if (type == StreamType::Video) {
+    stream_manager->PrefetchInitSegments(Impl::GetSequences(
+        this, type, video_representations_, current_id));
+  } else {
+    stream_manager->PrefetchInitSegments(Impl::GetSequences(
+        this, type, audio_representations_, current_id));
+  }
+}
+
+void EsDashPlayerController::ScheduleBufferUpdate() {
+  if (!player_thread_ || buffer_update_scheduled_.exchange(true)) return;
+
+  executor_->PostWork(
+      cc_factory_.NewCallback(&EsDashPlayerController::UpdateStreamsBuffer));
+}
+
+void EsDashPlayerController::OnBufferWatchdog(int32_t,
+                                              uint32_t update_count) {
+  if (update_count == buffer_update_count_) UpdateStreamsBuffer(PP_OK);
 }
 
 void EsDashPlayerController::UpdateStreamsBuffer(int32_t) {
   TimeTicks current_playback_time = 0.0;
+  // Events from now on need another update.
+  buffer_update_scheduled_ = false;
+  ++buffer_update_count_;
 
   if (!player_) {
     LOG_DEBUG("player_ is null!, quit function");
@@ -397,29 +2234,38 @@ void EsDashPlayerController::UpdateStreamsBuffer(int32_t) {
   }
 
   if (static_cast<int>(state_) > static_cast<int>(PlayerState::kReady)) {
-    player_->GetCurrentTime(current_playback_time);
+    Impl::GetPlaybackTime(this, &current_playback_time);
+    if (state_ == PlayerState::kPlaying && !trick_play_)
+      playback_metrics_->UpdatePlaybackPosition(current_playback_time);
   } else {
-    current_playback_time = 0.;
+    // Buffers are filled from the position the playback starts at.
+    current_playback_time = start_time_;
   }
   LOG_DEBUG("Current time: %f [s]", current_playback_time);
 
   bool segments_pending = false;
+  bool more_media_expected = playlist_loading_ || !playlist_.empty();
 
   for (const auto& stream : streams_) {
     if (stream) {
+        stream->SetMoreMediaExpected(more_media_expected);
         segments_pending |= stream->UpdateBuffer(current_playback_time);
     }
   }
+  // Subtitles don't hold back the end of stream.
+  if (text_stream_) text_stream_->UpdateBuffer(current_playback_time);
 
-  if (static_cast<int>(state_) >= static_cast<int>(PlayerState::kReady) &&
-      (!drm_listener_ || drm_listener_->IsInitialized())) {
+  if (static_cast<int>(state_) >= static_cast<int>(PlayerState::kReady)) {
     bool has_buffered_packets = packets_manager_.UpdateBuffer(
         current_playback_time);
+    if (packets_manager_.PacketsAppended())
+      Impl::MarkLatency(this, LatencyPhase::kFirstPacketAppended);
+    Impl::ReportBufferLevel(this, current_playback_time);
 
     // All streams reached EOS:
     if (!waiting_seek_ && !segments_pending && !has_buffered_packets &&
         packets_manager_.IsEosReached()) {
-      int32_t ret = data_source_->SetEndOfStream();
+      int32_t ret = es_backend_->SetEndOfStream();
       if (ret == ErrorCodes::Success) {
         state_ = PlayerState::kFinished;
         LOG_INFO("End of stream signalized from all streams, set EOS - OK");
@@ -428,17 +2274,29 @@ void EsDashPlayerController::UpdateStreamsBuffer(int32_t) {
       }
       return;
     }
+    AdaptRepresentations(current_playback_time);
+    CatchUpLiveEdge(current_playback_time);
+    RecoverStalls(current_playback_time);
+    PrebufferAlternateLanguage(current_playback_time);
   }
   if (player_thread_) {
-    player_thread_->message_loop().PostWork(
-        cc_factory_.NewCallback(&EsDashPlayerController::UpdateStreamsBuffer),
-        kMainLoopDelay);
+    executor_->PostWork(
+        cc_factory_.NewCallback(&EsDashPlayerController::OnBufferWatchdog,
+                                buffer_update_count_),
+        state_ == PlayerState::kPlaying
+            ? tuning_.buffer_update_interval
+            : kPausedBufferWatchdogDelay);
   }
   LOG_DEBUG("Finished");
 }
 
 void EsDashPlayerController::SetViewRect(const Rect& view_rect) {
   view_rect_ = view_rect;
+  if (player_thread_) {
+    executor_->PostWork(cc_factory_.NewCallback(
+        &EsDashPlayerController::OnViewSizeChanged, view_rect.width(),
+        view_rect.height()));
+  }
   if (!player_) return;
 
   LOG_DEBUG("Set view rect to %d, %d", view_rect_.width(), view_rect_.height());
@@ -451,6 +2309,19 @@ void EsDashPlayerController::SetViewRect(const Rect& view_rect) {
 }
 
 void EsDashPlayerController::PostTextTrackInfo() {
+  if (!player_) return;
+
+  if (!text_track_ && !text_representations_.empty()) {
+    text_track_list_.clear();
+    for (const auto& text : text_representations_) {
+      TextTrackInfo info;
+      info.index = text.description.id;
+      info.language = text.language;
+      text_track_list_.push_back(info);
+    }
+    message_sender_->SetTextTracks(text_track_list_);
+    return;
+  }
   int32_t ret = player_->GetTextTracksList(text_track_list_);
   if (ret == ErrorCodes::Success) {
     LOG_INFO("GetTextTrackInfo called successfully");
@@ -460,9 +2331,43 @@ void EsDashPlayerController::PostTextTrackInfo() {
   }
 }
 
+void EsDashPlayerController::PostMetrics() {
+  if (!player_thread_) {
+    LOG_INFO("PostMetrics. Player is not initialized");
+    return;
+  }
+  executor_->PostWork(cc_factory_.NewCallback(
+      &EsDashPlayerController::OnPostMetrics));
+}
+
+void EsDashPlayerController::SetMetricsInterval(double interval) {
+  if (!player_thread_) {
+    LOG_INFO("SetMetricsInterval. Player is not initialized");
+    return;
+  }
+  executor_->PostWork(cc_factory_.NewCallback(
+      &EsDashPlayerController::OnSetMetricsInterval, interval));
+}
+
+void EsDashPlayerController::OnPostMetrics(int32_t) {
+  TimeTicks playback_time = 0.;
+  if (player_ &&
+      static_cast<int>(state_) > static_cast<int>(PlayerState::kReady))
+    Impl::GetPlaybackTime(this, &playback_time);
+  Impl::SendMetrics(this, playback_time);
+}
+
+void EsDashPlayerController::OnSetMetricsInterval(int32_t, double interval) {
+  metrics_report_interval_ = duration_cast<milliseconds>(
+      duration<double>(std::max(interval, 0.)));
+  next_metrics_report_ = executor_->Now() + metrics_report_interval_;
+  LOG_INFO("Metrics are sent every %lld ms",
+           static_cast<long long>(metrics_report_interval_.count()));
+}
+
 void EsDashPlayerController::ChangeSubtitles(int32_t id) {
   LOG_INFO("Change subtitle to %d", id);
-  player_thread_->message_loop().PostWork(
+  executor_->PostWork(
       cc_factory_.NewCallback(
           &EsDashPlayerController::OnChangeSubtitles, id));
 }
@@ -470,7 +2375,7 @@ void EsDashPlayerController::ChangeSubtitles(int32_t id) {
 void EsDashPlayerController::ChangeSubtitleVisibility() {
   subtitles_visible_ = !subtitles_visible_;
   LOG_INFO("Change subtitle visibility to %d", subtitles_visible_);
-  player_thread_->message_loop().PostWork(
+  executor_->PostWork(
       cc_factory_.NewCallback(
           &EsDashPlayerController::OnChangeSubVisibility,
           subtitles_visible_));
@@ -492,23 +2397,33 @@ void EsDashPlayerController::OnStreamConfigured(StreamType type) {
   }
 
   if (all_initialized) {
+    Impl::MarkLatency(this, LatencyPhase::kConfigEmitted);
     FinishStreamConfiguration();
   }
 }
 
 void EsDashPlayerController::FinishStreamConfiguration() {
+  if (data_source_attached_) {
+    LOG_DEBUG("Data source attached with provisional configs already");
+    return;
+  }
   LOG_INFO("All streams configured, attaching data source.");
-  // Audio and video stream should be initialized already.
+  // Audio and video stream should be configured already.
   if (!player_) {
     LOG_DEBUG("player_ is null!, quit function");
     return;
   }
   int32_t result = player_->AttachDataSource(*data_source_);
 
+  // The data source of the previous media is detached by now.
+  previous_data_source_.reset();
   if (result == ErrorCodes::Success && state_ != PlayerState::kError) {
+    data_source_attached_ = true;
     if (state_ == PlayerState::kUnitialized)
       state_ = PlayerState::kReady;
     LOG_INFO("Data Source attached");
+    Impl::MarkLatency(this, LatencyPhase::kDataSourceAttached);
+    Impl::SeekToStartTime(this);
   } else {
     state_ = PlayerState::kError;
     LOG_ERROR("Failed to AttachDataSource!");
@@ -520,6 +2435,16 @@ void EsDashPlayerController::OnSetDisplayRect(int32_t ret) {
 }
 
 void EsDashPlayerController::OnChangeSubtitles(int32_t, int32_t id) {
+  if (!player_) return;
+
+  if (!text_track_ && !text_representations_.empty()) {
+    if (id == text_representation_id_) return;
+    TimeTicks playback_time = 0.;
+    if (static_cast<int>(state_) > static_cast<int>(PlayerState::kReady))
+      Impl::GetPlaybackTime(this, &playback_time);
+    Impl::StartTextStream(this, id, playback_time);
+    return;
+  }
   int32_t ret = player_->SelectTrack(
       Samsung::NaClPlayer::ElementaryStreamType_Text, id);
   if (ret == ErrorCodes::Success) {
@@ -530,6 +2455,9 @@ void EsDashPlayerController::OnChangeSubtitles(int32_t, int32_t id) {
 }
 
 void EsDashPlayerController::OnChangeSubVisibility(int32_t, bool show) {
+  // Cues of the manifest are not sent while subtitles are hidden.
+  if (!text_track_) return;
+
   if (show)
     player_->SetSubtitleListener(listeners_.subtitle_listener);
   else
@@ -0,0 +1,70 @@
+/*!
+ * keyframe_index.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#include "keyframe_index.h"
+
+#include <cmath>
+
+using pp::AutoLock;
+
+namespace {
+
+// Times of the same keyframe demuxed again can differ by rounding.
+constexpr double kKeyframeTolerance = 0.001;  // in seconds
+// Limits memory used by the index of a long representation, the earliest
+// keyframes are dropped first.
+constexpr size_t kMaxKeyframesPerRepresentation = 16384;
+
+}  // anonymous namespace
+
+KeyframeIndex::KeyframeIndex() {}
+
+KeyframeIndex::~KeyframeIndex() {}
+
+void KeyframeIndex::Add(const std::string& representation_id, double time) {
+  AutoLock lock(lock_);
+  auto& keyframes = keyframes_[representation_id];
+  auto it = keyframes.lower_bound(time - kKeyframeTolerance);
+  if (it != keyframes.end() && *it <= time + kKeyframeTolerance) return;
+
+  keyframes.insert(time);
+  if (keyframes.size() > kMaxKeyframesPerRepresentation)
+    keyframes.erase(keyframes.begin());
+}
+
+bool KeyframeIndex::FindClosest(const std::string& representation_id,
+                                double time, double begin, double end,
+                                double* keyframe) const {
+  AutoLock lock(lock_);
+  auto keyframes = keyframes_.find(representation_id);
+  if (keyframes == keyframes_.end()) return false;
+
+  bool found = false;
+  auto it = keyframes->second.lower_bound(begin);
+  for (; it != keyframes->second.end() && *it < end; ++it) {
+    if (!found || std::fabs(*it - time) < std::fabs(*keyframe - time)) {
+      *keyframe = *it;
+      found = true;
+    } else if (*it > time) {
+      // Following keyframes are even further.
+      break;
+    }
+  }
+  return found;
+}
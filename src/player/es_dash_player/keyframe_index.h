@@ -0,0 +1,51 @@
+/*!
+ * keyframe_index.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_KEYFRAME_INDEX_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_KEYFRAME_INDEX_H_
+
+#include <map>
+#include <set>
+#include <string>
+
+#include "ppapi/utility/threading/lock.h"
+
+// Presentation times of video keyframes known for each representation of
+// a stream. They are collected from demuxed packets, so a seek can start at
+// a keyframe inside a segment instead of only at segment boundaries. It's
+// thread safe.
+class KeyframeIndex {
+ public:
+  KeyframeIndex();
+  ~KeyframeIndex();
+
+  // Keyframes closer than kKeyframeTolerance to a known one are ignored.
+  void Add(const std::string& representation_id, double time);
+
+  // Finds a keyframe of the representation closest to time, within
+  // [begin, end). Returns false if none is known.
+  bool FindClosest(const std::string& representation_id, double time,
+                   double begin, double end, double* keyframe) const;
+
+ private:
+  mutable pp::Lock lock_;
+  std::map<std::string, std::set<double>> keyframes_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_KEYFRAME_INDEX_H_
@@ -0,0 +1,74 @@
+/*!
+ * language_history.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#include "language_history.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "common.h"
+
+namespace {
+constexpr const char* kHistoryFile = "/audio_languages";
+// Older choices say little about what the user picks next.
+constexpr size_t kMaxLanguages = 8;
+// Longer lines are not language tags.
+constexpr size_t kMaxLanguageLength = 32;
+
+std::string HistoryPath() {
+  std::string dir = GetTemporaryStorageDir();
+  return dir.empty() ? dir : dir + kHistoryFile;
+}
+}
+
+void LanguageHistory::Add(const std::string& language) {
+  if (language.empty() || language.size() > kMaxLanguageLength) return;
+  std::string path = HistoryPath();
+  if (path.empty()) return;
+
+  auto languages = Load();
+  languages.erase(std::remove(languages.begin(), languages.end(), language),
+                  languages.end());
+  languages.insert(languages.begin(), language);
+  if (languages.size() > kMaxLanguages) languages.resize(kMaxLanguages);
+
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) return;
+  for (const auto& saved : languages)
+    fprintf(file, "%s\n", saved.c_str());
+  fclose(file);
+}
+
+std::vector<std::string> LanguageHistory::Load() {
+  std::vector<std::string> languages;
+  std::string path = HistoryPath();
+  if (path.empty()) return languages;
+
+  FILE* file = fopen(path.c_str(), "r");
+  if (!file) return languages;
+  char line[kMaxLanguageLength + 2];
+  while (languages.size() < kMaxLanguages &&
+         fgets(line, sizeof(line), file)) {
+    std::string language(line);
+    if (!language.empty() && language.back() == '\n') language.pop_back();
+    if (!language.empty()) languages.push_back(language);
+  }
+  fclose(file);
+  return languages;
+}
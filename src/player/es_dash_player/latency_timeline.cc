@@ -0,0 +1,120 @@
+/*!
+ * latency_timeline.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#include "latency_timeline.h"
+
+using pp::AutoLock;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+constexpr size_t LatencyTimeline::kPhaseCount;
+
+LatencyTimeline::LatencyTimeline()
+    : started_(false),
+      operation_(Operation::kStartup),
+      times_(),
+      marked_() {}
+
+LatencyTimeline::~LatencyTimeline() {}
+
+void LatencyTimeline::Start(Operation operation, bool keep_running) {
+  AutoLock lock(lock_);
+  if (keep_running && started_ && operation_ == operation) return;
+
+  started_ = true;
+  operation_ = operation;
+  marked_.fill(false);
+  times_[static_cast<size_t>(Phase::kRequested)] = steady_clock::now();
+  marked_[static_cast<size_t>(Phase::kRequested)] = true;
+}
+
+bool LatencyTimeline::Mark(Phase phase) {
+  auto now = steady_clock::now();
+  auto index = static_cast<size_t>(phase);
+  AutoLock lock(lock_);
+  if (!started_ || index >= kPhaseCount || marked_[index]) return false;
+
+  times_[index] = now;
+  marked_[index] = true;
+  return IsComplete();
+}
+
+bool LatencyTimeline::Finish(Operation* operation, Report* report) {
+  AutoLock lock(lock_);
+  if (!started_) return false;
+
+  started_ = false;
+  *operation = operation_;
+  report->clear();
+  auto start = times_[static_cast<size_t>(Phase::kRequested)];
+  for (size_t i = 0; i < kPhaseCount; ++i) {
+    if (!marked_[i]) continue;
+    report->emplace_back(PhaseName(static_cast<Phase>(i)),
+        duration<double, std::milli>(times_[i] - start).count());
+  }
+  return true;
+}
+
+bool LatencyTimeline::IsComplete() const {
+  if (operation_ == Operation::kStartup)
+    return marked_[static_cast<size_t>(Phase::kBufferingCompleted)];
+
+  return marked_[static_cast<size_t>(Phase::kSeekCompleted)] &&
+         marked_[static_cast<size_t>(Phase::kFirstPacketAppended)];
+}
+
+const char* LatencyTimeline::OperationName(Operation operation) {
+  switch (operation) {
+    case Operation::kStartup:
+      return "startup";
+    case Operation::kSeek:
+      return "seek";
+  }
+  return "unknown";
+}
+
+const char* LatencyTimeline::PhaseName(Phase phase) {
+  switch (phase) {
+    case Phase::kRequested:
+      return "requested";
+    case Phase::kManifestDownloaded:
+      return "manifestDownloaded";
+    case Phase::kManifestParsed:
+      return "manifestParsed";
+    case Phase::kSequencesBuilt:
+      return "sequencesBuilt";
+    case Phase::kInitSegmentsDownloaded:
+      return "initSegmentsDownloaded";
+    case Phase::kConfigEmitted:
+      return "configEmitted";
+    case Phase::kDataSourceAttached:
+      return "dataSourceAttached";
+    case Phase::kLicenseInstalled:
+      return "licenseInstalled";
+    case Phase::kSeekCompleted:
+      return "seekCompleted";
+    case Phase::kFirstPacketAppended:
+      return "firstPacketAppended";
+    case Phase::kBufferingCompleted:
+      return "bufferingCompleted";
+    case Phase::kPhaseCount:
+      break;
+  }
+  return "unknown";
+}
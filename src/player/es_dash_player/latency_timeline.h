@@ -0,0 +1,95 @@
+/*!
+ * latency_timeline.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_LATENCY_TIMELINE_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_LATENCY_TIMELINE_H_
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ppapi/utility/threading/lock.h"
+
+// Records when phases of a startup or a seek happen, so it can be seen where
+// time to the first frame goes. Phases are marked on the main thread, the
+// player thread and network workers, so it's thread safe.
+class LatencyTimeline {
+ public:
+  enum class Operation {
+    kStartup,
+    kSeek
+  };
+
+  // In the order they usually happen, not all of them happen in each
+  // operation.
+  enum class Phase {
+    kRequested,
+    kManifestDownloaded,
+    kManifestParsed,
+    kSequencesBuilt,
+    kInitSegmentsDownloaded,
+    kConfigEmitted,
+    kDataSourceAttached,
+    kLicenseInstalled,
+    kSeekCompleted,
+    kFirstPacketAppended,
+    kBufferingCompleted,
+    kPhaseCount
+  };
+
+  // Names of phases with milliseconds elapsed since kRequested.
+  typedef std::vector<std::pair<std::string, double>> Report;
+
+  LatencyTimeline();
+  ~LatencyTimeline();
+
+  // Starts a new timeline at kRequested, the previous one is dropped. When
+  // keep_running is true, a timeline of the same operation which is in
+  // progress is continued instead, e.g. for a seek superseding another one.
+  void Start(Operation operation, bool keep_running = false);
+
+  // Records the time of phase, unless it's recorded already in the current
+  // timeline. Does nothing if no timeline is started. Returns true when this
+  // completes the timeline, i.e. buffering is completed after a startup, or
+  // a seek is completed and packets are appended after it.
+  bool Mark(Phase phase);
+
+  // Ends the current timeline. Returns false if no timeline is started.
+  bool Finish(Operation* operation, Report* report);
+
+  static const char* OperationName(Operation operation);
+  static const char* PhaseName(Phase phase);
+
+ private:
+  static constexpr size_t kPhaseCount =
+      static_cast<size_t>(Phase::kPhaseCount);
+
+  // Checks if the current timeline is complete. lock_ must be locked.
+  bool IsComplete() const;
+
+  pp::Lock lock_;
+  bool started_;
+  Operation operation_;
+  std::array<std::chrono::steady_clock::time_point, kPhaseCount> times_;
+  std::array<bool, kPhaseCount> marked_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_LATENCY_TIMELINE_H_
@@ -0,0 +1,274 @@
+/*!
+ * license_cache.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDrm
+
+#include "license_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "common.h"
+
+using pp::AutoLock;
+
+namespace {
+
+constexpr const char* kFilePrefix = "/license_";
+constexpr const char* kMagic = "NPLC1";
+constexpr const char* kKidTag = "<KID";
+constexpr const char* kKidEndTag = "</KID>";
+constexpr const char* kKidValueAttribute = "VALUE=\"";
+constexpr const char* kLicenseTag = "<License>";
+constexpr const char* kLicenseEndTag = "</License>";
+// Licenses which don't expire are stored for a day, so revoked ones don't
+// stay in use forever.
+constexpr int64_t kMaxLifetime = 24 * 60 * 60;
+// Licenses of titles downloaded for offline playback are kept longer, the
+// device may stay offline for a while.
+constexpr int64_t kMaxPersistentLifetime = 30 * 24 * 60 * 60;
+constexpr uint32_t kMaxFieldSize = 1024 * 1024;
+
+// XMR is a binary format of PlayReady licenses, their values are big endian.
+constexpr uint8_t kXmrMagic[] = { 'X', 'M', 'R', 0 };
+constexpr size_t kXmrHeaderSize = 24;  // magic, version and rights ID
+constexpr size_t kXmrObjectHeaderSize = 8;  // flags, type and length
+constexpr uint16_t kXmrContainerFlag = 0x0002;
+constexpr uint16_t kXmrExpirationRestriction = 0x0012;
+
+uint32_t ReadBigEndian(const uint8_t* data, size_t size) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < size; ++i) value = (value << 8) | data[i];
+  return value;
+}
+
+// Looks for an expiration restriction in XMR objects, sets end_date to the
+// earliest one found.
+void FindXmrExpiration(const uint8_t* data, size_t size, int64_t* end_date) {
+  while (size >= kXmrObjectHeaderSize) {
+    uint16_t flags = ReadBigEndian(data, 2);
+    uint16_t type = ReadBigEndian(data + 2, 2);
+    uint32_t length = ReadBigEndian(data + 4, 4);
+    if (length < kXmrObjectHeaderSize || length > size) return;
+
+    const uint8_t* payload = data + kXmrObjectHeaderSize;
+    size_t payload_size = length - kXmrObjectHeaderSize;
+    if (flags & kXmrContainerFlag) {
+      FindXmrExpiration(payload, payload_size, end_date);
+    } else if (type == kXmrExpirationRestriction && payload_size >= 8) {
+      int64_t end = ReadBigEndian(payload + 4, 4);
+      if (*end_date == 0 || end < *end_date) *end_date = end;
+    }
+    data += length;
+    size -= length;
+  }
+}
+
+// Returns time when licenses of response expire, as seconds since epoch,
+// but not later than max_lifetime from now.
+int64_t GetExpirationTime(const std::string& response, int64_t now,
+                          int64_t max_lifetime) {
+  int64_t end_date = 0;
+  size_t pos = 0;
+  while ((pos = response.find(kLicenseTag, pos)) != std::string::npos) {
+    pos += strlen(kLicenseTag);
+    size_t end = response.find(kLicenseEndTag, pos);
+    if (end == std::string::npos) break;
+
+    std::vector<uint8_t> xmr = Base64Decode(response.substr(pos, end - pos));
+    if (xmr.size() > kXmrHeaderSize &&
+        std::equal(kXmrMagic, kXmrMagic + sizeof(kXmrMagic), xmr.begin()))
+      FindXmrExpiration(xmr.data() + kXmrHeaderSize,
+                        xmr.size() - kXmrHeaderSize, &end_date);
+    pos = end;
+  }
+  int64_t max_time = now + max_lifetime;
+  return end_date ? std::min(end_date, max_time) : max_time;
+}
+
+bool ReadField(FILE* file, std::string* field) {
+  return ReadStorageField(file, kMaxFieldSize, field);
+}
+
+}  // namespace
+
+LicenseCache& LicenseCache::Get() {
+  static LicenseCache cache;
+  return cache;
+}
+
+LicenseCache::LicenseCache() : hits_(0), misses_(0) {}
+
+std::string LicenseCache::ParseKeyId(const std::string& challenge) {
+  std::string key_ids;
+  size_t pos = 0;
+  while ((pos = challenge.find(kKidTag, pos)) != std::string::npos) {
+    pos += strlen(kKidTag);
+    size_t tag_end = challenge.find('>', pos);
+    if (tag_end == std::string::npos) break;
+    // Skips other elements, like KIDS of PlayReady header 4.2.
+    if (challenge[pos] != '>' && challenge[pos] != ' ') continue;
+
+    // PlayReady header 4.0 holds the key ID as text of the KID element,
+    // later versions have it in its VALUE attribute.
+    std::string key_id;
+    size_t value = challenge.find(kKidValueAttribute, pos);
+    if (value != std::string::npos && value < tag_end) {
+      value += strlen(kKidValueAttribute);
+      size_t value_end = challenge.find('"', value);
+      if (value_end == std::string::npos) break;
+      key_id = challenge.substr(value, value_end - value);
+    } else {
+      size_t end = challenge.find(kKidEndTag, tag_end);
+      if (end == std::string::npos) break;
+      key_id = challenge.substr(tag_end + 1, end - tag_end - 1);
+    }
+    // The same key can be listed in a few headers of one challenge.
+    if (key_id.empty() || key_ids.find(key_id) != std::string::npos)
+      continue;
+    if (!key_ids.empty()) key_ids += ',';
+    key_ids += key_id;
+  }
+  return key_ids;
+}
+
+std::string LicenseCache::ParseInitDataKeyId(
+    const std::vector<uint8_t>& init_data) {
+  // The PlayReady header is an UTF-16 XML, dropping zero bytes leaves its
+  // ASCII text.
+  std::string text;
+  text.reserve(init_data.size());
+  for (uint8_t byte : init_data)
+    if (byte) text.push_back(static_cast<char>(byte));
+
+  std::string key_id = ParseKeyId(text);
+  if (!key_id.empty()) return key_id;
+
+  // Init data without a key id is told apart by its stable hash, which is
+  // stored with licenses.
+  return StorageFileName(std::string(init_data.begin(), init_data.end()));
+}
+
+std::string LicenseCache::PathFor(const std::string& key_id,
+                                  const std::string& content_id,
+                                  bool persistent) const {
+  std::string dir =
+      persistent ? GetPersistentStorageDir() : GetTemporaryStorageDir();
+  if (dir.empty()) return std::string();
+
+  return dir + kFilePrefix + StorageFileName(key_id + '\n' + content_id);
+}
+
+bool LicenseCache::ReadEntry(const std::string& path,
+                             const std::string& key_id,
+                             const std::string& content_id,
+                             std::string* response) {
+  if (path.empty()) return false;
+
+  AutoLock lock(lock_);
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) return false;
+
+  std::string magic;
+  std::string cached_key_id;
+  std::string cached_content_id;
+  std::string expiration_time;
+  std::string cached;
+  bool found = ReadField(file, &magic) && magic == kMagic &&
+               ReadField(file, &cached_key_id) && cached_key_id == key_id &&
+               ReadField(file, &cached_content_id) &&
+               cached_content_id == content_id &&
+               ReadField(file, &expiration_time) &&
+               strtoll(expiration_time.c_str(), nullptr, 10) >
+                   static_cast<int64_t>(time(nullptr)) &&
+               ReadField(file, &cached);
+  fclose(file);
+  if (found) {
+    *response = std::move(cached);
+  } else {
+    // Expired or broken entries are not needed anymore.
+    remove(path.c_str());
+  }
+  return found;
+}
+
+bool LicenseCache::Lookup(const std::string& key_id,
+                          const std::string& content_id,
+                          std::string* response, bool persistent) {
+  bool found = (persistent &&
+                ReadEntry(PathFor(key_id, content_id, true), key_id,
+                          content_id, response)) ||
+               ReadEntry(PathFor(key_id, content_id, false), key_id,
+                         content_id, response);
+
+  uint32_t hits = found ? ++hits_ : hits_.load();
+  uint32_t misses = found ? misses_.load() : ++misses_;
+  LOG_INFO("License cache %s for key %s (hits: %u, misses: %u)",
+           found ? "hit" : "miss", key_id.c_str(), hits, misses);
+  return found;
+}
+
+void LicenseCache::Put(const std::string& key_id,
+                       const std::string& content_id,
+                       const std::string& response, bool persistent) {
+  if (response.size() > kMaxFieldSize) return;
+
+  std::string path = PathFor(key_id, content_id, persistent);
+  if (path.empty()) return;
+
+  int64_t now = time(nullptr);
+  int64_t expiration_time = GetExpirationTime(response, now,
+      persistent ? kMaxPersistentLifetime : kMaxLifetime);
+  if (expiration_time <= now) return;
+
+  AutoLock lock(lock_);
+  FILE* file = fopen(path.c_str(), "wb");
+  if (!file) {
+    LOG_ERROR("Can't create license cache file %s", path.c_str());
+    return;
+  }
+
+  bool ok = WriteStorageField(file, kMagic) &&
+            WriteStorageField(file, key_id) &&
+            WriteStorageField(file, content_id) &&
+            WriteStorageField(file, std::to_string(expiration_time)) &&
+            WriteStorageField(file, response);
+  if (fclose(file) != 0 || !ok) {
+    LOG_ERROR("Can't write license cache file %s", path.c_str());
+    remove(path.c_str());
+  }
+}
+
+void LicenseCache::Remove(const std::string& key_id,
+                          const std::string& content_id) {
+  for (bool persistent : {false, true}) {
+    std::string path = PathFor(key_id, content_id, persistent);
+    if (path.empty()) continue;
+
+    AutoLock lock(lock_);
+    remove(path.c_str());
+  }
+}
+
+LicenseCache::Stats LicenseCache::GetStats() const {
+  return Stats{hits_.load(), misses_.load()};
+}
@@ -0,0 +1,90 @@
+/*!
+ * license_cache.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_LICENSE_CACHE_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_LICENSE_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ppapi/utility/threading/lock.h"
+
+// Keeps PlayReady license responses in a temporary HTML5 file system, keyed
+// by a key ID and a content ID, so playing a title again, or a license
+// request sent again after a seek, installs a stored license instead of
+// asking the license server. Licenses are kept until their expiration date,
+// but not longer than a day. Licenses of titles downloaded for offline
+// playback are persistent, they are stored in a persistent HTML5 file system
+// and kept for up to 30 days. It's thread safe, but must not be used on the
+// main thread.
+class LicenseCache {
+ public:
+  struct Stats {
+    uint32_t hits;
+    uint32_t misses;
+  };
+
+  static LicenseCache& Get();
+
+  // Returns IDs (as they are written in the challenge) of keys a license is
+  // requested for, separated by commas, or an empty string if there are
+  // none. With key rotation, a challenge may ask for the current and the
+  // next key.
+  static std::string ParseKeyId(const std::string& challenge);
+
+  // Returns key IDs of the PlayReady header in DRM init data (a pssh box or
+  // a PlayReady object), like ParseKeyId(). If there are none, a hash of
+  // init data is returned, so it still identifies the keys.
+  static std::string ParseInitDataKeyId(const std::vector<uint8_t>& init_data);
+
+  // Returns true and fills response if a license which hasn't expired yet
+  // is cached. Persistent licenses are looked up first if persistent is
+  // set. Counts a hit or a miss.
+  bool Lookup(const std::string& key_id, const std::string& content_id,
+              std::string* response, bool persistent = false);
+
+  // Stores a license response received from a license server.
+  void Put(const std::string& key_id, const std::string& content_id,
+           const std::string& response, bool persistent = false);
+
+  // Removes a cached license, e.g. when the CDM doesn't accept it. A
+  // persistent one is removed too.
+  void Remove(const std::string& key_id, const std::string& content_id);
+
+  Stats GetStats() const;
+
+ private:
+  LicenseCache();
+
+  // Returns an empty string if the storage is not available.
+  std::string PathFor(const std::string& key_id,
+                      const std::string& content_id, bool persistent) const;
+
+  // Reads an entry of the license from path, removing it if it's expired.
+  bool ReadEntry(const std::string& path, const std::string& key_id,
+                 const std::string& content_id, std::string* response);
+
+  pp::Lock lock_;
+  std::atomic<uint32_t> hits_;
+  std::atomic<uint32_t> misses_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_LICENSE_CACHE_H_
@@ -20,14 +20,41 @@
 #ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_MEDIA_SEGMENT_H_
 #define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_MEDIA_SEGMENT_H_
 
+#include <chrono>
+#include <string>
 #include <vector>
 
 struct MediaSegment {
   std::vector<uint8_t> data_;
   double duration_;
   double timestamp_;
+  // Added to media timestamps of the segment to get presentation times.
+  double timestamp_offset_;
+  // Representation which the segment was downloaded from.
+  std::string representation_id_;
+  // A segment can be passed in chunks while it's being downloaded. Each chunk
+  // carries duration and timestamp of the whole segment. The last chunk of a
+  // segment passed in chunks has no data.
+  bool first_chunk_;
+  bool last_chunk_;
+  // When the segment was requested and when its first and last bytes were
+  // received. The first chunk carries requested_ and first_byte_, the last
+  // one all of them.
+  std::chrono::steady_clock::time_point requested_;
+  std::chrono::steady_clock::time_point first_byte_;
+  std::chrono::steady_clock::time_point last_byte_;
 
-  MediaSegment() : data_(), duration_(0.0), timestamp_(0.0) {}
+  MediaSegment()
+      : data_(),
+        duration_(0.0),
+        timestamp_(0.0),
+        timestamp_offset_(0.0),
+        representation_id_(),
+        first_chunk_(true),
+        last_chunk_(true),
+        requested_(),
+        first_byte_(),
+        last_byte_() {}
 };
 
 #endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_MEDIA_SEGMENT_H_
@@ -0,0 +1,124 @@
+/*!
+ * nacl_es_backend.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#include "player/es_dash_player/nacl_es_backend.h"
+
+#include "nacl_player/error_codes.h"
+
+#include "cpu_profiler.h"
+
+using Samsung::NaClPlayer::AudioElementaryStream;
+using Samsung::NaClPlayer::ElementaryStream;
+using Samsung::NaClPlayer::ElementaryStreamListener;
+using Samsung::NaClPlayer::ErrorCodes;
+using Samsung::NaClPlayer::ESDataSource;
+using Samsung::NaClPlayer::TimeTicks;
+using Samsung::NaClPlayer::VideoElementaryStream;
+
+namespace {
+
+class NaClStream : public EsBackend::Stream {
+ public:
+  NaClStream(StreamType type, std::shared_ptr<ElementaryStream> stream)
+      : type_(type), stream_(std::move(stream)) {}
+
+  int32_t SetConfig(const AudioConfig& audio_config) override {
+    if (type_ != StreamType::Audio) return ErrorCodes::BadArgument;
+    auto audio_stream =
+        std::static_pointer_cast<AudioElementaryStream>(stream_);
+    audio_stream->SetAudioCodecType(audio_config.codec_type);
+    audio_stream->SetAudioCodecProfile(audio_config.codec_profile);
+    audio_stream->SetSampleFormat(audio_config.sample_format);
+    audio_stream->SetChannelLayout(audio_config.channel_layout);
+    audio_stream->SetBitsPerChannel(audio_config.bits_per_channel);
+    audio_stream->SetSamplesPerSecond(audio_config.samples_per_second);
+    audio_stream->SetCodecExtraData(audio_config.extra_data.size(),
+                                    audio_config.extra_data.data());
+    return audio_stream->InitializeDone();
+  }
+
+  int32_t SetConfig(const VideoConfig& video_config) override {
+    if (type_ != StreamType::Video) return ErrorCodes::BadArgument;
+    auto video_stream =
+        std::static_pointer_cast<VideoElementaryStream>(stream_);
+    video_stream->SetVideoCodecType(video_config.codec_type);
+    video_stream->SetVideoCodecProfile(video_config.codec_profile);
+    video_stream->SetVideoFrameFormat(video_config.frame_format);
+    video_stream->SetVideoFrameSize(video_config.size);
+    video_stream->SetFrameRate(video_config.frame_rate);
+    video_stream->SetCodecExtraData(video_config.extra_data.size(),
+                                    video_config.extra_data.data());
+    return video_stream->InitializeDone();
+  }
+
+  int32_t AppendPacket(const ElementaryStreamPacket& packet) override {
+    if (!packet.IsEncrypted())
+      return stream_->AppendPacket(packet.GetESPacket());
+    CPU_SCOPE(CpuStage::kDrm);
+    return stream_->AppendEncryptedPacket(packet.GetESPacket(),
+                                          packet.GetEncryptionInfo());
+  }
+
+  int32_t SetDrmInitData(const std::string& type,
+                         const std::vector<uint8_t>& init_data) override {
+    return stream_->SetDRMInitData(type, init_data.size(),
+        static_cast<const void*>(init_data.data()));
+  }
+
+ private:
+  StreamType type_;
+  std::shared_ptr<ElementaryStream> stream_;
+};
+
+}  // anonymous namespace
+
+NaClEsBackend::NaClEsBackend(std::shared_ptr<ESDataSource> data_source)
+    : data_source_(std::move(data_source)) {}
+
+NaClEsBackend::~NaClEsBackend() = default;
+
+int32_t NaClEsBackend::AddStream(StreamType type,
+    std::shared_ptr<ElementaryStreamListener> listener,
+    std::shared_ptr<Stream>* stream) {
+  int32_t result = ErrorCodes::BadArgument;
+  std::shared_ptr<ElementaryStream> elementary_stream;
+  if (type == StreamType::Video) {
+    auto video_stream = std::make_shared<VideoElementaryStream>();
+    result = data_source_->AddStream(*video_stream, listener);
+    elementary_stream =
+        std::static_pointer_cast<ElementaryStream>(video_stream);
+  } else if (type == StreamType::Audio) {
+    auto audio_stream = std::make_shared<AudioElementaryStream>();
+    result = data_source_->AddStream(*audio_stream, listener);
+    elementary_stream =
+        std::static_pointer_cast<ElementaryStream>(audio_stream);
+  }
+
+  if (result == ErrorCodes::Success)
+    *stream = std::make_shared<NaClStream>(type, elementary_stream);
+  return result;
+}
+
+int32_t NaClEsBackend::SetDuration(TimeTicks duration) {
+  return data_source_->SetDuration(duration);
+}
+
+int32_t NaClEsBackend::SetEndOfStream() {
+  return data_source_->SetEndOfStream();
+}
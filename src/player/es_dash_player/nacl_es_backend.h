@@ -0,0 +1,48 @@
+/*!
+ * nacl_es_backend.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_NACL_ES_BACKEND_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_NACL_ES_BACKEND_H_
+
+#include <memory>
+
+#include "nacl_player/es_data_source.h"
+
+#include "player/es_dash_player/es_backend.h"
+
+// Passes streams to NaCl Player through an ESDataSource, which is attached
+// to a player by the caller.
+class NaClEsBackend : public EsBackend {
+ public:
+  explicit NaClEsBackend(
+      std::shared_ptr<Samsung::NaClPlayer::ESDataSource> data_source);
+  ~NaClEsBackend() override;
+
+  int32_t AddStream(
+      StreamType type,
+      std::shared_ptr<Samsung::NaClPlayer::ElementaryStreamListener> listener,
+      std::shared_ptr<Stream>* stream) override;
+  int32_t SetDuration(Samsung::NaClPlayer::TimeTicks duration) override;
+  int32_t SetEndOfStream() override;
+
+ private:
+  std::shared_ptr<Samsung::NaClPlayer::ESDataSource> data_source_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_NACL_ES_BACKEND_H_
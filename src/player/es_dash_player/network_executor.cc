@@ -0,0 +1,223 @@
+/*!
+ * network_executor.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @author Piotr Bałut
+ */
+
+#include "network_executor.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "ppapi/c/pp_errors.h"
+#include "ppapi/cpp/message_loop.h"
+
+#include "common.h"
+#include "thread_config.h"
+
+using pp::AutoLock;
+
+namespace {
+
+// State of the executor which task runs on this thread, if any.
+__thread const void* current_executor_state = nullptr;
+
+}  // anonymous namespace
+
+constexpr size_t WorkerPool::kMinWorkerCount;
+constexpr size_t NetworkExecutor::kUnlimited;
+
+size_t WorkerPool::DefaultWorkerCount() {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return std::max(cores > 0 ? static_cast<size_t>(cores) : 0,
+                  kMinWorkerCount);
+}
+
+WorkerPool::WorkerPool(const pp::InstanceHandle& instance,
+                       size_t worker_count)
+    : cc_factory_(this),
+      next_worker_(0) {
+  for (size_t i = 0; i < std::max<size_t>(worker_count, 1); ++i) {
+    workers_.push_back(
+        ThreadConfig::StartSimpleThread(instance, ThreadRole::kDownload));
+  }
+  worker_count_ = MakeUnique<ScopedResourceCount>(TrackedResource::kThread,
+                                                  workers_.size());
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    AutoLock lock(lock_);
+    tasks_.clear();
+  }
+  // Workers are joined here, before cc_factory_ is destroyed.
+  workers_.clear();
+  worker_count_.reset();
+}
+
+void WorkerPool::Post(std::function<void()> task) {
+  AutoLock lock(lock_);
+  tasks_.push_back(std::move(task));
+  // Each task wakes up a worker, which runs the first pending one.
+  auto& worker = workers_[next_worker_++ % workers_.size()];
+  worker->message_loop().PostWork(
+      cc_factory_.NewCallback(&WorkerPool::RunNextTask));
+}
+
+void WorkerPool::RunNextTask(int32_t) {
+  std::function<void()> task;
+  {
+    AutoLock lock(lock_);
+    if (tasks_.empty()) return;
+    task = std::move(tasks_.front());
+    tasks_.pop_front();
+  }
+
+  task();
+}
+
+bool WorkerPool::IsWorkerThread() const {
+  pp::MessageLoop current = pp::MessageLoop::GetCurrent();
+  if (current.is_null()) return false;
+
+  for (const auto& worker : workers_) {
+    if (worker->message_loop() == current) return true;
+  }
+  return false;
+}
+
+NetworkExecutor::NetworkExecutor(const pp::InstanceHandle& instance,
+                                 size_t worker_count)
+    : NetworkExecutor(std::make_shared<WorkerPool>(instance, worker_count)) {}
+
+NetworkExecutor::NetworkExecutor(std::shared_ptr<WorkerPool> pool,
+                                 size_t max_running)
+    : pool_(std::move(pool)),
+      state_(std::make_shared<State>()) {
+  state_->max_running = max_running;
+  state_->dispatched = 0;
+  state_->running = 0;
+  state_->closed = false;
+}
+
+NetworkExecutor::~NetworkExecutor() {
+  std::unique_lock<std::mutex> lock(state_->mutex);
+  state_->closed = true;
+  for (auto& queue : state_->tasks)
+    queue.clear();
+  // A task destroying its own executor doesn't wait for itself.
+  size_t own_tasks = current_executor_state == state_.get() ? 1 : 0;
+  state_->task_finished.wait(lock, [this, own_tasks]() {
+    return state_->running <= own_tasks;
+  });
+  // Runners left in the pool see the executor closed and do nothing.
+}
+
+void NetworkExecutor::Post(Priority priority,
+                           pp::CompletionCallback callback) {
+  Enqueue(priority, [callback]() mutable { callback.Run(PP_OK); });
+}
+
+void NetworkExecutor::PostTask(Priority priority, std::function<void()> task) {
+  Enqueue(priority, std::move(task));
+}
+
+void NetworkExecutor::RunAndWait(Priority priority,
+                                 const std::function<void()>& task) {
+  RunAllAndWait(priority, {task});
+}
+
+void NetworkExecutor::RunAllAndWait(Priority priority,
+    const std::vector<std::function<void()>>& tasks) {
+  if (pool_->IsWorkerThread()) {
+    for (const auto& task : tasks)
+      task();
+    return;
+  }
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  size_t pending = tasks.size();
+  for (const auto& task : tasks) {
+    Enqueue(priority, [&]() {
+      task();
+      std::lock_guard<std::mutex> guard(mutex);
+      --pending;
+      condition.notify_one();
+    });
+  }
+
+  std::unique_lock<std::mutex> guard(mutex);
+  condition.wait(guard, [&pending]() { return pending == 0; });
+}
+
+void NetworkExecutor::Enqueue(Priority priority, std::function<void()> task) {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  if (state_->closed) return;
+  state_->tasks[static_cast<size_t>(priority)].push_back(std::move(task));
+  Dispatch(pool_.get(), state_);
+}
+
+void NetworkExecutor::Dispatch(WorkerPool* pool,
+                               const std::shared_ptr<State>& state) {
+  if (state->max_running != kUnlimited &&
+      state->dispatched >= state->max_running)
+    return;
+
+  ++state->dispatched;
+  pool->Post([pool, state]() { RunNextTask(pool, state); });
+}
+
+void NetworkExecutor::RunNextTask(WorkerPool* pool,
+                                  const std::shared_ptr<State>& state) {
+  std::function<void()> task;
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (!state->closed) {
+      for (auto& queue : state->tasks) {
+        if (queue.empty()) continue;
+        task = std::move(queue.front());
+        queue.pop_front();
+        break;
+      }
+    }
+    if (!task) {
+      --state->dispatched;
+      return;
+    }
+    ++state->running;
+  }
+
+  const void* previous_state = current_executor_state;
+  current_executor_state = state.get();
+  task();
+  current_executor_state = previous_state;
+
+  std::lock_guard<std::mutex> lock(state->mutex);
+  --state->running;
+  --state->dispatched;
+  state->task_finished.notify_all();
+  // Each task of an unlimited executor has a runner dispatched already, a
+  // limited one takes the next task once this one is done.
+  if (state->closed || state->max_running == kUnlimited) return;
+  for (const auto& queue : state->tasks) {
+    if (queue.empty()) continue;
+    Dispatch(pool, state);
+    break;
+  }
+}
@@ -0,0 +1,169 @@
+/*!
+ * network_executor.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_NETWORK_EXECUTOR_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_NETWORK_EXECUTOR_H_
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ppapi/cpp/completion_callback.h"
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/lock.h"
+#include "ppapi/utility/threading/simple_thread.h"
+
+class ScopedResourceCount;
+
+// Worker threads shared by NetworkExecutors. It lives as long as any
+// executor using it, its workers are joined when it's destroyed, which must
+// not happen on one of them.
+class WorkerPool {
+ public:
+  explicit WorkerPool(const pp::InstanceHandle& instance,
+                      size_t worker_count = DefaultWorkerCount());
+  ~WorkerPool();
+
+  // Workers mostly wait for the network, so there are at least that many of
+  // them on SoCs with less cores.
+  static constexpr size_t kMinWorkerCount = 4;
+
+  // Returns a number of CPU cores, but at least kMinWorkerCount.
+  static size_t DefaultWorkerCount();
+
+  size_t WorkerCount() const { return workers_.size(); }
+
+ private:
+  friend class NetworkExecutor;
+
+  // Runs task on the next free worker, tasks start in posting order.
+  void Post(std::function<void()> task);
+  void RunNextTask(int32_t);
+  bool IsWorkerThread() const;
+
+  std::vector<std::unique_ptr<pp::SimpleThread>> workers_;
+  std::unique_ptr<ScopedResourceCount> worker_count_;
+  pp::CompletionCallbackFactory<WorkerPool> cc_factory_;
+
+  pp::Lock lock_;
+  std::deque<std::function<void()>> tasks_;
+  size_t next_worker_;
+};
+
+// Runs blocking network requests of all streams, the DRM client and the
+// manifest loader on a set of worker threads. Whenever a worker is free, it
+// takes the most urgent pending task, tasks of the same priority are run in
+// posting order.
+//
+// Workers can be shared by executors of different components (see
+// WorkerPool), so a playback doesn't start threads of its own. An executor
+// limited to a single running task runs its tasks one at a time in posting
+// order, like a thread of its own would, while sharing the workers.
+class NetworkExecutor {
+ public:
+  // From the most urgent.
+  enum class Priority {
+    kLicense,
+    kManifest,
+    kInitSegment,
+    kVideo,
+    kAudio,
+    kPrefetch,
+    kPriorityCount
+  };
+
+  // No limit of tasks running at the same time, other than the number of
+  // workers.
+  static constexpr size_t kUnlimited = 0;
+
+  // Creates an executor with worker_count workers of its own.
+  explicit NetworkExecutor(
+      const pp::InstanceHandle& instance,
+      size_t worker_count = WorkerPool::DefaultWorkerCount());
+
+  // Creates an executor using shared workers. At most max_running of its
+  // tasks run at the same time.
+  explicit NetworkExecutor(std::shared_ptr<WorkerPool> pool,
+                           size_t max_running = kUnlimited);
+
+  // Drops pending tasks and waits for running ones, so they can still use
+  // objects which are destroyed after the executor.
+  ~NetworkExecutor();
+
+  // Runs callback with PP_OK on one of the workers. Callbacks made with
+  // a CompletionCallbackFactory do nothing if their factory is destroyed in
+  // the meantime.
+  void Post(Priority priority, pp::CompletionCallback callback);
+
+  // Runs task on one of the workers. A task which is dropped when the
+  // executor is destroyed is deleted without running, e.g. so the Promise
+  // it captures drops continuations of its Future.
+  void PostTask(Priority priority, std::function<void()> task);
+
+  // Runs task on one of the workers and waits until it's done. Task is run
+  // right away when called on a worker thread.
+  void RunAndWait(Priority priority, const std::function<void()>& task);
+
+  // Runs tasks on the workers at the same time and waits until all of them
+  // are done. Tasks are run one after another when called on a worker
+  // thread.
+  void RunAllAndWait(Priority priority,
+                     const std::vector<std::function<void()>>& tasks);
+
+  size_t WorkerCount() const { return pool_->WorkerCount(); }
+
+ private:
+  // Tasks of an executor. It's shared with tasks posted to the pool, which
+  // can run after the executor is destroyed.
+  struct State {
+    std::mutex mutex;
+    // Notified when a running task finishes.
+    std::condition_variable task_finished;
+    std::array<std::deque<std::function<void()>>,
+               static_cast<size_t>(Priority::kPriorityCount)> tasks;
+    // Limit of running tasks, kUnlimited if there is none.
+    size_t max_running;
+    // Runners posted to the pool and not finished yet. Each one takes the
+    // most urgent task when it starts.
+    size_t dispatched;
+    // Tasks taken from tasks and not finished yet.
+    size_t running;
+    // Set when the executor is destroyed.
+    bool closed;
+  };
+
+  void Enqueue(Priority priority, std::function<void()> task);
+  // Posts a runner of state to pool, unless the limit of running tasks is
+  // reached. state->mutex must be locked.
+  static void Dispatch(WorkerPool* pool, const std::shared_ptr<State>& state);
+  // A runner, runs the most urgent task of state.
+  static void RunNextTask(WorkerPool* pool,
+                          const std::shared_ptr<State>& state);
+
+  std::shared_ptr<WorkerPool> pool_;
+  std::shared_ptr<State> state_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_NETWORK_EXECUTOR_H_
@@ -0,0 +1,462 @@
+/*!
+ * network_simulation.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include "player/es_dash_player/network_simulation.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <memory>
+
+#include "common.h"
+#include "dash/dash_manifest.h"
+#include "dash/media_stream.h"
+#include "dash/util.h"
+#include "tuning_profile.h"
+
+#include "abr_engine.h"
+#include "bandwidth_estimator.h"
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Playback starts, and resumes after running out of data, when every stream
+// has that much buffered.
+constexpr double kResumeBuffer = 2.;  // seconds
+// EsDashPlayerController updates representations that often.
+constexpr double kAbrUpdateInterval = 1.;  // seconds
+// Playback of longer or live content is simulated up to that position.
+constexpr double kMaxContentTime = 600.;  // seconds
+// A simulation stops if playback doesn't finish within that much time,
+// e.g. when a trace has no bandwidth at all.
+constexpr double kMaxSimulatedTime = 3600.;  // seconds
+constexpr double kBitsPerByte = 8.;
+// A switch in the opposite direction of the previous one within that time
+// is counted as an oscillation.
+constexpr double kOscillationWindow = 10.;  // seconds
+
+// Makes a trace of points which last the same time.
+NetworkSimulation::Trace MakeTrace(const char* name, double point_duration,
+    const vector<std::pair<double, double>>& bandwidth_and_latency) {
+  NetworkSimulation::Trace trace;
+  trace.name = name;
+  for (const auto& point : bandwidth_and_latency)
+    trace.points.push_back({point_duration, point.first, point.second});
+  return trace;
+}
+
+}  // anonymous namespace
+
+NetworkSimulation::Link::Link(const vector<TracePoint>& points)
+    : points_(points),
+      trace_duration_(0.) {
+  for (const auto& point : points_) trace_duration_ += point.duration;
+}
+
+double NetworkSimulation::Link::Download(double time, uint64_t bytes,
+                                         double* time_to_first_byte) const {
+  double start = time;
+  time += PointAt(time).latency;
+  *time_to_first_byte = time - start;
+  double bits = bytes * kBitsPerByte;
+  while (bits > 0. && time - start < kMaxSimulatedTime) {
+    double point_end = 0.;
+    const auto& point = PointAt(time, &point_end);
+    double transferable = point.bandwidth * (point_end - time);
+    if (point.bandwidth > 0. && transferable >= bits)
+      return time + bits / point.bandwidth - start;
+    bits -= std::max(transferable, 0.);
+    time = point_end;
+  }
+  return time - start;
+}
+
+const NetworkSimulation::TracePoint& NetworkSimulation::Link::PointAt(
+    double time, double* point_end) const {
+  double loops = std::floor(time / trace_duration_);
+  double point_start = loops * trace_duration_;
+  for (const auto& point : points_) {
+    if (time < point_start + point.duration) {
+      if (point_end) *point_end = point_start + point.duration;
+      return point;
+    }
+    point_start += point.duration;
+  }
+  if (point_end) *point_end = point_start + points_.back().duration;
+  return points_.back();
+}
+
+// Simulates a playback of the manifest with a single trace.
+class NetworkSimulation::Session {
+ public:
+  Session(DashManifest* manifest, const Trace& trace,
+          const std::atomic<bool>& cancelled)
+      : manifest_(manifest),
+        trace_(trace),
+        cancelled_(cancelled),
+        link_(trace.points),
+        video_streams_(),
+        audio_streams_(),
+        bandwidth_estimator_(std::make_shared<BandwidthEstimator>()),
+        abr_engine_(bandwidth_estimator_,
+                    AbrRule::Create(AbrRule::Type::kHybrid)),
+        origin_(AbrEngine::Clock::now()),
+        segment_ahead_(TuningProfile::Current().segment_ahead),
+        streams_(),
+        content_end_(0.),
+        time_(0.),
+        playback_time_(0.),
+        playing_(false),
+        started_(false),
+        next_abr_update_(kAbrUpdateInterval),
+        rebuffer_time_(0.),
+        weighted_bitrate_(0.),
+        video_time_(0.),
+        last_switch_time_(0.),
+        last_switch_direction_(0),
+        result_() {
+    abr_engine_.SetTimeSource([this]() {
+      return origin_ + std::chrono::duration_cast<AbrEngine::Clock::duration>(
+          std::chrono::duration<double>(time_));
+    });
+  }
+
+  Result Run() {
+    result_.trace = trace_.name;
+    video_streams_ = manifest_->GetVideoStreams();
+    audio_streams_ = manifest_->GetAudioStreams();
+    if (video_streams_.empty() || trace_.points.empty()) return result_;
+    for (const auto& point : trace_.points) {
+      if (point.duration <= 0.) {
+        LOG_ERROR("Trace %s has a point without duration",
+                  trace_.name.c_str());
+        return result_;
+      }
+    }
+
+    double duration = ParseDurationToSeconds(manifest_->GetDuration());
+    content_end_ = duration > 0. && !manifest_->IsDynamic()
+        ? std::min(duration, kMaxContentTime) : kMaxContentTime;
+    if (!StartStream(StreamType::Video, video_streams_) ||
+        (!audio_streams_.empty() &&
+         !StartStream(StreamType::Audio, audio_streams_)))
+      return result_;
+
+    while (!cancelled_ && time_ < kMaxSimulatedTime) {
+      UpdateRepresentations();
+      Stream* next = NextDownload();
+      if (next) {
+        DownloadSegment(next);
+        continue;
+      }
+      if (Finished()) break;
+      // Nothing to download until buffers drain to the threshold.
+      Advance(std::max(MinBufferedTime() - segment_ahead_ -
+                           playback_time_, kEps));
+    }
+
+    result_.ok = Finished();
+    result_.played_time = playback_time_;
+    result_.simulated_time = time_;
+    double watched = time_ - result_.startup_time;
+    if (started_ && watched > 0.)
+      result_.rebuffer_ratio = rebuffer_time_ / watched;
+    if (video_time_ > 0.)
+      result_.average_bitrate = weighted_bitrate_ / video_time_;
+    if (playback_time_ > 0.)
+      result_.switches_per_minute = result_.switches * 60. / playback_time_;
+    return result_;
+  }
+
+ private:
+  struct Stream {
+    StreamType type;
+    bool active = false;
+    int32_t representation_id = -1;
+    uint32_t bitrate = 0;
+    std::shared_ptr<const MediaSegmentSequence> sequence;
+    MediaSegmentSequence::Iterator next_segment;
+    double buffered_time = 0.;
+    bool ended = false;
+  };
+
+  template <typename T>
+  bool StartStream(StreamType type, const vector<T>& representations) {
+    // Alternatives of the first representation, like the default ones the
+    // controller starts with.
+    vector<AbrCandidate> candidates;
+    for (const auto& representation : representations) {
+      if (IsSameKind(representation, representations.front()))
+        candidates.push_back(MakeAbrCandidate(representation));
+    }
+    abr_engine_.SetCandidates(type, std::move(candidates),
+                              representations.front().description.id);
+    int32_t id = abr_engine_.ChooseInitial(type);
+    Stream& stream = streams_[static_cast<size_t>(type)];
+    stream.type = type;
+    stream.active = true;
+    if (!SwitchRepresentation(&stream, id,
+                              representations[id].description.bitrate)) {
+      LOG_ERROR("No sequence of representation %d", id);
+      return false;
+    }
+    abr_engine_.OnRepresentationChanged(type, id);
+    return true;
+  }
+
+  bool SwitchRepresentation(Stream* stream, int32_t id, uint32_t bitrate) {
+    auto sequence = manifest_->GetSequence(
+        static_cast<MediaStreamType>(stream->type), id);
+    if (!sequence) return false;
+
+    stream->representation_id = id;
+    stream->bitrate = bitrate;
+    stream->sequence = std::move(sequence);
+    // Buffered segments are kept, the new representation continues after
+    // them.
+    stream->next_segment = stream->buffered_time > 0.
+        ? stream->sequence->MediaSegmentForTime(stream->buffered_time + kEps)
+        : stream->sequence->Begin();
+    return true;
+  }
+
+  void UpdateRepresentations() {
+    if (time_ < next_abr_update_) return;
+    next_abr_update_ = time_ + kAbrUpdateInterval;
+
+    for (auto& stream : streams_) {
+      if (!stream.active || stream.ended) continue;
+      int32_t id = abr_engine_.Update(stream.type,
+                                      stream.buffered_time - playback_time_);
+      if (id < 0) continue;
+
+      uint32_t bitrate = stream.type == StreamType::Video
+          ? video_streams_[id].description.bitrate
+          : audio_streams_[id].description.bitrate;
+      uint32_t previous_bitrate = stream.bitrate;
+      if (!SwitchRepresentation(&stream, id, bitrate)) continue;
+      abr_engine_.OnRepresentationChanged(stream.type, id);
+      if (stream.type == StreamType::Video)
+        CountVideoSwitch(bitrate > previous_bitrate ? 1 : -1);
+    }
+  }
+
+  void CountVideoSwitch(int direction) {
+    ++result_.switches;
+    if (direction == -last_switch_direction_ &&
+        time_ - last_switch_time_ <= kOscillationWindow)
+      ++result_.oscillations;
+    last_switch_direction_ = direction;
+    last_switch_time_ = time_;
+  }
+
+  // The stream with the least data buffered, if it needs a segment.
+  Stream* NextDownload() {
+    Stream* next = nullptr;
+    for (auto& stream : streams_) {
+      if (!stream.active || stream.ended ||
+          stream.buffered_time - playback_time_ >= segment_ahead_)
+        continue;
+      if (!next || stream.buffered_time < next->buffered_time) next = &stream;
+    }
+    return next;
+  }
+
+  void DownloadSegment(Stream* stream) {
+    const MediaSegmentSequence* sequence = stream->sequence.get();
+    auto& it = stream->next_segment;
+    if (it == sequence->End() ||
+        sequence->SegmentTimestamp(it) >= content_end_ - kEps) {
+      stream->ended = true;
+      stream->buffered_time = std::max(stream->buffered_time, content_end_);
+      CheckBuffers();
+      return;
+    }
+
+    double segment_duration = std::max(sequence->SegmentDuration(it), 0.);
+    uint64_t bytes = sequence->SegmentSize(it);
+    if (bytes == 0) {
+      bytes = static_cast<uint64_t>(
+          stream->bitrate * segment_duration / kBitsPerByte);
+    }
+    DownloadSample sample;
+    sample.bytes = bytes;
+    sample.total_time = link_.Download(time_, bytes,
+                                       &sample.time_to_first_byte);
+    sample.representation_id = sequence->RepresentationId();
+    Advance(sample.total_time);
+    bandwidth_estimator_->AddSample(sample);
+
+    double segment_end = sequence->SegmentTimestamp(it) + segment_duration;
+    stream->buffered_time = std::max(stream->buffered_time, segment_end);
+    if (stream->type == StreamType::Video) {
+      weighted_bitrate_ += stream->bitrate * segment_duration;
+      video_time_ += segment_duration;
+    }
+    ++it;
+    CheckBuffers();
+  }
+
+  // Moves the simulated time forward, playing what's buffered.
+  void Advance(double time) {
+    time_ += time;
+    if (!playing_) {
+      if (started_) rebuffer_time_ += time;
+      return;
+    }
+    double playable = MinBufferedTime() - playback_time_;
+    if (time <= playable) {
+      playback_time_ += time;
+      return;
+    }
+    playback_time_ += std::max(playable, 0.);
+    if (Finished()) return;
+    playing_ = false;
+    rebuffer_time_ += time - std::max(playable, 0.);
+    ++result_.rebuffers;
+  }
+
+  // Starts or resumes playback once every stream has enough data.
+  void CheckBuffers() {
+    if (playing_ ||
+        MinBufferedTime() < std::min(playback_time_ + kResumeBuffer,
+                                     content_end_))
+      return;
+    playing_ = true;
+    if (!started_) {
+      started_ = true;
+      result_.startup_time = time_;
+    }
+  }
+
+  double MinBufferedTime() const {
+    double buffered = content_end_;
+    for (const auto& stream : streams_)
+      if (stream.active) buffered = std::min(buffered, stream.buffered_time);
+    return buffered;
+  }
+
+  bool Finished() const {
+    return playback_time_ >= content_end_ - kEps;
+  }
+
+  DashManifest* manifest_;
+  const Trace& trace_;
+  const std::atomic<bool>& cancelled_;
+  Link link_;
+  vector<VideoStream> video_streams_;
+  vector<AudioStream> audio_streams_;
+  std::shared_ptr<BandwidthEstimator> bandwidth_estimator_;
+  AbrEngine abr_engine_;
+  // Simulated time 0 for AbrEngine.
+  AbrEngine::Clock::time_point origin_;
+  // Like StreamManager, the next segment is requested when less than that
+  // much is buffered ahead of the playback position.
+  double segment_ahead_;
+  std::array<Stream, static_cast<size_t>(StreamType::MaxStreamTypes)>
+      streams_;
+  double content_end_;
+  // Seconds since the start of the simulation.
+  double time_;
+  double playback_time_;
+  bool playing_;
+  bool started_;
+  double next_abr_update_;
+  double rebuffer_time_;
+  double weighted_bitrate_;
+  double video_time_;
+  // Time and direction of the last video switch, 1 up, -1 down and 0 before
+  // the first one.
+  double last_switch_time_;
+  int last_switch_direction_;
+  Result result_;
+};
+
+NetworkSimulation::NetworkSimulation(const pp::InstanceHandle& instance)
+    : cc_factory_(this),
+      running_(false),
+      cancelled_(false),
+      thread_(instance) {
+  thread_.Start();
+}
+
+NetworkSimulation::~NetworkSimulation() {
+  cancelled_ = true;
+  thread_.Join();
+}
+
+vector<NetworkSimulation::Trace> NetworkSimulation::DefaultTraces() {
+  return {
+    MakeTrace("broadband", 60., {{20e6, 0.02}}),
+    MakeTrace("dsl", 60., {{4e6, 0.04}}),
+    MakeTrace("mobile", 5., {{6e6, 0.08}, {2.5e6, 0.1}, {1.2e6, 0.15},
+                             {0.6e6, 0.2}, {3e6, 0.1}, {9e6, 0.06},
+                             {4e6, 0.08}, {1.5e6, 0.12}}),
+    MakeTrace("drop", 60., {{10e6, 0.03}, {1e6, 0.05}, {10e6, 0.03}}),
+    MakeTrace("satellite", 30., {{8e6, 0.6}, {5e6, 0.8}}),
+  };
+}
+
+bool NetworkSimulation::Start(const string& manifest_url,
+                              const vector<Trace>& traces,
+                              const ResultCallback& callback) {
+  if (running_.exchange(true)) {
+    LOG_ERROR("A network simulation is running already");
+    return false;
+  }
+  manifest_url_ = manifest_url;
+  traces_ = traces.empty() ? DefaultTraces() : traces;
+  callback_ = callback;
+  thread_.message_loop().PostWork(cc_factory_.NewCallback(
+      &NetworkSimulation::RunOnSimulationThread));
+  return true;
+}
+
+void NetworkSimulation::RunOnSimulationThread(int32_t) {
+  auto manifest = DashManifest::ParseMPD(manifest_url_);
+  if (!manifest) LOG_ERROR("Failed to load %s", manifest_url_.c_str());
+  // Segment indexes are loaded up front, so they are not downloaded during
+  // the first simulation.
+  if (manifest) manifest->LoadSegmentIndexes();
+
+  for (const auto& trace : traces_) {
+    if (cancelled_) break;
+    Result result = Result();
+    result.trace = trace.name;
+    if (manifest) result = Session(manifest.get(), trace, cancelled_).Run();
+    LOG_INFO("%s: %s, startup: %.2f [s], rebuffers: %u ratio: %.3f, "
+             "bitrate: %.0f [bps], switches: %u (%.2f per minute, %u "
+             "oscillations), played: %.1f [s] in %.1f [s]",
+             result.trace.c_str(), result.ok ? "ok" : "failed",
+             result.startup_time, result.rebuffers, result.rebuffer_ratio,
+             result.average_bitrate, result.switches,
+             result.switches_per_minute, result.oscillations,
+             result.played_time, result.simulated_time);
+    if (callback_) callback_(result);
+  }
+  traces_.clear();
+  callback_ = nullptr;
+  running_ = false;
+}
@@ -0,0 +1,137 @@
+/*!
+ * network_simulation.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_NETWORK_SIMULATION_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_NETWORK_SIMULATION_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/simple_thread.h"
+
+// Replays network traces against the download and adaptation logic, to tune
+// it in repeatable conditions. Segments of a real manifest are "downloaded"
+// over a simulated link, which bandwidth and latency follow a trace, and
+// BandwidthEstimator and AbrEngine choose representations like during
+// playback. Buffering mirrors StreamManager, which requests a segment when
+// less than 7 seconds are buffered ahead, and playback is a simulated clock
+// which stalls when a stream runs out of data.
+//
+// Everything runs in a simulated time, so a trace of several minutes takes
+// a fraction of a second. Only the manifest is downloaded for real, segment
+// sizes are taken from segment indexes or representation bitrates.
+class NetworkSimulation {
+ public:
+  // A period of constant network conditions.
+  struct TracePoint {
+    double duration;  // seconds
+    double bandwidth;  // bits per second
+    double latency;  // seconds, until the first byte of a response
+  };
+
+  // A trace is repeated when playback outlasts it.
+  struct Trace {
+    std::string name;
+    std::vector<TracePoint> points;
+  };
+
+  // A link which serves one request at a time. Bandwidth and latency follow
+  // the trace, latency is the one of the point the request starts in.
+  class Link {
+   public:
+    explicit Link(const std::vector<TracePoint>& points);
+
+    // Returns the time a download of the given size, started at time,
+    // takes and stores its time to first byte in time_to_first_byte.
+    double Download(double time, uint64_t bytes,
+                    double* time_to_first_byte) const;
+
+   private:
+    // Returns the point the given time falls in and stores its end time in
+    // point_end, if it's not null.
+    const TracePoint& PointAt(double time, double* point_end = nullptr) const;
+
+    std::vector<TracePoint> points_;
+    double trace_duration_;
+  };
+
+  struct Result {
+    std::string trace;
+    bool ok;
+    // Time from the start until playback started, in seconds.
+    double startup_time;
+    // Part of the time after startup spent waiting for data.
+    double rebuffer_ratio;
+    uint32_t rebuffers;
+    // Video bitrate weighted by segment durations, in bits per second.
+    double average_bitrate;
+    // Video representation changes made by AbrEngine.
+    uint32_t switches;
+    // Changes per minute of played content.
+    double switches_per_minute;
+    // Changes reverting the direction of the previous one within 10
+    // seconds, i.e. AbrEngine going back and forth between bitrates.
+    uint32_t oscillations;
+    // Played content and simulated time, in seconds.
+    double played_time;
+    double simulated_time;
+  };
+
+  // Called once per trace, on the simulation thread.
+  typedef std::function<void(const Result&)> ResultCallback;
+
+  explicit NetworkSimulation(const pp::InstanceHandle& instance);
+  ~NetworkSimulation();
+
+  // Built-in traces: fixed broadband and DSL links, a fluctuating mobile
+  // one, a sudden drop of bandwidth and a high latency satellite link.
+  static std::vector<Trace> DefaultTraces();
+
+  // Starts a simulation of the given manifest with each trace, unless one
+  // is running already.
+  bool Start(const std::string& manifest_url,
+             const std::vector<Trace>& traces,
+             const ResultCallback& callback);
+
+  bool IsRunning() const { return running_; }
+
+ private:
+  class Session;
+
+  void RunOnSimulationThread(int32_t);
+
+  pp::CompletionCallbackFactory<NetworkSimulation> cc_factory_;
+  std::atomic<bool> running_;
+  std::atomic<bool> cancelled_;
+
+  // Used on the simulation thread while a simulation runs.
+  std::string manifest_url_;
+  std::vector<Trace> traces_;
+  ResultCallback callback_;
+
+  // Declared last, so it's joined before other members are destroyed.
+  pp::SimpleThread thread_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_NETWORK_SIMULATION_H_
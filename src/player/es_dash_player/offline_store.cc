@@ -0,0 +1,428 @@
+/*!
+ * offline_store.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include "offline_store.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <utility>
+
+#include "libxml/parser.h"
+#include "libxml/tree.h"
+#include "ppapi/c/pp_errors.h"
+#include "ppapi/utility/threading/lock.h"
+
+#include "common.h"
+#include "dash/base_url_selector.h"
+#include "dash/dash_manifest.h"
+#include "dash/media_segment_sequence.h"
+#include "dash/util.h"
+
+#include "drm_play_ready.h"
+#include "network_executor.h"
+
+namespace {
+
+constexpr const char* kTitlePrefix = "/offline_";
+constexpr const char* kManifestFile = "/manifest.mpd";
+constexpr const char* kPartSuffix = ".part";
+constexpr const char* kStoredFileMagic = "NPOS1";
+constexpr uint32_t kMaxHeaderFieldSize = 64 * 1024;
+constexpr const char* kPeriodElement = "Period";
+constexpr const char* kAdaptationSetElement = "AdaptationSet";
+constexpr const char* kRepresentationElement = "Representation";
+constexpr const char* kIdAttribute = "id";
+
+// Guards the title served by the local data source.
+pp::Lock active_title_lock;
+std::string active_title_dir;
+
+// Returns an empty string if the storage is not available.
+std::string TitleDir(const std::string& url) {
+  std::string dir = GetPersistentStorageDir();
+  if (dir.empty()) return std::string();
+  return dir + kTitlePrefix + StorageFileName(url);
+}
+
+std::string ResourcePath(const std::string& dir, const std::string& url) {
+  return dir + '/' + StorageFileName(url);
+}
+
+// Stored files begin with a header holding the url they were downloaded
+// from, so a colliding file name is a miss instead of other title's bytes.
+bool WriteStoredHeader(FILE* file, const std::string& url) {
+  return WriteStorageField(file, kStoredFileMagic, strlen(kStoredFileMagic)) &&
+         WriteStorageField(file, url);
+}
+
+// Returns an offset of the data which follows the header, or 0 if the file
+// is missing or it was stored for other url.
+uint64_t StoredDataOffset(const std::string& path, const std::string& url) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) return 0;
+  std::string magic;
+  std::string stored_url;
+  bool ok = ReadStorageField(file, kMaxHeaderFieldSize, &magic) &&
+            magic == kStoredFileMagic &&
+            ReadStorageField(file, kMaxHeaderFieldSize, &stored_url) &&
+            stored_url == url;
+  long offset = ok ? ftell(file) : 0;
+  fclose(file);
+  return offset > 0 ? offset : 0;
+}
+
+bool IsStored(const std::string& path, const std::string& url) {
+  return StoredDataOffset(path, url) != 0;
+}
+
+// Reads the range of data stored for url; the range doesn't count the
+// header.
+bool ReadStored(const std::string& path, const std::string& url,
+                const std::string& range, std::vector<uint8_t>* data) {
+  uint64_t offset = StoredDataOffset(path, url);
+  if (offset == 0) return false;
+  uint64_t first = 0;
+  std::string last;
+  if (!range.empty()) {
+    char* end = nullptr;
+    first = std::strtoull(range.c_str(), &end, 10);
+    if (*end == '-' && *(end + 1) != '\0')
+      last = std::to_string(std::strtoull(end + 1, nullptr, 10) + offset);
+  }
+  return ReadLocalFile(path, std::to_string(first + offset) + '-' + last,
+                       data);
+}
+
+bool WriteStoredFile(const std::string& path, const std::string& url,
+                     const std::string& text) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (!file) return false;
+  bool ok = WriteStoredHeader(file, url) &&
+            fwrite(text.data(), 1, text.size(), file) == text.size();
+  return fclose(file) == 0 && ok;
+}
+
+// Calls callback for element children of node with the given name. The
+// callback can unlink the child.
+template <typename Callback>
+void ForEachChild(xmlNodePtr node, const char* name, Callback callback) {
+  xmlNodePtr child = node->children;
+  while (child) {
+    xmlNodePtr next = child->next;
+    if (child->type == XML_ELEMENT_NODE &&
+        xmlStrEqual(child->name, BAD_CAST name))
+      callback(child);
+    child = next;
+  }
+}
+
+void RemoveNode(xmlNodePtr node) {
+  xmlUnlinkNode(node);
+  xmlFreeNode(node);
+}
+
+bool IsKept(xmlNodePtr representation,
+            const std::set<std::string>& kept_ids) {
+  xmlChar* id = xmlGetProp(representation, BAD_CAST kIdAttribute);
+  bool kept = id && kept_ids.count(reinterpret_cast<const char*>(id));
+  xmlFree(id);
+  return kept;
+}
+
+// Rewrites the manifest, so it lists only representations of kept_ids.
+// Adaptation sets left without representations are dropped as well.
+// Returns false if the manifest can't be parsed.
+bool FilterRepresentations(const std::string& mpd,
+                           const std::set<std::string>& kept_ids,
+                           std::string* filtered) {
+  xmlInitParser();
+  xmlDocPtr doc = xmlReadMemory(mpd.data(), mpd.size(), nullptr, nullptr,
+                                XML_PARSE_NONET | XML_PARSE_NOERROR |
+                                    XML_PARSE_NOWARNING);
+  xmlNodePtr root = doc ? xmlDocGetRootElement(doc) : nullptr;
+  if (!root) {
+    xmlFreeDoc(doc);
+    return false;
+  }
+
+  ForEachChild(root, kPeriodElement, [&kept_ids](xmlNodePtr period) {
+    ForEachChild(period, kAdaptationSetElement,
+        [&kept_ids](xmlNodePtr adaptation_set) {
+          bool empty = true;
+          ForEachChild(adaptation_set, kRepresentationElement,
+              [&kept_ids, &empty](xmlNodePtr representation) {
+                if (IsKept(representation, kept_ids))
+                  empty = false;
+                else
+                  RemoveNode(representation);
+              });
+          if (empty) RemoveNode(adaptation_set);
+        });
+  });
+
+  xmlChar* buffer = nullptr;
+  int size = 0;
+  xmlDocDumpMemory(doc, &buffer, &size);
+  if (buffer) filtered->assign(reinterpret_cast<char*>(buffer), size);
+  xmlFree(buffer);
+  xmlFreeDoc(doc);
+  return buffer != nullptr;
+}
+
+void AddResource(const std::string& url, std::vector<std::string>* urls) {
+  if (!url.empty() && std::find(urls->begin(), urls->end(), url) == urls->end())
+    urls->push_back(url);
+}
+
+// Adds URLs of init, index and media segments of sequence. Segments given
+// by byte ranges are parts of the same resource, which is stored whole.
+void AddSequenceResources(const MediaSegmentSequence& sequence,
+                          std::vector<std::string>* urls) {
+  auto add_segment = [urls](std::unique_ptr<dash::mpd::ISegment> segment) {
+    if (segment) AddResource(DescribeSegment(segment.get()).url, urls);
+  };
+  add_segment(sequence.GetInitSegment());
+  add_segment(sequence.GetRepresentationIndexSegment());
+  add_segment(sequence.GetIndexSegment());
+  for (auto it = sequence.Begin(); it != sequence.End(); ++it) {
+    SegmentDescriptor segment;
+    if (!sequence.GetSegmentDescriptor(it, &segment)) break;
+    AddResource(segment.url, urls);
+  }
+}
+
+// The highest bitrate up to max_bitrate, or the lowest one if all of them
+// exceed it.
+const VideoStream* ChooseVideo(const std::vector<VideoStream>& streams,
+                               uint32_t max_bitrate) {
+  const VideoStream* chosen = nullptr;
+  const VideoStream* lowest = nullptr;
+  for (const auto& stream : streams) {
+    uint32_t bitrate = stream.description.bitrate;
+    if (!lowest || bitrate < lowest->description.bitrate) lowest = &stream;
+    if ((max_bitrate == 0 || bitrate <= max_bitrate) &&
+        (!chosen || bitrate > chosen->description.bitrate))
+      chosen = &stream;
+  }
+  return chosen ? chosen : lowest;
+}
+
+}  // namespace
+
+struct OfflineStore::Job {
+  Job(const std::string& url, uint32_t max_bitrate)
+      : url(url), max_bitrate(max_bitrate), next(0), reported_percent(0),
+        finished(false) {}
+
+  std::string url;
+  uint32_t max_bitrate;
+  std::string dir;
+  // The rewritten manifest, written when all resources are stored.
+  std::string mpd;
+  std::vector<std::string> resources;
+  size_t next;
+  uint32_t reported_percent;
+  CancellationToken cancellation_token;
+  std::atomic<bool> finished;
+};
+
+OfflineStore::OfflineStore(std::shared_ptr<WorkerPool> worker_pool,
+                           ProgressCallback progress_callback)
+    : progress_callback_(std::move(progress_callback)),
+      cc_factory_(this),
+      executor_(MakeUnique<NetworkExecutor>(std::move(worker_pool), 1)),
+      jobs_() {}
+
+OfflineStore::~OfflineStore() {
+  for (auto& job : jobs_)
+    job->cancellation_token.Cancel();
+}
+
+void OfflineStore::Download(const std::string& url, uint32_t max_bitrate) {
+  jobs_.erase(std::remove_if(jobs_.begin(), jobs_.end(),
+      [](const std::shared_ptr<Job>& job) { return job->finished.load(); }),
+      jobs_.end());
+  auto same_url = [&url](const std::shared_ptr<Job>& job) {
+    return job->url == url;
+  };
+  if (std::any_of(jobs_.begin(), jobs_.end(), same_url)) return;
+
+  LOG_INFO("Downloading for offline playback: %s", url.c_str());
+  auto job = std::make_shared<Job>(url, max_bitrate);
+  jobs_.push_back(job);
+  executor_->Post(NetworkExecutor::Priority::kPrefetch,
+      cc_factory_.NewCallback(&OfflineStore::PrepareOnWorker, job));
+}
+
+bool OfflineStore::Activate(const std::string& url) {
+  std::string dir = TitleDir(url);
+  bool stored = !dir.empty() && IsStored(dir + kManifestFile, url);
+  pp::AutoLock lock(active_title_lock);
+  if (!stored) {
+    if (!active_title_dir.empty()) {
+      SetLocalDataSource(nullptr);
+      active_title_dir.clear();
+    }
+    return false;
+  }
+
+  LOG_INFO("Playing from offline storage: %s", url.c_str());
+  if (active_title_dir == dir) return true;
+  active_title_dir = dir;
+  SetLocalDataSource([dir, url](const SegmentDescriptor& location,
+                                std::vector<uint8_t>* data) {
+    if (location.url == url)
+      return ReadStored(dir + kManifestFile, url, std::string(), data);
+    return ReadStored(ResourcePath(dir, location.url), location.url,
+                      location.range, data);
+  });
+  return true;
+}
+
+void OfflineStore::PrepareOnWorker(int32_t,
+                                   const std::shared_ptr<Job>& job) {
+  if (job->cancellation_token.IsCancelled()) return;
+
+  job->dir = TitleDir(job->url);
+  if (job->dir.empty()) {
+    Finish(job, PP_ERROR_FAILED);
+    return;
+  }
+  if (IsStored(job->dir + kManifestFile, job->url)) {
+    LOG_INFO("Already stored for offline playback: %s", job->url.c_str());
+    job->reported_percent = 100;
+    Finish(job, PP_OK);
+    return;
+  }
+  mkdir(job->dir.c_str(), 0777);
+
+  BaseUrlSelector::Get().LoadScores();
+  auto visitor = MakeUnique<DrmPlayReadyContentProtectionVisitor>();
+  std::string mpd_data;
+  std::unique_ptr<DashManifest> manifest;
+  if (DashManifest::DownloadManifest(job->url, &mpd_data))
+    manifest = DashManifest::ParseMPD(job->url, mpd_data, visitor.get());
+  if (!manifest || manifest->IsDynamic()) {
+    LOG_ERROR("Can't download for offline playback: %s", job->url.c_str());
+    Finish(job, PP_ERROR_FAILED);
+    return;
+  }
+
+  std::vector<std::shared_ptr<const MediaSegmentSequence>> sequences;
+  const VideoStream* video =
+      ChooseVideo(manifest->GetVideoStreams(), job->max_bitrate);
+  if (video)
+    sequences.push_back(manifest->GetVideoSequence(video->description.id));
+  std::map<std::string, AudioStream> audio_by_language;
+  for (const auto& audio : manifest->GetAudioStreams()) {
+    auto it = audio_by_language.find(audio.language);
+    if (it == audio_by_language.end() ||
+        audio.description.bitrate > it->second.description.bitrate)
+      audio_by_language[audio.language] = audio;
+  }
+  for (const auto& entry : audio_by_language) {
+    sequences.push_back(
+        manifest->GetAudioSequence(entry.second.description.id));
+  }
+
+  std::set<std::string> kept_ids;
+  for (const auto& sequence : sequences) {
+    if (!sequence) continue;
+    kept_ids.insert(sequence->RepresentationId());
+    AddSequenceResources(*sequence, &job->resources);
+  }
+  if (job->resources.empty()) {
+    LOG_ERROR("No segments to download for: %s", job->url.c_str());
+    Finish(job, PP_ERROR_FAILED);
+    return;
+  }
+  if (!FilterRepresentations(mpd_data, kept_ids, &job->mpd)) {
+    LOG_ERROR("Can't rewrite the manifest of: %s", job->url.c_str());
+    Finish(job, PP_ERROR_FAILED);
+    return;
+  }
+  LOG_INFO("Storing %zu resources of: %s", job->resources.size(),
+           job->url.c_str());
+  DownloadOnWorker(PP_OK, job);
+}
+
+void OfflineStore::DownloadOnWorker(int32_t,
+                                    const std::shared_ptr<Job>& job) {
+  if (job->cancellation_token.IsCancelled()) return;
+
+  if (job->next == job->resources.size()) {
+    if (!WriteStoredFile(job->dir + kManifestFile, job->url, job->mpd)) {
+      LOG_ERROR("Can't store the manifest of: %s", job->url.c_str());
+      remove((job->dir + kManifestFile).c_str());
+      Finish(job, PP_ERROR_FAILED);
+      return;
+    }
+    LOG_INFO("Stored for offline playback: %s", job->url.c_str());
+    Finish(job, PP_OK);
+    return;
+  }
+
+  // Resources are stored under a temporary name until they are complete,
+  // so ones which are stored are skipped when a download continues.
+  const std::string& url = job->resources[job->next];
+  std::string path = ResourcePath(job->dir, url);
+  if (!IsStored(path, url)) {
+    std::string part_path = path + kPartSuffix;
+    FILE* file = fopen(part_path.c_str(), "wb");
+    bool ok = file && WriteStoredHeader(file, url) &&
+        DownloadSegment(SegmentDescriptor{url, std::string()},
+            [file](std::vector<uint8_t>&& chunk) {
+              return fwrite(chunk.data(), 1, chunk.size(), file) ==
+                     chunk.size();
+            }, nullptr, &job->cancellation_token);
+    if (file && fclose(file) != 0) ok = false;
+    if (!ok || rename(part_path.c_str(), path.c_str()) != 0) {
+      remove(part_path.c_str());
+      if (job->cancellation_token.IsCancelled()) return;
+      LOG_ERROR("Can't store %s of: %s", url.c_str(), job->url.c_str());
+      Finish(job, PP_ERROR_FAILED);
+      return;
+    }
+  }
+
+  ++job->next;
+  uint32_t percent = job->next * 100 / job->resources.size();
+  if (percent != job->reported_percent && job->next < job->resources.size()) {
+    job->reported_percent = percent;
+    progress_callback_(job->url, percent, PP_OK);
+  }
+  executor_->Post(NetworkExecutor::Priority::kPrefetch,
+      cc_factory_.NewCallback(&OfflineStore::DownloadOnWorker, job));
+}
+
+void OfflineStore::Finish(const std::shared_ptr<Job>& job, int32_t error) {
+  job->finished = true;
+  progress_callback_(job->url, error == PP_OK ? 100 : job->reported_percent,
+                     error);
+}
@@ -0,0 +1,88 @@
+/*!
+ * offline_store.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_OFFLINE_STORE_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_OFFLINE_STORE_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ppapi/utility/completion_callback_factory.h"
+
+class NetworkExecutor;
+class WorkerPool;
+
+// Downloads DASH titles for playback without a network. Init segments and
+// all media segments of chosen representations are stored in a persistent
+// HTML5 file system, along with a manifest rewritten to list only those
+// representations. Downloads run one segment at a time at the prefetch
+// priority on workers shared with players, and a download which was stopped,
+// e.g. by closing the application, continues with the first segment which
+// isn't stored yet.
+//
+// A stored title is served by a LocalDataSource (see Activate()), so it's
+// played by EsDashPlayerController from the same manifest URL as when it's
+// streamed. Only static presentations can be downloaded. It's used on the
+// main thread, apart from Activate().
+class OfflineStore {
+ public:
+  // Gets a manifest URL of the title, a percentage of it stored and
+  // PP_OK, or an error code when the download failed. It's called on
+  // a network worker.
+  typedef std::function<void(const std::string& url, uint32_t percent,
+                             int32_t error)> ProgressCallback;
+
+  OfflineStore(std::shared_ptr<WorkerPool> worker_pool,
+               ProgressCallback progress_callback);
+  ~OfflineStore();
+
+  // Starts downloading the title of the manifest url in the background.
+  // Video is stored in the highest bitrate up to max_bitrate (0 means no
+  // limit), audio in the highest bitrate of each language. Text and image
+  // adaptation sets are not stored.
+  void Download(const std::string& url, uint32_t max_bitrate);
+
+  // Serves the title stored for url from storage, so it plays without
+  // a network. Returns false if the title isn't stored completely, then
+  // a title served before isn't served anymore. Must not be called on the
+  // main thread.
+  static bool Activate(const std::string& url);
+
+ private:
+  struct Job;
+
+  void PrepareOnWorker(int32_t, const std::shared_ptr<Job>& job);
+  // Stores the next resource of job, once all of them are stored the
+  // manifest is written, which completes the title.
+  void DownloadOnWorker(int32_t, const std::shared_ptr<Job>& job);
+  void Finish(const std::shared_ptr<Job>& job, int32_t error);
+
+  ProgressCallback progress_callback_;
+  pp::CompletionCallbackFactory<OfflineStore> cc_factory_;
+  // Runs a single task at a time on shared workers. Its running task
+  // finishes before cc_factory_ is destroyed.
+  std::unique_ptr<NetworkExecutor> executor_;
+  std::vector<std::shared_ptr<Job>> jobs_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_OFFLINE_STORE_H_
@@ -0,0 +1,692 @@
+/*!
+ * packet_capture.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kPackets
+
+#include "player/es_dash_player/packet_capture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ppapi/utility/threading/lock.h"
+
+#include "common.h"
+#include "player/es_dash_player/packets_manager.h"
+#include "player/es_dash_player/stream_sink.h"
+
+using Samsung::NaClPlayer::TimeTicks;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+using std::vector;
+
+namespace {
+
+constexpr char kMagic[4] = {'N', 'P', 'P', 'C'};
+constexpr const char* kDefaultFile = "/packets.npcap";
+// Flags of kPacket records. Packets passed together with OnEsPackets() are
+// marked, so they are replayed as a batch as well.
+constexpr uint16_t kBatched = 1;
+constexpr uint16_t kBatchEnd = 2;
+// A size of the record header: type, stream, flag, body size and time.
+constexpr size_t kRecordHeaderSize = 16;
+// Bodies bigger than that are taken for a corrupted file.
+constexpr uint32_t kMaxBodySize = 64 * 1024 * 1024;
+
+typedef PacketCapture::RecordType RecordType;
+
+// Guards the capture file, records of a call are written in one go.
+pp::Lock capture_lock;
+FILE* capture_file = nullptr;
+PacketCapture::Stats capture_stats;
+std::atomic<bool> capture_payloads(false);
+std::atomic<int64_t> capture_start_us(0);
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      steady_clock::now().time_since_epoch()).count();
+}
+
+// Serializes records of a single call.
+class RecordWriter {
+ public:
+  void Begin(RecordType record_type, StreamType type, uint16_t flag) {
+    ++count_;
+    record_start_ = data_.size();
+    Put(static_cast<uint8_t>(record_type));
+    Put(static_cast<uint8_t>(type));
+    Put(flag);
+    Put(static_cast<uint32_t>(0));
+    Put(NowUs() - capture_start_us.load(std::memory_order_relaxed));
+  }
+
+  // Fills in the size of the body of the current record.
+  void End() {
+    auto size = static_cast<uint32_t>(
+        data_.size() - record_start_ - kRecordHeaderSize);
+    memcpy(&data_[record_start_ + 4], &size, sizeof(size));
+  }
+
+  template <typename T>
+  void Put(T value) {
+    PutBytes(&value, sizeof(value));
+  }
+
+  void PutBytes(const void* bytes, size_t size) {
+    if (!size) return;
+    auto data = static_cast<const uint8_t*>(bytes);
+    data_.insert(data_.end(), data, data + size);
+  }
+
+  void PutExtraData(const CodecExtraData& extra_data) {
+    Put(static_cast<uint32_t>(extra_data.size()));
+    PutBytes(extra_data.data(), extra_data.size());
+  }
+
+  void PutPacket(StreamType type, const ElementaryStreamPacket& packet,
+                 uint16_t flag) {
+    const auto& info = packet.GetEncryptionInfo();
+    bool encrypted = packet.IsEncrypted();
+    uint32_t subsamples = encrypted ? info.num_subsamples : 0;
+    Begin(RecordType::kPacket, type, flag);
+    Put(packet.GetMediaPts());
+    Put(packet.GetMediaDts());
+    Put(packet.GetMediaDuration());
+    Put(static_cast<int32_t>(packet.demux_id));
+    Put(packet.GetDataSize());
+    Put(static_cast<uint8_t>(packet.IsKeyFrame()));
+    Put(static_cast<uint8_t>(encrypted ? info.key_id_size : 0));
+    Put(static_cast<uint8_t>(encrypted ? info.iv_size : 0));
+    Put(static_cast<uint8_t>(0));
+    Put(subsamples);
+    if (encrypted) {
+      PutBytes(info.key_id, info.key_id_size);
+      PutBytes(info.iv, info.iv_size);
+      for (uint32_t i = 0; i < subsamples; ++i) {
+        Put(info.subsamples[i].clear_bytes);
+        Put(info.subsamples[i].cipher_bytes);
+      }
+    }
+    if (capture_payloads.load(std::memory_order_relaxed))
+      PutBytes(packet.GetESPacket().buffer, packet.GetDataSize());
+    End();
+  }
+
+  const vector<uint8_t>& data() const {
+    return data_;
+  }
+
+  uint64_t count() const {
+    return count_;
+  }
+
+ private:
+  vector<uint8_t> data_;
+  size_t record_start_ = 0;
+  uint64_t count_ = 0;
+};
+
+// Reads values of a record body, an overrun leaves zeros and clears ok.
+class BodyReader {
+ public:
+  explicit BodyReader(const vector<uint8_t>& body)
+      : pos_(body.data()), end_(body.data() + body.size()), ok_(true) {}
+
+  template <typename T>
+  T Get() {
+    T value = T();
+    const uint8_t* bytes = GetBytes(sizeof(value));
+    if (bytes) memcpy(&value, bytes, sizeof(value));
+    return value;
+  }
+
+  // Returns a pointer to size bytes of the body, or null on an overrun.
+  const uint8_t* GetBytes(size_t size) {
+    if (!ok_ || static_cast<size_t>(end_ - pos_) < size) {
+      ok_ = false;
+      return nullptr;
+    }
+    const uint8_t* bytes = pos_;
+    pos_ += size;
+    return bytes;
+  }
+
+  CodecExtraData GetExtraData() {
+    auto size = Get<uint32_t>();
+    const uint8_t* bytes = GetBytes(size);
+    return bytes ? CodecExtraData(bytes, bytes + size) : CodecExtraData();
+  }
+
+  bool ok() const { return ok_; }
+
+ private:
+  const uint8_t* pos_;
+  const uint8_t* end_;
+  bool ok_;
+};
+
+struct Record {
+  RecordType type;
+  StreamType stream;
+  uint16_t flag;
+  int64_t time_us;
+  vector<uint8_t> body;
+};
+
+bool ReadRecord(FILE* file, Record* record) {
+  uint8_t header[kRecordHeaderSize];
+  if (fread(header, 1, sizeof(header), file) != sizeof(header)) return false;
+  uint32_t size;
+  record->type = static_cast<RecordType>(header[0]);
+  record->stream = static_cast<StreamType>(header[1]);
+  memcpy(&record->flag, &header[2], sizeof(record->flag));
+  memcpy(&size, &header[4], sizeof(size));
+  memcpy(&record->time_us, &header[8], sizeof(record->time_us));
+  if (size > kMaxBodySize ||
+      (record->stream != StreamType::Audio &&
+       record->stream != StreamType::Video)) {
+    LOG_ERROR("A packet capture is corrupted");
+    return false;
+  }
+  record->body.resize(size);
+  return fread(record->body.data(), 1, size, file) == size;
+}
+
+AudioConfig ParseAudioConfig(BodyReader* reader) {
+  AudioConfig config = AudioConfig();
+  config.codec_type = static_cast<Samsung::NaClPlayer::AudioCodec_Type>(
+      reader->Get<int32_t>());
+  config.codec_profile = static_cast<Samsung::NaClPlayer::AudioCodec_Profile>(
+      reader->Get<int32_t>());
+  config.sample_format = static_cast<Samsung::NaClPlayer::SampleFormat>(
+      reader->Get<int32_t>());
+  config.channel_layout = static_cast<Samsung::NaClPlayer::ChannelLayout>(
+      reader->Get<int32_t>());
+  config.bits_per_channel = reader->Get<int32_t>();
+  config.samples_per_second = reader->Get<int32_t>();
+  config.demux_id = reader->Get<int32_t>();
+  config.extra_data = reader->GetExtraData();
+  return config;
+}
+
+VideoConfig ParseVideoConfig(BodyReader* reader) {
+  VideoConfig config = VideoConfig();
+  config.codec_type = static_cast<Samsung::NaClPlayer::VideoCodec_Type>(
+      reader->Get<int32_t>());
+  config.codec_profile = static_cast<Samsung::NaClPlayer::VideoCodec_Profile>(
+      reader->Get<int32_t>());
+  config.frame_format = static_cast<Samsung::NaClPlayer::VideoFrame_Format>(
+      reader->Get<int32_t>());
+  config.size.width = reader->Get<int32_t>();
+  config.size.height = reader->Get<int32_t>();
+  config.frame_rate.numerator = reader->Get<int32_t>();
+  config.frame_rate.denominator = reader->Get<int32_t>();
+  config.profile_idc = reader->Get<int32_t>();
+  config.level_idc = reader->Get<int32_t>();
+  config.bit_depth = reader->Get<int32_t>();
+  config.color.primaries = reader->Get<int32_t>();
+  config.color.transfer = reader->Get<int32_t>();
+  config.color.matrix = reader->Get<int32_t>();
+  config.color.full_range = reader->Get<int32_t>() != 0;
+  config.dolby_vision.present = reader->Get<int32_t>() != 0;
+  config.dolby_vision.profile = reader->Get<int32_t>();
+  config.dolby_vision.level = reader->Get<int32_t>();
+  config.dolby_vision.rpu_present = reader->Get<int32_t>() != 0;
+  config.dolby_vision.el_present = reader->Get<int32_t>() != 0;
+  config.dolby_vision.bl_present = reader->Get<int32_t>() != 0;
+  config.dolby_vision.bl_compatibility_id = reader->Get<int32_t>();
+  config.demux_id = reader->Get<int32_t>();
+  config.extra_data = reader->GetExtraData();
+  return config;
+}
+
+// Stands for a StreamManager and a NaCl Player stream which takes every
+// packet. It's seeking from PrepareForSeek() until PacketsManager sets the
+// position of the stream, as no segments are downloaded for it.
+class ReplayStreamSink : public StreamSink {
+ public:
+  ReplayStreamSink() : seeking_(false), appended_(0), appended_bytes_(0) {}
+
+  bool IsInitialized() override {
+    return true;
+  }
+
+  bool IsSeeking() const override {
+    return seeking_;
+  }
+
+  AppendResult AppendPacket(const ElementaryStreamPacket& packet) override {
+    ++appended_;
+    appended_bytes_ += packet.GetDataSize();
+    return AppendResult::kAppended;
+  }
+
+  size_t AppendPackets(
+      const vector<const ElementaryStreamPacket*>& packets,
+      AppendResult* result) override {
+    for (const auto* packet : packets)
+      AppendPacket(*packet);
+    *result = AppendResult::kAppended;
+    return packets.size();
+  }
+
+  bool SetConfig(const AudioConfig&) override {
+    return true;
+  }
+
+  bool SetConfig(const VideoConfig&) override {
+    return true;
+  }
+
+  // Segment boundaries are not captured, so segments start at the seek
+  // position. The captured packets tell where the seek ends.
+  void SetSegmentToTime(TimeTicks time, TimeTicks* timestamp,
+                        TimeTicks* duration) override {
+    seeking_ = false;
+    if (timestamp) *timestamp = time;
+    if (duration) *duration = 0.;
+  }
+
+  void StartSeek() {
+    seeking_ = true;
+  }
+
+  uint64_t appended() const {
+    return appended_;
+  }
+
+  uint64_t appended_bytes() const {
+    return appended_bytes_;
+  }
+
+ private:
+  bool seeking_;
+  uint64_t appended_;
+  uint64_t appended_bytes_;
+};
+
+
+}  // anonymous namespace
+
+constexpr uint32_t PacketCapture::kVersion;
+constexpr uint32_t PacketCapture::kWithPayloads;
+std::atomic<bool> PacketCapture::enabled_(false);
+
+bool PacketCapture::Start(const std::string& path, bool with_payloads) {
+  std::string file_path = path.empty() ? DefaultPath() : path;
+  if (file_path.empty()) {
+    LOG_ERROR("No storage for a packet capture");
+    return false;
+  }
+  Stop();
+  FILE* file = fopen(file_path.c_str(), "wb");
+  if (!file) {
+    LOG_ERROR("Can't create a packet capture: %s", file_path.c_str());
+    return false;
+  }
+  uint32_t flags = with_payloads ? kWithPayloads : 0;
+  bool ok = fwrite(kMagic, 1, sizeof(kMagic), file) == sizeof(kMagic) &&
+            fwrite(&kVersion, sizeof(kVersion), 1, file) == 1 &&
+            fwrite(&flags, sizeof(flags), 1, file) == 1;
+  if (!ok) {
+    fclose(file);
+    LOG_ERROR("Can't write a packet capture: %s", file_path.c_str());
+    return false;
+  }
+
+  pp::AutoLock lock(capture_lock);
+  capture_file = file;
+  capture_stats = Stats();
+  capture_payloads = with_payloads;
+  capture_start_us = NowUs();
+  enabled_ = true;
+  LOG_INFO("Packet capture started: %s%s", file_path.c_str(),
+           with_payloads ? " (with payloads)" : "");
+  return true;
+}
+
+PacketCapture::Stats PacketCapture::Stop() {
+  pp::AutoLock lock(capture_lock);
+  enabled_ = false;
+  if (capture_file) {
+    if (fclose(capture_file) != 0)
+      LOG_ERROR("Can't write the end of a packet capture");
+    capture_file = nullptr;
+    LOG_INFO("Packet capture stopped, %llu records, %llu bytes",
+             static_cast<unsigned long long>(capture_stats.records),
+             static_cast<unsigned long long>(capture_stats.bytes));
+  }
+  return capture_stats;
+}
+
+std::string PacketCapture::DefaultPath() {
+  std::string dir = GetTemporaryStorageDir();
+  return dir.empty() ? dir : dir + kDefaultFile;
+}
+
+void PacketCapture::RecordConfig(const AudioConfig& config) {
+  if (!IsEnabled()) return;
+  RecordWriter writer;
+  writer.Begin(RecordType::kAudioConfig, StreamType::Audio, 0);
+  writer.Put<int32_t>(config.codec_type);
+  writer.Put<int32_t>(config.codec_profile);
+  writer.Put<int32_t>(config.sample_format);
+  writer.Put<int32_t>(config.channel_layout);
+  writer.Put<int32_t>(config.bits_per_channel);
+  writer.Put<int32_t>(config.samples_per_second);
+  writer.Put<int32_t>(config.demux_id);
+  writer.PutExtraData(config.extra_data);
+  writer.End();
+  Write(writer.data(), writer.count());
+}
+
+void PacketCapture::RecordConfig(const VideoConfig& config) {
+  if (!IsEnabled()) return;
+  RecordWriter writer;
+  writer.Begin(RecordType::kVideoConfig, StreamType::Video, 0);
+  writer.Put<int32_t>(config.codec_type);
+  writer.Put<int32_t>(config.codec_profile);
+  writer.Put<int32_t>(config.frame_format);
+  writer.Put<int32_t>(config.size.width);
+  writer.Put<int32_t>(config.size.height);
+  writer.Put<int32_t>(config.frame_rate.numerator);
+  writer.Put<int32_t>(config.frame_rate.denominator);
+  writer.Put<int32_t>(config.profile_idc);
+  writer.Put<int32_t>(config.level_idc);
+  writer.Put<int32_t>(config.bit_depth);
+  writer.Put<int32_t>(config.color.primaries);
+  writer.Put<int32_t>(config.color.transfer);
+  writer.Put<int32_t>(config.color.matrix);
+  writer.Put<int32_t>(config.color.full_range);
+  writer.Put<int32_t>(config.dolby_vision.present);
+  writer.Put<int32_t>(config.dolby_vision.profile);
+  writer.Put<int32_t>(config.dolby_vision.level);
+  writer.Put<int32_t>(config.dolby_vision.rpu_present);
+  writer.Put<int32_t>(config.dolby_vision.el_present);
+  writer.Put<int32_t>(config.dolby_vision.bl_present);
+  writer.Put<int32_t>(config.dolby_vision.bl_compatibility_id);
+  writer.Put<int32_t>(config.demux_id);
+  writer.PutExtraData(config.extra_data);
+  writer.End();
+  Write(writer.data(), writer.count());
+}
+
+void PacketCapture::RecordPacket(StreamType type,
+                                 const ElementaryStreamPacket& packet) {
+  if (!IsEnabled()) return;
+  RecordWriter writer;
+  writer.PutPacket(type, packet, 0);
+  Write(writer.data(), writer.count());
+}
+
+void PacketCapture::RecordPackets(StreamType type,
+                                  const StreamDemuxer::PacketBatch& packets) {
+  if (!IsEnabled() || packets.empty()) return;
+  RecordWriter writer;
+  for (size_t i = 0; i < packets.size(); ++i) {
+    writer.PutPacket(type, *packets[i],
+        kBatched | (i + 1 == packets.size() ? kBatchEnd : 0));
+  }
+  Write(writer.data(), writer.count());
+}
+
+void PacketCapture::RecordEvent(RecordType record_type, StreamType type,
+                                double value, uint16_t flag) {
+  if (!IsEnabled()) return;
+  RecordWriter writer;
+  writer.Begin(record_type, type, flag);
+  writer.Put(value);
+  writer.End();
+  Write(writer.data(), writer.count());
+}
+
+void PacketCapture::Write(const vector<uint8_t>& data, uint64_t count) {
+  pp::AutoLock lock(capture_lock);
+  // The capture might have been stopped since the records were made.
+  if (!capture_file) return;
+  if (fwrite(data.data(), 1, data.size(), capture_file) != data.size()) {
+    LOG_ERROR("Can't write a packet capture, it's stopped");
+    fclose(capture_file);
+    capture_file = nullptr;
+    enabled_ = false;
+    return;
+  }
+  capture_stats.records += count;
+  capture_stats.bytes += data.size();
+}
+
+PacketCaptureReplay::PacketCaptureReplay(const pp::InstanceHandle& instance)
+    : cc_factory_(this),
+      running_(false),
+      cancelled_(false),
+      thread_(instance) {
+  thread_.Start();
+}
+
+PacketCaptureReplay::~PacketCaptureReplay() {
+  cancelled_ = true;
+  thread_.Join();
+}
+
+bool PacketCaptureReplay::Start(const std::string& path, bool max_speed,
+                                const ResultCallback& callback) {
+  if (running_.exchange(true)) {
+    LOG_ERROR("A packet capture replay is running already");
+    return false;
+  }
+  callback_ = callback;
+  thread_.message_loop().PostWork(cc_factory_.NewCallback(
+      &PacketCaptureReplay::RunOnReplayThread, path, max_speed));
+  return true;
+}
+
+void PacketCaptureReplay::RunOnReplayThread(int32_t, const std::string& path,
+                                            bool max_speed) {
+  Result result = Replay(path, max_speed);
+  LOG_INFO("Packet capture replay%s: %llu records, %llu packets, %llu "
+           "appended in %.3f [s] (captured in %.3f [s]), deliver: %.0f "
+           "ns/packet, update: %.0f ns/packet, max: %.2f [us], %.1f [MB/s]",
+           result.ok ? "" : " failed",
+           static_cast<unsigned long long>(result.records),
+           static_cast<unsigned long long>(result.packets),
+           static_cast<unsigned long long>(result.appended), result.seconds,
+           result.captured_seconds, result.deliver_ns_per_packet,
+           result.update_ns_per_packet, result.update_max_us,
+           result.appended_megabytes_per_second);
+  if (callback_) callback_(result);
+  callback_ = nullptr;
+  running_ = false;
+}
+
+PacketCaptureReplay::Result PacketCaptureReplay::Replay(
+    const std::string& path, bool max_speed) {
+  Result result = Result();
+  std::string file_path = path.empty() ? PacketCapture::DefaultPath() : path;
+  FILE* file = fopen(file_path.c_str(), "rb");
+  if (!file) {
+    LOG_ERROR("Can't open a packet capture: %s", file_path.c_str());
+    return result;
+  }
+  char magic[sizeof(kMagic)];
+  uint32_t version = 0;
+  uint32_t flags = 0;
+  if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+      memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+      fread(&version, sizeof(version), 1, file) != 1 ||
+      fread(&flags, sizeof(flags), 1, file) != 1 ||
+      version != PacketCapture::kVersion) {
+    LOG_ERROR("Not a packet capture of version %u: %s",
+              PacketCapture::kVersion, file_path.c_str());
+    fclose(file);
+    return result;
+  }
+
+  PacketsManager packets_manager(TuningProfile::Current());
+  ReplayStreamSink audio;
+  ReplayStreamSink video;
+  packets_manager.SetStream(StreamType::Audio, &audio);
+  packets_manager.SetStream(StreamType::Video, &video);
+
+  // Packets captured without payloads refer to a shared zeroed buffer,
+  // like the ones of Mp4Demuxer refer to their segment.
+  auto zeros = std::make_shared<const vector<uint8_t>>();
+  StreamDemuxer::PacketBatch batch;
+  double deliver_total_us = 0.;
+  double update_total_us = 0.;
+  int64_t first_time_us = -1;
+  int64_t last_time_us = 0;
+  auto start = steady_clock::now();
+  bool ok = true;
+  Record record;
+  while (!cancelled_ && ReadRecord(file, &record)) {
+    ++result.records;
+    if (first_time_us < 0) first_time_us = record.time_us;
+    last_time_us = record.time_us;
+    if (!max_speed) {
+      std::this_thread::sleep_until(
+          start + std::chrono::microseconds(record.time_us - first_time_us));
+    }
+
+    BodyReader reader(record.body);
+    auto call_start = steady_clock::now();
+    switch (record.type) {
+      case RecordType::kAudioConfig:
+        packets_manager.OnStreamConfig(ParseAudioConfig(&reader));
+        break;
+      case RecordType::kVideoConfig:
+        packets_manager.OnStreamConfig(ParseVideoConfig(&reader));
+        break;
+      case RecordType::kPacket: {
+        auto pts = reader.Get<MediaTime>();
+        auto dts = reader.Get<MediaTime>();
+        auto packet_duration = reader.Get<MediaTime>();
+        auto demux_id = reader.Get<int32_t>();
+        auto size = reader.Get<uint32_t>();
+        auto key_frame = reader.Get<uint8_t>() != 0;
+        auto key_id_size = reader.Get<uint8_t>();
+        auto iv_size = reader.Get<uint8_t>();
+        reader.Get<uint8_t>();
+        auto subsamples = reader.Get<uint32_t>();
+        const uint8_t* key_id = reader.GetBytes(key_id_size);
+        const uint8_t* iv = reader.GetBytes(iv_size);
+        vector<std::pair<uint32_t, uint32_t>> subsample_sizes;
+        for (uint32_t i = 0; i < subsamples && reader.ok(); ++i) {
+          auto clear_bytes = reader.Get<uint32_t>();
+          subsample_sizes.emplace_back(clear_bytes, reader.Get<uint32_t>());
+        }
+        std::unique_ptr<ElementaryStreamPacket> packet;
+        if (flags & PacketCapture::kWithPayloads) {
+          const uint8_t* payload = reader.GetBytes(size);
+          if (!reader.ok()) break;
+          packet = MakeUnique<ElementaryStreamPacket>(
+              const_cast<uint8_t*>(payload), size);
+        } else {
+          if (zeros->size() < size)
+            zeros = std::make_shared<const vector<uint8_t>>(size * 2);
+          packet = MakeUnique<ElementaryStreamPacket>(zeros, 0, size);
+        }
+        if (!reader.ok()) break;
+        packet->SetMediaTimestamps(pts, dts, packet_duration);
+        packet->SetKeyFrame(key_frame);
+        packet->demux_id = demux_id;
+        if (key_id_size)
+          packet->SetKeyId(const_cast<uint8_t*>(key_id), key_id_size);
+        if (iv_size) packet->SetIv(const_cast<uint8_t*>(iv), iv_size);
+        for (const auto& subsample : subsample_sizes)
+          packet->AddSubsample(subsample.first, subsample.second);
+        ++result.packets;
+
+        auto message = record.stream == StreamType::Audio
+            ? StreamDemuxer::kAudioPkt : StreamDemuxer::kVideoPkt;
+        if (!(record.flag & kBatched)) {
+          packets_manager.OnEsPacket(message, std::move(packet));
+        } else {
+          batch.push_back(std::move(packet));
+          if (!(record.flag & kBatchEnd)) continue;
+          packets_manager.OnEsPackets(message, std::move(batch));
+          batch.clear();
+        }
+        deliver_total_us += MicrosecondsSince(call_start);
+        continue;
+      }
+      case RecordType::kEndOfStream:
+        packets_manager.OnEndOfStream(record.stream);
+        break;
+      case RecordType::kSeek: {
+        auto time = reader.Get<double>();
+        if (!record.flag) {
+          audio.StartSeek();
+          video.StartSeek();
+        }
+        batch.clear();
+        packets_manager.PrepareForSeek(time, record.flag != 0);
+        break;
+      }
+      case RecordType::kSeekData:
+        packets_manager.OnSeekData(record.stream, reader.Get<double>());
+        break;
+      case RecordType::kNeedData:
+        packets_manager.OnNeedData(record.stream,
+                                   static_cast<int32_t>(reader.Get<double>()));
+        break;
+      case RecordType::kEnoughData:
+        packets_manager.OnEnoughData(record.stream);
+        break;
+      case RecordType::kUpdateBuffer: {
+        packets_manager.UpdateBuffer(reader.Get<double>());
+        double update_us = MicrosecondsSince(call_start);
+        update_total_us += update_us;
+        result.update_max_us = std::max(result.update_max_us, update_us);
+        break;
+      }
+      default:
+        // Records of later versions are skipped.
+        break;
+    }
+    if (!reader.ok()) {
+      LOG_ERROR("A packet capture record is corrupted");
+      ok = false;
+      break;
+    }
+  }
+  ok = ok && !cancelled_ && feof(file);
+  fclose(file);
+  packets_manager.SetStream(StreamType::Audio, nullptr);
+  packets_manager.SetStream(StreamType::Video, nullptr);
+
+  result.ok = ok;
+  result.seconds = duration<double>(steady_clock::now() - start).count();
+  if (first_time_us >= 0)
+    result.captured_seconds = (last_time_us - first_time_us) / 1e6;
+  result.appended = audio.appended() + video.appended();
+  result.appended_bytes = audio.appended_bytes() + video.appended_bytes();
+  if (result.packets > 0)
+    result.deliver_ns_per_packet = deliver_total_us * 1e3 / result.packets;
+  if (result.appended > 0)
+    result.update_ns_per_packet = update_total_us * 1e3 / result.appended;
+  if (result.seconds > 0.) {
+    result.appended_megabytes_per_second =
+        result.appended_bytes / (1024. * 1024.) / result.seconds;
+  }
+  return result;
+}
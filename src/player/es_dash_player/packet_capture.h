@@ -0,0 +1,162 @@
+/*!
+ * packet_capture.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_PACKET_CAPTURE_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_PACKET_CAPTURE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/simple_thread.h"
+
+#include "common.h"
+#include "demuxer/elementary_stream_packet.h"
+#include "demuxer/stream_demuxer.h"
+
+// Records what PacketsManager gets, i.e. configs and packets from demuxers
+// and calls of the player and the buffer update, to a file, so a field
+// issue can be reproduced and the append path benchmarked without network
+// and demuxers (see PacketCaptureReplay). Payloads are optional, without
+// them packets are replayed with zeroed data of the same size. It's thread
+// safe; records of all threads go to one file in the order of calls.
+//
+// The file holds a header, "NPPC", a uint32 version and uint32 flags
+// (kWithPayloads), followed by records. Each record starts with a uint8
+// RecordType, a uint8 StreamType, a uint16 flag, a uint32 size of its body
+// and an int64 time of the call in microseconds since the capture started.
+// Bodies of kPacket records hold int64 pts, dts and duration (MediaTime),
+// int32 demux_id, uint32 size, uint8 key_frame, key id and IV sizes, a
+// padding byte, uint32 count of subsamples, then the key id, the IV, pairs
+// of uint32 clear and cipher bytes and the payload, if it's captured.
+// Config records hold int32 fields of the config in the order of their
+// declarations, then uint32 size of extra data and the data. Other records
+// hold a double argument of the call. Values are in the host byte order,
+// which is little-endian on all supported devices.
+class PacketCapture {
+ public:
+  enum class RecordType : uint8_t {
+    kAudioConfig = 1,
+    kVideoConfig = 2,
+    kPacket = 3,
+    kEndOfStream = 4,
+    // PrepareForSeek(), the flag is in_buffer.
+    kSeek = 5,
+    kSeekData = 6,
+    kNeedData = 7,
+    kEnoughData = 8,
+    kUpdateBuffer = 9,
+  };
+
+  static constexpr uint32_t kVersion = 1;
+  static constexpr uint32_t kWithPayloads = 1;
+
+  struct Stats {
+    uint64_t records;
+    uint64_t bytes;
+  };
+
+  // Starts recording to path, or to a file in the temporary storage if it's
+  // empty, which must not be done on the main thread then. A capture in
+  // progress is stopped first.
+  static bool Start(const std::string& path, bool with_payloads);
+
+  // Stops recording and returns what was written.
+  static Stats Stop();
+
+  static bool IsEnabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  // A file used when no path is given.
+  static std::string DefaultPath();
+
+  static void RecordConfig(const AudioConfig& config);
+  static void RecordConfig(const VideoConfig& config);
+  static void RecordPacket(StreamType type,
+                           const ElementaryStreamPacket& packet);
+  static void RecordPackets(StreamType type,
+                            const StreamDemuxer::PacketBatch& packets);
+  static void RecordEvent(RecordType record_type, StreamType type,
+                          double value, uint16_t flag = 0);
+
+ private:
+  // Appends count serialized records to the file, the capture is stopped if
+  // that fails.
+  static void Write(const std::vector<uint8_t>& data, uint64_t count);
+
+  static std::atomic<bool> enabled_;
+};
+
+// Feeds a capture back into PacketsManager, at the original pace of the
+// calls or as fast as possible, on its own thread. Streams are fake
+// StreamSinks which take every packet, like a player which never pushes
+// back, while NeedData, EnoughData and the buffer updates come from the
+// capture, so packets are scheduled as they were on the device.
+class PacketCaptureReplay {
+ public:
+  struct Result {
+    bool ok;
+    uint64_t records;
+    uint64_t packets;
+    uint64_t appended;
+    uint64_t appended_bytes;
+    // Wall time of the replay and of the capture.
+    double seconds;
+    double captured_seconds;
+    // Time spent in OnEsPacket()/OnEsPackets() and UpdateBuffer(), per
+    // packet delivered and appended respectively.
+    double deliver_ns_per_packet;
+    double update_ns_per_packet;
+    double update_max_us;
+    double appended_megabytes_per_second;
+  };
+
+  // Called on the replay thread when it ends.
+  typedef std::function<void(const Result&)> ResultCallback;
+
+  explicit PacketCaptureReplay(const pp::InstanceHandle& instance);
+  ~PacketCaptureReplay();
+
+  // Starts replaying a capture from path, or from
+  // PacketCapture::DefaultPath() if it's empty, unless a replay is running
+  // already.
+  bool Start(const std::string& path, bool max_speed,
+             const ResultCallback& callback);
+
+  bool IsRunning() const { return running_; }
+
+ private:
+  void RunOnReplayThread(int32_t, const std::string& path, bool max_speed);
+  Result Replay(const std::string& path, bool max_speed);
+
+  pp::CompletionCallbackFactory<PacketCaptureReplay> cc_factory_;
+  std::atomic<bool> running_;
+  std::atomic<bool> cancelled_;
+  ResultCallback callback_;
+
+  // Declared last, so it's joined before other members are destroyed.
+  pp::SimpleThread thread_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_PACKET_CAPTURE_H_
@@ -17,128 +17,278 @@
  * @author Piotr Bałut
  */
 
+#define LOG_CATEGORY LogCategory::kPackets
+
 #include "player/es_dash_player/packets_manager.h"
 
+#include <algorithm>
 #include <limits>
 
+#include "allocation_tracker.h"
+#include "cpu_profiler.h"
+#include "packet_capture.h"
+#include "playback_metrics.h"
+#include "tracer.h"
+#include "tuning_profile.h"
+
 using Samsung::NaClPlayer::TimeTicks;
 
 namespace {
 
 constexpr int kAudioStreamId = static_cast<int>(StreamType::Audio);
 constexpr int kVideoStreamId = static_cast<int>(StreamType::Video);
-// Determines how many seconds worth of packets should be appended to NaCl
-// Player in advance. All available packets in a range:
-// (last appended packet; current_playback_time + kAppendPacketsThreshold]
-// will be appended upon every UpdateBuffer().
-constexpr TimeTicks kAppendPacketsThreshold = 4.0f;  // seconds
+constexpr int kStreamCount = static_cast<int>(StreamType::MaxStreamTypes);
+// Video keyframes that much before the seek target can end a seek.
+constexpr TimeTicks kSeekKeyframeMargin = 0.25f;  // seconds
+// Default limits of memory used by buffered packets of a stream. Together
+// with a time threshold in StreamManager they decide when to download the
+// next segment, so high bitrate streams don't exceed the TV memory budget.
+constexpr size_t kDefaultVideoMemoryBudget = 64 * 1024 * 1024;
+constexpr size_t kDefaultAudioMemoryBudget = 8 * 1024 * 1024;
+// Marks a missing dts in PacketsManager::last_demuxed_dts_ and
+// overlap_end_dts_.
+constexpr MediaTime kNoDts = std::numeric_limits<MediaTime>::min();
 
-class BufferedPacket : public PacketsManager::BufferedStreamObject {
+// Releases a locked pp::Lock for its lifetime, so NaCl Player can be called
+// without holding it.
+class ScopedUnlock {
  public:
-  BufferedPacket(StreamType type,
-                 std::unique_ptr<ElementaryStreamPacket> packet)
-      : BufferedStreamObject(type, packet->GetDts()),
-        packet_(std::move(packet)) {}
-  ~BufferedPacket() override = default;
-  bool Append(StreamManager* stream_manager) override {
-    LOG_DEBUG("demux_id: %d manager: %p dts: %f pts: %f dur: %f pts_end: %f"
-        " key_frame: %d encrypted: %d size: %u",
-        packet_->demux_id, stream_manager, packet_->GetDts(), packet_->GetPts(),
-        packet_->GetDuration(), packet_->GetPts() + packet_->GetDuration(),
-        packet_->IsKeyFrame(), packet_->IsEncrypted(), packet_->GetDataSize());
-    return !stream_manager->AppendPacket(std::move(packet_));
-  }
-  bool IsKeyFrame() const override {
-    return packet_->IsKeyFrame();
-  }
-  bool IsConfig() const override {
-    return false;
-  }
- private:
-   std::unique_ptr<ElementaryStreamPacket> packet_;
-};
+  explicit ScopedUnlock(pp::Lock* lock) : lock_(lock) { lock_->Release(); }
+  ~ScopedUnlock() { lock_->Acquire(); }
 
-template <typename ConfigT, StreamType stream_type>
-class BufferedConfig : public PacketsManager::BufferedStreamObject {
- public:
-  BufferedConfig(TimeTicks time,
-                 const ConfigT& config)
-      : BufferedStreamObject(stream_type, time),
-        config_(config) {}
-  ~BufferedConfig() override = default;
-  bool Append(StreamManager* stream_manager) override {
-    LOG_DEBUG("demux_id: %d dts: %f CONFIG", config_.demux_id, time());
-    return stream_manager->SetConfig(config_);
-  }
-  bool IsKeyFrame() const override {
-    return false;
-  }
-  bool IsConfig() const override {
-      return true;
-  }
  private:
-   ConfigT config_;
+  pp::Lock* lock_;
 };
 
-typedef BufferedConfig<AudioConfig, StreamType::Audio> BufferedAudioConfig;
-typedef BufferedConfig<VideoConfig, StreamType::Video> BufferedVideoConfig;
-
 } // anonymous namespace
 
+PacketsManager::BufferedStreamObject::BufferedStreamObject(
+    StreamType type, std::unique_ptr<ElementaryStreamPacket> packet)
+    : type_(type),
+      key_frame_(packet->IsKeyFrame()),
+      encrypted_(packet->IsEncrypted()),
+      data_size_(packet->GetDataSize()),
+      time_(packet->GetMediaDts()),
+      packet_(std::move(packet)) {}
+
+PacketsManager::BufferedStreamObject::BufferedStreamObject(
+    MediaTime time, const AudioConfig& config)
+    : type_(StreamType::Audio),
+      key_frame_(false),
+      encrypted_(false),
+      data_size_(0),
+      time_(time),
+      audio_config_(MakeUnique<AudioConfig>(config)) {}
+
+PacketsManager::BufferedStreamObject::BufferedStreamObject(
+    MediaTime time, const VideoConfig& config)
+    : type_(StreamType::Video),
+      key_frame_(false),
+      encrypted_(false),
+      data_size_(0),
+      time_(time),
+      video_config_(MakeUnique<VideoConfig>(config)) {}
+
 PacketsManager::BufferedStreamObject::~BufferedStreamObject() = default;
 
-PacketsManager::PacketsManager()
-    : seeking_(false),
-      eos_count_(0),
+bool PacketsManager::BufferedStreamObject::AppendConfig(
+    StreamSink* stream) const {
+  if (audio_config_) {
+    LOG_DEBUG("demux_id: %d dts: %f CONFIG", audio_config_->demux_id, time());
+    return stream->SetConfig(*audio_config_);
+  }
+  if (video_config_) {
+    LOG_DEBUG("demux_id: %d dts: %f CONFIG", video_config_->demux_id, time());
+    return stream->SetConfig(*video_config_);
+  }
+  return false;
+}
+
+PacketsManager::PacketsManager(const TuningProfile& tuning)
+    : tuning_(tuning),
+      seeking_(false),
+      packets_appended_(false),
+      seek_generation_(0),
+      in_buffer_seek_(false),
+      stream_seeking_{ {false, false} },
+      seek_dropped_packets_(false),
+      force_seek_end_(false),
       seek_segment_set_{ {false, false} },
       seek_segment_video_time_(0),
-      buffered_packets_timestamp_{ {0, 0} } {
+      seek_keyframe_time_(0),
+      memory_usage_(MemoryConsumer::kPackets),
+      needed_bytes_{ {0, 0} },
+      enough_data_{ {false, false} },
+      low_latency_(false),
+      playback_rate_(1.),
+      append_ahead_(tuning.append_ahead),
+      min_append_ahead_(tuning.min_append_ahead),
+      append_limit_{ {0., 0.} },
+      has_last_config_{ {false, false} },
+      has_held_video_config_(false),
+      shown_text_cue_end_(0.),
+      playback_metrics_(nullptr) {
+  for (auto& timestamp : buffered_packets_timestamp_) timestamp = 0;
+  for (auto& bytes : buffered_bytes_) bytes = 0;
+  for (auto& eos : eos_signalled_) eos = false;
+  for (auto& suspended : suspended_) suspended = false;
+  last_demuxed_dts_.fill(kNoDts);
+  overlap_end_dts_.fill(kNoDts);
+  for (auto& dts : appended_start_) dts = kNoDts;
+  for (auto& dts : appended_end_) dts = kNoDts;
+  memory_budget_[kAudioStreamId] = kDefaultAudioMemoryBudget;
+  memory_budget_[kVideoStreamId] = kDefaultVideoMemoryBudget;
 }
 
 PacketsManager::~PacketsManager() = default;
 
-void PacketsManager::PrepareForSeek(Samsung::NaClPlayer::TimeTicks to_time) {
+bool PacketsManager::CanSeekInBuffer(TimeTicks to_time) {
+  pp::AutoLock critical_section(packets_lock_);
+  DrainIncoming();
+  if (seeking_ || (!IsActive(kVideoStreamId) && !IsActive(kAudioStreamId)))
+    return false;
+
+  auto target = ToMediaTime(to_time);
+  auto margin = ToMediaTime(kSeekKeyframeMargin);
+  // Playback starts at a video keyframe close to the target, so audio must
+  // be queued from before it.
+  auto start = target;
+  if (IsActive(kVideoStreamId)) {
+    const auto& queue = packets_[kVideoStreamId];
+    auto keyframe = std::find_if(queue.begin(), queue.end(),
+        [target, margin](const BufferedStreamObject& stream_object) {
+          return !stream_object.IsConfig() && stream_object.IsKeyFrame() &&
+                 stream_object.media_time() + margin >= target;
+        });
+    if (keyframe == queue.end() ||
+        keyframe->media_time() > target + margin)
+      return false;
+    start = keyframe->media_time();
+  }
+  if (IsActive(kAudioStreamId)) {
+    const auto& queue = packets_[kAudioStreamId];
+    if (queue.empty() || queue.front().media_time() > start ||
+        queue.back().media_time() < start)
+      return false;
+  }
+  return true;
+}
+
+void PacketsManager::PrepareForSeek(TimeTicks to_time, bool in_buffer) {
+  if (PacketCapture::IsEnabled()) {
+    PacketCapture::RecordEvent(PacketCapture::RecordType::kSeek,
+                               StreamType::Video, to_time, in_buffer);
+  }
   pp::AutoLock critical_section(packets_lock_);
+  DrainIncoming();
+  ++seek_generation_;
+  in_buffer_seek_ = in_buffer;
 
-  // Append pending representation changes
-  BufferedStreamObjectPtr last_config;
-  while (!packets_.empty()) {
-    const auto& packet = packets_.top();
-    if (packet->IsConfig())
-      const_cast<decltype(last_config)&>(packets_.top()).swap(last_config);
-    packets_.pop();
-  }
-  if (last_config) {
-    auto stream_id = static_cast<int>(last_config->type());
-    if (streams_[stream_id]) {
-      last_config->Append(streams_[stream_id]);
+  // Append pending representation changes. Packets queued for a seek inside
+  // them are kept, CheckSeekEndConditions() drops ones before the target.
+  std::array<IncomingObjects, kStreamCount> last_configs;
+  for (int32_t stream_id = 0; stream_id < kStreamCount && !in_buffer;
+       ++stream_id) {
+    auto& queue = packets_[stream_id];
+    size_t dropped = 0;
+    size_t dropped_bytes = 0;
+    for (const auto& stream_object : queue) {
+      dropped_bytes += stream_object.GetDataSize();
+      if (!stream_object.IsConfig()) ++dropped;
     }
+    auto last_config = std::find_if(queue.rbegin(), queue.rend(),
+        [](const BufferedStreamObject& stream_object) {
+          return stream_object.IsConfig();
+        });
+    if (last_config != queue.rend())
+      last_configs[stream_id].push_back(std::move(*last_config));
+    AddDroppedPackets(dropped);
+    queue.clear();
+    buffered_bytes_[stream_id] -= dropped_bytes;
+    memory_usage_.Remove(dropped_bytes);
   }
 
   // Stream managers will not send packets while they are seeking streams.
   // If streamManager sends packet, it means stream is at a new position. This
   // manager seek ends when it receives a keyframe packet for each stream.
   seeking_ = true;
+  packets_appended_ = false;
+  // The player drops what was appended.
+  for (auto& dts : appended_start_) dts = kNoDts;
+  for (auto& dts : appended_end_) dts = kNoDts;
+  for (int32_t stream_id = 0; stream_id < kStreamCount; ++stream_id)
+    stream_seeking_[stream_id] = IsActive(stream_id);
+  seek_dropped_packets_ = false;
+  force_seek_end_ = false;
   seek_segment_set_[kAudioStreamId] = false;
   seek_segment_set_[kVideoStreamId] = false;
   seek_segment_video_time_ = 0;
-  eos_count_ = 0;
-  buffered_packets_timestamp_[kAudioStreamId] = 0;
-  buffered_packets_timestamp_[kVideoStreamId] = 0;
+  seek_keyframe_time_ = to_time;
+  // The player signals its needs anew after a seek.
+  needed_bytes_.fill(0);
+  enough_data_.fill(false);
+  if (!in_buffer) {
+    for (auto& eos : eos_signalled_) eos = false;
+    buffered_packets_timestamp_[kAudioStreamId] = 0;
+    buffered_packets_timestamp_[kVideoStreamId] = 0;
+  }
+  // Cues of the new position come from the text stream again.
+  text_cues_.clear();
+  shown_text_cue_end_ = 0.;
+
+  ScopedUnlock unlock(&packets_lock_);
+  for (int32_t stream_id = 0; stream_id < kStreamCount; ++stream_id) {
+    if (!last_configs[stream_id].empty() && streams_[stream_id])
+      last_configs[stream_id].back().AppendConfig(streams_[stream_id]);
+  }
+}
+
+void PacketsManager::Reset() {
+  pp::AutoLock critical_section(packets_lock_);
+  append_ahead_ = tuning_.append_ahead;
+  min_append_ahead_ = tuning_.min_append_ahead;
+  append_limit_.fill(0.);
+  DrainIncoming();
+  ++seek_generation_;
+  for (auto& queue : packets_)
+    queue.clear();
+  for (auto& bytes : buffered_bytes_) bytes = 0;
+  for (auto& timestamp : buffered_packets_timestamp_) timestamp = 0;
+  memory_usage_.Set(0);
+  seeking_ = false;
+  packets_appended_ = false;
+  for (auto& eos : eos_signalled_) eos = false;
+  for (auto& suspended : suspended_) suspended = false;
+  last_demuxed_dts_.fill(kNoDts);
+  overlap_end_dts_.fill(kNoDts);
+  for (auto& dts : appended_start_) dts = kNoDts;
+  for (auto& dts : appended_end_) dts = kNoDts;
+  stream_seeking_.fill(false);
+  seek_dropped_packets_ = false;
+  force_seek_end_ = false;
+  seek_segment_set_.fill(false);
+  seek_segment_video_time_ = 0;
+  seek_keyframe_time_ = 0;
+  needed_bytes_.fill(0);
+  enough_data_.fill(false);
+  has_last_config_.fill(false);
+  has_held_video_config_ = false;
+  text_cues_.clear();
+  shown_text_cue_end_ = 0.;
 }
 
 void PacketsManager::OnEsPacket(
     StreamDemuxer::Message message,
     std::unique_ptr<ElementaryStreamPacket> packet) {
+  ALLOCATION_SCOPE("packets");
+  CPU_SCOPE(CpuStage::kPackets);
   switch (message) {
-  case StreamDemuxer::kEndOfStream:
-    ++eos_count_;
-    break;
   case StreamDemuxer::kAudioPkt:
   case StreamDemuxer::kVideoPkt:
   {
     auto type = (message == StreamDemuxer::kAudioPkt ? StreamType::Audio :
                             StreamType::Video);
+    if (PacketCapture::IsEnabled()) PacketCapture::RecordPacket(type, *packet);
     auto stream_index = static_cast<int32_t>(type);
     if (!streams_[stream_index]) {
       LOG_ERROR("Received a packet for a non-existing stream (%s).",
@@ -146,57 +296,312 @@ void PacketsManager::OnEsPacket(
       break;
     }
     if (streams_[stream_index]->IsSeeking()) {
-      LOG_DEBUG("Stream %s is seeking dropping packet with pts: %f",
-                type == StreamType::Video ? "VIDEO" : "AUDIO",
-                packet->GetPts());
+      LOG_EVERY_N(Debug, 100,
+                  "Stream %s is seeking dropping packet with pts: %f",
+                  type == StreamType::Video ? "VIDEO" : "AUDIO",
+                  packet->GetPts());
+      AddDroppedPackets(1);
       break;
     }
 
-    LOG_DEBUG("Stream %s demux_id: %d got packet pts: %f dts: %f",
-             type == StreamType::Video ? "VIDEO" : "AUDIO",
-             packet->demux_id, packet->GetPts(), packet->GetDts());
+    LOG_EVERY_N(Debug, 100,
+                "Stream %s demux_id: %d got packet pts: %f dts: %f",
+                type == StreamType::Video ? "VIDEO" : "AUDIO",
+                packet->demux_id, packet->GetPts(), packet->GetDts());
+
+    StreamDemuxer::PacketBatch packets;
+    packets.push_back(std::move(packet));
+    DropOverlappingPackets(stream_index, &packets);
+    IncomingObjects objects;
+    HoldUntilKeyframe(stream_index, &packets, &objects);
+    if (packets.empty()) break;
 
-    pp::AutoLock critical_section(packets_lock_);
-    buffered_packets_timestamp_[stream_index] = packet->GetDts();
-    packets_.emplace(MakeUnique<BufferedPacket>(type, std::move(packet)));
+    AllocationTracker::CountPackets("demux", 1);
+    auto dts = packets.front()->GetMediaDts();
+    objects.emplace_back(type, std::move(packets.front()));
+    PushIncoming(stream_index, std::move(objects), dts);
     break;
   };
   default:
     LOG_ERROR("Received an unsupported message type!");
   }
+  RequestBufferUpdate();
+}
+
+void PacketsManager::OnEsPackets(StreamDemuxer::Message message,
+                                 StreamDemuxer::PacketBatch packets) {
+  if (packets.empty()) return;
+  ALLOCATION_SCOPE("packets");
+  CPU_SCOPE(CpuStage::kPackets);
+  if (message != StreamDemuxer::kAudioPkt &&
+      message != StreamDemuxer::kVideoPkt) {
+    LOG_ERROR("Received an unsupported message type!");
+    return;
+  }
+
+  auto type = (message == StreamDemuxer::kAudioPkt ? StreamType::Audio :
+                          StreamType::Video);
+  if (PacketCapture::IsEnabled()) PacketCapture::RecordPackets(type, packets);
+  auto stream_index = static_cast<int32_t>(type);
+  if (!streams_[stream_index]) {
+    LOG_ERROR("Received packets for a non-existing stream (%s).",
+              type == StreamType::Video ? "VIDEO" : "AUDIO");
+    return;
+  }
+  if (streams_[stream_index]->IsSeeking()) {
+    LOG_DEBUG("Stream %s is seeking dropping %zu packets",
+              type == StreamType::Video ? "VIDEO" : "AUDIO", packets.size());
+    AddDroppedPackets(packets.size());
+    return;
+  }
+
+  LOG_EVERY_MS(Debug, 1000,
+               "Stream %s demux_id: %d got %zu packets, last dts: %f",
+               type == StreamType::Video ? "VIDEO" : "AUDIO",
+               packets.back()->demux_id, packets.size(),
+               packets.back()->GetDts());
+
+  DropOverlappingPackets(stream_index, &packets);
+  IncomingObjects objects;
+  HoldUntilKeyframe(stream_index, &packets, &objects);
+  if (packets.empty()) return;
+
+  AllocationTracker::CountPackets("demux", packets.size());
+  auto last_dts = packets.back()->GetMediaDts();
+  objects.reserve(objects.size() + packets.size());
+  for (auto& packet : packets)
+    objects.emplace_back(type, std::move(packet));
+  PushIncoming(stream_index, std::move(objects), last_dts);
+  RequestBufferUpdate();
+}
+
+void PacketsManager::PushIncoming(int32_t stream_id, IncomingObjects objects,
+                                  MediaTime last_dts) {
+  size_t bytes = 0;
+  for (const auto& stream_object : objects)
+    bytes += stream_object.GetDataSize();
+  // Bytes are counted before the hand-over, so the append side never
+  // removes more than was added. The timestamp is published after it, so
+  // packets up to it are there when the append side reads it.
+  buffered_bytes_[stream_id] += bytes;
+  memory_usage_.Add(bytes);
+  incoming_[stream_id].Push(std::move(objects));
+  buffered_packets_timestamp_[stream_id] = last_dts;
+}
+
+void PacketsManager::DropOverlappingPackets(
+    int32_t stream_id, StreamDemuxer::PacketBatch* packets) {
+  auto& last_dts = last_demuxed_dts_[stream_id];
+  auto& overlap_end = overlap_end_dts_[stream_id];
+  auto type_name = stream_id == kVideoStreamId ? "VIDEO" : "AUDIO";
+  size_t kept = 0;
+  size_t dropped = 0;
+  for (size_t i = 0; i < packets->size(); ++i) {
+    auto& packet = (*packets)[i];
+    MediaTime dts = packet->GetMediaDts();
+    // Demuxed timestamps go back only when a new representation starts
+    // inside the range buffered from the previous one.
+    if (overlap_end == kNoDts && last_dts != kNoDts && dts <= last_dts) {
+      if (stream_id == kVideoStreamId && packet->IsKeyFrame() &&
+          ReplaceQueuedPackets(stream_id, dts)) {
+        LOG_INFO("Replaced %s packets buffered from %f [s]", type_name,
+                 ToTimeTicks(dts));
+      } else {
+        LOG_INFO("Dropping %s packets repeating %f ... %f [s]", type_name,
+                 ToTimeTicks(dts), ToTimeTicks(last_dts));
+        overlap_end = last_dts;
+      }
+    }
+    // Video can resume only at a keyframe.
+    if (overlap_end != kNoDts) {
+      if (dts <= overlap_end ||
+          (stream_id == kVideoStreamId && !packet->IsKeyFrame())) {
+        ++dropped;
+        continue;
+      }
+      overlap_end = kNoDts;
+    }
+    last_dts = dts;
+    if (i != kept) (*packets)[kept] = std::move(packet);
+    ++kept;
+  }
+  packets->resize(kept);
+  if (dropped > 0) AddDroppedPackets(dropped);
+}
+
+void PacketsManager::HoldUntilKeyframe(int32_t stream_id,
+    StreamDemuxer::PacketBatch* packets, IncomingObjects* objects) {
+  if (stream_id != kVideoStreamId || !has_held_video_config_) return;
+
+  auto keyframe = std::find_if(packets->begin(), packets->end(),
+      [](const std::unique_ptr<ElementaryStreamPacket>& packet) {
+        return packet->IsKeyFrame();
+      });
+  auto dropped = keyframe - packets->begin();
+  if (dropped > 0) {
+    LOG_INFO("Dropping %zu VIDEO packets before a keyframe of the new "
+             "configuration", static_cast<size_t>(dropped));
+    AddDroppedPackets(dropped);
+  }
+  if (keyframe != packets->end()) {
+    // The decoder is reconfigured right before the keyframe it starts with.
+    objects->emplace_back((*keyframe)->GetMediaDts(), held_video_config_);
+    has_held_video_config_ = false;
+  }
+  packets->erase(packets->begin(), keyframe);
+}
+
+bool PacketsManager::ReplaceQueuedPackets(int32_t stream_id, MediaTime time) {
+  pp::AutoLock critical_section(packets_lock_);
+  DrainIncoming();
+  auto& queue = packets_[stream_id];
+  auto it = std::find_if(queue.begin(), queue.end(),
+      [time](const BufferedStreamObject& stream_object) {
+        return stream_object.media_time() >= time;
+      });
+  // Packets before the front ones might have been appended already.
+  if (it == queue.end() || it == queue.begin()) return false;
+  if (std::any_of(it, queue.end(),
+                  [](const BufferedStreamObject& stream_object) {
+                    return stream_object.IsConfig();
+                  }))
+    return false;
+
+  size_t dropped_bytes = 0;
+  for (auto drop = it; drop != queue.end(); ++drop)
+    dropped_bytes += drop->GetDataSize();
+  buffered_bytes_[stream_id] -= dropped_bytes;
+  memory_usage_.Remove(dropped_bytes);
+  AddDroppedPackets(queue.end() - it);
+  queue.erase(it, queue.end());
+  buffered_packets_timestamp_[stream_id] = queue.back().media_time();
+  return true;
+}
+
+void PacketsManager::DrainIncoming() {
+  IncomingObjects objects;
+  for (int32_t stream_id = 0; stream_id < kStreamCount; ++stream_id) {
+    auto& queue = packets_[stream_id];
+    while (incoming_[stream_id].Pop(&objects)) {
+      for (auto& stream_object : objects)
+        queue.push_back(std::move(stream_object));
+    }
+  }
 }
 
 void PacketsManager::OnStreamConfig(const AudioConfig& config) {
+    if (PacketCapture::IsEnabled()) PacketCapture::RecordConfig(config);
     HandleStreamConfig(StreamType::Audio, config);
 }
 
-std::unique_ptr<PacketsManager::BufferedStreamObject>
-PacketsManager::CreateBufferedConfig(const AudioConfig& config) {
-  return MakeUnique<BufferedAudioConfig>(
-      buffered_packets_timestamp_[kAudioStreamId] + kEps, config);
+void PacketsManager::QueueConfig(const AudioConfig& config) {
+  IncomingObjects objects;
+  objects.emplace_back(buffered_packets_timestamp_[kAudioStreamId] + 1,
+                       config);
+  PushIncoming(kAudioStreamId, std::move(objects),
+               buffered_packets_timestamp_[kAudioStreamId]);
 }
 
 void PacketsManager::OnStreamConfig(const VideoConfig& config) {
+    if (PacketCapture::IsEnabled()) PacketCapture::RecordConfig(config);
     HandleStreamConfig(StreamType::Video, config);
 }
 
-std::unique_ptr<PacketsManager::BufferedStreamObject>
-PacketsManager::CreateBufferedConfig(const VideoConfig& config) {
-  return MakeUnique<BufferedVideoConfig>(
-      buffered_packets_timestamp_[kVideoStreamId] + kEps, config);
+void PacketsManager::QueueConfig(const VideoConfig& config) {
+  // A later configuration supersedes a held one, no packets are between.
+  held_video_config_ = config;
+  has_held_video_config_ = true;
+}
+
+ConfigChange PacketsManager::UpdateLastConfig(const AudioConfig& config) {
+  auto change = has_last_config_[kAudioStreamId]
+      ? ClassifyConfigChange(last_audio_config_, config)
+      : ConfigChange::kCodec;
+  last_audio_config_ = config;
+  has_last_config_[kAudioStreamId] = true;
+  return change;
+}
+
+ConfigChange PacketsManager::UpdateLastConfig(const VideoConfig& config) {
+  auto change = has_last_config_[kVideoStreamId]
+      ? ClassifyConfigChange(last_video_config_, config)
+      : ConfigChange::kCodec;
+  last_video_config_ = config;
+  has_last_config_[kVideoStreamId] = true;
+  return change;
 }
 
 void PacketsManager::OnNeedData(StreamType type, int32_t bytes_max) {
+  assert(type < StreamType::MaxStreamTypes);
+  if (PacketCapture::IsEnabled()) {
+    PacketCapture::RecordEvent(PacketCapture::RecordType::kNeedData, type,
+                               bytes_max);
+  }
+  {
+    pp::AutoLock critical_section(packets_lock_);
+    auto stream_id = static_cast<int32_t>(type);
+    needed_bytes_[stream_id] = std::max<int64_t>(bytes_max, 0);
+    enough_data_[stream_id] = false;
+  }
+  RequestBufferUpdate();
 }
 
 void PacketsManager::OnEnoughData(StreamType type) {
+  assert(type < StreamType::MaxStreamTypes);
+  if (PacketCapture::IsEnabled()) {
+    PacketCapture::RecordEvent(PacketCapture::RecordType::kEnoughData, type,
+                               0.);
+  }
+  {
+    pp::AutoLock critical_section(packets_lock_);
+    auto stream_id = static_cast<int32_t>(type);
+    needed_bytes_[stream_id] = 0;
+    enough_data_[stream_id] = true;
+  }
+  RequestBufferUpdate();
+}
+
+void PacketsManager::OnSegmentReceived(StreamType type) {
+  RequestBufferUpdate();
+}
+
+void PacketsManager::SetBufferUpdateCallback(
+    const std::function<void()>& callback) {
+  buffer_update_callback_ = callback;
+}
+
+void PacketsManager::SetDecryptableCallback(
+    const std::function<bool(const ElementaryStreamPacket&)>& callback) {
+  pp::AutoLock critical_section(packets_lock_);
+  decryptable_callback_ = callback;
+}
+
+void PacketsManager::RequestBufferUpdate() {
+  if (buffer_update_callback_) buffer_update_callback_();
 }
 
 void PacketsManager::OnSeekData(StreamType type,
                                 TimeTicks new_time) {
-  if (streams_[kAudioStreamId] && type == StreamType::Audio) {
+  if (PacketCapture::IsEnabled()) {
+    PacketCapture::RecordEvent(PacketCapture::RecordType::kSeekData, type,
+                               new_time);
+  }
+  // Packets of the new position don't continue the ones demuxed before,
+  // unless they are appended from the queue.
+  if (!in_buffer_seek_) {
+    last_demuxed_dts_[static_cast<int32_t>(type)] = kNoDts;
+    overlap_end_dts_[static_cast<int32_t>(type)] = kNoDts;
+  }
+  if (suspended_[static_cast<int32_t>(type)]) return;
+  if (in_buffer_seek_) {
+    // Streams continue downloading after the queued packets.
+    LOG_DEBUG("Seek to %f [s] served from buffered %s packets", new_time,
+              type == StreamType::Video ? "VIDEO" : "AUDIO");
+    return;
+  }
+  if (IsActive(kAudioStreamId) && type == StreamType::Audio) {
     seek_segment_set_[kAudioStreamId] = true;
-  } else if (streams_[kVideoStreamId] && type == StreamType::Video) {
+  } else if (IsActive(kVideoStreamId) && type == StreamType::Video) {
     // If video track is present, we want to align seek to video keyframe
     // (which is at the beginning start of a segment).
     seek_segment_set_[kVideoStreamId] = true;
@@ -216,12 +621,12 @@ void PacketsManager::OnSeekData(StreamType type,
   // If there is no video track, then just continue with seeking audio.
   // Otherwise allow seeking audio only after seeking video (i.e. when video
   // seek time is determined).
-  auto video_segment_set = !streams_[kVideoStreamId] ||
+  auto video_segment_set = !IsActive(kVideoStreamId) ||
                            seek_segment_set_[kVideoStreamId];
   auto audio_segment_set = seek_segment_set_[kAudioStreamId];
-  if (streams_[kAudioStreamId] && audio_segment_set && video_segment_set) {
+  if (IsActive(kAudioStreamId) && audio_segment_set && video_segment_set) {
     // Align audio seek time to video seek time if video track is present.
-    auto seek_audio_to_time = streams_[kVideoStreamId] ?
+    auto seek_audio_to_time = IsActive(kVideoStreamId) ?
                                seek_segment_video_time_ : new_time;
     TimeTicks audio_segment_start;
     TimeTicks audio_segment_duration;
@@ -233,110 +638,537 @@ void PacketsManager::OnSeekData(StreamType type,
   }
 }
 
-void PacketsManager::CheckSeekEndConditions(
-    Samsung::NaClPlayer::TimeTicks buffered_time) {
-  // Seeks ends when:
-  // - a video keyframe is received (if video stream is present)
-  // - an audio keyframe is received (otherwise)
-  // All packets before the one that ends seek must be dropped. It's worth
-  // noting that all audio frames are keyframes.
+void PacketsManager::CheckSeekEndConditions() {
+  // The seek of each stream ends at its own starting packet:
+  // - a video keyframe at the seek target (within a margin),
+  // - an audio packet which plays at the seek target.
+  // Packets before it are dropped. Audio doesn't wait for the video
+  // keyframe, so the sound starts as soon as its packets are there and the
+  // player synchronizes video when its keyframe comes.
   assert(seeking_);
-  BufferedStreamObjectPtr last_config;
-  while (!packets_.empty()) {
-    const auto& packet = packets_.top();
-    auto packet_playback_position = packet->time();
-    if (buffered_time < packet_playback_position)
-      break;
-    if (((streams_[kVideoStreamId] && packet->type() == StreamType::Video) ||
-         (!streams_[kVideoStreamId] && streams_[kAudioStreamId] &&
-         packet->type() == StreamType::Audio)) && packet->IsKeyFrame()) {
-      seeking_ = false;
-      LOG_DEBUG("Seek finishing at %f [s] %s packet... buffered packets: %u",
-          packet->time(),
-          packet->type() == StreamType::Video ? "VIDEO" : "AUDIO",
-          packets_.size());
-      break;
-    } else {
-      if (packet->IsConfig())
-        const_cast<decltype(last_config)&>(packets_.top()).swap(last_config);
-      packets_.pop();
+  for (int32_t stream_id = 0; stream_id < kStreamCount; ++stream_id) {
+    // A stream suspended during the seek doesn't hold the other one.
+    if (!IsActive(stream_id)) stream_seeking_[stream_id] = false;
+    if (!stream_seeking_[stream_id]) continue;
+    auto& queue = packets_[stream_id];
+    // The last config dropped, kept for the packets of the seek.
+    IncomingObjects last_config;
+    while (!queue.empty()) {
+      const auto& stream_object = queue.front();
+      const ElementaryStreamPacket* packet = stream_object.GetPacket();
+      bool is_seek_start = false;
+      if (force_seek_end_) {
+        is_seek_start = packet != nullptr;
+      } else if (stream_id == kVideoStreamId) {
+        // Seek target is a keyframe time, which can be inside a segment.
+        // Video keyframes before it are dropped, within a margin for
+        // targets set after a keyframe and for decode times preceding
+        // presentation times.
+        is_seek_start = stream_object.IsKeyFrame() &&
+            stream_object.time() + kSeekKeyframeMargin >=
+                seek_keyframe_time_;
+      } else if (packet) {
+        is_seek_start = stream_object.time() + packet->GetDuration() >
+            seek_keyframe_time_;
+      }
+      if (is_seek_start) {
+        stream_seeking_[stream_id] = false;
+        LOG_DEBUG("Seek of %s finishing at %f [s], buffered packets: %zu",
+                  stream_id == kVideoStreamId ? "VIDEO" : "AUDIO",
+                  stream_object.time(), queue.size());
+        break;
+      }
+      auto dropped = PopFront(stream_id);
+      if (dropped.IsConfig()) {
+        last_config.clear();
+        last_config.push_back(std::move(dropped));
+      } else {
+        seek_dropped_packets_ = true;
+        AddDroppedPackets(1);
+      }
     }
+    if (!last_config.empty())
+      queue.push_front(std::move(last_config.back()));
   }
-  if (last_config)
-    packets_.push(std::move(last_config));
+  seeking_ = std::any_of(stream_seeking_.begin(), stream_seeking_.end(),
+                         [](bool seeking) { return seeking; });
 }
 
 void PacketsManager::AppendPackets(TimeTicks playback_time,
-                                   TimeTicks buffered_time) {
-  assert(!seeking_);
-  if (packets_.empty())
-    return;
-  // Append packets to respective streams:
-  auto packet_playback_position = packets_.top()->time();
-  while (packet_playback_position - playback_time < kAppendPacketsThreshold &&
-         packet_playback_position < buffered_time) {
-    auto stream_id = static_cast<int>(packets_.top()->type());
-    if (streams_[stream_id]) {
-      std::unique_ptr<BufferedStreamObject> stream_object;
-      // Moving object out of priority queue breaks it ordering, hence
-      // const_cast immediately followed by a pop to simulate atomic
-      // "pop top element from queue to local variable".
-      const_cast<decltype(stream_object)&>(packets_.top()).swap(stream_object);
-      packets_.pop();
-      // True means that we should break the loop and try again eg. audio/video
-      // config has change and we need some time to finish initialization
-      if (stream_object->Append(streams_[stream_id]))
-        break;
-    } else {
+                                   MediaTime buffered_time) {
+  TRACE_SCOPE("append packets");
+  ALLOCATION_SCOPE("packets");
+  CPU_SCOPE(CpuStage::kPackets);
+  // Append packets to respective streams. Consecutive packets of a stream
+  // are appended in batches. Streams which are still seeking get nothing.
+  std::vector<BufferedStreamObject> batch;
+  int32_t batch_stream_id = -1;
+  int32_t stream_id;
+  uint32_t full_streams = 0;
+  for (stream_id = 0; stream_id < kStreamCount; ++stream_id) {
+    if (stream_seeking_[stream_id]) full_streams |= 1u << stream_id;
+  }
+  // All packets up to append_ahead_ past the playback position are
+  // appended. After the end of stream nothing more is demuxed, so the
+  // remaining packets are appended as far as the player takes them.
+  auto append_threshold = low_latency_ || IsEosSignalled()
+      ? std::numeric_limits<TimeTicks>::max()
+      : append_ahead_ * playback_rate_;
+  // Packets that close to the playback position are appended even after the
+  // player reported it has enough data, so a missed OnNeedData() can't stall
+  // playback.
+  auto min_append_ahead = min_append_ahead_ * playback_rate_;
+  while ((stream_id = NextStreamIndex(full_streams)) >= 0) {
+    auto& queue = packets_[stream_id];
+    if (queue.front().media_time() >= buffered_time)
+      break;
+    auto packet_playback_position = queue.front().time();
+    // Other streams can still get packets when this one has enough.
+    auto time_ahead = packet_playback_position - playback_time;
+    auto append_limit = append_limit_[stream_id] * playback_rate_;
+    if ((enough_data_[stream_id] ? time_ahead >= min_append_ahead
+                                 : needed_bytes_[stream_id] <= 0 &&
+                                       time_ahead >= append_threshold) ||
+        (append_limit > 0. && time_ahead >= append_limit)) {
+      full_streams |= 1u << stream_id;
+      continue;
+    }
+    // Packets of a key which license is missing wait for it, clear ones
+    // (e.g. a clear lead) and ones of other keys are still appended.
+    const ElementaryStreamPacket* packet = queue.front().GetPacket();
+    if (decryptable_callback_ && queue.front().IsEncrypted() &&
+        !decryptable_callback_(*packet)) {
+      full_streams |= 1u << stream_id;
+      continue;
+    }
+    if (!streams_[stream_id]) {
       LOG_ERROR("Invalid stream index: %d", stream_id);
+      PopFront(stream_id);
+      continue;
     }
-    if (packets_.empty())
-      break;
+    if (stream_id != batch_stream_id || !packet) {
+      if (!AppendBatch(batch_stream_id, &batch)) return;
+      batch_stream_id = stream_id;
+    }
+    auto stream_object = PopFront(stream_id);
+    needed_bytes_[stream_id] = std::max<int64_t>(needed_bytes_[stream_id] -
+        static_cast<int64_t>(stream_object.GetDataSize()), 0);
+    if (packet) {
+      batch.push_back(std::move(stream_object));
+      continue;
+    }
+    auto generation = seek_generation_;
+    bool retry;
+    {
+      ScopedUnlock unlock(&packets_lock_);
+      retry = stream_object.AppendConfig(streams_[stream_id]);
+    }
+    // True means that we should break the loop and try again eg. audio/video
+    // config has change and we need some time to finish initialization
+    if (retry || generation != seek_generation_)
+      return;
+  }
+  AppendBatch(batch_stream_id, &batch);
+}
+
+bool PacketsManager::AppendBatch(int32_t stream_id,
+                                 std::vector<BufferedStreamObject>* batch) {
+  if (batch->empty()) return true;
+  TRACE_SCOPE("append batch");
+  Tracer::Counter("append batch size", batch->size());
+
+  std::vector<const ElementaryStreamPacket*> packets;
+  packets.reserve(batch->size());
+  for (const auto& stream_object : *batch)
+    packets.push_back(stream_object.GetPacket());
+  StreamSink::AppendResult result;
+  size_t appended;
+  auto generation = seek_generation_;
+  {
+    ScopedUnlock unlock(&packets_lock_);
+    appended = streams_[stream_id]->AppendPackets(packets, &result);
+  }
+  if (appended > 0) packets_appended_ = true;
+  AllocationTracker::CountPackets("packets", appended);
+
+  if (generation != seek_generation_) {
+    // A seek was prepared meanwhile, remaining packets are not needed.
+    AddDroppedPackets(batch->size() - appended);
+    batch->clear();
+    return false;
+  }
+  if (appended > 0) {
+    if (appended_start_[stream_id] == kNoDts)
+      appended_start_[stream_id] = (*batch)[0].media_time();
+    appended_end_[stream_id] = (*batch)[appended - 1].media_time();
+  }
+
+  size_t requeued = appended;
+  if (result == StreamSink::AppendResult::kTryAgain) {
+    // The player is full. Like after OnEnoughData(), the stream gets only
+    // packets needed very soon until the next OnNeedData().
+    needed_bytes_[stream_id] = 0;
+    enough_data_[stream_id] = true;
+  } else if (result == StreamSink::AppendResult::kFailed) {
+    // Appending a rejected packet again would block the stream.
+    ++requeued;
+  }
+
+  // Packets which weren't appended go back to the front of the queue, so
+  // the stream resumes from them instead of losing them.
+  auto& queue = packets_[stream_id];
+  for (size_t i = batch->size(); i > requeued; --i) {
+    size_t size = (*batch)[i - 1].GetDataSize();
+    buffered_bytes_[stream_id] += size;
+    memory_usage_.Add(size);
+    needed_bytes_[stream_id] += size;
+    queue.push_front(std::move((*batch)[i - 1]));
   }
+  bool all_appended = appended == batch->size();
+  batch->clear();
+  return all_appended;
+}
+
+PacketsManager::BufferedStreamObject PacketsManager::PopFront(
+    int32_t stream_id) {
+  auto& queue = packets_[stream_id];
+  auto stream_object = std::move(queue.front());
+  queue.pop_front();
+  buffered_bytes_[stream_id] -= stream_object.GetDataSize();
+  memory_usage_.Remove(stream_object.GetDataSize());
+  return stream_object;
+}
+
+int32_t PacketsManager::NextStreamIndex(uint32_t skipped_streams) const {
+  int32_t next = -1;
+  for (int32_t stream_id = 0; stream_id < kStreamCount; ++stream_id) {
+    if (packets_[stream_id].empty() || skipped_streams & (1u << stream_id))
+      continue;
+    if (next < 0 || packets_[stream_id].front() < packets_[next].front())
+      next = stream_id;
+  }
+  return next;
+}
+
+bool PacketsManager::HasBufferedObjects() const {
+  for (const auto& queue : packets_) {
+    if (!queue.empty()) return true;
+  }
+  return false;
+}
+
+void PacketsManager::OnEndOfStream(StreamType type) {
+  if (PacketCapture::IsEnabled()) {
+    PacketCapture::RecordEvent(PacketCapture::RecordType::kEndOfStream, type,
+                               0.);
+  }
+  eos_signalled_[static_cast<int32_t>(type)] = true;
+  // The end of stream is set as soon as the remaining packets are appended,
+  // without waiting for the next buffer update.
+  RequestBufferUpdate();
 }
 
 bool PacketsManager::IsEosSignalled() const {
-  int stream_count = 0;
-  for (auto stream : streams_) {
-    if (stream)
-      ++stream_count;
+  for (int32_t stream_id = 0; stream_id < kStreamCount; ++stream_id) {
+    if (IsActive(stream_id) && !eos_signalled_[stream_id]) return false;
   }
-  return eos_count_ == stream_count;
+  return true;
 }
 
-bool PacketsManager::IsEosReached() const {
-  return packets_.empty() && IsEosSignalled();
+bool PacketsManager::IsActive(int32_t stream_id) const {
+  return streams_[stream_id] && !suspended_[stream_id];
 }
 
-bool PacketsManager::UpdateBuffer(
-    Samsung::NaClPlayer::TimeTicks playback_time) {
+void PacketsManager::SetStreamSuspended(StreamType type, bool suspended) {
+  auto stream_id = static_cast<int32_t>(type);
+  pp::AutoLock critical_section(packets_lock_);
+  DrainIncoming();
+  suspended_[stream_id] = suspended;
+  if (!suspended) return;
+
+  auto& queue = packets_[stream_id];
+  size_t dropped = 0;
+  size_t dropped_bytes = 0;
+  for (const auto& stream_object : queue) {
+    dropped_bytes += stream_object.GetDataSize();
+    if (!stream_object.IsConfig()) ++dropped;
+  }
+  AddDroppedPackets(dropped);
+  queue.clear();
+  buffered_bytes_[stream_id] -= dropped_bytes;
+  memory_usage_.Remove(dropped_bytes);
+  LOG_INFO("Stream %s suspended, dropped %zu packets",
+           type == StreamType::Video ? "VIDEO" : "AUDIO", dropped);
+}
+
+bool PacketsManager::IsEosReached() {
+  // Demuxers signal EOS after their last packets are pushed, so all of them
+  // are drained when it's seen.
+  bool eos_signalled = IsEosSignalled();
+  pp::AutoLock critical_section(packets_lock_);
+  DrainIncoming();
+  return !HasBufferedObjects() && eos_signalled;
+}
+
+bool PacketsManager::PacketsAppended() const {
+  return packets_appended_;
+}
+
+bool PacketsManager::IsSeekDroppingPackets() {
   pp::AutoLock critical_section(packets_lock_);
+  return seeking_ && seek_dropped_packets_;
+}
 
+void PacketsManager::ForceSeekEnd() {
+  pp::AutoLock critical_section(packets_lock_);
+  if (!seeking_) return;
+  LOG_INFO("Forcing the seek to %f [s] to end", seek_keyframe_time_);
+  force_seek_end_ = true;
+}
+
+bool PacketsManager::UpdateBuffer(
+    Samsung::NaClPlayer::TimeTicks playback_time) {
+  if (PacketCapture::IsEnabled()) {
+    PacketCapture::RecordEvent(PacketCapture::RecordType::kUpdateBuffer,
+                               StreamType::Video, playback_time);
+  }
   // Determine max time we have packets for:
-  auto buffered_time = std::numeric_limits<TimeTicks>::max();
+  auto buffered_time = std::numeric_limits<MediaTime>::max();
 
   // Upon EOS all packets needs to be flushed, so checking max time should be
-  // skipped.
+  // skipped. Timestamps are read before packets are drained, so all packets
+  // up to them are there.
   if (!IsEosSignalled()) {
-    if (streams_[kVideoStreamId] && buffered_time >
-        buffered_packets_timestamp_[kVideoStreamId])
-      buffered_time = buffered_packets_timestamp_[kVideoStreamId];
-
-    if (streams_[kAudioStreamId] && buffered_time >
-        buffered_packets_timestamp_[kAudioStreamId])
-      buffered_time = buffered_packets_timestamp_[kAudioStreamId];
+    for (int32_t stream_id : {kVideoStreamId, kAudioStreamId}) {
+      MediaTime timestamp = buffered_packets_timestamp_[stream_id];
+      if (IsActive(stream_id) && buffered_time > timestamp)
+        buffered_time = timestamp;
+    }
   }
 
-  if (seeking_)
-    CheckSeekEndConditions(buffered_time);
+  std::vector<TextCue> due_cues;
+  bool has_buffered_objects;
+  {
+    pp::AutoLock critical_section(packets_lock_);
+    DrainIncoming();
+
+    if (seeking_)
+      CheckSeekEndConditions();
 
-  if (!seeking_)
     AppendPackets(playback_time, buffered_time);
+    if (!seeking_) TakeDueTextCues(playback_time, &due_cues);
+
+    has_buffered_objects = HasBufferedObjects();
+  }
+  // Called without the lock, as the callback sends messages.
+  if (text_cue_callback_) {
+    for (const auto& cue : due_cues)
+      text_cue_callback_(cue);
+  }
+  return has_buffered_objects;
+}
+
+void PacketsManager::SetTextCueCallback(
+    const std::function<void(const TextCue&)>& callback) {
+  text_cue_callback_ = callback;
+}
+
+void PacketsManager::SetPlaybackMetrics(PlaybackMetrics* metrics) {
+  playback_metrics_ = metrics;
+}
+
+void PacketsManager::AddDroppedPackets(size_t count) {
+  if (playback_metrics_) playback_metrics_->AddDroppedPackets(count);
+}
+
+void PacketsManager::OnTextCues(std::vector<TextCue> cues) {
+  pp::AutoLock critical_section(packets_lock_);
+  for (auto& cue : cues) {
+    auto it = std::upper_bound(text_cues_.begin(), text_cues_.end(), cue,
+        [](const TextCue& cue, const TextCue& queued) {
+          return cue.start < queued.start;
+        });
+    // Cues spanning several segments are repeated in each of them.
+    bool duplicate = false;
+    for (auto same = it; same != text_cues_.begin();) {
+      --same;
+      if (same->start != cue.start) break;
+      if (same->end == cue.end && same->text == cue.text) duplicate = true;
+    }
+    if (!duplicate) text_cues_.insert(it, std::move(cue));
+  }
+}
+
+void PacketsManager::ClearTextCues() {
+  pp::AutoLock critical_section(packets_lock_);
+  text_cues_.clear();
+  shown_text_cue_end_ = 0.;
+}
+
+void PacketsManager::TakeDueTextCues(TimeTicks playback_time,
+                                     std::vector<TextCue>* due_cues) {
+  while (!text_cues_.empty() && text_cues_.front().start <= playback_time) {
+    TextCue cue = std::move(text_cues_.front());
+    text_cues_.pop_front();
+    // Cues which ended meanwhile are skipped, as well as repetitions of a
+    // shown cue that come with the next segment.
+    if (cue.end <= playback_time) continue;
+    if (cue.end == shown_text_cue_end_ && cue.text == shown_text_cue_text_)
+      continue;
+    shown_text_cue_end_ = cue.end;
+    shown_text_cue_text_ = cue.text;
+    cue.start = playback_time;
+    due_cues->push_back(std::move(cue));
+  }
+}
+
+void PacketsManager::SetStream(StreamType type, StreamSink* stream) {
+  assert(type < StreamType::MaxStreamTypes);
+  streams_[static_cast<int32_t>(type)] = stream;
+  has_last_config_[static_cast<int32_t>(type)] = false;
+}
+
+void PacketsManager::SetMemoryBudget(StreamType type, size_t max_bytes) {
+  assert(type < StreamType::MaxStreamTypes);
+  memory_budget_[static_cast<int32_t>(type)] = max_bytes;
+}
+
+void PacketsManager::SetLowLatency(bool enabled) {
+  low_latency_ = enabled;
+}
+
+void PacketsManager::SetPlaybackRate(double rate) {
+  playback_rate_ = rate;
+}
+
+void PacketsManager::SetAppendLimit(StreamType type, TimeTicks limit) {
+  assert(type < StreamType::MaxStreamTypes);
+  pp::AutoLock critical_section(packets_lock_);
+  append_limit_[static_cast<int32_t>(type)] =
+      limit > 0. ? std::max(limit, min_append_ahead_) : 0.;
+}
 
-  return !packets_.empty();
+size_t PacketsManager::GetBufferedBytes(StreamType type) {
+  assert(type < StreamType::MaxStreamTypes);
+  return buffered_bytes_[static_cast<int32_t>(type)];
+}
+
+TimeTicks PacketsManager::GetBufferedTime(StreamType type) {
+  assert(type < StreamType::MaxStreamTypes);
+  return ToTimeTicks(buffered_packets_timestamp_[static_cast<int32_t>(type)]);
+}
+
+bool PacketsManager::CanBuffer(StreamType type, size_t bytes) {
+  assert(type < StreamType::MaxStreamTypes);
+  auto stream_index = static_cast<int32_t>(type);
+  size_t buffered_bytes = buffered_bytes_[stream_index];
+  // Always allow buffering something, even if a single segment is bigger than
+  // the budget.
+  if (buffered_bytes == 0) return true;
+  // Under memory pressure less is buffered ahead.
+  return buffered_bytes + bytes <=
+      MemoryGovernor::ScaleLimit(memory_budget_[stream_index]);
+}
+
+bool PacketsManager::GetPendingPacketsTime(StreamType type, TimeTicks* first,
+                                           TimeTicks* last) {
+  assert(type < StreamType::MaxStreamTypes);
+  pp::AutoLock critical_section(packets_lock_);
+  DrainIncoming();
+  const auto& queue = packets_[static_cast<int32_t>(type)];
+  if (queue.empty()) return false;
+  for (const auto& stream_object : queue) {
+    if (stream_object.IsConfig()) return false;
+  }
+  *first = queue.front().time();
+  *last = queue.back().time();
+  return true;
+}
+
+StreamBufferedRanges PacketsManager::GetBufferedRanges(StreamType type) {
+  assert(type < StreamType::MaxStreamTypes);
+  auto stream_index = static_cast<int32_t>(type);
+  StreamBufferedRanges ranges;
+  MediaTime appended_start = appended_start_[stream_index];
+  MediaTime appended_end = appended_end_[stream_index];
+  if (appended_start != kNoDts && appended_end != kNoDts) {
+    ranges.appended.start = ToTimeTicks(appended_start);
+    ranges.appended.end = ToTimeTicks(appended_end);
+  }
+  pp::AutoLock critical_section(packets_lock_);
+  DrainIncoming();
+  const auto& queue = packets_[stream_index];
+  if (!queue.empty()) {
+    ranges.queued.start = queue.front().time();
+    ranges.queued.end = queue.back().time();
+  }
+  return ranges;
+}
+
+bool PacketsManager::DropPacketsFrom(StreamType type, TimeTicks time) {
+  assert(type < StreamType::MaxStreamTypes);
+  auto stream_index = static_cast<int32_t>(type);
+  pp::AutoLock critical_section(packets_lock_);
+  DrainIncoming();
+  auto& queue = packets_[stream_index];
+  auto it = std::find_if(queue.begin(), queue.end(),
+      [time](const BufferedStreamObject& stream_object) {
+        return stream_object.time() >= time - kSegmentMargin &&
+               stream_object.IsKeyFrame();
+      });
+  // At least one packet is kept, so buffered_packets_timestamp_ stays valid.
+  if (it == queue.end() || it == queue.begin() ||
+      it->time() > time + kSegmentMargin)
+    return false;
+  if (std::any_of(it, queue.end(),
+                  [](const BufferedStreamObject& stream_object) {
+                    return stream_object.IsConfig();
+                  }))
+    return false;
+
+  LOG_INFO("Dropping %zu %s packets from %f [s]", queue.end() - it,
+           type == StreamType::Video ? "VIDEO" : "AUDIO", it->time());
+  size_t dropped_bytes = 0;
+  for (auto drop = it; drop != queue.end(); ++drop)
+    dropped_bytes += drop->GetDataSize();
+  buffered_bytes_[stream_index] -= dropped_bytes;
+  memory_usage_.Remove(dropped_bytes);
+  AddDroppedPackets(queue.end() - it);
+  queue.erase(it, queue.end());
+  buffered_packets_timestamp_[stream_index] = queue.back().media_time();
+  last_demuxed_dts_[stream_index] = queue.back().media_time();
+  return true;
 }
 
-void PacketsManager::SetStream(StreamType type, StreamManager* manager) {
+bool PacketsManager::DropQueuedPackets(StreamType type,
+                                       TimeTicks* appended_end) {
   assert(type < StreamType::MaxStreamTypes);
-  streams_[static_cast<int32_t>(type)] = manager;
+  auto stream_index = static_cast<int32_t>(type);
+  pp::AutoLock critical_section(packets_lock_);
+  DrainIncoming();
+  MediaTime end = appended_end_[stream_index];
+  if (seeking_ || end == kNoDts) return false;
+  auto& queue = packets_[stream_index];
+  if (std::any_of(queue.begin(), queue.end(),
+                  [](const BufferedStreamObject& stream_object) {
+                    return stream_object.IsConfig();
+                  }))
+    return false;
+
+  LOG_INFO("Dropping %zu queued %s packets after %f [s]", queue.size(),
+           type == StreamType::Video ? "VIDEO" : "AUDIO", ToTimeTicks(end));
+  size_t dropped_bytes = 0;
+  for (const auto& stream_object : queue)
+    dropped_bytes += stream_object.GetDataSize();
+  buffered_bytes_[stream_index] -= dropped_bytes;
+  memory_usage_.Remove(dropped_bytes);
+  AddDroppedPackets(queue.size());
+  queue.clear();
+  // Packets of the next representation up to the appended ones are dropped
+  // as overlapping, see DropOverlappingPackets().
+  buffered_packets_timestamp_[stream_index] = end;
+  last_demuxed_dts_[stream_index] = end;
+  overlap_end_dts_[stream_index] = kNoDts;
+  *appended_end = ToTimeTicks(end);
+  return true;
 }
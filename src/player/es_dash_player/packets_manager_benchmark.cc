@@ -0,0 +1,470 @@
+/*!
+ * packets_manager_benchmark.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kPackets
+
+#include "player/es_dash_player/packets_manager_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "demuxer/elementary_stream_packet.h"
+#include "player/es_dash_player/packets_manager.h"
+#include "player/es_dash_player/stream_sink.h"
+
+using Samsung::NaClPlayer::TimeTicks;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+using std::vector;
+
+struct PacketsManagerBenchmark::Scenario {
+  const char* name;
+  double video_fps;
+  // How far ahead of the playback position packets are delivered.
+  TimeTicks buffer_time;
+  // Packets are passed with OnEsPackets() if true, or with OnEsPacket().
+  bool batched;
+  // A seek forward is made that often, if it's not 0.
+  TimeTicks seek_interval;
+  // Configurations change every that many segments, if it's not 0.
+  uint32_t config_interval;
+};
+
+namespace {
+
+constexpr PacketsManagerBenchmark::Scenario kScenarios[] = {
+  {"30fps_5s", 30., 5., true, 0., 0},
+  {"60fps_10s", 60., 10., true, 0., 0},
+  {"120fps_30s", 120., 30., true, 0., 0},
+  {"120fps_30s_single", 120., 30., false, 0., 0},
+  {"120fps_30s_seeks", 120., 30., true, 20., 5},
+};
+
+constexpr TimeTicks kContentDuration = 600.;  // seconds
+constexpr TimeTicks kSegmentDuration = 2.;  // seconds
+constexpr uint32_t kSegmentCount =
+    static_cast<uint32_t>(kContentDuration / kSegmentDuration);
+// How far ahead of the playback position the fake player takes packets.
+constexpr TimeTicks kPlayerBufferTime = 3.;  // seconds
+constexpr TimeTicks kSeekDistance = 10.;  // seconds
+// AAC frames of 1024 samples at 48 kHz.
+constexpr double kAudioPacketsPerSecond = 48000. / 1024.;
+constexpr uint32_t kAudioPacketSize = 384;
+constexpr double kVideoBitrate = 8e6;  // bits per second
+// Keyframes, at the start of each segment, are that much bigger than other
+// video frames.
+constexpr uint32_t kKeyframeSizeFactor = 8;
+constexpr int32_t kNeedDataBytes = 2 * 1024 * 1024;
+
+// Stands for a StreamManager and the NaCl Player stream behind it. Only the
+// playback thread appends packets and moves the playback position, while
+// IsSeeking() is checked by the delivering thread as well.
+class FakeStreamSink : public StreamSink {
+ public:
+  explicit FakeStreamSink(StreamType type)
+      : type_(type),
+        seeking_(false),
+        played_time_(0.),
+        appended_time_(-1.),
+        appended_(0),
+        full_(false) {}
+
+  bool IsInitialized() override {
+    return true;
+  }
+
+  bool IsSeeking() const override {
+    return seeking_;
+  }
+
+  AppendResult AppendPacket(const ElementaryStreamPacket& packet) override {
+    if (packet.GetDts() > played_time_ + kPlayerBufferTime) {
+      full_ = true;
+      return AppendResult::kTryAgain;
+    }
+    appended_time_ = packet.GetDts();
+    ++appended_;
+    return AppendResult::kAppended;
+  }
+
+  size_t AppendPackets(
+      const vector<const ElementaryStreamPacket*>& packets,
+      AppendResult* result) override {
+    size_t appended = 0;
+    *result = AppendResult::kAppended;
+    for (; appended < packets.size(); ++appended) {
+      *result = AppendPacket(*packets[appended]);
+      if (*result != AppendResult::kAppended) break;
+    }
+    return appended;
+  }
+
+  bool SetConfig(const AudioConfig&) override {
+    return true;
+  }
+
+  bool SetConfig(const VideoConfig&) override {
+    return true;
+  }
+
+  void SetSegmentToTime(TimeTicks time, TimeTicks* timestamp,
+                        TimeTicks* duration) override {
+    seeking_ = false;
+    if (timestamp)
+      *timestamp = std::floor(time / kSegmentDuration) * kSegmentDuration;
+    if (duration) *duration = kSegmentDuration;
+  }
+
+  void StartSeek(TimeTicks time) {
+    seeking_ = true;
+    played_time_ = time;
+    appended_time_ = -1.;
+    full_ = false;
+  }
+
+  // Moves the playback position and asks for data, like NaCl Player does,
+  // when the buffer is half empty after it was full.
+  void Play(TimeTicks time, PacketsManager* packets_manager) {
+    played_time_ = time;
+    if (full_ && appended_time_ - played_time_ < kPlayerBufferTime / 2) {
+      full_ = false;
+      packets_manager->OnNeedData(type_, kNeedDataBytes);
+    }
+  }
+
+  TimeTicks appended_time() const {
+    return appended_time_;
+  }
+
+  uint64_t appended() const {
+    return appended_;
+  }
+
+ private:
+  StreamType type_;
+  std::atomic<bool> seeking_;
+  TimeTicks played_time_;
+  TimeTicks appended_time_;
+  uint64_t appended_;
+  bool full_;
+};
+
+// Generates packets of media segments and passes them to PacketsManager on
+// its own thread, like a demuxer callback dispatcher.
+class PacketsFeeder {
+ public:
+  PacketsFeeder(const PacketsManagerBenchmark::Scenario& scenario,
+                PacketsManager* packets_manager,
+                const std::atomic<TimeTicks>& playback_time)
+      : scenario_(scenario),
+        packets_manager_(packets_manager),
+        playback_time_(playback_time),
+        video_packet_size_(static_cast<uint32_t>(
+            kVideoBitrate / 8. / scenario.video_fps)),
+        data_(std::make_shared<vector<uint8_t>>(
+            video_packet_size_ * kKeyframeSizeFactor)),
+        next_segment_(0),
+        eos_sent_(false),
+        exited_(false),
+        packets_(0) {
+    thread_ = std::thread(&PacketsFeeder::ThreadFn, this);
+  }
+
+  ~PacketsFeeder() {
+    Stop();
+  }
+
+  // Joins the feeder thread.
+  void Stop() {
+    exited_ = true;
+    if (thread_.joinable()) thread_.join();
+  }
+
+  // Makes the feeder continue from the given segment. Called during a seek,
+  // with the feeder locked.
+  void SetNextSegment(uint32_t segment) {
+    next_segment_ = segment;
+    eos_sent_ = false;
+  }
+
+  std::mutex& mutex() {
+    return mutex_;
+  }
+
+  // Durations of calls to PacketsManager in microseconds and a number of
+  // delivered packets, which can be read once the feeder is stopped.
+  vector<double>& call_durations() {
+    return call_durations_;
+  }
+
+  uint64_t packets() const {
+    return packets_;
+  }
+
+ private:
+  void ThreadFn() {
+    while (!exited_) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (next_segment_ >= kSegmentCount) {
+        if (!eos_sent_) {
+          // Each stream demuxer signals the end of its stream.
+          packets_manager_->OnEndOfStream(StreamType::Audio);
+          packets_manager_->OnEndOfStream(StreamType::Video);
+          eos_sent_ = true;
+        }
+      } else if (next_segment_ * kSegmentDuration <=
+                 playback_time_ + scenario_.buffer_time) {
+        DeliverSegment(next_segment_++);
+        continue;
+      }
+      lock.unlock();
+      std::this_thread::yield();
+    }
+  }
+
+  void DeliverSegment(uint32_t segment) {
+    TimeTicks start = segment * kSegmentDuration;
+    if (scenario_.config_interval && segment > 0 &&
+        segment % scenario_.config_interval == 0) {
+      AudioConfig audio_config = AudioConfig();
+      audio_config.demux_id = segment;
+      packets_manager_->OnStreamConfig(audio_config);
+      VideoConfig video_config = VideoConfig();
+      video_config.demux_id = segment;
+      packets_manager_->OnStreamConfig(video_config);
+    }
+
+    auto video_count = static_cast<uint32_t>(
+        std::lround(kSegmentDuration * scenario_.video_fps));
+    StreamDemuxer::PacketBatch video;
+    for (uint32_t i = 0; i < video_count; ++i) {
+      bool key_frame = i == 0;
+      video.push_back(MakePacket(start + i / scenario_.video_fps,
+          1. / scenario_.video_fps, key_frame,
+          key_frame ? video_packet_size_ * kKeyframeSizeFactor
+                    : video_packet_size_));
+    }
+    auto audio_count = static_cast<uint32_t>(
+        std::lround(kSegmentDuration * kAudioPacketsPerSecond));
+    StreamDemuxer::PacketBatch audio;
+    for (uint32_t i = 0; i < audio_count; ++i) {
+      audio.push_back(MakePacket(start + i / kAudioPacketsPerSecond,
+          1. / kAudioPacketsPerSecond, true, kAudioPacketSize));
+    }
+    packets_ += video.size() + audio.size();
+
+    if (scenario_.batched) {
+      // Demuxers post batches of each stream separately.
+      Deliver(StreamDemuxer::kVideoPkt, std::move(video));
+      Deliver(StreamDemuxer::kAudioPkt, std::move(audio));
+      return;
+    }
+    // Packets of both streams interleaved in the timestamp order.
+    size_t audio_index = 0;
+    for (auto& packet : video) {
+      while (audio_index < audio.size() &&
+             audio[audio_index]->GetDts() <= packet->GetDts())
+        Deliver(StreamDemuxer::kAudioPkt, std::move(audio[audio_index++]));
+      Deliver(StreamDemuxer::kVideoPkt, std::move(packet));
+    }
+    for (; audio_index < audio.size(); ++audio_index)
+      Deliver(StreamDemuxer::kAudioPkt, std::move(audio[audio_index]));
+  }
+
+  std::unique_ptr<ElementaryStreamPacket> MakePacket(TimeTicks time,
+      TimeTicks duration, bool key_frame, uint32_t size) {
+    // Packets refer to a shared buffer, like the ones of Mp4Demuxer.
+    auto packet = MakeUnique<ElementaryStreamPacket>(data_, 0, size);
+    packet->SetPts(time);
+    packet->SetDts(time);
+    packet->SetDuration(duration);
+    packet->SetKeyFrame(key_frame);
+    return packet;
+  }
+
+  void Deliver(StreamDemuxer::Message message,
+               StreamDemuxer::PacketBatch packets) {
+    auto start = steady_clock::now();
+    packets_manager_->OnEsPackets(message, std::move(packets));
+    call_durations_.push_back(MicrosecondsSince(start));
+  }
+
+  void Deliver(StreamDemuxer::Message message,
+               std::unique_ptr<ElementaryStreamPacket> packet) {
+    auto start = steady_clock::now();
+    packets_manager_->OnEsPacket(message, std::move(packet));
+    call_durations_.push_back(MicrosecondsSince(start));
+  }
+
+  const PacketsManagerBenchmark::Scenario& scenario_;
+  PacketsManager* packets_manager_;
+  const std::atomic<TimeTicks>& playback_time_;
+  uint32_t video_packet_size_;
+  std::shared_ptr<const vector<uint8_t>> data_;
+  std::mutex mutex_;
+  // Guarded by mutex_.
+  uint32_t next_segment_;
+  bool eos_sent_;
+  std::atomic<bool> exited_;
+  // Used on the feeder thread only.
+  uint64_t packets_;
+  vector<double> call_durations_;
+  std::thread thread_;
+};
+
+}  // anonymous namespace
+
+PacketsManagerBenchmark::PacketsManagerBenchmark(
+    const pp::InstanceHandle& instance)
+    : cc_factory_(this),
+      running_(false),
+      cancelled_(false),
+      thread_(instance) {
+  thread_.Start();
+}
+
+PacketsManagerBenchmark::~PacketsManagerBenchmark() {
+  cancelled_ = true;
+  thread_.Join();
+}
+
+bool PacketsManagerBenchmark::Start(const ResultCallback& callback) {
+  if (running_.exchange(true)) {
+    LOG_ERROR("A packets manager benchmark is running already");
+    return false;
+  }
+  callback_ = callback;
+  thread_.message_loop().PostWork(cc_factory_.NewCallback(
+      &PacketsManagerBenchmark::RunOnBenchmarkThread));
+  return true;
+}
+
+void PacketsManagerBenchmark::RunOnBenchmarkThread(int32_t) {
+  for (const auto& scenario : kScenarios) {
+    if (cancelled_) break;
+    Result result = RunScenario(scenario);
+    LOG_INFO("%s: %llu packets in %.3f [s], deliver: %.0f ns/packet, "
+             "p50: %.2f p99: %.2f max: %.2f [us], update: %.0f ns/packet, "
+             "p50: %.2f p99: %.2f max: %.2f [us], seeks: %llu max: %.2f [us]",
+             result.scenario.c_str(),
+             static_cast<unsigned long long>(result.packets), result.seconds,
+             result.deliver_ns_per_packet, result.deliver_p50_us,
+             result.deliver_p99_us, result.deliver_max_us,
+             result.update_ns_per_packet, result.update_p50_us,
+             result.update_p99_us, result.update_max_us,
+             static_cast<unsigned long long>(result.seeks),
+             result.seek_max_us);
+    if (callback_) callback_(result);
+  }
+  callback_ = nullptr;
+  running_ = false;
+}
+
+PacketsManagerBenchmark::Result PacketsManagerBenchmark::RunScenario(
+    const Scenario& scenario) {
+  Result result = Result();
+  result.scenario = scenario.name;
+
+  PacketsManager packets_manager(TuningProfile::Current());
+  FakeStreamSink audio(StreamType::Audio);
+  FakeStreamSink video(StreamType::Video);
+  packets_manager.SetStream(StreamType::Audio, &audio);
+  packets_manager.SetStream(StreamType::Video, &video);
+
+  vector<double> update_durations;
+  vector<double> deliver_durations;
+  double update_total_us = 0.;
+  double deliver_total_us = 0.;
+  std::atomic<TimeTicks> playback_time(0.);
+  TimeTicks frame_duration = 1. / scenario.video_fps;
+  TimeTicks last_frame_time = kContentDuration - frame_duration;
+  TimeTicks next_seek = scenario.seek_interval;
+  auto start = steady_clock::now();
+  {
+    PacketsFeeder feeder(scenario, &packets_manager, playback_time);
+    TimeTicks time = 0.;
+    while (time + kEps < last_frame_time && !cancelled_) {
+      if (scenario.seek_interval > 0. && time >= next_seek &&
+          time + kSeekDistance < last_frame_time) {
+        // Segment aligned, so the seek ends on the keyframe of the segment.
+        time = std::floor((time + kSeekDistance) / kSegmentDuration) *
+            kSegmentDuration;
+        next_seek = time + scenario.seek_interval;
+        auto seek_start = steady_clock::now();
+        std::lock_guard<std::mutex> lock(feeder.mutex());
+        audio.StartSeek(time);
+        video.StartSeek(time);
+        packets_manager.PrepareForSeek(time);
+        packets_manager.OnSeekData(StreamType::Video, time);
+        packets_manager.OnSeekData(StreamType::Audio, time);
+        feeder.SetNextSegment(static_cast<uint32_t>(
+            std::lround(time / kSegmentDuration)));
+        playback_time = time;
+        result.seek_max_us = std::max(result.seek_max_us,
+                                      MicrosecondsSince(seek_start));
+        ++result.seeks;
+      }
+
+      auto update_start = steady_clock::now();
+      packets_manager.UpdateBuffer(time);
+      double update_us = MicrosecondsSince(update_start);
+      update_durations.push_back(update_us);
+      update_total_us += update_us;
+
+      // The next frame is played once it's appended.
+      if (video.appended_time() >= time + frame_duration - kEps) {
+        time += frame_duration;
+        playback_time = time;
+        audio.Play(time, &packets_manager);
+        video.Play(time, &packets_manager);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    feeder.Stop();
+    result.packets = feeder.packets();
+    deliver_durations.swap(feeder.call_durations());
+  }
+  result.seconds = duration<double>(steady_clock::now() - start).count();
+  result.appended = audio.appended() + video.appended();
+  for (double call_us : deliver_durations)
+    deliver_total_us += call_us;
+  if (result.packets > 0)
+    result.deliver_ns_per_packet = deliver_total_us * 1e3 / result.packets;
+  if (result.appended > 0)
+    result.update_ns_per_packet = update_total_us * 1e3 / result.appended;
+
+  std::sort(deliver_durations.begin(), deliver_durations.end());
+  result.deliver_p50_us = Percentile(deliver_durations, 50.);
+  result.deliver_p99_us = Percentile(deliver_durations, 99.);
+  result.deliver_max_us =
+      deliver_durations.empty() ? 0. : deliver_durations.back();
+  std::sort(update_durations.begin(), update_durations.end());
+  result.update_p50_us = Percentile(update_durations, 50.);
+  result.update_p99_us = Percentile(update_durations, 99.);
+  result.update_max_us =
+      update_durations.empty() ? 0. : update_durations.back();
+  return result;
+}
@@ -0,0 +1,93 @@
+/*!
+ * packets_manager_benchmark.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_PACKETS_MANAGER_BENCHMARK_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_PACKETS_MANAGER_BENCHMARK_H_
+
+#include <atomic>
+#include <functional>
+#include <string>
+
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/simple_thread.h"
+
+// Drives PacketsManager with synthetic, interleaved audio and video packets,
+// without NaCl Player. Streams are fake StreamSinks which take packets up to
+// a few seconds ahead of a simulated playback position. Packets are delivered
+// from a separate thread, like from a demuxer callback dispatcher, while the
+// benchmark thread calls UpdateBuffer(), so both contend for the packets
+// lock. Playback time is simulated, i.e. it advances as soon as packets for
+// the next frame are appended.
+//
+// A few scenarios are run one after another: various frame rates and buffer
+// depths, packets passed one by one or in batches, seeks and configuration
+// changes.
+class PacketsManagerBenchmark {
+ public:
+  // Parameters of a scenario, the list of scenarios is in the .cc file.
+  struct Scenario;
+
+  struct Result {
+    std::string scenario;
+    // Packets passed to PacketsManager and appended to the streams.
+    uint64_t packets;
+    uint64_t appended;
+    double seconds;
+    // Time spent in OnEsPacket()/OnEsPackets() by the delivering thread and
+    // in UpdateBuffer() by the playback thread, per packet.
+    double deliver_ns_per_packet;
+    double update_ns_per_packet;
+    // Durations of single calls, which include waiting for and holding the
+    // packets lock, in microseconds.
+    double deliver_p50_us;
+    double deliver_p99_us;
+    double deliver_max_us;
+    double update_p50_us;
+    double update_p99_us;
+    double update_max_us;
+    uint64_t seeks;
+    double seek_max_us;
+  };
+
+  // Called once per scenario, on the benchmark thread.
+  typedef std::function<void(const Result&)> ResultCallback;
+
+  explicit PacketsManagerBenchmark(const pp::InstanceHandle& instance);
+  ~PacketsManagerBenchmark();
+
+  // Starts a benchmark, unless one is running already.
+  bool Start(const ResultCallback& callback);
+
+  bool IsRunning() const { return running_; }
+
+ private:
+  void RunOnBenchmarkThread(int32_t);
+  Result RunScenario(const Scenario& scenario);
+
+  pp::CompletionCallbackFactory<PacketsManagerBenchmark> cc_factory_;
+  std::atomic<bool> running_;
+  std::atomic<bool> cancelled_;
+  ResultCallback callback_;
+
+  // Declared last, so it's joined before other members are destroyed.
+  pp::SimpleThread thread_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_PACKETS_MANAGER_BENCHMARK_H_
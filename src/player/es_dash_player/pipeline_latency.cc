@@ -0,0 +1,251 @@
+/*!
+ * pipeline_latency.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kGeneral
+
+#include "pipeline_latency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "common.h"
+
+using pp::AutoLock;
+
+namespace {
+
+constexpr double kMicrosecondsPerMillisecond = 1000.;
+
+// Segments which aren't finished by then, e.g. the ones without packets
+// appended after a representation change, are dropped.
+constexpr size_t kMaxTrackedSegments = 16;
+
+bool IsSet(PipelineLatency::Clock::time_point time) {
+  return time.time_since_epoch().count() != 0;
+}
+
+}  // namespace
+
+constexpr size_t PipelineLatency::kStageCount;
+
+PipelineLatency::Histogram::Histogram() {
+  Reset();
+}
+
+void PipelineLatency::Histogram::Reset() {
+  buckets_.fill(0);
+  count_ = 0;
+  max_ = 0;
+}
+
+size_t PipelineLatency::Histogram::BucketOf(uint64_t microseconds) {
+  microseconds = std::min(microseconds, (uint64_t{1} << kMaxLatencyBits) - 1);
+  if (microseconds < kSubBuckets) return microseconds;
+
+  uint32_t shift = 0;
+  while ((microseconds >> shift) >= 2 * kSubBuckets) ++shift;
+  return kSubBuckets * (shift + 1) + (microseconds >> shift) - kSubBuckets;
+}
+
+uint64_t PipelineLatency::Histogram::UpperBoundOf(size_t bucket) {
+  if (bucket < kSubBuckets) return bucket;
+
+  uint32_t shift = bucket / kSubBuckets - 1;
+  uint64_t sub_bucket = bucket % kSubBuckets + kSubBuckets;
+  return ((sub_bucket + 1) << shift) - 1;
+}
+
+void PipelineLatency::Histogram::Add(uint64_t microseconds) {
+  ++buckets_[BucketOf(microseconds)];
+  ++count_;
+  max_ = std::max(max_, microseconds);
+}
+
+uint64_t PipelineLatency::Histogram::Percentile(double percent) const {
+  if (count_ == 0) return 0;
+
+  uint64_t rank = std::max<uint64_t>(
+      static_cast<uint64_t>(std::ceil(percent / 100. * count_)), 1);
+  uint64_t counted = 0;
+  for (size_t bucket = 0; bucket < kBucketCount; ++bucket) {
+    counted += buckets_[bucket];
+    if (counted >= rank) return std::min(UpperBoundOf(bucket), max_);
+  }
+  return max_;
+}
+
+const char* PipelineLatency::StageName(Stage stage) {
+  switch (stage) {
+    case Stage::kRequest:
+      return "request";
+    case Stage::kDownload:
+      return "download";
+    case Stage::kFirstPacket:
+      return "first packet";
+    case Stage::kParse:
+      return "parse";
+    case Stage::kAppend:
+      return "append";
+    case Stage::kTotal:
+      return "total";
+    default:
+      return "unknown";
+  }
+}
+
+PipelineLatency::PipelineLatency() = default;
+
+void PipelineLatency::Reset() {
+  AutoLock lock(lock_);
+  for (auto& histogram : histograms_)
+    histogram.Reset();
+}
+
+void PipelineLatency::AddSegment(const SegmentTimes& times) {
+  const std::pair<Clock::time_point, Clock::time_point> spans[] = {
+    {times.requested, times.first_byte},
+    {times.first_byte, times.last_byte},
+    {times.first_byte, times.first_packet},
+    {times.parse_start, times.last_packet},
+    {times.last_packet, times.last_appended},
+    {times.requested, times.last_appended},
+  };
+  static_assert(sizeof(spans) / sizeof(spans[0]) == kStageCount,
+                "Each stage needs a span");
+
+  AutoLock lock(lock_);
+  for (size_t stage = 0; stage < kStageCount; ++stage) {
+    if (!IsSet(spans[stage].first) || !IsSet(spans[stage].second)) continue;
+    // Demuxing can start before the segment is downloaded, latencies of
+    // overlapping stages are 0.
+    auto latency = std::max(spans[stage].second - spans[stage].first,
+                            Clock::duration::zero());
+    histograms_[stage].Add(
+        std::chrono::duration_cast<std::chrono::microseconds>(latency)
+            .count());
+  }
+}
+
+PipelineLatency::Report PipelineLatency::GetReport() const {
+  Report report;
+  AutoLock lock(lock_);
+  for (size_t stage = 0; stage < kStageCount; ++stage) {
+    const auto& histogram = histograms_[stage];
+    auto& stage_report = report.stages[stage];
+    stage_report.count = histogram.Count();
+    stage_report.p50 =
+        histogram.Percentile(50.) / kMicrosecondsPerMillisecond;
+    stage_report.p90 =
+        histogram.Percentile(90.) / kMicrosecondsPerMillisecond;
+    stage_report.p99 =
+        histogram.Percentile(99.) / kMicrosecondsPerMillisecond;
+    stage_report.max = histogram.Max() / kMicrosecondsPerMillisecond;
+  }
+  return report;
+}
+
+void PipelineLatency::LogReport() const {
+  Report report = GetReport();
+  if (report.stages[static_cast<size_t>(Stage::kTotal)].count == 0) return;
+
+  for (size_t stage = 0; stage < kStageCount; ++stage) {
+    const auto& stage_report = report.stages[stage];
+    LOG_INFO("Segment %s latency of %u segments, p50: %.1f p90: %.1f "
+             "p99: %.1f max: %.1f [ms]",
+             StageName(static_cast<Stage>(stage)), stage_report.count,
+             stage_report.p50, stage_report.p90, stage_report.p99,
+             stage_report.max);
+  }
+}
+
+SegmentLatencyTracker::SegmentLatencyTracker()
+    : lock_(), latency_(nullptr), segments_() {}
+
+void SegmentLatencyTracker::SetLatency(PipelineLatency* latency) {
+  AutoLock lock(lock_);
+  latency_ = latency;
+}
+
+void SegmentLatencyTracker::AddSegment(double begin, double end,
+                                       Clock::time_point requested) {
+  AutoLock lock(lock_);
+  // The segment is downloaded again, e.g. from another representation.
+  segments_.erase(std::remove_if(segments_.begin(), segments_.end(),
+      [begin](const Segment& segment) {
+        return std::abs(segment.begin - begin) < kEps;
+      }), segments_.end());
+  if (segments_.size() >= kMaxTrackedSegments) segments_.pop_front();
+
+  Segment segment = {begin, end, false, {}};
+  segment.times.requested = requested;
+  segment.times.parse_start = Clock::now();
+  segments_.push_back(segment);
+}
+
+void SegmentLatencyTracker::SetDownloaded(double begin,
+    Clock::time_point first_byte, Clock::time_point last_byte) {
+  // An end of stream signal isn't downloaded.
+  if (!IsSet(last_byte)) return;
+
+  AutoLock lock(lock_);
+  for (auto& segment : segments_) {
+    if (std::abs(segment.begin - begin) < kEps) {
+      segment.downloaded = true;
+      segment.times.first_byte = first_byte;
+      segment.times.last_byte = last_byte;
+      return;
+    }
+  }
+}
+
+void SegmentLatencyTracker::AddDemuxed(double first_pts, double last_pts) {
+  auto now = Clock::now();
+  AutoLock lock(lock_);
+  // Timestamps of packets can be rounded below the start of their segment.
+  for (auto& segment : segments_) {
+    if (segment.begin - kEps > last_pts || first_pts >= segment.end)
+      continue;
+    if (!IsSet(segment.times.first_packet))
+      segment.times.first_packet = now;
+    segment.times.last_packet = now;
+  }
+}
+
+void SegmentLatencyTracker::AddAppended(double first_pts, double last_pts) {
+  auto now = Clock::now();
+  AutoLock lock(lock_);
+  for (auto& segment : segments_) {
+    if (segment.begin - kEps <= last_pts && first_pts < segment.end)
+      segment.times.last_appended = now;
+  }
+  // Packets of later segments are appended only after all packets of
+  // earlier ones.
+  while (!segments_.empty() && segments_.front().end <= last_pts) {
+    const Segment& segment = segments_.front();
+    if (latency_ && segment.downloaded && IsSet(segment.times.last_appended))
+      latency_->AddSegment(segment.times);
+    segments_.pop_front();
+  }
+}
+
+void SegmentLatencyTracker::Clear() {
+  AutoLock lock(lock_);
+  segments_.clear();
+}
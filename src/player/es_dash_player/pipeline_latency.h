@@ -0,0 +1,172 @@
+/*!
+ * pipeline_latency.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_PIPELINE_LATENCY_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_PIPELINE_LATENCY_H_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+#include "ppapi/utility/threading/lock.h"
+
+// Collects latencies of stages which media segments go through: download,
+// demuxing and appending to NaCl Player. Each stage has a histogram with
+// buckets growing with the latency (as in HdrHistogram), so percentiles
+// are within a few percent of the measured values, however many segments
+// are measured. Each player owns one, reset when it starts a new content.
+// It's thread safe.
+class PipelineLatency {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  enum class Stage {
+    // From the request of a segment to its first byte.
+    kRequest,
+    // From the first to the last byte of a segment.
+    kDownload,
+    // From the first byte of a segment to its first packet demuxed.
+    kFirstPacket,
+    // From passing a segment to the demuxer to its last packet demuxed.
+    kParse,
+    // From the last packet of a segment demuxed to its last packet appended.
+    kAppend,
+    // From the request of a segment to its last packet appended.
+    kTotal,
+    kCount
+  };
+  static constexpr size_t kStageCount = static_cast<size_t>(Stage::kCount);
+
+  // Times of a segment going through the pipeline, unset ones are zero.
+  struct SegmentTimes {
+    Clock::time_point requested;
+    Clock::time_point first_byte;
+    Clock::time_point last_byte;
+    // The first data of the segment was passed to the demuxer.
+    Clock::time_point parse_start;
+    // Packets were passed on by the demuxer, to the PacketsManager.
+    Clock::time_point first_packet;
+    Clock::time_point last_packet;
+    Clock::time_point last_appended;
+  };
+
+  struct StageReport {
+    uint32_t count;
+    // Latency percentiles, in milliseconds.
+    double p50;
+    double p90;
+    double p99;
+    double max;
+  };
+
+  struct Report {
+    std::array<StageReport, kStageCount> stages;
+  };
+
+  PipelineLatency();
+
+  static const char* StageName(Stage stage);
+
+  void Reset();
+
+  // Adds latencies of each stage of the segment which both ends are set
+  // for.
+  void AddSegment(const SegmentTimes& times);
+
+  Report GetReport() const;
+  // Logs the report, if any segment has been measured.
+  void LogReport() const;
+
+ private:
+  // Latencies are counted in microseconds: exactly below kSubBuckets, then
+  // in kSubBuckets buckets for each power of two, up to kMaxLatency.
+  class Histogram {
+   public:
+    Histogram();
+
+    void Reset();
+    void Add(uint64_t microseconds);
+    uint32_t Count() const { return count_; }
+    // Returns the upper bound of the bucket with the given percentile,
+    // in microseconds.
+    uint64_t Percentile(double percent) const;
+    uint64_t Max() const { return max_; }
+
+   private:
+    static constexpr uint32_t kSubBucketBits = 4;
+    static constexpr uint64_t kSubBuckets = 1 << kSubBucketBits;
+    static constexpr uint32_t kMaxLatencyBits = 26;  // over a minute
+    static constexpr size_t kBucketCount =
+        kSubBuckets * (kMaxLatencyBits - kSubBucketBits + 1);
+
+    static size_t BucketOf(uint64_t microseconds);
+    static uint64_t UpperBoundOf(size_t bucket);
+
+    std::array<uint32_t, kBucketCount> buckets_;
+    uint32_t count_;
+    uint64_t max_;
+  };
+
+  mutable pp::Lock lock_;
+  std::array<Histogram, kStageCount> histograms_;
+};
+
+// Follows segments of a stream through the pipeline and passes their times
+// to the PipelineLatency of the player once their last packet is appended.
+// Packets are matched to segments by their timestamps, as the demuxer
+// doesn't tell which segment a packet comes from. It's thread safe, as
+// segments are demuxed on the stream thread and appended on the packets
+// thread.
+class SegmentLatencyTracker {
+ public:
+  typedef PipelineLatency::Clock Clock;
+
+  SegmentLatencyTracker();
+
+  // Segments are measured into latency, nothing is measured while it's null.
+  void SetLatency(PipelineLatency* latency);
+  // A segment spanning [begin, end) of media is passed to the demuxer now.
+  void AddSegment(double begin, double end, Clock::time_point requested);
+  // The segment starting at begin was downloaded.
+  void SetDownloaded(double begin, Clock::time_point first_byte,
+                     Clock::time_point last_byte);
+  // Packets with timestamps from first_pts to last_pts were demuxed or
+  // appended now. Segments are measured once a packet after them is
+  // appended, as segments are appended in order.
+  void AddDemuxed(double first_pts, double last_pts);
+  void AddAppended(double first_pts, double last_pts);
+  // Drops segments in progress, e.g. on a seek.
+  void Clear();
+
+ private:
+  struct Segment {
+    double begin;
+    double end;
+    bool downloaded;
+    PipelineLatency::SegmentTimes times;
+  };
+
+  pp::Lock lock_;
+  PipelineLatency* latency_;
+  std::deque<Segment> segments_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_PIPELINE_LATENCY_H_
@@ -0,0 +1,172 @@
+/*!
+ * platform_health.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kGeneral
+
+#include "platform_health.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "common.h"
+
+using pp::AutoLock;
+using std::chrono::duration;
+
+namespace {
+
+// Buffering with that much video appended ahead of the playback position
+// isn't caused by the network nor the pipeline.
+constexpr double kUnderrunVideoAhead = 1.0;  // in seconds
+
+// A time update is late if it comes that many times later than usual.
+constexpr double kLateIntervalFactor = 2.0;
+
+// Intervals needed before late ones are told apart, and the weight of each
+// further one in the typical interval.
+constexpr uint32_t kMinTypicalIntervals = 5;
+constexpr double kTypicalIntervalWeight = 0.1;
+
+// Longer intervals are gaps the player wasn't told about, e.g. a playback
+// held by the application, they are not counted.
+constexpr double kMaxInterval = 5000.;  // in milliseconds
+
+// The platform doesn't keep up with a representation once it underran that
+// many times, or once that part of its time updates, out of enough of them,
+// came late.
+constexpr uint32_t kMaxUnderruns = 2;
+constexpr uint32_t kMinRepresentationTimeUpdates = 20;
+constexpr double kMaxLateTimeUpdateRatio = 0.2;
+
+}  // namespace
+
+PlatformHealth::PlatformHealth()
+    : representation_id_(-1),
+      error_count_(0),
+      last_error_(0),
+      buffering_count_(0),
+      underrun_count_(0),
+      has_last_time_update_(false),
+      last_time_update_(),
+      interval_count_(0),
+      interval_sum_(0.),
+      interval_square_sum_(0.),
+      typical_interval_(0.),
+      late_time_updates_(0),
+      representations_() {}
+
+void PlatformHealth::Reset() {
+  AutoLock lock(lock_);
+  representation_id_ = -1;
+  error_count_ = 0;
+  last_error_ = 0;
+  buffering_count_ = 0;
+  underrun_count_ = 0;
+  has_last_time_update_ = false;
+  interval_count_ = 0;
+  interval_sum_ = 0.;
+  interval_square_sum_ = 0.;
+  typical_interval_ = 0.;
+  late_time_updates_ = 0;
+  representations_.clear();
+}
+
+void PlatformHealth::SetRepresentation(int32_t id) {
+  AutoLock lock(lock_);
+  representation_id_ = id;
+}
+
+void PlatformHealth::AddTimeUpdate(bool playing) {
+  auto now = Clock::now();
+  AutoLock lock(lock_);
+  bool measured = has_last_time_update_;
+  double interval =
+      duration<double, std::milli>(now - last_time_update_).count();
+  has_last_time_update_ = playing;
+  last_time_update_ = now;
+  if (!playing || !measured || interval > kMaxInterval) return;
+
+  ++interval_count_;
+  interval_sum_ += interval;
+  interval_square_sum_ += interval * interval;
+  bool late = interval_count_ > kMinTypicalIntervals &&
+              interval > typical_interval_ * kLateIntervalFactor;
+  if (late) {
+    ++late_time_updates_;
+  } else if (interval_count_ > kMinTypicalIntervals) {
+    typical_interval_ += (interval - typical_interval_) *
+                         kTypicalIntervalWeight;
+  } else {
+    typical_interval_ = interval_sum_ / interval_count_;
+  }
+  if (representation_id_ < 0) return;
+
+  auto& representation = representations_[representation_id_];
+  ++representation.time_updates;
+  if (late) ++representation.late_time_updates;
+}
+
+void PlatformHealth::AddError(int32_t error) {
+  AutoLock lock(lock_);
+  ++error_count_;
+  last_error_ = error;
+}
+
+void PlatformHealth::AddBuffering(double video_ahead) {
+  AutoLock lock(lock_);
+  ++buffering_count_;
+  if (video_ahead < kUnderrunVideoAhead) return;
+
+  ++underrun_count_;
+  LOG_INFO("The platform underran with %f [s] of video appended, "
+           "representation: %d", video_ahead, representation_id_);
+  if (representation_id_ >= 0)
+    ++representations_[representation_id_].underruns;
+}
+
+bool PlatformHealth::IsOverloaded(int32_t id) const {
+  AutoLock lock(lock_);
+  auto it = representations_.find(id);
+  if (it == representations_.end()) return false;
+
+  const auto& representation = it->second;
+  return representation.underruns >= kMaxUnderruns ||
+         (representation.time_updates >= kMinRepresentationTimeUpdates &&
+          representation.late_time_updates >
+              representation.time_updates * kMaxLateTimeUpdateRatio);
+}
+
+PlatformHealth::Report PlatformHealth::GetReport() const {
+  Report report;
+  AutoLock lock(lock_);
+  report.error_count = error_count_;
+  report.last_error = last_error_;
+  report.buffering_count = buffering_count_;
+  report.underrun_count = underrun_count_;
+  report.time_update_interval = 0.;
+  report.time_update_jitter = 0.;
+  if (interval_count_ > 0) {
+    double mean = interval_sum_ / interval_count_;
+    report.time_update_interval = mean;
+    report.time_update_jitter = std::sqrt(std::max(
+        interval_square_sum_ / interval_count_ - mean * mean, 0.));
+  }
+  report.late_time_updates = late_time_updates_;
+  return report;
+}
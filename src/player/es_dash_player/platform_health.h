@@ -0,0 +1,105 @@
+/*!
+ * platform_health.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_PLATFORM_HEALTH_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_PLATFORM_HEALTH_H_
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+
+#include "ppapi/utility/threading/lock.h"
+
+// Collects what NaCl Player tells about decoding and rendering: errors,
+// buffering events and the cadence of time updates. Buffering while video
+// is appended ahead of the playback position, or time updates coming late,
+// show the platform doesn't keep up, rather than the network or the
+// pipeline. These are counted for the video representation requested last,
+// so ABR can tell which ones the device can't play. NaCl Player doesn't
+// report dropped frames. Each player keeps its own one, as players of
+// a module play different content, and resets it when it starts a new
+// content. It's thread safe.
+class PlatformHealth {
+ public:
+  struct Report {
+    uint32_t error_count;
+    // The last MediaPlayerError code, 0 if there was none.
+    int32_t last_error;
+    // Buffering started during playback.
+    uint32_t buffering_count;
+    // Buffering started with video appended ahead, see AddBuffering().
+    uint32_t underrun_count;
+    // Intervals between time updates during playback, in milliseconds.
+    double time_update_interval;
+    // A standard deviation of the intervals, in milliseconds.
+    double time_update_jitter;
+    uint32_t late_time_updates;
+  };
+
+  PlatformHealth();
+
+  void Reset();
+
+  // Sets the video representation played from now on, -1 if there's none.
+  void SetRepresentation(int32_t id);
+
+  // Counts a time update of NaCl Player. Intervals are measured between
+  // updates which come while the media plays, i.e. not paused, seeking nor
+  // in a trick mode.
+  void AddTimeUpdate(bool playing);
+  void AddError(int32_t error);
+  // Counts buffering started during playback, with video_ahead seconds of
+  // video appended ahead of the playback position. The platform underran
+  // if there was enough of it.
+  void AddBuffering(double video_ahead);
+
+  // Checks if the platform doesn't keep up with the video representation:
+  // it underran or too many time updates came late while it was played.
+  bool IsOverloaded(int32_t id) const;
+
+  Report GetReport() const;
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct RepresentationHealth {
+    uint32_t time_updates;
+    uint32_t late_time_updates;
+    uint32_t underruns;
+  };
+
+  mutable pp::Lock lock_;
+  int32_t representation_id_;
+  uint32_t error_count_;
+  int32_t last_error_;
+  uint32_t buffering_count_;
+  uint32_t underrun_count_;
+  bool has_last_time_update_;
+  Clock::time_point last_time_update_;
+  uint32_t interval_count_;
+  // Sums of intervals and their squares, in milliseconds.
+  double interval_sum_;
+  double interval_square_sum_;
+  // A moving average of intervals which weren't late, in milliseconds.
+  double typical_interval_;
+  uint32_t late_time_updates_;
+  std::map<int32_t, RepresentationHealth> representations_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_PLATFORM_HEALTH_H_
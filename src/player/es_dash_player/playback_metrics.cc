@@ -0,0 +1,194 @@
+/*!
+ * playback_metrics.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kPackets
+
+#include "playback_metrics.h"
+
+#include <algorithm>
+
+#include "common.h"
+#include "demuxer/stream_demuxer.h"
+
+using pp::AutoLock;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+constexpr size_t PlaybackMetrics::kDownloadTimeBuckets;
+constexpr size_t PlaybackMetrics::kMaxPendingDownloadSamples;
+const uint32_t PlaybackMetrics::kDownloadTimeBounds[] = {
+    250, 500, 1000, 2000, 4000};
+
+namespace {
+
+// The playback position is updated several times a second, a bigger change
+// is a jump rather than played media.
+constexpr double kMaxPlaybackStep = 1.0;  // in seconds
+
+}  // namespace
+
+PlaybackMetrics::PlaybackMetrics()
+    : bytes_downloaded_(0),
+      segments_downloaded_(0),
+      download_time_histogram_(),
+      packets_appended_(0),
+      packets_dropped_(0),
+      seek_count_(0),
+      seek_latency_total_(0.),
+      seek_latency_max_(0.),
+      rebuffer_count_(0),
+      rebuffer_duration_(0.),
+      rebuffering_(false),
+      rebuffer_start_(),
+      demuxer_cpu_time_base_(StreamDemuxer::GetCpuTime()),
+      cpu_report_base_(CpuProfiler::GetReport()),
+      main_thread_base_(MainThreadBudget::GetReport()),
+      played_time_(0.),
+      last_playback_position_(-1.),
+      stall_recoveries_(0) {}
+
+void PlaybackMetrics::Reset() {
+  AutoLock lock(lock_);
+  bytes_downloaded_ = 0;
+  segments_downloaded_ = 0;
+  download_time_histogram_.fill(0);
+  packets_appended_ = 0;
+  packets_dropped_ = 0;
+  seek_count_ = 0;
+  seek_latency_total_ = 0.;
+  seek_latency_max_ = 0.;
+  rebuffer_count_ = 0;
+  rebuffer_duration_ = 0.;
+  rebuffering_ = false;
+  demuxer_cpu_time_base_ = StreamDemuxer::GetCpuTime();
+  cpu_report_base_ = CpuProfiler::GetReport();
+  main_thread_base_ = MainThreadBudget::GetReport();
+  played_time_ = 0.;
+  last_playback_position_ = -1.;
+  stall_recoveries_ = 0;
+  download_samples_.clear();
+}
+
+void PlaybackMetrics::AddSegmentDownload(size_t bytes, double seconds) {
+  auto milliseconds = seconds * 1000.;
+  size_t bucket = std::upper_bound(
+      kDownloadTimeBounds, kDownloadTimeBounds + kDownloadTimeBuckets - 1,
+      milliseconds) - kDownloadTimeBounds;
+  AutoLock lock(lock_);
+  bytes_downloaded_ += bytes;
+  ++segments_downloaded_;
+  ++download_time_histogram_[bucket];
+}
+
+void PlaybackMetrics::AddDownloadSample(const DownloadSample& sample) {
+  AutoLock lock(lock_);
+  if (download_samples_.size() >= kMaxPendingDownloadSamples)
+    download_samples_.pop_front();
+  download_samples_.push_back(sample);
+}
+
+void PlaybackMetrics::AddAppendedPackets(size_t count) {
+  AutoLock lock(lock_);
+  packets_appended_ += count;
+}
+
+void PlaybackMetrics::AddDroppedPackets(size_t count) {
+  AutoLock lock(lock_);
+  packets_dropped_ += count;
+}
+
+void PlaybackMetrics::AddSeek(double milliseconds) {
+  AutoLock lock(lock_);
+  ++seek_count_;
+  seek_latency_total_ += milliseconds;
+  seek_latency_max_ = std::max(seek_latency_max_, milliseconds);
+}
+
+bool PlaybackMetrics::StartRebuffer() {
+  AutoLock lock(lock_);
+  if (rebuffering_) return false;
+  LOG_INFO("Rebuffering started");
+  rebuffering_ = true;
+  rebuffer_start_ = steady_clock::now();
+  ++rebuffer_count_;
+  return true;
+}
+
+bool PlaybackMetrics::EndRebuffer(double* seconds) {
+  AutoLock lock(lock_);
+  if (!rebuffering_) return false;
+  rebuffering_ = false;
+  *seconds = duration<double>(steady_clock::now() - rebuffer_start_).count();
+  rebuffer_duration_ += *seconds;
+  LOG_INFO("Rebuffering completed after %.3f [s]", *seconds);
+  return true;
+}
+
+void PlaybackMetrics::UpdatePlaybackPosition(double position) {
+  AutoLock lock(lock_);
+  double played = position - last_playback_position_;
+  if (last_playback_position_ >= 0. && played > 0. &&
+      played <= kMaxPlaybackStep)
+    played_time_ += played;
+  last_playback_position_ = position;
+}
+
+void PlaybackMetrics::AddStallRecovery() {
+  AutoLock lock(lock_);
+  ++stall_recoveries_;
+}
+
+PlaybackMetrics::Report PlaybackMetrics::GetReport() const {
+  Report report;
+  double cpu_time = StreamDemuxer::GetCpuTime();
+  auto cpu_report = CpuProfiler::GetReport();
+  AutoLock lock(lock_);
+  report.bytes_downloaded = bytes_downloaded_;
+  report.segments_downloaded = segments_downloaded_;
+  report.download_time_histogram = download_time_histogram_;
+  report.packets_appended = packets_appended_;
+  report.packets_dropped = packets_dropped_;
+  report.seek_count = seek_count_;
+  report.seek_latency_average =
+      seek_count_ > 0 ? seek_latency_total_ / seek_count_ : 0.;
+  report.seek_latency_max = seek_latency_max_;
+  report.rebuffer_count = rebuffer_count_;
+  report.rebuffer_duration = rebuffer_duration_;
+  if (rebuffering_) {
+    report.rebuffer_duration += duration<double>(
+        steady_clock::now() - rebuffer_start_).count();
+  }
+  report.demuxer_cpu_time = std::max(cpu_time - demuxer_cpu_time_base_, 0.);
+  for (size_t i = 0; i < cpu_report.size(); ++i) {
+    report.stage_cpu_time[i] = std::max(
+        cpu_report[i].cpu_time - cpu_report_base_[i].cpu_time, 0.);
+  }
+  report.played_time = played_time_;
+  report.stall_recoveries = stall_recoveries_;
+  report.main_thread = MainThreadBudget::GetReportSince(main_thread_base_);
+  return report;
+}
+
+std::vector<DownloadSample> PlaybackMetrics::TakeDownloadSamples() {
+  AutoLock lock(lock_);
+  std::vector<DownloadSample> samples(download_samples_.begin(),
+                                      download_samples_.end());
+  download_samples_.clear();
+  return samples;
+}
@@ -0,0 +1,126 @@
+/*!
+ * playback_metrics.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_PLAYBACK_METRICS_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_PLAYBACK_METRICS_H_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "ppapi/utility/threading/lock.h"
+
+#include "bandwidth_estimator.h"
+#include "cpu_profiler.h"
+#include "main_thread_budget.h"
+
+// Collects counters of the playback: segment downloads, appended and dropped
+// packets, seeks and rebuffers, for QoE reporting. Each player owns one,
+// reset when it starts a new content. Samples of single segment requests are
+// kept until they are taken, so they can be reported with their response
+// headers. It's thread safe.
+class PlaybackMetrics {
+ public:
+  // Segment download times are counted in buckets with these upper bounds
+  // (in milliseconds) and one more for longer downloads.
+  static constexpr size_t kDownloadTimeBuckets = 6;
+  static const uint32_t kDownloadTimeBounds[kDownloadTimeBuckets - 1];
+  // The oldest samples are dropped when more are waiting to be taken.
+  static constexpr size_t kMaxPendingDownloadSamples = 64;
+
+  struct Report {
+    uint64_t bytes_downloaded;
+    uint32_t segments_downloaded;
+    std::array<uint32_t, kDownloadTimeBuckets> download_time_histogram;
+    uint64_t packets_appended;
+    // Packets demuxed but not appended, e.g. because of a seek.
+    uint64_t packets_dropped;
+    uint32_t seek_count;
+    // Seek latencies, in milliseconds.
+    double seek_latency_average;
+    double seek_latency_max;
+    uint32_t rebuffer_count;
+    // Time spent rebuffering, including a rebuffer in progress, in seconds.
+    double rebuffer_duration;
+    // CPU time used by demuxers, in seconds.
+    double demuxer_cpu_time;
+    // CPU time used by each pipeline stage, in seconds.
+    std::array<double, static_cast<size_t>(CpuStage::kCount)> stage_cpu_time;
+    // Media played, in seconds.
+    double played_time;
+    // Stalled pipeline stages which were recovered, see
+    // EsDashPlayerController::RecoverStalls().
+    uint32_t stall_recoveries;
+    // Work on the main thread, which is shared by all players of the module.
+    MainThreadBudget::Report main_thread;
+  };
+
+  PlaybackMetrics();
+
+  void Reset();
+
+  void AddSegmentDownload(size_t bytes, double seconds);
+  void AddDownloadSample(const DownloadSample& sample);
+  void AddAppendedPackets(size_t count);
+  void AddDroppedPackets(size_t count);
+  void AddSeek(double milliseconds);
+  // Buffering started during playback, i.e. not after a startup or a seek.
+  // Returns false if a rebuffer is in progress already.
+  bool StartRebuffer();
+  // Buffering completed. Returns false if it wasn't a rebuffer, otherwise
+  // sets its duration.
+  bool EndRebuffer(double* seconds);
+  // Advances the played media by a change of the playback position. Jumps,
+  // e.g. seeks, are not counted.
+  void UpdatePlaybackPosition(double position);
+  void AddStallRecovery();
+
+  Report GetReport() const;
+
+  // Returns download samples added since the previous call.
+  std::vector<DownloadSample> TakeDownloadSamples();
+
+ private:
+  mutable pp::Lock lock_;
+  uint64_t bytes_downloaded_;
+  uint32_t segments_downloaded_;
+  std::array<uint32_t, kDownloadTimeBuckets> download_time_histogram_;
+  uint64_t packets_appended_;
+  uint64_t packets_dropped_;
+  uint32_t seek_count_;
+  double seek_latency_total_;
+  double seek_latency_max_;
+  uint32_t rebuffer_count_;
+  double rebuffer_duration_;
+  bool rebuffering_;
+  std::chrono::steady_clock::time_point rebuffer_start_;
+  // Demuxer CPU time at the last Reset().
+  double demuxer_cpu_time_base_;
+  CpuProfiler::Report cpu_report_base_;
+  MainThreadBudget::Report main_thread_base_;
+  double played_time_;
+  double last_playback_position_;
+  uint32_t stall_recoveries_;
+  std::deque<DownloadSample> download_samples_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_PLAYBACK_METRICS_H_
@@ -0,0 +1,154 @@
+/*!
+ * recording_es_backend.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#include "player/es_dash_player/recording_es_backend.h"
+
+#include "nacl_player/error_codes.h"
+
+using pp::AutoLock;
+using Samsung::NaClPlayer::ElementaryStreamListener;
+using Samsung::NaClPlayer::ErrorCodes;
+using Samsung::NaClPlayer::TimeTicks;
+
+class RecordingEsBackend::RecordingStream : public EsBackend::Stream {
+ public:
+  RecordingStream(RecordingEsBackend* backend, size_t index)
+      : backend_(backend), index_(index) {}
+
+  int32_t SetConfig(const AudioConfig&) override {
+    return CountConfig();
+  }
+
+  int32_t SetConfig(const VideoConfig&) override {
+    return CountConfig();
+  }
+
+  int32_t AppendPacket(const ElementaryStreamPacket& packet) override {
+    AutoLock critical_section(backend_->lock_);
+    auto& stats = backend_->stats_[index_];
+    ++stats.packets;
+    stats.bytes += packet.GetDataSize();
+    if (packet.IsEncrypted()) ++stats.encrypted_packets;
+    if (packet.IsKeyFrame()) ++stats.key_frames;
+    if (stats.first_pts < 0.) stats.first_pts = packet.GetPts();
+    stats.last_pts = packet.GetPts();
+    if (backend_->record_packets_) {
+      backend_->packets_[index_].push_back({packet.GetPts(), packet.GetDts(),
+          packet.GetDataSize(), packet.IsKeyFrame(), packet.IsEncrypted()});
+    }
+    return ErrorCodes::Success;
+  }
+
+  int32_t SetDrmInitData(const std::string&,
+                         const std::vector<uint8_t>&) override {
+    AutoLock critical_section(backend_->lock_);
+    ++backend_->stats_[index_].drm_init_data;
+    return ErrorCodes::Success;
+  }
+
+ private:
+  int32_t CountConfig() {
+    AutoLock critical_section(backend_->lock_);
+    ++backend_->stats_[index_].configs;
+    return ErrorCodes::Success;
+  }
+
+  RecordingEsBackend* backend_;
+  size_t index_;
+};
+
+RecordingEsBackend::RecordingEsBackend(bool record_packets)
+    : record_packets_(record_packets),
+      duration_(0.),
+      end_of_stream_(false) {}
+
+RecordingEsBackend::~RecordingEsBackend() = default;
+
+int32_t RecordingEsBackend::AddStream(StreamType type,
+    std::shared_ptr<ElementaryStreamListener> listener,
+    std::shared_ptr<Stream>* stream) {
+  auto index = static_cast<size_t>(type);
+  if (index >= kStreamCount) return ErrorCodes::BadArgument;
+
+  AutoLock critical_section(lock_);
+  stats_[index] = StreamStats();
+  stats_[index].added = true;
+  packets_[index].clear();
+  listeners_[index] = std::move(listener);
+  *stream = std::make_shared<RecordingStream>(this, index);
+  return ErrorCodes::Success;
+}
+
+int32_t RecordingEsBackend::SetDuration(TimeTicks duration) {
+  AutoLock critical_section(lock_);
+  duration_ = duration;
+  return ErrorCodes::Success;
+}
+
+int32_t RecordingEsBackend::SetEndOfStream() {
+  AutoLock critical_section(lock_);
+  end_of_stream_ = true;
+  return ErrorCodes::Success;
+}
+
+void RecordingEsBackend::NeedData(StreamType type, int32_t bytes_max) {
+  if (auto listener = GetListener(type)) listener->OnNeedData(bytes_max);
+}
+
+void RecordingEsBackend::SeekData(StreamType type, TimeTicks position) {
+  {
+    AutoLock critical_section(lock_);
+    end_of_stream_ = false;
+  }
+  if (auto listener = GetListener(type)) listener->OnSeekData(position);
+}
+
+RecordingEsBackend::StreamStats RecordingEsBackend::GetStats(
+    StreamType type) const {
+  auto index = static_cast<size_t>(type);
+  if (index >= kStreamCount) return StreamStats();
+  AutoLock critical_section(lock_);
+  return stats_[index];
+}
+
+std::vector<RecordingEsBackend::PacketRecord> RecordingEsBackend::GetPackets(
+    StreamType type) const {
+  auto index = static_cast<size_t>(type);
+  if (index >= kStreamCount) return {};
+  AutoLock critical_section(lock_);
+  return packets_[index];
+}
+
+TimeTicks RecordingEsBackend::GetDuration() const {
+  AutoLock critical_section(lock_);
+  return duration_;
+}
+
+bool RecordingEsBackend::IsEndOfStream() const {
+  AutoLock critical_section(lock_);
+  return end_of_stream_;
+}
+
+std::shared_ptr<ElementaryStreamListener> RecordingEsBackend::GetListener(
+    StreamType type) const {
+  auto index = static_cast<size_t>(type);
+  if (index >= kStreamCount) return nullptr;
+  AutoLock critical_section(lock_);
+  return listeners_[index];
+}
@@ -0,0 +1,100 @@
+/*!
+ * recording_es_backend.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_RECORDING_ES_BACKEND_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_RECORDING_ES_BACKEND_H_
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "ppapi/utility/threading/lock.h"
+
+#include "player/es_dash_player/es_backend.h"
+
+// Accepts everything StreamManager passes and only counts it, standing in
+// for NaCl Player when the pipeline runs headless, e.g. under a profiler or
+// sanitizers on a workstation. It never pushes back, so packets are
+// appended as fast as they are demuxed and scheduled. A driver can act as
+// the player with NeedData() and SeekData(). It must outlive streams added
+// to it, like an ESDataSource outlives StreamManagers. It's thread safe.
+class RecordingEsBackend : public EsBackend {
+ public:
+  struct PacketRecord {
+    Samsung::NaClPlayer::TimeTicks pts;
+    Samsung::NaClPlayer::TimeTicks dts;
+    uint32_t size;
+    bool key_frame;
+    bool encrypted;
+  };
+
+  struct StreamStats {
+    bool added = false;
+    uint32_t configs = 0;
+    uint32_t drm_init_data = 0;
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    uint64_t encrypted_packets = 0;
+    uint64_t key_frames = 0;
+    Samsung::NaClPlayer::TimeTicks first_pts = -1.;
+    Samsung::NaClPlayer::TimeTicks last_pts = -1.;
+  };
+
+  // Packets are also recorded one by one if record_packets is set, which
+  // costs an allocation every now and then.
+  explicit RecordingEsBackend(bool record_packets = false);
+  ~RecordingEsBackend() override;
+
+  int32_t AddStream(
+      StreamType type,
+      std::shared_ptr<Samsung::NaClPlayer::ElementaryStreamListener> listener,
+      std::shared_ptr<Stream>* stream) override;
+  int32_t SetDuration(Samsung::NaClPlayer::TimeTicks duration) override;
+  int32_t SetEndOfStream() override;
+
+  // Passes OnNeedData() or OnSeekData() to the listener of the stream, like
+  // NaCl Player does. Must not be called with a lock of the listener held.
+  void NeedData(StreamType type, int32_t bytes_max);
+  void SeekData(StreamType type, Samsung::NaClPlayer::TimeTicks position);
+
+  StreamStats GetStats(StreamType type) const;
+  std::vector<PacketRecord> GetPackets(StreamType type) const;
+  Samsung::NaClPlayer::TimeTicks GetDuration() const;
+  bool IsEndOfStream() const;
+
+ private:
+  class RecordingStream;
+
+  static constexpr size_t kStreamCount =
+      static_cast<size_t>(StreamType::MaxStreamTypes);
+
+  std::shared_ptr<Samsung::NaClPlayer::ElementaryStreamListener> GetListener(
+      StreamType type) const;
+
+  const bool record_packets_;
+  mutable pp::Lock lock_;
+  std::array<StreamStats, kStreamCount> stats_;
+  std::array<std::vector<PacketRecord>, kStreamCount> packets_;
+  std::array<std::shared_ptr<Samsung::NaClPlayer::ElementaryStreamListener>,
+             kStreamCount> listeners_;
+  Samsung::NaClPlayer::TimeTicks duration_;
+  bool end_of_stream_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_RECORDING_ES_BACKEND_H_
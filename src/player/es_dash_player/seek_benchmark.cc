@@ -0,0 +1,545 @@
+/*!
+ * seek_benchmark.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include "player/es_dash_player/seek_benchmark.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <utility>
+
+#include "common.h"
+#include "dash/dash_manifest.h"
+#include "dash/media_stream.h"
+#include "dash/media_segment_sequence.h"
+#include "dash/util.h"
+#include "player/es_dash_player/benchmark_pipeline.h"
+
+#include "abr_engine.h"
+#include "recording_es_backend.h"
+
+using Samsung::NaClPlayer::TimeTicks;
+using std::chrono::steady_clock;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The link segments are replayed over, see NetworkSimulation::DefaultTraces.
+const char kTraceName[] = "dsl";
+
+enum class ScenarioKind {
+  kRandomSeeks,
+  kSkips,
+  kSeeksDuringSeeks,
+  kRepresentationChanges
+};
+
+struct Scenario {
+  const char* name;
+  ScenarioKind kind;
+};
+
+constexpr Scenario kScenarios[] = {
+  {"randomSeek", ScenarioKind::kRandomSeeks},
+  {"skip", ScenarioKind::kSkips},
+  {"seekDuringSeek", ScenarioKind::kSeeksDuringSeeks},
+  {"representationChange", ScenarioKind::kRepresentationChanges},
+};
+
+constexpr size_t kSeeksPerScenario = 12;
+// Seek positions are reproducible between runs.
+constexpr uint32_t kRandomSeed = 1234;
+// Skips are made one after another from kSkipStart, in a loop.
+constexpr TimeTicks kSkips[] = {10., -5., 30., -10.};  // seconds
+constexpr TimeTicks kSkipStart = 60.;  // seconds
+// Seeks are made below that position of longer content.
+constexpr TimeTicks kMaxContentTime = 600.;  // seconds
+// Like in EsDashPlayerController::GetSeekTarget().
+constexpr TimeTicks kSeekEndMargin = 0.25;  // seconds
+// A seek is superseded after a segment was served for it, or after that
+// many steps if none was.
+constexpr uint32_t kSupersedeSteps = 50;
+// A seek which appends no keyframe or audio within that much of real time
+// is counted as timed out.
+constexpr double kSeekTimeout = 20.;  // seconds
+// After a seek streams download segments up to their threshold before the
+// next one, at least for kMinSettleSteps and at most for kSettleTimeout.
+constexpr uint32_t kMinSettleSteps = 10;
+constexpr double kSettleTimeout = 5.;  // seconds
+
+// Segment addressing and encryption of the content, detected from elements
+// of its manifest.
+string DetectContentType(const string& mpd) {
+  string type;
+  if (mpd.find("<SegmentTimeline") != string::npos)
+    type = "segmentTimeline";
+  else if (mpd.find("<SegmentTemplate") != string::npos)
+    type = "segmentTemplate";
+  else if (mpd.find("<SegmentList") != string::npos)
+    type = "segmentList";
+  else
+    type = "segmentBase";
+  bool encrypted = mpd.find("<ContentProtection") != string::npos;
+  return type + (encrypted ? "/encrypted" : "/clear");
+}
+
+}  // anonymous namespace
+
+// Makes the seeks of a scenario on a BenchmarkPipeline, driven by Step()
+// calls on the benchmark thread.
+class SeekBenchmark::Session {
+ public:
+  Session(const pp::InstanceHandle& instance, DashManifest* manifest,
+          ReplayCache* replay_cache, TimeTicks content_end,
+          const Scenario& scenario, bool measured)
+      : manifest_(manifest),
+        replay_cache_(replay_cache),
+        content_end_(content_end),
+        scenario_(scenario),
+        measured_(measured),
+        video_ids_{{-1, -1}},
+        video_index_(0),
+        pipeline_(instance, manifest, replay_cache),
+        playback_time_(0.),
+        phase_(Phase::kStarting),
+        next_operation_(0),
+        steps_(0),
+        superseded_time_(0.),
+        link_start_(0.),
+        misses_start_(0),
+        keyframes_start_(0),
+        audio_packets_start_(0),
+        keyframe_ms_(-1.),
+        keyframe_processing_ms_(0.),
+        audio_ms_(-1.) {
+    PlanOperations();
+  }
+
+  // Creates the pipeline, returns false if the content can't be used by
+  // the scenario.
+  bool Start() {
+    vector<VideoStream> video_streams = manifest_->GetVideoStreams();
+    vector<AudioStream> audio_streams = manifest_->GetAudioStreams();
+    if (video_streams.empty()) {
+      LOG_ERROR("No video streams");
+      return false;
+    }
+    const VideoStream& first = video_streams.front();
+    video_ids_[0] = first.description.id;
+    for (const auto& representation : video_streams) {
+      if (representation.description.id != first.description.id &&
+          IsSameKind(representation, first)) {
+        video_ids_[1] = representation.description.id;
+        break;
+      }
+    }
+    if (scenario_.kind == ScenarioKind::kRepresentationChanges &&
+        video_ids_[1] < 0) {
+      LOG_INFO("%s needs two video representations", scenario_.name);
+      return false;
+    }
+
+    int32_t audio_id =
+        audio_streams.empty() ? -1 : audio_streams.front().description.id;
+    if (!pipeline_.Start(video_ids_[0], audio_id)) return false;
+    StartMeasurement();
+    return true;
+  }
+
+  // Runs due stream tasks, updates buffers and moves on with the seeks.
+  // Returns false when the scenario is done.
+  bool Step() {
+    pipeline_.Step(playback_time_);
+    ++steps_;
+
+    switch (phase_) {
+      case Phase::kStarting:
+      case Phase::kSeeking:
+        CheckSeek();
+        break;
+      case Phase::kSuperseding:
+        if (replay_cache_->Time() > link_start_ ||
+            steps_ >= kSupersedeSteps) {
+          // The next seek is requested before the platform seek completes.
+          StartMeasurement();
+          pipeline_.CancelSeek();
+          pipeline_.CompletePlatformSeek(superseded_time_);
+          Seek(operations_[next_operation_ - 1].time);
+        }
+        break;
+      case Phase::kSettling:
+        if (steps_ >= kMinSettleSteps &&
+            (pipeline_.IsSettled() ||
+             MillisecondsSince(settle_start_) > kSettleTimeout * 1e3))
+          return StartNextOperation();
+        break;
+    }
+    return true;
+  }
+
+  const Samples& samples() const { return samples_; }
+
+ private:
+  enum class Phase {
+    kStarting,
+    kSuperseding,
+    kSeeking,
+    kSettling
+  };
+
+  struct Operation {
+    TimeTicks time;
+    // A seek made before and superseded by this one, if it's not negative.
+    TimeTicks superseded_time;
+    // The video representation is changed right before the seek.
+    bool change_representation;
+  };
+
+  void PlanOperations() {
+    std::mt19937 random(kRandomSeed);
+    TimeTicks last_position = std::max(content_end_ - kSeekEndMargin, 0.);
+    std::uniform_real_distribution<TimeTicks> position(0., last_position);
+    TimeTicks skip_position = std::min(kSkipStart, last_position / 2.);
+    for (size_t i = 0; i < kSeeksPerScenario; ++i) {
+      Operation operation = {position(random), -1., false};
+      switch (scenario_.kind) {
+        case ScenarioKind::kRandomSeeks:
+          break;
+        case ScenarioKind::kSkips:
+          skip_position += kSkips[i % (sizeof(kSkips) / sizeof(kSkips[0]))];
+          skip_position = std::min(std::max(skip_position, 0.),
+                                   last_position);
+          operation.time = skip_position;
+          break;
+        case ScenarioKind::kSeeksDuringSeeks:
+          operation.superseded_time = position(random);
+          break;
+        case ScenarioKind::kRepresentationChanges:
+          operation.change_representation = true;
+          break;
+      }
+      operations_.push_back(operation);
+    }
+  }
+
+  bool StartNextOperation() {
+    if (next_operation_ >= operations_.size()) return false;
+    const Operation& operation = operations_[next_operation_++];
+    if (operation.change_representation) {
+      video_index_ = 1 - video_index_;
+      pipeline_.ChangeRepresentation(StreamType::Video,
+                                     video_ids_[video_index_], false);
+    }
+    if (operation.superseded_time >= 0.) {
+      superseded_time_ = PrepareSeek(operation.superseded_time);
+      link_start_ = replay_cache_->Time();
+      steps_ = 0;
+      phase_ = Phase::kSuperseding;
+      return true;
+    }
+    StartMeasurement();
+    Seek(operation.time);
+    return true;
+  }
+
+  // Clamps the position like EsDashPlayerController::Seek().
+  TimeTicks PrepareSeek(TimeTicks time) {
+    if (time > content_end_ - kSeekEndMargin)
+      time = content_end_ - kSeekEndMargin;
+    if (time < kEps) time = 0.;
+    return pipeline_.PrepareSeek(time);
+  }
+
+  void Seek(TimeTicks time) {
+    TimeTicks to_time = PrepareSeek(time);
+    pipeline_.CompletePlatformSeek(to_time);
+    playback_time_ = to_time;
+    steps_ = 0;
+    phase_ = Phase::kSeeking;
+  }
+
+  void StartMeasurement() {
+    seek_start_ = steady_clock::now();
+    link_start_ = replay_cache_->Time();
+    misses_start_ = replay_cache_->Misses();
+    keyframes_start_ =
+        pipeline_.backend()->GetStats(StreamType::Video).key_frames;
+    audio_packets_start_ =
+        pipeline_.backend()->GetStats(StreamType::Audio).packets;
+    keyframe_ms_ = -1.;
+    audio_ms_ = -1.;
+  }
+
+  // Takes times of the first keyframe and audio packet appended since the
+  // seek started.
+  void CheckSeek() {
+    double processing_ms = MillisecondsSince(seek_start_);
+    double latency_ms = processing_ms +
+        (replay_cache_->Time() - link_start_) * 1e3;
+    RecordingEsBackend* backend = pipeline_.backend();
+    if (keyframe_ms_ < 0. &&
+        backend->GetStats(StreamType::Video).key_frames > keyframes_start_) {
+      keyframe_ms_ = latency_ms;
+      keyframe_processing_ms_ = processing_ms;
+    }
+    bool has_audio = pipeline_.HasAudio();
+    if (has_audio && audio_ms_ < 0. &&
+        backend->GetStats(StreamType::Audio).packets > audio_packets_start_)
+      audio_ms_ = latency_ms;
+
+    bool done = keyframe_ms_ >= 0. && (!has_audio || audio_ms_ >= 0.);
+    bool timed_out = !done && processing_ms > kSeekTimeout * 1e3;
+    if (!done && !timed_out) return;
+
+    if (phase_ == Phase::kSeeking && measured_) {
+      ++samples_.seeks;
+      if (timed_out) ++samples_.timeouts;
+      if (keyframe_ms_ >= 0.) {
+        samples_.keyframe.push_back(keyframe_ms_);
+        samples_.keyframe_processing.push_back(keyframe_processing_ms_);
+      }
+      if (audio_ms_ >= 0.) samples_.audio.push_back(audio_ms_);
+      samples_.cache_misses += replay_cache_->Misses() - misses_start_;
+    } else if (timed_out) {
+      LOG_ERROR("%s: playback didn't start", scenario_.name);
+    }
+    settle_start_ = steady_clock::now();
+    steps_ = 0;
+    phase_ = Phase::kSettling;
+  }
+
+  DashManifest* manifest_;
+  ReplayCache* replay_cache_;
+  TimeTicks content_end_;
+  const Scenario& scenario_;
+  bool measured_;
+  vector<Operation> operations_;
+  // The first video representation and an alternative of it, -1 if there
+  // is none.
+  std::array<int32_t, 2> video_ids_;
+  size_t video_index_;
+
+  BenchmarkPipeline pipeline_;
+  TimeTicks playback_time_;
+
+  Phase phase_;
+  size_t next_operation_;
+  uint32_t steps_;
+  TimeTicks superseded_time_;
+  steady_clock::time_point seek_start_;
+  steady_clock::time_point settle_start_;
+  double link_start_;
+  uint32_t misses_start_;
+  uint64_t keyframes_start_;
+  uint64_t audio_packets_start_;
+  double keyframe_ms_;
+  double keyframe_processing_ms_;
+  double audio_ms_;
+  Samples samples_;
+};
+
+SeekBenchmark::SeekBenchmark(const pp::InstanceHandle& instance)
+    : instance_(instance),
+      cc_factory_(this),
+      running_(false),
+      cancelled_(false),
+      next_manifest_(0),
+      content_end_(0.),
+      scenario_(0),
+      measured_(false),
+      thread_(instance) {
+  thread_.Start();
+}
+
+SeekBenchmark::~SeekBenchmark() {
+  cancelled_ = true;
+  thread_.Join();
+}
+
+bool SeekBenchmark::Start(const vector<string>& manifest_urls,
+                          const ResultCallback& callback) {
+  if (running_.exchange(true)) {
+    LOG_ERROR("A seek benchmark is running already");
+    return false;
+  }
+  manifest_urls_ = manifest_urls;
+  callback_ = callback;
+  thread_.message_loop().PostWork(cc_factory_.NewCallback(
+      &SeekBenchmark::RunOnBenchmarkThread));
+  return true;
+}
+
+void SeekBenchmark::RunOnBenchmarkThread(int32_t) {
+  for (const auto& trace : NetworkSimulation::DefaultTraces()) {
+    if (trace.name == kTraceName)
+      replay_cache_ = std::make_shared<ReplayCache>(trace);
+  }
+  auto replay_cache = replay_cache_;
+  SetLocalDataSource([replay_cache](const SegmentDescriptor& location,
+                                    vector<uint8_t>* data) {
+    return replay_cache->Read(location, data);
+  });
+  next_manifest_ = 0;
+  samples_.clear();
+  StartNextRun();
+}
+
+void SeekBenchmark::StartNextRun() {
+  // Each scenario runs twice, first to fill the replay cache.
+  if (session_) {
+    if (measured_) {
+      auto& samples = samples_[{content_type_, kScenarios[scenario_].name}];
+      const Samples& session_samples = session_->samples();
+      ++samples.contents;
+      samples.seeks += session_samples.seeks;
+      samples.timeouts += session_samples.timeouts;
+      samples.cache_misses += session_samples.cache_misses;
+      for (auto member : {&Samples::keyframe, &Samples::audio,
+                          &Samples::keyframe_processing}) {
+        (samples.*member).insert((samples.*member).end(),
+                                 (session_samples.*member).begin(),
+                                 (session_samples.*member).end());
+      }
+      ++scenario_;
+    }
+    measured_ = !measured_;
+    session_.reset();
+  }
+
+  constexpr size_t kScenarioCount =
+      sizeof(kScenarios) / sizeof(kScenarios[0]);
+  while (!cancelled_) {
+    if (!manifest_ || scenario_ >= kScenarioCount) {
+      if (!LoadNextManifest()) break;
+    }
+    session_ = MakeUnique<Session>(instance_, manifest_.get(),
+        replay_cache_.get(), content_end_, kScenarios[scenario_], measured_);
+    if (session_->Start()) {
+      thread_.message_loop().PostWork(cc_factory_.NewCallback(
+          &SeekBenchmark::StepOnBenchmarkThread));
+      return;
+    }
+    session_.reset();
+    measured_ = false;
+    ++scenario_;
+  }
+  Finish();
+}
+
+bool SeekBenchmark::LoadNextManifest() {
+  manifest_.reset();
+  replay_cache_->Clear();
+  while (!cancelled_ && next_manifest_ < manifest_urls_.size()) {
+    const string& url = manifest_urls_[next_manifest_++];
+    string mpd;
+    if (!DashManifest::DownloadManifest(url, &mpd)) {
+      LOG_ERROR("Failed to download %s", url.c_str());
+      continue;
+    }
+    manifest_ = DashManifest::ParseMPD(url, mpd);
+    if (!manifest_) {
+      LOG_ERROR("Failed to parse %s", url.c_str());
+      continue;
+    }
+    double duration = ParseDurationToSeconds(manifest_->GetDuration());
+    if (manifest_->IsDynamic() || duration <= 0.) {
+      LOG_ERROR("Only static content with a duration can be used: %s",
+                url.c_str());
+      manifest_.reset();
+      continue;
+    }
+    manifest_->LoadSegmentIndexes();
+    content_end_ = std::min(duration, kMaxContentTime);
+    content_type_ = DetectContentType(mpd);
+    scenario_ = 0;
+    measured_ = false;
+    LOG_INFO("Seek benchmark of %s (%s)", url.c_str(), content_type_.c_str());
+    return true;
+  }
+  return false;
+}
+
+void SeekBenchmark::StepOnBenchmarkThread(int32_t) {
+  if (cancelled_) {
+    Finish();
+    return;
+  }
+  // Demuxer callbacks are dispatched by the message loop of this thread, so
+  // it's not blocked between steps.
+  if (session_->Step()) {
+    thread_.message_loop().PostWork(cc_factory_.NewCallback(
+        &SeekBenchmark::StepOnBenchmarkThread));
+  } else {
+    thread_.message_loop().PostWork(cc_factory_.NewCallback(
+        &SeekBenchmark::StartNextRunOnBenchmarkThread));
+  }
+}
+
+void SeekBenchmark::StartNextRunOnBenchmarkThread(int32_t) {
+  StartNextRun();
+}
+
+void SeekBenchmark::Finish() {
+  session_.reset();
+  manifest_.reset();
+  SetLocalDataSource(nullptr);
+  replay_cache_.reset();
+
+  for (auto& entry : samples_) {
+    if (cancelled_) break;
+    Samples& samples = entry.second;
+    Result result = Result();
+    result.content_type = entry.first.first;
+    result.scenario = entry.first.second;
+    result.contents = samples.contents;
+    result.seeks = samples.seeks;
+    result.timeouts = samples.timeouts;
+    result.cache_misses = samples.cache_misses;
+    std::sort(samples.keyframe.begin(), samples.keyframe.end());
+    std::sort(samples.audio.begin(), samples.audio.end());
+    std::sort(samples.keyframe_processing.begin(),
+              samples.keyframe_processing.end());
+    result.keyframe_p50 = Percentile(samples.keyframe, 50.);
+    result.keyframe_p90 = Percentile(samples.keyframe, 90.);
+    result.keyframe_max = Percentile(samples.keyframe, 100.);
+    result.audio_p50 = Percentile(samples.audio, 50.);
+    result.audio_p90 = Percentile(samples.audio, 90.);
+    result.audio_max = Percentile(samples.audio, 100.);
+    result.keyframe_processing_p50 =
+        Percentile(samples.keyframe_processing, 50.);
+    LOG_INFO("%s %s: %u seeks (%u timed out, %u cache misses), keyframe "
+             "p50: %.1f p90: %.1f max: %.1f [ms] (processing p50: %.1f "
+             "[ms]), audio p50: %.1f p90: %.1f max: %.1f [ms]",
+             result.content_type.c_str(), result.scenario.c_str(),
+             result.seeks, result.timeouts, result.cache_misses,
+             result.keyframe_p50, result.keyframe_p90, result.keyframe_max,
+             result.keyframe_processing_p50, result.audio_p50,
+             result.audio_p90, result.audio_max);
+    if (callback_) callback_(result);
+  }
+  samples_.clear();
+  manifest_urls_.clear();
+  callback_ = nullptr;
+  running_ = false;
+}
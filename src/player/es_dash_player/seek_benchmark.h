@@ -0,0 +1,148 @@
+/*!
+ * seek_benchmark.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_SEEK_BENCHMARK_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_SEEK_BENCHMARK_H_
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/simple_thread.h"
+
+#include "player/es_dash_player/network_simulation.h"
+
+class DashManifest;
+class ReplayCache;
+
+// Measures seek latency of the whole pipeline: StreamManagers, their
+// demuxers and PacketsManager, with a RecordingEsBackend standing in for
+// NaCl Player. Stream tasks run on a SimulatedExecutor, whose clock follows
+// a simulated network link.
+//
+// Segments are served from memory by a LocalDataSource: a resource is
+// downloaded for real the first time it's requested and replayed
+// afterwards, each time taking the time of the link (the built-in "dsl"
+// trace of NetworkSimulation). So every scenario runs twice, the first run
+// only fills the replay cache, and the second one is measured with a fresh
+// pipeline, so segment caches of streams don't help it.
+//
+// Scenarios: seeks to random positions, short skips forward and backward,
+// seeks made while the previous one is in progress (measured from the last
+// one) and seeks right after a change of the video representation. Each
+// seek measures time to the first video keyframe and to the first audio
+// packet appended after it: real processing time plus simulated network
+// time. Distributions are reported per content type, which is detected from
+// the manifest: segment addressing (SegmentBase, SegmentList,
+// SegmentTemplate with or without a SegmentTimeline) and encryption.
+class SeekBenchmark {
+ public:
+  struct Result {
+    // E.g. "segmentTimeline/encrypted".
+    std::string content_type;
+    std::string scenario;
+    // Manifests of the content type.
+    uint32_t contents;
+    uint32_t seeks;
+    // Seeks which didn't append a keyframe or audio within a time limit.
+    uint32_t timeouts;
+    // Requests not found in the replay cache during measured seeks, which
+    // made them wait for a real download.
+    uint32_t cache_misses;
+    // Time to the first keyframe appended after a seek, in milliseconds.
+    double keyframe_p50;
+    double keyframe_p90;
+    double keyframe_max;
+    // Time to the first audio packet appended after a seek.
+    double audio_p50;
+    double audio_p90;
+    double audio_max;
+    // The processing part of the time to the first keyframe, i.e. without
+    // the simulated network.
+    double keyframe_processing_p50;
+  };
+
+  // Called once per content type and scenario when all manifests are
+  // done, on the benchmark thread.
+  typedef std::function<void(const Result&)> ResultCallback;
+
+  explicit SeekBenchmark(const pp::InstanceHandle& instance);
+  ~SeekBenchmark();
+
+  // Starts a benchmark of the given manifests, unless one is running
+  // already.
+  bool Start(const std::vector<std::string>& manifest_urls,
+             const ResultCallback& callback);
+
+  bool IsRunning() const { return running_; }
+
+ private:
+  class Session;
+
+  // Samples of a content type and scenario.
+  struct Samples {
+    uint32_t contents = 0;
+    uint32_t seeks = 0;
+    uint32_t timeouts = 0;
+    uint32_t cache_misses = 0;
+    std::vector<double> keyframe;
+    std::vector<double> audio;
+    std::vector<double> keyframe_processing;
+  };
+
+  void RunOnBenchmarkThread(int32_t);
+  // Starts the next run of a scenario, moving to the next manifest when
+  // all scenarios of the current one are done.
+  void StartNextRun();
+  void StartNextRunOnBenchmarkThread(int32_t);
+  bool LoadNextManifest();
+  void StepOnBenchmarkThread(int32_t);
+  // Reports results.
+  void Finish();
+
+  pp::InstanceHandle instance_;
+  pp::CompletionCallbackFactory<SeekBenchmark> cc_factory_;
+  std::atomic<bool> running_;
+  std::atomic<bool> cancelled_;
+
+  // Used on the benchmark thread while a benchmark runs.
+  std::vector<std::string> manifest_urls_;
+  size_t next_manifest_;
+  ResultCallback callback_;
+  std::shared_ptr<ReplayCache> replay_cache_;
+  std::unique_ptr<DashManifest> manifest_;
+  std::string content_type_;
+  double content_end_;
+  size_t scenario_;
+  // Whether the current run of the scenario is the measured one.
+  bool measured_;
+  std::unique_ptr<Session> session_;
+  // Keyed by content type and scenario.
+  std::map<std::pair<std::string, std::string>, Samples> samples_;
+
+  // Declared last, so it's joined before other members are destroyed.
+  pp::SimpleThread thread_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_SEEK_BENCHMARK_H_
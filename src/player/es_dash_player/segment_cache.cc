@@ -0,0 +1,157 @@
+/*!
+ * segment_cache.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kNet
+
+#include "segment_cache.h"
+
+#include "libdash/libdash.h"
+
+#include "common.h"
+#include "dash/media_segment_sequence.h"
+
+using pp::AutoLock;
+
+SegmentCache::SegmentCache(size_t byte_budget)
+    : byte_budget_(byte_budget),
+      cached_bytes_(0),
+      usage_(MemoryConsumer::kSegmentCache),
+      hits_(0),
+      misses_(0) {
+  pressure_listener_ = MemoryGovernor::AddPressureListener(
+      [this](MemoryPressure pressure) { OnMemoryPressure(pressure); });
+}
+
+SegmentCache::~SegmentCache() {
+  MemoryGovernor::RemovePressureListener(pressure_listener_);
+}
+
+std::string SegmentCache::KeyFor(dash::mpd::ISegment* segment) {
+  if (!segment) return std::string();
+
+  auto chunk = static_cast<dash::network::IChunk*>(segment);
+  std::string key = chunk->AbsoluteURI();
+  if (chunk->HasByteRange()) key += "#" + chunk->Range();
+  return key;
+}
+
+std::string SegmentCache::KeyFor(const SegmentDescriptor& segment) {
+  if (segment.url.empty() || segment.range.empty()) return segment.url;
+
+  return segment.url + "#" + segment.range;
+}
+
+bool SegmentCache::Get(const std::string& key, std::vector<uint8_t>* out) {
+  AutoLock lock(lock_);
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    ++misses_;
+    return false;
+  }
+
+  ++hits_;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  *out = it->second->data;
+  LOG_DEBUG("Segment cache hit: %s, hits: %llu misses: %llu", key.c_str(),
+            static_cast<unsigned long long>(hits_),
+            static_cast<unsigned long long>(misses_));
+  return true;
+}
+
+bool SegmentCache::Contains(const std::string& key) const {
+  AutoLock lock(lock_);
+  return index_.count(key) > 0;
+}
+
+void SegmentCache::Put(const std::string& key,
+                       const std::vector<uint8_t>& data, bool pinned) {
+  if (key.empty()) return;
+
+  AutoLock lock(lock_);
+  if (!pinned && data.size() > MemoryGovernor::ScaleLimit(byte_budget_))
+    return;
+
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    cached_bytes_ -= it->second->data.size();
+    pinned = pinned || it->second->pinned;
+    entries_.erase(it->second);
+    index_.erase(it);
+  }
+
+  entries_.push_front(Entry{key, data, pinned});
+  index_[key] = entries_.begin();
+  cached_bytes_ += data.size();
+  EvictOverBudget();
+  usage_.Set(cached_bytes_);
+}
+
+void SegmentCache::CopyTo(SegmentCache* destination) const {
+  if (!destination || destination == this) return;
+
+  AutoLock lock(lock_);
+  // The least recently used entries first, so they end up last in
+  // destination as well.
+  for (auto it = entries_.rbegin(); it != entries_.rend(); ++it)
+    destination->Put(it->key, it->data, it->pinned);
+}
+
+void SegmentCache::SetByteBudget(size_t byte_budget) {
+  AutoLock lock(lock_);
+  byte_budget_ = byte_budget;
+  EvictOverBudget();
+  usage_.Set(cached_bytes_);
+}
+
+uint64_t SegmentCache::Hits() const {
+  AutoLock lock(lock_);
+  return hits_;
+}
+
+uint64_t SegmentCache::Misses() const {
+  AutoLock lock(lock_);
+  return misses_;
+}
+
+size_t SegmentCache::CachedBytes() const {
+  AutoLock lock(lock_);
+  return cached_bytes_;
+}
+
+void SegmentCache::EvictOverBudget() {
+  size_t byte_budget = MemoryGovernor::ScaleLimit(byte_budget_);
+  auto it = entries_.end();
+  while (cached_bytes_ > byte_budget && it != entries_.begin()) {
+    --it;
+    if (it->pinned) continue;
+
+    cached_bytes_ -= it->data.size();
+    index_.erase(it->key);
+    it = entries_.erase(it);
+  }
+}
+
+void SegmentCache::OnMemoryPressure(MemoryPressure pressure) {
+  if (pressure == MemoryPressure::kNone) return;
+
+  AutoLock lock(lock_);
+  EvictOverBudget();
+  usage_.Set(cached_bytes_);
+}
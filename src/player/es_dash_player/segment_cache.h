@@ -0,0 +1,99 @@
+/*!
+ * segment_cache.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_SEGMENT_CACHE_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_SEGMENT_CACHE_H_
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ppapi/utility/threading/lock.h"
+
+#include "memory_governor.h"
+
+namespace dash {
+namespace mpd {
+class ISegment;
+}
+}
+
+struct SegmentDescriptor;
+
+// A bounded LRU cache of downloaded segments, keyed by URL and byte range.
+// Allows to rewind or switch back to a recently used representation without
+// downloading the same data again. The budget shrinks under memory pressure
+// (see MemoryGovernor::ScaleLimit()). It's thread safe.
+class SegmentCache {
+ public:
+  explicit SegmentCache(size_t byte_budget);
+  ~SegmentCache();
+
+  // Returns a key identifying segment data or an empty string if segment is
+  // null or has no URL.
+  static std::string KeyFor(dash::mpd::ISegment* segment);
+  static std::string KeyFor(const SegmentDescriptor& segment);
+
+  // Copies cached data to out. Returns false if key is not cached.
+  bool Get(const std::string& key, std::vector<uint8_t>* out);
+
+  // Checks if key is cached, without counting it as a hit or a miss.
+  bool Contains(const std::string& key) const;
+
+  // Stores a copy of data, evicting least recently used entries to keep
+  // within the budget. Pinned entries (i.e. init segments) are never evicted.
+  void Put(const std::string& key, const std::vector<uint8_t>& data,
+           bool pinned = false);
+
+  // Stores copies of all entries in destination, keeping their order of use
+  // and pinning, e.g. to hand segments downloaded in advance to a stream.
+  void CopyTo(SegmentCache* destination) const;
+
+  void SetByteBudget(size_t byte_budget);
+
+  uint64_t Hits() const;
+  uint64_t Misses() const;
+  size_t CachedBytes() const;
+
+ private:
+  struct Entry {
+    std::string key;
+    std::vector<uint8_t> data;
+    bool pinned;
+  };
+
+  // lock_ must be locked.
+  void EvictOverBudget();
+  void OnMemoryPressure(MemoryPressure pressure);
+
+  mutable pp::Lock lock_;
+  // Most recently used entries first.
+  std::list<Entry> entries_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+  size_t byte_budget_;
+  size_t cached_bytes_;
+  MemoryUsage usage_;
+  int32_t pressure_listener_;
+  uint64_t hits_;
+  uint64_t misses_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_SEGMENT_CACHE_H_
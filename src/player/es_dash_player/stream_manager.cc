@@ -18,53 +18,83 @@
  * @author Jacob Tarasiewicz
  */
 
+#define LOG_CATEGORY LogCategory::kPackets
+
 #include "player/es_dash_player/stream_manager.h"
 
 #include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <set>
+#include <string>
+#include <vector>
 
 #include "ppapi/utility/threading/lock.h"
 
 #include "common.h"
+#include "demuxer/convert_codecs.h"
 #include "demuxer/elementary_stream_packet.h"
 #include "demuxer/stream_demuxer.h"
 
 #include "player/es_dash_player/es_dash_player_controller.h"
 #include "player/es_dash_player/stream_listener.h"
 
+#include "allocation_tracker.h"
 #include "async_data_provider.h"
+#include "bandwidth_estimator.h"
+#include "cpu_profiler.h"
+#include "download_arbiter.h"
+#include "drm_metrics.h"
+#include "keyframe_index.h"
+#include "license_cache.h"
 #include "media_segment.h"
+#include "network_executor.h"
+#include "pipeline_latency.h"
+#include "playback_metrics.h"
+#include "tracer.h"
+#include "tuning_profile.h"
 
 using pp::AutoLock;
-using Samsung::NaClPlayer::AudioElementaryStream;
 using Samsung::NaClPlayer::DRMType;
 using Samsung::NaClPlayer::DRMType_Unknown;
 using Samsung::NaClPlayer::DRMType_Playready;
-using Samsung::NaClPlayer::ElementaryStream;
 using Samsung::NaClPlayer::ElementaryStreamListener;
 using Samsung::NaClPlayer::ErrorCodes;
-using Samsung::NaClPlayer::ESDataSource;
 using Samsung::NaClPlayer::ESPacket;
 using Samsung::NaClPlayer::MediaPlayer;
 using Samsung::NaClPlayer::TimeTicks;
-using Samsung::NaClPlayer::VideoElementaryStream;
 
 using std::placeholders::_1;
 using std::placeholders::_2;
-using std::make_shared;
 using std::shared_ptr;
 using std::unique_ptr;
 using std::vector;
 
 namespace {
 
-const TimeTicks kNextSegmentTimeThreshold = 7.0f;    // in seconds
+// Buffered packets are replaced starting at least that much after the first
+// one which is not appended yet, so the player doesn't run out of packets
+// while the first replacing segment is downloaded.
+const TimeTicks kReplaceBufferMargin = 1.0f;    // in seconds
+// Number of recently parsed segments, which demuxed keyframes are matched
+// with to find their representations.
+constexpr size_t kMaxParsedSegments = 8;
+// In a trick mode the first keyframe that much before the seek position is
+// shown, as seek positions are keyframe times.
+const TimeTicks kTrickPlayKeyframeMargin = 0.25f;  // in seconds
+// A demuxer which has data queued, but delivers no packets for that many
+// segment durations (and at least kMinStallTimeout) is considered stalled.
+const TimeTicks kStallTimeoutSegments = 2.0f;
+const TimeTicks kMinStallTimeout = 4.0f;  // in seconds
 
 // This class breaks circular shared pointer dependency between:
 //    StreamManager
 // -> StreamManager::Impl
-// -> Samsung::NaClPlayer::ElementaryStream
+// -> EsBackend (e.g. Samsung::NaClPlayer::ElementaryStream)
 // -> Samsung::NaClPlayer::ElementaryStreamListener (which is StreamManager)
 // TODO(p.balut): Code should be refactored so that this class can be removed.
 class StreamListenerProxy : public ElementaryStreamListener {
@@ -90,29 +120,147 @@ class StreamListenerProxy : public ElementaryStreamListener {
 
 }  // anonymous namespace
 
+// Threading: the state of Impl belongs to the stream thread, i.e. the thread
+// which initializes the stream and calls UpdateBuffer(), where downloaded
+// segments and demuxed packets are delivered as well. Other threads may only:
+//  - set the atomic flags below (seeking_, trick_play_, trick_play_requested_
+//    and seek_cancelled_), which the stream thread reads before it requests
+//    or passes on data,
+//  - use members which synchronize themselves, i.e. data_provider_ requests
+//    and keyframe_index_,
+//  - post the rest of their work to the stream thread, see
+//    PostToStreamThread(). E.g. a seek is prepared on the controller thread
+//    and NaCl Player reports its position there, but the demuxer and the
+//    segment bookkeeping are updated on the stream thread, in that order.
 class StreamManager::Impl :
     public std::enable_shared_from_this<StreamManager::Impl> {
  public:
-  explicit Impl(pp::InstanceHandle instance, StreamType type);
+  explicit Impl(pp::InstanceHandle instance, StreamType type,
+                const TuningProfile& tuning,
+                std::shared_ptr<NetworkExecutor> network_executor,
+                std::shared_ptr<BandwidthEstimator> bandwidth_estimator);
   ~Impl();
   bool Initialize(
-       std::unique_ptr<MediaSegmentSequence> segment_sequence,
-       ESDataSource* es_data_source,
+       std::shared_ptr<const MediaSegmentSequence> segment_sequence,
+       const std::vector<uint8_t>& init_segment,
+       EsBackend* es_backend,
        std::function<void(StreamType)> stream_configured_callback,
        std::function<void(StreamDemuxer::Message,
                           unique_ptr<ElementaryStreamPacket>)>
                               es_packet_callback,
+       std::function<void(StreamDemuxer::Message,
+                          StreamDemuxer::PacketBatch)> es_packets_callback,
        StreamListener* stream_listener,
        Samsung::NaClPlayer::DRMType drm_type,
        std::shared_ptr<ElementaryStreamListener> listener);
 
+  bool AddStream(EsBackend* es_backend,
+                 std::shared_ptr<ElementaryStreamListener> listener);
+
+  bool PreConfigure(const AudioStream& stream);
+  bool PreConfigure(const VideoStream& stream);
+
   void SetMediaSegmentSequence(
-       std::unique_ptr<MediaSegmentSequence> segment_sequence);
+       std::shared_ptr<const MediaSegmentSequence> segment_sequence,
+       bool replace_buffered);
+
+  void ReplaceMediaSegmentSequence(
+       std::shared_ptr<const MediaSegmentSequence> segment_sequence);
+
+  void PrefetchInitSegments(
+       std::vector<std::shared_ptr<const MediaSegmentSequence>> sequences) {
+    data_provider_->PrefetchInitSegments(std::move(sequences));
+  }
+
+  void PrefetchSegment(
+      Samsung::NaClPlayer::TimeTicks time,
+      std::shared_ptr<const MediaSegmentSequence> sequence) {
+    if (data_provider_)
+      data_provider_->PrefetchSegment(time, std::move(sequence));
+  }
+
+  void AddCachedSegments(const SegmentCache& segments) {
+    if (data_provider_) segments.CopyTo(data_provider_->GetSegmentCache());
+  }
+
+  void CopyCachedSegments(SegmentCache* destination) const {
+    if (data_provider_) data_provider_->GetSegmentCache()->CopyTo(destination);
+  }
+
+  void SetTrickPlay(bool enabled) { trick_play_ = enabled; }
+
+  void SetPlaybackRate(double rate) { playback_rate_ = rate; }
+
+  void SetLiveTargetBuffer(TimeTicks buffer) { live_target_buffer_ = buffer; }
+
+  void SetStartTime(TimeTicks time) { start_time_ = time; }
+
+  void SetMoreMediaExpected(bool expected) { more_media_expected_ = expected; }
+
+  void SetTaskExecutor(std::shared_ptr<TaskExecutor> executor) {
+    task_executor_ = std::move(executor);
+    if (data_provider_) data_provider_->SetTaskExecutor(task_executor_);
+  }
+
+  void SetDownloadArbiter(std::shared_ptr<DownloadArbiter> arbiter) {
+    download_arbiter_ = std::move(arbiter);
+  }
+
+  void SetPipelineLatency(PipelineLatency* latency) {
+    latency_tracker_.SetLatency(latency);
+  }
+
+  void SetDrmMetrics(DrmMetrics* metrics) { drm_metrics_ = metrics; }
+
+  void SetPlaybackMetrics(PlaybackMetrics* metrics) {
+    playback_metrics_ = metrics;
+  }
 
   bool UpdateBuffer(Samsung::NaClPlayer::TimeTicks playback_time);
 
+  double GetUpcomingBitrate(Samsung::NaClPlayer::TimeTicks time);
+
+  size_t GetPendingSegments() const {
+    return data_provider_ ? data_provider_->PendingSegments() : 0;
+  }
+
+  TimeTicks GetStallTimeout() const {
+    auto segment_duration =
+        data_provider_ ? data_provider_->AverageSegmentDuration() : 0.;
+    return std::max(kMinStallTimeout, kStallTimeoutSegments * segment_duration);
+  }
+
+  bool IsDemuxerStalled() const {
+    if (!demuxer_ || demuxer_->QueuedBytes() == 0) return false;
+    auto progress = TaskExecutor::Clock::time_point(
+        TaskExecutor::Clock::duration(demuxer_progress_));
+    return std::chrono::duration<double>(Now() - progress).count() >=
+        GetStallTimeout();
+  }
+
+  void RecreateDemuxerOnSeek() { recreate_demuxer_ = true; }
+
+  // Called from any thread.
+  StreamBufferedRanges::Range GetDownloadedRange() const {
+    StreamBufferedRanges::Range range;
+    range.start = ToTimeTicks(downloaded_start_);
+    range.end = ToTimeTicks(downloaded_end_);
+    return range;
+  }
+
+  // Called from any thread.
+  StreamManager::SwitchStats GetSwitchStats() const {
+    AutoLock lock(switch_lock_);
+    return switch_stats_;
+  }
+
+  // Counts a representation change, which completes once a packet of
+  // sequence is appended.
+  void StartSwitch(const MediaSegmentSequence* sequence);
+
   bool IsInitialized() { return initialized_; }
 
+  // Called from any thread, e.g. by PacketsManager on delivery of packets.
   bool IsSeeking() const { return seeking_; }
 
   void OnNeedData(int32_t bytes_max);
@@ -122,112 +270,394 @@ class StreamManager::Impl :
   void OnDRMInitData(const std::string& type,
                      const std::vector<uint8_t>& init_data);
 
-  void PrepareForSeek(Samsung::NaClPlayer::TimeTicks new_position);
+  void PrepareForSeek(Samsung::NaClPlayer::TimeTicks new_position,
+                      bool in_buffer);
+
+  void CancelSeek();
+
+  void Trim();
 
   void SetSegmentToTime(Samsung::NaClPlayer::TimeTicks time,
       Samsung::NaClPlayer::TimeTicks* timestamp,
       Samsung::NaClPlayer::TimeTicks* duration);
 
-  bool AppendPacket(std::unique_ptr<ElementaryStreamPacket>);
+  AppendResult AppendPacket(const ElementaryStreamPacket& packet);
+  size_t AppendPackets(const std::vector<const ElementaryStreamPacket*>&,
+                       AppendResult* result);
 
   bool SetConfig(const AudioConfig& audio_config);
   bool SetConfig(const VideoConfig& video_config);
+  // Notifies the controller once the first config of the stream is applied.
+  void MarkInitialized();
 
   Samsung::NaClPlayer::TimeTicks GetClosestKeyframeTime(
       Samsung::NaClPlayer::TimeTicks);
 
  private:
+  struct ParsedSegment {
+    TimeTicks begin;
+    TimeTicks end;
+    std::string representation_id;
+  };
+
   bool InitParser(StreamDemuxer::InitMode init_mode);
+  // Keeps parameters of a new representation which demuxers need.
+  void DescribeSequence(const MediaSegmentSequence& sequence);
+  // Aborts demuxer_ and destroys it in a separate task, so data it didn't
+  // parse yet doesn't delay the caller, e.g. a seek.
+  void RetireDemuxer();
+  void DestroyRetiredDemuxers(int32_t);
+  void PostToStreamThread(const pp::CompletionCallback& callback);
+  // Parts of a seek which touch the state of the stream thread.
+  void FlushForSeek(int32_t);
+  void SeekInBufferOnStreamThread(int32_t);
+  void TrimOnStreamThread(int32_t);
+  void OnSeekDataOnStreamThread(int32_t, TimeTicks new_position);
   bool ParseInitSegment();
+  // Drops buffered packets after the playback position and makes them
+  // downloaded again from *sequence. It fails, leaving *sequence untouched,
+  // when there's not enough packets buffered to replace them.
+  bool ReplaceBufferedSegments(
+      std::shared_ptr<const MediaSegmentSequence>* sequence);
   void GotSegment(std::unique_ptr<MediaSegment> segment);
+  TaskExecutor::Clock::time_point Now() const {
+    return task_executor_ ? task_executor_->Now() : TaskExecutor::Clock::now();
+  }
+  void MarkDemuxerProgress() {
+    demuxer_progress_ = Now().time_since_epoch().count();
+  }
+  // Adds a demuxed video keyframe to keyframe_index_.
+  void RecordKeyframe(const ElementaryStreamPacket& packet);
+  // Passes timestamps of packets passed on by the demuxer to
+  // latency_tracker_.
+  void TrackDemuxedPackets(const StreamDemuxer::PacketBatch& packets);
+  // Checks if a demuxed video packet should be passed on. In a trick mode
+  // only the keyframe at the seek position is.
+  bool ShouldPassPacket(const ElementaryStreamPacket& packet);
+  // Appends packets one by one until one is not accepted. Only a protected
+  // stream checks them for encryption, to measure encrypted appends.
+  template <bool kProtected>
+  size_t AppendPacketsTo(
+      const std::vector<const ElementaryStreamPacket*>& packets,
+      AppendResult* result);
+  // Completes the pending representation change if the appended packet
+  // belongs to its first segment or a later one.
+  void CheckSwitchAppended(const ElementaryStreamPacket& packet);
+  void AddWastedBytes(size_t bytes);
+  void CountDecoderConfig();
 
   void OnAudioConfig(const AudioConfig& audio_config);
   void OnVideoConfig(const VideoConfig& video_config);
 
   pp::InstanceHandle instance_handle_;
   StreamType stream_type_;
+  // A snapshot of the profile of the player.
+  const TuningProfile tuning_;
 
   std::unique_ptr<StreamDemuxer> demuxer_;
+  // Aborted demuxers, waiting for their parsing threads to finish.
+  std::vector<std::unique_ptr<StreamDemuxer>> retired_demuxers_;
+  std::shared_ptr<NetworkExecutor> network_executor_;
+  std::shared_ptr<BandwidthEstimator> bandwidth_estimator_;
   std::unique_ptr<AsyncDataProvider> data_provider_;
+  // Passed to data_provider_, null if it posts to the current message loop.
+  std::shared_ptr<TaskExecutor> task_executor_;
+  // Shares downloads with other streams, may be null.
+  std::shared_ptr<DownloadArbiter> download_arbiter_;
+  // A loop of the stream thread, used when task_executor_ is null.
+  pp::MessageLoop stream_loop_;
+  // Initialization segment of the current representation.
+  std::vector<uint8_t> init_segment_;
+  // @codecs of the current representation, passed to new demuxers.
+  std::string codecs_;
+  // Bitrate and segment duration of the current representation, which new
+  // demuxers size their buffers for, and probing values of tuning_.
+  DemuxerOptions demuxer_options_;
 
   pp::CompletionCallbackFactory<Impl> callback_factory_;
 
-  std::shared_ptr<Samsung::NaClPlayer::ElementaryStream> elementary_stream_;
+  std::shared_ptr<EsBackend::Stream> elementary_stream_;
   std::function<void(StreamType)> stream_configured_callback_;
   std::function<void(StreamDemuxer::Message,
                      unique_ptr<ElementaryStreamPacket>)>
                          es_packet_callback_;
+  std::function<void(StreamDemuxer::Message, StreamDemuxer::PacketBatch)>
+      es_packets_callback_;
+  // AppendPacketsTo() specialized for the protection of the stream, chosen
+  // once in Initialize().
+  size_t (Impl::*append_packets_)(
+      const std::vector<const ElementaryStreamPacket*>&, AppendResult*);
 
   StreamListener* stream_listener_;
 
-  bool drm_initialized_;
+  // Keys which DRM init data has been passed to the elementary stream for.
+  // It's kept over seeks and representation changes, so a license is
+  // requested again only when a new key appears.
+  std::set<std::string> drm_key_ids_;
   bool exited_;
   bool init_seek_;
+  // Set on the stream thread for a seek served from packets already queued,
+  // cleared when its OnSeekData() is handled.
+  bool in_buffer_seek_;
   bool initialized_;
-  bool seeking_;
+  // Set when the elementary stream was configured from the manifest before
+  // the init segment arrived, the demuxed config is compared to it then.
+  bool preconfigured_;
+  // Set by the controller thread when a seek starts, cleared by the stream
+  // thread when a segment at the seek position arrives.
+  std::atomic<bool> seeking_;
+  // Time the demuxer last delivered packets, or got data with nothing
+  // queued, in ticks of TaskExecutor::Clock. See IsDemuxerStalled().
+  std::atomic<TaskExecutor::Clock::rep> demuxer_progress_;
+  // Set by RecreateDemuxerOnSeek(), cleared when the next seek retires the
+  // demuxer.
+  std::atomic<bool> recreate_demuxer_;
   bool changing_representation_;
-  bool segment_pending_;
 
   AudioConfig audio_config_;
   VideoConfig video_config_;
   Samsung::NaClPlayer::DRMType drm_type_;
 
   Samsung::NaClPlayer::TimeTicks buffered_segments_time_;
+  // Times of segments passed to the demuxer since the last seek, for other
+  // threads. The end follows buffered_segments_time_.
+  std::atomic<MediaTime> downloaded_start_;
+  std::atomic<MediaTime> downloaded_end_;
   Samsung::NaClPlayer::TimeTicks need_time_;
+  // Size of the last downloaded segment, next one is expected to be similar.
+  size_t last_segment_bytes_;
+  // Bytes received so far of the segment which is passed in chunks.
+  size_t segment_bytes_;
+  // Set when the rest of the segment passed in chunks should be dropped.
+  bool dropping_segment_;
+  // Offset of media timestamps set in demuxer_, it changes at period
+  // boundaries.
+  Samsung::NaClPlayer::TimeTicks timestamp_offset_;
+  // Keyframes demuxed so far, used to find seek targets inside segments.
+  KeyframeIndex keyframe_index_;
+  std::deque<ParsedSegment> parsed_segments_;
+  // Measures latencies of segments passed to the demuxer since the last
+  // seek.
+  SegmentLatencyTracker latency_tracker_;
+  // Measures appends of encrypted packets, set before Initialize().
+  DrmMetrics* drm_metrics_;
+  // Counts downloads and appends, set before Initialize().
+  PlaybackMetrics* playback_metrics_;
+  // Set by the controller thread, used on the player thread.
+  std::atomic<bool> trick_play_;
+  // Set when the segment at the seek position is requested in a trick mode,
+  // no more are requested until the next seek.
+  std::atomic<bool> trick_play_requested_;
+  // Set when the keyframe at the seek position is passed on in a trick mode.
+  bool trick_play_keyframe_passed_;
+  // Set by the controller thread when the seek in progress is superseded.
+  std::atomic<bool> seek_cancelled_;
+  // Speed of the playback, media is buffered that many times further ahead
+  // to last the same time.
+  std::atomic<double> playback_rate_;
+  // The next segment is requested when less than that much is buffered
+  // ahead of the playback position. Taken from tuning_.
+  TimeTicks segment_ahead_;
+  // Buffer kept behind the live edge of a low-latency presentation, 0 for
+  // other ones. Set before the stream is initialized.
+  Samsung::NaClPlayer::TimeTicks live_target_buffer_;
+  // Position the first segment is requested for, set before the stream is
+  // initialized.
+  Samsung::NaClPlayer::TimeTicks start_time_;
+  // Set while media enqueued after this one is loaded, so the end of stream
+  // is not passed before its segments are joined.
+  bool more_media_expected_;
+  // Guards switch_stats_ and the pending change below, which are updated by
+  // the controller, the stream thread and AppendPacket().
+  mutable pp::Lock switch_lock_;
+  StreamManager::SwitchStats switch_stats_;
+  // Representation of a change which no packets were appended of yet, and
+  // time of its first segment passed to the demuxer, negative until then.
+  std::string switch_representation_;
+  Samsung::NaClPlayer::TimeTicks switch_start_;
+  // Set while a change is pending, checked without switch_lock_ on appends.
+  std::atomic<bool> switch_pending_;
+  // End of segments passed to the demuxer since the last seek, including
+  // the replaced ones. Segments before it are downloaded again.
+  Samsung::NaClPlayer::TimeTicks parsed_end_;
 };  // class StreamManager::Impl
 
-StreamManager::Impl::Impl(pp::InstanceHandle instance, StreamType type)
+StreamManager::Impl::Impl(pp::InstanceHandle instance, StreamType type,
+    const TuningProfile& tuning,
+    std::shared_ptr<NetworkExecutor> network_executor,
+    std::shared_ptr<BandwidthEstimator> bandwidth_estimator)
     : instance_handle_(instance),
       stream_type_(type),
+      tuning_(tuning),
+      network_executor_(network_executor),
+      bandwidth_estimator_(bandwidth_estimator),
       data_provider_(),
       callback_factory_(this),
+      append_packets_(&Impl::AppendPacketsTo<false>),
       stream_listener_(nullptr),
-      drm_initialized_(false),
       exited_(false),
       init_seek_(false),
+      in_buffer_seek_(false),
       initialized_(false),
+      preconfigured_(false),
       seeking_(false),
+      demuxer_progress_(0),
+      recreate_demuxer_(false),
       changing_representation_(false),
-      segment_pending_(false),
       drm_type_(Samsung::NaClPlayer::DRMType_Unknown),
       buffered_segments_time_(0.),
-      need_time_(0.) {}
+      downloaded_start_(0),
+      downloaded_end_(0),
+      need_time_(0.),
+      last_segment_bytes_(0),
+      segment_bytes_(0),
+      dropping_segment_(false),
+      timestamp_offset_(0.),
+      keyframe_index_(),
+      parsed_segments_(),
+      latency_tracker_(),
+      drm_metrics_(nullptr),
+      playback_metrics_(nullptr),
+      trick_play_(false),
+      trick_play_requested_(false),
+      trick_play_keyframe_passed_(false),
+      seek_cancelled_(false),
+      playback_rate_(1.),
+      segment_ahead_(tuning.segment_ahead),
+      live_target_buffer_(0.),
+      start_time_(0.),
+      more_media_expected_(false),
+      switch_start_(-1.),
+      switch_pending_(false),
+      parsed_end_(0.) {
+  demuxer_options_.probe_size = type == StreamType::Video
+      ? tuning_.video_probe_size
+      : tuning_.audio_probe_size;
+  demuxer_options_.analyze_duration = tuning_.analyze_duration;
+}
 
 StreamManager::Impl::~Impl() {
   LOG_DEBUG("");
   exited_ = true;
+  // Nothing will be played anymore, so queued data needn't be parsed.
+  if (demuxer_) demuxer_->Abort();
+  if (download_arbiter_) download_arbiter_->Remove(stream_type_);
 }
 
 void StreamManager::Impl::OnNeedData(int32_t bytes_max) {
   LOG_DEBUG("Type: %s size: %d",
             stream_type_ == StreamType::Video ? "VIDEO" : "AUDIO", bytes_max);
+  if (stream_listener_) stream_listener_->OnNeedData(stream_type_, bytes_max);
 }
 
 void StreamManager::Impl::OnEnoughData() {
   LOG_DEBUG("Type: %s", stream_type_ == StreamType::Video ? "VIDEO" : "AUDIO");
+  if (stream_listener_) stream_listener_->OnEnoughData(stream_type_);
 }
 
 void StreamManager::Impl::OnSeekData(TimeTicks new_position) {
+  PostToStreamThread(callback_factory_.NewCallback(
+      &Impl::OnSeekDataOnStreamThread, new_position));
+}
+
+void StreamManager::Impl::OnSeekDataOnStreamThread(int32_t,
+                                                   TimeTicks new_position) {
   LOG_INFO("Type: %s, new_position: %f",
       stream_type_ == StreamType::Video ? "VIDEO" : "AUDIO", new_position);
   if (!init_seek_) {
     init_seek_ = true;
     return;
   }
-  if (InitParser(changing_representation_
-                 ? StreamDemuxer::kFullInitialization
-                 : StreamDemuxer::kSkipInitCodecData)) {
-    ParseInitSegment();
+  if (in_buffer_seek_) {
+    // The demuxer continues after the queued packets.
+    in_buffer_seek_ = false;
     stream_listener_->OnSeekData(stream_type_, new_position);
+    return;
+  }
+  // Demuxer flushed in PrepareForSeek() can be reused as long as the
+  // initialization segment stays the same and it isn't stalled (see
+  // RecreateDemuxerOnSeek()).
+  if (!demuxer_ || changing_representation_ ||
+      recreate_demuxer_.exchange(false)) {
+    RetireDemuxer();
+    if (!InitParser(changing_representation_
+                    ? StreamDemuxer::kFastInitialization
+                    : StreamDemuxer::kSkipInitCodecData))
+      return;
   }
+  ParseInitSegment();
+  stream_listener_->OnSeekData(stream_type_, new_position);
 }
 
 void StreamManager::Impl::PrepareForSeek(
-    Samsung::NaClPlayer::TimeTicks new_position) {
+    Samsung::NaClPlayer::TimeTicks new_position, bool in_buffer) {
+  if (in_buffer) {
+    // Packets at the new position are queued already, downloads and the
+    // demuxer go on from buffered_segments_time_.
+    seek_cancelled_ = false;
+    PostToStreamThread(callback_factory_.NewCallback(
+        &Impl::SeekInBufferOnStreamThread));
+    return;
+  }
+  // Packets are not passed on from now on, until the seek position is set.
+  seeking_ = true;
+  // Nothing is requested in a trick mode until the seek position is set.
+  trick_play_requested_ = true;
+  seek_cancelled_ = false;
+  // Segments requested before the seek are not needed, the ones for the new
+  // position are downloaded faster without them.
+  if (data_provider_) data_provider_->CancelRequests();
+  // Runs before OnSeekData() of this seek, which is posted after it.
+  PostToStreamThread(callback_factory_.NewCallback(&Impl::FlushForSeek));
+}
+
+void StreamManager::Impl::FlushForSeek(int32_t) {
+  latency_tracker_.Clear();
   buffered_segments_time_ = 0.0;
+  parsed_end_ = 0.0;
+  downloaded_start_ = 0;
+  downloaded_end_ = 0;
+  if (demuxer_) demuxer_->Flush();
+}
+
+void StreamManager::Impl::SeekInBufferOnStreamThread(int32_t) {
+  in_buffer_seek_ = true;
+}
+
+void StreamManager::Impl::PostToStreamThread(
+    const pp::CompletionCallback& callback) {
+  if (task_executor_)
+    task_executor_->PostWork(callback);
+  else
+    stream_loop_.PostWork(callback);
+}
+
+void StreamManager::Impl::CancelSeek() {
+  LOG_INFO("Type: %s, seek superseded",
+      stream_type_ == StreamType::Video ? "VIDEO" : "AUDIO");
+  seek_cancelled_ = true;
+  if (data_provider_) data_provider_->CancelRequests();
+}
+
+void StreamManager::Impl::Trim() {
+  LOG_INFO("Type: %s, trimming buffers",
+      stream_type_ == StreamType::Video ? "VIDEO" : "AUDIO");
+  // As with a superseded seek, the stream waits for the next one.
   seeking_ = true;
-  drm_initialized_ = false;
-  demuxer_.reset();
+  seek_cancelled_ = true;
+  if (data_provider_) data_provider_->CancelRequests();
+  PostToStreamThread(callback_factory_.NewCallback(
+      &Impl::TrimOnStreamThread));
+}
+
+void StreamManager::Impl::TrimOnStreamThread(int32_t) {
+  latency_tracker_.Clear();
+  buffered_segments_time_ = 0.0;
+  parsed_end_ = 0.0;
+  downloaded_start_ = 0;
+  downloaded_end_ = 0;
+  // OnSeekDataOnStreamThread() creates a new one from init_segment_.
+  RetireDemuxer();
 }
 
 void StreamManager::Impl::SetSegmentToTime(Samsung::NaClPlayer::TimeTicks time,
@@ -236,41 +666,87 @@ void StreamManager::Impl::SetSegmentToTime(Samsung::NaClPlayer::TimeTicks time,
   need_time_ = time;
   if (need_time_ < 0.0) need_time_ = 0.0;
   data_provider_->SetNextSegmentToTime(time);
+  trick_play_requested_ = false;
+  trick_play_keyframe_passed_ = false;
   if (timestamp)
     *timestamp = data_provider_->CurrentSegmentTimestamp();
   if (duration)
     *duration =  data_provider_->CurrentSegmentDuration();
 }
 
-bool StreamManager::Impl::AppendPacket(
-    std::unique_ptr<ElementaryStreamPacket> packet) {
-  int32_t ret = ErrorCodes::Success;
-  const char* fname = "";
-  if (!packet->IsEncrypted()) {
-    fname = "AppendPacket";
-    ret = elementary_stream_->AppendPacket(packet->GetESPacket());
-  } else {
-    fname = "AppendEncryptedPacket";
-    ret = elementary_stream_->AppendEncryptedPacket(
-        packet->GetESPacket(), packet->GetEncryptionInfo());
-  }
-  LOG_DEBUG("stream: %s , %p, %s ret: %d, packet pts: %f",
-            stream_type_ == StreamType::Video ? "VIDEO" : "AUDIO", this,
-            fname, ret, packet->GetPts());
-  if (ret != ErrorCodes::Success) {
-    LOG_ERROR("Failed to AppendPacket! Error code: %d", ret);
-    return false;
+StreamManager::AppendResult StreamManager::Impl::AppendPacket(
+    const ElementaryStreamPacket& packet) {
+  int32_t ret = elementary_stream_->AppendPacket(packet);
+  if (ret == ErrorCodes::Success) {
+    if (switch_pending_) CheckSwitchAppended(packet);
+    return AppendResult::kAppended;
   }
-  return true;
+
+  LOG_ERROR("Failed to AppendPacket! Error code: %d, pts: %f", ret,
+            packet.GetPts());
+  // The player is out of buffer space, which is back-pressure rather than
+  // a broken packet.
+  if (ret == ErrorCodes::NoMemory) return AppendResult::kTryAgain;
+  return AppendResult::kFailed;
+}
+
+template <bool kProtected>
+size_t StreamManager::Impl::AppendPacketsTo(
+    const std::vector<const ElementaryStreamPacket*>& packets,
+    AppendResult* result) {
+  size_t appended = 0;
+  size_t encrypted = 0;
+  auto start = kProtected ? std::chrono::steady_clock::now()
+                          : std::chrono::steady_clock::time_point();
+  *result = AppendResult::kAppended;
+  for (; appended < packets.size(); ++appended) {
+    *result = AppendPacket(*packets[appended]);
+    if (*result != AppendResult::kAppended) break;
+    if (kProtected && packets[appended]->IsEncrypted()) ++encrypted;
+  }
+  if (kProtected && encrypted > 0 && drm_metrics_) {
+    drm_metrics_->AddEncryptedAppends(encrypted,
+        std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count());
+  }
+  return appended;
+}
+
+size_t StreamManager::Impl::AppendPackets(
+    const std::vector<const ElementaryStreamPacket*>& packets,
+    AppendResult* result) {
+  size_t appended = (this->*append_packets_)(packets, result);
+
+  // Logged once per batch at most once a second, as NaCl Player gets a few
+  // hundred packets per second.
+  if (appended > 0) {
+    if (playback_metrics_) playback_metrics_->AddAppendedPackets(appended);
+    TimeTicks first_pts = packets.front()->GetPts();
+    TimeTicks last_pts = first_pts;
+    for (size_t i = 1; i < appended; ++i) {
+      first_pts = std::min(first_pts, packets[i]->GetPts());
+      last_pts = std::max(last_pts, packets[i]->GetPts());
+    }
+    latency_tracker_.AddAppended(first_pts, last_pts);
+    LOG_EVERY_MS(Debug, 1000,
+                 "stream: %s , %p, appended %zu packets, pts: %f - %f",
+                 stream_type_ == StreamType::Video ? "VIDEO" : "AUDIO", this,
+                 appended, packets.front()->GetPts(),
+                 packets[appended - 1]->GetPts());
+  }
+  return appended;
 }
 
 bool StreamManager::Impl::Initialize(
-    unique_ptr<MediaSegmentSequence> segment_sequence,
-    ESDataSource* es_data_source,
+    shared_ptr<const MediaSegmentSequence> segment_sequence,
+    const std::vector<uint8_t>& init_segment,
+    EsBackend* es_backend,
     std::function<void(StreamType)> stream_configured_callback,
     std::function<void(StreamDemuxer::Message,
                        unique_ptr<ElementaryStreamPacket>)>
                            es_packet_callback,
+    std::function<void(StreamDemuxer::Message,
+                       StreamDemuxer::PacketBatch)> es_packets_callback,
     StreamListener* stream_listener,
     DRMType drm_type,
     std::shared_ptr<ElementaryStreamListener> listener) {
@@ -280,47 +756,138 @@ bool StreamManager::Impl::Initialize(
     return false;
   }
   stream_configured_callback_ = stream_configured_callback;
-  es_packet_callback_ = es_packet_callback;
+  // Packets delivered by the demuxer mark its progress, video keyframes are
+  // recorded and packets which aren't shown are filtered out.
+  es_packet_callback_ = [this, es_packet_callback](
+      StreamDemuxer::Message msg, unique_ptr<ElementaryStreamPacket> packet) {
+    MarkDemuxerProgress();
+    if (packet && stream_type_ == StreamType::Video) {
+      RecordKeyframe(*packet);
+      if (!ShouldPassPacket(*packet)) return;
+    }
+    if (packet)
+      latency_tracker_.AddDemuxed(packet->GetPts(), packet->GetPts());
+    es_packet_callback(msg, std::move(packet));
+  };
+  es_packets_callback_ = nullptr;
+  if (es_packets_callback) {
+    es_packets_callback_ = [this, es_packets_callback](
+        StreamDemuxer::Message msg, StreamDemuxer::PacketBatch packets) {
+      MarkDemuxerProgress();
+      if (stream_type_ == StreamType::Video) {
+        StreamDemuxer::PacketBatch passed;
+        passed.reserve(packets.size());
+        for (auto& packet : packets) {
+          RecordKeyframe(*packet);
+          if (ShouldPassPacket(*packet)) passed.push_back(std::move(packet));
+        }
+        packets = std::move(passed);
+      }
+      TrackDemuxedPackets(packets);
+      if (!packets.empty()) es_packets_callback(msg, std::move(packets));
+    };
+  }
   stream_listener_ = stream_listener;
   drm_type_ = drm_type;
+  // Packets of a clear stream are never encrypted, as the demuxer gets no
+  // DRM listener for it.
+  append_packets_ = drm_type_ == DRMType_Unknown
+      ? &Impl::AppendPacketsTo<false>
+      : &Impl::AppendPacketsTo<true>;
+  stream_loop_ = pp::MessageLoop::GetCurrent();
   auto callback = [this](std::unique_ptr<MediaSegment> segment) {
     GotSegment(std::move(segment));
   };
   data_provider_ = MakeUnique<AsyncDataProvider>(
-      instance_handle_, callback);
-  data_provider_->SetMediaSegmentSequence(std::move(segment_sequence));
+      instance_handle_, callback, network_executor_, bandwidth_estimator_,
+      stream_type_ == StreamType::Video ? NetworkExecutor::Priority::kVideo
+                                        : NetworkExecutor::Priority::kAudio);
+  // Demuxers accept partial data, so segments are parsed while downloaded.
+  data_provider_->SetChunkedDelivery(true);
+  data_provider_->SetTuningProfile(tuning_);
+  data_provider_->SetTaskExecutor(task_executor_);
+  data_provider_->SetPlaybackMetrics(playback_metrics_);
+  if (segment_sequence) DescribeSequence(*segment_sequence);
+  data_provider_->SetMediaSegmentSequence(std::move(segment_sequence),
+                                          start_time_);
+  if (!init_segment.empty()) data_provider_->SetInitSegment(init_segment);
 
-  int32_t result = ErrorCodes::BadArgument;
-  // Add a stream to ESDataSource
-  if (stream_type_ == StreamType::Video) {
-    auto video_stream = make_shared<VideoElementaryStream>();
-    result = es_data_source->AddStream(*video_stream, listener);
-    elementary_stream_ =
-        std::static_pointer_cast<ElementaryStream>(video_stream);
-  } else if (stream_type_ == StreamType::Audio) {
-    auto audio_stream = make_shared<AudioElementaryStream>();
-    result = es_data_source->AddStream(*audio_stream, listener);
-    elementary_stream_ =
-        std::static_pointer_cast<ElementaryStream>(audio_stream);
+  if (!elementary_stream_ && !AddStream(es_backend, listener))
+    return false;
+
+  // Initialize stream parser
+  if (!InitParser(StreamDemuxer::kFastInitialization)) {
+    LOG_ERROR("Failed to initialize parser or config listeners");
+    return false;
   }
 
+  return ParseInitSegment();
+}
+
+bool StreamManager::Impl::AddStream(EsBackend* es_backend,
+    std::shared_ptr<ElementaryStreamListener> listener) {
+  int32_t result = ErrorCodes::BadArgument;
+  if (es_backend)
+    result = es_backend->AddStream(stream_type_, listener, &elementary_stream_);
+
   if (result != ErrorCodes::Success) {
     LOG_ERROR("Failed to AddStream, type: %d, result: %d", stream_type_,
               result);
+    elementary_stream_.reset();
     return false;
   }
 
-  if (!elementary_stream_) {
+  return elementary_stream_ != nullptr;
+}
+
+bool StreamManager::Impl::PreConfigure(const AudioStream& stream) {
+  AudioConfig config;
+  if (stream_type_ != StreamType::Audio || !elementary_stream_ ||
+      !MakeProvisionalConfig(stream.description.codecs, stream.sampling_rate,
+                             stream.channels, &config)) {
+    LOG_DEBUG("Not enough audio info in the manifest, waiting for demuxer");
     return false;
   }
 
-  // Initialize stream parser
-  if (!InitParser(StreamDemuxer::kFullInitialization)) {
-    LOG_ERROR("Failed to initialize parser or config listeners");
+  int32_t ret = elementary_stream_->SetConfig(config);
+  LOG_INFO("audio - provisional InitializeDone for %s: %d",
+           stream.description.codecs.c_str(), ret);
+  if (ret != ErrorCodes::Success) return false;
+
+  audio_config_ = config;
+  preconfigured_ = true;
+  return true;
+}
+
+bool StreamManager::Impl::PreConfigure(const VideoStream& stream) {
+  VideoConfig config;
+  Samsung::NaClPlayer::Rational frame_rate(0, 1);
+  if (stream.frame_rate_den > 0)
+    frame_rate = Samsung::NaClPlayer::Rational(stream.frame_rate_num,
+                                               stream.frame_rate_den);
+  if (stream_type_ != StreamType::Video || !elementary_stream_ ||
+      !MakeProvisionalConfig(stream.description.codecs, stream.width,
+                             stream.height, frame_rate, &config)) {
+    LOG_DEBUG("Not enough video info in the manifest, waiting for demuxer");
     return false;
   }
 
-  return ParseInitSegment();
+  int32_t ret = elementary_stream_->SetConfig(config);
+  LOG_INFO("video - provisional InitializeDone for %s: %d",
+           stream.description.codecs.c_str(), ret);
+  if (ret != ErrorCodes::Success) return false;
+
+  video_config_ = config;
+  preconfigured_ = true;
+  return true;
+}
+
+void StreamManager::Impl::DescribeSequence(
+    const MediaSegmentSequence& sequence) {
+  codecs_ = sequence.Codecs();
+  demuxer_options_.bitrate = sequence.Bandwidth();
+  demuxer_options_.segment_duration =
+      std::max(sequence.AverageSegmentDuration(), 0.);
 }
 
 bool StreamManager::Impl::InitParser(StreamDemuxer::InitMode init_mode) {
@@ -336,7 +903,9 @@ bool StreamManager::Impl::InitParser(StreamDemuxer::InitMode init_mode) {
       demuxer_type = StreamDemuxer::kUnknown;
   }
 
-  demuxer_ = StreamDemuxer::Create(instance_handle_, demuxer_type, init_mode);
+  demuxer_ = StreamDemuxer::Create(instance_handle_, demuxer_type, init_mode,
+                                   demuxer_options_);
+  timestamp_offset_ = 0.;
 
   if (!demuxer_) {
     LOG_ERROR("Failed to construct a FFMpegStreamParser");
@@ -345,6 +914,12 @@ bool StreamManager::Impl::InitParser(StreamDemuxer::InitMode init_mode) {
   if (!demuxer_->Init(es_packet_callback_, pp::MessageLoop::GetCurrent()))
     return false;
 
+  if (!codecs_.empty()) demuxer_->SetCodecs(codecs_);
+
+  // Demuxers without batched delivery pass packets to es_packet_callback_.
+  if (es_packets_callback_)
+    demuxer_->SetEsPacketsListener(es_packets_callback_);
+
   bool ok = demuxer_->SetAudioConfigListener([this](const AudioConfig& config) {
       OnAudioConfig(config);
   });
@@ -363,62 +938,165 @@ bool StreamManager::Impl::InitParser(StreamDemuxer::InitMode init_mode) {
   return ok;
 }
 
+void StreamManager::Impl::RetireDemuxer() {
+  if (!demuxer_) return;
+  demuxer_->Abort();
+  retired_demuxers_.push_back(std::move(demuxer_));
+  // Runs after the new demuxer gets its initialization segment.
+  PostToStreamThread(callback_factory_.NewCallback(
+      &Impl::DestroyRetiredDemuxers));
+}
+
+void StreamManager::Impl::DestroyRetiredDemuxers(int32_t) {
+  TRACE_SCOPE("destroy retired demuxers");
+  retired_demuxers_.clear();
+}
+
 bool StreamManager::Impl::ParseInitSegment() {
-  // Download initialization segment.
-  vector<uint8_t> init_segment;
-  if (!data_provider_->GetInitSegment(&init_segment)) {
-    LOG_ERROR("Failed to download initialization segment!");
-    return false;
-  }
+  // Download initialization segment, unless it's already known for the
+  // current representation.
+  if (init_segment_.empty()) {
+    if (!data_provider_->GetInitSegment(&init_segment_)) {
+      LOG_ERROR("Failed to download initialization segment!");
+      init_segment_.clear();
+      return false;
+    }
 
-  if (init_segment.empty()) {
-    LOG_ERROR("Initialization segment is empty!");
-    return false;
+    if (init_segment_.empty()) {
+      LOG_ERROR("Initialization segment is empty!");
+      return false;
+    }
   }
 
-  demuxer_->Parse(init_segment);
+  ALLOCATION_SCOPE("demux");
+  CPU_SCOPE(CpuStage::kDemux);
+  MarkDemuxerProgress();
+  demuxer_->Parse(init_segment_);
   return true;
 }
 
 Samsung::NaClPlayer::TimeTicks StreamManager::Impl::GetClosestKeyframeTime(
     Samsung::NaClPlayer::TimeTicks time) {
-  return data_provider_->GetClosestKeyframeTime(time);
+  return data_provider_->GetClosestKeyframeTime(time, &keyframe_index_);
 }
 
 bool StreamManager::Impl::UpdateBuffer(TimeTicks playback_time) {
   LOG_DEBUG("stream manager: %p, playback_time: %f, buffered time: %f", this,
             playback_time, buffered_segments_time_);
 
+  if (download_arbiter_)
+    download_arbiter_->Update(stream_type_, GetPendingSegments());
+
   if (!elementary_stream_) {
     LOG_DEBUG("elementary stream is not initialized!");
     return true;
   }
 
-  // Check if we need to request next segment download.
-  if (!segment_pending_) {
-    auto next_segment_threshold = std::max(kNextSegmentTimeThreshold,
-        data_provider_->AverageSegmentDuration());
-    if (buffered_segments_time_ - playback_time < next_segment_threshold) {
-      LOG_INFO("Requesting next %s segment...",
+  // Check if we need to request next segments download. Up to a prefetch
+  // depth of the data provider segments are downloaded at the same time.
+  // Low-latency streams keep only the target buffer, past the end of the
+  // segment which is produced at the live edge.
+  auto next_segment_threshold = live_target_buffer_ > 0.
+      ? live_target_buffer_ + data_provider_->AverageSegmentDuration()
+      : std::max(segment_ahead_ * playback_rate_,
+                 data_provider_->AverageSegmentDuration());
+  // The end of stream is passed as soon as the last segment is requested,
+  // rather than when the playback gets near it, so the demuxer flushes its
+  // last packets and the player gets the end of stream right after them.
+  if (!more_media_expected_ && !seek_cancelled_ &&
+      !(trick_play_ && trick_play_requested_) &&
+      data_provider_->IsSequenceEnd()) {
+    data_provider_->RequestNextDataSegment();
+    LOG_DEBUG("There are no more segments to load");
+    return false;
+  }
+  while (data_provider_->PendingSegments() < data_provider_->PrefetchDepth()) {
+    // A trick mode shows a single frame of each seek position.
+    if (trick_play_ && trick_play_requested_) break;
+    // Segments of a superseded seek are not shown.
+    if (seek_cancelled_) break;
+    auto pending_segments = data_provider_->PendingSegments();
+    // Segments which are being downloaded count as buffered.
+    auto requested_time = pending_segments > 0
+        ? data_provider_->RequestedSegmentsEndTime() : buffered_segments_time_;
+    bool enough_time_buffered =
+        requested_time - playback_time >= next_segment_threshold;
+    // Downloads stop on whichever limit is hit first: buffered time or
+    // memory used by packets which are waiting to be appended. The next
+    // segment is expected to be similar to the last one, unless its size is
+    // known. Data which waits for the demuxer counts too, so a demuxer
+    // which falls behind holds downloads back instead of queuing segments
+    // without a limit.
+    uint64_t next_segment_bytes = 0;
+    double next_segment_duration = 0.;
+    if (!data_provider_->GetUpcomingSegmentsSize(kEps, &next_segment_bytes,
+                                                 &next_segment_duration))
+      next_segment_bytes = last_segment_bytes_;
+    auto demuxer_bytes = demuxer_ ? demuxer_->QueuedBytes() : 0;
+    bool enough_bytes_buffered = !stream_listener_->CanBuffer(stream_type_,
+        next_segment_bytes + last_segment_bytes_ * pending_segments +
+            demuxer_bytes);
+    if (enough_bytes_buffered && !enough_time_buffered) {
+      LOG_DEBUG("%s memory budget reached, not requesting next segment",
                 stream_type_ == StreamType::Video ? "VIDEO" : "AUDIO");
-      bool has_more_segments = data_provider_->RequestNextDataSegment();
-      if (has_more_segments) {
-        segment_pending_ = true;
-      } else {
-        LOG_DEBUG("There are no more segments to load");
-        return false;
-      }
     }
+    if (enough_time_buffered || enough_bytes_buffered) break;
+    // Health of the buffer is its time ahead relative to the threshold, the
+    // stream which is the furthest behind gets the next download.
+    if (download_arbiter_ && !download_arbiter_->Request(stream_type_,
+            (requested_time - playback_time) / next_segment_threshold)) {
+      LOG_DEBUG("%s download deferred by the arbiter",
+                stream_type_ == StreamType::Video ? "VIDEO" : "AUDIO");
+      break;
+    }
+
+    LOG_INFO("Requesting next %s segment...",
+              stream_type_ == StreamType::Video ? "VIDEO" : "AUDIO");
+    bool has_more_segments = data_provider_->RequestNextDataSegment();
+    trick_play_requested_ = true;
+    if (!has_more_segments) {
+      LOG_DEBUG("There are no more segments to load");
+      return false;
+    }
+    // Live edge reached, the next segment is not available yet.
+    if (data_provider_->PendingSegments() == pending_segments) break;
   }
 
   return true;
 }
 
+double StreamManager::Impl::GetUpcomingBitrate(TimeTicks time) {
+  if (!data_provider_) return 0.;
+
+  uint64_t bytes = 0;
+  double duration = 0.;
+  if (!data_provider_->GetUpcomingSegmentsSize(time, &bytes, &duration))
+    return 0.;
+  return bytes * 8. / duration;
+}
+
 void StreamManager::Impl::SetMediaSegmentSequence(
-    std::unique_ptr<MediaSegmentSequence> segment_sequence) {
+    std::shared_ptr<const MediaSegmentSequence> segment_sequence,
+    bool replace_buffered) {
   LOG_INFO("Setting new %s sequence to %f [s]",
             stream_type_ == StreamType::Video ? "VIDEO" : "AUDIO",
             buffered_segments_time_);
+  if (segment_sequence) DescribeSequence(*segment_sequence);
+  if (replace_buffered && ReplaceBufferedSegments(&segment_sequence)) return;
+
+  // The running demuxer gets the new init segment inline, before the first
+  // segment of the new representation. Segments requested already are kept.
+  if (!seeking_ && !changing_representation_ && demuxer_ &&
+      demuxer_->CanSwitchBitstream() &&
+      data_provider_->SwitchMediaSegmentSequence(&segment_sequence)) {
+    LOG_INFO("Switched %s bitstream after %f [s]",
+             stream_type_ == StreamType::Video ? "VIDEO" : "AUDIO",
+             data_provider_->RequestedSegmentsEndTime());
+    // A seek needs the init segment of the new representation.
+    init_segment_.clear();
+    return;
+  }
+
   // TODO(p.balut): This is needed only for adjusting a demuxer timestamp in
   //                GotSegment() and will be redundant after update to ffmpeg
   //                2.6+.
@@ -427,38 +1105,245 @@ void StreamManager::Impl::SetMediaSegmentSequence(
   //                than just using timestamps (i.e. use segment indices).
   need_time_ = buffered_segments_time_ + kSegmentMargin;
   demuxer_.reset();
-  drm_initialized_ = false;
+  init_segment_.clear();
   LOG_INFO("Parser reset");
   data_provider_->SetMediaSegmentSequence(std::move(segment_sequence),
       buffered_segments_time_ + kSegmentMargin);
-  if (InitParser(StreamDemuxer::kFullInitialization)) ParseInitSegment();
+  if (InitParser(StreamDemuxer::kFastInitialization)) ParseInitSegment();
 
   LOG_DEBUG("SetMediaSegmentSequence changed segments in data provider");
 }
 
+void StreamManager::Impl::ReplaceMediaSegmentSequence(
+    std::shared_ptr<const MediaSegmentSequence> segment_sequence) {
+  TimeTicks appended_end;
+  if (seeking_ || !demuxer_ || !segment_sequence ||
+      !stream_listener_->DropQueuedPackets(stream_type_, &appended_end)) {
+    SetMediaSegmentSequence(std::move(segment_sequence), false);
+    return;
+  }
+
+  LOG_INFO("Replacing %s packets queued after %f [s]",
+           stream_type_ == StreamType::Video ? "VIDEO" : "AUDIO",
+           appended_end);
+  DescribeSequence(*segment_sequence);
+  // The new representation starts with the segment playing at the end of
+  // appended packets, likely prefetched already (see PrefetchSegment()).
+  // Its packets before that end are dropped by the listener, a new demuxer
+  // is made in case the codec changes.
+  changing_representation_ = true;
+  need_time_ = appended_end + kEps;
+  buffered_segments_time_ = appended_end;
+  downloaded_end_ = ToMediaTime(appended_end);
+  demuxer_.reset();
+  init_segment_.clear();
+  data_provider_->SetMediaSegmentSequence(std::move(segment_sequence),
+                                          need_time_);
+  if (InitParser(StreamDemuxer::kFastInitialization)) ParseInitSegment();
+}
+
+bool StreamManager::Impl::ReplaceBufferedSegments(
+    std::shared_ptr<const MediaSegmentSequence>* sequence) {
+  if (seeking_ || changing_representation_ || !demuxer_ ||
+      !demuxer_->CanSwitchBitstream())
+    return false;
+
+  TimeTicks first_pending;
+  TimeTicks last_pending;
+  if (!stream_listener_->GetPendingPacketsTime(stream_type_, &first_pending,
+                                               &last_pending))
+    return false;
+
+  // Replacing starts at a segment boundary of the new sequence.
+  auto replace_from = first_pending + kReplaceBufferMargin;
+  auto it = (*sequence)->MediaSegmentForTime(replace_from);
+  if (it == (*sequence)->End()) return false;
+  if ((*sequence)->SegmentTimestamp(it) < replace_from - kEps &&
+      ++it == (*sequence)->End())
+    return false;
+  TimeTicks replace_time = (*sequence)->SegmentTimestamp(it);
+  // Flushing the demuxer drops packets it posted and listener didn't get
+  // yet, these must be the replaced ones only.
+  if (replace_time > last_pending) return false;
+  if (!stream_listener_->DropPacketsFrom(stream_type_, replace_time))
+    return false;
+
+  LOG_INFO("Replacing %s segments buffered from %f [s]",
+           stream_type_ == StreamType::Video ? "VIDEO" : "AUDIO",
+           replace_time);
+  demuxer_->Flush();
+  // As after a representation change, the demuxer timestamp is adjusted to
+  // the first segment in GotSegment().
+  changing_representation_ = true;
+  need_time_ = replace_time;
+  buffered_segments_time_ = replace_time;
+  downloaded_end_ = ToMediaTime(replace_time);
+  init_segment_.clear();
+  data_provider_->SetMediaSegmentSequence(std::move(*sequence),
+                                          replace_time + kEps);
+  ParseInitSegment();
+  return true;
+}
+
 void StreamManager::Impl::GotSegment(std::unique_ptr<MediaSegment> segment) {
+  TRACE_SCOPE("got segment");
+  Tracer::FlowEnd("segment", reinterpret_cast<uintptr_t>(segment.get()));
+  // Buffers are updated after the segment is handled, e.g. so the next one
+  // is requested.
+  stream_listener_->OnSegmentReceived(stream_type_);
+  // Delivered after the stream was trimmed, before a seek creates a demuxer.
+  if (!demuxer_) return;
   if (!segment->data_.empty()) {
     LOG_DEBUG("Got %s segment. duration: %f, data size: %d, timestamp: %f [s]",
         stream_type_ == StreamType::Video ? "VIDEO" : "AUDIO",
         segment->duration_, segment->data_.size(), segment->timestamp_);
   }
-  segment_pending_ = false;
-  if ((seeking_ || changing_representation_) &&
-      segment->timestamp_ - kEps <= need_time_ &&
-      need_time_ < segment->duration_ + segment->timestamp_) {
-    LOG_INFO("This segment finishes a seek for this stream.");
-    changing_representation_ = false;
-    seeking_ = false;
-    demuxer_->SetTimestamp(segment->timestamp_);
-  } else if (seeking_) {
-    LOG_INFO("This segment is out of bounds and will be dropped. Expected "
-             "time == %f [s]", need_time_);
+  // Segments can come in chunks, decisions are made on the first one.
+  if (segment->first_chunk_) {
+    dropping_segment_ = false;
+    segment_bytes_ = 0;
+    if ((seeking_ || changing_representation_) &&
+        segment->timestamp_ - kEps <= need_time_ &&
+        need_time_ < segment->duration_ + segment->timestamp_) {
+      LOG_INFO("This segment finishes a seek for this stream.");
+      changing_representation_ = false;
+      seeking_ = false;
+      demuxer_->SetTimestamp(segment->timestamp_);
+    } else if (seeking_) {
+      LOG_INFO("This segment is out of bounds and will be dropped. Expected "
+               "time == %f [s]", need_time_);
+      dropping_segment_ = !segment->last_chunk_;
+      AddWastedBytes(segment->data_.size());
+      return;
+    }
+    if (switch_pending_) {
+      AutoLock lock(switch_lock_);
+      if (switch_start_ < 0. &&
+          segment->representation_id_ == switch_representation_)
+        switch_start_ = segment->timestamp_;
+    }
+    // Media timestamps of each period of a multi-period presentation can
+    // start anew. Segments of the next period are preceded by its
+    // initialization segment, so the demuxer reports a changed config which
+    // is applied after packets of the previous period, without a flush.
+    if (segment->timestamp_offset_ != timestamp_offset_) {
+      LOG_INFO("Timestamp offset changed from %f to %f [s]",
+               timestamp_offset_, segment->timestamp_offset_);
+      timestamp_offset_ = segment->timestamp_offset_;
+      if (!demuxer_->SetTimestampOffset(timestamp_offset_))
+        LOG_ERROR("Demuxer doesn't support timestamp offsets!");
+    }
+    if (!segment->data_.empty()) {
+      latency_tracker_.AddSegment(segment->timestamp_,
+          segment->timestamp_ + segment->duration_, segment->requested_);
+    }
+    if (stream_type_ == StreamType::Video && !segment->data_.empty()) {
+      parsed_segments_.push_back({segment->timestamp_,
+          segment->timestamp_ + segment->duration_,
+          segment->representation_id_});
+      if (parsed_segments_.size() > kMaxParsedSegments)
+        parsed_segments_.pop_front();
+    }
+  } else if (dropping_segment_) {
+    if (segment->last_chunk_) dropping_segment_ = false;
+    AddWastedBytes(segment->data_.size());
     return;
   }
 
-  buffered_segments_time_ =
-      static_cast<TimeTicks>(segment->duration_ + segment->timestamp_);
-  demuxer_->Parse(segment->data_);
+  segment_bytes_ += segment->data_.size();
+  if (segment->last_chunk_) {
+    if (segment->timestamp_ + kEps < parsed_end_)
+      AddWastedBytes(segment_bytes_);
+    parsed_end_ = std::max(parsed_end_,
+                           segment->timestamp_ + segment->duration_);
+    // The first segment after a seek starts the downloaded range.
+    if (buffered_segments_time_ == 0.)
+      downloaded_start_ = ToMediaTime(segment->timestamp_);
+    buffered_segments_time_ =
+        static_cast<TimeTicks>(segment->duration_ + segment->timestamp_);
+    downloaded_end_ = ToMediaTime(buffered_segments_time_);
+    last_segment_bytes_ = segment_bytes_;
+    latency_tracker_.SetDownloaded(segment->timestamp_, segment->first_byte_,
+                                   segment->last_byte_);
+  }
+  // The last chunk of a segment passed in chunks has no data and must not be
+  // mistaken for the end of stream.
+  if (segment->data_.empty() && !segment->first_chunk_) return;
+  ALLOCATION_SCOPE("demux");
+  CPU_SCOPE(CpuStage::kDemux);
+  if (segment->last_chunk_) AllocationTracker::CountSegment("demux");
+  // An idle demuxer is given the stall timeout from now on.
+  if (demuxer_->QueuedBytes() == 0) MarkDemuxerProgress();
+  demuxer_->Parse(std::move(segment->data_));
+}
+
+void StreamManager::Impl::RecordKeyframe(
+    const ElementaryStreamPacket& packet) {
+  if (!packet.IsKeyFrame()) return;
+
+  TimeTicks pts = packet.GetPts();
+  for (const auto& segment : parsed_segments_) {
+    if (segment.begin - kEps <= pts && pts < segment.end) {
+      keyframe_index_.Add(segment.representation_id, pts);
+      return;
+    }
+  }
+}
+
+void StreamManager::Impl::TrackDemuxedPackets(
+    const StreamDemuxer::PacketBatch& packets) {
+  if (packets.empty()) return;
+
+  TimeTicks first_pts = packets.front()->GetPts();
+  TimeTicks last_pts = first_pts;
+  for (const auto& packet : packets) {
+    first_pts = std::min(first_pts, packet->GetPts());
+    last_pts = std::max(last_pts, packet->GetPts());
+  }
+  latency_tracker_.AddDemuxed(first_pts, last_pts);
+}
+
+bool StreamManager::Impl::ShouldPassPacket(
+    const ElementaryStreamPacket& packet) {
+  if (!trick_play_) return true;
+  if (trick_play_keyframe_passed_ || !packet.IsKeyFrame()) return false;
+
+  // Earlier keyframes are dropped by the listener as seek ends at the
+  // target one.
+  if (packet.GetPts() + kTrickPlayKeyframeMargin >= need_time_) {
+    trick_play_keyframe_passed_ = true;
+    LOG_DEBUG("Trick play keyframe at %f [s], aborting segment download",
+              packet.GetPts());
+    data_provider_->CancelRequests();
+  }
+  return true;
+}
+
+void StreamManager::Impl::StartSwitch(const MediaSegmentSequence* sequence) {
+  AutoLock lock(switch_lock_);
+  ++switch_stats_.switches;
+  switch_representation_ = sequence ? sequence->RepresentationId() : "";
+  switch_start_ = -1.;
+  switch_pending_ = sequence != nullptr;
+}
+
+void StreamManager::Impl::CheckSwitchAppended(
+    const ElementaryStreamPacket& packet) {
+  AutoLock lock(switch_lock_);
+  if (switch_start_ < 0. || packet.GetPts() < switch_start_ - kEps) return;
+  ++switch_stats_.completed;
+  switch_representation_.clear();
+  switch_pending_ = false;
+}
+
+void StreamManager::Impl::AddWastedBytes(size_t bytes) {
+  AutoLock lock(switch_lock_);
+  switch_stats_.wasted_bytes += bytes;
+}
+
+void StreamManager::Impl::CountDecoderConfig() {
+  AutoLock lock(switch_lock_);
+  ++switch_stats_.decoder_configs;
 }
 
 bool StreamManager::Impl::SetConfig(const AudioConfig& audio_config) {
@@ -470,30 +1355,22 @@ bool StreamManager::Impl::SetConfig(const AudioConfig& audio_config) {
       audio_config.sample_format, audio_config.bits_per_channel,
       audio_config.channel_layout, audio_config.samples_per_second);
 
-  if (audio_config_ == audio_config) {
+  if ((initialized_ || preconfigured_) &&
+      ClassifyConfigChange(audio_config_, audio_config) ==
+          ConfigChange::kNone) {
     LOG_INFO("The same config as before");
+    MarkInitialized();
     return true;
   }
 
   audio_config_ = audio_config;
   if (stream_type_ == StreamType::Audio) {
-    auto audio_stream =
-        std::static_pointer_cast<AudioElementaryStream>(elementary_stream_);
-    audio_stream->SetAudioCodecType(audio_config.codec_type);
-    audio_stream->SetAudioCodecProfile(audio_config.codec_profile);
-    audio_stream->SetSampleFormat(audio_config.sample_format);
-    audio_stream->SetChannelLayout(audio_config.channel_layout);
-    audio_stream->SetBitsPerChannel(audio_config.bits_per_channel);
-    audio_stream->SetSamplesPerSecond(audio_config.samples_per_second);
-    audio_stream->SetCodecExtraData(audio_config.extra_data.size(),
-                                    &audio_config.extra_data.front());
-
-    int32_t ret = audio_stream->InitializeDone();
+    int32_t ret = elementary_stream_->SetConfig(audio_config);
     LOG_DEBUG("audio - InitializeDone: %d", ret);
 
-    if (ret == ErrorCodes::Success && !initialized_) {
-      initialized_ = true;
-      stream_configured_callback_(stream_type_);
+    if (ret == ErrorCodes::Success) {
+      CountDecoderConfig();
+      MarkInitialized();
     }
     return ret == ErrorCodes::Success;
   } else {
@@ -511,29 +1388,39 @@ bool StreamManager::Impl::SetConfig(const VideoConfig& video_config) {
       video_config.frame_format,
       video_config.size.width, video_config.size.height,
       video_config.frame_rate.numerator, video_config.frame_rate.denominator);
-  if (video_config_ == video_config) {
+  LOG_INFO("profile_idc: %d level_idc: %d bit_depth: %d colour: %d/%d/%d%s "
+      "dolby vision: %d.%02d (base layer compatibility: %d)",
+      video_config.profile_idc, video_config.level_idc,
+      video_config.bit_depth, video_config.color.primaries,
+      video_config.color.transfer, video_config.color.matrix,
+      video_config.color.full_range ? " full range" : "",
+      video_config.dolby_vision.present ? video_config.dolby_vision.profile
+                                        : -1,
+      video_config.dolby_vision.level,
+      video_config.dolby_vision.bl_compatibility_id);
+  auto change = initialized_ || preconfigured_
+      ? ClassifyConfigChange(video_config_, video_config)
+      : ConfigChange::kCodec;
+  if (change == ConfigChange::kNone) {
     LOG_INFO("The same config as before");
+    MarkInitialized();
     return true;
   }
 
   video_config_ = video_config;
+  if (change == ConfigChange::kResolution) {
+    // The decoder follows frame size and rate changes from the stream.
+    LOG_INFO("Only resolution changed, skipping InitializeDone");
+    MarkInitialized();
+    return true;
+  }
   if (stream_type_ == StreamType::Video) {
-    auto video_stream =
-        std::static_pointer_cast<VideoElementaryStream>(elementary_stream_);
-    video_stream->SetVideoCodecType(video_config.codec_type);
-    video_stream->SetVideoCodecProfile(video_config.codec_profile);
-    video_stream->SetVideoFrameFormat(video_config.frame_format);
-    video_stream->SetVideoFrameSize(video_config.size);
-    video_stream->SetFrameRate(video_config.frame_rate);
-    video_stream->SetCodecExtraData(video_config.extra_data.size(),
-                                    &video_config.extra_data.front());
-
-    int32_t ret = video_stream->InitializeDone();
+    int32_t ret = elementary_stream_->SetConfig(video_config);
     LOG_DEBUG("video - InitializeDone: %d", ret);
 
-    if (ret == ErrorCodes::Success && !initialized_) {
-      initialized_ = true;
-      stream_configured_callback_(stream_type_);
+    if (ret == ErrorCodes::Success) {
+      CountDecoderConfig();
+      MarkInitialized();
     }
     return ret == ErrorCodes::Success;
   } else {
@@ -542,6 +1429,12 @@ bool StreamManager::Impl::SetConfig(const VideoConfig& video_config) {
   return false;
 }
 
+void StreamManager::Impl::MarkInitialized() {
+  if (initialized_) return;
+  initialized_ = true;
+  stream_configured_callback_(stream_type_);
+}
+
 void StreamManager::Impl::OnAudioConfig(const AudioConfig& audio_config) {
   stream_listener_->OnStreamConfig(audio_config);
 }
@@ -554,23 +1447,27 @@ void StreamManager::Impl::OnDRMInitData(const std::string& type,
                                         const std::vector<uint8_t>& init_data) {
   LOG_DEBUG("stream type: %d, init data type: %s, init_data.size(): %d",
             stream_type_, type.c_str(), init_data.size());
-  if (drm_initialized_) {
+  std::string key_id = LicenseCache::ParseInitDataKeyId(init_data);
+  if (drm_key_ids_.count(key_id)) {
     LOG_INFO("DRM initialized already");
     return;
   }
   LOG_DEBUG("init_data hex str: [[%s]]",
             ToHexString(init_data.size(), init_data.data()).c_str());
 
-  int32_t ret = elementary_stream_->SetDRMInitData(
-      type, init_data.size(), static_cast<const void*>(init_data.data()));
-  if (ret == ErrorCodes::Success) drm_initialized_ = true;
+  int32_t ret = elementary_stream_->SetDrmInitData(type, init_data);
+  if (ret == ErrorCodes::Success) drm_key_ids_.insert(key_id);
   LOG_DEBUG("SetDRMInitData returned: %d", ret);
 }
 
 // end of PIMPL implementation
 
-StreamManager::StreamManager(pp::InstanceHandle instance, StreamType type)
-  : pimpl_(MakeUnique<Impl>(instance, type)) {
+StreamManager::StreamManager(pp::InstanceHandle instance, StreamType type,
+    const TuningProfile& tuning,
+    std::shared_ptr<NetworkExecutor> network_executor,
+    std::shared_ptr<BandwidthEstimator> bandwidth_estimator)
+  : pimpl_(MakeUnique<Impl>(instance, type, tuning, network_executor,
+                            bandwidth_estimator)) {
 }
 
 StreamManager::~StreamManager() = default;
@@ -596,8 +1493,8 @@ bool StreamManager::IsSeeking() const {
 }
 
 void StreamManager::PrepareForSeek(
-    Samsung::NaClPlayer::TimeTicks new_position) {
-  pimpl_->PrepareForSeek(new_position);
+    Samsung::NaClPlayer::TimeTicks new_position, bool in_buffer) {
+  pimpl_->PrepareForSeek(new_position, in_buffer);
 }
 
 void StreamManager::SetSegmentToTime(Samsung::NaClPlayer::TimeTicks time,
@@ -606,9 +1503,15 @@ void StreamManager::SetSegmentToTime(Samsung::NaClPlayer::TimeTicks time,
   pimpl_->SetSegmentToTime(time, timestamp, duration);
 }
 
-bool StreamManager::AppendPacket(
-    std::unique_ptr<ElementaryStreamPacket> packet) {
-  return pimpl_->AppendPacket(std::move(packet));
+StreamManager::AppendResult StreamManager::AppendPacket(
+    const ElementaryStreamPacket& packet) {
+  return pimpl_->AppendPacket(packet);
+}
+
+size_t StreamManager::AppendPackets(
+    const std::vector<const ElementaryStreamPacket*>& packets,
+    AppendResult* result) {
+  return pimpl_->AppendPackets(packets, result);
 }
 
 bool StreamManager::SetConfig(const AudioConfig& audio_config) {
@@ -625,20 +1528,37 @@ Samsung::NaClPlayer::TimeTicks StreamManager::GetClosestKeyframeTime(
 }
 
 bool StreamManager::Initialize(
-    unique_ptr<MediaSegmentSequence> segment_sequence,
-    ESDataSource* es_data_source,
+    shared_ptr<const MediaSegmentSequence> segment_sequence,
+    const std::vector<uint8_t>& init_segment,
+    EsBackend* es_backend,
     std::function<void(StreamType)> stream_configured_callback,
     std::function<void(StreamDemuxer::Message,
                        unique_ptr<ElementaryStreamPacket>)>
                            es_packet_callback,
+    std::function<void(StreamDemuxer::Message,
+                       StreamDemuxer::PacketBatch)> es_packets_callback,
     StreamListener* stream_listener,
     DRMType drm_type) {
-  return pimpl_->Initialize(std::move(segment_sequence), es_data_source,
-                            stream_configured_callback, es_packet_callback,
+  return pimpl_->Initialize(std::move(segment_sequence), init_segment,
+                            es_backend, stream_configured_callback,
+                            es_packet_callback, es_packets_callback,
                             stream_listener, drm_type,
                             std::make_shared<StreamListenerProxy>(this));
 }
 
+bool StreamManager::AddStream(EsBackend* es_backend) {
+  return pimpl_->AddStream(es_backend,
+                           std::make_shared<StreamListenerProxy>(this));
+}
+
+bool StreamManager::PreConfigure(const AudioStream& stream) {
+  return pimpl_->PreConfigure(stream);
+}
+
+bool StreamManager::PreConfigure(const VideoStream& stream) {
+  return pimpl_->PreConfigure(stream);
+}
+
 void StreamManager::SetDrmInitData(const std::string& type,
                                    const std::vector<uint8_t>& init_data) {
   pimpl_->OnDRMInitData(type, init_data);
@@ -648,7 +1568,111 @@ bool StreamManager::UpdateBuffer(TimeTicks playback_time) {
   return pimpl_->UpdateBuffer(playback_time);
 }
 
+double StreamManager::GetUpcomingBitrate(TimeTicks time) {
+  return pimpl_->GetUpcomingBitrate(time);
+}
+
+size_t StreamManager::GetPendingSegments() const {
+  return pimpl_->GetPendingSegments();
+}
+
+StreamBufferedRanges::Range StreamManager::GetDownloadedRange() const {
+  return pimpl_->GetDownloadedRange();
+}
+
+StreamManager::SwitchStats StreamManager::GetSwitchStats() const {
+  return pimpl_->GetSwitchStats();
+}
+
 void StreamManager::SetMediaSegmentSequence(
-    std::unique_ptr<MediaSegmentSequence> segment_sequence) {
-  pimpl_->SetMediaSegmentSequence(std::move(segment_sequence));
+    std::shared_ptr<const MediaSegmentSequence> segment_sequence,
+    bool replace_buffered) {
+  pimpl_->StartSwitch(segment_sequence.get());
+  pimpl_->SetMediaSegmentSequence(std::move(segment_sequence),
+                                  replace_buffered);
+}
+
+void StreamManager::PrefetchInitSegments(
+    std::vector<std::shared_ptr<const MediaSegmentSequence>> sequences) {
+  pimpl_->PrefetchInitSegments(std::move(sequences));
+}
+
+void StreamManager::ReplaceMediaSegmentSequence(
+    std::shared_ptr<const MediaSegmentSequence> segment_sequence) {
+  pimpl_->StartSwitch(segment_sequence.get());
+  pimpl_->ReplaceMediaSegmentSequence(std::move(segment_sequence));
+}
+
+void StreamManager::PrefetchSegment(
+    TimeTicks time, std::shared_ptr<const MediaSegmentSequence> sequence) {
+  pimpl_->PrefetchSegment(time, std::move(sequence));
+}
+
+void StreamManager::AddCachedSegments(const SegmentCache& segments) {
+  pimpl_->AddCachedSegments(segments);
+}
+
+void StreamManager::CopyCachedSegments(SegmentCache* destination) const {
+  pimpl_->CopyCachedSegments(destination);
+}
+
+void StreamManager::CancelSeek() {
+  pimpl_->CancelSeek();
+}
+
+void StreamManager::Trim() {
+  pimpl_->Trim();
+}
+
+void StreamManager::SetTrickPlay(bool enabled) {
+  pimpl_->SetTrickPlay(enabled);
+}
+
+void StreamManager::SetPlaybackRate(double rate) {
+  pimpl_->SetPlaybackRate(rate);
+}
+
+void StreamManager::SetTaskExecutor(std::shared_ptr<TaskExecutor> executor) {
+  pimpl_->SetTaskExecutor(std::move(executor));
+}
+
+void StreamManager::SetDownloadArbiter(
+    std::shared_ptr<DownloadArbiter> arbiter) {
+  pimpl_->SetDownloadArbiter(std::move(arbiter));
+}
+
+void StreamManager::SetPipelineLatency(PipelineLatency* latency) {
+  pimpl_->SetPipelineLatency(latency);
+}
+
+void StreamManager::SetDrmMetrics(DrmMetrics* metrics) {
+  pimpl_->SetDrmMetrics(metrics);
+}
+
+void StreamManager::SetPlaybackMetrics(PlaybackMetrics* metrics) {
+  pimpl_->SetPlaybackMetrics(metrics);
+}
+
+TimeTicks StreamManager::GetStallTimeout() const {
+  return pimpl_->GetStallTimeout();
+}
+
+bool StreamManager::IsDemuxerStalled() const {
+  return pimpl_->IsDemuxerStalled();
+}
+
+void StreamManager::RecreateDemuxerOnSeek() {
+  pimpl_->RecreateDemuxerOnSeek();
+}
+
+void StreamManager::SetLiveTargetBuffer(TimeTicks buffer) {
+  pimpl_->SetLiveTargetBuffer(buffer);
+}
+
+void StreamManager::SetStartTime(TimeTicks time) {
+  pimpl_->SetStartTime(time);
+}
+
+void StreamManager::SetMoreMediaExpected(bool expected) {
+  pimpl_->SetMoreMediaExpected(expected);
 }
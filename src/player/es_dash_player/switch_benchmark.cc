@@ -0,0 +1,446 @@
+/*!
+ * switch_benchmark.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include "player/es_dash_player/switch_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "common.h"
+#include "dash/dash_manifest.h"
+#include "dash/media_stream.h"
+#include "dash/util.h"
+#include "player/es_dash_player/benchmark_pipeline.h"
+
+#include "abr_engine.h"
+#include "recording_es_backend.h"
+
+using Samsung::NaClPlayer::TimeTicks;
+using std::chrono::steady_clock;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The link segments are replayed over, see NetworkSimulation::DefaultTraces.
+const char kTraceName[] = "dsl";
+
+struct Scenario {
+  const char* name;
+  // Passed to StreamManager::SetMediaSegmentSequence().
+  bool replace_buffered;
+};
+
+constexpr Scenario kScenarios[] = {
+  {"keepBuffered", false},
+  {"replaceBuffered", true},
+};
+
+constexpr size_t kSwitchesPerScenario = 8;
+// A switch is made after that much playback since the previous one
+// completed.
+constexpr TimeTicks kSwitchInterval = 8.;  // seconds
+// Playback of longer content is simulated up to that position.
+constexpr TimeTicks kMaxContentTime = 600.;  // seconds
+// A switch which appends no packet of the new representation within that
+// much of real and simulated time is counted as timed out.
+constexpr double kSwitchTimeout = 30.;  // seconds
+// A run stops when playback doesn't start, or stalls, for that long.
+constexpr double kStallTimeout = 30.;  // seconds
+// The link idles that much per step when streams download nothing, so
+// playback goes on.
+constexpr double kIdleStep = 0.1;  // seconds
+
+}  // anonymous namespace
+
+// Plays the content on a BenchmarkPipeline and makes the switches of a
+// scenario, driven by Step() calls on the benchmark thread. Playback
+// follows the link time, but not past the last appended video packet.
+class SwitchBenchmark::Session {
+ public:
+  Session(const pp::InstanceHandle& instance, DashManifest* manifest,
+          ReplayCache* replay_cache, TimeTicks content_end,
+          const Scenario& scenario, bool measured)
+      : manifest_(manifest),
+        replay_cache_(replay_cache),
+        content_end_(content_end),
+        scenario_(scenario),
+        measured_(measured),
+        low_id_(-1),
+        high_id_(-1),
+        current_id_(-1),
+        pipeline_(instance, manifest, replay_cache),
+        playing_(false),
+        playback_time_(0.),
+        link_time_(0.),
+        last_pts_(-1.),
+        progress_time_(0.),
+        next_switch_time_(0.),
+        switches_made_(0),
+        switching_(false),
+        link_start_(0.) {}
+
+  // Creates the pipeline, returns false if the content has no alternative
+  // video representations.
+  bool Start() {
+    vector<VideoStream> video_streams = manifest_->GetVideoStreams();
+    vector<AudioStream> audio_streams = manifest_->GetAudioStreams();
+    if (video_streams.empty()) {
+      LOG_ERROR("No video streams");
+      return false;
+    }
+    const VideoStream& first = video_streams.front();
+    const VideoStream* low = &first;
+    const VideoStream* high = &first;
+    for (const auto& representation : video_streams) {
+      if (!IsSameKind(representation, first)) continue;
+      if (representation.description.bitrate < low->description.bitrate)
+        low = &representation;
+      if (representation.description.bitrate > high->description.bitrate)
+        high = &representation;
+    }
+    if (low == high) {
+      LOG_INFO("Switches need two video representations");
+      return false;
+    }
+    low_id_ = low->description.id;
+    high_id_ = high->description.id;
+    current_id_ = low_id_;
+
+    int32_t audio_id =
+        audio_streams.empty() ? -1 : audio_streams.front().description.id;
+    return pipeline_.Start(current_id_, audio_id);
+  }
+
+  // Runs due stream tasks, moves playback on and makes switches. Returns
+  // false when the scenario is done.
+  bool Step() {
+    pipeline_.Step(playback_time_);
+    UpdatePlayback();
+
+    if (!playing_) {
+      if (replay_cache_->Time() - progress_time_ > kStallTimeout) {
+        LOG_ERROR("%s: playback didn't start", scenario_.name);
+        return false;
+      }
+    } else if (replay_cache_->Time() - progress_time_ > kStallTimeout) {
+      LOG_ERROR("%s: playback stalled at %f [s]", scenario_.name,
+                playback_time_);
+      CloseSwitch();
+      return false;
+    }
+    if (switching_) CheckSwitch();
+
+    if (playing_ && !switching_ && playback_time_ >= next_switch_time_) {
+      CloseSwitch();
+      if (switches_made_ >= kSwitchesPerScenario ||
+          playback_time_ >= content_end_ - kSwitchInterval)
+        return false;
+      StartSwitch();
+    }
+    // Nothing is downloaded until buffers drain, so the link idles.
+    if (pipeline_.IsSettled())
+      replay_cache_->AdvanceTo(replay_cache_->Time() + kIdleStep);
+    return true;
+  }
+
+  const std::map<string, Samples>& samples() const { return samples_; }
+
+ private:
+  // Plays from the first appended video packet, for as long as the link
+  // took since the previous step.
+  void UpdatePlayback() {
+    auto stats = pipeline_.backend()->GetStats(StreamType::Video);
+    double now = replay_cache_->Time();
+    if (stats.last_pts > last_pts_) {
+      last_pts_ = stats.last_pts;
+      progress_time_ = now;
+    }
+    if (!playing_) {
+      if (stats.packets == 0) return;
+      playing_ = true;
+      playback_time_ = stats.first_pts;
+      next_switch_time_ = playback_time_ + kSwitchInterval;
+    } else {
+      playback_time_ = std::min(playback_time_ + now - link_time_, last_pts_);
+    }
+    link_time_ = now;
+  }
+
+  void StartSwitch() {
+    current_id_ = current_id_ == low_id_ ? high_id_ : low_id_;
+    direction_ = current_id_ == high_id_ ? "up" : "down";
+    stats_start_ = pipeline_.stream(StreamType::Video)->GetSwitchStats();
+    switch_start_ = steady_clock::now();
+    link_start_ = replay_cache_->Time();
+    switching_ = true;
+    ++switches_made_;
+    pipeline_.ChangeRepresentation(StreamType::Video, current_id_,
+                                   scenario_.replace_buffered);
+  }
+
+  // Takes the time of the first packet of the new representation.
+  void CheckSwitch() {
+    double latency_ms = MillisecondsSince(switch_start_) +
+        (replay_cache_->Time() - link_start_) * 1e3;
+    auto stats = pipeline_.stream(StreamType::Video)->GetSwitchStats();
+    bool done = stats.completed > stats_start_.completed;
+    bool timed_out = !done && latency_ms > kSwitchTimeout * 1e3;
+    if (!done && !timed_out) return;
+
+    if (measured_) {
+      Samples& samples = samples_[direction_];
+      ++samples.switches;
+      if (timed_out)
+        ++samples.timeouts;
+      else
+        samples.latency.push_back(latency_ms);
+    } else if (timed_out) {
+      LOG_ERROR("%s: switch to %d timed out", scenario_.name, current_id_);
+    }
+    switching_ = false;
+    next_switch_time_ = playback_time_ + kSwitchInterval;
+  }
+
+  // Counts wasted bytes and decoder configs since the last switch started.
+  void CloseSwitch() {
+    if (direction_.empty() || !measured_) return;
+    auto stats = pipeline_.stream(StreamType::Video)->GetSwitchStats();
+    Samples& samples = samples_[direction_];
+    samples.wasted_bytes += stats.wasted_bytes - stats_start_.wasted_bytes;
+    samples.decoder_configs +=
+        stats.decoder_configs - stats_start_.decoder_configs;
+    direction_.clear();
+  }
+
+  DashManifest* manifest_;
+  ReplayCache* replay_cache_;
+  TimeTicks content_end_;
+  const Scenario& scenario_;
+  bool measured_;
+  // The lowest and the highest bitrate video representation.
+  int32_t low_id_;
+  int32_t high_id_;
+  int32_t current_id_;
+
+  BenchmarkPipeline pipeline_;
+  bool playing_;
+  TimeTicks playback_time_;
+  // Link time playback was moved to.
+  double link_time_;
+  // The last video packet appended and the link time it changed at.
+  TimeTicks last_pts_;
+  double progress_time_;
+  TimeTicks next_switch_time_;
+
+  size_t switches_made_;
+  // Set until the switch in progress appends a packet or times out.
+  bool switching_;
+  // Direction of the last switch, empty once its counters are taken.
+  string direction_;
+  StreamManager::SwitchStats stats_start_;
+  steady_clock::time_point switch_start_;
+  double link_start_;
+  // Keyed by direction.
+  std::map<string, Samples> samples_;
+};
+
+SwitchBenchmark::SwitchBenchmark(const pp::InstanceHandle& instance)
+    : instance_(instance),
+      cc_factory_(this),
+      running_(false),
+      cancelled_(false),
+      next_manifest_(0),
+      content_end_(0.),
+      scenario_(0),
+      measured_(false),
+      thread_(instance) {
+  thread_.Start();
+}
+
+SwitchBenchmark::~SwitchBenchmark() {
+  cancelled_ = true;
+  thread_.Join();
+}
+
+bool SwitchBenchmark::Start(const vector<string>& manifest_urls,
+                            const ResultCallback& callback) {
+  if (running_.exchange(true)) {
+    LOG_ERROR("A switch benchmark is running already");
+    return false;
+  }
+  manifest_urls_ = manifest_urls;
+  callback_ = callback;
+  thread_.message_loop().PostWork(cc_factory_.NewCallback(
+      &SwitchBenchmark::RunOnBenchmarkThread));
+  return true;
+}
+
+void SwitchBenchmark::RunOnBenchmarkThread(int32_t) {
+  for (const auto& trace : NetworkSimulation::DefaultTraces()) {
+    if (trace.name == kTraceName)
+      replay_cache_ = std::make_shared<ReplayCache>(trace);
+  }
+  auto replay_cache = replay_cache_;
+  SetLocalDataSource([replay_cache](const SegmentDescriptor& location,
+                                    vector<uint8_t>* data) {
+    return replay_cache->Read(location, data);
+  });
+  next_manifest_ = 0;
+  samples_.clear();
+  StartNextRun();
+}
+
+void SwitchBenchmark::StartNextRun() {
+  // Each scenario runs twice, first to fill the replay cache.
+  if (session_) {
+    if (measured_) {
+      for (const auto& entry : session_->samples()) {
+        auto& samples = samples_[{kScenarios[scenario_].name, entry.first}];
+        const Samples& session_samples = entry.second;
+        ++samples.contents;
+        samples.switches += session_samples.switches;
+        samples.timeouts += session_samples.timeouts;
+        samples.wasted_bytes += session_samples.wasted_bytes;
+        samples.decoder_configs += session_samples.decoder_configs;
+        samples.latency.insert(samples.latency.end(),
+                               session_samples.latency.begin(),
+                               session_samples.latency.end());
+      }
+      ++scenario_;
+    }
+    measured_ = !measured_;
+    session_.reset();
+  }
+
+  constexpr size_t kScenarioCount =
+      sizeof(kScenarios) / sizeof(kScenarios[0]);
+  while (!cancelled_) {
+    if (!manifest_ || scenario_ >= kScenarioCount) {
+      if (!LoadNextManifest()) break;
+    }
+    session_ = MakeUnique<Session>(instance_, manifest_.get(),
+        replay_cache_.get(), content_end_, kScenarios[scenario_], measured_);
+    if (session_->Start()) {
+      thread_.message_loop().PostWork(cc_factory_.NewCallback(
+          &SwitchBenchmark::StepOnBenchmarkThread));
+      return;
+    }
+    // Other scenarios can't use the content either.
+    session_.reset();
+    measured_ = false;
+    manifest_.reset();
+  }
+  Finish();
+}
+
+bool SwitchBenchmark::LoadNextManifest() {
+  manifest_.reset();
+  replay_cache_->Clear();
+  while (!cancelled_ && next_manifest_ < manifest_urls_.size()) {
+    const string& url = manifest_urls_[next_manifest_++];
+    string mpd;
+    if (!DashManifest::DownloadManifest(url, &mpd)) {
+      LOG_ERROR("Failed to download %s", url.c_str());
+      continue;
+    }
+    manifest_ = DashManifest::ParseMPD(url, mpd);
+    if (!manifest_) {
+      LOG_ERROR("Failed to parse %s", url.c_str());
+      continue;
+    }
+    double duration = ParseDurationToSeconds(manifest_->GetDuration());
+    if (manifest_->IsDynamic() || duration <= 0.) {
+      LOG_ERROR("Only static content with a duration can be used: %s",
+                url.c_str());
+      manifest_.reset();
+      continue;
+    }
+    manifest_->LoadSegmentIndexes();
+    content_end_ = std::min(duration, kMaxContentTime);
+    scenario_ = 0;
+    measured_ = false;
+    LOG_INFO("Switch benchmark of %s", url.c_str());
+    return true;
+  }
+  return false;
+}
+
+void SwitchBenchmark::StepOnBenchmarkThread(int32_t) {
+  if (cancelled_) {
+    Finish();
+    return;
+  }
+  // Demuxer callbacks are dispatched by the message loop of this thread, so
+  // it's not blocked between steps.
+  if (session_->Step()) {
+    thread_.message_loop().PostWork(cc_factory_.NewCallback(
+        &SwitchBenchmark::StepOnBenchmarkThread));
+  } else {
+    thread_.message_loop().PostWork(cc_factory_.NewCallback(
+        &SwitchBenchmark::StartNextRunOnBenchmarkThread));
+  }
+}
+
+void SwitchBenchmark::StartNextRunOnBenchmarkThread(int32_t) {
+  StartNextRun();
+}
+
+void SwitchBenchmark::Finish() {
+  session_.reset();
+  manifest_.reset();
+  SetLocalDataSource(nullptr);
+  replay_cache_.reset();
+
+  for (auto& entry : samples_) {
+    if (cancelled_) break;
+    Samples& samples = entry.second;
+    Result result = Result();
+    result.scenario = entry.first.first;
+    result.direction = entry.first.second;
+    result.contents = samples.contents;
+    result.switches = samples.switches;
+    result.timeouts = samples.timeouts;
+    std::sort(samples.latency.begin(), samples.latency.end());
+    result.latency_p50 = Percentile(samples.latency, 50.);
+    result.latency_p90 = Percentile(samples.latency, 90.);
+    result.latency_max = Percentile(samples.latency, 100.);
+    if (samples.switches > 0) {
+      result.wasted_bytes_per_switch =
+          static_cast<double>(samples.wasted_bytes) / samples.switches;
+      result.decoder_reinits_per_switch =
+          static_cast<double>(samples.decoder_configs) / samples.switches;
+    }
+    LOG_INFO("%s %s: %u switches (%u timed out), latency p50: %.1f p90: "
+             "%.1f max: %.1f [ms], wasted: %.0f [B], decoder re-inits: "
+             "%.2f per switch", result.scenario.c_str(),
+             result.direction.c_str(), result.switches, result.timeouts,
+             result.latency_p50, result.latency_p90, result.latency_max,
+             result.wasted_bytes_per_switch,
+             result.decoder_reinits_per_switch);
+    if (callback_) callback_(result);
+  }
+  samples_.clear();
+  manifest_urls_.clear();
+  callback_ = nullptr;
+  running_ = false;
+}
@@ -0,0 +1,132 @@
+/*!
+ * switch_benchmark.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_SWITCH_BENCHMARK_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_SWITCH_BENCHMARK_H_
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/simple_thread.h"
+
+class DashManifest;
+class ReplayCache;
+
+// Measures representation switches of the pipeline, like SeekBenchmark
+// does with seeks: a BenchmarkPipeline plays the content over the "dsl"
+// link of a ReplayCache, each scenario runs twice and only the second run
+// is measured.
+//
+// The video stream switches between its lowest and highest bitrate
+// representation every few seconds of playback, keeping buffered packets
+// or replacing them (see StreamManager::SetMediaSegmentSequence()). Each
+// switch measures the time from the change to the first packet of the new
+// representation appended to the backend (real processing time plus
+// simulated network time), segment bytes downloaded in vain and configs
+// passed to the backend, i.e. decoder re-initializations, until the next
+// switch. How often AbrEngine oscillates between bitrates is measured by
+// NetworkSimulation instead.
+class SwitchBenchmark {
+ public:
+  struct Result {
+    // "keepBuffered" or "replaceBuffered".
+    std::string scenario;
+    // "up" or "down".
+    std::string direction;
+    // Manifests with at least two video representations.
+    uint32_t contents;
+    uint32_t switches;
+    // Switches which appended no packet of the new representation within a
+    // time limit.
+    uint32_t timeouts;
+    // Time to the first packet of the new representation, in milliseconds.
+    double latency_p50;
+    double latency_p90;
+    double latency_max;
+    double wasted_bytes_per_switch;
+    double decoder_reinits_per_switch;
+  };
+
+  // Called once per scenario and direction when all manifests are done, on
+  // the benchmark thread.
+  typedef std::function<void(const Result&)> ResultCallback;
+
+  explicit SwitchBenchmark(const pp::InstanceHandle& instance);
+  ~SwitchBenchmark();
+
+  // Starts a benchmark of the given manifests, unless one is running
+  // already.
+  bool Start(const std::vector<std::string>& manifest_urls,
+             const ResultCallback& callback);
+
+  bool IsRunning() const { return running_; }
+
+ private:
+  class Session;
+
+  // Samples of a scenario and direction.
+  struct Samples {
+    uint32_t contents = 0;
+    uint32_t switches = 0;
+    uint32_t timeouts = 0;
+    uint64_t wasted_bytes = 0;
+    uint32_t decoder_configs = 0;
+    std::vector<double> latency;
+  };
+
+  void RunOnBenchmarkThread(int32_t);
+  // Starts the next run of a scenario, moving to the next manifest when
+  // all scenarios of the current one are done.
+  void StartNextRun();
+  void StartNextRunOnBenchmarkThread(int32_t);
+  bool LoadNextManifest();
+  void StepOnBenchmarkThread(int32_t);
+  // Reports results.
+  void Finish();
+
+  pp::InstanceHandle instance_;
+  pp::CompletionCallbackFactory<SwitchBenchmark> cc_factory_;
+  std::atomic<bool> running_;
+  std::atomic<bool> cancelled_;
+
+  // Used on the benchmark thread while a benchmark runs.
+  std::vector<std::string> manifest_urls_;
+  size_t next_manifest_;
+  ResultCallback callback_;
+  std::shared_ptr<ReplayCache> replay_cache_;
+  std::unique_ptr<DashManifest> manifest_;
+  double content_end_;
+  size_t scenario_;
+  // Whether the current run of the scenario is the measured one.
+  bool measured_;
+  std::unique_ptr<Session> session_;
+  // Keyed by scenario and direction.
+  std::map<std::pair<std::string, std::string>, Samples> samples_;
+
+  // Declared last, so it's joined before other members are destroyed.
+  pp::SimpleThread thread_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_SWITCH_BENCHMARK_H_
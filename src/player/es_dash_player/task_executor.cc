@@ -0,0 +1,103 @@
+/*!
+ * task_executor.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#include "player/es_dash_player/task_executor.h"
+
+#include <algorithm>
+
+#include "ppapi/c/pp_errors.h"
+
+using std::chrono::milliseconds;
+
+constexpr size_t SimulatedExecutor::kDefaultMaxTasks;
+
+TaskExecutor::~TaskExecutor() = default;
+
+MessageLoopExecutor::MessageLoopExecutor(const pp::MessageLoop& message_loop)
+    : message_loop_(message_loop) {}
+
+MessageLoopExecutor::~MessageLoopExecutor() = default;
+
+TaskExecutor::Clock::time_point MessageLoopExecutor::Now() const {
+  return Clock::now();
+}
+
+void MessageLoopExecutor::PostWork(const pp::CompletionCallback& callback,
+                                   int64_t delay_ms) {
+  message_loop_.PostWork(callback, delay_ms);
+}
+
+SimulatedExecutor::SimulatedExecutor(Clock::time_point start_time)
+    : now_(start_time), next_sequence_(0) {}
+
+SimulatedExecutor::~SimulatedExecutor() = default;
+
+TaskExecutor::Clock::time_point SimulatedExecutor::Now() const {
+  pp::AutoLock lock(lock_);
+  return now_;
+}
+
+void SimulatedExecutor::PostWork(const pp::CompletionCallback& callback,
+                                 int64_t delay_ms) {
+  pp::AutoLock lock(lock_);
+  tasks_.push(Task{now_ + milliseconds(std::max<int64_t>(delay_ms, 0)),
+                   next_sequence_++, callback});
+}
+
+bool SimulatedExecutor::PopTaskDueAt(Clock::time_point time, Task* task) {
+  pp::AutoLock lock(lock_);
+  if (tasks_.empty() || tasks_.top().due_time > time) return false;
+  *task = tasks_.top();
+  tasks_.pop();
+  // Tasks posted by this one are delayed relative to its due time.
+  now_ = std::max(now_, task->due_time);
+  return true;
+}
+
+size_t SimulatedExecutor::RunUntilIdle(size_t max_tasks) {
+  size_t run = 0;
+  Task task;
+  // The lock isn't held while a task runs, so it can post more of them.
+  while (run < max_tasks && PopTaskDueAt(Now(), &task)) {
+    task.callback.Run(PP_OK);
+    ++run;
+  }
+  return run;
+}
+
+size_t SimulatedExecutor::AdvanceBy(milliseconds time, size_t max_tasks) {
+  auto end_time = Now() + time;
+  size_t run = 0;
+  Task task;
+  while (run < max_tasks && PopTaskDueAt(end_time, &task)) {
+    task.callback.Run(PP_OK);
+    ++run;
+  }
+  // When stopped by max_tasks, the time stays at the last task run.
+  if (run < max_tasks) {
+    pp::AutoLock lock(lock_);
+    now_ = std::max(now_, end_time);
+  }
+  return run;
+}
+
+size_t SimulatedExecutor::PendingTasks() const {
+  pp::AutoLock lock(lock_);
+  return tasks_.size();
+}
@@ -0,0 +1,133 @@
+/*!
+ * text_stream_manager.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include "text_stream_manager.h"
+
+#include <utility>
+
+#include "common.h"
+
+#include "bandwidth_estimator.h"
+#include "network_executor.h"
+
+using Samsung::NaClPlayer::TimeTicks;
+
+namespace {
+
+// Text segments are small, so they are downloaded that far ahead of the
+// playback position, one at a time and after media segments.
+constexpr TimeTicks kTextBufferAhead = 10.0;  // in seconds
+constexpr size_t kTextPrefetchDepth = 1;
+
+}  // namespace
+
+TextStreamManager::TextStreamManager(const pp::InstanceHandle& instance,
+    std::shared_ptr<NetworkExecutor> network_executor,
+    std::shared_ptr<BandwidthEstimator> bandwidth_estimator,
+    std::shared_ptr<TaskExecutor> task_executor,
+    std::function<void(std::vector<TextCue>)> cues_callback)
+    : task_executor_(std::move(task_executor)),
+      cues_callback_(std::move(cues_callback)),
+      representation_id_(0),
+      cc_factory_(this) {
+  data_provider_ = MakeUnique<AsyncDataProvider>(instance,
+      [this](std::unique_ptr<MediaSegment> segment) {
+        OnSegment(std::move(segment));
+      },
+      std::move(network_executor), std::move(bandwidth_estimator),
+      NetworkExecutor::Priority::kPrefetch, kTextPrefetchDepth);
+  data_provider_->SetTaskExecutor(task_executor_);
+}
+
+TextStreamManager::~TextStreamManager() {
+  // Waits for downloads, which deliver segments to this object.
+  data_provider_.reset();
+}
+
+bool TextStreamManager::Initialize(
+    std::shared_ptr<const MediaSegmentSequence> sequence,
+    const std::vector<uint8_t>& init_segment, const TextStream& stream,
+    TimeTicks time) {
+  parser_ = TextTrackParser::Create(stream.mime_type,
+                                    stream.description.codecs);
+  if (!parser_) return false;
+  if (!sequence) {
+    LOG_ERROR("Text representation %u has no segments",
+              stream.description.id);
+    return false;
+  }
+
+  std::vector<TextCue> cues;
+  if (parser_->NeedsInitSegment() &&
+      !parser_->Parse(init_segment.data(), init_segment.size(), &cues)) {
+    LOG_ERROR("Failed to parse a text init segment");
+    return false;
+  }
+  representation_id_ = stream.description.id;
+  data_provider_->SetMediaSegmentSequence(std::move(sequence), time);
+  LOG_INFO("Text representation %u (%s) starts at %f [s]",
+           representation_id_, stream.language.c_str(), time);
+  return true;
+}
+
+void TextStreamManager::UpdateBuffer(TimeTicks playback_time) {
+  if (!parser_) return;
+
+  while (data_provider_->PendingSegments() < data_provider_->PrefetchDepth()) {
+    auto pending_segments = data_provider_->PendingSegments();
+    if (pending_segments > 0 &&
+        data_provider_->RequestedSegmentsEndTime() - playback_time >=
+            kTextBufferAhead)
+      break;
+    if (!data_provider_->RequestNextDataSegment()) break;
+    // Live edge reached, the next segment is not available yet.
+    if (data_provider_->PendingSegments() == pending_segments) break;
+  }
+}
+
+void TextStreamManager::PrepareForSeek(TimeTicks time) {
+  // Segments requested before the seek are not needed.
+  data_provider_->CancelRequests();
+  task_executor_->PostWork(cc_factory_.NewCallback(
+      &TextStreamManager::SeekOnExecutorThread, time));
+}
+
+void TextStreamManager::SeekOnExecutorThread(int32_t, TimeTicks time) {
+  data_provider_->SetNextSegmentToTime(time);
+}
+
+void TextStreamManager::OnSegment(std::unique_ptr<MediaSegment> segment) {
+  // An empty segment signals the end of the stream.
+  if (!segment || segment->data_.empty()) return;
+
+  std::vector<TextCue> cues;
+  if (!parser_->Parse(segment->data_.data(), segment->data_.size(), &cues))
+    LOG_ERROR("Failed to parse a text segment at %f [s]", segment->timestamp_);
+  if (cues.empty()) return;
+
+  for (auto& cue : cues) {
+    cue.start += segment->timestamp_offset_;
+    cue.end += segment->timestamp_offset_;
+  }
+  LOG_DEBUG("Parsed %zu cues of a text segment at %f [s]", cues.size(),
+            segment->timestamp_);
+  cues_callback_(std::move(cues));
+}
@@ -0,0 +1,91 @@
+/*!
+ * text_stream_manager.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_TEXT_STREAM_MANAGER_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_TEXT_STREAM_MANAGER_H_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "nacl_player/media_common.h"
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/utility/completion_callback_factory.h"
+
+#include "dash/media_segment_sequence.h"
+#include "dash/media_stream.h"
+#include "player/es_dash_player/task_executor.h"
+#include "player/es_dash_player/text_track_parser.h"
+
+#include "async_data_provider.h"
+
+class BandwidthEstimator;
+class NetworkExecutor;
+
+// Downloads segments of a DASH text representation a little ahead of the
+// playback position and passes cues parsed from them to a callback. Text is
+// not an elementary stream of NaCl Player, so cues are shown by the
+// application (see PacketsManager::OnTextCues()). It must be used on the
+// thread of the task executor, apart from PrepareForSeek().
+class TextStreamManager {
+ public:
+  TextStreamManager(const pp::InstanceHandle& instance,
+                    std::shared_ptr<NetworkExecutor> network_executor,
+                    std::shared_ptr<BandwidthEstimator> bandwidth_estimator,
+                    std::shared_ptr<TaskExecutor> task_executor,
+                    std::function<void(std::vector<TextCue>)> cues_callback);
+  ~TextStreamManager();
+
+  // Starts the stream at the given time. init_segment is parsed if the
+  // format of the representation needs one. Returns false if the format is
+  // not supported or the init segment is malformed.
+  bool Initialize(std::shared_ptr<const MediaSegmentSequence> sequence,
+                  const std::vector<uint8_t>& init_segment,
+                  const TextStream& stream,
+                  Samsung::NaClPlayer::TimeTicks time);
+
+  // Counts downloaded text segments in playback metrics of the player,
+  // which must outlive this object. Must be called before Initialize().
+  void SetPlaybackMetrics(PlaybackMetrics* metrics) {
+    data_provider_->SetPlaybackMetrics(metrics);
+  }
+
+  // Requests segments up to kTextBufferAhead past the playback position.
+  void UpdateBuffer(Samsung::NaClPlayer::TimeTicks playback_time);
+
+  // Drops requested segments and continues from the given time. It can be
+  // called on any thread.
+  void PrepareForSeek(Samsung::NaClPlayer::TimeTicks time);
+
+  // An id of the representation used by the stream.
+  uint32_t RepresentationId() const { return representation_id_; }
+
+ private:
+  void OnSegment(std::unique_ptr<MediaSegment> segment);
+  void SeekOnExecutorThread(int32_t, Samsung::NaClPlayer::TimeTicks time);
+
+  std::shared_ptr<TaskExecutor> task_executor_;
+  std::function<void(std::vector<TextCue>)> cues_callback_;
+  std::unique_ptr<AsyncDataProvider> data_provider_;
+  std::unique_ptr<TextTrackParser> parser_;
+  uint32_t representation_id_;
+  pp::CompletionCallbackFactory<TextStreamManager> cc_factory_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_TEXT_STREAM_MANAGER_H_
@@ -0,0 +1,677 @@
+/*!
+ * text_track_parser.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDemuxer
+
+#include "player/es_dash_player/text_track_parser.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "common.h"
+
+namespace {
+
+const char kWebVttMimeType[] = "text/vtt";
+const char kTtmlMimeType[] = "application/ttml+xml";
+const char kMp4MimeType[] = "application/mp4";
+const char kWebVttCodec[] = "wvtt";
+const char kTtmlCodec[] = "stpp";
+const char kUtf8Bom[] = "\xEF\xBB\xBF";
+// Used by TTML frame based times when ttp:frameRate is missing.
+constexpr double kDefaultTtmlFrameRate = 30.;
+
+constexpr uint32_t Fourcc(char a, char b, char c, char d) {
+  return static_cast<uint32_t>(static_cast<uint8_t>(a)) << 24 |
+         static_cast<uint32_t>(static_cast<uint8_t>(b)) << 16 |
+         static_cast<uint32_t>(static_cast<uint8_t>(c)) << 8 |
+         static_cast<uint32_t>(static_cast<uint8_t>(d));
+}
+
+constexpr uint32_t kMoov = Fourcc('m', 'o', 'o', 'v');
+constexpr uint32_t kTrak = Fourcc('t', 'r', 'a', 'k');
+constexpr uint32_t kMdia = Fourcc('m', 'd', 'i', 'a');
+constexpr uint32_t kMdhd = Fourcc('m', 'd', 'h', 'd');
+constexpr uint32_t kMoof = Fourcc('m', 'o', 'o', 'f');
+constexpr uint32_t kTraf = Fourcc('t', 'r', 'a', 'f');
+constexpr uint32_t kTfhd = Fourcc('t', 'f', 'h', 'd');
+constexpr uint32_t kTfdt = Fourcc('t', 'f', 'd', 't');
+constexpr uint32_t kTrun = Fourcc('t', 'r', 'u', 'n');
+constexpr uint32_t kMdat = Fourcc('m', 'd', 'a', 't');
+constexpr uint32_t kVttc = Fourcc('v', 't', 't', 'c');
+constexpr uint32_t kPayl = Fourcc('p', 'a', 'y', 'l');
+
+// tfhd flags
+constexpr uint32_t kBaseDataOffsetPresent = 0x1;
+constexpr uint32_t kSampleDescriptionIndexPresent = 0x2;
+constexpr uint32_t kDefaultSampleDurationPresent = 0x8;
+constexpr uint32_t kDefaultSampleSizePresent = 0x10;
+// trun flags
+constexpr uint32_t kDataOffsetPresent = 0x1;
+constexpr uint32_t kFirstSampleFlagsPresent = 0x4;
+constexpr uint32_t kSampleDurationPresent = 0x100;
+constexpr uint32_t kSampleSizePresent = 0x200;
+constexpr uint32_t kSampleFlagsPresent = 0x400;
+constexpr uint32_t kSampleCompositionTimeOffsetPresent = 0x800;
+
+// Appends text, replacing character references used in subtitles with
+// characters they stand for.
+void AppendDecoded(const char* begin, const char* end, std::string* out) {
+  static const struct {
+    const char* reference;
+    const char* text;
+  } kReferences[] = {
+      {"&amp;", "&"},   {"&lt;", "<"},   {"&gt;", ">"},  {"&quot;", "\""},
+      {"&apos;", "'"},  {"&nbsp;", " "}, {"&lrm;", ""},  {"&rlm;", ""},
+  };
+  for (const char* p = begin; p < end;) {
+    bool replaced = false;
+    if (*p == '&') {
+      for (const auto& reference : kReferences) {
+        size_t length = std::strlen(reference.reference);
+        if (static_cast<size_t>(end - p) < length ||
+            std::strncmp(p, reference.reference, length) != 0)
+          continue;
+        out->append(reference.text);
+        p += length;
+        replaced = true;
+        break;
+      }
+    }
+    if (!replaced) out->push_back(*p++);
+  }
+}
+
+// Appends a line of a cue without its markup, e.g. <b> or <c.yellow>.
+void AppendWithoutTags(const std::string& line, std::string* out) {
+  size_t pos = 0;
+  while (pos < line.size()) {
+    size_t tag = line.find('<', pos);
+    if (tag == std::string::npos) tag = line.size();
+    AppendDecoded(line.data() + pos, line.data() + tag, out);
+    if (tag == line.size()) break;
+
+    size_t tag_end = line.find('>', tag);
+    if (tag_end == std::string::npos) break;
+    pos = tag_end + 1;
+  }
+}
+
+// Reads a line ending with CR, LF or CRLF.
+bool NextLine(const std::string& text, size_t* pos, std::string* line) {
+  if (*pos >= text.size()) return false;
+
+  size_t end = text.find_first_of("\r\n", *pos);
+  if (end == std::string::npos) end = text.size();
+  line->assign(text, *pos, end - *pos);
+  *pos = end;
+  if (*pos < text.size() && text[*pos] == '\r') ++*pos;
+  if (*pos < text.size() && text[*pos] == '\n') ++*pos;
+  return true;
+}
+
+// Parses a WebVTT timestamp "[hh:]mm:ss.ttt" at *pos, moving *pos past it.
+bool ParseVttTimestamp(const std::string& line, size_t* pos, double* time) {
+  while (*pos < line.size() && IsSpace(line[*pos])) ++*pos;
+  const char* begin = line.c_str() + *pos;
+  const char* p = begin;
+  unsigned long fields[3];
+  size_t count = 0;
+  while (count < 3) {
+    char* end = nullptr;
+    fields[count] = std::strtoul(p, &end, 10);
+    if (end == p) return false;
+    ++count;
+    p = end;
+    if (*p != ':') break;
+    ++p;
+  }
+  if (count < 2 || *p != '.') return false;
+
+  char* end = nullptr;
+  unsigned long milliseconds = std::strtoul(p + 1, &end, 10);
+  if (end != p + 4) return false;
+
+  double hours = count == 3 ? fields[0] : 0.;
+  *time = hours * 3600. + fields[count - 2] * 60. + fields[count - 1] +
+          milliseconds / 1000.;
+  *pos += end - begin;
+  return true;
+}
+
+bool ParseWebVtt(const std::string& text, std::vector<TextCue>* cues) {
+  size_t pos = StartsWith(text, kUtf8Bom) ? std::strlen(kUtf8Bom) : 0;
+  if (text.compare(pos, 6, "WEBVTT") != 0) {
+    LOG_ERROR("WebVTT signature is missing");
+    return false;
+  }
+
+  // Blocks without a timing line (the header, NOTE, STYLE and REGION blocks)
+  // are skipped, a cue identifier preceding a timing line is ignored.
+  std::string line;
+  TextCue cue;
+  bool in_cue = false;
+  while (NextLine(text, &pos, &line)) {
+    if (in_cue && line.empty()) {
+      cues->push_back(cue);
+      in_cue = false;
+    } else if (in_cue) {
+      if (!cue.text.empty()) cue.text.push_back('\n');
+      AppendWithoutTags(line, &cue.text);
+    } else {
+      size_t arrow = line.find("-->");
+      if (arrow == std::string::npos) continue;
+
+      size_t start_pos = 0;
+      size_t end_pos = arrow + 3;
+      if (!ParseVttTimestamp(line, &start_pos, &cue.start) ||
+          !ParseVttTimestamp(line, &end_pos, &cue.end)) {
+        LOG_ERROR("Invalid WebVTT timing: %s", line.c_str());
+        continue;
+      }
+      cue.text.clear();
+      in_cue = true;
+    }
+  }
+  if (in_cue) cues->push_back(cue);
+  return true;
+}
+
+// Timing parameters of a TTML document.
+struct TtmlTiming {
+  double frame_rate;
+  double tick_rate;
+};
+
+// Parses a TTML time expression: a clock time "hh:mm:ss[.fraction]" or
+// "hh:mm:ss:frames", or an offset time, e.g. "1.5s" or "40f".
+bool ParseTtmlTime(const std::string& value, const TtmlTiming& timing,
+                   double* time) {
+  const char* p = value.c_str();
+  char* end = nullptr;
+  double number = std::strtod(p, &end);
+  if (end == p) return false;
+
+  if (*end == ':') {
+    double hours = number;
+    p = end + 1;
+    double minutes = std::strtod(p, &end);
+    if (end == p || *end != ':') return false;
+    p = end + 1;
+    double seconds = std::strtod(p, &end);
+    if (end == p) return false;
+    double frames = 0.;
+    if (*end == ':') frames = std::strtod(end + 1, nullptr);
+    *time = hours * 3600. + minutes * 60. + seconds +
+            frames / timing.frame_rate;
+    return true;
+  }
+
+  std::string metric(end);
+  if (metric == "h") {
+    *time = number * 3600.;
+  } else if (metric == "m") {
+    *time = number * 60.;
+  } else if (metric == "s" || metric.empty()) {
+    *time = number;
+  } else if (metric == "ms") {
+    *time = number / 1000.;
+  } else if (metric == "f") {
+    *time = number / timing.frame_rate;
+  } else if (metric == "t") {
+    *time = number / timing.tick_rate;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// A start or end tag of an XML element, namespace prefixes are dropped
+// from its name.
+struct XmlTag {
+  std::string name;
+  std::string attributes;
+  size_t begin;
+  bool closing;
+  bool self_closing;
+};
+
+// Finds the next tag at or after *pos, skipping comments, processing
+// instructions and declarations. *pos is moved past the tag.
+bool NextTag(const std::string& doc, size_t* pos, XmlTag* tag) {
+  while (true) {
+    size_t begin = doc.find('<', *pos);
+    if (begin == std::string::npos) return false;
+
+    if (doc.compare(begin, 4, "<!--") == 0) {
+      size_t end = doc.find("-->", begin);
+      if (end == std::string::npos) return false;
+      *pos = end + 3;
+      continue;
+    }
+    size_t end = doc.find('>', begin);
+    if (end == std::string::npos) return false;
+    *pos = end + 1;
+    if (doc[begin + 1] == '?' || doc[begin + 1] == '!') continue;
+
+    tag->begin = begin;
+    tag->closing = doc[begin + 1] == '/';
+    tag->self_closing = doc[end - 1] == '/';
+    size_t name_begin = begin + (tag->closing ? 2 : 1);
+    size_t name_end = name_begin;
+    while (name_end < end && !IsSpace(doc[name_end]) && doc[name_end] != '/')
+      ++name_end;
+    size_t prefix = doc.rfind(':', name_end);
+    if (prefix != std::string::npos && prefix >= name_begin)
+      name_begin = prefix + 1;
+    tag->name.assign(doc, name_begin, name_end - name_begin);
+    tag->attributes.assign(doc, name_end, end - name_end);
+    return true;
+  }
+}
+
+// Gets a value of the attribute with a given qualified name.
+bool GetAttribute(const std::string& attributes, const char* name,
+                  std::string* value) {
+  size_t length = std::strlen(name);
+  for (size_t pos = attributes.find(name); pos != std::string::npos;
+       pos = attributes.find(name, pos + 1)) {
+    if (pos == 0 || !IsSpace(attributes[pos - 1])) continue;
+
+    size_t equals = pos + length;
+    while (equals < attributes.size() && IsSpace(attributes[equals])) ++equals;
+    if (equals + 1 >= attributes.size() || attributes[equals] != '=')
+      continue;
+
+    size_t quote = equals + 1;
+    while (quote < attributes.size() && IsSpace(attributes[quote])) ++quote;
+    if (quote >= attributes.size() ||
+        (attributes[quote] != '"' && attributes[quote] != '\''))
+      continue;
+
+    size_t end = attributes.find(attributes[quote], quote + 1);
+    if (end == std::string::npos) return false;
+    value->assign(attributes, quote + 1, end - quote - 1);
+    return true;
+  }
+  return false;
+}
+
+// Appends text of a TTML paragraph, collapsing white space like the default
+// xml:space does.
+void AppendCollapsed(const std::string& doc, size_t begin, size_t end,
+                     std::string* out) {
+  std::string decoded;
+  AppendDecoded(doc.data() + begin, doc.data() + end, &decoded);
+  for (char c : decoded) {
+    if (!IsSpace(c)) {
+      out->push_back(c);
+    } else if (!out->empty() && out->back() != ' ' && out->back() != '\n') {
+      out->push_back(' ');
+    }
+  }
+}
+
+void TrimTrailingSpace(std::string* text) {
+  while (!text->empty() && text->back() == ' ') text->pop_back();
+}
+
+// Parses timed paragraphs (<p> elements) of a TTML document. Timing
+// inherited from parent elements is not supported, as subtitle profiles
+// (e.g. EBU-TT-D and IMSC1) time paragraphs.
+bool ParseTtml(const std::string& doc, std::vector<TextCue>* cues) {
+  TtmlTiming timing = {kDefaultTtmlFrameRate, 1.};
+  size_t pos = 0;
+  size_t text_pos = 0;
+  XmlTag tag;
+  TextCue cue;
+  bool in_paragraph = false;
+  bool has_root = false;
+  while (NextTag(doc, &pos, &tag)) {
+    if (in_paragraph) {
+      AppendCollapsed(doc, text_pos, tag.begin, &cue.text);
+      text_pos = pos;
+      if (tag.name == "br") {
+        TrimTrailingSpace(&cue.text);
+        cue.text.push_back('\n');
+      } else if (tag.name == "p" && tag.closing) {
+        TrimTrailingSpace(&cue.text);
+        if (!cue.text.empty()) cues->push_back(cue);
+        in_paragraph = false;
+      }
+      continue;
+    }
+
+    if (tag.closing) continue;
+
+    std::string value;
+    if (tag.name == "tt") {
+      has_root = true;
+      if (GetAttribute(tag.attributes, "ttp:frameRate", &value))
+        timing.frame_rate = std::strtod(value.c_str(), nullptr);
+      if (timing.frame_rate <= 0.) timing.frame_rate = kDefaultTtmlFrameRate;
+      if (GetAttribute(tag.attributes, "ttp:tickRate", &value))
+        timing.tick_rate = std::strtod(value.c_str(), nullptr);
+      if (timing.tick_rate <= 0.) timing.tick_rate = 1.;
+      continue;
+    }
+    if (tag.name != "p" || tag.self_closing) continue;
+
+    if (!GetAttribute(tag.attributes, "begin", &value) ||
+        !ParseTtmlTime(value, timing, &cue.start))
+      continue;
+
+    double duration = 0.;
+    if (GetAttribute(tag.attributes, "end", &value)) {
+      if (!ParseTtmlTime(value, timing, &cue.end)) continue;
+    } else if (GetAttribute(tag.attributes, "dur", &value) &&
+               ParseTtmlTime(value, timing, &duration)) {
+      cue.end = cue.start + duration;
+    } else {
+      continue;
+    }
+    cue.text.clear();
+    text_pos = pos;
+    in_paragraph = true;
+  }
+  if (!has_root) {
+    LOG_ERROR("TTML root element is missing");
+    return false;
+  }
+  return true;
+}
+
+class WebVttParser : public TextTrackParser {
+ public:
+  bool Parse(const uint8_t* data, size_t size,
+             std::vector<TextCue>* cues) override {
+    return ParseWebVtt(
+        std::string(reinterpret_cast<const char*>(data), size), cues);
+  }
+};
+
+class TtmlParser : public TextTrackParser {
+ public:
+  bool Parse(const uint8_t* data, size_t size,
+             std::vector<TextCue>* cues) override {
+    return ParseTtml(
+        std::string(reinterpret_cast<const char*>(data), size), cues);
+  }
+};
+
+uint32_t ReadU32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 |
+         static_cast<uint32_t>(p[2]) << 8 | static_cast<uint32_t>(p[3]);
+}
+
+uint64_t ReadU64(const uint8_t* p) {
+  return static_cast<uint64_t>(ReadU32(p)) << 32 | ReadU32(p + 4);
+}
+
+struct Box {
+  uint32_t type;
+  size_t begin;
+  size_t payload;
+  size_t end;
+};
+
+// Reads a box header at *pos, which has to fit before end, and moves *pos
+// past the box.
+bool NextBox(const uint8_t* data, size_t end, size_t* pos, Box* box) {
+  if (*pos + 8 > end) return false;
+
+  uint64_t size = ReadU32(data + *pos);
+  box->type = ReadU32(data + *pos + 4);
+  box->begin = *pos;
+  box->payload = *pos + 8;
+  if (size == 1) {
+    if (*pos + 16 > end) return false;
+    size = ReadU64(data + *pos + 8);
+    box->payload += 8;
+  } else if (size == 0) {
+    size = end - *pos;
+  }
+  if (size < box->payload - box->begin || size > end - *pos) return false;
+
+  box->end = *pos + size;
+  *pos = box->end;
+  return true;
+}
+
+// WebVTT ("wvtt", ISO/IEC 14496-30) or TTML ("stpp") in ISO BMFF segments.
+class Mp4TextParser : public TextTrackParser {
+ public:
+  explicit Mp4TextParser(bool ttml) : ttml_(ttml), timescale_(0) {}
+
+  bool NeedsInitSegment() const override { return true; }
+
+  bool Parse(const uint8_t* data, size_t size,
+             std::vector<TextCue>* cues) override;
+
+ private:
+  struct Sample {
+    uint64_t time;
+    uint32_t duration;
+    uint32_t size;
+    // Position of the sample data, or -1 if it follows the previous sample
+    // (or starts the mdat box).
+    int64_t offset;
+  };
+
+  bool ParseMoov(const uint8_t* data, const Box& moov);
+  bool ParseTraf(const uint8_t* data, const Box& moof, const Box& traf);
+  bool ParseMdat(const uint8_t* data, size_t size, const Box& mdat,
+                 std::vector<TextCue>* cues);
+  void ParseSample(const uint8_t* data, const Sample& sample,
+                   std::vector<TextCue>* cues);
+
+  bool ttml_;
+  uint32_t timescale_;
+  // Samples of the last moof box, waiting for its mdat box.
+  std::vector<Sample> samples_;
+};
+
+bool Mp4TextParser::Parse(const uint8_t* data, size_t size,
+                          std::vector<TextCue>* cues) {
+  size_t pos = 0;
+  Box box;
+  while (pos < size) {
+    if (!NextBox(data, size, &pos, &box)) {
+      LOG_ERROR("Invalid box at %zu of %zu bytes", pos, size);
+      return false;
+    }
+    if (box.type == kMoov) {
+      if (!ParseMoov(data, box)) return false;
+    } else if (box.type == kMoof) {
+      samples_.clear();
+      Box traf;
+      for (size_t child = box.payload; NextBox(data, box.end, &child, &traf);)
+        if (traf.type == kTraf && !ParseTraf(data, box, traf)) return false;
+    } else if (box.type == kMdat) {
+      if (!ParseMdat(data, size, box, cues)) return false;
+    }
+  }
+  return true;
+}
+
+bool Mp4TextParser::ParseMoov(const uint8_t* data, const Box& moov) {
+  Box trak, mdia, box;
+  for (size_t p1 = moov.payload; NextBox(data, moov.end, &p1, &trak);) {
+    if (trak.type != kTrak) continue;
+    for (size_t p2 = trak.payload; NextBox(data, trak.end, &p2, &mdia);) {
+      if (mdia.type != kMdia) continue;
+      for (size_t p3 = mdia.payload; NextBox(data, mdia.end, &p3, &box);) {
+        if (box.type != kMdhd || box.payload + 4 > box.end) continue;
+        size_t timescale_pos = box.payload + (data[box.payload] == 1 ? 20 : 12);
+        if (timescale_pos + 4 > box.end) return false;
+        timescale_ = ReadU32(data + timescale_pos);
+        return timescale_ > 0;
+      }
+    }
+  }
+  LOG_ERROR("Timescale of the text track is missing");
+  return false;
+}
+
+bool Mp4TextParser::ParseTraf(const uint8_t* data, const Box& moof,
+                              const Box& traf) {
+  uint64_t base_offset = moof.begin;
+  uint64_t time = 0;
+  uint32_t default_duration = 0;
+  uint32_t default_size = 0;
+  Box box;
+  for (size_t pos = traf.payload; NextBox(data, traf.end, &pos, &box);) {
+    if (box.payload + 8 > box.end) continue;
+    uint32_t flags = ReadU32(data + box.payload) & 0xFFFFFF;
+    size_t p = box.payload + 4;
+    if (box.type == kTfhd) {
+      p += 4;  // track_ID
+      size_t fields_size =
+          (flags & kBaseDataOffsetPresent ? 8 : 0) +
+          (flags & kSampleDescriptionIndexPresent ? 4 : 0) +
+          (flags & kDefaultSampleDurationPresent ? 4 : 0) +
+          (flags & kDefaultSampleSizePresent ? 4 : 0);
+      if (p + fields_size > box.end) return false;
+      if (flags & kBaseDataOffsetPresent) {
+        base_offset = ReadU64(data + p);
+        p += 8;
+      }
+      if (flags & kSampleDescriptionIndexPresent) p += 4;
+      if (flags & kDefaultSampleDurationPresent) {
+        default_duration = ReadU32(data + p);
+        p += 4;
+      }
+      if (flags & kDefaultSampleSizePresent) default_size = ReadU32(data + p);
+    } else if (box.type == kTfdt) {
+      bool version_1 = data[box.payload] == 1;
+      if (p + (version_1 ? 8 : 4) > box.end) return false;
+      time = version_1 ? ReadU64(data + p) : ReadU32(data + p);
+    } else if (box.type == kTrun) {
+      uint32_t count = ReadU32(data + p);
+      p += 4;
+      int64_t offset = -1;
+      if (flags & kDataOffsetPresent) {
+        if (p + 4 > box.end) return false;
+        offset = base_offset + static_cast<int32_t>(ReadU32(data + p));
+        p += 4;
+      }
+      if (flags & kFirstSampleFlagsPresent) p += 4;
+      size_t record_size =
+          (flags & kSampleDurationPresent ? 4 : 0) +
+          (flags & kSampleSizePresent ? 4 : 0) +
+          (flags & kSampleFlagsPresent ? 4 : 0) +
+          (flags & kSampleCompositionTimeOffsetPresent ? 4 : 0);
+      if (p > box.end || (box.end - p) < uint64_t{record_size} * count)
+        return false;
+      for (uint32_t i = 0; i < count; ++i) {
+        Sample sample = {time, default_duration, default_size,
+                         i == 0 ? offset : -1};
+        if (flags & kSampleDurationPresent) {
+          sample.duration = ReadU32(data + p);
+          p += 4;
+        }
+        if (flags & kSampleSizePresent) {
+          sample.size = ReadU32(data + p);
+          p += 4;
+        }
+        if (flags & kSampleFlagsPresent) p += 4;
+        if (flags & kSampleCompositionTimeOffsetPresent) p += 4;
+        time += sample.duration;
+        samples_.push_back(sample);
+      }
+    }
+  }
+  return true;
+}
+
+bool Mp4TextParser::ParseMdat(const uint8_t* data, size_t size,
+                              const Box& mdat, std::vector<TextCue>* cues) {
+  if (samples_.empty()) return true;
+
+  if (timescale_ == 0) {
+    LOG_ERROR("Text samples precede the initialization segment");
+    return false;
+  }
+  uint64_t pos = mdat.payload;
+  for (const auto& sample : samples_) {
+    if (sample.offset >= 0) pos = sample.offset;
+    if (pos + sample.size > size) {
+      LOG_ERROR("Text sample exceeds the segment");
+      return false;
+    }
+    ParseSample(data + pos, sample, cues);
+    pos += sample.size;
+  }
+  samples_.clear();
+  return true;
+}
+
+void Mp4TextParser::ParseSample(const uint8_t* data, const Sample& sample,
+                                std::vector<TextCue>* cues) {
+  // TTML documents are timed on the media timeline of the track.
+  if (ttml_) {
+    ParseTtml(std::string(reinterpret_cast<const char*>(data), sample.size),
+              cues);
+    return;
+  }
+
+  // A sample holds a vttc box with a cue payload for each cue active during
+  // the sample, or a vtte box if there are none.
+  Box cue_box, box;
+  for (size_t p1 = 0; NextBox(data, sample.size, &p1, &cue_box);) {
+    if (cue_box.type != kVttc) continue;
+    for (size_t p2 = cue_box.payload; NextBox(data, cue_box.end, &p2, &box);) {
+      if (box.type != kPayl) continue;
+      TextCue cue;
+      cue.start = static_cast<double>(sample.time) / timescale_;
+      cue.end = static_cast<double>(sample.time + sample.duration) / timescale_;
+      std::string payload(reinterpret_cast<const char*>(data + box.payload),
+                          box.end - box.payload);
+      size_t pos = 0;
+      std::string line;
+      while (NextLine(payload, &pos, &line)) {
+        if (!cue.text.empty()) cue.text.push_back('\n');
+        AppendWithoutTags(line, &cue.text);
+      }
+      cues->push_back(cue);
+    }
+  }
+}
+
+}  // anonymous namespace
+
+std::unique_ptr<TextTrackParser> TextTrackParser::Create(
+    const std::string& mime_type, const std::string& codecs) {
+  if (mime_type == kWebVttMimeType)
+    return std::unique_ptr<TextTrackParser>(new WebVttParser());
+
+  if (mime_type == kTtmlMimeType)
+    return std::unique_ptr<TextTrackParser>(new TtmlParser());
+
+  if (mime_type == kMp4MimeType || mime_type.empty()) {
+    if (StartsWith(codecs, kWebVttCodec))
+      return std::unique_ptr<TextTrackParser>(new Mp4TextParser(false));
+    if (StartsWith(codecs, kTtmlCodec))
+      return std::unique_ptr<TextTrackParser>(new Mp4TextParser(true));
+  }
+
+  LOG_ERROR("Unsupported text track, mime type: %s, codecs: %s",
+            mime_type.c_str(), codecs.c_str());
+  return {};
+}
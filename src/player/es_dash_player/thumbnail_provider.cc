@@ -0,0 +1,128 @@
+/*!
+ * thumbnail_provider.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#define LOG_CATEGORY LogCategory::kDash
+
+#include "thumbnail_provider.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "common.h"
+
+#include "network_executor.h"
+
+using pp::AutoLock;
+using Samsung::NaClPlayer::Rect;
+using Samsung::NaClPlayer::TimeTicks;
+
+ThumbnailProvider::ThumbnailProvider(
+    std::shared_ptr<NetworkExecutor> network_executor,
+    const ImageStream& stream,
+    std::shared_ptr<const MediaSegmentSequence> sequence,
+    std::function<void(const Thumbnail&)> callback)
+    : network_executor_(std::move(network_executor)),
+      stream_(stream),
+      callback_(std::move(callback)),
+      cache_(kCacheByteBudget),
+      lock_(),
+      sequence_(std::move(sequence)),
+      downloading_key_(),
+      has_pending_request_(false),
+      pending_time_(0.) {}
+
+ThumbnailProvider::~ThumbnailProvider() {}
+
+void ThumbnailProvider::Request(TimeTicks time) {
+  Thumbnail thumbnail;
+  SegmentDescriptor image;
+  {
+    AutoLock lock(lock_);
+    if (!FindTile(time, &image, &thumbnail.tile)) return;
+
+    std::string key = SegmentCache::KeyFor(image);
+    if (!cache_.Get(key, &thumbnail.image)) {
+      // The last request is served once the current download completes.
+      if (!downloading_key_.empty()) {
+        has_pending_request_ = true;
+        pending_time_ = time;
+        return;
+      }
+      downloading_key_ = key;
+      auto weak_this = std::weak_ptr<ThumbnailProvider>(shared_from_this());
+      network_executor_->PostTask(NetworkExecutor::Priority::kPrefetch,
+          [weak_this, image]() {
+            if (auto thiz = weak_this.lock()) thiz->Download(image);
+          });
+      return;
+    }
+  }
+
+  thumbnail.time = time;
+  thumbnail.url = image.url;
+  thumbnail.mime_type = stream_.mime_type;
+  callback_(thumbnail);
+}
+
+bool ThumbnailProvider::FindTile(TimeTicks time, SegmentDescriptor* image,
+                                 Rect* tile) {
+  if (!sequence_) return false;
+
+  auto it = sequence_->MediaSegmentForTime(time);
+  if (it == sequence_->End() || !sequence_->GetSegmentDescriptor(it, image))
+    return false;
+
+  // Tiles show equal parts of the image duration, in rows.
+  uint32_t tiles = stream_.tile_columns * stream_.tile_rows;
+  if (tiles == 0) return false;
+  double start = sequence_->SegmentTimestamp(it);
+  double duration = sequence_->SegmentDuration(it);
+  uint32_t index = 0;
+  if (start >= 0. && duration > 0.) {
+    index = static_cast<uint32_t>(std::max(
+        std::floor((time - start) * tiles / duration), 0.));
+    index = std::min(index, tiles - 1);
+  }
+  int32_t width = stream_.width / stream_.tile_columns;
+  int32_t height = stream_.height / stream_.tile_rows;
+  *tile = Rect(index % stream_.tile_columns * width,
+               index / stream_.tile_columns * height, width, height);
+  return true;
+}
+
+void ThumbnailProvider::Download(SegmentDescriptor image) {
+  std::vector<uint8_t> data;
+  if (DownloadSegment(image, &data)) {
+    // Images are small, so they are all cached alike.
+    cache_.Put(SegmentCache::KeyFor(image), data);
+  } else {
+    LOG_ERROR("Failed to download a thumbnail image: %s", image.url.c_str());
+  }
+
+  TimeTicks pending_time;
+  {
+    AutoLock lock(lock_);
+    downloading_key_.clear();
+    if (!has_pending_request_) return;
+    has_pending_request_ = false;
+    pending_time = pending_time_;
+  }
+  Request(pending_time);
+}
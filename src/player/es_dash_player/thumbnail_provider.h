@@ -0,0 +1,93 @@
+/*!
+ * thumbnail_provider.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_THUMBNAIL_PROVIDER_H_
+#define NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_THUMBNAIL_PROVIDER_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "nacl_player/media_common.h"
+#include "ppapi/utility/threading/lock.h"
+
+#include "dash/media_segment_sequence.h"
+#include "dash/media_stream.h"
+
+#include "segment_cache.h"
+
+class NetworkExecutor;
+
+// A thumbnail of a seek position: a tile of an image of a DASH image
+// representation. The whole image is passed, so the application crops it.
+struct Thumbnail {
+  // The requested position.
+  Samsung::NaClPlayer::TimeTicks time;
+  // Identifies the image, thumbnails of the same one have the same url.
+  std::string url;
+  std::string mime_type;
+  std::vector<uint8_t> image;
+  // The tile in pixels of the image.
+  Samsung::NaClPlayer::Rect tile;
+};
+
+// Finds thumbnails of seek positions in an image representation, e.g. while
+// the user moves over the seek bar, so a position can be previewed without
+// seeking. Images are downloaded one at a time at the prefetch priority and
+// kept in a small LRU cache, so each of them is downloaded once. A position
+// requested while an image is downloaded replaces the previous one, only
+// the last one is served. It's thread safe, it must be created with
+// std::make_shared().
+class ThumbnailProvider
+    : public std::enable_shared_from_this<ThumbnailProvider> {
+ public:
+  static constexpr size_t kCacheByteBudget = 4 * 1024 * 1024;
+
+  ThumbnailProvider(std::shared_ptr<NetworkExecutor> network_executor,
+                    const ImageStream& stream,
+                    std::shared_ptr<const MediaSegmentSequence> sequence,
+                    std::function<void(const Thumbnail&)> callback);
+  ~ThumbnailProvider();
+
+  // Passes a thumbnail of time to the callback, right away if its image is
+  // cached or on a network worker once it's downloaded. Nothing is passed
+  // if there is no image at time or it can't be downloaded.
+  void Request(Samsung::NaClPlayer::TimeTicks time);
+
+ private:
+  // Finds the image and the tile of time. Must be called under lock_.
+  bool FindTile(Samsung::NaClPlayer::TimeTicks time,
+                SegmentDescriptor* image, Samsung::NaClPlayer::Rect* tile);
+  void Download(SegmentDescriptor image);
+
+  std::shared_ptr<NetworkExecutor> network_executor_;
+  ImageStream stream_;
+  std::function<void(const Thumbnail&)> callback_;
+  SegmentCache cache_;
+
+  pp::Lock lock_;
+  std::shared_ptr<const MediaSegmentSequence> sequence_;
+  // A key of the image being downloaded, empty if there is none.
+  std::string downloading_key_;
+  bool has_pending_request_;
+  Samsung::NaClPlayer::TimeTicks pending_time_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_ES_DASH_PLAYER_THUMBNAIL_PROVIDER_H_
@@ -21,13 +21,12 @@
 
 using Samsung::NaClPlayer::TimeTicks;
 using Samsung::NaClPlayer::MediaPlayerError;
-using pp::Var;
 
 void SubtitleListener::OnShowSubtitle(TimeTicks duration, const char* text) {
-  Var varText = Var(text);
+  if (!text) text = "";
   LOG_DEBUG("Got subtitle: %s , duration: %f", text, duration);
   if (auto message_sender = message_sender_.lock()) {
-    message_sender->ShowSubtitles(duration, varText);
+    message_sender->ShowSubtitles(duration, text);
   }
 }
 
@@ -35,6 +34,7 @@ void MediaPlayerListener::OnTimeUpdate(TimeTicks time) {
   if (auto message_sender = message_sender_.lock()) {
     message_sender->CurrentTimeUpdate(time);
   }
+  if (time_update_callback_) time_update_callback_();
 }
 
 void MediaPlayerListener::OnEnded() {
@@ -46,14 +46,19 @@ void MediaPlayerListener::OnEnded() {
 
 void MediaPlayerListener::OnError(MediaPlayerError error) {
   LOG_ERROR("Event: Error occurred. Error no: %d.", error);
+  if (error_callback_) error_callback_(error);
 }
 
 void MediaBufferingListener::OnBufferingStart() {
   LOG_INFO("Event: Buffering started, wait for the end.");
+  if (buffering_start_callback_) buffering_start_callback_();
 }
 
 void MediaBufferingListener::OnBufferingProgress(uint32_t percent) {
   LOG_DEBUG("Event: Buffering progress: %d %%.", percent);
+  if (auto message_sender = message_sender_.lock()) {
+    message_sender->BufferingProgress(percent);
+  }
 }
 
 void MediaBufferingListener::OnBufferingComplete() {
@@ -64,4 +69,5 @@ void MediaBufferingListener::OnBufferingComplete() {
   if (auto player_controller = player_controller_.lock()) {
     player_controller->PostTextTrackInfo();
   }
+  if (buffering_complete_callback_) buffering_complete_callback_();
 }
@@ -19,12 +19,29 @@
 
 #include "player/player_provider.h"
 
+#include "ppapi/utility/threading/lock.h"
+
+#include "player/es_dash_player/dash_preloader.h"
 #include "player/es_dash_player/es_dash_player_controller.h"
+#include "player/es_dash_player/network_executor.h"
+#include "player/es_dash_player/offline_store.h"
 #include "player/url_player/url_player_controller.h"
 #include "logger.h"
 
 using Samsung::NaClPlayer::Rect;
 
+PlayerProvider::PlayerProvider(const pp::InstanceHandle& instance,
+    std::shared_ptr<Communication::MessageSender> message_sender)
+    : instance_(instance),
+      message_sender_(std::move(message_sender)),
+      worker_pool_(),
+      dash_preloader_(),
+      offline_store_(),
+      initial_buffer_(0.),
+      start_time_(0.) {}
+
+PlayerProvider::~PlayerProvider() {}
+
 std::shared_ptr<PlayerController> PlayerProvider::CreatePlayer(
     PlayerType type, const std::string& url,
     const Samsung::NaClPlayer::Rect view_rect,
@@ -37,6 +54,7 @@ std::shared_ptr<PlayerController> PlayerProvider::CreatePlayer(
       std::shared_ptr<UrlPlayerController> controller =
           std::make_shared<UrlPlayerController>(instance_, message_sender_);
       controller->SetViewRect(view_rect);
+      controller->SetInitialBuffer(initial_buffer_);
       controller->InitPlayer(url, subtitle, encoding);
       return controller;
     }
@@ -44,6 +62,11 @@ std::shared_ptr<PlayerController> PlayerProvider::CreatePlayer(
       std::shared_ptr<EsDashPlayerController> controller =
           std::make_shared<EsDashPlayerController>(instance_, message_sender_);
       controller->SetViewRect(view_rect);
+      controller->SetNetworkExecutor(
+          std::make_shared<NetworkExecutor>(GetWorkerPool()));
+      if (dash_preloader_)
+        controller->SetPreloadedMedia(dash_preloader_->Take(url));
+      controller->SetStartTime(start_time_);
       controller->InitPlayer(url, subtitle, encoding,
                              drm_license_url, drm_key_request_properties);
       return controller;
@@ -54,3 +77,109 @@ std::shared_ptr<PlayerController> PlayerProvider::CreatePlayer(
 
   return 0;
 }
+
+bool PlayerProvider::ReusePlayer(
+    const std::shared_ptr<PlayerController>& controller, PlayerType type,
+    const std::string& url, const Samsung::NaClPlayer::Rect view_rect,
+    const std::string& subtitle, const std::string& encoding,
+    const std::string& drm_license_url,
+    const std::unordered_map<std::string, std::string>&
+        drm_key_request_properties) {
+  // A URL player gets its data source with the URL, it's always created
+  // anew. A player which failed or didn't load its media yet is replaced,
+  // so the new one doesn't wait for loading tasks of the previous media.
+  if (type != kEsDash || !controller ||
+      static_cast<int>(controller->GetState()) <=
+          static_cast<int>(PlayerController::PlayerState::kUnitialized))
+    return false;
+
+  auto es_controller =
+      std::static_pointer_cast<EsDashPlayerController>(controller);
+  es_controller->SetViewRect(view_rect);
+  if (dash_preloader_)
+    es_controller->SetPreloadedMedia(dash_preloader_->Take(url));
+  es_controller->SetStartTime(start_time_);
+  es_controller->InitPlayer(url, subtitle, encoding, drm_license_url,
+                            drm_key_request_properties);
+  return true;
+}
+
+void PlayerProvider::PreloadMedia(PlayerType type, const std::string& url) {
+  if (type != kEsDash) {
+    Logger::Error("Preloading is not supported by player type %d", type);
+    return;
+  }
+
+  if (!dash_preloader_)
+    dash_preloader_ = MakeUnique<DashPreloader>(GetWorkerPool());
+  dash_preloader_->Preload(url);
+}
+
+void PlayerProvider::SetWarmMedia(PlayerType type,
+                                  const std::vector<std::string>& urls) {
+  if (type != kEsDash) {
+    Logger::Error("Warm media is not supported by player type %d", type);
+    return;
+  }
+
+  if (!dash_preloader_) {
+    if (urls.empty()) return;
+    dash_preloader_ = MakeUnique<DashPreloader>(GetWorkerPool());
+  }
+  dash_preloader_->SetWarmMedia(urls);
+}
+
+void PlayerProvider::SuspendPlayer(
+    const std::shared_ptr<PlayerController>& controller, PlayerType type) {
+  if (type != kEsDash || !controller) return;
+
+  auto media = std::static_pointer_cast<EsDashPlayerController>(controller)
+      ->CreateResumeState();
+  if (!media) return;
+  if (!dash_preloader_)
+    dash_preloader_ = MakeUnique<DashPreloader>(GetWorkerPool());
+  dash_preloader_->KeepSuspended(std::move(media));
+}
+
+void PlayerProvider::DownloadMedia(PlayerType type, const std::string& url,
+                                   uint32_t max_bitrate) {
+  if (type != kEsDash) {
+    Logger::Error("Downloading is not supported by player type %d", type);
+    return;
+  }
+
+  if (!offline_store_) {
+    auto message_sender = message_sender_;
+    offline_store_ = MakeUnique<OfflineStore>(GetWorkerPool(),
+        [message_sender](const std::string& url, uint32_t percent,
+                         int32_t error) {
+          message_sender->DownloadProgress(url, percent, error);
+        });
+  }
+  offline_store_->Download(url, max_bitrate);
+}
+
+void PlayerProvider::SetInitialBuffer(
+    Samsung::NaClPlayer::TimeTicks initial_buffer) {
+  initial_buffer_ = initial_buffer;
+}
+
+void PlayerProvider::SetStartTime(Samsung::NaClPlayer::TimeTicks start_time) {
+  start_time_ = start_time;
+}
+
+std::shared_ptr<WorkerPool> PlayerProvider::GetWorkerPool() {
+  if (worker_pool_) return worker_pool_;
+
+  // Providers of all instances share workers, they are stopped with the
+  // last provider which uses them.
+  static pp::Lock lock;
+  static std::weak_ptr<WorkerPool> shared_pool;
+  pp::AutoLock auto_lock(lock);
+  worker_pool_ = shared_pool.lock();
+  if (!worker_pool_) {
+    worker_pool_ = std::make_shared<WorkerPool>(instance_);
+    shared_pool = worker_pool_;
+  }
+  return worker_pool_;
+}
@@ -0,0 +1,208 @@
+/*!
+ * soak_test.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#include "player/soak_test.h"
+
+#include <malloc.h>
+
+#include <algorithm>
+
+#include "demuxer/elementary_stream_packet.h"
+
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+namespace {
+
+// Delay after each step of a cycle, so the player has time to act on it.
+constexpr int32_t kStepDelay = 5000;  // in milliseconds
+// Delay after closing the player, so it's destroyed on the disposal thread
+// and its downloads finish, before a sample is taken.
+constexpr int32_t kSettleDelay = 10000;  // in milliseconds
+// Heap may grow that much above the baseline, e.g. for the manifest cache.
+constexpr uint64_t kMaxHeapGrowth = 16 * 1024 * 1024;  // bytes
+// A drift has to last that many samples, as some resources are released
+// with a delay.
+constexpr uint32_t kMaxDriftingSamples = 3;
+
+enum class Step {
+  kLoad,
+  kPlay,
+  kSeek,
+  kLowestVideo,
+  kSeekAgain,
+  kHighVideo,
+  kAutomaticVideo,
+  kClose,
+  kSample,
+};
+
+constexpr Step kCycle[] = {
+  Step::kLoad, Step::kPlay, Step::kSeek, Step::kLowestVideo,
+  Step::kSeekAgain, Step::kHighVideo, Step::kAutomaticVideo, Step::kClose,
+  Step::kSample,
+};
+
+uint64_t HeapBytes() {
+  return static_cast<uint64_t>(mallinfo().uordblks);
+}
+
+}  // anonymous namespace
+
+SoakTest::SoakTest(const Actions& actions)
+    : actions_(actions),
+      cc_factory_(this),
+      running_(false),
+      generation_(0),
+      seek_range_(0.),
+      next_step_(0),
+      drifting_samples_(0),
+      result_() {}
+
+SoakTest::~SoakTest() {}
+
+bool SoakTest::Start(double duration, double seek_range,
+                     const SampleCallback& sample_callback,
+                     const ResultCallback& result_callback) {
+  if (running_) {
+    LOG_ERROR("A soak test is running already");
+    return false;
+  }
+  message_loop_ = pp::MessageLoop::GetCurrent();
+  running_ = true;
+  ++generation_;
+  start_ = steady_clock::now();
+  end_ = start_ + std::chrono::duration_cast<steady_clock::duration>(
+      std::chrono::duration<double>(duration));
+  seek_range_ = std::max(seek_range, 0.);
+  random_.seed(static_cast<uint32_t>(generation_));
+  next_step_ = 0;
+  drifting_samples_ = 0;
+  sample_callback_ = sample_callback;
+  result_callback_ = result_callback;
+  result_ = Result();
+  LOG_INFO("Soak test started for %.0f s", duration);
+  ScheduleStep(0);
+  return true;
+}
+
+void SoakTest::Stop() {
+  if (running_) Finish(result_.cycles > 0 && drifting_samples_ == 0);
+}
+
+void SoakTest::ScheduleStep(int32_t delay_ms) {
+  message_loop_.PostWork(cc_factory_.NewCallback(&SoakTest::RunStep,
+                                                 generation_), delay_ms);
+}
+
+void SoakTest::RunStep(int32_t, uint64_t generation) {
+  if (!running_ || generation != generation_) return;
+
+  std::uniform_real_distribution<double> seek_time(0., seek_range_);
+  Step step = kCycle[next_step_];
+  next_step_ = (next_step_ + 1) % (sizeof(kCycle) / sizeof(kCycle[0]));
+  int32_t delay_ms = kStepDelay;
+  switch (step) {
+    case Step::kLoad:
+      actions_.load();
+      break;
+    case Step::kPlay:
+      actions_.play();
+      break;
+    case Step::kSeek:
+    case Step::kSeekAgain:
+      actions_.seek(seek_time(random_));
+      break;
+    case Step::kLowestVideo:
+      actions_.change_representation(StreamType::Video, 0);
+      break;
+    case Step::kHighVideo:
+      actions_.change_representation(StreamType::Video, 1);
+      break;
+    case Step::kAutomaticVideo:
+      actions_.change_representation(StreamType::Video, -1);
+      break;
+    case Step::kClose:
+      actions_.close();
+      delay_ms = kSettleDelay;
+      break;
+    case Step::kSample:
+      TakeSample();
+      if (!running_) return;
+      if (steady_clock::now() >= end_) {
+        Finish(true);
+        return;
+      }
+      delay_ms = 0;
+      break;
+  }
+  ScheduleStep(delay_ms);
+}
+
+void SoakTest::TakeSample() {
+  Sample sample = Sample();
+  sample.cycle = ++result_.cycles;
+  sample.elapsed = duration<double>(steady_clock::now() - start_).count();
+  sample.heap_bytes = HeapBytes();
+  sample.threads = ScopedResourceCount::Get(TrackedResource::kThread);
+  sample.url_loaders = ScopedResourceCount::Get(TrackedResource::kUrlLoader);
+  sample.live_packets =
+      ElementaryStreamPacket::GetAllocationStats().live_packets;
+  result_.peak_heap_bytes = std::max(result_.peak_heap_bytes,
+                                     sample.heap_bytes);
+  result_.last = sample;
+  LOG_INFO("Soak test cycle %llu at %.0f s, heap: %llu bytes, threads: "
+           "%lld, URL loaders: %lld, live packets: %lld",
+           static_cast<unsigned long long>(sample.cycle), sample.elapsed,
+           static_cast<unsigned long long>(sample.heap_bytes),
+           static_cast<long long>(sample.threads),
+           static_cast<long long>(sample.url_loaders),
+           static_cast<long long>(sample.live_packets));
+  if (sample_callback_) sample_callback_(sample);
+
+  if (sample.cycle == 1) {
+    result_.baseline = sample;
+    return;
+  }
+  const Sample& baseline = result_.baseline;
+  result_.heap_drift =
+      sample.heap_bytes > baseline.heap_bytes + kMaxHeapGrowth;
+  result_.thread_drift = sample.threads > baseline.threads;
+  result_.url_loader_drift = sample.url_loaders > baseline.url_loaders;
+  result_.packet_drift = sample.live_packets > baseline.live_packets;
+  bool drift = result_.heap_drift || result_.thread_drift ||
+               result_.url_loader_drift || result_.packet_drift;
+  drifting_samples_ = drift ? drifting_samples_ + 1 : 0;
+  if (drifting_samples_ >= kMaxDriftingSamples) {
+    LOG_ERROR("Soak test failed, resources drifted for %u cycles",
+              drifting_samples_);
+    Finish(false);
+  }
+}
+
+void SoakTest::Finish(bool ok) {
+  running_ = false;
+  result_.ok = ok;
+  LOG_INFO("Soak test %s after %llu cycles", ok ? "passed" : "failed",
+           static_cast<unsigned long long>(result_.cycles));
+  ResultCallback callback = std::move(result_callback_);
+  result_callback_ = nullptr;
+  sample_callback_ = nullptr;
+  if (callback) callback(result_);
+}
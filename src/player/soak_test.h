@@ -0,0 +1,124 @@
+/*!
+ * soak_test.h (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#ifndef NATIVE_PLAYER_SRC_PLAYER_SOAK_TEST_H_
+#define NATIVE_PLAYER_SRC_PLAYER_SOAK_TEST_H_
+
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+
+#include "ppapi/cpp/message_loop.h"
+#include "ppapi/utility/completion_callback_factory.h"
+
+#include "common.h"
+
+// Loops player lifecycles for hours, to find resources which are not
+// released, like on TVs which run the application for days. Each cycle
+// loads the content, plays it, seeks, changes representations and closes
+// the player. When the player is gone, heap usage, threads of
+// NetworkExecutors and demuxers, open URLLoaders and live packets are
+// sampled. They are compared with the sample of the first cycle, after
+// which pools and caches are warmed up, and the test fails when any of them
+// stays above it for a few cycles in a row.
+//
+// It runs on the message handling thread, which it's started on, and calls
+// player actions there, like messages from the UI would.
+class SoakTest {
+ public:
+  // Player actions, called on the message handling thread.
+  struct Actions {
+    // Loads the content, replacing the current player.
+    std::function<void()> load;
+    std::function<void()> play;
+    std::function<void()> close;
+    std::function<void(double time)> seek;
+    // -1 enables automatic selection again.
+    std::function<void(StreamType type, int32_t id)> change_representation;
+  };
+
+  struct Sample {
+    uint64_t cycle;
+    // Seconds since the start of the test.
+    double elapsed;
+    // Bytes allocated from the heap, measured with mallinfo().
+    uint64_t heap_bytes;
+    int64_t threads;
+    int64_t url_loaders;
+    int64_t live_packets;
+  };
+
+  struct Result {
+    // True if the test ran for the whole duration without a drift.
+    bool ok;
+    uint64_t cycles;
+    Sample baseline;
+    Sample last;
+    uint64_t peak_heap_bytes;
+    // Values which drifted.
+    bool heap_drift;
+    bool thread_drift;
+    bool url_loader_drift;
+    bool packet_drift;
+  };
+
+  typedef std::function<void(const Sample&)> SampleCallback;
+  typedef std::function<void(const Result&)> ResultCallback;
+
+  explicit SoakTest(const Actions& actions);
+  ~SoakTest();
+
+  // Starts a test which lasts the given number of seconds, unless one is
+  // running already. Seeks are made to random positions below seek_range.
+  // Must be called on the message handling thread.
+  bool Start(double duration, double seek_range,
+             const SampleCallback& sample_callback,
+             const ResultCallback& result_callback);
+
+  // Stops the test and reports its result so far.
+  void Stop();
+
+  bool IsRunning() const { return running_; }
+
+ private:
+  void ScheduleStep(int32_t delay_ms);
+  void RunStep(int32_t, uint64_t generation);
+  void TakeSample();
+  void Finish(bool ok);
+
+  Actions actions_;
+  pp::MessageLoop message_loop_;
+  pp::CompletionCallbackFactory<SoakTest> cc_factory_;
+  bool running_;
+  // Steps scheduled by a stopped test are ignored.
+  uint64_t generation_;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point end_;
+  double seek_range_;
+  std::mt19937 random_;
+  size_t next_step_;
+  // Consecutive samples above the baseline.
+  uint32_t drifting_samples_;
+  SampleCallback sample_callback_;
+  ResultCallback result_callback_;
+  Result result_;
+};
+
+#endif  // NATIVE_PLAYER_SRC_PLAYER_SOAK_TEST_H_
@@ -26,6 +26,7 @@
 
 #include "nacl_player/error_codes.h"
 #include "nacl_player/url_data_source.h"
+#include "ppapi/cpp/message_loop.h"
 #include "ppapi/cpp/var_dictionary.h"
 
 using Samsung::NaClPlayer::ErrorCodes;
@@ -39,10 +40,18 @@ using Samsung::NaClPlayer::TimeTicks;
 using std::make_shared;
 using std::placeholders::_1;
 
+namespace {
+
+// A name of the load in latency reports.
+const char kUrlStartupOperation[] = "urlStartup";
+
+}  // namespace
+
 void UrlPlayerController::InitPlayer(const std::string& url,
                                      const std::string& subtitle,
                                      const std::string& encoding) {
   LOG_INFO("Loading media from : [%s]", url.c_str());
+  load_start_ = std::chrono::steady_clock::now();
   CleanPlayer();
 
   player_thread_ = MakeUnique<pp::SimpleThread>(instance_);
@@ -88,17 +97,93 @@ void UrlPlayerController::InitPlayer(const std::string& url,
 void UrlPlayerController::InitializeUrlPlayer(
     const std::string& content_container_url) {
   LOG_INFO("Play content directly from URL = %s ", content_container_url.c_str());
-  data_source_ = make_shared<URLDataSource>(content_container_url);
-  player_->AttachDataSource(*data_source_);
-  TimeTicks duration;
-  if (player_->GetDuration(duration) == ErrorCodes::Success) {
-    message_sender_->SetMediaDuration(duration);
-    video_duration_ = duration;
-    LOG_INFO("Got duration: %f [s].", duration);
+  auto url_data_source = make_shared<URLDataSource>(content_container_url);
+  if (initial_buffer_ > 0.) {
+    // The platform takes the prebuffered amount in milliseconds.
+    auto initial_buffer_ms = static_cast<int64_t>(initial_buffer_ * 1000);
+    int32_t ret = url_data_source->SetStreamingProperty(
+        Samsung::NaClPlayer::kStreamingPropertyPrebufferMode,
+        std::to_string(initial_buffer_ms));
+    if (ret == ErrorCodes::Success) {
+      LOG_INFO("Initial buffer set to %f [s]", initial_buffer_);
+    } else {
+      LOG_ERROR("Failed to set the initial buffer, code: %d", ret);
+    }
+  }
+  data_source_ = std::move(url_data_source);
+  // The platform opens the URL while the data source is attached, which
+  // takes long on slow origins. It's done on the player thread, so UI
+  // commands are still handled.
+  load_phases_.clear();
+  player_thread_->message_loop().PostWork(cc_factory_.NewCallback(
+      &UrlPlayerController::OnInitializeUrlPlayer, ++load_generation_));
+}
+
+void UrlPlayerController::OnInitializeUrlPlayer(int32_t, uint32_t generation) {
+  auto mark_phase = [this](const char* name) {
+    load_phases_.emplace_back(name,
+        std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - load_start_).count());
+  };
+
+  int32_t ret = player_->AttachDataSource(*data_source_);
+  mark_phase("dataSourceAttached");
+  if (ret == ErrorCodes::Success) {
+    TimeTicks duration;
+    if (player_->GetDuration(duration) == ErrorCodes::Success) {
+      video_duration_ = duration;
+      LOG_INFO("Got duration: %f [s].", duration);
+    } else {
+      LOG_INFO("Failed to retreive duration!");
+    }
+    mark_phase("durationRetrieved");
+    int32_t tracks_ret = player_->GetTextTracksList(text_track_list_);
+    if (tracks_ret != ErrorCodes::Success) {
+      LOG_ERROR("GetTextTrackInfo call failed, code: %d", tracks_ret);
+      text_track_list_.clear();
+    }
+    mark_phase("textTracksRetrieved");
   } else {
-    LOG_INFO("Failed to retreive duration!");
+    LOG_ERROR("Failed to AttachDataSource, code: %d", ret);
   }
-  PostTextTrackInfo();
+  pp::MessageLoop::GetForMainThread().PostWork(cc_factory_.NewCallback(
+      &UrlPlayerController::OnUrlPlayerInitialized, ret, generation));
+}
+
+void UrlPlayerController::OnUrlPlayerInitialized(int32_t, int32_t attach_result,
+                                                 uint32_t generation) {
+  if (!player_ || generation != load_generation_) return;
+
+  for (const auto& phase_time : load_phases_) {
+    LOG_INFO("%s latency: %s after %.1f [ms]", kUrlStartupOperation,
+             phase_time.first.c_str(), phase_time.second);
+  }
+  message_sender_->LatencyReport(kUrlStartupOperation, load_phases_);
+  if (attach_result != ErrorCodes::Success) {
+    state_ = PlayerState::kError;
+    play_requested_ = false;
+    pending_seek_.reset();
+    message_sender_->MediaLoaded(attach_result);
+    return;
+  }
+
+  state_ = PlayerState::kReady;
+  if (video_duration_ > 0.) message_sender_->SetMediaDuration(video_duration_);
+  message_sender_->SetTextTracks(text_track_list_);
+  message_sender_->MediaLoaded(attach_result);
+  if (pending_seek_) {
+    auto to_time = *pending_seek_;
+    pending_seek_.reset();
+    Seek(to_time);
+  }
+  if (play_requested_) {
+    play_requested_ = false;
+    Play();
+  }
+}
+
+void UrlPlayerController::SetInitialBuffer(TimeTicks initial_buffer) {
+  initial_buffer_ = initial_buffer;
 }
 
 void UrlPlayerController::Play() {
@@ -106,6 +191,11 @@ void UrlPlayerController::Play() {
     LOG_INFO("Play. player is not initialized, cannot play");
     return;
   }
+  if (state_ == PlayerState::kUnitialized) {
+    LOG_INFO("Play. media is being opened, playing once it's opened");
+    play_requested_ = true;
+    return;
+  }
 
   int32_t ret = player_->Play();
   if (ret == ErrorCodes::Success) {
@@ -120,6 +210,10 @@ void UrlPlayerController::Pause() {
     LOG_INFO("Pause. player is not initialized");
     return;
   }
+  if (state_ == PlayerState::kUnitialized) {
+    play_requested_ = false;
+    return;
+  }
 
   int32_t ret = player_->Pause();
   if (ret == ErrorCodes::Success) {
@@ -131,6 +225,15 @@ void UrlPlayerController::Pause() {
 
 void UrlPlayerController::Seek(TimeTicks to_time) {
   LOG_INFO("Seek to %f", to_time);
+  if (!player_) {
+    LOG_INFO("Seek. player is not initialized");
+    return;
+  }
+  if (state_ == PlayerState::kUnitialized) {
+    LOG_INFO("Seek. media is being opened, seeking once it's opened");
+    pending_seek_ = MakeUnique<TimeTicks>(to_time);
+    return;
+  }
   // video_duration_ equal to 0 means we failed to retrieve the video duration,
   // we still should try to seek, but it is possiable that seek will fail.
   if (video_duration_ && to_time > video_duration_ - kEps) {
@@ -145,6 +248,18 @@ void UrlPlayerController::Seek(TimeTicks to_time) {
   }
 }
 
+void UrlPlayerController::PreviewSeek(TimeTicks /*to_time*/) {
+  // Data is downloaded by the NaCl Player itself, it can't be prefetched.
+}
+
+void UrlPlayerController::SetPlaybackRate(double /*rate*/) {
+  LOG_INFO("URLplayer doesnt support trick play");
+}
+
+void UrlPlayerController::EnqueueMedia(const std::string& /*url*/) {
+  LOG_INFO("URLplayer doesnt support playlists");
+}
+
 void UrlPlayerController::ChangeRepresentation(StreamType /*stream_type*/,
                                                int32_t /*id*/) {
   LOG_INFO("URLplayer doesnt support changing representation");
@@ -162,6 +277,9 @@ void UrlPlayerController::SetViewRect(const Rect& view_rect) {
 }
 
 void UrlPlayerController::PostTextTrackInfo() {
+  // Text tracks are sent once the media is opened.
+  if (!player_ || state_ == PlayerState::kUnitialized) return;
+
   int32_t ret = player_->GetTextTracksList(text_track_list_);
   if (ret == ErrorCodes::Success) {
     LOG_INFO("GetTextTrackInfo called successfully");
@@ -171,6 +289,22 @@ void UrlPlayerController::PostTextTrackInfo() {
   }
 }
 
+void UrlPlayerController::PostMetrics() {
+  LOG_INFO("URLplayer doesnt support metrics");
+}
+
+void UrlPlayerController::SetMetricsInterval(double /*interval*/) {
+  LOG_INFO("URLplayer doesnt support metrics");
+}
+
+void UrlPlayerController::SetVisible(bool /*visible*/) {
+  LOG_INFO("URLplayer doesnt support trimming buffers");
+}
+
+void UrlPlayerController::SetAudioOnly(bool /*audio_only*/) {
+  LOG_INFO("URLplayer doesnt support audio only playback");
+}
+
 void UrlPlayerController::ChangeSubtitles(int32_t id) {
   LOG_INFO("Change subtitle to %d", id);
   player_thread_->message_loop().PostWork(
@@ -229,6 +363,12 @@ void UrlPlayerController::CleanPlayer() {
   player_->SetSubtitleListener(nullptr);
   player_->SetBufferingListener(nullptr);
   player_->SetDRMListener(nullptr);
+  // Waits for a load in progress, which uses data_source_.
+  player_thread_.reset();
   data_source_.reset();
+  video_duration_ = 0.;
+  text_track_list_.clear();
+  play_requested_ = false;
+  pending_seek_.reset();
   state_ = PlayerState::kUnitialized;
 }
@@ -0,0 +1,148 @@
+/*!
+ * thread_config.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ *
+ * @brief
+ * Per-role scheduling settings of pipeline threads.
+ */
+
+#include "thread_config.h"
+
+#if defined(__linux__) && !defined(__native_client__)
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define THREAD_CONFIG_SUPPORTED
+#endif
+
+#include <algorithm>
+#include <array>
+
+#include "ppapi/cpp/completion_callback.h"
+#include "ppapi/utility/threading/lock.h"
+
+#include "common.h"
+#include "logger.h"
+
+using pp::AutoLock;
+
+constexpr int32_t ThreadConfig::kMinPriority;
+constexpr int32_t ThreadConfig::kMaxPriority;
+constexpr int32_t ThreadConfig::kAnyCpu;
+
+namespace {
+
+struct RoleSettings {
+  bool set;
+  int32_t priority;
+  int32_t cpu;
+};
+
+const char* const kRoleNames[] = {
+  "audioDemuxer",
+  "videoDemuxer",
+  "appendScheduler",
+  "download",
+};
+
+static_assert(sizeof(kRoleNames) / sizeof(kRoleNames[0]) ==
+                  static_cast<size_t>(ThreadRole::kCount),
+              "each thread role needs a name");
+
+pp::Lock settings_lock;
+std::array<RoleSettings, static_cast<size_t>(ThreadRole::kCount)> settings;
+
+bool GetSettings(ThreadRole role, RoleSettings* role_settings) {
+  AutoLock lock(settings_lock);
+  *role_settings = settings[static_cast<size_t>(role)];
+  return role_settings->set;
+}
+
+void ApplyCallback(void* user_data, int32_t) {
+  ThreadConfig::ApplyToCurrentThread(
+      static_cast<ThreadRole>(reinterpret_cast<intptr_t>(user_data)));
+}
+
+}  // anonymous namespace
+
+void ThreadConfig::Set(ThreadRole role, int32_t priority, int32_t cpu) {
+  LOG_INFO("role: %s, priority: %d, cpu: %d",
+           kRoleNames[static_cast<size_t>(role)], priority, cpu);
+  AutoLock lock(settings_lock);
+  settings[static_cast<size_t>(role)] = RoleSettings{
+      true, std::min(std::max(priority, kMinPriority), kMaxPriority),
+      std::max(cpu, kAnyCpu)};
+}
+
+bool ThreadConfig::GetRoleByName(const std::string& name, ThreadRole* role) {
+  for (size_t i = 0; i < static_cast<size_t>(ThreadRole::kCount); ++i) {
+    if (name == kRoleNames[i]) {
+      *role = static_cast<ThreadRole>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadConfig::ApplyToCurrentThread(ThreadRole role) {
+  RoleSettings role_settings;
+  if (!GetSettings(role, &role_settings)) return true;
+#ifdef THREAD_CONFIG_SUPPORTED
+  bool ok = true;
+  // Linux keeps nice values per thread, so the calling thread is set only.
+  if (setpriority(PRIO_PROCESS, syscall(SYS_gettid),
+                  role_settings.priority) != 0) {
+    LOG_ERROR("Can't set priority %d of %s thread", role_settings.priority,
+              kRoleNames[static_cast<size_t>(role)]);
+    ok = false;
+  }
+  if (role_settings.cpu != kAnyCpu) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(role_settings.cpu, &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+      LOG_ERROR("Can't bind %s thread to cpu %d",
+                kRoleNames[static_cast<size_t>(role)], role_settings.cpu);
+      ok = false;
+    }
+  }
+  return ok;
+#else
+  LOG_DEBUG("Thread settings are not supported, role: %s",
+            kRoleNames[static_cast<size_t>(role)]);
+  return false;
+#endif
+}
+
+std::unique_ptr<std::thread> ThreadConfig::StartThread(
+    ThreadRole role, std::function<void()> function) {
+  return MakeUnique<std::thread>([role, function]() {
+    ApplyToCurrentThread(role);
+    function();
+  });
+}
+
+std::unique_ptr<pp::SimpleThread> ThreadConfig::StartSimpleThread(
+    const pp::InstanceHandle& instance, ThreadRole role) {
+  auto thread = MakeUnique<pp::SimpleThread>(instance);
+  thread->Start();
+  // Runs before any work posted by the caller.
+  thread->message_loop().PostWork(pp::CompletionCallback(
+      &ApplyCallback, reinterpret_cast<void*>(static_cast<intptr_t>(role))));
+  return thread;
+}
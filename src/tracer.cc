@@ -0,0 +1,210 @@
+/*!
+ * tracer.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ *
+ * @brief
+ * Trace events collected into per-thread buffers and exported in Chrome
+ * trace event format.
+ */
+
+#include "tracer.h"
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "ppapi/utility/threading/lock.h"
+
+using pp::AutoLock;
+
+std::atomic<bool> Tracer::enabled_(false);
+
+namespace {
+
+// The oldest events of a thread are overwritten when its buffer is full.
+const size_t kMaxEventsPerThread = 8192;
+
+struct TraceEvent {
+  const char* name;
+  uint64_t value;
+  int64_t timestamp_us;
+  uint32_t thread_id;
+  char phase;
+};
+
+struct ThreadBuffer {
+  // Taken by the owning thread and by an export, so it's rarely contended.
+  pp::Lock lock;
+  std::vector<TraceEvent> events;
+  // Position of the oldest event once events are full.
+  size_t next;
+  // Events of an exited thread keep its id when the buffer is reused.
+  uint32_t thread_id;
+  // A buffer of an exited thread is reused by the next new thread.
+  bool thread_exited;
+};
+
+pp::Lock buffers_lock;
+std::vector<ThreadBuffer*> buffers;
+uint32_t next_thread_id = 1;
+pthread_key_t thread_exit_key;
+pthread_once_t thread_exit_key_once = PTHREAD_ONCE_INIT;
+__thread ThreadBuffer* current_buffer = nullptr;
+
+int64_t GetTimestampUs() {
+  using std::chrono::steady_clock;
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+
+  static auto st_begin = steady_clock::now();
+  return duration_cast<microseconds>(steady_clock::now() - st_begin).count();
+}
+
+void OnThreadExit(void* buffer) {
+  AutoLock lock(buffers_lock);
+  static_cast<ThreadBuffer*>(buffer)->thread_exited = true;
+}
+
+void CreateThreadExitKey() {
+  pthread_key_create(&thread_exit_key, &OnThreadExit);
+}
+
+ThreadBuffer* GetThreadBuffer() {
+  if (current_buffer) return current_buffer;
+
+  pthread_once(&thread_exit_key_once, &CreateThreadExitKey);
+  AutoLock lock(buffers_lock);
+  for (auto buffer : buffers) {
+    if (buffer->thread_exited) {
+      current_buffer = buffer;
+      break;
+    }
+  }
+  if (!current_buffer) {
+    current_buffer = new ThreadBuffer();
+    current_buffer->next = 0;
+    buffers.push_back(current_buffer);
+  }
+  current_buffer->thread_id = next_thread_id++;
+  current_buffer->thread_exited = false;
+  pthread_setspecific(thread_exit_key, current_buffer);
+  return current_buffer;
+}
+
+void AppendEventJson(const TraceEvent& event, std::string* json) {
+  char buff[256];
+  int length = snprintf(buff, sizeof(buff),
+      "{\"name\":\"%s\",\"cat\":\"player\",\"ph\":\"%c\",\"ts\":%lld,"
+      "\"pid\":1,\"tid\":%u", event.name, event.phase,
+      static_cast<long long>(event.timestamp_us), event.thread_id);
+  if (length < 0) return;
+  json->append(buff, std::min<size_t>(length, sizeof(buff) - 1));
+  switch (event.phase) {
+    case 'C':
+      length = snprintf(buff, sizeof(buff), ",\"args\":{\"value\":%lld}",
+                        static_cast<long long>(event.value));
+      break;
+    case 's':
+      length = snprintf(buff, sizeof(buff), ",\"id\":%llu",
+                        static_cast<unsigned long long>(event.value));
+      break;
+    case 'f':
+      // Binds the flow end to the enclosing slice.
+      length = snprintf(buff, sizeof(buff), ",\"id\":%llu,\"bp\":\"e\"",
+                        static_cast<unsigned long long>(event.value));
+      break;
+    default:
+      length = 0;
+  }
+  if (length > 0)
+    json->append(buff, std::min<size_t>(length, sizeof(buff) - 1));
+  json->append("},\n");
+}
+
+}  // anonymous namespace
+
+void Tracer::SetEnabled(bool enabled) {
+  if (enabled) {
+    AutoLock lock(buffers_lock);
+    for (auto buffer : buffers) {
+      AutoLock buffer_lock(buffer->lock);
+      buffer->events.clear();
+      buffer->next = 0;
+    }
+  }
+  enabled_ = enabled;
+}
+
+void Tracer::Begin(const char* name) {
+  AddEvent(name, 'B', 0);
+}
+
+void Tracer::End(const char* name) {
+  AddEvent(name, 'E', 0);
+}
+
+void Tracer::Counter(const char* name, int64_t value) {
+  AddEvent(name, 'C', static_cast<uint64_t>(value));
+}
+
+void Tracer::FlowStart(const char* name, uint64_t id) {
+  AddEvent(name, 's', id);
+}
+
+void Tracer::FlowEnd(const char* name, uint64_t id) {
+  AddEvent(name, 'f', id);
+}
+
+std::string Tracer::ExportJson() {
+  std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  {
+    AutoLock lock(buffers_lock);
+    for (auto buffer : buffers) {
+      AutoLock buffer_lock(buffer->lock);
+      const auto& events = buffer->events;
+      for (size_t i = 0; i < events.size(); ++i) {
+        AppendEventJson(events[(buffer->next + i) % events.size()], &json);
+      }
+    }
+  }
+  // Drops a comma after the last event.
+  if (json.back() == '\n' && json[json.size() - 2] == ',')
+    json.erase(json.size() - 2, 1);
+  json.append("]}");
+  return json;
+}
+
+void Tracer::AddEvent(const char* name, char phase, uint64_t value) {
+  if (!IsEnabled()) return;
+  TraceEvent event;
+  event.name = name;
+  event.value = value;
+  event.timestamp_us = GetTimestampUs();
+  event.phase = phase;
+  ThreadBuffer* buffer = GetThreadBuffer();
+  event.thread_id = buffer->thread_id;
+  AutoLock lock(buffer->lock);
+  if (buffer->events.size() < kMaxEventsPerThread) {
+    buffer->events.push_back(event);
+  } else {
+    buffer->events[buffer->next] = event;
+    buffer->next = (buffer->next + 1) % kMaxEventsPerThread;
+  }
+}
@@ -0,0 +1,145 @@
+/*!
+ * tuning_profile.cc (https://github.com/SamsungDForum/NativePlayer)
+ * Copyright 2016, Samsung Electronics Co., Ltd
+ * Licensed under the MIT license
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @author Piotr Bałut
+ */
+
+#include "tuning_profile.h"
+
+#include <cstdio>
+
+#include "ppapi/utility/threading/lock.h"
+
+#include "common.h"
+
+namespace {
+
+// A field of the profile as it's named in messages, with its range.
+struct Field {
+  const char* name;
+  double min;
+  double max;
+  double (*get)(const TuningProfile&);
+  void (*set)(TuningProfile*, double);
+};
+
+constexpr double kMicrosecondsPerSecond = 1e6;
+
+const Field kFields[] = {
+  {"id", 0., INT32_MAX,
+   [](const TuningProfile& p) -> double { return p.id; },
+   [](TuningProfile* p, double v) { p->id = static_cast<int32_t>(v); }},
+  {"appendAhead", 0.5, 60.,
+   [](const TuningProfile& p) { return p.append_ahead; },
+   [](TuningProfile* p, double v) { p->append_ahead = v; }},
+  {"minAppendAhead", 0., 10.,
+   [](const TuningProfile& p) { return p.min_append_ahead; },
+   [](TuningProfile* p, double v) { p->min_append_ahead = v; }},
+  {"segmentAhead", 1., 300.,
+   [](const TuningProfile& p) { return p.segment_ahead; },
+   [](TuningProfile* p, double v) { p->segment_ahead = v; }},
+  {"languageSwitchAhead", 0., 10.,
+   [](const TuningProfile& p) { return p.language_switch_ahead; },
+   [](TuningProfile* p, double v) { p->language_switch_ahead = v; }},
+  {"bufferUpdateInterval", 10., 5000.,
+   [](const TuningProfile& p) -> double { return p.buffer_update_interval; },
+   [](TuningProfile* p, double v) {
+     p->buffer_update_interval = static_cast<int64_t>(v);
+   }},
+  {"downloadBudget", 1., 16.,
+   [](const TuningProfile& p) -> double { return p.download_budget; },
+   [](TuningProfile* p, double v) {
+     p->download_budget = static_cast<size_t>(v);
+   }},
+  {"audioProbeSize", 64., 16 * 1024 * 1024,
+   [](const TuningProfile& p) -> double { return p.audio_probe_size; },
+   [](TuningProfile* p, double v) {
+     p->audio_probe_size = static_cast<uint32_t>(v);
+   }},
+  {"videoProbeSize", 1024., 16 * 1024 * 1024,
+   [](const TuningProfile& p) -> double { return p.video_probe_size; },
+   [](TuningProfile* p, double v) {
+     p->video_probe_size = static_cast<uint32_t>(v);
+   }},
+  {"analyzeDuration", 0.1, 60.,
+   [](const TuningProfile& p) {
+     return p.analyze_duration / kMicrosecondsPerSecond;
+   },
+   [](TuningProfile* p, double v) {
+     p->analyze_duration = static_cast<int64_t>(v * kMicrosecondsPerSecond);
+   }},
+  {"downloadBufferSize", 4 * 1024, 64 * 1024 * 1024,
+   [](const TuningProfile& p) -> double { return p.download_buffer_size; },
+   [](TuningProfile* p, double v) {
+     p->download_buffer_size = static_cast<uint32_t>(v);
+   }},
+  {"downloadChunkSize", 4 * 1024, 16 * 1024 * 1024,
+   [](const TuningProfile& p) -> double { return p.download_chunk_size; },
+   [](TuningProfile* p, double v) {
+     p->download_chunk_size = static_cast<uint32_t>(v);
+   }},
+};
+
+pp::Lock current_lock;
+TuningProfile current;
+
+}  // anonymous namespace
+
+bool TuningProfile::Set(const std::string& name, double value) {
+  for (const auto& field : kFields) {
+    if (name != field.name) continue;
+    // NaN fails both comparisons.
+    if (!(value >= field.min && value <= field.max)) {
+      LOG_ERROR("Tuning profile field %s: %f is out of [%g, %g]",
+                field.name, value, field.min, field.max);
+      return false;
+    }
+    field.set(this, value);
+    return true;
+  }
+  LOG_ERROR("Unknown tuning profile field: %s", name.c_str());
+  return false;
+}
+
+bool TuningProfile::IsValid() const {
+  if (min_append_ahead > append_ahead) {
+    LOG_ERROR("Tuning profile minAppendAhead %f exceeds appendAhead %f",
+              min_append_ahead, append_ahead);
+    return false;
+  }
+  return true;
+}
+
+std::string TuningProfile::ToString() const {
+  std::string text;
+  for (const auto& field : kFields) {
+    char value[48];
+    snprintf(value, sizeof(value), "%s%s=%g", text.empty() ? "" : " ",
+             field.name, field.get(*this));
+    text += value;
+  }
+  return text;
+}
+
+void TuningProfile::SetCurrent(const TuningProfile& profile) {
+  pp::AutoLock lock(current_lock);
+  current = profile;
+}
+
+TuningProfile TuningProfile::Current() {
+  pp::AutoLock lock(current_lock);
+  return current;
+}